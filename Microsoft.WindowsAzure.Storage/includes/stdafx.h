@@ -32,6 +32,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <atomic>
 #include <math.h>
 #include <limits>
 #include <functional>
@@ -44,5 +45,6 @@
 
 #include "cpprest/http_client.h"
 #include "cpprest/producerconsumerstream.h"
+#include "cpprest/rawptrstream.h"
 
 #pragma warning(pop)
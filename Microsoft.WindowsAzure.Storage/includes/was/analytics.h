@@ -0,0 +1,346 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="analytics.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "blob.h"
+
+namespace wa { namespace storage {
+
+    /// <summary>
+    /// A non-owning view of the UTF-8 text of a field of a Storage Analytics log entry. It is only valid as long as the entry it belongs to.
+    /// </summary>
+    /// <remarks>The quotation marks around a quoted field are not part of the view, and the text inside them is not unescaped.</remarks>
+    class analytics_log_field
+    {
+    public:
+
+        analytics_log_field()
+            : m_data(nullptr), m_size(0)
+        {
+        }
+
+        analytics_log_field(const char* data, size_t size)
+            : m_data(data), m_size(size)
+        {
+        }
+
+        const char* data() const
+        {
+            return m_data;
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        /// <summary>
+        /// Returns true if the viewed bytes are exactly the given ASCII text
+        /// </summary>
+        bool equals(const char* text) const
+        {
+            size_t length = std::strlen(text);
+            return m_size == length && std::memcmp(m_data, text, length) == 0;
+        }
+
+        /// <summary>
+        /// Copies the viewed bytes into a UTF-8 string
+        /// </summary>
+        std::string to_utf8_string() const
+        {
+            return std::string(m_data, m_size);
+        }
+
+        /// <summary>
+        /// Converts the viewed bytes into a platform string
+        /// </summary>
+        WASTORAGE_API utility::string_t to_string() const;
+
+        /// <summary>
+        /// Parses the field as a decimal number, returning 0 if it is empty or not a number
+        /// </summary>
+        utility::size64_t to_number() const
+        {
+            utility::size64_t value = 0;
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                char c = m_data[i];
+                if (c < '0' || c > '9')
+                {
+                    return 0;
+                }
+
+                value = value * 10 + static_cast<utility::size64_t>(c - '0');
+            }
+
+            return value;
+        }
+
+    private:
+
+        const char* m_data;
+        size_t m_size;
+    };
+
+    /// <summary>
+    /// Represents an entry of a Storage Analytics log, whose fields are views of the line of the log it was parsed from.
+    /// </summary>
+    /// <remarks>The accessors follow version 1.0 of the log format. Later versions add fields at the end, which can be read
+    /// with <see cref="field" />.</remarks>
+    class analytics_log_entry
+    {
+    public:
+
+        analytics_log_entry()
+        {
+        }
+
+        /// <summary>
+        /// Splits a line of a log into the fields of the entry, without copying it. The text must outlive the use of the fields.
+        /// </summary>
+        /// <param name="data">The UTF-8 text of the line, without the line break.</param>
+        /// <param name="size">The length of the line in bytes.</param>
+        /// <returns><c>true</c> if the line is a well-formed entry; otherwise, <c>false</c>.</returns>
+        WASTORAGE_API bool parse(const char* data, size_t size);
+
+        /// <summary>
+        /// Gets the number of fields of the entry.
+        /// </summary>
+        size_t field_count() const
+        {
+            return m_fields.size();
+        }
+
+        /// <summary>
+        /// Gets a field of the entry by its position, or an empty field if the entry does not have that many.
+        /// </summary>
+        analytics_log_field field(size_t index) const
+        {
+            return index < m_fields.size() ? m_fields[index] : analytics_log_field();
+        }
+
+        analytics_log_field version() const
+        {
+            return field(0);
+        }
+
+        /// <summary>
+        /// Gets the time the request was received, which is parsed each time it is called.
+        /// </summary>
+        WASTORAGE_API utility::datetime request_start_time() const;
+
+        analytics_log_field operation_type() const
+        {
+            return field(2);
+        }
+
+        analytics_log_field request_status() const
+        {
+            return field(3);
+        }
+
+        int http_status_code() const
+        {
+            return static_cast<int>(field(4).to_number());
+        }
+
+        std::chrono::milliseconds end_to_end_latency() const
+        {
+            return std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(field(5).to_number()));
+        }
+
+        std::chrono::milliseconds server_latency() const
+        {
+            return std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(field(6).to_number()));
+        }
+
+        analytics_log_field authentication_type() const
+        {
+            return field(7);
+        }
+
+        analytics_log_field requester_account_name() const
+        {
+            return field(8);
+        }
+
+        analytics_log_field owner_account_name() const
+        {
+            return field(9);
+        }
+
+        analytics_log_field service_type() const
+        {
+            return field(10);
+        }
+
+        analytics_log_field request_url() const
+        {
+            return field(11);
+        }
+
+        analytics_log_field requested_object_key() const
+        {
+            return field(12);
+        }
+
+        analytics_log_field request_id() const
+        {
+            return field(13);
+        }
+
+        int operation_count() const
+        {
+            return static_cast<int>(field(14).to_number());
+        }
+
+        analytics_log_field requester_ip_address() const
+        {
+            return field(15);
+        }
+
+        analytics_log_field request_version() const
+        {
+            return field(16);
+        }
+
+        utility::size64_t request_header_size() const
+        {
+            return field(17).to_number();
+        }
+
+        utility::size64_t request_packet_size() const
+        {
+            return field(18).to_number();
+        }
+
+        utility::size64_t response_header_size() const
+        {
+            return field(19).to_number();
+        }
+
+        utility::size64_t response_packet_size() const
+        {
+            return field(20).to_number();
+        }
+
+        utility::size64_t request_content_length() const
+        {
+            return field(21).to_number();
+        }
+
+        analytics_log_field request_md5() const
+        {
+            return field(22);
+        }
+
+        analytics_log_field server_md5() const
+        {
+            return field(23);
+        }
+
+        analytics_log_field etag() const
+        {
+            return field(24);
+        }
+
+        analytics_log_field last_modified_time() const
+        {
+            return field(25);
+        }
+
+        analytics_log_field conditions_used() const
+        {
+            return field(26);
+        }
+
+        analytics_log_field user_agent() const
+        {
+            return field(27);
+        }
+
+        analytics_log_field referrer() const
+        {
+            return field(28);
+        }
+
+        analytics_log_field client_request_id() const
+        {
+            return field(29);
+        }
+
+    private:
+
+        std::vector<analytics_log_field> m_fields;
+    };
+
+    /// <summary>
+    /// Called for each entry of a log. The entry and its fields are only valid during the call.
+    /// </summary>
+    typedef std::function<void (const analytics_log_entry& entry)> analytics_log_handler;
+
+    /// <summary>
+    /// Returns a task that performs an asynchronous operation to parse a Storage Analytics log from a stream, such as one returned by
+    /// <see cref="cloud_blob::open_read_async" />.
+    /// </summary>
+    /// <param name="stream">The stream to read the log from.</param>
+    /// <param name="handler">The function to call for each entry of the log.</param>
+    /// <returns>A <see cref="pplx::task" /> object that returns the number of entries.</returns>
+    /// <remarks>The log is read in chunks and each entry is parsed where it lies in the chunk, so that only the text of the log is ever copied.
+    /// A malformed entry fails the operation with a <see cref="std::runtime_error" />.</remarks>
+    WASTORAGE_API pplx::task<utility::size64_t> read_analytics_log_async(concurrency::streams::istream stream, analytics_log_handler handler);
+
+    /// <summary>
+    /// Returns a task that performs an asynchronous operation to parse the Storage Analytics logs that an account has written under a
+    /// prefix of its <c>$logs</c> container.
+    /// </summary>
+    /// <param name="client">The client of the blob service of the account.</param>
+    /// <param name="prefix">The prefix of the log blobs, such as <c>blob/2014/05/01</c> for the requests made to the blob service on a day.</param>
+    /// <param name="handler">The function to call for each entry of the logs.</param>
+    /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+    /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+    /// <returns>A <see cref="pplx::task" /> object that returns the number of entries.</returns>
+    /// <remarks>Up to <see cref="blob_request_options::parallelism_factor" /> log blobs are read and parsed at the same time, so the handler
+    /// may be called from several threads at once, though the entries of each blob are passed to it in order. The blobs are read with
+    /// <see cref="blob_request_options::stream_prefetch_depth" /> ranges prefetched, or two if it is not set.</remarks>
+    WASTORAGE_API pplx::task<utility::size64_t> read_analytics_logs_async(const cloud_blob_client& client, const utility::string_t& prefix, analytics_log_handler handler, const blob_request_options& options, operation_context context);
+
+    /// <summary>
+    /// Parses the Storage Analytics logs that an account has written under a prefix of its <c>$logs</c> container.
+    /// </summary>
+    /// <param name="client">The client of the blob service of the account.</param>
+    /// <param name="prefix">The prefix of the log blobs, such as <c>blob/2014/05/01</c> for the requests made to the blob service on a day.</param>
+    /// <param name="handler">The function to call for each entry of the logs.</param>
+    /// <returns>The number of entries.</returns>
+    inline utility::size64_t read_analytics_logs(const cloud_blob_client& client, const utility::string_t& prefix, analytics_log_handler handler)
+    {
+        return read_analytics_logs_async(client, prefix, std::move(handler), blob_request_options(), operation_context()).get();
+    }
+
+}} // namespace wa::storage
@@ -25,11 +25,18 @@ namespace wa { namespace storage {
 
     class cloud_blob_shared_access_headers;
 
+    namespace core
+    {
+        class hmac_sha256_hash;
+        class sas_cache;
+    }
+
 }} // namespace wa::storage
 
 namespace wa { namespace storage { namespace protocol {
 
-    utility::string_t calculate_hmac_sha256_hash(const utility::string_t& string_to_hash, const storage_credentials& credentials);
+    WASTORAGE_API utility::string_t calculate_hmac_sha256_hash(const utility::string_t& string_to_hash, const storage_credentials& credentials);
+    utility::string_t calculate_hmac_sha256_hash(const utility::string_t& string_to_hash, const core::hmac_sha256_hash& signing_key);
 
     const utility::string_t auth_name_shared_key(U("SharedKey"));
     const utility::string_t auth_name_shared_key_lite(U("SharedKeyLite"));
@@ -49,8 +56,21 @@ namespace wa { namespace storage { namespace protocol {
         /// <param name="request">The request to be authenticated.</param>
         /// <param name="account_name">The storage account name.</param>
         canonicalizer_helper(const web::http::http_request& request, const utility::string_t& account_name)
-            : m_request(request), m_account_name(account_name)
+            : m_request(request), m_account_name(account_name), m_result(m_buffer)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="canonicalizer_helper"/> class that writes the
+        /// canonicalized string to the specified buffer, replacing its contents.
+        /// </summary>
+        /// <param name="request">The request to be authenticated.</param>
+        /// <param name="account_name">The storage account name.</param>
+        /// <param name="result">The buffer that receives the UTF-8 encoded canonicalized string.</param>
+        canonicalizer_helper(const web::http::http_request& request, const utility::string_t& account_name, std::string& result)
+            : m_request(request), m_account_name(account_name), m_result(result)
         {
+            m_result.clear();
         }
 
         /// <summary>
@@ -59,18 +79,24 @@ namespace wa { namespace storage { namespace protocol {
         /// <returns>The canonicalized string.</returns>
         utility::string_t str() const
         {
-            return m_result.str();
+            return utility::conversions::to_string_t(m_result);
         }
 
         /// <summary>
-        /// Appends a value to the canonicalization string.
+        /// Returns the canonicalized string encoded as UTF-8.
         /// </summary>
-        /// <param name="value">The value.</param>
-        void append(const utility::string_t& value)
+        /// <returns>The UTF-8 encoded canonicalized string.</returns>
+        const std::string& utf8_str() const
         {
-            m_result << value << U('\n');
+            return m_result;
         }
 
+        /// <summary>
+        /// Appends a value to the canonicalization string.
+        /// </summary>
+        /// <param name="value">The value.</param>
+        void append(const utility::string_t& value);
+
         /// <summary>
         /// Appends a Windows Azure Storage resource to the canonicalization string.
         /// </summary>
@@ -78,6 +104,15 @@ namespace wa { namespace storage { namespace protocol {
         /// for Shared Key Lite; <c>false</c> to include all URI parameters in the string.</param>
         void append_resource(bool only_comp);
 
+        /// <summary>
+        /// Appends a resource that was canonicalized earlier by <see cref="append_resource"/> for a request to the same URI.
+        /// </summary>
+        /// <param name="canonicalized_resource">The UTF-8 encoded canonicalized resource.</param>
+        void append_canonicalized_resource(const std::string& canonicalized_resource)
+        {
+            m_result.append(canonicalized_resource);
+        }
+
         /// <summary>
         /// Appends a header to the canonicalization string.
         /// </summary>
@@ -99,9 +134,12 @@ namespace wa { namespace storage { namespace protocol {
 
     private:
         
+        void append_utf8(utility::string_t::const_iterator begin, utility::string_t::const_iterator end, bool to_lower = false);
+
         const web::http::http_request& m_request;
         const utility::string_t& m_account_name;
-        utility::ostringstream_t m_result;
+        std::string m_buffer;
+        std::string& m_result;
     };
 
     /// <summary>
@@ -127,6 +165,41 @@ namespace wa { namespace storage { namespace protocol {
         /// </remarks>
         virtual utility::string_t canonicalize(const web::http::http_request& request, operation_context context) const = 0;
 
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="result">The buffer that receives the canonicalized string. Its previous contents are replaced, but its capacity can be reused.</param>
+        virtual void canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const
+        {
+            result = utility::conversions::to_utf8string(canonicalize(request, context));
+        }
+
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8, taking the canonicalized
+        /// resource from an earlier call to <see cref="canonicalize_resource_utf8"/> for a request to the same URI.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="canonicalized_resource">The UTF-8 encoded canonicalized resource of the request.</param>
+        /// <param name="result">The buffer that receives the canonicalized string. Its previous contents are replaced, but its capacity can be reused.</param>
+        virtual void canonicalize_utf8(const web::http::http_request& request, operation_context context, const std::string& canonicalized_resource, std::string& result) const
+        {
+            canonicalize_utf8(request, context, result);
+        }
+
+        /// <summary>
+        /// Converts the resource of the specified HTTP request into the standard form that ends its canonicalized string,
+        /// so that it can be shared by many requests to the same URI.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <returns>The UTF-8 encoded canonicalized resource, or an empty string if the canonicalizer does not support sharing it.</returns>
+        virtual std::string canonicalize_resource_utf8(const web::http::http_request& request) const
+        {
+            return std::string();
+        }
+
         /// <summary>
         /// Gets the authentication scheme used for canonicalization.
         /// </summary>
@@ -187,6 +260,30 @@ namespace wa { namespace storage { namespace protocol {
         /// </remarks>
         WASTORAGE_API utility::string_t canonicalize(const web::http::http_request& request, operation_context context) const override;
 
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="result">The buffer that receives the canonicalized string.</param>
+        WASTORAGE_API void canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const override;
+
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8, with a resource that was canonicalized earlier.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="canonicalized_resource">The UTF-8 encoded canonicalized resource of the request.</param>
+        /// <param name="result">The buffer that receives the canonicalized string.</param>
+        WASTORAGE_API void canonicalize_utf8(const web::http::http_request& request, operation_context context, const std::string& canonicalized_resource, std::string& result) const override;
+
+        /// <summary>
+        /// Converts the resource of the specified HTTP request into the standard form that ends its canonicalized string.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <returns>The UTF-8 encoded canonicalized resource.</returns>
+        WASTORAGE_API std::string canonicalize_resource_utf8(const web::http::http_request& request) const override;
+
         /// <summary>
         /// Gets the authentication scheme used for canonicalization.
         /// </summary>
@@ -199,6 +296,10 @@ namespace wa { namespace storage { namespace protocol {
         {
             return auth_name_shared_key;
         }
+
+    private:
+
+        void append_headers(canonicalizer_helper& helper, const web::http::http_request& request) const;
     };
 
     /// <summary>
@@ -234,6 +335,30 @@ namespace wa { namespace storage { namespace protocol {
         /// </remarks>
         WASTORAGE_API utility::string_t canonicalize(const web::http::http_request& request, operation_context context) const override;
 
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="result">The buffer that receives the canonicalized string.</param>
+        WASTORAGE_API void canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const override;
+
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8, with a resource that was canonicalized earlier.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="canonicalized_resource">The UTF-8 encoded canonicalized resource of the request.</param>
+        /// <param name="result">The buffer that receives the canonicalized string.</param>
+        WASTORAGE_API void canonicalize_utf8(const web::http::http_request& request, operation_context context, const std::string& canonicalized_resource, std::string& result) const override;
+
+        /// <summary>
+        /// Converts the resource of the specified HTTP request into the standard form that ends its canonicalized string.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <returns>The UTF-8 encoded canonicalized resource.</returns>
+        WASTORAGE_API std::string canonicalize_resource_utf8(const web::http::http_request& request) const override;
+
         /// <summary>
         /// Gets the authentication scheme used for canonicalization.
         /// </summary>
@@ -246,6 +371,10 @@ namespace wa { namespace storage { namespace protocol {
         {
             return auth_name_shared_key_lite;
         }
+
+    private:
+
+        void append_headers(canonicalizer_helper& helper, const web::http::http_request& request) const;
     };
 
     /// <summary>
@@ -281,6 +410,14 @@ namespace wa { namespace storage { namespace protocol {
         /// </remarks>
         WASTORAGE_API utility::string_t canonicalize(const web::http::http_request& request, operation_context context) const override;
 
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="result">The buffer that receives the canonicalized string.</param>
+        WASTORAGE_API void canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const override;
+
         /// <summary>
         /// Gets the authentication scheme used for canonicalization.
         /// </summary>
@@ -328,6 +465,14 @@ namespace wa { namespace storage { namespace protocol {
         /// </remarks>
         WASTORAGE_API utility::string_t canonicalize(const web::http::http_request& request, operation_context context) const override;
 
+        /// <summary>
+        /// Converts the specified HTTP request data into a standard form for signing, encoded as UTF-8.
+        /// </summary>
+        /// <param name="request">The HTTP request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="result">The buffer that receives the canonicalized string.</param>
+        WASTORAGE_API void canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const override;
+
         /// <summary>
         /// Gets the authentication scheme used for canonicalization.
         /// </summary>
@@ -361,6 +506,29 @@ namespace wa { namespace storage { namespace protocol {
         virtual void sign_request(web::http::http_request& request, operation_context context) const
         {
         }
+
+        /// <summary>
+        /// Returns the part of the signature of the specified request that only depends on its URI, 
+        /// so that it can be shared by many requests to the same URI.
+        /// </summary>
+        /// <param name="request">The request to be signed.</param>
+        /// <returns>The UTF-8 encoded canonicalized resource, or an empty string if the handler does not support sharing it.</returns>
+        virtual std::string canonicalize_resource(const web::http::http_request& request) const
+        {
+            return std::string();
+        }
+
+        /// <summary>
+        /// Sign the specified request for authentication, reusing a canonicalized resource returned by 
+        /// <see cref="canonicalize_resource"/> for a request to the same URI.
+        /// </summary>
+        /// <param name="request">The request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="canonicalized_resource">The UTF-8 encoded canonicalized resource of the request.</param>
+        virtual void sign_request_with_resource(web::http::http_request& request, operation_context context, const std::string& canonicalized_resource) const
+        {
+            sign_request(request, context);
+        }
     };
 
     /// <summary>
@@ -403,10 +571,7 @@ namespace wa { namespace storage { namespace protocol {
         /// </summary>
         /// <param name="canonicalizer">The canonicalizer to use to sign the request.</param>
         /// <param name="credentials">The <see cref="storage_credentials" /> to use to sign the request.</param>
-        shared_key_authentication_handler(std::shared_ptr<canonicalizer> canonicalizer, const storage_credentials& credentials)
-            : m_canonicalizer(canonicalizer), m_credentials(credentials)
-        {
-        }
+        WASTORAGE_API shared_key_authentication_handler(std::shared_ptr<canonicalizer> canonicalizer, const storage_credentials& credentials);
 
         /// <summary>
         /// Sign the specified request for authentication via Shared Key.
@@ -415,17 +580,38 @@ namespace wa { namespace storage { namespace protocol {
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         WASTORAGE_API void sign_request(web::http::http_request& request, operation_context context) const override;
 
+        /// <summary>
+        /// Returns the canonicalized resource of the specified request, which is shared by all requests to the same URI.
+        /// </summary>
+        /// <param name="request">The request to be signed.</param>
+        /// <returns>The UTF-8 encoded canonicalized resource, or an empty string if the canonicalizer does not support sharing it.</returns>
+        WASTORAGE_API std::string canonicalize_resource(const web::http::http_request& request) const override;
+
+        /// <summary>
+        /// Sign the specified request for authentication via Shared Key, reusing the canonicalized resource of a request to the same URI.
+        /// </summary>
+        /// <param name="request">The request to be signed.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="canonicalized_resource">The UTF-8 encoded canonicalized resource of the request.</param>
+        WASTORAGE_API void sign_request_with_resource(web::http::http_request& request, operation_context context, const std::string& canonicalized_resource) const override;
+
     private:
+
+        void sign_request_impl(web::http::http_request& request, operation_context context, const std::string* canonicalized_resource) const;
         
         std::shared_ptr<canonicalizer> m_canonicalizer;
         storage_credentials m_credentials;
+
+        // Keyed once with the account key, and copied for every request that is signed
+        std::shared_ptr<const core::hmac_sha256_hash> m_signing_key;
     };
 
 #pragma endregion
 
 #pragma region Shared Access Signatures
 
-    utility::string_t get_blob_sas_token(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource_type, const utility::string_t& resource, const storage_credentials& credentials);
+    utility::string_t get_blob_sas_token(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource_type, const utility::string_t& resource, const storage_credentials& credentials, const std::shared_ptr<core::sas_cache>& cache = nullptr);
+    std::vector<utility::string_t> get_blob_sas_tokens(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource_type, const std::vector<utility::string_t>& resources, const storage_credentials& credentials);
     utility::string_t get_queue_sas_token(const utility::string_t& identifier, const shared_access_policy& policy, const utility::string_t& resource, const storage_credentials& credentials);
     utility::string_t get_table_sas_token(const utility::string_t& identifier, const shared_access_policy& policy, const utility::string_t& table_name, const utility::string_t& start_partition_key, const utility::string_t& start_row_key, const utility::string_t& end_partition_key, const utility::string_t& end_row_key, const utility::string_t& resource, const storage_credentials& credentials);
     storage_credentials parse_query(const web::http::uri& uri, bool require_signed_resource);
@@ -0,0 +1,183 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="await.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+// Opt-in coroutine support: the storage client library itself does not include this header. Including it with a compiler
+// that supports coroutines lets a coroutine await the task of any asynchronous operation, and return a pplx::task itself:
+//
+//     pplx::task<utility::string_t> read_text(wa::storage::cloud_block_blob blob)
+//     {
+//         if (!co_await wa::storage::awaitable(blob.exists_async()))
+//         {
+//             co_return utility::string_t();
+//         }
+//
+//         co_return co_await wa::storage::awaitable(blob.download_text_async());
+//     }
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define WASTORAGE_COROUTINES_SUPPORTED
+#define WASTORAGE_COROUTINE_NAMESPACE std
+#define WASTORAGE_COROUTINE_NAMESPACE_BEGIN namespace std {
+#define WASTORAGE_COROUTINE_NAMESPACE_END }
+#elif defined(_MSC_VER) && defined(_RESUMABLE_FUNCTIONS_SUPPORTED)
+#include <experimental/resumable>
+#define WASTORAGE_COROUTINES_SUPPORTED
+#define WASTORAGE_COROUTINE_NAMESPACE std::experimental
+#define WASTORAGE_COROUTINE_NAMESPACE_BEGIN namespace std { namespace experimental {
+#define WASTORAGE_COROUTINE_NAMESPACE_END }}
+#elif defined(__cpp_coroutines)
+#include <experimental/coroutine>
+#define WASTORAGE_COROUTINES_SUPPORTED
+#define WASTORAGE_COROUTINE_NAMESPACE std::experimental
+#define WASTORAGE_COROUTINE_NAMESPACE_BEGIN namespace std { namespace experimental {
+#define WASTORAGE_COROUTINE_NAMESPACE_END }}
+#endif
+
+#ifdef WASTORAGE_COROUTINES_SUPPORTED
+
+#include <exception>
+
+#include "core.h"
+
+namespace wa { namespace storage {
+
+    /// <summary>
+    /// Adapts a task so that a coroutine can await it.
+    /// </summary>
+    /// <remarks>A task that has already completed is not waited for, so the coroutine goes on without a hop through the scheduler.
+    /// Otherwise the coroutine is resumed by a single continuation of the task, on the thread that completes it.</remarks>
+    template<typename T>
+    class task_awaiter
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="task_awaiter"/> class.
+        /// </summary>
+        /// <param name="task">The task to await.</param>
+        explicit task_awaiter(pplx::task<T> task)
+            : m_task(std::move(task))
+        {
+        }
+
+        bool await_ready() const
+        {
+            return m_task.is_done();
+        }
+
+        void await_suspend(WASTORAGE_COROUTINE_NAMESPACE::coroutine_handle<> handle)
+        {
+            m_task.then([handle] (pplx::task<T>)
+            {
+                handle.resume();
+            });
+        }
+
+        T await_resume()
+        {
+            return m_task.get();
+        }
+
+    private:
+
+        pplx::task<T> m_task;
+    };
+
+    /// <summary>
+    /// Returns an object by which a coroutine awaits the specified task.
+    /// </summary>
+    /// <param name="task">The task of an asynchronous operation.</param>
+    /// <returns>A <see cref="task_awaiter"/> object, whose result is the result of the task, or which throws the exception the task failed with.</returns>
+    template<typename T>
+    task_awaiter<T> awaitable(pplx::task<T> task)
+    {
+        return task_awaiter<T>(std::move(task));
+    }
+
+    namespace core
+    {
+        // The part of the promise of a coroutine that returns a pplx::task, which does not depend on the result type
+        template<typename T>
+        class basic_task_promise
+        {
+        public:
+
+            pplx::task<T> get_return_object()
+            {
+                return pplx::create_task(m_completion_event);
+            }
+
+            WASTORAGE_COROUTINE_NAMESPACE::suspend_never initial_suspend() const
+            {
+                return WASTORAGE_COROUTINE_NAMESPACE::suspend_never();
+            }
+
+            WASTORAGE_COROUTINE_NAMESPACE::suspend_never final_suspend() const noexcept
+            {
+                return WASTORAGE_COROUTINE_NAMESPACE::suspend_never();
+            }
+
+            void unhandled_exception()
+            {
+                m_completion_event.set_exception(std::current_exception());
+            }
+
+        protected:
+
+            pplx::task_completion_event<T> m_completion_event;
+        };
+
+        template<typename T>
+        class task_promise : public basic_task_promise<T>
+        {
+        public:
+
+            void return_value(T value)
+            {
+                this->m_completion_event.set(std::move(value));
+            }
+        };
+
+        template<>
+        class task_promise<void> : public basic_task_promise<void>
+        {
+        public:
+
+            void return_void()
+            {
+                m_completion_event.set();
+            }
+        };
+    }
+
+}} // namespace wa::storage
+
+WASTORAGE_COROUTINE_NAMESPACE_BEGIN
+
+    // Lets a coroutine return a pplx::task, which completes when the coroutine returns
+    template<typename T, typename... Args>
+    struct coroutine_traits<pplx::task<T>, Args...>
+    {
+        typedef wa::storage::core::task_promise<T> promise_type;
+    };
+
+WASTORAGE_COROUTINE_NAMESPACE_END
+
+#endif // WASTORAGE_COROUTINES_SUPPORTED
@@ -17,6 +17,10 @@
 
 #pragma once
 
+#include <chrono>
+#include <map>
+#include <mutex>
+
 #include "service_client.h"
 
 namespace wa { namespace storage {
@@ -27,6 +31,20 @@ namespace wa { namespace storage {
     class cloud_blob_directory;
     class cloud_blob_container;
     class cloud_blob_client;
+    class list_blob_item;
+
+    namespace core
+    {
+        class basic_cloud_block_blob_ostreambuf;
+        class blob_attribute_cache;
+        class blob_listing_cache;
+        class blob_content_cache;
+        class block_buffer_pool;
+        class mapped_file;
+        class memory_budget;
+        class sas_cache;
+        class upload_tuner;
+    }
 
     namespace protocol
     {
@@ -1025,4209 +1043,8319 @@ namespace wa { namespace storage {
     };
 
     /// <summary>
-    /// Represents a segment of <see cref="wa::storage::cloud_blob_container" /> results, and 
-    /// includes continuation and pagination information.
-    /// </summary>
-    typedef result_segment<cloud_blob_container> container_result_segment;
-
-    /// <summary>
-    /// Represents the system properties for a blob.
+    /// Represents a part of a blob listing that can be listed on its own, by any process, and saved as text between segments.
     /// </summary>
-    class cloud_blob_properties
+    /// <remarks>
+    /// Split a listing into units with <see cref="cloud_blob_container::split_listing_async" />, hand each unit to a worker as the text
+    /// returned by <see cref="blob_listing_unit::to_string" />, and have the worker list the unit's prefix segment by segment from
+    /// <see cref="blob_listing_unit::continuation_token" />, calling <see cref="blob_listing_unit::advance" /> with the continuation token
+    /// of every segment it has processed. A unit that is not a flat listing covers only the blobs directly under its prefix, so the
+    /// virtual directories it returns are skipped.
+    /// </remarks>
+    class blob_listing_unit
     {
     public:
+
         /// <summary>
-        /// Initializes a new instance of the <see cref="cloud_blob_properties"/> class.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_listing_unit"/> class.
         /// </summary>
-        cloud_blob_properties()
-            : m_type(blob_type::unspecified), m_page_blob_sequence_number(0),
-            m_lease_state(lease_state::unspecified), m_lease_status(lease_status::unspecified),
-            m_lease_duration(lease_duration::unspecified), m_size(0)
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="use_flat_blob_listing">Indicates whether the unit covers every blob under the prefix, or only the blobs directly under it.</param>
+        blob_listing_unit(const utility::string_t& prefix, bool use_flat_blob_listing)
+            : m_prefix(prefix), m_use_flat_blob_listing(use_flat_blob_listing), m_is_complete(false)
         {
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="cloud_blob_properties"/> class.
+        /// Reads a unit from the text returned by <see cref="blob_listing_unit::to_string" />.
         /// </summary>
-        /// <param name="other">A reference to a set of <see cref="cloud_blob_properties" /> on which to base the new instance.</param>
-        cloud_blob_properties(cloud_blob_properties&& other)
-        {
-            *this = std::move(other);
-        }
+        /// <param name="value">The saved unit.</param>
+        /// <returns>The unit.</returns>
+        WASTORAGE_API static blob_listing_unit parse(const utility::string_t& value);
 
         /// <summary>
-        /// Returns a reference to a <see cref="cloud_blob_properties" /> object.
+        /// Returns the unit, with its progress, as text that can be saved and read back with <see cref="blob_listing_unit::parse" />.
         /// </summary>
-        /// <param name="other">A reference to a set of <see cref="cloud_blob_properties" /> to use to set properties.</param>
-        /// <returns>A <see cref="cloud_blob_properties" /> object with properties set.</returns>
-        cloud_blob_properties& operator=(cloud_blob_properties&& other)
-        {
-            m_size = std::move(other.m_size);
-            m_etag = std::move(other.m_etag);
-            m_last_modified = std::move(other.m_last_modified);
-            m_type = std::move(other.m_type);
-            m_lease_duration = std::move(other.m_lease_duration);
-            m_lease_state = std::move(other.m_lease_state);
-            m_lease_status = std::move(other.m_lease_status);
-            m_page_blob_sequence_number = std::move(other.m_page_blob_sequence_number);
-            m_cache_control = std::move(other.m_cache_control);
-            m_content_disposition = std::move(other.m_content_disposition);
-            m_content_encoding = std::move(other.m_content_encoding);
-            m_content_language = std::move(other.m_content_language);
-            m_content_md5 = std::move(other.m_content_md5);
-            m_content_type = std::move(other.m_content_type);
-            return *this;
-        }
+        /// <returns>The unit as text.</returns>
+        WASTORAGE_API utility::string_t to_string() const;
 
         /// <summary>
-        /// Gets the cache-control value stored for the blob.
+        /// Gets the blob name prefix to list.
         /// </summary>
-        /// <returns>The blob's cache-control value.</returns>
-        const utility::string_t& cache_control() const
+        /// <returns>The blob name prefix.</returns>
+        const utility::string_t& prefix() const
         {
-            return m_cache_control;
+            return m_prefix;
         }
 
         /// <summary>
-        /// Sets the cache-control value stored for the blob.
+        /// Gets a value indicating whether the unit is listed in a flat listing.
         /// </summary>
-        /// <param name="value">The blob's cache-control value.</param>
-        void set_cache_control(const utility::string_t& value)
+        /// <returns><c>true</c> if every blob under the prefix belongs to the unit; <c>false</c> if only the blobs directly under it do.</returns>
+        bool use_flat_blob_listing() const
         {
-            m_cache_control = value;
+            return m_use_flat_blob_listing;
         }
 
         /// <summary>
-        /// Gets the content-disposition value stored for the blob.
+        /// Gets the continuation token to list the next segment of the unit with.
         /// </summary>
-        /// <returns>The blob's content-disposition value.</returns>
-        const utility::string_t& content_disposition() const
+        /// <returns>A <see cref="blob_continuation_token" />, which is empty before the first segment.</returns>
+        const blob_continuation_token& continuation_token() const
         {
-            return m_content_disposition;
+            return m_continuation_token;
         }
 
         /// <summary>
-        /// Sets the content-disposition value stored for the blob.
+        /// Records that a segment of the unit has been processed.
         /// </summary>
-        /// <param name="value">The blob's content-disposition value.</param>
-        void set_content_disposition(const utility::string_t& value)
+        /// <param name="next_token">The continuation token returned with the segment.</param>
+        void advance(const blob_continuation_token& next_token)
         {
-            m_content_disposition = value;
+            m_continuation_token = next_token;
+            m_is_complete = next_token.empty();
         }
 
         /// <summary>
-        /// Gets the content-encoding value stored for the blob.
+        /// Gets a value indicating whether every segment of the unit has been processed.
         /// </summary>
-        /// <returns>The blob's content-encoding value.</returns>
-        const utility::string_t& content_encoding() const
+        /// <returns><c>true</c> if the unit is complete; otherwise, <c>false</c>.</returns>
+        bool is_complete() const
         {
-            return m_content_encoding;
+            return m_is_complete;
         }
 
+    private:
+
+        utility::string_t m_prefix;
+        bool m_use_flat_blob_listing;
+        blob_continuation_token m_continuation_token;
+        bool m_is_complete;
+    };
+
+    /// <summary>
+    /// Represents the names and main properties of a large number of blobs, stored column by column so that each blob takes
+    /// a few dozen bytes besides its name.
+    /// </summary>
+    /// <remarks>
+    /// The names are kept back to back as UTF-8 in a single buffer. Entity tags in the usual hexadecimal form and MD5 hashes
+    /// are kept as binary values, and any other value is kept as text on the side. Entries are read by index, in listing order.
+    /// </remarks>
+    class blob_inventory
+    {
+    public:
+
         /// <summary>
-        /// Sets the content-encoding value stored for the blob.
+        /// Initializes a new instance of the <see cref="blob_inventory"/> class.
         /// </summary>
-        /// <param name="value">The blob's content-encoding value.</param>
-        void set_content_encoding(const utility::string_t& value)
+        blob_inventory()
         {
-            m_content_encoding = value;
         }
 
         /// <summary>
-        /// Gets the content-language value stored for the blob.
+        /// Initializes a new instance of the <see cref="blob_inventory"/> class.
         /// </summary>
-        /// <returns>The blob's content-language value.</returns>
-        const utility::string_t& content_language() const
+        /// <param name="other">A reference to a <see cref="blob_inventory" /> on which to base the new instance.</param>
+        blob_inventory(const blob_inventory& other)
+            : m_names(other.m_names), m_name_ends(other.m_name_ends), m_lengths(other.m_lengths), m_last_modified(other.m_last_modified), m_etags(other.m_etags),
+            m_types(other.m_types), m_content_md5s(other.m_content_md5s), m_has_content_md5(other.m_has_content_md5), m_irregular_etags(other.m_irregular_etags),
+            m_irregular_content_md5s(other.m_irregular_content_md5s), m_continuation_token(other.m_continuation_token)
         {
-            return m_content_language;
         }
 
         /// <summary>
-        /// Sets the content-language value stored for the blob.
+        /// Initializes a new instance of the <see cref="blob_inventory"/> class.
         /// </summary>
-        /// <param name="value">The blob's content-language value.</param>
-        void set_content_language(const utility::string_t& value)
+        /// <param name="other">A reference to a <see cref="blob_inventory" /> on which to base the new instance.</param>
+        blob_inventory(blob_inventory&& other)
         {
-            m_content_language = value;
+            *this = std::move(other);
         }
 
         /// <summary>
-        /// Gets the size of the blob, in bytes.
+        /// Returns a reference to a <see cref="blob_inventory" /> object.
         /// </summary>
-        /// <returns>The blob's size in bytes.</returns>
-        utility::size64_t size() const
+        /// <param name="other">A reference to a <see cref="blob_inventory" /> to copy.</param>
+        /// <returns>A <see cref="blob_inventory" /> object with the blobs copied.</returns>
+        blob_inventory& operator=(const blob_inventory& other)
         {
-            return m_size;
+            blob_inventory copy(other);
+            *this = std::move(copy);
+            return *this;
         }
 
         /// <summary>
-        /// Gets the content-MD5 value stored for the blob.
+        /// Returns a reference to a <see cref="blob_inventory" /> object.
         /// </summary>
-        /// <returns>The blob's content-MD5 hash.</returns>
-        const utility::string_t& content_md5() const
+        /// <param name="other">A reference to a <see cref="blob_inventory" /> to move from.</param>
+        /// <returns>A <see cref="blob_inventory" /> object with the blobs moved.</returns>
+        blob_inventory& operator=(blob_inventory&& other)
         {
-            return m_content_md5;
+            m_names = std::move(other.m_names);
+            m_name_ends = std::move(other.m_name_ends);
+            m_lengths = std::move(other.m_lengths);
+            m_last_modified = std::move(other.m_last_modified);
+            m_etags = std::move(other.m_etags);
+            m_types = std::move(other.m_types);
+            m_content_md5s = std::move(other.m_content_md5s);
+            m_has_content_md5 = std::move(other.m_has_content_md5);
+            m_irregular_etags = std::move(other.m_irregular_etags);
+            m_irregular_content_md5s = std::move(other.m_irregular_content_md5s);
+            m_continuation_token = std::move(other.m_continuation_token);
+            return *this;
         }
 
         /// <summary>
-        /// Sets the content-MD5 value stored for the blob.
+        /// Gets the number of blobs in the inventory.
         /// </summary>
-        /// <param name="value">The blob's content-MD5 hash.</param>
-        void set_content_md5(const utility::string_t& value)
+        /// <returns>The number of blobs.</returns>
+        size_t size() const
         {
-            m_content_md5 = value;
+            return m_name_ends.size();
         }
 
         /// <summary>
-        /// Gets the content-type value stored for the blob.
+        /// Indicates whether the inventory holds no blobs.
         /// </summary>
-        /// <returns>The blob's content-type value.</returns>
-        const utility::string_t& content_type() const
+        /// <returns><c>true</c> if the inventory is empty; otherwise, <c>false</c>.</returns>
+        bool empty() const
         {
-            return m_content_type;
+            return m_name_ends.empty();
         }
 
         /// <summary>
-        /// Sets the content-type value stored for the blob.
+        /// Gets the name of a blob.
         /// </summary>
-        /// <param name="value">The blob's content-type value.</param>
-        void set_content_type(const utility::string_t& value)
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The name of the blob.</returns>
+        utility::string_t name(size_t index) const
         {
-            m_content_type = value;
+            return utility::conversions::to_string_t(name_utf8(index));
         }
 
         /// <summary>
-        /// Gets the blob's ETag value.
+        /// Gets the name of a blob as UTF-8, which is how it is stored.
         /// </summary>
-        /// <returns>The blob's ETag value.</returns>
-        const utility::string_t& etag() const
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The name of the blob.</returns>
+        std::string name_utf8(size_t index) const
         {
-            return m_etag;
+            size_t begin = index == 0 ? 0 : static_cast<size_t>(m_name_ends[index - 1]);
+            return m_names.substr(begin, static_cast<size_t>(m_name_ends[index]) - begin);
         }
 
         /// <summary>
-        /// Gets the last-modified time for the blob, expressed as a UTC value.
+        /// Gets the size of a blob, in bytes.
         /// </summary>
-        /// <returns>The blob's last-modified time, in UTC format.</returns>
-        const utility::datetime& last_modified() const
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The size of the blob, in bytes.</returns>
+        utility::size64_t length(size_t index) const
         {
-            return m_last_modified;
+            return m_lengths[index];
         }
 
         /// <summary>
-        /// Gets the type of the blob.
+        /// Gets the last-modified time of a blob.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::blob_type" /> object that indicates the type of the blob.</returns>
-        blob_type type() const
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The last-modified time of the blob, which is not valid if the service did not return it.</returns>
+        utility::datetime last_modified(size_t index) const
         {
-            return m_type;
+            return utility::datetime() + m_last_modified[index];
         }
 
         /// <summary>
-        /// Gets the blob's lease status.
+        /// Gets the type of a blob.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::lease_status" /> object that indicates the blob's lease status.</returns>
-        wa::storage::lease_status lease_status() const
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>A <see cref="wa::storage::blob_type"/> value.</returns>
+        blob_type type(size_t index) const
         {
-            return m_lease_status;
+            return static_cast<blob_type>(m_types[index]);
         }
 
         /// <summary>
-        /// Gets the blob's lease state.
+        /// Gets the ETag of a blob, quoted the same way as <see cref="wa::storage::cloud_blob_properties::etag"/>.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::lease_state" /> object that indicates the blob's lease state.</returns>
-        wa::storage::lease_state lease_state() const
-        {
-            return m_lease_state;
-        }
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The ETag of the blob.</returns>
+        WASTORAGE_API utility::string_t etag(size_t index) const;
 
         /// <summary>
-        /// Gets the blob's lease duration.
+        /// Gets the base64-encoded MD5 hash of the content of a blob.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::lease_duration" /> object that indicates the blob's lease duration.</returns>
-        wa::storage::lease_duration lease_duration() const
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The MD5 hash of the blob, or an empty string if the blob has none.</returns>
+        WASTORAGE_API utility::string_t content_md5(size_t index) const;
+
+        /// <summary>
+        /// Gets the continuation token to use to list the blobs that follow the ones in this inventory.
+        /// </summary>
+        /// <returns>A reference to the <see cref="blob_continuation_token" />, which is empty if the listing is complete.</returns>
+        const blob_continuation_token& continuation_token() const
         {
-            return m_lease_duration;
+            return m_continuation_token;
         }
 
         /// <summary>
-        /// If the blob is a page blob, gets the blob's current sequence number.
+        /// Sets the continuation token to use to list the blobs that follow the ones in this inventory.
         /// </summary>
-        /// <returns>The blob's current sequence number.</returns>
-        int64_t page_blob_sequence_number() const
+        /// <param name="token">The continuation token.</param>
+        void set_continuation_token(blob_continuation_token token)
         {
-            return m_page_blob_sequence_number;
+            m_continuation_token = std::move(token);
         }
 
+        /// <summary>
+        /// Reserves space for a number of blobs, so that adding them does not need to grow the storage.
+        /// </summary>
+        /// <param name="count">The number of blobs.</param>
+        /// <param name="name_bytes">The total length of their names, in UTF-8 bytes.</param>
+        WASTORAGE_API void reserve(size_t count, size_t name_bytes);
+
+        /// <summary>
+        /// Adds the blobs of another inventory after the blobs of this one, and takes its continuation token.
+        /// </summary>
+        /// <param name="other">The inventory to add.</param>
+        WASTORAGE_API void append(const blob_inventory& other);
+
+        /// <summary>
+        /// Removes all the blobs, and releases the memory they used.
+        /// </summary>
+        WASTORAGE_API void clear();
+
+        /// <summary>
+        /// Adds a blob at the end of the inventory.
+        /// </summary>
+        /// <param name="name">The name of the blob.</param>
+        /// <param name="length">The size of the blob, in bytes.</param>
+        /// <param name="last_modified">The last-modified time of the blob.</param>
+        /// <param name="etag">The ETag of the blob, without quotes, as the listing returns it.</param>
+        /// <param name="type">The type of the blob.</param>
+        /// <param name="content_md5">The base64-encoded MD5 hash of the blob, or an empty string.</param>
+        WASTORAGE_API void _add_blob(const utility::string_t& name, utility::size64_t length, const utility::datetime& last_modified, const utility::string_t& etag, blob_type type, const utility::string_t& content_md5);
+
     private:
 
-        void set_type(blob_type value)
-        {
-            m_type = value;
-        }
+        std::string m_names;
+        std::vector<uint64_t> m_name_ends;
+        std::vector<utility::size64_t> m_lengths;
+        std::vector<utility::datetime::interval_type> m_last_modified;
 
-        utility::string_t m_cache_control;
-        utility::string_t m_content_disposition;
-        utility::string_t m_content_encoding;
-        utility::string_t m_content_language;
-        utility::size64_t m_size;
-        utility::string_t m_content_md5;
-        utility::string_t m_content_type;
-        utility::string_t m_etag;
-        utility::datetime m_last_modified;
-        blob_type m_type;
-        wa::storage::lease_status m_lease_status;
-        wa::storage::lease_state m_lease_state;
-        wa::storage::lease_duration m_lease_duration;
-        int64_t m_page_blob_sequence_number;
+        // 0 marks an ETag that is kept as text in m_irregular_etags
+        std::vector<uint64_t> m_etags;
+        std::vector<uint8_t> m_types;
 
-        void copy_from_root(const cloud_blob_properties& root_blob_properties);
-        void update_etag_and_last_modified(const cloud_blob_properties& parsed_properties);
-        void update_size(const cloud_blob_properties& parsed_properties);
-        void update_page_blob_sequence_number(const cloud_blob_properties& parsed_properties);
-        void update_all(const cloud_blob_properties& parsed_properties, bool ignore_md5);
+        // 16 bytes for each blob, which are only meaningful where m_has_content_md5 is set
+        std::vector<uint8_t> m_content_md5s;
+        std::vector<bool> m_has_content_md5;
 
-        friend class cloud_blob;
-        friend class cloud_block_blob;
-        friend class cloud_page_blob;
-        friend class protocol::blob_response_parsers;
-        friend class protocol::list_blobs_reader;
+        std::map<size_t, utility::string_t> m_irregular_etags;
+        std::map<size_t, utility::string_t> m_irregular_content_md5s;
+        blob_continuation_token m_continuation_token;
+
+        friend class blob_inventory_snapshot;
     };
 
     /// <summary>
-    /// Represents the optional headers that can be returned with a blob accessed via a shared access signature.
+    /// Represents the differences between a <see cref="wa::storage::blob_inventory_snapshot" /> and a more recent listing
+    /// of the same blobs.
     /// </summary>
-    class cloud_blob_shared_access_headers
+    class blob_inventory_diff
     {
     public:
+
         /// <summary>
-        /// Initializes a new instance of the <see cref="cloud_blob_shared_access_headers"/> class.
+        /// Initializes a new instance of the <see cref="blob_inventory_diff"/> class.
         /// </summary>
-        cloud_blob_shared_access_headers()
+        blob_inventory_diff()
         {
         }
 
         /// <summary>
-        /// Gets the value of the cache-control header returned with the blob.
+        /// Initializes a new instance of the <see cref="blob_inventory_diff"/> class.
         /// </summary>
-        /// <returns>The cache-control value.</returns>
-        const utility::string_t& cache_control() const
+        /// <param name="added">The indexes in the recent listing of the blobs that are not in the snapshot.</param>
+        /// <param name="changed">The indexes in the recent listing of the blobs whose ETag differs from the snapshot.</param>
+        /// <param name="removed">The indexes in the snapshot of the blobs that are not in the recent listing.</param>
+        blob_inventory_diff(std::vector<size_t> added, std::vector<size_t> changed, std::vector<size_t> removed)
+            : m_added(std::move(added)), m_changed(std::move(changed)), m_removed(std::move(removed))
         {
-            return m_cache_control;
         }
 
         /// <summary>
-        /// Sets value of the cache-control header returned with the blob.
+        /// Gets the blobs that are not in the snapshot.
         /// </summary>
-        /// <param name="value">The cache-control value.</param>
-        void set_cache_control(const utility::string_t& value)
+        /// <returns>The indexes of the blobs in the recent listing, in name order.</returns>
+        const std::vector<size_t>& added() const
         {
-            m_cache_control = value;
+            return m_added;
         }
 
         /// <summary>
-        /// Gets the value of the content-disposition header returned with the blob.
+        /// Gets the blobs whose ETag differs from the snapshot.
         /// </summary>
-        /// <returns>The content-disposition value.</returns>
-        const utility::string_t& content_disposition() const
+        /// <returns>The indexes of the blobs in the recent listing, in name order.</returns>
+        const std::vector<size_t>& changed() const
         {
-            return m_content_disposition;
+            return m_changed;
         }
 
         /// <summary>
-        /// Sets the value of the content-disposition header returned with the blob.
+        /// Gets the blobs that are no longer listed.
         /// </summary>
-        /// <param name="value">The content-disposition value.</param>
-        void set_content_disposition(const utility::string_t& value)
+        /// <returns>The indexes of the blobs in the snapshot, in name order.</returns>
+        const std::vector<size_t>& removed() const
         {
-            m_content_disposition = value;
+            return m_removed;
         }
 
+    private:
+
+        std::vector<size_t> m_added;
+        std::vector<size_t> m_changed;
+        std::vector<size_t> m_removed;
+    };
+
+    /// <summary>
+    /// Represents a <see cref="wa::storage::blob_inventory" /> saved to a file, which is read through a memory mapping so that
+    /// opening it takes no time whatever the number of blobs.
+    /// </summary>
+    /// <remarks>
+    /// The blobs are sorted by the bytes of their UTF-8 names, which is the order the Blob service lists them in, so that a blob
+    /// can be found by binary search and a new listing can be compared with a single merge. Keeping a snapshot up to date takes
+    /// listing the container, comparing the listing with <see cref="wa::storage::blob_inventory_snapshot::diff" /> and writing
+    /// the listing as the next snapshot. The file uses the byte order of the machine that wrote it.
+    /// </remarks>
+    class blob_inventory_snapshot
+    {
+    public:
+
         /// <summary>
-        /// Gets the value of the content-encoding header returned with the blob.
+        /// Initializes a new instance of the <see cref="blob_inventory_snapshot"/> class that holds no blobs.
         /// </summary>
-        /// <returns>The content-encoding value.</returns>
-        const utility::string_t& content_encoding() const
+        WASTORAGE_API blob_inventory_snapshot();
+
+        /// <summary>
+        /// Writes an inventory to a file, sorting the blobs by name.
+        /// </summary>
+        /// <param name="path">The path of the file, which is replaced if it exists.</param>
+        /// <param name="inventory">The inventory to write.</param>
+        WASTORAGE_API static void write(const utility::string_t& path, const blob_inventory& inventory);
+
+        /// <summary>
+        /// Opens a file written by <see cref="wa::storage::blob_inventory_snapshot::write" />.
+        /// </summary>
+        /// <param name="path">The path of the file.</param>
+        /// <returns>A <see cref="wa::storage::blob_inventory_snapshot" /> that maps the file for as long as it or a copy of it exists.</returns>
+        WASTORAGE_API static blob_inventory_snapshot open(const utility::string_t& path);
+
+        /// <summary>
+        /// Gets the number of blobs in the snapshot.
+        /// </summary>
+        /// <returns>The number of blobs.</returns>
+        size_t size() const
         {
-            return m_content_encoding;
+            return m_size;
         }
 
         /// <summary>
-        /// Sets the value of the content-encoding header returned with the blob.
+        /// Indicates whether the snapshot holds no blobs.
         /// </summary>
-        /// <param name="value">The content-encoding value.</param>
-        void set_content_encoding(const utility::string_t& value)
+        /// <returns><c>true</c> if the snapshot is empty; otherwise, <c>false</c>.</returns>
+        bool empty() const
         {
-            m_content_encoding = value;
+            return m_size == 0;
         }
 
         /// <summary>
-        /// Gets the value of the content-language header returned with the blob.
+        /// Gets the name of a blob.
         /// </summary>
-        /// <returns>The content-language value.</returns>
-        const utility::string_t& content_language() const
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The name of the blob.</returns>
+        utility::string_t name(size_t index) const
         {
-            return m_content_language;
+            return utility::conversions::to_string_t(name_utf8(index));
         }
 
         /// <summary>
-        /// Sets the value of the content-language header returned with the blob.
+        /// Gets the name of a blob as UTF-8, which is how it is stored.
         /// </summary>
-        /// <param name="value">The content-language value.</param>
-        void set_content_language(const utility::string_t& value)
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The name of the blob.</returns>
+        std::string name_utf8(size_t index) const
         {
-            m_content_language = value;
+            size_t begin = index == 0 ? 0 : static_cast<size_t>(m_name_ends[index - 1]);
+            return std::string(m_names + begin, static_cast<size_t>(m_name_ends[index]) - begin);
         }
 
         /// <summary>
-        /// Gets the value of the content-type header returned with the blob.
+        /// Gets the size of a blob, in bytes.
         /// </summary>
-        /// <returns>The content-type value.</returns>
-        const utility::string_t& content_type() const
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The size of the blob, in bytes.</returns>
+        utility::size64_t length(size_t index) const
         {
-            return m_content_type;
+            return m_lengths[index];
         }
 
         /// <summary>
-        /// Sets the value of the content-type header returned with the blob.
+        /// Gets the last-modified time of a blob.
         /// </summary>
-        /// <param name="value">The content-type value.</param>
-        void set_content_type(const utility::string_t& value)
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The last-modified time of the blob, which is not valid if the service did not return it.</returns>
+        utility::datetime last_modified(size_t index) const
         {
-            m_content_type = value;
+            return utility::datetime() + m_last_modified[index];
+        }
+
+        /// <summary>
+        /// Gets the type of a blob.
+        /// </summary>
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>A <see cref="wa::storage::blob_type"/> value.</returns>
+        blob_type type(size_t index) const
+        {
+            return static_cast<blob_type>(m_types[index]);
         }
 
+        /// <summary>
+        /// Gets the ETag of a blob, quoted the same way as <see cref="wa::storage::cloud_blob_properties::etag"/>.
+        /// </summary>
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The ETag of the blob.</returns>
+        WASTORAGE_API utility::string_t etag(size_t index) const;
+
+        /// <summary>
+        /// Gets the base64-encoded MD5 hash of the content of a blob.
+        /// </summary>
+        /// <param name="index">The index of the blob.</param>
+        /// <returns>The MD5 hash of the blob, or an empty string if the blob has none.</returns>
+        WASTORAGE_API utility::string_t content_md5(size_t index) const;
+
+        /// <summary>
+        /// Finds a blob by name.
+        /// </summary>
+        /// <param name="name">The name of the blob.</param>
+        /// <param name="index">Set to the index of the blob if it is found.</param>
+        /// <returns><c>true</c> if the snapshot holds the blob; otherwise, <c>false</c>.</returns>
+        WASTORAGE_API bool find(const utility::string_t& name, size_t& index) const;
+
+        /// <summary>
+        /// Compares the snapshot with a more recent listing of the same blobs.
+        /// </summary>
+        /// <param name="current">The recent listing. It is sorted first if it is not in name order already.</param>
+        /// <returns>A <see cref="wa::storage::blob_inventory_diff" /> with the blobs that were added, changed and removed since the snapshot.</returns>
+        WASTORAGE_API blob_inventory_diff diff(const blob_inventory& current) const;
+
     private:
 
-        utility::string_t m_cache_control;
-        utility::string_t m_content_disposition;
-        utility::string_t m_content_encoding;
-        utility::string_t m_content_language;
-        utility::string_t m_content_type;
+        // Blobs that have an ETag or an MD5 hash that is kept as text, sorted by the index of the blob
+        struct text_column
+        {
+            text_column()
+                : indexes(nullptr), ends(nullptr), text(nullptr), count(0)
+            {
+            }
+
+            const uint64_t* indexes;
+            const uint64_t* ends;
+            const char* text;
+            size_t count;
+        };
+
+        static std::string find_text(const text_column& column, size_t index);
+        static const char* inventory_name(const blob_inventory& inventory, size_t index, size_t& size);
+
+        // Returns the indexes of the blobs of an inventory in name order
+        static std::vector<size_t> name_order(const blob_inventory& inventory);
+
+        std::shared_ptr<core::mapped_file> m_file;
+        size_t m_size;
+        const char* m_names;
+        const uint64_t* m_name_ends;
+        const uint64_t* m_lengths;
+        const uint64_t* m_last_modified;
+        const uint64_t* m_etags;
+        const uint8_t* m_content_md5s;
+        const uint8_t* m_types;
+        const uint8_t* m_has_content_md5;
+        text_column m_irregular_etags;
+        text_column m_irregular_content_md5s;
     };
 
     /// <summary>
-    /// Represents a set of timeout and retry policy options that may be specified on a request against the Blob service.
+    /// Represents a segment of <see cref="wa::storage::cloud_blob_container" /> results, and 
+    /// includes continuation and pagination information.
     /// </summary>
-    class blob_request_options : public request_options
+    typedef result_segment<cloud_blob_container> container_result_segment;
+
+    /// <summary>
+    /// Represents a blob that could not be deleted by <see cref="wa::storage::cloud_blob_container::delete_blobs_async" />.
+    /// </summary>
+    class blob_delete_failure
     {
     public:
+
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::blob_request_options" /> class.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_delete_failure" /> class.
         /// </summary>
-        blob_request_options()
-            : request_options(),
-            m_use_transactional_md5(false),
-            m_store_blob_content_md5(false),
-            m_disable_content_md5_validation(false),
-            m_single_blob_upload_threshold(protocol::default_single_blob_upload_threshold),
-            m_stream_read_size(protocol::max_block_size),
-            m_stream_write_size(protocol::max_block_size),
-            m_parallelism_factor(1)
+        /// <param name="name">The name of the blob.</param>
+        /// <param name="error">The exception the delete failed with.</param>
+        blob_delete_failure(utility::string_t name, std::exception_ptr error)
+            : m_name(std::move(name)), m_error(std::move(error))
         {
         }
 
         /// <summary>
-        /// Applies the default set of request options.
+        /// Gets the name of the blob that could not be deleted.
         /// </summary>
-        /// <param name="other">A reference to a set of <see cref="blob_request_options" />.</param>
-        /// <param name="type">The blob type, specified by <see cref="blob_type" />.</param>
-        /// <param name="apply_expiry">Specifies that an expiry time be applied to the
-        /// request options. This parameter is used internally.</param>
-        void apply_defaults(const blob_request_options& other, blob_type type, bool apply_expiry = true)
+        /// <returns>The name of the blob.</returns>
+        const utility::string_t& name() const
         {
-            request_options::apply_defaults(other, apply_expiry);
-
-            // To match the server's Put Blob API behavior, all block blob uploads
-            // should automatically set the blob's Content-MD5 property.
-            if (type == blob_type::block_blob)
-            {
-                m_store_blob_content_md5.merge(other.m_store_blob_content_md5, true);
-            }
-            else
-            {
-                m_store_blob_content_md5.merge(other.m_store_blob_content_md5);
-            }
-
-            m_use_transactional_md5.merge(other.m_use_transactional_md5);
-            m_disable_content_md5_validation.merge(other.m_disable_content_md5_validation);
-            m_parallelism_factor.merge(other.m_parallelism_factor);
-            m_single_blob_upload_threshold.merge(other.m_single_blob_upload_threshold);
-            m_stream_write_size.merge(other.m_stream_write_size);
-            m_stream_read_size.merge(other.m_stream_read_size);
+            return m_name;
         }
 
         /// <summary>
-        /// Gets a value indicating whether the content-MD5 hash will be calculated and validated for the request.
+        /// Gets the exception the delete failed with, which is usually a <see cref="wa::storage::storage_exception"/>.
         /// </summary>
-        /// <returns><c>true</c> if the content-MD5 hash will be calculated and validated for the request; otherwise, <c>false</c>.</returns>
-        bool use_transactional_md5() const
+        /// <returns>A pointer to the exception, which can be rethrown with std::rethrow_exception.</returns>
+        std::exception_ptr error() const
         {
-            return m_use_transactional_md5;
+            return m_error;
         }
 
+    private:
+
+        utility::string_t m_name;
+        std::exception_ptr m_error;
+    };
+
+    /// <summary>
+    /// Represents the system properties for a blob.
+    /// </summary>
+    class cloud_blob_properties
+    {
+    public:
         /// <summary>
-        /// Indicates whether to calculate and validate the content-MD5 hash for the request.
+        /// Initializes a new instance of the <see cref="cloud_blob_properties"/> class.
         /// </summary>
-        /// <param name="value"><c>true</c> to calculate and validate the content-MD5 hash for the request; otherwise, <c>false</c>.</param>
-        void set_use_transactional_md5(bool value)
+        cloud_blob_properties()
+            : m_type(blob_type::unspecified), m_page_blob_sequence_number(0),
+            m_lease_state(lease_state::unspecified), m_lease_status(lease_status::unspecified),
+            m_lease_duration(lease_duration::unspecified), m_size(0)
         {
-            m_use_transactional_md5 = value;
         }
 
         /// <summary>
-        /// Gets a value indicating whether the content-MD5 hash will be calculated and stored when uploading a blob.
+        /// Initializes a new instance of the <see cref="cloud_blob_properties"/> class.
         /// </summary>
-        /// <returns><c>true</c> to calculate and store the content-MD5 hash when uploading a blob; otherwise, <c>false</c>.</returns>
-        bool store_blob_content_md5() const
+        /// <param name="other">A reference to a set of <see cref="cloud_blob_properties" /> on which to base the new instance.</param>
+        cloud_blob_properties(cloud_blob_properties&& other)
         {
-            return m_store_blob_content_md5;
+            *this = std::move(other);
         }
 
         /// <summary>
-        /// Indicates whether to calculate and store the content-MD5 hash when uploading a blob.
+        /// Returns a reference to a <see cref="cloud_blob_properties" /> object.
         /// </summary>
-        /// <param name="value"><c>true</c> to calculate and store the content-MD5 hash when uploading a blob; otherwise, <c>false</c>.</param>
-        void set_store_blob_content_md5(bool value)
+        /// <param name="other">A reference to a set of <see cref="cloud_blob_properties" /> to use to set properties.</param>
+        /// <returns>A <see cref="cloud_blob_properties" /> object with properties set.</returns>
+        cloud_blob_properties& operator=(cloud_blob_properties&& other)
         {
-            m_store_blob_content_md5 = value;
+            m_size = std::move(other.m_size);
+            m_etag = std::move(other.m_etag);
+            m_last_modified = std::move(other.m_last_modified);
+            m_type = std::move(other.m_type);
+            m_lease_duration = std::move(other.m_lease_duration);
+            m_lease_state = std::move(other.m_lease_state);
+            m_lease_status = std::move(other.m_lease_status);
+            m_page_blob_sequence_number = std::move(other.m_page_blob_sequence_number);
+            m_cache_control = std::move(other.m_cache_control);
+            m_content_disposition = std::move(other.m_content_disposition);
+            m_content_encoding = std::move(other.m_content_encoding);
+            m_content_language = std::move(other.m_content_language);
+            m_content_md5 = std::move(other.m_content_md5);
+            m_content_type = std::move(other.m_content_type);
+            return *this;
         }
 
         /// <summary>
-        /// Gets a value indicating whether content-MD5 validation will be disabled when downloading blobs.
+        /// Gets the cache-control value stored for the blob.
         /// </summary>
-        /// <returns><c>true</c> to disable content-MD5 validation; otherwise, <c>false</c>.</returns>
-        bool disable_content_md5_validation() const
+        /// <returns>The blob's cache-control value.</returns>
+        const utility::string_t& cache_control() const
         {
-            return m_disable_content_md5_validation;
+            return m_cache_control;
         }
 
         /// <summary>
-        /// Indicates whether to disable content-MD5 validation when downloading blobs.
+        /// Sets the cache-control value stored for the blob.
         /// </summary>
-        /// <param name="value"><c>true</c> to disable content-MD5 validation; otherwise, <c>false</c>.</param>
-        void set_disable_content_md5_validation(bool value)
+        /// <param name="value">The blob's cache-control value.</param>
+        void set_cache_control(const utility::string_t& value)
         {
-            m_disable_content_md5_validation = value;
+            m_cache_control = value;
         }
 
         /// <summary>
-        /// Gets the maximum size of a blob in bytes that may be uploaded as a single blob.
+        /// Gets the content-disposition value stored for the blob.
         /// </summary>
-        /// <returns>The maximum size of a blob, in bytes, that may be uploaded as a single blob,
-        /// ranging from between 1 and 64 MB inclusive.</returns>
-        utility::size64_t single_blob_upload_threshold_in_bytes() const
+        /// <returns>The blob's content-disposition value.</returns>
+        const utility::string_t& content_disposition() const
         {
-            return m_single_blob_upload_threshold;
+            return m_content_disposition;
         }
 
         /// <summary>
-        /// Sets the maximum size of a blob in bytes that may be uploaded as a single blob.
+        /// Sets the content-disposition value stored for the blob.
         /// </summary>
-        /// <param name="value">The maximum size of a blob, in bytes, that may be uploaded as a single blob,
-        /// ranging from between 1 and 64 MB inclusive.</param>
-        void set_single_blob_upload_threshold_in_bytes(utility::size64_t value)
+        /// <param name="value">The blob's content-disposition value.</param>
+        void set_content_disposition(const utility::string_t& value)
         {
-            m_single_blob_upload_threshold = value;
+            m_content_disposition = value;
         }
 
         /// <summary>
-        /// Gets the number of blocks or pages that may be simultaneously uploaded when uploading a blob that is greater than
-        /// the value specified by the <see cref="single_blob_upload_threshold_in_bytes" /> property in size.
+        /// Gets the content-encoding value stored for the blob.
         /// </summary>
-        /// <returns>The number of parallel block or page upload operations that may proceed.</returns>
-        int parallelism_factor() const
+        /// <returns>The blob's content-encoding value.</returns>
+        const utility::string_t& content_encoding() const
         {
-            return m_parallelism_factor;
+            return m_content_encoding;
         }
 
         /// <summary>
-        /// Sets the number of blocks or pages that may be simultaneously uploaded when uploading a blob that is greater than
-        /// the value specified by the <see cref="single_blob_upload_threshold_in_bytes" /> property in size.
+        /// Sets the content-encoding value stored for the blob.
         /// </summary>
-        /// <param name="value">The number of parallel block or page upload operations that may proceed.</param>
-        void set_parallelism_factor(int value)
+        /// <param name="value">The blob's content-encoding value.</param>
+        void set_content_encoding(const utility::string_t& value)
         {
-            m_parallelism_factor = value;
+            m_content_encoding = value;
         }
 
         /// <summary>
-        /// Gets the minimum number of bytes to buffer when reading from a blob stream.
+        /// Gets the content-language value stored for the blob.
         /// </summary>
-        /// <returns>The minimum number of bytes to buffer, being at least 16KB.</returns>
-        size_t stream_read_size_in_bytes() const
+        /// <returns>The blob's content-language value.</returns>
+        const utility::string_t& content_language() const
         {
-            return m_stream_read_size;
+            return m_content_language;
         }
 
         /// <summary>
-        /// Sets the minimum number of bytes to buffer when reading from a blob stream.
+        /// Sets the content-language value stored for the blob.
         /// </summary>
-        /// <param name="value">The minimum number of bytes to buffer, being at least 16KB.</param>
-        void set_stream_read_size_in_bytes(size_t value)
+        /// <param name="value">The blob's content-language value.</param>
+        void set_content_language(const utility::string_t& value)
         {
-            m_stream_read_size = value;
+            m_content_language = value;
         }
 
         /// <summary>
-        /// Gets the block size for writing to a block blob.
+        /// Gets the size of the blob, in bytes.
         /// </summary>
-        /// <returns>The size of a block, in bytes, ranging from between 16 KB and 4 MB inclusive.</returns>
-        size_t stream_write_size_in_bytes() const
+        /// <returns>The blob's size in bytes.</returns>
+        utility::size64_t size() const
         {
-            return m_stream_write_size;
+            return m_size;
         }
 
         /// <summary>
-        /// Sets the block size for writing to a block blob.
+        /// Gets the content-MD5 value stored for the blob.
         /// </summary>
-        /// <param name="value">The size of a block, in bytes, ranging from between 16 KB and 4 MB inclusive.</param>
-        void set_stream_write_size_in_bytes(size_t value)
+        /// <returns>The blob's content-MD5 hash.</returns>
+        const utility::string_t& content_md5() const
         {
-            m_stream_write_size = value;
+            return m_content_md5;
         }
 
-    private:
-
-        option_with_default<bool> m_use_transactional_md5;
-        option_with_default<bool> m_store_blob_content_md5;
-        option_with_default<bool> m_disable_content_md5_validation;
-        option_with_default<int> m_parallelism_factor;
-        option_with_default<utility::size64_t> m_single_blob_upload_threshold;
-        option_with_default<size_t> m_stream_write_size;
-        option_with_default<size_t> m_stream_read_size;
-    };
+        /// <summary>
+        /// Sets the content-MD5 value stored for the blob.
+        /// </summary>
+        /// <param name="value">The blob's content-MD5 hash.</param>
+        void set_content_md5(const utility::string_t& value)
+        {
+            m_content_md5 = value;
+        }
 
-    /// <summary>
-    /// Represents a block in a block list.
-    /// </summary>
-    class block_list_item
-    {
-    public:
         /// <summary>
-        /// Indicates which block lists should be searched to find a specified block. 
+        /// Gets the content-type value stored for the blob.
         /// </summary>
-        enum block_mode
+        /// <returns>The blob's content-type value.</returns>
+        const utility::string_t& content_type() const
         {
-            /// <summary>
-            /// Search the committed block list only.
-            /// </summary>
-            committed,
+            return m_content_type;
+        }
 
-            /// <summary>
-            /// Search the uncommitted block list only.
-            /// </summary>
-            uncommitted,
-
-            /// <summary>
-            /// Search the uncommitted block list first, and if the block is not found there, search 
-            /// the committed block list.
-            /// </summary>
-            latest
-        };
+        /// <summary>
+        /// Sets the content-type value stored for the blob.
+        /// </summary>
+        /// <param name="value">The blob's content-type value.</param>
+        void set_content_type(const utility::string_t& value)
+        {
+            m_content_type = value;
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="block_list_item"/> class.
+        /// Gets the blob's ETag value.
         /// </summary>
-        /// <param name="id">The block name.</param>
-        block_list_item(const utility::string_t& id)
-            : m_id(id), m_size(-1), m_mode(block_mode::latest)
+        /// <returns>The blob's ETag value.</returns>
+        const utility::string_t& etag() const
         {
+            return m_etag;
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="block_list_item"/> class.
+        /// Gets the last-modified time for the blob, expressed as a UTC value.
         /// </summary>
-        /// <param name="id">The block name.</param>
-        /// <param name="mode">A <see cref="block_mode" /> value that indicates which block lists to search for the block.</param>
-        block_list_item(const utility::string_t& id, block_mode mode)
-            : m_id(id), m_size(-1), m_mode(mode)
+        /// <returns>The blob's last-modified time, in UTC format.</returns>
+        const utility::datetime& last_modified() const
         {
+            return m_last_modified;
         }
 
         /// <summary>
-        /// Gets the name of the block.
+        /// Gets the type of the blob.
         /// </summary>
-        /// <returns>The block name.</returns>
-        const utility::string_t& id() const
+        /// <returns>A <see cref="wa::storage::blob_type" /> object that indicates the type of the blob.</returns>
+        blob_type type() const
         {
-            return m_id;
+            return m_type;
         }
 
         /// <summary>
-        /// Gets the size of block in bytes.
+        /// Gets the blob's lease status.
         /// </summary>
-        /// <returns>The block size.</returns>
-        size_t size() const
+        /// <returns>A <see cref="wa::storage::lease_status" /> object that indicates the blob's lease status.</returns>
+        wa::storage::lease_status lease_status() const
         {
-            return m_size;
+            return m_lease_status;
         }
 
         /// <summary>
-        /// Gets a value indicating whether the block has been committed.
+        /// Gets the blob's lease state.
         /// </summary>
-        /// <returns>A <see cref="block_mode" /> value that indicates whether the block has been committed.</returns>
-        block_mode mode() const
+        /// <returns>A <see cref="wa::storage::lease_state" /> object that indicates the blob's lease state.</returns>
+        wa::storage::lease_state lease_state() const
         {
-            return m_mode;
+            return m_lease_state;
         }
 
-    private:
+        /// <summary>
+        /// Gets the blob's lease duration.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::lease_duration" /> object that indicates the blob's lease duration.</returns>
+        wa::storage::lease_duration lease_duration() const
+        {
+            return m_lease_duration;
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="block_list_item"/> class.
+        /// If the blob is a page blob, gets the blob's current sequence number.
         /// </summary>
-        /// <param name="id">The block name.</param>
-        /// <param name="size">The size of the block.</param>
-        /// <param name="committed"><c>true</c> indicates that the block has been committed; 
-        /// <c>false</c> indicates that it is uncommitted.</param>
-        block_list_item(const utility::string_t& id, size_t size, bool committed)
-            : m_id(id), m_size(size), m_mode(committed ? block_mode::committed : block_mode::uncommitted)
+        /// <returns>The blob's current sequence number.</returns>
+        int64_t page_blob_sequence_number() const
         {
+            return m_page_blob_sequence_number;
         }
 
-        utility::string_t m_id;
-        size_t m_size;
-        block_mode m_mode;
+    private:
 
-        friend class protocol::block_list_reader;
+        void set_type(blob_type value)
+        {
+            m_type = value;
+        }
+
+        utility::string_t m_cache_control;
+        utility::string_t m_content_disposition;
+        utility::string_t m_content_encoding;
+        utility::string_t m_content_language;
+        utility::size64_t m_size;
+        utility::string_t m_content_md5;
+        utility::string_t m_content_type;
+        utility::string_t m_etag;
+        utility::datetime m_last_modified;
+        blob_type m_type;
+        wa::storage::lease_status m_lease_status;
+        wa::storage::lease_state m_lease_state;
+        wa::storage::lease_duration m_lease_duration;
+        int64_t m_page_blob_sequence_number;
+
+        void copy_from_root(const cloud_blob_properties& root_blob_properties);
+        void update_etag_and_last_modified(const cloud_blob_properties& parsed_properties);
+        void update_size(const cloud_blob_properties& parsed_properties);
+        void update_page_blob_sequence_number(const cloud_blob_properties& parsed_properties);
+        void update_all(const cloud_blob_properties& parsed_properties, bool ignore_md5);
+
+        friend class cloud_blob;
+        friend class cloud_block_blob;
+        friend class cloud_page_blob;
+        friend class protocol::blob_response_parsers;
+        friend class protocol::list_blobs_reader;
     };
 
     /// <summary>
-    /// Represents a range of pages in a page blob.
+    /// Represents the optional headers that can be returned with a blob accessed via a shared access signature.
     /// </summary>
-    class page_range
+    class cloud_blob_shared_access_headers
     {
     public:
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::page_range" /> class.
+        /// Initializes a new instance of the <see cref="cloud_blob_shared_access_headers"/> class.
         /// </summary>
-        /// <param name="start">The starting offset.</param>
-        /// <param name="end">The ending offset.</param>
-        page_range(int64_t start, int64_t end)
-            : m_start_offset(start), m_end_offset(end)
+        cloud_blob_shared_access_headers()
         {
         }
 
         /// <summary>
-        /// Returns the content of the page range as a string.
+        /// Gets the value of the cache-control header returned with the blob.
         /// </summary>
-        /// <returns>The content of the page range.</returns>
-        utility::string_t to_string() const
+        /// <returns>The cache-control value.</returns>
+        const utility::string_t& cache_control() const
         {
-            utility::ostringstream_t value;
-            value << protocol::header_value_range_prefix << m_start_offset << U('-') << m_end_offset;
-            return value.str();
+            return m_cache_control;
         }
 
         /// <summary>
-        /// Gets the starting offset of the page range.
+        /// Sets value of the cache-control header returned with the blob.
         /// </summary>
-        /// <returns>The starting offset.</returns>
-        int64_t start_offset() const
+        /// <param name="value">The cache-control value.</param>
+        void set_cache_control(const utility::string_t& value)
         {
-            return m_start_offset;
+            m_cache_control = value;
         }
 
         /// <summary>
-        /// Gets the ending offset of the page range.
+        /// Gets the value of the content-disposition header returned with the blob.
         /// </summary>
-        /// <returns>The ending offset.</returns>
-        int64_t end_offset() const
+        /// <returns>The content-disposition value.</returns>
+        const utility::string_t& content_disposition() const
         {
-            return m_end_offset;
+            return m_content_disposition;
         }
 
-    private:
-
-        int64_t m_start_offset;
-        int64_t m_end_offset;
-    };
-
-    /// <summary>
-    /// Describes actions that can be performed on a page blob sequence number.
-    /// </summary>
-    class sequence_number
-    {
-    public:
-        enum class sequence_number_action
+        /// <summary>
+        /// Sets the value of the content-disposition header returned with the blob.
+        /// </summary>
+        /// <param name="value">The content-disposition value.</param>
+        void set_content_disposition(const utility::string_t& value)
         {
-            /// <summary>
-            /// Sets the sequence number to be the higher of two values: the value included on the request, or the value 
-            /// currently stored for the blob.
-            /// </summary>
-            maximum,
-
-            /// <summary>
-            /// Sets the sequence number to the value included with the request.
-            /// </summary>
-            update,
-
-            /// <summary>
-            /// Increments the value of the sequence number by 1.
-            /// </summary>
-            increment
-        };
+            m_content_disposition = value;
+        }
 
         /// <summary>
-        /// Constructs a sequence number action to set the higher of two values: the value included on the request, 
-        /// or the value currently stored for the blob.
+        /// Gets the value of the content-encoding header returned with the blob.
         /// </summary>
-        /// <param name="value">The sequence number.</param>
-        /// <returns>A <see cref="wa::storage::sequence_number" /> object that represents the action.</returns>
-        static sequence_number maximum(int64_t value)
+        /// <returns>The content-encoding value.</returns>
+        const utility::string_t& content_encoding() const
         {
-            return sequence_number(sequence_number_action::maximum, value);
+            return m_content_encoding;
         }
 
         /// <summary>
-        /// Constructs a sequence number action to set the sequence number to the value included with the request.
+        /// Sets the value of the content-encoding header returned with the blob.
         /// </summary>
-        /// <param name="value">The sequence number.</param>
-        /// <returns>A <see cref="wa::storage::sequence_number" /> object that represents the action.</returns>
-        static sequence_number update(int64_t value)
+        /// <param name="value">The content-encoding value.</param>
+        void set_content_encoding(const utility::string_t& value)
         {
-            return sequence_number(sequence_number_action::update, value);
+            m_content_encoding = value;
         }
 
         /// <summary>
-        /// Constructs a sequence number action to increment the value of the sequence number by 1.
+        /// Gets the value of the content-language header returned with the blob.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::sequence_number" /> object that represents the action.</returns>
-        static sequence_number increment()
+        /// <returns>The content-language value.</returns>
+        const utility::string_t& content_language() const
         {
-            return sequence_number(sequence_number_action::increment, -1);
+            return m_content_language;
         }
 
         /// <summary>
-        /// Gets the action that will be performed on a page blob sequence number.
+        /// Sets the value of the content-language header returned with the blob.
         /// </summary>
-        /// <returns>The sequence number action.</returns>
-        sequence_number_action action() const
+        /// <param name="value">The content-language value.</param>
+        void set_content_language(const utility::string_t& value)
         {
-            return m_action;
+            m_content_language = value;
         }
 
         /// <summary>
-        /// Gets the page blob's sequence number.
+        /// Gets the value of the content-type header returned with the blob.
         /// </summary>
-        /// <returns>The sequence number.</returns>
-        int64_t value() const
+        /// <returns>The content-type value.</returns>
+        const utility::string_t& content_type() const
         {
-            return m_value;
+            return m_content_type;
         }
 
-    private:
-
-        sequence_number(sequence_number_action action, int64_t value)
+        /// <summary>
+        /// Sets the value of the content-type header returned with the blob.
+        /// </summary>
+        /// <param name="value">The content-type value.</param>
+        void set_content_type(const utility::string_t& value)
         {
-            m_action = action;
-            m_value = value;
+            m_content_type = value;
         }
 
-        sequence_number_action m_action;
-        int64_t m_value;
+    private:
+
+        utility::string_t m_cache_control;
+        utility::string_t m_content_disposition;
+        utility::string_t m_content_encoding;
+        utility::string_t m_content_language;
+        utility::string_t m_content_type;
     };
 
     /// <summary>
-    /// Represents the system properties for a container.
+    /// Counts the bytes of blob transfers that the service has acknowledged, and reports the count to a handler at most once per interval.
     /// </summary>
-    class cloud_blob_container_properties
+    /// <remarks>
+    /// Bytes are added when a block, a page write or a downloaded range completes, however many of them are in flight at once. Adding bytes only takes
+    /// an atomic increment and a look at the clock, so one instance can be shared by many concurrent transfers. As the handler is throttled, the
+    /// latest bytes may not have been reported when a transfer completes; <see cref="transfer_progress::report" /> reports them.
+    /// </remarks>
+    class transfer_progress
     {
     public:
+
         /// <summary>
-        /// Initializes a new instance of the <see cref="cloud_blob_container_properties"/> class.
+        /// The type of the function that is called with the number of bytes transferred so far.
         /// </summary>
-        cloud_blob_container_properties() {}
-
-        /// <summary>
-        /// Initializes a new instance of the <see cref="cloud_blob_container_properties"/> class.
-        /// </summary>
-        /// <param name="other">A reference to a <see cref="cloud_blob_container_properties" /> object.</param>
-        cloud_blob_container_properties(cloud_blob_container_properties&& other)
-        {
-            *this = std::move(other);
-        }
+        typedef std::function<void (utility::size64_t)> handler_type;
 
         /// <summary>
-        /// Returns a reference to a <see cref="cloud_blob_container_properties" /> object.
+        /// Initializes a new instance of the <see cref="wa::storage::transfer_progress" /> class that only counts the bytes.
         /// </summary>
-        /// <param name="other">A reference to a set of <see cref="cloud_blob_container_properties" /> to use to set properties.</param>
-        /// <returns>A <see cref="cloud_blob_container_properties" /> object with properties set.</returns>
-        cloud_blob_container_properties& operator=(cloud_blob_container_properties&& other)
+        transfer_progress()
+            : m_interval(0), m_bytes_transferred(0), m_last_report(0)
         {
-            m_etag = std::move(other.m_etag);
-            m_last_modified = std::move(other.m_last_modified);
-            m_lease_duration = std::move(other.m_lease_duration);
-            m_lease_state = std::move(other.m_lease_state);
-            m_lease_status = std::move(other.m_lease_status);
-            return *this;
         }
 
         /// <summary>
-        /// Gets the ETag value for the container.
+        /// Initializes a new instance of the <see cref="wa::storage::transfer_progress" /> class.
         /// </summary>
-        /// <returns>The container's quoted ETag value.</returns>
-        const utility::string_t& etag() const
+        /// <param name="handler">The function that is called with the number of bytes transferred so far.</param>
+        /// <param name="interval">The minimum time between two calls to the handler.</param>
+        transfer_progress(handler_type handler, std::chrono::milliseconds interval)
+            : m_handler(std::move(handler)), m_interval(interval.count()), m_bytes_transferred(0), m_last_report(0)
         {
-            return m_etag;
         }
 
         /// <summary>
-        /// Gets the container's last-modified time.
+        /// Gets the number of bytes transferred so far.
         /// </summary>
-        /// <returns>The container's last-modified time.</returns>
-        const utility::datetime& last_modified() const
+        /// <returns>The number of bytes.</returns>
+        utility::size64_t bytes_transferred() const
         {
-            return m_last_modified;
+            return m_bytes_transferred.load(std::memory_order_relaxed);
         }
 
         /// <summary>
-        /// Gets the container's lease status.
+        /// Calls the handler with the number of bytes transferred so far, regardless of the interval.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::lease_status" /> object that indicates the container's lease status.</returns>
-        wa::storage::lease_status lease_status() const
+        void report()
         {
-            return m_lease_status;
+            m_last_report.store(now(), std::memory_order_relaxed);
+            if (m_handler)
+            {
+                m_handler(bytes_transferred());
+            }
         }
 
         /// <summary>
-        /// Gets the container's lease state.
+        /// Adds bytes that the service has acknowledged, and calls the handler if the interval has passed since it was last called.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::lease_state" /> object that indicates the container's lease state.</returns>
-        wa::storage::lease_state lease_state() const
+        /// <param name="count">The number of bytes.</param>
+        /// <remarks>This is called by the library as each part of a transfer completes.</remarks>
+        void _add(utility::size64_t count)
         {
-            return m_lease_state;
-        }
+            auto total = m_bytes_transferred.fetch_add(count, std::memory_order_relaxed) + count;
+            if (!m_handler)
+            {
+                return;
+            }
 
-        /// <summary>
-        /// Gets the container's lease duration.
-        /// </summary>
-        /// <returns>A <see cref="wa::storage::lease_duration" /> object that indicates the container's lease duration.</returns>
-        wa::storage::lease_duration lease_duration() const
-        {
-            return m_lease_duration;
+            // Of the threads that find the interval passed, only the one that moves the time of the last report forward calls the handler
+            auto current_time = now();
+            auto last_report = m_last_report.load(std::memory_order_relaxed);
+            if ((current_time - last_report >= m_interval) && m_last_report.compare_exchange_strong(last_report, current_time, std::memory_order_relaxed))
+            {
+                m_handler(total);
+            }
         }
 
     private:
 
-        utility::string_t m_etag;
-        utility::datetime m_last_modified;
-        wa::storage::lease_status m_lease_status;
-        wa::storage::lease_state m_lease_state;
-        wa::storage::lease_duration m_lease_duration;
-
-        void update_etag_and_last_modified(const cloud_blob_container_properties& parsed_properties);
+        static std::chrono::milliseconds::rep now()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
 
-        friend class cloud_blob_container;
-        friend class protocol::blob_response_parsers;
-        friend class protocol::list_containers_reader;
+        handler_type m_handler;
+        const std::chrono::milliseconds::rep m_interval;
+        std::atomic<utility::size64_t> m_bytes_transferred;
+        std::atomic<std::chrono::milliseconds::rep> m_last_report;
     };
 
     /// <summary>
-    /// Provides a client-side logical representation of the Windows Azure Blob Service. This client is used to configure and execute requests against the Blob Service.
+    /// Represents a set of timeout and retry policy options that may be specified on a request against the Blob service.
     /// </summary>
-    /// <remarks>The service client encapsulates the base URI for the Blob service. If the service client will be used for authenticated access, it also encapsulates the credentials for accessing the storage account.</remarks>
-    class cloud_blob_client : public cloud_client
+    class blob_request_options : public request_options
     {
     public:
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_request_options" /> class.
         /// </summary>
-        cloud_blob_client()
+        blob_request_options()
+            : request_options(),
+            m_use_transactional_md5(false),
+            m_use_transactional_crc64(false),
+            m_store_blob_content_md5(false),
+            m_disable_content_md5_validation(false),
+            m_single_blob_upload_threshold(protocol::default_single_blob_upload_threshold),
+            m_stream_read_size(protocol::max_block_size),
+            m_stream_write_size(protocol::max_block_size),
+            m_initial_stream_write_size(0),
+            m_parallelism_factor(1),
+            m_stream_prefetch_depth(0),
+            m_stream_range_cache_size(0),
+            m_skip_zero_pages(false),
+            m_adaptive_upload(false),
+            m_create_container_if_not_found(false),
+            m_update_attributes_on_range_read(true),
+            m_stream_block_retries(protocol::default_stream_block_retries),
+            m_stream_max_failed_blocks(protocol::default_stream_max_failed_blocks)
         {
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class using the specified Blob service endpoint
-        /// and anonymous credentials.
+        /// Applies the default set of request options.
         /// </summary>
-        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Blob service endpoint for all locations.</param>
-        cloud_blob_client(const storage_uri& base_uri)
-            : cloud_client(base_uri)
+        /// <param name="other">A reference to a set of <see cref="blob_request_options" />.</param>
+        /// <param name="type">The blob type, specified by <see cref="blob_type" />.</param>
+        /// <param name="apply_expiry">Specifies that an expiry time be applied to the
+        /// request options. This parameter is used internally.</param>
+        void apply_defaults(const blob_request_options& other, blob_type type, bool apply_expiry = true)
         {
-            initialize();
+            request_options::apply_defaults(other, apply_expiry);
+
+            // To match the server's Put Blob API behavior, all block blob uploads
+            // should automatically set the blob's Content-MD5 property.
+            if (type == blob_type::block_blob)
+            {
+                m_store_blob_content_md5.merge(other.m_store_blob_content_md5, true);
+            }
+            else
+            {
+                m_store_blob_content_md5.merge(other.m_store_blob_content_md5);
+            }
+
+            m_use_transactional_md5.merge(other.m_use_transactional_md5);
+            m_use_transactional_crc64.merge(other.m_use_transactional_crc64);
+            m_disable_content_md5_validation.merge(other.m_disable_content_md5_validation);
+            m_parallelism_factor.merge(other.m_parallelism_factor);
+            m_single_blob_upload_threshold.merge(other.m_single_blob_upload_threshold);
+            m_stream_write_size.merge(other.m_stream_write_size);
+            m_initial_stream_write_size.merge(other.m_initial_stream_write_size);
+            m_stream_read_size.merge(other.m_stream_read_size);
+            m_stream_prefetch_depth.merge(other.m_stream_prefetch_depth);
+            m_stream_range_cache_size.merge(other.m_stream_range_cache_size);
+            m_skip_zero_pages.merge(other.m_skip_zero_pages);
+            m_adaptive_upload.merge(other.m_adaptive_upload);
+            m_create_container_if_not_found.merge(other.m_create_container_if_not_found);
+            m_update_attributes_on_range_read.merge(other.m_update_attributes_on_range_read);
+            m_stream_block_retries.merge(other.m_stream_block_retries);
+            m_stream_max_failed_blocks.merge(other.m_stream_max_failed_blocks);
+
+            if (!m_block_buffer_pool)
+            {
+                m_block_buffer_pool = other.m_block_buffer_pool;
+            }
+
+            if (!m_memory_budget)
+            {
+                m_memory_budget = other.m_memory_budget;
+            }
+
+            if (!m_upload_tuner)
+            {
+                m_upload_tuner = other.m_upload_tuner;
+            }
+
+            if (!m_transfer_progress)
+            {
+                m_transfer_progress = other.m_transfer_progress;
+            }
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class using the specified Blob service endpoint
-        /// and account credentials.
+        /// Gets a value indicating whether the content-MD5 hash will be calculated and validated for the request.
         /// </summary>
-        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Blob service endpoint for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_blob_client(const storage_uri& base_uri, const storage_credentials& credentials)
-            : cloud_client(base_uri, credentials)
+        /// <returns><c>true</c> if the content-MD5 hash will be calculated and validated for the request; otherwise, <c>false</c>.</returns>
+        bool use_transactional_md5() const
         {
-            initialize();
+            return m_use_transactional_md5;
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class using the specified Blob service endpoint
-        /// and account credentials.
+        /// Indicates whether to calculate and validate the content-MD5 hash for the request.
         /// </summary>
-        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Blob service endpoint for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        /// <param name="default_request_options">The default <see cref="blob_request_options" /> object to use for all requests made with this client object.</param>
-        cloud_blob_client(const storage_uri& base_uri, const storage_credentials& credentials, const blob_request_options& default_request_options)
-            : cloud_client(base_uri, credentials), m_default_request_options(default_request_options)
+        /// <param name="value"><c>true</c> to calculate and validate the content-MD5 hash for the request; otherwise, <c>false</c>.</param>
+        void set_use_transactional_md5(bool value)
         {
-            initialize();
+            m_use_transactional_md5 = value;
         }
 
         /// <summary>
-        /// Sets the authentication scheme to use to sign HTTP requests.
+        /// Gets a value indicating whether the content-CRC64 checksum will be calculated and validated for the request.
         /// </summary>
-        /// <param name="value">The authentication scheme.</param>
-        WASTORAGE_API void set_authentication_scheme(wa::storage::authentication_scheme value) override;
+        /// <returns><c>true</c> if the content-CRC64 checksum will be calculated and validated for the request; otherwise, <c>false</c>.</returns>
+        /// <remarks>CRC64 is much cheaper to calculate than MD5, but it is only checked by service versions that support it.</remarks>
+        bool use_transactional_crc64() const
+        {
+            return m_use_transactional_crc64;
+        }
 
         /// <summary>
-        /// Returns a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// Indicates whether to calculate and validate the content-CRC64 checksum for the request.
         /// </summary>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="container_result_segment" /> containing a collection of containers.</returns>
-        container_result_segment list_containers_segmented(const blob_continuation_token& current_token) const
+        /// <param name="value"><c>true</c> to calculate and validate the content-CRC64 checksum for the request; otherwise, <c>false</c>.</param>
+        void set_use_transactional_crc64(bool value)
         {
-            return list_containers_segmented_async(current_token).get();
+            m_use_transactional_crc64 = value;
         }
 
         /// <summary>
-        /// Returns a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// Gets a value indicating whether the content-MD5 hash will be calculated and stored when uploading a blob.
         /// </summary>
-        /// <param name="prefix">The container name prefix.</param>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="container_result_segment" /> containing a collection of containers.</returns>
-        container_result_segment list_containers_segmented(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        /// <returns><c>true</c> to calculate and store the content-MD5 hash when uploading a blob; otherwise, <c>false</c>.</returns>
+        bool store_blob_content_md5() const
         {
-            return list_containers_segmented_async(prefix, current_token).get();
+            return m_store_blob_content_md5;
         }
 
         /// <summary>
-        /// Returns a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// Indicates whether to calculate and store the content-MD5 hash when uploading a blob.
         /// </summary>
-        /// <param name="prefix">The container name prefix.</param>
-        /// <param name="listing_details">A value that indicates whether to return container metadata with the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned 
-        /// in the result segment, up to the per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="container_result_segment" /> containing a collection of containers.</returns>
-        container_result_segment list_containers_segmented(const utility::string_t& prefix, const container_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        /// <param name="value"><c>true</c> to calculate and store the content-MD5 hash when uploading a blob; otherwise, <c>false</c>.</param>
+        void set_store_blob_content_md5(bool value)
         {
-            return list_containers_segmented_async(prefix, includes, max_results, current_token, options, context).get();
+            m_store_blob_content_md5 = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// Gets a value indicating whether content-MD5 validation will be disabled when downloading blobs.
         /// </summary>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="container_result_segment" /> that represents the current operation.</returns>
-        pplx::task<container_result_segment> list_containers_segmented_async(const blob_continuation_token& current_token) const
+        /// <returns><c>true</c> to disable content-MD5 validation; otherwise, <c>false</c>.</returns>
+        bool disable_content_md5_validation() const
         {
-            return list_containers_segmented_async(utility::string_t(), current_token);
+            return m_disable_content_md5_validation;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// Indicates whether to disable content-MD5 validation when downloading blobs.
         /// </summary>
-        /// <param name="prefix">The container name prefix.</param>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="container_result_segment" /> that represents the current operation.</returns>
-        pplx::task<container_result_segment> list_containers_segmented_async(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        /// <param name="value"><c>true</c> to disable content-MD5 validation; otherwise, <c>false</c>.</param>
+        void set_disable_content_md5_validation(bool value)
         {
-            return list_containers_segmented_async(prefix, container_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+            m_disable_content_md5_validation = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// Gets the maximum size of a blob in bytes that may be uploaded as a single blob.
         /// </summary>
-        /// <param name="prefix">The container name prefix.</param>
-        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned 
-        /// in the result segment, up to the per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="container_result_segment" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<container_result_segment> list_containers_segmented_async(const utility::string_t& prefix, const container_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+        /// <returns>The maximum size of a blob, in bytes, that may be uploaded as a single blob,
+        /// ranging from between 1 and 64 MB inclusive.</returns>
+        utility::size64_t single_blob_upload_threshold_in_bytes() const
+        {
+            return m_single_blob_upload_threshold;
+        }
 
         /// <summary>
-        /// Returns a result segment containing a collection of blob items
-        /// in the container.
+        /// Sets the maximum size of a blob in bytes that may be uploaded as a single blob.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement 
-        /// <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
-        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        /// <param name="value">The maximum size of a blob, in bytes, that may be uploaded as a single blob,
+        /// ranging from between 1 and 64 MB inclusive.</param>
+        void set_single_blob_upload_threshold_in_bytes(utility::size64_t value)
         {
-            return list_blobs_segmented_async(prefix, current_token).get();
+            m_single_blob_upload_threshold = value;
         }
 
         /// <summary>
-        /// Returns a result segment containing a collection of blob items
-        /// in the container.
+        /// Gets the number of blocks or pages that may be simultaneously uploaded when uploading a blob that is greater than
+        /// the value specified by the <see cref="single_blob_upload_threshold_in_bytes" /> property in size.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
-        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
-        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>         
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
-        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        /// <returns>The number of parallel block or page upload operations that may proceed.</returns>
+        /// <remarks>When greater than 1, downloads to a seekable stream are also split into ranges of
+        /// <see cref="stream_read_size_in_bytes" /> bytes, and up to this many ranges are downloaded at the same time.
+        /// The MD5 of the whole blob is not validated then, but each range is validated if <see cref="use_transactional_md5" /> is set.</remarks>
+        int parallelism_factor() const
         {
-            return list_blobs_segmented_async(prefix, use_flat_blob_listing, includes, max_results, current_token, options, context).get();
+            return m_parallelism_factor;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items in the container.
+        /// Sets the number of blocks or pages that may be simultaneously uploaded when uploading a blob that is greater than
+        /// the value specified by the <see cref="single_blob_upload_threshold_in_bytes" /> property in size.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
-        pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        /// <param name="value">The number of parallel block or page upload operations that may proceed.</param>
+        void set_parallelism_factor(int value)
         {
-            return list_blobs_segmented_async(prefix, false, blob_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+            m_parallelism_factor = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items in the container.
+        /// Gets the minimum number of bytes to buffer when reading from a blob stream.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
-        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
-        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>         
-        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+        /// <returns>The minimum number of bytes to buffer, being at least 16KB.</returns>
+        size_t stream_read_size_in_bytes() const
+        {
+            return m_stream_read_size;
+        }
 
         /// <summary>
-        /// Gets the service properties for the service client.
+        /// Sets the minimum number of bytes to buffer when reading from a blob stream.
         /// </summary>
-        /// <returns>The <see cref="service_properties" /> for the service client.</returns>
-        service_properties download_service_properties() const
+        /// <param name="value">The minimum number of bytes to buffer, being at least 16KB.</param>
+        void set_stream_read_size_in_bytes(size_t value)
         {
-            return download_service_properties_async().get();
+            m_stream_read_size = value;
         }
 
         /// <summary>
-        /// Gets the service properties for the service client.
+        /// Gets the number of upcoming ranges that are downloaded ahead of the reader when reading from a blob stream.
         /// </summary>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The <see cref="service_properties" /> for the service client.</returns>
-        service_properties download_service_properties(const blob_request_options& options, operation_context context) const
+        /// <returns>The number of ranges to prefetch, or 0 to download each range only when it is needed.</returns>
+        int stream_prefetch_depth() const
         {
-            return download_service_properties_async(options, context).get();
+            return m_stream_prefetch_depth;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get the properties of the service.
+        /// Sets the number of upcoming ranges that are downloaded ahead of the reader when reading from a blob stream.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="service_properties" /> that represents the current operation.</returns>
-        pplx::task<service_properties> download_service_properties_async() const
+        /// <param name="value">The number of ranges to prefetch, or 0 to download each range only when it is needed.</param>
+        /// <remarks>Each prefetched range is <see cref="stream_read_size_in_bytes" /> bytes long and is buffered in memory
+        /// until it is read. Seeking outside of the prefetched ranges discards them.</remarks>
+        void set_stream_prefetch_depth(int value)
         {
-            return download_service_properties_async(blob_request_options(), operation_context());
+            m_stream_prefetch_depth = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get the properties of the service.
+        /// Gets the number of bytes of downloaded ranges that a blob stream keeps after the reader has left them.
         /// </summary>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="service_properties" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<service_properties> download_service_properties_async(const blob_request_options& options, operation_context context) const;
+        /// <returns>The size of the range cache, in bytes, or 0 to keep no ranges.</returns>
+        size_t stream_range_cache_size_in_bytes() const
+        {
+            return m_stream_range_cache_size;
+        }
 
         /// <summary>
-        /// Sets the service properties for the service client.
+        /// Sets the number of bytes of downloaded ranges that a blob stream keeps after the reader has left them.
         /// </summary>
-        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
-        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
-        void upload_service_properties(const service_properties& properties, const service_properties_includes& includes) const
+        /// <param name="value">The size of the range cache, in bytes, or 0 to keep no ranges.</param>
+        /// <remarks>With a range cache, ranges are aligned to multiples of <see cref="stream_read_size_in_bytes" />, and
+        /// seeking back to a range that is still cached reads it from memory, dropping the least recently used ranges once
+        /// the cache is full. Ranges are only prefetched once the reader has read two ranges in a row without seeking. The
+        /// cached ranges do not count against the memory budget.</remarks>
+        void set_stream_range_cache_size_in_bytes(size_t value)
         {
-            upload_service_properties_async(properties, includes).wait();
+            m_stream_range_cache_size = value;
         }
 
         /// <summary>
-        /// Sets the service properties for the service client.
+        /// Gets a value indicating whether pages that only contain zeros are left out when writing to a page blob.
         /// </summary>
-        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
-        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_service_properties(const service_properties& properties, const service_properties_includes& includes, const blob_request_options& options, operation_context context) const
+        /// <returns><c>true</c> to leave out the pages that only contain zeros; otherwise, <c>false</c>.</returns>
+        bool skip_zero_pages() const
         {
-            upload_service_properties_async(properties, includes, options, context).wait();
+            return m_skip_zero_pages;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set the service properties for the service client.
+        /// Indicates whether to leave out the pages that only contain zeros when writing to a page blob.
         /// </summary>
-        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
-        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_service_properties_async(const service_properties& properties, const service_properties_includes& includes) const
+        /// <param name="value"><c>true</c> to leave out the pages that only contain zeros; otherwise, <c>false</c>.</param>
+        /// <remarks>Only the runs of pages with data in them are uploaded, which makes uploading sparse content such as virtual disk
+        /// images much faster. The runs of zero pages are not sent at all to a blob that the upload has just created, 
+        /// and are cleared in an existing blob, each with a single request.</remarks>
+        void set_skip_zero_pages(bool value)
         {
-            return upload_service_properties_async(properties, includes, blob_request_options(), operation_context());
+            m_skip_zero_pages = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set the service properties for the service client.
+        /// Gets a value indicating whether downloading a range of a blob updates the properties, metadata and copy state of the blob.
         /// </summary>
-        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
-        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_service_properties_async(const service_properties& properties, const service_properties_includes& includes, const blob_request_options& options, operation_context context) const;
+        /// <returns><c>true</c> to update the attributes of the blob from each range; otherwise, <c>false</c>.</returns>
+        bool update_attributes_on_range_read() const
+        {
+            return m_update_attributes_on_range_read;
+        }
 
         /// <summary>
-        /// Returns a reference to a <see cref="wa::storage::cloud_blob_container" /> object.
+        /// Indicates whether downloading a range of a blob updates the properties, metadata and copy state of the blob.
         /// </summary>
-        /// <returns>A reference to the root container, of type <see cref="cloud_blob_container" />.</returns>
-        WASTORAGE_API cloud_blob_container get_root_container_reference() const;
+        /// <param name="value"><c>true</c> to update the attributes of the blob from each range; otherwise, <c>false</c>.</param>
+        /// <remarks>Without the update, only the ETag of the blob is taken from the response, and its other headers are not parsed.
+        /// This suits reads of many ranges of a blob whose attributes have been downloaded already, and is what the stream
+        /// returned by <c>open_read</c> does.</remarks>
+        void set_update_attributes_on_range_read(bool value)
+        {
+            m_update_attributes_on_range_read = value;
+        }
 
         /// <summary>
-        /// Returns a reference to a <see cref="wa::storage::cloud_blob_container" /> object with the specified name.
+        /// Gets the number of times a block is sent again after its upload from a blob stream has failed.
         /// </summary>
-        /// <param name="container_name">The name of the container, or an absolute URI to the container.</param>
-        /// <returns>A reference to a <see cref="cloud_blob_container" />.</returns>
-        WASTORAGE_API cloud_blob_container get_container_reference(const utility::string_t& container_name) const;
+        /// <returns>The number of times a failed block is sent again.</returns>
+        int stream_block_retries() const
+        {
+            return m_stream_block_retries;
+        }
 
         /// <summary>
-        /// Returns the default set of request options.
+        /// Sets the number of times a block is sent again after its upload from a blob stream has failed.
         /// </summary>
-        /// <returns>A <see cref="blob_request_options" /> object.</returns>
-        const blob_request_options& default_request_options() const
+        /// <param name="value">The number of times a failed block is sent again, or 0 to fail the stream with the first failed block.</param>
+        /// <remarks>A block is sent again once the retry policy has given up on it, after a delay that doubles with each attempt,
+        /// while the other blocks of the stream keep being uploaded. Its buffer is kept until it has been uploaded. A block is
+        /// only sent again if it failed because of a timeout, a server error or the network.</remarks>
+        void set_stream_block_retries(int value)
         {
-            return m_default_request_options;
+            m_stream_block_retries = value;
         }
-        
+
         /// <summary>
-        /// Gets the default delimiter that may be used to create a virtual directory structure of blobs.
+        /// Gets the number of blocks that may fail during an upload from a blob stream before the stream gives up.
         /// </summary>
-        /// <returns>A string containing the default delimiter.</returns>
-        const utility::string_t& directory_delimiter() const
+        /// <returns>The number of blocks that may fail.</returns>
+        int stream_max_failed_blocks() const
         {
-            return m_delimiter;
+            return m_stream_max_failed_blocks;
         }
 
         /// <summary>
-        /// Sets the default delimiter that may be used to create a virtual directory structure of blobs.
+        /// Sets the number of blocks that may fail during an upload from a blob stream before the stream gives up.
         /// </summary>
-        /// <param name="value">A string containing the default delimiter.</param>
-        void set_directory_delimiter(const utility::string_t& value)
+        /// <param name="value">The number of blocks that may fail and be sent again.</param>
+        /// <remarks>Once more blocks than this have failed, the next failed block is not sent again, and the stream fails.</remarks>
+        void set_stream_max_failed_blocks(int value)
         {
-            if (value.empty())
-            {
-                throw std::invalid_argument("value");
-            }
-
-            m_delimiter = value;
+            m_stream_max_failed_blocks = value;
         }
 
-    private:
-
-        void initialize()
+        /// <summary>
+        /// Gets the counter that the bytes of uploads and downloads are added to as their blocks, pages and ranges complete.
+        /// </summary>
+        /// <returns>The progress counter, or <c>nullptr</c> if progress is not reported.</returns>
+        const std::shared_ptr<wa::storage::transfer_progress>& transfer_progress() const
         {
-            set_authentication_scheme(authentication_scheme::shared_key);
-            m_delimiter = protocol::directory_delimiter;
+            return m_transfer_progress;
         }
 
-        blob_request_options m_default_request_options;
-        utility::string_t m_delimiter;
-    };
-
-    /// <summary>
-    /// Represents a container in the Windows Azure Blob service.
-    /// </summary>
-    class cloud_blob_container
-    {
-    public:
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// Sets the counter that the bytes of uploads and downloads are added to as their blocks, pages and ranges complete.
         /// </summary>
-        cloud_blob_container() {}
+        /// <param name="value">The progress counter, which may be shared by any number of transfers.</param>
+        void set_transfer_progress(std::shared_ptr<wa::storage::transfer_progress> value)
+        {
+            m_transfer_progress = value;
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// Gets the block size for writing to a block blob.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the container for all locations.</param>
-        WASTORAGE_API cloud_blob_container(const storage_uri& uri);
+        /// <returns>The size of a block, in bytes, ranging from between 16 KB and 4 MB inclusive.</returns>
+        size_t stream_write_size_in_bytes() const
+        {
+            return m_stream_write_size;
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// Sets the block size for writing to a block blob.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the container for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        WASTORAGE_API cloud_blob_container(const storage_uri& uri, const storage_credentials& credentials);
+        /// <param name="value">The size of a block, in bytes, ranging from between 16 KB and 4 MB inclusive.</param>
+        void set_stream_write_size_in_bytes(size_t value)
+        {
+            m_stream_write_size = value;
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// Gets the size of the first block that a write stream of a block blob uploads.
         /// </summary>
-        /// <param name="name">The name of the container.</param>
-        /// <param name="client">The Blob service client.</param>
-        cloud_blob_container(const utility::string_t& name, const cloud_blob_client& client);
+        /// <returns>The size of the first block, in bytes, or 0 if every block has the size of <see cref="stream_write_size_in_bytes" />.</returns>
+        size_t initial_stream_write_size_in_bytes() const
+        {
+            return m_initial_stream_write_size;
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// Sets the size of the first block that a write stream of a block blob uploads.
         /// </summary>
-        /// <param name="name">The container name.</param>
-        /// <param name="client">The Blob service client.</param>
-        /// <param name="properties">The properties for the container.</param>
-        /// <param name="metadata">The metadata for the container.</param>
-        cloud_blob_container(utility::string_t name, const cloud_blob_client& client, cloud_blob_container_properties properties, cloud_metadata metadata);
+        /// <param name="value">The size of the first block, in bytes, or 0 to give every block the size of <see cref="stream_write_size_in_bytes" />.</param>
+        /// <remarks>Each block after the first is as large as everything written before it, so the block size doubles as the stream grows
+        /// until it reaches <see cref="stream_write_size_in_bytes" />. Short streams then take little memory and their first block is sent early,
+        /// while long streams take about as many requests as with fixed blocks.</remarks>
+        void set_initial_stream_write_size_in_bytes(size_t value)
+        {
+            m_initial_stream_write_size = value;
+        }
 
         /// <summary>
-        /// Returns a shared access signature for the container.
+        /// Gets a value indicating whether block blob uploads are tuned to the throughput observed for the storage endpoint.
         /// </summary>
-        /// <param name="policy">The access policy for the shared access signature.</param>
-        /// <returns>A string containing a shared access signature.</returns>
-        utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy) const
+        /// <returns><c>true</c> if block blob uploads are tuned to the observed throughput; otherwise, <c>false</c>.</returns>
+        bool adaptive_upload() const
         {
-            return get_shared_access_signature(policy, utility::string_t());
+            return m_adaptive_upload;
         }
 
         /// <summary>
-        /// Returns a shared access signature for the container.
+        /// Indicates whether to tune block blob uploads to the throughput observed for the storage endpoint.
         /// </summary>
-        /// <param name="policy">The access policy for the shared access signature.</param>
-        /// <param name="stored_policy_identifier">A container-level access policy.</param>
-        /// <returns>A string containing a shared access signature.</returns>
-        WASTORAGE_API utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier) const;
+        /// <param name="value"><c>true</c> to tune block blob uploads to the observed throughput; otherwise, <c>false</c>.</param>
+        /// <remarks>The latency and bandwidth of the requests sent to each endpoint are measured, and once enough of them have been seen,
+        /// an upload chooses between a single request and a block upload, the block size and the number of blocks in flight from them.
+        /// The <see cref="single_blob_upload_threshold_in_bytes" />, <see cref="stream_write_size_in_bytes" /> and
+        /// <see cref="parallelism_factor" /> properties are never exceeded.</remarks>
+        void set_adaptive_upload(bool value)
+        {
+            m_adaptive_upload = value;
+        }
 
         /// <summary>
-        /// Gets a reference to a blob in this container.
+        /// Gets a value indicating whether an upload creates the container of the blob if it turns out not to exist.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
-        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name) const;
+        /// <returns><c>true</c> if an upload creates a missing container; otherwise, <c>false</c>.</returns>
+        bool create_container_if_not_found() const
+        {
+            return m_create_container_if_not_found;
+        }
 
         /// <summary>
-        /// Gets a reference to a blob in this container.
+        /// Indicates whether an upload creates the container of the blob if it turns out not to exist.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
-        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+        /// <param name="value"><c>true</c> to create a missing container; otherwise, <c>false</c>.</param>
+        /// <remarks>The upload is sent as if the container existed. Only if it fails with ContainerNotFound is the container created,
+        /// with no public access, and the upload sent again, so writers need no round trip to create the container up front. Uploads
+        /// to the same container that fail at the same time wait for a single creation. This applies to the uploads of block and
+        /// page blobs from seekable streams, files, buffers and text; an upload from a stream that cannot seek is not sent again.</remarks>
+        void set_create_container_if_not_found(bool value)
+        {
+            m_create_container_if_not_found = value;
+        }
 
         /// <summary>
-        /// Gets a reference to a page blob in this container.
+        /// Gets the pool that block buffers of blob write streams are taken from.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
-        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name) const;
+        /// <returns>The block buffer pool, or <c>nullptr</c> if every block buffer is allocated separately.</returns>
+        /// <remarks>This is set internally by the service client that owns the pool.</remarks>
+        const std::shared_ptr<core::block_buffer_pool>& _block_buffer_pool() const
+        {
+            return m_block_buffer_pool;
+        }
 
         /// <summary>
-        /// Gets a reference to a page blob in this container.
+        /// Sets the pool that block buffers of blob write streams are taken from.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
-        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+        /// <param name="value">The block buffer pool.</param>
+        /// <remarks>This is used internally by the service client that owns the pool.</remarks>
+        void _set_block_buffer_pool(std::shared_ptr<core::block_buffer_pool> value)
+        {
+            m_block_buffer_pool = value;
+        }
 
         /// <summary>
-        /// Gets a reference to a block blob in this container.
+        /// Gets the memory budget that buffers of blob streams are reserved from.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
-        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name) const;
+        /// <returns>The memory budget, or <c>nullptr</c> if the memory of blob streams is not limited.</returns>
+        /// <remarks>This is set internally by the service client that owns the budget.</remarks>
+        const std::shared_ptr<core::memory_budget>& _memory_budget() const
+        {
+            return m_memory_budget;
+        }
 
         /// <summary>
-        /// Gets a reference to a block blob in this container.
+        /// Sets the memory budget that buffers of blob streams are reserved from.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
-        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+        /// <param name="value">The memory budget.</param>
+        /// <remarks>This is used internally by the service client that owns the budget.</remarks>
+        void _set_memory_budget(std::shared_ptr<core::memory_budget> value)
+        {
+            m_memory_budget = value;
+        }
 
         /// <summary>
-        /// Gets a reference to a virtual blob directory beneath this container.
+        /// Gets the throughput model that adaptive uploads are tuned with.
         /// </summary>
-        /// <param name="name">The name of the virtual blob directory.</param>
-        /// <returns>A reference to a <see cref="cloud_blob_directory" />.</returns>
-        WASTORAGE_API cloud_blob_directory get_directory_reference(const utility::string_t& name) const;
+        /// <returns>The upload tuner, or <c>nullptr</c> if uploads are not tuned.</returns>
+        /// <remarks>This is set internally by the service client that owns the tuner.</remarks>
+        const std::shared_ptr<core::upload_tuner>& _upload_tuner() const
+        {
+            return m_upload_tuner;
+        }
 
         /// <summary>
-        /// Retrieves the container's attributes.
+        /// Sets the throughput model that adaptive uploads are tuned with.
         /// </summary>
-        void download_attributes()
+        /// <param name="value">The upload tuner.</param>
+        /// <remarks>This is used internally by the service client that owns the tuner.</remarks>
+        void _set_upload_tuner(std::shared_ptr<core::upload_tuner> value)
         {
-            download_attributes_async().wait();
+            m_upload_tuner = value;
         }
 
+    private:
+
+        option_with_default<bool> m_use_transactional_md5;
+        option_with_default<bool> m_use_transactional_crc64;
+        option_with_default<bool> m_store_blob_content_md5;
+        option_with_default<bool> m_disable_content_md5_validation;
+        option_with_default<int> m_parallelism_factor;
+        option_with_default<utility::size64_t> m_single_blob_upload_threshold;
+        option_with_default<size_t> m_stream_write_size;
+        option_with_default<size_t> m_initial_stream_write_size;
+        option_with_default<size_t> m_stream_read_size;
+        option_with_default<int> m_stream_prefetch_depth;
+        option_with_default<size_t> m_stream_range_cache_size;
+        option_with_default<bool> m_skip_zero_pages;
+        option_with_default<bool> m_adaptive_upload;
+        option_with_default<bool> m_create_container_if_not_found;
+        option_with_default<bool> m_update_attributes_on_range_read;
+        option_with_default<int> m_stream_block_retries;
+        option_with_default<int> m_stream_max_failed_blocks;
+        std::shared_ptr<core::block_buffer_pool> m_block_buffer_pool;
+        std::shared_ptr<core::memory_budget> m_memory_budget;
+        std::shared_ptr<core::upload_tuner> m_upload_tuner;
+        std::shared_ptr<wa::storage::transfer_progress> m_transfer_progress;
+    };
+
+    /// <summary>
+    /// Represents a block in a block list.
+    /// </summary>
+    class block_list_item
+    {
+    public:
         /// <summary>
-        /// Retrieves the container's attributes.
+        /// Indicates which block lists should be searched to find a specified block. 
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void download_attributes(const access_condition& condition, const blob_request_options& options, operation_context context)
+        enum block_mode
         {
-            download_attributes_async(condition, options, context).wait();
-        }
+            /// <summary>
+            /// Search the committed block list only.
+            /// </summary>
+            committed,
+
+            /// <summary>
+            /// Search the uncommitted block list only.
+            /// </summary>
+            uncommitted,
+
+            /// <summary>
+            /// Search the uncommitted block list first, and if the block is not found there, search 
+            /// the committed block list.
+            /// </summary>
+            latest
+        };
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to retrieve the container's attributes.
+        /// Initializes a new instance of the <see cref="block_list_item"/> class.
+        /// </summary>
+        /// <param name="id">The block name.</param>
+        block_list_item(const utility::string_t& id)
+            : m_id(id), m_size(-1), m_mode(block_mode::latest)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="block_list_item"/> class.
+        /// </summary>
+        /// <param name="id">The block name.</param>
+        /// <param name="mode">A <see cref="block_mode" /> value that indicates which block lists to search for the block.</param>
+        block_list_item(const utility::string_t& id, block_mode mode)
+            : m_id(id), m_size(-1), m_mode(mode)
+        {
+        }
+
+        /// <summary>
+        /// Gets the name of the block.
+        /// </summary>
+        /// <returns>The block name.</returns>
+        const utility::string_t& id() const
+        {
+            return m_id;
+        }
+
+        /// <summary>
+        /// Gets the size of block in bytes.
+        /// </summary>
+        /// <returns>The block size.</returns>
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether the block has been committed.
+        /// </summary>
+        /// <returns>A <see cref="block_mode" /> value that indicates whether the block has been committed.</returns>
+        block_mode mode() const
+        {
+            return m_mode;
+        }
+
+    private:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="block_list_item"/> class.
+        /// </summary>
+        /// <param name="id">The block name.</param>
+        /// <param name="size">The size of the block.</param>
+        /// <param name="committed"><c>true</c> indicates that the block has been committed; 
+        /// <c>false</c> indicates that it is uncommitted.</param>
+        block_list_item(const utility::string_t& id, size_t size, bool committed)
+            : m_id(id), m_size(size), m_mode(committed ? block_mode::committed : block_mode::uncommitted)
+        {
+        }
+
+        utility::string_t m_id;
+        size_t m_size;
+        block_mode m_mode;
+
+        friend class protocol::block_list_reader;
+    };
+
+    /// <summary>
+    /// Records the progress of a resumable block blob upload, so that an upload interrupted by a process restart
+    /// can continue without sending the blocks that the service already has.
+    /// </summary>
+    /// <remarks>
+    /// The checkpoint is small enough to be saved after every block: it holds the block size, the prefix of the block IDs,
+    /// the numbers of the blocks that have been uploaded and the intermediate state of the blob MD5.
+    /// </remarks>
+    class block_blob_upload_checkpoint
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="block_blob_upload_checkpoint"/> class for a new upload with blocks of the maximum size.
+        /// </summary>
+        WASTORAGE_API block_blob_upload_checkpoint();
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="block_blob_upload_checkpoint"/> class for a new upload.
+        /// </summary>
+        /// <param name="block_size">The size of each block in bytes, up to 4MB.</param>
+        WASTORAGE_API explicit block_blob_upload_checkpoint(size_t block_size);
+
+        /// <summary>
+        /// Reads a checkpoint from the text returned by <see cref="block_blob_upload_checkpoint::to_string" />.
+        /// </summary>
+        /// <param name="value">The saved checkpoint.</param>
+        /// <returns>The checkpoint.</returns>
+        WASTORAGE_API static block_blob_upload_checkpoint parse(const utility::string_t& value);
+
+        /// <summary>
+        /// Returns the checkpoint as text that can be saved and read back with <see cref="block_blob_upload_checkpoint::parse" />.
+        /// </summary>
+        /// <returns>The checkpoint as text.</returns>
+        WASTORAGE_API utility::string_t to_string() const;
+
+        /// <summary>
+        /// Gets the size of each block in bytes.
+        /// </summary>
+        /// <returns>The block size.</returns>
+        size_t block_size() const
+        {
+            return m_block_size;
+        }
+
+        /// <summary>
+        /// Gets the base64 prefix that the IDs of all blocks of the upload start with.
+        /// </summary>
+        /// <returns>The block ID prefix.</returns>
+        const utility::string_t& block_id_prefix() const
+        {
+            return m_block_id_prefix;
+        }
+
+        /// <summary>
+        /// Gets the number of bytes being uploaded, which is only known once the upload has been started.
+        /// </summary>
+        /// <returns>The length of the upload, or <see cref="protocol::invalid_size64_t" /> if it has not been started.</returns>
+        utility::size64_t length() const
+        {
+            return m_length;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether the block with the given number has been uploaded.
+        /// </summary>
+        /// <param name="index">The number of the block.</param>
+        /// <returns><c>true</c> if the block has been uploaded; otherwise, <c>false</c>.</returns>
+        bool is_block_completed(size_t index) const
+        {
+            return (index < m_completed_blocks.size()) && m_completed_blocks[index];
+        }
+
+        /// <summary>
+        /// Gets the number of blocks that have been uploaded.
+        /// </summary>
+        /// <returns>The number of uploaded blocks.</returns>
+        WASTORAGE_API size_t completed_block_count() const;
+
+    private:
+
+        size_t m_block_size;
+        utility::string_t m_block_id_prefix;
+        utility::size64_t m_length;
+        std::vector<bool> m_completed_blocks;
+
+        // The blob MD5 covers the first m_hashed_blocks blocks
+        size_t m_hashed_blocks;
+        std::vector<uint8_t> m_md5_state;
+
+        friend class cloud_block_blob;
+    };
+
+    /// <summary>
+    /// Represents a range of pages in a page blob.
+    /// </summary>
+    class page_range
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::page_range" /> class.
+        /// </summary>
+        /// <param name="start">The starting offset.</param>
+        /// <param name="end">The ending offset.</param>
+        page_range(int64_t start, int64_t end)
+            : m_start_offset(start), m_end_offset(end)
+        {
+        }
+
+        /// <summary>
+        /// Returns the content of the page range as a string.
+        /// </summary>
+        /// <returns>The content of the page range.</returns>
+        utility::string_t to_string() const
+        {
+            utility::ostringstream_t value;
+            value << protocol::header_value_range_prefix << m_start_offset << U('-') << m_end_offset;
+            return value.str();
+        }
+
+        /// <summary>
+        /// Gets the starting offset of the page range.
+        /// </summary>
+        /// <returns>The starting offset.</returns>
+        int64_t start_offset() const
+        {
+            return m_start_offset;
+        }
+
+        /// <summary>
+        /// Gets the ending offset of the page range.
+        /// </summary>
+        /// <returns>The ending offset.</returns>
+        int64_t end_offset() const
+        {
+            return m_end_offset;
+        }
+
+    private:
+
+        int64_t m_start_offset;
+        int64_t m_end_offset;
+    };
+
+    /// <summary>
+    /// Represents a range of pages that differs between two snapshots of a page blob.
+    /// </summary>
+    class page_diff_range : public page_range
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::page_diff_range" /> class.
+        /// </summary>
+        /// <param name="start">The starting offset.</param>
+        /// <param name="end">The ending offset.</param>
+        /// <param name="is_cleared"><c>true</c> if the pages were cleared; <c>false</c> if they were written.</param>
+        page_diff_range(int64_t start, int64_t end, bool is_cleared)
+            : page_range(start, end), m_is_cleared(is_cleared)
+        {
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether the pages in the range were cleared, rather than written, since the earlier snapshot.
+        /// </summary>
+        /// <returns><c>true</c> if the pages were cleared and only contain zeros now; <c>false</c> if they were written.</returns>
+        bool is_cleared() const
+        {
+            return m_is_cleared;
+        }
+
+    private:
+
+        bool m_is_cleared;
+    };
+
+    /// <summary>
+    /// Describes actions that can be performed on a page blob sequence number.
+    /// </summary>
+    class sequence_number
+    {
+    public:
+        enum class sequence_number_action
+        {
+            /// <summary>
+            /// Sets the sequence number to be the higher of two values: the value included on the request, or the value 
+            /// currently stored for the blob.
+            /// </summary>
+            maximum,
+
+            /// <summary>
+            /// Sets the sequence number to the value included with the request.
+            /// </summary>
+            update,
+
+            /// <summary>
+            /// Increments the value of the sequence number by 1.
+            /// </summary>
+            increment
+        };
+
+        /// <summary>
+        /// Constructs a sequence number action to set the higher of two values: the value included on the request, 
+        /// or the value currently stored for the blob.
+        /// </summary>
+        /// <param name="value">The sequence number.</param>
+        /// <returns>A <see cref="wa::storage::sequence_number" /> object that represents the action.</returns>
+        static sequence_number maximum(int64_t value)
+        {
+            return sequence_number(sequence_number_action::maximum, value);
+        }
+
+        /// <summary>
+        /// Constructs a sequence number action to set the sequence number to the value included with the request.
+        /// </summary>
+        /// <param name="value">The sequence number.</param>
+        /// <returns>A <see cref="wa::storage::sequence_number" /> object that represents the action.</returns>
+        static sequence_number update(int64_t value)
+        {
+            return sequence_number(sequence_number_action::update, value);
+        }
+
+        /// <summary>
+        /// Constructs a sequence number action to increment the value of the sequence number by 1.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::sequence_number" /> object that represents the action.</returns>
+        static sequence_number increment()
+        {
+            return sequence_number(sequence_number_action::increment, -1);
+        }
+
+        /// <summary>
+        /// Gets the action that will be performed on a page blob sequence number.
+        /// </summary>
+        /// <returns>The sequence number action.</returns>
+        sequence_number_action action() const
+        {
+            return m_action;
+        }
+
+        /// <summary>
+        /// Gets the page blob's sequence number.
+        /// </summary>
+        /// <returns>The sequence number.</returns>
+        int64_t value() const
+        {
+            return m_value;
+        }
+
+    private:
+
+        sequence_number(sequence_number_action action, int64_t value)
+        {
+            m_action = action;
+            m_value = value;
+        }
+
+        sequence_number_action m_action;
+        int64_t m_value;
+    };
+
+    /// <summary>
+    /// Represents the system properties for a container.
+    /// </summary>
+    class cloud_blob_container_properties
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="cloud_blob_container_properties"/> class.
+        /// </summary>
+        cloud_blob_container_properties() {}
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="cloud_blob_container_properties"/> class.
+        /// </summary>
+        /// <param name="other">A reference to a <see cref="cloud_blob_container_properties" /> object.</param>
+        cloud_blob_container_properties(cloud_blob_container_properties&& other)
+        {
+            *this = std::move(other);
+        }
+
+        /// <summary>
+        /// Returns a reference to a <see cref="cloud_blob_container_properties" /> object.
+        /// </summary>
+        /// <param name="other">A reference to a set of <see cref="cloud_blob_container_properties" /> to use to set properties.</param>
+        /// <returns>A <see cref="cloud_blob_container_properties" /> object with properties set.</returns>
+        cloud_blob_container_properties& operator=(cloud_blob_container_properties&& other)
+        {
+            m_etag = std::move(other.m_etag);
+            m_last_modified = std::move(other.m_last_modified);
+            m_lease_duration = std::move(other.m_lease_duration);
+            m_lease_state = std::move(other.m_lease_state);
+            m_lease_status = std::move(other.m_lease_status);
+            return *this;
+        }
+
+        /// <summary>
+        /// Gets the ETag value for the container.
+        /// </summary>
+        /// <returns>The container's quoted ETag value.</returns>
+        const utility::string_t& etag() const
+        {
+            return m_etag;
+        }
+
+        /// <summary>
+        /// Gets the container's last-modified time.
+        /// </summary>
+        /// <returns>The container's last-modified time.</returns>
+        const utility::datetime& last_modified() const
+        {
+            return m_last_modified;
+        }
+
+        /// <summary>
+        /// Gets the container's lease status.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::lease_status" /> object that indicates the container's lease status.</returns>
+        wa::storage::lease_status lease_status() const
+        {
+            return m_lease_status;
+        }
+
+        /// <summary>
+        /// Gets the container's lease state.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::lease_state" /> object that indicates the container's lease state.</returns>
+        wa::storage::lease_state lease_state() const
+        {
+            return m_lease_state;
+        }
+
+        /// <summary>
+        /// Gets the container's lease duration.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::lease_duration" /> object that indicates the container's lease duration.</returns>
+        wa::storage::lease_duration lease_duration() const
+        {
+            return m_lease_duration;
+        }
+
+    private:
+
+        utility::string_t m_etag;
+        utility::datetime m_last_modified;
+        wa::storage::lease_status m_lease_status;
+        wa::storage::lease_state m_lease_state;
+        wa::storage::lease_duration m_lease_duration;
+
+        void update_etag_and_last_modified(const cloud_blob_container_properties& parsed_properties);
+
+        friend class cloud_blob_container;
+        friend class protocol::blob_response_parsers;
+        friend class protocol::list_containers_reader;
+    };
+
+    /// <summary>
+    /// Represents the settings of the cache of blob properties and metadata kept by a blob service client.
+    /// </summary>
+    class blob_attribute_cache_settings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::blob_attribute_cache_settings" /> class, which disables the cache.
+        /// </summary>
+        blob_attribute_cache_settings()
+            : m_max_blobs(0), m_time_to_live(protocol::default_attribute_cache_time_to_live)
+        {
+        }
+
+        /// <summary>
+        /// Gets the maximum number of blobs whose attributes are cached. The least recently used blobs are removed first.
+        /// </summary>
+        /// <returns>The maximum number of blobs, or 0 if the cache is disabled.</returns>
+        size_t max_blobs() const
+        {
+            return m_max_blobs;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of blobs whose attributes are cached. The least recently used blobs are removed first.
+        /// </summary>
+        /// <param name="value">The maximum number of blobs, or 0 to disable the cache.</param>
+        void set_max_blobs(size_t value)
+        {
+            m_max_blobs = value;
+        }
+
+        /// <summary>
+        /// Gets the amount of time cached attributes are used without reading them from the service again.
+        /// </summary>
+        /// <returns>The time to live.</returns>
+        const std::chrono::seconds& time_to_live() const
+        {
+            return m_time_to_live;
+        }
+
+        /// <summary>
+        /// Sets the amount of time cached attributes are used without reading them from the service again.
+        /// </summary>
+        /// <param name="value">The time to live.</param>
+        void set_time_to_live(const std::chrono::seconds& value)
+        {
+            m_time_to_live = value;
+        }
+
+    private:
+
+        size_t m_max_blobs;
+        std::chrono::seconds m_time_to_live;
+    };
+
+    /// <summary>
+    /// Represents the settings of the cache of hierarchical blob listings kept by a blob service client.
+    /// </summary>
+    class blob_listing_cache_settings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::blob_listing_cache_settings" /> class, which disables the cache.
+        /// </summary>
+        blob_listing_cache_settings()
+            : m_max_listings(0), m_time_to_live(protocol::default_listing_cache_time_to_live), m_max_prefetched_directories(protocol::default_listing_cache_prefetched_directories)
+        {
+        }
+
+        /// <summary>
+        /// Gets the maximum number of listing segments that are cached. The least recently used segments are removed first.
+        /// </summary>
+        /// <returns>The maximum number of segments, or 0 if the cache is disabled.</returns>
+        size_t max_listings() const
+        {
+            return m_max_listings;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of listing segments that are cached. The least recently used segments are removed first.
+        /// </summary>
+        /// <param name="value">The maximum number of segments, or 0 to disable the cache.</param>
+        void set_max_listings(size_t value)
+        {
+            m_max_listings = value;
+        }
+
+        /// <summary>
+        /// Gets the amount of time a cached segment is returned without listing the directory again.
+        /// </summary>
+        /// <returns>The time to live.</returns>
+        const std::chrono::seconds& time_to_live() const
+        {
+            return m_time_to_live;
+        }
+
+        /// <summary>
+        /// Sets the amount of time a cached segment is returned without listing the directory again.
+        /// </summary>
+        /// <param name="value">The time to live.</param>
+        void set_time_to_live(const std::chrono::seconds& value)
+        {
+            m_time_to_live = value;
+        }
+
+        /// <summary>
+        /// Gets the number of child directories of a listed segment whose first segments are listed ahead of time.
+        /// </summary>
+        /// <returns>The number of child directories, or 0 if no directories are listed ahead of time.</returns>
+        size_t max_prefetched_directories() const
+        {
+            return m_max_prefetched_directories;
+        }
+
+        /// <summary>
+        /// Sets the number of child directories of a listed segment whose first segments are listed ahead of time.
+        /// </summary>
+        /// <param name="value">The number of child directories, or 0 to list no directories ahead of time.</param>
+        void set_max_prefetched_directories(size_t value)
+        {
+            m_max_prefetched_directories = value;
+        }
+
+    private:
+
+        size_t m_max_listings;
+        std::chrono::seconds m_time_to_live;
+        size_t m_max_prefetched_directories;
+    };
+
+    /// <summary>
+    /// Represents the settings of the cache of small blob contents kept by a blob service client.
+    /// </summary>
+    class blob_content_cache_settings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::blob_content_cache_settings" /> class, which disables the cache.
+        /// </summary>
+        blob_content_cache_settings()
+            : m_max_size_in_bytes(0), m_max_blob_size_in_bytes(protocol::default_content_cache_max_blob_size)
+        {
+        }
+
+        /// <summary>
+        /// Gets the maximum number of bytes of blob content that are kept in memory. The least recently used blobs are removed first.
+        /// </summary>
+        /// <returns>The maximum size of the cache, in bytes, or 0 if the cache is disabled.</returns>
+        utility::size64_t max_size_in_bytes() const
+        {
+            return m_max_size_in_bytes;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of bytes of blob content that are kept in memory. The least recently used blobs are removed first.
+        /// </summary>
+        /// <param name="value">The maximum size of the cache, in bytes, or 0 to disable the cache.</param>
+        void set_max_size_in_bytes(utility::size64_t value)
+        {
+            m_max_size_in_bytes = value;
+        }
+
+        /// <summary>
+        /// Gets the size of the largest blob whose content is cached.
+        /// </summary>
+        /// <returns>The maximum size of a cached blob, in bytes.</returns>
+        size_t max_blob_size_in_bytes() const
+        {
+            return m_max_blob_size_in_bytes;
+        }
+
+        /// <summary>
+        /// Sets the size of the largest blob whose content is cached.
+        /// </summary>
+        /// <param name="value">The maximum size of a cached blob, in bytes.</param>
+        /// <remarks>As much of every download as this size is requested at once, so that the content of a larger blob does not
+        /// have to be kept in memory; the rest of such a blob is downloaded by a second request.</remarks>
+        void set_max_blob_size_in_bytes(size_t value)
+        {
+            m_max_blob_size_in_bytes = value;
+        }
+
+        /// <summary>
+        /// Gets the local directory where cached contents are also written, so that they outlive the process.
+        /// </summary>
+        /// <returns>The path of the directory, or an empty string if contents are only kept in memory.</returns>
+        const utility::string_t& directory() const
+        {
+            return m_directory;
+        }
+
+        /// <summary>
+        /// Sets the local directory where cached contents are also written, so that they outlive the process.
+        /// </summary>
+        /// <param name="value">The path of the directory, which is created if it does not exist, or an empty string to only keep contents in memory.</param>
+        void set_directory(const utility::string_t& value)
+        {
+            m_directory = value;
+        }
+
+    private:
+
+        utility::size64_t m_max_size_in_bytes;
+        size_t m_max_blob_size_in_bytes;
+        utility::string_t m_directory;
+    };
+
+    /// <summary>
+    /// Provides a client-side logical representation of the Windows Azure Blob Service. This client is used to configure and execute requests against the Blob Service.
+    /// </summary>
+    /// <remarks>The service client encapsulates the base URI for the Blob service. If the service client will be used for authenticated access, it also encapsulates the credentials for accessing the storage account.</remarks>
+    class cloud_blob_client : public cloud_client
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class.
+        /// </summary>
+        cloud_blob_client()
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class using the specified Blob service endpoint
+        /// and anonymous credentials.
+        /// </summary>
+        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Blob service endpoint for all locations.</param>
+        cloud_blob_client(const storage_uri& base_uri)
+            : cloud_client(base_uri)
+        {
+            initialize();
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class using the specified Blob service endpoint
+        /// and account credentials.
+        /// </summary>
+        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Blob service endpoint for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        cloud_blob_client(const storage_uri& base_uri, const storage_credentials& credentials)
+            : cloud_client(base_uri, credentials)
+        {
+            initialize();
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_client" /> class using the specified Blob service endpoint
+        /// and account credentials.
+        /// </summary>
+        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Blob service endpoint for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        /// <param name="default_request_options">The default <see cref="blob_request_options" /> object to use for all requests made with this client object.</param>
+        cloud_blob_client(const storage_uri& base_uri, const storage_credentials& credentials, const blob_request_options& default_request_options)
+            : cloud_client(base_uri, credentials), m_default_request_options(default_request_options)
+        {
+            initialize();
+        }
+
+        /// <summary>
+        /// Sets the authentication scheme to use to sign HTTP requests.
+        /// </summary>
+        /// <param name="value">The authentication scheme.</param>
+        WASTORAGE_API void set_authentication_scheme(wa::storage::authentication_scheme value) override;
+
+        /// <summary>
+        /// Returns a collection of all the containers in the storage account.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_blob_container" /> objects.</returns>
+        std::vector<cloud_blob_container> list_containers() const
+        {
+            return list_containers_async(utility::string_t(), container_listing_includes(), blob_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Returns a collection of all the containers in the storage account.
+        /// </summary>
+        /// <param name="prefix">The container name prefix.</param>
+        /// <param name="includes">A <see cref="wa::storage::container_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_blob_container" /> objects.</returns>
+        std::vector<cloud_blob_container> list_containers(const utility::string_t& prefix, const container_listing_includes& includes, const blob_request_options& options, operation_context context) const
+        {
+            return list_containers_async(prefix, includes, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a collection of all the containers in the storage account.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="wa::storage::cloud_blob_container" />, that represents the current operation.</returns>
+        pplx::task<std::vector<cloud_blob_container>> list_containers_async() const
+        {
+            return list_containers_async(utility::string_t(), container_listing_includes(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a collection of all the containers in the storage account.
+        /// </summary>
+        /// <param name="prefix">The container name prefix.</param>
+        /// <param name="includes">A <see cref="wa::storage::container_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="wa::storage::cloud_blob_container" />, that represents the current operation.</returns>
+        /// <remarks>The request for each segment is sent as soon as the previous segment has arrived, while that segment's results are collected.</remarks>
+        WASTORAGE_API pplx::task<std::vector<cloud_blob_container>> list_containers_async(const utility::string_t& prefix, const container_listing_includes& includes, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Returns a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// </summary>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="container_result_segment" /> containing a collection of containers.</returns>
+        container_result_segment list_containers_segmented(const blob_continuation_token& current_token) const
+        {
+            return list_containers_segmented_async(current_token).get();
+        }
+
+        /// <summary>
+        /// Returns a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// </summary>
+        /// <param name="prefix">The container name prefix.</param>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="container_result_segment" /> containing a collection of containers.</returns>
+        container_result_segment list_containers_segmented(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        {
+            return list_containers_segmented_async(prefix, current_token).get();
+        }
+
+        /// <summary>
+        /// Returns a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// </summary>
+        /// <param name="prefix">The container name prefix.</param>
+        /// <param name="listing_details">A value that indicates whether to return container metadata with the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned 
+        /// in the result segment, up to the per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="container_result_segment" /> containing a collection of containers.</returns>
+        container_result_segment list_containers_segmented(const utility::string_t& prefix, const container_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        {
+            return list_containers_segmented_async(prefix, includes, max_results, current_token, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// </summary>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="container_result_segment" /> that represents the current operation.</returns>
+        pplx::task<container_result_segment> list_containers_segmented_async(const blob_continuation_token& current_token) const
+        {
+            return list_containers_segmented_async(utility::string_t(), current_token);
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// </summary>
+        /// <param name="prefix">The container name prefix.</param>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="container_result_segment" /> that represents the current operation.</returns>
+        pplx::task<container_result_segment> list_containers_segmented_async(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        {
+            return list_containers_segmented_async(prefix, container_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of <see cref="wa::storage::cloud_blob_container" /> objects.
+        /// </summary>
+        /// <param name="prefix">The container name prefix.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned 
+        /// in the result segment, up to the per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="container_result_segment" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<container_result_segment> list_containers_segmented_async(const utility::string_t& prefix, const container_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Returns a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement 
+        /// <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
+        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(prefix, current_token).get();
+        }
+
+        /// <summary>
+        /// Returns a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>         
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
+        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        {
+            return list_blobs_segmented_async(prefix, use_flat_blob_listing, includes, max_results, current_token, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
+        pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(prefix, false, blob_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>         
+        /// <param name="current_token">A <see cref="wa::storage::blob_continuation_token" /> returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options"/> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Gets the service properties for the service client.
+        /// </summary>
+        /// <returns>The <see cref="service_properties" /> for the service client.</returns>
+        service_properties download_service_properties() const
+        {
+            return download_service_properties_async().get();
+        }
+
+        /// <summary>
+        /// Gets the service properties for the service client.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The <see cref="service_properties" /> for the service client.</returns>
+        service_properties download_service_properties(const blob_request_options& options, operation_context context) const
+        {
+            return download_service_properties_async(options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to get the properties of the service.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="service_properties" /> that represents the current operation.</returns>
+        pplx::task<service_properties> download_service_properties_async() const
+        {
+            return download_service_properties_async(blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to get the properties of the service.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="service_properties" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<service_properties> download_service_properties_async(const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Sets the service properties for the service client.
+        /// </summary>
+        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
+        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
+        void upload_service_properties(const service_properties& properties, const service_properties_includes& includes) const
+        {
+            upload_service_properties_async(properties, includes).wait();
+        }
+
+        /// <summary>
+        /// Sets the service properties for the service client.
+        /// </summary>
+        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
+        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_service_properties(const service_properties& properties, const service_properties_includes& includes, const blob_request_options& options, operation_context context) const
+        {
+            upload_service_properties_async(properties, includes, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to set the service properties for the service client.
+        /// </summary>
+        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
+        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_service_properties_async(const service_properties& properties, const service_properties_includes& includes) const
+        {
+            return upload_service_properties_async(properties, includes, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to set the service properties for the service client.
+        /// </summary>
+        /// <param name="properties">The <see cref="service_properties" /> for the service client.</param>
+        /// <param name="includes">A <see cref="wa::storage::service_properties_includes"/> enumeration describing which items to include when setting service properties.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_service_properties_async(const service_properties& properties, const service_properties_includes& includes, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Returns a reference to a <see cref="wa::storage::cloud_blob_container" /> object.
+        /// </summary>
+        /// <returns>A reference to the root container, of type <see cref="cloud_blob_container" />.</returns>
+        WASTORAGE_API cloud_blob_container get_root_container_reference() const;
+
+        /// <summary>
+        /// Returns a reference to a <see cref="wa::storage::cloud_blob_container" /> object with the specified name.
+        /// </summary>
+        /// <param name="container_name">The name of the container, or an absolute URI to the container.</param>
+        /// <returns>A reference to a <see cref="cloud_blob_container" />.</returns>
+        WASTORAGE_API cloud_blob_container get_container_reference(const utility::string_t& container_name) const;
+
+        /// <summary>
+        /// Returns the default set of request options.
+        /// </summary>
+        /// <returns>A <see cref="blob_request_options" /> object.</returns>
+        const blob_request_options& default_request_options() const
+        {
+            return m_default_request_options;
+        }
+        
+        /// <summary>
+        /// Gets the default delimiter that may be used to create a virtual directory structure of blobs.
+        /// </summary>
+        /// <returns>A string containing the default delimiter.</returns>
+        const utility::string_t& directory_delimiter() const
+        {
+            return m_delimiter;
+        }
+
+        /// <summary>
+        /// Sets the default delimiter that may be used to create a virtual directory structure of blobs.
+        /// </summary>
+        /// <param name="value">A string containing the default delimiter.</param>
+        void set_directory_delimiter(const utility::string_t& value)
+        {
+            if (value.empty())
+            {
+                throw std::invalid_argument("value");
+            }
+
+            m_delimiter = value;
+        }
+
+        /// <summary>
+        /// Gets the maximum number of block buffers that the blob write streams of this client can hold at once.
+        /// </summary>
+        /// <returns>The maximum number of block buffers.</returns>
+        WASTORAGE_API size_t block_buffer_pool_size() const;
+
+        /// <summary>
+        /// Sets the maximum number of block buffers that the blob write streams of this client can hold at once.
+        /// </summary>
+        /// <param name="value">The maximum number of block buffers.</param>
+        /// <remarks>Block buffers are reused across write streams. Once they are all in use,
+        /// writes wait until an upload completes and returns its buffer to the pool.
+        /// A value of 0 allocates a separate buffer for every block.</remarks>
+        WASTORAGE_API void set_block_buffer_pool_size(size_t value);
+
+        /// <summary>
+        /// Gets the maximum number of bytes that the buffers of all blob streams opened through this client can hold at once.
+        /// </summary>
+        /// <returns>The memory budget, in bytes, or 0 if it is not limited.</returns>
+        WASTORAGE_API utility::size64_t memory_budget_in_bytes() const;
+
+        /// <summary>
+        /// Sets the maximum number of bytes that the buffers of all blob streams opened through this client can hold at once.
+        /// </summary>
+        /// <param name="value">The memory budget, in bytes, or 0 to not limit it.</param>
+        /// <remarks>Write streams reserve every block buffer, and read streams every downloaded or prefetched range,
+        /// from this budget. Once it is used up, writes and reads wait until other streams release their buffers.
+        /// Streams that are already open keep the budget they were opened with.</remarks>
+        WASTORAGE_API void set_memory_budget_in_bytes(utility::size64_t value);
+
+        /// <summary>
+        /// Gets the maximum number of shared access signatures that this client keeps to return again.
+        /// </summary>
+        /// <returns>The maximum number of cached shared access signatures, or 0 if they are not cached.</returns>
+        WASTORAGE_API size_t shared_access_signature_cache_size() const;
+
+        /// <summary>
+        /// Sets the maximum number of shared access signatures that this client keeps to return again.
+        /// </summary>
+        /// <param name="value">The maximum number of cached shared access signatures, or 0 to not cache them.</param>
+        /// <remarks>Once cached, asking again for the signature of the same resource with the same policy, stored policy identifier
+        /// and headers returns it without signing it again. Signatures are dropped from the cache once their policy expires.
+        /// Caching is disabled by default.</remarks>
+        WASTORAGE_API void set_shared_access_signature_cache_size(size_t value);
+
+        /// <summary>
+        /// Gets the cache of shared access signatures of the client. This method is used internally.
+        /// </summary>
+        /// <returns>The cache, or <c>nullptr</c> if signatures are not cached.</returns>
+        std::shared_ptr<core::sas_cache> _sas_cache() const
+        {
+            return m_sas_cache;
+        }
+
+        /// <summary>
+        /// Gets the settings of the cache of blob properties and metadata.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::blob_attribute_cache_settings" /> object.</returns>
+        WASTORAGE_API blob_attribute_cache_settings attribute_cache_settings() const;
+
+        /// <summary>
+        /// Sets the settings of the cache of blob properties and metadata.
+        /// </summary>
+        /// <param name="value">A <see cref="wa::storage::blob_attribute_cache_settings" /> object.</param>
+        /// <remarks>Attributes are cached when they are downloaded, and opening a blob for reading while they are fresh
+        /// does not read them again; the read is made conditional on the cached ETag instead, so it fails rather than return
+        /// content that has changed. The cache is shared by all copies of the service client and all blobs created from it,
+        /// and writes through any of them remove the attributes of the blob they change. Changing the settings empties the cache.</remarks>
+        WASTORAGE_API void set_attribute_cache_settings(const blob_attribute_cache_settings& value);
+
+        /// <summary>
+        /// Gets the cache of blob properties and metadata. This method is used internally.
+        /// </summary>
+        /// <returns>The attribute cache.</returns>
+        std::shared_ptr<core::blob_attribute_cache> _attribute_cache() const
+        {
+            return m_attribute_cache;
+        }
+
+        /// <summary>
+        /// Gets the settings of the cache of hierarchical blob listings.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::blob_listing_cache_settings" /> object.</returns>
+        WASTORAGE_API blob_listing_cache_settings listing_cache_settings() const;
+
+        /// <summary>
+        /// Sets the settings of the cache of hierarchical blob listings.
+        /// </summary>
+        /// <param name="value">A <see cref="wa::storage::blob_listing_cache_settings" /> object.</param>
+        /// <remarks>Segments of listings that are not flat are cached by their container, prefix, delimiter, includes, maximum
+        /// number of results and continuation token, and listing the same segment again while it is fresh returns it without
+        /// a request. Once a segment has been listed from the service, the first segments of some of its child directories are
+        /// listed in the background, so that browsing into them is served from the cache. The cache is shared by all copies of
+        /// the service client and all containers and blobs created from it; writes to a blob through any of them remove the
+        /// segments the blob appears in, and deleting a container removes all of its segments. Changing the settings empties the cache.</remarks>
+        WASTORAGE_API void set_listing_cache_settings(const blob_listing_cache_settings& value);
+
+        /// <summary>
+        /// Gets the cache of hierarchical blob listings. This method is used internally.
+        /// </summary>
+        /// <returns>The listing cache.</returns>
+        std::shared_ptr<core::blob_listing_cache> _listing_cache() const
+        {
+            return m_listing_cache;
+        }
+
+        /// <summary>
+        /// Gets the settings of the cache of small blob contents.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::blob_content_cache_settings" /> object.</returns>
+        WASTORAGE_API blob_content_cache_settings content_cache_settings() const;
+
+        /// <summary>
+        /// Sets the settings of the cache of small blob contents.
+        /// </summary>
+        /// <param name="value">A <see cref="wa::storage::blob_content_cache_settings" /> object.</param>
+        /// <remarks>Whole blobs that are downloaded without a condition other than a lease are cached. Downloading a cached blob
+        /// again sends its ETag in an If-None-Match header, and if the service answers that the blob has not changed, the content
+        /// is returned from the cache instead of being transferred again. The cache is shared by all copies of the service client
+        /// and all blobs created from it. Changing the settings empties the cache in memory.</remarks>
+        WASTORAGE_API void set_content_cache_settings(const blob_content_cache_settings& value);
+
+        /// <summary>
+        /// Gets the cache of small blob contents. This method is used internally.
+        /// </summary>
+        /// <returns>The content cache.</returns>
+        std::shared_ptr<core::blob_content_cache> _content_cache() const
+        {
+            return m_content_cache;
+        }
+
+    private:
+
+        WASTORAGE_API void initialize();
+
+        blob_request_options m_default_request_options;
+        utility::string_t m_delimiter;
+        std::shared_ptr<core::sas_cache> m_sas_cache;
+        std::shared_ptr<core::blob_attribute_cache> m_attribute_cache;
+        std::shared_ptr<core::blob_listing_cache> m_listing_cache;
+        std::shared_ptr<core::blob_content_cache> m_content_cache;
+    };
+
+    /// <summary>
+    /// Represents a container in the Windows Azure Blob service.
+    /// </summary>
+    class cloud_blob_container
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// </summary>
+        cloud_blob_container() {}
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// </summary>
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the container for all locations.</param>
+        WASTORAGE_API cloud_blob_container(const storage_uri& uri);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// </summary>
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the container for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        WASTORAGE_API cloud_blob_container(const storage_uri& uri, const storage_credentials& credentials);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// </summary>
+        /// <param name="name">The name of the container.</param>
+        /// <param name="client">The Blob service client.</param>
+        cloud_blob_container(const utility::string_t& name, const cloud_blob_client& client);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_container" /> class.
+        /// </summary>
+        /// <param name="name">The container name.</param>
+        /// <param name="client">The Blob service client.</param>
+        /// <param name="properties">The properties for the container.</param>
+        /// <param name="metadata">The metadata for the container.</param>
+        cloud_blob_container(utility::string_t name, const cloud_blob_client& client, cloud_blob_container_properties properties, cloud_metadata metadata);
+
+        /// <summary>
+        /// Returns a shared access signature for the container.
+        /// </summary>
+        /// <param name="policy">The access policy for the shared access signature.</param>
+        /// <returns>A string containing a shared access signature.</returns>
+        utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy) const
+        {
+            return get_shared_access_signature(policy, utility::string_t());
+        }
+
+        /// <summary>
+        /// Returns a shared access signature for the container.
+        /// </summary>
+        /// <param name="policy">The access policy for the shared access signature.</param>
+        /// <param name="stored_policy_identifier">A container-level access policy.</param>
+        /// <returns>A string containing a shared access signature.</returns>
+        WASTORAGE_API utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier) const;
+
+        /// <summary>
+        /// Returns shared access signatures for blobs in the container.
+        /// </summary>
+        /// <param name="policy">The access policy for the shared access signatures.</param>
+        /// <param name="stored_policy_identifier">A container-level access policy.</param>
+        /// <param name="blob_names">The names of the blobs.</param>
+        /// <returns>The shared access signatures, in the order of the blob names.</returns>
+        std::vector<utility::string_t> get_blob_shared_access_signatures(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier, const std::vector<utility::string_t>& blob_names) const
+        {
+            return get_blob_shared_access_signatures(policy, stored_policy_identifier, blob_names, cloud_blob_shared_access_headers());
+        }
+
+        /// <summary>
+        /// Returns shared access signatures for blobs in the container.
+        /// </summary>
+        /// <param name="policy">The access policy for the shared access signatures.</param>
+        /// <param name="stored_policy_identifier">A container-level access policy.</param>
+        /// <param name="blob_names">The names of the blobs.</param>
+        /// <param name="headers">The optional header values to set for a blob returned with these SAS.</param>
+        /// <returns>The shared access signatures, in the order of the blob names.</returns>
+        /// <remarks>Each signature is the same as the one that <see cref="cloud_blob::get_shared_access_signature" /> returns for the blob,
+        /// but the policy, the headers and the account key are only prepared once for all of them.</remarks>
+        WASTORAGE_API std::vector<utility::string_t> get_blob_shared_access_signatures(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier, const std::vector<utility::string_t>& blob_names, const cloud_blob_shared_access_headers& headers) const;
+
+        /// <summary>
+        /// Gets a reference to a blob in this container.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
+        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a blob in this container.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
+        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+
+        /// <summary>
+        /// Gets a reference to a page blob in this container.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
+        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a page blob in this container.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
+        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+
+        /// <summary>
+        /// Gets a reference to a block blob in this container.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
+        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a block blob in this container.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
+        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+
+        /// <summary>
+        /// Gets a reference to a virtual blob directory beneath this container.
+        /// </summary>
+        /// <param name="name">The name of the virtual blob directory.</param>
+        /// <returns>A reference to a <see cref="cloud_blob_directory" />.</returns>
+        WASTORAGE_API cloud_blob_directory get_directory_reference(const utility::string_t& name) const;
+
+        /// <summary>
+        /// Retrieves the container's attributes.
+        /// </summary>
+        void download_attributes()
+        {
+            download_attributes_async().wait();
+        }
+
+        /// <summary>
+        /// Retrieves the container's attributes.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_attributes(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            download_attributes_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to retrieve the container's attributes.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_attributes_async()
+        {
+            return download_attributes_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to retrieve the container's attributes.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> download_attributes_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Sets the container's user-defined metadata.
+        /// </summary>
+        void upload_metadata()
+        {
+            upload_metadata_async().wait();
+        }
+
+        /// <summary>
+        /// Sets the container's user-defined metadata.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_metadata(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            upload_metadata_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to set the container's user-defined metadata.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_metadata_async()
+        {
+            return upload_metadata_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to set the container's user-defined metadata.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_metadata_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Acquires a lease on the container.
+        /// </summary>
+        /// <param name="duration">A <see cref="wa::storage::lease_time"/> representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <returns>A string containing the ID of the acquired lease.</returns>
+        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        {
+            return acquire_lease_async(duration, proposed_lease_id).get();
+        }
+
+        /// <summary>
+        /// Acquires a lease on the container.
+        /// </summary>
+        /// <param name="duration">A <see cref="wa::storage::lease_time"/> representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A string containing the ID of the acquired lease.</returns>
+        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return acquire_lease_async(duration, proposed_lease_id, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to acquire a lease on the container.
+        /// </summary>
+        /// <param name="duration">A <see cref="wa::storage::lease_time"/> object representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed..</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        {
+            return acquire_lease_async(duration, proposed_lease_id, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to acquire a lease on the container.
+        /// </summary>
+        /// <param name="duration">A <see cref="wa::storage::lease_time"/> representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Renews a lease on the container.
+        /// </summary>
+        void renew_lease() const
+        {
+            renew_lease_async().wait();
+        }
+
+        /// <summary>
+        /// Renews a lease on the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void renew_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            renew_lease_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to renew a lease on the container.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> renew_lease_async() const
+        {
+            return renew_lease_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to renew a lease on the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> renew_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Changes the lease ID for a lease on the container.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <returns>The new lease ID.</returns>
+        utility::string_t change_lease(const utility::string_t& proposed_lease_id) const
+        {
+            return change_lease_async(proposed_lease_id).get();
+        }
+
+        /// <summary>
+        /// Changes the lease ID for a lease on the container.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The new lease ID.</returns>
+        utility::string_t change_lease(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return change_lease_async(proposed_lease_id, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to change the lease ID for a lease on the container.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id) const
+        {
+            return change_lease_async(proposed_lease_id, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to change the lease ID for a lease on the container.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Releases a lease on the container.
+        /// </summary>
+        void release_lease() const
+        {
+            release_lease_async().wait();
+        }
+
+        /// <summary>
+        /// Releases a lease on the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void release_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            release_lease_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to release a lease on the container.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> release_lease_async() const
+        {
+            return release_lease_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to release a lease on the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> release_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Breaks the current lease on the container.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <returns>The time until the lease ends, in seconds.</returns>
+        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period) const
+        {
+            return break_lease_async(break_period).get();
+        }
+
+        /// <summary>
+        /// Breaks the current lease on the container.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The time until the lease ends, in seconds.</returns>
+        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return break_lease_async(break_period, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to break the current lease on the container.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
+        pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period) const
+        {
+            return break_lease_async(break_period, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to break the current lease on the container.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Creates the container.
+        /// </summary>
+        void create()
+        {
+            create_async().wait();
+        }
+
+        /// <summary>
+        /// Creates the container and specifies the level of access to the container's data.
+        /// </summary>
+        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object
+        /// is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        void create(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context)
+        {
+            create_async(public_access, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to create the container.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> create_async()
+        {
+            return create_async(blob_container_public_access_type::off, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to create the container.
+        /// </summary>
+        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> create_async(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Creates the container if it does not already exist.
+        /// </summary>
+        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
+        bool create_if_not_exists()
+        {
+            return create_if_not_exists_async().get();
+        }
+
+        /// <summary>
+        /// Creates the container if it does not already exist and specifies the level of public access to the container's data.
+        /// </summary>
+        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
+        bool create_if_not_exists(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context)
+        {
+            return create_if_not_exists_async(public_access, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to create the container if it does not already exist.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<bool> create_if_not_exists_async()
+        {
+            return create_if_not_exists_async(blob_container_public_access_type::off, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to create the container if it does not already exist and specify the level of public access to the container's data.
+        /// </summary>
+        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<bool> create_if_not_exists_async(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Deletes the container.
+        /// </summary>
+        void delete_container()
+        {
+            delete_container_async().wait();
+        }
+
+        /// <summary>
+        /// Deletes the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void delete_container(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            delete_container_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the container.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> delete_container_async()
+        {
+            return delete_container_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> delete_container_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Deletes the container if it already exists.
+        /// </summary>
+        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
+        bool delete_container_if_exists()
+        {
+            return delete_container_if_exists_async().get();
+        }
+
+        /// <summary>
+        /// Deletes the container if it already exists.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
+        bool delete_container_if_exists(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            return delete_container_if_exists_async(condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the container if it already exists.
+        /// </summary>
+        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<bool> delete_container_if_exists_async()
+        {
+            return delete_container_if_exists_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the container if it already exists.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<bool> delete_container_if_exists_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Returns a result segment containing a collection of blob items in the container.
+        /// </summary>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
+        blob_result_segment list_blobs_segmented(const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(current_token).get();
+        }
+
+        /// <summary>
+        /// Returns a result segment containing a collection of blob items in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <returns>A result segment containing objects that implement <see cref="wa::storage::cloud_blob" /> and <see cref="wa::storage::cloud_blob_directory" />.</returns>
+        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(prefix, current_token).get();
+        }
+
+        /// <summary>
+        /// Returns a result segment containing a collection of blob items in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
+        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        {
+            return list_blobs_segmented_async(prefix, use_flat_blob_listing, includes, max_results, current_token, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
+        pplx::task<blob_result_segment> list_blobs_segmented_async(const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(utility::string_t(), current_token);
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
+        pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(prefix, false, blob_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Lists all the blob items in the container, passing each one to a handler as soon as it has been read from the response.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="handler">A function that is called for each blob item in listing order. Returning <c>false</c> stops the listing.</param>
+        void list_blobs(const utility::string_t& prefix, std::function<bool (const list_blob_item&)> handler) const
+        {
+            list_blobs_async(prefix, std::move(handler)).wait();
+        }
+
+        /// <summary>
+        /// Lists all the blob items in the container, passing each one to a handler as soon as it has been read from the response.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned by each request, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="handler">A function that is called for each blob item in listing order. Returning <c>false</c> stops the listing.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void list_blobs(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const
+        {
+            list_blobs_async(prefix, use_flat_blob_listing, includes, max_results, std::move(handler), options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to list all the blob items in the container, passing each one
+        /// to a handler as soon as it has been read from the response.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="handler">A function that is called for each blob item in listing order. Returning <c>false</c> stops the listing.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> list_blobs_async(const utility::string_t& prefix, std::function<bool (const list_blob_item&)> handler) const
+        {
+            return list_blobs_async(prefix, false, blob_listing_includes(), 0, std::move(handler), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to list all the blob items in the container, passing each one
+        /// to a handler as soon as it has been read from the response.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned by each request, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="handler">A function that is called for each blob item in listing order. Returning <c>false</c> stops the listing.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The handler is called while the response is still downloading. If a request is retried, items that were already
+        /// passed to the handler are skipped, so each item is seen at most once.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> list_blobs_async(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Lists the blobs in the container by flat-listing several name prefixes concurrently, passing the blobs of all the
+        /// prefixes to a single handler.
+        /// </summary>
+        /// <param name="prefixes">The blob name prefixes to list, which must not overlap. If empty, the top-level virtual directories
+        /// of the container are discovered first and used as the prefixes.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned by each request, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="handler">A function that is called for each blob. Returning <c>false</c> stops the listing.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// Up to <see cref="wa::storage::blob_request_options::parallelism_factor" /> prefixes are listed at the same time. The handler is
+        /// never called concurrently. Blobs of one prefix are passed in listing order, but blobs of different prefixes are interleaved.
+        /// Discovering the prefixes uses a hierarchical listing, so it cannot be combined with including snapshots.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> list_blobs_parallel_async(const std::vector<utility::string_t>& prefixes, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Lists the blobs in the container whose names are in a range, passing each one to a handler as soon as it has been read from the response.
+        /// </summary>
+        /// <param name="start_name">The lowest blob name of the range, or an empty string to start at the first blob.</param>
+        /// <param name="end_name">The blob name that the range ends before, or an empty string to end at the last blob.</param>
+        /// <param name="handler">A function that is called for each blob in listing order. Returning <c>false</c> stops the listing.</param>
+        void list_blobs_in_range(const utility::string_t& start_name, const utility::string_t& end_name, std::function<bool (const list_blob_item&)> handler) const
+        {
+            list_blobs_in_range_async(start_name, end_name, blob_listing_includes(), 0, std::move(handler), blob_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to list the blobs in the container whose names are in a range, passing
+        /// each one to a handler as soon as it has been read from the response.
+        /// </summary>
+        /// <param name="start_name">The lowest blob name of the range, or an empty string to start at the first blob.</param>
+        /// <param name="end_name">The blob name that the range ends before, or an empty string to end at the last blob.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned by each request, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="handler">A function that is called for each blob in listing order. Returning <c>false</c> stops the listing.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The listing is flat and limited to the prefix that the start and end names share. It starts at the start name with a marker
+        /// written as the service writes its own, so the pages before the range are not read, and it stops at the first blob past the end name.
+        /// If the service does not accept the marker, the listing starts at the shared prefix and skips the blobs before the range.
+        /// The snapshots of the blob at the start name come before it, so a listing that includes snapshots always starts at the shared prefix.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> list_blobs_in_range_async(const utility::string_t& start_name, const utility::string_t& end_name, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to list the blobs in the container whose names are in any of several
+        /// ranges, listing the ranges concurrently and passing the blobs of all the ranges to a single handler.
+        /// </summary>
+        /// <param name="ranges">The ranges to list, which must not overlap, each as a start name and the name the range ends before.
+        /// An empty start or end name leaves that side of the range open.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned by each request, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="handler">A function that is called for each blob. Returning <c>false</c> stops the listing.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// Each range is listed as <see cref="cloud_blob_container::list_blobs_in_range_async" /> lists it. Up to
+        /// <see cref="wa::storage::blob_request_options::parallelism_factor" /> ranges are listed at the same time. The handler is never
+        /// called concurrently. Blobs of one range are passed in listing order, but blobs of different ranges are interleaved.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> list_blobs_in_ranges_async(const std::vector<std::pair<utility::string_t, utility::string_t>>& ranges, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Returns a segment of a flat listing of the blobs in the container as a <see cref="wa::storage::blob_inventory" />.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="wa::storage::blob_inventory" /> holding the blobs of the segment and the continuation token.</returns>
+        blob_inventory list_blob_inventory_segmented(const utility::string_t& prefix, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        {
+            return list_blob_inventory_segmented_async(prefix, max_results, current_token, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a segment of a flat listing of the blobs in the container
+        /// as a <see cref="wa::storage::blob_inventory" />.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::blob_inventory" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// Only the name, size, last-modified time, ETag, type and MD5 hash of each blob are kept, and they are read from the
+        /// response as it downloads without creating a <see cref="wa::storage::cloud_blob" /> for each blob.
+        /// </remarks>
+        WASTORAGE_API pplx::task<blob_inventory> list_blob_inventory_segmented_async(const utility::string_t& prefix, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Returns a flat listing of all the blobs in the container as a <see cref="wa::storage::blob_inventory" />.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="wa::storage::blob_inventory" /> holding all the blobs.</returns>
+        blob_inventory list_blob_inventory(const utility::string_t& prefix, const blob_request_options& options, operation_context context) const
+        {
+            return list_blob_inventory_async(prefix, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a flat listing of all the blobs in the container as a
+        /// <see cref="wa::storage::blob_inventory" />.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::blob_inventory" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// Each segment is appended to the inventory as soon as it has been read, so that only one segment is held in any other form.
+        /// </remarks>
+        WASTORAGE_API pplx::task<blob_inventory> list_blob_inventory_async(const utility::string_t& prefix, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Splits the listing of the blobs under a prefix into units that can be listed separately.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::blob_listing_unit" /> objects that together cover every blob under the prefix.</returns>
+        std::vector<blob_listing_unit> split_listing(const utility::string_t& prefix) const
+        {
+            return split_listing_async(prefix, blob_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Splits the listing of the blobs under a prefix into units that can be listed separately.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::blob_listing_unit" /> objects that together cover every blob under the prefix.</returns>
+        std::vector<blob_listing_unit> split_listing(const utility::string_t& prefix, const blob_request_options& options, operation_context context) const
+        {
+            return split_listing_async(prefix, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to split the listing of the blobs under a prefix into units that can be listed separately.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector{blob_listing_unit}" /> that represents the current operation.</returns>
+        pplx::task<std::vector<blob_listing_unit>> split_listing_async(const utility::string_t& prefix) const
+        {
+            return split_listing_async(prefix, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to split the listing of the blobs under a prefix into units that can be listed separately.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector{blob_listing_unit}" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// The service does not report how blob names are distributed, so the listing is split by virtual directory: one level under the
+        /// prefix is listed, and there is one unit for the blobs directly under the prefix and a flat-listing unit for each virtual directory.
+        /// </remarks>
+        WASTORAGE_API pplx::task<std::vector<blob_listing_unit>> split_listing_async(const utility::string_t& prefix, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Deletes all the blobs in the container whose names start with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix. If empty, all the blobs in the container are deleted.</param>
+        /// <param name="snapshots_option">Indicates whether to delete the snapshots of the blobs as well.</param>
+        /// <returns>The blobs that could not be deleted.</returns>
+        std::vector<blob_delete_failure> delete_blobs(const utility::string_t& prefix, delete_snapshots_option snapshots_option)
+        {
+            return delete_blobs_async(prefix, snapshots_option, blob_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Deletes all the blobs in the container whose names start with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix. If empty, all the blobs in the container are deleted.</param>
+        /// <param name="snapshots_option">Indicates whether to delete the snapshots of the blobs as well.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The blobs that could not be deleted.</returns>
+        std::vector<blob_delete_failure> delete_blobs(const utility::string_t& prefix, delete_snapshots_option snapshots_option, const blob_request_options& options, operation_context context)
+        {
+            return delete_blobs_async(prefix, snapshots_option, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete all the blobs in the container whose names start with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix. If empty, all the blobs in the container are deleted.</param>
+        /// <param name="snapshots_option">Indicates whether to delete the snapshots of the blobs as well.</param>
+        /// <returns>A <see cref="pplx::task" /> object of the blobs that could not be deleted.</returns>
+        pplx::task<std::vector<blob_delete_failure>> delete_blobs_async(const utility::string_t& prefix, delete_snapshots_option snapshots_option)
+        {
+            return delete_blobs_async(prefix, snapshots_option, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete all the blobs in the container whose names start with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The blob name prefix. If empty, all the blobs in the container are deleted.</param>
+        /// <param name="snapshots_option">Indicates whether to delete the snapshots of the blobs as well.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of the blobs that could not be deleted.</returns>
+        /// <remarks>
+        /// Blobs are deleted while the listing goes on, up to <see cref="wa::storage::blob_request_options::parallelism_factor" /> at the same time,
+        /// and the next page of the listing is requested while the blobs of the current page are deleted. A blob that cannot be deleted
+        /// does not stop the others from being deleted; the task fails only if the listing itself fails.
+        /// </remarks>
+        WASTORAGE_API pplx::task<std::vector<blob_delete_failure>> delete_blobs_async(const utility::string_t& prefix, delete_snapshots_option snapshots_option, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Sets permissions for the container.
+        /// </summary>
+        /// <param name="permissions">The permissions to apply to the container.</param>
+        void upload_permissions(const blob_container_permissions& permissions)
+        {
+            upload_permissions_async(permissions).wait();
+        }
+
+        /// <summary>
+        /// Sets permissions for the container.
+        /// </summary>
+        /// <param name="permissions">The permissions to apply to the container.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_permissions(const blob_container_permissions& permissions, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            upload_permissions_async(permissions, condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to set permissions for the container.
+        /// </summary>
+        /// <param name="permissions">The permissions to apply to the container.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_permissions_async(const blob_container_permissions& permissions)
+        {
+            return upload_permissions_async(permissions, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to set permissions for the container.
+        /// </summary>
+        /// <param name="permissions">The permissions to apply to the container.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_permissions_async(const blob_container_permissions& permissions, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Gets the permissions settings for the container.
+        /// </summary>
+        /// <returns>The container's permissions.</returns>
+        blob_container_permissions download_permissions()
+        {
+            return download_permissions_async().get();
+        }
+
+        /// <summary>
+        /// Gets the permissions settings for the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The container's permissions.</returns>
+        blob_container_permissions download_permissions(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            return download_permissions_async(condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to get permissions settings for the container.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_container_permissions" /> that represents the current operation.</returns>
+        pplx::task<blob_container_permissions> download_permissions_async()
+        {
+            return download_permissions_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to get permissions settings for the container.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_container_permissions" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<blob_container_permissions> download_permissions_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Checks existence of the container.
+        /// </summary>
+        /// <returns><c>true</c> if the container exists.</returns>
+        bool exists()
+        {
+            return exists_async().get();
+        }
+
+        /// <summary>
+        /// Checks existence of the container.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns><c>true</c> if the container exists.</returns>
+        bool exists(const blob_request_options& options, operation_context context)
+        {
+            return exists_async(options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to check the existence of the container.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<bool> exists_async()
+        {
+            return exists_async(blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to check the existence of the container.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that that represents the current operation.</returns>
+        pplx::task<bool> exists_async(const blob_request_options& options, operation_context context)
+        {
+            return exists_async(false, options, context);
+        }
+
+        /// <summary>
+        /// Gets the service client for the container.
+        /// </summary>
+        /// <returns>A <see cref="cloud_blob_client" /> object that specifies the endpoint for the Blob service.</returns>
+        const cloud_blob_client& service_client() const
+        {
+            return m_client;
+        }
+
+        /// <summary>
+        /// Gets the container URI for all locations.
+        /// </summary>
+        /// <returns>A <see cref="storage_uri" /> containing the container URI for all locations.</returns>
+        const storage_uri& uri() const
+        {
+            return m_uri;
+        }
+
+        /// <summary>
+        /// Gets the name of the container.
+        /// </summary>
+        /// <returns>A string containing the container name.</returns>
+        const utility::string_t& name() const
+        {
+            return m_name;
+        }
+
+        /// <summary>
+        /// Gets the container's metadata.
+        /// </summary>
+        /// <returns>A <see cref="cloud_metadata" /> object containing the container's metadata.</returns>
+        cloud_metadata& metadata()
+        {
+            return *m_metadata;
+        }
+
+        /// <summary>
+        /// Gets the container's metadata.
+        /// </summary>
+        /// <returns>A <see cref="cloud_metadata" /> object containing the container's metadata.</returns>
+        const cloud_metadata& metadata() const
+        {
+            return *m_metadata;
+        }
+
+        /// <summary>
+        /// Gets the container's system properties.
+        /// </summary>
+        /// <returns>The container's properties.</returns>
+        const cloud_blob_container_properties& properties() const
+        {
+            return *m_properties;
+        }
+
+        /// <summary>
+        /// Indicates whether the <see cref="cloud_blob_container" /> object is valid.
+        /// </summary>
+        /// <returns><c>true</c> if the <see cref="cloud_blob_container" /> object is valid; otherwise, <c>false</c>.</returns>
+        bool is_valid() const
+        {
+            return !m_name.empty();
+        }
+
+        /// <summary>
+        /// Returns a task that creates the container after a write has found it missing, which the writes that found it missing
+        /// at the same time share. This method is used internally.
+        /// </summary>
+        pplx::task<void> _create_after_not_found_async(const blob_request_options& options, operation_context context) const;
+
+    private:
+
+        void init(const storage_credentials& credentials);
+        WASTORAGE_API pplx::task<bool> exists_async(bool primary_only, const blob_request_options& options, operation_context context);
+        pplx::task<void> list_blobs_from_async(const utility::string_t& prefix, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const blob_continuation_token& first_token, std::function<bool (const list_blob_item&)> handler, const blob_request_options& modified_options, operation_context context) const;
+        pplx::task<blob_result_segment> list_blobs_segment_from_service_async(const utility::string_t& prefix, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& modified_options, operation_context context) const;
+        void prefetch_child_directories(std::shared_ptr<core::blob_listing_cache> cache, const blob_result_segment& segment, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const blob_request_options& modified_options) const;
+
+        storage_uri m_uri;
+        utility::string_t m_name;
+        cloud_blob_client m_client;
+        std::shared_ptr<cloud_metadata> m_metadata;
+        std::shared_ptr<cloud_blob_container_properties> m_properties;
+    };
+
+    /// <summary>
+    /// Represents a virtual directory of blobs, designated by a delimiter character.
+    /// </summary>
+    /// <remarks>Containers, which are encapsulated as <see cref="wa::storage::cloud_blob_container" /> objects, hold directories, and directories hold block blobs and page blobs. Directories can also contain sub-directories.</remarks>
+    class cloud_blob_directory
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_directory" /> class.
+        /// </summary>
+        cloud_blob_directory() {}
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_directory" /> class.
+        /// </summary>
+        /// <param name="name">Name of the virtual directory.</param>
+        /// <param name="container">The container.</param>
+        cloud_blob_directory(const utility::string_t& name, const cloud_blob_container& container);
+
+        /// <summary>
+        /// Gets a reference to a blob in this virtual directory.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
+        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a blob in this virtual directory.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
+        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+
+        /// <summary>
+        /// Gets a reference to a page blob in this virtual directory.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
+        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a page blob in this virtual directory.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
+        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+
+        /// <summary>
+        /// Gets a reference to a block blob in this virtual directory.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
+        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a block blob in this virtual directory.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
+        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+
+        /// <summary>
+        /// Returns a virtual subdirectory within this virtual directory.
+        /// </summary>
+        /// <param name="name">The name of the virtual subdirectory.</param>
+        /// <returns>A <see cref="wa::storage::cloud_blob_directory" /> object representing the virtual subdirectory.</returns>
+        WASTORAGE_API cloud_blob_directory get_subdirectory_reference(const utility::string_t& name) const;
+
+        /// <summary>
+        /// Gets the <see cref="wa::storage::cloud_blob_directory" /> object representing the
+        /// parent directory for the current virtual directory.
+        /// </summary>
+        /// <returns>The virtual directory's parent directory.</returns>
+        WASTORAGE_API cloud_blob_directory get_parent_reference() const;
+
+        /// <summary>
+        /// Returns a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
+        blob_result_segment list_blobs_segmented(const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(current_token).get();
+        }
+
+        /// <summary>
+        /// Returns a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>    
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
+        blob_result_segment list_blobs_segmented(bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        {
+            return list_blobs_segmented_async(use_flat_blob_listing, includes, max_results, current_token, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that that represents the current operation.</returns>
+        pplx::task<blob_result_segment> list_blobs_segmented_async(const blob_continuation_token& current_token) const
+        {
+            return list_blobs_segmented_async(false, blob_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
+        /// in the container.
+        /// </summary>
+        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
+        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>    
+        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<blob_result_segment> list_blobs_segmented_async(bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Gets the service client for the virtual directory.
+        /// </summary>
+        /// <returns>A client object that specifies the endpoint for the Windows Azure Blob service.</returns>
+        const cloud_blob_client& service_client() const
+        {
+            return m_container.service_client();
+        }
+
+        /// <summary>
+        /// Gets a <see cref="wa::storage::cloud_blob_container" /> object representing the virtual directory's container.
+        /// </summary>
+        /// <returns>The virtual directory's container.</returns>
+        const cloud_blob_container& container() const
+        {
+            return m_container;
+        }
+
+        /// <summary>
+        /// Gets the virtual directory URI for all locations.
+        /// </summary>
+        /// <returns>A <see cref="storage_uri" /> containing the virtual directory URI for all locations.</returns>
+        const storage_uri& uri() const
+        {
+            return m_uri;
+        }
+
+        /// <summary>
+        /// Gets the prefix for the virtual directory.
+        /// </summary>
+        /// <returns>A string containing the prefix.</returns>
+        const utility::string_t& prefix() const
+        {
+            return m_name;
+        }
+
+        /// <summary>
+        /// Indicates whether the <see cref="cloud_blob_directory" /> object is valid.
+        /// </summary>
+        /// <returns><c>true</c> if the <see cref="cloud_blob_directory" /> object is valid; otherwise, <c>false</c>.</returns>
+        bool is_valid() const
+        {
+            return !m_name.empty();
+        }
+
+    private:
+
+        cloud_blob_container m_container;
+        storage_uri m_uri;
+        utility::string_t m_name;
+    };
+
+    /// <summary>
+    /// A class for Windows Azure blob types. The <see cref="wa::storage::cloud_block_blob"/> and 
+    /// <see cref="wa::storage::cloud_page_blob"/> classes derive from the <see cref="wa::storage::cloud_blob"/> class.
+    /// </summary>
+    class cloud_blob
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// </summary>
+        cloud_blob()
+            : m_lazy_uri(false)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// </summary>
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        WASTORAGE_API cloud_blob(const storage_uri& uri);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// </summary>
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        WASTORAGE_API cloud_blob(const storage_uri& uri, const storage_credentials& credentials);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// </summary>
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        WASTORAGE_API cloud_blob(const storage_uri& uri, const utility::string_t& snapshot_time, const storage_credentials& credentials);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class.
+        /// </summary>
+        /// <param name="name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <param name="container">A reference to the parent container.</param>
+        /// <remarks>The URI of the blob is only built from those of the container and the name when it is first used.</remarks>
+        cloud_blob(const utility::string_t& name, const utility::string_t& snapshot_time, const cloud_blob_container& container);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class.
+        /// </summary>
+        /// <param name="name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <param name="container">A reference to the parent container.</param>
+        /// <param name="properties">A set of properties for the blob.</param>
+        /// <param name="metadata">User-defined metadata for the blob.</param>
+        /// <param name="copy_state">the state of the most recent or pending copy operation.</param>
+        cloud_blob(utility::string_t name, utility::string_t snapshot_time, const cloud_blob_container& container, cloud_blob_properties properties, cloud_metadata metadata, copy_state copy_state);
+
+        /// <summary>
+        /// Gets the <see cref="wa::storage::cloud_blob_directory" /> object representing the
+        /// virtual parent directory for the blob.
+        /// </summary>
+        /// <returns>The blob's virtual parent directory.</returns>
+        WASTORAGE_API cloud_blob_directory get_parent_reference() const;
+
+        /// <summary>
+        /// Gets the snapshot-qualified URI to the blob.
+        /// </summary>
+        /// <returns>The blob's snapshot-qualified URI, if the blob is a snapshot; otherwise, the absolute URI to the blob.</returns>
+        WASTORAGE_API storage_uri snapshot_qualified_uri() const;
+
+        /// <summary>
+        /// Returns a shared access signature for the blob.
+        /// </summary>
+        /// <param name="policy">The access policy for the shared access signature.</param>
+        /// <returns>A string containing a shared access signature.</returns>
+        utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy) const
+        {
+            return get_shared_access_signature(policy, utility::string_t());
+        }
+
+        /// <summary>
+        /// Returns a shared access signature for the blob.
+        /// </summary>
+        /// <param name="policy">The access policy for the shared access signature.</param>
+        /// <param name="stored_policy_identifier">A container-level access policy.</param>
+        /// <returns>A string containing a shared access signature.</returns>
+        utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier) const
+        {
+            return get_shared_access_signature(policy, stored_policy_identifier, cloud_blob_shared_access_headers());
+        }
+
+        /// <summary>
+        /// Returns a shared access signature for the blob.
+        /// </summary>
+        /// <param name="policy">The access policy for the shared access signature.</param>
+        /// <param name="stored_policy_identifier">A container-level access policy.</param>
+        /// <param name="headers">The optional header values to set for a blob returned with this SAS.</param>
+        /// <returns>A string containing a shared access signature.</returns>
+        WASTORAGE_API utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier, const cloud_blob_shared_access_headers& headers) const;
+
+        /// <summary>
+        /// Opens a stream for reading from the blob.
+        /// </summary>
+        /// <returns>A stream to be used for reading from the blob.</returns>
+        concurrency::streams::istream open_read()
+        {
+            return open_read_async().get();
+        }
+
+        /// <summary>
+        /// Opens a stream for reading from the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A stream to be used for reading from the blob.</returns>
+        concurrency::streams::istream open_read(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            return open_read_async(condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to open a stream for reading from the blob.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::istream" /> that represents the current operation.</returns>
+        pplx::task<concurrency::streams::istream> open_read_async()
+        {
+            return open_read_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to open a stream for reading from the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::istream" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<concurrency::streams::istream> open_read_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Checks existence of the blob.
+        /// </summary>
+        /// <returns><c>true</c> if the blob exists.</returns>
+        bool exists()
+        {
+            return exists_async().get();
+        }
+
+        /// <summary>
+        /// Checks existence of the blob.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns><c>true</c> if the blob exists.</returns>
+        bool exists(const blob_request_options& options, operation_context context)
+        {
+            return exists_async(options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to check the existence of the blob.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<bool> exists_async()
+        {
+            return exists_async(blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to check the existence of the blob.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<bool> exists_async(const blob_request_options& options, operation_context context)
+        {
+            return exists_async(false, options, context);
+        }
+
+        /// <summary>
+        /// Populates a blob's properties and metadata.
+        /// </summary>
+        void download_attributes()
+        {
+            download_attributes_async().wait();
+        }
+
+        /// <summary>
+        /// Populates a blob's properties and metadata.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_attributes(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            download_attributes_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to populate a blob's properties and metadata.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_attributes_async()
+        {
+            return download_attributes_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to populate a blob's properties and metadata.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> download_attributes_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Updates the blob's metadata.
+        /// </summary>
+        void upload_metadata()
+        {
+            upload_metadata_async().wait();
+        }
+
+        /// <summary>
+        /// Updates the blob's metadata.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_metadata(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            upload_metadata_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to update the blob's metadata.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_metadata_async()
+        {
+            return upload_metadata_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to update the blob's metadata.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_metadata_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Updates the blob's properties.
+        /// </summary>
+        void upload_properties()
+        {
+            upload_properties_async().wait();
+        }
+
+        /// <summary>
+        /// Updates the blob's properties.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_properties(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            upload_properties_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to update the blob's properties.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_properties_async()
+        {
+            return upload_properties_async(access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to update the blob's properties.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_properties_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Deletes the blob.
+        /// </summary>
+        void delete_blob()
+        {
+            delete_blob_async().wait();
+        }
+
+        /// <summary>
+        /// Deletes the blob.
+        /// </summary>
+        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void delete_blob(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            delete_blob_async(snapshots_option, condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the blob.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> delete_blob_async()
+        {
+            return delete_blob_async(delete_snapshots_option::none, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the blob.
+        /// </summary>
+        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> delete_blob_async(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Deletes the blob if it already exists.
+        /// </summary>
+        /// <returns><c>true</c> if the blob did already exist and was deleted; otherwise <c>false</c>.</returns>
+        bool delete_blob_if_exists()
+        {
+            return delete_blob_if_exists_async().get();
+        }
+
+        /// <summary>
+        /// Deletes the blob if it already exists.
+        /// </summary>
+        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns><c>true</c> if the blob did already exist and was deleted; otherwise <c>false</c>.</returns>
+        bool delete_blob_if_exists(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            return delete_blob_if_exists_async(snapshots_option, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the blob if it already exists.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<bool> delete_blob_if_exists_async()
+        {
+            return delete_blob_if_exists_async(delete_snapshots_option::none, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to delete the blob if it already exists.
+        /// </summary>
+        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<bool> delete_blob_if_exists_async(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Acquires a lease on the blob.
+        /// </summary>
+        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <returns>A string containing the lease ID.</returns>
+        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        {
+            return acquire_lease_async(duration, proposed_lease_id).get();
+        }
+
+        /// <summary>
+        /// Acquires a lease on the blob.
+        /// </summary>
+        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A string containing the lease ID.</returns>
+        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return acquire_lease_async(duration, proposed_lease_id, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to acquire a lease on the blob.
+        /// </summary>
+        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        {
+            return acquire_lease_async(duration, proposed_lease_id, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to acquire a lease on the blob.
+        /// </summary>
+        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
+        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Renews a lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        void renew_lease(const access_condition& condition) const
+        {
+            renew_lease_async(condition).wait();
+        }
+
+        /// <summary>
+        /// Renews a lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void renew_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            renew_lease_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to renew a lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> renew_lease_async(const access_condition& condition) const
+        {
+            return renew_lease_async(condition, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to renew a lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> renew_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Changes the lease ID on the blob.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <returns>The new lease ID.</returns>
+        utility::string_t change_lease(const utility::string_t& proposed_lease_id, const access_condition& condition) const
+        {
+            return change_lease_async(proposed_lease_id, condition).get();
+        }
+
+        /// <summary>
+        /// Changes the lease ID on the blob.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The new lease ID.</returns>
+        utility::string_t change_lease(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return change_lease_async(proposed_lease_id, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to change the lease ID on the blob.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id, const access_condition& condition) const
+        {
+            return change_lease_async(proposed_lease_id, condition, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to change the lease ID on the blob.
+        /// </summary>
+        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Releases the lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        void release_lease(const access_condition& condition) const
+        {
+            release_lease_async(condition).wait();
+        }
+
+        /// <summary>
+        /// Releases the lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void release_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            release_lease_async(condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to release the lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> release_lease_async(const access_condition& condition) const
+        {
+            return release_lease_async(condition, blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to release the lease on the blob.
+        /// </summary>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> release_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Breaks the current lease on the blob.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <returns>The time until the lease ends, in seconds.</returns>
+        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period) const
+        {
+            return break_lease_async(break_period).get();
+        }
+
+        /// <summary>
+        /// Breaks the current lease on the blob.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The time until the lease ends, in seconds.</returns>
+        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return break_lease_async(break_period, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to break the current lease on the blob.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
+        pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period) const
+        {
+            return break_lease_async(break_period, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to break the current lease on the blob.
+        /// </summary>
+        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Downloads the contents of a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        void download_to_stream(concurrency::streams::ostream target)
+        {
+            download_to_stream_async(target).wait();
+        }
+
+        /// <summary>
+        /// Downloads the contents of a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_to_stream(concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            download_to_stream_async(target, condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download the contents of a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_to_stream_async(concurrency::streams::ostream target)
+        {
+            return download_to_stream_async(target, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download the contents of a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_to_stream_async(concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            return download_range_to_stream_async(target, -1, -1, condition, options, context);
+        }
+
+        /// <summary>
+        /// Downloads the contents of a blob to a file.
+        /// </summary>
+        /// <param name="path">The target file.</param>
+        void download_to_file(const utility::string_t& path)
+        {
+            download_to_file_async(path).wait();
+        }
+
+        /// <summary>
+        /// Downloads the contents of a blob to a file.
+        /// </summary>
+        /// <param name="path">The target file.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_to_file(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            download_to_file_async(path, condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download the contents of a blob to a file.
+        /// </summary>
+        /// <param name="path">The target file.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_to_file_async(const utility::string_t& path)
+        {
+            return download_to_file_async(path, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download the contents of a blob to a file.
+        /// </summary>
+        /// <param name="path">The target file.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The file is created, or truncated if it exists, preallocated to the size of the blob and written through a memory mapping.
+        /// The download is conditional on the ETag of the blob not changing after its size is read.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> download_to_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Downloads a range of bytes in a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        void download_range_to_stream(concurrency::streams::ostream target, int64_t offset, int64_t length)
+        {
+            download_range_to_stream_async(target, offset, length).wait();
+        }
+
+        /// <summary>
+        /// Downloads a range of bytes in a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_range_to_stream(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            download_range_to_stream_async(target, offset, length, condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download a range of bytes in a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_range_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length)
+        {
+            return download_range_to_stream_async(target, offset, length, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download a range of bytes in a blob to a stream.
+        /// </summary>
+        /// <param name="target">The target stream.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> download_range_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Downloads a range of bytes in a blob straight into a buffer.
+        /// </summary>
+        /// <param name="buffer">The buffer that receives the data, which must hold at least <paramref name="length" /> bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <returns>The number of bytes downloaded, which is less than <paramref name="length" /> if the blob ends before the range does.</returns>
+        size_t download_range_to_buffer(uint8_t* buffer, size_t length, int64_t offset)
+        {
+            return download_range_to_buffer_async(buffer, length, offset).get();
+        }
+
+        /// <summary>
+        /// Downloads a range of bytes in a blob straight into a buffer.
+        /// </summary>
+        /// <param name="buffer">The buffer that receives the data, which must hold at least <paramref name="length" /> bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The number of bytes downloaded, which is less than <paramref name="length" /> if the blob ends before the range does.</returns>
+        size_t download_range_to_buffer(uint8_t* buffer, size_t length, int64_t offset, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            return download_range_to_buffer_async(buffer, length, offset, condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download a range of bytes in a blob straight into a buffer.
+        /// </summary>
+        /// <param name="buffer">The buffer that receives the data, which must hold at least <paramref name="length" /> bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes with the number of bytes downloaded.</returns>
+        pplx::task<size_t> download_range_to_buffer_async(uint8_t* buffer, size_t length, int64_t offset)
+        {
+            return download_range_to_buffer_async(buffer, length, offset, access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to download a range of bytes in a blob straight into a buffer.
+        /// </summary>
+        /// <param name="buffer">The buffer that receives the data, which must hold at least <paramref name="length" /> bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes with the number of bytes downloaded.</returns>
+        /// <remarks>
+        /// The response bodies are read directly into the buffer, which must stay valid until the task completes. If the
+        /// <see cref="blob_request_options::parallelism_factor" /> is greater than 1, the range is split into sub-ranges of
+        /// <see cref="blob_request_options::stream_read_size_in_bytes" /> bytes, and each of them is written to its own part
+        /// of the buffer as it arrives. Only the properties returned for the first sub-range are kept.
+        /// </remarks>
+        WASTORAGE_API pplx::task<size_t> download_range_to_buffer_async(uint8_t* buffer, size_t length, int64_t offset, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <returns>The copy ID associated with the copy operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        utility::string_t start_copy_from_blob(const web::http::uri& source)
+        {
+            return start_copy_from_blob_async(source).get();
+        }
+
+        /// <summary>
+        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <param name="source_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the source blob.</param>
+        /// <param name="destination_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the destination blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The copy ID associated with the copy operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        utility::string_t start_copy_from_blob(const web::http::uri& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context)
+        {
+            return start_copy_from_blob_async(source, source_condition, destination_condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <returns>The copy ID associated with the copy operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        utility::string_t start_copy_from_blob(const cloud_blob& source)
+        {
+            return start_copy_from_blob_async(source).get();
+        }
+
+        /// <summary>
+        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <param name="source_condition">An object that represents the <see cref="access_condition" /> for the source blob.</param>
+        /// <param name="destination_condition">An object that represents the <see cref="access_condition" /> for the destination blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>The copy ID associated with the copy operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        utility::string_t start_copy_from_blob(const cloud_blob& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context)
+        {
+            return start_copy_from_blob_async(source, source_condition, destination_condition, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        pplx::task<utility::string_t> start_copy_from_blob_async(const web::http::uri& source)
+        {
+            return start_copy_from_blob_async(source, access_condition(), access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        pplx::task<utility::string_t> start_copy_from_blob_async(const cloud_blob& source)
+        {
+            return start_copy_from_blob_async(source, access_condition(), access_condition(), blob_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <param name="source_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the source blob.</param>
+        /// <param name="destination_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the destination blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        WASTORAGE_API pplx::task<utility::string_t> start_copy_from_blob_async(const web::http::uri& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// </summary>
+        /// <param name="source">The URI of a source blob.</param>
+        /// <param name="source_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the source blob.</param>
+        /// <param name="destination_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the destination blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
+        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
+        /// </remarks>
+        WASTORAGE_API pplx::task<utility::string_t> start_copy_from_blob_async(const cloud_blob& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Aborts an ongoing blob copy operation.
+        /// </summary>
+        /// <param name="copy_id">A string identifying the copy operation.</param>
+        void abort_copy(const utility::string_t& copy_id) const
+        {
+            abort_copy_async(copy_id).wait();
+        }
+
+        /// <summary>
+        /// Aborts an ongoing blob copy operation.
+        /// </summary>
+        /// <param name="copy_id">A string identifying the copy operation.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void abort_copy(const utility::string_t& copy_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            abort_copy_async(copy_id, condition, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to abort an ongoing blob copy operation.
         /// </summary>
+        /// <param name="copy_id">A string identifying the copy operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> download_attributes_async()
+        pplx::task<void> abort_copy_async(const utility::string_t& copy_id) const
         {
-            return download_attributes_async(access_condition(), blob_request_options(), operation_context());
+            return abort_copy_async(copy_id, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to retrieve the container's attributes.
+        /// Returns a task that performs an asynchronous operation to abort an ongoing blob copy operation.
         /// </summary>
+        /// <param name="copy_id">A string identifying the copy operation.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> download_attributes_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        WASTORAGE_API pplx::task<void> abort_copy_async(const utility::string_t& copy_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
 
         /// <summary>
-        /// Sets the container's user-defined metadata.
+        /// Creates a snapshot of the blob.
         /// </summary>
-        void upload_metadata()
+        /// <returns>A blob snapshot.</returns>
+        cloud_blob create_snapshot()
         {
-            upload_metadata_async().wait();
+            return create_snapshot_async().get();
         }
 
         /// <summary>
-        /// Sets the container's user-defined metadata.
+        /// Creates a snapshot of the blob.
         /// </summary>
+        /// <param name="metadata">A collection of name-value pairs defining the metadata of the snapshot.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_metadata(const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>A blob snapshot.</returns>
+        cloud_blob create_snapshot(const cloud_metadata& metadata, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            upload_metadata_async(condition, options, context).wait();
+            return create_snapshot_async(metadata, condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set the container's user-defined metadata.
+        /// Returns a task that performs an asynchronous operation to create a snapshot of the blob.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_metadata_async()
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::cloud_blob" /> that represents the current operation.</returns>
+        pplx::task<wa::storage::cloud_blob> create_snapshot_async()
         {
-            return upload_metadata_async(access_condition(), blob_request_options(), operation_context());
+            return create_snapshot_async(cloud_metadata(), access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set the container's user-defined metadata.
+        /// Returns a task that performs an asynchronous operation to create a snapshot of the blob.
         /// </summary>
+        /// <param name="metadata">A collection of name-value pairs defining the metadata of the snapshot.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_metadata_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::cloud_blob" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<wa::storage::cloud_blob> create_snapshot_async(const cloud_metadata& metadata, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Acquires a lease on the container.
+        /// Gets the <see cref="wa::storage::cloud_blob_client" /> object that represents the Blob service.
         /// </summary>
-        /// <param name="duration">A <see cref="wa::storage::lease_time"/> representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
-        /// <returns>A string containing the ID of the acquired lease.</returns>
-        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        /// <returns>A client object that specifies the Blob service endpoint.</returns>
+        const cloud_blob_client& service_client() const
         {
-            return acquire_lease_async(duration, proposed_lease_id).get();
+            return m_container.service_client();
         }
 
         /// <summary>
-        /// Acquires a lease on the container.
+        /// Gets a <see cref="wa::storage::cloud_blob_container" /> object representing the blob's container.
         /// </summary>
-        /// <param name="duration">A <see cref="wa::storage::lease_time"/> representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A string containing the ID of the acquired lease.</returns>
-        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <returns>The blob's container.</returns>
+        const cloud_blob_container& container() const
         {
-            return acquire_lease_async(duration, proposed_lease_id, condition, options, context).get();
+            return m_container;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to acquire a lease on the container.
+        /// Gets the blob's system properties.
         /// </summary>
-        /// <param name="duration">A <see cref="wa::storage::lease_time"/> object representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed..</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        /// <returns>The blob's properties.</returns>
+        cloud_blob_properties& properties()
         {
-            return acquire_lease_async(duration, proposed_lease_id, access_condition(), blob_request_options(), operation_context());
+            return *m_properties;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to acquire a lease on the container.
+        /// Gets the blob's system properties.
         /// </summary>
-        /// <param name="duration">A <see cref="wa::storage::lease_time"/> representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns>The blob's properties.</returns>
+        const cloud_blob_properties& properties() const
+        {
+            return *m_properties;
+        }
 
         /// <summary>
-        /// Renews a lease on the container.
+        /// Gets the user-defined metadata for the blob.
         /// </summary>
-        void renew_lease() const
+        /// <returns>The blob's metadata, as a collection of name-value pairs.</returns>
+        cloud_metadata& metadata()
         {
-            renew_lease_async().wait();
+            return *m_metadata;
         }
 
         /// <summary>
-        /// Renews a lease on the container.
+        /// Gets the user-defined metadata for the blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void renew_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <returns>The blob's metadata, as a collection of name-value pairs.</returns>
+        const cloud_metadata& metadata() const
         {
-            renew_lease_async(condition, options, context).wait();
+            return *m_metadata;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to renew a lease on the container.
+        /// Gets the date and time that the blob snapshot was taken, if this blob is a snapshot.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> renew_lease_async() const
+        /// <returns>The blob's snapshot time, if the blob is a snapshot; otherwise, returns an empty string.</returns>
+        const utility::string_t& snapshot_time() const
         {
-            return renew_lease_async(access_condition(), blob_request_options(), operation_context());
+            return m_snapshot_time;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to renew a lease on the container.
+        /// Gets a value indicating whether this blob is a snapshot.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> renew_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns><c>true</c> if this blob is a snapshot; otherwise, <c>false</c>.</returns>
+        bool is_snapshot() const
+        {
+            return !m_snapshot_time.empty();
+        }
 
         /// <summary>
-        /// Changes the lease ID for a lease on the container.
+        /// Gets the state of the most recent or pending copy operation.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <returns>The new lease ID.</returns>
-        utility::string_t change_lease(const utility::string_t& proposed_lease_id) const
+        /// <returns>A <see cref="wa::storage::copy_state" /> object containing the copy state.</returns>
+        const wa::storage::copy_state& copy_state() const
         {
-            return change_lease_async(proposed_lease_id).get();
+            return *m_copy_state;
         }
 
         /// <summary>
-        /// Changes the lease ID for a lease on the container.
+        /// Gets the blob URI for all locations.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The new lease ID.</returns>
-        utility::string_t change_lease(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <returns>A <see cref="storage_uri" /> containing the blob URI for all locations.</returns>
+        const storage_uri& uri() const
         {
-            return change_lease_async(proposed_lease_id, condition, options, context).get();
+            return m_lazy_uri ? lazy_uri() : m_uri;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to change the lease ID for a lease on the container.
+        /// Gets the blob's name.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id) const
+        /// <returns>The blob's name.</returns>
+        const utility::string_t& name() const
         {
-            return change_lease_async(proposed_lease_id, access_condition(), blob_request_options(), operation_context());
+            return m_name;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to change the lease ID for a lease on the container.
+        /// Gets the type of the blob.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns>The type of the blob.</returns>
+        blob_type type() const
+        {
+            return m_properties->type();
+        }
 
         /// <summary>
-        /// Releases a lease on the container.
+        /// Indicates whether the <see cref="cloud_blob" /> object is valid.
         /// </summary>
-        void release_lease() const
+        /// <returns><c>true</c> if the <see cref="cloud_blob" /> object is valid; otherwise, <c>false</c>.</returns>
+        bool is_valid() const
         {
-            release_lease_async().wait();
+            return !m_name.empty();
         }
 
         /// <summary>
-        /// Releases a lease on the container.
+        /// Removes the cached attributes of the blob from the cache of the service client. This method is used internally.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void release_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        void _remove_cached_attributes() const;
+
+        /// <summary>
+        /// Removes the cached listing segments the blob appears in from the cache of the service client. This method is used internally.
+        /// </summary>
+        void _remove_cached_listings() const;
+
+    protected:
+
+        void assert_no_snapshot() const;
+        pplx::task<void> download_single_range_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context, bool update_properties);
+
+        void set_type(blob_type value)
+        {
+            m_properties->set_type(value);
+        }
+
+        std::shared_ptr<cloud_blob_properties> m_properties;
+        std::shared_ptr<cloud_metadata> m_metadata;
+        std::shared_ptr<wa::storage::copy_state> m_copy_state;
+
+    private:
+
+        // The properties, metadata and copy state share one allocation, and copies of the blob share all of it.
+        // For a blob that was created from its container and name, the URI is built here the first time it is used.
+        struct shared_state
+        {
+            shared_state()
+            {
+            }
+
+            shared_state(cloud_blob_properties properties, cloud_metadata metadata, wa::storage::copy_state copy_state)
+                : properties(std::move(properties)), metadata(std::move(metadata)), copy_state(std::move(copy_state))
+            {
+            }
+
+            cloud_blob_properties properties;
+            cloud_metadata metadata;
+            wa::storage::copy_state copy_state;
+            std::once_flag uri_flag;
+            storage_uri uri;
+        };
+
+        void init(const utility::string_t& snapshot_time, storage_credentials credentials);
+        void set_shared_state(std::shared_ptr<shared_state> state);
+        WASTORAGE_API const storage_uri& lazy_uri() const;
+        WASTORAGE_API pplx::task<bool> exists_async(bool primary_only, const blob_request_options& options, operation_context context);
+        pplx::task<void> download_parallel_ranges_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+        pplx::task<void> download_cached_to_stream_async(std::shared_ptr<core::blob_content_cache> cache, concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+        pplx::task<void> download_range_to_stream_impl_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+        pplx::task<void> download_coalesced_to_stream_async(std::shared_ptr<core::request_coalescer> coalescer, concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+        pplx::task<void> download_attributes_impl_async(const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+        pplx::task<void> download_attributes_coalesced_async(std::shared_ptr<core::request_coalescer> coalescer, const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+
+        storage_uri m_uri;
+        utility::string_t m_name;
+        utility::string_t m_snapshot_time;
+        cloud_blob_container m_container;
+        std::shared_ptr<shared_state> m_state;
+        bool m_lazy_uri;
+    };
+
+    /// <summary>
+    /// Represents an item returned by a blob listing, which is either a blob or a virtual directory.
+    /// </summary>
+    class list_blob_item
+    {
+    public:
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::list_blob_item" /> class that represents a blob.
+        /// </summary>
+        /// <param name="blob">The listed blob.</param>
+        explicit list_blob_item(cloud_blob blob)
+            : m_is_blob(true), m_blob(std::move(blob))
         {
-            release_lease_async(condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to release a lease on the container.
+        /// Initializes a new instance of the <see cref="wa::storage::list_blob_item" /> class that represents a virtual directory.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> release_lease_async() const
+        /// <param name="directory">The listed virtual directory.</param>
+        explicit list_blob_item(cloud_blob_directory directory)
+            : m_is_blob(false), m_directory(std::move(directory))
         {
-            return release_lease_async(access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to release a lease on the container.
+        /// Gets a value indicating whether this item is a blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> release_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns><c>true</c> if the item is a blob; <c>false</c> if it is a virtual directory.</returns>
+        bool is_blob() const
+        {
+            return m_is_blob;
+        }
 
         /// <summary>
-        /// Breaks the current lease on the container.
+        /// Gets the item as a blob.
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <returns>The time until the lease ends, in seconds.</returns>
-        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period) const
+        /// <returns>A reference to a <see cref="wa::storage::cloud_blob" /> object.</returns>
+        const cloud_blob& as_blob() const
         {
-            return break_lease_async(break_period).get();
+            return m_blob;
         }
 
         /// <summary>
-        /// Breaks the current lease on the container.
+        /// Gets the item as a virtual directory.
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The time until the lease ends, in seconds.</returns>
-        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <returns>A reference to a <see cref="wa::storage::cloud_blob_directory" /> object.</returns>
+        const cloud_blob_directory& as_directory() const
         {
-            return break_lease_async(break_period, condition, options, context).get();
+            return m_directory;
         }
 
+    private:
+
+        bool m_is_blob;
+        cloud_blob m_blob;
+        cloud_blob_directory m_directory;
+    };
+
+    /// <summary>
+    /// Compresses and decompresses the blocks of a blob, each on its own, for <see cref="wa::storage::cloud_block_blob::upload_compressed_from_stream_async" />.
+    /// </summary>
+    /// <remarks>
+    /// The methods are called for several blocks at the same time, so they must be thread-safe. Each compressed block must be a complete frame of the
+    /// content encoding, such as a gzip member or a zstd frame, so that the frames of all blocks together are a valid encoding of the whole content.
+    /// </remarks>
+    class block_codec
+    {
+    public:
+
+        virtual ~block_codec() {}
+
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to break the current lease on the container.
+        /// Gets the value of the Content-Encoding property of a blob that is uploaded with the codec, such as "gzip".
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
-        pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period) const
-        {
-            return break_lease_async(break_period, access_condition(), blob_request_options(), operation_context());
-        }
+        /// <returns>The content encoding.</returns>
+        virtual utility::string_t content_encoding() const = 0;
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to break the current lease on the container.
+        /// Compresses the content of a block into a complete frame.
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation, including a required lease ID.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <param name="data">The content of the block.</param>
+        /// <param name="length">The length of the content, in bytes.</param>
+        /// <returns>The compressed frame.</returns>
+        virtual std::vector<uint8_t> compress(const uint8_t* data, size_t length) = 0;
 
         /// <summary>
-        /// Creates the container.
+        /// Decompresses one or more complete frames.
         /// </summary>
-        void create()
-        {
-            create_async().wait();
-        }
+        /// <param name="data">The compressed frames.</param>
+        /// <param name="length">The length of the compressed frames, in bytes.</param>
+        /// <returns>The content of the frames.</returns>
+        virtual std::vector<uint8_t> decompress(const uint8_t* data, size_t length) = 0;
+    };
 
+    /// <summary>
+    /// Represents a blob that is uploaded as a set of blocks.
+    /// </summary>
+    class cloud_block_blob : public cloud_blob
+    {
+    public:
         /// <summary>
-        /// Creates the container and specifies the level of access to the container's data.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
         /// </summary>
-        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object
-        /// is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
-        void create(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context)
+        cloud_block_blob()
+            : cloud_blob()
         {
-            create_async(public_access, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create the container.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> create_async()
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        cloud_block_blob(const storage_uri& uri)
+            : cloud_blob(uri)
         {
-            return create_async(blob_container_public_access_type::off, blob_request_options(), operation_context());
+            set_type(blob_type::block_blob);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create the container.
-        /// </summary>
-        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> create_async(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context);
-
-        /// <summary>
-        /// Creates the container if it does not already exist.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
         /// </summary>
-        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
-        bool create_if_not_exists()
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        cloud_block_blob(const storage_uri& uri, const storage_credentials& credentials)
+            : cloud_blob(uri, credentials)
         {
-            return create_if_not_exists_async().get();
+            set_type(blob_type::block_blob);
         }
 
         /// <summary>
-        /// Creates the container if it does not already exist and specifies the level of public access to the container's data.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
         /// </summary>
-        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
-        bool create_if_not_exists(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context)
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        cloud_block_blob(const storage_uri& uri, const utility::string_t& snapshot_time, const storage_credentials& credentials)
+            : cloud_blob(uri, snapshot_time, credentials)
         {
-            return create_if_not_exists_async(public_access, options, context).get();
+            set_type(blob_type::block_blob);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create the container if it does not already exist.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<bool> create_if_not_exists_async()
+        /// <param name="name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <param name="container">A reference to the parent container.</param>
+        cloud_block_blob(const utility::string_t& name, const utility::string_t& snapshot_time, const cloud_blob_container& container)
+            : cloud_blob(name, snapshot_time, container)
         {
-            return create_if_not_exists_async(blob_container_public_access_type::off, blob_request_options(), operation_context());
+            set_type(blob_type::block_blob);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create the container if it does not already exist and specify the level of public access to the container's data.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class.
         /// </summary>
-        /// <param name="public_access">A <see cref="wa::storage::blob_container_public_access_type"/> value that specifies whether data in the container may be accessed publicly and what level of access is to be allowed.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<bool> create_if_not_exists_async(blob_container_public_access_type public_access, const blob_request_options& options, operation_context context);
+        /// <param name="blob">Reference to the blob.</param>
+        cloud_block_blob(const cloud_blob& blob)
+            : cloud_blob(blob)
+        {
+            set_type(blob_type::block_blob);
+        }
 
         /// <summary>
-        /// Deletes the container.
+        /// Opens a stream for writing to the block blob.
         /// </summary>
-        void delete_container()
+        /// <returns>A stream to be used for writing to the blob.</returns>
+        concurrency::streams::ostream open_write()
         {
-            delete_container_async().wait();
+            return open_write_async().get();
         }
 
         /// <summary>
-        /// Deletes the container.
+        /// Opens a stream for writing to the block blob.
         /// </summary>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void delete_container(const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>A stream to be used for writing to the blob.</returns>
+        concurrency::streams::ostream open_write(const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            delete_container_async(condition, options, context).wait();
+            return open_write_async(condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the container.
+        /// Returns a task that performs an asynchronous operation to open a stream for writing to the block blob.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> delete_container_async()
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
+        pplx::task<concurrency::streams::ostream> open_write_async()
         {
-            return delete_container_async(access_condition(), blob_request_options(), operation_context());
+            return open_write_async(access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the container.
+        /// Returns a task that performs an asynchronous operation to open a stream for writing to the block blob.
         /// </summary>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> delete_container_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<concurrency::streams::ostream> open_write_async(const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Deletes the container if it already exists.
+        /// Returns an enumerable collection of the blob's blocks, using the specified block list filter.
         /// </summary>
-        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
-        bool delete_container_if_exists()
+        /// <returns>An enumerable collection of objects implementing <see cref="wa::storage::block_list_item" />.</returns>
+        std::vector<block_list_item> download_block_list() const
         {
-            return delete_container_if_exists_async().get();
+            return download_block_list_async().get();
         }
 
         /// <summary>
-        /// Deletes the container if it already exists.
+        /// Returns an enumerable collection of the blob's blocks, using the specified block list filter.
         /// </summary>
+        /// <param name="listing_filter">One of the enumeration values that indicates whether to return
+        /// committed blocks, uncommitted blocks, or both.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
-        bool delete_container_if_exists(const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>An enumerable collection of objects implementing <see cref="wa::storage::block_list_item" />.</returns>
+        std::vector<block_list_item> download_block_list(block_listing_filter listing_filter, const access_condition& condition, const blob_request_options& options, operation_context context) const
         {
-            return delete_container_if_exists_async(condition, options, context).get();
+            return download_block_list_async(listing_filter, condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the container if it already exists.
+        /// Returns a task that performs an asynchronous operation to return an enumerable collection of the blob's blocks, 
+        /// using the specified block list filter.
         /// </summary>
-        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<bool> delete_container_if_exists_async()
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="block_list_item" />, that represents the current operation.</returns>
+        pplx::task<std::vector<block_list_item>> download_block_list_async() const
         {
-            return delete_container_if_exists_async(access_condition(), blob_request_options(), operation_context());
+            return download_block_list_async(block_listing_filter::committed, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the container if it already exists.
+        /// Returns a task that performs an asynchronous operation to return an enumerable collection of the blob's blocks, 
+        /// using the specified block list filter.
         /// </summary>
+        /// <param name="listing_filter">One of the enumeration values that indicates whether to return
+        /// committed blocks, uncommitted blocks, or both.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns><c>true</c> if the container did not already exist and was created; otherwise <c>false</c>.</returns>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<bool> delete_container_if_exists_async(const access_condition& condition, const blob_request_options& options, operation_context context);
-
-        /// <summary>
-        /// Returns a result segment containing a collection of blob items in the container.
-        /// </summary>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
-        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
-        blob_result_segment list_blobs_segmented(const blob_continuation_token& current_token) const
-        {
-            return list_blobs_segmented_async(current_token).get();
-        }
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="block_list_item" />, that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<std::vector<block_list_item>> download_block_list_async(block_listing_filter listing_filter, const access_condition& condition, const blob_request_options& options, operation_context context) const;
 
         /// <summary>
-        /// Returns a result segment containing a collection of blob items in the container.
+        /// Downloads the blob's contents as a string.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
-        /// <returns>A result segment containing objects that implement <see cref="wa::storage::cloud_blob" /> and <see cref="wa::storage::cloud_blob_directory" />.</returns>
-        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        /// <returns>The contents of the blob, as a string.</returns>
+        utility::string_t download_text()
         {
-            return list_blobs_segmented_async(prefix, current_token).get();
+            return download_text_async().get();
         }
 
         /// <summary>
-        /// Returns a result segment containing a collection of blob items in the container.
+        /// Downloads the blob's contents as a string.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
-        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
-        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
-        blob_result_segment list_blobs_segmented(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
-        {
-            return list_blobs_segmented_async(prefix, use_flat_blob_listing, includes, max_results, current_token, options, context).get();
-        }
-
-        /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
-        /// in the container.
-        /// </summary>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
-        pplx::task<blob_result_segment> list_blobs_segmented_async(const blob_continuation_token& current_token) const
+        /// <returns>The contents of the blob, as a string.</returns>
+        utility::string_t download_text(const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return list_blobs_segmented_async(utility::string_t(), current_token);
+            return download_text_async(condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
-        /// in the container.
+        /// Returns a task that performs an asynchronous operation to download the blob's contents as a string.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
-        pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, const blob_continuation_token& current_token) const
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        pplx::task<utility::string_t> download_text_async()
         {
-            return list_blobs_segmented_async(prefix, false, blob_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+            return download_text_async(access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
-        /// in the container.
+        /// Returns a task that performs an asynchronous operation to download the blob's contents as a string.
         /// </summary>
-        /// <param name="prefix">The blob name prefix.</param>
-        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
-        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
-        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<blob_result_segment> list_blobs_segmented_async(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<utility::string_t> download_text_async(const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Sets permissions for the container.
+        /// Uploads a single block.
         /// </summary>
-        /// <param name="permissions">The permissions to apply to the container.</param>
-        void upload_permissions(const blob_container_permissions& permissions)
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">A stream that provides the data for the block.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
+        void upload_block(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5) const
         {
-            upload_permissions_async(permissions).wait();
+            upload_block_async(block_id, block_data, content_md5).wait();
         }
 
         /// <summary>
-        /// Sets permissions for the container.
+        /// Uploads a single block.
         /// </summary>
-        /// <param name="permissions">The permissions to apply to the container.</param>
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">A stream that provides the data for the block.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_permissions(const blob_container_permissions& permissions, const access_condition& condition, const blob_request_options& options, operation_context context)
+        void upload_block(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const
         {
-            upload_permissions_async(permissions, condition, options, context).wait();
+            upload_block_async(block_id, block_data, content_md5, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set permissions for the container.
+        /// Returns a task that performs an asynchronous operation to upload a single block.
         /// </summary>
-        /// <param name="permissions">The permissions to apply to the container.</param>
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">A stream that provides the data for the block.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_permissions_async(const blob_container_permissions& permissions)
+        pplx::task<void> upload_block_async(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5) const
         {
-            return upload_permissions_async(permissions, access_condition(), blob_request_options(), operation_context());
+            return upload_block_async(block_id, block_data, content_md5, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set permissions for the container.
+        /// Returns a task that performs an asynchronous operation to upload a single block.
         /// </summary>
-        /// <param name="permissions">The permissions to apply to the container.</param>
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">A stream that provides the data for the block.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_permissions_async(const blob_container_permissions& permissions, const access_condition& condition, const blob_request_options& options, operation_context context);
+        WASTORAGE_API pplx::task<void> upload_block_async(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const;
 
         /// <summary>
-        /// Gets the permissions settings for the container.
+        /// Uploads a single block whose data is the concatenation of a list of buffers.
         /// </summary>
-        /// <returns>The container's permissions.</returns>
-        blob_container_permissions download_permissions()
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">The buffers that provide the data for the block, in order.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
+        void upload_block(const utility::string_t& block_id, const std::vector<const_buffer>& block_data, const utility::string_t& content_md5) const
         {
-            return download_permissions_async().get();
+            upload_block_async(block_id, block_data, content_md5).wait();
         }
 
         /// <summary>
-        /// Gets the permissions settings for the container.
+        /// Uploads a single block whose data is the concatenation of a list of buffers.
         /// </summary>
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">The buffers that provide the data for the block, in order.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The container's permissions.</returns>
-        blob_container_permissions download_permissions(const access_condition& condition, const blob_request_options& options, operation_context context)
+        void upload_block(const utility::string_t& block_id, const std::vector<const_buffer>& block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const
         {
-            return download_permissions_async(condition, options, context).get();
+            upload_block_async(block_id, block_data, content_md5, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get permissions settings for the container.
+        /// Returns a task that performs an asynchronous operation to upload a single block whose data is the concatenation of a list of buffers.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_container_permissions" /> that represents the current operation.</returns>
-        pplx::task<blob_container_permissions> download_permissions_async()
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">The buffers that provide the data for the block, in order.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_block_async(const utility::string_t& block_id, const std::vector<const_buffer>& block_data, const utility::string_t& content_md5) const
         {
-            return download_permissions_async(access_condition(), blob_request_options(), operation_context());
+            return upload_block_async(block_id, block_data, content_md5, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get permissions settings for the container.
+        /// Returns a task that performs an asynchronous operation to upload a single block whose data is the concatenation of a list of buffers.
         /// </summary>
+        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
+        /// <param name="block_data">The buffers that provide the data for the block, in order.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_container_permissions" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<blob_container_permissions> download_permissions_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>The buffers are sent as they are, without being copied into one, so the memory they refer to must stay valid
+        /// and unchanged until the task completes. Any MD5 or CRC64 hash is calculated across all of them.</remarks>
+        WASTORAGE_API pplx::task<void> upload_block_async(const utility::string_t& block_id, const std::vector<const_buffer>& block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const;
 
         /// <summary>
-        /// Checks existence of the container.
+        /// Uploads a list of blocks to a new or existing blob. 
         /// </summary>
-        /// <returns><c>true</c> if the container exists.</returns>
-        bool exists()
+        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
+        void upload_block_list(const std::vector<block_list_item>& block_list)
         {
-            return exists_async().get();
+            upload_block_list_async(block_list).wait();
         }
 
         /// <summary>
-        /// Checks existence of the container.
+        /// Uploads a list of blocks to a new or existing blob. 
         /// </summary>
+        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns><c>true</c> if the container exists.</returns>
-        bool exists(const blob_request_options& options, operation_context context)
+        void upload_block_list(const std::vector<block_list_item>& block_list, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return exists_async(options, context).get();
+            upload_block_list_async(block_list, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to check the existence of the container.
+        /// Returns a task that performs an asynchronous operation to upload a list of blocks to a new or existing blob. 
         /// </summary>
+        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<bool> exists_async()
+        pplx::task<void> upload_block_list_async(const std::vector<block_list_item>& block_list)
         {
-            return exists_async(blob_request_options(), operation_context());
+            return upload_block_list_async(block_list, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to check the existence of the container.
+        /// Returns a task that performs an asynchronous operation to upload a list of blocks to a new or existing blob. 
         /// </summary>
+        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that that represents the current operation.</returns>
-        pplx::task<bool> exists_async(const blob_request_options& options, operation_context context)
-        {
-            return exists_async(false, options, context);
-        }
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_block_list_async(const std::vector<block_list_item>& block_list, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Gets the service client for the container.
+        /// Uploads a stream to a block blob.
         /// </summary>
-        /// <returns>A <see cref="cloud_blob_client" /> object that specifies the endpoint for the Blob service.</returns>
-        const cloud_blob_client& service_client() const
+        /// <param name="source">The stream providing the blob content.</param>
+        void upload_from_stream(concurrency::streams::istream source)
         {
-            return m_client;
+            upload_from_stream_async(source).wait();
         }
 
         /// <summary>
-        /// Gets the container URI for all locations.
+        /// Uploads a stream to a block blob.
         /// </summary>
-        /// <returns>A <see cref="storage_uri" /> containing the container URI for all locations.</returns>
-        const storage_uri& uri() const
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_from_stream(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return m_uri;
+            upload_from_stream_async(source, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Gets the name of the container.
+        /// Uploads a stream to a block blob.
         /// </summary>
-        /// <returns>A string containing the container name.</returns>
-        const utility::string_t& name() const
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length)
         {
-            return m_name;
+            upload_from_stream_async(source, length).wait();
         }
 
         /// <summary>
-        /// Gets the container's metadata.
+        /// Uploads a stream to a block blob.
         /// </summary>
-        /// <returns>A <see cref="cloud_metadata" /> object containing the container's metadata.</returns>
-        cloud_metadata& metadata()
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return *m_metadata;
+            upload_from_stream_async(source, length, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Gets the container's metadata.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
         /// </summary>
-        /// <returns>A <see cref="cloud_metadata" /> object containing the container's metadata.</returns>
-        const cloud_metadata& metadata() const
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source)
         {
-            return *m_metadata;
+            return upload_from_stream_async(source, protocol::invalid_size64_t);
         }
 
         /// <summary>
-        /// Gets the container's system properties.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
         /// </summary>
-        /// <returns>The container's properties.</returns>
-        const cloud_blob_container_properties& properties() const
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return *m_properties;
+            return upload_from_stream_async(source, protocol::invalid_size64_t, condition, options, context);
         }
 
         /// <summary>
-        /// Indicates whether the <see cref="cloud_blob_container" /> object is valid.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
         /// </summary>
-        /// <returns><c>true</c> if the <see cref="cloud_blob_container" /> object is valid; otherwise, <c>false</c>.</returns>
-        bool is_valid() const
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length)
         {
-            return !m_name.empty();
+            return upload_from_stream_async(source, length, access_condition(), blob_request_options(), operation_context());
         }
 
-    private:
-
-        void init(const storage_credentials& credentials);
-        WASTORAGE_API pplx::task<bool> exists_async(bool primary_only, const blob_request_options& options, operation_context context);
-
-        storage_uri m_uri;
-        utility::string_t m_name;
-        cloud_blob_client m_client;
-        std::shared_ptr<cloud_metadata> m_metadata;
-        std::shared_ptr<cloud_blob_container_properties> m_properties;
-    };
-
-    /// <summary>
-    /// Represents a virtual directory of blobs, designated by a delimiter character.
-    /// </summary>
-    /// <remarks>Containers, which are encapsulated as <see cref="wa::storage::cloud_blob_container" /> objects, hold directories, and directories hold block blobs and page blobs. Directories can also contain sub-directories.</remarks>
-    class cloud_blob_directory
-    {
-    public:
-        /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_directory" /> class.
-        /// </summary>
-        cloud_blob_directory() {}
-
-        /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob_directory" /> class.
-        /// </summary>
-        /// <param name="name">Name of the virtual directory.</param>
-        /// <param name="container">The container.</param>
-        cloud_blob_directory(const utility::string_t& name, const cloud_blob_container& container);
-
-        /// <summary>
-        /// Gets a reference to a blob in this virtual directory.
-        /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
-        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name) const;
-
-        /// <summary>
-        /// Gets a reference to a blob in this virtual directory.
-        /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <returns>A reference to a <see cref="cloud_blob" />.</returns>
-        WASTORAGE_API cloud_blob get_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
-
-        /// <summary>
-        /// Gets a reference to a page blob in this virtual directory.
-        /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
-        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name) const;
-
         /// <summary>
-        /// Gets a reference to a page blob in this virtual directory.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <returns>A reference to a <see cref="cloud_page_blob" />.</returns>
-        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Gets a reference to a block blob in this virtual directory.
+        /// Uploads the concatenation of a list of buffers to a block blob.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
-        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name) const;
+        /// <param name="source">The buffers providing the blob content, in order.</param>
+        void upload_from_buffers(const std::vector<const_buffer>& source)
+        {
+            upload_from_buffers_async(source).wait();
+        }
 
         /// <summary>
-        /// Gets a reference to a block blob in this virtual directory.
+        /// Uploads the concatenation of a list of buffers to a block blob.
         /// </summary>
-        /// <param name="blob_name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <returns>A reference to a <see cref="cloud_block_blob" />.</returns>
-        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& blob_name, const utility::string_t& snapshot_time) const;
+        /// <param name="source">The buffers providing the blob content, in order.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_from_buffers(const std::vector<const_buffer>& source, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            upload_from_buffers_async(source, condition, options, context).wait();
+        }
 
         /// <summary>
-        /// Returns a virtual subdirectory within this virtual directory.
+        /// Returns a task that performs an asynchronous operation to upload the concatenation of a list of buffers to a block blob.
         /// </summary>
-        /// <param name="name">The name of the virtual subdirectory.</param>
-        /// <returns>A <see cref="wa::storage::cloud_blob_directory" /> object representing the virtual subdirectory.</returns>
-        WASTORAGE_API cloud_blob_directory get_subdirectory_reference(const utility::string_t& name) const;
+        /// <param name="source">The buffers providing the blob content, in order.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_buffers_async(const std::vector<const_buffer>& source)
+        {
+            return upload_from_buffers_async(source, access_condition(), blob_request_options(), operation_context());
+        }
 
-        /// <summary>
-        /// Gets the <see cref="wa::storage::cloud_blob_directory" /> object representing the
-        /// parent directory for the current virtual directory.
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to upload the concatenation of a list of buffers to a block blob.
         /// </summary>
-        /// <returns>The virtual directory's parent directory.</returns>
-        WASTORAGE_API cloud_blob_directory get_parent_reference() const;
+        /// <param name="source">The buffers providing the blob content, in order.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>The content is uploaded in a single request or in blocks, as for a stream of the same length. The buffers are
+        /// read in place, so the memory they refer to must stay valid and unchanged until the task completes.</remarks>
+        WASTORAGE_API pplx::task<void> upload_from_buffers_async(const std::vector<const_buffer>& source, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Returns a result segment containing a collection of blob items
-        /// in the container.
+        /// Uploads a file to a block blob.
         /// </summary>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
-        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
-        blob_result_segment list_blobs_segmented(const blob_continuation_token& current_token) const
+        /// <param name="path">The file providing the blob content.</param>
+        void upload_from_file(const utility::string_t& path)
         {
-            return list_blobs_segmented_async(current_token).get();
+            upload_from_file_async(path).wait();
         }
 
         /// <summary>
-        /// Returns a result segment containing a collection of blob items
-        /// in the container.
+        /// Uploads a file to a block blob.
         /// </summary>
-        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
-        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
-        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>    
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="path">The file providing the blob content.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="blob_result_segment" /> containing blob items, which may implement <see cref="wa::storage::cloud_blob" /> or <see cref="wa::storage::cloud_blob_directory" />.</returns>
-        blob_result_segment list_blobs_segmented(bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+        void upload_from_file(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return list_blobs_segmented_async(use_flat_blob_listing, includes, max_results, current_token, options, context).get();
+            upload_from_file_async(path, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
-        /// in the container.
+        /// Returns a task that performs an asynchronous operation to upload a file to a block blob.
         /// </summary>
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that that represents the current operation.</returns>
-        pplx::task<blob_result_segment> list_blobs_segmented_async(const blob_continuation_token& current_token) const
+        /// <param name="path">The file providing the blob content.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_file_async(const utility::string_t& path)
         {
-            return list_blobs_segmented_async(false, blob_listing_includes(), 0, current_token, blob_request_options(), operation_context());
+            return upload_from_file_async(path, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return a result segment containing a collection of blob items
-        /// in the container.
+        /// Returns a task that performs an asynchronous operation to upload a file to a block blob.
         /// </summary>
-        /// <param name="use_flat_blob_listing">Indicates whether to list blobs in a flat listing, or whether to list blobs hierarchically, by virtual directory.</param>
-        /// <param name="includes">A <see cref="wa::storage::blob_listing_includes"/> enumeration describing which items to include in the listing.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
-        /// per-operation limit of 5000. If this value is 0, the maximum possible number of results will be returned, up to 5000.</param>    
-        /// <param name="current_token">A continuation token returned by a previous listing operation.</param>
+        /// <param name="path">The file providing the blob content.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="blob_result_segment" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<blob_result_segment> list_blobs_segmented_async(bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const;
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The file is read through a memory mapping, so its content is uploaded without going through a file stream.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> upload_from_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Gets the service client for the virtual directory.
+        /// Copies the content of another blob to a block blob through the client.
         /// </summary>
-        /// <returns>A client object that specifies the endpoint for the Windows Azure Blob service.</returns>
-        const cloud_blob_client& service_client() const
+        /// <param name="source">The blob to copy, which may belong to another storage account.</param>
+        void upload_from_blob(const cloud_blob& source)
         {
-            return m_container.service_client();
+            upload_from_blob_async(source).wait();
         }
 
         /// <summary>
-        /// Gets a <see cref="wa::storage::cloud_blob_container" /> object representing the virtual directory's container.
+        /// Copies the content of another blob to a block blob through the client.
         /// </summary>
-        /// <returns>The virtual directory's container.</returns>
-        const cloud_blob_container& container() const
+        /// <param name="source">The blob to copy, which may belong to another storage account.</param>
+        /// <param name="source_condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the source blob.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the destination blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_from_blob(const cloud_blob& source, const access_condition& source_condition, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return m_container;
+            upload_from_blob_async(source, source_condition, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Gets the virtual directory URI for all locations.
+        /// Returns a task that performs an asynchronous operation to copy the content of another blob to a block blob through the client.
         /// </summary>
-        /// <returns>A <see cref="storage_uri" /> containing the virtual directory URI for all locations.</returns>
-        const storage_uri& uri() const
+        /// <param name="source">The blob to copy, which may belong to another storage account.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_blob_async(const cloud_blob& source)
         {
-            return m_uri;
+            return upload_from_blob_async(source, access_condition(), access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Gets the prefix for the virtual directory.
+        /// Returns a task that performs an asynchronous operation to copy the content of another blob to a block blob through the client.
         /// </summary>
-        /// <returns>A string containing the prefix.</returns>
-        const utility::string_t& prefix() const
-        {
-            return m_name;
-        }
+        /// <param name="source">The blob to copy, which may belong to another storage account.</param>
+        /// <param name="source_condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the source blob.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the destination blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// Use this instead of <see cref="cloud_blob::start_copy_from_blob_async" /> when the service cannot copy the blob itself. The source is
+        /// read in ranges of the stream write size, up to 4MB, and each range is uploaded as a block of its own as soon as it has arrived. Up to
+        /// <see cref="blob_request_options::parallelism_factor" /> ranges are downloaded and as many blocks are uploaded at the same time, through
+        /// a fixed ring of twice as many buffers, so the content is never held as a whole. Every range is read under the ETag the source had when
+        /// the copy started, so the copy fails rather than mixing two versions of the source. The properties and metadata of the source are
+        /// copied with the content.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> upload_from_blob_async(const cloud_blob& source, const access_condition& source_condition, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Indicates whether the <see cref="cloud_blob_directory" /> object is valid.
+        /// Uploads a stream to a block blob, compressing each block on its own before it is sent.
         /// </summary>
-        /// <returns><c>true</c> if the <see cref="cloud_blob_directory" /> object is valid; otherwise, <c>false</c>.</returns>
-        bool is_valid() const
+        /// <param name="source">The stream providing the blob content, which is read to its end.</param>
+        /// <param name="codec">The codec that compresses the blocks.</param>
+        void upload_compressed_from_stream(concurrency::streams::istream source, std::shared_ptr<block_codec> codec)
         {
-            return !m_name.empty();
+            upload_compressed_from_stream_async(source, codec).wait();
         }
 
-    private:
-
-        cloud_blob_container m_container;
-        storage_uri m_uri;
-        utility::string_t m_name;
-    };
-
-    /// <summary>
-    /// A class for Windows Azure blob types. The <see cref="wa::storage::cloud_block_blob"/> and 
-    /// <see cref="wa::storage::cloud_page_blob"/> classes derive from the <see cref="wa::storage::cloud_blob"/> class.
-    /// </summary>
-    class cloud_blob
-    {
-    public:
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// Uploads a stream to a block blob, compressing each block on its own before it is sent.
         /// </summary>
-        cloud_blob()
+        /// <param name="source">The stream providing the blob content, which is read to its end.</param>
+        /// <param name="codec">The codec that compresses the blocks.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_compressed_from_stream(concurrency::streams::istream source, std::shared_ptr<block_codec> codec, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
+            upload_compressed_from_stream_async(source, codec, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob, compressing each block on its own before it is sent.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        WASTORAGE_API cloud_blob(const storage_uri& uri);
+        /// <param name="source">The stream providing the blob content, which is read to its end.</param>
+        /// <param name="codec">The codec that compresses the blocks.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_compressed_from_stream_async(concurrency::streams::istream source, std::shared_ptr<block_codec> codec)
+        {
+            return upload_compressed_from_stream_async(source, codec, access_condition(), blob_request_options(), operation_context());
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob, compressing each block on its own before it is sent.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        WASTORAGE_API cloud_blob(const storage_uri& uri, const storage_credentials& credentials);
+        /// <param name="source">The stream providing the blob content, which is read to its end.</param>
+        /// <param name="codec">The codec that compresses the blocks.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The source is read in blocks of <see cref="wa::storage::blob_request_options::stream_write_size_in_bytes" /> bytes, and up to
+        /// <see cref="wa::storage::blob_request_options::parallelism_factor" /> blocks are compressed and uploaded at the same time. The Content-Encoding
+        /// property of the blob is set to the one of the codec, and a stored Content-MD5 would not match the compressed content, so none is set.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> upload_compressed_from_stream_async(concurrency::streams::istream source, std::shared_ptr<block_codec> codec, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class using an absolute URI to the blob.
+        /// Downloads the contents of a block blob that was uploaded with compressed blocks to a stream, decompressing each block on its own.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        WASTORAGE_API cloud_blob(const storage_uri& uri, const utility::string_t& snapshot_time, const storage_credentials& credentials);
+        /// <param name="target">The target stream.</param>
+        /// <param name="codec">The codec that decompresses the blocks.</param>
+        void download_decompressed_to_stream(concurrency::streams::ostream target, std::shared_ptr<block_codec> codec)
+        {
+            download_decompressed_to_stream_async(target, codec).wait();
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class.
+        /// Downloads the contents of a block blob that was uploaded with compressed blocks to a stream, decompressing each block on its own.
         /// </summary>
-        /// <param name="name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <param name="container">A reference to the parent container.</param>
-        cloud_blob(const utility::string_t& name, const utility::string_t& snapshot_time, const cloud_blob_container& container);
+        /// <param name="target">The target stream.</param>
+        /// <param name="codec">The codec that decompresses the blocks.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_decompressed_to_stream(concurrency::streams::ostream target, std::shared_ptr<block_codec> codec, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            download_decompressed_to_stream_async(target, codec, condition, options, context).wait();
+        }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_blob" /> class.
+        /// Returns a task that performs an asynchronous operation to download the contents of a block blob that was uploaded with compressed blocks to a stream, decompressing each block on its own.
         /// </summary>
-        /// <param name="name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <param name="container">A reference to the parent container.</param>
-        /// <param name="properties">A set of properties for the blob.</param>
-        /// <param name="metadata">User-defined metadata for the blob.</param>
-        /// <param name="copy_state">the state of the most recent or pending copy operation.</param>
-        cloud_blob(utility::string_t name, utility::string_t snapshot_time, const cloud_blob_container& container, cloud_blob_properties properties, cloud_metadata metadata, copy_state copy_state);
+        /// <param name="target">The target stream.</param>
+        /// <param name="codec">The codec that decompresses the blocks.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_decompressed_to_stream_async(concurrency::streams::ostream target, std::shared_ptr<block_codec> codec)
+        {
+            return download_decompressed_to_stream_async(target, codec, access_condition(), blob_request_options(), operation_context());
+        }
 
         /// <summary>
-        /// Gets the <see cref="wa::storage::cloud_blob_directory" /> object representing the
-        /// virtual parent directory for the blob.
+        /// Returns a task that performs an asynchronous operation to download the contents of a block blob that was uploaded with compressed blocks to a stream, decompressing each block on its own.
         /// </summary>
-        /// <returns>The blob's virtual parent directory.</returns>
-        WASTORAGE_API cloud_blob_directory get_parent_reference() const;
+        /// <param name="target">The target stream.</param>
+        /// <param name="codec">The codec that decompresses the blocks.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The committed blocks of the blob are the frame boundaries, so each block is downloaded as a range of its own, and up to
+        /// <see cref="wa::storage::blob_request_options::parallelism_factor" /> blocks are downloaded and decompressed at the same time. The content
+        /// is written to the target in order. A blob without committed blocks, such as one uploaded with a single request, is decompressed as a whole.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> download_decompressed_to_stream_async(concurrency::streams::ostream target, std::shared_ptr<block_codec> codec, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Gets the snapshot-qualified URI to the blob.
+        /// Uploads a stream to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
-        /// <returns>The blob's snapshot-qualified URI, if the blob is a snapshot; otherwise, the absolute URI to the blob.</returns>
-        WASTORAGE_API storage_uri snapshot_qualified_uri() const;
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        void upload_changed_blocks_from_stream(concurrency::streams::istream source, utility::size64_t length)
+        {
+            upload_changed_blocks_from_stream_async(source, length).wait();
+        }
 
         /// <summary>
-        /// Returns a shared access signature for the blob.
+        /// Uploads a stream to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
-        /// <param name="policy">The access policy for the shared access signature.</param>
-        /// <returns>A string containing a shared access signature.</returns>
-        utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy) const
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void upload_changed_blocks_from_stream(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return get_shared_access_signature(policy, utility::string_t());
+            upload_changed_blocks_from_stream_async(source, length, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a shared access signature for the blob.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
-        /// <param name="policy">The access policy for the shared access signature.</param>
-        /// <param name="stored_policy_identifier">A container-level access policy.</param>
-        /// <returns>A string containing a shared access signature.</returns>
-        utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier) const
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_changed_blocks_from_stream_async(concurrency::streams::istream source, utility::size64_t length)
         {
-            return get_shared_access_signature(policy, stored_policy_identifier, cloud_blob_shared_access_headers());
+            return upload_changed_blocks_from_stream_async(source, length, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a shared access signature for the blob.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
-        /// <param name="policy">The access policy for the shared access signature.</param>
-        /// <param name="stored_policy_identifier">A container-level access policy.</param>
-        /// <param name="headers">The optional header values to set for a blob returned with this SAS.</param>
-        /// <returns>A string containing a shared access signature.</returns>
-        WASTORAGE_API utility::string_t get_shared_access_signature(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier, const cloud_blob_shared_access_headers& headers) const;
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The source is split into blocks of <see cref="wa::storage::blob_request_options::stream_write_size_in_bytes" /> bytes, and the ID of each block
+        /// is the MD5 of its content. A block whose ID is in the committed block list of the blob is not sent again, and neither is a block that occurs 
+        /// more than once in the source. Reusing blocks only works if the blob was last uploaded by this method with the same block size.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> upload_changed_blocks_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Opens a stream for reading from the blob.
+        /// Uploads a file to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
-        /// <returns>A stream to be used for reading from the blob.</returns>
-        concurrency::streams::istream open_read()
+        /// <param name="path">The file providing the blob content.</param>
+        void upload_changed_blocks_from_file(const utility::string_t& path)
         {
-            return open_read_async().get();
+            upload_changed_blocks_from_file_async(path).wait();
         }
 
         /// <summary>
-        /// Opens a stream for reading from the blob.
+        /// Uploads a file to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
+        /// <param name="path">The file providing the blob content.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A stream to be used for reading from the blob.</returns>
-        concurrency::streams::istream open_read(const access_condition& condition, const blob_request_options& options, operation_context context)
+        void upload_changed_blocks_from_file(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return open_read_async(condition, options, context).get();
+            upload_changed_blocks_from_file_async(path, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for reading from the blob.
+        /// Returns a task that performs an asynchronous operation to upload a file to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::istream" /> that represents the current operation.</returns>
-        pplx::task<concurrency::streams::istream> open_read_async()
+        /// <param name="path">The file providing the blob content.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_changed_blocks_from_file_async(const utility::string_t& path)
         {
-            return open_read_async(access_condition(), blob_request_options(), operation_context());
+            return upload_changed_blocks_from_file_async(path, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for reading from the blob.
+        /// Returns a task that performs an asynchronous operation to upload a file to a block blob, sending only the blocks that the blob does not have committed already.
         /// </summary>
+        /// <param name="path">The file providing the blob content.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::istream" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<concurrency::streams::istream> open_read_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_changed_blocks_from_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Checks existence of the blob.
+        /// Uploads a stream to a block blob, continuing the upload recorded by a checkpoint.
         /// </summary>
-        /// <returns><c>true</c> if the blob exists.</returns>
-        bool exists()
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="checkpoint">A new checkpoint, or one saved by an earlier attempt to upload the same content.</param>
+        /// <param name="checkpoint_handler">A function that is called with the updated checkpoint whenever a block has been uploaded.</param>
+        void upload_resumable_from_stream(concurrency::streams::istream source, utility::size64_t length, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler)
         {
-            return exists_async().get();
+            upload_resumable_from_stream_async(source, length, checkpoint, checkpoint_handler).wait();
         }
 
         /// <summary>
-        /// Checks existence of the blob.
+        /// Uploads a stream to a block blob, continuing the upload recorded by a checkpoint.
         /// </summary>
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="checkpoint">A new checkpoint, or one saved by an earlier attempt to upload the same content.</param>
+        /// <param name="checkpoint_handler">A function that is called with the updated checkpoint whenever a block has been uploaded.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns><c>true</c> if the blob exists.</returns>
-        bool exists(const blob_request_options& options, operation_context context)
+        void upload_resumable_from_stream(concurrency::streams::istream source, utility::size64_t length, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return exists_async(options, context).get();
+            upload_resumable_from_stream_async(source, length, checkpoint, checkpoint_handler, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to check the existence of the blob.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob, continuing the upload recorded by a checkpoint.
         /// </summary>
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="checkpoint">A new checkpoint, or one saved by an earlier attempt to upload the same content.</param>
+        /// <param name="checkpoint_handler">A function that is called with the updated checkpoint whenever a block has been uploaded.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<bool> exists_async()
+        pplx::task<void> upload_resumable_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler)
         {
-            return exists_async(blob_request_options(), operation_context());
+            return upload_resumable_from_stream_async(source, length, checkpoint, checkpoint_handler, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to check the existence of the blob.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob, continuing the upload recorded by a checkpoint.
         /// </summary>
+        /// <param name="source">A seekable stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="checkpoint">A new checkpoint, or one saved by an earlier attempt to upload the same content.</param>
+        /// <param name="checkpoint_handler">A function that is called with the updated checkpoint whenever a block has been uploaded.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<bool> exists_async(const blob_request_options& options, operation_context context)
+        /// <remarks>
+        /// Before any block is sent, the checkpoint is reconciled with the block list of the blob, so a block counts as uploaded only if the service
+        /// has it with the expected size. This also picks up blocks that were uploaded after the checkpoint was last saved. The blocks are committed
+        /// once all of them have been uploaded, after which the checkpoint is no longer needed. The handler is called while other blocks are being
+        /// uploaded, one call at a time, and an exception it throws fails the upload.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> upload_resumable_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to upload a file to a block blob, continuing the upload recorded by a checkpoint.
+        /// </summary>
+        /// <param name="path">The file providing the blob content.</param>
+        /// <param name="checkpoint">A new checkpoint, or one saved by an earlier attempt to upload the same file.</param>
+        /// <param name="checkpoint_handler">A function that is called with the updated checkpoint whenever a block has been uploaded.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_resumable_from_file_async(const utility::string_t& path, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler)
         {
-            return exists_async(false, options, context);
+            return upload_resumable_from_file_async(path, checkpoint, checkpoint_handler, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Populates a blob's properties and metadata.
+        /// Returns a task that performs an asynchronous operation to upload a file to a block blob, continuing the upload recorded by a checkpoint.
         /// </summary>
-        void download_attributes()
+        /// <param name="path">The file providing the blob content.</param>
+        /// <param name="checkpoint">A new checkpoint, or one saved by an earlier attempt to upload the same file.</param>
+        /// <param name="checkpoint_handler">A function that is called with the updated checkpoint whenever a block has been uploaded.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> upload_resumable_from_file_async(const utility::string_t& path, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Uploads a string of text to a blob.
+        /// </summary>
+        /// <param name="content">A string containing the text to upload.</param>
+        void upload_text(const utility::string_t& content)
         {
-            download_attributes_async().wait();
+            upload_text_async(content).wait();
         }
 
         /// <summary>
-        /// Populates a blob's properties and metadata.
+        /// Uploads a string of text to a blob.
         /// </summary>
+        /// <param name="content">A string containing the text to upload.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void download_attributes(const access_condition& condition, const blob_request_options& options, operation_context context)
+        void upload_text(const utility::string_t& content, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            download_attributes_async(condition, options, context).wait();
+            upload_text_async(content, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to populate a blob's properties and metadata.
+        /// Uploads a string of text to a blob.
         /// </summary>
+        /// <param name="content">A string containing the text to upload.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> download_attributes_async()
+        pplx::task<void> upload_text_async(const utility::string_t& content)
         {
-            return download_attributes_async(access_condition(), blob_request_options(), operation_context());
+            return upload_text_async(content, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to populate a blob's properties and metadata.
+        /// Uploads a string of text to a blob.
         /// </summary>
+        /// <param name="content">A string containing the text to upload.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> download_attributes_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        WASTORAGE_API pplx::task<void> upload_text_async(const utility::string_t& content, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+    private:
+
+        pplx::task<void> check_write_condition_async(const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+        pplx::task<void> upload_block_list_async(concurrency::streams::istream block_list, const access_condition& condition, const blob_request_options& options, operation_context context);
+        pplx::task<void> upload_blocks_from_seekable_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+
+        friend class core::basic_cloud_block_blob_ostreambuf;
+    };
 
+    /// <summary>
+    /// Represents a Windows Azure page blob.
+    /// </summary>
+    class cloud_page_blob : public cloud_blob
+    {
+    public:
         /// <summary>
-        /// Updates the blob's metadata.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class.
         /// </summary>
-        void upload_metadata()
+        cloud_page_blob()
+            : cloud_blob()
         {
-            upload_metadata_async().wait();
         }
 
         /// <summary>
-        /// Updates the blob's metadata.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class using an absolute URI to the blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_metadata(const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        cloud_page_blob(const storage_uri& uri)
+            : cloud_blob(uri)
         {
-            upload_metadata_async(condition, options, context).wait();
+            set_type(blob_type::page_blob);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to update the blob's metadata.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class using an absolute URI to the blob.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_metadata_async()
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        cloud_page_blob(const storage_uri& uri, const storage_credentials& credentials)
+            : cloud_blob(uri, credentials)
         {
-            return upload_metadata_async(access_condition(), blob_request_options(), operation_context());
+            set_type(blob_type::page_blob);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to update the blob's metadata.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class using an absolute URI to the blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_metadata_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        cloud_page_blob(const storage_uri& uri, const utility::string_t& snapshot_time, const storage_credentials& credentials)
+            : cloud_blob(uri, snapshot_time, credentials)
+        {
+            set_type(blob_type::page_blob);
+        }
 
         /// <summary>
-        /// Updates the blob's properties.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class.
         /// </summary>
-        void upload_properties()
+        /// <param name="name">The name of the blob.</param>
+        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
+        /// <param name="container">A reference to the parent container.</param>
+        cloud_page_blob(const utility::string_t& name, const utility::string_t& snapshot_time, const cloud_blob_container& container)
+            : cloud_blob(name, snapshot_time, container)
         {
-            upload_properties_async().wait();
+            set_type(blob_type::page_blob);
         }
 
         /// <summary>
-        /// Updates the blob's properties.
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_properties(const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="blob">Reference to the blob.</param>
+        cloud_page_blob(const cloud_blob& blob)
+            : cloud_blob(blob)
         {
-            upload_properties_async(condition, options, context).wait();
+            set_type(blob_type::page_blob);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to update the blob's properties.
+        /// Opens a stream for writing to an existing page blob.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_properties_async()
+        /// <returns>A stream to be used for writing to the blob.</returns>
+        concurrency::streams::ostream open_write()
         {
-            return upload_properties_async(access_condition(), blob_request_options(), operation_context());
+            return open_write_async().get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to update the blob's properties.
+        /// Opens a stream for writing to an existing page blob.
         /// </summary>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_properties_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A stream to be used for writing to the blob.</returns>
+        concurrency::streams::ostream open_write(const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            return open_write_async(condition, options, context).get();
+        }
 
         /// <summary>
-        /// Deletes the blob.
+        /// Opens a stream for writing to a new page blob.
         /// </summary>
-        void delete_blob()
+        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
+        /// <returns>A stream to be used for writing to the blob.</returns>
+        concurrency::streams::ostream open_write(utility::size64_t size)
         {
-            delete_blob_async().wait();
+            return open_write_async(size).get();
         }
 
         /// <summary>
-        /// Deletes the blob.
+        /// Opens a stream for writing to a new page blob.
         /// </summary>
-        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
+        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void delete_blob(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>A stream to be used for writing to the blob.</returns>
+        concurrency::streams::ostream open_write(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            delete_blob_async(snapshots_option, condition, options, context).wait();
+            return open_write_async(size, condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the blob.
+        /// Returns a task that performs an asynchronous operation to open a stream for writing to an existing page blob.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> delete_blob_async()
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
+        pplx::task<concurrency::streams::ostream> open_write_async()
         {
-            return delete_blob_async(delete_snapshots_option::none, access_condition(), blob_request_options(), operation_context());
+            return open_write_async(access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the blob.
+        /// Returns a task that performs an asynchronous operation to open a stream for writing to an existing page blob.
         /// </summary>
-        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> delete_blob_async(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<concurrency::streams::ostream> open_write_async(const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Deletes the blob if it already exists.
+        /// Returns a task that performs an asynchronous operation to open a stream for writing to a new page blob.
         /// </summary>
-        /// <returns><c>true</c> if the blob did already exist and was deleted; otherwise <c>false</c>.</returns>
-        bool delete_blob_if_exists()
+        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
+        pplx::task<concurrency::streams::ostream> open_write_async(utility::size64_t size)
         {
-            return delete_blob_if_exists_async().get();
+            return open_write_async(size, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Deletes the blob if it already exists.
+        /// Returns a task that performs an asynchronous operation to open a stream for writing to a new page blob.
         /// </summary>
-        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
+        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns><c>true</c> if the blob did already exist and was deleted; otherwise <c>false</c>.</returns>
-        bool delete_blob_if_exists(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            return delete_blob_if_exists_async(snapshots_option, condition, options, context).get();
-        }
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<concurrency::streams::ostream> open_write_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the blob if it already exists.
+        /// Clears pages from a page blob.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<bool> delete_blob_if_exists_async()
+        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
+        void clear_pages(int64_t start_offset, int64_t length)
         {
-            return delete_blob_if_exists_async(delete_snapshots_option::none, access_condition(), blob_request_options(), operation_context());
+            clear_pages_async(start_offset, length).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to delete the blob if it already exists.
+        /// Clears pages from a page blob.
         /// </summary>
-        /// <param name="snapshots_option">Indicates whether to delete only the blob, to delete the blob and all snapshots, or to delete only snapshots.</param>
+        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<bool> delete_blob_if_exists_async(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context);
+        void clear_pages(int64_t start_offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            clear_pages_async(start_offset, length, condition, options, context).wait();
+        }
 
         /// <summary>
-        /// Acquires a lease on the blob.
+        /// Returns a task that performs an asynchronous operation to clear pages from a page blob.
         /// </summary>
-        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
-        /// <returns>A string containing the lease ID.</returns>
-        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> clear_pages_async(int64_t start_offset, int64_t length)
         {
-            return acquire_lease_async(duration, proposed_lease_id).get();
+            return clear_pages_async(start_offset, length, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Acquires a lease on the blob.
+        /// Returns a task that performs an asynchronous operation to clear pages from a page blob.
         /// </summary>
-        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
+        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A string containing the lease ID.</returns>
-        utility::string_t acquire_lease(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
-        {
-            return acquire_lease_async(duration, proposed_lease_id, condition, options, context).get();
-        }
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> clear_pages_async(int64_t start_offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to acquire a lease on the blob.
+        /// Gets a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id) const
+        /// <returns>An enumerable collection of page ranges.</returns>
+        std::vector<page_range> download_page_ranges() const
         {
-            return acquire_lease_async(duration, proposed_lease_id, access_condition(), blob_request_options(), operation_context());
+            return download_page_ranges_async().get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to acquire a lease on the blob.
+        /// Gets a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="lease_time">A <see cref="wa::storage::lease_duration"/> representing the span of time for which to acquire the lease.</param>
-        /// <param name="proposed_lease_id">A string representing the proposed lease ID for the new lease. May be an empty string if no lease ID is proposed.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<utility::string_t> acquire_lease_async(const wa::storage::lease_time& duration, const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns>An enumerable collection of page ranges.</returns>
+        std::vector<page_range> download_page_ranges(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return download_page_ranges_async(condition, options, context).get();
+        }
 
         /// <summary>
-        /// Renews a lease on the blob.
+        /// Gets a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
-        void renew_lease(const access_condition& condition) const
+        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <returns>An enumerable collection of page ranges.</returns>
+        std::vector<page_range> download_page_ranges(int64_t offset, int64_t length) const
         {
-            renew_lease_async(condition).wait();
+            return download_page_ranges_async(offset, length).get();
         }
 
         /// <summary>
-        /// Renews a lease on the blob.
+        /// Gets a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void renew_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <returns>An enumerable collection of page ranges.</returns>
+        std::vector<page_range> download_page_ranges(int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context) const
         {
-            renew_lease_async(condition, options, context).wait();
+            return download_page_ranges_async(offset, length, condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to renew a lease on the blob.
+        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> renew_lease_async(const access_condition& condition) const
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
+        pplx::task<std::vector<page_range>> download_page_ranges_async() const
         {
-            return renew_lease_async(condition, blob_request_options(), operation_context());
+            return download_page_ranges_async(-1, -1);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to renew a lease on the blob.
+        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> renew_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
+        pplx::task<std::vector<page_range>> download_page_ranges_async(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        {
+            return download_page_ranges_async(-1, -1, condition, options, context);
+        }
 
         /// <summary>
-        /// Changes the lease ID on the blob.
+        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
-        /// <returns>The new lease ID.</returns>
-        utility::string_t change_lease(const utility::string_t& proposed_lease_id, const access_condition& condition) const
+        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
+        pplx::task<std::vector<page_range>> download_page_ranges_async(int64_t offset, int64_t length) const
         {
-            return change_lease_async(proposed_lease_id, condition).get();
+            return download_page_ranges_async(offset, length, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Changes the lease ID on the blob.
+        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The new lease ID.</returns>
-        utility::string_t change_lease(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
-        {
-            return change_lease_async(proposed_lease_id, condition, options, context).get();
-        }
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<std::vector<page_range>> download_page_ranges_async(int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context) const;
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to change the lease ID on the blob.
+        /// Gets the valid page ranges of a data range by listing windows of it in parallel, and passes the ranges to a handler in order.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id, const access_condition& condition) const
+        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range over which to list page ranges, in bytes, or -1 to list up to the end of the blob. Must be a multiple of 512.</param>
+        /// <param name="window_size">The length of each window that is listed with one request, in bytes. Must be a positive multiple of 512.</param>
+        /// <param name="handler">A function that is called for each page range in order of offset. Returning <c>false</c> stops the listing.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_page_ranges(int64_t offset, int64_t length, int64_t window_size, std::function<bool (const page_range&)> handler, const access_condition& condition, const blob_request_options& options, operation_context context) const
         {
-            return change_lease_async(proposed_lease_id, condition, blob_request_options(), operation_context());
+            download_page_ranges_async(offset, length, window_size, handler, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to change the lease ID on the blob.
+        /// Returns a task that gets the valid page ranges of a data range by listing windows of it in parallel, and passes the ranges to a handler in order.
         /// </summary>
-        /// <param name="proposed_lease_id">A string containing the proposed lease ID for the lease. May not be empty.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
+        /// <param name="length">The length of the data range over which to list page ranges, in bytes, or -1 to list up to the end of the blob. Must be a multiple of 512.</param>
+        /// <param name="window_size">The length of each window that is listed with one request, in bytes. Must be a positive multiple of 512.</param>
+        /// <param name="handler">A function that is called for each page range in order of offset. Returning <c>false</c> stops the listing.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<utility::string_t> change_lease_async(const utility::string_t& proposed_lease_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// Up to the parallelism factor of windows are listed at the same time. The ranges of a window are passed to the handler, one at a time,
+        /// as soon as every window before it has been passed, and a range that spans windows is passed once as a whole. Each window is listed
+        /// with a separate request, so to see the pages of one version of a blob that is being written, list a snapshot or pass an if-match condition.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> download_page_ranges_async(int64_t offset, int64_t length, int64_t window_size, std::function<bool (const page_range&)> handler, const access_condition& condition, const blob_request_options& options, operation_context context) const;
 
         /// <summary>
-        /// Releases the lease on the blob.
+        /// Writes pages to a page blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
-        void release_lease(const access_condition& condition) const
+        /// <param name="page_data">A stream providing the page data.</param>
+        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
+        void upload_pages(concurrency::streams::istream page_data, int64_t start_offset, const utility::string_t& content_md5)
         {
-            release_lease_async(condition).wait();
+            upload_pages_async(page_data, start_offset, content_md5).wait();
         }
 
         /// <summary>
-        /// Releases the lease on the blob.
+        /// Writes pages to a page blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="page_data">A stream providing the page data.</param>
+        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void release_lease(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        void upload_pages(concurrency::streams::istream page_data, int64_t start_offset, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            release_lease_async(condition, options, context).wait();
+            upload_pages_async(page_data, start_offset, content_md5, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to release the lease on the blob.
+        /// Returns a task that performs an asynchronous operation to write pages to a page blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="page_data">A stream providing the page data.</param>
+        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> release_lease_async(const access_condition& condition) const
+        pplx::task<void> upload_pages_async(concurrency::streams::istream source, int64_t start_offset, const utility::string_t& content_md5)
         {
-            return release_lease_async(condition, blob_request_options(), operation_context());
+            return upload_pages_async(source, start_offset, content_md5, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to release the lease on the blob.
+        /// Returns a task that performs an asynchronous operation to write pages to a page blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="page_data">A stream providing the page data.</param>
+        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
+        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
+        /// on the blob. May be an empty string.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> release_lease_async(const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        WASTORAGE_API pplx::task<void> upload_pages_async(concurrency::streams::istream source, int64_t start_offset, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Breaks the current lease on the blob.
+        /// Uploads a stream to a page blob.
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <returns>The time until the lease ends, in seconds.</returns>
-        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period) const
+        /// <param name="source">The stream providing the blob content.</param>
+        void upload_from_stream(concurrency::streams::istream source)
         {
-            return break_lease_async(break_period).get();
+            upload_from_stream_async(source).wait();
         }
 
         /// <summary>
-        /// Breaks the current lease on the blob.
+        /// Uploads a stream to a page blob.
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The time until the lease ends, in seconds.</returns>
-        std::chrono::seconds break_lease(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        void upload_from_stream(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return break_lease_async(break_period, condition, options, context).get();
+            upload_from_stream_async(source, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to break the current lease on the blob.
+        /// Uploads a stream to a page blob.
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
-        pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period) const
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length)
         {
-            return break_lease_async(break_period, access_condition(), blob_request_options(), operation_context());
+            upload_from_stream_async(source, length).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to break the current lease on the blob.
+        /// Uploads a stream to a page blob.
         /// </summary>
-        /// <param name="break_period">A <see cref="wa::storage::lease_break_period"/> representing the amount of time to allow the lease to remain.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access conditions for the blob, including a required lease ID.</param>
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::chrono::seconds" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<std::chrono::seconds> break_lease_async(const wa::storage::lease_break_period& break_period, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
+        {
+            upload_from_stream_async(source, length, condition, options, context).wait();
+        }
 
         /// <summary>
-        /// Downloads the contents of a blob to a stream.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
-        void download_to_stream(concurrency::streams::ostream target)
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source)
         {
-            download_to_stream_async(target).wait();
+            return upload_from_stream_async(source, protocol::invalid_size64_t);
         }
 
         /// <summary>
-        /// Downloads the contents of a blob to a stream.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
+        /// <param name="source">The stream providing the blob content.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void download_to_stream(concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            download_to_stream_async(target, condition, options, context).wait();
+            return upload_from_stream_async(source, protocol::invalid_size64_t, condition, options, context);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to download the contents of a blob to a stream.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> download_to_stream_async(concurrency::streams::ostream target)
+        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length)
         {
-            return download_to_stream_async(target, access_condition(), blob_request_options(), operation_context());
+            return upload_from_stream_async(source, length, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to download the contents of a blob to a stream.
+        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
+        /// <param name="source">The stream providing the blob content.</param>
+        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> download_to_stream_async(concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            return download_range_to_stream_async(target, -1, -1, condition, options, context);
-        }
+        WASTORAGE_API pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Downloads a range of bytes in a blob to a stream.
+        /// Uploads a file to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
-        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
-        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
-        void download_range_to_stream(concurrency::streams::ostream target, int64_t offset, int64_t length)
+        /// <param name="path">The file providing the blob content.</param>
+        void upload_from_file(const utility::string_t& path)
         {
-            download_range_to_stream_async(target, offset, length).wait();
+            upload_from_file_async(path).wait();
         }
 
         /// <summary>
-        /// Downloads a range of bytes in a blob to a stream.
+        /// Uploads a file to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
-        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
-        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="path">The file providing the blob content.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void download_range_to_stream(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
+        void upload_from_file(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            download_range_to_stream_async(target, offset, length, condition, options, context).wait();
+            upload_from_file_async(path, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to download a range of bytes in a blob to a stream.
+        /// Returns a task that performs an asynchronous operation to upload a file to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
-        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
-        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="path">The file providing the blob content.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> download_range_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length)
+        pplx::task<void> upload_from_file_async(const utility::string_t& path)
         {
-            return download_range_to_stream_async(target, offset, length, access_condition(), blob_request_options(), operation_context());
+            return upload_from_file_async(path, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to download a range of bytes in a blob to a stream.
+        /// Returns a task that performs an asynchronous operation to upload a file to a page blob.
         /// </summary>
-        /// <param name="target">The target stream.</param>
-        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
-        /// <param name="length">The length of the data to download from the blob, in bytes.</param>
+        /// <param name="path">The file providing the blob content.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> download_range_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <remarks>
+        /// The file is read through a memory mapping, so its content is uploaded without going through a file stream.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> upload_from_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// Creates a page blob.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <returns>The copy ID associated with the copy operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        utility::string_t start_copy_from_blob(const web::http::uri& source)
+        /// <param name="size">The maximum size of the page blob, in bytes.</param>
+        void create(utility::size64_t size)
         {
-            return start_copy_from_blob_async(source).get();
+            create_async(size).wait();
         }
 
         /// <summary>
-        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// Creates a page blob.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <param name="source_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the source blob.</param>
-        /// <param name="destination_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the destination blob.</param>
+        /// <param name="size">The maximum size of the page blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The copy ID associated with the copy operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        utility::string_t start_copy_from_blob(const web::http::uri& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context)
+        void create(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return start_copy_from_blob_async(source, source_condition, destination_condition, options, context).get();
+            create_async(size, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// Returns a task that performs an asynchronous operation to create a page blob.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <returns>The copy ID associated with the copy operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        utility::string_t start_copy_from_blob(const cloud_blob& source)
+        /// <param name="size">The maximum size of the page blob, in bytes.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> create_async(utility::size64_t size)
         {
-            return start_copy_from_blob_async(source).get();
+            return create_async(size, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Begins an operation to copy a blob's contents, properties, and metadata to a new blob.
+        /// Returns a task that performs an asynchronous operation to create a page blob.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <param name="source_condition">An object that represents the <see cref="access_condition" /> for the source blob.</param>
-        /// <param name="destination_condition">An object that represents the <see cref="access_condition" /> for the destination blob.</param>
+        /// <param name="size">The maximum size of the page blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The copy ID associated with the copy operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        utility::string_t start_copy_from_blob(const cloud_blob& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context)
-        {
-            return start_copy_from_blob_async(source, source_condition, destination_condition, options, context).get();
-        }
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> create_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// Resizes the page blob to the specified size.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        pplx::task<utility::string_t> start_copy_from_blob_async(const web::http::uri& source)
+        /// <param name="size">The size of the page blob, in bytes.</param>
+        void resize(utility::size64_t size)
         {
-            return start_copy_from_blob_async(source, access_condition(), access_condition(), blob_request_options(), operation_context());
+            resize_async(size).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// Resizes the page blob to the specified size.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        pplx::task<utility::string_t> start_copy_from_blob_async(const cloud_blob& source)
+        /// <param name="size">The size of the page blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void resize(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return start_copy_from_blob_async(source, access_condition(), access_condition(), blob_request_options(), operation_context());
+            resize_async(size, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// Returns a task that performs an asynchronous operation to resize the page blob to the specified size.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <param name="source_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the source blob.</param>
-        /// <param name="destination_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the destination blob.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        WASTORAGE_API pplx::task<utility::string_t> start_copy_from_blob_async(const web::http::uri& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context);
+        /// <param name="size">The size of the page blob, in bytes.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> resize_async(utility::size64_t size)
+        {
+            return resize_async(size, access_condition(), blob_request_options(), operation_context());
+        }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to begin to copy a blob's contents, properties, and metadata to a new blob.
+        /// Returns a task that performs an asynchronous operation to resize the page blob to the specified size.
         /// </summary>
-        /// <param name="source">The URI of a source blob.</param>
-        /// <param name="source_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the source blob.</param>
-        /// <param name="destination_condition">An object that represents the <see cref="wa::storage::access_condition" /> for the destination blob.</param>
+        /// <param name="size">The size of the page blob, in bytes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        /// <remarks>
-        /// This method fetches the blob's ETag, last-modified time, and part of the copy state.
-        /// The copy ID and copy status fields are fetched, and the rest of the copy state is cleared.
-        /// </remarks>
-        WASTORAGE_API pplx::task<utility::string_t> start_copy_from_blob_async(const cloud_blob& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> resize_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Aborts an ongoing blob copy operation.
+        /// Sets the page blob's sequence number.
         /// </summary>
-        /// <param name="copy_id">A string identifying the copy operation.</param>
-        void abort_copy(const utility::string_t& copy_id) const
+        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
+        void set_sequence_number(const wa::storage::sequence_number& sequence_number)
         {
-            abort_copy_async(copy_id).wait();
+            set_sequence_number_async(sequence_number).wait();
         }
 
         /// <summary>
-        /// Aborts an ongoing blob copy operation.
+        /// Sets the page blob's sequence number.
         /// </summary>
-        /// <param name="copy_id">A string identifying the copy operation.</param>
+        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void abort_copy(const utility::string_t& copy_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        void set_sequence_number(const wa::storage::sequence_number& sequence_number, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            abort_copy_async(copy_id, condition, options, context).wait();
+            set_sequence_number_async(sequence_number, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to abort an ongoing blob copy operation.
+        /// Returns a task that performs an asynchronous operation to set the page blob's sequence number.
         /// </summary>
-        /// <param name="copy_id">A string identifying the copy operation.</param>
+        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> abort_copy_async(const utility::string_t& copy_id) const
+        pplx::task<void> set_sequence_number_async(const wa::storage::sequence_number& sequence_number)
         {
-            return abort_copy_async(copy_id, access_condition(), blob_request_options(), operation_context());
+            return set_sequence_number_async(sequence_number, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to abort an ongoing blob copy operation.
+        /// Returns a task that performs an asynchronous operation to set the page blob's sequence number.
         /// </summary>
-        /// <param name="copy_id">A string identifying the copy operation.</param>
+        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> abort_copy_async(const utility::string_t& copy_id, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        WASTORAGE_API pplx::task<void> set_sequence_number_async(const wa::storage::sequence_number& sequence_number, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Creates a snapshot of the blob.
+        /// Downloads only the valid page ranges of the blob to a stream, filling the rest of it with zeros.
         /// </summary>
-        /// <returns>A blob snapshot.</returns>
-        cloud_blob create_snapshot()
+        /// <param name="target">The target stream, which must be seekable.</param>
+        void download_sparse_to_stream(concurrency::streams::ostream target)
         {
-            return create_snapshot_async().get();
+            download_sparse_to_stream_async(target).wait();
         }
 
         /// <summary>
-        /// Creates a snapshot of the blob.
+        /// Downloads only the valid page ranges of the blob to a stream, filling the rest of it with zeros.
         /// </summary>
-        /// <param name="metadata">A collection of name-value pairs defining the metadata of the snapshot.</param>
+        /// <param name="target">The target stream, which must be seekable.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A blob snapshot.</returns>
-        cloud_blob create_snapshot(const cloud_metadata& metadata, const access_condition& condition, const blob_request_options& options, operation_context context)
+        void download_sparse_to_stream(concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return create_snapshot_async(metadata, condition, options, context).get();
+            download_sparse_to_stream_async(target, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create a snapshot of the blob.
+        /// Returns a task that performs an asynchronous operation to download only the valid page ranges of the blob to a stream, filling the rest of it with zeros.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::cloud_blob" /> that represents the current operation.</returns>
-        pplx::task<wa::storage::cloud_blob> create_snapshot_async()
+        /// <param name="target">The target stream, which must be seekable.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_sparse_to_stream_async(concurrency::streams::ostream target)
         {
-            return create_snapshot_async(cloud_metadata(), access_condition(), blob_request_options(), operation_context());
+            return download_sparse_to_stream_async(target, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create a snapshot of the blob.
+        /// Returns a task that performs an asynchronous operation to download only the valid page ranges of the blob to a stream, filling the rest of it with zeros.
         /// </summary>
-        /// <param name="metadata">A collection of name-value pairs defining the metadata of the snapshot.</param>
+        /// <param name="target">The target stream, which must be seekable.</param>
         /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::cloud_blob" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<wa::storage::cloud_blob> create_snapshot_async(const cloud_metadata& metadata, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>The valid page ranges are downloaded in ranges of <see cref="wa::storage::blob_request_options::stream_read_size_in_bytes" /> bytes, 
+        /// up to <see cref="wa::storage::blob_request_options::parallelism_factor" /> of them at the same time.</remarks>
+        WASTORAGE_API pplx::task<void> download_sparse_to_stream_async(concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Gets the <see cref="wa::storage::cloud_blob_client" /> object that represents the Blob service.
+        /// Downloads only the valid page ranges of the blob to a sparse file.
         /// </summary>
-        /// <returns>A client object that specifies the Blob service endpoint.</returns>
-        const cloud_blob_client& service_client() const
+        /// <param name="path">The target file.</param>
+        void download_sparse_to_file(const utility::string_t& path)
         {
-            return m_container.service_client();
+            download_sparse_to_file_async(path).wait();
         }
 
         /// <summary>
-        /// Gets a <see cref="wa::storage::cloud_blob_container" /> object representing the blob's container.
+        /// Downloads only the valid page ranges of the blob to a sparse file.
         /// </summary>
-        /// <returns>The blob's container.</returns>
-        const cloud_blob_container& container() const
+        /// <param name="path">The target file.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_sparse_to_file(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return m_container;
+            download_sparse_to_file_async(path, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Gets the blob's system properties.
+        /// Returns a task that performs an asynchronous operation to download only the valid page ranges of the blob to a sparse file.
         /// </summary>
-        /// <returns>The blob's properties.</returns>
-        cloud_blob_properties& properties()
+        /// <param name="path">The target file.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_sparse_to_file_async(const utility::string_t& path)
         {
-            return *m_properties;
+            return download_sparse_to_file_async(path, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Gets the blob's system properties.
+        /// Returns a task that performs an asynchronous operation to download only the valid page ranges of the blob to a sparse file.
         /// </summary>
-        /// <returns>The blob's properties.</returns>
-        const cloud_blob_properties& properties() const
-        {
-            return *m_properties;
-        }
+        /// <param name="path">The target file.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>The file is created as a sparse file where the file system supports it, and the regions of the blob without
+        /// valid pages are never written, so they take no space on disk.</remarks>
+        WASTORAGE_API pplx::task<void> download_sparse_to_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Gets the user-defined metadata for the blob.
+        /// Gets the page ranges that differ between this blob or snapshot and an earlier snapshot of the blob.
         /// </summary>
-        /// <returns>The blob's metadata, as a collection of name-value pairs.</returns>
-        cloud_metadata& metadata()
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::page_diff_range" /> objects.</returns>
+        std::vector<page_diff_range> download_page_ranges_diff(const utility::string_t& previous_snapshot_time) const
         {
-            return *m_metadata;
+            return download_page_ranges_diff_async(previous_snapshot_time).get();
         }
 
         /// <summary>
-        /// Gets the user-defined metadata for the blob.
+        /// Gets the page ranges that differ between this blob or snapshot and an earlier snapshot of the blob.
         /// </summary>
-        /// <returns>The blob's metadata, as a collection of name-value pairs.</returns>
-        const cloud_metadata& metadata() const
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::page_diff_range" /> objects.</returns>
+        std::vector<page_diff_range> download_page_ranges_diff(const utility::string_t& previous_snapshot_time, const access_condition& condition, const blob_request_options& options, operation_context context) const
         {
-            return *m_metadata;
+            return download_page_ranges_diff_async(previous_snapshot_time, condition, options, context).get();
         }
 
         /// <summary>
-        /// Gets the date and time that the blob snapshot was taken, if this blob is a snapshot.
+        /// Returns a task that performs an asynchronous operation to get the page ranges that differ between this blob or snapshot and an earlier snapshot of the blob.
         /// </summary>
-        /// <returns>The blob's snapshot time, if the blob is a snapshot; otherwise, returns an empty string.</returns>
-        const utility::string_t& snapshot_time() const
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_diff_range" />, that represents the current operation.</returns>
+        pplx::task<std::vector<page_diff_range>> download_page_ranges_diff_async(const utility::string_t& previous_snapshot_time) const
         {
-            return m_snapshot_time;
+            return download_page_ranges_diff_async(previous_snapshot_time, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Gets a value indicating whether this blob is a snapshot.
+        /// Returns a task that performs an asynchronous operation to get the page ranges that differ between this blob or snapshot and an earlier snapshot of the blob.
         /// </summary>
-        /// <returns><c>true</c> if this blob is a snapshot; otherwise, <c>false</c>.</returns>
-        bool is_snapshot() const
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_diff_range" />, that represents the current operation.</returns>
+        /// <remarks>The ranges are written ranges, with new content, or cleared ranges, which only contain zeros now. This request is sent with 
+        /// a later service version than the others, because earlier versions do not compare snapshots.</remarks>
+        WASTORAGE_API pplx::task<std::vector<page_diff_range>> download_page_ranges_diff_async(const utility::string_t& previous_snapshot_time, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Applies the changes made since an earlier snapshot of the blob to a replica of that snapshot.
+        /// </summary>
+        /// <param name="target">A seekable stream positioned at the start of the replica.</param>
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        void download_changes_to_stream(concurrency::streams::ostream target, const utility::string_t& previous_snapshot_time)
         {
-            return !m_snapshot_time.empty();
+            download_changes_to_stream_async(target, previous_snapshot_time).wait();
         }
 
         /// <summary>
-        /// Gets the state of the most recent or pending copy operation.
+        /// Applies the changes made since an earlier snapshot of the blob to a replica of that snapshot.
         /// </summary>
-        /// <returns>A <see cref="wa::storage::copy_state" /> object containing the copy state.</returns>
-        const wa::storage::copy_state& copy_state() const
+        /// <param name="target">A seekable stream positioned at the start of the replica.</param>
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        void download_changes_to_stream(concurrency::streams::ostream target, const utility::string_t& previous_snapshot_time, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return *m_copy_state;
+            download_changes_to_stream_async(target, previous_snapshot_time, condition, options, context).wait();
         }
 
         /// <summary>
-        /// Gets the blob URI for all locations.
+        /// Returns a task that performs an asynchronous operation to apply the changes made since an earlier snapshot of the blob to a replica of that snapshot.
         /// </summary>
-        /// <returns>A <see cref="storage_uri" /> containing the blob URI for all locations.</returns>
-        const storage_uri& uri() const
+        /// <param name="target">A seekable stream positioned at the start of the replica.</param>
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> download_changes_to_stream_async(concurrency::streams::ostream target, const utility::string_t& previous_snapshot_time)
         {
-            return m_uri;
+            return download_changes_to_stream_async(target, previous_snapshot_time, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Gets the blob's name.
+        /// Returns a task that performs an asynchronous operation to apply the changes made since an earlier snapshot of the blob to a replica of that snapshot.
         /// </summary>
-        /// <returns>The blob's name.</returns>
-        const utility::string_t& name() const
+        /// <param name="target">A seekable stream positioned at the start of the replica.</param>
+        /// <param name="previous_snapshot_time">The snapshot time of the earlier snapshot.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>Only the written ranges are downloaded, up to <see cref="wa::storage::blob_request_options::parallelism_factor" /> pieces at the same time,
+        /// and the cleared ranges are overwritten with zeros. If the blob was resized, the caller has to resize the replica to <see cref="cloud_blob_properties::size" /> as well.</remarks>
+        WASTORAGE_API pplx::task<void> download_changes_to_stream_async(concurrency::streams::ostream target, const utility::string_t& previous_snapshot_time, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+    private:
+
+        pplx::task<void> download_page_ranges_to_stream_async(concurrency::streams::ostream target, const std::vector<page_diff_range>& ranges, const access_condition& condition, const blob_request_options& modified_options, operation_context context);
+    };
+
+    /// <summary>
+    /// The outcome of a copy run by a <see cref="wa::storage::blob_copy_manager" />.
+    /// </summary>
+    class blob_copy_result
+    {
+    public:
+
+        blob_copy_result(cloud_blob destination, std::exception_ptr error)
+            : m_destination(std::move(destination)), m_error(error), m_stalled(false)
+        {
+        }
+
+        blob_copy_result(cloud_blob destination, bool stalled)
+            : m_destination(std::move(destination)), m_stalled(stalled)
         {
-            return m_name;
         }
 
         /// <summary>
-        /// Gets the type of the blob.
+        /// Gets the destination blob of the copy. Its <see cref="cloud_blob::copy_state" /> is the final state of the copy.
         /// </summary>
-        /// <returns>The type of the blob.</returns>
-        blob_type type() const
+        /// <returns>The destination blob.</returns>
+        const cloud_blob& destination() const
         {
-            return m_properties->type();
+            return m_destination;
         }
 
         /// <summary>
-        /// Indicates whether the <see cref="cloud_blob" /> object is valid.
+        /// Gets the error that kept the copy from being started or its state from being retrieved.
         /// </summary>
-        /// <returns><c>true</c> if the <see cref="cloud_blob" /> object is valid; otherwise, <c>false</c>.</returns>
-        bool is_valid() const
+        /// <returns>The error, or <c>nullptr</c> if the copy ran to a final state.</returns>
+        std::exception_ptr error() const
         {
-            return !m_name.empty();
+            return m_error;
         }
 
-    protected:
-
-        void assert_no_snapshot() const;
-
-        void set_type(blob_type value)
+        /// <summary>
+        /// Gets a value indicating whether the copy was aborted by the manager because it made no progress.
+        /// </summary>
+        /// <returns><c>true</c> if the copy stalled and was aborted.</returns>
+        bool stalled() const
         {
-            m_properties->set_type(value);
+            return m_stalled;
         }
 
-        std::shared_ptr<cloud_blob_properties> m_properties;
-        std::shared_ptr<cloud_metadata> m_metadata;
-        std::shared_ptr<wa::storage::copy_state> m_copy_state;
-
     private:
 
-        void init(const utility::string_t& snapshot_time, storage_credentials credentials);
-        WASTORAGE_API pplx::task<bool> exists_async(bool primary_only, const blob_request_options& options, operation_context context);
-
-        storage_uri m_uri;
-        utility::string_t m_name;
-        utility::string_t m_snapshot_time;
-        cloud_blob_container m_container;
+        cloud_blob m_destination;
+        std::exception_ptr m_error;
+        bool m_stalled;
     };
 
     /// <summary>
-    /// Represents a blob that is uploaded as a set of blocks.
+    /// Copies blobs into a container on the service side, and waits for the copies to complete.
     /// </summary>
-    class cloud_block_blob : public cloud_blob
+    /// <remarks>
+    /// At most the maximum number of concurrent copies are pending on the service at the same time; the others wait until one of them
+    /// completes. The state of all pending copies is retrieved with a single listing of the container, with copy details included and
+    /// limited to the longest prefix that the names of the pending destinations share, instead of one request per blob. The polling 
+    /// interval doubles from the minimum to the maximum polling interval while no copy makes progress, and goes back to the minimum as
+    /// soon as one does. A copy whose number of bytes copied has not changed for the stall timeout is aborted.
+    /// </remarks>
+    class blob_copy_manager
     {
     public:
+
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_copy_manager" /> class.
         /// </summary>
-        cloud_block_blob()
-            : cloud_blob()
+        /// <param name="container">The container the blobs are copied into.</param>
+        explicit blob_copy_manager(const cloud_blob_container& container)
+            : m_container(container), m_max_concurrent_copies(protocol::default_max_concurrent_copies), m_min_polling_interval(protocol::default_min_copy_polling_interval),
+            m_max_polling_interval(protocol::default_max_copy_polling_interval), m_stall_timeout(protocol::default_copy_stall_timeout)
         {
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_copy_manager" /> class.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        cloud_block_blob(const storage_uri& uri)
-            : cloud_blob(uri)
+        /// <param name="container">The container the blobs are copied into.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests.</param>
+        blob_copy_manager(const cloud_blob_container& container, const blob_request_options& options, operation_context context)
+            : m_container(container), m_options(options), m_context(context), m_max_concurrent_copies(protocol::default_max_concurrent_copies),
+            m_min_polling_interval(protocol::default_min_copy_polling_interval), m_max_polling_interval(protocol::default_max_copy_polling_interval),
+            m_stall_timeout(protocol::default_copy_stall_timeout)
         {
-            set_type(blob_type::block_blob);
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
+        /// Adds a copy of a blob to the container. The copy is started once fewer than the maximum number of concurrent copies are pending.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_block_blob(const storage_uri& uri, const storage_credentials& credentials)
-            : cloud_blob(uri, credentials)
+        /// <param name="source">The URI of the source blob, including a shared access signature if the source is not public.</param>
+        /// <param name="destination_name">The name of the destination blob in the container.</param>
+        /// <remarks>The settings of the manager are fixed when the first copy is added.</remarks>
+        WASTORAGE_API void add(const web::http::uri& source, const utility::string_t& destination_name);
+
+        /// <summary>
+        /// Waits until every copy added so far has reached a final state.
+        /// </summary>
+        /// <returns>The results of all copies added so far.</returns>
+        std::vector<blob_copy_result> wait_all()
         {
-            set_type(blob_type::block_blob);
+            return wait_all_async().get();
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class using an absolute URI to the blob.
+        /// Returns a task that completes once every copy added so far has reached a final state.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_block_blob(const storage_uri& uri, const utility::string_t& snapshot_time, const storage_credentials& credentials)
-            : cloud_blob(uri, snapshot_time, credentials)
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="blob_copy_result" />, with the results of all copies added so far.</returns>
+        WASTORAGE_API pplx::task<std::vector<blob_copy_result>> wait_all_async();
+
+        /// <summary>
+        /// Gets the maximum number of copies that are pending on the service at the same time.
+        /// </summary>
+        /// <returns>The maximum number of concurrent copies.</returns>
+        int max_concurrent_copies() const
         {
-            set_type(blob_type::block_blob);
+            return m_max_concurrent_copies;
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class.
+        /// Sets the maximum number of copies that are pending on the service at the same time.
         /// </summary>
-        /// <param name="name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <param name="container">A reference to the parent container.</param>
-        cloud_block_blob(const utility::string_t& name, const utility::string_t& snapshot_time, const cloud_blob_container& container)
-            : cloud_blob(name, snapshot_time, container)
+        /// <param name="value">The maximum number of concurrent copies, which must be at least 1.</param>
+        void set_max_concurrent_copies(int value)
         {
-            set_type(blob_type::block_blob);
+            m_max_concurrent_copies = value;
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_block_blob" /> class.
+        /// Gets the time to wait before the first poll, and after a poll in which a copy made progress.
         /// </summary>
-        /// <param name="blob">Reference to the blob.</param>
-        cloud_block_blob(const cloud_blob& blob)
-            : cloud_blob(blob)
+        /// <returns>The minimum polling interval.</returns>
+        std::chrono::milliseconds min_polling_interval() const
         {
-            set_type(blob_type::block_blob);
+            return m_min_polling_interval;
         }
 
         /// <summary>
-        /// Opens a stream for writing to the block blob.
+        /// Sets the time to wait before the first poll, and after a poll in which a copy made progress.
         /// </summary>
-        /// <returns>A stream to be used for writing to the blob.</returns>
-        concurrency::streams::ostream open_write()
+        /// <param name="value">The minimum polling interval.</param>
+        void set_min_polling_interval(std::chrono::milliseconds value)
         {
-            return open_write_async().get();
+            m_min_polling_interval = value;
         }
 
         /// <summary>
-        /// Opens a stream for writing to the block blob.
+        /// Gets the longest time to wait between two polls.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A stream to be used for writing to the blob.</returns>
-        concurrency::streams::ostream open_write(const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>The maximum polling interval.</returns>
+        std::chrono::milliseconds max_polling_interval() const
         {
-            return open_write_async(condition, options, context).get();
+            return m_max_polling_interval;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for writing to the block blob.
+        /// Sets the longest time to wait between two polls.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
-        pplx::task<concurrency::streams::ostream> open_write_async()
+        /// <param name="value">The maximum polling interval.</param>
+        void set_max_polling_interval(std::chrono::milliseconds value)
         {
-            return open_write_async(access_condition(), blob_request_options(), operation_context());
+            m_max_polling_interval = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for writing to the block blob.
+        /// Gets the time after which a copy that has made no progress is aborted.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<concurrency::streams::ostream> open_write_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>The stall timeout, or 0 if stalled copies are not aborted.</returns>
+        std::chrono::seconds stall_timeout() const
+        {
+            return m_stall_timeout;
+        }
 
         /// <summary>
-        /// Returns an enumerable collection of the blob's blocks, using the specified block list filter.
+        /// Sets the time after which a copy that has made no progress is aborted.
         /// </summary>
-        /// <returns>An enumerable collection of objects implementing <see cref="wa::storage::block_list_item" />.</returns>
-        std::vector<block_list_item> download_block_list() const
+        /// <param name="value">The stall timeout, or 0 if stalled copies are not aborted.</param>
+        void set_stall_timeout(std::chrono::seconds value)
         {
-            return download_block_list_async().get();
+            m_stall_timeout = value;
         }
 
+    private:
+
+        struct shared_state;
+
+        blob_copy_manager(const blob_copy_manager&);
+        blob_copy_manager& operator=(const blob_copy_manager&);
+
+        cloud_blob_container m_container;
+        blob_request_options m_options;
+        operation_context m_context;
+        int m_max_concurrent_copies;
+        std::chrono::milliseconds m_min_polling_interval;
+        std::chrono::milliseconds m_max_polling_interval;
+        std::chrono::seconds m_stall_timeout;
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+    /// <summary>
+    /// Represents a file or blob that could not be transferred by a <see cref="wa::storage::blob_directory_transfer_manager" />.
+    /// </summary>
+    class blob_transfer_failure
+    {
+    public:
+
         /// <summary>
-        /// Returns an enumerable collection of the blob's blocks, using the specified block list filter.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_transfer_failure" /> class.
         /// </summary>
-        /// <param name="listing_filter">One of the enumeration values that indicates whether to return
-        /// committed blocks, uncommitted blocks, or both.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>An enumerable collection of objects implementing <see cref="wa::storage::block_list_item" />.</returns>
-        std::vector<block_list_item> download_block_list(block_listing_filter listing_filter, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <param name="name">The name of the blob, relative to the virtual directory.</param>
+        /// <param name="error">The exception the transfer failed with.</param>
+        blob_transfer_failure(utility::string_t name, std::exception_ptr error)
+            : m_name(std::move(name)), m_error(std::move(error))
         {
-            return download_block_list_async(listing_filter, condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return an enumerable collection of the blob's blocks, 
-        /// using the specified block list filter.
+        /// Gets the name of the blob that could not be transferred, relative to the virtual directory.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="block_list_item" />, that represents the current operation.</returns>
-        pplx::task<std::vector<block_list_item>> download_block_list_async() const
+        /// <returns>The name of the blob.</returns>
+        const utility::string_t& name() const
         {
-            return download_block_list_async(block_listing_filter::committed, access_condition(), blob_request_options(), operation_context());
+            return m_name;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to return an enumerable collection of the blob's blocks, 
-        /// using the specified block list filter.
+        /// Gets the exception the transfer failed with.
         /// </summary>
-        /// <param name="listing_filter">One of the enumeration values that indicates whether to return
-        /// committed blocks, uncommitted blocks, or both.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="block_list_item" />, that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<std::vector<block_list_item>> download_block_list_async(block_listing_filter listing_filter, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <returns>A pointer to the exception, which can be rethrown with std::rethrow_exception.</returns>
+        std::exception_ptr error() const
+        {
+            return m_error;
+        }
+
+    private:
+
+        utility::string_t m_name;
+        std::exception_ptr m_error;
+    };
+
+    /// <summary>
+    /// Mirrors a local directory tree to a virtual directory of block blobs, or a virtual directory to a local directory tree.
+    /// </summary>
+    /// <remarks>
+    /// Every file of a transfer is scheduled on a single work queue, of which up to the maximum number of concurrent transfers run at the same time.
+    /// A file that is not larger than the chunk size is transferred as a whole, and a larger file is split into chunks of the chunk size. Small files
+    /// and chunks take turns, and the chunks of the large files in progress are taken in round-robin order, so neither kind of file holds up the other.
+    /// While a chunk is transferred, its size is held from the memory budget of the service client, and all requests go through the connection pool
+    /// of the service client. If a checkpoint file is set, the name of every file that has been transferred is appended to it, and files listed in it
+    /// are skipped, so that an interrupted transfer can be restarted where it stopped. Use a different checkpoint file for each transfer.
+    /// A sync only transfers the files that differ between the two sides. A file is the same as its blob if their sizes are equal, and
+    /// either their MD5 hashes are equal or, if the blob has no Content-MD5, the copy being synced to was written after the other one
+    /// last changed. Local files are hashed in parallel, and if a hash cache file is set, a hash is kept there with the size and
+    /// last write time of its file, so that a file is only hashed again once it has changed.
+    /// </remarks>
+    class blob_directory_transfer_manager
+    {
+    public:
 
         /// <summary>
-        /// Downloads the blob's contents as a string.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_directory_transfer_manager" /> class.
         /// </summary>
-        /// <returns>The contents of the blob, as a string.</returns>
-        utility::string_t download_text()
+        /// <param name="directory">The virtual directory to transfer to or from.</param>
+        explicit blob_directory_transfer_manager(const cloud_blob_directory& directory)
+            : m_directory(directory), m_max_concurrent_transfers(protocol::default_max_concurrent_transfers), m_chunk_size(protocol::default_transfer_chunk_size),
+            m_delete_extraneous(false)
         {
-            return download_text_async().get();
         }
 
         /// <summary>
-        /// Downloads the blob's contents as a string.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_directory_transfer_manager" /> class.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>The contents of the blob, as a string.</returns>
-        utility::string_t download_text(const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="directory">The virtual directory to transfer to or from.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests.</param>
+        blob_directory_transfer_manager(const cloud_blob_directory& directory, const blob_request_options& options, operation_context context)
+            : m_directory(directory), m_options(options), m_context(context), m_max_concurrent_transfers(protocol::default_max_concurrent_transfers),
+            m_chunk_size(protocol::default_transfer_chunk_size), m_delete_extraneous(false)
         {
-            return download_text_async(condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to download the blob's contents as a string.
+        /// Uploads every file in a local directory tree to a block blob in the virtual directory.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        pplx::task<utility::string_t> download_text_async()
+        /// <param name="local_directory">The path of the local directory.</param>
+        /// <returns>The files that could not be uploaded.</returns>
+        std::vector<blob_transfer_failure> upload_directory(const utility::string_t& local_directory)
         {
-            return download_text_async(access_condition(), blob_request_options(), operation_context());
+            return upload_directory_async(local_directory).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to download the blob's contents as a string.
+        /// Returns a task that uploads every file in a local directory tree to a block blob in the virtual directory.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="utility::string_t" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<utility::string_t> download_text_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="local_directory">The path of the local directory.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="blob_transfer_failure" />, with the files that could not be uploaded.</returns>
+        /// <remarks>The blob names use the directory delimiter of the service client in place of the path separators. Existing blobs are overwritten.</remarks>
+        WASTORAGE_API pplx::task<std::vector<blob_transfer_failure>> upload_directory_async(const utility::string_t& local_directory);
 
         /// <summary>
-        /// Uploads a single block.
+        /// Downloads every blob in the virtual directory to a file in a local directory tree.
         /// </summary>
-        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
-        /// <param name="block_data">A stream that provides the data for the block.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        void upload_block(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5) const
+        /// <param name="local_directory">The path of the local directory, which is created if it does not exist.</param>
+        /// <returns>The blobs that could not be downloaded.</returns>
+        std::vector<blob_transfer_failure> download_directory(const utility::string_t& local_directory)
         {
-            upload_block_async(block_id, block_data, content_md5).wait();
+            return download_directory_async(local_directory).get();
         }
 
         /// <summary>
-        /// Uploads a single block.
+        /// Returns a task that downloads every blob in the virtual directory to a file in a local directory tree.
         /// </summary>
-        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
-        /// <param name="block_data">A stream that provides the data for the block.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_block(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <param name="local_directory">The path of the local directory, which is created if it does not exist.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="blob_transfer_failure" />, with the blobs that could not be downloaded.</returns>
+        /// <remarks>Local subdirectories are created for the virtual subdirectories. Existing files are overwritten.</remarks>
+        WASTORAGE_API pplx::task<std::vector<blob_transfer_failure>> download_directory_async(const utility::string_t& local_directory);
+
+        /// <summary>
+        /// Uploads the files in a local directory tree that differ from their blobs in the virtual directory.
+        /// </summary>
+        /// <param name="local_directory">The path of the local directory.</param>
+        /// <returns>The files that could not be hashed, uploaded or deleted.</returns>
+        std::vector<blob_transfer_failure> sync_upload_directory(const utility::string_t& local_directory)
         {
-            upload_block_async(block_id, block_data, content_md5, condition, options, context).wait();
+            return sync_upload_directory_async(local_directory).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a single block.
+        /// Returns a task that uploads the files in a local directory tree that differ from their blobs in the virtual directory.
         /// </summary>
-        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
-        /// <param name="block_data">A stream that provides the data for the block.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_block_async(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5) const
+        /// <param name="local_directory">The path of the local directory.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="blob_transfer_failure" />, with the files that could not be hashed, uploaded or deleted.</returns>
+        /// <remarks>Every uploaded blob gets the MD5 hash of its file as its Content-MD5, which the next sync compares against. If extraneous
+        /// items are deleted, blobs without a local file are deleted with their snapshots once every upload has completed.</remarks>
+        WASTORAGE_API pplx::task<std::vector<blob_transfer_failure>> sync_upload_directory_async(const utility::string_t& local_directory);
+
+        /// <summary>
+        /// Downloads the blobs in the virtual directory that differ from their files in a local directory tree.
+        /// </summary>
+        /// <param name="local_directory">The path of the local directory, which is created if it does not exist.</param>
+        /// <returns>The files that could not be hashed, downloaded or deleted.</returns>
+        std::vector<blob_transfer_failure> sync_download_directory(const utility::string_t& local_directory)
         {
-            return upload_block_async(block_id, block_data, content_md5, access_condition(), blob_request_options(), operation_context());
+            return sync_download_directory_async(local_directory).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a single block.
+        /// Returns a task that downloads the blobs in the virtual directory that differ from their files in a local directory tree.
         /// </summary>
-        /// <param name="block_id">A Base64-encoded block ID that identifies the block.</param>
-        /// <param name="block_data">A stream that provides the data for the block.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_block_async(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <param name="local_directory">The path of the local directory, which is created if it does not exist.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="blob_transfer_failure" />, with the files that could not be hashed, downloaded or deleted.</returns>
+        /// <remarks>Local files are only hashed if their blobs have a Content-MD5 and the same size. If extraneous items are deleted, files
+        /// without a blob are deleted once every download has completed.</remarks>
+        WASTORAGE_API pplx::task<std::vector<blob_transfer_failure>> sync_download_directory_async(const utility::string_t& local_directory);
 
         /// <summary>
-        /// Uploads a list of blocks to a new or existing blob. 
+        /// Gets the maximum number of files and chunks that are transferred at the same time.
         /// </summary>
-        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
-        void upload_block_list(const std::vector<block_list_item>& block_list)
+        /// <returns>The maximum number of concurrent transfers.</returns>
+        int max_concurrent_transfers() const
         {
-            upload_block_list_async(block_list).wait();
+            return m_max_concurrent_transfers;
         }
 
         /// <summary>
-        /// Uploads a list of blocks to a new or existing blob. 
+        /// Sets the maximum number of files and chunks that are transferred at the same time.
         /// </summary>
-        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_block_list(const std::vector<block_list_item>& block_list, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="value">The maximum number of concurrent transfers, which must be at least 1.</param>
+        void set_max_concurrent_transfers(int value)
         {
-            upload_block_list_async(block_list, condition, options, context).wait();
+            m_max_concurrent_transfers = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a list of blocks to a new or existing blob. 
+        /// Gets the size of the chunks that files larger than it are transferred in.
         /// </summary>
-        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_block_list_async(const std::vector<block_list_item>& block_list)
+        /// <returns>The chunk size, in bytes.</returns>
+        size_t chunk_size() const
         {
-            return upload_block_list_async(block_list, access_condition(), blob_request_options(), operation_context());
+            return m_chunk_size;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a list of blocks to a new or existing blob. 
+        /// Sets the size of the chunks that files larger than it are transferred in.
         /// </summary>
-        /// <param name="block_list">An enumerable collection of block IDs, as Base64-encoded strings.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_block_list_async(const std::vector<block_list_item>& block_list, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="value">The chunk size, in bytes, which must be positive and cannot be greater than 4MB.</param>
+        void set_chunk_size(size_t value)
+        {
+            m_chunk_size = value;
+        }
 
         /// <summary>
-        /// Uploads a stream to a block blob.
+        /// Gets the path of the file that records the files that have been transferred.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        void upload_from_stream(concurrency::streams::istream source)
+        /// <returns>The path of the checkpoint file, or an empty string if no checkpoint is kept.</returns>
+        const utility::string_t& checkpoint_path() const
         {
-            upload_from_stream_async(source).wait();
+            return m_checkpoint_path;
         }
 
         /// <summary>
-        /// Uploads a stream to a block blob.
+        /// Sets the path of the file that records the files that have been transferred.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_from_stream(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="value">The path of the checkpoint file, or an empty string to keep no checkpoint.</param>
+        void set_checkpoint_path(utility::string_t value)
         {
-            upload_from_stream_async(source, condition, options, context).wait();
+            m_checkpoint_path = std::move(value);
         }
 
         /// <summary>
-        /// Uploads a stream to a block blob.
+        /// Gets a value indicating whether a sync deletes the items at the destination that the source does not have.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length)
+        /// <returns><c>true</c> if extraneous blobs or files are deleted; otherwise, <c>false</c>.</returns>
+        bool delete_extraneous() const
         {
-            upload_from_stream_async(source, length).wait();
+            return m_delete_extraneous;
         }
 
         /// <summary>
-        /// Uploads a stream to a block blob.
+        /// Sets a value indicating whether a sync deletes the items at the destination that the source does not have.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="value"><c>true</c> to delete extraneous blobs or files; otherwise, <c>false</c>.</param>
+        void set_delete_extraneous(bool value)
         {
-            upload_from_stream_async(source, length, condition, options, context).wait();
+            m_delete_extraneous = value;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
+        /// Gets the path of the file that keeps the MD5 hashes of the local files between syncs.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source)
+        /// <returns>The path of the hash cache file, or an empty string if no hashes are kept.</returns>
+        const utility::string_t& hash_cache_path() const
         {
-            return upload_from_stream_async(source, protocol::invalid_size64_t);
+            return m_hash_cache_path;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
+        /// Sets the path of the file that keeps the MD5 hashes of the local files between syncs.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="value">The path of the hash cache file, or an empty string to keep no hashes. Use a different file for each local directory.</param>
+        void set_hash_cache_path(utility::string_t value)
         {
-            return upload_from_stream_async(source, protocol::invalid_size64_t, condition, options, context);
+            m_hash_cache_path = std::move(value);
+        }
+
+    private:
+
+        struct shared_state;
+
+        blob_directory_transfer_manager(const blob_directory_transfer_manager&);
+        blob_directory_transfer_manager& operator=(const blob_directory_transfer_manager&);
+
+        pplx::task<std::vector<blob_transfer_failure>> transfer_async(const utility::string_t& local_directory, bool is_upload, bool is_sync);
+
+        cloud_blob_directory m_directory;
+        blob_request_options m_options;
+        operation_context m_context;
+        int m_max_concurrent_transfers;
+        size_t m_chunk_size;
+        utility::string_t m_checkpoint_path;
+        bool m_delete_extraneous;
+        utility::string_t m_hash_cache_path;
+    };
+
+    /// <summary>
+    /// Keeps leases on blobs and containers from expiring, by renewing them before their lease time runs out.
+    /// </summary>
+    /// <remarks>
+    /// Every tracked lease is renewed once a third of its lease time is left. All leases share a single timer, which passes over a wheel
+    /// of one-second slots and renews the leases in a slot together, so tracking a lease does not start a task or a thread of its own.
+    /// A renewal that fails because the request could not be completed is tried again on the next tick for as long as the lease has not
+    /// expired yet. A lease that the service rejects, or that expires, is lost: it stops being tracked and its loss handler is called.
+    /// Leases of infinite duration are tracked without being renewed. Tracked leases are identified by the URI of their blob or container.
+    /// </remarks>
+    class blob_lease_keeper
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::blob_lease_keeper" /> class.
+        /// </summary>
+        blob_lease_keeper()
+        {
+            initialize(blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_lease_keeper" /> class.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length)
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        blob_lease_keeper(const blob_request_options& options, operation_context context)
         {
-            return upload_from_stream_async(source, length, access_condition(), blob_request_options(), operation_context());
+            initialize(options, context);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a block blob.
+        /// Stops renewing all tracked leases, which expire when their lease time runs out.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
+        WASTORAGE_API ~blob_lease_keeper();
+
+        /// <summary>
+        /// Starts renewing a lease that has been acquired on a blob.
+        /// </summary>
+        /// <param name="blob">The blob.</param>
+        /// <param name="lease_id">The ID of the lease.</param>
+        /// <param name="duration">The lease time the lease was acquired with.</param>
+        /// <param name="lost_handler">A function that is called with the error that caused the loss if the lease is lost. It may be empty.</param>
+        WASTORAGE_API void track(const cloud_blob& blob, const utility::string_t& lease_id, const lease_time& duration, std::function<void (std::exception_ptr)> lost_handler);
+
+        /// <summary>
+        /// Starts renewing a lease that has been acquired on a container.
+        /// </summary>
+        /// <param name="container">The container.</param>
+        /// <param name="lease_id">The ID of the lease.</param>
+        /// <param name="duration">The lease time the lease was acquired with.</param>
+        /// <param name="lost_handler">A function that is called with the error that caused the loss if the lease is lost. It may be empty.</param>
+        WASTORAGE_API void track(const cloud_blob_container& container, const utility::string_t& lease_id, const lease_time& duration, std::function<void (std::exception_ptr)> lost_handler);
+
+        /// <summary>
+        /// Stops renewing a lease, which expires when its lease time runs out.
+        /// </summary>
+        /// <param name="uri">The URI of the blob or container.</param>
+        WASTORAGE_API void release(const storage_uri& uri);
+
+        /// <summary>
+        /// Gets whether a lease is being renewed.
+        /// </summary>
+        /// <param name="uri">The URI of the blob or container.</param>
+        /// <returns><c>true</c> if the lease is tracked and has not been lost.</returns>
+        WASTORAGE_API bool is_tracked(const storage_uri& uri) const;
 
         /// <summary>
-        /// Uploads a string of text to a blob.
+        /// Gets the number of leases that are being renewed.
         /// </summary>
-        /// <param name="content">A string containing the text to upload.</param>
-        void upload_text(const utility::string_t& content)
-        {
-            upload_text_async(content).wait();
-        }
+        /// <returns>The number of tracked leases.</returns>
+        WASTORAGE_API size_t tracked_count() const;
 
         /// <summary>
-        /// Uploads a string of text to a blob.
+        /// Gets an access condition that makes a request to a blob or container succeed only while the tracked lease is held.
         /// </summary>
-        /// <param name="content">A string containing the text to upload.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_text(const utility::string_t& content, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            upload_text_async(content, condition, options, context).wait();
-        }
+        /// <param name="uri">The URI of the blob or container.</param>
+        /// <returns>An <see cref="wa::storage::access_condition" /> object with the ID of the lease.</returns>
+        /// <remarks>Throws std::invalid_argument if the lease is not tracked, which includes a lease that has been lost.</remarks>
+        WASTORAGE_API access_condition get_access_condition(const storage_uri& uri) const;
 
         /// <summary>
-        /// Uploads a string of text to a blob.
+        /// Stops renewing a lease and releases it on the service, so that it can be acquired again right away.
         /// </summary>
-        /// <param name="content">A string containing the text to upload.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_text_async(const utility::string_t& content)
+        /// <param name="uri">The URI of the blob or container.</param>
+        void release_lease(const storage_uri& uri)
         {
-            return upload_text_async(content, access_condition(), blob_request_options(), operation_context());
+            release_lease_async(uri).wait();
         }
 
         /// <summary>
-        /// Uploads a string of text to a blob.
+        /// Returns a task that stops renewing a lease and releases it on the service, so that it can be acquired again right away.
+        /// A renewal that is in progress is waited for first.
         /// </summary>
-        /// <param name="content">A string containing the text to upload.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <param name="uri">The URI of the blob or container.</param>
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_text_async(const utility::string_t& content, const access_condition& condition, const blob_request_options& options, operation_context context);
+        WASTORAGE_API pplx::task<void> release_lease_async(const storage_uri& uri);
+
+    private:
+
+        struct shared_state;
+
+        blob_lease_keeper(const blob_lease_keeper&);
+        blob_lease_keeper& operator=(const blob_lease_keeper&);
+
+        WASTORAGE_API void initialize(const blob_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
     };
 
     /// <summary>
-    /// Represents a Windows Azure page blob.
+    /// Buffers writes to a page blob in 512-byte pages, and writes the dirty pages back in large runs.
     /// </summary>
-    class cloud_page_blob : public cloud_blob
+    /// <remarks>
+    /// Writes need not be aligned to pages. The part of a page that a write does not cover is read from the blob first, unless the page is
+    /// cached already. Overlapping writes to a page are merged in the cache, and a flush writes each run of adjacent dirty pages, up to 4MB,
+    /// with a single request, running up to the maximum number of concurrent writes at the same time. A flush starts by itself once the dirty
+    /// pages reach the maximum dirty size, or when the flush interval has passed since a page was made dirty. A page that has been written
+    /// back, or read from the blob, stays cached as a clean page so that reads of it are answered from memory, and the least recently used
+    /// clean pages are dropped once they exceed the maximum clean size. Writes are applied in the order they were started, and a read sees
+    /// every write whose task has completed. The cache assumes that nothing else writes to the blob while it is in use.
+    /// </remarks>
+    class page_blob_write_cache
     {
     public:
+
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class.
+        /// Initializes a new instance of the <see cref="wa::storage::page_blob_write_cache" /> class.
         /// </summary>
-        cloud_page_blob()
-            : cloud_blob()
+        /// <param name="blob">The page blob, which must exist and be large enough for the writes.</param>
+        explicit page_blob_write_cache(const cloud_page_blob& blob)
         {
+            initialize(blob, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class using an absolute URI to the blob.
+        /// Initializes a new instance of the <see cref="wa::storage::page_blob_write_cache" /> class.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        cloud_page_blob(const storage_uri& uri)
-            : cloud_blob(uri)
+        /// <param name="blob">The page blob, which must exist and be large enough for the writes.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for every request, such as the lease on the blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests.</param>
+        page_blob_write_cache(const cloud_page_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            set_type(blob_type::page_blob);
+            initialize(blob, condition, options, context);
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class using an absolute URI to the blob.
+        /// Stops flushing by itself. Dirty pages that have not been flushed are not written to the blob.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_page_blob(const storage_uri& uri, const storage_credentials& credentials)
-            : cloud_blob(uri, credentials)
-        {
-            set_type(blob_type::page_blob);
-        }
+        WASTORAGE_API ~page_blob_write_cache();
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class using an absolute URI to the blob.
+        /// Writes data to the cache.
         /// </summary>
-        /// <param name="uri">A <see cref="storage_uri" /> object containing the absolute URI to the blob for all locations.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_page_blob(const storage_uri& uri, const utility::string_t& snapshot_time, const storage_credentials& credentials)
-            : cloud_blob(uri, snapshot_time, credentials)
+        /// <param name="data">The data to write.</param>
+        /// <param name="length">The number of bytes to write.</param>
+        /// <param name="start_offset">The offset in the blob at which to begin writing, in bytes.</param>
+        void write(const uint8_t* data, size_t length, int64_t start_offset)
         {
-            set_type(blob_type::page_blob);
+            write_async(data, length, start_offset).wait();
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class.
+        /// Returns a task that writes data to the cache.
         /// </summary>
-        /// <param name="name">The name of the blob.</param>
-        /// <param name="snapshot_time">The snapshot timestamp, if the blob is a snapshot.</param>
-        /// <param name="container">A reference to the parent container.</param>
-        cloud_page_blob(const utility::string_t& name, const utility::string_t& snapshot_time, const cloud_blob_container& container)
-            : cloud_blob(name, snapshot_time, container)
-        {
-            set_type(blob_type::page_blob);
-        }
+        /// <param name="data">The data to write, which is copied before the method returns.</param>
+        /// <param name="length">The number of bytes to write.</param>
+        /// <param name="start_offset">The offset in the blob at which to begin writing, in bytes.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once the data is in the cache.</returns>
+        /// <remarks>A write that leaves twice the maximum dirty size of dirty pages completes once the flush it started has completed.</remarks>
+        WASTORAGE_API pplx::task<void> write_async(const uint8_t* data, size_t length, int64_t start_offset);
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_page_blob" /> class.
+        /// Reads data from the cache, or from the blob for the pages that are not cached.
         /// </summary>
-        /// <param name="blob">Reference to the blob.</param>
-        cloud_page_blob(const cloud_blob& blob)
-            : cloud_blob(blob)
+        /// <param name="offset">The offset in the blob at which to begin reading, in bytes.</param>
+        /// <param name="length">The number of bytes to read.</param>
+        /// <returns>The data.</returns>
+        std::vector<uint8_t> read(int64_t offset, size_t length)
         {
-            set_type(blob_type::page_blob);
+            return read_async(offset, length).get();
         }
 
         /// <summary>
-        /// Opens a stream for writing to an existing page blob.
+        /// Returns a task that reads data from the cache, or from the blob for the pages that are not cached.
         /// </summary>
-        /// <returns>A stream to be used for writing to the blob.</returns>
-        concurrency::streams::ostream open_write()
-        {
-            return open_write_async().get();
-        }
+        /// <param name="offset">The offset in the blob at which to begin reading, in bytes.</param>
+        /// <param name="length">The number of bytes to read.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="uint8_t" />, with the data.</returns>
+        WASTORAGE_API pplx::task<std::vector<uint8_t>> read_async(int64_t offset, size_t length);
 
         /// <summary>
-        /// Opens a stream for writing to an existing page blob.
+        /// Writes every dirty page to the blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A stream to be used for writing to the blob.</returns>
-        concurrency::streams::ostream open_write(const access_condition& condition, const blob_request_options& options, operation_context context)
+        void flush()
         {
-            return open_write_async(condition, options, context).get();
+            flush_async().wait();
         }
 
         /// <summary>
-        /// Opens a stream for writing to a new page blob.
+        /// Returns a task that writes every dirty page to the blob, once the writes started before it are in the cache.
         /// </summary>
-        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
-        /// <returns>A stream to be used for writing to the blob.</returns>
-        concurrency::streams::ostream open_write(utility::size64_t size)
-        {
-            return open_write_async(size).get();
-        }
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>A page that could not be written stays dirty, and the task fails with the first error once the other runs are done.</remarks>
+        WASTORAGE_API pplx::task<void> flush_async();
 
         /// <summary>
-        /// Opens a stream for writing to a new page blob.
+        /// Gets the number of bytes in dirty pages, which have not been written to the blob yet.
         /// </summary>
-        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A stream to be used for writing to the blob.</returns>
-        concurrency::streams::ostream open_write(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>The size of the dirty pages, in bytes.</returns>
+        WASTORAGE_API size_t dirty_size() const;
+
+        /// <summary>
+        /// Gets the number of bytes in the pages of the cache, dirty or clean.
+        /// </summary>
+        /// <returns>The size of the cached pages, in bytes.</returns>
+        WASTORAGE_API size_t cached_size() const;
+
+        /// <summary>
+        /// Gets the size of the dirty pages at which a flush starts by itself.
+        /// </summary>
+        /// <returns>The maximum dirty size, in bytes.</returns>
+        WASTORAGE_API size_t max_dirty_size() const;
+
+        /// <summary>
+        /// Sets the size of the dirty pages at which a flush starts by itself.
+        /// </summary>
+        /// <param name="value">The maximum dirty size, in bytes, which must be positive.</param>
+        WASTORAGE_API void set_max_dirty_size(size_t value);
+
+        /// <summary>
+        /// Gets the size of the clean pages above which the least recently used ones are dropped.
+        /// </summary>
+        /// <returns>The maximum clean size, in bytes.</returns>
+        WASTORAGE_API size_t max_clean_size() const;
+
+        /// <summary>
+        /// Sets the size of the clean pages above which the least recently used ones are dropped.
+        /// </summary>
+        /// <param name="value">The maximum clean size, in bytes, or 0 to keep no clean pages.</param>
+        WASTORAGE_API void set_max_clean_size(size_t value);
+
+        /// <summary>
+        /// Gets the time after a page was made dirty at which a flush starts by itself.
+        /// </summary>
+        /// <returns>The flush interval, or 0 if flushes only start by themselves when the maximum dirty size is reached.</returns>
+        WASTORAGE_API std::chrono::milliseconds flush_interval() const;
+
+        /// <summary>
+        /// Sets the time after a page was made dirty at which a flush starts by itself.
+        /// </summary>
+        /// <param name="value">The flush interval, or 0 to only start flushes by themselves when the maximum dirty size is reached.</param>
+        WASTORAGE_API void set_flush_interval(std::chrono::milliseconds value);
+
+        /// <summary>
+        /// Gets the maximum number of runs of dirty pages that a flush writes at the same time.
+        /// </summary>
+        /// <returns>The maximum number of concurrent writes.</returns>
+        WASTORAGE_API int max_concurrent_writes() const;
+
+        /// <summary>
+        /// Sets the maximum number of runs of dirty pages that a flush writes at the same time.
+        /// </summary>
+        /// <param name="value">The maximum number of concurrent writes, which must be at least 1.</param>
+        WASTORAGE_API void set_max_concurrent_writes(int value);
+
+    private:
+
+        struct shared_state;
+
+        page_blob_write_cache(const page_blob_write_cache&);
+        page_blob_write_cache& operator=(const page_blob_write_cache&);
+
+        WASTORAGE_API void initialize(const cloud_page_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+
+    /// <summary>
+    /// Uploads a block blob from several producers at the same time, and commits the parts that they uploaded in the order of their indexes.
+    /// </summary>
+    /// <remarks>
+    /// Each producer claims an index for its part, or uses one it was assigned, and uploads the part independently of the others. A part is
+    /// read in blocks of the stream write size, up to 4MB, and each block is uploaded as soon as it has been read, with up to the maximum number
+    /// of concurrent uploads running at the same time across all parts. The indexes of the parts need not be consecutive. Once every producer
+    /// has finished, committing the writer makes the blob consist of the parts in increasing order of their indexes.
+    /// </remarks>
+    class block_blob_parallel_writer
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::block_blob_parallel_writer" /> class.
+        /// </summary>
+        /// <param name="blob">The block blob to upload.</param>
+        explicit block_blob_parallel_writer(const cloud_block_blob& blob)
         {
-            return open_write_async(size, condition, options, context).get();
+            initialize(blob, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for writing to an existing page blob.
+        /// Initializes a new instance of the <see cref="wa::storage::block_blob_parallel_writer" /> class.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
-        pplx::task<concurrency::streams::ostream> open_write_async()
+        /// <param name="blob">The block blob to upload.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for every request, such as the lease on the blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests.</param>
+        block_blob_parallel_writer(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            return open_write_async(access_condition(), blob_request_options(), operation_context());
+            initialize(blob, condition, options, context);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for writing to an existing page blob.
+        /// Claims the index of a part that no producer has claimed or uploaded yet.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<concurrency::streams::ostream> open_write_async(const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>The index of the part, which is greater than the index of every part claimed or uploaded before.</returns>
+        WASTORAGE_API size_t claim_part();
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for writing to a new page blob.
+        /// Uploads a part of the blob.
         /// </summary>
-        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
-        pplx::task<concurrency::streams::ostream> open_write_async(utility::size64_t size)
+        /// <param name="part_index">The index of the part, which no other part may have.</param>
+        /// <param name="source">The stream providing the data of the part, which is read to its end.</param>
+        void upload_part(size_t part_index, concurrency::streams::istream source)
         {
-            return open_write_async(size, access_condition(), blob_request_options(), operation_context());
+            upload_part_async(part_index, source).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to open a stream for writing to a new page blob.
+        /// Returns a task that uploads a part of the blob.
         /// </summary>
-        /// <param name="size">The size of the write operation, in bytes. The size must be a multiple of 512.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::ostream" /> that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<concurrency::streams::ostream> open_write_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="part_index">The index of the part, which no other part may have.</param>
+        /// <param name="source">The stream providing the data of the part, which is read to its end.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once every block of the part has been uploaded.</returns>
+        WASTORAGE_API pplx::task<void> upload_part_async(size_t part_index, concurrency::streams::istream source);
 
         /// <summary>
-        /// Clears pages from a page blob.
+        /// Commits the parts that have been uploaded as the content of the blob.
         /// </summary>
-        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
-        void clear_pages(int64_t start_offset, int64_t length)
+        void commit()
         {
-            clear_pages_async(start_offset, length).wait();
+            commit_async().wait();
         }
 
         /// <summary>
-        /// Clears pages from a page blob.
+        /// Returns a task that commits the parts that have been uploaded as the content of the blob, once the uploads started before it have completed.
         /// </summary>
-        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void clear_pages(int64_t start_offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            clear_pages_async(start_offset, length, condition, options, context).wait();
-        }
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>If the upload of a part failed, the blob is not committed and the task fails with the first error. No part can be uploaded once the commit has started.</remarks>
+        WASTORAGE_API pplx::task<void> commit_async();
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to clear pages from a page blob.
+        /// Gets the number of parts that have been started.
         /// </summary>
-        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> clear_pages_async(int64_t start_offset, int64_t length)
+        /// <returns>The number of parts.</returns>
+        WASTORAGE_API size_t part_count() const;
+
+        /// <summary>
+        /// Gets the maximum number of blocks that are uploaded at the same time, across all parts.
+        /// </summary>
+        /// <returns>The maximum number of concurrent uploads.</returns>
+        WASTORAGE_API int max_concurrent_uploads() const;
+
+        /// <summary>
+        /// Sets the maximum number of blocks that are uploaded at the same time, across all parts.
+        /// </summary>
+        /// <param name="value">The maximum number of concurrent uploads, which must be at least 1.</param>
+        /// <remarks>The setting is fixed once the first part has been started.</remarks>
+        WASTORAGE_API void set_max_concurrent_uploads(int value);
+
+    private:
+
+        struct shared_state;
+
+        block_blob_parallel_writer(const block_blob_parallel_writer&);
+        block_blob_parallel_writer& operator=(const block_blob_parallel_writer&);
+
+        WASTORAGE_API void initialize(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+    /// <summary>
+    /// Represents the range of blocks of a block blob that one worker of a coordinated upload may upload, and how the blocks are named.
+    /// </summary>
+    /// <remarks>The assignment can be handed to a worker on another machine as the text returned by <see cref="to_string" />.</remarks>
+    class block_upload_assignment
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::block_upload_assignment" /> class.
+        /// </summary>
+        block_upload_assignment()
+            : m_part_index(0), m_first_block(0), m_max_block_count(0)
         {
-            return clear_pages_async(start_offset, length, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to clear pages from a page blob.
+        /// Reads an assignment from the text returned by <see cref="to_string" />.
         /// </summary>
-        /// <param name="start_offset">The offset at which to begin clearing pages, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range to be cleared, in bytes. The length must be a multiple of 512.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> clear_pages_async(int64_t start_offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="value">The text of the assignment.</param>
+        /// <returns>The assignment.</returns>
+        WASTORAGE_API static block_upload_assignment parse(const utility::string_t& value);
 
         /// <summary>
-        /// Gets a collection of valid page ranges and their starting and ending bytes.
+        /// Returns the assignment as text that can be passed to another process.
         /// </summary>
-        /// <returns>An enumerable collection of page ranges.</returns>
-        std::vector<page_range> download_page_ranges() const
+        /// <returns>The text of the assignment.</returns>
+        WASTORAGE_API utility::string_t to_string() const;
+
+        /// <summary>
+        /// Gets the index of the part of the blob that the assignment uploads. The parts make up the blob in increasing order of their indexes.
+        /// </summary>
+        /// <returns>The index of the part.</returns>
+        size_t part_index() const
         {
-            return download_page_ranges_async().get();
+            return m_part_index;
         }
 
         /// <summary>
-        /// Gets a collection of valid page ranges and their starting and ending bytes.
+        /// Gets the number of the first block of the part, among the blocks of the whole blob.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>An enumerable collection of page ranges.</returns>
-        std::vector<page_range> download_page_ranges(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <returns>The number of the first block.</returns>
+        size_t first_block() const
         {
-            return download_page_ranges_async(condition, options, context).get();
+            return m_first_block;
         }
 
         /// <summary>
-        /// Gets a collection of valid page ranges and their starting and ending bytes.
+        /// Gets the maximum number of blocks that the part may have.
         /// </summary>
-        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <returns>An enumerable collection of page ranges.</returns>
-        std::vector<page_range> download_page_ranges(int64_t offset, int64_t length) const
+        /// <returns>The maximum number of blocks.</returns>
+        size_t max_block_count() const
+        {
+            return m_max_block_count;
+        }
+
+        /// <summary>
+        /// Returns the ID of a block of the part.
+        /// </summary>
+        /// <param name="index">The index of the block within the part, which must be less than <see cref="max_block_count" />.</param>
+        /// <returns>The base64 ID of the block, which has the same length as the IDs of every other block of the upload.</returns>
+        WASTORAGE_API utility::string_t get_block_id(size_t index) const;
+
+    private:
+
+        size_t m_part_index;
+        size_t m_first_block;
+        size_t m_max_block_count;
+
+        // The base64 prefix that the IDs of all the blocks of the upload start with
+        utility::string_t m_block_id_prefix;
+
+        friend class block_blob_upload_coordinator;
+    };
+
+    /// <summary>
+    /// Represents what a worker of a coordinated upload has uploaded for its part, which it hands back to the coordinator.
+    /// </summary>
+    class block_upload_receipt
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::block_upload_receipt" /> class.
+        /// </summary>
+        block_upload_receipt()
+            : m_part_index(0), m_block_count(0), m_length(0)
         {
-            return download_page_ranges_async(offset, length).get();
         }
 
         /// <summary>
-        /// Gets a collection of valid page ranges and their starting and ending bytes.
+        /// Initializes a new instance of the <see cref="wa::storage::block_upload_receipt" /> class.
         /// </summary>
-        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>An enumerable collection of page ranges.</returns>
-        std::vector<page_range> download_page_ranges(int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <param name="part_index">The index of the part.</param>
+        /// <param name="block_count">The number of blocks of the part, which are its first blocks.</param>
+        /// <param name="length">The total length of the blocks, in bytes.</param>
+        block_upload_receipt(size_t part_index, size_t block_count, utility::size64_t length)
+            : m_part_index(part_index), m_block_count(block_count), m_length(length)
         {
-            return download_page_ranges_async(offset, length, condition, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
+        /// Reads a receipt from the text returned by <see cref="to_string" />.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
-        pplx::task<std::vector<page_range>> download_page_ranges_async() const
+        /// <param name="value">The text of the receipt.</param>
+        /// <returns>The receipt.</returns>
+        WASTORAGE_API static block_upload_receipt parse(const utility::string_t& value);
+
+        /// <summary>
+        /// Returns the receipt as text that can be passed to another process.
+        /// </summary>
+        /// <returns>The text of the receipt.</returns>
+        WASTORAGE_API utility::string_t to_string() const;
+
+        /// <summary>
+        /// Gets the index of the part that the receipt is for.
+        /// </summary>
+        /// <returns>The index of the part.</returns>
+        size_t part_index() const
         {
-            return download_page_ranges_async(-1, -1);
+            return m_part_index;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
+        /// Gets the number of blocks that were uploaded for the part, which are its first blocks.
         /// </summary>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
-        pplx::task<std::vector<page_range>> download_page_ranges_async(const access_condition& condition, const blob_request_options& options, operation_context context) const
+        /// <returns>The number of blocks.</returns>
+        size_t block_count() const
         {
-            return download_page_ranges_async(-1, -1, condition, options, context);
+            return m_block_count;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
+        /// Gets the total length of the blocks of the part, in bytes.
         /// </summary>
-        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
-        pplx::task<std::vector<page_range>> download_page_ranges_async(int64_t offset, int64_t length) const
+        /// <returns>The length of the part.</returns>
+        utility::size64_t length() const
         {
-            return download_page_ranges_async(offset, length, access_condition(), blob_request_options(), operation_context());
+            return m_length;
         }
 
+    private:
+
+        size_t m_part_index;
+        size_t m_block_count;
+        utility::size64_t m_length;
+    };
+
+    /// <summary>
+    /// Coordinates the upload of a single block blob by workers that may run on many machines.
+    /// </summary>
+    /// <remarks>
+    /// The coordinator splits the blocks a blob may have into one range for each part, and gives every block an ID of the same length that
+    /// no other upload uses. Each worker uploads its part with <see cref="upload_part_async" />, which returns a receipt for the blocks it
+    /// uploaded. Once every worker has finished, <see cref="commit_async" /> checks the receipts against the uncommitted blocks of the blob and
+    /// commits the blocks of all the parts in order with a single request. A part may have fewer blocks than its range holds, but not more.
+    /// </remarks>
+    class block_blob_upload_coordinator
+    {
+    public:
+
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to get a collection of valid page ranges and their starting and ending bytes.
+        /// Initializes a new instance of the <see cref="wa::storage::block_blob_upload_coordinator" /> class, which plans a new upload.
         /// </summary>
-        /// <param name="offset">The starting offset of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <param name="length">The length of the data range over which to list page ranges, in bytes. Must be a multiple of 512.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="page_range" />, that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<std::vector<page_range>> download_page_ranges_async(int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+        /// <param name="blob">The block blob to upload.</param>
+        /// <param name="part_count">The number of parts, which must be between 1 and the maximum number of blocks of a blob.</param>
+        WASTORAGE_API block_blob_upload_coordinator(const cloud_block_blob& blob, size_t part_count);
 
         /// <summary>
-        /// Writes pages to a page blob.
+        /// Initializes a new instance of the <see cref="wa::storage::block_blob_upload_coordinator" /> class, which continues an upload that was planned before.
         /// </summary>
-        /// <param name="page_data">A stream providing the page data.</param>
-        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        void upload_pages(concurrency::streams::istream page_data, int64_t start_offset, const utility::string_t& content_md5)
+        /// <param name="blob">The block blob to upload.</param>
+        /// <param name="assignments">The assignments of the earlier coordinator.</param>
+        block_blob_upload_coordinator(const cloud_block_blob& blob, std::vector<block_upload_assignment> assignments)
+            : m_blob(blob), m_assignments(std::move(assignments))
         {
-            upload_pages_async(page_data, start_offset, content_md5).wait();
         }
 
         /// <summary>
-        /// Writes pages to a page blob.
+        /// Gets the assignments of the parts, in order.
         /// </summary>
-        /// <param name="page_data">A stream providing the page data.</param>
-        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_pages(concurrency::streams::istream page_data, int64_t start_offset, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <returns>The assignments, one for each part.</returns>
+        const std::vector<block_upload_assignment>& assignments() const
         {
-            upload_pages_async(page_data, start_offset, content_md5, condition, options, context).wait();
+            return m_assignments;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to write pages to a page blob.
+        /// Uploads a part of the blob.
         /// </summary>
-        /// <param name="page_data">A stream providing the page data.</param>
-        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_pages_async(concurrency::streams::istream source, int64_t start_offset, const utility::string_t& content_md5)
+        /// <param name="blob">The block blob, which the worker may reference with credentials of its own.</param>
+        /// <param name="assignment">The assignment of the part.</param>
+        /// <param name="source">The stream providing the data of the part, which is read to its end.</param>
+        /// <returns>The receipt for the part.</returns>
+        static block_upload_receipt upload_part(const cloud_block_blob& blob, const block_upload_assignment& assignment, concurrency::streams::istream source)
         {
-            return upload_pages_async(source, start_offset, content_md5, access_condition(), blob_request_options(), operation_context());
+            return upload_part_async(blob, assignment, source, access_condition(), blob_request_options(), operation_context()).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to write pages to a page blob.
+        /// Returns a task that uploads a part of the blob.
         /// </summary>
-        /// <param name="page_data">A stream providing the page data.</param>
-        /// <param name="start_offset">The offset at which to begin writing, in bytes. The offset must be a multiple of 512.</param>
-        /// <param name="content_md5">An optional hash value that will be used to set the Content-MD5 property
-        /// on the blob. May be an empty string.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="blob">The block blob, which the worker may reference with credentials of its own.</param>
+        /// <param name="assignment">The assignment of the part.</param>
+        /// <param name="source">The stream providing the data of the part, which is read to its end.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for every request, such as the lease on the blob.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_pages_async(concurrency::streams::istream source, int64_t start_offset, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object that returns the receipt for the part.</returns>
+        /// <remarks>The part is read in blocks of the stream write size, up to 4MB, and up to the parallelism factor of them are uploaded at the same time.
+        /// The upload fails if the part needs more blocks than its assignment allows.</remarks>
+        WASTORAGE_API static pplx::task<block_upload_receipt> upload_part_async(const cloud_block_blob& blob, const block_upload_assignment& assignment, concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context);
 
         /// <summary>
-        /// Uploads a stream to a page blob.
+        /// Commits the parts that the workers have uploaded as the content of the blob.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        void upload_from_stream(concurrency::streams::istream source)
+        /// <param name="receipts">The receipts that the workers returned, one for each part.</param>
+        void commit(const std::vector<block_upload_receipt>& receipts) const
         {
-            upload_from_stream_async(source).wait();
+            commit_async(receipts, access_condition(), blob_request_options(), operation_context()).wait();
         }
 
         /// <summary>
-        /// Uploads a stream to a page blob.
+        /// Returns a task that commits the parts that the workers have uploaded as the content of the blob.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
+        /// <param name="receipts">The receipts that the workers returned, one for each part.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the request.</param>
         /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_from_stream(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            upload_from_stream_async(source, condition, options, context).wait();
-        }
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>The blob is only committed if every block of every receipt is among its uncommitted blocks, and the blocks of each
+        /// part add up to the length of its receipt.</remarks>
+        WASTORAGE_API pplx::task<void> commit_async(const std::vector<block_upload_receipt>& receipts, const access_condition& condition, const blob_request_options& options, operation_context context) const;
+
+    private:
+
+        cloud_block_blob m_blob;
+        std::vector<block_upload_assignment> m_assignments;
+    };
+
+
+    /// <summary>
+    /// Appends records from many writers to a block blob, by gathering them into blocks and committing the blocks in groups.
+    /// </summary>
+    /// <remarks>
+    /// Records appended at about the same time share a block, which is uploaded once it reaches the maximum block size, or once the maximum
+    /// batch delay has passed since its first record was appended. The blocks are committed after the blocks that the blob already has, in
+    /// the order they were started, and every block that has been uploaded while a commit was running is committed by the next one together.
+    /// The task of a record completes once the block holding it has been committed. A record is never split between blocks. The writer
+    /// assumes that the blob is not written by anything else while it is in use, and that the blocks the blob has were not uploaded with IDs
+    /// of a different length than the ones of this library.
+    /// </remarks>
+    class block_blob_log_writer
+    {
+    public:
 
         /// <summary>
-        /// Uploads a stream to a page blob.
+        /// Initializes a new instance of the <see cref="wa::storage::block_blob_log_writer" /> class.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length)
+        /// <param name="blob">The block blob to append to, which is created by the first commit if it does not exist.</param>
+        explicit block_blob_log_writer(const cloud_block_blob& blob)
         {
-            upload_from_stream_async(source, length).wait();
+            initialize(blob, access_condition(), blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Uploads a stream to a page blob.
+        /// Initializes a new instance of the <see cref="wa::storage::block_blob_log_writer" /> class.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void upload_from_stream(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="blob">The block blob to append to, which is created by the first commit if it does not exist.</param>
+        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for every request, such as the lease on the blob.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests.</param>
+        block_blob_log_writer(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
         {
-            upload_from_stream_async(source, length, condition, options, context).wait();
+            initialize(blob, condition, options, context);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
+        /// Appends a record to the blob.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source)
+        /// <param name="data">The data of the record.</param>
+        /// <param name="length">The length of the record, in bytes, which cannot be greater than the maximum block size.</param>
+        void append(const uint8_t* data, size_t length)
         {
-            return upload_from_stream_async(source, protocol::invalid_size64_t);
+            append_async(data, length).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
+        /// Returns a task that appends a record to the blob.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            return upload_from_stream_async(source, protocol::invalid_size64_t, condition, options, context);
-        }
+        /// <param name="data">The data of the record, which is copied before the method returns.</param>
+        /// <param name="length">The length of the record, in bytes, which cannot be greater than the maximum block size.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once the record has been committed to the blob.</returns>
+        WASTORAGE_API pplx::task<void> append_async(const uint8_t* data, size_t length);
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
+        /// Uploads the records that have been appended without waiting for the maximum batch delay.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length)
+        void flush()
         {
-            return upload_from_stream_async(source, length, access_condition(), blob_request_options(), operation_context());
+            flush_async().wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to upload a stream to a page blob.
+        /// Returns a task that uploads the records that have been appended without waiting for the maximum batch delay.
         /// </summary>
-        /// <param name="source">The stream providing the blob content.</param>
-        /// <param name="length">The number of bytes to write from the source stream at its current position.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <returns>A <see cref="pplx::task" /> object that completes once the last record appended before it has been committed.</returns>
+        WASTORAGE_API pplx::task<void> flush_async();
 
         /// <summary>
-        /// Creates a page blob.
+        /// Gets the size at which a block is uploaded without waiting for the maximum batch delay.
         /// </summary>
-        /// <param name="size">The maximum size of the page blob, in bytes.</param>
-        void create(utility::size64_t size)
-        {
-            create_async(size).wait();
-        }
+        /// <returns>The maximum block size, in bytes.</returns>
+        WASTORAGE_API size_t max_block_size() const;
 
         /// <summary>
-        /// Creates a page blob.
+        /// Sets the size at which a block is uploaded without waiting for the maximum batch delay.
         /// </summary>
-        /// <param name="size">The maximum size of the page blob, in bytes.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void create(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            create_async(size, condition, options, context).wait();
-        }
+        /// <param name="value">The maximum block size, in bytes, which must be positive and cannot be greater than 4MB.</param>
+        WASTORAGE_API void set_max_block_size(size_t value);
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create a page blob.
+        /// Gets the time after the first record of a block was appended at which the block is uploaded.
         /// </summary>
-        /// <param name="size">The maximum size of the page blob, in bytes.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> create_async(utility::size64_t size)
-        {
-            return create_async(size, access_condition(), blob_request_options(), operation_context());
-        }
+        /// <returns>The maximum batch delay.</returns>
+        WASTORAGE_API std::chrono::milliseconds max_batch_delay() const;
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to create a page blob.
+        /// Sets the time after the first record of a block was appended at which the block is uploaded.
         /// </summary>
-        /// <param name="size">The maximum size of the page blob, in bytes.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> create_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="value">The maximum batch delay, or 0 to upload every block as soon as its first record has been appended.</param>
+        WASTORAGE_API void set_max_batch_delay(std::chrono::milliseconds value);
+
+    private:
+
+        struct shared_state;
+
+        block_blob_log_writer(const block_blob_log_writer&);
+        block_blob_log_writer& operator=(const block_blob_log_writer&);
+
+        WASTORAGE_API void initialize(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+
+    /// <summary>
+    /// Merges small range reads of the same blob, started at about the same time, into fewer and larger downloads.
+    /// </summary>
+    /// <remarks>
+    /// Reads of a blob with the same ETag that are started within the batching window are sorted by offset, and the ones that overlap or are
+    /// separated by no more than the maximum gap are downloaded with a single ranged request, up to the maximum merged size. The bytes of each
+    /// read are then written to its own target stream. If the blob has an ETag, the merged downloads only succeed while the blob still has it.
+    /// </remarks>
+    class blob_range_read_scheduler
+    {
+    public:
 
         /// <summary>
-        /// Resizes the page blob to the specified size.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_range_read_scheduler" /> class.
         /// </summary>
-        /// <param name="size">The size of the page blob, in bytes.</param>
-        void resize(utility::size64_t size)
+        blob_range_read_scheduler()
         {
-            resize_async(size).wait();
+            initialize(blob_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Resizes the page blob to the specified size.
+        /// Initializes a new instance of the <see cref="wa::storage::blob_range_read_scheduler" /> class.
         /// </summary>
-        /// <param name="size">The size of the page blob, in bytes.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void resize(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for every download.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the downloads.</param>
+        blob_range_read_scheduler(const blob_request_options& options, operation_context context)
         {
-            resize_async(size, condition, options, context).wait();
+            initialize(options, context);
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to resize the page blob to the specified size.
+        /// Downloads a range of bytes from a blob to a stream.
         /// </summary>
-        /// <param name="size">The size of the page blob, in bytes.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> resize_async(utility::size64_t size)
+        /// <param name="blob">The blob to read from.</param>
+        /// <param name="target">The target stream.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes, which must be positive.</param>
+        void download_range_to_stream(const cloud_blob& blob, concurrency::streams::ostream target, int64_t offset, int64_t length)
         {
-            return resize_async(size, access_condition(), blob_request_options(), operation_context());
+            download_range_to_stream_async(blob, target, offset, length).wait();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to resize the page blob to the specified size.
+        /// Returns a task that downloads a range of bytes from a blob to a stream, together with the reads of nearby ranges of the blob.
         /// </summary>
-        /// <param name="size">The size of the page blob, in bytes.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> resize_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="blob">The blob to read from.</param>
+        /// <param name="target">The target stream.</param>
+        /// <param name="offset">The offset at which to begin downloading the blob, in bytes.</param>
+        /// <param name="length">The length of the data to download from the blob, in bytes, which must be positive.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once the bytes of the range have been written to the target.</returns>
+        WASTORAGE_API pplx::task<void> download_range_to_stream_async(const cloud_blob& blob, concurrency::streams::ostream target, int64_t offset, int64_t length);
 
         /// <summary>
-        /// Sets the page blob's sequence number.
+        /// Gets the largest number of bytes between two reads that are still downloaded together.
         /// </summary>
-        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
-        void set_sequence_number(const wa::storage::sequence_number& sequence_number)
-        {
-            set_sequence_number_async(sequence_number).wait();
-        }
+        /// <returns>The maximum gap, in bytes.</returns>
+        WASTORAGE_API size_t max_gap() const;
 
         /// <summary>
-        /// Sets the page blob's sequence number.
+        /// Sets the largest number of bytes between two reads that are still downloaded together.
         /// </summary>
-        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        void set_sequence_number(const wa::storage::sequence_number& sequence_number, const access_condition& condition, const blob_request_options& options, operation_context context)
-        {
-            set_sequence_number_async(sequence_number, condition, options, context).wait();
-        }
+        /// <param name="value">The maximum gap, in bytes, or 0 to only merge reads that overlap or touch.</param>
+        WASTORAGE_API void set_max_gap(size_t value);
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set the page blob's sequence number.
+        /// Gets the largest range that reads are merged into.
         /// </summary>
-        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        pplx::task<void> set_sequence_number_async(const wa::storage::sequence_number& sequence_number)
-        {
-            return set_sequence_number_async(sequence_number, access_condition(), blob_request_options(), operation_context());
-        }
+        /// <returns>The maximum merged size, in bytes.</returns>
+        WASTORAGE_API size_t max_merged_size() const;
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation to set the page blob's sequence number.
+        /// Sets the largest range that reads are merged into.
         /// </summary>
-        /// <param name="sequence_number">A value of type <see cref="wa::storage::sequence_number"/>, indicating the operation to perform on the sequence number.</param>
-        /// <param name="condition">An <see cref="wa::storage::access_condition" /> object that represents the access condition for the operation.</param>
-        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<void> set_sequence_number_async(const wa::storage::sequence_number& sequence_number, const access_condition& condition, const blob_request_options& options, operation_context context);
+        /// <param name="value">The maximum merged size, in bytes, which must be positive.</param>
+        /// <remarks>A read that is larger than the maximum merged size is downloaded on its own.</remarks>
+        WASTORAGE_API void set_max_merged_size(size_t value);
+
+        /// <summary>
+        /// Gets the time that the first read of a blob waits for other reads of the blob to merge with.
+        /// </summary>
+        /// <returns>The batching window.</returns>
+        WASTORAGE_API std::chrono::milliseconds batching_window() const;
+
+        /// <summary>
+        /// Sets the time that the first read of a blob waits for other reads of the blob to merge with.
+        /// </summary>
+        /// <param name="value">The batching window, which cannot be negative.</param>
+        WASTORAGE_API void set_batching_window(std::chrono::milliseconds value);
+
+    private:
+
+        struct shared_state;
+
+        blob_range_read_scheduler(const blob_range_read_scheduler&);
+        blob_range_read_scheduler& operator=(const blob_range_read_scheduler&);
+
+        WASTORAGE_API void initialize(const blob_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
     };
 
 }} // namespace wa::storage
@@ -17,17 +17,273 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
 #include <unordered_map>
+#include <vector>
 
 #include "core.h"
 #include "retry_policies.h"
 
 namespace wa { namespace storage {
 
+    namespace core
+    {
+        class http_client_pool;
+        class location_selector;
+        class retry_budget;
+        class latency_recorder;
+        class prepared_request_cache;
+        class request_coalescer;
+        class existence_cache;
+        class operation_dispatcher;
+        class circuit_breaker;
+    }
+
     /// <summary>
     /// Represents the user meta-data for queues, containers and blobs.
     /// </summary>
-    typedef std::unordered_map<utility::string_t, utility::string_t> cloud_metadata;
+    /// <remarks>
+    /// The names and values are kept in one vector sorted by name, rather than in a node per entry, since a resource
+    /// rarely has more than a few of them and a listing can return thousands of resources. Lookups work as they do on
+    /// a map, and iterating visits the entries in the order of their names. The name of an entry must not be changed
+    /// through an iterator.
+    /// </remarks>
+    class cloud_metadata
+    {
+    public:
+
+        typedef utility::string_t key_type;
+        typedef utility::string_t mapped_type;
+        typedef std::pair<utility::string_t, utility::string_t> value_type;
+        typedef std::vector<value_type>::iterator iterator;
+        typedef std::vector<value_type>::const_iterator const_iterator;
+        typedef std::vector<value_type>::size_type size_type;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="cloud_metadata"/> class.
+        /// </summary>
+        cloud_metadata()
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="cloud_metadata"/> class with the entries in a range.
+        /// </summary>
+        /// <param name="first">The first entry of the range.</param>
+        /// <param name="last">The end of the range.</param>
+        /// <remarks>If a name occurs more than once, its first entry is kept.</remarks>
+        template<typename InputIterator>
+        cloud_metadata(InputIterator first, InputIterator last)
+        {
+            insert(first, last);
+        }
+
+        cloud_metadata(const cloud_metadata& other)
+            : m_entries(other.m_entries)
+        {
+        }
+
+        cloud_metadata(cloud_metadata&& other)
+            : m_entries(std::move(other.m_entries))
+        {
+        }
+
+        cloud_metadata& operator=(const cloud_metadata& other)
+        {
+            m_entries = other.m_entries;
+            return *this;
+        }
+
+        cloud_metadata& operator=(cloud_metadata&& other)
+        {
+            m_entries = std::move(other.m_entries);
+            return *this;
+        }
+
+        iterator begin()
+        {
+            return m_entries.begin();
+        }
+
+        const_iterator begin() const
+        {
+            return m_entries.begin();
+        }
+
+        iterator end()
+        {
+            return m_entries.end();
+        }
+
+        const_iterator end() const
+        {
+            return m_entries.end();
+        }
+
+        const_iterator cbegin() const
+        {
+            return m_entries.cbegin();
+        }
+
+        const_iterator cend() const
+        {
+            return m_entries.cend();
+        }
+
+        size_type size() const
+        {
+            return m_entries.size();
+        }
+
+        bool empty() const
+        {
+            return m_entries.empty();
+        }
+
+        void clear()
+        {
+            m_entries.clear();
+        }
+
+        /// <summary>
+        /// Reserves space for the given number of entries.
+        /// </summary>
+        /// <param name="count">The number of entries.</param>
+        void reserve(size_type count)
+        {
+            m_entries.reserve(count);
+        }
+
+        void swap(cloud_metadata& other)
+        {
+            m_entries.swap(other.m_entries);
+        }
+
+        iterator find(const key_type& key)
+        {
+            auto iter = lower_bound(key);
+            return (iter != m_entries.end() && iter->first == key) ? iter : m_entries.end();
+        }
+
+        const_iterator find(const key_type& key) const
+        {
+            return const_cast<cloud_metadata*>(this)->find(key);
+        }
+
+        size_type count(const key_type& key) const
+        {
+            return find(key) != m_entries.end() ? 1 : 0;
+        }
+
+        /// <summary>
+        /// Gets the value of the entry with the given name, adding an empty one if there is none.
+        /// </summary>
+        /// <param name="key">The name of the entry.</param>
+        /// <returns>A reference to the value.</returns>
+        mapped_type& operator[](const key_type& key)
+        {
+            auto iter = lower_bound(key);
+            if (iter == m_entries.end() || iter->first != key)
+            {
+                iter = m_entries.insert(iter, value_type(key, mapped_type()));
+            }
+
+            return iter->second;
+        }
+
+        /// <summary>
+        /// Gets the value of the entry with the given name, and throws std::out_of_range if there is none.
+        /// </summary>
+        /// <param name="key">The name of the entry.</param>
+        /// <returns>A reference to the value.</returns>
+        const mapped_type& at(const key_type& key) const
+        {
+            auto iter = find(key);
+            if (iter == m_entries.end())
+            {
+                throw std::out_of_range("The metadata does not have an entry with the given name.");
+            }
+
+            return iter->second;
+        }
+
+        mapped_type& at(const key_type& key)
+        {
+            return const_cast<mapped_type&>(static_cast<const cloud_metadata*>(this)->at(key));
+        }
+
+        /// <summary>
+        /// Adds an entry, unless there already is one with the same name.
+        /// </summary>
+        /// <param name="value">The name and the value of the entry.</param>
+        /// <returns>The entry with the name, and <c>true</c> if it was added.</returns>
+        std::pair<iterator, bool> insert(value_type value)
+        {
+            auto iter = lower_bound(value.first);
+            if (iter != m_entries.end() && iter->first == value.first)
+            {
+                return std::make_pair(iter, false);
+            }
+
+            return std::make_pair(m_entries.insert(iter, std::move(value)), true);
+        }
+
+        template<typename InputIterator>
+        void insert(InputIterator first, InputIterator last)
+        {
+            for (; first != last; ++first)
+            {
+                insert(value_type(first->first, first->second));
+            }
+        }
+
+        size_type erase(const key_type& key)
+        {
+            auto iter = find(key);
+            if (iter == m_entries.end())
+            {
+                return 0;
+            }
+
+            m_entries.erase(iter);
+            return 1;
+        }
+
+        iterator erase(const_iterator position)
+        {
+            return m_entries.erase(begin() + (position - cbegin()));
+        }
+
+        bool operator==(const cloud_metadata& other) const
+        {
+            return m_entries == other.m_entries;
+        }
+
+        bool operator!=(const cloud_metadata& other) const
+        {
+            return m_entries != other.m_entries;
+        }
+
+    private:
+
+        iterator lower_bound(const key_type& key)
+        {
+            return std::lower_bound(m_entries.begin(), m_entries.end(), key, [] (const value_type& entry, const key_type& value) -> bool
+            {
+                return entry.first < value;
+            });
+        }
+
+        std::vector<value_type> m_entries;
+    };
 
     /// <summary>
     /// Represents a continuation token for listing operations. 
@@ -846,6 +1102,11 @@ namespace wa { namespace storage {
     {
     public:
 
+        _operation_context()
+            : m_log_sampling_interval(1), m_max_request_results(std::numeric_limits<size_t>::max()), m_next_request_result(0), m_request_count(0), m_failed_request_count(0)
+        {
+        }
+
         /// <summary>
         /// Gets a string containing the client request ID.
         /// </summary>
@@ -864,6 +1125,24 @@ namespace wa { namespace storage {
             m_client_request_id = client_request_id;
         }
 
+        /// <summary>
+        /// Gets the tag that the operation is dispatched under.
+        /// </summary>
+        /// <returns>A string containing the dispatch tag.</returns>
+        const utility::string_t& dispatch_tag() const
+        {
+            return m_dispatch_tag;
+        }
+
+        /// <summary>
+        /// Sets the tag that the operation is dispatched under.
+        /// </summary>
+        /// <param name="value">A string containing the dispatch tag.</param>
+        void set_dispatch_tag(const utility::string_t& value)
+        {
+            m_dispatch_tag = value;
+        }
+
         /// <summary>
         /// Gets the start time of the request.
         /// </summary>
@@ -918,6 +1197,25 @@ namespace wa { namespace storage {
             m_log_level = log_level;
         }
 
+        /// <summary>
+        /// Gets how many operations share one operation that is logged at the full level.
+        /// </summary>
+        /// <returns>The number of operations, of which one is logged at the full level and the others only log warnings and errors.</returns>
+        size_t log_sampling_interval() const
+        {
+            return m_log_sampling_interval;
+        }
+
+        /// <summary>
+        /// Sets how many operations share one operation that is logged at the full level.
+        /// </summary>
+        /// <param name="interval">The number of operations, of which one is logged at the full level and the others only log warnings and errors.
+        /// Zero and one both log every operation at the full level.</param>
+        void set_log_sampling_interval(size_t interval)
+        {
+            m_log_sampling_interval = interval;
+        }
+
         /// <summary>
         /// Gets the user headers provided for the request.
         /// </summary>
@@ -933,6 +1231,8 @@ namespace wa { namespace storage {
         /// <returns>An enumerable collection of <see cref="request_result" /> objects.</returns>
         const std::vector<request_result>& request_results() const
         {
+            pplx::extensibility::scoped_critical_section_t l(m_request_results_lock);
+            order_request_results();
             return m_request_results;
         }
 
@@ -941,9 +1241,74 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="result">A <see cref="request_result" /> object.</param>
         void add_request_result(const request_result& result)
+        {
+            ++m_request_count;
+            if (!result.is_response_available() || result.http_status_code() >= 400)
+            {
+                ++m_failed_request_count;
+            }
+
+            // Only the counters are kept when no results are, so that no lock is taken
+            if (m_max_request_results == 0)
+            {
+                return;
+            }
+
+            pplx::extensibility::scoped_critical_section_t l(m_request_results_lock);
+            size_t max_request_results = m_max_request_results;
+            if (m_request_results.size() < max_request_results)
+            {
+                m_request_results.push_back(result);
+            }
+            else if (max_request_results > 0)
+            {
+                // Once the limit is reached, the results are a ring buffer in which the oldest one is overwritten
+                m_request_results[m_next_request_result] = result;
+                m_next_request_result = (m_next_request_result + 1) % max_request_results;
+            }
+        }
+
+        /// <summary>
+        /// Gets the maximum number of request results that are kept.
+        /// </summary>
+        /// <returns>The maximum number of request results.</returns>
+        size_t max_request_results() const
+        {
+            return m_max_request_results;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of request results that are kept.
+        /// </summary>
+        /// <param name="value">The maximum number of request results, of which the most recent ones are kept.</param>
+        void set_max_request_results(size_t value)
         {
             pplx::extensibility::scoped_critical_section_t l(m_request_results_lock);
-            m_request_results.push_back(result);
+            order_request_results();
+            if (m_request_results.size() > value)
+            {
+                m_request_results.erase(m_request_results.begin(), m_request_results.end() - value);
+            }
+
+            m_max_request_results = value;
+        }
+
+        /// <summary>
+        /// Gets the number of requests made.
+        /// </summary>
+        /// <returns>The number of requests made.</returns>
+        size_t request_count() const
+        {
+            return m_request_count;
+        }
+
+        /// <summary>
+        /// Gets the number of requests that got no response or an error response.
+        /// </summary>
+        /// <returns>The number of failed requests.</returns>
+        size_t failed_request_count() const
+        {
+            return m_failed_request_count;
         }
 
         /// <summary>
@@ -991,12 +1356,29 @@ namespace wa { namespace storage {
         std::function<void(web::http::http_request &, operation_context)> m_sending_request;
         std::function<void(web::http::http_request &, const web::http::http_response &, operation_context)> m_response_received;
         utility::string_t m_client_request_id;
+        utility::string_t m_dispatch_tag;
         web::http::http_headers m_user_headers;
         utility::datetime m_start_time;
         utility::datetime m_end_time;
         client_log_level m_log_level;
-        std::vector<request_result> m_request_results;
-        pplx::extensibility::critical_section_t m_request_results_lock;
+        size_t m_log_sampling_interval;
+
+        // Puts the results of a full ring buffer back in the order they were added in
+        void order_request_results() const
+        {
+            if (m_next_request_result != 0)
+            {
+                std::rotate(m_request_results.begin(), m_request_results.begin() + m_next_request_result, m_request_results.end());
+                m_next_request_result = 0;
+            }
+        }
+
+        mutable std::vector<request_result> m_request_results;
+        mutable size_t m_next_request_result;
+        std::atomic<size_t> m_max_request_results;
+        std::atomic<size_t> m_request_count;
+        std::atomic<size_t> m_failed_request_count;
+        mutable pplx::extensibility::critical_section_t m_request_results_lock;
     };
 
     /// <summary>
@@ -1049,6 +1431,28 @@ namespace wa { namespace storage {
             return m_impl->set_client_request_id(client_request_id);
         }
 
+        /// <summary>
+        /// Gets the tag that the operation is dispatched under, such as the tenant or the priority it is made for.
+        /// </summary>
+        /// <returns>The dispatch tag, which is empty unless it has been set.</returns>
+        const utility::string_t& dispatch_tag() const
+        {
+            return m_impl->dispatch_tag();
+        }
+
+        /// <summary>
+        /// Sets the tag that the operation is dispatched under, such as the tenant or the priority it is made for.
+        /// </summary>
+        /// <param name="value">The dispatch tag.</param>
+        /// <remarks>
+        /// When the service client limits the number of operations in flight, the operations with each tag are queued separately and
+        /// get a share of the limit by the <see cref="dispatch_tag_settings" /> of the tag. Operations without a tag share the empty tag.
+        /// </remarks>
+        void set_dispatch_tag(const utility::string_t& value)
+        {
+            m_impl->set_dispatch_tag(value);
+        }
+
         /// <summary>
         /// Gets the start time of the operation.
         /// </summary>
@@ -1115,6 +1519,39 @@ namespace wa { namespace storage {
             m_impl->set_log_level(log_level);
         }
 
+        /// <summary>
+        /// Gets the default number of operations of which one is logged at the full level, for subsequently created instances of the <see cref="wa::storage::operation_context"/> class.
+        /// </summary>
+        /// <returns>The default number of operations.</returns>
+        WASTORAGE_API static size_t default_log_sampling_interval();
+
+        /// <summary>
+        /// Sets the default number of operations of which one is logged at the full level, for subsequently created instances of the <see cref="wa::storage::operation_context"/> class.
+        /// </summary>
+        /// <param name="interval">The default number of operations.</param>
+        WASTORAGE_API static void set_default_log_sampling_interval(size_t interval);
+
+        /// <summary>
+        /// Gets the number of operations using the <see cref="wa::storage::operation_context"/> of which one is logged at the full level.
+        /// </summary>
+        /// <returns>The number of operations, of which one is logged at the logging level of the <see cref="wa::storage::operation_context"/>
+        /// and the others only log warnings and errors.</returns>
+        /// <remarks>This allows tracing a sample of the operations at the verbose level without paying for it on every operation.</remarks>
+        size_t log_sampling_interval() const
+        {
+            return m_impl->log_sampling_interval();
+        }
+
+        /// <summary>
+        /// Sets the number of operations using the <see cref="wa::storage::operation_context"/> of which one is logged at the full level.
+        /// </summary>
+        /// <param name="interval">The number of operations, of which one is logged at the logging level of the <see cref="wa::storage::operation_context"/>
+        /// and the others only log warnings and errors. Zero and one both log every operation at the full level.</param>
+        void set_log_sampling_interval(size_t interval)
+        {
+            m_impl->set_log_sampling_interval(interval);
+        }
+
         /// <summary>
         /// Gets or sets additional headers on the request, for example, for proxy or logging information.
         /// </summary>
@@ -1133,6 +1570,45 @@ namespace wa { namespace storage {
             return m_impl->request_results();
         }
 
+        /// <summary>
+        /// Gets the maximum number of request results that are kept.
+        /// </summary>
+        /// <returns>The maximum number of request results.</returns>
+        size_t max_request_results() const
+        {
+            return m_impl->max_request_results();
+        }
+
+        /// <summary>
+        /// Sets the maximum number of request results that are kept.
+        /// </summary>
+        /// <param name="value">The maximum number of request results, or 0 to only count requests.</param>
+        /// <remarks>By default, the result of every request is kept, so a context that is used for many operations keeps growing.
+        /// With a limit, only the most recent results are kept, and with 0, only <see cref="request_count" /> and
+        /// <see cref="failed_request_count" /> are, which also saves requests sent in parallel from waiting on each other.</remarks>
+        void set_max_request_results(size_t value)
+        {
+            m_impl->set_max_request_results(value);
+        }
+
+        /// <summary>
+        /// Gets the number of requests made with the context, including the ones whose results are no longer kept.
+        /// </summary>
+        /// <returns>The number of requests made.</returns>
+        size_t request_count() const
+        {
+            return m_impl->request_count();
+        }
+
+        /// <summary>
+        /// Gets the number of requests made with the context that got no response or an error response.
+        /// </summary>
+        /// <returns>The number of failed requests.</returns>
+        size_t failed_request_count() const
+        {
+            return m_impl->failed_request_count();
+        }
+
         /// <summary>
         /// Sets the function to call when sending a request.
         /// </summary>
@@ -1162,6 +1638,7 @@ namespace wa { namespace storage {
 
         std::shared_ptr<_operation_context> m_impl;
         static client_log_level m_global_log_level;
+        static size_t m_global_log_sampling_interval;
     };
 
     /// <summary>
@@ -1426,34 +1903,1403 @@ namespace wa { namespace storage {
     };
 
     /// <summary>
-    /// Represents a set of timeout and retry policy options that may be specified for an operation request.
+    /// Represents a histogram of non-negative values, in buckets whose bounds are powers of two.
     /// </summary>
-    class request_options
+    class histogram
     {
     public:
 
         /// <summary>
-        /// Gets the retry policy for the request.
+        /// Initializes a new instance of the <see cref="histogram"/> class.
         /// </summary>
-        /// <returns>The retry policy for the request.</returns>
-        wa::storage::retry_policy retry_policy() const
+        histogram()
+            : m_buckets(protocol::histogram_bucket_count, 0), m_count(0), m_total(0)
         {
-            return m_retry_policy;
         }
 
         /// <summary>
-        /// Sets the retry policy for the request.
+        /// Adds a value to the histogram.
         /// </summary>
-        /// <param name="retry_policy">The retry policy for the request.</param>
-        void set_retry_policy(wa::storage::retry_policy retry_policy)
+        /// <param name="value">The value.</param>
+        void add(uint64_t value)
         {
-            m_retry_policy = retry_policy;
+            auto remaining = value;
+            size_t bucket = 0;
+            while (remaining != 0 && bucket + 1 < m_buckets.size())
+            {
+                remaining >>= 1;
+                ++bucket;
+            }
+
+            ++m_buckets[bucket];
+            ++m_count;
+            m_total += value;
         }
 
         /// <summary>
-        /// Gets the server timeout for the request. 
+        /// Adds all the values of another histogram to the histogram.
         /// </summary>
-        /// <returns>The server timeout for the request.</returns>
+        /// <param name="other">The other histogram.</param>
+        void merge(const histogram& other)
+        {
+            for (size_t bucket = 0; bucket < m_buckets.size(); ++bucket)
+            {
+                m_buckets[bucket] += other.m_buckets[bucket];
+            }
+
+            m_count += other.m_count;
+            m_total += other.m_total;
+        }
+
+        /// <summary>
+        /// Gets the number of values in the histogram.
+        /// </summary>
+        /// <returns>The number of values.</returns>
+        uint64_t count() const
+        {
+            return m_count;
+        }
+
+        /// <summary>
+        /// Gets the sum of the values in the histogram.
+        /// </summary>
+        /// <returns>The sum of the values.</returns>
+        uint64_t total() const
+        {
+            return m_total;
+        }
+
+        /// <summary>
+        /// Gets the number of values in each bucket.
+        /// </summary>
+        /// <returns>The buckets. Bucket 0 counts the value 0, and bucket i counts values of at least 2^(i-1) and less than 2^i.
+        /// The last bucket also counts all larger values.</returns>
+        const std::vector<uint64_t>& buckets() const
+        {
+            return m_buckets;
+        }
+
+        /// <summary>
+        /// Gets an upper bound of the specified percentile of the values.
+        /// </summary>
+        /// <param name="percentile">The percentile, between 0 and 1.</param>
+        /// <returns>The largest value of the bucket that the percentile falls into, or zero if the histogram is empty.</returns>
+        uint64_t percentile(double percentile) const
+        {
+            auto rank = static_cast<uint64_t>(std::ceil(percentile * static_cast<double>(m_count)));
+            uint64_t seen = 0;
+            for (size_t bucket = 0; bucket < m_buckets.size(); ++bucket)
+            {
+                seen += m_buckets[bucket];
+                if (m_count > 0 && seen >= std::max<uint64_t>(rank, 1))
+                {
+                    return bucket == 0 ? 0 : (static_cast<uint64_t>(1) << bucket) - 1;
+                }
+            }
+
+            return 0;
+        }
+
+    private:
+
+        std::vector<uint64_t> m_buckets;
+        uint64_t m_count;
+        uint64_t m_total;
+    };
+
+    /// <summary>
+    /// Represents a histogram of durations, in buckets whose bounds are powers of two microseconds.
+    /// </summary>
+    class latency_histogram
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="latency_histogram"/> class.
+        /// </summary>
+        latency_histogram()
+        {
+        }
+
+        /// <summary>
+        /// Adds a duration to the histogram.
+        /// </summary>
+        /// <param name="value">The duration.</param>
+        void add(std::chrono::microseconds value)
+        {
+            m_histogram.add(static_cast<uint64_t>(std::max(value.count(), static_cast<std::chrono::microseconds::rep>(0))));
+        }
+
+        /// <summary>
+        /// Adds all the durations of another histogram to the histogram.
+        /// </summary>
+        /// <param name="other">The other histogram.</param>
+        void merge(const latency_histogram& other)
+        {
+            m_histogram.merge(other.m_histogram);
+        }
+
+        /// <summary>
+        /// Gets the number of durations in the histogram.
+        /// </summary>
+        /// <returns>The number of durations.</returns>
+        uint64_t count() const
+        {
+            return m_histogram.count();
+        }
+
+        /// <summary>
+        /// Gets the sum of the durations in the histogram.
+        /// </summary>
+        /// <returns>The sum of the durations.</returns>
+        std::chrono::microseconds total() const
+        {
+            return std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(m_histogram.total()));
+        }
+
+        /// <summary>
+        /// Gets the number of durations in each bucket.
+        /// </summary>
+        /// <returns>The buckets. Bucket 0 counts durations shorter than 1 microsecond, and bucket i counts durations
+        /// of at least 2^(i-1) and less than 2^i microseconds. The last bucket also counts all longer durations.</returns>
+        const std::vector<uint64_t>& buckets() const
+        {
+            return m_histogram.buckets();
+        }
+
+        /// <summary>
+        /// Gets an upper bound of the specified percentile of the durations.
+        /// </summary>
+        /// <param name="percentile">The percentile, between 0 and 1.</param>
+        /// <returns>The upper bound of the bucket that the percentile falls into, or zero if the histogram is empty.</returns>
+        std::chrono::microseconds percentile(double percentile) const
+        {
+            return std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(m_histogram.percentile(percentile)));
+        }
+
+    private:
+
+        histogram m_histogram;
+    };
+
+    /// <summary>
+    /// Represents histograms of how long each phase of a kind of request took.
+    /// </summary>
+    class request_latency_histograms
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="request_latency_histograms"/> class.
+        /// </summary>
+        request_latency_histograms()
+        {
+        }
+
+        /// <summary>
+        /// Adds the phases of a request to the histograms.
+        /// </summary>
+        /// <param name="timings">A <see cref="request_timings" /> object.</param>
+        void add(const request_timings& timings)
+        {
+            m_build.add(timings.build_time());
+            m_sign.add(timings.sign_time());
+            m_connection_wait.add(timings.connection_wait_time());
+            m_time_to_first_byte.add(timings.time_to_first_byte());
+            m_body.add(timings.body_time());
+            m_postprocess.add(timings.postprocess_time());
+            m_total.add(timings.total_time());
+        }
+
+        /// <summary>
+        /// Adds all the phases of other histograms to the histograms.
+        /// </summary>
+        /// <param name="other">A <see cref="request_latency_histograms" /> object.</param>
+        void merge(const request_latency_histograms& other)
+        {
+            m_build.merge(other.m_build);
+            m_sign.merge(other.m_sign);
+            m_connection_wait.merge(other.m_connection_wait);
+            m_time_to_first_byte.merge(other.m_time_to_first_byte);
+            m_body.merge(other.m_body);
+            m_postprocess.merge(other.m_postprocess);
+            m_total.merge(other.m_total);
+        }
+
+        /// <summary>
+        /// Gets the histogram of the time it took to build the requests.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& build() const
+        {
+            return m_build;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the time it took to sign the requests.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& sign() const
+        {
+            return m_sign;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the time the requests waited for a connection.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& connection_wait() const
+        {
+            return m_connection_wait;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the time from sending the requests until their response headers arrived.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& time_to_first_byte() const
+        {
+            return m_time_to_first_byte;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the time it took to download the response bodies.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& body() const
+        {
+            return m_body;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the time it took to process the response bodies.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& postprocess() const
+        {
+            return m_postprocess;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the time the whole requests took.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& total() const
+        {
+            return m_total;
+        }
+
+    private:
+
+        latency_histogram m_build;
+        latency_histogram m_sign;
+        latency_histogram m_connection_wait;
+        latency_histogram m_time_to_first_byte;
+        latency_histogram m_body;
+        latency_histogram m_postprocess;
+        latency_histogram m_total;
+    };
+
+    /// <summary>
+    /// Represents what a metrics sink is told about a request made by a service client.
+    /// </summary>
+    class request_metrics
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="request_metrics"/> class.
+        /// </summary>
+        request_metrics()
+            : m_location(storage_location::unspecified), m_http_status_code(0), m_request_bytes(0), m_response_bytes(0), m_retry_count(0)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="request_metrics"/> class.
+        /// </summary>
+        /// <param name="service">The name of the service the request was sent to.</param>
+        /// <param name="operation">The kind of the request.</param>
+        /// <param name="location">The location the request was sent to.</param>
+        /// <param name="http_status_code">The HTTP status code of the response, or zero if no response was received.</param>
+        /// <param name="request_bytes">The length of the request body.</param>
+        /// <param name="response_bytes">The length of the response body.</param>
+        /// <param name="retry_count">The number of times the operation had been retried before the request.</param>
+        /// <param name="timings">How long each phase of the request took.</param>
+        request_metrics(utility::string_t service, utility::string_t operation, storage_location location, web::http::status_code http_status_code, utility::size64_t request_bytes, utility::size64_t response_bytes, int retry_count, const request_timings& timings)
+            : m_service(std::move(service)), m_operation(std::move(operation)), m_location(location), m_http_status_code(http_status_code),
+            m_request_bytes(request_bytes), m_response_bytes(response_bytes), m_retry_count(retry_count), m_timings(timings)
+        {
+        }
+
+        /// <summary>
+        /// Gets the name of the service the request was sent to.
+        /// </summary>
+        /// <returns>The name of the service, such as <c>blob</c>.</returns>
+        const utility::string_t& service() const
+        {
+            return m_service;
+        }
+
+        /// <summary>
+        /// Gets the kind of the request.
+        /// </summary>
+        /// <returns>The method of the request followed by the resource type and component it addresses, such as <c>PUT block</c>.</returns>
+        const utility::string_t& operation() const
+        {
+            return m_operation;
+        }
+
+        /// <summary>
+        /// Gets the location the request was sent to.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::storage_location" /> object.</returns>
+        storage_location location() const
+        {
+            return m_location;
+        }
+
+        /// <summary>
+        /// Gets the HTTP status code of the response.
+        /// </summary>
+        /// <returns>The HTTP status code, or zero if no response was received.</returns>
+        web::http::status_code http_status_code() const
+        {
+            return m_http_status_code;
+        }
+
+        /// <summary>
+        /// Gets the length of the request body.
+        /// </summary>
+        /// <returns>The length of the request body, in bytes.</returns>
+        utility::size64_t request_bytes() const
+        {
+            return m_request_bytes;
+        }
+
+        /// <summary>
+        /// Gets the length of the response body.
+        /// </summary>
+        /// <returns>The length of the response body, in bytes.</returns>
+        utility::size64_t response_bytes() const
+        {
+            return m_response_bytes;
+        }
+
+        /// <summary>
+        /// Gets the number of times the operation had been retried before the request.
+        /// </summary>
+        /// <returns>The number of retries.</returns>
+        int retry_count() const
+        {
+            return m_retry_count;
+        }
+
+        /// <summary>
+        /// Gets how long each phase of the request took.
+        /// </summary>
+        /// <returns>A <see cref="request_timings" /> object.</returns>
+        const request_timings& timings() const
+        {
+            return m_timings;
+        }
+
+    private:
+
+        utility::string_t m_service;
+        utility::string_t m_operation;
+        storage_location m_location;
+        web::http::status_code m_http_status_code;
+        utility::size64_t m_request_bytes;
+        utility::size64_t m_response_bytes;
+        int m_retry_count;
+        request_timings m_timings;
+    };
+
+    /// <summary>
+    /// Represents a destination that service clients report every request they make to.
+    /// </summary>
+    /// <remarks>A sink is called by many requests at once, from whichever thread completes them, so it has to be thread-safe
+    /// and should return quickly.</remarks>
+    class metrics_sink
+    {
+    public:
+
+        virtual ~metrics_sink()
+        {
+        }
+
+        /// <summary>
+        /// Records a request.
+        /// </summary>
+        /// <param name="metrics">A <see cref="request_metrics" /> object.</param>
+        virtual void record(const request_metrics& metrics) = 0;
+    };
+
+    /// <summary>
+    /// Specifies what a span of a trace covers.
+    /// </summary>
+    enum class trace_span_kind
+    {
+        /// <summary>
+        /// The span covers an operation, from its first request to the end of its last retry.
+        /// </summary>
+        operation,
+
+        /// <summary>
+        /// The span covers one attempt of an operation, which is a child of the operation span.
+        /// </summary>
+        attempt,
+
+        /// <summary>
+        /// The span covers a phase of an attempt, such as signing the request or receiving its body, which is a child of the attempt span.
+        /// </summary>
+        phase
+    };
+
+    /// <summary>
+    /// Represents a span of time that a request tracer is told about.
+    /// </summary>
+    class trace_span
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="trace_span"/> class.
+        /// </summary>
+        trace_span()
+            : m_kind(trace_span_kind::operation), m_span_id(0), m_parent_id(0), m_operation_id(0), m_duration(0), m_location(storage_location::unspecified), m_http_status_code(0)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="trace_span"/> class.
+        /// </summary>
+        /// <param name="kind">What the span covers.</param>
+        /// <param name="name">The name of the span.</param>
+        /// <param name="client_request_id">The client request ID of the operation the span belongs to.</param>
+        /// <param name="span_id">The ID of the span.</param>
+        /// <param name="parent_id">The ID of the parent span, or zero for an operation span.</param>
+        /// <param name="operation_id">The ID of the operation span the span belongs to.</param>
+        /// <param name="start_time">When the span started.</param>
+        /// <param name="duration">How long the span took.</param>
+        /// <param name="location">The location the request was sent to.</param>
+        /// <param name="http_status_code">The HTTP status code of the response, or zero if no response was received.</param>
+        trace_span(trace_span_kind kind, utility::string_t name, utility::string_t client_request_id, uint64_t span_id, uint64_t parent_id, uint64_t operation_id,
+            std::chrono::steady_clock::time_point start_time, std::chrono::microseconds duration, storage_location location, web::http::status_code http_status_code)
+            : m_kind(kind), m_name(std::move(name)), m_client_request_id(std::move(client_request_id)), m_span_id(span_id), m_parent_id(parent_id), m_operation_id(operation_id),
+            m_start_time(start_time), m_duration(duration), m_location(location), m_http_status_code(http_status_code)
+        {
+        }
+
+        /// <summary>
+        /// Gets what the span covers.
+        /// </summary>
+        /// <returns>A <see cref="trace_span_kind" /> value.</returns>
+        trace_span_kind kind() const
+        {
+            return m_kind;
+        }
+
+        /// <summary>
+        /// Gets the name of the span.
+        /// </summary>
+        /// <returns>The kind of the request for operation and attempt spans, such as <c>PUT block</c>, or the name of the phase, such as <c>sign</c>.</returns>
+        const utility::string_t& name() const
+        {
+            return m_name;
+        }
+
+        /// <summary>
+        /// Gets the client request ID of the operation the span belongs to.
+        /// </summary>
+        /// <returns>The client request ID, which the operations that share an <see cref="operation_context" /> have in common.</returns>
+        const utility::string_t& client_request_id() const
+        {
+            return m_client_request_id;
+        }
+
+        /// <summary>
+        /// Gets the ID of the span, which is unique within the process.
+        /// </summary>
+        /// <returns>The ID of the span.</returns>
+        uint64_t span_id() const
+        {
+            return m_span_id;
+        }
+
+        /// <summary>
+        /// Gets the ID of the parent span.
+        /// </summary>
+        /// <returns>The ID of the parent span, or zero for an operation span.</returns>
+        uint64_t parent_id() const
+        {
+            return m_parent_id;
+        }
+
+        /// <summary>
+        /// Gets the ID of the operation span the span belongs to.
+        /// </summary>
+        /// <returns>The ID of the operation span, which is the ID of the span itself for an operation span.</returns>
+        uint64_t operation_id() const
+        {
+            return m_operation_id;
+        }
+
+        /// <summary>
+        /// Gets when the span started.
+        /// </summary>
+        /// <returns>The start time of the span.</returns>
+        std::chrono::steady_clock::time_point start_time() const
+        {
+            return m_start_time;
+        }
+
+        /// <summary>
+        /// Gets how long the span took.
+        /// </summary>
+        /// <returns>The duration of the span.</returns>
+        std::chrono::microseconds duration() const
+        {
+            return m_duration;
+        }
+
+        /// <summary>
+        /// Gets the location the request was sent to.
+        /// </summary>
+        /// <returns>The location of the last attempt for an operation span.</returns>
+        storage_location location() const
+        {
+            return m_location;
+        }
+
+        /// <summary>
+        /// Gets the HTTP status code of the response.
+        /// </summary>
+        /// <returns>The HTTP status code, or zero if no response was received.</returns>
+        web::http::status_code http_status_code() const
+        {
+            return m_http_status_code;
+        }
+
+    private:
+
+        trace_span_kind m_kind;
+        utility::string_t m_name;
+        utility::string_t m_client_request_id;
+        uint64_t m_span_id;
+        uint64_t m_parent_id;
+        uint64_t m_operation_id;
+        std::chrono::steady_clock::time_point m_start_time;
+        std::chrono::microseconds m_duration;
+        storage_location m_location;
+        web::http::status_code m_http_status_code;
+    };
+
+    /// <summary>
+    /// Represents a destination that the spans of every operation and request attempt are reported to, such as an
+    /// adapter to OpenTelemetry.
+    /// </summary>
+    /// <remarks>The spans of an attempt are reported when it ends, before the span of its operation. A tracer is called by
+    /// many requests at once, from whichever thread completes them, so it has to be thread-safe and should return quickly.</remarks>
+    class request_tracer
+    {
+    public:
+
+        virtual ~request_tracer()
+        {
+        }
+
+        /// <summary>
+        /// Records a span.
+        /// </summary>
+        /// <param name="span">A <see cref="trace_span" /> object.</param>
+        virtual void record(const trace_span& span) = 0;
+
+        /// <summary>
+        /// Returns a new span ID.
+        /// </summary>
+        /// <returns>An ID that is unique within the process.</returns>
+        /// <remarks>This is used internally by the executor of the requests.</remarks>
+        WASTORAGE_API static uint64_t _next_span_id();
+    };
+
+    /// <summary>
+    /// Represents a request tracer that keeps the spans it is told about, and writes them out in the Chrome trace event
+    /// format that chrome://tracing and Perfetto load.
+    /// </summary>
+    /// <remarks>The operations of one <see cref="operation_context" /> are shown as one process named by their client
+    /// request ID, in which operations that ran at the same time, such as the blocks of a parallel upload, are placed on
+    /// sibling threads.</remarks>
+    class chrome_trace_writer : public request_tracer
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="chrome_trace_writer"/> class.
+        /// </summary>
+        chrome_trace_writer()
+        {
+        }
+
+        /// <summary>
+        /// Records a span.
+        /// </summary>
+        /// <param name="span">A <see cref="trace_span" /> object.</param>
+        WASTORAGE_API void record(const trace_span& span) override;
+
+        /// <summary>
+        /// Gets the spans recorded so far.
+        /// </summary>
+        /// <returns>The spans, in the order they were recorded.</returns>
+        WASTORAGE_API std::vector<trace_span> spans() const;
+
+        /// <summary>
+        /// Writes the spans of the operations that have completed as a Chrome trace.
+        /// </summary>
+        /// <returns>A JSON object holding a <c>traceEvents</c> array.</returns>
+        WASTORAGE_API web::json::value to_json() const;
+
+        /// <summary>
+        /// Discards the spans recorded so far.
+        /// </summary>
+        WASTORAGE_API void clear();
+
+    private:
+
+        chrome_trace_writer(const chrome_trace_writer&);
+        chrome_trace_writer& operator=(const chrome_trace_writer&);
+
+        std::vector<trace_span> m_spans;
+        mutable pplx::extensibility::critical_section_t m_lock;
+    };
+
+    /// <summary>
+    /// Represents the aggregated metrics of the requests of one kind sent to one location of a service.
+    /// </summary>
+    class metrics_series
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="metrics_series"/> class.
+        /// </summary>
+        metrics_series()
+            : m_location(storage_location::unspecified)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="metrics_series"/> class.
+        /// </summary>
+        /// <param name="service">The name of the service the requests were sent to.</param>
+        /// <param name="operation">The kind of the requests.</param>
+        /// <param name="location">The location the requests were sent to.</param>
+        metrics_series(utility::string_t service, utility::string_t operation, storage_location location)
+            : m_service(std::move(service)), m_operation(std::move(operation)), m_location(location)
+        {
+        }
+
+        /// <summary>
+        /// Adds a request to the series.
+        /// </summary>
+        /// <param name="metrics">A <see cref="request_metrics" /> object.</param>
+        void add(const request_metrics& metrics)
+        {
+            m_latency.add(metrics.timings());
+            m_request_bytes.add(metrics.request_bytes());
+            m_response_bytes.add(metrics.response_bytes());
+            m_retries.add(static_cast<uint64_t>(std::max(metrics.retry_count(), 0)));
+            ++m_status_codes[metrics.http_status_code()];
+        }
+
+        /// <summary>
+        /// Adds all the requests of another series to the series.
+        /// </summary>
+        /// <param name="other">A <see cref="metrics_series" /> object.</param>
+        void merge(const metrics_series& other)
+        {
+            m_latency.merge(other.m_latency);
+            m_request_bytes.merge(other.m_request_bytes);
+            m_response_bytes.merge(other.m_response_bytes);
+            m_retries.merge(other.m_retries);
+            for (auto iter = other.m_status_codes.cbegin(); iter != other.m_status_codes.cend(); ++iter)
+            {
+                m_status_codes[iter->first] += iter->second;
+            }
+        }
+
+        /// <summary>
+        /// Gets the name of the service the requests were sent to.
+        /// </summary>
+        /// <returns>The name of the service, such as <c>blob</c>.</returns>
+        const utility::string_t& service() const
+        {
+            return m_service;
+        }
+
+        /// <summary>
+        /// Gets the kind of the requests.
+        /// </summary>
+        /// <returns>The method of the requests followed by the resource type and component they address, such as <c>PUT block</c>.</returns>
+        const utility::string_t& operation() const
+        {
+            return m_operation;
+        }
+
+        /// <summary>
+        /// Gets the location the requests were sent to.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::storage_location" /> object.</returns>
+        storage_location location() const
+        {
+            return m_location;
+        }
+
+        /// <summary>
+        /// Gets the histograms of how long each phase of the requests took.
+        /// </summary>
+        /// <returns>A <see cref="request_latency_histograms" /> object.</returns>
+        const request_latency_histograms& latency() const
+        {
+            return m_latency;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the lengths of the request bodies, in bytes.
+        /// </summary>
+        /// <returns>A <see cref="histogram" /> object.</returns>
+        const histogram& request_bytes() const
+        {
+            return m_request_bytes;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the lengths of the response bodies, in bytes.
+        /// </summary>
+        /// <returns>A <see cref="histogram" /> object.</returns>
+        const histogram& response_bytes() const
+        {
+            return m_response_bytes;
+        }
+
+        /// <summary>
+        /// Gets the histogram of the number of times the operations had been retried before the requests.
+        /// </summary>
+        /// <returns>A <see cref="histogram" /> object.</returns>
+        const histogram& retries() const
+        {
+            return m_retries;
+        }
+
+        /// <summary>
+        /// Gets the number of responses with each HTTP status code.
+        /// </summary>
+        /// <returns>The number of responses, by status code. Requests that received no response are counted under zero.</returns>
+        const std::map<web::http::status_code, uint64_t>& status_codes() const
+        {
+            return m_status_codes;
+        }
+
+    private:
+
+        utility::string_t m_service;
+        utility::string_t m_operation;
+        storage_location m_location;
+        request_latency_histograms m_latency;
+        histogram m_request_bytes;
+        histogram m_response_bytes;
+        histogram m_retries;
+        std::map<web::http::status_code, uint64_t> m_status_codes;
+    };
+
+    /// <summary>
+    /// Represents a metrics sink that aggregates the requests it is told about into histograms and counters,
+    /// by service, kind of request and location.
+    /// </summary>
+    /// <remarks>The requests are spread over a fixed number of independently locked shards by the thread that records them,
+    /// so that requests completing on different threads rarely wait for each other. The shards are only merged when the
+    /// series are read.</remarks>
+    class histogram_metrics_sink : public metrics_sink
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="histogram_metrics_sink"/> class.
+        /// </summary>
+        histogram_metrics_sink()
+        {
+        }
+
+        /// <summary>
+        /// Records a request.
+        /// </summary>
+        /// <param name="metrics">A <see cref="request_metrics" /> object.</param>
+        WASTORAGE_API void record(const request_metrics& metrics) override;
+
+        /// <summary>
+        /// Gets a copy of the aggregated metrics of every series a request has been recorded in.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="metrics_series" /> objects, ordered by service, kind of request and location.</returns>
+        WASTORAGE_API std::vector<metrics_series> series() const;
+
+        /// <summary>
+        /// Discards all the recorded requests.
+        /// </summary>
+        WASTORAGE_API void reset();
+
+    private:
+
+        typedef std::tuple<utility::string_t, utility::string_t, storage_location> series_key;
+
+        struct shard
+        {
+            std::map<series_key, metrics_series> series;
+            pplx::extensibility::critical_section_t lock;
+        };
+
+        histogram_metrics_sink(const histogram_metrics_sink&);
+        histogram_metrics_sink& operator=(const histogram_metrics_sink&);
+
+        mutable shard m_shards[protocol::metrics_sink_shard_count];
+    };
+
+    /// <summary>
+    /// Represents the settings used to pool and reuse HTTP connections for the requests made by a service client.
+    /// </summary>
+    class connection_pool_settings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::connection_pool_settings" /> class.
+        /// </summary>
+        connection_pool_settings()
+            : m_max_idle_connections_per_host(protocol::default_max_idle_connections_per_host),
+            m_idle_timeout(protocol::default_connection_idle_timeout),
+            m_max_connections_per_host(0),
+            m_adaptive_concurrency(false)
+        {
+        }
+
+        /// <summary>
+        /// Gets the maximum number of idle connections that are kept open for each host.
+        /// </summary>
+        /// <returns>The maximum number of idle connections per host.</returns>
+        size_t max_idle_connections_per_host() const
+        {
+            return m_max_idle_connections_per_host;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of idle connections that are kept open for each host.
+        /// </summary>
+        /// <param name="value">The maximum number of idle connections per host. A value of 0 disables connection reuse.</param>
+        void set_max_idle_connections_per_host(size_t value)
+        {
+            m_max_idle_connections_per_host = value;
+        }
+
+        /// <summary>
+        /// Gets the amount of time after which an idle connection is closed.
+        /// </summary>
+        /// <returns>The idle timeout.</returns>
+        const std::chrono::seconds& idle_timeout() const
+        {
+            return m_idle_timeout;
+        }
+
+        /// <summary>
+        /// Sets the amount of time after which an idle connection is closed.
+        /// </summary>
+        /// <param name="value">The idle timeout.</param>
+        void set_idle_timeout(const std::chrono::seconds& value)
+        {
+            m_idle_timeout = value;
+        }
+
+        /// <summary>
+        /// Gets the maximum number of connections that may be in use at the same time for each host.
+        /// </summary>
+        /// <returns>The maximum number of connections per host, or 0 if the number of connections is not limited.</returns>
+        int max_connections_per_host() const
+        {
+            return m_max_connections_per_host;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of connections that may be in use at the same time for each host.
+        /// </summary>
+        /// <param name="value">The maximum number of connections per host, or 0 to not limit the number of connections.</param>
+        /// <remarks>Requests that exceed this limit wait until a connection to the same host becomes available.</remarks>
+        void set_max_connections_per_host(int value)
+        {
+            if (value < 0)
+            {
+                throw std::invalid_argument("value");
+            }
+
+            m_max_connections_per_host = value;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether the number of requests in flight to each host is adapted to how busy the host is.
+        /// </summary>
+        /// <returns><c>true</c> if the number of requests in flight adapts to the host; otherwise, <c>false</c>.</returns>
+        bool adaptive_concurrency() const
+        {
+            return m_adaptive_concurrency;
+        }
+
+        /// <summary>
+        /// Indicates whether to adapt the number of requests in flight to each host to how busy the host is.
+        /// </summary>
+        /// <param name="value"><c>true</c> to adapt the number of requests in flight to the host; otherwise, <c>false</c>.</param>
+        /// <remarks>The number of requests that may be in flight starts at <see cref="max_connections_per_host" />, or at 256 if that is not limited.
+        /// It is halved when the host answers that it is busy or timed out (503 Server Busy or 500 Operation Timed Out), and grows by one
+        /// again for every such number of requests that succeed, so that the requests to a throttled account wait in the client
+        /// instead of failing and being retried by each request on its own.</remarks>
+        void set_adaptive_concurrency(bool value)
+        {
+            m_adaptive_concurrency = value;
+        }
+
+    private:
+
+        size_t m_max_idle_connections_per_host;
+        std::chrono::seconds m_idle_timeout;
+        int m_max_connections_per_host;
+        bool m_adaptive_concurrency;
+    };
+
+    /// <summary>
+    /// Represents when a service client stops sending requests to a storage location that keeps failing.
+    /// </summary>
+    class circuit_breaker_settings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::circuit_breaker_settings" /> class.
+        /// </summary>
+        circuit_breaker_settings()
+            : m_failure_threshold(0),
+            m_open_duration(protocol::default_circuit_open_duration)
+        {
+        }
+
+        /// <summary>
+        /// Gets the number of requests to a location that must fail in a row for the circuit of the location to open.
+        /// </summary>
+        /// <returns>The number of failures in a row, or 0 if circuits never open.</returns>
+        int failure_threshold() const
+        {
+            return m_failure_threshold;
+        }
+
+        /// <summary>
+        /// Sets the number of requests to a location that must fail in a row for the circuit of the location to open.
+        /// </summary>
+        /// <param name="value">The number of failures in a row, or 0 to never open circuits.</param>
+        /// <remarks>A request fails if no response is received or the response is a server error. While the circuit is open,
+        /// operations fail right away, or are sent to the other location if their location mode allows it.</remarks>
+        void set_failure_threshold(int value)
+        {
+            if (value < 0)
+            {
+                throw std::invalid_argument("value");
+            }
+
+            m_failure_threshold = value;
+        }
+
+        /// <summary>
+        /// Gets the amount of time that a circuit stays open before a request is let through to probe the location.
+        /// </summary>
+        /// <returns>The open duration.</returns>
+        const std::chrono::seconds& open_duration() const
+        {
+            return m_open_duration;
+        }
+
+        /// <summary>
+        /// Sets the amount of time that a circuit stays open before a request is let through to probe the location.
+        /// </summary>
+        /// <param name="value">The open duration.</param>
+        /// <remarks>Only one request at a time is let through while the circuit is half-open. If it succeeds, the circuit closes,
+        /// and if it fails, the circuit stays open for this long again.</remarks>
+        void set_open_duration(const std::chrono::seconds& value)
+        {
+            if (value.count() < 0)
+            {
+                throw std::invalid_argument("value");
+            }
+
+            m_open_duration = value;
+        }
+
+    private:
+
+        int m_failure_threshold;
+        std::chrono::seconds m_open_duration;
+    };
+
+    /// <summary>
+    /// Represents the share of the operations in flight of a service client that the operations with a dispatch tag get.
+    /// </summary>
+    class dispatch_tag_settings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::dispatch_tag_settings" /> class, with a weight of 1 and no quota.
+        /// </summary>
+        dispatch_tag_settings()
+            : m_max_concurrent_operations(0), m_weight(1)
+        {
+        }
+
+        /// <summary>
+        /// Gets the maximum number of operations with the tag that may be in flight at the same time.
+        /// </summary>
+        /// <returns>The quota of the tag, or 0 if the tag is only limited by the service client.</returns>
+        int max_concurrent_operations() const
+        {
+            return m_max_concurrent_operations;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of operations with the tag that may be in flight at the same time.
+        /// </summary>
+        /// <param name="value">The quota of the tag, or 0 to only limit the tag by the service client.</param>
+        void set_max_concurrent_operations(int value)
+        {
+            if (value < 0)
+            {
+                throw std::invalid_argument("value");
+            }
+
+            m_max_concurrent_operations = value;
+        }
+
+        /// <summary>
+        /// Gets the weight of the tag.
+        /// </summary>
+        /// <returns>The weight of the tag.</returns>
+        int weight() const
+        {
+            return m_weight;
+        }
+
+        /// <summary>
+        /// Sets the weight of the tag.
+        /// </summary>
+        /// <param name="value">The weight of the tag, which must be at least 1.</param>
+        /// <remarks>While operations with several tags are waiting, each tag is dispatched operations in proportion to its weight.</remarks>
+        void set_weight(int value)
+        {
+            if (value < 1)
+            {
+                throw std::invalid_argument("value");
+            }
+
+            m_weight = value;
+        }
+
+    private:
+
+        int m_max_concurrent_operations;
+        int m_weight;
+    };
+
+    /// <summary>
+    /// Represents how the operations with a dispatch tag have waited until they were dispatched.
+    /// </summary>
+    class dispatch_tag_statistics
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::dispatch_tag_statistics" /> class.
+        /// </summary>
+        dispatch_tag_statistics()
+            : m_queued_operations(0), m_running_operations(0)
+        {
+        }
+
+        /// <summary>
+        /// Gets the number of operations with the tag that are waiting to be dispatched.
+        /// </summary>
+        /// <returns>The number of queued operations.</returns>
+        size_t queued_operations() const
+        {
+            return m_queued_operations;
+        }
+
+        /// <summary>
+        /// Gets the number of operations with the tag that are in flight.
+        /// </summary>
+        /// <returns>The number of running operations.</returns>
+        size_t running_operations() const
+        {
+            return m_running_operations;
+        }
+
+        /// <summary>
+        /// Gets a histogram of how long the operations with the tag waited until they were dispatched.
+        /// </summary>
+        /// <returns>A <see cref="latency_histogram" /> object.</returns>
+        const latency_histogram& queueing_delay() const
+        {
+            return m_queueing_delay;
+        }
+
+    private:
+
+        size_t m_queued_operations;
+        size_t m_running_operations;
+        latency_histogram m_queueing_delay;
+
+        friend class core::operation_dispatcher;
+    };
+
+    /// <summary>
+    /// Refers to a piece of memory owned by the caller, one of a list of buffers that are read one after the other.
+    /// </summary>
+    class const_buffer
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::const_buffer" /> class that refers to no memory.
+        /// </summary>
+        const_buffer()
+            : m_data(nullptr), m_size(0)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::const_buffer" /> class.
+        /// </summary>
+        /// <param name="data">A pointer to the memory, which must stay valid and unchanged while it is in use.</param>
+        /// <param name="size">The number of bytes in the buffer.</param>
+        const_buffer(const uint8_t* data, size_t size)
+            : m_data(data), m_size(size)
+        {
+        }
+
+        /// <summary>
+        /// Gets a pointer to the memory of the buffer.
+        /// </summary>
+        /// <returns>A pointer to the first byte of the buffer.</returns>
+        const uint8_t* data() const
+        {
+            return m_data;
+        }
+
+        /// <summary>
+        /// Gets the size of the buffer.
+        /// </summary>
+        /// <returns>The number of bytes in the buffer.</returns>
+        size_t size() const
+        {
+            return m_size;
+        }
+
+    private:
+
+        const uint8_t* m_data;
+        size_t m_size;
+    };
+
+    /// <summary>
+    /// Sends the requests of operations in place of the HTTP client, such as to serve them from memory in tests.
+    /// </summary>
+    /// <remarks>A transport can also carry requests over a protocol the HTTP client does not speak, such as one that multiplexes
+    /// the requests to an endpoint over a few HTTP/2 connections. The requests to an endpoint that the transport cannot serve
+    /// go through the HTTP client and its connection pool instead.</remarks>
+    class http_transport
+    {
+    public:
+
+        virtual ~http_transport()
+        {
+        }
+
+        /// <summary>
+        /// Sends a request and returns its response.
+        /// </summary>
+        /// <param name="request">The request, whose body stream is read to the end. If it has a response stream, the body of the
+        /// response is written there instead of to the response.</param>
+        /// <param name="token">A token that is canceled if the response is no longer needed.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes with the response, once its body is complete.</returns>
+        virtual pplx::task<web::http::http_response> send(web::http::http_request request, const pplx::cancellation_token& token) = 0;
+
+        /// <summary>
+        /// Gets a value indicating whether requests to the given endpoint are sent through the transport.
+        /// </summary>
+        /// <param name="authority">The scheme, host and port of the endpoint.</param>
+        /// <returns><c>true</c> if the transport sends the requests; <c>false</c> if they go through the HTTP client, such as
+        /// once a multiplexing transport has found that the endpoint does not negotiate its protocol.</returns>
+        /// <remarks>This is called for every request, before it is sent.</remarks>
+        virtual bool can_send(const web::http::uri& /* authority */)
+        {
+            return true;
+        }
+    };
+
+    /// <summary>
+    /// Allocates the memory of the buffers that the bodies of requests and responses are staged in, such as the blocks a blob
+    /// stream uploads and the ranges it reads ahead.
+    /// </summary>
+    /// <remarks>An allocator can keep these large, long-lived buffers out of the general heap, such as by taking them from an
+    /// arena, from huge pages, from the memory of a NUMA node or from memory that is pinned for the network adapter. It is called
+    /// from any thread, and a buffer may be freed on a different thread from the one that allocated it.</remarks>
+    class buffer_allocator
+    {
+    public:
+
+        virtual ~buffer_allocator()
+        {
+        }
+
+        /// <summary>
+        /// Allocates a buffer.
+        /// </summary>
+        /// <param name="size">The size of the buffer, in bytes, which is never zero.</param>
+        /// <returns>The buffer, aligned as the allocator sees fit and at least as <c>::operator new</c> aligns it, or <c>nullptr</c>
+        /// if the memory cannot be allocated, in which case the operation fails with <c>std::bad_alloc</c>.</returns>
+        virtual void* allocate(size_t size) = 0;
+
+        /// <summary>
+        /// Frees a buffer that was allocated by this allocator.
+        /// </summary>
+        /// <param name="pointer">The buffer.</param>
+        /// <param name="size">The size the buffer was allocated with, in bytes.</param>
+        virtual void deallocate(void* pointer, size_t size) = 0;
+    };
+
+    /// <summary>
+    /// Specifies how urgently the bytes of an operation are sent and received when a <see cref="bandwidth_limiter" /> is shared with other operations.
+    /// </summary>
+    enum class transfer_priority
+    {
+        /// <summary>
+        /// The operation is latency-sensitive, and its bytes go ahead of those of every other operation.
+        /// </summary>
+        interactive,
+
+        /// <summary>
+        /// The operation's bytes go ahead of those of bulk transfers.
+        /// </summary>
+        normal,
+
+        /// <summary>
+        /// The operation is a bulk transfer, which only uses the bandwidth that no other operation is waiting for.
+        /// </summary>
+        bulk
+    };
+
+    /// <summary>
+    /// Limits the rate at which the request and response bodies of the operations that share it are transferred.
+    /// </summary>
+    /// <remarks>The limiter is a token bucket that fills at the given rate up to the burst size. Bytes are only transferred once
+    /// enough tokens are available and no operation of the same or a higher priority is waiting, so operations of a higher priority
+    /// take the bandwidth ahead of those of a lower priority which are already waiting.</remarks>
+    class bandwidth_limiter : public std::enable_shared_from_this<bandwidth_limiter>
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::bandwidth_limiter" /> class, whose burst size is a tenth of a second at the given rate.
+        /// </summary>
+        /// <param name="bytes_per_second">The number of bytes that can be transferred per second.</param>
+        WASTORAGE_API explicit bandwidth_limiter(utility::size64_t bytes_per_second);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::bandwidth_limiter" /> class.
+        /// </summary>
+        /// <param name="bytes_per_second">The number of bytes that can be transferred per second.</param>
+        /// <param name="burst_bytes">The largest number of bytes that can be transferred at once after the limiter has been idle.</param>
+        WASTORAGE_API bandwidth_limiter(utility::size64_t bytes_per_second, size_t burst_bytes);
+
+        /// <summary>
+        /// Waits until the given number of bytes can be transferred.
+        /// </summary>
+        /// <param name="count">The number of bytes, which is reduced to the burst size if it is larger.</param>
+        /// <param name="priority">The priority of the transfer.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once the bytes can be transferred.</returns>
+        WASTORAGE_API pplx::task<void> acquire_async(size_t count, transfer_priority priority);
+
+        /// <summary>
+        /// Gets the rate of the limiter.
+        /// </summary>
+        /// <returns>The number of bytes that can be transferred per second.</returns>
+        utility::size64_t bytes_per_second() const
+        {
+            return m_bytes_per_second;
+        }
+
+        /// <summary>
+        /// Gets the burst size of the limiter.
+        /// </summary>
+        /// <returns>The largest number of bytes that can be transferred at once.</returns>
+        size_t burst_bytes() const
+        {
+            return m_burst_bytes;
+        }
+
+    private:
+
+        struct waiter
+        {
+            size_t count;
+            pplx::task_completion_event<void> ready;
+        };
+
+        void refill(std::chrono::steady_clock::time_point now);
+        void grant_waiters(std::vector<pplx::task_completion_event<void>>& ready);
+        void schedule_timer();
+        void on_timer();
+
+        utility::size64_t m_bytes_per_second;
+        size_t m_burst_bytes;
+        double m_tokens;
+        std::chrono::steady_clock::time_point m_last_refill;
+        std::deque<waiter> m_waiters[3];
+        bool m_timer_scheduled;
+        std::mutex m_mutex;
+    };
+
+    /// <summary>
+    /// Represents a set of timeout and retry policy options that may be specified for an operation request.
+    /// </summary>
+    class request_options
+    {
+    public:
+
+        /// <summary>
+        /// Gets the retry policy for the request.
+        /// </summary>
+        /// <returns>The retry policy for the request.</returns>
+        wa::storage::retry_policy retry_policy() const
+        {
+            return m_retry_policy;
+        }
+
+        /// <summary>
+        /// Sets the retry policy for the request.
+        /// </summary>
+        /// <param name="retry_policy">The retry policy for the request.</param>
+        void set_retry_policy(wa::storage::retry_policy retry_policy)
+        {
+            m_retry_policy = retry_policy;
+        }
+
+        /// <summary>
+        /// Gets the server timeout for the request. 
+        /// </summary>
+        /// <returns>The server timeout for the request.</returns>
         const std::chrono::seconds& server_timeout() const
         {
             return m_server_timeout;
@@ -1504,6 +3350,231 @@ namespace wa { namespace storage {
             m_location_mode = location_mode;
         }
 
+        /// <summary>
+        /// Gets a value indicating whether reads that may be served by either location are also sent to the secondary location
+        /// when the primary location is slow to respond.
+        /// </summary>
+        /// <returns><c>true</c> if slow reads are hedged with a request to the secondary location; otherwise, <c>false</c>.</returns>
+        bool hedged_reads() const
+        {
+            return m_hedged_reads;
+        }
+
+        /// <summary>
+        /// Indicates whether reads that may be served by either location are also sent to the secondary location
+        /// when the primary location is slow to respond.
+        /// </summary>
+        /// <param name="value"><c>true</c> to hedge slow reads with a request to the secondary location; otherwise, <c>false</c>.</param>
+        /// <remarks>This only applies when the <see cref="location_mode" /> allows the secondary location to be read, and the account has one.
+        /// If the primary location has not sent the response headers within the 95th percentile of its recent response times,
+        /// the same request is sent to the secondary location. The response that arrives first is used and the other request is canceled.
+        /// As with any read from the secondary location, the data may not include the latest writes to the primary location.</remarks>
+        void set_hedged_reads(bool value)
+        {
+            m_hedged_reads = value;
+        }
+
+        /// <summary>
+        /// Gets the size from which a request body is only sent once the service has accepted the request headers.
+        /// </summary>
+        /// <returns>The size in bytes, or 0 if request bodies are always sent right away.</returns>
+        utility::size64_t expect_continue_threshold() const
+        {
+            return m_expect_continue_threshold;
+        }
+
+        /// <summary>
+        /// Sets the size from which a request body is only sent once the service has accepted the request headers.
+        /// </summary>
+        /// <param name="value">The size in bytes, or 0 to always send request bodies right away.</param>
+        /// <remarks>A request with a body of at least this size is sent with an <c>Expect: 100-continue</c> header, so a request that
+        /// the service rejects for its lease, conditions or authorization, such as with 409 Conflict, 412 Precondition Failed or
+        /// 403 Forbidden, fails without its body being sent, and so does each of its retries. A body that is accepted waits one round trip.</remarks>
+        void set_expect_continue_threshold(utility::size64_t value)
+        {
+            m_expect_continue_threshold = value;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether listings and table queries ask for their responses to be compressed.
+        /// </summary>
+        /// <returns><c>true</c> if the responses may be gzip encoded; otherwise, <c>false</c>.</returns>
+        bool accept_compressed_responses() const
+        {
+            return m_accept_compressed_responses;
+        }
+
+        /// <summary>
+        /// Sets a value indicating whether listings and table queries ask for their responses to be compressed.
+        /// </summary>
+        /// <param name="value"><c>true</c> to let the responses be gzip encoded; otherwise, <c>false</c>.</param>
+        /// <remarks>The requests that list containers, blobs and queues, and those that query tables, are sent with an
+        /// <c>Accept-Encoding: gzip</c> header. A response that the service or a proxy in between compresses is decoded while it is parsed,
+        /// and a response that is not compressed is parsed as before.</remarks>
+        void set_accept_compressed_responses(bool value)
+        {
+            m_accept_compressed_responses = value;
+        }
+
+        /// <summary>
+        /// Gets the token that cancels the operation.
+        /// </summary>
+        /// <returns>A <see cref="pplx::cancellation_token" /> object.</returns>
+        const pplx::cancellation_token& cancellation_token() const
+        {
+            return m_cancellation_token;
+        }
+
+        /// <summary>
+        /// Sets the token that cancels the operation.
+        /// </summary>
+        /// <param name="value">A <see cref="pplx::cancellation_token" /> object.</param>
+        /// <remarks>Once the token is canceled, requests in flight are abandoned, no more requests or retries are sent, and the
+        /// operation fails with a <see cref="storage_exception" /> that cannot be retried. This applies to every request
+        /// the operation makes, such as the block uploads of a large blob or the ranges a blob stream reads ahead. The HTTP client
+        /// cannot abort a request, so an abandoned request still completes in the background and its connection is not reused.</remarks>
+        void set_cancellation_token(const pplx::cancellation_token& value)
+        {
+            m_cancellation_token = value;
+        }
+
+        /// <summary>
+        /// Gets the transport that requests are sent through.
+        /// </summary>
+        /// <returns>The transport, or <c>nullptr</c> if requests are sent over the network.</returns>
+        const std::shared_ptr<http_transport>& transport() const
+        {
+            return m_transport;
+        }
+
+        /// <summary>
+        /// Sets the transport that requests are sent through.
+        /// </summary>
+        /// <param name="value">The transport, or <c>nullptr</c> to send requests over the network.</param>
+        /// <remarks>A transport replaces the HTTP client and its connection pool. Everything else about the operation,
+        /// such as retries, timeouts and the parsing of the responses, is the same.</remarks>
+        void set_transport(std::shared_ptr<http_transport> value)
+        {
+            m_transport = value;
+        }
+
+        /// <summary>
+        /// Gets the tracer that the spans of the operation and its requests are reported to.
+        /// </summary>
+        /// <returns>The tracer, or <c>nullptr</c> if no spans are reported.</returns>
+        const std::shared_ptr<request_tracer>& tracer() const
+        {
+            return m_tracer;
+        }
+
+        /// <summary>
+        /// Sets the tracer that the spans of the operation and its requests are reported to.
+        /// </summary>
+        /// <param name="value">The tracer, such as a <see cref="chrome_trace_writer" />, or <c>nullptr</c> to report no spans.</param>
+        void set_tracer(std::shared_ptr<request_tracer> value)
+        {
+            m_tracer = value;
+        }
+
+        /// <summary>
+        /// Gets the limiter that the request and response bodies are transferred through.
+        /// </summary>
+        /// <returns>The limiter, or <c>nullptr</c> if the bodies are transferred as fast as the network allows.</returns>
+        const std::shared_ptr<wa::storage::bandwidth_limiter>& bandwidth_limiter() const
+        {
+            return m_bandwidth_limiter;
+        }
+
+        /// <summary>
+        /// Sets the limiter that the request and response bodies are transferred through.
+        /// </summary>
+        /// <param name="value">The limiter, or <c>nullptr</c> to transfer the bodies as fast as the network allows.</param>
+        /// <remarks>Operations that share a limiter share its bandwidth, in the order of their <see cref="transfer_priority" />.
+        /// This applies to every request the operation makes, such as the blocks a blob stream uploads or the ranges it reads ahead.</remarks>
+        void set_bandwidth_limiter(std::shared_ptr<wa::storage::bandwidth_limiter> value)
+        {
+            m_bandwidth_limiter = value;
+        }
+
+        /// <summary>
+        /// Gets the priority of the operation's transfers.
+        /// </summary>
+        /// <returns>The priority of the transfers.</returns>
+        wa::storage::transfer_priority transfer_priority() const
+        {
+            return m_transfer_priority;
+        }
+
+        /// <summary>
+        /// Sets the priority of the operation's transfers.
+        /// </summary>
+        /// <param name="value">The priority of the transfers.</param>
+        /// <remarks>The priority only has an effect if a <see cref="wa::storage::bandwidth_limiter" /> is set.</remarks>
+        void set_transfer_priority(wa::storage::transfer_priority value)
+        {
+            m_transfer_priority = value;
+        }
+
+        /// <summary>
+        /// Gets the scheduler that the response of each request is handled on.
+        /// </summary>
+        /// <returns>The scheduler, or <c>nullptr</c> if the response is handled on the default scheduler.</returns>
+        const std::shared_ptr<pplx::scheduler_interface>& io_scheduler() const
+        {
+            return m_io_scheduler;
+        }
+
+        /// <summary>
+        /// Sets the scheduler that the response of each request is handled on.
+        /// </summary>
+        /// <param name="value">The scheduler, or <c>nullptr</c> to use the default scheduler.</param>
+        /// <remarks>This runs the handling of the response headers, including the <see cref="operation_context::response_received" /> callback.
+        /// It should not be a scheduler whose threads are kept busy by long-running work.</remarks>
+        void set_io_scheduler(std::shared_ptr<pplx::scheduler_interface> value)
+        {
+            m_io_scheduler = value;
+        }
+
+        /// <summary>
+        /// Gets the scheduler that CPU-heavy work for requests, such as hashing and parsing, is run on.
+        /// </summary>
+        /// <returns>The scheduler, or <c>nullptr</c> if the work is run on the default scheduler.</returns>
+        const std::shared_ptr<pplx::scheduler_interface>& cpu_scheduler() const
+        {
+            return m_cpu_scheduler;
+        }
+
+        /// <summary>
+        /// Sets the scheduler that CPU-heavy work for requests, such as hashing and parsing, is run on.
+        /// </summary>
+        /// <param name="value">The scheduler, or <c>nullptr</c> to use the default scheduler.</param>
+        /// <remarks>This runs the parsing of response bodies and the hashing of the blocks written to a blob stream, so
+        /// that a bounded pool can be dedicated to them without holding up the completion of other requests.</remarks>
+        void set_cpu_scheduler(std::shared_ptr<pplx::scheduler_interface> value)
+        {
+            m_cpu_scheduler = value;
+        }
+
+        /// <summary>
+        /// Gets the allocator that the transfer buffers of the operation are allocated by.
+        /// </summary>
+        /// <returns>The allocator, or <c>nullptr</c> if the buffers are allocated on the heap.</returns>
+        const std::shared_ptr<wa::storage::buffer_allocator>& buffer_allocator() const
+        {
+            return m_buffer_allocator;
+        }
+
+        /// <summary>
+        /// Sets the allocator that the transfer buffers of the operation are allocated by.
+        /// </summary>
+        /// <param name="value">The allocator, or <c>nullptr</c> to allocate the buffers on the heap.</param>
+        /// <remarks>This covers the blocks a blob stream or a parallel copy holds, the ranges a blob stream reads ahead and the
+        /// copy of a request body that cannot be read twice. Small objects, such as parsed responses, are allocated on the heap.</remarks>
+        void set_buffer_allocator(std::shared_ptr<wa::storage::buffer_allocator> value)
+        {
+            m_buffer_allocator = value;
+        }
+
         /// <summary>
         /// Gets the expiry time across all potential retries for the request.
         /// </summary>
@@ -1513,6 +3584,166 @@ namespace wa { namespace storage {
             return m_operation_expiry_time;
         }
 
+        /// <summary>
+        /// Gets the HTTP client pool that requests made with these options are sent through.
+        /// </summary>
+        /// <returns>The HTTP client pool, or <c>nullptr</c> if connections are not pooled.</returns>
+        /// <remarks>This is set internally by the service client that owns the pool.</remarks>
+        const std::shared_ptr<core::http_client_pool>& _http_client_pool() const
+        {
+            return m_http_client_pool;
+        }
+
+        /// <summary>
+        /// Sets the HTTP client pool that requests made with these options are sent through.
+        /// </summary>
+        /// <param name="value">The HTTP client pool.</param>
+        /// <remarks>This is used internally by the service client that owns the pool.</remarks>
+        void _set_http_client_pool(std::shared_ptr<core::http_client_pool> value)
+        {
+            m_http_client_pool = value;
+        }
+
+        /// <summary>
+        /// Gets the health of the locations that requests made with these options in the adaptive location mode are routed by.
+        /// </summary>
+        /// <returns>The location selector, or <c>nullptr</c> if requests always start at the primary location.</returns>
+        /// <remarks>This is set internally by the service client that owns the selector.</remarks>
+        const std::shared_ptr<core::location_selector>& _location_selector() const
+        {
+            return m_location_selector;
+        }
+
+        /// <summary>
+        /// Sets the health of the locations that requests made with these options in the adaptive location mode are routed by.
+        /// </summary>
+        /// <param name="value">The location selector.</param>
+        /// <remarks>This is used internally by the service client that owns the selector.</remarks>
+        void _set_location_selector(std::shared_ptr<core::location_selector> value)
+        {
+            m_location_selector = value;
+        }
+
+        /// <summary>
+        /// Gets the retry budget that retries of requests made with these options are withdrawn from.
+        /// </summary>
+        /// <returns>The retry budget, or <c>nullptr</c> if retries are only limited by the retry policy.</returns>
+        /// <remarks>This is set internally by the service client that owns the budget.</remarks>
+        const std::shared_ptr<core::retry_budget>& _retry_budget() const
+        {
+            return m_retry_budget;
+        }
+
+        /// <summary>
+        /// Sets the retry budget that retries of requests made with these options are withdrawn from.
+        /// </summary>
+        /// <param name="value">The retry budget.</param>
+        /// <remarks>This is used internally by the service client that owns the budget.</remarks>
+        void _set_retry_budget(std::shared_ptr<core::retry_budget> value)
+        {
+            m_retry_budget = value;
+        }
+
+        /// <summary>
+        /// Gets the recorder that the phase timings of requests made with these options are aggregated by.
+        /// </summary>
+        /// <returns>The latency recorder, or <c>nullptr</c> if the timings are not aggregated.</returns>
+        /// <remarks>This is set internally by the service client that owns the recorder.</remarks>
+        const std::shared_ptr<core::latency_recorder>& _latency_recorder() const
+        {
+            return m_latency_recorder;
+        }
+
+        /// <summary>
+        /// Sets the recorder that the phase timings of requests made with these options are aggregated by.
+        /// </summary>
+        /// <param name="value">The latency recorder.</param>
+        /// <remarks>This is used internally by the service client that owns the recorder.</remarks>
+        void _set_latency_recorder(std::shared_ptr<core::latency_recorder> value)
+        {
+            m_latency_recorder = value;
+        }
+
+        /// <summary>
+        /// Gets the cache of the static parts of requests that are sent repeatedly with these options.
+        /// </summary>
+        /// <returns>The prepared request cache, or <c>nullptr</c> if every request is built in full.</returns>
+        /// <remarks>This is set internally by the service client that owns the cache.</remarks>
+        const std::shared_ptr<core::prepared_request_cache>& _prepared_requests() const
+        {
+            return m_prepared_requests;
+        }
+
+        /// <summary>
+        /// Sets the cache of the static parts of requests that are sent repeatedly with these options.
+        /// </summary>
+        /// <param name="value">The prepared request cache.</param>
+        /// <remarks>This is used internally by the service client that owns the cache.</remarks>
+        void _set_prepared_requests(std::shared_ptr<core::prepared_request_cache> value)
+        {
+            m_prepared_requests = value;
+        }
+
+        /// <summary>
+        /// Gets the cache of the containers, queues and tables that were recently confirmed to exist.
+        /// </summary>
+        /// <returns>The existence cache, or <c>nullptr</c> if every request to create a resource is sent.</returns>
+        /// <remarks>This is set internally by the service client that owns the cache.</remarks>
+        const std::shared_ptr<core::existence_cache>& _existence_cache() const
+        {
+            return m_existence_cache;
+        }
+
+        /// <summary>
+        /// Sets the cache of the containers, queues and tables that were recently confirmed to exist.
+        /// </summary>
+        /// <param name="value">The existence cache.</param>
+        /// <remarks>This is used internally by the service client that owns the cache.</remarks>
+        void _set_existence_cache(std::shared_ptr<core::existence_cache> value)
+        {
+            m_existence_cache = value;
+        }
+
+        /// <summary>
+        /// Gets the dispatcher that operations made with these options wait in until their tag may have another operation in flight.
+        /// </summary>
+        /// <returns>The operation dispatcher, or <c>nullptr</c> if operations start right away.</returns>
+        /// <remarks>This is set internally by the service client that owns the dispatcher.</remarks>
+        const std::shared_ptr<core::operation_dispatcher>& _operation_dispatcher() const
+        {
+            return m_operation_dispatcher;
+        }
+
+        /// <summary>
+        /// Sets the dispatcher that operations made with these options wait in until their tag may have another operation in flight.
+        /// </summary>
+        /// <param name="value">The operation dispatcher.</param>
+        /// <remarks>This is used internally by the service client that owns the dispatcher.</remarks>
+        void _set_operation_dispatcher(std::shared_ptr<core::operation_dispatcher> value)
+        {
+            m_operation_dispatcher = value;
+        }
+
+        /// <summary>
+        /// Gets the circuit breaker that decides whether requests made with these options may be sent to a location.
+        /// </summary>
+        /// <returns>The circuit breaker, or <c>nullptr</c> if requests are always sent.</returns>
+        /// <remarks>This is set internally by the service client that owns the circuit breaker.</remarks>
+        const std::shared_ptr<core::circuit_breaker>& _circuit_breaker() const
+        {
+            return m_circuit_breaker;
+        }
+
+        /// <summary>
+        /// Sets the circuit breaker that decides whether requests made with these options may be sent to a location.
+        /// </summary>
+        /// <param name="value">The circuit breaker.</param>
+        /// <remarks>This is used internally by the service client that owns the circuit breaker.</remarks>
+        void _set_circuit_breaker(std::shared_ptr<core::circuit_breaker> value)
+        {
+            m_circuit_breaker = value;
+        }
+
     protected:
 
         /// <summary>
@@ -1521,6 +3752,11 @@ namespace wa { namespace storage {
         request_options()
             : m_server_timeout(protocol::default_server_timeout),
             m_location_mode(location_mode::primary_only),
+            m_hedged_reads(false),
+            m_expect_continue_threshold(0),
+            m_accept_compressed_responses(false),
+            m_transfer_priority(transfer_priority::normal),
+            m_cancellation_token(pplx::cancellation_token::none()),
             m_retry_policy(exponential_retry_policy())
         {
         }
@@ -1541,6 +3777,85 @@ namespace wa { namespace storage {
             m_server_timeout.merge(other.m_server_timeout);
             m_maximum_execution_time.merge(other.m_maximum_execution_time);
             m_location_mode.merge(other.m_location_mode);
+            m_hedged_reads.merge(other.m_hedged_reads);
+            m_expect_continue_threshold.merge(other.m_expect_continue_threshold);
+            m_accept_compressed_responses.merge(other.m_accept_compressed_responses);
+            m_transfer_priority.merge(other.m_transfer_priority);
+
+            if (!m_cancellation_token.is_cancelable())
+            {
+                m_cancellation_token = other.m_cancellation_token;
+            }
+
+            if (!m_transport)
+            {
+                m_transport = other.m_transport;
+            }
+
+            if (!m_bandwidth_limiter)
+            {
+                m_bandwidth_limiter = other.m_bandwidth_limiter;
+            }
+
+            if (!m_tracer)
+            {
+                m_tracer = other.m_tracer;
+            }
+
+            if (!m_io_scheduler)
+            {
+                m_io_scheduler = other.m_io_scheduler;
+            }
+
+            if (!m_cpu_scheduler)
+            {
+                m_cpu_scheduler = other.m_cpu_scheduler;
+            }
+
+            if (!m_buffer_allocator)
+            {
+                m_buffer_allocator = other.m_buffer_allocator;
+            }
+
+            if (!m_http_client_pool)
+            {
+                m_http_client_pool = other.m_http_client_pool;
+            }
+
+            if (!m_location_selector)
+            {
+                m_location_selector = other.m_location_selector;
+            }
+
+            if (!m_retry_budget)
+            {
+                m_retry_budget = other.m_retry_budget;
+            }
+
+            if (!m_latency_recorder)
+            {
+                m_latency_recorder = other.m_latency_recorder;
+            }
+
+            if (!m_prepared_requests)
+            {
+                m_prepared_requests = other.m_prepared_requests;
+            }
+
+            if (!m_existence_cache)
+            {
+                m_existence_cache = other.m_existence_cache;
+            }
+
+            if (!m_operation_dispatcher)
+            {
+                m_operation_dispatcher = other.m_operation_dispatcher;
+            }
+
+            if (!m_circuit_breaker)
+            {
+                m_circuit_breaker = other.m_circuit_breaker;
+            }
 
             if (apply_expiry)
             {
@@ -1563,6 +3878,25 @@ namespace wa { namespace storage {
         option_with_default<std::chrono::seconds> m_server_timeout;
         option_with_default<std::chrono::seconds> m_maximum_execution_time;
         option_with_default<wa::storage::location_mode> m_location_mode;
+        option_with_default<bool> m_hedged_reads;
+        option_with_default<utility::size64_t> m_expect_continue_threshold;
+        option_with_default<bool> m_accept_compressed_responses;
+        option_with_default<wa::storage::transfer_priority> m_transfer_priority;
+        pplx::cancellation_token m_cancellation_token;
+        std::shared_ptr<http_transport> m_transport;
+        std::shared_ptr<wa::storage::bandwidth_limiter> m_bandwidth_limiter;
+        std::shared_ptr<request_tracer> m_tracer;
+        std::shared_ptr<pplx::scheduler_interface> m_io_scheduler;
+        std::shared_ptr<pplx::scheduler_interface> m_cpu_scheduler;
+        std::shared_ptr<wa::storage::buffer_allocator> m_buffer_allocator;
+        std::shared_ptr<core::http_client_pool> m_http_client_pool;
+        std::shared_ptr<core::location_selector> m_location_selector;
+        std::shared_ptr<core::retry_budget> m_retry_budget;
+        std::shared_ptr<core::latency_recorder> m_latency_recorder;
+        std::shared_ptr<core::prepared_request_cache> m_prepared_requests;
+        std::shared_ptr<core::existence_cache> m_existence_cache;
+        std::shared_ptr<core::operation_dispatcher> m_operation_dispatcher;
+        std::shared_ptr<core::circuit_breaker> m_circuit_breaker;
     };
 
 }} // namespace wa::storage
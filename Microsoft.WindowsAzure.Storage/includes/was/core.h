@@ -86,6 +86,13 @@ namespace wa { namespace storage {
         /// Requests should always be sent to the secondary location first. If the request fails, it should be sent to the primary location.
         /// </summary>
         secondary_then_primary,
+
+        /// <summary>
+        /// Requests that either location can serve should be sent first to the location that has recently been faster and more reliable,
+        /// and the other location should be tried from time to time. If the request fails, it should be sent to the other location.
+        /// Requests that only one location can serve are sent to that location.
+        /// </summary>
+        adaptive,
     };
 
     /// <summary>
@@ -427,6 +434,214 @@ namespace wa { namespace storage {
         std::unordered_map<utility::string_t, utility::string_t> m_details;
     };
 
+    /// <summary>
+    /// Represents how long each phase of a request took.
+    /// </summary>
+    /// <remarks>A phase the request did not reach, for example because it failed earlier, is reported as zero.</remarks>
+    class request_timings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="request_timings"/> class.
+        /// </summary>
+        request_timings()
+            : m_build_time(0), m_sign_time(0), m_connection_wait_time(0), m_time_to_first_byte(0), m_body_time(0), m_postprocess_time(0), m_total_time(0)
+        {
+        }
+
+        /// <summary>
+        /// Gets the time it took to build the request, including the callback that is called before it is sent.
+        /// </summary>
+        /// <returns>The build time.</returns>
+        std::chrono::microseconds build_time() const
+        {
+            return m_build_time;
+        }
+
+        /// <summary>
+        /// Sets the time it took to build the request.
+        /// </summary>
+        /// <param name="value">The build time.</param>
+        void set_build_time(std::chrono::microseconds value)
+        {
+            m_build_time = value;
+        }
+
+        /// <summary>
+        /// Gets the time it took to sign the request.
+        /// </summary>
+        /// <returns>The signing time.</returns>
+        std::chrono::microseconds sign_time() const
+        {
+            return m_sign_time;
+        }
+
+        /// <summary>
+        /// Sets the time it took to sign the request.
+        /// </summary>
+        /// <param name="value">The signing time.</param>
+        void set_sign_time(std::chrono::microseconds value)
+        {
+            m_sign_time = value;
+        }
+
+        /// <summary>
+        /// Gets the time the request waited for a connection to the host to become available.
+        /// </summary>
+        /// <returns>The connection wait time.</returns>
+        std::chrono::microseconds connection_wait_time() const
+        {
+            return m_connection_wait_time;
+        }
+
+        /// <summary>
+        /// Sets the time the request waited for a connection to the host to become available.
+        /// </summary>
+        /// <param name="value">The connection wait time.</param>
+        void set_connection_wait_time(std::chrono::microseconds value)
+        {
+            m_connection_wait_time = value;
+        }
+
+        /// <summary>
+        /// Gets the time from sending the request until the response headers arrived, which includes resolving the host
+        /// name, connecting, uploading the request body and the time the service took.
+        /// </summary>
+        /// <returns>The time to the first byte of the response.</returns>
+        std::chrono::microseconds time_to_first_byte() const
+        {
+            return m_time_to_first_byte;
+        }
+
+        /// <summary>
+        /// Sets the time from sending the request until the response headers arrived.
+        /// </summary>
+        /// <param name="value">The time to the first byte of the response.</param>
+        void set_time_to_first_byte(std::chrono::microseconds value)
+        {
+            m_time_to_first_byte = value;
+        }
+
+        /// <summary>
+        /// Gets the time from the arrival of the response headers until the response body was downloaded.
+        /// </summary>
+        /// <returns>The body download time.</returns>
+        std::chrono::microseconds body_time() const
+        {
+            return m_body_time;
+        }
+
+        /// <summary>
+        /// Sets the time from the arrival of the response headers until the response body was downloaded.
+        /// </summary>
+        /// <param name="value">The body download time.</param>
+        void set_body_time(std::chrono::microseconds value)
+        {
+            m_body_time = value;
+        }
+
+        /// <summary>
+        /// Gets the time it took to process the response body once it was downloaded.
+        /// </summary>
+        /// <returns>The post-processing time.</returns>
+        std::chrono::microseconds postprocess_time() const
+        {
+            return m_postprocess_time;
+        }
+
+        /// <summary>
+        /// Sets the time it took to process the response body once it was downloaded.
+        /// </summary>
+        /// <param name="value">The post-processing time.</param>
+        void set_postprocess_time(std::chrono::microseconds value)
+        {
+            m_postprocess_time = value;
+        }
+
+        /// <summary>
+        /// Gets the time the whole request took.
+        /// </summary>
+        /// <returns>The total time.</returns>
+        std::chrono::microseconds total_time() const
+        {
+            return m_total_time;
+        }
+
+        /// <summary>
+        /// Sets the time the whole request took.
+        /// </summary>
+        /// <param name="value">The total time.</param>
+        void set_total_time(std::chrono::microseconds value)
+        {
+            m_total_time = value;
+        }
+
+    private:
+
+        std::chrono::microseconds m_build_time;
+        std::chrono::microseconds m_sign_time;
+        std::chrono::microseconds m_connection_wait_time;
+        std::chrono::microseconds m_time_to_first_byte;
+        std::chrono::microseconds m_body_time;
+        std::chrono::microseconds m_postprocess_time;
+        std::chrono::microseconds m_total_time;
+    };
+
+    /// <summary>
+    /// Represents the heap allocations made while a request was executed.
+    /// </summary>
+    /// <remarks>
+    /// Allocations are only counted when the library is built with WASTORAGE_COUNT_ALLOCATIONS defined, and are reported
+    /// as zero otherwise. Only allocations made on the threads that run the steps of the request are counted, so work
+    /// that the HTTP client does on its own threads is not included.
+    /// </remarks>
+    class request_allocations
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="request_allocations"/> class.
+        /// </summary>
+        request_allocations()
+            : m_count(0), m_bytes(0)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="request_allocations"/> class.
+        /// </summary>
+        /// <param name="count">The number of allocations.</param>
+        /// <param name="bytes">The number of bytes allocated.</param>
+        request_allocations(uint64_t count, uint64_t bytes)
+            : m_count(count), m_bytes(bytes)
+        {
+        }
+
+        /// <summary>
+        /// Gets the number of heap allocations made by the request.
+        /// </summary>
+        /// <returns>The number of allocations.</returns>
+        uint64_t count() const
+        {
+            return m_count;
+        }
+
+        /// <summary>
+        /// Gets the number of bytes the request allocated from the heap.
+        /// </summary>
+        /// <returns>The number of bytes allocated.</returns>
+        uint64_t bytes() const
+        {
+            return m_bytes;
+        }
+
+    private:
+
+        uint64_t m_count;
+        uint64_t m_bytes;
+    };
+
     /// <summary>
     /// Represents a result returned by a request.
     /// </summary>
@@ -528,6 +743,44 @@ namespace wa { namespace storage {
             return m_extended_error;
         }
 
+        /// <summary>
+        /// Gets how long each phase of the request took.
+        /// </summary>
+        /// <returns>A <see cref="request_timings" /> object.</returns>
+        const request_timings& timings() const
+        {
+            return m_timings;
+        }
+
+        /// <summary>
+        /// Sets how long each phase of the request took.
+        /// </summary>
+        /// <param name="value">A <see cref="request_timings" /> object.</param>
+        /// <remarks>This is set internally by the executor of the request.</remarks>
+        void _set_timings(const request_timings& value)
+        {
+            m_timings = value;
+        }
+
+        /// <summary>
+        /// Gets the heap allocations made while the request was executed.
+        /// </summary>
+        /// <returns>A <see cref="request_allocations" /> object.</returns>
+        const request_allocations& allocations() const
+        {
+            return m_allocations;
+        }
+
+        /// <summary>
+        /// Sets the heap allocations made while the request was executed.
+        /// </summary>
+        /// <param name="value">A <see cref="request_allocations" /> object.</param>
+        /// <remarks>This is set internally by the executor of the request.</remarks>
+        void _set_allocations(const request_allocations& value)
+        {
+            m_allocations = value;
+        }
+
     private:
 
         void parse_headers(const web::http::http_headers& headers);
@@ -543,6 +796,8 @@ namespace wa { namespace storage {
         storage_extended_error m_extended_error;
         utility::datetime m_start_time;
         utility::datetime m_end_time;
+        request_timings m_timings;
+        request_allocations m_allocations;
     };
 
     /// <summary>
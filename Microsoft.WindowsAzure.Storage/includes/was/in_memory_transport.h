@@ -0,0 +1,228 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="in_memory_transport.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <random>
+
+#include "common.h"
+
+namespace wa { namespace storage {
+
+    /// <summary>
+    /// A transport that answers requests from memory with canned responses of the Blob, Queue and Table services, so that
+    /// the throughput of the client itself can be measured without an account or the network.
+    /// </summary>
+    /// <remarks>The responses only look like those of the services, and nothing that is written can be read back. The
+    /// settings should not be changed while requests are being sent.</remarks>
+    class in_memory_transport : public http_transport
+    {
+    public:
+
+        /// <summary>
+        /// Builds the response to a request, with its body set but not yet complete. The body of the request is passed
+        /// for table batches, whose response depends on it, and is empty for other requests.
+        /// </summary>
+        typedef std::function<web::http::http_response (const web::http::http_request&, const std::string&)> responder_type;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="in_memory_transport"/> class, which answers every request right away.
+        /// </summary>
+        WASTORAGE_API in_memory_transport();
+
+        /// <summary>
+        /// Reads the body of a request and answers it after the latency and the transfer time of both bodies have passed.
+        /// </summary>
+        /// <param name="request">The request.</param>
+        /// <param name="token">A token that cancels the request.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes with the response.</returns>
+        WASTORAGE_API pplx::task<web::http::http_response> send(web::http::http_request request, const pplx::cancellation_token& token) override;
+
+        /// <summary>
+        /// Builds the canned response to a request. A responder may call this for the requests it does not handle itself.
+        /// </summary>
+        /// <param name="request">The request.</param>
+        /// <param name="batch_body">The body of a table batch request, or an empty string.</param>
+        /// <returns>The response, with its body set but not yet complete.</returns>
+        WASTORAGE_API web::http::http_response default_response(const web::http::http_request& request, const std::string& batch_body) const;
+
+        /// <summary>
+        /// Gets the function that builds the responses.
+        /// </summary>
+        /// <returns>The responder, or an empty function if the canned responses are used.</returns>
+        const responder_type& responder() const
+        {
+            return m_responder;
+        }
+
+        /// <summary>
+        /// Sets the function that builds the responses.
+        /// </summary>
+        /// <param name="value">The responder, or an empty function to use the canned responses.</param>
+        void set_responder(responder_type value)
+        {
+            m_responder = std::move(value);
+        }
+
+        /// <summary>
+        /// Gets the time that passes before each response starts to arrive.
+        /// </summary>
+        /// <returns>The latency.</returns>
+        std::chrono::milliseconds latency() const
+        {
+            return m_latency;
+        }
+
+        /// <summary>
+        /// Sets the time that passes before each response starts to arrive.
+        /// </summary>
+        /// <param name="value">The latency.</param>
+        void set_latency(std::chrono::milliseconds value)
+        {
+            m_latency = value;
+        }
+
+        /// <summary>
+        /// Gets the number of bytes of request and response bodies that each request transfers per second.
+        /// </summary>
+        /// <returns>The bandwidth per request, or 0 if the bodies are transferred right away.</returns>
+        utility::size64_t bandwidth() const
+        {
+            return m_bandwidth;
+        }
+
+        /// <summary>
+        /// Sets the number of bytes of request and response bodies that each request transfers per second.
+        /// </summary>
+        /// <param name="value">The bandwidth per request, or 0 to transfer the bodies right away.</param>
+        void set_bandwidth(utility::size64_t value)
+        {
+            m_bandwidth = value;
+        }
+
+        /// <summary>
+        /// Gets the share of requests that are answered with 503 Server Busy.
+        /// </summary>
+        /// <returns>The share of requests between 0 and 1.</returns>
+        double error_rate() const
+        {
+            return m_error_rate;
+        }
+
+        /// <summary>
+        /// Sets the share of requests that are answered with 503 Server Busy.
+        /// </summary>
+        /// <param name="value">The share of requests between 0 and 1.</param>
+        WASTORAGE_API void set_error_rate(double value);
+
+        /// <summary>
+        /// Gets the share of requests that fail as if the connection was lost, without a response.
+        /// </summary>
+        /// <returns>The share of requests between 0 and 1.</returns>
+        double failure_rate() const
+        {
+            return m_failure_rate;
+        }
+
+        /// <summary>
+        /// Sets the share of requests that fail as if the connection was lost, without a response.
+        /// </summary>
+        /// <param name="value">The share of requests between 0 and 1.</param>
+        WASTORAGE_API void set_failure_rate(double value);
+
+        /// <summary>
+        /// Restarts the sequence that decides which requests get an error or a failure, so that a run can be repeated.
+        /// </summary>
+        /// <param name="value">The seed of the sequence.</param>
+        void set_seed(unsigned int value)
+        {
+            std::lock_guard<std::mutex> guard(m_random_mutex);
+            m_random.seed(value);
+        }
+
+        /// <summary>
+        /// Gets the size of the blobs that are downloaded.
+        /// </summary>
+        /// <returns>The size of every blob, in bytes.</returns>
+        utility::size64_t blob_size() const
+        {
+            return m_blob_size;
+        }
+
+        /// <summary>
+        /// Sets the size of the blobs that are downloaded.
+        /// </summary>
+        /// <param name="value">The size of every blob, in bytes.</param>
+        void set_blob_size(utility::size64_t value)
+        {
+            m_blob_size = value;
+        }
+
+        /// <summary>
+        /// Gets the number of items that list operations and queries return.
+        /// </summary>
+        /// <returns>The number of containers, blobs, queues, tables or entities in each response.</returns>
+        int listing_size() const
+        {
+            return m_listing_size;
+        }
+
+        /// <summary>
+        /// Sets the number of items that list operations and queries return.
+        /// </summary>
+        /// <param name="value">The number of containers, blobs, queues, tables or entities in each response.</param>
+        void set_listing_size(int value)
+        {
+            m_listing_size = value;
+        }
+
+        /// <summary>
+        /// Gets the number of requests that have been sent through the transport.
+        /// </summary>
+        /// <returns>The number of requests.</returns>
+        utility::size64_t request_count() const
+        {
+            return m_request_count;
+        }
+
+    private:
+
+        enum class request_outcome
+        {
+            response,
+            error,
+            failure
+        };
+
+        request_outcome next_outcome();
+
+        responder_type m_responder;
+        std::chrono::milliseconds m_latency;
+        utility::size64_t m_bandwidth;
+        double m_error_rate;
+        double m_failure_rate;
+        utility::size64_t m_blob_size;
+        int m_listing_size;
+        std::atomic<utility::size64_t> m_request_count;
+        std::mt19937 m_random;
+        std::mutex m_random_mutex;
+    };
+
+}} // namespace wa::storage
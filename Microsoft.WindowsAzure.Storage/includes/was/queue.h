@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "blob.h"
 #include "service_client.h"
 
 namespace wa { namespace storage {
@@ -25,6 +26,11 @@ namespace wa { namespace storage {
     class cloud_queue;
     class cloud_queue_client;
 
+    namespace protocol
+    {
+        class message_writer;
+    }
+
     /*
     namespace details
     {
@@ -174,7 +180,7 @@ namespace wa { namespace storage {
         /// Initializes a new instance of the <see cref="cloud_queue_message"/> class.
         /// </summary>
         cloud_queue_message()
-            : m_dequeue_count(0)
+            : m_is_binary(false), m_dequeue_count(0)
         {
         }
 
@@ -183,7 +189,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="content">The content of the message.</param>
         cloud_queue_message(const utility::string_t& content)
-            : m_content(content), m_dequeue_count(0)
+            : m_content(content), m_is_binary(false), m_dequeue_count(0)
         {
         }
 
@@ -213,8 +219,9 @@ namespace wa { namespace storage {
         /// Initializes a new instance of the <see cref="cloud_queue_message"/> class with the specified raw data.
         /// </summary>
         /// <param name="content">The content of the message as raw data.</param>
-        cloud_queue_message(const std::vector<uint8_t>& content)
-            : m_content(utility::conversions::to_base64(content)), m_dequeue_count(0)
+        /// <remarks>The data is kept as it is and only base64 encoded when it is sent, directly into the request body.</remarks>
+        cloud_queue_message(std::vector<uint8_t> content)
+            : m_binary_content(std::move(content)), m_is_binary(true), m_dequeue_count(0)
         {
         }
 
@@ -224,27 +231,24 @@ namespace wa { namespace storage {
         /// <param name="id">The unique ID of the message.</param>
         /// <param name="pop_receipt">The pop receipt token.</param>
         cloud_queue_message(const utility::string_t& id, const utility::string_t& pop_receipt)
-            : m_id(id), m_pop_receipt(pop_receipt), m_dequeue_count(0)
+            : m_id(id), m_pop_receipt(pop_receipt), m_is_binary(false), m_dequeue_count(0)
         {
         }
 
         /// <summary>
         /// Gets the content of the message as text.
         /// </summary>
-        /// <returns>The content of the message as text.</returns>
+        /// <returns>The content of the message as text, which is base64 encoded if the content was set as raw data.</returns>
         const utility::string_t content_as_string() const
         {
-            return m_content;
+            return m_is_binary ? utility::conversions::to_base64(m_binary_content) : m_content;
         }
 
         /// <summary>
         /// Gets the content of the message as raw data.
         /// </summary>
-        /// <returns>The content of the message as raw data.</returns>
-        const std::vector<uint8_t> content_as_binary() const
-        {
-            return std::vector<uint8_t>(utility::conversions::from_base64(m_content));
-        }
+        /// <returns>The content of the message as raw data, decoded from base64 unless the content was set as raw data.</returns>
+        WASTORAGE_API const std::vector<uint8_t> content_as_binary() const;
 
         /// <summary>
         /// Sets the content of this message.
@@ -253,15 +257,19 @@ namespace wa { namespace storage {
         void set_content(const utility::string_t& value)
         {
             m_content = value;
+            m_binary_content.clear();
+            m_is_binary = false;
         }
 
         /// <summary>
         /// Sets the content of this message.
         /// </summary>
         /// <param name="content">The new message content.</param>
-        void set_content(const std::vector<uint8_t>& value)
+        void set_content(std::vector<uint8_t> value)
         {
-            m_content = utility::conversions::to_base64(value);
+            m_binary_content = std::move(value);
+            m_content.clear();
+            m_is_binary = true;
         }
 
         /// <summary>
@@ -336,7 +344,7 @@ namespace wa { namespace storage {
     private:
 
         cloud_queue_message(const utility::string_t& content, const utility::string_t& id, const utility::string_t& pop_receipt, const utility::datetime& insertion_time, const utility::datetime& expiration_time, const utility::datetime& next_visible_time, int dequeue_count)
-            : m_content(content), m_id(id), m_pop_receipt(pop_receipt), m_insertion_time(insertion_time), m_expiration_time(expiration_time), m_next_visible_time(next_visible_time), m_dequeue_count(dequeue_count)
+            : m_content(content), m_id(id), m_pop_receipt(pop_receipt), m_insertion_time(insertion_time), m_expiration_time(expiration_time), m_next_visible_time(next_visible_time), m_is_binary(false), m_dequeue_count(dequeue_count)
         {
         }
 
@@ -368,14 +376,17 @@ namespace wa { namespace storage {
         */
 
         utility::string_t m_content;
+        std::vector<uint8_t> m_binary_content;
         utility::string_t m_id;
         utility::string_t m_pop_receipt;
         utility::datetime m_insertion_time;
         utility::datetime m_expiration_time;
         utility::datetime m_next_visible_time;
+        bool m_is_binary;
         int m_dequeue_count;
 
         friend class cloud_queue;
+        friend class protocol::message_writer;
     };
 
     /// <summary>
@@ -389,7 +400,8 @@ namespace wa { namespace storage {
         /// Initializes a new instance of the <see cref="wa::storage::queue_request_options" /> class.
         /// </summary>
         queue_request_options()
-            : request_options()
+            : request_options(),
+            m_create_queue_if_not_found(false)
         {
         }
 
@@ -400,7 +412,34 @@ namespace wa { namespace storage {
         void apply_defaults(const queue_request_options& other)
         {
             request_options::apply_defaults(other, true);
+
+            m_create_queue_if_not_found.merge(other.m_create_queue_if_not_found);
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether adding a message creates the queue if it turns out not to exist.
+        /// </summary>
+        /// <returns><c>true</c> if adding a message creates a missing queue; otherwise, <c>false</c>.</returns>
+        bool create_queue_if_not_found() const
+        {
+            return m_create_queue_if_not_found;
+        }
+
+        /// <summary>
+        /// Indicates whether adding a message creates the queue if it turns out not to exist.
+        /// </summary>
+        /// <param name="value"><c>true</c> to create a missing queue; otherwise, <c>false</c>.</param>
+        /// <remarks>The message is added as if the queue existed. Only if that fails with QueueNotFound is the queue created and the
+        /// message added again, so writers need no round trip to create the queue up front. Adds to the same queue that fail at the
+        /// same time wait for a single creation.</remarks>
+        void set_create_queue_if_not_found(bool value)
+        {
+            m_create_queue_if_not_found = value;
         }
+
+    private:
+
+        option_with_default<bool> m_create_queue_if_not_found;
     };
 
     /// <summary>
@@ -454,6 +493,113 @@ namespace wa { namespace storage {
         friend class cloud_queue_client;
     };
 
+    /// <summary>
+    /// Packs small logical messages into envelopes that are each added as one <see cref="wa::storage::cloud_queue_message"/>, so that
+    /// adding, getting and deleting them takes one transaction per envelope rather than one per logical message.
+    /// </summary>
+    /// <remarks>
+    /// An envelope is binary content that starts with a three-byte header and frames each logical message as its size, in a variable number
+    /// of bytes, followed by its bytes. An envelope is filled up to the size that still fits in a message once it is base64 encoded.
+    /// </remarks>
+    class queue_message_packer
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_packer" /> class with an empty envelope.
+        /// </summary>
+        queue_message_packer()
+            : m_count(0)
+        {
+        }
+
+        /// <summary>
+        /// Adds a logical message to the current envelope if it fits.
+        /// </summary>
+        /// <param name="content">The content of the logical message.</param>
+        /// <returns><c>true</c> if the message was added; <c>false</c> if the envelope is too full, in which case the envelope is taken and the message added again.</returns>
+        /// <remarks>
+        /// An exception is thrown if the message would not fit even in an empty envelope.
+        /// </remarks>
+        WASTORAGE_API bool try_add(const std::vector<uint8_t>& content);
+
+        /// <summary>
+        /// Gets the number of logical messages in the current envelope.
+        /// </summary>
+        /// <returns>The number of logical messages.</returns>
+        size_t count() const
+        {
+            return m_count;
+        }
+
+        /// <summary>
+        /// Takes the current envelope, after which the packer starts an empty one.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::cloud_queue_message"/> object with the envelope as its content.</returns>
+        WASTORAGE_API cloud_queue_message take_envelope();
+
+    private:
+
+        std::vector<uint8_t> m_envelope;
+        size_t m_count;
+    };
+
+    /// <summary>
+    /// Represents an envelope retrieved from a queue, with the logical messages that it holds and which of them have been completed.
+    /// </summary>
+    /// <remarks>
+    /// Copies share the completion of the logical messages, so a copy can be passed to each consumer. A message that is not
+    /// an envelope holds one logical message, which is the text of the message as UTF-8.
+    /// </remarks>
+    class queue_packed_message
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_packed_message" /> class by unpacking an envelope.
+        /// </summary>
+        /// <param name="envelope">The message that was retrieved from the queue.</param>
+        WASTORAGE_API explicit queue_packed_message(cloud_queue_message envelope);
+
+        /// <summary>
+        /// Gets the message that holds the logical messages, with the pop receipt it was retrieved with.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::cloud_queue_message"/> object.</returns>
+        WASTORAGE_API const cloud_queue_message& envelope() const;
+
+        /// <summary>
+        /// Gets the number of logical messages in the envelope.
+        /// </summary>
+        /// <returns>The number of logical messages.</returns>
+        WASTORAGE_API size_t size() const;
+
+        /// <summary>
+        /// Gets the content of a logical message.
+        /// </summary>
+        /// <param name="index">The index of the logical message.</param>
+        /// <returns>The content of the logical message.</returns>
+        WASTORAGE_API const std::vector<uint8_t>& content(size_t index) const;
+
+        /// <summary>
+        /// Marks a logical message as completed.
+        /// </summary>
+        /// <param name="index">The index of the logical message.</param>
+        /// <returns><c>true</c> if it was the last logical message to be completed, in which case the envelope can be deleted.</returns>
+        WASTORAGE_API bool complete(size_t index);
+
+        /// <summary>
+        /// Gets the number of logical messages that have not been completed yet.
+        /// </summary>
+        /// <returns>The number of logical messages left.</returns>
+        WASTORAGE_API size_t remaining() const;
+
+    private:
+
+        struct shared_state;
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
     /// <summary>
     /// Provides a client-side logical representation of the Windows Azure Queue service. This client is used to configure and execute requests against the Queue service.
     /// </summary>
@@ -747,6 +893,15 @@ namespace wa { namespace storage {
         void initialize()
         {
             set_authentication_scheme(authentication_scheme::shared_key);
+            m_default_request_options._set_http_client_pool(http_client_pool());
+            m_default_request_options._set_location_selector(location_selector());
+            m_default_request_options._set_retry_budget(retry_budget());
+            m_default_request_options._set_latency_recorder(latency_recorder());
+            m_default_request_options._set_prepared_requests(prepared_requests());
+            m_default_request_options._set_existence_cache(existence_cache());
+            m_default_request_options._set_operation_dispatcher(operation_dispatcher());
+            m_default_request_options._set_circuit_breaker(circuit_breaker());
+            set_service_name(U("queue"));
         }
 
         queue_request_options get_modified_options(const queue_request_options& options) const;
@@ -1002,6 +1157,60 @@ namespace wa { namespace storage {
         /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
         WASTORAGE_API pplx::task<void> add_message_async(cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, queue_request_options& options, operation_context context);
 
+        /// <summary>
+        /// Adds many messages to the queue, with a bounded number of adds in flight.
+        /// </summary>
+        /// <param name="messages">The messages to add to the queue.</param>
+        /// <returns>An enumerable collection with an element for each message, in the same order, which is a null pointer if the message was added 
+        /// and otherwise points to the exception that adding it failed with.</returns>
+        std::vector<std::exception_ptr> add_messages(std::vector<cloud_queue_message> messages)
+        {
+            return add_messages_async(std::move(messages)).get();
+        }
+
+        /// <summary>
+        /// Adds many messages to the queue, with a bounded number of adds in flight.
+        /// </summary>
+        /// <param name="messages">The messages to add to the queue.</param>
+        /// <param name="time_to_live">The maximum time to allow the messages to be in the queue.</param>
+        /// <param name="initial_visibility_timeout">The length of time from now during which the messages will be invisible.</param>
+        /// <param name="max_concurrent_adds">The maximum number of adds in flight at the same time.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>An enumerable collection with an element for each message, in the same order, which is a null pointer if the message was added 
+        /// and otherwise points to the exception that adding it failed with.</returns>
+        std::vector<std::exception_ptr> add_messages(std::vector<cloud_queue_message> messages, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, int max_concurrent_adds, queue_request_options& options, operation_context context)
+        {
+            return add_messages_async(std::move(messages), time_to_live, initial_visibility_timeout, max_concurrent_adds, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to add many messages to the queue, with a bounded number of adds in flight.
+        /// </summary>
+        /// <param name="messages">The messages to add to the queue.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type enumerable collection of <see cref="std::exception_ptr" /> that represents the current operation.</returns>
+        pplx::task<std::vector<std::exception_ptr>> add_messages_async(std::vector<cloud_queue_message> messages)
+        {
+            queue_request_options options;
+            return add_messages_async(std::move(messages), std::chrono::seconds(604800LL), std::chrono::seconds(0LL), protocol::default_max_concurrent_message_adds, options, operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to add many messages to the queue, with a bounded number of adds in flight.
+        /// </summary>
+        /// <param name="messages">The messages to add to the queue.</param>
+        /// <param name="time_to_live">The maximum time to allow the messages to be in the queue.</param>
+        /// <param name="initial_visibility_timeout">The length of time from now during which the messages will be invisible.</param>
+        /// <param name="max_concurrent_adds">The maximum number of adds in flight at the same time.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type enumerable collection of <see cref="std::exception_ptr" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// The adds share the pooled connections of the client, and the part of their signature that only depends on the URI is computed once.
+        /// A failed add does not stop the others; its error is returned in the element for its message.
+        /// </remarks>
+        WASTORAGE_API pplx::task<std::vector<std::exception_ptr>> add_messages_async(std::vector<cloud_queue_message> messages, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, int max_concurrent_adds, queue_request_options& options, operation_context context);
+
         /// <summary>
         /// Retrieves a message from the front of the queue
         /// </summary>
@@ -1099,6 +1308,73 @@ namespace wa { namespace storage {
         /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="cloud_queue_message" />, that represents the current operation.</returns>
         WASTORAGE_API pplx::task<std::vector<cloud_queue_message>> get_messages_async(size_t message_count, std::chrono::seconds visibility_timeout, queue_request_options& options, operation_context context);
 
+        /// <summary>
+        /// Adds many logical messages to the queue, packed into as few envelopes as they fit in.
+        /// </summary>
+        /// <param name="contents">The content of each logical message.</param>
+        /// <param name="time_to_live">The maximum time to allow the messages to be in the queue.</param>
+        /// <param name="initial_visibility_timeout">The length of time from now during which the messages will be invisible.</param>
+        /// <param name="max_concurrent_adds">The maximum number of adds in flight at the same time.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>An enumerable collection with an element for each logical message, in the same order, which is a null pointer if the message was added
+        /// and otherwise points to the exception that adding its envelope failed with.</returns>
+        std::vector<std::exception_ptr> add_packed_messages(const std::vector<std::vector<uint8_t>>& contents, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, int max_concurrent_adds, queue_request_options& options, operation_context context)
+        {
+            return add_packed_messages_async(contents, time_to_live, initial_visibility_timeout, max_concurrent_adds, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation to add many logical messages to the queue, packed into as few envelopes as they fit in.
+        /// </summary>
+        /// <param name="contents">The content of each logical message.</param>
+        /// <param name="time_to_live">The maximum time to allow the messages to be in the queue.</param>
+        /// <param name="initial_visibility_timeout">The length of time from now during which the messages will be invisible.</param>
+        /// <param name="max_concurrent_adds">The maximum number of adds in flight at the same time.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type enumerable collection of <see cref="std::exception_ptr" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// The logical messages are packed in order by a <see cref="wa::storage::queue_message_packer"/>, and the envelopes are added as by
+        /// <see cref="add_messages_async" />. The messages of an envelope that could not be added all get the error of that envelope.
+        /// </remarks>
+        WASTORAGE_API pplx::task<std::vector<std::exception_ptr>> add_packed_messages_async(const std::vector<std::vector<uint8_t>>& contents, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, int max_concurrent_adds, queue_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Retrieves the specified number of envelopes from the front of the queue and unpacks their logical messages.
+        /// </summary>
+        /// <param name="message_count">The number of envelopes to retrieve.</param>
+        /// <param name="visibility_timeout">The length of time from now during which the envelopes will be invisible.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::queue_packed_message" /> objects.</returns>
+        std::vector<queue_packed_message> get_packed_messages(size_t message_count, std::chrono::seconds visibility_timeout, queue_request_options& options, operation_context context)
+        {
+            return get_packed_messages_async(message_count, visibility_timeout, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that retrieves the specified number of envelopes from the front of the queue
+        /// and unpacks their logical messages.
+        /// </summary>
+        /// <param name="message_count">The number of envelopes to retrieve.</param>
+        /// <param name="visibility_timeout">The length of time from now during which the envelopes will be invisible.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="wa::storage::queue_packed_message" />, that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<std::vector<queue_packed_message>> get_packed_messages_async(size_t message_count, std::chrono::seconds visibility_timeout, queue_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that completes a logical message, deleting its envelope once every
+        /// logical message of the envelope has been completed.
+        /// </summary>
+        /// <param name="message">The envelope that holds the logical message.</param>
+        /// <param name="index">The index of the logical message.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes with <c>true</c> if the envelope was deleted.</returns>
+        WASTORAGE_API pplx::task<bool> complete_packed_message_async(queue_packed_message& message, size_t index, queue_request_options& options, operation_context context);
+
         /// <summary>
         /// Peeks a message from the front of the queue
         /// </summary>
@@ -1568,5 +1844,1018 @@ namespace wa { namespace storage {
         friend class cloud_queue_client;
     };
 
+    /// <summary>
+    /// Gets messages from a queue ahead of time, so that consumers do not have to wait for a request every time they need a message.
+    /// </summary>
+    /// <remarks>
+    /// Messages are retrieved in the background, up to 32 at a time, and the number kept in the buffer follows the rate at which they
+    /// are consumed and the time the requests take. Every message in the buffer is invisible to other consumers, so a message is discarded
+    /// rather than returned once its visibility timeout is about to expire; it becomes visible in the queue again afterwards.
+    /// Messages are not deleted from the queue, which still has to be done once they have been processed.
+    /// </remarks>
+    class queue_message_prefetcher
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_prefetcher" /> class.
+        /// </summary>
+        /// <param name="queue">The queue to get messages from.</param>
+        /// <param name="visibility_timeout">The time interval for which the messages retrieved are invisible to other consumers, or 0 for the default of the service.</param>
+        queue_message_prefetcher(const cloud_queue& queue, std::chrono::seconds visibility_timeout)
+        {
+            initialize(queue, visibility_timeout, queue_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_prefetcher" /> class.
+        /// </summary>
+        /// <param name="queue">The queue to get messages from.</param>
+        /// <param name="visibility_timeout">The time interval for which the messages retrieved are invisible to other consumers, or 0 for the default of the service.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        queue_message_prefetcher(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+        {
+            initialize(queue, visibility_timeout, options, context);
+        }
+
+        /// <summary>
+        /// Gets the next message.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::cloud_queue_message" /> object, which has an empty ID if the queue is empty.</returns>
+        cloud_queue_message get_message()
+        {
+            return get_message_async().get();
+        }
+
+        /// <summary>
+        /// Returns a task that gets the next message. Several messages may be requested at the same time.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::cloud_queue_message" /> that completes with the message,
+        /// which has an empty ID if the queue is empty.</returns>
+        WASTORAGE_API pplx::task<cloud_queue_message> get_message_async();
+
+        /// <summary>
+        /// Gets the maximum number of messages that are kept in the buffer.
+        /// </summary>
+        /// <returns>The maximum number of buffered messages.</returns>
+        WASTORAGE_API size_t max_buffered_messages() const;
+
+        /// <summary>
+        /// Sets the maximum number of messages that are kept in the buffer.
+        /// </summary>
+        /// <param name="value">The maximum number of buffered messages, which must be at least 1.</param>
+        WASTORAGE_API void set_max_buffered_messages(size_t value);
+
+        /// <summary>
+        /// Gets the time that must be left before the visibility timeout of a buffered message expires for it to be returned.
+        /// </summary>
+        /// <returns>The minimum remaining visibility time.</returns>
+        WASTORAGE_API std::chrono::seconds minimum_remaining_visibility() const;
+
+        /// <summary>
+        /// Sets the time that must be left before the visibility timeout of a buffered message expires for it to be returned.
+        /// This should cover the time needed to process the message.
+        /// </summary>
+        /// <param name="value">The minimum remaining visibility time, which must be shorter than the visibility timeout.</param>
+        WASTORAGE_API void set_minimum_remaining_visibility(std::chrono::seconds value);
+
+    private:
+
+        struct shared_state;
+
+        WASTORAGE_API void initialize(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+    /// <summary>
+    /// Gets messages from a queue and passes each of them to a handler, polling less often while the queue is empty.
+    /// </summary>
+    /// <remarks>
+    /// The queue is polled again right away as long as it returns messages and a handler is free. Each empty response doubles the time
+    /// until the next poll, up to the maximum polling interval, and a random part of it is left out so that pumps started together do
+    /// not poll at the same time. A message is deleted once the task returned by its handler completes successfully; if the handler fails,
+    /// the message becomes visible in the queue again when its visibility timeout expires. No thread is dedicated to the pump.
+    /// </remarks>
+    class queue_message_pump
+    {
+    public:
+
+        /// <summary>
+        /// The type of the function that processes a message.
+        /// </summary>
+        typedef std::function<pplx::task<void> (const cloud_queue_message&)> handler_type;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_pump" /> class.
+        /// </summary>
+        /// <param name="queue">The queue to get messages from.</param>
+        /// <param name="handler">The function that processes a message.</param>
+        queue_message_pump(const cloud_queue& queue, handler_type handler)
+            : m_queue(queue), m_handler(std::move(handler)), m_visibility_timeout(0), m_max_concurrent_handlers(1),
+            m_min_polling_interval(protocol::default_min_polling_interval), m_max_polling_interval(protocol::default_max_polling_interval),
+            m_adaptive_visibility_timeout(false), m_visibility_percentile(protocol::default_adaptive_visibility_percentile), m_visibility_margin(protocol::default_adaptive_visibility_margin)
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_pump" /> class.
+        /// </summary>
+        /// <param name="queue">The queue to get messages from.</param>
+        /// <param name="handler">The function that processes a message.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        queue_message_pump(const cloud_queue& queue, handler_type handler, const queue_request_options& options, operation_context context)
+            : m_queue(queue), m_handler(std::move(handler)), m_options(options), m_context(context), m_visibility_timeout(0), m_max_concurrent_handlers(1),
+            m_min_polling_interval(protocol::default_min_polling_interval), m_max_polling_interval(protocol::default_max_polling_interval),
+            m_adaptive_visibility_timeout(false), m_visibility_percentile(protocol::default_adaptive_visibility_percentile), m_visibility_margin(protocol::default_adaptive_visibility_margin)
+        {
+        }
+
+        /// <summary>
+        /// Stops the pump without waiting for the handlers that are running.
+        /// </summary>
+        WASTORAGE_API ~queue_message_pump();
+
+        /// <summary>
+        /// Starts getting messages and passing them to the handler. The settings cannot be changed afterwards.
+        /// </summary>
+        WASTORAGE_API void start();
+
+        /// <summary>
+        /// Stops getting messages and waits until every running handler has completed.
+        /// </summary>
+        void stop()
+        {
+            stop_async().wait();
+        }
+
+        /// <summary>
+        /// Returns a task that stops getting messages and waits until every running handler has completed.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> stop_async();
+
+        /// <summary>
+        /// Gets the time interval for which the messages retrieved are invisible to other consumers.
+        /// </summary>
+        /// <returns>The visibility timeout, or 0 for the default of the service.</returns>
+        std::chrono::seconds visibility_timeout() const
+        {
+            return m_visibility_timeout;
+        }
+
+        /// <summary>
+        /// Sets the time interval for which the messages retrieved are invisible to other consumers. It should be longer than a handler takes.
+        /// </summary>
+        /// <param name="value">The visibility timeout, or 0 for the default of the service.</param>
+        void set_visibility_timeout(std::chrono::seconds value)
+        {
+            m_visibility_timeout = value;
+        }
+
+        /// <summary>
+        /// Gets the maximum number of handlers that run at the same time.
+        /// </summary>
+        /// <returns>The maximum number of concurrent handlers.</returns>
+        int max_concurrent_handlers() const
+        {
+            return m_max_concurrent_handlers;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of handlers that run at the same time. No more messages are retrieved than there are free handlers.
+        /// </summary>
+        /// <param name="value">The maximum number of concurrent handlers, which must be at least 1.</param>
+        void set_max_concurrent_handlers(int value)
+        {
+            m_max_concurrent_handlers = value;
+        }
+
+        /// <summary>
+        /// Gets the time to wait before polling again after the first empty response.
+        /// </summary>
+        /// <returns>The minimum polling interval.</returns>
+        std::chrono::milliseconds min_polling_interval() const
+        {
+            return m_min_polling_interval;
+        }
+
+        /// <summary>
+        /// Sets the time to wait before polling again after the first empty response.
+        /// </summary>
+        /// <param name="value">The minimum polling interval.</param>
+        void set_min_polling_interval(std::chrono::milliseconds value)
+        {
+            m_min_polling_interval = value;
+        }
+
+        /// <summary>
+        /// Gets the longest time to wait before polling an empty queue again.
+        /// </summary>
+        /// <returns>The maximum polling interval.</returns>
+        std::chrono::milliseconds max_polling_interval() const
+        {
+            return m_max_polling_interval;
+        }
+
+        /// <summary>
+        /// Sets the longest time to wait before polling an empty queue again, which is the most latency added when messages arrive.
+        /// </summary>
+        /// <param name="value">The maximum polling interval.</param>
+        void set_max_polling_interval(std::chrono::milliseconds value)
+        {
+            m_max_polling_interval = value;
+        }
+
+        /// <summary>
+        /// Gets whether the visibility timeout of each poll is picked from the time recent handlers have taken.
+        /// </summary>
+        /// <returns><c>true</c> if the visibility timeout is adaptive.</returns>
+        bool adaptive_visibility_timeout() const
+        {
+            return m_adaptive_visibility_timeout;
+        }
+
+        /// <summary>
+        /// Sets whether the visibility timeout of each poll is picked from the time recent handlers have taken.
+        /// </summary>
+        /// <param name="value"><c>true</c> to make the visibility timeout adaptive.</param>
+        /// <remarks>The pump keeps the processing times of the most recent messages that were handled successfully, and each poll
+        /// sets the visibility percentile of them, rounded up to a second, plus the visibility margin. The visibility timeout of the
+        /// pump is used until enough messages have been handled. A handler that runs longer than the timeout of its poll has its
+        /// message renewed once a third of the timeout is left, so only the outliers cost extra requests, while a message whose handler
+        /// failed becomes visible again soon.</remarks>
+        void set_adaptive_visibility_timeout(bool value)
+        {
+            m_adaptive_visibility_timeout = value;
+        }
+
+        /// <summary>
+        /// Gets the share of recent handlers that an adaptive visibility timeout is long enough for.
+        /// </summary>
+        /// <returns>The percentile, between 0 and 1.</returns>
+        double visibility_percentile() const
+        {
+            return m_visibility_percentile;
+        }
+
+        /// <summary>
+        /// Sets the share of recent handlers that an adaptive visibility timeout is long enough for.
+        /// </summary>
+        /// <param name="value">The percentile, which must be greater than 0 and at most 1.</param>
+        void set_visibility_percentile(double value)
+        {
+            m_visibility_percentile = value;
+        }
+
+        /// <summary>
+        /// Gets the time added to the percentile of the processing times to make an adaptive visibility timeout.
+        /// </summary>
+        /// <returns>The visibility margin.</returns>
+        std::chrono::seconds visibility_margin() const
+        {
+            return m_visibility_margin;
+        }
+
+        /// <summary>
+        /// Sets the time added to the percentile of the processing times to make an adaptive visibility timeout.
+        /// </summary>
+        /// <param name="value">The visibility margin, which cannot be negative.</param>
+        void set_visibility_margin(std::chrono::seconds value)
+        {
+            m_visibility_margin = value;
+        }
+
+    private:
+
+        struct shared_state;
+
+        queue_message_pump(const queue_message_pump&);
+        queue_message_pump& operator=(const queue_message_pump&);
+
+        cloud_queue m_queue;
+        handler_type m_handler;
+        queue_request_options m_options;
+        operation_context m_context;
+        std::chrono::seconds m_visibility_timeout;
+        int m_max_concurrent_handlers;
+        std::chrono::milliseconds m_min_polling_interval;
+        std::chrono::milliseconds m_max_polling_interval;
+        bool m_adaptive_visibility_timeout;
+        double m_visibility_percentile;
+        std::chrono::seconds m_visibility_margin;
+
+        std::shared_ptr<shared_state> m_state;
+        pplx::task<void> m_run_task;
+    };
+
+    /// <summary>
+    /// Keeps messages invisible to other consumers while they are being processed, by extending their visibility timeout before it expires.
+    /// </summary>
+    /// <remarks>
+    /// Every tracked message is renewed once a third of its visibility timeout is left. All messages share a single timer, which passes
+    /// over a wheel of one-second slots and renews the messages in a slot together, so tracking a message does not start a task of its own.
+    /// A message stops being renewed when it is deleted or released through the lease keeper, or when a renewal fails, for example
+    /// because the message has been deleted by someone else.
+    /// </remarks>
+    class queue_message_lease_keeper
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_lease_keeper" /> class.
+        /// </summary>
+        /// <param name="queue">The queue the messages belong to.</param>
+        /// <param name="visibility_timeout">The visibility timeout each renewal sets, which must be at least 3 seconds.</param>
+        queue_message_lease_keeper(const cloud_queue& queue, std::chrono::seconds visibility_timeout)
+        {
+            initialize(queue, visibility_timeout, queue_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_lease_keeper" /> class.
+        /// </summary>
+        /// <param name="queue">The queue the messages belong to.</param>
+        /// <param name="visibility_timeout">The visibility timeout each renewal sets, which must be at least 3 seconds.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        queue_message_lease_keeper(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+        {
+            initialize(queue, visibility_timeout, options, context);
+        }
+
+        /// <summary>
+        /// Stops renewing all tracked messages, which become visible again when their visibility timeout expires.
+        /// </summary>
+        WASTORAGE_API ~queue_message_lease_keeper();
+
+        /// <summary>
+        /// Starts renewing the visibility timeout of a message that has been retrieved from the queue.
+        /// </summary>
+        /// <param name="message">The message, which is renewed shortly before its next visible time.</param>
+        WASTORAGE_API void track(const cloud_queue_message& message);
+
+        /// <summary>
+        /// Stops renewing a message, which becomes visible again when its visibility timeout expires.
+        /// </summary>
+        /// <param name="message_id">The ID of the message.</param>
+        WASTORAGE_API void release(const utility::string_t& message_id);
+
+        /// <summary>
+        /// Gets whether a message is being renewed.
+        /// </summary>
+        /// <param name="message_id">The ID of the message.</param>
+        /// <returns><c>true</c> if the message is being renewed.</returns>
+        WASTORAGE_API bool is_tracked(const utility::string_t& message_id) const;
+
+        /// <summary>
+        /// Gets the number of messages that are being renewed.
+        /// </summary>
+        /// <returns>The number of tracked messages.</returns>
+        WASTORAGE_API size_t tracked_count() const;
+
+        /// <summary>
+        /// Gets a tracked message with the pop receipt and next visible time of its latest renewal.
+        /// </summary>
+        /// <param name="message_id">The ID of the message.</param>
+        /// <returns>A <see cref="wa::storage::cloud_queue_message" /> object, which has an empty ID if the message is not tracked.</returns>
+        WASTORAGE_API cloud_queue_message get_message(const utility::string_t& message_id) const;
+
+        /// <summary>
+        /// Stops renewing a message and deletes it from the queue with the pop receipt of its latest renewal.
+        /// </summary>
+        /// <param name="message_id">The ID of the message.</param>
+        void delete_message(const utility::string_t& message_id)
+        {
+            delete_message_async(message_id).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that stops renewing a message and deletes it from the queue with the pop receipt of its latest renewal.
+        /// A renewal that is in progress is waited for first.
+        /// </summary>
+        /// <param name="message_id">The ID of the message.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> delete_message_async(const utility::string_t& message_id);
+
+    private:
+
+        struct shared_state;
+
+        queue_message_lease_keeper(const queue_message_lease_keeper&);
+        queue_message_lease_keeper& operator=(const queue_message_lease_keeper&);
+
+        WASTORAGE_API void initialize(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+    /// <summary>
+    /// Represents a message that a <see cref="wa::storage::queue_message_deleter"/> could not delete.
+    /// </summary>
+    class queue_delete_failure
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_delete_failure" /> class.
+        /// </summary>
+        /// <param name="message">The message that could not be deleted.</param>
+        /// <param name="error">The exception the delete failed with.</param>
+        queue_delete_failure(cloud_queue_message message, std::exception_ptr error)
+            : m_message(std::move(message)), m_error(std::move(error))
+        {
+        }
+
+        /// <summary>
+        /// Gets the message that could not be deleted.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::cloud_queue_message"/> object.</returns>
+        const cloud_queue_message& message() const
+        {
+            return m_message;
+        }
+
+        /// <summary>
+        /// Gets the exception the delete failed with, which is usually a <see cref="wa::storage::storage_exception"/>,
+        /// for example because the pop receipt is no longer valid.
+        /// </summary>
+        /// <returns>A pointer to the exception, which can be rethrown with std::rethrow_exception.</returns>
+        std::exception_ptr error() const
+        {
+            return m_error;
+        }
+
+    private:
+
+        cloud_queue_message m_message;
+        std::exception_ptr m_error;
+    };
+
+    /// <summary>
+    /// Deletes processed messages from a queue in the background, with a bounded number of deletes in flight.
+    /// </summary>
+    /// <remarks>
+    /// Adding a message only waits while the maximum number of deletes is in flight, so consumers can go on getting messages.
+    /// The messages that could not be deleted are collected and returned by the next flush.
+    /// </remarks>
+    class queue_message_deleter
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_deleter" /> class.
+        /// </summary>
+        /// <param name="queue">The queue to delete messages from.</param>
+        explicit queue_message_deleter(const cloud_queue& queue)
+        {
+            initialize(queue, protocol::default_max_concurrent_message_deletes, queue_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_message_deleter" /> class.
+        /// </summary>
+        /// <param name="queue">The queue to delete messages from.</param>
+        /// <param name="max_concurrent_deletes">The maximum number of deletes in flight, which must be at least 1.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        queue_message_deleter(const cloud_queue& queue, int max_concurrent_deletes, const queue_request_options& options, operation_context context)
+        {
+            initialize(queue, max_concurrent_deletes, options, context);
+        }
+
+        /// <summary>
+        /// Adds a message to be deleted.
+        /// </summary>
+        /// <param name="message">The message, with the pop receipt of the get or update that returned it last.</param>
+        void add(const cloud_queue_message& message)
+        {
+            add_async(message).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that adds a message to be deleted.
+        /// </summary>
+        /// <param name="message">The message, with the pop receipt of the get or update that returned it last.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once the delete has been sent, which is delayed while the maximum
+        /// number of deletes are in flight.</returns>
+        WASTORAGE_API pplx::task<void> add_async(const cloud_queue_message& message);
+
+        /// <summary>
+        /// Waits until every message that has been added is deleted.
+        /// </summary>
+        /// <returns>The messages that could not be deleted since the previous flush.</returns>
+        std::vector<queue_delete_failure> flush()
+        {
+            return flush_async().get();
+        }
+
+        /// <summary>
+        /// Returns a task that waits until every message that has been added is deleted.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that completes with the messages that could not be deleted since the previous flush.</returns>
+        WASTORAGE_API pplx::task<std::vector<queue_delete_failure>> flush_async();
+
+    private:
+
+        struct shared_state;
+
+        WASTORAGE_API void initialize(const cloud_queue& queue, int max_concurrent_deletes, const queue_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+    /// <summary>
+    /// Represents the messages a <see cref="wa::storage::sharded_queue"/> got from one of its queues.
+    /// </summary>
+    class sharded_queue_result
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_queue_result" /> class.
+        /// </summary>
+        /// <param name="queue">The queue the messages were got from.</param>
+        /// <param name="messages">The messages.</param>
+        sharded_queue_result(cloud_queue queue, std::vector<cloud_queue_message> messages)
+            : m_queue(std::move(queue)), m_messages(std::move(messages))
+        {
+        }
+
+        /// <summary>
+        /// Gets the queue the messages were got from, which has to be used to update or delete them.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::cloud_queue"/> object.</returns>
+        const cloud_queue& queue() const
+        {
+            return m_queue;
+        }
+
+        /// <summary>
+        /// Gets the messages, which are empty if none of the queues had a message.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_queue_message"/> objects.</returns>
+        const std::vector<cloud_queue_message>& messages() const
+        {
+            return m_messages;
+        }
+
+    private:
+
+        cloud_queue m_queue;
+        std::vector<cloud_queue_message> m_messages;
+    };
+
+    /// <summary>
+    /// Spreads messages over several queues, so that the throughput is not limited to what a single queue supports.
+    /// </summary>
+    /// <remarks>
+    /// Messages are added to the queues in turn, or to the queue chosen by a key, which keeps the messages with the same key in the same
+    /// queue. When messages are got, a queue is chosen at random, weighted by how often each queue has had messages recently, and the
+    /// other queues are tried in turn while the chosen one is empty. Copies of a sharded queue share these statistics.
+    /// Queues created from the same service client share its connections.
+    /// </remarks>
+    class sharded_queue
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_queue" /> class.
+        /// </summary>
+        /// <param name="shards">The queues to spread the messages over. The order must be the same for every producer that adds messages by key.</param>
+        WASTORAGE_API explicit sharded_queue(std::vector<cloud_queue> shards);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_queue" /> class over the queues named by the prefix and the numbers
+        /// from 0 to shard_count - 1.
+        /// </summary>
+        /// <param name="client">The service client of the queues.</param>
+        /// <param name="name_prefix">The start of the queue names, for example "orders-" for the queues "orders-0", "orders-1" and so on.</param>
+        /// <param name="shard_count">The number of queues, which must be at least 1.</param>
+        WASTORAGE_API sharded_queue(const cloud_queue_client& client, const utility::string_t& name_prefix, size_t shard_count);
+
+        /// <summary>
+        /// Gets the queues the messages are spread over.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_queue"/> objects.</returns>
+        WASTORAGE_API const std::vector<cloud_queue>& shards() const;
+
+        /// <summary>
+        /// Gets the position of the queue that messages added with a key go to. It does not change between processes or platforms.
+        /// </summary>
+        /// <param name="key">The key.</param>
+        /// <returns>The index of the queue in <see cref="wa::storage::sharded_queue::shards"/>.</returns>
+        WASTORAGE_API size_t get_shard_index(const utility::string_t& key) const;
+
+        /// <summary>
+        /// Creates each of the queues if it does not exist.
+        /// </summary>
+        void create_if_not_exists()
+        {
+            create_if_not_exists_async(queue_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that creates each of the queues if it does not exist.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> create_if_not_exists_async(const queue_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Deletes each of the queues if it exists.
+        /// </summary>
+        void delete_if_exists()
+        {
+            delete_if_exists_async(queue_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that deletes each of the queues if it exists.
+        /// </summary>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> delete_if_exists_async(const queue_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Adds a message to the next queue in turn.
+        /// </summary>
+        /// <param name="message">The message to add.</param>
+        void add_message(cloud_queue_message& message)
+        {
+            add_message_async(message, std::chrono::seconds(604800LL), std::chrono::seconds(0LL), queue_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that adds a message to the next queue in turn.
+        /// </summary>
+        /// <param name="message">The message to add.</param>
+        /// <param name="time_to_live">The maximum time to allow the message to be in the queue.</param>
+        /// <param name="initial_visibility_timeout">The length of time from now during which the message will be invisible.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> add_message_async(cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, const queue_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Adds a message to the queue chosen by a key.
+        /// </summary>
+        /// <param name="key">The key, for example the ID of the entity the message is about.</param>
+        /// <param name="message">The message to add.</param>
+        void add_message(const utility::string_t& key, cloud_queue_message& message)
+        {
+            add_message_async(key, message, std::chrono::seconds(604800LL), std::chrono::seconds(0LL), queue_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that adds a message to the queue chosen by a key.
+        /// </summary>
+        /// <param name="key">The key, for example the ID of the entity the message is about.</param>
+        /// <param name="message">The message to add.</param>
+        /// <param name="time_to_live">The maximum time to allow the message to be in the queue.</param>
+        /// <param name="initial_visibility_timeout">The length of time from now during which the message will be invisible.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> add_message_async(const utility::string_t& key, cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, const queue_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Gets messages from one of the queues.
+        /// </summary>
+        /// <param name="message_count">The number of messages to get, which cannot be greater than 32.</param>
+        /// <returns>A <see cref="wa::storage::sharded_queue_result" /> object with the messages and the queue they belong to.</returns>
+        sharded_queue_result get_messages(size_t message_count)
+        {
+            return get_messages_async(message_count, std::chrono::seconds(0LL), queue_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Returns a task that gets messages from one of the queues.
+        /// </summary>
+        /// <param name="message_count">The number of messages to get, which cannot be greater than 32.</param>
+        /// <param name="visibility_timeout">The time interval for which the messages are invisible to other consumers, or 0 for the default of the service.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::sharded_queue_result" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<sharded_queue_result> get_messages_async(size_t message_count, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context);
+
+    private:
+
+        struct shared_state;
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+    /// <summary>
+    /// Represents the latest depth of a queue that a <see cref="wa::storage::queue_depth_monitor"/> tracks.
+    /// </summary>
+    class queue_depth_snapshot
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_depth_snapshot" /> class.
+        /// </summary>
+        queue_depth_snapshot()
+            : m_approximate_message_count(-1), m_previous_message_count(-1), m_refresh_interval(0)
+        {
+        }
+
+        /// <summary>
+        /// Gets the URI of the queue.
+        /// </summary>
+        /// <returns>The primary URI of the queue.</returns>
+        const web::http::uri& queue_uri() const
+        {
+            return m_queue_uri;
+        }
+
+        /// <summary>
+        /// Gets the approximate number of messages in the queue at the latest successful refresh.
+        /// </summary>
+        /// <returns>The approximate number of messages, or -1 if the queue has not been refreshed yet.</returns>
+        int approximate_message_count() const
+        {
+            return m_approximate_message_count;
+        }
+
+        /// <summary>
+        /// Gets the approximate number of messages in the queue at the successful refresh before the latest one.
+        /// </summary>
+        /// <returns>The approximate number of messages, or -1 if the queue has been refreshed at most once.</returns>
+        int previous_message_count() const
+        {
+            return m_previous_message_count;
+        }
+
+        /// <summary>
+        /// Gets the time of the latest successful refresh.
+        /// </summary>
+        /// <returns>The time, which is not initialized if the queue has not been refreshed yet.</returns>
+        utility::datetime refreshed_time() const
+        {
+            return m_refreshed_time;
+        }
+
+        /// <summary>
+        /// Gets the time until the next refresh, which is shorter while the depth is changing.
+        /// </summary>
+        /// <returns>The refresh interval.</returns>
+        std::chrono::milliseconds refresh_interval() const
+        {
+            return m_refresh_interval;
+        }
+
+        /// <summary>
+        /// Gets the exception the latest refresh failed with, if it failed. The depth is left as it was before.
+        /// </summary>
+        /// <returns>A pointer to the exception, which is null if the latest refresh succeeded.</returns>
+        std::exception_ptr error() const
+        {
+            return m_error;
+        }
+
+    private:
+
+        web::http::uri m_queue_uri;
+        int m_approximate_message_count;
+        int m_previous_message_count;
+        utility::datetime m_refreshed_time;
+        std::chrono::milliseconds m_refresh_interval;
+        std::exception_ptr m_error;
+
+        friend class queue_depth_monitor;
+    };
+
+    /// <summary>
+    /// Keeps the approximate message counts of a set of queues up to date, refreshing their attributes in the background
+    /// with a bounded number of requests in flight.
+    /// </summary>
+    /// <remarks>
+    /// A queue whose depth changed at its last refresh is refreshed again after the minimum interval. Every refresh that finds
+    /// the same depth doubles the interval, up to the maximum, so queues that are idle cost few requests. All queues share a
+    /// single timer. The change callback is called, outside of any lock, whenever a refresh finds a depth that differs from the
+    /// previous one, including the first refresh of a queue.
+    /// </remarks>
+    class queue_depth_monitor
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_depth_monitor" /> class.
+        /// </summary>
+        queue_depth_monitor()
+        {
+            initialize(protocol::default_max_concurrent_depth_refreshes, protocol::default_min_depth_refresh_interval, protocol::default_max_depth_refresh_interval, queue_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_depth_monitor" /> class.
+        /// </summary>
+        /// <param name="max_concurrent_refreshes">The maximum number of refreshes in flight, which must be at least 1.</param>
+        /// <param name="min_refresh_interval">The interval between the refreshes of a queue whose depth is changing, which must be at least 100 milliseconds.</param>
+        /// <param name="max_refresh_interval">The interval between the refreshes of a queue whose depth is not changing, which cannot be less than the minimum.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        queue_depth_monitor(int max_concurrent_refreshes, std::chrono::milliseconds min_refresh_interval, std::chrono::milliseconds max_refresh_interval, const queue_request_options& options, operation_context context)
+        {
+            initialize(max_concurrent_refreshes, min_refresh_interval, max_refresh_interval, options, context);
+        }
+
+        /// <summary>
+        /// Stops refreshing all tracked queues. Refreshes in flight complete, but do not call the change callback.
+        /// </summary>
+        WASTORAGE_API ~queue_depth_monitor();
+
+        /// <summary>
+        /// Starts refreshing the depth of a queue. The first refresh is sent right away.
+        /// </summary>
+        /// <param name="queue">The queue, which is tracked by its primary URI.</param>
+        WASTORAGE_API void track(const cloud_queue& queue);
+
+        /// <summary>
+        /// Stops refreshing the depth of a queue.
+        /// </summary>
+        /// <param name="queue">The queue.</param>
+        WASTORAGE_API void untrack(const cloud_queue& queue);
+
+        /// <summary>
+        /// Gets whether the depth of a queue is being refreshed.
+        /// </summary>
+        /// <param name="queue">The queue.</param>
+        /// <returns><c>true</c> if the queue is tracked.</returns>
+        WASTORAGE_API bool is_tracked(const cloud_queue& queue) const;
+
+        /// <summary>
+        /// Gets the number of queues whose depth is being refreshed.
+        /// </summary>
+        /// <returns>The number of tracked queues.</returns>
+        WASTORAGE_API size_t tracked_count() const;
+
+        /// <summary>
+        /// Gets the latest depth of a tracked queue.
+        /// </summary>
+        /// <param name="queue">The queue.</param>
+        /// <returns>A <see cref="wa::storage::queue_depth_snapshot" /> object, which has an empty URI if the queue is not tracked.</returns>
+        WASTORAGE_API queue_depth_snapshot get_snapshot(const cloud_queue& queue) const;
+
+        /// <summary>
+        /// Gets the latest depth of every tracked queue.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::queue_depth_snapshot"/> objects.</returns>
+        WASTORAGE_API std::vector<queue_depth_snapshot> snapshots() const;
+
+        /// <summary>
+        /// Sets the function that is called with the new snapshot of a queue whenever its depth changes.
+        /// </summary>
+        /// <param name="callback">The function, which is called from the thread of the refresh that found the change.</param>
+        WASTORAGE_API void set_change_callback(std::function<void (const queue_depth_snapshot&)> callback);
+
+        /// <summary>
+        /// Refreshes every tracked queue right away.
+        /// </summary>
+        void refresh()
+        {
+            refresh_async().wait();
+        }
+
+        /// <summary>
+        /// Returns a task that refreshes every tracked queue right away. Queues with a refresh in flight wait for it instead.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that completes once every tracked queue has been refreshed.</returns>
+        WASTORAGE_API pplx::task<void> refresh_async();
+
+    private:
+
+        struct shared_state;
+
+        queue_depth_monitor(const queue_depth_monitor&);
+        queue_depth_monitor& operator=(const queue_depth_monitor&);
+
+        WASTORAGE_API void initialize(int max_concurrent_refreshes, std::chrono::milliseconds min_refresh_interval, std::chrono::milliseconds max_refresh_interval, const queue_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
+    /// <summary>
+    /// Sends messages of any size through a queue, by uploading the content of a large message to a blob and adding a small reference
+    /// to it to the queue instead, which is known as the claim-check pattern.
+    /// </summary>
+    /// <remarks>
+    /// Content up to the threshold is added to the queue as it is. Larger content is uploaded as a block blob with a unique name to the
+    /// container, with the parallelism of the blob request options, and the message holds a three-byte header followed by the name of the
+    /// blob. Consumers read the content of either kind of message as a stream, and deleting a message through the claim check deletes
+    /// its blob as well.
+    /// </remarks>
+    class queue_claim_check
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_claim_check" /> class.
+        /// </summary>
+        /// <param name="queue">The queue the messages are added to.</param>
+        /// <param name="container">The container the content of large messages is uploaded to, which must exist.</param>
+        queue_claim_check(const cloud_queue& queue, const cloud_blob_container& container)
+        {
+            blob_request_options options;
+            options.set_stream_prefetch_depth(protocol::default_claim_check_prefetch_depth);
+            initialize(queue, container, protocol::max_packed_queue_message_size, options);
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::queue_claim_check" /> class.
+        /// </summary>
+        /// <param name="queue">The queue the messages are added to.</param>
+        /// <param name="container">The container the content of large messages is uploaded to, which must exist.</param>
+        /// <param name="threshold">The largest content, in bytes, that is added to the queue as it is, which cannot be greater than 48 KB.</param>
+        /// <param name="blob_options">A <see cref="wa::storage::blob_request_options" /> object that specifies the options for uploading, reading and deleting the blobs,
+        /// such as the parallelism of uploads and the prefetch depth of reads.</param>
+        queue_claim_check(const cloud_queue& queue, const cloud_blob_container& container, size_t threshold, const blob_request_options& blob_options)
+        {
+            initialize(queue, container, threshold, blob_options);
+        }
+
+        /// <summary>
+        /// Gets the largest content that is added to the queue as it is.
+        /// </summary>
+        /// <returns>The threshold, in bytes.</returns>
+        WASTORAGE_API size_t threshold() const;
+
+        /// <summary>
+        /// Gets whether a message holds a reference to a blob rather than its content.
+        /// </summary>
+        /// <param name="message">The message that was retrieved from the queue.</param>
+        /// <returns><c>true</c> if the content of the message is in a blob.</returns>
+        WASTORAGE_API static bool is_claim_check(const cloud_queue_message& message);
+
+        /// <summary>
+        /// Adds a message with the given content to the queue.
+        /// </summary>
+        /// <param name="content">The content of the message.</param>
+        void add_message(const std::vector<uint8_t>& content)
+        {
+            add_message_async(content, std::chrono::seconds(604800LL), std::chrono::seconds(0LL), queue_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that adds a message with the given content to the queue, uploading the content to a blob first if it is larger than the threshold.
+        /// </summary>
+        /// <param name="content">The content of the message.</param>
+        /// <param name="time_to_live">The maximum time to allow the message to be in the queue.</param>
+        /// <param name="initial_visibility_timeout">The length of time from now during which the message will be invisible.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation. If the message cannot be added, the blob is deleted again.</returns>
+        WASTORAGE_API pplx::task<void> add_message_async(const std::vector<uint8_t>& content, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, const queue_request_options& options, operation_context context);
+
+        /// <summary>
+        /// Opens a stream over the content of a message.
+        /// </summary>
+        /// <param name="message">The message that was retrieved from the queue.</param>
+        /// <returns>A stream over the content of the message.</returns>
+        concurrency::streams::istream open_content(const cloud_queue_message& message)
+        {
+            return open_content_async(message, operation_context()).get();
+        }
+
+        /// <summary>
+        /// Returns a task that opens a stream over the content of a message. The content of a claim check is read from its blob as the stream is read.
+        /// </summary>
+        /// <param name="message">The message that was retrieved from the queue.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="concurrency::streams::istream" /> that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<concurrency::streams::istream> open_content_async(const cloud_queue_message& message, operation_context context);
+
+        /// <summary>
+        /// Deletes a message from the queue, and its blob if it is a claim check.
+        /// </summary>
+        /// <param name="message">The message, with the pop receipt of the get or update that returned it last.</param>
+        void delete_message(cloud_queue_message& message)
+        {
+            delete_message_async(message, queue_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that deletes a message from the queue, and then its blob if it is a claim check.
+        /// </summary>
+        /// <param name="message">The message, with the pop receipt of the get or update that returned it last.</param>
+        /// <param name="options">A <see cref="wa::storage::queue_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> delete_message_async(cloud_queue_message& message, const queue_request_options& options, operation_context context);
+
+    private:
+
+        struct shared_state;
+
+        WASTORAGE_API void initialize(const cloud_queue& queue, const cloud_blob_container& container, size_t threshold, const blob_request_options& blob_options);
+
+        std::shared_ptr<shared_state> m_state;
+    };
 
 }} // namespace wa::storage
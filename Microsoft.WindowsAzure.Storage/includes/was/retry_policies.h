@@ -179,7 +179,8 @@ namespace wa { namespace storage {
         /// <param name="max_attempts">The maximum number of retries to attempt.</param>
         basic_exponential_retry_policy(std::chrono::seconds delta_backoff, int max_attempts)
             : basic_common_retry_policy(max_attempts), m_delta_backoff(delta_backoff),
-            m_rand_distribution(delta_backoff.count() * 0.8, delta_backoff.count() * 1.2)
+            m_rand_distribution(delta_backoff.count() * 0.8, delta_backoff.count() * 1.2),
+            m_rand_engine(std::random_device()())
         {
         }
 
@@ -227,4 +228,69 @@ namespace wa { namespace storage {
         }
     };
 
+    /// <summary>
+    /// Represents an exponential retry policy with decorrelated jitter.
+    /// </summary>
+    /// <remarks>Each retry waits a random time between the delta backoff and three times the previous wait, up to the
+    /// maximum exponential retry interval. The waits of clients that failed at the same time quickly drift apart, so
+    /// their retries do not reach the service in waves.</remarks>
+    class basic_decorrelated_jitter_retry_policy : public basic_common_retry_policy
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="basic_decorrelated_jitter_retry_policy"/> class.
+        /// </summary>
+        /// <param name="delta_backoff">The shortest wait before a retry.</param>
+        /// <param name="max_attempts">The maximum number of retries to attempt.</param>
+        basic_decorrelated_jitter_retry_policy(std::chrono::seconds delta_backoff, int max_attempts)
+            : basic_common_retry_policy(max_attempts), m_delta_backoff(delta_backoff), m_last_interval(delta_backoff),
+            m_rand_engine(std::random_device()())
+        {
+        }
+
+        WASTORAGE_API retry_info evaluate(const retry_context& retry_context, operation_context context) override;
+
+        /// <summary>
+        /// Clones the retry policy.
+        /// </summary>
+        /// <returns>A cloned <see cref="retry_policy" />.</returns>
+        retry_policy clone() const override
+        {
+            return retry_policy(std::make_shared<basic_decorrelated_jitter_retry_policy>(m_delta_backoff, m_max_attempts));
+        }
+
+    private:
+
+        std::chrono::seconds m_delta_backoff;
+        std::chrono::milliseconds m_last_interval;
+        std::default_random_engine m_rand_engine;
+    };
+
+    /// <summary>
+    /// Represents an exponential retry policy with decorrelated jitter.
+    /// </summary>
+    class decorrelated_jitter_retry_policy : public retry_policy
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="decorrelated_jitter_retry_policy"/> class.
+        /// </summary>
+        decorrelated_jitter_retry_policy()
+            : retry_policy(std::make_shared<basic_decorrelated_jitter_retry_policy>(protocol::default_retry_interval, default_attempts))
+        {
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="decorrelated_jitter_retry_policy"/> class.
+        /// </summary>
+        /// <param name="delta_backoff">The shortest wait before a retry.</param>
+        /// <param name="max_attempts">The maximum number of retries to attempt.</param>
+        decorrelated_jitter_retry_policy(std::chrono::seconds delta_backoff, int max_attempts)
+            : retry_policy(std::make_shared<basic_decorrelated_jitter_retry_policy>(delta_backoff, max_attempts))
+        {
+        }
+    };
+
 }} // namespace wa::storage
@@ -75,6 +75,251 @@ namespace wa { namespace storage {
             return m_authentication_handler;
         }
 
+        /// <summary>
+        /// Gets the settings used to pool and reuse HTTP connections for requests made by the service client.
+        /// </summary>
+        /// <returns>A <see cref="connection_pool_settings" /> object.</returns>
+        WASTORAGE_API wa::storage::connection_pool_settings connection_pool_settings() const;
+
+        /// <summary>
+        /// Sets the settings used to pool and reuse HTTP connections for requests made by the service client.
+        /// </summary>
+        /// <param name="value">A <see cref="connection_pool_settings" /> object.</param>
+        /// <remarks>The connection pool is shared by all copies of the service client and all objects created from it,
+        /// so the new settings apply to requests made through any of them.</remarks>
+        WASTORAGE_API void set_connection_pool_settings(const wa::storage::connection_pool_settings& value);
+
+        /// <summary>
+        /// Opens connections to the primary and secondary endpoints of the service and keeps them idle for the requests that follow.
+        /// </summary>
+        /// <param name="connections">The number of connections to open to each endpoint.</param>
+        /// <returns>The number of connections that were opened.</returns>
+        int warm_up(int connections)
+        {
+            return warm_up_async(connections).get();
+        }
+
+        /// <summary>
+        /// Returns a task that opens connections to the primary and secondary endpoints of the service and keeps them idle for the requests that follow.
+        /// </summary>
+        /// <param name="connections">The number of connections to open to each endpoint.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes with the number of connections that were opened.</returns>
+        /// <remarks>Opening a connection resolves the name of the host and completes the TCP and TLS handshakes, so the first
+        /// requests of a process do not pay for them. At most as many connections are kept as the connection pool settings
+        /// allow to be idle for each host. An endpoint that cannot be reached is skipped rather than failing the task.</remarks>
+        WASTORAGE_API pplx::task<int> warm_up_async(int connections) const;
+
+        /// <summary>
+        /// Gets the HTTP client pool used to send requests made by the service client.
+        /// </summary>
+        /// <returns>The HTTP client pool.</returns>
+        std::shared_ptr<core::http_client_pool> http_client_pool() const
+        {
+            return m_http_client_pool;
+        }
+
+        /// <summary>
+        /// Gets the health of the locations of the service, which requests in the adaptive location mode are routed by.
+        /// </summary>
+        /// <returns>The location selector.</returns>
+        std::shared_ptr<core::location_selector> location_selector() const
+        {
+            return m_location_selector;
+        }
+
+        /// <summary>
+        /// Gets the fraction of the operations made by the service client that may be retried once a burst of retries has used up the retry budget.
+        /// </summary>
+        /// <returns>The fraction of operations that may be retried, or 0 if retries are only limited by the retry policy.</returns>
+        WASTORAGE_API double retry_budget_ratio() const;
+
+        /// <summary>
+        /// Sets the fraction of the operations made by the service client that may be retried once a burst of retries has used up the retry budget.
+        /// </summary>
+        /// <param name="value">The fraction of operations that may be retried, or 0 to only limit retries by the retry policy.</param>
+        /// <remarks>The retry budget is shared by all copies of the service client and all objects created from it. Each operation
+        /// adds the fraction to the budget and each retry takes a whole one from it, so that when a location fails, the retries
+        /// do not multiply the load on it. A retry that the budget does not allow fails the operation.</remarks>
+        WASTORAGE_API void set_retry_budget_ratio(double value);
+
+        /// <summary>
+        /// Gets the retry budget that retries of operations made by the service client are withdrawn from.
+        /// </summary>
+        /// <returns>The retry budget.</returns>
+        std::shared_ptr<core::retry_budget> retry_budget() const
+        {
+            return m_retry_budget;
+        }
+
+        /// <summary>
+        /// Gets histograms of how long each phase of the requests made by the service client took, for each kind of request.
+        /// </summary>
+        /// <returns>The histograms, by the method of the requests followed by the resource type and component they address, such as <c>PUT block</c>.</returns>
+        /// <remarks>The histograms are shared by all copies of the service client and all objects created from it.</remarks>
+        WASTORAGE_API std::map<utility::string_t, request_latency_histograms> latency_histograms() const;
+
+        /// <summary>
+        /// Discards the histograms of how long each phase of the requests made by the service client took.
+        /// </summary>
+        WASTORAGE_API void reset_latency_histograms();
+
+        /// <summary>
+        /// Gets the sink that every request made by the service client is reported to.
+        /// </summary>
+        /// <returns>The metrics sink, or nullptr if requests are not reported.</returns>
+        WASTORAGE_API std::shared_ptr<wa::storage::metrics_sink> metrics_sink() const;
+
+        /// <summary>
+        /// Sets the sink that every request made by the service client is reported to.
+        /// </summary>
+        /// <param name="value">The metrics sink, such as a <see cref="histogram_metrics_sink" />, or nullptr to stop reporting requests.</param>
+        /// <remarks>The sink is shared by all copies of the service client and all objects created from it. It is called
+        /// once for each request, including each retry, after the request completes.</remarks>
+        WASTORAGE_API void set_metrics_sink(std::shared_ptr<wa::storage::metrics_sink> value);
+
+        /// <summary>
+        /// Gets the recorder that the phase timings of the requests made by the service client are aggregated by.
+        /// </summary>
+        /// <returns>The latency recorder.</returns>
+        std::shared_ptr<core::latency_recorder> latency_recorder() const
+        {
+            return m_latency_recorder;
+        }
+
+        /// <summary>
+        /// Gets the cache of the static parts of requests that the service client sends repeatedly.
+        /// </summary>
+        /// <returns>The prepared request cache.</returns>
+        std::shared_ptr<core::prepared_request_cache> prepared_requests() const
+        {
+            return m_prepared_requests;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether identical reads made by the service client at the same time are sent as a single request.
+        /// </summary>
+        /// <returns><c>true</c> if identical reads are coalesced; otherwise, <c>false</c>.</returns>
+        WASTORAGE_API bool request_coalescing() const;
+
+        /// <summary>
+        /// Sets a value indicating whether identical reads made by the service client at the same time are sent as a single request.
+        /// </summary>
+        /// <param name="value"><c>true</c> to coalesce identical reads; otherwise, <c>false</c>.</param>
+        /// <remarks>Coalescing is shared by all copies of the service client and all objects created from it. It applies to the
+        /// downloads of blobs and blob ranges, the downloads of blob attributes and the retrieves of table entities. A read that
+        /// starts while an identical one is in flight waits for it and receives a copy of its result instead of sending a request,
+        /// so only the operation context of the first read records the request. The body of a coalesced download is kept in memory
+        /// until it has been written to the stream of each read, so large blobs should be downloaded without coalescing.</remarks>
+        WASTORAGE_API void set_request_coalescing(bool value);
+
+        /// <summary>
+        /// Gets the coalescer that joins identical reads made by the service client at the same time.
+        /// </summary>
+        /// <returns>The request coalescer.</returns>
+        std::shared_ptr<core::request_coalescer> request_coalescer() const
+        {
+            return m_request_coalescer;
+        }
+
+        /// <summary>
+        /// Gets how long a container, queue or table that the service client confirmed to exist is remembered.
+        /// </summary>
+        /// <returns>The time to live of a confirmed resource, or 0 if confirmed resources are not remembered.</returns>
+        WASTORAGE_API std::chrono::seconds existence_cache_time_to_live() const;
+
+        /// <summary>
+        /// Sets how long a container, queue or table that the service client confirmed to exist is remembered.
+        /// </summary>
+        /// <param name="value">The time to live of a confirmed resource, or 0 to stop remembering confirmed resources.</param>
+        /// <remarks>The remembered resources are shared by all copies of the service client and all objects created from it.
+        /// A resource is confirmed when a request to create it if it does not exist succeeds, and until the time to live passes,
+        /// creating it if it does not exist again returns <c>false</c> without sending a request.
+        /// Deleting the resource, or any request that addresses it or lies under it failing with Not Found, forgets it. A resource
+        /// that is deleted by another client is not forgotten until then.</remarks>
+        WASTORAGE_API void set_existence_cache_time_to_live(std::chrono::seconds value);
+
+        /// <summary>
+        /// Gets the cache of the containers, queues and tables that the service client recently confirmed to exist.
+        /// </summary>
+        /// <returns>The existence cache.</returns>
+        std::shared_ptr<core::existence_cache> existence_cache() const
+        {
+            return m_existence_cache;
+        }
+
+        /// <summary>
+        /// Gets the maximum number of operations made by the service client that may be in flight at the same time.
+        /// </summary>
+        /// <returns>The maximum number of operations in flight, or 0 if operations are not dispatched and start right away.</returns>
+        WASTORAGE_API int max_concurrent_operations() const;
+
+        /// <summary>
+        /// Sets the maximum number of operations made by the service client that may be in flight at the same time.
+        /// </summary>
+        /// <param name="value">The maximum number of operations in flight, or 0 to start operations right away.</param>
+        /// <remarks>The limit is shared by all copies of the service client and all objects created from it. An operation over the limit
+        /// waits with the other operations of its <see cref="operation_context::dispatch_tag" /> until one in flight completes. Then the waiting
+        /// tag that has been dispatched the fewest operations for its weight, and that is below its own quota, starts its oldest operation,
+        /// so that a tag with a burst of operations cannot starve the others. Each operation is dispatched once, including its retries.</remarks>
+        WASTORAGE_API void set_max_concurrent_operations(int value);
+
+        /// <summary>
+        /// Gets the share of the operations in flight that the operations with a dispatch tag get.
+        /// </summary>
+        /// <param name="tag">The dispatch tag.</param>
+        /// <returns>A <see cref="dispatch_tag_settings" /> object.</returns>
+        WASTORAGE_API wa::storage::dispatch_tag_settings get_dispatch_tag_settings(const utility::string_t& tag) const;
+
+        /// <summary>
+        /// Sets the share of the operations in flight that the operations with a dispatch tag get.
+        /// </summary>
+        /// <param name="tag">The dispatch tag.</param>
+        /// <param name="value">A <see cref="dispatch_tag_settings" /> object.</param>
+        WASTORAGE_API void set_dispatch_tag_settings(const utility::string_t& tag, const wa::storage::dispatch_tag_settings& value);
+
+        /// <summary>
+        /// Gets how the operations made by the service client have waited until they were dispatched, for each dispatch tag.
+        /// </summary>
+        /// <returns>The statistics, by dispatch tag.</returns>
+        WASTORAGE_API std::map<utility::string_t, dispatch_tag_statistics> dispatch_statistics() const;
+
+        /// <summary>
+        /// Discards the histograms of how long the operations made by the service client waited until they were dispatched.
+        /// </summary>
+        WASTORAGE_API void reset_dispatch_statistics();
+
+        /// <summary>
+        /// Gets the dispatcher that the operations made by the service client wait in while the maximum number of operations is in flight.
+        /// </summary>
+        /// <returns>The operation dispatcher.</returns>
+        std::shared_ptr<core::operation_dispatcher> operation_dispatcher() const
+        {
+            return m_operation_dispatcher;
+        }
+
+        /// <summary>
+        /// Gets when the service client stops sending requests to a storage location that keeps failing.
+        /// </summary>
+        /// <returns>A <see cref="circuit_breaker_settings" /> object.</returns>
+        WASTORAGE_API wa::storage::circuit_breaker_settings circuit_breaker_settings() const;
+
+        /// <summary>
+        /// Sets when the service client stops sending requests to a storage location that keeps failing.
+        /// </summary>
+        /// <param name="value">A <see cref="circuit_breaker_settings" /> object.</param>
+        /// <remarks>The circuits are kept for each account and location, and are shared by all copies of the service client
+        /// and all objects created from it.</remarks>
+        WASTORAGE_API void set_circuit_breaker_settings(const wa::storage::circuit_breaker_settings& value);
+
+        /// <summary>
+        /// Gets the circuit breaker that decides whether the requests made by the service client may be sent to a location.
+        /// </summary>
+        /// <returns>The circuit breaker.</returns>
+        std::shared_ptr<core::circuit_breaker> circuit_breaker() const
+        {
+            return m_circuit_breaker;
+        }
+
     protected:
 
         /// <summary>
@@ -88,20 +333,20 @@ namespace wa { namespace storage {
         /// Initializes a new instance of the service client class using the specified service endpoint.
         /// </summary>
         /// <param name="base_uri">A <see cref="storage_uri" /> object containing the service endpoint for all locations.</param>
-        cloud_client(const storage_uri& base_uri)
-            : m_base_uri(base_uri)
-        {
-        }
+        WASTORAGE_API cloud_client(const storage_uri& base_uri);
 
         /// <summary>
         /// Initializes a new instance of the client class using the specified service endpoint and storage account credentials.
         /// </summary>
         /// <param name="base_uri">A <see cref="storage_uri" /> object containing the service endpoint for all locations.</param>
         /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_client(const storage_uri& base_uri, const wa::storage::storage_credentials& credentials)
-            : m_base_uri(base_uri), m_credentials(credentials)
-        {
-        }
+        WASTORAGE_API cloud_client(const storage_uri& base_uri, const wa::storage::storage_credentials& credentials);
+
+        /// <summary>
+        /// Sets the name of the service that the service client sends requests to, which the requests are reported under.
+        /// </summary>
+        /// <param name="value">The name of the service, such as <c>blob</c>.</param>
+        WASTORAGE_API void set_service_name(const utility::string_t& value);
 
         /// <summary>
         /// Sets the authentication handler to use to sign HTTP requests.
@@ -121,6 +366,15 @@ namespace wa { namespace storage {
         wa::storage::storage_credentials m_credentials;
         wa::storage::authentication_scheme m_authentication_scheme;
         std::shared_ptr<protocol::authentication_handler> m_authentication_handler;
+        std::shared_ptr<core::http_client_pool> m_http_client_pool;
+        std::shared_ptr<core::location_selector> m_location_selector;
+        std::shared_ptr<core::retry_budget> m_retry_budget;
+        std::shared_ptr<core::latency_recorder> m_latency_recorder;
+        std::shared_ptr<core::prepared_request_cache> m_prepared_requests;
+        std::shared_ptr<core::request_coalescer> m_request_coalescer;
+        std::shared_ptr<core::existence_cache> m_existence_cache;
+        std::shared_ptr<core::operation_dispatcher> m_operation_dispatcher;
+        std::shared_ptr<core::circuit_breaker> m_circuit_breaker;
     };
 
 }} // namespace wa::storage
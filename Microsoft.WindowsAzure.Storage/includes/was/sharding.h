@@ -0,0 +1,265 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="sharding.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <functional>
+
+#include "blob.h"
+#include "queue.h"
+#include "table.h"
+#include "storage_account.h"
+
+namespace wa { namespace storage {
+
+    /// <summary>
+    /// Chooses the shard that a key belongs to, from its key and the number of shards. It must return a number less than the number of shards,
+    /// and the same number for the same key in every process that shares the shards.
+    /// </summary>
+    typedef std::function<size_t (const utility::string_t& key, size_t shard_count)> shard_placement;
+
+    /// <summary>
+    /// Places a key by a consistent hash of its UTF-8 bytes, so that adding a shard at the end only moves the keys that the new shard takes over.
+    /// </summary>
+    /// <param name="key">The key, such as a blob name or a partition key.</param>
+    /// <param name="shard_count">The number of shards, which must be at least 1.</param>
+    /// <returns>The index of the shard, which does not change between processes or platforms.</returns>
+    WASTORAGE_API size_t consistent_hash_placement(const utility::string_t& key, size_t shard_count);
+
+    /// <summary>
+    /// Spreads blobs over several storage accounts, so that the throughput is not limited to what a single account supports.
+    /// </summary>
+    /// <remarks>
+    /// Each blob is kept in the account chosen by its name, in a container of the same name in every account. Every account has a service
+    /// client of its own, with its own connection pool. The order of the accounts must be the same for every process that shares them.
+    /// </remarks>
+    class sharded_blob_client
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_blob_client" /> class that places blobs by consistent hashing of their names.
+        /// </summary>
+        /// <param name="accounts">The storage accounts to spread the blobs over.</param>
+        WASTORAGE_API explicit sharded_blob_client(const std::vector<cloud_storage_account>& accounts);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_blob_client" /> class.
+        /// </summary>
+        /// <param name="accounts">The storage accounts to spread the blobs over.</param>
+        /// <param name="placement">The function that chooses the account of a blob from its name.</param>
+        /// <param name="default_request_options">The default <see cref="wa::storage::blob_request_options" /> of the service clients.</param>
+        WASTORAGE_API sharded_blob_client(const std::vector<cloud_storage_account>& accounts, shard_placement placement, const blob_request_options& default_request_options);
+
+        /// <summary>
+        /// Gets the service clients of the accounts, in the order of the accounts.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_blob_client"/> objects.</returns>
+        WASTORAGE_API const std::vector<cloud_blob_client>& shards() const;
+
+        /// <summary>
+        /// Gets the position of the account that a blob is kept in.
+        /// </summary>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>The index of the account in <see cref="wa::storage::sharded_blob_client::shards"/>.</returns>
+        WASTORAGE_API size_t get_shard_index(const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a block blob in the account chosen by its name.
+        /// </summary>
+        /// <param name="container_name">The name of the container.</param>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="wa::storage::cloud_block_blob" />.</returns>
+        WASTORAGE_API cloud_block_blob get_block_blob_reference(const utility::string_t& container_name, const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets a reference to a page blob in the account chosen by its name.
+        /// </summary>
+        /// <param name="container_name">The name of the container.</param>
+        /// <param name="blob_name">The name of the blob.</param>
+        /// <returns>A reference to a <see cref="wa::storage::cloud_page_blob" />.</returns>
+        WASTORAGE_API cloud_page_blob get_page_blob_reference(const utility::string_t& container_name, const utility::string_t& blob_name) const;
+
+        /// <summary>
+        /// Gets references to the container of the same name in every account.
+        /// </summary>
+        /// <param name="container_name">The name of the container.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_blob_container"/> objects, in the order of the accounts.</returns>
+        WASTORAGE_API std::vector<cloud_blob_container> get_container_references(const utility::string_t& container_name) const;
+
+        /// <summary>
+        /// Creates the container in every account if it does not exist.
+        /// </summary>
+        /// <param name="container_name">The name of the container.</param>
+        void create_containers_if_not_exist(const utility::string_t& container_name) const
+        {
+            create_containers_if_not_exist_async(container_name, blob_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that creates the container in every account if it does not exist.
+        /// </summary>
+        /// <param name="container_name">The name of the container.</param>
+        /// <param name="options">A <see cref="wa::storage::blob_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> create_containers_if_not_exist_async(const utility::string_t& container_name, const blob_request_options& options, operation_context context) const;
+
+    private:
+
+        std::vector<cloud_blob_client> m_shards;
+        shard_placement m_placement;
+    };
+
+    /// <summary>
+    /// Spreads the partitions of tables over several storage accounts, so that the throughput is not limited to what a single account supports.
+    /// </summary>
+    /// <remarks>
+    /// Each partition is kept in the account chosen by its partition key, in a table of the same name in every account, so that batches and
+    /// queries within a partition still go to a single table. Every account has a service client of its own, with its own connection pool.
+    /// The order of the accounts must be the same for every process that shares them.
+    /// </remarks>
+    class sharded_table_client
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_table_client" /> class that places partitions by consistent hashing of their keys.
+        /// </summary>
+        /// <param name="accounts">The storage accounts to spread the partitions over.</param>
+        WASTORAGE_API explicit sharded_table_client(const std::vector<cloud_storage_account>& accounts);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_table_client" /> class.
+        /// </summary>
+        /// <param name="accounts">The storage accounts to spread the partitions over.</param>
+        /// <param name="placement">The function that chooses the account of a partition from its partition key.</param>
+        /// <param name="default_request_options">The default <see cref="wa::storage::table_request_options" /> of the service clients.</param>
+        WASTORAGE_API sharded_table_client(const std::vector<cloud_storage_account>& accounts, shard_placement placement, const table_request_options& default_request_options);
+
+        /// <summary>
+        /// Gets the service clients of the accounts, in the order of the accounts.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_table_client"/> objects.</returns>
+        WASTORAGE_API const std::vector<cloud_table_client>& shards() const;
+
+        /// <summary>
+        /// Gets the position of the account that a partition is kept in.
+        /// </summary>
+        /// <param name="partition_key">The partition key.</param>
+        /// <returns>The index of the account in <see cref="wa::storage::sharded_table_client::shards"/>.</returns>
+        WASTORAGE_API size_t get_shard_index(const utility::string_t& partition_key) const;
+
+        /// <summary>
+        /// Gets a reference to the table that holds a partition, in the account chosen by the partition key.
+        /// </summary>
+        /// <param name="table_name">The name of the table.</param>
+        /// <param name="partition_key">The partition key of the entities that the table is used for.</param>
+        /// <returns>A reference to a <see cref="wa::storage::cloud_table" />.</returns>
+        WASTORAGE_API cloud_table get_table_reference(const utility::string_t& table_name, const utility::string_t& partition_key) const;
+
+        /// <summary>
+        /// Gets references to the table of the same name in every account, such as to query across all partitions.
+        /// </summary>
+        /// <param name="table_name">The name of the table.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_table"/> objects, in the order of the accounts.</returns>
+        WASTORAGE_API std::vector<cloud_table> get_table_references(const utility::string_t& table_name) const;
+
+        /// <summary>
+        /// Creates the table in every account if it does not exist.
+        /// </summary>
+        /// <param name="table_name">The name of the table.</param>
+        void create_tables_if_not_exist(const utility::string_t& table_name) const
+        {
+            create_tables_if_not_exist_async(table_name, table_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that creates the table in every account if it does not exist.
+        /// </summary>
+        /// <param name="table_name">The name of the table.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<void> create_tables_if_not_exist_async(const utility::string_t& table_name, const table_request_options& options, operation_context context) const;
+
+    private:
+
+        std::vector<cloud_table_client> m_shards;
+        shard_placement m_placement;
+    };
+
+    /// <summary>
+    /// Spreads queues over several storage accounts, so that the throughput is not limited to what a single account supports.
+    /// </summary>
+    /// <remarks>
+    /// Each queue is kept in the account chosen by its name. A <see cref="wa::storage::sharded_queue"/> can also spread the messages of one
+    /// queue over the queues of the same name in every account. Every account has a service client of its own, with its own connection pool.
+    /// The order of the accounts must be the same for every process that shares them.
+    /// </remarks>
+    class sharded_queue_client
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_queue_client" /> class that places queues by consistent hashing of their names.
+        /// </summary>
+        /// <param name="accounts">The storage accounts to spread the queues over.</param>
+        WASTORAGE_API explicit sharded_queue_client(const std::vector<cloud_storage_account>& accounts);
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::sharded_queue_client" /> class.
+        /// </summary>
+        /// <param name="accounts">The storage accounts to spread the queues over.</param>
+        /// <param name="placement">The function that chooses the account of a queue from its name.</param>
+        /// <param name="default_request_options">The default <see cref="wa::storage::queue_request_options" /> of the service clients.</param>
+        WASTORAGE_API sharded_queue_client(const std::vector<cloud_storage_account>& accounts, shard_placement placement, const queue_request_options& default_request_options);
+
+        /// <summary>
+        /// Gets the service clients of the accounts, in the order of the accounts.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::cloud_queue_client"/> objects.</returns>
+        WASTORAGE_API const std::vector<cloud_queue_client>& shards() const;
+
+        /// <summary>
+        /// Gets the position of the account that a queue is kept in.
+        /// </summary>
+        /// <param name="queue_name">The name of the queue.</param>
+        /// <returns>The index of the account in <see cref="wa::storage::sharded_queue_client::shards"/>.</returns>
+        WASTORAGE_API size_t get_shard_index(const utility::string_t& queue_name) const;
+
+        /// <summary>
+        /// Gets a reference to a queue in the account chosen by its name.
+        /// </summary>
+        /// <param name="queue_name">The name of the queue.</param>
+        /// <returns>A reference to a <see cref="wa::storage::cloud_queue" />.</returns>
+        WASTORAGE_API cloud_queue get_queue_reference(const utility::string_t& queue_name) const;
+
+        /// <summary>
+        /// Gets a queue that spreads its messages over the queues of the same name in every account.
+        /// </summary>
+        /// <param name="queue_name">The name of the queues.</param>
+        /// <returns>A <see cref="wa::storage::sharded_queue" /> object.</returns>
+        WASTORAGE_API sharded_queue get_sharded_queue(const utility::string_t& queue_name) const;
+
+    private:
+
+        std::vector<cloud_queue_client> m_shards;
+        shard_placement m_placement;
+    };
+
+}} // namespace wa::storage
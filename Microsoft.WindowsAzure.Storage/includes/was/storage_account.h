@@ -147,6 +147,22 @@ namespace wa { namespace storage {
         /// <returns>A reference to the development storage account.</returns>
         WASTORAGE_API static cloud_storage_account development_storage_account();
 
+        /// <summary>
+        /// Indicates whether clients and shared access signatures that use the same account key share one signing key.
+        /// </summary>
+        /// <returns><c>true</c> if signing keys are shared; otherwise, <c>false</c>.</returns>
+        WASTORAGE_API static bool share_signing_keys();
+
+        /// <summary>
+        /// Sets whether clients and shared access signatures that use the same account key share one signing key.
+        /// </summary>
+        /// <param name="value"><c>true</c> to share signing keys; otherwise, <c>false</c>. The default is <c>false</c>.</param>
+        /// <remarks>
+        /// A shared signing key is prepared once and lives only as long as some client or shared access signature signs with it.
+        /// This setting applies to clients and shared access signatures created after it is changed.
+        /// </remarks>
+        WASTORAGE_API static void set_share_signing_keys(bool value);
+
         /// <summary>
         /// Gets the endpoint for the Blob service for all location.
         /// </summary>
@@ -196,9 +212,11 @@ namespace wa { namespace storage {
 
         WASTORAGE_API void initialize_default_endpoints(bool use_https);
         static cloud_storage_account get_development_storage_account(const web::http::uri& proxy_uri);
-        static cloud_storage_account parse_devstore_settings(std::map<utility::string_t, utility::string_t> settings);
-        static cloud_storage_account parse_defaults_settings(std::map<utility::string_t, utility::string_t> settings);
-        static cloud_storage_account parse_explicit_settings(std::map<utility::string_t, utility::string_t> settings);
+
+        struct connection_settings;
+        static cloud_storage_account parse_devstore_settings(const connection_settings& settings);
+        static cloud_storage_account parse_defaults_settings(const connection_settings& settings);
+        static cloud_storage_account parse_explicit_settings(const connection_settings& settings);
 
         bool m_initialized;
         bool m_default_endpoints;
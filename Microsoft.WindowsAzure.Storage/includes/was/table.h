@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <cstring>
+#include <unordered_set>
+
 #include "service_client.h"
 
 namespace wa { namespace storage {
@@ -25,6 +28,17 @@ namespace wa { namespace storage {
     class table_operation;
     class table_result_segment;
 
+    namespace core
+    {
+        class table_entity_cache;
+        class partition_tracker;
+    }
+
+    namespace protocol
+    {
+        class table_entity_writer;
+    }
+
     /// <summary>
     /// Enumeration containing the types of values that can be stored in a table entity property.
     /// </summary>
@@ -208,11 +222,17 @@ namespace wa { namespace storage {
     {
     public:
 
+        /// <summary>
+        /// The type of a function that decides the type of a property from the partition key and row key of its entity,
+        /// the name of the property and its value as text.
+        /// </summary>
+        typedef std::function<edm_type (const utility::string_t& partition_key, const utility::string_t& row_key, const utility::string_t& property_name, const utility::string_t& property_value)> property_resolver_type;
+
         /// <summary>
         /// Initializes a new instance of the <see cref="wa::storage::table_request_options" /> class.
         /// </summary>
         table_request_options()
-            : m_payload_format(wa::storage::table_payload_format::json)
+            : m_payload_format(wa::storage::table_payload_format::json), m_parallelism_factor(1), m_track_property_changes(false), m_echo_content(false)
         {
         }
 
@@ -225,6 +245,10 @@ namespace wa { namespace storage {
             request_options::apply_defaults(other, true);
             
             m_payload_format.merge(other.m_payload_format);
+            m_parallelism_factor.merge(other.m_parallelism_factor);
+            m_property_resolver.merge(other.m_property_resolver);
+            m_track_property_changes.merge(other.m_track_property_changes);
+            m_echo_content.merge(other.m_echo_content);
         }
 
         /// <summary>
@@ -245,9 +269,92 @@ namespace wa { namespace storage {
             m_payload_format = payload_format;
         }
 
+        /// <summary>
+        /// Gets the number of requests that may be simultaneously sent by operations that consist of many requests,
+        /// such as writing entities through a <see cref="wa::storage::table_bulk_writer"/>.
+        /// </summary>
+        /// <returns>The number of parallel requests that may proceed.</returns>
+        int parallelism_factor() const
+        {
+            return m_parallelism_factor;
+        }
+
+        /// <summary>
+        /// Sets the number of requests that may be simultaneously sent by operations that consist of many requests,
+        /// such as writing entities through a <see cref="wa::storage::table_bulk_writer"/>.
+        /// </summary>
+        /// <param name="value">The number of parallel requests that may proceed.</param>
+        void set_parallelism_factor(int value)
+        {
+            m_parallelism_factor = value;
+        }
+
+        /// <summary>
+        /// Gets the function that decides the types of the properties read from the service.
+        /// </summary>
+        /// <returns>The property resolver, which is empty if the types are taken from the response.</returns>
+        const property_resolver_type& property_resolver() const
+        {
+            return m_property_resolver;
+        }
+
+        /// <summary>
+        /// Sets a function that decides the types of the properties read from the service, instead of the type annotations of the response.
+        /// This is useful with <see cref="wa::storage::table_payload_format::json_no_metadata"/>, whose responses have no type annotations.
+        /// </summary>
+        /// <param name="value">A function that is called with the partition key, the row key, the name of the property and its value
+        /// as text, and that returns the type of the property.</param>
+        void set_property_resolver(property_resolver_type value)
+        {
+            m_property_resolver = std::move(value);
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether entities read from the service record their properties, so that
+        /// <see cref="wa::storage::table_operation::merge_entity_changes"/> can send only the properties changed since.
+        /// </summary>
+        /// <returns><c>true</c> if the properties of the entities read are recorded.</returns>
+        bool track_property_changes() const
+        {
+            return m_track_property_changes;
+        }
+
+        /// <summary>
+        /// Sets a value indicating whether entities read from the service record their properties, so that
+        /// <see cref="wa::storage::table_operation::merge_entity_changes"/> can send only the properties changed since.
+        /// </summary>
+        /// <param name="value"><c>true</c> to record the properties of the entities read, which keeps a second copy of them.</param>
+        void set_track_property_changes(bool value)
+        {
+            m_track_property_changes = value;
+        }
+
+        /// <summary>
+        /// Gets a value indicating whether insert operations return the inserted entity, including the properties the service set.
+        /// </summary>
+        /// <returns><c>true</c> if inserts return the entity; <c>false</c> if they are sent with "Prefer: return-no-content" and only return its ETag.</returns>
+        bool echo_content() const
+        {
+            return m_echo_content;
+        }
+
+        /// <summary>
+        /// Sets a value indicating whether insert operations, on their own or in a batch, return the inserted entity.
+        /// </summary>
+        /// <param name="value"><c>true</c> to read the inserted entity from the response; <c>false</c> to only read its ETag, which saves
+        /// the bandwidth and the parsing of the echoed entity.</param>
+        void set_echo_content(bool value)
+        {
+            m_echo_content = value;
+        }
+
     private:
 
         option_with_default<table_payload_format> m_payload_format;
+        option_with_default<int> m_parallelism_factor;
+        option_with_default<property_resolver_type> m_property_resolver;
+        option_with_default<bool> m_track_property_changes;
+        option_with_default<bool> m_echo_content;
     };
 
     /// <summary>
@@ -261,7 +368,7 @@ namespace wa { namespace storage {
         /// Initializes a new instance of the <see cref="entity_property"/> class.
         /// </summary>
         entity_property()
-            : m_property_type(edm_type::string), m_is_null(true)
+            : m_property_type(edm_type::string), m_is_null(true), m_has_stored_value(false), m_value_formatted(true)
         {
         }
 
@@ -271,7 +378,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A byte array.</param>
         entity_property(const std::vector<uint8_t>& value)
-            : m_property_type(edm_type::binary), m_is_null(false)
+            : m_property_type(edm_type::binary), m_is_null(false), m_has_stored_value(false), m_value_formatted(true)
         {
             set_value_impl(value);
         }
@@ -282,7 +389,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A boolean value.</param>
         entity_property(bool value)
-            : m_property_type(edm_type::boolean), m_is_null(false)
+            : m_property_type(edm_type::boolean), m_is_null(false), m_has_stored_value(false), m_value_formatted(true)
         {
             set_value_impl(value);
         }
@@ -293,7 +400,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A datetime value.</param>
         entity_property(const utility::datetime& value)
-            : m_property_type(edm_type::datetime), m_is_null(false)
+            : m_property_type(edm_type::datetime), m_is_null(false), m_has_stored_value(false), m_value_formatted(true)
         {
             set_value_impl(value);
         }
@@ -304,7 +411,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A double value.</param>
         entity_property(double value)
-            : m_property_type(edm_type::double_floating_point), m_is_null(false)
+            : m_property_type(edm_type::double_floating_point), m_is_null(false), m_has_stored_value(false), m_value_formatted(true)
         {
             set_value_impl(value);
         }
@@ -315,7 +422,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A GUID value.</param>
         entity_property(const utility::uuid& value)
-            : m_property_type(edm_type::guid), m_is_null(false)
+            : m_property_type(edm_type::guid), m_is_null(false), m_has_stored_value(false), m_value_formatted(true)
         {
             set_value_impl(value);
         }
@@ -326,7 +433,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A 32-bit integer value.</param>
         entity_property(int32_t value)
-            : m_property_type(edm_type::int32), m_is_null(false)
+            : m_property_type(edm_type::int32), m_is_null(false), m_has_stored_value(false), m_value_formatted(true)
         {
             set_value_impl(value);
         }
@@ -337,7 +444,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A 64-bit integer value.</param>
         entity_property(int64_t value)
-            : m_property_type(edm_type::int64), m_is_null(false)
+            : m_property_type(edm_type::int64), m_is_null(false), m_has_stored_value(false), m_value_formatted(true)
         {
             set_value_impl(value);
         }
@@ -348,7 +455,7 @@ namespace wa { namespace storage {
         /// </summary>
         /// <param name="input">A string value.</param>
         entity_property(const utility::string_t& value)
-            : m_property_type(edm_type::string), m_value(value), m_is_null(false)
+            : m_property_type(edm_type::string), m_is_null(false), m_has_stored_value(false), m_value_formatted(true), m_value(value)
         {
         }
 
@@ -365,9 +472,16 @@ namespace wa { namespace storage {
         /// Sets the property type of the <see cref="entity_property" /> object.
         /// </summary>
         /// <param name="property_type">An <see cref="edm_type" /> object indicating the property type.</param>
+        /// <remarks>
+        /// A value that was set as a string is converted to the new type once here, so that reading it does not parse it again.
+        /// </remarks>
         void set_property_type(wa::storage::edm_type property_type)
         {
             m_property_type = property_type;
+            if ((!m_has_stored_value || m_stored_type == edm_type::string) && !m_is_null && property_type != edm_type::string)
+            {
+                parse_value();
+            }
         }
 
         /// <summary>
@@ -404,7 +518,12 @@ namespace wa { namespace storage {
                 throw std::runtime_error("The type of the entity property is not binary.");
             }
 
-            return std::vector<uint8_t>(utility::conversions::from_base64(m_value));
+            if (has_stored_value(edm_type::binary))
+            {
+                return m_binary;
+            }
+
+            return std::vector<uint8_t>(utility::conversions::from_base64(str()));
         }
 
         /// <summary>
@@ -421,11 +540,17 @@ namespace wa { namespace storage {
                 throw std::runtime_error("The type of the entity property is not boolean.");
             }
 
-            if (m_value.compare(U("false")) == 0)
+            if (has_stored_value(edm_type::boolean))
+            {
+                return m_boolean;
+            }
+
+            const utility::string_t& value = str();
+            if (value.compare(U("false")) == 0)
             {
                 return false;
             }
-            else if (m_value.compare(U("true")) == 0)
+            else if (value.compare(U("true")) == 0)
             {
                 return true;
             }
@@ -481,22 +606,28 @@ namespace wa { namespace storage {
                 throw std::runtime_error("The type of the entity property is not double.");
             }
 
-            if (m_value.compare(protocol::double_not_a_number) == 0)
+            if (has_stored_value(edm_type::double_floating_point))
+            {
+                return m_double;
+            }
+
+            const utility::string_t& value = str();
+            if (value.compare(protocol::double_not_a_number) == 0)
             {
                 return std::numeric_limits<double>::quiet_NaN();
             }
-            else if (m_value.compare(protocol::double_infinity) == 0)
+            else if (value.compare(protocol::double_infinity) == 0)
             {
                 return std::numeric_limits<double>::infinity();
             }
-            else if (m_value.compare(protocol::double_negative_infinity) == 0)
+            else if (value.compare(protocol::double_negative_infinity) == 0)
             {
                 return -std::numeric_limits<double>::infinity();
             }
 
             // TODO: Test and verify this throws an appropriate exception on failure
             double result;
-            utility::istringstream_t buffer(m_value);
+            utility::istringstream_t buffer(value);
             buffer >> result;
             return result;
         }
@@ -515,7 +646,14 @@ namespace wa { namespace storage {
                 throw std::runtime_error("The type of the entity property is not GUID.");
             }
 
-            utility::uuid result = utility::string_to_uuid(m_value);
+            if (has_stored_value(edm_type::guid))
+            {
+                utility::uuid result;
+                std::memcpy(&result, m_guid, sizeof(m_guid));
+                return result;
+            }
+
+            utility::uuid result = utility::string_to_uuid(str());
             return result;
         }
 
@@ -533,8 +671,13 @@ namespace wa { namespace storage {
                 throw std::runtime_error("The type of the entity property is not 32-bit integer.");
             }
 
+            if (has_stored_value(edm_type::int32))
+            {
+                return m_int32;
+            }
+
             int32_t result;
-            utility::istringstream_t buffer(m_value);
+            utility::istringstream_t buffer(str());
             buffer >> result;
             return result;
         }
@@ -553,8 +696,13 @@ namespace wa { namespace storage {
                 throw std::runtime_error("The type of the entity property is not 64-bit integer.");
             }
 
+            if (has_stored_value(edm_type::int64))
+            {
+                return m_int64;
+            }
+
             int64_t result;
-            utility::istringstream_t buffer(m_value);
+            utility::istringstream_t buffer(str());
             buffer >> result;
             return result;
         }
@@ -573,7 +721,7 @@ namespace wa { namespace storage {
                 throw std::runtime_error("The type of the entity property is not string.");
             }
 
-            return m_value;
+            return str();
         }
 
         // TODO: Use std::vector<uint8_t> for binary data throughout the library
@@ -663,63 +811,149 @@ namespace wa { namespace storage {
         {
             m_property_type = edm_type::string;
             m_is_null = false;
-            m_value = value;
+            m_has_stored_value = false;
+            m_value_formatted = true;
+            m_value = std::move(value);
+        }
+
+        /// <summary>
+        /// Sets the string value of the <see cref="entity_property"/> object from UTF-8 text.
+        /// </summary>
+        /// <param name="value">The string value, encoded as UTF-8.</param>
+        /// <remarks>
+        /// The text is kept as it is and only converted to a platform string the first time the value is read as one,
+        /// so a value that is only written back to the service is never converted.
+        /// </remarks>
+        void set_utf8_value(std::string value)
+        {
+#ifdef _UTF16_STRINGS
+            m_property_type = edm_type::string;
+            m_is_null = false;
+            m_utf8_value = std::move(value);
+            set_stored_type(edm_type::string);
+#else
+            set_value(std::move(value));
+#endif
+        }
+
+        /// <summary>
+        /// Indicates whether the value is kept as UTF-8 text that has not been converted to a platform string.
+        /// </summary>
+        /// <returns><c>true</c> if <see cref="utf8_value" /> returns the value.</returns>
+        bool has_utf8_value() const
+        {
+            return has_stored_value(edm_type::string);
+        }
+
+        /// <summary>
+        /// Gets the UTF-8 text that was set by <see cref="set_utf8_value" />.
+        /// </summary>
+        /// <returns>The UTF-8 text, or an empty string if <see cref="has_utf8_value" /> is <c>false</c>.</returns>
+        const std::string& utf8_value() const
+        {
+            return m_utf8_value;
         }
 
         /// <summary>
         /// Returns the value of the <see cref="entity_property"/> object as a string.
         /// </summary>
         /// <returns>A string containing the property value.</returns>
+        /// <remarks>
+        /// Values that were not set as strings are formatted the first time this is called.
+        /// </remarks>
         const utility::string_t& str() const
         {
+            if (!m_value_formatted)
+            {
+                format_value();
+            }
+
             return m_value;
         }
 
     private:
 
+        bool has_stored_value(edm_type type) const
+        {
+            return m_has_stored_value && m_stored_type == type;
+        }
+
+        void set_stored_type(edm_type type)
+        {
+            m_stored_type = type;
+            m_has_stored_value = true;
+            m_value_formatted = false;
+        }
+
         void set_value_impl(const std::vector<uint8_t>& value)
         {
-            m_value = utility::conversions::to_base64(value);
+            m_binary = value;
+            set_stored_type(edm_type::binary);
         }
 
         void set_value_impl(bool value)
         {
-            m_value = value ? U("true") : U("false");
+            m_boolean = value;
+            set_stored_type(edm_type::boolean);
         }
 
-        /*
         void set_value_impl(const utility::datetime& value)
         {
-            m_value = value.to_string(utility::datetime::ISO_8601);
+            m_datetime = value.to_interval();
+            set_stored_type(edm_type::datetime);
         }
-        */
-
-        WASTORAGE_API void set_value_impl(const utility::datetime& value);
 
-        WASTORAGE_API void set_value_impl(double value);
+        void set_value_impl(double value)
+        {
+            m_double = value;
+            set_stored_type(edm_type::double_floating_point);
+        }
 
-        void set_value_impl(utility::uuid value)
+        void set_value_impl(const utility::uuid& value)
         {
-            m_value = utility::uuid_to_string(value);
+            std::memcpy(m_guid, &value, sizeof(m_guid));
+            set_stored_type(edm_type::guid);
         }
 
         void set_value_impl(int32_t value)
         {
-            utility::ostringstream_t buffer;
-            buffer << value;
-            m_value = buffer.str();
+            m_int32 = value;
+            set_stored_type(edm_type::int32);
         }
 
         void set_value_impl(int64_t value)
         {
-            utility::ostringstream_t buffer;
-            buffer << value;
-            m_value = buffer.str();
+            m_int64 = value;
+            set_stored_type(edm_type::int64);
         }
 
+        WASTORAGE_API void format_value() const;
+        WASTORAGE_API void parse_value();
+
+        // The writer formats the stored values straight into a request body
+        friend class protocol::table_entity_writer;
+
         edm_type m_property_type;
         bool m_is_null;
-        utility::string_t m_value;
+
+        // Non-string values are kept in binary form, and m_value only caches their formatted text.
+        // A string value whose property type could not be parsed stays in m_value only.
+        // A string value read from a response is kept in m_utf8_value, with String as its stored type.
+        bool m_has_stored_value;
+        mutable bool m_value_formatted;
+        edm_type m_stored_type;
+        union
+        {
+            bool m_boolean;
+            int32_t m_int32;
+            int64_t m_int64;
+            double m_double;
+            utility::datetime::interval_type m_datetime;
+            unsigned char m_guid[sizeof(utility::uuid)];
+        };
+        std::vector<uint8_t> m_binary;
+        std::string m_utf8_value;
+        mutable utility::string_t m_value;
     };
 
     /// <summary>
@@ -868,6 +1102,36 @@ namespace wa { namespace storage {
             m_etag = std::move(etag);
         }
 
+        /// <summary>
+        /// Records the current properties of the entity, so that later changes to them can be told apart.
+        /// </summary>
+        /// <remarks>
+        /// Entities read with <see cref="wa::storage::table_request_options::track_property_changes"/> enabled have their properties recorded already.
+        /// </remarks>
+        void accept_changes()
+        {
+            m_original_properties = std::make_shared<properties_type>(m_properties);
+        }
+
+        /// <summary>
+        /// Indicates whether the properties of the entity have been recorded by <see cref="accept_changes"/>.
+        /// </summary>
+        /// <returns><c>true</c> if the changes to the properties are tracked.</returns>
+        bool is_tracking_changes() const
+        {
+            return m_original_properties != nullptr;
+        }
+
+        /// <summary>
+        /// Gets the properties that were added or changed since the properties of the entity were recorded.
+        /// </summary>
+        /// <returns>The changed properties, indexed by property name, or all the properties if changes are not tracked.</returns>
+        /// <remarks>
+        /// A property is changed if its type, its null-ness or its value differs from the recorded one.
+        /// Properties that were removed are not included, because a merge cannot remove them.
+        /// </remarks>
+        WASTORAGE_API properties_type changed_properties() const;
+
     private:
 
         properties_type m_properties;
@@ -875,6 +1139,9 @@ namespace wa { namespace storage {
         utility::string_t m_row_key;
         utility::datetime m_timestamp;
         utility::string_t m_etag;
+
+        // The properties as they were recorded, shared between copies of the entity
+        std::shared_ptr<const properties_type> m_original_properties;
     };
 
     /// <summary>
@@ -954,6 +1221,21 @@ namespace wa { namespace storage {
             return table_operation(table_operation_type::merge_operation, entity);
         }
 
+        /// <summary>
+        /// Creates a new table operation to merge only the properties of the specified entity that were added or changed
+        /// since its properties were recorded, which keeps the request small when few properties changed.
+        /// </summary>
+        /// <param name="entity">The entity whose changed contents are being merged.</param>
+        /// <returns>A <see cref="wa::storage::table_operation"/> object.</returns>
+        /// <remarks>
+        /// All the properties are merged if the changes to the entity are not tracked.
+        /// </remarks>
+        static const table_operation merge_entity_changes(const table_entity& entity)
+        {
+            table_entity changes(entity.partition_key(), entity.row_key(), entity.etag(), entity.changed_properties());
+            return table_operation(table_operation_type::merge_operation, changes);
+        }
+
         /// <summary>
         /// Creates a new table operation to replace the contents of the specified entity.
         /// </summary>
@@ -1222,7 +1504,7 @@ namespace wa { namespace storage {
         /// Gets the names of the entity properties to return when the query is executed.
         /// </summary>
         /// <returns>An enumerable collection of strings containing the names of the properties to return when the query is executed.</returns>
-        std::vector<utility::string_t> select_columns() const
+        const std::vector<utility::string_t>& select_columns() const
         {
             return m_select_columns;
         }
@@ -1636,7 +1918,7 @@ namespace wa { namespace storage {
         /// Gets an enumerable collection of <see cref="wa::storage::table_entity" /> results.
         /// </summary>
         /// <returns>An enumerable collection of <see cref="wa::storage::table_entity" /> results.</returns>
-        std::vector<wa::storage::table_entity> results() const
+        const std::vector<wa::storage::table_entity>& results() const
         {
             return m_results;
         }
@@ -1652,7 +1934,7 @@ namespace wa { namespace storage {
 
     private:
 
-        void set_results(const std::vector<wa::storage::table_entity>& results)
+        void set_results(std::vector<wa::storage::table_entity> results)
         {
             m_results = std::move(results);
         }
@@ -1669,163 +1951,1229 @@ namespace wa { namespace storage {
     };
 
     /// <summary>
-    /// Provides a client-side logical representation of the Windows Azure Table service. 
-    /// This client is used to configure and execute requests against the Table service.
+    /// Represents the results of a table query that keeps the first entities in memory and writes the rest to a file,
+    /// and reads them back one at a time.
     /// </summary>
-    /// <remarks>The service client encapsulates the base URI for the Table service. 
-    /// If the service client will be used for authenticated access, it also encapsulates the 
-    /// credentials for accessing the storage account.</remarks>
-    class cloud_table_client : public cloud_client
+    /// <remarks>
+    /// Copies of a result share the entities and the position of the reader. The file is deleted once the last copy is destroyed.
+    /// </remarks>
+    class table_query_result
     {
     public:
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class.
+        /// Initializes a new instance of the <see cref="wa::storage::table_query_result"/> class with no entities.
         /// </summary>
-        cloud_table_client()
-            : cloud_client()
+        table_query_result()
         {
-            initialize();
         }
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class using the specified Table service endpoint
-        /// and anonymous credentials.
+        /// Reads the next entity of the results.
         /// </summary>
-        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Table service endpoint for all locations.</param>
-        cloud_table_client(const storage_uri& base_uri)
-            : cloud_client(base_uri)
-        {
-            initialize();
-        }
+        /// <param name="entity">The entity that is read.</param>
+        /// <returns><c>true</c> if an entity was read; <c>false</c> at the end of the results.</returns>
+        WASTORAGE_API bool read_next(table_entity& entity);
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class using the specified Table service endpoint
-        /// and account credentials.
+        /// Gets the number of entities of the results.
         /// </summary>
-        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Table service endpoint for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_table_client(const storage_uri& base_uri, const storage_credentials& credentials)
-            : cloud_client(base_uri, credentials)
-        {
-            initialize();
-        }
+        /// <returns>The number of entities.</returns>
+        WASTORAGE_API size_t size() const;
 
         /// <summary>
-        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class using the specified Table service endpoint
-        /// and account credentials.
+        /// Gets the number of entities that were written to the file, because the ones before them reached the memory limit.
         /// </summary>
-        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Table service endpoint for all locations.</param>
-        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
-        cloud_table_client(const storage_uri& base_uri, const storage_credentials& credentials, const table_request_options& default_request_options)
-            : cloud_client(base_uri, credentials), m_default_request_options(default_request_options)
+        /// <returns>The number of entities in the file.</returns>
+        WASTORAGE_API size_t spilled_count() const;
+
+    private:
+
+        struct shared_state;
+
+        table_query_result(size_t max_memory_size, const utility::string_t& spill_directory);
+        void append(const table_entity& entity);
+        void finish();
+
+        std::shared_ptr<shared_state> m_state;
+
+        friend class cloud_table;
+    };
+
+    /// <summary>
+    /// Represents a PartitionKey range of a table query that can be executed on its own, by any process, and saved as text between segments.
+    /// </summary>
+    /// <remarks>
+    /// Split a query into units with <see cref="table_scan_unit::split" />, hand each unit to a worker as the text returned by
+    /// <see cref="table_scan_unit::to_string" />, and have the worker execute <see cref="table_scan_unit::query" /> segment by segment
+    /// from <see cref="table_scan_unit::continuation_token" />, calling <see cref="table_scan_unit::advance" /> with the continuation token of
+    /// every segment it has processed. Saving the unit after each segment lets another worker resume it if the first one stops.
+    /// </remarks>
+    class table_scan_unit
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_scan_unit"/> class that covers the whole table.
+        /// </summary>
+        /// <param name="query">The query to execute.</param>
+        explicit table_scan_unit(const table_query& query)
+            : m_query(query), m_is_complete(false)
         {
-            initialize();
         }
 
         /// <summary>
-        /// Sets the authentication scheme to use to sign HTTP requests.
+        /// Initializes a new instance of the <see cref="wa::storage::table_scan_unit"/> class.
         /// </summary>
-        /// <param name="value">The authentication scheme.</param>
-        WASTORAGE_API void set_authentication_scheme(wa::storage::authentication_scheme value) override;
+        /// <param name="query">The query to execute.</param>
+        /// <param name="lower_partition_key">The lowest PartitionKey of the range, or an empty string if the range has no lower bound.</param>
+        /// <param name="upper_partition_key">The PartitionKey that the range ends before, or an empty string if the range has no upper bound.</param>
+        WASTORAGE_API table_scan_unit(const table_query& query, const utility::string_t& lower_partition_key, const utility::string_t& upper_partition_key);
 
         /// <summary>
-        /// Returns an enumerable collection of tables.
+        /// Splits a query into units of consecutive PartitionKey ranges that together cover the whole table.
         /// </summary>
-        /// <returns>An enumerable collection of <see cref="cloud_table" /> objects.</returns>
-        std::vector<cloud_table> list_tables() const
-        {
-            return list_tables_async(utility::string_t(), table_request_options(), operation_context()).get();
-        }
+        /// <param name="query">The query to execute.</param>
+        /// <param name="partition_key_boundaries">The partition keys that separate the ranges, in ascending order. Each boundary starts a new range,
+        /// so N boundaries split the table into N + 1 units.</param>
+        /// <returns>An enumerable collection of units, in the order of their ranges.</returns>
+        WASTORAGE_API static std::vector<table_scan_unit> split(const table_query& query, const std::vector<utility::string_t>& partition_key_boundaries);
 
         /// <summary>
-        /// Returns an enumerable collection of tables, retrieved lazily, that begin with the specified prefix.
+        /// Reads a unit from the text returned by <see cref="table_scan_unit::to_string" />.
         /// </summary>
-        /// <param name="prefix">The table name prefix.</param>
-        /// <returns>An enumerable collection of <see cref="cloud_table" /> objects that are retrieved lazily.</returns>
-        std::vector<cloud_table> list_tables(const utility::string_t& prefix) const
-        {
-            return list_tables_async(prefix, table_request_options(), operation_context()).get();
-        }
+        /// <param name="value">The saved unit.</param>
+        /// <returns>The unit.</returns>
+        WASTORAGE_API static table_scan_unit parse(const utility::string_t& value);
 
         /// <summary>
-        /// Returns an enumerable collection of tables that begin with the specified prefix.
+        /// Returns the unit, with its progress, as text that can be saved and read back with <see cref="table_scan_unit::parse" />.
         /// </summary>
-        /// <param name="prefix">The table name prefix.</param>
-        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>An enumerable collection of <see cref="cloud_table" /> objects.</returns>
-        std::vector<cloud_table> list_tables(const utility::string_t& prefix, const table_request_options& options, operation_context context) const
-        {
-            return list_tables_async(prefix, options, context).get();
-        }
+        /// <returns>The unit as text.</returns>
+        WASTORAGE_API utility::string_t to_string() const;
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation that returns an enumerable collection of tables.
+        /// Gets the query that returns the entities of the unit, which is the query it was created with restricted to its range.
         /// </summary>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="cloud_table" />, that represents the current operation.</returns>
-        pplx::task<std::vector<cloud_table>> list_tables_async() const
+        /// <returns>A <see cref="wa::storage::table_query" /> object.</returns>
+        const table_query& query() const
         {
-            return list_tables_async(utility::string_t(), table_request_options(), operation_context());
+            return m_query;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation that returns an enumerable collection of tables, retrieved lazily, that begin with the specified prefix.
+        /// Gets the lowest PartitionKey of the range.
         /// </summary>
-        /// <param name="prefix">The table name prefix.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="cloud_table" />, that represents the current operation.</returns>
-        pplx::task<std::vector<cloud_table>> list_tables_async(const utility::string_t& prefix) const
+        /// <returns>The lower bound of the range, or an empty string if the range has no lower bound.</returns>
+        const utility::string_t& lower_partition_key() const
         {
-            return list_tables_async(prefix, table_request_options(), operation_context());
+            return m_lower_partition_key;
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation that returns an enumerable collection of tables that begin with the specified prefix.
+        /// Gets the PartitionKey that the range ends before.
         /// </summary>
-        /// <param name="prefix">The table name prefix.</param>
-        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="cloud_table" />, that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<std::vector<cloud_table>> list_tables_async(const utility::string_t& prefix, const table_request_options& options, operation_context context) const;
+        /// <returns>The upper bound of the range, or an empty string if the range has no upper bound.</returns>
+        const utility::string_t& upper_partition_key() const
+        {
+            return m_upper_partition_key;
+        }
 
         /// <summary>
-        /// Returns a <see cref="table_result_segment" /> containing an enumerable collection of tables.
+        /// Gets the continuation token to execute the next segment of the unit with.
         /// </summary>
-        /// <param name="continuation_token">A <see cref="wa::storage::continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="table_result_segment" /> containing an enumerable collection of tables.</returns>
-        table_result_segment list_tables_segmented(const continuation_token& continuation_token) const
+        /// <returns>A <see cref="wa::storage::continuation_token" /> object, which is empty before the first segment.</returns>
+        const wa::storage::continuation_token& continuation_token() const
         {
-            return list_tables_segmented_async(utility::string_t(), 0, continuation_token, table_request_options(), operation_context()).get();
+            return m_continuation_token;
         }
 
         /// <summary>
-        /// Returns a <see cref="table_result_segment" /> containing an enumerable collection of tables, retrieved lazily, that begin with the specified prefix.
+        /// Records that a segment of the unit has been processed.
         /// </summary>
-        /// <param name="prefix">The table name prefix.</param>
-        /// <param name="continuation_token">A <see cref="wa::storage::continuation_token" /> returned by a previous listing operation.</param>
-        /// <returns>A <see cref="table_result_segment" /> containing an enumerable collection of tables.</returns>
-        table_result_segment list_tables_segmented(const utility::string_t& prefix, const continuation_token& continuation_token) const
+        /// <param name="next_token">The continuation token returned with the segment.</param>
+        void advance(const wa::storage::continuation_token& next_token)
         {
-            return list_tables_segmented_async(prefix, 0, continuation_token, table_request_options(), operation_context()).get();
+            m_continuation_token = next_token;
+            m_is_complete = next_token.empty();
         }
 
         /// <summary>
-        /// Returns a <see cref="table_result_segment" /> containing an enumerable collection of tables that begin with the specified prefix.
+        /// Gets a value indicating whether every segment of the unit has been processed.
         /// </summary>
-        /// <param name="prefix">The table name prefix.</param>
-        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
-        /// per-operation limit of 5000. If this value is zero the maximum possible number of results will be returned, up to 5000.</param>
-        /// <param name="continuation_token">A <see cref="wa::storage::continuation_token"/> returned by a previous listing operation.</param>
-        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
-        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
-        /// <returns>A <see cref="table_result_segment" /> containing an enumerable collection of tables.</returns>
-        table_result_segment list_tables_segmented(const utility::string_t& prefix, int max_results, const continuation_token& continuation_token, const table_request_options& options, operation_context context) const
+        /// <returns><c>true</c> if the unit is complete; otherwise, <c>false</c>.</returns>
+        bool is_complete() const
         {
-            return list_tables_segmented_async(prefix, max_results, continuation_token, options, context).get();
+            return m_is_complete;
         }
 
-        /// <summary>
-        /// Returns a task that performs an asynchronous operation that returns a <see cref="table_result_segment" /> containing an enumerable collection of tables.
+    private:
+
+        table_query m_query;
+        utility::string_t m_lower_partition_key;
+        utility::string_t m_upper_partition_key;
+        wa::storage::continuation_token m_continuation_token;
+        bool m_is_complete;
+    };
+
+    /// <summary>
+    /// Receives the entities read by a query one property at a time, so that they can be stored in application objects
+    /// without building a <see cref="wa::storage::table_entity"/>. Usually implemented by <see cref="wa::storage::table_entity_mapping"/>.
+    /// </summary>
+    class table_entity_receiver
+    {
+    public:
+
+        virtual ~table_entity_receiver()
+        {
+        }
+
+        /// <summary>
+        /// Gets the index of the property with the specified name. It is asked once for each column of a response rather than once per entity.
+        /// </summary>
+        /// <param name="name">The UTF-8 name of the property.</param>
+        /// <returns>The index of the property, or -1 if the property is not received, in which case its values are skipped without being converted.</returns>
+        virtual int property_index(const std::string& name) const = 0;
+
+        /// <summary>
+        /// Gets the type a property is converted to when the response does not specify one.
+        /// </summary>
+        /// <param name="index">The index of the property.</param>
+        /// <returns>An <see cref="wa::storage::edm_type"/> object.</returns>
+        virtual edm_type property_type(int index) const = 0;
+
+        /// <summary>
+        /// Starts receiving a new entity.
+        /// </summary>
+        virtual void begin_entity() = 0;
+
+        /// <summary>
+        /// Receives the partition key of the current entity.
+        /// </summary>
+        virtual void set_partition_key(const utility::string_t& value) = 0;
+
+        /// <summary>
+        /// Receives the row key of the current entity.
+        /// </summary>
+        virtual void set_row_key(const utility::string_t& value) = 0;
+
+        /// <summary>
+        /// Receives the timestamp of the current entity.
+        /// </summary>
+        virtual void set_timestamp(const utility::datetime& value) = 0;
+
+        /// <summary>
+        /// Receives the ETag of the current entity.
+        /// </summary>
+        virtual void set_etag(const utility::string_t& value) = 0;
+
+        /// <summary>
+        /// Receives a property of the current entity. Properties whose value is null are not received.
+        /// </summary>
+        /// <param name="index">The index of the property.</param>
+        /// <param name="value">The value of the property.</param>
+        virtual void set_property(int index, const entity_property& value) = 0;
+
+        /// <summary>
+        /// Completes the current entity.
+        /// </summary>
+        /// <returns><c>true</c> to receive more entities; <c>false</c> to stop the query.</returns>
+        virtual bool end_entity() = 0;
+    };
+
+    namespace core
+    {
+        template<typename V>
+        struct entity_property_traits;
+
+        template<>
+        struct entity_property_traits<bool>
+        {
+            static edm_type type() { return edm_type::boolean; }
+            static bool read(const entity_property& property) { return property.boolean_value(); }
+        };
+
+        template<>
+        struct entity_property_traits<int32_t>
+        {
+            static edm_type type() { return edm_type::int32; }
+            static int32_t read(const entity_property& property) { return property.int32_value(); }
+        };
+
+        template<>
+        struct entity_property_traits<int64_t>
+        {
+            static edm_type type() { return edm_type::int64; }
+            static int64_t read(const entity_property& property) { return property.int64_value(); }
+        };
+
+        template<>
+        struct entity_property_traits<double>
+        {
+            static edm_type type() { return edm_type::double_floating_point; }
+            static double read(const entity_property& property) { return property.double_value(); }
+        };
+
+        template<>
+        struct entity_property_traits<utility::string_t>
+        {
+            static edm_type type() { return edm_type::string; }
+            static utility::string_t read(const entity_property& property) { return property.string_value(); }
+        };
+
+        template<>
+        struct entity_property_traits<utility::datetime>
+        {
+            static edm_type type() { return edm_type::datetime; }
+            static utility::datetime read(const entity_property& property) { return property.datetime_value(); }
+        };
+
+        template<>
+        struct entity_property_traits<utility::uuid>
+        {
+            static edm_type type() { return edm_type::guid; }
+            static utility::uuid read(const entity_property& property) { return property.guid_value(); }
+        };
+
+        template<>
+        struct entity_property_traits<std::vector<uint8_t>>
+        {
+            static edm_type type() { return edm_type::binary; }
+            static std::vector<uint8_t> read(const entity_property& property) { return property.binary_value(); }
+        };
+    }
+
+    /// <summary>
+    /// Maps the properties of table entities to the members of an application type.
+    /// </summary>
+    /// <remarks>
+    /// The type of every property follows from the type of its member, which may be bool, int32_t, int64_t, double, utility::string_t,
+    /// utility::datetime, utility::uuid or std::vector&lt;uint8_t&gt;. Queries that use a mapping store each property straight into its
+    /// member, and properties that are not mapped are skipped. A mapping is usually built once and shared, and it is not changed while it is in use.
+    /// <code>
+    /// table_entity_mapping&lt;order&gt; mapping;
+    /// mapping.partition_key(&amp;order::customer).row_key(&amp;order::id).property(U("Total"), &amp;order::total);
+    /// </code>
+    /// </remarks>
+    template<typename T>
+    class table_entity_mapping
+    {
+    public:
+
+        typedef T value_type;
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_entity_mapping" /> class.
+        /// </summary>
+        table_entity_mapping()
+            : m_fields(std::make_shared<fields>())
+        {
+        }
+
+        /// <summary>
+        /// Maps the partition key to a member.
+        /// </summary>
+        /// <param name="member">The member that holds the partition key.</param>
+        /// <returns>A reference to the mapping.</returns>
+        table_entity_mapping& partition_key(utility::string_t T::* member)
+        {
+            m_fields->partition_key = member;
+            return *this;
+        }
+
+        /// <summary>
+        /// Maps the row key to a member.
+        /// </summary>
+        /// <param name="member">The member that holds the row key.</param>
+        /// <returns>A reference to the mapping.</returns>
+        table_entity_mapping& row_key(utility::string_t T::* member)
+        {
+            m_fields->row_key = member;
+            return *this;
+        }
+
+        /// <summary>
+        /// Maps the timestamp to a member. The timestamp is only read, because it is set by the service.
+        /// </summary>
+        /// <param name="member">The member that holds the timestamp.</param>
+        /// <returns>A reference to the mapping.</returns>
+        table_entity_mapping& timestamp(utility::datetime T::* member)
+        {
+            m_fields->timestamp = member;
+            return *this;
+        }
+
+        /// <summary>
+        /// Maps the ETag to a member.
+        /// </summary>
+        /// <param name="member">The member that holds the ETag.</param>
+        /// <returns>A reference to the mapping.</returns>
+        table_entity_mapping& etag(utility::string_t T::* member)
+        {
+            m_fields->etag = member;
+            return *this;
+        }
+
+        /// <summary>
+        /// Maps a property to a member.
+        /// </summary>
+        /// <param name="name">The name of the property.</param>
+        /// <param name="member">The member that holds the property.</param>
+        /// <returns>A reference to the mapping.</returns>
+        template<typename V>
+        table_entity_mapping& property(const utility::string_t& name, V T::* member)
+        {
+            m_fields->properties.push_back(std::make_shared<typed_field<V>>(name, member));
+            return *this;
+        }
+
+        /// <summary>
+        /// Stores the properties of an entity in an object.
+        /// </summary>
+        /// <param name="entity">The entity to read.</param>
+        /// <param name="value">The object whose mapped members are set.</param>
+        void read_entity(const table_entity& entity, T& value) const
+        {
+            const fields& mapped = *m_fields;
+            if (mapped.partition_key != nullptr)
+            {
+                value.*mapped.partition_key = entity.partition_key();
+            }
+
+            if (mapped.row_key != nullptr)
+            {
+                value.*mapped.row_key = entity.row_key();
+            }
+
+            if (mapped.timestamp != nullptr)
+            {
+                value.*mapped.timestamp = entity.timestamp();
+            }
+
+            if (mapped.etag != nullptr)
+            {
+                value.*mapped.etag = entity.etag();
+            }
+
+            for (auto iter = mapped.properties.cbegin(); iter != mapped.properties.cend(); ++iter)
+            {
+                auto property = entity.properties().find((*iter)->name());
+                if (property != entity.properties().cend() && !property->second.is_null())
+                {
+                    (*iter)->read(property->second, value);
+                }
+            }
+        }
+
+        /// <summary>
+        /// Creates an entity from the mapped members of an object, for example to be written by a <see cref="wa::storage::table_operation"/>.
+        /// </summary>
+        /// <param name="value">The object to read.</param>
+        /// <returns>A <see cref="wa::storage::table_entity"/> object.</returns>
+        table_entity write_entity(const T& value) const
+        {
+            const fields& mapped = *m_fields;
+            table_entity entity;
+            if (mapped.partition_key != nullptr)
+            {
+                entity.set_partition_key(value.*mapped.partition_key);
+            }
+
+            if (mapped.row_key != nullptr)
+            {
+                entity.set_row_key(value.*mapped.row_key);
+            }
+
+            if (mapped.etag != nullptr)
+            {
+                entity.set_etag(value.*mapped.etag);
+            }
+
+            entity.properties().reserve(mapped.properties.size());
+            for (auto iter = mapped.properties.cbegin(); iter != mapped.properties.cend(); ++iter)
+            {
+                entity.properties().insert(table_entity::property_type((*iter)->name(), (*iter)->write(value)));
+            }
+
+            return entity;
+        }
+
+        /// <summary>
+        /// Creates a receiver that stores the entities of a query in objects and passes each one to a handler.
+        /// </summary>
+        /// <param name="handler">A function that is called for each object. Returning <c>false</c> stops the query.</param>
+        /// <returns>A <see cref="wa::storage::table_entity_receiver"/> object.</returns>
+        std::shared_ptr<table_entity_receiver> create_receiver(std::function<bool (const T&)> handler) const
+        {
+            return std::make_shared<receiver>(m_fields, std::move(handler));
+        }
+
+    private:
+
+        class field
+        {
+        public:
+
+            field(const utility::string_t& name, edm_type type)
+                : m_name(name), m_utf8_name(utility::conversions::to_utf8string(name)), m_type(type)
+            {
+            }
+
+            virtual ~field()
+            {
+            }
+
+            const utility::string_t& name() const
+            {
+                return m_name;
+            }
+
+            const std::string& utf8_name() const
+            {
+                return m_utf8_name;
+            }
+
+            edm_type type() const
+            {
+                return m_type;
+            }
+
+            virtual void read(const entity_property& property, T& value) const = 0;
+            virtual entity_property write(const T& value) const = 0;
+
+        private:
+
+            utility::string_t m_name;
+            std::string m_utf8_name;
+            edm_type m_type;
+        };
+
+        template<typename V>
+        class typed_field : public field
+        {
+        public:
+
+            typed_field(const utility::string_t& name, V T::* member)
+                : field(name, core::entity_property_traits<V>::type()), m_member(member)
+            {
+            }
+
+            virtual void read(const entity_property& property, T& value) const
+            {
+                value.*m_member = core::entity_property_traits<V>::read(property);
+            }
+
+            virtual entity_property write(const T& value) const
+            {
+                return entity_property(value.*m_member);
+            }
+
+        private:
+
+            V T::* m_member;
+        };
+
+        struct fields
+        {
+            fields()
+                : partition_key(nullptr), row_key(nullptr), timestamp(nullptr), etag(nullptr)
+            {
+            }
+
+            utility::string_t T::* partition_key;
+            utility::string_t T::* row_key;
+            utility::datetime T::* timestamp;
+            utility::string_t T::* etag;
+            std::vector<std::shared_ptr<field>> properties;
+        };
+
+        class receiver : public table_entity_receiver
+        {
+        public:
+
+            receiver(std::shared_ptr<const fields> mapped, std::function<bool (const T&)> handler)
+                : m_fields(std::move(mapped)), m_handler(std::move(handler))
+            {
+            }
+
+            virtual int property_index(const std::string& name) const
+            {
+                for (size_t i = 0; i < m_fields->properties.size(); ++i)
+                {
+                    if (m_fields->properties[i]->utf8_name() == name)
+                    {
+                        return static_cast<int>(i);
+                    }
+                }
+
+                return -1;
+            }
+
+            virtual edm_type property_type(int index) const
+            {
+                return m_fields->properties[index]->type();
+            }
+
+            virtual void begin_entity()
+            {
+                m_value = T();
+            }
+
+            virtual void set_partition_key(const utility::string_t& value)
+            {
+                if (m_fields->partition_key != nullptr)
+                {
+                    m_value.*m_fields->partition_key = value;
+                }
+            }
+
+            virtual void set_row_key(const utility::string_t& value)
+            {
+                if (m_fields->row_key != nullptr)
+                {
+                    m_value.*m_fields->row_key = value;
+                }
+            }
+
+            virtual void set_timestamp(const utility::datetime& value)
+            {
+                if (m_fields->timestamp != nullptr)
+                {
+                    m_value.*m_fields->timestamp = value;
+                }
+            }
+
+            virtual void set_etag(const utility::string_t& value)
+            {
+                if (m_fields->etag != nullptr)
+                {
+                    m_value.*m_fields->etag = value;
+                }
+            }
+
+            virtual void set_property(int index, const entity_property& value)
+            {
+                m_fields->properties[index]->read(value, m_value);
+            }
+
+            virtual bool end_entity()
+            {
+                return m_handler(m_value);
+            }
+
+        private:
+
+            std::shared_ptr<const fields> m_fields;
+            std::function<bool (const T&)> m_handler;
+            T m_value;
+        };
+
+        std::shared_ptr<fields> m_fields;
+    };
+
+    /// <summary>
+    /// Represents the values of one property across the rows of a <see cref="wa::storage::table_column_batch"/>, laid out as an Apache Arrow array.
+    /// </summary>
+    /// <remarks>
+    /// The validity bitmap holds one bit per row, least significant bit first, which is set if the row has a value. Boolean values are bits
+    /// packed the same way, while 32-bit and 64-bit integers, doubles and date/time values are contiguous fixed-width values with a slot for
+    /// every row. A date/time value is the 64-bit number of 100-nanosecond intervals since January 1, 1601. Strings, GUIDs in their text form
+    /// and binary values are stored back to back, strings as UTF-8, and the offsets hold the start of every row followed by the end of the last one.
+    /// </remarks>
+    class table_column
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_column" /> class with no rows.
+        /// </summary>
+        /// <param name="name">The name of the property.</param>
+        /// <param name="type">The type the values of the property are stored as.</param>
+        WASTORAGE_API table_column(const utility::string_t& name, edm_type type);
+
+        /// <summary>
+        /// Gets the name of the property.
+        /// </summary>
+        /// <returns>The name of the property.</returns>
+        const utility::string_t& name() const
+        {
+            return m_name;
+        }
+
+        /// <summary>
+        /// Gets the type the values of the property are stored as.
+        /// </summary>
+        /// <returns>An <see cref="wa::storage::edm_type"/> object.</returns>
+        edm_type type() const
+        {
+            return m_type;
+        }
+
+        /// <summary>
+        /// Gets the number of rows in the column.
+        /// </summary>
+        /// <returns>The number of rows.</returns>
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        /// <summary>
+        /// Gets the number of rows that have no value, because the entity did not have the property or its value was null.
+        /// </summary>
+        /// <returns>The number of rows without a value.</returns>
+        size_t null_count() const
+        {
+            return m_null_count;
+        }
+
+        /// <summary>
+        /// Indicates whether a row has no value.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns><c>true</c> if the row has no value.</returns>
+        bool is_null(size_t row) const
+        {
+            return !get_bit(m_validity, row);
+        }
+
+        /// <summary>
+        /// Gets the validity bitmap of the column.
+        /// </summary>
+        /// <returns>The bitmap, with a set bit for each row that has a value.</returns>
+        const std::vector<uint8_t>& validity() const
+        {
+            return m_validity;
+        }
+
+        /// <summary>
+        /// Gets the buffer that holds the values of the column.
+        /// </summary>
+        /// <returns>The values, as described for the type of the column.</returns>
+        const std::vector<uint8_t>& values() const
+        {
+            return m_values;
+        }
+
+        /// <summary>
+        /// Gets the offsets of the rows in the values of a string, GUID or binary column.
+        /// </summary>
+        /// <returns>The offsets, which are empty for other types.</returns>
+        const std::vector<int32_t>& offsets() const
+        {
+            return m_offsets;
+        }
+
+        /// <summary>
+        /// Gets a value of a boolean column.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns>The value, which is <c>false</c> if the row has no value.</returns>
+        bool boolean_value(size_t row) const
+        {
+            return get_bit(m_values, row);
+        }
+
+        /// <summary>
+        /// Gets a value of a 32-bit integer column.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns>The value, which is zero if the row has no value.</returns>
+        int32_t int32_value(size_t row) const
+        {
+            return get_fixed_value<int32_t>(row);
+        }
+
+        /// <summary>
+        /// Gets a value of a 64-bit integer column.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns>The value, which is zero if the row has no value.</returns>
+        int64_t int64_value(size_t row) const
+        {
+            return get_fixed_value<int64_t>(row);
+        }
+
+        /// <summary>
+        /// Gets a value of a double-precision floating point column.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns>The value, which is zero if the row has no value.</returns>
+        double double_value(size_t row) const
+        {
+            return get_fixed_value<double>(row);
+        }
+
+        /// <summary>
+        /// Gets a value of a date/time column.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns>The value, which is not initialized if the row has no value.</returns>
+        utility::datetime datetime_value(size_t row) const
+        {
+            return utility::datetime() + static_cast<utility::datetime::interval_type>(get_fixed_value<int64_t>(row));
+        }
+
+        /// <summary>
+        /// Gets a value of a string or GUID column.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns>The value, which is empty if the row has no value.</returns>
+        utility::string_t string_value(size_t row) const
+        {
+            return utility::conversions::to_string_t(std::string(reinterpret_cast<const char*>(m_values.data()) + m_offsets[row], m_offsets[row + 1] - m_offsets[row]));
+        }
+
+        /// <summary>
+        /// Gets a value of a binary column.
+        /// </summary>
+        /// <param name="row">The index of the row.</param>
+        /// <returns>The value, which is empty if the row has no value.</returns>
+        std::vector<uint8_t> binary_value(size_t row) const
+        {
+            return std::vector<uint8_t>(m_values.cbegin() + m_offsets[row], m_values.cbegin() + m_offsets[row + 1]);
+        }
+
+    private:
+
+        static bool get_bit(const std::vector<uint8_t>& bits, size_t index)
+        {
+            return (bits[index / 8] & (1 << (index % 8))) != 0;
+        }
+
+        template<typename V>
+        V get_fixed_value(size_t row) const
+        {
+            V value;
+            std::memcpy(&value, m_values.data() + row * sizeof(V), sizeof(V));
+            return value;
+        }
+
+        WASTORAGE_API void append(const entity_property& value);
+        WASTORAGE_API void append_text(const std::string& value);
+        WASTORAGE_API void append_null();
+        WASTORAGE_API void clear();
+        void append_validity(bool has_value);
+
+        utility::string_t m_name;
+        edm_type m_type;
+        size_t m_size;
+        size_t m_null_count;
+        std::vector<uint8_t> m_validity;
+        std::vector<uint8_t> m_values;
+        std::vector<int32_t> m_offsets;
+
+        friend class table_column_batch_receiver;
+    };
+
+    /// <summary>
+    /// Represents a batch of entities read by a query, with a <see cref="wa::storage::table_column"/> for the partition keys, one for the
+    /// row keys and one for each projected property.
+    /// </summary>
+    class table_column_batch
+    {
+    public:
+
+        /// <summary>
+        /// Gets the number of rows in the batch.
+        /// </summary>
+        /// <returns>The number of rows.</returns>
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        /// <summary>
+        /// Gets the partition keys of the entities.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::table_column"/> object.</returns>
+        const table_column& partition_keys() const
+        {
+            return m_partition_keys;
+        }
+
+        /// <summary>
+        /// Gets the row keys of the entities.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::table_column"/> object.</returns>
+        const table_column& row_keys() const
+        {
+            return m_row_keys;
+        }
+
+        /// <summary>
+        /// Gets the columns of the projected properties, in the order they were specified.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="wa::storage::table_column"/> objects.</returns>
+        const std::vector<table_column>& columns() const
+        {
+            return m_columns;
+        }
+
+    private:
+
+        table_column_batch()
+            : m_size(0), m_partition_keys(U("PartitionKey"), edm_type::string), m_row_keys(U("RowKey"), edm_type::string)
+        {
+        }
+
+        size_t m_size;
+        table_column m_partition_keys;
+        table_column m_row_keys;
+        std::vector<table_column> m_columns;
+
+        friend class table_column_batch_receiver;
+    };
+
+    /// <summary>
+    /// Receives the entities read by a query into columns, passing the rows to a handler in batches of a fixed size.
+    /// </summary>
+    /// <remarks>
+    /// The columns of a batch are cleared and reused once the handler returns, so a handler that needs the values later copies them.
+    /// Properties that are not projected, the timestamps and the ETags are skipped.
+    /// </remarks>
+    class table_column_batch_receiver : public table_entity_receiver
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_column_batch_receiver" /> class.
+        /// </summary>
+        /// <param name="columns">The names of the projected properties and the types their values are stored as.</param>
+        /// <param name="batch_size">The number of rows passed to the handler at a time.</param>
+        /// <param name="handler">A function that is called for each batch. Returning <c>false</c> stops the query.</param>
+        WASTORAGE_API table_column_batch_receiver(const std::vector<std::pair<utility::string_t, edm_type>>& columns, size_t batch_size, std::function<bool (const table_column_batch&)> handler);
+
+        WASTORAGE_API virtual int property_index(const std::string& name) const;
+        WASTORAGE_API virtual edm_type property_type(int index) const;
+        WASTORAGE_API virtual void begin_entity();
+        WASTORAGE_API virtual void set_partition_key(const utility::string_t& value);
+        WASTORAGE_API virtual void set_row_key(const utility::string_t& value);
+        WASTORAGE_API virtual void set_timestamp(const utility::datetime& value);
+        WASTORAGE_API virtual void set_etag(const utility::string_t& value);
+        WASTORAGE_API virtual void set_property(int index, const entity_property& value);
+        WASTORAGE_API virtual bool end_entity();
+
+        /// <summary>
+        /// Passes the rows that are left after the last full batch to the handler, once the query has ended.
+        /// </summary>
+        WASTORAGE_API void finish();
+
+    private:
+
+        bool handle_batch();
+
+        table_column_batch m_batch;
+        std::vector<std::string> m_utf8_names;
+        std::vector<bool> m_received;
+        size_t m_batch_size;
+        std::function<bool (const table_column_batch&)> m_handler;
+        bool m_stopped;
+    };
+
+    /// <summary>
+    /// Represents the settings of the cache a <see cref="wa::storage::cloud_table_client"/> keeps of the entities read by retrieve operations.
+    /// </summary>
+    /// <remarks>
+    /// A cached entity is returned without a request until its time to live has passed. After that, the next retrieve asks the service
+    /// for the entity only if its ETag has changed. Write operations executed through the same client remove the entities they change,
+    /// but changes made by other clients are only seen once the time to live has passed.
+    /// </remarks>
+    class table_entity_cache_settings
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_entity_cache_settings" /> class, which disables the cache.
+        /// </summary>
+        table_entity_cache_settings()
+            : m_max_entities(0), m_time_to_live(protocol::default_entity_cache_time_to_live)
+        {
+        }
+
+        /// <summary>
+        /// Gets the maximum number of entities that are cached. The least recently used entities are removed first.
+        /// </summary>
+        /// <returns>The maximum number of entities, or 0 if the cache is disabled.</returns>
+        size_t max_entities() const
+        {
+            return m_max_entities;
+        }
+
+        /// <summary>
+        /// Sets the maximum number of entities that are cached. The least recently used entities are removed first.
+        /// </summary>
+        /// <param name="value">The maximum number of entities, or 0 to disable the cache.</param>
+        void set_max_entities(size_t value)
+        {
+            m_max_entities = value;
+        }
+
+        /// <summary>
+        /// Gets the amount of time a cached entity is returned without asking the service whether it has changed.
+        /// </summary>
+        /// <returns>The time to live.</returns>
+        const std::chrono::seconds& time_to_live() const
+        {
+            return m_time_to_live;
+        }
+
+        /// <summary>
+        /// Sets the amount of time a cached entity is returned without asking the service whether it has changed.
+        /// </summary>
+        /// <param name="value">The time to live.</param>
+        void set_time_to_live(const std::chrono::seconds& value)
+        {
+            m_time_to_live = value;
+        }
+
+    private:
+
+        size_t m_max_entities;
+        std::chrono::seconds m_time_to_live;
+    };
+
+    /// <summary>
+    /// Represents the sampled requests of the table operations that addressed a partition.
+    /// </summary>
+    class table_partition_statistics
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_partition_statistics" /> class.
+        /// </summary>
+        /// <param name="table_name">The name of the table.</param>
+        /// <param name="partition_key">The partition key.</param>
+        /// <param name="operation_count">The number of sampled requests.</param>
+        /// <param name="throttled_count">The number of sampled requests that the service throttled.</param>
+        /// <param name="total_latency">The sum of how long the sampled requests took.</param>
+        table_partition_statistics(utility::string_t table_name, utility::string_t partition_key, uint64_t operation_count, uint64_t throttled_count, std::chrono::microseconds total_latency)
+            : m_table_name(std::move(table_name)), m_partition_key(std::move(partition_key)), m_operation_count(operation_count), m_throttled_count(throttled_count), m_total_latency(total_latency)
+        {
+        }
+
+        /// <summary>
+        /// Gets the name of the table.
+        /// </summary>
+        /// <returns>The name of the table.</returns>
+        const utility::string_t& table_name() const
+        {
+            return m_table_name;
+        }
+
+        /// <summary>
+        /// Gets the partition key.
+        /// </summary>
+        /// <returns>The partition key.</returns>
+        const utility::string_t& partition_key() const
+        {
+            return m_partition_key;
+        }
+
+        /// <summary>
+        /// Gets the number of sampled requests, including retries, that addressed the partition.
+        /// </summary>
+        /// <returns>The number of sampled requests.</returns>
+        uint64_t operation_count() const
+        {
+            return m_operation_count;
+        }
+
+        /// <summary>
+        /// Gets the number of sampled requests that the service throttled, with the status code 503 (Server Busy) or 429.
+        /// </summary>
+        /// <returns>The number of throttled requests.</returns>
+        uint64_t throttled_count() const
+        {
+            return m_throttled_count;
+        }
+
+        /// <summary>
+        /// Gets the fraction of the sampled requests that the service throttled.
+        /// </summary>
+        /// <returns>The throttle rate, between 0 and 1.</returns>
+        double throttle_rate() const
+        {
+            return m_operation_count == 0 ? 0.0 : static_cast<double>(m_throttled_count) / static_cast<double>(m_operation_count);
+        }
+
+        /// <summary>
+        /// Gets how long the sampled requests took on average, from building the request to processing the response.
+        /// </summary>
+        /// <returns>The average latency.</returns>
+        std::chrono::microseconds average_latency() const
+        {
+            return m_operation_count == 0 ? std::chrono::microseconds(0) : std::chrono::microseconds(m_total_latency.count() / static_cast<std::chrono::microseconds::rep>(m_operation_count));
+        }
+
+    private:
+
+        utility::string_t m_table_name;
+        utility::string_t m_partition_key;
+        uint64_t m_operation_count;
+        uint64_t m_throttled_count;
+        std::chrono::microseconds m_total_latency;
+    };
+
+    /// <summary>
+    /// Provides a client-side logical representation of the Windows Azure Table service. 
+    /// This client is used to configure and execute requests against the Table service.
+    /// </summary>
+    /// <remarks>The service client encapsulates the base URI for the Table service. 
+    /// If the service client will be used for authenticated access, it also encapsulates the 
+    /// credentials for accessing the storage account.</remarks>
+    class cloud_table_client : public cloud_client
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class.
+        /// </summary>
+        cloud_table_client()
+            : cloud_client()
+        {
+            initialize();
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class using the specified Table service endpoint
+        /// and anonymous credentials.
+        /// </summary>
+        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Table service endpoint for all locations.</param>
+        cloud_table_client(const storage_uri& base_uri)
+            : cloud_client(base_uri)
+        {
+            initialize();
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class using the specified Table service endpoint
+        /// and account credentials.
+        /// </summary>
+        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Table service endpoint for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        cloud_table_client(const storage_uri& base_uri, const storage_credentials& credentials)
+            : cloud_client(base_uri, credentials)
+        {
+            initialize();
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::cloud_table_client" /> class using the specified Table service endpoint
+        /// and account credentials.
+        /// </summary>
+        /// <param name="base_uri">A <see cref="storage_uri" /> object containing the Table service endpoint for all locations.</param>
+        /// <param name="credentials">The <see cref="storage_credentials" /> to use.</param>
+        cloud_table_client(const storage_uri& base_uri, const storage_credentials& credentials, const table_request_options& default_request_options)
+            : cloud_client(base_uri, credentials), m_default_request_options(default_request_options)
+        {
+            initialize();
+        }
+
+        /// <summary>
+        /// Sets the authentication scheme to use to sign HTTP requests.
+        /// </summary>
+        /// <param name="value">The authentication scheme.</param>
+        WASTORAGE_API void set_authentication_scheme(wa::storage::authentication_scheme value) override;
+
+        /// <summary>
+        /// Returns an enumerable collection of tables.
+        /// </summary>
+        /// <returns>An enumerable collection of <see cref="cloud_table" /> objects.</returns>
+        std::vector<cloud_table> list_tables() const
+        {
+            return list_tables_async(utility::string_t(), table_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Returns an enumerable collection of tables, retrieved lazily, that begin with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The table name prefix.</param>
+        /// <returns>An enumerable collection of <see cref="cloud_table" /> objects that are retrieved lazily.</returns>
+        std::vector<cloud_table> list_tables(const utility::string_t& prefix) const
+        {
+            return list_tables_async(prefix, table_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Returns an enumerable collection of tables that begin with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The table name prefix.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>An enumerable collection of <see cref="cloud_table" /> objects.</returns>
+        std::vector<cloud_table> list_tables(const utility::string_t& prefix, const table_request_options& options, operation_context context) const
+        {
+            return list_tables_async(prefix, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that returns an enumerable collection of tables.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="cloud_table" />, that represents the current operation.</returns>
+        pplx::task<std::vector<cloud_table>> list_tables_async() const
+        {
+            return list_tables_async(utility::string_t(), table_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that returns an enumerable collection of tables, retrieved lazily, that begin with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The table name prefix.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="cloud_table" />, that represents the current operation.</returns>
+        pplx::task<std::vector<cloud_table>> list_tables_async(const utility::string_t& prefix) const
+        {
+            return list_tables_async(prefix, table_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that returns an enumerable collection of tables that begin with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The table name prefix.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="cloud_table" />, that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<std::vector<cloud_table>> list_tables_async(const utility::string_t& prefix, const table_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Returns a <see cref="table_result_segment" /> containing an enumerable collection of tables.
+        /// </summary>
+        /// <param name="continuation_token">A <see cref="wa::storage::continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="table_result_segment" /> containing an enumerable collection of tables.</returns>
+        table_result_segment list_tables_segmented(const continuation_token& continuation_token) const
+        {
+            return list_tables_segmented_async(utility::string_t(), 0, continuation_token, table_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Returns a <see cref="table_result_segment" /> containing an enumerable collection of tables, retrieved lazily, that begin with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The table name prefix.</param>
+        /// <param name="continuation_token">A <see cref="wa::storage::continuation_token" /> returned by a previous listing operation.</param>
+        /// <returns>A <see cref="table_result_segment" /> containing an enumerable collection of tables.</returns>
+        table_result_segment list_tables_segmented(const utility::string_t& prefix, const continuation_token& continuation_token) const
+        {
+            return list_tables_segmented_async(prefix, 0, continuation_token, table_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Returns a <see cref="table_result_segment" /> containing an enumerable collection of tables that begin with the specified prefix.
+        /// </summary>
+        /// <param name="prefix">The table name prefix.</param>
+        /// <param name="max_results">A non-negative integer value that indicates the maximum number of results to be returned at a time, up to the 
+        /// per-operation limit of 5000. If this value is zero the maximum possible number of results will be returned, up to 5000.</param>
+        /// <param name="continuation_token">A <see cref="wa::storage::continuation_token"/> returned by a previous listing operation.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="table_result_segment" /> containing an enumerable collection of tables.</returns>
+        table_result_segment list_tables_segmented(const utility::string_t& prefix, int max_results, const continuation_token& continuation_token, const table_request_options& options, operation_context context) const
+        {
+            return list_tables_segmented_async(prefix, max_results, continuation_token, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that returns a <see cref="table_result_segment" /> containing an enumerable collection of tables.
         /// </summary>
         /// <param name="continuation_token">A <see cref="wa::storage::continuation_token" /> returned by a previous listing operation.</param>
         /// <returns>A <see cref="pplx::task" /> object of type <see cref="table_result_segment" /> that represents the current operation.</returns>
@@ -1953,16 +3301,74 @@ namespace wa { namespace storage {
             return m_default_request_options;
         }
 
-    private:
+        /// <summary>
+        /// Gets the settings of the cache of entities read by retrieve operations.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::table_entity_cache_settings" /> object.</returns>
+        WASTORAGE_API table_entity_cache_settings entity_cache_settings() const;
+
+        /// <summary>
+        /// Sets the settings of the cache of entities read by retrieve operations.
+        /// </summary>
+        /// <param name="value">A <see cref="wa::storage::table_entity_cache_settings" /> object.</param>
+        /// <remarks>The cache is shared by all copies of the service client and all tables created from it, so the new settings
+        /// apply to operations executed through any of them. Changing the settings empties the cache.</remarks>
+        WASTORAGE_API void set_entity_cache_settings(const table_entity_cache_settings& value);
 
-        void initialize()
+        /// <summary>
+        /// Gets the cache of entities read by retrieve operations.
+        /// </summary>
+        /// <returns>The entity cache.</returns>
+        std::shared_ptr<core::table_entity_cache> entity_cache() const
+        {
+            return m_entity_cache;
+        }
+
+        /// <summary>
+        /// Gets the fraction of table operations whose requests are sampled by the partition they address.
+        /// </summary>
+        /// <returns>The sampling rate, between 0 and 1, which is 0 if no operations are sampled.</returns>
+        WASTORAGE_API double partition_sampling_rate() const;
+
+        /// <summary>
+        /// Sets the fraction of table operations whose requests are sampled by the partition they address.
+        /// </summary>
+        /// <param name="value">The sampling rate, between 0 and 1. Setting it to 0 stops sampling and discards the statistics.</param>
+        /// <remarks>Entity operations and batches are sampled, while queries are not. The samples are spread evenly over the operations,
+        /// and every request of a sampled operation is recorded, including its retries. The statistics are shared by all copies of the
+        /// service client and all tables created from it.</remarks>
+        WASTORAGE_API void set_partition_sampling_rate(double value);
+
+        /// <summary>
+        /// Gets the partitions that the most sampled requests addressed.
+        /// </summary>
+        /// <param name="count">The largest number of partitions to return.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::table_partition_statistics" /> objects, busiest first.</returns>
+        WASTORAGE_API std::vector<table_partition_statistics> hot_partitions(size_t count) const;
+
+        /// <summary>
+        /// Discards the statistics of the sampled partitions.
+        /// </summary>
+        WASTORAGE_API void reset_partition_statistics();
+
+        /// <summary>
+        /// Gets the statistics of the requests sampled by partition.
+        /// </summary>
+        /// <returns>The partition tracker.</returns>
+        std::shared_ptr<core::partition_tracker> partition_tracker() const
         {
-            set_authentication_scheme(authentication_scheme::shared_key);
+            return m_partition_tracker;
         }
 
+    private:
+
+        WASTORAGE_API void initialize();
+
         table_request_options get_modified_options(const table_request_options& options) const;
 
         table_request_options m_default_request_options;
+        std::shared_ptr<core::table_entity_cache> m_entity_cache;
+        std::shared_ptr<core::partition_tracker> m_partition_tracker;
     };
 
     /// <summary>
@@ -2034,47 +3440,95 @@ namespace wa { namespace storage {
         WASTORAGE_API pplx::task<table_result> execute_async(const table_operation& operation, const table_request_options& options, operation_context context) const;
 
         /// <summary>
-        /// Executes a batch operation on a table as an atomic operation.
+        /// Executes a batch operation on a table as an atomic operation.
+        /// </summary>
+        /// <param name="operation">A <see cref="wa::storage::table_batch_operation"/> object that represents the operation to perform.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::table_result"/> objects that contains the results, in order, 
+        /// of each operation in the <see cref="wa::storage::table_batch_operation"/>.</returns>
+        std::vector<table_result> execute_batch(const table_batch_operation& operation) const
+        {
+            return execute_batch_async(operation, table_request_options(), operation_context()).get();
+        }
+
+        /// <summary>
+        /// Executes a batch operation on a table as an atomic operation.
+        /// </summary>
+        /// <param name="operation">A <see cref="wa::storage::table_batch_operation"/> object that represents the operation to perform.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::table_result"/> objects that contains the results, in order, 
+        /// of each operation in the <see cref="wa::storage::table_batch_operation"/>.</returns>
+        std::vector<table_result> execute_batch(const table_batch_operation& operation, const table_request_options& options, operation_context context) const
+        {
+            return execute_batch_async(operation, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a batch operation on a table as an atomic operation.
+        /// </summary>
+        /// <param name="operation">A <see cref="wa::storage::table_batch_operation" /> object that represents the operation to perform.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="table_result" />, that represents the current operation.</returns>
+        pplx::task<std::vector<table_result>> execute_batch_async(const table_batch_operation& operation) const
+        {
+            return execute_batch_async(operation, table_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a batch operation on a table as an atomic operation.
+        /// </summary>
+        /// <param name="operation">A <see cref="wa::storage::table_batch_operation" /> object that represents the operation to perform.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="table_result" />, that represents the current operation.</returns>
+        WASTORAGE_API pplx::task<std::vector<table_result>> execute_batch_async(const table_batch_operation& operation, const table_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Retrieves the entities with the specified keys from a table.
         /// </summary>
-        /// <param name="operation">A <see cref="wa::storage::table_batch_operation"/> object that represents the operation to perform.</param>
-        /// <returns>An enumerable collection of <see cref="wa::storage::table_result"/> objects that contains the results, in order, 
-        /// of each operation in the <see cref="wa::storage::table_batch_operation"/>.</returns>
-        std::vector<table_result> execute_batch(const table_batch_operation& operation) const
+        /// <param name="keys">The partition key and row key of each entity to retrieve.</param>
+        /// <returns>An enumerable collection of <see cref="wa::storage::table_result"/> objects that contains the results, in the order of the keys.
+        /// The result of an entity that does not exist has the status code 404 (Not Found).</returns>
+        std::vector<table_result> retrieve_entities(const std::vector<std::pair<utility::string_t, utility::string_t>>& keys) const
         {
-            return execute_batch_async(operation, table_request_options(), operation_context()).get();
+            return retrieve_entities_async(keys, table_request_options(), operation_context()).get();
         }
 
         /// <summary>
-        /// Executes a batch operation on a table as an atomic operation.
+        /// Retrieves the entities with the specified keys from a table.
         /// </summary>
-        /// <param name="operation">A <see cref="wa::storage::table_batch_operation"/> object that represents the operation to perform.</param>
+        /// <param name="keys">The partition key and row key of each entity to retrieve.</param>
         /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
-        /// <returns>An enumerable collection of <see cref="wa::storage::table_result"/> objects that contains the results, in order, 
-        /// of each operation in the <see cref="wa::storage::table_batch_operation"/>.</returns>
-        std::vector<table_result> execute_batch(const table_batch_operation& operation, const table_request_options& options, operation_context context) const
+        /// <returns>An enumerable collection of <see cref="wa::storage::table_result"/> objects that contains the results, in the order of the keys.
+        /// The result of an entity that does not exist has the status code 404 (Not Found).</returns>
+        std::vector<table_result> retrieve_entities(const std::vector<std::pair<utility::string_t, utility::string_t>>& keys, const table_request_options& options, operation_context context) const
         {
-            return execute_batch_async(operation, options, context).get();
+            return retrieve_entities_async(keys, options, context).get();
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation that executes a batch operation on a table as an atomic operation.
+        /// Returns a task that performs an asynchronous operation that retrieves the entities with the specified keys from a table.
         /// </summary>
-        /// <param name="operation">A <see cref="wa::storage::table_batch_operation" /> object that represents the operation to perform.</param>
+        /// <param name="keys">The partition key and row key of each entity to retrieve.</param>
         /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="table_result" />, that represents the current operation.</returns>
-        pplx::task<std::vector<table_result>> execute_batch_async(const table_batch_operation& operation) const
+        pplx::task<std::vector<table_result>> retrieve_entities_async(const std::vector<std::pair<utility::string_t, utility::string_t>>& keys) const
         {
-            return execute_batch_async(operation, table_request_options(), operation_context());
+            return retrieve_entities_async(keys, table_request_options(), operation_context());
         }
 
         /// <summary>
-        /// Returns a task that performs an asynchronous operation that executes a batch operation on a table as an atomic operation.
+        /// Returns a task that performs an asynchronous operation that retrieves the entities with the specified keys from a table.
         /// </summary>
-        /// <param name="operation">A <see cref="wa::storage::table_batch_operation" /> object that represents the operation to perform.</param>
+        /// <param name="keys">The partition key and row key of each entity to retrieve.</param>
         /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
         /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="table_result" />, that represents the current operation.</returns>
-        WASTORAGE_API pplx::task<std::vector<table_result>> execute_batch_async(const table_batch_operation& operation, const table_request_options& options, operation_context context) const;
+        /// <remarks>
+        /// The keys are grouped by partition. The entities of a partition with few keys are retrieved one by one, and those of a partition
+        /// with more keys are read by queries that each match several row keys. Up to <see cref="wa::storage::table_request_options::parallelism_factor" />
+        /// requests are sent at the same time. The result of a key that appears more than once is repeated at each of its positions.
+        /// </remarks>
+        WASTORAGE_API pplx::task<std::vector<table_result>> retrieve_entities_async(const std::vector<std::pair<utility::string_t, utility::string_t>>& keys, const table_request_options& options, operation_context context) const;
 
         /// <summary>
         /// Executes a query on a table.
@@ -2115,8 +3569,164 @@ namespace wa { namespace storage {
         /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
         /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
         /// <returns>A <see cref="pplx::task" /> object of type <see cref="std::vector" />, of type <see cref="table_entity" />, that represents the current operation.</returns>
+        /// <remarks>
+        /// When <see cref="wa::storage::table_request_options::parallelism_factor" /> is greater than one and the filter of the query names
+        /// several PartitionKeys or ranges of them, such as PartitionKeys combined with <see cref="wa::storage::query_logical_operator::or" />,
+        /// each is queried on its own, as <see cref="cloud_table::execute_query_parallel_async" /> does, and the entities are returned in the same order.
+        /// </remarks>
         WASTORAGE_API pplx::task<std::vector<table_entity>> execute_query_async(const table_query& query, const table_request_options& options, operation_context context) const;
 
+        /// <summary>
+        /// Executes a query on a table, keeping the results in memory up to a limit and writing the rest to a file.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query" /> representing the query to execute.</param>
+        /// <param name="max_memory_size">The approximate number of bytes that the entities kept in memory may take up.</param>
+        /// <param name="spill_directory">The directory that the file of the entities beyond the limit is created in.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="wa::storage::table_query_result" /> object that reads the results.</returns>
+        table_query_result execute_query(const table_query& query, size_t max_memory_size, const utility::string_t& spill_directory, const table_request_options& options, operation_context context) const
+        {
+            return execute_query_async(query, max_memory_size, spill_directory, options, context).get();
+        }
+
+        /// <summary>
+        /// Returns a task that executes a query on a table, keeping the results in memory up to a limit and writing the rest to a file.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query" /> representing the query to execute.</param>
+        /// <param name="max_memory_size">The approximate number of bytes that the entities kept in memory may take up.</param>
+        /// <param name="spill_directory">The directory that the file of the entities beyond the limit is created in.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation.</param>
+        /// <returns>A <see cref="pplx::task" /> object of type <see cref="wa::storage::table_query_result" /> that represents the current operation.</returns>
+        /// <remarks>
+        /// Once the entities in memory reach the limit, every later entity is written to the file as soon as it is parsed, in a compact binary
+        /// form that keeps the type of every property. The file is only created if the limit is reached.
+        /// </remarks>
+        WASTORAGE_API pplx::task<table_query_result> execute_query_async(const table_query& query, size_t max_memory_size, const utility::string_t& spill_directory, const table_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Executes a query on a table, passing each entity to a handler as soon as the segment that contains it has been received.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="handler">A function that is called for each entity in query order. Returning <c>false</c> stops the query.</param>
+        void execute_query(const table_query& query, std::function<bool (const table_entity&)> handler) const
+        {
+            execute_query_async(query, std::move(handler), true, table_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Executes a query on a table, passing each entity to a handler as soon as the segment that contains it has been received.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="handler">A function that is called for each entity in query order. Returning <c>false</c> stops the query.</param>
+        /// <param name="prefetch"><c>true</c> to request the next segment before the entities of the current one are passed to the handler.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        void execute_query(const table_query& query, std::function<bool (const table_entity&)> handler, bool prefetch, const table_request_options& options, operation_context context) const
+        {
+            execute_query_async(query, std::move(handler), prefetch, options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a query on a table, passing each entity to a handler
+        /// as soon as the segment that contains it has been received.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="handler">A function that is called for each entity in query order. Returning <c>false</c> stops the query.</param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        pplx::task<void> execute_query_async(const table_query& query, std::function<bool (const table_entity&)> handler) const
+        {
+            return execute_query_async(query, std::move(handler), true, table_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a query on a table, passing each entity to a handler
+        /// as soon as the segment that contains it has been received.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="handler">A function that is called for each entity in query order. Returning <c>false</c> stops the query.</param>
+        /// <param name="prefetch"><c>true</c> to request the next segment before the entities of the current one are passed to the handler.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// Only the segments that are being handled or fetched are held in memory, so the memory used does not grow with the number of results.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> execute_query_async(const table_query& query, std::function<bool (const table_entity&)> handler, bool prefetch, const table_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Executes a query on a table, storing each entity in an object of an application type that is passed to a handler.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="mapping">A <see cref="wa::storage::table_entity_mapping"/> object that maps the properties of the entities to the members of the type.</param>
+        /// <param name="handler">A function that is called for each object in query order. Returning <c>false</c> stops the query.</param>
+        template<typename T>
+        void execute_query(const table_query& query, const table_entity_mapping<T>& mapping, std::function<bool (const typename table_entity_mapping<T>::value_type&)> handler) const
+        {
+            execute_query_async(query, mapping.create_receiver(std::move(handler)), table_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a query on a table, storing each entity in an object
+        /// of an application type that is passed to a handler.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="mapping">A <see cref="wa::storage::table_entity_mapping"/> object that maps the properties of the entities to the members of the type.</param>
+        /// <param name="handler">A function that is called for each object in query order. Returning <c>false</c> stops the query.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        template<typename T>
+        pplx::task<void> execute_query_async(const table_query& query, const table_entity_mapping<T>& mapping, std::function<bool (const typename table_entity_mapping<T>::value_type&)> handler, const table_request_options& options, operation_context context) const
+        {
+            return execute_query_async(query, mapping.create_receiver(std::move(handler)), options, context);
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a query on a table, passing the properties of each entity
+        /// to a receiver as they are read from the response.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="receiver">A <see cref="wa::storage::table_entity_receiver"/> object that receives the entities in query order.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The receiver is called while the response is still downloading. If a request is retried, entities that were already
+        /// received are skipped, so each entity is seen at most once.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> execute_query_async(const table_query& query, std::shared_ptr<table_entity_receiver> receiver, const table_request_options& options, operation_context context) const;
+
+        /// <summary>
+        /// Executes a query on a table, reading the entities into columns that are passed to a handler in batches.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="columns">The names of the projected properties and the types their values are stored as.</param>
+        /// <param name="batch_size">The number of rows passed to the handler at a time. The last batch may have fewer.</param>
+        /// <param name="handler">A function that is called for each <see cref="wa::storage::table_column_batch"/> in query order. Returning <c>false</c> stops the query.</param>
+        void execute_query_columnar(const table_query& query, const std::vector<std::pair<utility::string_t, edm_type>>& columns, size_t batch_size, std::function<bool (const table_column_batch&)> handler) const
+        {
+            execute_query_columnar_async(query, columns, batch_size, std::move(handler), table_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a query on a table, reading the entities into columns
+        /// that are passed to a handler in batches.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="columns">The names of the projected properties and the types their values are stored as.</param>
+        /// <param name="batch_size">The number of rows passed to the handler at a time. The last batch may have fewer.</param>
+        /// <param name="handler">A function that is called for each <see cref="wa::storage::table_column_batch"/> in query order. Returning <c>false</c> stops the query.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The values are appended to the columns as the response is read, without building a <see cref="wa::storage::table_entity"/>.
+        /// If the query does not select any columns, only the projected properties are requested.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> execute_query_columnar_async(const table_query& query, const std::vector<std::pair<utility::string_t, edm_type>>& columns, size_t batch_size, std::function<bool (const table_column_batch&)> handler, const table_request_options& options, operation_context context) const;
+
         /// <summary>
         /// Executes a query with the specified <see cref="wa::storage::continuation_token"/> to retrieve the next page of results.
         /// </summary>
@@ -2162,6 +3772,59 @@ namespace wa { namespace storage {
         /// <returns>A <see cref="pplx::task" /> object of type <see cref="table_result_segment" /> that represents the current operation.</returns>
         WASTORAGE_API pplx::task<table_query_segment> execute_query_segmented_async(const table_query& query, continuation_token continuation_token, const table_request_options& options, operation_context context) const;
 
+        /// <summary>
+        /// Executes a query on a table by splitting it into PartitionKey ranges that are queried concurrently, passing the entities
+        /// of all the ranges to a single handler.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="partition_key_boundaries">The partition keys that separate the ranges, in ascending order. Each boundary starts a new range,
+        /// so N boundaries split the table into N + 1 ranges.</param>
+        /// <param name="preserve_order"><c>true</c> to pass the entities in the order of a serial query; <c>false</c> to pass them as soon as they are received.</param>
+        /// <param name="handler">A function that is called for each entity. Returning <c>false</c> stops the query.</param>
+        void execute_query_parallel(const table_query& query, const std::vector<utility::string_t>& partition_key_boundaries, bool preserve_order, std::function<bool (const table_entity&)> handler) const
+        {
+            execute_query_parallel_async(query, partition_key_boundaries, preserve_order, std::move(handler), table_request_options(), operation_context()).wait();
+        }
+
+        /// <summary>
+        /// Executes a query on a table by splitting it into PartitionKey ranges that are queried concurrently, passing the entities
+        /// of all the ranges to a single handler.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="partition_key_boundaries">The partition keys that separate the ranges, in ascending order. Each boundary starts a new range,
+        /// so N boundaries split the table into N + 1 ranges.</param>
+        /// <param name="preserve_order"><c>true</c> to pass the entities in the order of a serial query; <c>false</c> to pass them as soon as they are received.</param>
+        /// <param name="handler">A function that is called for each entity. Returning <c>false</c> stops the query.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        void execute_query_parallel(const table_query& query, const std::vector<utility::string_t>& partition_key_boundaries, bool preserve_order, std::function<bool (const table_entity&)> handler, const table_request_options& options, operation_context context) const
+        {
+            execute_query_parallel_async(query, partition_key_boundaries, preserve_order, std::move(handler), options, context).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that performs an asynchronous operation that executes a query on a table by splitting it into PartitionKey ranges
+        /// that are queried concurrently, passing the entities of all the ranges to a single handler.
+        /// </summary>
+        /// <param name="query">A <see cref="wa::storage::table_query"/> object.</param>
+        /// <param name="partition_key_boundaries">The partition keys that separate the ranges, in ascending order. Each boundary starts a new range,
+        /// so N boundaries split the table into N + 1 ranges.</param>
+        /// <param name="preserve_order"><c>true</c> to pass the entities in the order of a serial query; <c>false</c> to pass them as soon as they are received.</param>
+        /// <param name="handler">A function that is called for each entity. Returning <c>false</c> stops the query.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for the request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the current operation. This object is used to track requests to the storage service, and to provide additional runtime information about the operation. </param>
+        /// <returns>A <see cref="pplx::task" /> object that represents the current operation.</returns>
+        /// <remarks>
+        /// The ranges are first derived from the PartitionKey conditions of the filter, as written by <see cref="table_query::generate_filter_condition" />
+        /// and <see cref="table_query::combine_filter_conditions" />: only the PartitionKeys the filter can match are queried, and each PartitionKey
+        /// or range of them that the filter names is queried on its own. The boundaries then split those ranges further, so an empty collection
+        /// of boundaries queries just the ranges of the filter.
+        /// Up to <see cref="wa::storage::table_request_options::parallelism_factor" /> ranges are queried at the same time. The handler is never called
+        /// concurrently. When the order is preserved, the entities of a range are held back until all the ranges before it have been passed
+        /// to the handler, so memory use grows with the amount of data that later ranges read ahead.
+        /// </remarks>
+        WASTORAGE_API pplx::task<void> execute_query_parallel_async(const table_query& query, const std::vector<utility::string_t>& partition_key_boundaries, bool preserve_order, std::function<bool (const table_entity&)> handler, const table_request_options& options, operation_context context) const;
+
         /// <summary>
         /// Creates a table.
         /// </summary>
@@ -2488,6 +4151,8 @@ namespace wa { namespace storage {
         pplx::task<bool> create_async_impl(const table_request_options& options, operation_context context, bool allow_conflict);
         pplx::task<bool> delete_async_impl(const table_request_options& options, operation_context context, bool allow_not_found);
         pplx::task<bool> exists_async_impl(const table_request_options& options, operation_context context, bool allow_secondary) const;
+        pplx::task<table_result> execute_async_impl(const table_operation& operation, const utility::string_t& if_none_match, const table_request_options& modified_options, operation_context context) const;
+        pplx::task<table_result> retrieve_async_impl(const table_operation& operation, const utility::string_t& if_none_match, const table_request_options& modified_options, operation_context context) const;
 
         /*
         void set_service_client(const cloud_table_client& client)
@@ -2503,4 +4168,249 @@ namespace wa { namespace storage {
         friend class cloud_table_client;
     };
 
+    /// <summary>
+    /// Represents an operation written through a <see cref="wa::storage::table_bulk_writer"/> that failed.
+    /// </summary>
+    class table_bulk_failure
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_bulk_failure" /> class.
+        /// </summary>
+        /// <param name="operation">The operation that failed.</param>
+        /// <param name="error">The exception the operation failed with.</param>
+        table_bulk_failure(table_operation operation, std::exception_ptr error)
+            : m_operation(std::move(operation)), m_error(std::move(error))
+        {
+        }
+
+        /// <summary>
+        /// Gets the operation that failed.
+        /// </summary>
+        /// <returns>A <see cref="wa::storage::table_operation"/> object.</returns>
+        const table_operation& operation() const
+        {
+            return m_operation;
+        }
+
+        /// <summary>
+        /// Gets the exception the operation failed with, which is usually a <see cref="wa::storage::storage_exception"/>.
+        /// </summary>
+        /// <returns>A pointer to the exception, which can be rethrown with std::rethrow_exception.</returns>
+        std::exception_ptr error() const
+        {
+            return m_error;
+        }
+
+    private:
+
+        table_operation m_operation;
+        std::exception_ptr m_error;
+    };
+
+    /// <summary>
+    /// Writes a stream of entity operations to a table, grouping them into batch operations.
+    /// </summary>
+    /// <remarks>
+    /// Operations are collected per partition key and a batch is sent as soon as it is full, which is when it holds
+    /// 100 operations or its payload would grow beyond 4MB, or when an operation for an entity that is already in it is added.
+    /// Up to <see cref="wa::storage::table_request_options::parallelism_factor"/> batches are sent at the same time.
+    /// When a batch fails, which leaves all of its operations unapplied, its operations are executed one at a time so that
+    /// every failure can be reported for the operation that caused it.
+    /// A writer may not be used by more than one thread at the same time.
+    /// </remarks>
+    class table_bulk_writer
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_bulk_writer" /> class.
+        /// </summary>
+        /// <param name="table">The table to write to.</param>
+        explicit table_bulk_writer(const cloud_table& table)
+        {
+            initialize(table, table_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_bulk_writer" /> class.
+        /// </summary>
+        /// <param name="table">The table to write to.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        table_bulk_writer(const cloud_table& table, const table_request_options& options, operation_context context)
+        {
+            initialize(table, options, context);
+        }
+
+        /// <summary>
+        /// Adds an operation to be written. Retrieve operations are not supported.
+        /// </summary>
+        /// <param name="operation">A <see cref="wa::storage::table_operation" /> object that represents the operation to perform.</param>
+        void add(const table_operation& operation)
+        {
+            add_async(operation).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that adds an operation to be written. Retrieve operations are not supported.
+        /// </summary>
+        /// <param name="operation">A <see cref="wa::storage::table_operation" /> object that represents the operation to perform.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once the operation has been accepted, which is delayed
+        /// while the maximum number of batches are being sent. Another operation may only be added after it has completed.</returns>
+        WASTORAGE_API pplx::task<void> add_async(const table_operation& operation);
+
+        /// <summary>
+        /// Sends all operations that have been added and waits until every batch has been written.
+        /// </summary>
+        /// <returns>The operations that failed since the previous flush.</returns>
+        std::vector<table_bulk_failure> flush()
+        {
+            return flush_async().get();
+        }
+
+        /// <summary>
+        /// Returns a task that sends all operations that have been added and waits until every batch has been written.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that completes with the operations that failed since the previous flush.</returns>
+        WASTORAGE_API pplx::task<std::vector<table_bulk_failure>> flush_async();
+
+        /// <summary>
+        /// Gets the number of operations that may be waiting for their batch to fill up, across all partition keys.
+        /// </summary>
+        /// <returns>The maximum number of buffered operations.</returns>
+        size_t max_buffered_operations() const
+        {
+            return m_max_buffered_operations;
+        }
+
+        /// <summary>
+        /// Sets the number of operations that may be waiting for their batch to fill up, across all partition keys.
+        /// When it is reached, the largest batch is sent even though it is not full.
+        /// </summary>
+        /// <param name="value">The maximum number of buffered operations.</param>
+        void set_max_buffered_operations(size_t value)
+        {
+            m_max_buffered_operations = value;
+        }
+
+    private:
+
+        struct pending_batch
+        {
+            pending_batch()
+                : payload_size(0)
+            {
+            }
+
+            table_batch_operation operation;
+            size_t payload_size;
+            std::unordered_set<utility::string_t> row_keys;
+        };
+
+        struct shared_state;
+
+        WASTORAGE_API void initialize(const cloud_table& table, const table_request_options& options, operation_context context);
+        pplx::task<void> send_async(pending_batch& batch);
+
+        std::shared_ptr<shared_state> m_state;
+        std::unordered_map<utility::string_t, pending_batch> m_batches;
+        size_t m_buffered_operations;
+        size_t m_max_buffered_operations;
+    };
+
+    /// <summary>
+    /// Buffers writes of entities to a table for a flush interval, combining the writes of the same entity into one
+    /// and sending the buffered writes of each partition key as batch operations.
+    /// </summary>
+    /// <remarks>
+    /// A write that replaces an entity supersedes the buffered write of the same entity, and a write that merges an entity has its
+    /// properties merged into the buffered write, whose type is kept if it replaces the entity. The combined write keeps the ETag
+    /// of the earlier write, because that is the one the stored entity is checked against.
+    /// The writes buffered during a flush interval are sent together, and the next ones are only sent once they have been written,
+    /// so the writes of an entity are applied in order. Up to <see cref="wa::storage::table_request_options::parallelism_factor"/>
+    /// batches are sent at the same time, and the operations of a failed batch are executed one at a time, as with
+    /// <see cref="wa::storage::table_bulk_writer"/>. A buffer may be used by several threads at the same time.
+    /// </remarks>
+    class table_write_behind_buffer
+    {
+    public:
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_write_behind_buffer" /> class.
+        /// </summary>
+        /// <param name="table">The table to write to.</param>
+        explicit table_write_behind_buffer(const cloud_table& table)
+        {
+            initialize(table, table_request_options(), operation_context());
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="wa::storage::table_write_behind_buffer" /> class.
+        /// </summary>
+        /// <param name="table">The table to write to.</param>
+        /// <param name="options">A <see cref="wa::storage::table_request_options" /> object that specifies additional options for every request.</param>
+        /// <param name="context">An <see cref="wa::storage::operation_context" /> object that represents the context for the requests. This object is used to track requests to the storage service, and to provide additional runtime information about the operation.</param>
+        table_write_behind_buffer(const cloud_table& table, const table_request_options& options, operation_context context)
+        {
+            initialize(table, options, context);
+        }
+
+        /// <summary>
+        /// Writes an entity to the table, together with the other writes buffered during the flush interval.
+        /// </summary>
+        /// <param name="operation">An insert-or-replace, insert-or-merge, replace or merge <see cref="wa::storage::table_operation" /> object.</param>
+        void write(const table_operation& operation)
+        {
+            write_async(operation).wait();
+        }
+
+        /// <summary>
+        /// Returns a task that writes an entity to the table, together with the other writes buffered during the flush interval.
+        /// </summary>
+        /// <param name="operation">An insert-or-replace, insert-or-merge, replace or merge <see cref="wa::storage::table_operation" /> object.</param>
+        /// <returns>A <see cref="pplx::task" /> object that completes once the write, or the combined write that includes it, has been
+        /// applied to the table, or that fails with the exception the write failed with.</returns>
+        WASTORAGE_API pplx::task<void> write_async(const table_operation& operation);
+
+        /// <summary>
+        /// Sends the buffered writes without waiting for the flush interval, and waits until they have been applied.
+        /// </summary>
+        void flush()
+        {
+            flush_async().wait();
+        }
+
+        /// <summary>
+        /// Returns a task that sends the buffered writes without waiting for the flush interval.
+        /// </summary>
+        /// <returns>A <see cref="pplx::task" /> object that completes once every write buffered before the call has been sent,
+        /// and that fails with the exception of the first write that failed.</returns>
+        WASTORAGE_API pplx::task<void> flush_async();
+
+        /// <summary>
+        /// Gets the time after the first write into an empty buffer at which the buffered writes are sent.
+        /// </summary>
+        /// <returns>The flush interval.</returns>
+        WASTORAGE_API std::chrono::milliseconds flush_interval() const;
+
+        /// <summary>
+        /// Sets the time after the first write into an empty buffer at which the buffered writes are sent.
+        /// </summary>
+        /// <param name="value">The flush interval, or 0 to send every write as soon as possible.</param>
+        WASTORAGE_API void set_flush_interval(std::chrono::milliseconds value);
+
+    private:
+
+        struct shared_state;
+
+        table_write_behind_buffer(const table_write_behind_buffer&);
+        table_write_behind_buffer& operator=(const table_write_behind_buffer&);
+
+        WASTORAGE_API void initialize(const cloud_table& table, const table_request_options& options, operation_context context);
+
+        std::shared_ptr<shared_state> m_state;
+    };
+
 }} // namespace wa::storage
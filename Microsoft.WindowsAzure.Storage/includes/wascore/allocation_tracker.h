@@ -0,0 +1,92 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="allocation_tracker.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <atomic>
+
+#include "wascore/basic_types.h"
+#include "was/core.h"
+
+namespace wa { namespace storage { namespace core {
+
+    // Heap allocations counted for one request. The steps of a request run one after another, but a hedged request
+    // can run two of them at once, so the counters are atomic.
+    class allocation_counters
+    {
+    public:
+
+        allocation_counters()
+            : m_count(0), m_bytes(0)
+        {
+        }
+
+        void add(size_t size)
+        {
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        void reset()
+        {
+            m_count.store(0, std::memory_order_relaxed);
+            m_bytes.store(0, std::memory_order_relaxed);
+        }
+
+        request_allocations get() const
+        {
+            return request_allocations(m_count.load(std::memory_order_relaxed), m_bytes.load(std::memory_order_relaxed));
+        }
+
+    private:
+
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint64_t> m_bytes;
+    };
+
+    // Counts the heap allocations that the calling thread makes while the scope exists. Scopes nest, and an allocation
+    // is only counted by the innermost one. Allocations are only counted when the library is built with
+    // WASTORAGE_COUNT_ALLOCATIONS defined, which replaces the global operator new of the library.
+    class allocation_scope
+    {
+    public:
+
+        explicit allocation_scope(allocation_counters& counters)
+            : m_previous(exchange_current(&counters))
+        {
+        }
+
+        ~allocation_scope()
+        {
+            exchange_current(m_previous);
+        }
+
+        // Returns true if the library was built to count allocations
+        WASTORAGE_API static bool is_counting();
+
+    private:
+
+        allocation_scope(const allocation_scope&);
+        allocation_scope& operator=(const allocation_scope&);
+
+        WASTORAGE_API static allocation_counters* exchange_current(allocation_counters* counters);
+
+        allocation_counters* m_previous;
+    };
+
+}}} // namespace wa::storage::core
@@ -17,8 +17,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <mutex>
-#include <queue>
+#include <vector>
 
 #include "cpprest/asyncrt_utils.h"
 
@@ -30,39 +32,63 @@ namespace wa { namespace storage { namespace core {
     {
     public:
 
-        _async_semaphore(int count)
-            : m_count(count), m_initial_count(count)
+        _async_semaphore(int64_t count)
+            : m_count(count), m_initial_count(count), m_waiter_count(0)
         {
-            m_empty_event.set();
         }
 
-        pplx::task<void> lock_async();
-        void unlock();
-        pplx::task<void> wait_all_async();
+        WASTORAGE_API pplx::task<void> lock_async(int64_t weight);
+        WASTORAGE_API void unlock(int64_t weight);
+        WASTORAGE_API pplx::task<void> wait_all_async();
 
     private:
 
-        pplx::task_completion_event<void> dequeue_pending();
-
-        int m_count;
-        int m_initial_count;
-        pplx::task_completion_event<void> m_empty_event;
-        std::queue<pplx::task_completion_event<void>> m_queue;
+        struct waiter
+        {
+            int64_t weight;
+            pplx::task_completion_event<void> event;
+        };
+
+        int64_t clamp_weight(int64_t weight) const;
+        bool try_acquire(int64_t weight);
+        void grant_pending(std::vector<pplx::task_completion_event<void>>& granted);
+
+        std::atomic<int64_t> m_count;
+        const int64_t m_initial_count;
+        std::atomic<int> m_waiter_count;
+        std::deque<waiter> m_queue;
+        std::vector<pplx::task_completion_event<void>> m_empty_events;
         std::mutex m_mutex;
     };
 
+    /// <summary>
+    /// A semaphore whose units are acquired asynchronously, one at a time or several at once.
+    /// </summary>
+    /// <remarks>
+    /// Units are granted to waiters in the order they asked for them. While nobody is waiting,
+    /// locking and unlocking only update an atomic counter.
+    /// </remarks>
     class async_semaphore
     {
     public:
 
-        async_semaphore(int count)
+        async_semaphore(int64_t count)
             : m_semaphore(std::make_shared<_async_semaphore>(count))
         {
         }
 
         pplx::task<void> lock_async()
         {
-            return m_semaphore->lock_async();
+            return m_semaphore->lock_async(1);
+        }
+
+        /// <summary>
+        /// Returns a task that completes once the specified number of units have been acquired.
+        /// A weight above the count of the semaphore is reduced to it.
+        /// </summary>
+        pplx::task<void> lock_async(int64_t weight)
+        {
+            return m_semaphore->lock_async(weight);
         }
 
         void lock()
@@ -72,7 +98,15 @@ namespace wa { namespace storage { namespace core {
 
         void unlock()
         {
-            return m_semaphore->unlock();
+            m_semaphore->unlock(1);
+        }
+
+        /// <summary>
+        /// Releases the specified number of units, which must match the weight they were acquired with.
+        /// </summary>
+        void unlock(int64_t weight)
+        {
+            m_semaphore->unlock(weight);
         }
 
         pplx::task<void> wait_all_async()
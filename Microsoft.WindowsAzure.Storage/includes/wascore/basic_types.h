@@ -25,6 +25,13 @@
 #define WASTORAGE_API __declspec( dllimport )
 #endif
 
+// Static storage that every thread has its own copy of, which has to be plain data without a constructor
+#ifdef WIN32
+#define WASTORAGE_THREAD_LOCAL __declspec(thread)
+#else
+#define WASTORAGE_THREAD_LOCAL __thread
+#endif
+
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
@@ -0,0 +1,79 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_attribute_cache.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "wascore/basic_types.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A bounded least-recently-used cache of the attributes read from blobs, shared by the copies of a blob service client.
+    /// </summary>
+    class blob_attribute_cache
+    {
+    public:
+
+        blob_attribute_cache()
+            : m_invalidations(0)
+        {
+        }
+
+        blob_attribute_cache_settings settings() const;
+        void set_settings(const blob_attribute_cache_settings& value);
+        bool is_enabled() const;
+
+        static utility::string_t get_key(const storage_uri& uri, const utility::string_t& snapshot_time);
+
+        // Returns the number of invalidations so far, which is passed to put so that attributes read before an invalidation are not stored
+        uint64_t begin_read() const;
+
+        // Returns true if the attributes are cached, and sets is_fresh if their time to live has not passed yet
+        bool try_get(const utility::string_t& key, cloud_blob_properties& properties, cloud_metadata& metadata, copy_state& copy, bool& is_fresh);
+        void put(const utility::string_t& key, const cloud_blob_properties& properties, const cloud_metadata& metadata, const copy_state& copy, uint64_t read_invalidations);
+        void remove(const utility::string_t& key);
+
+    private:
+
+        struct entry
+        {
+            utility::string_t key;
+            cloud_blob_properties properties;
+            cloud_metadata metadata;
+            copy_state copy;
+            std::chrono::steady_clock::time_point expiry_time;
+        };
+
+        typedef std::list<entry> entry_list;
+
+        blob_attribute_cache_settings m_settings;
+
+        // The most recently used entries are at the front
+        entry_list m_entries;
+        std::unordered_map<utility::string_t, entry_list::iterator> m_index;
+        uint64_t m_invalidations;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,102 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_content_cache.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "wascore/basic_types.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A size-bounded least-recently-used cache of the contents of small blobs, shared by the copies of a blob service client.
+    /// Every use of a cached content is revalidated with the service, so the cache only saves transferring it again.
+    /// </summary>
+    class blob_content_cache
+    {
+    public:
+
+        struct content
+        {
+            content()
+                : has_attributes(false)
+            {
+            }
+
+            utility::string_t etag;
+            std::shared_ptr<const std::vector<uint8_t>> body;
+
+            // Contents read back from disk only have their ETag, because the other attributes are not written
+            bool has_attributes;
+            cloud_blob_properties properties;
+            cloud_metadata metadata;
+            wa::storage::copy_state copy;
+        };
+
+        blob_content_cache()
+            : m_size(0), m_invalidations(0), m_disk_task(pplx::task_from_result())
+        {
+        }
+
+        blob_content_cache_settings settings() const;
+        void set_settings(const blob_content_cache_settings& value);
+        bool is_enabled() const;
+
+        static utility::string_t get_key(const storage_uri& snapshot_qualified_uri);
+
+        // Returns the number of invalidations so far, which is passed to put so that a content read before an invalidation is not stored
+        uint64_t begin_read() const;
+
+        // Returns the cached content, looking for it on disk if it is not in memory, or nullptr if it is not cached
+        pplx::task<std::shared_ptr<const content>> get_async(const utility::string_t& key);
+        void put(const utility::string_t& key, std::shared_ptr<const content> value, uint64_t read_invalidations, bool write_to_disk);
+        void remove(const utility::string_t& key);
+
+    private:
+
+        struct entry
+        {
+            utility::string_t key;
+            std::shared_ptr<const content> value;
+        };
+
+        typedef std::list<entry> entry_list;
+
+        utility::string_t get_path(const utility::string_t& key) const;
+        static pplx::task<std::shared_ptr<const content>> read_file_async(const utility::string_t& path, const utility::string_t& key);
+        void write_file(const utility::string_t& path, const utility::string_t& key, std::shared_ptr<const content> value);
+        void delete_file(const utility::string_t& path);
+
+        blob_content_cache_settings m_settings;
+
+        // The most recently used entries are at the front
+        entry_list m_entries;
+        std::unordered_map<utility::string_t, entry_list::iterator> m_index;
+        utility::size64_t m_size;
+        uint64_t m_invalidations;
+
+        // Files are written and deleted one at a time, so that two versions of a content are never written to the same file together
+        pplx::task<void> m_disk_task;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,84 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_listing_cache.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "wascore/basic_types.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A bounded least-recently-used cache of the segments of hierarchical blob listings, shared by the copies of a blob service client.
+    /// </summary>
+    class blob_listing_cache
+    {
+    public:
+
+        blob_listing_cache()
+            : m_invalidations(0)
+        {
+        }
+
+        blob_listing_cache_settings settings() const;
+        void set_settings(const blob_listing_cache_settings& value);
+        bool is_enabled() const;
+
+        static utility::string_t get_key(const storage_uri& container_uri, const utility::string_t& prefix, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const continuation_token& token);
+
+        // Returns the number of invalidations so far, which is passed to put so that segments listed before an invalidation are not stored
+        uint64_t begin_read() const;
+
+        // Returns true and a copy of the segment, whose blobs belong to the given container, if it is cached and its time to live has not passed yet
+        bool try_get(const utility::string_t& key, const cloud_blob_container& container, blob_result_segment& segment);
+        bool contains(const utility::string_t& key);
+        void put(const utility::string_t& key, const cloud_blob_container& container, const utility::string_t& prefix, const blob_result_segment& segment, uint64_t read_invalidations);
+
+        // Removes the segments of the container's listings that the blob appears in, by itself or as part of a directory
+        void remove_blob(const storage_uri& container_uri, const utility::string_t& blob_name);
+        void remove_container(const storage_uri& container_uri);
+
+    private:
+
+        struct entry
+        {
+            utility::string_t key;
+            utility::string_t container;
+            utility::string_t prefix;
+            blob_result_segment segment;
+            std::chrono::steady_clock::time_point expiry_time;
+        };
+
+        typedef std::list<entry> entry_list;
+
+        bool is_fresh(const entry& value) const;
+
+        blob_listing_cache_settings m_settings;
+
+        // The most recently used entries are at the front
+        entry_list m_entries;
+        std::unordered_map<utility::string_t, entry_list::iterator> m_index;
+        uint64_t m_invalidations;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
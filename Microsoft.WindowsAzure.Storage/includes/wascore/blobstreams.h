@@ -17,14 +17,39 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <list>
+
 #include "basic_types.h"
+#include "constants.h"
 #include "streams.h"
 #include "async_semaphore.h"
+#include "block_buffer_pool.h"
+#include "memory_budget.h"
 #include "util.h"
 #include "was/blob.h"
 
 namespace wa { namespace storage { namespace core {
 
+    /// <summary>
+    /// Adds the bytes of a block, a page write or a downloaded range to the progress counter of the options once its request has succeeded.
+    /// </summary>
+    inline pplx::task<void> add_transfer_progress(pplx::task<void> transfer_task, const blob_request_options& modified_options, utility::size64_t length)
+    {
+        auto progress = modified_options.transfer_progress();
+        if (!progress)
+        {
+            return transfer_task;
+        }
+
+        return transfer_task.then([progress, length] ()
+        {
+            progress->_add(length);
+        });
+    }
+
     class basic_cloud_blob_istreambuf : public basic_istreambuf<concurrency::streams::ostream::traits::char_type>
     {
     public:
@@ -32,7 +57,8 @@ namespace wa { namespace storage { namespace core {
             : basic_istreambuf<concurrency::streams::ostream::traits::char_type>(),
             m_blob(blob), m_condition(condition), m_options(options), m_context(context),
             m_current_blob_offset(0), m_next_blob_offset(0), m_buffer_size(options.stream_read_size_in_bytes()),
-            m_next_buffer_size(options.stream_read_size_in_bytes()), m_buffer(std::ios_base::in)
+            m_next_buffer_size(options.stream_read_size_in_bytes()), m_buffer(std::ios_base::in), m_memory_budget(options._memory_budget()),
+            m_range_cache_size(options.stream_range_cache_size_in_bytes()), m_cached_size(0), m_sequential_ranges(0)
         {
             if (!options.disable_content_md5_validation() && !m_blob->properties().content_md5().empty())
             {
@@ -40,6 +66,11 @@ namespace wa { namespace storage { namespace core {
             }
         }
 
+        ~basic_cloud_blob_istreambuf()
+        {
+            discard_prefetched_ranges();
+        }
+
         bool can_seek() const
         {
             return is_open();
@@ -144,8 +175,28 @@ namespace wa { namespace storage { namespace core {
 
     private:
 
+        struct prefetched_range
+        {
+            int64_t offset;
+            int64_t length;
+            concurrency::streams::container_buffer<transfer_buffer> buffer;
+            pplx::task<std::shared_ptr<memory_budget::reservation>> download_task;
+            pplx::cancellation_token_source cancellation;
+        };
+
+        struct cached_range
+        {
+            int64_t offset;
+            transfer_buffer data;
+        };
+
         pplx::task<bool> download_if_necessary(size_t bytes_needed);
         pplx::task<bool> download();
+        void prefetch(int64_t offset);
+        void retire_buffer();
+        bool use_cached_range(int64_t offset);
+        void discard_prefetched_ranges();
+        static void discard(const prefetched_range& range);
 
         std::shared_ptr<cloud_blob> m_blob;
         access_condition m_condition;
@@ -156,7 +207,18 @@ namespace wa { namespace storage { namespace core {
         int64_t m_next_blob_offset;
         size_t m_buffer_size;
         size_t m_next_buffer_size;
-        concurrency::streams::container_buffer<std::vector<char_type>> m_buffer;
+        concurrency::streams::container_buffer<transfer_buffer> m_buffer;
+        std::shared_ptr<memory_budget> m_memory_budget;
+        std::shared_ptr<memory_budget::reservation> m_buffer_reservation;
+        std::deque<prefetched_range> m_prefetched_ranges;
+
+        // The ranges the reader has left, the most recently used first
+        size_t m_range_cache_size;
+        size_t m_cached_size;
+        std::list<cached_range> m_cached_ranges;
+
+        // The number of ranges read since the last seek that did not continue the previous range
+        int m_sequential_ranges;
     };
 
 
@@ -176,13 +238,9 @@ namespace wa { namespace storage { namespace core {
             : basic_ostreambuf<concurrency::streams::ostream::traits::char_type>(),
             m_condition(condition), m_options(options), m_context(context), m_semaphore(options.parallelism_factor()),
             m_buffer_size(options.stream_write_size_in_bytes()), m_next_buffer_size(options.stream_write_size_in_bytes()),
-            m_current_streambuf_offset(0), m_committed(false)
+            m_buffer_pool(options._block_buffer_pool()), m_memory_budget(options._memory_budget()), m_buffer_acquired(false),
+            m_current_streambuf_offset(0), m_committed(false), m_hash_task(pplx::task_from_result())
         {
-            if (options.use_transactional_md5())
-            {
-                m_block_hash = hash_md5_streambuf();
-            }
-
             if (options.store_blob_content_md5())
             {
                 m_blob_hash = hash_md5_streambuf();
@@ -271,11 +329,33 @@ namespace wa { namespace storage { namespace core {
         class buffer_to_upload
         {
         public:
-            buffer_to_upload(concurrency::streams::container_buffer<std::vector<char_type>> buffer, const utility::string_t& content_md5)
-                : m_stream(concurrency::streams::container_stream<std::vector<char_type>>::open_istream(std::move(buffer.collection()))),
-                m_size(buffer.size()),
-                m_content_md5(content_md5)
+            buffer_to_upload(concurrency::streams::container_buffer<transfer_buffer> buffer, std::shared_ptr<block_buffer_pool> pool, std::shared_ptr<memory_budget::reservation> reservation)
+                : m_size(buffer.size()),
+                m_buffer(std::move(buffer.collection()), std::ios_base::in),
+                m_content_md5(pplx::task_from_result(utility::string_t())),
+                m_pool(pool),
+                m_reservation(reservation)
+            {
+                m_stream = m_buffer.create_istream();
+            }
+
+            ~buffer_to_upload()
+            {
+                release();
+            }
+
+            /// <summary>
+            /// Returns the memory of the buffer to the pool it was taken from and to the memory budget, once it has been uploaded.
+            /// </summary>
+            void release()
             {
+                if (m_pool)
+                {
+                    m_pool->release(std::move(m_buffer.collection()));
+                    m_pool.reset();
+                }
+
+                m_reservation.reset();
             }
 
             concurrency::streams::istream stream() const
@@ -293,36 +373,270 @@ namespace wa { namespace storage { namespace core {
                 return m_size == 0;
             }
 
-            const utility::string_t& content_md5() const
+            const transfer_buffer& data() const
+            {
+                return m_buffer.collection();
+            }
+
+            /// <summary>
+            /// Returns a task that completes with the MD5 of the buffer, or an empty string if it is not calculated,
+            /// once the hashing stage of the stream has reached this buffer.
+            /// </summary>
+            pplx::task<utility::string_t> content_md5() const
             {
                 return m_content_md5;
             }
 
+            void set_content_md5(pplx::task<utility::string_t> value)
+            {
+                m_content_md5 = value;
+            }
+
         private:
 
-            concurrency::streams::istream m_stream;
             utility::size64_t m_size;
-            utility::string_t m_content_md5;
+            concurrency::streams::container_buffer<transfer_buffer> m_buffer;
+            concurrency::streams::istream m_stream;
+            pplx::task<utility::string_t> m_content_md5;
+            std::shared_ptr<block_buffer_pool> m_pool;
+            std::shared_ptr<memory_budget::reservation> m_reservation;
         };
 
-        concurrency::streams::container_buffer<std::vector<char_type>> m_buffer;
+        concurrency::streams::container_buffer<transfer_buffer> m_buffer;
         pos_type m_current_streambuf_offset;
         hash_streambuf m_blob_hash;
-        hash_streambuf m_block_hash;
         access_condition m_condition;
         blob_request_options m_options;
         operation_context m_context;
         async_semaphore m_semaphore;
 
+        // The size of the buffer being filled and of the one after it
+        size_t m_buffer_size;
+        size_t m_next_buffer_size;
+
         virtual pplx::task<void> upload_buffer() = 0;
         virtual pplx::task<void> commit_blob() = 0;
         std::shared_ptr<buffer_to_upload> prepare_buffer();
 
     private:
 
-        size_t m_buffer_size;
-        size_t m_next_buffer_size;
+        pplx::task<void> acquire_buffer();
+
+        std::shared_ptr<block_buffer_pool> m_buffer_pool;
+        std::shared_ptr<memory_budget> m_memory_budget;
+        std::shared_ptr<memory_budget::reservation> m_buffer_reservation;
+        bool m_buffer_acquired;
         bool m_committed;
+        pplx::task<void> m_hash_task;
+    };
+
+    /// <summary>
+    /// The IDs of the blocks that one upload creates. Each ID is a random prefix shared by the upload and a fixed-width block number,
+    /// so only the prefix is kept and the ID of any block is formatted again from its number when it is needed.
+    /// </summary>
+    class block_id_sequence
+    {
+    public:
+
+        block_id_sequence();
+
+        /// <summary>
+        /// Continues the IDs of an earlier upload from the base64 text of its prefix.
+        /// </summary>
+        explicit block_id_sequence(std::string encoded_prefix)
+            : m_encoded_prefix(std::move(encoded_prefix))
+        {
+        }
+
+        const std::string& encoded_prefix() const
+        {
+            return m_encoded_prefix;
+        }
+
+        /// <summary>
+        /// Returns the base64 ID of the block with the given number. All IDs have the same length.
+        /// </summary>
+        std::string get_utf8_block_id(size_t index) const;
+
+        utility::string_t get_block_id(size_t index) const
+        {
+            return utility::conversions::to_string_t(get_utf8_block_id(index));
+        }
+
+    private:
+
+        // The prefix has a multiple of three bytes, so its base64 text does not depend on the block number that follows
+        std::string m_encoded_prefix;
+    };
+
+    /// <summary>
+    /// A seekable stream over the Put Block List body that commits the first block_count blocks of a <see cref="block_id_sequence" />.
+    /// The XML is produced as it is read, so the body is never held in memory as a whole.
+    /// </summary>
+    class basic_block_list_streambuf : public basic_istreambuf<concurrency::streams::istream::traits::char_type>
+    {
+    public:
+        basic_block_list_streambuf(block_id_sequence block_ids, size_t block_count);
+
+        bool can_seek() const
+        {
+            return is_open();
+        }
+
+        bool has_size() const
+        {
+            return true;
+        }
+
+        utility::size64_t size() const
+        {
+            return m_size;
+        }
+
+        size_t buffer_size(std::ios_base::openmode direction) const
+        {
+            return (size_t)0;
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
+        {
+        }
+
+        size_t in_avail() const
+        {
+            return static_cast<size_t>(m_size - m_position);
+        }
+
+        pos_type getpos(std::ios_base::openmode direction) const
+        {
+            if (direction == std::ios_base::in)
+            {
+                return (pos_type)m_position;
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode direction)
+        {
+            switch (way)
+            {
+            case std::ios_base::beg:
+                return seekpos((pos_type)offset, direction);
+
+            case std::ios_base::cur:
+                return seekpos((pos_type)(offset + (off_type)m_position), direction);
+
+            case std::ios_base::end:
+                return seekpos((pos_type)(offset + (off_type)m_size), direction);
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode direction)
+        {
+            if ((direction == std::ios_base::in) && (pos >= 0) && (static_cast<utility::size64_t>(pos) <= m_size))
+            {
+                m_position = static_cast<utility::size64_t>(pos);
+                return pos;
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        bool acquire(_Out_writes_(count) char_type*& ptr, _In_ size_t& count)
+        {
+            return false;
+        }
+
+        void release(_Out_writes_(count) char_type* ptr, _In_ size_t count)
+        {
+        }
+
+        pplx::task<int_type> _bumpc()
+        {
+            return pplx::task_from_result(_sbumpc());
+        }
+
+        int_type _sbumpc()
+        {
+            auto ch = _sgetc();
+            if (ch != traits::eof())
+            {
+                m_position++;
+            }
+
+            return ch;
+        }
+
+        pplx::task<int_type> _getc()
+        {
+            return pplx::task_from_result(_sgetc());
+        }
+
+        int_type _sgetc()
+        {
+            char_type ch;
+            return read(m_position, &ch, 1) == 1 ? traits::to_int_type(ch) : traits::eof();
+        }
+
+        pplx::task<int_type> _nextc()
+        {
+            if (m_position >= m_size)
+            {
+                return pplx::task_from_result<int_type>(traits::eof());
+            }
+
+            m_position++;
+            return _getc();
+        }
+
+        pplx::task<int_type> _ungetc()
+        {
+            if (m_position == 0)
+            {
+                return pplx::task_from_result<int_type>(traits::eof());
+            }
+
+            m_position--;
+            return _getc();
+        }
+
+        pplx::task<size_t> _getn(_Out_writes_(count) char_type* ptr, _In_ size_t count)
+        {
+            auto read_count = read(m_position, ptr, count);
+            m_position += read_count;
+            return pplx::task_from_result(read_count);
+        }
+
+        size_t _scopy(_Out_writes_(count) char_type* ptr, _In_ size_t count)
+        {
+            return read(m_position, ptr, count);
+        }
+
+    private:
+
+        size_t read(utility::size64_t position, char_type* ptr, size_t count);
+
+        block_id_sequence m_block_ids;
+        size_t m_block_count;
+        size_t m_entry_size;
+        utility::size64_t m_size;
+        utility::size64_t m_position;
+
+        // The last block list entry that was formatted, as reads usually continue where the previous one ended
+        size_t m_entry_index;
+        std::string m_entry;
+    };
+
+    class block_list_streambuf : public concurrency::streams::streambuf<basic_block_list_streambuf::char_type>
+    {
+    public:
+        block_list_streambuf(block_id_sequence block_ids, size_t block_count)
+            : concurrency::streams::streambuf<basic_block_list_streambuf::char_type>(std::make_shared<basic_block_list_streambuf>(block_ids, block_count))
+        {
+        }
     };
 
     class basic_cloud_block_blob_ostreambuf : public basic_cloud_blob_ostreambuf
@@ -330,8 +644,13 @@ namespace wa { namespace storage { namespace core {
     public:
         basic_cloud_block_blob_ostreambuf(std::shared_ptr<cloud_block_blob> blob, const access_condition &condition, const blob_request_options& options, operation_context context)
             : basic_cloud_blob_ostreambuf(condition, options, context),
-            m_blob(blob), m_block_id_prefix(utility::uuid_to_string(utility::new_uuid()))
+            m_blob(blob), m_block_count(0), m_blocks_size(0), m_failed_blocks(0)
         {
+            if (options.initial_stream_write_size_in_bytes() > 0)
+            {
+                m_buffer_size = std::min(options.initial_stream_write_size_in_bytes(), options.stream_write_size_in_bytes());
+                m_next_buffer_size = m_buffer_size;
+            }
         }
 
         bool can_seek() const
@@ -361,11 +680,15 @@ namespace wa { namespace storage { namespace core {
 
     private:
 
-        utility::string_t get_next_block_id();
+        pplx::task<void> upload_block_with_retries(std::shared_ptr<buffer_to_upload> buffer, utility::string_t block_id, utility::string_t content_md5, int retry_count);
 
         std::shared_ptr<cloud_block_blob> m_blob;
-        utility::string_t m_block_id_prefix;
-        std::vector<block_list_item> m_block_list;
+        block_id_sequence m_block_ids;
+        size_t m_block_count;
+        utility::size64_t m_blocks_size;
+
+        // The number of blocks that have failed at least once
+        std::atomic<int> m_failed_blocks;
     };
 
     class cloud_block_blob_ostreambuf : public concurrency::streams::streambuf<basic_cloud_block_blob_ostreambuf::char_type>
@@ -380,10 +703,17 @@ namespace wa { namespace storage { namespace core {
     class basic_cloud_page_blob_ostreambuf : public basic_cloud_blob_ostreambuf
     {
     public:
-        basic_cloud_page_blob_ostreambuf(std::shared_ptr<cloud_page_blob> blob, utility::size64_t blob_size, const access_condition &condition, const blob_request_options& options, operation_context context)
+        basic_cloud_page_blob_ostreambuf(std::shared_ptr<cloud_page_blob> blob, utility::size64_t blob_size, bool is_new_blob, const access_condition &condition, const blob_request_options& options, operation_context context)
             : basic_cloud_blob_ostreambuf(condition, options, context),
-            m_blob(blob), m_blob_size(blob_size), m_current_blob_offset(0)
+            m_blob(blob), m_blob_size(blob_size), m_current_blob_offset(0), m_clear_zero_pages(!is_new_blob)
+        {
+            m_buffer_size = get_page_aligned_size(m_buffer_size);
+            m_next_buffer_size = m_buffer_size;
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
         {
+            basic_cloud_blob_ostreambuf::set_buffer_size(get_page_aligned_size(size), direction);
         }
 
         bool can_seek() const
@@ -411,6 +741,9 @@ namespace wa { namespace storage { namespace core {
                 }
 
                 sync().wait();
+
+                // Pages written before may be overwritten now, so zero pages can no longer be left out
+                m_clear_zero_pages = true;
                 m_current_blob_offset = pos;
                 m_current_streambuf_offset = pos;
                 return (pos_type)m_current_streambuf_offset;
@@ -428,16 +761,29 @@ namespace wa { namespace storage { namespace core {
 
     private:
 
+        // Every buffer becomes one Put Page request, so it has to be whole pages and no larger than the service accepts
+        static size_t get_page_aligned_size(size_t size)
+        {
+            size = std::min(size, protocol::max_page_write_size);
+            size -= size % protocol::page_size;
+            return std::max(size, protocol::page_size);
+        }
+
+        pplx::task<void> upload_pages(std::shared_ptr<buffer_to_upload> buffer, int64_t offset, const utility::string_t& content_md5);
+
         std::shared_ptr<cloud_page_blob> m_blob;
         utility::size64_t m_blob_size;
         int64_t m_current_blob_offset;
+
+        // Set when the zero pages of a buffer have to be cleared, rather than left out of a blob that is still all zeros
+        bool m_clear_zero_pages;
     };
 
     class cloud_page_blob_ostreambuf : public concurrency::streams::streambuf<basic_cloud_page_blob_ostreambuf::char_type>
     {
     public:
-        cloud_page_blob_ostreambuf(std::shared_ptr<cloud_page_blob> blob, utility::size64_t blob_size, const access_condition &condition, const blob_request_options& options, operation_context context)
-        : concurrency::streams::streambuf<basic_cloud_page_blob_ostreambuf::char_type>(std::make_shared<basic_cloud_page_blob_ostreambuf>(blob, blob_size, condition, options, context))
+        cloud_page_blob_ostreambuf(std::shared_ptr<cloud_page_blob> blob, utility::size64_t blob_size, bool is_new_blob, const access_condition &condition, const blob_request_options& options, operation_context context)
+        : concurrency::streams::streambuf<basic_cloud_page_blob_ostreambuf::char_type>(std::make_shared<basic_cloud_page_blob_ostreambuf>(blob, blob_size, is_new_blob, condition, options, context))
         {
         }
     };
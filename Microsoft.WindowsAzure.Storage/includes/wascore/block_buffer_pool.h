@@ -0,0 +1,67 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="block_buffer_pool.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "wascore/basic_types.h"
+#include "wascore/transfer_buffer.h"
+#include "async_semaphore.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A bounded pool of reusable block buffers shared by the blob write streams of a service client.
+    /// </summary>
+    class block_buffer_pool : public std::enable_shared_from_this<block_buffer_pool>
+    {
+    public:
+
+        explicit block_buffer_pool(size_t max_buffers)
+            : m_max_buffers(max_buffers), m_semaphore(static_cast<int>(max_buffers))
+        {
+        }
+
+        /// <summary>
+        /// Returns a task that completes with an empty buffer whose capacity is at least the specified size,
+        /// once fewer than the maximum number of buffers are in use.
+        /// </summary>
+        /// <param name="allocator">The allocator of the buffer, or <c>nullptr</c> to allocate it on the heap. A free buffer is
+        /// only reused if it came from the same allocator.</param>
+        pplx::task<transfer_buffer> acquire_async(size_t capacity, std::shared_ptr<wa::storage::buffer_allocator> allocator);
+
+        /// <summary>
+        /// Returns a buffer that was acquired from this pool.
+        /// </summary>
+        void release(transfer_buffer buffer);
+
+        size_t max_buffers() const
+        {
+            return m_max_buffers;
+        }
+
+    private:
+
+        size_t m_max_buffers;
+        async_semaphore m_semaphore;
+        std::vector<transfer_buffer> m_free_buffers;
+        std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
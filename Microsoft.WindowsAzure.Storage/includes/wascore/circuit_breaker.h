@@ -0,0 +1,90 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="circuit_breaker.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include "wascore/basic_types.h"
+#include "was/common.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Keeps a circuit for each location of each account that a service client sends requests to, which is opened
+    /// after a number of failures in a row so that requests to a failing endpoint fail right away instead of waiting for it.
+    /// </summary>
+    /// <remarks>Once the circuit has been open for a while, it is half-open and lets a single request through as a probe.
+    /// A probe that succeeds closes the circuit, and one that fails opens it again.</remarks>
+    class circuit_breaker
+    {
+    public:
+
+        circuit_breaker();
+
+        circuit_breaker_settings settings() const;
+        void set_settings(const circuit_breaker_settings& value);
+
+        /// <summary>
+        /// Returns true if the circuit breaker is enabled.
+        /// </summary>
+        bool is_enabled() const;
+
+        /// <summary>
+        /// Returns true if a request may be sent to the location of the account, which makes it the probe if the circuit is half-open.
+        /// </summary>
+        bool try_admit(const utility::string_t& account, storage_location location);
+
+        /// <summary>
+        /// Records the outcome of a request sent to the location of the account.
+        /// </summary>
+        void record(const utility::string_t& account, storage_location location, bool failed);
+
+    private:
+
+        enum class circuit_state
+        {
+            closed,
+            open,
+            half_open
+        };
+
+        struct circuit
+        {
+            circuit()
+                : state(circuit_state::closed), failures(0)
+            {
+            }
+
+            circuit_state state;
+            int failures;
+
+            // When the circuit opened, or when the probe was let through while it is half-open
+            std::chrono::steady_clock::time_point changed;
+        };
+
+        typedef std::pair<utility::string_t, storage_location> circuit_key;
+
+        circuit_breaker_settings m_settings;
+        std::map<circuit_key, circuit> m_circuits;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,70 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="credential_cache.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    class hmac_sha256_hash;
+
+    /// <summary>
+    /// A process-wide cache of signing keys, so that the signers of the same account key schedule it only once.
+    /// </summary>
+    /// <remarks>
+    /// The cache is off unless enabled. It is keyed by a SHA-256 digest of the account key and holds its signing keys
+    /// weakly, so a key schedule is kept only while the authentication handlers and shared access signature signers of
+    /// some storage_credentials still use it. When the cache is full, entries that expired are removed to make room.
+    /// </remarks>
+    class credential_cache
+    {
+    public:
+
+        WASTORAGE_API static credential_cache& instance();
+
+        bool enabled() const
+        {
+            return m_enabled;
+        }
+
+        void set_enabled(bool value);
+
+        // Returns the HMAC-SHA256 key schedule of the account key, shared by everything that signs with it while the cache is enabled
+        WASTORAGE_API std::shared_ptr<const hmac_sha256_hash> get_signing_key(const std::vector<uint8_t>& account_key);
+
+    private:
+
+        explicit credential_cache(size_t max_entries)
+            : m_max_entries(max_entries), m_enabled(false)
+        {
+        }
+
+        size_t m_max_entries;
+        std::atomic<bool> m_enabled;
+        std::unordered_map<std::string, std::weak_ptr<const hmac_sha256_hash>> m_signing_keys;
+        std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,39 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="datetime_codec.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    // Fixed-format codecs for the dates of the storage protocol. RFC 1123 dates look like "Sun, 06 Nov 1994 08:49:37 GMT",
+    // and ISO 8601 dates like "1994-11-06T08:49:37.1234567Z", with up to seven digits of fractional seconds. Like
+    // utility::datetime::from_string, the parsers return an uninitialized datetime for text they cannot parse.
+
+    WASTORAGE_API utility::datetime parse_rfc1123_datetime(const utility::string_t& value);
+    WASTORAGE_API utility::string_t format_rfc1123_datetime(const utility::datetime& value);
+    WASTORAGE_API utility::datetime parse_iso8601_datetime(const utility::string_t& value);
+    WASTORAGE_API utility::string_t format_iso8601_datetime(const utility::datetime& value);
+
+    // Returns the current time as an RFC 1123 date, which each thread only formats again once a second
+    WASTORAGE_API utility::string_t current_rfc1123_datetime();
+
+}}} // namespace wa::storage::core
@@ -23,6 +23,17 @@
 #include "logging.h"
 #include "util.h"
 #include "streams.h"
+#include "transfer_buffer.h"
+#include "http_client_pool.h"
+#include "location_selector.h"
+#include "retry_budget.h"
+#include "timer_wheel.h"
+#include "latency_recorder.h"
+#include "existence_cache.h"
+#include "operation_dispatcher.h"
+#include "circuit_breaker.h"
+#include "allocation_tracker.h"
+#include "scheduler.h"
 #include "was/auth.h"
 
 namespace wa { namespace storage { namespace core {
@@ -30,46 +41,83 @@ namespace wa { namespace storage { namespace core {
     class istream_descriptor
     {
     public:
-        istream_descriptor() {}
+        istream_descriptor()
+            : m_data(nullptr), m_source_lock(1)
+        {
+        }
         
-        static pplx::task<istream_descriptor> create(concurrency::streams::istream stream, bool calculate_md5 = false, utility::size64_t length = protocol::invalid_size64_t)
+        // A stream that cannot seek is copied into memory taken from the allocator, or from the heap if there is none
+        static pplx::task<istream_descriptor> create(concurrency::streams::istream stream, bool calculate_md5 = false, utility::size64_t length = protocol::invalid_size64_t, bool calculate_crc64 = false, std::shared_ptr<wa::storage::buffer_allocator> allocator = nullptr)
         {
             if (length == protocol::invalid_size64_t)
             {
                 length = get_remaining_stream_length(stream);
             }
 
-            if (!calculate_md5 && stream.can_seek())
+            if (stream.can_seek())
             {
-                return pplx::task_from_result(istream_descriptor(stream, length, utility::string_t()));
+                if (!calculate_md5 && !calculate_crc64)
+                {
+                    return pplx::task_from_result(istream_descriptor(stream, length, utility::string_t(), utility::string_t()));
+                }
+
+                // A seekable stream can be read twice, so the hashes are calculated in a read-only pass
+                // and the stream is rewound, instead of the content being copied into memory
+                hash_streambuf hash_buffer;
+                hash_streambuf crc64_buffer;
+                concurrency::streams::streambuf<concurrency::streams::ostream::traits::char_type> hash_target;
+                if (calculate_md5)
+                {
+                    hash_buffer = hash_md5_streambuf();
+                    hash_target = hash_buffer;
+                }
+
+                if (calculate_crc64)
+                {
+                    crc64_buffer = hash_crc64_streambuf();
+                    if (hash_target)
+                    {
+                        hash_target = splitter_streambuf<concurrency::streams::ostream::traits::char_type>(hash_target, crc64_buffer);
+                    }
+                    else
+                    {
+                        hash_target = crc64_buffer;
+                    }
+                }
+
+                auto position = stream.tell();
+                return stream_copy_async(stream, hash_target.create_ostream(), length).then([stream, position, length, hash_buffer, crc64_buffer] (pplx::task<utility::size64_t> hash_task) mutable -> istream_descriptor
+                {
+                    hash_task.wait();
+                    stream.seek(position);
+                    return istream_descriptor(stream, length, close_hash(hash_buffer), close_hash(crc64_buffer));
+                });
             }
 
-            concurrency::streams::container_buffer<std::vector<uint8_t>> temp_buffer;
-            concurrency::streams::ostream temp_stream;
+            concurrency::streams::container_buffer<transfer_buffer> temp_buffer(transfer_buffer(transfer_allocator<uint8_t>(allocator)), std::ios_base::out);
+            concurrency::streams::streambuf<concurrency::streams::ostream::traits::char_type> temp_streambuf(temp_buffer);
             hash_streambuf hash_buffer;
+            hash_streambuf crc64_buffer;
 
+            // If a hash is needed, splitter_streambufs will act as proxies to forward incoming data to
+            // the hash streambufs and the in-memory container_buffer
             if (calculate_md5)
             {
-                // If MD5 is needed, a splitter_streambuf will act as a proxy to forward incoming data to
-                // a hash_md5_streambuf and the in-memory container_buffer
                 hash_buffer = hash_md5_streambuf();
-                temp_stream = splitter_streambuf<concurrency::streams::ostream::traits::char_type>(temp_buffer, hash_buffer).create_ostream();
+                temp_streambuf = splitter_streambuf<concurrency::streams::ostream::traits::char_type>(temp_streambuf, hash_buffer);
             }
-            else
+
+            if (calculate_crc64)
             {
-                temp_stream = temp_buffer.create_ostream();
+                crc64_buffer = hash_crc64_streambuf();
+                temp_streambuf = splitter_streambuf<concurrency::streams::ostream::traits::char_type>(temp_streambuf, crc64_buffer);
             }
 
-            return stream_copy_async(stream, temp_stream, length).then([temp_buffer, hash_buffer] (pplx::task<utility::size64_t> buffer_task) mutable -> istream_descriptor
+            return stream_copy_async(stream, temp_streambuf.create_ostream(), length).then([temp_buffer, hash_buffer, crc64_buffer] (pplx::task<utility::size64_t> buffer_task) mutable -> istream_descriptor
             {
-                utility::string_t md5;
-                if (hash_buffer)
-                {
-                    hash_buffer.close().wait();
-                    md5 = utility::conversions::to_base64(hash_buffer.hash());
-                }
-
-                return istream_descriptor(concurrency::streams::container_stream<std::vector<uint8_t>>::open_istream(std::move(temp_buffer.collection())), buffer_task.get(), md5);
+                utility::string_t md5 = close_hash(hash_buffer);
+                utility::string_t crc64 = close_hash(crc64_buffer);
+                return istream_descriptor(concurrency::streams::container_stream<transfer_buffer>::open_istream(std::move(temp_buffer.collection())), buffer_task.get(), md5, crc64);
             });
         }
 
@@ -93,22 +141,67 @@ namespace wa { namespace storage { namespace core {
             return m_content_md5;
         }
 
-        void rewind()
+        const utility::string_t& content_crc64() const
+        {
+            return m_content_crc64;
+        }
+
+        // Returns a stream over the content with a position of its own, so that a request that was abandoned and still reads
+        // its body cannot move the body of the next attempt. Content in memory is read in place, and other content is read
+        // from the stream at the offset of each read, one read at a time.
+        concurrency::streams::istream attempt_stream() const
         {
-            m_stream.seek(m_offset);
+            typedef concurrency::streams::istream::traits::char_type char_type;
+            if (m_data != nullptr)
+            {
+                std::vector<std::pair<const char_type*, size_t>> segments(1, std::make_pair(m_data, static_cast<size_t>(m_length)));
+                return gather_streambuf<char_type>(std::move(segments), m_stream.streambuf()).create_istream();
+            }
+
+            return substream_streambuf<char_type>(m_stream.streambuf(), m_source_lock, m_offset, m_length).create_istream();
         }
 
     private:
         
-        istream_descriptor(concurrency::streams::istream stream, utility::size64_t length, utility::string_t content_md5)
-            : m_stream(stream), m_offset(stream.tell()), m_length(length), m_content_md5(std::move(content_md5))
+        // Returns the base64-encoded hash of everything written to the buffer, or an empty string if there is no buffer
+        static utility::string_t close_hash(hash_streambuf& buffer)
+        {
+            if (!buffer)
+            {
+                return utility::string_t();
+            }
+
+            buffer.close().wait();
+            return utility::conversions::to_base64(buffer.hash());
+        }
+
+        istream_descriptor(concurrency::streams::istream stream, utility::size64_t length, utility::string_t content_md5, utility::string_t content_crc64)
+            : m_stream(stream), m_offset(stream.tell()), m_length(length), m_content_md5(std::move(content_md5)), m_content_crc64(std::move(content_crc64)), m_data(nullptr), m_source_lock(1)
         {
+            // The stream buffer lends the content if it is in memory
+            auto streambuf = m_stream.streambuf();
+            concurrency::streams::istream::traits::char_type* data = nullptr;
+            size_t available = 0;
+            if ((m_length > 0) && streambuf.acquire(data, available))
+            {
+                if ((data != nullptr) && (available >= m_length))
+                {
+                    m_data = data;
+                }
+
+                streambuf.release(data, 0);
+            }
         }
 
         concurrency::streams::istream m_stream;
         concurrency::streams::istream::pos_type m_offset;
         utility::string_t m_content_md5;
+        utility::string_t m_content_crc64;
         utility::size64_t m_length;
+        const concurrency::streams::istream::traits::char_type* m_data;
+
+        // Taken by each read of an attempt's stream, which seeks the shared stream before reading it
+        async_semaphore m_source_lock;
     };
 
     class ostream_descriptor
@@ -118,8 +211,8 @@ namespace wa { namespace storage { namespace core {
         {
         }
 
-        ostream_descriptor(utility::size64_t length, utility::string_t content_md5)
-            : m_length(length), m_content_md5(std::move(content_md5))
+        ostream_descriptor(utility::size64_t length, utility::string_t content_md5, utility::string_t content_crc64 = utility::string_t())
+            : m_length(length), m_content_md5(std::move(content_md5)), m_content_crc64(std::move(content_crc64))
         {
         }
 
@@ -133,9 +226,15 @@ namespace wa { namespace storage { namespace core {
             return m_content_md5;
         }
 
+        const utility::string_t& content_crc64() const
+        {
+            return m_content_crc64;
+        }
+
     private:
         
         utility::string_t m_content_md5;
+        utility::string_t m_content_crc64;
         utility::size64_t m_length;
     };
 
@@ -153,8 +252,15 @@ namespace wa { namespace storage { namespace core {
     class storage_command
     {
     public:
+
+        typedef T result_type;
+
         storage_command(const storage_uri& request_uri)
-            : m_request_uri(request_uri), m_location_mode(command_location_mode::primary_only)
+            : m_request_uri(request_uri), m_calculate_response_body_md5(false), m_calculate_response_body_crc64(false), m_stream_response_body(false), m_accept_compressed_response(false), m_location_mode(command_location_mode::primary_only)
+        {
+        }
+
+        virtual ~storage_command()
         {
         }
 
@@ -173,6 +279,21 @@ namespace wa { namespace storage { namespace core {
             m_calculate_response_body_md5 = value;
         }
 
+        void set_calculate_response_body_crc64(bool value)
+        {
+            m_calculate_response_body_crc64 = value;
+        }
+
+        void set_stream_response_body(bool value)
+        {
+            m_stream_response_body = value;
+        }
+
+        void set_accept_compressed_response(bool value)
+        {
+            m_accept_compressed_response = value;
+        }
+
         void set_build_request(std::function<web::http::http_request (web::http::uri_builder, const std::chrono::seconds&, operation_context)> value)
         {
             m_build_request = value;
@@ -181,18 +302,26 @@ namespace wa { namespace storage { namespace core {
         void set_custom_sign_request(std::function<void (web::http::http_request &, operation_context)> value)
         {
             m_sign_request = value;
+            m_authentication_handler.reset();
         }
 
         void set_authentication_handler(std::shared_ptr<protocol::authentication_handler> handler)
         {
-            set_custom_sign_request(std::bind(&protocol::authentication_handler::sign_request, handler, std::placeholders::_1, std::placeholders::_2));
+            // The handler is called directly, which saves binding it into a function object for every request
+            m_authentication_handler = handler;
+            m_sign_request = nullptr;
         }
 
-        void set_recover_request(std::function<bool (operation_context)> value)
+        void set_recover_request(std::function<bool (utility::size64_t, operation_context)> value)
         {
             m_recover_request = value;
         }
 
+        void set_record_attempt(std::function<void (const request_result&)> value)
+        {
+            m_record_attempt = value;
+        }
+
         void set_preprocess_response(std::function<T (const web::http::http_response &, operation_context)> value)
         {
             m_preprocess_response = value;
@@ -231,17 +360,51 @@ namespace wa { namespace storage { namespace core {
             }
         }
 
+    protected:
+
+        // The executor calls the steps of a command through these, so that a command type can provide its own steps
+        // without storing them as function objects
+        virtual web::http::http_request build_request(web::http::uri_builder builder, const std::chrono::seconds& timeout, operation_context context) const
+        {
+            return m_build_request(builder, timeout, context);
+        }
+
+        virtual void sign_request(web::http::http_request& request, operation_context context) const
+        {
+            if (m_authentication_handler)
+            {
+                m_authentication_handler->sign_request(request, context);
+            }
+            else
+            {
+                m_sign_request(request, context);
+            }
+        }
+
+        virtual T preprocess_response(const web::http::http_response& response, operation_context context) const
+        {
+            return m_preprocess_response(response, context);
+        }
+
     private:
 
         storage_uri m_request_uri;
         istream_descriptor m_request_body;
         concurrency::streams::ostream m_destination_stream;
         bool m_calculate_response_body_md5;
+        bool m_calculate_response_body_crc64;
+        // When set, m_postprocess_response is called once the headers are processed and reads the body while it downloads
+        bool m_stream_response_body;
+        // When set, the response may be gzip encoded if the request options allow it, and m_postprocess_response reads it decoded
+        bool m_accept_compressed_response;
         command_location_mode m_location_mode;
 
         std::function<web::http::http_request (web::http::uri_builder, const std::chrono::seconds&, operation_context)> m_build_request;
         std::function<void(web::http::http_request &, operation_context)> m_sign_request;
-        std::function<bool (operation_context)> m_recover_request;
+        std::shared_ptr<protocol::authentication_handler> m_authentication_handler;
+        std::function<bool (utility::size64_t, operation_context)> m_recover_request;
+        // Called with the result of every attempt, including its timings, once it has completed
+        std::function<void (const request_result&)> m_record_attempt;
         std::function<T (const web::http::http_response &, operation_context)> m_preprocess_response;
         std::function<pplx::task<T> (const web::http::http_response &, const request_result&, const ostream_descriptor&, operation_context)> m_postprocess_response;
 
@@ -254,13 +417,51 @@ namespace wa { namespace storage { namespace core {
     public:
 
         executor(std::shared_ptr<storage_command<T>> command, const request_options& options, operation_context context)
-            : m_command(command), m_request_options(options), m_context(context),
-            m_retry_count(0), m_current_location(get_first_location(options.location_mode())),
-            m_current_location_mode(options.location_mode()), m_retry_policy(options.retry_policy().clone())
+            : m_command(command), m_request_options(options), m_context(context), m_log_level(logger::instance().operation_log_level(context)),
+            m_retry_count(0), m_copy_response_body(false), m_record_location_health(false), m_body_complete(false), m_response_length(0), m_operation_span_id(0), m_phase_events(false), m_phase_activity(0), m_traced_phase(trace_phase::none), m_current_location(get_first_location(options.location_mode())),
+            m_current_location_mode(options.location_mode()), m_retry_policy(options.retry_policy().clone()), m_exchange_task(pplx::task_from_result(true))
         {
+            if (m_current_location_mode == location_mode::adaptive)
+            {
+                resolve_adaptive_location();
+            }
         }
 
         static pplx::task<T> execute_async(std::shared_ptr<storage_command<T>> command, const request_options& options, operation_context context)
+        {
+            // With a limit on the operations in flight, the operation waits until its tag is dispatched, and its retries run within that dispatch
+            auto dispatcher = options._operation_dispatcher();
+            if (!dispatcher || !dispatcher->is_enabled())
+            {
+                return execute_dispatched_async(command, options, context);
+            }
+
+            auto tag = context.dispatch_tag();
+            request_options dispatched_options(options);
+            return dispatcher->acquire_async(tag).then([command, dispatched_options, context, dispatcher, tag] () -> pplx::task<T>
+            {
+                pplx::task<T> operation_task;
+                try
+                {
+                    operation_task = execute_dispatched_async(command, dispatched_options, context);
+                }
+                catch (...)
+                {
+                    dispatcher->release(tag);
+                    throw;
+                }
+
+                return operation_task.then([dispatcher, tag] (pplx::task<T> completed_task) -> T
+                {
+                    dispatcher->release(tag);
+                    return completed_task.get();
+                });
+            });
+        }
+
+    private:
+
+        static pplx::task<T> execute_dispatched_async(std::shared_ptr<storage_command<T>> command, const request_options& options, operation_context context)
         {
             if (!context.start_time().is_initialized())
             {
@@ -268,156 +469,243 @@ namespace wa { namespace storage { namespace core {
             }
 
             auto instance = std::make_shared<executor<T>>(command, options, context);
+            if (instance->m_request_options.tracer())
+            {
+                instance->m_operation_span_id = request_tracer::_next_span_id();
+                instance->m_operation_start_time = std::chrono::steady_clock::now();
+            }
+
+            if (instance->m_request_options._retry_budget())
+            {
+                instance->m_request_options._retry_budget()->record_operation();
+            }
+
             return pplx::details::do_while([instance] () -> pplx::task<bool>
             {
                 // 0. Begin request 
                 instance->validate_location_mode();
+                instance->admit_to_circuit();
 
-                // 1. Build request
+                // 1-3. Build, set headers and sign request
                 instance->m_start_time = utility::datetime::utc_now();
-                instance->m_uri_builder = web::http::uri_builder(instance->m_command->m_request_uri.get_location_uri(instance->m_current_location));
-                instance->m_request = instance->m_command->m_build_request(instance->m_uri_builder, instance->m_request_options.server_timeout(), instance->m_context);
+                instance->m_timings = request_timings();
+                instance->m_allocations.reset();
+                allocation_scope allocations(instance->m_allocations);
+                instance->m_attempt_start_time = std::chrono::steady_clock::now();
+                instance->m_phase_start_time = instance->m_attempt_start_time;
+                instance->begin_phase_events();
+                instance->m_body_complete = false;
+                instance->m_response_length = 0;
+                instance->m_exchange_task = pplx::task_from_result(true);
+                instance->m_request = instance->build_request(instance->m_current_location, &instance->m_timings);
+                instance->m_timings.set_build_time(instance->end_phase() - instance->m_timings.sign_time());
                 instance->m_request_result = request_result(instance->m_start_time, instance->m_current_location);
 
-                if (logger::instance().should_log(instance->m_context, client_log_level::log_level_informational))
-                {
-                    utility::ostringstream_t str;
-                    str << U("Starting ") << instance->m_request.method() << U(" request to ") << instance->m_request.request_uri().to_string();
-                    logger::instance().log(instance->m_context, client_log_level::log_level_informational, str.str());
-                }
-
-                // 2. Set Headers
-                auto& client_request_id = instance->m_context.client_request_id();
-                if (!client_request_id.empty())
+                if (instance->should_log(client_log_level::log_level_informational))
                 {
-                    instance->m_request.headers().add(protocol::ms_header_client_request_id, client_request_id);
+                    logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Starting %s request to %s"), instance->m_request.method(), instance->m_request.request_uri().to_string());
                 }
 
-                auto& user_headers = instance->m_context.user_headers();
-                for (auto iter = user_headers.begin(); iter != user_headers.end(); ++iter)
-                {
-                    instance->m_request.headers().add(iter->first, iter->second);
-                }
+                // A read that either location can serve is also sent to the secondary location if the primary
+                // location takes longer than usual to respond. Neither request can write to the destination stream
+                // then, so the body of the response that arrives first is copied to it instead.
+                std::chrono::milliseconds hedge_delay;
+                bool can_hedge = instance->can_hedge();
+                bool hedge = can_hedge && instance->try_get_hedge_delay(hedge_delay);
 
-                // If the command provided a request body, set it on the http_request object
-                if (instance->m_command->m_request_body.is_valid())
-                {
-                    instance->m_command->m_request_body.rewind();
-                    instance->m_request.set_body(instance->m_command->m_request_body.stream(), instance->m_command->m_request_body.length(), utility::string_t());
-                }
+                // A hedged request waits for its connection as part of the time to first byte
+                instance->trace_next_phase(hedge ? trace_phase::time_to_first_byte : trace_phase::connection_wait);
+                instance->m_copy_response_body = hedge && instance->m_command->m_destination_stream;
 
                 // If the command wants to copy the response body to a stream, set it
                 // on the http_request object
                 if (instance->m_command->m_destination_stream)
                 {
-                    // If MD5 is needed, a splitter_streambuf will act as a proxy to forward incoming data to
-                    // a hash_md5_streambuf and the destination stream provided by the command
+                    // The destination is wrapped in a hashing_streambuf, which counts the bytes written and hashes
+                    // them as they arrive if MD5 or CRC64 is needed. It hands the destination's buffer to the HTTP
+                    // layer, so the body is not copied on its way, and the hashes read the same memory.
                     if (instance->m_command->m_calculate_response_body_md5)
                     {
                         instance->m_hash_streambuf = hash_md5_streambuf();
-                        instance->m_response_streambuf = splitter_streambuf<concurrency::streams::ostream::traits::char_type>(instance->m_command->m_destination_stream.streambuf(), instance->m_hash_streambuf);
                     }
                     else
                     {
                         instance->m_hash_streambuf = hash_streambuf();
-                        instance->m_response_streambuf = splitter_streambuf<concurrency::streams::ostream::traits::char_type>(instance->m_command->m_destination_stream.streambuf(), null_streambuf<concurrency::streams::ostream::traits::char_type>());
                     }
 
-                    instance->m_request.set_response_stream(instance->m_response_streambuf.create_ostream());
-                }
+                    if (instance->m_command->m_calculate_response_body_crc64)
+                    {
+                        instance->m_crc64_streambuf = hash_crc64_streambuf();
+                    }
+                    else
+                    {
+                        instance->m_crc64_streambuf = hash_streambuf();
+                    }
 
-                // Let the user know we are ready to send
-                auto sending_request = instance->m_context._get_impl()->sending_request();
-                if (sending_request)
-                {
-                    sending_request(instance->m_request, instance->m_context);
-                }
+                    // With a bandwidth limiter, the body is written to the destination no faster than the limiter allows, which
+                    // in turn holds back reading it from the connection
+                    auto destination = instance->m_command->m_destination_stream.streambuf();
+                    const auto& limiter = instance->m_request_options.bandwidth_limiter();
+                    if (limiter)
+                    {
+                        destination = throttled_ostreambuf<concurrency::streams::ostream::traits::char_type>(destination, limiter, instance->m_request_options.transfer_priority());
+                    }
 
-                // 3. Sign Request
-                instance->m_command->m_sign_request(instance->m_request, instance->m_context);
+                    instance->m_response_streambuf = hashing_streambuf<concurrency::streams::ostream::traits::char_type>(destination, instance->m_hash_streambuf, instance->m_crc64_streambuf);
+
+                    // An attempt abandoned because the operation expired or was canceled may keep writing here, but no
+                    // retry follows it then, so its bytes cannot interleave with those of another attempt
+                    if (!instance->m_copy_response_body)
+                    {
+                        instance->m_request.set_response_stream(instance->m_response_streambuf.create_ostream());
+                    }
+                }
 
                 // 4. Set timeout
-                web::http::client::http_client_config config;
-                config.set_timeout(instance->remaining_time());
+                // The client configuration is shared by all requests sent through the pool, so the
+                // operation expiry time is enforced by racing each attempt against a timer instead.
+                auto config = http_client_pool::client_config();
+                auto timeout = instance->remaining_time();
 
                 // 5-6. Potentially upload data and get response
-                web::http::client::http_client client(instance->m_request.request_uri().authority(), config);
-                return client.request(instance->m_request).then([instance] (pplx::task<web::http::http_response> get_headers_task) -> pplx::task<web::http::http_response>
+                pplx::task<web::http::http_response> response_task;
+                if (hedge)
                 {
-                    // Headers are ready. It should be noted that http_client will
-                    // continue to download the response body in parallel.
-                    auto response = get_headers_task.get();
-
-                    if (logger::instance().should_log(instance->m_context, client_log_level::log_level_informational))
+                    response_task = send_hedged_request_async(instance, config, hedge_delay, timeout);
+                }
+                else
+                {
+                    auto send_time = std::chrono::steady_clock::now();
+                    response_task = instance->acquire_http_client_async(config).then([instance, timeout] () -> pplx::task<web::http::http_response>
                     {
-                        utility::ostringstream_t str;
-                        str << U("Response received. Status code = ") << response.status_code() << U(". Reason = ") << response.reason_phrase();
-                        logger::instance().log(instance->m_context, client_log_level::log_level_informational, str.str());
-                    }
+                        instance->m_timings.set_connection_wait_time(instance->end_phase());
+                        instance->trace_next_phase(trace_phase::time_to_first_byte);
 
-                    try
-                    {
-                        // Let the user know we received response
-                        auto response_received = instance->m_context._get_impl()->response_received();
-                        if (response_received)
+                        const auto& token = instance->m_request_options.cancellation_token();
+                        if (token.is_canceled())
                         {
-                            response_received(instance->m_request, response, instance->m_context);
+                            throw storage_exception(utility::conversions::to_utf8string(protocol::error_operation_canceled), false);
                         }
 
-                        // 7. Do Response parsing (headers etc, no stream available here)
-                        // This is when the status code will be checked and m_preprocess_response
-                        // will throw a storage_exception if it is not expected.
-                        instance->m_result = instance->m_command->m_preprocess_response(response, instance->m_context);
-                        instance->m_request_result = request_result(instance->m_start_time, instance->m_current_location, response, false);
+                        return complete_before(send_request(instance->m_transport, instance->m_http_client_lease, instance->m_request, token, instance->m_exchange_task), timeout);
+                    });
 
-                        if (logger::instance().should_log(instance->m_context, client_log_level::log_level_informational))
+                    // The response times of the primary location are what the hedging delay is derived from
+                    if (can_hedge)
+                    {
+                        response_task = response_task.then([instance, send_time] (web::http::http_response response) -> web::http::http_response
                         {
-                            logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Successful request ID = ") + instance->m_request_result.service_request_id());
-                        }
-
-                        // 8. Potentially download data
-                        return response.content_ready();
+                            instance->record_response_time(send_time);
+                            return response;
+                        });
                     }
-                    catch (const storage_exception& e)
+                }
+
+                return response_task.then([instance] (pplx::task<web::http::http_response> get_headers_task) -> pplx::task<web::http::http_response>
+                {
+                    // Headers are ready. It should be noted that http_client will
+                    // continue to download the response body in parallel.
+                    return run_async_on_scheduler<web::http::http_response>(instance->m_request_options.io_scheduler(), [instance, get_headers_task] () -> pplx::task<web::http::http_response>
                     {
-                        // If the exception already contains an error message, the issue is not with
-                        // the response, so rethrowing is the right thing.
-                        if (e.what() != NULL && e.what()[0] != '\0')
+                        allocation_scope allocations(instance->m_allocations);
+                        auto response = get_headers_task.get();
+                        instance->m_timings.set_time_to_first_byte(instance->end_phase());
+                        instance->m_response_length = response.headers().content_length();
+                        instance->m_phase_event.status_code = response.status_code();
+                        instance->trace_next_phase(trace_phase::body);
+
+                        // An in-memory destination is presized from the Content-Length, instead of growing with every write
+                        if (instance->m_response_streambuf && instance->m_response_length > 0)
                         {
-                            throw;
+                            instance->m_response_streambuf.set_size_hint(instance->m_response_length);
+                        }
+
+                        if (instance->should_log(client_log_level::log_level_informational))
+                        {
+                            logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Response received. Status code = %d. Reason = %s"), response.status_code(), response.reason_phrase());
                         }
 
-                        // Otherwise, response body might contain an error coming from the Storage service.
-                        // However, if the command has a destination stream, there is no guarantee that it
-                        // is seekable and thus it cannot be read back to parse the error.
-                        if (!instance->m_command->m_destination_stream)
+                        try
                         {
-                            return response.content_ready().then([instance] (pplx::task<web::http::http_response> get_error_body_task) -> web::http::http_response
+                            // Let the user know we received response
+                            auto response_received = instance->m_context._get_impl()->response_received();
+                            if (response_received)
+                            {
+                                response_received(instance->m_request, response, instance->m_context);
+                            }
+
+                            // 7. Do Response parsing (headers etc, no stream available here)
+                            // This is when the status code will be checked and m_preprocess_response
+                            // will throw a storage_exception if it is not expected.
+                            instance->m_result = instance->m_command->preprocess_response(response, instance->m_context);
+                            instance->m_request_result = request_result(instance->m_start_time, instance->m_current_location, response, false);
+
+                            if (instance->should_log(client_log_level::log_level_informational))
+                            {
+                                logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Successful request ID = %s"), instance->m_request_result.service_request_id());
+                            }
+
+                            // 8. Potentially download data, unless the body is parsed as it arrives
+                            if (instance->m_command->m_stream_response_body)
                             {
-                                auto response = get_error_body_task.get();
-                                instance->m_request_result = request_result(instance->m_start_time, instance->m_current_location, response, true);
+                                return pplx::task_from_result(response);
+                            }
 
-                                if (logger::instance().should_log(instance->m_context, client_log_level::log_level_warning))
+                            if (instance->m_copy_response_body)
+                            {
+                                return complete_before(response.body().read_to_end(instance->m_response_streambuf).then([response] (size_t) -> web::http::http_response
                                 {
-                                    logger::instance().log(instance->m_context, client_log_level::log_level_warning, U("Failed request ID = ") + instance->m_request_result.service_request_id());
-                                }
+                                    return response;
+                                }), instance->remaining_time());
+                            }
 
-                                throw storage_exception(utility::conversions::to_utf8string(response.reason_phrase()));
-                            });
+                            return complete_before(response.content_ready(), instance->remaining_time());
                         }
+                        catch (const storage_exception& e)
+                        {
+                            // If the exception already contains an error message, the issue is not with
+                            // the response, so rethrowing is the right thing.
+                            if (e.what() != NULL && e.what()[0] != '\0')
+                            {
+                                throw;
+                            }
 
-                        // In the worst case, storage_exception will just contain the HTTP error message
-                        throw storage_exception(utility::conversions::to_utf8string(response.reason_phrase()));
-                    }
+                            // Otherwise, response body might contain an error coming from the Storage service.
+                            // However, if the command has a destination stream, there is no guarantee that it
+                            // is seekable and thus it cannot be read back to parse the error.
+                            if (!instance->m_command->m_destination_stream)
+                            {
+                                return response.content_ready().then([instance] (pplx::task<web::http::http_response> get_error_body_task) -> web::http::http_response
+                                {
+                                    auto response = instance->decode_response(get_error_body_task.get());
+                                    instance->m_request_result = request_result(instance->m_start_time, instance->m_current_location, response, true);
+
+                                    if (instance->should_log(client_log_level::log_level_warning))
+                                    {
+                                        logger::instance().log(instance->m_context, client_log_level::log_level_warning, U("Failed request ID = %s"), instance->m_request_result.service_request_id());
+                                    }
+
+                                    throw storage_exception(utility::conversions::to_utf8string(response.reason_phrase()));
+                                });
+                            }
+
+                            // In the worst case, storage_exception will just contain the HTTP error message
+                            throw storage_exception(utility::conversions::to_utf8string(response.reason_phrase()));
+                        }
+                    });
                 }).then([instance] (pplx::task<web::http::http_response> get_body_task) -> pplx::task<void>
                 {
                     // 9. Evaluate response & parse results
-                    auto response = get_body_task.get();
+                    allocation_scope allocations(instance->m_allocations);
+                    auto response = instance->decode_response(get_body_task.get());
+                    instance->m_timings.set_body_time(instance->end_phase());
+                    instance->m_body_complete = true;
+                    instance->trace_next_phase(trace_phase::parse);
 
                     // If the command asked for post-processing, it is now time to call m_postprocess_response
                     if (instance->m_command->m_postprocess_response)
                     {
-                        if (logger::instance().should_log(instance->m_context, client_log_level::log_level_informational))
+                        if (instance->should_log(client_log_level::log_level_informational))
                         {
                             logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Processing response body"));
                         }
@@ -431,13 +719,32 @@ namespace wa { namespace storage { namespace core {
                             md5 = utility::conversions::to_base64(instance->m_hash_streambuf.hash());
                         }
 
+                        utility::string_t crc64;
+                        if (instance->m_crc64_streambuf)
+                        {
+                            instance->m_crc64_streambuf.close().wait();
+                            crc64 = utility::conversions::to_base64(instance->m_crc64_streambuf.hash());
+                        }
+
                         ostream_descriptor descriptor;
                         if (instance->m_response_streambuf)
                         {
-                            descriptor = ostream_descriptor(instance->m_response_streambuf.total_written(), md5);
+                            descriptor = ostream_descriptor(instance->m_response_streambuf.total_written(), md5, crc64);
+                        }
+
+                        // The body is parsed on the CPU scheduler, if there is one
+                        auto postprocess_task = run_async_on_scheduler<T>(instance->m_request_options.cpu_scheduler(), [instance, response, descriptor] () -> pplx::task<T>
+                        {
+                            allocation_scope allocations(instance->m_allocations);
+                            return instance->m_command->m_postprocess_response(response, instance->m_request_result, descriptor, instance->m_context);
+                        });
+                        if (instance->m_command->m_stream_response_body)
+                        {
+                            // The body download was not awaited, so it is covered by the timeout here instead
+                            postprocess_task = complete_before(postprocess_task, instance->remaining_time());
                         }
 
-                        return instance->m_command->m_postprocess_response(response, instance->m_request_result, descriptor, instance->m_context).then([instance] (T result)
+                        return postprocess_task.then([instance] (T result)
                         {
                             instance->m_result = result;
                         });
@@ -449,7 +756,16 @@ namespace wa { namespace storage { namespace core {
                 }).then([instance] (pplx::task<void> final_task) -> pplx::task<bool>
                 {
                     bool retryable_exception = true;
+                    {
+                        allocation_scope allocations(instance->m_allocations);
+                        instance->release_http_client();
+                    }
+
+                    instance->record_timings();
                     instance->m_context._get_impl()->add_request_result(instance->m_request_result);
+                    instance->record_location_health();
+                    instance->record_circuit_outcome();
+                    instance->forget_missing_resource();
 
                     try
                     {
@@ -465,16 +781,27 @@ namespace wa { namespace storage { namespace core {
                     }
                     catch (const std::exception& e)
                     {
-                        if (logger::instance().should_log(instance->m_context, client_log_level::log_level_warning))
+                        if (instance->should_log(client_log_level::log_level_warning))
+                        {
+                            logger::instance().log(instance->m_context, client_log_level::log_level_warning, U("Exception thrown while processing response: %s"), utility::conversions::to_string_t(e.what()));
+                        }
+
+                        // A canceled operation fails with its own message, whatever the abandoned request failed with
+                        if (instance->m_request_options.cancellation_token().is_canceled())
                         {
-                            logger::instance().log(instance->m_context, client_log_level::log_level_warning, U("Exception thrown while processing response: ") + utility::conversions::to_string_t(e.what()));
+                            if (instance->should_log(client_log_level::log_level_error))
+                            {
+                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Operation was canceled"));
+                            }
+
+                            throw storage_exception(utility::conversions::to_utf8string(protocol::error_operation_canceled), instance->m_request_result, false);
                         }
 
                         if (!retryable_exception)
                         {
-                            if (logger::instance().should_log(instance->m_context, client_log_level::log_level_error))
+                            if (instance->should_log(client_log_level::log_level_error))
                             {
-                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Exception was not retryable: ") + utility::conversions::to_string_t(e.what()));
+                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Exception was not retryable: %s"), utility::conversions::to_string_t(e.what()));
                             }
 
                             throw storage_exception(e.what(), instance->m_request_result, false);
@@ -485,9 +812,34 @@ namespace wa { namespace storage { namespace core {
                         retry_info retry(instance->m_retry_policy.evaluate(context, instance->m_context));
                         if (!retry.should_retry())
                         {
-                            if (logger::instance().should_log(instance->m_context, client_log_level::log_level_error))
+                            if (instance->should_log(client_log_level::log_level_error))
+                            {
+                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Retry policy did not allow for a retry, so throwing exception: %s"), utility::conversions::to_string_t(e.what()));
+                            }
+
+                            throw storage_exception(e.what(), instance->m_request_result, false);
+                        }
+
+                        // A retry that cannot complete before the operation expires is not attempted, so that the failure
+                        // surfaces right away instead of after the backoff
+                        if (!instance->fit_retry_before_expiry(retry))
+                        {
+                            if (instance->should_log(client_log_level::log_level_error))
+                            {
+                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Not enough time is left for a retry before the operation expires, so throwing exception: %s"), utility::conversions::to_string_t(e.what()));
+                            }
+
+                            throw storage_exception(e.what(), instance->m_request_result, false);
+                        }
+
+                        // The retry budget is shared by all operations of the service client, so that a failing location
+                        // is not sent more retries than a fraction of the requests it would get anyway
+                        const auto& budget = instance->m_request_options._retry_budget();
+                        if (budget && !budget->try_withdraw())
+                        {
+                            if (instance->should_log(client_log_level::log_level_error))
                             {
-                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Retry policy did not allow for a retry, so throwing exception: ") + utility::conversions::to_string_t(e.what()));
+                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Retry budget is exhausted, so throwing exception: %s"), utility::conversions::to_string_t(e.what()));
                             }
 
                             throw storage_exception(e.what(), instance->m_request_result, false);
@@ -497,26 +849,26 @@ namespace wa { namespace storage { namespace core {
                         instance->m_current_location_mode = retry.updated_location_mode();
 
                         // Try to recover the request. If it cannot be recovered, it cannot be retried
-                        // even if the retry policy allowed for a retry.
+                        // even if the retry policy allowed for a retry. The command is told how many bytes
+                        // of the failed attempt reached its destination stream, so that it can resume.
+                        utility::size64_t bytes_written = instance->m_response_streambuf ? instance->m_response_streambuf.total_written() : 0;
                         if (instance->m_command->m_recover_request &&
-                            !instance->m_command->m_recover_request(instance->m_context))
+                            !instance->m_command->m_recover_request(bytes_written, instance->m_context))
                         {
-                            if (logger::instance().should_log(instance->m_context, client_log_level::log_level_error))
+                            if (instance->should_log(client_log_level::log_level_error))
                             {
-                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Cannot recover request for retry, so throwing exception: ") + utility::conversions::to_string_t(e.what()));
+                                logger::instance().log(instance->m_context, client_log_level::log_level_error, U("Cannot recover request for retry, so throwing exception: %s"), utility::conversions::to_string_t(e.what()));
                             }
 
                             throw storage_exception(e.what(), instance->m_request_result, false);
                         }
 
-                        if (logger::instance().should_log(instance->m_context, client_log_level::log_level_informational))
+                        if (instance->should_log(client_log_level::log_level_informational))
                         {
-                            utility::ostringstream_t str;
-                            str << U("Retrying failed operation, number of retries: ") << instance->m_retry_count;
-                            logger::instance().log(instance->m_context, client_log_level::log_level_informational, str.str());
+                            logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Retrying failed operation, number of retries: %d"), instance->m_retry_count);
                         }
 
-                        return complete_after(retry.retry_interval()).then([] () -> bool
+                        return complete_after(retry.retry_interval(), instance->m_request_options.cancellation_token()).then([] () -> bool
                         {
                             // Returning true here will tell the outer do_while loop to loop one more time.
                             return true;
@@ -529,9 +881,10 @@ namespace wa { namespace storage { namespace core {
             }).then([instance] (pplx::task<bool> loop_task) -> T
             {
                 instance->m_context.set_end_time(utility::datetime::utc_now());
+                instance->record_operation_span();
                 loop_task.wait();
 
-                if (logger::instance().should_log(instance->m_context, client_log_level::log_level_informational))
+                if (instance->should_log(client_log_level::log_level_informational))
                 {
                     logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Operation completed successfully"));
                 }
@@ -540,70 +893,901 @@ namespace wa { namespace storage { namespace core {
             });
         }
 
-    private:
+        struct hedged_response
+        {
+            web::http::http_response response;
+            web::http::http_request request;
+            http_client_pool::lease lease;
+            pplx::task<bool> exchange_task;
+            storage_location location;
+        };
+
+        // Shared by the requests of a hedged read, of which only the first to complete is used
+        struct hedge_state
+        {
+            hedge_state()
+                : done(false), started(1), failed(0)
+            {
+            }
 
-        std::chrono::seconds remaining_time() const
+            std::mutex mutex;
+            bool done;
+            int started;
+            int failed;
+            std::exception_ptr primary_error;
+            std::chrono::steady_clock::time_point send_time;
+            pplx::task_completion_event<hedged_response> completion_event;
+            pplx::cancellation_token_source primary_cancellation;
+            pplx::cancellation_token_source secondary_cancellation;
+        };
+
+        web::http::http_request build_request(storage_location location, request_timings* timings = nullptr)
         {
-            if (m_request_options.operation_expiry_time().is_initialized())
+            web::http::uri_builder builder(m_command->m_request_uri.get_location_uri(location));
+            web::http::http_request request = m_command->build_request(builder, m_request_options.server_timeout(), m_context);
+
+            auto& client_request_id = m_context.client_request_id();
+            if (!client_request_id.empty())
             {
-                auto now = utility::datetime::utc_now();
-                if (m_request_options.operation_expiry_time().to_interval() > now.to_interval())
+                request.headers().add(protocol::ms_header_client_request_id, client_request_id);
+            }
+
+            auto& user_headers = m_context.user_headers();
+            for (auto iter = user_headers.begin(); iter != user_headers.end(); ++iter)
+            {
+                request.headers().add(iter->first, iter->second);
+            }
+
+            // A listing or a query may be gzip encoded, and is decoded in front of its parser
+            if (m_command->m_accept_compressed_response && m_request_options.accept_compressed_responses())
+            {
+                request.headers().add(web::http::header_names::accept_encoding, protocol::header_value_gzip);
+            }
+
+            // If the command provided a request body, set it on the http_request object
+            if (m_command->m_request_body.is_valid())
+            {
+                auto body = m_command->m_request_body.attempt_stream();
+                const auto& limiter = m_request_options.bandwidth_limiter();
+                if (limiter)
                 {
-                    return std::chrono::seconds(m_request_options.operation_expiry_time() - now);
+                    body = throttled_istreambuf<concurrency::streams::istream::traits::char_type>(body.streambuf(), limiter, m_request_options.transfer_priority()).create_istream();
                 }
-                else
+
+                request.set_body(body, m_command->m_request_body.length(), utility::string_t());
+
+                // A large body waits for the service to accept the headers, so a request that is rejected does not send it
+                utility::size64_t expect_continue_threshold = m_request_options.expect_continue_threshold();
+                if (expect_continue_threshold > 0 && m_command->m_request_body.length() >= expect_continue_threshold)
                 {
-                    throw storage_exception(utility::conversions::to_utf8string(protocol::error_client_timeout), false);
+                    request.headers().add(protocol::header_expect, protocol::header_value_100_continue);
                 }
             }
 
-            return std::chrono::seconds();
-        }
-
-        static storage_location get_first_location(location_mode mode)
-        {
-            switch (mode)
+            // Let the user know we are ready to send
+            auto sending_request = m_context._get_impl()->sending_request();
+            if (sending_request)
             {
-            case location_mode::primary_only:
-            case location_mode::primary_then_secondary:
-                return storage_location::primary;
+                sending_request(request, m_context);
+            }
 
-            case location_mode::secondary_only:
-            case location_mode::secondary_then_primary:
-                return storage_location::secondary;
+            auto sign_start_time = std::chrono::steady_clock::now();
+            m_command->sign_request(request, m_context);
+            if (timings != nullptr)
+            {
+                timings->set_sign_time(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sign_start_time));
             }
 
-            throw std::invalid_argument("mode");
+            return request;
         }
 
-        storage_location get_next_location() const
+        // Gives a gzip encoded response a body that decodes the content as it is read, so that the parser of the
+        // response reads the same bytes it would without the encoding. Any other response is returned as it is.
+        web::http::http_response decode_response(const web::http::http_response& response) const
         {
-            switch (m_current_location_mode)
+            utility::string_t content_encoding;
+            if (!m_command->m_accept_compressed_response || !response.headers().match(web::http::header_names::content_encoding, content_encoding) || content_encoding != protocol::header_value_gzip)
             {
-            case location_mode::primary_only:
-                return storage_location::primary;
+                return response;
+            }
 
-            case location_mode::secondary_only:
-                return storage_location::secondary;
+            web::http::http_response decoded(response.status_code());
+            decoded.set_reason_phrase(response.reason_phrase());
+            decoded.headers() = response.headers();
+            decoded.headers().remove(web::http::header_names::content_encoding);
+            decoded.headers().remove(web::http::header_names::content_length);
 
-            case location_mode::primary_then_secondary:
-            case location_mode::secondary_then_primary:
-                return m_current_location == storage_location::primary ?
-                    storage_location::secondary :
-                    storage_location::primary;
-            }
+            auto content_type = response.headers().content_type();
+            decoded.set_body(gzip_istreambuf(response.body().streambuf()).create_istream(), content_type);
+            return decoded;
+        }
 
-            throw std::invalid_argument("mode");
+        // Returns the time since the previous phase of the attempt ended
+        std::chrono::microseconds end_phase()
+        {
+            auto now = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_phase_start_time);
+            m_phase_start_time = now;
+            return elapsed;
         }
 
-        void validate_location_mode()
+        // Writes the start events of the attempt and of building its request, if a trace session is listening
+        void begin_phase_events()
         {
-            bool is_valid;
-            switch (m_current_location_mode)
+            m_phase_events = logger::instance().phase_events_enabled();
+            m_traced_phase = trace_phase::none;
+            if (!m_phase_events)
             {
-            case location_mode::primary_only:
-                is_valid = !m_command->m_request_uri.primary_uri().is_empty();
-                break;
+                return;
+            }
+
+            // The operation of the first attempt is only known once its request is built
+            m_phase_activity = request_tracer::_next_span_id();
+            m_phase_event.client_request_id = m_context.client_request_id();
+            m_phase_event.location = m_current_location;
+            m_phase_event.status_code = 0;
+            m_phase_event.bytes = 0;
+            logger::instance().write_phase_start(trace_phase::attempt, m_phase_activity, m_phase_event);
+            trace_next_phase(trace_phase::build);
+        }
+
+        // Writes the stop event of the phase in progress and the start event of the next one. The stop event counts
+        // the bytes of the request body for the time to first byte, and the bytes of the response for the body.
+        void trace_next_phase(trace_phase next)
+        {
+            if (!m_phase_events)
+            {
+                return;
+            }
+
+            if (m_traced_phase == trace_phase::build)
+            {
+                m_phase_event.operation = latency_recorder::get_operation(m_request);
+            }
+
+            if (m_traced_phase != trace_phase::none)
+            {
+                m_phase_event.bytes = 0;
+                if (m_traced_phase == trace_phase::time_to_first_byte)
+                {
+                    m_phase_event.bytes = m_command->m_request_body.is_valid() ? m_command->m_request_body.length() : 0;
+                }
+                else if (m_traced_phase == trace_phase::body)
+                {
+                    m_phase_event.bytes = m_response_streambuf ? m_response_streambuf.total_written() : m_response_length;
+                }
+
+                logger::instance().write_phase_stop(m_traced_phase, m_phase_activity, m_phase_event);
+            }
+
+            m_traced_phase = next;
+            if (next != trace_phase::none)
+            {
+                m_phase_event.bytes = 0;
+                logger::instance().write_phase_start(next, m_phase_activity, m_phase_event);
+            }
+        }
+
+        // Writes the stop events of the phase in progress, which a failed attempt may have left, and of the attempt
+        void end_phase_events()
+        {
+            if (!m_phase_events)
+            {
+                return;
+            }
+
+            trace_next_phase(trace_phase::none);
+            m_phase_event.bytes = (m_command->m_request_body.is_valid() ? m_command->m_request_body.length() : 0) +
+                (m_response_streambuf ? m_response_streambuf.total_written() : m_response_length);
+            logger::instance().write_phase_stop(trace_phase::attempt, m_phase_activity, m_phase_event);
+            m_phase_events = false;
+        }
+
+        bool should_log(client_log_level level) const
+        {
+            return level <= m_log_level;
+        }
+
+        void record_timings()
+        {
+            if (m_body_complete)
+            {
+                m_timings.set_postprocess_time(end_phase());
+            }
+
+            m_timings.set_total_time(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_attempt_start_time));
+            end_phase_events();
+            m_request_result._set_timings(m_timings);
+            m_request_result._set_allocations(m_allocations.get());
+            record_attempt_spans();
+
+            if (m_command->m_record_attempt)
+            {
+                m_command->m_record_attempt(m_request_result);
+            }
+
+            const auto& recorder = m_request_options._latency_recorder();
+            if (recorder)
+            {
+                auto operation = latency_recorder::get_operation(m_request);
+                recorder->record(operation, m_timings);
+
+                auto sink = recorder->metrics_sink();
+                if (sink)
+                {
+                    utility::size64_t request_bytes = m_command->m_request_body.is_valid() ? m_command->m_request_body.length() : 0;
+                    utility::size64_t response_bytes = m_response_streambuf ? m_response_streambuf.total_written() : m_response_length;
+                    web::http::status_code status_code = m_request_result.is_response_available() ? m_request_result.http_status_code() : 0;
+                    sink->record(request_metrics(recorder->service(), std::move(operation), m_request_result.target_location(), status_code, request_bytes, response_bytes, m_retry_count, m_timings));
+                }
+            }
+        }
+
+        void record_attempt_spans()
+        {
+            const auto& tracer = m_request_options.tracer();
+            if (!tracer)
+            {
+                return;
+            }
+
+            auto operation = latency_recorder::get_operation(m_request);
+            if (m_operation_name.empty())
+            {
+                m_operation_name = operation;
+            }
+
+            // The phases follow each other, so each one starts where the one before it ended. Signing is the last
+            // part of building the request, and a phase that was not reached is left out.
+            web::http::status_code status_code = m_request_result.is_response_available() ? m_request_result.http_status_code() : 0;
+            uint64_t attempt_id = request_tracer::_next_span_id();
+            const utility::string_t& client_request_id = m_context.client_request_id();
+            const std::pair<const utility::char_t*, std::chrono::microseconds> phases[] =
+            {
+                std::make_pair(U("build"), m_timings.build_time()),
+                std::make_pair(U("sign"), m_timings.sign_time()),
+                std::make_pair(U("connection wait"), m_timings.connection_wait_time()),
+                std::make_pair(U("time to first byte"), m_timings.time_to_first_byte()),
+                std::make_pair(U("body"), m_timings.body_time()),
+                std::make_pair(U("parse"), m_timings.postprocess_time())
+            };
+
+            auto phase_start_time = m_attempt_start_time;
+            for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); ++i)
+            {
+                if (phases[i].second.count() > 0)
+                {
+                    tracer->record(trace_span(trace_span_kind::phase, phases[i].first, client_request_id, request_tracer::_next_span_id(), attempt_id, m_operation_span_id,
+                        phase_start_time, phases[i].second, m_current_location, status_code));
+                    phase_start_time += phases[i].second;
+                }
+            }
+
+            tracer->record(trace_span(trace_span_kind::attempt, std::move(operation), client_request_id, attempt_id, m_operation_span_id, m_operation_span_id,
+                m_attempt_start_time, m_timings.total_time(), m_current_location, status_code));
+        }
+
+        void record_operation_span()
+        {
+            const auto& tracer = m_request_options.tracer();
+            if (tracer)
+            {
+                web::http::status_code status_code = m_request_result.is_response_available() ? m_request_result.http_status_code() : 0;
+                auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_operation_start_time);
+                tracer->record(trace_span(trace_span_kind::operation, m_operation_name, m_context.client_request_id(), m_operation_span_id, 0, m_operation_span_id,
+                    m_operation_start_time, duration, m_current_location, status_code));
+            }
+        }
+
+        bool can_hedge() const
+        {
+            // Requests with a body are never hedged, as the body stream cannot be sent twice at once
+            return m_request_options.hedged_reads() &&
+                m_request_options._http_client_pool() &&
+                (m_command->m_location_mode == command_location_mode::primary_or_secondary) &&
+                (m_current_location == storage_location::primary) &&
+                (m_current_location_mode != location_mode::primary_only) &&
+                !m_command->m_request_body.is_valid();
+        }
+
+        bool try_get_hedge_delay(std::chrono::milliseconds& delay) const
+        {
+            if (!m_request_options._http_client_pool()->try_get_response_time_percentile(m_request.request_uri().authority().to_string(), protocol::hedged_read_percentile, delay))
+            {
+                return false;
+            }
+
+            delay = std::max(delay, protocol::min_hedged_read_delay);
+            return true;
+        }
+
+        void record_response_time(std::chrono::steady_clock::time_point send_time) const
+        {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - send_time);
+            m_request_options._http_client_pool()->record_response_time(m_request.request_uri().authority().to_string(), elapsed);
+        }
+
+        static pplx::task<web::http::http_response> send_hedged_request_async(std::shared_ptr<executor<T>> instance, const web::http::client::http_client_config& config, std::chrono::milliseconds delay, std::chrono::milliseconds timeout)
+        {
+            auto state = std::make_shared<hedge_state>();
+            state->send_time = std::chrono::steady_clock::now();
+
+            // Canceling the operation cancels both requests
+            auto token = instance->m_request_options.cancellation_token();
+            if (token.is_cancelable())
+            {
+                state->primary_cancellation = pplx::cancellation_token_source::create_linked_source(token);
+                state->secondary_cancellation = pplx::cancellation_token_source::create_linked_source(token);
+            }
+
+            send_hedged_leg(instance, state, config, instance->m_request, storage_location::primary);
+
+            complete_after(delay).then([instance, state, config] ()
+            {
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    if (state->done)
+                    {
+                        return;
+                    }
+
+                    ++state->started;
+                }
+
+                if (instance->should_log(client_log_level::log_level_informational))
+                {
+                    logger::instance().log(instance->m_context, client_log_level::log_level_informational, U("Primary location is slow to respond, so the request is also sent to the secondary location"));
+                }
+
+                web::http::http_request request;
+                try
+                {
+                    request = instance->build_request(storage_location::secondary);
+                }
+                catch (...)
+                {
+                    fail_hedged_leg(state, storage_location::secondary, std::current_exception());
+                    return;
+                }
+
+                send_hedged_leg(instance, state, config, request, storage_location::secondary);
+            });
+
+            // The timeout is raced here instead of by complete_before, so that a request that completes after it
+            // cannot hand its response to the executor any more
+            if (timeout.count() > 0)
+            {
+                complete_after(timeout).then([state] ()
+                {
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        if (state->done)
+                        {
+                            return;
+                        }
+
+                        state->done = true;
+                    }
+
+                    state->primary_cancellation.cancel();
+                    state->secondary_cancellation.cancel();
+                    state->completion_event.set_exception(storage_exception(utility::conversions::to_utf8string(protocol::error_client_timeout), false));
+                });
+            }
+
+            return pplx::create_task(state->completion_event).then([instance] (hedged_response result) -> web::http::http_response
+            {
+                instance->m_request = result.request;
+                instance->m_http_client_lease = result.lease;
+                instance->m_exchange_task = result.exchange_task;
+                if (result.location != instance->m_current_location)
+                {
+                    instance->m_current_location = result.location;
+                    instance->m_request_result = request_result(instance->m_start_time, instance->m_current_location);
+                }
+
+                return result.response;
+            });
+        }
+
+        static void send_hedged_leg(std::shared_ptr<executor<T>> instance, std::shared_ptr<hedge_state> state, const web::http::client::http_client_config& config, web::http::http_request request, storage_location location)
+        {
+            auto pool = instance->m_request_options._http_client_pool();
+            auto token = location == storage_location::primary ? state->primary_cancellation.get_token() : state->secondary_cancellation.get_token();
+            auto primary_host = instance->m_request.request_uri().authority().to_string();
+            auto transport = select_transport(instance->m_request_options, request.request_uri().authority());
+
+            // A transport does not need a client from the pool
+            auto acquire_task = transport ? pplx::task_from_result(http_client_pool::lease()) : pool->acquire_async(request.request_uri().authority(), config);
+            acquire_task.then([state, pool, transport, request, location, token, primary_host] (http_client_pool::lease lease) -> pplx::task<void>
+            {
+                if (token.is_canceled())
+                {
+                    pool->release(lease, true);
+                    throw storage_exception(utility::conversions::to_utf8string(protocol::error_operation_canceled), false);
+                }
+
+                pplx::task<bool> exchange_task;
+                auto request_task = send_request(transport, lease, request, token, exchange_task);
+                return request_task.then([state, pool, request, location, lease, exchange_task, primary_host] (pplx::task<web::http::http_response> response_task) mutable
+                {
+                    web::http::http_response response;
+                    try
+                    {
+                        response = response_task.get();
+                    }
+                    catch (...)
+                    {
+                        // A canceled connection may be in any state, so it is not reused
+                        release_after_exchange(pool, lease, exchange_task, false);
+                        throw;
+                    }
+
+                    bool is_first;
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        is_first = !state->done;
+                        state->done = true;
+                    }
+
+                    if (!is_first)
+                    {
+                        release_after_exchange(pool, lease, exchange_task, false);
+                        return;
+                    }
+
+                    // If the secondary location answered first, the time the primary location had taken so far still counts
+                    // as its response time, which keeps such slow responses in the window the delay is derived from
+                    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state->send_time);
+                    pool->record_response_time(primary_host, elapsed);
+
+                    if (location == storage_location::primary)
+                    {
+                        state->secondary_cancellation.cancel();
+                    }
+                    else
+                    {
+                        state->primary_cancellation.cancel();
+                    }
+
+                    hedged_response result;
+                    result.response = response;
+                    result.request = request;
+                    result.lease = lease;
+                    result.exchange_task = exchange_task;
+                    result.location = location;
+                    state->completion_event.set(result);
+                });
+            }).then([state, location] (pplx::task<void> leg_task)
+            {
+                try
+                {
+                    leg_task.wait();
+                }
+                catch (...)
+                {
+                    fail_hedged_leg(state, location, std::current_exception());
+                }
+            });
+        }
+
+        static void fail_hedged_leg(std::shared_ptr<hedge_state> state, storage_location location, std::exception_ptr error)
+        {
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (location == storage_location::primary)
+                {
+                    state->primary_error = error;
+                }
+
+                // The read only fails once every request that was sent has failed, with the error of the primary location if it had one
+                if (state->done || (++state->failed < state->started))
+                {
+                    return;
+                }
+
+                state->done = true;
+                if (state->primary_error)
+                {
+                    error = state->primary_error;
+                }
+            }
+
+            state->completion_event.set_exception(error);
+        }
+
+        // Sends the request and sets exchange_task to a task that completes once the request and the body of its response no
+        // longer use the connection, which an abandoned request still does for a while. It completes with false if they failed.
+        static pplx::task<web::http::http_response> send_request(const std::shared_ptr<http_transport>& transport, const http_client_pool::lease& lease, web::http::http_request request, const pplx::cancellation_token& token, pplx::task<bool>& exchange_task)
+        {
+            if (transport)
+            {
+                exchange_task = pplx::task_from_result(true);
+                return transport->send(request, token);
+            }
+
+            auto request_task = lease.client().request(request);
+            exchange_task = request_task.then([] (pplx::task<web::http::http_response> headers_task) -> pplx::task<bool>
+            {
+                web::http::http_response response;
+                try
+                {
+                    response = headers_task.get();
+                }
+                catch (...)
+                {
+                    return pplx::task_from_result(false);
+                }
+
+                return response.content_ready().then([] (pplx::task<web::http::http_response> body_task) -> bool
+                {
+                    try
+                    {
+                        body_task.wait();
+                        return true;
+                    }
+                    catch (...)
+                    {
+                        return false;
+                    }
+                });
+            });
+
+            // The HTTP client cannot abort a request, so a canceled one is abandoned and completes in the background
+            return complete_before(request_task, token);
+        }
+
+        // Returns a lease to the pool once its exchange no longer uses the connection, so that an abandoned request keeps
+        // its slot and the pool never has more requests in flight to a host than its limit allows
+        static void release_after_exchange(std::shared_ptr<http_client_pool> pool, http_client_pool::lease lease, pplx::task<bool> exchange_task, bool reusable, http_client_pool::request_outcome outcome = http_client_pool::request_outcome::unknown)
+        {
+            if (exchange_task.is_done())
+            {
+                pool->release(lease, reusable && exchange_task.get(), outcome);
+                return;
+            }
+
+            exchange_task.then([pool, lease, reusable, outcome] (bool completed) mutable
+            {
+                pool->release(lease, reusable && completed, outcome);
+            });
+        }
+
+        // Returns the transport that sends the requests to the endpoint, or nullptr if they are sent through an HTTP client
+        static std::shared_ptr<http_transport> select_transport(const request_options& options, const web::http::uri& authority)
+        {
+            const auto& transport = options.transport();
+            if (transport && transport->can_send(authority))
+            {
+                return transport;
+            }
+
+            return nullptr;
+        }
+
+        pplx::task<void> acquire_http_client_async(const web::http::client::http_client_config& config)
+        {
+            // Requests sent through a transport do not use an HTTP client
+            m_transport = select_transport(m_request_options, m_request.request_uri().authority());
+            if (m_transport)
+            {
+                return pplx::task_from_result();
+            }
+
+            const auto& pool = m_request_options._http_client_pool();
+            if (!pool)
+            {
+                m_http_client_lease = http_client_pool::lease(std::make_shared<web::http::client::http_client>(m_request.request_uri().authority(), config));
+                return pplx::task_from_result();
+            }
+
+            return pool->acquire_async(m_request.request_uri().authority(), config).then([this] (http_client_pool::lease lease)
+            {
+                // The caller keeps the executor alive until the request completes
+                m_http_client_lease = lease;
+            });
+        }
+
+        void release_http_client()
+        {
+            // A client is only returned to the pool when a response was received, as a failed
+            // connection is not worth keeping around
+            const auto& pool = m_request_options._http_client_pool();
+            if (pool)
+            {
+                // Server Busy and Operation Timed Out tell the pool that the host is overloaded
+                auto outcome = http_client_pool::request_outcome::unknown;
+                if (m_request_result.is_response_available())
+                {
+                    auto status_code = m_request_result.http_status_code();
+                    outcome = (status_code == web::http::status_codes::ServiceUnavailable) || (status_code == web::http::status_codes::InternalError) ?
+                        http_client_pool::request_outcome::busy :
+                        http_client_pool::request_outcome::succeeded;
+                }
+
+                release_after_exchange(pool, m_http_client_lease, m_exchange_task, m_request_result.is_response_available(), outcome);
+            }
+
+            m_http_client_lease = http_client_pool::lease();
+        }
+
+        // Returns false if the operation expires before a retry could complete after its backoff, given how long requests of
+        // the same kind have taken. A backoff that would leave too little time is shortened when that time is known.
+        bool fit_retry_before_expiry(retry_info& retry) const
+        {
+            if (!m_request_options.operation_expiry_time().is_initialized())
+            {
+                return true;
+            }
+
+            auto remaining_interval = m_request_options.operation_expiry_time().to_interval() - std::min(m_request_options.operation_expiry_time().to_interval(), utility::datetime::utc_now().to_interval());
+            std::chrono::milliseconds remaining(remaining_interval / 10000);
+
+            std::chrono::microseconds latency(0);
+            const auto& recorder = m_request_options._latency_recorder();
+            bool has_latency = recorder && recorder->try_get_mean_latency(latency_recorder::get_operation(m_request), latency);
+            auto expected_latency = std::chrono::duration_cast<std::chrono::milliseconds>(latency);
+
+            if (remaining <= expected_latency)
+            {
+                return false;
+            }
+
+            if (retry.retry_interval() + expected_latency >= remaining)
+            {
+                if (!has_latency)
+                {
+                    return false;
+                }
+
+                retry.set_retry_interval(remaining - expected_latency);
+            }
+
+            return true;
+        }
+
+        std::chrono::milliseconds remaining_time() const
+        {
+            if (m_request_options.operation_expiry_time().is_initialized())
+            {
+                auto now = utility::datetime::utc_now();
+                if (m_request_options.operation_expiry_time().to_interval() > now.to_interval())
+                {
+                    // datetime intervals are in 100-nanosecond units. Round up so that a non-zero
+                    // remaining time is never mistaken for no timeout at all.
+                    auto remaining = m_request_options.operation_expiry_time().to_interval() - now.to_interval();
+                    return std::chrono::milliseconds((remaining + 9999) / 10000);
+                }
+                else
+                {
+                    throw storage_exception(utility::conversions::to_utf8string(protocol::error_client_timeout), false);
+                }
+            }
+
+            return std::chrono::milliseconds();
+        }
+
+        template<typename R>
+        static pplx::task<R> complete_before(pplx::task<R> task, std::chrono::milliseconds timeout)
+        {
+            if (timeout.count() <= 0)
+            {
+                return task;
+            }
+
+            // Whichever of the task and the timer completes first sets the event, and the other one is ignored.
+            // A request that times out is left to complete in the background on its pooled client, which keeps its
+            // slot in the pool until then, and the timer of a request that completes in time is cancelled.
+            pplx::task_completion_event<R> completion_event;
+            auto timer = timer_wheel::instance().schedule(timeout, [completion_event] ()
+            {
+                completion_event.set_exception(storage_exception(utility::conversions::to_utf8string(protocol::error_client_timeout), false));
+            });
+
+            task.then([completion_event, timer] (pplx::task<R> completed_task)
+            {
+                timer.cancel();
+                try
+                {
+                    completion_event.set(completed_task.get());
+                }
+                catch (...)
+                {
+                    completion_event.set_exception(std::current_exception());
+                }
+            });
+
+            return pplx::create_task(completion_event);
+        }
+
+        template<typename R>
+        static pplx::task<R> complete_before(pplx::task<R> task, const pplx::cancellation_token& token)
+        {
+            if (!token.is_cancelable())
+            {
+                return task;
+            }
+
+            // Whichever of the task and the cancellation comes first sets the event, and the other one is ignored
+            pplx::task_completion_event<R> completion_event;
+            auto registration = token.register_callback([completion_event] ()
+            {
+                completion_event.set_exception(storage_exception(utility::conversions::to_utf8string(protocol::error_operation_canceled), false));
+            });
+
+            task.then([completion_event, token, registration] (pplx::task<R> completed_task)
+            {
+                token.deregister_callback(registration);
+                try
+                {
+                    completion_event.set(completed_task.get());
+                }
+                catch (...)
+                {
+                    completion_event.set_exception(std::current_exception());
+                }
+            });
+
+            return pplx::create_task(completion_event);
+        }
+
+        static storage_location get_first_location(location_mode mode)
+        {
+            switch (mode)
+            {
+            case location_mode::primary_only:
+            case location_mode::primary_then_secondary:
+                return storage_location::primary;
+
+            case location_mode::secondary_only:
+            case location_mode::secondary_then_primary:
+                return storage_location::secondary;
+
+            case location_mode::adaptive:
+                return storage_location::primary;
+            }
+
+            throw std::invalid_argument("mode");
+        }
+
+        // The adaptive location mode starts a read at the healthier location and is otherwise replaced by
+        // the fixed mode that starts there, so that the retry policies never see it
+        void resolve_adaptive_location()
+        {
+            switch (m_command->m_location_mode)
+            {
+            case command_location_mode::primary_only:
+                m_current_location_mode = location_mode::primary_only;
+                m_current_location = storage_location::primary;
+                return;
+
+            case command_location_mode::secondary_only:
+                m_current_location_mode = location_mode::secondary_only;
+                m_current_location = storage_location::secondary;
+                return;
+
+            default:
+                break;
+            }
+
+            const auto& selector = m_request_options._location_selector();
+            if (!selector || m_command->m_request_uri.secondary_uri().is_empty())
+            {
+                m_current_location_mode = location_mode::primary_only;
+                m_current_location = storage_location::primary;
+                return;
+            }
+
+            m_record_location_health = true;
+            m_current_location = selector->select(m_command->m_request_uri.primary_uri().authority().to_string());
+            m_current_location_mode = m_current_location == storage_location::primary ?
+                location_mode::primary_then_secondary :
+                location_mode::secondary_then_primary;
+        }
+
+        void record_location_health() const
+        {
+            if (!m_record_location_health)
+            {
+                return;
+            }
+
+            // A request without a response ended just now, as its result was created when it was sent.
+            // Server errors count as failures of the location, while other errors are about the request itself.
+            auto end_time = m_request_result.is_response_available() ? m_request_result.end_time() : utility::datetime::utc_now();
+            auto start = m_request_result.start_time().to_interval();
+            auto end = end_time.to_interval();
+            std::chrono::milliseconds latency(end > start ? static_cast<std::chrono::milliseconds::rep>((end - start) / 10000) : 0);
+            bool failed = !m_request_result.is_response_available() || (m_request_result.http_status_code() >= web::http::status_codes::InternalError);
+            m_request_options._location_selector()->record(m_command->m_request_uri.primary_uri().authority().to_string(), m_request_result.target_location(), latency, failed);
+        }
+
+        // A location whose circuit is open is not sent the request. It goes to the other location instead if the
+        // location mode allows it and that circuit lets it through, and otherwise the operation fails right away.
+        void admit_to_circuit()
+        {
+            const auto& breaker = m_request_options._circuit_breaker();
+            if (!breaker || !breaker->is_enabled())
+            {
+                return;
+            }
+
+            auto account = m_command->m_request_uri.primary_uri().authority().to_string();
+            if (breaker->try_admit(account, m_current_location))
+            {
+                return;
+            }
+
+            bool can_switch = m_current_location_mode == location_mode::primary_then_secondary || m_current_location_mode == location_mode::secondary_then_primary;
+            if (can_switch && breaker->try_admit(account, get_next_location()))
+            {
+                if (should_log(client_log_level::log_level_warning))
+                {
+                    logger::instance().log(m_context, client_log_level::log_level_warning, U("Circuit is open, so sending the request to the other location"));
+                }
+
+                m_current_location = get_next_location();
+                return;
+            }
+
+            if (should_log(client_log_level::log_level_error))
+            {
+                logger::instance().log(m_context, client_log_level::log_level_error, U("Circuit is open, so failing the operation without sending a request"));
+            }
+
+            throw storage_exception(utility::conversions::to_utf8string(protocol::error_circuit_open), false);
+        }
+
+        void record_circuit_outcome() const
+        {
+            const auto& breaker = m_request_options._circuit_breaker();
+            if (!breaker || !breaker->is_enabled())
+            {
+                return;
+            }
+
+            bool failed = !m_request_result.is_response_available() || (m_request_result.http_status_code() >= web::http::status_codes::InternalError);
+            breaker->record(m_command->m_request_uri.primary_uri().authority().to_string(), m_request_result.target_location(), failed);
+        }
+
+        void forget_missing_resource() const
+        {
+            // A resource that is gone is forgotten, so that creating it if it does not exist sends a request again
+            const auto& cache = m_request_options._existence_cache();
+            if (cache && m_request_result.is_response_available() && (m_request_result.http_status_code() == web::http::status_codes::NotFound))
+            {
+                cache->remove_containing(m_command->m_request_uri.primary_uri().to_string());
+            }
+        }
+
+        storage_location get_next_location() const
+        {
+            switch (m_current_location_mode)
+            {
+            case location_mode::primary_only:
+                return storage_location::primary;
+
+            case location_mode::secondary_only:
+                return storage_location::secondary;
+
+            case location_mode::primary_then_secondary:
+            case location_mode::secondary_then_primary:
+                return m_current_location == storage_location::primary ?
+                    storage_location::secondary :
+                    storage_location::primary;
+            }
+
+            throw std::invalid_argument("mode");
+        }
+
+        void validate_location_mode()
+        {
+            bool is_valid;
+            switch (m_current_location_mode)
+            {
+            case location_mode::primary_only:
+                is_valid = !m_command->m_request_uri.primary_uri().is_empty();
+                break;
 
             case location_mode::secondary_only:
                 is_valid = !m_command->m_request_uri.secondary_uri().is_empty();
@@ -628,7 +1812,7 @@ namespace wa { namespace storage { namespace core {
                     throw storage_exception(utility::conversions::to_utf8string(protocol::error_primary_only_command), false);
                 }
             
-                if (logger::instance().should_log(m_context, client_log_level::log_level_verbose))
+                if (should_log(client_log_level::log_level_verbose))
                 {
                     logger::instance().log(m_context, client_log_level::log_level_verbose, protocol::error_primary_only_command);
                 }
@@ -643,7 +1827,7 @@ namespace wa { namespace storage { namespace core {
                     throw storage_exception(utility::conversions::to_utf8string(protocol::error_secondary_only_command), false);
                 }
 
-                if (logger::instance().should_log(m_context, client_log_level::log_level_verbose))
+                if (should_log(client_log_level::log_level_verbose))
                 {
                     logger::instance().log(m_context, client_log_level::log_level_verbose, protocol::error_secondary_only_command);
                 }
@@ -657,14 +1841,36 @@ namespace wa { namespace storage { namespace core {
         std::shared_ptr<storage_command<T>> m_command;
         request_options m_request_options;
         operation_context m_context;
+
+        // Decided once, so that a sampled operation logs all its steps and the others none of their details
+        client_log_level m_log_level;
+
         utility::datetime m_start_time;
-        web::http::uri_builder m_uri_builder;
         web::http::http_request m_request;
         request_result m_request_result;
         hash_streambuf m_hash_streambuf;
-        splitter_streambuf<concurrency::streams::ostream::traits::char_type> m_response_streambuf;
+        hash_streambuf m_crc64_streambuf;
+        hashing_streambuf<concurrency::streams::ostream::traits::char_type> m_response_streambuf;
         retry_policy m_retry_policy;
+        http_client_pool::lease m_http_client_lease;
+        pplx::task<bool> m_exchange_task;
+        std::shared_ptr<http_transport> m_transport;
         int m_retry_count;
+        bool m_copy_response_body;
+        bool m_record_location_health;
+        bool m_body_complete;
+        utility::size64_t m_response_length;
+        request_timings m_timings;
+        allocation_counters m_allocations;
+        uint64_t m_operation_span_id;
+        utility::string_t m_operation_name;
+        bool m_phase_events;
+        uint64_t m_phase_activity;
+        trace_phase m_traced_phase;
+        phase_event m_phase_event;
+        std::chrono::steady_clock::time_point m_operation_start_time;
+        std::chrono::steady_clock::time_point m_attempt_start_time;
+        std::chrono::steady_clock::time_point m_phase_start_time;
         storage_location m_current_location;
         location_mode m_current_location_mode;
         T m_result;
@@ -703,6 +1909,80 @@ namespace wa { namespace storage { namespace core {
         }
     };
 
+    // Calls the preprocessing step of an operation, and gives a command without a result the placeholder result
+    template<typename T>
+    struct preprocess_invoker
+    {
+        template<typename Operation>
+        static T invoke(const Operation& operation, const web::http::http_response& response, operation_context context)
+        {
+            return operation.preprocess_response(response, context);
+        }
+    };
+
+    template<>
+    struct preprocess_invoker<void>
+    {
+        template<typename Operation>
+        static void_command_type invoke(const Operation& operation, const web::http::http_response& response, operation_context context)
+        {
+            operation.preprocess_response(response, context);
+            return VOID_COMMAND_RESULT;
+        }
+    };
+
+    // The base of the operations of a static_storage_command, which leaves signing to the authentication handler of the command
+    class basic_command_operation
+    {
+    public:
+
+        // Returns false if the command is to sign the request itself
+        bool sign_request(web::http::http_request&, operation_context) const
+        {
+            return false;
+        }
+    };
+
+    // A command whose request is built and whose response is preprocessed by an operation object held by value.
+    // The operation derives from basic_command_operation, and provides build_request and preprocess_response with the
+    // same parameters as the steps of a storage_command. It can also hide sign_request to sign the requests it built,
+    // for example from a prepared_request. Nothing but the command itself is allocated for the steps, which matters
+    // for small requests. The other steps can still be set as function objects.
+    template<typename T, typename Operation>
+    class static_storage_command : public storage_command<T>
+    {
+    public:
+
+        static_storage_command(const storage_uri& request_uri, Operation operation)
+            : storage_command<T>(request_uri), m_operation(std::move(operation))
+        {
+        }
+
+    protected:
+
+        web::http::http_request build_request(web::http::uri_builder builder, const std::chrono::seconds& timeout, operation_context context) const override
+        {
+            return m_operation.build_request(builder, timeout, context);
+        }
+
+        void sign_request(web::http::http_request& request, operation_context context) const override
+        {
+            if (!m_operation.sign_request(request, context))
+            {
+                storage_command<T>::sign_request(request, context);
+            }
+        }
+
+        typename storage_command<T>::result_type preprocess_response(const web::http::http_response& response, operation_context context) const override
+        {
+            return preprocess_invoker<T>::invoke(m_operation, response, context);
+        }
+
+    private:
+
+        Operation m_operation;
+    };
+
     template<>
     class executor<void>
     {
@@ -0,0 +1,79 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="existence_cache.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Remembers the containers, queues and tables that were recently confirmed to exist, shared by the copies of a service client.
+    /// </summary>
+    /// <remarks>Resources are keyed by their primary URI. A request that fails with Not Found forgets the resource it addresses.</remarks>
+    class existence_cache
+    {
+    public:
+
+        existence_cache()
+            : m_time_to_live(0)
+        {
+        }
+
+        /// <summary>
+        /// Gets how long a resource is remembered, or 0 if the cache is disabled.
+        /// </summary>
+        std::chrono::seconds time_to_live() const;
+
+        /// <summary>
+        /// Sets how long a resource is remembered. 0 disables the cache and forgets every resource.
+        /// </summary>
+        void set_time_to_live(std::chrono::seconds value);
+
+        /// <summary>
+        /// Returns true if the resource was confirmed to exist within the time to live.
+        /// </summary>
+        bool contains(const utility::string_t& key);
+
+        /// <summary>
+        /// Records that the resource exists.
+        /// </summary>
+        void add(const utility::string_t& key);
+
+        /// <summary>
+        /// Forgets the resource.
+        /// </summary>
+        void remove(const utility::string_t& key);
+
+        /// <summary>
+        /// Forgets the resource that the request URI addresses or lies under, such as the container of a blob.
+        /// </summary>
+        void remove_containing(const utility::string_t& request_uri);
+
+    private:
+
+        std::chrono::seconds m_time_to_live;
+        std::unordered_map<utility::string_t, std::chrono::steady_clock::time_point> m_expiry_times;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,108 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="gzip_decoder.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Decodes gzip content, such as a response body with a Content-Encoding of gzip, while it is being read.
+    /// </summary>
+    /// <remarks>The compressed bytes are pulled from the source only as the decoded bytes are read, so no more than a chunk of
+    /// either is held at a time. Members that follow each other are decoded as one stream, and the CRC-32 and the size in the
+    /// trailer of each member are verified. Invalid content throws a std::runtime_error.</remarks>
+    class gzip_decoder
+    {
+    public:
+
+        /// <summary>
+        /// Creates a decoder that reads the compressed bytes from the given function, which returns 0 at the end of the content.
+        /// </summary>
+        explicit gzip_decoder(std::function<size_t (uint8_t*, size_t)> source);
+
+        /// <summary>
+        /// Decodes up to the given number of bytes into the buffer, returning 0 once the content has ended.
+        /// </summary>
+        size_t read(uint8_t* buffer, size_t count);
+
+    private:
+
+        enum decoder_state
+        {
+            state_member_header,
+            state_block_header,
+            state_stored_block,
+            state_compressed_block,
+            state_member_trailer,
+            state_done
+        };
+
+        // A canonical Huffman code: the number of codes of each length, and the symbols in the order of their codes
+        struct huffman_code
+        {
+            uint16_t counts[16];
+            std::vector<uint16_t> symbols;
+        };
+
+        bool read_member_header();
+        void read_block_header();
+        void read_dynamic_codes();
+        void read_member_trailer();
+        void end_block();
+
+        bool try_read_byte(uint8_t& value);
+        uint8_t read_byte();
+        uint32_t read_bits(int count);
+        int decode_symbol(const huffman_code& code);
+        void emit(uint8_t value, uint8_t* buffer, size_t& written);
+
+        static void build_code(huffman_code& code, const uint8_t* lengths, size_t count);
+        static void fail();
+
+        std::function<size_t (uint8_t*, size_t)> m_source;
+        std::vector<uint8_t> m_input;
+        size_t m_input_position;
+        size_t m_input_size;
+        bool m_source_done;
+
+        uint32_t m_bit_buffer;
+        int m_bit_count;
+
+        decoder_state m_state;
+        bool m_last_block;
+        size_t m_stored_remaining;
+        huffman_code m_literal_code;
+        huffman_code m_distance_code;
+        size_t m_copy_length;
+        size_t m_copy_distance;
+
+        // The last 32 KB of decoded bytes, which back-references copy from
+        std::vector<uint8_t> m_window;
+        size_t m_window_position;
+        size_t m_window_filled;
+
+        uint32_t m_member_crc;
+        uint32_t m_member_size;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,42 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="hash_crc64.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "basic_types.h"
+#include "streambuf.h"
+#include "hash_software.h"
+
+namespace wa { namespace storage { namespace core {
+
+    // CRC64 is not provided by the platform crypto libraries, so the same software implementation is used everywhere
+    class basic_hash_crc64_streambuf : public basic_hash_streambuf
+    {
+    public:
+
+        basic_hash_crc64_streambuf();
+
+        pplx::task<void> _close_write();
+        pplx::task<int_type> _putc(char_type ch);
+        pplx::task<size_t> _putn(const char_type* ptr, size_t count);
+
+    private:
+
+        crc64_hash m_hash_object;
+    };
+
+}}} // namespace wa::storage::core
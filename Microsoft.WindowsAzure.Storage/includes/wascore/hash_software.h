@@ -0,0 +1,127 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="hash_software.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A portable implementation of the MD5 message digest (RFC 1321).
+    /// </summary>
+    class md5_hash
+    {
+    public:
+
+        md5_hash();
+
+        void update(const uint8_t* data, size_t count);
+        std::vector<unsigned char> finalize();
+
+        // Returns the intermediate state of a hash that has not been finalized, so that hashing can continue in another process
+        std::vector<uint8_t> save_state() const;
+
+        // Restores a state returned by save_state, returning false if it is not a valid state
+        bool load_state(const std::vector<uint8_t>& state);
+
+    private:
+
+        void transform(const uint8_t* data, size_t blocks);
+
+        uint32_t m_state[4];
+        uint64_t m_length;
+        uint8_t m_buffer[64];
+        size_t m_buffered;
+    };
+
+    /// <summary>
+    /// A portable implementation of the SHA-256 message digest (FIPS 180-4).
+    /// </summary>
+    class sha256_hash
+    {
+    public:
+
+        static const size_t digest_size = 32;
+
+        sha256_hash();
+
+        void update(const uint8_t* data, size_t count);
+        std::vector<unsigned char> finalize();
+
+        // Writes the digest_size bytes of the digest to the given buffer
+        void finalize(uint8_t* digest);
+
+    private:
+
+        void transform(const uint8_t* data, size_t blocks);
+
+        uint32_t m_state[8];
+        uint64_t m_length;
+        uint8_t m_buffer[64];
+        size_t m_buffered;
+    };
+
+    /// <summary>
+    /// A portable implementation of HMAC-SHA256 (RFC 2104).
+    /// </summary>
+    /// <remarks>
+    /// The key schedule is done by the constructor and the object holds no heap memory, so a keyed
+    /// instance can be copied to sign each message without repeating it.
+    /// </remarks>
+    class hmac_sha256_hash
+    {
+    public:
+
+        static const size_t digest_size = sha256_hash::digest_size;
+
+        explicit hmac_sha256_hash(const std::vector<unsigned char>& key);
+
+        void update(const uint8_t* data, size_t count);
+        std::vector<unsigned char> finalize();
+
+        // Writes the digest_size bytes of the digest to the given buffer
+        void finalize(uint8_t* digest);
+
+    private:
+
+        sha256_hash m_inner;
+        sha256_hash m_outer;
+    };
+
+    /// <summary>
+    /// A portable implementation of the CRC64 checksum used by the storage service (the reflected
+    /// polynomial 0x9A6C9329AC4BC9B5), processing eight bytes at a time. The result is the checksum
+    /// in little-endian byte order.
+    /// </summary>
+    class crc64_hash
+    {
+    public:
+
+        crc64_hash();
+
+        void update(const uint8_t* data, size_t count);
+        std::vector<unsigned char> finalize();
+
+    private:
+
+        uint64_t m_crc;
+    };
+
+}}} // namespace wa::storage::core
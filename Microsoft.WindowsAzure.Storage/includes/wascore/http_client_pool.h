@@ -0,0 +1,162 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="http_client_pool.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "cpprest/http_client.h"
+
+#include "wascore/basic_types.h"
+#include "async_semaphore.h"
+#include "was/common.h"
+
+namespace wa { namespace storage { namespace core {
+
+    class http_client_pool : public std::enable_shared_from_this<http_client_pool>
+    {
+    public:
+
+        // Tells the adaptive concurrency limit how the host handled a request
+        enum class request_outcome
+        {
+            unknown,
+            succeeded,
+            busy
+        };
+
+        class lease
+        {
+        public:
+
+            lease()
+                : m_generation(0)
+            {
+            }
+
+            // Creates a lease for a client that does not belong to any pool
+            explicit lease(std::shared_ptr<web::http::client::http_client> client)
+                : m_client(client), m_generation(0)
+            {
+            }
+
+            bool is_valid() const
+            {
+                return m_client != nullptr;
+            }
+
+            web::http::client::http_client& client() const
+            {
+                return *m_client;
+            }
+
+        private:
+
+            lease(utility::string_t key, utility::string_t host, std::shared_ptr<web::http::client::http_client> client, std::shared_ptr<async_semaphore> host_semaphore, int generation)
+                : m_key(std::move(key)), m_host(std::move(host)), m_client(client), m_host_semaphore(host_semaphore), m_generation(generation)
+            {
+            }
+
+            utility::string_t m_key;
+            utility::string_t m_host;
+            std::shared_ptr<web::http::client::http_client> m_client;
+            std::shared_ptr<async_semaphore> m_host_semaphore;
+
+            // The number of times the adaptive limit had been reduced when the lease was acquired
+            int m_generation;
+
+            friend class http_client_pool;
+        };
+
+        explicit http_client_pool(const connection_pool_settings& settings)
+            : m_settings(settings)
+        {
+        }
+
+        // Returns the configuration of the clients that requests are sent through, which the clients are pooled by
+        static web::http::client::http_client_config client_config();
+
+        pplx::task<lease> acquire_async(const web::http::uri& authority, const web::http::client::http_client_config& config);
+        void release(lease& value, bool reusable, request_outcome outcome = request_outcome::unknown);
+
+        // Opens up to the given number of connections to the host and keeps them idle, returning how many could be opened
+        pplx::task<int> warm_up_async(const web::http::uri& authority, const web::http::client::http_client_config& config, int connections);
+
+        connection_pool_settings settings() const;
+        void set_settings(const connection_pool_settings& value);
+
+        // Keeps the time it took the host to send the response headers, out of a window of recent requests
+        void record_response_time(const utility::string_t& host, std::chrono::milliseconds value);
+
+        // Returns false if too few response times have been recorded for the host yet
+        bool try_get_response_time_percentile(const utility::string_t& host, double percentile, std::chrono::milliseconds& value) const;
+
+    private:
+
+        struct idle_client
+        {
+            std::shared_ptr<web::http::client::http_client> client;
+            std::chrono::steady_clock::time_point last_used;
+        };
+
+        struct host_limit
+        {
+            host_limit()
+                : max_connections(0), adaptive(false), limit(0.0), granted(0), generation(0)
+            {
+            }
+
+            int max_connections;
+            bool adaptive;
+            std::shared_ptr<async_semaphore> semaphore;
+
+            // With an adaptive limit, the semaphore holds max_connections units, of which all but the granted ones
+            // are held back. The limit grows by fractions of a unit, and generation counts the reductions.
+            double limit;
+            int granted;
+            int generation;
+        };
+
+        struct response_times
+        {
+            response_times()
+                : next(0)
+            {
+            }
+
+            std::vector<std::chrono::milliseconds::rep> window;
+            size_t next;
+        };
+
+        static utility::string_t get_key(const utility::string_t& host, const web::http::client::http_client_config& config);
+        host_limit* get_host_limit(const utility::string_t& host);
+        void adapt_host_limit(const lease& value, request_outcome outcome);
+        std::shared_ptr<web::http::client::http_client> get_idle_client(const utility::string_t& key);
+        void remove_expired_clients(std::chrono::steady_clock::time_point now);
+
+        connection_pool_settings m_settings;
+        std::map<utility::string_t, std::deque<idle_client>> m_idle_clients;
+        std::map<utility::string_t, host_limit> m_host_limits;
+        std::map<utility::string_t, response_times> m_response_times;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
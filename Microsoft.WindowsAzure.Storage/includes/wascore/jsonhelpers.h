@@ -0,0 +1,227 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="jsonhelpers.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cpprest/basic_types.h"
+#include "cpprest/streams.h"
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core { namespace json {
+
+    /// <summary>
+    /// A non-owning view of UTF-8 text read by a <see cref="json_reader"/>. It is only valid until the reader moves to the next token.
+    /// </summary>
+    class json_string_view
+    {
+    public:
+
+        json_string_view()
+            : m_data(nullptr), m_size(0)
+        {
+        }
+
+        json_string_view(const char* data, size_t size)
+            : m_data(data), m_size(size)
+        {
+        }
+
+        const char* data() const
+        {
+            return m_data;
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        /// <summary>
+        /// Returns true if the viewed bytes are exactly the given ASCII text
+        /// </summary>
+        bool equals(const char* text) const
+        {
+            size_t length = std::strlen(text);
+            return m_size == length && std::memcmp(m_data, text, length) == 0;
+        }
+
+        /// <summary>
+        /// Copies the viewed bytes into a UTF-8 string
+        /// </summary>
+        std::string to_utf8_string() const
+        {
+            return std::string(m_data, m_size);
+        }
+
+        /// <summary>
+        /// Converts the viewed bytes into a platform string
+        /// </summary>
+        utility::string_t to_string() const;
+
+    private:
+
+        const char* m_data;
+        size_t m_size;
+    };
+
+    /// <summary>
+    /// Incremental SAX-style JSON reader. The input is consumed in chunks as parsing proceeds, and every token is
+    /// reported to a callback as soon as it has been read, so no document is built.
+    /// </summary>
+    class json_reader
+    {
+    public:
+
+        virtual ~json_reader() {}
+
+        /// <summary>
+        /// Parses the input to the end. Throws std::runtime_error if the input is not well-formed JSON.
+        /// </summary>
+        WASTORAGE_API void parse();
+
+    protected:
+
+        /// <summary>
+        /// Creates a reader that pulls UTF-8 text from the given stream.
+        /// </summary>
+        WASTORAGE_API explicit json_reader(concurrency::streams::istream stream);
+
+        /// <summary>
+        /// Creates a reader over UTF-8 text in memory. The memory must outlive the reader.
+        /// </summary>
+        WASTORAGE_API json_reader(const char* data, size_t size);
+
+        /// <summary>
+        /// Callback for handling the start of an object.
+        /// </summary>
+        virtual void handle_begin_object()
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling the end of an object.
+        /// </summary>
+        virtual void handle_end_object()
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling the start of an array.
+        /// </summary>
+        virtual void handle_begin_array()
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling the end of an array.
+        /// </summary>
+        virtual void handle_end_array()
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling the name of an object member. The member's value is reported next.
+        /// </summary>
+        virtual void handle_key(const json_string_view&)
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling a string value, with escape sequences already decoded.
+        /// </summary>
+        virtual void handle_string(const json_string_view&)
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling a number value. The text is passed as it appears in the input, and is_integer
+        /// is true if it has neither a fraction nor an exponent.
+        /// </summary>
+        virtual void handle_number(const json_string_view&, bool)
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling a boolean value.
+        /// </summary>
+        virtual void handle_boolean(bool)
+        {
+        }
+
+        /// <summary>
+        /// Callback for handling a null value.
+        /// </summary>
+        virtual void handle_null()
+        {
+        }
+
+        /// <summary>
+        /// Returns the number of objects and arrays enclosing the current token
+        /// </summary>
+        size_t depth() const
+        {
+            return m_containers.size();
+        }
+
+    private:
+
+        enum parse_state
+        {
+            state_value,
+            state_first_value,
+            state_key,
+            state_first_key,
+            state_colon,
+            state_comma,
+            state_done
+        };
+
+        bool fill_buffer();
+        bool ensure(size_t count);
+        bool skip_whitespace();
+        void read_value();
+        void end_container(char open);
+        void end_value();
+        json_string_view read_string();
+        json_string_view read_number(bool& is_integer);
+        void read_literal(const char* literal, size_t length);
+        void decode_string(const char* data, size_t size);
+        void fail(const char* message);
+
+        concurrency::streams::streambuf<uint8_t> m_source;
+        bool m_sourceDone;
+        std::string m_buffer;
+        const char* m_data;
+        size_t m_size;
+        size_t m_position;
+
+        parse_state m_state;
+        std::vector<char> m_containers;
+        std::string m_decoded;
+    };
+
+}}}} // namespace wa::storage::core::json
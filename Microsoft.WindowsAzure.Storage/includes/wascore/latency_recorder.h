@@ -0,0 +1,109 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="latency_recorder.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "wascore/basic_types.h"
+#include "was/common.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Aggregates how long the phases of the requests made by a service client took, for each kind of request,
+    /// and reports each request to the metrics sink of the service client, if it has one.
+    /// </summary>
+    class latency_recorder
+    {
+    public:
+
+        latency_recorder()
+        {
+        }
+
+        /// <summary>
+        /// Returns the kind of the request, which is its method followed by the resource type and component it addresses, if any.
+        /// </summary>
+        static utility::string_t get_operation(const web::http::http_request& request);
+
+        /// <summary>
+        /// Returns the name of the service that the requests are sent to, such as blob.
+        /// </summary>
+        const utility::string_t& service() const
+        {
+            return m_service;
+        }
+
+        /// <summary>
+        /// Sets the name of the service that the requests are sent to. This is only called while the service client is initialized.
+        /// </summary>
+        void set_service(utility::string_t value)
+        {
+            m_service = std::move(value);
+        }
+
+        /// <summary>
+        /// Returns the sink that every request is reported to, or nullptr if there is none.
+        /// </summary>
+        std::shared_ptr<wa::storage::metrics_sink> metrics_sink() const
+        {
+            return std::atomic_load(&m_metrics_sink);
+        }
+
+        /// <summary>
+        /// Sets the sink that every request is reported to. Passing nullptr stops reporting requests.
+        /// </summary>
+        void set_metrics_sink(std::shared_ptr<wa::storage::metrics_sink> value)
+        {
+            std::atomic_store(&m_metrics_sink, value);
+        }
+
+        /// <summary>
+        /// Adds the phases of a request of the specified kind to its histograms.
+        /// </summary>
+        void record(const utility::string_t& operation, const request_timings& timings);
+
+        /// <summary>
+        /// Returns a copy of the histograms of each kind of request.
+        /// </summary>
+        std::map<utility::string_t, request_latency_histograms> histograms() const;
+
+        /// <summary>
+        /// Gets the mean time that whole requests of the specified kind took. Returns false if too few of them have been recorded yet.
+        /// </summary>
+        bool try_get_mean_latency(const utility::string_t& operation, std::chrono::microseconds& value) const;
+
+        /// <summary>
+        /// Discards all the histograms.
+        /// </summary>
+        void reset();
+
+    private:
+
+        utility::string_t m_service;
+
+        // Read by every request, so it is accessed atomically rather than under the mutex
+        std::shared_ptr<wa::storage::metrics_sink> m_metrics_sink;
+
+        std::map<utility::string_t, request_latency_histograms> m_histograms;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,92 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="location_selector.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include "wascore/basic_types.h"
+#include "was/core.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Tracks the latency and error rate of the primary and secondary locations of each account a service client
+    /// talks to, and picks the location that reads in the adaptive location mode start at.
+    /// </summary>
+    class location_selector
+    {
+    public:
+
+        location_selector()
+        {
+        }
+
+        /// <summary>
+        /// Returns the location that a read from the account with the specified primary endpoint should be sent to first.
+        /// </summary>
+        /// <remarks>This is usually the healthier location, but the other one is returned once in a while so that its health stays known.</remarks>
+        storage_location select(const utility::string_t& account);
+
+        /// <summary>
+        /// Records how long a request to a location of the account took, and whether the location failed to serve it.
+        /// </summary>
+        void record(const utility::string_t& account, storage_location location, std::chrono::milliseconds latency, bool failed);
+
+    private:
+
+        struct location_health
+        {
+            location_health()
+                : latency(0.0), error_rate(0.0), samples(0)
+            {
+            }
+
+            // Exponentially weighted moving averages of the latency in milliseconds and of the fraction of failed requests
+            double latency;
+            double error_rate;
+            int samples;
+            std::chrono::steady_clock::time_point last_used;
+        };
+
+        struct account_health
+        {
+            account_health()
+                : preferred(storage_location::primary)
+            {
+            }
+
+            location_health& get(storage_location location)
+            {
+                return location == storage_location::secondary ? secondary : primary;
+            }
+
+            location_health primary;
+            location_health secondary;
+            storage_location preferred;
+        };
+
+        static double get_cost(const location_health& health);
+
+        std::map<utility::string_t, account_health> m_accounts;
+        std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,106 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="log_ring.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "wascore/basic_types.h"
+#include "was/common.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A bounded ring of log records that many threads push to without taking a lock, and that a background
+    /// thread drains. Records keep their fields as they were passed, so messages are only formatted once drained.
+    /// </summary>
+    class log_ring
+    {
+    public:
+
+        typedef std::function<void(client_log_level level, const utility::string_t& message)> writer;
+
+        /// <summary>
+        /// Creates a ring with room for the given number of records, rounded up to a power of two. Every drained record is passed to the writer.
+        /// </summary>
+        log_ring(size_t capacity, writer write);
+
+        /// <summary>
+        /// Adds a record whose message is the format, with each %d replaced by the value and each %s by the next of the texts.
+        /// A null format makes the first text the message. Never blocks: if the ring is full, the record is dropped and counted.
+        /// </summary>
+        bool try_push(client_log_level level, const utility::char_t* format, int64_t value, const utility::string_t& text1, const utility::string_t& text2);
+
+        /// <summary>
+        /// Writes all the records that have been pushed so far.
+        /// </summary>
+        void flush();
+
+        /// <summary>
+        /// Returns the number of records that have been dropped because the ring was full.
+        /// </summary>
+        uint64_t dropped_count() const
+        {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+        static utility::string_t format_message(const utility::char_t* format, int64_t value, const utility::string_t& text1, const utility::string_t& text2);
+
+    private:
+
+        struct slot
+        {
+            slot()
+                : sequence(0), level(client_log_level::log_level_off), format(nullptr), value(0)
+            {
+            }
+
+            // Equals the position of the slot when it is free for that position's producer, and the position
+            // plus one once the record has been written and can be drained
+            std::atomic<size_t> sequence;
+
+            client_log_level level;
+            const utility::char_t* format;
+            int64_t value;
+            utility::string_t text1;
+            utility::string_t text2;
+        };
+
+        log_ring(const log_ring&);
+        log_ring& operator=(const log_ring&);
+
+        void start_drain_thread();
+        size_t drain();
+
+        std::unique_ptr<slot[]> m_slots;
+        size_t m_mask;
+        std::atomic<size_t> m_enqueue_position;
+        std::atomic<uint64_t> m_dropped;
+        writer m_write;
+
+        // Only the draining side locks this, so that the drain thread and flush never drain at the same time
+        std::mutex m_drain_mutex;
+        size_t m_dequeue_position;
+        uint64_t m_reported_dropped;
+        std::once_flag m_drain_thread_flag;
+    };
+
+}}} // namespace wa::storage::core
@@ -18,10 +18,38 @@
 #pragma once
 
 #include "wascore/basic_types.h"
+#include "wascore/log_ring.h"
 #include "was/common.h"
 
 namespace wa { namespace storage { namespace core {
 
+    // The phases of a request that the executor writes start and stop events for, numbered as the tasks of the event manifest
+    enum class trace_phase : uint8_t
+    {
+        none = 0,
+        attempt = 1,
+        build = 2,
+        connection_wait = 3,
+        time_to_first_byte = 4,
+        body = 5,
+        parse = 6
+    };
+
+    // The payload of a phase event. The status code and the byte count are only written by stop events.
+    struct phase_event
+    {
+        phase_event()
+            : location(storage_location::unspecified), status_code(0), bytes(0)
+        {
+        }
+
+        utility::string_t operation;
+        utility::string_t client_request_id;
+        storage_location location;
+        web::http::status_code status_code;
+        utility::size64_t bytes;
+    };
+
     class logger
     {
     public:
@@ -37,11 +65,39 @@ namespace wa { namespace storage { namespace core {
         ~logger();
 
         void log(wa::storage::operation_context context, client_log_level level, const utility::string_t& message) const;
+
+        // These keep the fields of the message as they are and leave formatting it to the thread that writes the log.
+        // The format must be a string literal, in which %d stands for the value and each %s for the next text.
+        void log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, int64_t value) const;
+        void log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, const utility::string_t& text) const;
+        void log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, int64_t value, const utility::string_t& text) const;
+        void log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, const utility::string_t& text1, const utility::string_t& text2) const;
+
         bool should_log(wa::storage::operation_context context, client_log_level level) const;
 
+        // Returns the level up to which an operation using the context logs, which is computed once per operation.
+        // Each call counts as a new operation for the sampling interval of the context.
+        client_log_level operation_log_level(wa::storage::operation_context context) const;
+
+        // Writes all the messages logged so far
+        void flush() const;
+
+        // Returns true if a trace session is listening to phase events, which is cheap enough to check for every attempt
+        bool phase_events_enabled() const;
+
+        // Phase events are written right away rather than through the ring, so their timestamps line up with other events
+        // in the trace. The events of one attempt share the activity, through which start and stop events are matched.
+        void write_phase_start(trace_phase phase, uint64_t activity, const phase_event& value) const;
+        void write_phase_stop(trace_phase phase, uint64_t activity, const phase_event& value) const;
+
     private:
 
         logger();
+
+        // Messages are written by a background thread that may outlive the logger, so the ring is never freed
+        log_ring* m_ring;
+
+        mutable std::atomic<size_t> m_operation_count;
     };
 
 }}} // namespace wa::storage::core
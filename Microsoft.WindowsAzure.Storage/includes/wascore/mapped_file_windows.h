@@ -0,0 +1,82 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="mapped_file_windows.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "basic_types.h"
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A file mapped into memory in its entirety.
+    /// </summary>
+    class mapped_file
+    {
+    public:
+
+        /// <summary>
+        /// Maps an existing file for reading.
+        /// </summary>
+        /// <param name="path">The path of the file.</param>
+        static std::shared_ptr<mapped_file> open_read(const utility::string_t& path);
+
+        /// <summary>
+        /// Creates or truncates a file, preallocates it to the specified size and maps it for writing.
+        /// </summary>
+        /// <param name="path">The path of the file.</param>
+        /// <param name="size">The size of the file, in bytes.</param>
+        /// <param name="sparse"><c>true</c> to create a sparse file, whose regions that are never written take no disk space, where the file system supports it.</param>
+        static std::shared_ptr<mapped_file> create(const utility::string_t& path, utility::size64_t size, bool sparse = false);
+
+        ~mapped_file();
+
+        uint8_t* data() const
+        {
+            return m_data;
+        }
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        /// <summary>
+        /// Writes modified pages of a writable mapping to the file.
+        /// </summary>
+        void flush();
+
+    private:
+
+        mapped_file(HANDLE file, utility::size64_t size, bool writable);
+        mapped_file(const mapped_file&);
+        mapped_file& operator=(const mapped_file&);
+
+        HANDLE m_file;
+        HANDLE m_mapping;
+        uint8_t* m_data;
+        size_t m_size;
+        bool m_writable;
+    };
+
+}}} // namespace wa::storage::core
+
+#endif
@@ -0,0 +1,93 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="memory_budget.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "wascore/basic_types.h"
+#include "async_semaphore.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A number of bytes that the buffers of blob streams can hold at once, shared by all streams of a service client.
+    /// </summary>
+    class memory_budget : public std::enable_shared_from_this<memory_budget>
+    {
+    public:
+
+        /// <summary>
+        /// A part of the budget held by a buffer, which is returned to the budget when this object is destroyed.
+        /// </summary>
+        class reservation
+        {
+        public:
+
+            ~reservation()
+            {
+                m_budget->release(m_size);
+            }
+
+            size_t size() const
+            {
+                return m_size;
+            }
+
+        private:
+
+            reservation(std::shared_ptr<memory_budget> budget, size_t size)
+                : m_budget(budget), m_size(size)
+            {
+            }
+
+            reservation(const reservation&);
+            reservation& operator=(const reservation&);
+
+            std::shared_ptr<memory_budget> m_budget;
+            size_t m_size;
+
+            friend class memory_budget;
+        };
+
+        explicit memory_budget(utility::size64_t max_bytes)
+            : m_max_bytes(max_bytes), m_semaphore(static_cast<int64_t>(max_bytes))
+        {
+        }
+
+        /// <summary>
+        /// Returns a task that completes with a reservation for the specified number of bytes,
+        /// once that many bytes are available. Requests are granted in the order they are made.
+        /// </summary>
+        /// <param name="bytes">The number of bytes to reserve. Requests above the whole budget are reduced to it.</param>
+        pplx::task<std::shared_ptr<reservation>> reserve_async(size_t bytes);
+
+        utility::size64_t max_bytes() const
+        {
+            return m_max_bytes;
+        }
+
+    private:
+
+        void release(size_t bytes)
+        {
+            m_semaphore.unlock(static_cast<int64_t>(bytes));
+        }
+
+        utility::size64_t m_max_bytes;
+        async_semaphore m_semaphore;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,110 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="operation_dispatcher.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "wascore/basic_types.h"
+#include "was/common.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Limits the operations of a service client that are in flight, and dispatches the waiting ones by weighted fair queuing
+    /// across their dispatch tags, each of which may also have a quota of its own.
+    /// </summary>
+    /// <remarks>Each tag has a virtual time that grows by the inverse of its weight for every operation it is dispatched, and the
+    /// waiting tag with the lowest virtual time goes first. A tag that starts waiting again is moved up to the virtual time of the
+    /// last dispatched operation, so that it cannot make up for the time it was idle with a burst.</remarks>
+    class operation_dispatcher
+    {
+    public:
+
+        operation_dispatcher()
+            : m_max_concurrent_operations(0), m_running(0), m_virtual_time(0.0)
+        {
+        }
+
+        /// <summary>
+        /// Returns false if operations are not dispatched and start right away
+        /// </summary>
+        bool is_enabled() const
+        {
+            return m_max_concurrent_operations.load() > 0;
+        }
+
+        int max_concurrent_operations() const
+        {
+            return m_max_concurrent_operations.load();
+        }
+
+        void set_max_concurrent_operations(int value);
+
+        dispatch_tag_settings tag_settings(const utility::string_t& tag) const;
+        void set_tag_settings(const utility::string_t& tag, const dispatch_tag_settings& value);
+
+        /// <summary>
+        /// Returns a task that completes once an operation with the tag may start. Every operation that was dispatched is released.
+        /// </summary>
+        pplx::task<void> acquire_async(const utility::string_t& tag);
+        void release(const utility::string_t& tag);
+
+        std::map<utility::string_t, dispatch_tag_statistics> statistics() const;
+        void reset_statistics();
+
+    private:
+
+        struct waiter
+        {
+            pplx::task_completion_event<void> event;
+            std::chrono::steady_clock::time_point enqueue_time;
+        };
+
+        struct tag_state
+        {
+            tag_state()
+                : running(0), virtual_time(0.0)
+            {
+            }
+
+            dispatch_tag_settings settings;
+            std::deque<waiter> waiting;
+            int running;
+            double virtual_time;
+            latency_histogram queueing_delay;
+        };
+
+        bool can_start(const tag_state& state) const;
+        void start(tag_state& state, std::chrono::microseconds delay);
+
+        // Starts waiting operations while there is room, and moves their events to the list, which is set once the lock is released
+        void dispatch_waiting(std::vector<pplx::task_completion_event<void>>& events);
+
+        std::atomic<int> m_max_concurrent_operations;
+        int m_running;
+        double m_virtual_time;
+        std::map<utility::string_t, tag_state> m_tags;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
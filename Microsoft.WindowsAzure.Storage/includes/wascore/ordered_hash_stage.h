@@ -0,0 +1,96 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="ordered_hash_stage.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cpprest/containerstream.h"
+
+#include "wascore/basic_types.h"
+#include "streams.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Hashes ranges of a download that complete in any order, feeding them to the hash in offset order on a background task.
+    /// </summary>
+    /// <remarks>
+    /// A range that arrives before the ones in front of it is held until they have been hashed. The reorder window bounds how far ahead
+    /// of the hashed part a range may be started, and so how much data waits to be hashed. The window must hold at least one range.
+    /// </remarks>
+    class ordered_hash_stage : public std::enable_shared_from_this<ordered_hash_stage>
+    {
+    public:
+
+        typedef concurrency::streams::container_buffer<std::vector<uint8_t>> range_buffer;
+
+        ordered_hash_stage(hash_streambuf hash, utility::size64_t start_offset, utility::size64_t window_size)
+            : m_hash(hash), m_next_offset(start_offset), m_window_size(window_size), m_end_offset(0), m_hashing(false), m_canceled(false)
+        {
+        }
+
+        /// <summary>
+        /// Returns a task that completes once the range that ends at the given offset fits in the reorder window, or the stage is canceled.
+        /// </summary>
+        pplx::task<void> reserve_async(utility::size64_t end_offset);
+
+        /// <summary>
+        /// Takes a downloaded range, which is hashed once all ranges before it have been.
+        /// </summary>
+        void add(utility::size64_t offset, range_buffer data);
+
+        /// <summary>
+        /// Returns a task that completes with the hash once everything before the given offset has been hashed.
+        /// </summary>
+        pplx::task<std::vector<unsigned char>> finish_async(utility::size64_t end_offset);
+
+        /// <summary>
+        /// Releases every reservation that is waiting and drops the ranges that have not been hashed, after a range failed to download.
+        /// </summary>
+        void cancel();
+
+    private:
+
+        struct reservation
+        {
+            utility::size64_t end_offset;
+            pplx::task_completion_event<void> event;
+        };
+
+        void hash_ranges();
+        void complete_reservations(std::vector<pplx::task_completion_event<void>>& granted);
+
+        hash_streambuf m_hash;
+        utility::size64_t m_next_offset;
+        const utility::size64_t m_window_size;
+        std::map<utility::size64_t, range_buffer> m_pending_ranges;
+        std::vector<reservation> m_reservations;
+
+        // Set by finish_async, which waits for the hash to reach the end offset
+        utility::size64_t m_end_offset;
+        std::shared_ptr<pplx::task_completion_event<std::vector<unsigned char>>> m_finish_event;
+
+        bool m_hashing;
+        bool m_canceled;
+        std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,66 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="partition_key_filter.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Represents a range of PartitionKeys, which always has a lower bound because the empty string is the lowest PartitionKey.
+    /// </summary>
+    struct partition_key_range
+    {
+        partition_key_range()
+            : lower_inclusive(true), has_upper(false), upper_inclusive(false)
+        {
+        }
+
+        // Returns true if the range holds a single PartitionKey
+        bool is_point() const
+        {
+            return has_upper && lower_inclusive && upper_inclusive && (lower == upper);
+        }
+
+        // Returns true if the range holds every PartitionKey
+        bool is_unbounded() const
+        {
+            return lower.empty() && lower_inclusive && !has_upper;
+        }
+
+        utility::string_t lower;
+        bool lower_inclusive;
+        utility::string_t upper;
+        bool has_upper;
+        bool upper_inclusive;
+    };
+
+    // Returns the PartitionKey ranges that the entities matched by a filter can be in, sorted and without overlaps. A filter, or a part
+    // of one, that does not restrict the PartitionKey with the comparisons written by table_query::generate_filter_condition and
+    // table_query::combine_filter_conditions matches every PartitionKey. A filter that no entity can match returns no range.
+    WASTORAGE_API std::vector<partition_key_range> get_partition_key_ranges(const utility::string_t& filter);
+
+    // Splits the ranges at the boundaries, sorted in ascending order, where each boundary starts a new range
+    WASTORAGE_API std::vector<partition_key_range> split_partition_key_ranges(const std::vector<partition_key_range>& ranges, const std::vector<utility::string_t>& partition_key_boundaries);
+
+    // Returns the filter that matches the PartitionKeys of the range, or an empty string if the range holds every PartitionKey
+    WASTORAGE_API utility::string_t get_partition_key_filter(const partition_key_range& range);
+
+}}} // namespace wa::storage::core
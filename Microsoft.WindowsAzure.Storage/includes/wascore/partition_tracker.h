@@ -0,0 +1,77 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="partition_tracker.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "wascore/basic_types.h"
+#include "was/table.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Samples the requests of table operations by the partition they address, shared by the copies of a table service client.
+    /// </summary>
+    /// <remarks>
+    /// At most a fixed number of partitions are kept. A partition that is sampled once they are all taken replaces the one with the
+    /// fewest operations and starts from its count, so the partitions with the most operations are kept, and the count of a partition
+    /// may be overestimated by at most the count it started from.
+    /// </remarks>
+    class partition_tracker
+    {
+    public:
+
+        partition_tracker()
+            : m_sampling_rate(0.0), m_sample_credit(0.0)
+        {
+        }
+
+        double sampling_rate() const;
+        void set_sampling_rate(double value);
+
+        // Returns true if the next operation is to be sampled, which spreads the samples evenly over the operations
+        bool should_sample();
+
+        void record(const utility::string_t& table_name, const utility::string_t& partition_key, const request_result& result);
+
+        // Returns the partitions with the most operations, busiest first
+        std::vector<table_partition_statistics> hot_partitions(size_t count) const;
+        void reset();
+
+    private:
+
+        struct entry
+        {
+            utility::string_t table_name;
+            utility::string_t partition_key;
+            uint64_t operation_count;
+            uint64_t throttled_count;
+            std::chrono::microseconds total_latency;
+        };
+
+        double m_sampling_rate;
+        double m_sample_credit;
+        std::unordered_map<utility::string_t, entry> m_entries;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
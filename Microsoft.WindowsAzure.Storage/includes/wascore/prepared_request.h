@@ -0,0 +1,97 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="prepared_request.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "cpprest/http_msg.h"
+
+#include "wascore/basic_types.h"
+#include "was/auth.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// The static parts of a request that is sent again and again to the same resource, such as a poll of a queue. The encoded URI,
+    /// the headers and the canonicalized resource are computed once, and each request is a copy that only its per-call parts are set on.
+    /// </summary>
+    class prepared_request
+    {
+    public:
+
+        /// <summary>
+        /// Prepares requests like the template, which is copied rather than kept, so it can still be sent itself.
+        /// </summary>
+        prepared_request(const web::http::http_request& template_request, std::shared_ptr<protocol::authentication_handler> handler);
+
+        /// <summary>
+        /// Returns a new request with the method, URI and headers of the template. The caller sets the body and any per-call headers.
+        /// </summary>
+        web::http::http_request create() const;
+
+        /// <summary>
+        /// Signs a request created from this one, reusing the canonicalized resource unless the request has been sent to another URI since.
+        /// </summary>
+        void sign(web::http::http_request& request, operation_context context) const;
+
+        const web::http::uri& uri() const
+        {
+            return m_uri;
+        }
+
+    private:
+
+        web::http::method m_method;
+        web::http::uri m_uri;
+        web::http::http_headers m_headers;
+        std::shared_ptr<protocol::authentication_handler> m_handler;
+
+        // Empty if the authentication handler signs each request in full
+        std::string m_canonicalized_resource;
+    };
+
+    /// <summary>
+    /// The prepared requests of a service client, by a key that the operation building them derives from its resource and parameters.
+    /// </summary>
+    class prepared_request_cache
+    {
+    public:
+
+        prepared_request_cache()
+        {
+        }
+
+        /// <summary>
+        /// Returns the prepared request with the given key, or nullptr if there is none.
+        /// </summary>
+        std::shared_ptr<const prepared_request> find(const utility::string_t& key) const;
+
+        /// <summary>
+        /// Adds a prepared request. If the cache is full, an arbitrary other request is discarded to make room.
+        /// </summary>
+        void add(const utility::string_t& key, std::shared_ptr<const prepared_request> value);
+
+    private:
+
+        std::map<utility::string_t, std::shared_ptr<const prepared_request>> m_requests;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
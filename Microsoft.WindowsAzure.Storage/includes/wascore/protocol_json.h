@@ -0,0 +1,149 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="protocol_json.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "wascore/basic_types.h"
+#include "was/table.h"
+#include "wascore/jsonhelpers.h"
+
+namespace wa { namespace storage { namespace protocol {
+
+    /// <summary>
+    /// Builds table entities directly from a JSON response body, either a single entity or the "value" array of a query response.
+    /// </summary>
+    class table_entity_reader : public core::json::json_reader
+    {
+    public:
+
+        table_entity_reader(Concurrency::streams::istream stream, bool is_query)
+            : json_reader(stream), m_is_query(is_query), m_receiver(nullptr)
+        {
+            initialize();
+        }
+
+        table_entity_reader(const char* data, size_t size, bool is_query)
+            : json_reader(data, size), m_is_query(is_query), m_receiver(nullptr)
+        {
+            initialize();
+        }
+
+        // Reads a query response into a receiver instead of building entities
+        table_entity_reader(Concurrency::streams::istream stream, table_entity_receiver* receiver)
+            : json_reader(stream), m_is_query(true), m_receiver(receiver)
+        {
+            initialize();
+        }
+
+        std::vector<table_entity> extract_entities()
+        {
+            parse();
+            return std::move(m_entities);
+        }
+
+        table_entity extract_entity()
+        {
+            parse();
+            return m_entities.empty() ? table_entity() : std::move(m_entities.front());
+        }
+
+        // Only the properties with the given names are read and the others are skipped, unless the list is empty
+        WASTORAGE_API void set_projection(const std::vector<utility::string_t>& columns);
+
+        // The resolver decides the types of the properties that are read, instead of the type annotations of the response
+        void set_property_resolver(table_request_options::property_resolver_type resolver)
+        {
+            m_property_resolver = std::move(resolver);
+        }
+
+        // Each entity read records its properties, so that the properties changed later can be told apart
+        void set_track_property_changes(bool value)
+        {
+            m_track_property_changes = value;
+        }
+
+    protected:
+
+        WASTORAGE_API virtual void handle_begin_object();
+        WASTORAGE_API virtual void handle_end_object();
+        WASTORAGE_API virtual void handle_begin_array();
+        WASTORAGE_API virtual void handle_end_array();
+        WASTORAGE_API virtual void handle_key(const core::json::json_string_view& key);
+        WASTORAGE_API virtual void handle_string(const core::json::json_string_view& value);
+        WASTORAGE_API virtual void handle_number(const core::json::json_string_view& value, bool is_integer);
+        WASTORAGE_API virtual void handle_boolean(bool value);
+        WASTORAGE_API virtual void handle_null();
+
+    private:
+
+        WASTORAGE_API void initialize();
+        bool is_entity_member() const;
+        bool is_regular_property() const;
+        void add_property(entity_property property);
+        bool is_filtering_properties() const;
+        bool is_skipped_property() const;
+        int get_property_index() const;
+        edm_type resolve_property_type(const utility::string_t& value);
+        const utility::string_t& property_name();
+        static edm_type get_property_type(const core::json::json_string_view& type_name);
+
+        bool m_is_query;
+        table_entity_receiver* m_receiver;
+        int m_property_index;
+        size_t m_entity_depth;
+        size_t m_property_count_hint;
+        bool m_value_member;
+        bool m_in_value_array;
+        bool m_in_entity;
+        size_t m_member_count;
+        bool m_track_property_changes;
+
+        std::vector<table_entity> m_entities;
+        table_entity m_entity;
+
+        // Member names are kept as UTF-8 and only converted when a property is added
+        std::string m_property_name;
+        std::string m_type_property_name;
+        edm_type m_type;
+        std::string m_number;
+
+        // The rows of a response usually have the same members in the same order, so the converted name of the member
+        // at each position is kept and reused while the next row has the same name there
+        std::vector<std::pair<std::string, utility::string_t>> m_property_names;
+        std::vector<std::pair<std::string, int>> m_property_indexes;
+
+        std::vector<std::string> m_projection;
+        table_request_options::property_resolver_type m_property_resolver;
+    };
+
+    /// <summary>
+    /// Writes table entities as JSON straight into a UTF-8 request body. Only the properties whose type cannot be told
+    /// from their JSON value have a type annotation, and values are formatted without going through text streams.
+    /// </summary>
+    class table_entity_writer
+    {
+    public:
+
+        WASTORAGE_API static void write_entity(std::string& body, const table_entity& entity);
+
+    private:
+
+        static void write_property(std::string& body, const utility::string_t& name, const entity_property& property);
+        static void write_type_annotation(std::string& body, const utility::string_t& name, edm_type type);
+    };
+
+}}} // namespace wa::storage::protocol
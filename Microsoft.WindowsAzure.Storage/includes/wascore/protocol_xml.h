@@ -228,12 +228,22 @@ namespace wa { namespace storage { namespace protocol {
             return std::move(m_next_marker);
         }
 
+        // Passes each item to a handler as soon as it has been read instead of collecting it. Parsing
+        // pauses, and the parse method returns true, when a handler returns false.
+        void set_item_handlers(std::function<bool (cloud_blob_list_item&)> blob_handler, std::function<bool (cloud_blob_prefix_list_item&)> blob_prefix_handler)
+        {
+            m_blob_handler = std::move(blob_handler);
+            m_blob_prefix_handler = std::move(blob_prefix_handler);
+        }
+
     protected:
 
-        virtual void handle_begin_element(const utility::string_t& element_name);
-        virtual void handle_element(const utility::string_t& element_name);
-        virtual void handle_end_element(const utility::string_t& element_name);
+        WASTORAGE_API virtual void handle_begin_element(const utility::string_t& element_name);
+        WASTORAGE_API virtual void handle_element(const utility::string_t& element_name);
+        WASTORAGE_API virtual void handle_end_element(const utility::string_t& element_name);
 
+        std::function<bool (cloud_blob_list_item&)> m_blob_handler;
+        std::function<bool (cloud_blob_prefix_list_item&)> m_blob_prefix_handler;
         std::vector<cloud_blob_list_item> m_blob_items;
         std::vector<cloud_blob_prefix_list_item> m_blob_prefix_items;
         utility::string_t m_next_marker;
@@ -247,6 +257,40 @@ namespace wa { namespace storage { namespace protocol {
         copy_state m_copy_state;
     };
 
+    // Reads a flat blob listing straight into a blob_inventory, without building an item for each blob
+    class list_blobs_inventory_reader : public core::xml::xml_reader
+    {
+    public:
+
+        list_blobs_inventory_reader(concurrency::streams::istream stream)
+            : xml_reader(stream), m_length(0), m_type(blob_type::unspecified)
+        {
+        }
+
+        // Extracts the result. This method can only be called once on this reader
+        blob_inventory extract_result()
+        {
+            parse();
+            m_inventory.set_continuation_token(continuation_token(std::move(m_next_marker)));
+            return std::move(m_inventory);
+        }
+
+    protected:
+
+        WASTORAGE_API virtual void handle_element(const utility::string_t& element_name);
+        WASTORAGE_API virtual void handle_end_element(const utility::string_t& element_name);
+
+        blob_inventory m_inventory;
+        utility::string_t m_next_marker;
+
+        utility::string_t m_name;
+        utility::size64_t m_length;
+        utility::datetime m_last_modified;
+        utility::string_t m_etag;
+        blob_type m_type;
+        utility::string_t m_content_md5;
+    };
+
     class page_list_reader : public core::xml::xml_reader
     {
     public:
@@ -273,6 +317,32 @@ namespace wa { namespace storage { namespace protocol {
         int64_t m_end;
     };
 
+    class page_diff_list_reader : public core::xml::xml_reader
+    {
+    public:
+
+        page_diff_list_reader(concurrency::streams::istream stream)
+            : xml_reader(stream), m_start(-1), m_end(-1)
+        {
+        }
+
+        // Extracts the result. This method can only be called once on this reader
+        std::vector<page_diff_range> extract_result()
+        {
+            parse();
+            return std::move(m_page_list);
+        }
+
+    protected:
+
+        virtual void handle_element(const utility::string_t& element_name);
+        virtual void handle_end_element(const utility::string_t& element_name);
+
+        std::vector<page_diff_range> m_page_list;
+        int64_t m_start;
+        int64_t m_end;
+    };
+
     class block_list_reader : public core::xml::xml_reader
     {
     public:
@@ -502,19 +572,19 @@ namespace wa { namespace storage { namespace protocol {
         {
         }
 
-        utility::string_t content() const
+        const utility::string_t& content() const
         {
-            return std::move(m_content);
+            return m_content;
         }
 
-        utility::string_t id() const
+        const utility::string_t& id() const
         {
-            return std::move(m_id);
+            return m_id;
         }
 
-        utility::string_t pop_receipt() const
+        const utility::string_t& pop_receipt() const
         {
-            return std::move(m_pop_receipt);
+            return m_pop_receipt;
         }
 
         utility::datetime insertion_time() const
@@ -0,0 +1,123 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="request_coalescer.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Joins identical reads that are in flight at the same time, shared by the copies of a service client. The first
+    /// caller for a key sends the request, and every caller that arrives before it completes receives the same result.
+    /// </summary>
+    class request_coalescer : public std::enable_shared_from_this<request_coalescer>
+    {
+    public:
+
+        request_coalescer()
+            : m_enabled(false)
+        {
+        }
+
+        bool is_enabled() const
+        {
+            return m_enabled;
+        }
+
+        void set_enabled(bool value)
+        {
+            m_enabled = value;
+        }
+
+        // Returns the number of keys that have a request in flight
+        size_t in_flight() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_in_flight.size();
+        }
+
+        // Starts the request unless one with the same key is in flight already. A key must always be used with the same
+        // result type, so each kind of request begins its keys with a prefix of its own.
+        template<typename T>
+        pplx::task<T> run_async(const utility::string_t& key, std::function<pplx::task<T> ()> start)
+        {
+            pplx::task_completion_event<T> result;
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                auto iter = m_in_flight.find(key);
+                if (iter != m_in_flight.end())
+                {
+                    return pplx::create_task(*std::static_pointer_cast<pplx::task_completion_event<T>>(iter->second));
+                }
+
+                m_in_flight.insert(std::make_pair(key, std::make_shared<pplx::task_completion_event<T>>(result)));
+            }
+
+            // The key is removed before the waiters are released, so that a caller that arrives
+            // after the result is known sends a request of its own instead of reading a stale one
+            auto this_pointer = shared_from_this();
+            pplx::task<T> request_task;
+            try
+            {
+                request_task = start();
+            }
+            catch (...)
+            {
+                request_task = pplx::task_from_exception<T>(std::current_exception());
+            }
+
+            request_task.then([this_pointer, key, result] (pplx::task<T> completed_task)
+            {
+                this_pointer->remove(key);
+                try
+                {
+                    result.set(completed_task.get());
+                }
+                catch (...)
+                {
+                    result.set_exception(std::current_exception());
+                }
+            });
+
+            return pplx::create_task(result);
+        }
+
+    private:
+
+        void remove(const utility::string_t& key)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_in_flight.erase(key);
+        }
+
+        std::atomic<bool> m_enabled;
+
+        // Each value is the completion event of the request in flight, of the result type its key is used with
+        std::unordered_map<utility::string_t, std::shared_ptr<void>> m_in_flight;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -23,26 +23,86 @@
 
 namespace wa { namespace storage { namespace protocol {
 
-    const utility::string_t error_blob_type_mismatch(U("Blob type of the blob reference doesn't match blob type of the blob."));
-    const utility::string_t error_closed_stream(U("Cannot access a closed stream."));
-    const utility::string_t error_lease_id_on_source(U("A lease condition cannot be specified on the source of a copy."));
-    const utility::string_t error_incorrect_length(U("Incorrect number of bytes received."));
-    const utility::string_t error_md5_mismatch(U("Calculated MD5 does not match existing property."));
-    const utility::string_t error_missing_md5(U("MD5 does not exist. If you do not want to force validation, please disable use_transactional_md5."));
-    const utility::string_t error_sas_missing_credentials(U("Cannot create Shared Access Signature unless Shared Key credentials are used."));
-    const utility::string_t error_client_timeout(U("The client could not finish the operation within specified timeout."));
-    const utility::string_t error_cannot_modify_snapshot(U("Cannot perform this operation on a blob representing a snapshot."));
-    const utility::string_t error_page_blob_size_unknown(U("The size of the page blob could not be determined, because stream is not seekable and a length argument is not provided."));
-    const utility::string_t error_stream_short(U("The requested number of bytes exceeds the length of the stream remaining from the specified position."));
-    const utility::string_t error_unsupported_text_blob(U("Only plain text with utf-8 encoding is supported."));
-    const utility::string_t error_multiple_snapshots(U("Cannot provide snapshot time as part of the address and as constructor parameter. Either pass in the address or use a different constructor."));
-    const utility::string_t error_multiple_credentials(U("Cannot provide credentials as part of the address and as constructor parameter. Either pass in the address or use a different constructor."));
-    const utility::string_t error_uri_missing_location(U("The Uri for the target storage location is not specified. Please consider changing the request's location mode."));
-    const utility::string_t error_primary_only_command(U("This operation can only be executed against the primary storage location."));
-    const utility::string_t error_secondary_only_command(U("This operation can only be executed against the secondary storage location."));
-    const utility::string_t error_md5_not_possible(U("MD5 cannot be calculated for an existing page blob because it would require reading the existing data. Please disable StoreBlobContentMD5."));
-    const utility::string_t error_missing_params_for_sas(U("Missing mandatory parameters for valid Shared Access Signature"));
-    const utility::string_t error_md5_options_mismatch(U("When uploading a blob in a single request, store_blob_content_md5 must be set to true if use_transactional_md5 is true, because the MD5 calculated for the transaction will be stored in the blob."));
-    const utility::string_t error_storage_uri_mismatch(U("Primary and secondary location URIs in a StorageUri must point to the same resource."));
+    const utility::char_t error_blob_type_mismatch[] = U("Blob type of the blob reference doesn't match blob type of the blob.");
+    const utility::char_t error_closed_stream[] = U("Cannot access a closed stream.");
+    const utility::char_t error_lease_id_on_source[] = U("A lease condition cannot be specified on the source of a copy.");
+    const utility::char_t error_incorrect_length[] = U("Incorrect number of bytes received.");
+    const utility::char_t error_md5_mismatch[] = U("Calculated MD5 does not match existing property.");
+    const utility::char_t error_missing_md5[] = U("MD5 does not exist. If you do not want to force validation, please disable use_transactional_md5.");
+    const utility::char_t error_crc64_mismatch[] = U("Calculated CRC64 does not match the value returned by the service.");
+    const utility::char_t error_missing_crc64[] = U("CRC64 does not exist. If you do not want to force validation, please disable use_transactional_crc64.");
+    const utility::char_t error_sas_missing_credentials[] = U("Cannot create Shared Access Signature unless Shared Key credentials are used.");
+    const utility::char_t error_client_timeout[] = U("The client could not finish the operation within specified timeout.");
+    const utility::char_t error_operation_canceled[] = U("The operation was canceled.");
+    const utility::char_t error_cannot_modify_snapshot[] = U("Cannot perform this operation on a blob representing a snapshot.");
+    const utility::char_t error_page_blob_size_unknown[] = U("The size of the page blob could not be determined, because stream is not seekable and a length argument is not provided.");
+    const utility::char_t error_changed_blocks_not_seekable[] = U("Uploading only the changed blocks of a blob requires a seekable source stream of known length.");
+    const utility::char_t error_resumable_upload_not_seekable[] = U("A resumable upload requires a seekable source stream of known length.");
+    const utility::char_t error_invalid_block_size[] = U("The block size must be greater than zero and no more than 4MB.");
+    const utility::char_t error_invalid_upload_checkpoint[] = U("The upload checkpoint is not valid.");
+    const utility::char_t error_upload_checkpoint_length_mismatch[] = U("The upload checkpoint was saved for a source of a different length.");
+    const utility::char_t error_sparse_download_not_seekable[] = U("Downloading only the valid page ranges of a blob requires a seekable target stream.");
+    const utility::char_t error_stream_short[] = U("The requested number of bytes exceeds the length of the stream remaining from the specified position.");
+    const utility::char_t error_unsupported_text_blob[] = U("Only plain text with utf-8 encoding is supported.");
+    const utility::char_t error_multiple_snapshots[] = U("Cannot provide snapshot time as part of the address and as constructor parameter. Either pass in the address or use a different constructor.");
+    const utility::char_t error_multiple_credentials[] = U("Cannot provide credentials as part of the address and as constructor parameter. Either pass in the address or use a different constructor.");
+    const utility::char_t error_uri_missing_location[] = U("The Uri for the target storage location is not specified. Please consider changing the request's location mode.");
+    const utility::char_t error_primary_only_command[] = U("This operation can only be executed against the primary storage location.");
+    const utility::char_t error_secondary_only_command[] = U("This operation can only be executed against the secondary storage location.");
+    const utility::char_t error_md5_not_possible[] = U("MD5 cannot be calculated for an existing page blob because it would require reading the existing data. Please disable StoreBlobContentMD5.");
+    const utility::char_t error_missing_params_for_sas[] = U("Missing mandatory parameters for valid Shared Access Signature");
+    const utility::char_t error_md5_options_mismatch[] = U("When uploading a blob in a single request, store_blob_content_md5 must be set to true if use_transactional_md5 is true, because the MD5 calculated for the transaction will be stored in the blob.");
+    const utility::char_t error_storage_uri_mismatch[] = U("Primary and secondary location URIs in a StorageUri must point to the same resource.");
+    const utility::char_t error_file_too_large_to_map[] = U("The file is too large to be mapped into the address space of this process.");
+    const utility::char_t error_invalid_base64[] = U("The text is not valid base64 encoded data.");
+    const utility::char_t error_bulk_retrieve_operation[] = U("A retrieve operation cannot be written through a table bulk writer.");
+    const utility::char_t error_write_behind_operation[] = U("Only insert-or-replace, insert-or-merge, replace and merge operations can be written through a write-behind buffer.");
+    const utility::char_t error_prefetch_max_buffered_messages[] = U("The maximum number of buffered messages must be at least 1.");
+    const utility::char_t error_prefetch_minimum_remaining_visibility[] = U("The minimum remaining visibility time must be shorter than the visibility timeout and cannot be negative.");
+    const utility::char_t error_pump_already_started[] = U("The message pump has been started already.");
+    const utility::char_t error_pump_max_concurrent_handlers[] = U("The maximum number of concurrent handlers must be at least 1.");
+    const utility::char_t error_copy_manager_max_concurrent_copies[] = U("The maximum number of concurrent copies must be at least 1.");
+    const utility::char_t error_copy_manager_polling_interval[] = U("The minimum polling interval must be positive and cannot be longer than the maximum polling interval.");
+    const utility::char_t error_transfer_manager_max_concurrent_transfers[] = U("The maximum number of concurrent transfers must be at least 1.");
+    const utility::char_t error_transfer_manager_chunk_size[] = U("The chunk size must be positive and cannot be greater than 4MB.");
+    const utility::char_t error_parallel_writer_committed[] = U("The blob has been committed by the writer already.");
+    const utility::char_t error_transfer_file_changed[] = U("The size of the file changed while it was being transferred.");
+    const utility::char_t error_pump_polling_interval[] = U("The minimum polling interval must be positive and cannot be longer than the maximum polling interval.");
+    const utility::char_t error_lease_keeper_visibility_timeout[] = U("The visibility timeout of a lease keeper must be at least 3 seconds and cannot be greater than 604800.");
+    const utility::char_t error_lease_keeper_untracked_message[] = U("The message is not tracked by the lease keeper.");
+    const utility::char_t error_lease_keeper_message_without_receipt[] = U("Only a message that has been retrieved from the queue, with an ID and a pop receipt, can be tracked.");
+    const utility::char_t error_lease_keeper_untracked_lease[] = U("The lease is not tracked by the lease keeper.");
+    const utility::char_t error_lease_keeper_empty_lease_id[] = U("Only a lease with an ID can be tracked.");
+    const utility::char_t error_content_cache_max_blob_size[] = U("The maximum size of a cached blob must be positive and cannot be greater than the size of the cache.");
+    const utility::char_t error_deleter_max_concurrent_deletes[] = U("The maximum number of concurrent deletes must be at least 1.");
+    const utility::char_t error_max_concurrent_message_adds[] = U("The maximum number of concurrent adds must be at least 1.");
+    const utility::char_t error_packed_message_too_large[] = U("The logical message is too large to fit in an envelope.");
+    const utility::char_t error_invalid_packed_message[] = U("The envelope of packed queue messages is not valid.");
+    const utility::char_t error_sharded_queue_empty[] = U("A sharded queue must have at least one queue.");
+    const utility::char_t error_sharded_client_empty[] = U("A sharded client must have at least one storage account.");
+    const utility::char_t error_shard_placement[] = U("The placement function returned the index of a shard that does not exist.");
+    const utility::char_t error_retry_budget_ratio[] = U("The retry budget ratio must be between 0 and 1.");
+    const utility::char_t error_transport_rate[] = U("The error and failure rates of a transport must be between 0 and 1.");
+    const utility::char_t error_transport_connection_failure[] = U("The connection was lost before a response was received.");
+    const utility::char_t error_bandwidth_limiter_rate[] = U("The rate and the burst size of a bandwidth limiter must be positive.");
+    const utility::char_t error_invalid_inventory_snapshot[] = U("The file is not a valid blob inventory snapshot.");
+    const utility::char_t error_table_column_too_large[] = U("The values of a table column do not fit in 32-bit offsets. Use a smaller batch size.");
+    const utility::char_t error_invalid_gzip_stream[] = U("The response body is not a valid gzip stream.");
+    const utility::char_t error_depth_monitor_max_concurrent_refreshes[] = U("The maximum number of concurrent refreshes must be at least 1.");
+    const utility::char_t error_depth_monitor_refresh_interval[] = U("The minimum refresh interval must be at least 100 milliseconds and cannot be greater than the maximum refresh interval.");
+    const utility::char_t error_claim_check_threshold[] = U("The threshold of a claim check cannot be greater than 48 KB.");
+    const utility::char_t error_invalid_claim_check[] = U("The message does not hold a valid reference to a blob.");
+    const utility::char_t error_partition_sampling_rate[] = U("The partition sampling rate must be between 0 and 1.");
+    const utility::char_t error_invalid_work_unit[] = U("The text does not hold a valid work unit.");
+    const utility::char_t error_stream_copy_write[] = U("The data could not be written to the destination stream.");
+    const utility::char_t error_circuit_open[] = U("The request was not sent because too many requests to the storage location have failed in a row.");
+    const utility::char_t error_invalid_analytics_log[] = U("The text is not a valid Storage Analytics log entry.");
+    const utility::char_t error_part_count[] = U("The number of parts must be between 1 and the maximum number of blocks of a blob.");
+    const utility::char_t error_part_too_large[] = U("The part has more blocks than its assignment allows.");
+    const utility::char_t error_missing_upload_receipt[] = U("There must be exactly one receipt for every part of the upload.");
+    const utility::char_t error_missing_uploaded_block[] = U("A block of a part has not been uploaded, or has a different length than the receipt states.");
+    const utility::char_t error_table_spill_file[] = U("The file that holds the entities of the query results could not be written or read.");
+    const utility::char_t error_pump_visibility_percentile[] = U("The visibility percentile must be greater than 0 and at most 1, and the visibility margin cannot be negative.");
+    const utility::char_t error_truncated_batch_response[] = U("The batch response ended before its closing boundary.");
 
 }}} // namespace wa::storage::protocol
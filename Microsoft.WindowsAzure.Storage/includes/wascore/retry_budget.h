@@ -0,0 +1,64 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="retry_budget.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <mutex>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A token bucket shared by all operations of a service client that limits how many of its requests can be retries.
+    /// </summary>
+    /// <remarks>Every operation deposits a fraction of a token and every retry withdraws a whole one, so that once the
+    /// bucket is empty, retries cannot be more than that fraction of the operations.</remarks>
+    class retry_budget
+    {
+    public:
+
+        retry_budget();
+
+        /// <summary>
+        /// Gets the fraction of a token that each operation deposits, or 0 if retries are not limited.
+        /// </summary>
+        double ratio() const;
+
+        /// <summary>
+        /// Sets the fraction of a token that each operation deposits. 0 stops limiting retries.
+        /// </summary>
+        void set_ratio(double value);
+
+        /// <summary>
+        /// Records that an operation has started.
+        /// </summary>
+        void record_operation();
+
+        /// <summary>
+        /// Withdraws a token for a retry, and returns false if there is none left.
+        /// </summary>
+        bool try_withdraw();
+
+    private:
+
+        double m_ratio;
+        double m_tokens;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
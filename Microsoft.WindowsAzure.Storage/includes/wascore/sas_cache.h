@@ -0,0 +1,70 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="sas_cache.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A bounded cache of shared access signature tokens, keyed by everything that goes into a token.
+    /// </summary>
+    /// <remarks>
+    /// A token only depends on its key and the account key, so a cached token is exactly the one that
+    /// would be signed again. Entries are dropped once their policy has expired, and when the cache is full
+    /// the entry that expires first makes room for a new one.
+    /// </remarks>
+    class sas_cache
+    {
+    public:
+
+        explicit sas_cache(size_t max_entries)
+            : m_max_entries(max_entries)
+        {
+        }
+
+        bool try_get(const utility::string_t& key, utility::string_t& token);
+        void add(const utility::string_t& key, const utility::string_t& token, const utility::datetime& expiry);
+
+        size_t max_entries() const
+        {
+            return m_max_entries;
+        }
+
+    private:
+
+        struct entry
+        {
+            utility::string_t token;
+
+            // Intervals of the expiry time, or the largest interval for a policy without an expiry
+            utility::datetime::interval_type expiry;
+        };
+
+        void remove_expired(utility::datetime::interval_type now);
+
+        size_t m_max_entries;
+        std::unordered_map<utility::string_t, entry> m_entries;
+        std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
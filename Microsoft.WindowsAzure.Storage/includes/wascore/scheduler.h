@@ -0,0 +1,130 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="scheduler.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+
+#include "cpprest/asyncrt_utils.h"
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace details
+    {
+        template<typename R>
+        struct scheduled_work
+        {
+            explicit scheduled_work(std::function<R ()> function)
+                : m_function(std::move(function))
+            {
+            }
+
+            void run()
+            {
+                m_completion.set(m_function());
+            }
+
+            std::function<R ()> m_function;
+            pplx::task_completion_event<R> m_completion;
+        };
+
+        template<>
+        struct scheduled_work<void>
+        {
+            explicit scheduled_work(std::function<void ()> function)
+                : m_function(std::move(function))
+            {
+            }
+
+            void run()
+            {
+                m_function();
+                m_completion.set();
+            }
+
+            std::function<void ()> m_function;
+            pplx::task_completion_event<void> m_completion;
+        };
+
+        template<typename R>
+        void run_scheduled_work(void* parameter)
+        {
+            std::unique_ptr<scheduled_work<R>> work(static_cast<scheduled_work<R>*>(parameter));
+            try
+            {
+                work->run();
+            }
+            catch (...)
+            {
+                work->m_completion.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    /// <summary>
+    /// Runs a function on the given scheduler, or right away on the calling thread if there is no scheduler.
+    /// </summary>
+    /// <returns>A task that completes with the result of the function, or with the exception it threw.</returns>
+    template<typename R>
+    pplx::task<R> run_on_scheduler(const std::shared_ptr<pplx::scheduler_interface>& scheduler, std::function<R ()> function)
+    {
+        auto work = new details::scheduled_work<R>(std::move(function));
+        pplx::task<R> result(work->m_completion);
+        if (!scheduler)
+        {
+            details::run_scheduled_work<R>(work);
+            return result;
+        }
+
+        try
+        {
+            scheduler->schedule(&details::run_scheduled_work<R>, work);
+        }
+        catch (...)
+        {
+            delete work;
+            throw;
+        }
+
+        return result;
+    }
+
+    /// <summary>
+    /// Starts an asynchronous function on the given scheduler, or right away on the calling thread if there is no scheduler.
+    /// </summary>
+    /// <returns>A task that completes when the task returned by the function does.</returns>
+    template<typename R>
+    pplx::task<R> run_async_on_scheduler(const std::shared_ptr<pplx::scheduler_interface>& scheduler, std::function<pplx::task<R> ()> function)
+    {
+        // Without a scheduler, the function is called directly so that no continuation is added to unwrap its task
+        if (!scheduler)
+        {
+            return function();
+        }
+
+        return run_on_scheduler<pplx::task<R>>(scheduler, std::move(function)).then([] (pplx::task<R> inner_task) -> pplx::task<R>
+        {
+            return inner_task;
+        });
+    }
+
+}}} // namespace wa::storage::core
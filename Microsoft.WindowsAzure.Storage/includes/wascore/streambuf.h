@@ -17,9 +17,19 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "cpprest/containerstream.h"
 #include "cpprest/streams.h"
 
 #include "wascore/basic_types.h"
+#include "was/common.h"
+#include "async_semaphore.h"
+#include "constants.h"
+#include "gzip_decoder.h"
 #include "resources.h"
 
 namespace wa { namespace storage { namespace core {
@@ -249,6 +259,198 @@ namespace wa { namespace storage { namespace core {
         utility::size64_t m_total_written;
     };
 
+    // If the target writes into an in-memory vector, reserves room for the given number of characters past its write
+    // position, so the vector is allocated once instead of growing one write at a time. Other targets are left alone.
+    template<typename _CharType>
+    void reserve_container_buffer(concurrency::streams::streambuf<_CharType> target, utility::size64_t count)
+    {
+        auto container = std::dynamic_pointer_cast<concurrency::streams::details::basic_container_buffer<std::vector<_CharType>>>(target.get_base());
+        if (!container || !container->can_write() || count == 0)
+        {
+            return;
+        }
+
+        auto& data = container->collection();
+        auto position = container->getpos(std::ios_base::out);
+        utility::size64_t required = (position < 0 ? data.size() : static_cast<utility::size64_t>(position)) + count;
+        if (required > data.capacity() && required <= data.max_size())
+        {
+            data.reserve(static_cast<typename std::vector<_CharType>::size_type>(required));
+        }
+    }
+
+    // Writes to a destination and hashes what was written with up to two hash streambufs, either of which may be
+    // invalid. The destination's own buffer is handed out through alloc/commit, so the HTTP layer can read into it
+    // directly, and the hashes are updated from the same memory instead of from a copy.
+    template<typename _CharType>
+    class basic_hashing_streambuf : public basic_ostreambuf<_CharType>
+    {
+    public:
+        basic_hashing_streambuf(concurrency::streams::streambuf<_CharType> destination, concurrency::streams::streambuf<_CharType> hash1, concurrency::streams::streambuf<_CharType> hash2)
+            : basic_ostreambuf<_CharType>(), m_destination(destination), m_hash1(hash1), m_hash2(hash2), m_allocated(nullptr), m_total_written(0), m_size_hint(0)
+        {
+        }
+
+        bool can_seek() const
+        {
+            return false;
+        }
+
+        bool has_size() const
+        {
+            return false;
+        }
+
+        utility::size64_t size() const
+        {
+            return (utility::size64_t)0;
+        }
+
+        size_t buffer_size(std::ios_base::openmode direction) const
+        {
+            return (size_t)0;
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
+        {
+        }
+
+        pos_type getpos(std::ios_base::openmode direction) const
+        {
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode direction)
+        {
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode direction)
+        {
+            return (pos_type)traits::eof();
+        }
+
+        char_type* _alloc(_In_ size_t count)
+        {
+            apply_size_hint();
+            m_allocated = m_destination.alloc(count);
+            return m_allocated;
+        }
+
+        void _commit(_In_ size_t count)
+        {
+            m_total_written += count;
+            hash(m_hash1, m_allocated, count);
+            hash(m_hash2, m_allocated, count);
+            m_allocated = nullptr;
+            m_destination.commit(count);
+        }
+
+        pplx::task<bool> _sync()
+        {
+            return m_destination.sync().then([] () -> bool
+            {
+                return true;
+            });
+        }
+
+        pplx::task<void> _close_write()
+        {
+            basic_ostreambuf<_CharType>::_close_write();
+            auto hash1 = m_hash1;
+            auto hash2 = m_hash2;
+            return m_destination.close(std::ios_base::out).then([hash1, hash2] () -> pplx::task<void>
+            {
+                return close_hash(hash1).then([hash2] () -> pplx::task<void>
+                {
+                    return close_hash(hash2);
+                });
+            });
+        }
+
+        pplx::task<int_type> _putc(char_type ch)
+        {
+            apply_size_hint();
+            m_total_written++;
+            auto hash1 = m_hash1;
+            auto hash2 = m_hash2;
+            return m_destination.putc(ch).then([hash1, hash2, ch] (int_type result) -> int_type
+            {
+                if (result != traits::eof())
+                {
+                    hash(hash1, &ch, 1);
+                    hash(hash2, &ch, 1);
+                }
+
+                return result;
+            });
+        }
+
+        pplx::task<size_t> _putn(const char_type* ptr, size_t count)
+        {
+            apply_size_hint();
+            m_total_written += count;
+            if (!m_hash1 && !m_hash2)
+            {
+                return m_destination.putn(ptr, count);
+            }
+
+            // The caller keeps the buffer until the returned task completes, so the hashes read it after the destination did
+            auto hash1 = m_hash1;
+            auto hash2 = m_hash2;
+            return m_destination.putn(ptr, count).then([hash1, hash2, ptr] (size_t written) -> size_t
+            {
+                hash(hash1, ptr, written);
+                hash(hash2, ptr, written);
+                return written;
+            });
+        }
+
+        utility::size64_t total_written() const
+        {
+            return m_total_written;
+        }
+
+        // Sets how many characters the whole body is expected to be. It may be called while the body is being written,
+        // so the destination is only presized by the next write, which cannot overlap with another one.
+        void set_size_hint(utility::size64_t value)
+        {
+            m_size_hint = value;
+        }
+
+    private:
+
+        void apply_size_hint()
+        {
+            utility::size64_t hint = m_size_hint.exchange(0);
+            if (hint > m_total_written)
+            {
+                reserve_container_buffer(m_destination, hint - m_total_written);
+            }
+        }
+
+        // Hash streambufs complete their writes synchronously
+        static void hash(concurrency::streams::streambuf<_CharType> target, const char_type* ptr, size_t count)
+        {
+            if (target && count > 0)
+            {
+                target.putn(ptr, count).wait();
+            }
+        }
+
+        static pplx::task<void> close_hash(concurrency::streams::streambuf<_CharType> target)
+        {
+            return target ? target.close(std::ios_base::out) : pplx::task_from_result();
+        }
+
+        concurrency::streams::streambuf<_CharType> m_destination;
+        concurrency::streams::streambuf<_CharType> m_hash1;
+        concurrency::streams::streambuf<_CharType> m_hash2;
+        char_type* m_allocated;
+        utility::size64_t m_total_written;
+        std::atomic<utility::size64_t> m_size_hint;
+    };
+
     template<typename _CharType>
     class basic_null_streambuf : public basic_ostreambuf<_CharType>
     {
@@ -328,6 +530,807 @@ namespace wa { namespace storage { namespace core {
         }
     };
 
+    // Read-only view over a range of a seekable source streambuf. Views over the same source
+    // share a lock, so that they can be read concurrently without buffering their data.
+    template<typename _CharType>
+    class basic_substream_streambuf : public basic_istreambuf<_CharType>
+    {
+    public:
+        basic_substream_streambuf(concurrency::streams::streambuf<_CharType> source, async_semaphore source_lock, pos_type offset, utility::size64_t length)
+            : basic_istreambuf<_CharType>(), m_source(source), m_source_lock(source_lock), m_offset(offset), m_length(length), m_position(0)
+        {
+        }
+
+        bool can_seek() const
+        {
+            return is_open();
+        }
+
+        bool has_size() const
+        {
+            return true;
+        }
+
+        utility::size64_t size() const
+        {
+            return m_length;
+        }
+
+        size_t buffer_size(std::ios_base::openmode direction) const
+        {
+            return (size_t)0;
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
+        {
+        }
+
+        size_t in_avail() const
+        {
+            return 0;
+        }
+
+        pos_type getpos(std::ios_base::openmode direction) const
+        {
+            if (direction == std::ios_base::in)
+            {
+                return (pos_type)m_position;
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode direction)
+        {
+            switch (way)
+            {
+            case std::ios_base::beg:
+                return seekpos((pos_type)offset, direction);
+
+            case std::ios_base::cur:
+                return seekpos((pos_type)(offset + (off_type)m_position), direction);
+
+            case std::ios_base::end:
+                return seekpos((pos_type)(offset + (off_type)m_length), direction);
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode direction)
+        {
+            if ((direction == std::ios_base::in) && (pos >= 0) && (static_cast<utility::size64_t>(pos) <= m_length))
+            {
+                m_position = static_cast<utility::size64_t>(pos);
+                return pos;
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        bool acquire(_Out_writes_(count) _CharType*& ptr, _In_ size_t& count)
+        {
+            return false;
+        }
+
+        void release(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+        }
+
+        pplx::task<int_type> _bumpc()
+        {
+            auto this_pointer = std::dynamic_pointer_cast<basic_substream_streambuf<_CharType>>(shared_from_this());
+            return _getc().then([this_pointer] (int_type ch) -> int_type
+            {
+                if (ch != traits::eof())
+                {
+                    this_pointer->m_position++;
+                }
+
+                return ch;
+            });
+        }
+
+        int_type _sbumpc()
+        {
+            return traits::requires_async();
+        }
+
+        pplx::task<int_type> _getc()
+        {
+            auto ch = std::make_shared<_CharType>();
+            return read_async(m_position, ch.get(), 1).then([ch] (size_t count) -> int_type
+            {
+                return count == 1 ? traits::to_int_type(*ch) : traits::eof();
+            });
+        }
+
+        int_type _sgetc()
+        {
+            return traits::requires_async();
+        }
+
+        pplx::task<int_type> _nextc()
+        {
+            if (m_position >= m_length)
+            {
+                return pplx::task_from_result<int_type>(traits::eof());
+            }
+
+            m_position++;
+            return _getc();
+        }
+
+        pplx::task<int_type> _ungetc()
+        {
+            if (m_position == 0)
+            {
+                return pplx::task_from_result<int_type>(traits::eof());
+            }
+
+            m_position--;
+            return _getc();
+        }
+
+        pplx::task<size_t> _getn(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+            auto this_pointer = std::dynamic_pointer_cast<basic_substream_streambuf<_CharType>>(shared_from_this());
+            return read_async(m_position, ptr, count).then([this_pointer] (size_t read_count) -> size_t
+            {
+                this_pointer->m_position += read_count;
+                return read_count;
+            });
+        }
+
+        size_t _scopy(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+            return 0;
+        }
+
+    private:
+
+        pplx::task<size_t> read_async(utility::size64_t position, _CharType* ptr, size_t count)
+        {
+            if (position >= m_length)
+            {
+                return pplx::task_from_result<size_t>(0);
+            }
+
+            if (count > m_length - position)
+            {
+                count = static_cast<size_t>(m_length - position);
+            }
+
+            auto source = m_source;
+            auto source_lock = m_source_lock;
+            auto source_position = m_offset + (off_type)position;
+            return source_lock.lock_async().then([source, source_position, ptr, count] () mutable -> pplx::task<size_t>
+            {
+                source.seekpos(source_position, std::ios_base::in);
+                return source.getn(ptr, count);
+            }).then([source_lock] (pplx::task<size_t> read_task) mutable -> size_t
+            {
+                source_lock.unlock();
+                return read_task.get();
+            });
+        }
+
+        concurrency::streams::streambuf<_CharType> m_source;
+        async_semaphore m_source_lock;
+        pos_type m_offset;
+        utility::size64_t m_length;
+        utility::size64_t m_position;
+    };
+
+    // Read-only, seekable view over a list of buffers read one after the other, as if they were a single buffer.
+    // The buffers are not copied, so they must stay valid and unchanged for as long as the streambuf is read. If
+    // they belong to another streambuf, that one can be given as the owner, and is kept alive by the view.
+    template<typename _CharType>
+    class basic_gather_streambuf : public basic_istreambuf<_CharType>
+    {
+    public:
+        basic_gather_streambuf(std::vector<std::pair<const _CharType*, size_t>> segments, concurrency::streams::streambuf<_CharType> owner = concurrency::streams::streambuf<_CharType>())
+            : basic_istreambuf<_CharType>(), m_segments(std::move(segments)), m_owner(owner), m_position(0), m_segment(0), m_segment_offset(0)
+        {
+            m_offsets.reserve(m_segments.size() + 1);
+            m_offsets.push_back(0);
+            for (auto iter = m_segments.cbegin(); iter != m_segments.cend(); ++iter)
+            {
+                m_offsets.push_back(m_offsets.back() + iter->second);
+            }
+        }
+
+        bool can_seek() const
+        {
+            return is_open();
+        }
+
+        bool has_size() const
+        {
+            return true;
+        }
+
+        utility::size64_t size() const
+        {
+            return m_offsets.back();
+        }
+
+        size_t buffer_size(std::ios_base::openmode direction) const
+        {
+            return (size_t)0;
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
+        {
+        }
+
+        size_t in_avail() const
+        {
+            return m_segment < m_segments.size() ? m_segments[m_segment].second - m_segment_offset : 0;
+        }
+
+        pos_type getpos(std::ios_base::openmode direction) const
+        {
+            if (direction == std::ios_base::in)
+            {
+                return (pos_type)m_position;
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode direction)
+        {
+            switch (way)
+            {
+            case std::ios_base::beg:
+                return seekpos((pos_type)offset, direction);
+
+            case std::ios_base::cur:
+                return seekpos((pos_type)(offset + (off_type)m_position), direction);
+
+            case std::ios_base::end:
+                return seekpos((pos_type)(offset + (off_type)size()), direction);
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode direction)
+        {
+            if ((direction == std::ios_base::in) && (pos >= 0) && (static_cast<utility::size64_t>(pos) <= size()))
+            {
+                set_position(static_cast<utility::size64_t>(pos));
+                return pos;
+            }
+
+            return (pos_type)traits::eof();
+        }
+
+        // Hands out the rest of the current buffer, so that it can be consumed without being copied
+        bool acquire(_Out_writes_(count) _CharType*& ptr, _In_ size_t& count)
+        {
+            count = in_avail();
+            if (count == 0)
+            {
+                ptr = nullptr;
+                return false;
+            }
+
+            ptr = const_cast<_CharType*>(m_segments[m_segment].first + m_segment_offset);
+            return true;
+        }
+
+        void release(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+            advance(count);
+        }
+
+        pplx::task<int_type> _bumpc()
+        {
+            return pplx::task_from_result<int_type>(_sbumpc());
+        }
+
+        int_type _sbumpc()
+        {
+            int_type ch = _sgetc();
+            if (ch != traits::eof())
+            {
+                advance(1);
+            }
+
+            return ch;
+        }
+
+        pplx::task<int_type> _getc()
+        {
+            return pplx::task_from_result<int_type>(_sgetc());
+        }
+
+        int_type _sgetc()
+        {
+            if (in_avail() == 0)
+            {
+                return traits::eof();
+            }
+
+            return traits::to_int_type(m_segments[m_segment].first[m_segment_offset]);
+        }
+
+        pplx::task<int_type> _nextc()
+        {
+            if (in_avail() == 0)
+            {
+                return pplx::task_from_result<int_type>(traits::eof());
+            }
+
+            advance(1);
+            return _getc();
+        }
+
+        pplx::task<int_type> _ungetc()
+        {
+            if (m_position == 0)
+            {
+                return pplx::task_from_result<int_type>(traits::eof());
+            }
+
+            set_position(m_position - 1);
+            return _getc();
+        }
+
+        pplx::task<size_t> _getn(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+            size_t read_count = _scopy(ptr, count);
+            advance(read_count);
+            return pplx::task_from_result<size_t>(read_count);
+        }
+
+        size_t _scopy(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+            size_t read_count = 0;
+            size_t segment = m_segment;
+            size_t segment_offset = m_segment_offset;
+            while ((read_count < count) && (segment < m_segments.size()))
+            {
+                size_t chunk = std::min(count - read_count, m_segments[segment].second - segment_offset);
+                std::memcpy(ptr + read_count, m_segments[segment].first + segment_offset, chunk * sizeof(_CharType));
+                read_count += chunk;
+                segment_offset += chunk;
+                if (segment_offset == m_segments[segment].second)
+                {
+                    ++segment;
+                    segment_offset = 0;
+                }
+            }
+
+            return read_count;
+        }
+
+    private:
+
+        // Moves forward by count characters, which are known to be available
+        void advance(size_t count)
+        {
+            set_position(m_position + count);
+        }
+
+        // Finds the buffer holding the given position, skipping over any empty ones
+        void set_position(utility::size64_t position)
+        {
+            auto next = std::upper_bound(m_offsets.cbegin(), m_offsets.cend(), position);
+            m_segment = static_cast<size_t>(next - m_offsets.cbegin()) - 1;
+            m_segment_offset = static_cast<size_t>(position - m_offsets[m_segment]);
+            m_position = position;
+        }
+
+        std::vector<std::pair<const _CharType*, size_t>> m_segments;
+        concurrency::streams::streambuf<_CharType> m_owner;
+
+        // The position at which each buffer starts, followed by the total size
+        std::vector<utility::size64_t> m_offsets;
+
+        utility::size64_t m_position;
+        size_t m_segment;
+        size_t m_segment_offset;
+    };
+
+    // Reads from a source, waiting on a bandwidth limiter before each read so that the bytes are read no faster than its rate.
+    // Seeking is passed on to the source, so that the body of a request can still be rewound and sent again.
+    template<typename _CharType>
+    class basic_throttled_istreambuf : public basic_istreambuf<_CharType>
+    {
+    public:
+        basic_throttled_istreambuf(concurrency::streams::streambuf<_CharType> source, std::shared_ptr<bandwidth_limiter> limiter, transfer_priority priority)
+            : basic_istreambuf<_CharType>(), m_source(source), m_limiter(limiter), m_priority(priority)
+        {
+        }
+
+        bool can_seek() const
+        {
+            return m_source.can_seek();
+        }
+
+        bool has_size() const
+        {
+            return m_source.has_size();
+        }
+
+        utility::size64_t size() const
+        {
+            return m_source.size();
+        }
+
+        size_t buffer_size(std::ios_base::openmode direction) const
+        {
+            return (size_t)0;
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
+        {
+        }
+
+        size_t in_avail() const
+        {
+            return 0;
+        }
+
+        pos_type getpos(std::ios_base::openmode direction) const
+        {
+            return m_source.getpos(direction);
+        }
+
+        pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode direction)
+        {
+            return m_source.seekoff(offset, way, direction);
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode direction)
+        {
+            return m_source.seekpos(pos, direction);
+        }
+
+        bool acquire(_Out_writes_(count) _CharType*& ptr, _In_ size_t& count)
+        {
+            return false;
+        }
+
+        void release(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+        }
+
+        pplx::task<int_type> _bumpc()
+        {
+            auto source = m_source;
+            return m_limiter->acquire_async(1, m_priority).then([source] () mutable -> pplx::task<int_type>
+            {
+                return source.bumpc();
+            });
+        }
+
+        int_type _sbumpc()
+        {
+            return traits::requires_async();
+        }
+
+        pplx::task<int_type> _getc()
+        {
+            return m_source.getc();
+        }
+
+        int_type _sgetc()
+        {
+            return traits::requires_async();
+        }
+
+        pplx::task<int_type> _nextc()
+        {
+            auto source = m_source;
+            return m_limiter->acquire_async(1, m_priority).then([source] () mutable -> pplx::task<int_type>
+            {
+                return source.nextc();
+            });
+        }
+
+        pplx::task<int_type> _ungetc()
+        {
+            return m_source.ungetc();
+        }
+
+        pplx::task<size_t> _getn(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+            // A read is never larger than the burst size, so that the bytes of the other transfers can go in between
+            if (count > m_limiter->burst_bytes())
+            {
+                count = m_limiter->burst_bytes();
+            }
+
+            if (count == 0)
+            {
+                return pplx::task_from_result<size_t>(0);
+            }
+
+            auto source = m_source;
+            return m_limiter->acquire_async(count, m_priority).then([source, ptr, count] () mutable -> pplx::task<size_t>
+            {
+                return source.getn(ptr, count);
+            });
+        }
+
+        size_t _scopy(_Out_writes_(count) _CharType* ptr, _In_ size_t count)
+        {
+            return 0;
+        }
+
+    private:
+
+        concurrency::streams::streambuf<_CharType> m_source;
+        std::shared_ptr<bandwidth_limiter> m_limiter;
+        transfer_priority m_priority;
+    };
+
+    // Writes to a destination, waiting on a bandwidth limiter before each piece of at most its burst size. The destination's
+    // buffer is not handed out through alloc/commit, because the bytes would be received before the limiter is consulted.
+    template<typename _CharType>
+    class basic_throttled_ostreambuf : public basic_ostreambuf<_CharType>
+    {
+    public:
+        basic_throttled_ostreambuf(concurrency::streams::streambuf<_CharType> destination, std::shared_ptr<bandwidth_limiter> limiter, transfer_priority priority)
+            : basic_ostreambuf<_CharType>(), m_destination(destination), m_limiter(limiter), m_priority(priority)
+        {
+        }
+
+        bool can_seek() const
+        {
+            return false;
+        }
+
+        bool has_size() const
+        {
+            return false;
+        }
+
+        utility::size64_t size() const
+        {
+            return (utility::size64_t)0;
+        }
+
+        size_t buffer_size(std::ios_base::openmode direction) const
+        {
+            return (size_t)0;
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
+        {
+        }
+
+        pos_type getpos(std::ios_base::openmode direction) const
+        {
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode direction)
+        {
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode direction)
+        {
+            return (pos_type)traits::eof();
+        }
+
+        char_type* _alloc(_In_ size_t count)
+        {
+            return nullptr;
+        }
+
+        void _commit(_In_ size_t count)
+        {
+        }
+
+        pplx::task<bool> _sync()
+        {
+            return m_destination.sync().then([] () -> bool
+            {
+                return true;
+            });
+        }
+
+        pplx::task<void> _close_write()
+        {
+            basic_ostreambuf<_CharType>::_close_write();
+            return m_destination.close(std::ios_base::out);
+        }
+
+        pplx::task<int_type> _putc(char_type ch)
+        {
+            auto destination = m_destination;
+            return m_limiter->acquire_async(1, m_priority).then([destination, ch] () mutable -> pplx::task<int_type>
+            {
+                return destination.putc(ch);
+            });
+        }
+
+        pplx::task<size_t> _putn(const char_type* ptr, size_t count)
+        {
+            return write_async(m_destination, m_limiter, m_priority, ptr, count, 0);
+        }
+
+    private:
+
+        // The caller keeps the buffer until the returned task completes, so it can be written in several pieces
+        static pplx::task<size_t> write_async(concurrency::streams::streambuf<_CharType> destination, std::shared_ptr<bandwidth_limiter> limiter, transfer_priority priority, const char_type* ptr, size_t count, size_t written)
+        {
+            size_t piece = (std::min)(count - written, limiter->burst_bytes());
+            if (piece == 0)
+            {
+                return pplx::task_from_result(written);
+            }
+
+            return limiter->acquire_async(piece, priority).then([destination, ptr, written, piece] () mutable -> pplx::task<size_t>
+            {
+                return destination.putn(ptr + written, piece);
+            }).then([destination, limiter, priority, ptr, count, written, piece] (size_t piece_written) -> pplx::task<size_t>
+            {
+                if (piece_written < piece)
+                {
+                    return pplx::task_from_result(written + piece_written);
+                }
+
+                return write_async(destination, limiter, priority, ptr, count, written + piece_written);
+            });
+        }
+
+        concurrency::streams::streambuf<_CharType> m_destination;
+        std::shared_ptr<bandwidth_limiter> m_limiter;
+        transfer_priority m_priority;
+    };
+
+    // Reads the content that a gzip encoded source decodes to. The source is read as the decoded bytes are, and each read
+    // waits for the source, so this is meant for a body that is parsed by a reader that waits for its input anyway.
+    class basic_gzip_istreambuf : public basic_istreambuf<concurrency::streams::istream::traits::char_type>
+    {
+    public:
+        explicit basic_gzip_istreambuf(concurrency::streams::streambuf<char_type> source)
+            : basic_istreambuf<char_type>(), m_decoder([source] (uint8_t* buffer, size_t count) mutable -> size_t
+            {
+                return source.getn(buffer, count).get();
+            }), m_buffer(protocol::gzip_decode_buffer_size), m_position(0), m_size(0)
+        {
+        }
+
+        bool can_seek() const
+        {
+            return false;
+        }
+
+        bool has_size() const
+        {
+            return false;
+        }
+
+        utility::size64_t size() const
+        {
+            return (utility::size64_t)0;
+        }
+
+        size_t buffer_size(std::ios_base::openmode direction) const
+        {
+            return m_buffer.size();
+        }
+
+        void set_buffer_size(size_t size, std::ios_base::openmode direction)
+        {
+        }
+
+        size_t in_avail() const
+        {
+            return m_size - m_position;
+        }
+
+        pos_type getpos(std::ios_base::openmode direction) const
+        {
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekoff(off_type offset, std::ios_base::seekdir way, std::ios_base::openmode direction)
+        {
+            return (pos_type)traits::eof();
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode direction)
+        {
+            return (pos_type)traits::eof();
+        }
+
+        bool acquire(_Out_writes_(count) char_type*& ptr, _In_ size_t& count)
+        {
+            return false;
+        }
+
+        void release(_Out_writes_(count) char_type* ptr, _In_ size_t count)
+        {
+        }
+
+        pplx::task<int_type> _bumpc()
+        {
+            return pplx::task_from_result<int_type>(fill() ? m_buffer[m_position++] : traits::eof());
+        }
+
+        int_type _sbumpc()
+        {
+            return m_position < m_size ? m_buffer[m_position++] : traits::requires_async();
+        }
+
+        pplx::task<int_type> _getc()
+        {
+            return pplx::task_from_result<int_type>(fill() ? m_buffer[m_position] : traits::eof());
+        }
+
+        int_type _sgetc()
+        {
+            return m_position < m_size ? m_buffer[m_position] : traits::requires_async();
+        }
+
+        pplx::task<int_type> _nextc()
+        {
+            if (m_position < m_size)
+            {
+                ++m_position;
+            }
+
+            return _getc();
+        }
+
+        pplx::task<int_type> _ungetc()
+        {
+            // Only a byte that is still buffered can be put back
+            if (m_position == 0)
+            {
+                return pplx::task_from_result<int_type>(traits::eof());
+            }
+
+            return pplx::task_from_result<int_type>(m_buffer[--m_position]);
+        }
+
+        pplx::task<size_t> _getn(_Out_writes_(count) char_type* ptr, _In_ size_t count)
+        {
+            size_t read = 0;
+            if (count > 0 && fill())
+            {
+                read = (std::min)(count, m_size - m_position);
+                std::memcpy(ptr, m_buffer.data() + m_position, read);
+                m_position += read;
+            }
+
+            return pplx::task_from_result(read);
+        }
+
+        size_t _scopy(_Out_writes_(count) char_type* ptr, _In_ size_t count)
+        {
+            return 0;
+        }
+
+    private:
+
+        // Returns false at the end of the decoded content
+        bool fill()
+        {
+            if (m_position == m_size)
+            {
+                m_position = 0;
+                m_size = m_decoder.read(m_buffer.data(), m_buffer.size());
+            }
+
+            return m_position < m_size;
+        }
+
+        gzip_decoder m_decoder;
+        std::vector<char_type> m_buffer;
+        size_t m_position;
+        size_t m_size;
+    };
+
     class basic_hash_streambuf : public basic_ostreambuf<concurrency::streams::ostream::traits::char_type>
     {
     public:
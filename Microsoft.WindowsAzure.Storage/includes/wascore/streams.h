@@ -22,9 +22,12 @@
 
 #ifdef WIN32
 #include "hash_windows.h"
+#include "mapped_file_windows.h"
 #else
 #include "hash_linux.h"
+#include "mapped_file_linux.h"
 #endif
+#include "hash_crc64.h"
 
 namespace wa { namespace storage { namespace core {
 
@@ -49,6 +52,33 @@ namespace wa { namespace storage { namespace core {
         }
     };
 
+    template<typename _CharType>
+    class hashing_streambuf : public concurrency::streams::streambuf<_CharType>
+    {
+    public:
+        hashing_streambuf()
+            : concurrency::streams::streambuf<_CharType>()
+        {
+        }
+
+        hashing_streambuf(concurrency::streams::streambuf<_CharType> destination, concurrency::streams::streambuf<_CharType> hash1, concurrency::streams::streambuf<_CharType> hash2)
+            : concurrency::streams::streambuf<_CharType>(std::make_shared<basic_hashing_streambuf<_CharType>>(destination, hash1, hash2))
+        {
+        }
+
+        utility::size64_t total_written() const
+        {
+            auto base = static_cast<basic_hashing_streambuf<_CharType>*>(get_base().get());
+            return base->total_written();
+        }
+
+        void set_size_hint(utility::size64_t value)
+        {
+            auto base = static_cast<basic_hashing_streambuf<_CharType>*>(get_base().get());
+            base->set_size_hint(value);
+        }
+    };
+
     template<typename _CharType>
     class null_streambuf : public concurrency::streams::streambuf<_CharType>
     {
@@ -59,6 +89,55 @@ namespace wa { namespace storage { namespace core {
         }
     };
 
+    template<typename _CharType>
+    class substream_streambuf : public concurrency::streams::streambuf<_CharType>
+    {
+    public:
+        substream_streambuf(concurrency::streams::streambuf<_CharType> source, async_semaphore source_lock, typename concurrency::streams::streambuf<_CharType>::pos_type offset, utility::size64_t length)
+            : concurrency::streams::streambuf<_CharType>(std::make_shared<basic_substream_streambuf<_CharType>>(source, source_lock, offset, length))
+        {
+        }
+    };
+
+    template<typename _CharType>
+    class gather_streambuf : public concurrency::streams::streambuf<_CharType>
+    {
+    public:
+        gather_streambuf(std::vector<std::pair<const _CharType*, size_t>> segments, concurrency::streams::streambuf<_CharType> owner = concurrency::streams::streambuf<_CharType>())
+            : concurrency::streams::streambuf<_CharType>(std::make_shared<basic_gather_streambuf<_CharType>>(std::move(segments), owner))
+        {
+        }
+    };
+
+    template<typename _CharType>
+    class throttled_istreambuf : public concurrency::streams::streambuf<_CharType>
+    {
+    public:
+        throttled_istreambuf(concurrency::streams::streambuf<_CharType> source, std::shared_ptr<bandwidth_limiter> limiter, transfer_priority priority)
+            : concurrency::streams::streambuf<_CharType>(std::make_shared<basic_throttled_istreambuf<_CharType>>(source, limiter, priority))
+        {
+        }
+    };
+
+    template<typename _CharType>
+    class throttled_ostreambuf : public concurrency::streams::streambuf<_CharType>
+    {
+    public:
+        throttled_ostreambuf(concurrency::streams::streambuf<_CharType> destination, std::shared_ptr<bandwidth_limiter> limiter, transfer_priority priority)
+            : concurrency::streams::streambuf<_CharType>(std::make_shared<basic_throttled_ostreambuf<_CharType>>(destination, limiter, priority))
+        {
+        }
+    };
+
+    class gzip_istreambuf : public concurrency::streams::streambuf<basic_gzip_istreambuf::char_type>
+    {
+    public:
+        explicit gzip_istreambuf(concurrency::streams::streambuf<basic_gzip_istreambuf::char_type> source)
+            : concurrency::streams::streambuf<basic_gzip_istreambuf::char_type>(std::make_shared<basic_gzip_istreambuf>(source))
+        {
+        }
+    };
+
     class hash_streambuf : public concurrency::streams::streambuf<basic_hash_streambuf::char_type>
     {
     public:
@@ -97,4 +176,13 @@ namespace wa { namespace storage { namespace core {
         }
     };
 
+    class hash_crc64_streambuf : public hash_streambuf
+    {
+    public:
+        hash_crc64_streambuf()
+            : hash_streambuf(std::make_shared<basic_hash_crc64_streambuf>())
+        {
+        }
+    };
+
 }}} // namespace wa::storage::core
@@ -0,0 +1,126 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="timer_wheel.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// A hierarchical timer wheel that all timers of the library are scheduled on. Scheduling and cancelling a timer
+    /// take constant time, and a single thread drives the wheel no matter how many timers are pending.
+    /// </summary>
+    class timer_wheel
+    {
+    private:
+
+        struct entry
+        {
+            entry(uint64_t expiry, std::function<void()> callback)
+                : expiry(expiry), callback(std::move(callback)), done(false)
+            {
+            }
+
+            uint64_t expiry;
+            std::function<void()> callback;
+
+            // Set once the timer has fired or has been cancelled
+            bool done;
+        };
+
+    public:
+
+        /// <summary>
+        /// A timer scheduled on the wheel, which can be cancelled until it fires.
+        /// </summary>
+        class timer
+        {
+        public:
+
+            timer()
+                : m_wheel(nullptr)
+            {
+            }
+
+            /// <summary>
+            /// Stops the timer from firing, if it has not fired yet.
+            /// </summary>
+            void cancel() const
+            {
+                if (m_wheel != nullptr)
+                {
+                    m_wheel->cancel(m_entry);
+                }
+            }
+
+        private:
+
+            timer(timer_wheel* wheel, std::shared_ptr<entry> value)
+                : m_wheel(wheel), m_entry(std::move(value))
+            {
+            }
+
+            timer_wheel* m_wheel;
+            std::shared_ptr<entry> m_entry;
+
+            friend class timer_wheel;
+        };
+
+        /// <summary>
+        /// Returns the wheel shared by the whole library. Its thread is started by the first timer.
+        /// </summary>
+        WASTORAGE_API static timer_wheel& instance();
+
+        /// <summary>
+        /// Calls the callback on the thread of the wheel once the delay has passed. The callback must not block.
+        /// A negative delay counts as zero, and a delay longer than ten years as ten years.
+        /// </summary>
+        WASTORAGE_API timer schedule(std::chrono::milliseconds delay, std::function<void()> callback);
+
+    private:
+
+        timer_wheel();
+
+        WASTORAGE_API void cancel(const std::shared_ptr<entry>& value);
+        void insert(std::shared_ptr<entry> value);
+        void cascade(size_t level);
+        void advance(std::vector<std::function<void()>>& expired);
+        uint64_t get_next_wake_tick() const;
+        uint64_t get_tick(std::chrono::steady_clock::time_point time) const;
+        void run();
+
+        // Level 0 has a slot for each tick, and a slot of each level above spans all the slots of the level below
+        std::vector<std::vector<std::vector<std::shared_ptr<entry>>>> m_levels;
+        std::chrono::steady_clock::time_point m_epoch;
+        uint64_t m_current_tick;
+        uint64_t m_wake_tick;
+        size_t m_pending;
+        bool m_started;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+    };
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,55 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="transcode.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <string>
+
+#include "wascore/basic_types.h"
+
+namespace wa { namespace storage { namespace core {
+
+    // Transcodes between UTF-8 and the platform string type. Protocol text is nearly always ASCII, so runs of ASCII are converted
+    // 16 characters at a time, with SSE2 where the processor has it, and only the characters outside of ASCII are transcoded one by one.
+
+    // Appends the UTF-8 form of the text to the target. A lone surrogate is written as the three bytes of its code unit.
+    WASTORAGE_API void append_utf8(std::string& target, const utility::char_t* data, size_t size);
+
+    // Appends UTF-8 text to the target. Text that is not valid UTF-8 throws the same exception as utility::conversions::to_string_t.
+    WASTORAGE_API void append_string_t(utility::string_t& target, const char* data, size_t size);
+
+    inline std::string to_utf8string(const utility::string_t& value)
+    {
+        std::string result;
+        append_utf8(result, value.data(), value.size());
+        return result;
+    }
+
+    inline utility::string_t to_string_t(const char* data, size_t size)
+    {
+        utility::string_t result;
+        append_string_t(result, data, size);
+        return result;
+    }
+
+    inline utility::string_t to_string_t(const std::string& value)
+    {
+        return to_string_t(value.data(), value.size());
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,133 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="transfer_buffer.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "wascore/basic_types.h"
+#include "was/common.h"
+
+namespace wa { namespace storage { namespace core {
+
+    // A standard allocator that takes its memory from the buffer allocator of the request options, or from the heap if there is none
+    template<typename T>
+    class transfer_allocator
+    {
+    public:
+
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        // A buffer keeps its allocator when it is moved into another one, such as into the pool it is returned to
+        typedef std::true_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef transfer_allocator<U> other;
+        };
+
+        transfer_allocator()
+        {
+        }
+
+        explicit transfer_allocator(std::shared_ptr<wa::storage::buffer_allocator> allocator)
+            : m_allocator(std::move(allocator))
+        {
+        }
+
+        template<typename U>
+        transfer_allocator(const transfer_allocator<U>& other)
+            : m_allocator(other.allocator())
+        {
+        }
+
+        pointer allocate(size_type count)
+        {
+            if (count > max_size())
+            {
+                throw std::bad_alloc();
+            }
+
+            if (!m_allocator)
+            {
+                return static_cast<pointer>(::operator new(count * sizeof(T)));
+            }
+
+            void* memory = count > 0 ? m_allocator->allocate(count * sizeof(T)) : nullptr;
+            if (memory == nullptr && count > 0)
+            {
+                throw std::bad_alloc();
+            }
+
+            return static_cast<pointer>(memory);
+        }
+
+        void deallocate(pointer memory, size_type count)
+        {
+            if (!m_allocator)
+            {
+                ::operator delete(memory);
+            }
+            else if (memory != nullptr)
+            {
+                m_allocator->deallocate(memory, count * sizeof(T));
+            }
+        }
+
+        size_type max_size() const
+        {
+            return (std::numeric_limits<size_type>::max)() / sizeof(T);
+        }
+
+        const std::shared_ptr<wa::storage::buffer_allocator>& allocator() const
+        {
+            return m_allocator;
+        }
+
+        template<typename U>
+        bool operator==(const transfer_allocator<U>& other) const
+        {
+            return m_allocator == other.allocator();
+        }
+
+        template<typename U>
+        bool operator!=(const transfer_allocator<U>& other) const
+        {
+            return m_allocator != other.allocator();
+        }
+
+    private:
+
+        std::shared_ptr<wa::storage::buffer_allocator> m_allocator;
+    };
+
+    // The buffers that request and response bodies are staged in
+    typedef std::vector<uint8_t, transfer_allocator<uint8_t>> transfer_buffer;
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,98 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="upload_tuner.h" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include "cpprest/base_uri.h"
+
+#include "wascore/basic_types.h"
+#include "was/common.h"
+
+namespace wa { namespace storage { namespace core {
+
+    /// <summary>
+    /// Models the throughput of the endpoints that a service client uploads blobs to, and tunes block blob uploads to it.
+    /// </summary>
+    /// <remarks>The duration of each upload request is modeled as a fixed latency plus its size over the bandwidth of the endpoint,
+    /// fitted to the recent requests by least squares. The number of blocks in flight is tuned separately, by comparing the
+    /// throughput of whole uploads with more or fewer of them.</remarks>
+    class upload_tuner
+    {
+    public:
+
+        struct tuning
+        {
+            utility::size64_t single_upload_threshold;
+            size_t block_size;
+            int parallelism;
+        };
+
+        upload_tuner()
+        {
+        }
+
+        /// <summary>
+        /// Records a successful request that sent the specified number of bytes to the endpoint of the uri.
+        /// </summary>
+        void record_request(const web::http::uri& uri, utility::size64_t bytes, const request_result& result);
+
+        /// <summary>
+        /// Records a whole block upload to the endpoint of the uri, along with the number of blocks it had in flight.
+        /// </summary>
+        void record_upload(const web::http::uri& uri, utility::size64_t bytes, std::chrono::steady_clock::duration elapsed, int parallelism, int max_parallelism);
+
+        /// <summary>
+        /// Tunes an upload to the endpoint of the uri, without exceeding the specified limits.
+        /// Returns false if not enough requests have been seen for the endpoint yet.
+        /// </summary>
+        bool try_get_tuning(const web::http::uri& uri, utility::size64_t max_single_upload_threshold, size_t max_block_size, int max_parallelism, tuning& value) const;
+
+    private:
+
+        struct endpoint_state
+        {
+            endpoint_state()
+                : weight(0.0), sum_x(0.0), sum_y(0.0), sum_xx(0.0), sum_xy(0.0), samples(0), parallelism(0), uploads_since_probe(0)
+            {
+            }
+
+            // Exponentially decayed sums of request sizes in bytes (x) and durations in seconds (y)
+            double weight;
+            double sum_x;
+            double sum_y;
+            double sum_xx;
+            double sum_xy;
+            int samples;
+
+            // Average throughput in bytes per second of whole uploads, by the number of blocks they had in flight
+            std::map<int, double> upload_rates;
+            int parallelism;
+            int uploads_since_probe;
+        };
+
+        static utility::string_t get_key(const web::http::uri& uri);
+
+        std::map<utility::string_t, endpoint_state> m_endpoints;
+        mutable std::mutex m_mutex;
+    };
+
+}}} // namespace wa::storage::core
@@ -38,14 +38,17 @@ namespace wa { namespace storage { namespace core {
 #pragma region MIME Helpers
 
     utility::string_t generate_boundary_name(const utility::string_t& prefix);
-    void write_boundary(utility::string_t& body_text, const utility::string_t& boundary_name, bool is_closure = false);
-    void write_mime_multipart_headers(utility::string_t& body_text);
-    void write_request_line(utility::string_t& body_text, const web::http::method& method, const web::http::uri& uri);
-    void write_request_headers(utility::string_t& body_text, const web::http::http_headers& headers);
+    void append_utf8(std::string& body, const utility::string_t& value);
+    void write_line_break(std::string& body);
+    void write_boundary(std::string& body, const utility::string_t& boundary_name, bool is_closure = false);
+    void write_mime_multipart_headers(std::string& body);
+    void write_request_line(std::string& body, const web::http::method& method, const web::http::uri& uri);
+    void write_request_headers(std::string& body, const web::http::http_headers& headers);
     //void write_content_type_request_header(utility::string_t& body_text, const utility::string_t& boundary_name);
     //void write_content_id_request_header(utility::string_t& body_text, int content_id);
     //void write_request_header_closure(utility::string_t& body_text);
-    void write_request_payload(utility::string_t& body_text, web::json::value json_object);
+    void write_json_string(std::string& body, const utility::string_t& value);
+    void write_json_utf8_string(std::string& body, const std::string& value);
 
 #pragma endregion
 
@@ -54,16 +57,41 @@ namespace wa { namespace storage { namespace core {
     utility::size64_t get_remaining_stream_length(concurrency::streams::istream stream);
     pplx::task<utility::size64_t> stream_copy_async(concurrency::streams::istream istream, concurrency::streams::ostream ostream, utility::size64_t length);
     pplx::task<void> complete_after(std::chrono::milliseconds timeout);
+    pplx::task<void> complete_after(std::chrono::milliseconds timeout, pplx::cancellation_token token);
+
+    // Returns true if the request failed with the given status code and extended error code
+    bool is_storage_error(const storage_exception& e, web::http::status_code status_code, const utility::char_t* error_code);
+    struct local_file_entry
+    {
+        // Relative to the listed directory, with backslashes as separators
+        utility::string_t path;
+        utility::size64_t size;
+        utility::datetime last_write_time;
+    };
+
+    std::vector<local_file_entry> list_local_files(const utility::string_t& directory);
+    void create_local_directories(const utility::string_t& path);
+    void delete_local_file(const utility::string_t& path);
     utility::string_t single_quote(const utility::string_t& value);
     bool is_nan(double value);
     bool is_finite(double value);
     utility::datetime truncate_fractional_seconds(const utility::datetime& value);
+    uint64_t hash_utf8_key(const utility::string_t& key);
     utility::string_t convert_to_string(int value);
     utility::string_t convert_to_string(const std::vector<uint8_t>& value);
+    void append_base64(std::string& target, const uint8_t* data, size_t size);
+    std::vector<uint8_t> decode_base64(const utility::string_t& value);
     std::vector<utility::string_t> string_split(const utility::string_t& string, const utility::string_t& separator);
     utility::string_t convert_to_string(utility::datetime value);
     utility::datetime parse_datetime(utility::string_t value);
 
+    // Saved state such as a work unit is written as one name=value line per field, with each value percent-encoded so that it can hold any text
+    void append_text_field(utility::string_t& text, const utility::string_t& name, const utility::string_t& value);
+    bool parse_text_fields(const utility::string_t& text, std::vector<std::pair<utility::string_t, utility::string_t>>& fields);
+    void append_continuation_token_fields(utility::string_t& text, const continuation_token& token);
+    // Returns false if the field does not belong to a continuation token, and clears valid if it cannot be read
+    bool parse_continuation_token_field(const utility::string_t& name, const utility::string_t& value, continuation_token& token, bool& valid);
+
     template<typename T>
     utility::string_t string_join(const std::vector<T>& vector, const utility::string_t& separator)
     {
@@ -83,6 +111,76 @@ namespace wa { namespace storage { namespace core {
         return str.str();
     }
 
+    // Collects the results of every segment of a listing. The request for the next segment is issued as
+    // soon as the current segment and its continuation token have arrived, before the current results are
+    // appended, so one segment is fetched ahead while the previous one is consumed.
+    template<typename Result, typename Segment>
+    pplx::task<std::vector<Result>> list_all_segments_async(std::function<pplx::task<Segment> (const continuation_token&)> get_segment)
+    {
+        auto results = std::make_shared<std::vector<Result>>();
+        auto next_segment = std::make_shared<pplx::task<Segment>>(get_segment(continuation_token()));
+
+        return pplx::details::do_while([get_segment, results, next_segment] () -> pplx::task<bool>
+        {
+            return next_segment->then([get_segment, results, next_segment] (Segment segment) -> bool
+            {
+                continuation_token token(segment.continuation_token());
+                bool has_more = !token.empty();
+                if (has_more)
+                {
+                    *next_segment = get_segment(token);
+                }
+
+                const std::vector<Result>& partial_results = segment.results();
+                results->insert(results->end(), partial_results.begin(), partial_results.end());
+                return has_more;
+            });
+        }).then([results] (bool) -> std::vector<Result>
+        {
+            return std::move(*results);
+        });
+    }
+
+    // Passes the results of every segment of a listing to a handler as each segment arrives, until the handler
+    // returns false. With prefetch, the request for the next segment is issued before the handler runs, so
+    // at most one segment is fetched ahead and memory does not grow with the size of the listing.
+    template<typename Result, typename Segment>
+    pplx::task<void> for_each_segment_result_async(std::function<pplx::task<Segment> (const continuation_token&)> get_segment, std::function<bool (const Result&)> handler, bool prefetch)
+    {
+        auto next_segment = std::make_shared<pplx::task<Segment>>(get_segment(continuation_token()));
+
+        return pplx::details::do_while([get_segment, handler, prefetch, next_segment] () -> pplx::task<bool>
+        {
+            return next_segment->then([get_segment, handler, prefetch, next_segment] (Segment segment) -> bool
+            {
+                continuation_token token(segment.continuation_token());
+                bool has_more = !token.empty();
+                if (has_more && prefetch)
+                {
+                    *next_segment = get_segment(token);
+                }
+
+                const std::vector<Result>& partial_results = segment.results();
+                for (auto iter = partial_results.cbegin(); iter != partial_results.cend(); ++iter)
+                {
+                    if (!handler(*iter))
+                    {
+                        return false;
+                    }
+                }
+
+                if (has_more && !prefetch)
+                {
+                    *next_segment = get_segment(token);
+                }
+
+                return has_more;
+            });
+        }).then([] (bool)
+        {
+        });
+    }
+
 #pragma endregion
 
 }}} // namespace wa::storage::core
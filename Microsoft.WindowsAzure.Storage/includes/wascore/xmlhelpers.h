@@ -47,18 +47,76 @@
 #include <atlbase.h>
 #include <xmllite.h>
 #else
-#include <libxml++/parsers/textreader.h>
 #include <libxml++/document.h>
 #include <stack>
 #endif 
 
+#include <cstring>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "cpprest/basic_types.h"
+#include "cpprest/streams.h"
+
+#include "wascore/basic_types.h"
 
 namespace wa { namespace storage { namespace core { namespace xml {
 
 /// <summary>
-/// XML reader based on xmlllite
+/// A non-owning view of UTF-8 text inside the reader's buffer. It is only valid until the reader moves to the next node.
+/// </summary>
+class xml_string_view
+{
+public:
+
+    xml_string_view()
+        : m_data(nullptr), m_size(0)
+    {
+    }
+
+    xml_string_view(const char* data, size_t size)
+        : m_data(data), m_size(size)
+    {
+    }
+
+    const char* data() const
+    {
+        return m_data;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    /// <summary>
+    /// Copies the viewed bytes into a UTF-8 string
+    /// </summary>
+    std::string to_utf8_string() const
+    {
+        return std::string(m_data, m_size);
+    }
+
+    /// <summary>
+    /// Converts the viewed bytes into a platform string
+    /// </summary>
+    utility::string_t to_string() const;
+
+private:
+
+    const char* m_data;
+    size_t m_size;
+};
+
+/// <summary>
+/// Incremental XML pull reader. The stream is consumed in chunks as parsing proceeds, and names and values
+/// are kept as UTF-8 views into the read buffer until a caller asks for a string.
 /// </summary>
 class xml_reader
 {
@@ -70,15 +128,17 @@ public:
     /// Parse the given xml string/stream. Returns true if it finished parsing the stream to the end, and false
     /// if it was asked to exit early via pause()
     /// </summary>
-    bool parse();
+    WASTORAGE_API bool parse();
 
 protected:
 
-    xml_reader() : m_continueParsing(true), m_streamDone(false)
+    xml_reader()
+        : m_continueParsing(true), m_streamDone(false), m_sourceDone(true), m_position(0), m_nodeType(node_none), m_emptyElement(false), m_attributeIndex(no_attribute)
     {
     }
 
-    xml_reader(concurrency::streams::istream stream) : m_continueParsing(true), m_streamDone(false)
+    xml_reader(concurrency::streams::istream stream)
+        : m_continueParsing(true), m_streamDone(false), m_sourceDone(true), m_position(0), m_nodeType(node_none), m_emptyElement(false), m_attributeIndex(no_attribute)
     {
         initialize(stream);
     }
@@ -116,12 +176,12 @@ protected:
     /// <summary>
     /// Returns the parent element name
     /// </summary>
-    utility::string_t get_parent_element_name(size_t pos = 0);
+    const utility::string_t& get_parent_element_name(size_t pos = 0);
 
     /// <summary>
-    /// Returns the current element name
+    /// Returns the current element name, or the current attribute name after move_to_first_attribute
     /// </summary>
-    utility::string_t get_current_element_name();
+    WASTORAGE_API const utility::string_t& get_current_element_name();
 
     /// <summary>
     /// Returns the current element name with the prefix if any. 
@@ -131,17 +191,22 @@ protected:
     /// <summary>
     /// Returns the current element value
     /// </summary>
-    utility::string_t get_current_element_text();
+    WASTORAGE_API utility::string_t get_current_element_text();
+
+    /// <summary>
+    /// Returns the current element value as a view into the read buffer
+    /// </summary>
+    xml_string_view get_current_element_text_view() const;
 
     /// <summary>
     /// Moves to the first attribute in the node
     /// </summary>
-    bool move_to_first_attribute();
+    WASTORAGE_API bool move_to_first_attribute();
 
     /// <summary>
     /// Moves to the first attribute in the node
     /// </summary>
-    bool move_to_next_attribute();
+    WASTORAGE_API bool move_to_next_attribute();
 
     /// <summary>
     /// Extracts the current element value into the provided type
@@ -149,19 +214,14 @@ protected:
     template <class T>
     void extract_current_element(T& value)
     {
-        utility::istringstream_t iss(get_current_element_text());
+        std::istringstream iss(get_current_element_text_view().to_utf8_string());
         iss >> value;
     }
 
     /// <summary>
     /// Initialize the reader
     /// </summary>
-    void initialize(concurrency::streams::istream stream);
-
-    /// <summary>
-    /// Remove Byte Order Mark from the stream
-    /// </summary>
-    void remove_bom(concurrency::streams::istream stream);
+    WASTORAGE_API void initialize(concurrency::streams::istream stream);
 
     /// <summary>
     /// Can be called by the derived classes in the handle_* routines, to cause the parse routine to exit early,
@@ -169,16 +229,51 @@ protected:
     /// </summary>
     void pause() { m_continueParsing = false; }
 
-#ifdef WIN32
-    CComPtr<IXmlReader> m_reader;
-#else
-    std::shared_ptr<xmlpp::TextReader> m_reader;
-    std::string m_data;
-#endif 
-
-    std::vector<utility::string_t> m_elementStack;
+    std::vector<const utility::string_t*> m_elementStack;
     bool m_continueParsing;
     bool m_streamDone;
+
+private:
+
+    enum node_type
+    {
+        node_none,
+        node_element,
+        node_text,
+        node_end_element
+    };
+
+    struct attribute
+    {
+        xml_string_view name;
+        xml_string_view value;
+    };
+
+    static const size_t no_attribute = static_cast<size_t>(-1);
+
+    bool read_node();
+    bool fill_buffer();
+    bool find_in_buffer(const char* terminator, size_t length, size_t start, size_t& found);
+    bool parse_start_tag(size_t begin, size_t end);
+    xml_string_view decode_text(size_t begin, size_t end);
+    const utility::string_t& intern_name(xml_string_view qualified_name);
+    void stop_on_error(const utility::string_t& message);
+
+    concurrency::streams::streambuf<uint8_t> m_source;
+    bool m_sourceDone;
+    std::string m_buffer;
+    size_t m_position;
+
+    node_type m_nodeType;
+    xml_string_view m_name;
+    xml_string_view m_value;
+    bool m_emptyElement;
+    std::vector<attribute> m_attributes;
+    size_t m_attributeIndex;
+
+    std::unordered_map<std::string, utility::string_t> m_names;
+    std::string m_nameKey;
+    utility::string_t m_emptyName;
 };
 
 /// <summary>
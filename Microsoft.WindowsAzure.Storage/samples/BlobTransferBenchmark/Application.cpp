@@ -0,0 +1,260 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="Application.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "samples_common.h"
+
+#include <Windows.h>
+#include <Psapi.h>
+
+#include "was/storage_account.h"
+#include "was/blob.h"
+#include "was/in_memory_transport.h"
+
+namespace wa { namespace storage { namespace samples {
+
+    // One point of the benchmark matrix
+    struct transfer_settings
+    {
+        utility::size64_t object_size;
+        size_t block_size;
+        int parallelism_factor;
+        bool use_md5;
+        utility::size64_t single_blob_upload_threshold;
+    };
+
+    // Wall time, CPU time and peak working set of one transfer
+    struct transfer_measurement
+    {
+        double seconds;
+        double cpu_seconds;
+        size_t peak_working_set;
+    };
+
+    double get_process_cpu_seconds()
+    {
+        FILETIME creation_time, exit_time, kernel_time, user_time;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        {
+            return 0.0;
+        }
+
+        // FILETIME counts in units of 100 nanoseconds
+        ULARGE_INTEGER kernel, user;
+        kernel.LowPart = kernel_time.dwLowDateTime;
+        kernel.HighPart = kernel_time.dwHighDateTime;
+        user.LowPart = user_time.dwLowDateTime;
+        user.HighPart = user_time.dwHighDateTime;
+        return static_cast<double>(kernel.QuadPart + user.QuadPart) / 1e7;
+    }
+
+    size_t get_peak_working_set()
+    {
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return 0;
+        }
+
+        return counters.PeakWorkingSetSize;
+    }
+
+    transfer_measurement measure_transfer(const std::function<void ()>& transfer)
+    {
+        double cpu_start = get_process_cpu_seconds();
+        auto start = std::chrono::steady_clock::now();
+        transfer();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        transfer_measurement result;
+        result.seconds = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1e6;
+        result.cpu_seconds = get_process_cpu_seconds() - cpu_start;
+        result.peak_working_set = get_peak_working_set();
+        return result;
+    }
+
+    void print_measurement(const utility::string_t& blob_type, const utility::string_t& direction, const transfer_settings& settings, const transfer_measurement& measurement)
+    {
+        const double megabyte = 1024.0 * 1024.0;
+        const double gigabyte = megabyte * 1024.0;
+        double size = static_cast<double>(settings.object_size);
+
+        ucout << blob_type << U(',') << direction << U(',')
+            << settings.object_size << U(',') << settings.block_size << U(',') << settings.parallelism_factor << U(',')
+            << (settings.use_md5 ? U("on") : U("off")) << U(',') << settings.single_blob_upload_threshold << U(',')
+            << (measurement.seconds > 0.0 ? size / megabyte / measurement.seconds : 0.0) << U(',')
+            << measurement.cpu_seconds * gigabyte / size << U(',')
+            << measurement.peak_working_set / megabyte << std::endl;
+    }
+
+    wa::storage::blob_request_options get_upload_options(const transfer_settings& settings)
+    {
+        wa::storage::blob_request_options options;
+        options.set_stream_write_size_in_bytes(settings.block_size);
+        options.set_parallelism_factor(settings.parallelism_factor);
+        options.set_single_blob_upload_threshold_in_bytes(settings.single_blob_upload_threshold);
+        options.set_use_transactional_md5(settings.use_md5);
+        options.set_store_blob_content_md5(settings.use_md5);
+        return options;
+    }
+
+    wa::storage::blob_request_options get_download_options(const transfer_settings& settings, bool in_memory)
+    {
+        wa::storage::blob_request_options options;
+        options.set_stream_read_size_in_bytes(settings.block_size);
+        options.set_parallelism_factor(settings.parallelism_factor);
+
+        // The canned responses of the in-memory transport carry no MD5, so only a real account can validate one
+        options.set_use_transactional_md5(settings.use_md5 && !in_memory);
+        options.set_disable_content_md5_validation(!settings.use_md5 || in_memory);
+        return options;
+    }
+
+    void run_transfer(wa::storage::cloud_blob_container& container, const transfer_settings& settings, const std::vector<uint8_t>& data, bool in_memory)
+    {
+        wa::storage::blob_request_options upload_options = get_upload_options(settings);
+        wa::storage::blob_request_options download_options = get_download_options(settings, in_memory);
+
+        // Block blob
+        wa::storage::cloud_block_blob block_blob = container.get_block_blob_reference(U("benchmark-block-blob"));
+        // The source is copied before the clock starts
+        concurrency::streams::istream block_source = concurrency::streams::bytestream::open_istream(data);
+        transfer_measurement measurement = measure_transfer([&] ()
+        {
+            block_blob.upload_from_stream(block_source, static_cast<utility::size64_t>(data.size()), wa::storage::access_condition(), upload_options, wa::storage::operation_context());
+        });
+        print_measurement(U("block"), U("upload"), settings, measurement);
+
+        measurement = measure_transfer([&] ()
+        {
+            concurrency::streams::container_buffer<std::vector<uint8_t>> target;
+            target.collection().reserve(data.size());
+            block_blob.download_to_stream(target.create_ostream(), wa::storage::access_condition(), download_options, wa::storage::operation_context());
+        });
+        print_measurement(U("block"), U("download"), settings, measurement);
+
+        // Page blob, whose size is always a multiple of 512 bytes in the matrix
+        wa::storage::cloud_page_blob page_blob = container.get_page_blob_reference(U("benchmark-page-blob"));
+        concurrency::streams::istream page_source = concurrency::streams::bytestream::open_istream(data);
+        measurement = measure_transfer([&] ()
+        {
+            page_blob.upload_from_stream(page_source, static_cast<utility::size64_t>(data.size()), wa::storage::access_condition(), upload_options, wa::storage::operation_context());
+        });
+        print_measurement(U("page"), U("upload"), settings, measurement);
+
+        measurement = measure_transfer([&] ()
+        {
+            concurrency::streams::container_buffer<std::vector<uint8_t>> target;
+            target.collection().reserve(data.size());
+            page_blob.download_to_stream(target.create_ostream(), wa::storage::access_condition(), download_options, wa::storage::operation_context());
+        });
+        print_measurement(U("page"), U("download"), settings, measurement);
+    }
+
+    void blob_transfer_benchmark(bool in_memory)
+    {
+        try
+        {
+            wa::storage::cloud_blob_client blob_client;
+            std::shared_ptr<wa::storage::in_memory_transport> transport;
+            if (in_memory)
+            {
+                // Measure the client alone, without an account or the network
+                transport = std::make_shared<wa::storage::in_memory_transport>();
+                wa::storage::blob_request_options default_options;
+                default_options.set_transport(transport);
+                blob_client = wa::storage::cloud_blob_client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+            }
+            else
+            {
+                wa::storage::cloud_storage_account storage_account = wa::storage::cloud_storage_account::parse(storage_connection_string);
+                blob_client = storage_account.create_cloud_blob_client();
+            }
+
+            wa::storage::cloud_blob_container container = blob_client.get_container_reference(U("azure-native-client-library-benchmark-container"));
+            container.create_if_not_exists();
+
+            const utility::size64_t object_sizes[] = { 1024 * 1024, 16 * 1024 * 1024, 128 * 1024 * 1024 };
+            const size_t block_sizes[] = { 512 * 1024, 1024 * 1024, 4 * 1024 * 1024 };
+            const int parallelism_factors[] = { 1, 4, 8 };
+            const bool md5_settings[] = { false, true };
+            const utility::size64_t thresholds[] = { 1024 * 1024, 32 * 1024 * 1024 };
+
+            // Peak working set only grows over the life of the process, so smaller objects are measured first
+            ucout << U("blob_type,direction,object_size,block_size,parallelism_factor,md5,single_blob_upload_threshold,mb_per_second,cpu_seconds_per_gb,peak_working_set_mb") << std::endl;
+            for (auto object_size : object_sizes)
+            {
+                std::vector<uint8_t> data(static_cast<size_t>(object_size));
+                for (size_t i = 0; i < data.size(); ++i)
+                {
+                    data[i] = static_cast<uint8_t>(i * 31 + (i >> 12));
+                }
+
+                if (transport)
+                {
+                    transport->set_blob_size(object_size);
+                }
+
+                for (auto block_size : block_sizes)
+                {
+                    for (auto parallelism_factor : parallelism_factors)
+                    {
+                        for (auto use_md5 : md5_settings)
+                        {
+                            for (auto threshold : thresholds)
+                            {
+                                transfer_settings settings;
+                                settings.object_size = object_size;
+                                settings.block_size = block_size;
+                                settings.parallelism_factor = parallelism_factor;
+                                settings.use_md5 = use_md5;
+                                settings.single_blob_upload_threshold = threshold;
+                                run_transfer(container, settings, data, in_memory);
+                            }
+                        }
+                    }
+                }
+            }
+
+            container.delete_container_if_exists();
+        }
+        catch (wa::storage::storage_exception& e)
+        {
+            ucout << U("Error: ") << e.what() << std::endl;
+
+            wa::storage::request_result result = e.result();
+            wa::storage::storage_extended_error extended_error = result.extended_error();
+            if (!extended_error.message().empty())
+            {
+                ucout << extended_error.message() << std::endl;
+            }
+        }
+        catch (std::exception& e)
+        {
+            ucout << U("Error: ") << e.what() << std::endl;
+        }
+    }
+
+}}} // namespace wa::storage::samples
+
+int _tmain(int argc, _TCHAR *argv[])
+{
+    // Pass --in-memory to measure the client against canned responses instead of the account in samples_common.h
+    bool in_memory = argc > 1 && utility::string_t(argv[1]) == U("--in-memory");
+    wa::storage::samples::blob_transfer_benchmark(in_memory);
+    return 0;
+}
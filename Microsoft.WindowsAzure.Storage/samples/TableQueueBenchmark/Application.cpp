@@ -0,0 +1,388 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="Application.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "samples_common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <Windows.h>
+
+#include "was/storage_account.h"
+#include "was/table.h"
+#include "was/queue.h"
+#include "was/in_memory_transport.h"
+
+namespace wa { namespace storage { namespace samples {
+
+    // One point of the benchmark matrix, of which only the fields that apply to the operation are printed
+    struct operation_settings
+    {
+        utility::string_t operation;
+        utility::string_t payload_format;
+        int entity_width;
+        int batch_size;
+        size_t message_size;
+        int concurrency;
+    };
+
+    // Throughput, latency percentiles, CPU time and library allocations of the operations of one point
+    struct operation_measurement
+    {
+        double operations_per_second;
+        double p50_milliseconds;
+        double p95_milliseconds;
+        double p99_milliseconds;
+        double cpu_microseconds_per_operation;
+        double allocations_per_operation;
+    };
+
+    // Runs one operation for the worker with the given index, under the given context
+    typedef std::function<void (int worker, wa::storage::operation_context context)> benchmark_operation;
+
+    double get_process_cpu_seconds()
+    {
+        FILETIME creation_time, exit_time, kernel_time, user_time;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        {
+            return 0.0;
+        }
+
+        // FILETIME counts in units of 100 nanoseconds
+        ULARGE_INTEGER kernel, user;
+        kernel.LowPart = kernel_time.dwLowDateTime;
+        kernel.HighPart = kernel_time.dwHighDateTime;
+        user.LowPart = user_time.dwLowDateTime;
+        user.HighPart = user_time.dwHighDateTime;
+        return static_cast<double>(kernel.QuadPart + user.QuadPart) / 1e7;
+    }
+
+    double get_percentile(const std::vector<long long>& sorted_microseconds, double percentile)
+    {
+        if (sorted_microseconds.empty())
+        {
+            return 0.0;
+        }
+
+        size_t index = std::min(static_cast<size_t>(percentile * sorted_microseconds.size()), sorted_microseconds.size() - 1);
+        return sorted_microseconds[index] / 1000.0;
+    }
+
+    // Every worker runs the operation once to warm up, and then all of them run it the given number of times at once, each on its own thread
+    operation_measurement measure_operations(int concurrency, int operations_per_worker, const benchmark_operation& operation)
+    {
+        std::vector<std::vector<long long>> latencies(concurrency);
+        std::vector<unsigned long long> allocations(concurrency, 0);
+        std::vector<std::thread> threads;
+        std::atomic<int> ready(0);
+        std::atomic<bool> start(false);
+        for (int i = 0; i < concurrency; ++i)
+        {
+            threads.push_back(std::thread([&operation, &latencies, &allocations, &ready, &start, operations_per_worker, i] ()
+            {
+                operation(i, wa::storage::operation_context());
+                ++ready;
+                while (!start.load())
+                {
+                    std::this_thread::yield();
+                }
+
+                latencies[i].reserve(operations_per_worker);
+                for (int j = 0; j < operations_per_worker; ++j)
+                {
+                    wa::storage::operation_context context;
+                    auto operation_start = std::chrono::steady_clock::now();
+                    operation(i, context);
+                    latencies[i].push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - operation_start).count());
+
+                    auto results = context.request_results();
+                    for (auto iter = results.cbegin(); iter != results.cend(); ++iter)
+                    {
+                        allocations[i] += iter->allocations().count();
+                    }
+                }
+            }));
+        }
+
+        while (ready.load() < concurrency)
+        {
+            std::this_thread::yield();
+        }
+
+        double cpu_start = get_process_cpu_seconds();
+        auto start_time = std::chrono::steady_clock::now();
+        start = true;
+        for (auto iter = threads.begin(); iter != threads.end(); ++iter)
+        {
+            iter->join();
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+        double cpu_seconds = get_process_cpu_seconds() - cpu_start;
+
+        std::vector<long long> all_latencies;
+        unsigned long long all_allocations = 0;
+        for (int i = 0; i < concurrency; ++i)
+        {
+            all_latencies.insert(all_latencies.end(), latencies[i].begin(), latencies[i].end());
+            all_allocations += allocations[i];
+        }
+
+        std::sort(all_latencies.begin(), all_latencies.end());
+        double operations = static_cast<double>(all_latencies.size());
+
+        operation_measurement result;
+        result.operations_per_second = operations * 1e6 / (elapsed > 0 ? elapsed : 1);
+        result.p50_milliseconds = get_percentile(all_latencies, 0.50);
+        result.p95_milliseconds = get_percentile(all_latencies, 0.95);
+        result.p99_milliseconds = get_percentile(all_latencies, 0.99);
+        result.cpu_microseconds_per_operation = operations > 0.0 ? cpu_seconds * 1e6 / operations : 0.0;
+        result.allocations_per_operation = operations > 0.0 ? all_allocations / operations : 0.0;
+        return result;
+    }
+
+    void print_measurement(const utility::string_t& service, const operation_settings& settings, const operation_measurement& measurement)
+    {
+        ucout << service << U(',') << settings.operation << U(',') << settings.payload_format << U(',');
+        if (settings.entity_width > 0)
+        {
+            ucout << settings.entity_width;
+        }
+
+        ucout << U(',');
+        if (settings.batch_size > 0)
+        {
+            ucout << settings.batch_size;
+        }
+
+        ucout << U(',');
+        if (settings.message_size > 0)
+        {
+            ucout << settings.message_size;
+        }
+
+        ucout << U(',') << settings.concurrency << U(',')
+            << measurement.operations_per_second << U(',')
+            << measurement.p50_milliseconds << U(',') << measurement.p95_milliseconds << U(',') << measurement.p99_milliseconds << U(',')
+            << measurement.cpu_microseconds_per_operation << U(',') << measurement.allocations_per_operation << std::endl;
+    }
+
+    // An entity with the given number of properties, which cycle through a string, a 32-bit integer and a double
+    wa::storage::table_entity make_entity(const utility::string_t& partition_key, const utility::string_t& row_key, int width)
+    {
+        wa::storage::table_entity entity(partition_key, row_key);
+        for (int i = 0; i < width; ++i)
+        {
+            utility::string_t name(U("Property") + utility::conversions::print_string(i));
+            switch (i % 3)
+            {
+            case 0:
+                entity.properties()[name] = wa::storage::entity_property(utility::string_t(U("benchmark value")));
+                break;
+
+            case 1:
+                entity.properties()[name] = wa::storage::entity_property(int32_t(i));
+                break;
+
+            default:
+                entity.properties()[name] = wa::storage::entity_property(i * 1.5);
+                break;
+            }
+        }
+
+        return entity;
+    }
+
+    utility::string_t get_partition_key(int worker)
+    {
+        return U("partition") + utility::conversions::print_string(worker);
+    }
+
+    void run_table_benchmarks(wa::storage::cloud_table& table, int operations_per_worker)
+    {
+        const wa::storage::table_payload_format payload_formats[] = { wa::storage::table_payload_format::json, wa::storage::table_payload_format::json_no_metadata, wa::storage::table_payload_format::json_full_metadata };
+        const utility::string_t payload_format_names[] = { U("json"), U("json_no_metadata"), U("json_full_metadata") };
+        const int entity_widths[] = { 4, 32, 128 };
+        const int batch_sizes[] = { 1, 10, 100 };
+        const int concurrency_levels[] = { 1, 4, 16, 64 };
+
+        for (size_t format_index = 0; format_index < sizeof(payload_formats) / sizeof(payload_formats[0]); ++format_index)
+        {
+            wa::storage::table_request_options options;
+            options.set_payload_format(payload_formats[format_index]);
+
+            for (auto entity_width : entity_widths)
+            {
+                for (auto concurrency : concurrency_levels)
+                {
+                    operation_settings settings;
+                    settings.payload_format = payload_format_names[format_index];
+                    settings.entity_width = entity_width;
+                    settings.message_size = 0;
+                    settings.concurrency = concurrency;
+
+                    // Each worker writes to a partition of its own, as every entity of a batch must share one
+                    for (auto batch_size : batch_sizes)
+                    {
+                        std::vector<wa::storage::table_batch_operation> batches;
+                        for (int worker = 0; worker < concurrency; ++worker)
+                        {
+                            wa::storage::table_batch_operation worker_batch;
+                            for (int i = 0; i < batch_size; ++i)
+                            {
+                                worker_batch.insert_or_replace_entity(make_entity(get_partition_key(worker), U("row") + utility::conversions::print_string(i), entity_width));
+                            }
+
+                            batches.push_back(worker_batch);
+                        }
+
+                        settings.operation = U("execute_batch");
+                        settings.batch_size = batch_size;
+                        print_measurement(U("table"), settings, measure_operations(concurrency, operations_per_worker, [&table, &batches, &options] (int worker, wa::storage::operation_context context)
+                        {
+                            table.execute_batch(batches[worker], options, context);
+                        }));
+                    }
+
+                    // The entities written by the largest batches are read back
+                    settings.batch_size = 0;
+                    settings.operation = U("point_read");
+                    print_measurement(U("table"), settings, measure_operations(concurrency, operations_per_worker, [&table, &options] (int worker, wa::storage::operation_context context)
+                    {
+                        table.execute(wa::storage::table_operation::retrieve_entity(get_partition_key(worker), U("row0")), options, context);
+                    }));
+
+                    settings.operation = U("query");
+                    print_measurement(U("table"), settings, measure_operations(concurrency, operations_per_worker, [&table, &options] (int worker, wa::storage::operation_context context)
+                    {
+                        wa::storage::table_query query;
+                        query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, get_partition_key(worker)));
+                        query.set_take_count(100);
+                        table.execute_query_segmented(query, wa::storage::continuation_token(), options, context);
+                    }));
+                }
+            }
+        }
+    }
+
+    void run_queue_benchmarks(wa::storage::cloud_queue& queue, int operations_per_worker)
+    {
+        const size_t message_sizes[] = { 64, 4 * 1024, 48 * 1024 };
+        const int concurrency_levels[] = { 1, 4, 16, 64 };
+
+        for (auto message_size : message_sizes)
+        {
+            const utility::string_t content(message_size, U('m'));
+            for (auto concurrency : concurrency_levels)
+            {
+                operation_settings settings;
+                settings.operation = U("add_get_delete");
+                settings.entity_width = 0;
+                settings.batch_size = 0;
+                settings.message_size = message_size;
+                settings.concurrency = concurrency;
+
+                // Each cycle adds a message and then takes one, which with several workers may be one another added
+                print_measurement(U("queue"), settings, measure_operations(concurrency, operations_per_worker, [&queue, &content] (int, wa::storage::operation_context context)
+                {
+                    wa::storage::queue_request_options options;
+                    wa::storage::cloud_queue_message message(content);
+                    queue.add_message(message, std::chrono::seconds(0), std::chrono::seconds(0), options, context);
+
+                    wa::storage::cloud_queue_message received = queue.get_message(std::chrono::seconds(30), options, context);
+                    if (!received.id().empty())
+                    {
+                        queue.delete_message(received, options, context);
+                    }
+                }));
+            }
+        }
+    }
+
+    void table_queue_benchmark(bool in_memory)
+    {
+        try
+        {
+            wa::storage::cloud_table_client table_client;
+            wa::storage::cloud_queue_client queue_client;
+            if (in_memory)
+            {
+                // Measure the client alone, without an account or the network
+                auto transport = std::make_shared<wa::storage::in_memory_transport>();
+                transport->set_listing_size(100);
+
+                wa::storage::storage_credentials credentials(U("account"), U("YWNjb3VudGtleQ=="));
+                wa::storage::table_request_options table_options;
+                table_options.set_transport(transport);
+                table_client = wa::storage::cloud_table_client(wa::storage::storage_uri(web::http::uri(U("https://account.table.core.windows.net"))), credentials, table_options);
+
+                wa::storage::queue_request_options queue_options;
+                queue_options.set_transport(transport);
+                queue_client = wa::storage::cloud_queue_client(wa::storage::storage_uri(web::http::uri(U("https://account.queue.core.windows.net"))), credentials, queue_options);
+            }
+            else
+            {
+                wa::storage::cloud_storage_account storage_account = wa::storage::cloud_storage_account::parse(storage_connection_string);
+                table_client = storage_account.create_cloud_table_client();
+                queue_client = storage_account.create_cloud_queue_client();
+            }
+
+            // Requests to a real account take milliseconds rather than microseconds, so fewer of them are made
+            int operations_per_worker = in_memory ? 200 : 20;
+
+            ucout << U("service,operation,payload_format,entity_width,batch_size,message_size,concurrency,ops_per_second,p50_ms,p95_ms,p99_ms,cpu_us_per_op,library_allocs_per_op") << std::endl;
+
+            wa::storage::cloud_table table = table_client.get_table_reference(U("AzureNativeClientLibraryBenchmarkTable"));
+            table.create_if_not_exists();
+            run_table_benchmarks(table, operations_per_worker);
+            table.delete_table_if_exists();
+
+            wa::storage::cloud_queue queue = queue_client.get_queue_reference(U("azure-native-client-library-benchmark-queue"));
+            queue.create_if_not_exists();
+            run_queue_benchmarks(queue, operations_per_worker);
+            queue.delete_queue_if_exists();
+        }
+        catch (wa::storage::storage_exception& e)
+        {
+            ucout << U("Error: ") << e.what() << std::endl;
+
+            wa::storage::request_result result = e.result();
+            wa::storage::storage_extended_error extended_error = result.extended_error();
+            if (!extended_error.message().empty())
+            {
+                ucout << extended_error.message() << std::endl;
+            }
+        }
+        catch (std::exception& e)
+        {
+            ucout << U("Error: ") << e.what() << std::endl;
+        }
+    }
+
+}}} // namespace wa::storage::samples
+
+int _tmain(int argc, _TCHAR *argv[])
+{
+    // Pass --in-memory to measure the client against canned responses instead of the account in samples_common.h
+    bool in_memory = argc > 1 && utility::string_t(argv[1]) == U("--in-memory");
+    wa::storage::samples::table_queue_benchmark(in_memory);
+    return 0;
+}
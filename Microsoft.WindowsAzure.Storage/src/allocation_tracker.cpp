@@ -0,0 +1,114 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="allocation_tracker.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/allocation_tracker.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        WASTORAGE_THREAD_LOCAL allocation_counters* current_counters = nullptr;
+    }
+
+#ifdef WASTORAGE_COUNT_ALLOCATIONS
+    void* counted_allocate(size_t size)
+    {
+        allocation_counters* counters = current_counters;
+        if (counters != nullptr)
+        {
+            counters->add(size);
+        }
+
+        return std::malloc(size == 0 ? 1 : size);
+    }
+#endif
+
+    bool allocation_scope::is_counting()
+    {
+#ifdef WASTORAGE_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    allocation_counters* allocation_scope::exchange_current(allocation_counters* counters)
+    {
+        allocation_counters* previous = current_counters;
+        current_counters = counters;
+        return previous;
+    }
+
+}}} // namespace wa::storage::core
+
+#ifdef WASTORAGE_COUNT_ALLOCATIONS
+
+// On Windows these only replace the allocation functions of the library itself, so allocations that cpprestsdk or the
+// application make are not counted, even on a thread that is inside an allocation_scope.
+
+void* operator new(size_t size)
+{
+    void* p = wa::storage::core::counted_allocate(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    return wa::storage::core::counted_allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    return wa::storage::core::counted_allocate(size);
+}
+
+void operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+    std::free(p);
+}
+
+#endif
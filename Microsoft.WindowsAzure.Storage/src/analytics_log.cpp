@@ -0,0 +1,265 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="analytics_log.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "was/analytics.h"
+#include "wascore/async_semaphore.h"
+#include "wascore/constants.h"
+#include "wascore/datetime_codec.h"
+#include "wascore/resources.h"
+#include "wascore/transcode.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        struct analytics_log_reader_state
+        {
+            analytics_log_reader_state(const concurrency::streams::istream& stream, analytics_log_handler handler)
+                : source(stream.streambuf()), handler(std::move(handler)), buffer(protocol::analytics_log_buffer_size, '\0'), size(0), count(0)
+            {
+            }
+
+            // Hands the complete lines in the buffer to the handler and moves the incomplete one at the end to the front
+            void parse_lines(bool last)
+            {
+                size_t position = 0;
+                for (;;)
+                {
+                    const char* begin = buffer.data() + position;
+                    const char* newline = static_cast<const char*>(std::memchr(begin, '\n', size - position));
+                    size_t length;
+                    if (newline != nullptr)
+                    {
+                        length = newline - begin;
+                    }
+                    else if (last && (position < size))
+                    {
+                        length = size - position;
+                    }
+                    else
+                    {
+                        break;
+                    }
+
+                    position += length + (newline != nullptr ? 1 : 0);
+                    if ((length > 0) && (begin[length - 1] == '\r'))
+                    {
+                        --length;
+                    }
+
+                    if (length > 0)
+                    {
+                        if (!entry.parse(begin, length))
+                        {
+                            throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_analytics_log));
+                        }
+
+                        handler(entry);
+                        ++count;
+                    }
+                }
+
+                if (position > 0)
+                {
+                    std::memmove(&buffer[0], &buffer[position], size - position);
+                    size -= position;
+                }
+            }
+
+            concurrency::streams::streambuf<uint8_t> source;
+            analytics_log_handler handler;
+            std::string buffer;
+            size_t size;
+            analytics_log_entry entry;
+            utility::size64_t count;
+        };
+    }
+
+    utility::string_t analytics_log_field::to_string() const
+    {
+        return core::to_string_t(m_data, m_size);
+    }
+
+    bool analytics_log_entry::parse(const char* data, size_t size)
+    {
+        // Fields are separated by semicolons, and a field that may contain one is quoted. A quoted field only
+        // ends at a quotation mark followed by a semicolon or the end of the line.
+        m_fields.clear();
+        size_t position = 0;
+        for (;;)
+        {
+            size_t end;
+            if ((position < size) && (data[position] == '"'))
+            {
+                end = position + 1;
+                for (;;)
+                {
+                    const char* quote = static_cast<const char*>(std::memchr(data + end, '"', size - end));
+                    if (quote == nullptr)
+                    {
+                        return false;
+                    }
+
+                    end = quote - data;
+                    if ((end + 1 == size) || (data[end + 1] == ';'))
+                    {
+                        break;
+                    }
+
+                    ++end;
+                }
+
+                m_fields.push_back(analytics_log_field(data + position + 1, end - position - 1));
+                ++end;
+            }
+            else
+            {
+                const char* separator = static_cast<const char*>(std::memchr(data + position, ';', size - position));
+                end = separator != nullptr ? static_cast<size_t>(separator - data) : size;
+                m_fields.push_back(analytics_log_field(data + position, end - position));
+            }
+
+            if (end >= size)
+            {
+                return true;
+            }
+
+            // Skip the separator. One at the end of the line leaves an empty last field.
+            position = end + 1;
+            if (position == size)
+            {
+                m_fields.push_back(analytics_log_field());
+                return true;
+            }
+        }
+    }
+
+    utility::datetime analytics_log_entry::request_start_time() const
+    {
+        return core::parse_iso8601_datetime(field(1).to_string());
+    }
+
+    pplx::task<utility::size64_t> read_analytics_log_async(concurrency::streams::istream stream, analytics_log_handler handler)
+    {
+        auto state = std::make_shared<analytics_log_reader_state>(stream, std::move(handler));
+        return pplx::details::do_while([state] () -> pplx::task<bool>
+        {
+            // A line longer than the buffer needs more room before the rest of it can be read
+            if (state->size == state->buffer.size())
+            {
+                state->buffer.resize(state->buffer.size() * 2);
+            }
+
+            return state->source.getn(reinterpret_cast<uint8_t*>(&state->buffer[state->size]), state->buffer.size() - state->size).then([state] (size_t read) -> bool
+            {
+                state->size += read;
+                state->parse_lines(read == 0);
+                return read != 0;
+            });
+        }).then([state] (bool) -> utility::size64_t
+        {
+            return state->count;
+        });
+    }
+
+    pplx::task<utility::size64_t> read_analytics_logs_async(const cloud_blob_client& client, const utility::string_t& prefix, analytics_log_handler handler, const blob_request_options& options, operation_context context)
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(client.default_request_options(), blob_type::unspecified);
+        if (modified_options.stream_prefetch_depth() == 0)
+        {
+            modified_options.set_stream_prefetch_depth(protocol::default_analytics_log_prefetch_depth);
+        }
+
+        auto container = client.get_container_reference(protocol::analytics_logs_container);
+        auto blobs = std::make_shared<std::vector<cloud_blob>>();
+        return container.list_blobs_async(prefix, true, blob_listing_includes(), 0, [blobs] (const list_blob_item& item) -> bool
+        {
+            blobs->push_back(item.as_blob());
+            return true;
+        }, modified_options, context).then([blobs, handler, modified_options, context] () -> pplx::task<utility::size64_t>
+        {
+            // Each blob is parsed as it is downloaded, and up to the parallelism factor of them at a time
+            core::async_semaphore semaphore(modified_options.parallelism_factor());
+            auto blob_tasks = std::make_shared<std::vector<pplx::task<utility::size64_t>>>();
+            auto next_blob = std::make_shared<size_t>(0);
+            auto failed = std::make_shared<std::atomic<bool>>(false);
+
+            return pplx::details::do_while([blobs, handler, modified_options, context, semaphore, blob_tasks, next_blob, failed] () mutable -> pplx::task<bool>
+            {
+                if (*next_blob >= blobs->size())
+                {
+                    return pplx::task_from_result(false);
+                }
+
+                return semaphore.lock_async().then([blobs, handler, modified_options, context, semaphore, blob_tasks, next_blob, failed] () mutable -> bool
+                {
+                    if (*failed)
+                    {
+                        semaphore.unlock();
+                        return false;
+                    }
+
+                    cloud_blob blob((*blobs)[(*next_blob)++]);
+                    auto blob_task = blob.open_read_async(access_condition(), modified_options, context).then([handler] (concurrency::streams::istream stream) -> pplx::task<utility::size64_t>
+                    {
+                        return read_analytics_log_async(stream, handler).then([stream] (pplx::task<utility::size64_t> read_task) mutable -> pplx::task<utility::size64_t>
+                        {
+                            return stream.close().then([read_task] () -> utility::size64_t
+                            {
+                                return read_task.get();
+                            });
+                        });
+                    });
+
+                    blob_task.then([semaphore, failed] (pplx::task<utility::size64_t> completed_task) mutable
+                    {
+                        try
+                        {
+                            completed_task.wait();
+                        }
+                        catch (...)
+                        {
+                            *failed = true;
+                        }
+
+                        semaphore.unlock();
+                    });
+
+                    blob_tasks->push_back(blob_task);
+                    return *next_blob < blobs->size();
+                });
+            }).then([semaphore, blob_tasks] (bool) mutable -> pplx::task<utility::size64_t>
+            {
+                return semaphore.wait_all_async().then([blob_tasks] () -> utility::size64_t
+                {
+                    // Rethrow the first failure, if any
+                    utility::size64_t count = 0;
+                    for (auto iter = blob_tasks->begin(); iter != blob_tasks->end(); ++iter)
+                    {
+                        count += iter->get();
+                    }
+
+                    return count;
+                });
+            });
+        });
+    }
+
+}} // namespace wa::storage
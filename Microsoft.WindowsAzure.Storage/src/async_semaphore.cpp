@@ -20,54 +20,110 @@
 
 namespace wa { namespace storage {  namespace core {
 
-    pplx::task<void> _async_semaphore::lock_async()
+    pplx::task<void> _async_semaphore::lock_async(int64_t weight)
     {
-        std::lock_guard<std::mutex> guard(m_mutex);
-        if (m_count > 0)
+        weight = clamp_weight(weight);
+
+        // Fast path, which is only taken while nobody is waiting so that waiters are never overtaken
+        if ((m_waiter_count.load() == 0) && try_acquire(weight))
+        {
+            return pplx::task_from_result();
+        }
+
+        waiter pending;
+        pending.weight = weight;
+
+        std::vector<pplx::task_completion_event<void>> granted;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_queue.push_back(pending);
+            ++m_waiter_count;
+
+            // Units released before the waiter was queued are only visible here
+            grant_pending(granted);
+        }
+
+        for (auto iter = granted.begin(); iter != granted.end(); ++iter)
+        {
+            iter->set();
+        }
+
+        return pplx::create_task(pending.event);
+    }
+
+    void _async_semaphore::unlock(int64_t weight)
+    {
+        weight = clamp_weight(weight);
+        auto count = m_count.fetch_add(weight) + weight;
+
+        if ((m_waiter_count.load() == 0) && (count != m_initial_count))
         {
-            if (m_count-- == m_initial_count)
+            return;
+        }
+
+        std::vector<pplx::task_completion_event<void>> granted;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            grant_pending(granted);
+
+            if (m_count.load() == m_initial_count)
             {
-                m_empty_event = pplx::task_completion_event<void>();
+                granted.insert(granted.end(), m_empty_events.begin(), m_empty_events.end());
+                m_empty_events.clear();
             }
-
-            return pplx::task_from_result();
         }
-        else
+
+        // Waiters are resumed outside of the lock, since their continuations may lock again
+        for (auto iter = granted.begin(); iter != granted.end(); ++iter)
         {
-            pplx::task_completion_event<void> pending;
-            m_queue.push(pending);
-            return pplx::create_task(pending);
+            iter->set();
         }
     }
 
     pplx::task<void> _async_semaphore::wait_all_async()
     {
-        return pplx::create_task(m_empty_event);
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_count.load() == m_initial_count)
+        {
+            return pplx::task_from_result();
+        }
+
+        pplx::task_completion_event<void> pending;
+        m_empty_events.push_back(pending);
+        return pplx::create_task(pending);
     }
 
-    void _async_semaphore::unlock()
+    int64_t _async_semaphore::clamp_weight(int64_t weight) const
     {
-        auto pending = dequeue_pending();
-        pending.set();
+        if (weight < 1)
+        {
+            return 1;
+        }
+
+        return (weight > m_initial_count) ? m_initial_count : weight;
     }
 
-    pplx::task_completion_event<void> _async_semaphore::dequeue_pending()
+    bool _async_semaphore::try_acquire(int64_t weight)
     {
-        std::lock_guard<std::mutex> guard(m_mutex);
-        if (m_queue.empty())
+        auto count = m_count.load();
+        while (count >= weight)
         {
-            if (++m_count == m_initial_count)
+            if (m_count.compare_exchange_weak(count, count - weight))
             {
-                m_empty_event.set();
+                return true;
             }
-
-            return pplx::task_completion_event<void>();
         }
-        else
+
+        return false;
+    }
+
+    void _async_semaphore::grant_pending(std::vector<pplx::task_completion_event<void>>& granted)
+    {
+        while (!m_queue.empty() && try_acquire(m_queue.front().weight))
         {
-            auto pending = m_queue.front();
-            m_queue.pop();
-            return pending;
+            granted.push_back(m_queue.front().event);
+            m_queue.pop_front();
+            --m_waiter_count;
         }
     }
 
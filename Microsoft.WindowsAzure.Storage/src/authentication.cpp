@@ -19,17 +19,144 @@
 #include "was/auth.h"
 #include "wascore/constants.h"
 #include "wascore/logging.h"
-#include "wascore/streams.h"
+#include "wascore/credential_cache.h"
+#include "wascore/datetime_codec.h"
+#include "wascore/hash_software.h"
+#include "wascore/transcode.h"
 
 namespace wa { namespace storage { namespace protocol {
 
+    namespace
+    {
+        const size_t base64_signature_length = ((core::hmac_sha256_hash::digest_size + 2) / 3) * 4;
+
+        // Large enough for the string to sign of nearly every request, so that it is built without reallocations
+        const size_t canonicalized_string_capacity = 512;
+
+        void update_utf8(core::hmac_sha256_hash& hash, const utility::string_t& value)
+        {
+#ifdef _UTF16_STRINGS
+            // The string is transcoded through a small buffer in chunks, which never split a surrogate pair
+            const size_t chunk_size = 256;
+            std::string buffer;
+            buffer.reserve(chunk_size * 3);
+            for (size_t position = 0; position < value.size(); )
+            {
+                size_t count = std::min(chunk_size, value.size() - position);
+                if ((position + count < value.size()) && (value[position + count - 1] >= 0xD800) && (value[position + count - 1] < 0xDC00))
+                {
+                    ++count;
+                }
+
+                buffer.clear();
+                core::append_utf8(buffer, value.data() + position, count);
+                hash.update(reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size());
+                position += count;
+            }
+#else
+            hash.update(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+#endif
+        }
+
+        void to_base64(const uint8_t* data, size_t size, utility::char_t* result)
+        {
+            static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            for (size_t i = 0; i < size; i += 3)
+            {
+                uint32_t group = static_cast<uint32_t>(data[i]) << 16;
+                if (i + 1 < size)
+                {
+                    group |= static_cast<uint32_t>(data[i + 1]) << 8;
+                }
+
+                if (i + 2 < size)
+                {
+                    group |= static_cast<uint32_t>(data[i + 2]);
+                }
+
+                *result++ = static_cast<utility::char_t>(alphabet[(group >> 18) & 0x3f]);
+                *result++ = static_cast<utility::char_t>(alphabet[(group >> 12) & 0x3f]);
+                *result++ = (i + 1 < size) ? static_cast<utility::char_t>(alphabet[(group >> 6) & 0x3f]) : U('=');
+                *result++ = (i + 2 < size) ? static_cast<utility::char_t>(alphabet[group & 0x3f]) : U('=');
+            }
+        }
+
+        // Finishes the keyed hash of a string to sign, writing the base64 signature to the given buffer
+        void finalize_signature(core::hmac_sha256_hash& hash, utility::char_t* signature)
+        {
+            uint8_t digest[core::hmac_sha256_hash::digest_size];
+            hash.finalize(digest);
+            to_base64(digest, sizeof(digest), signature);
+        }
+
+        char to_lower_ascii(char ch)
+        {
+            return ((ch >= 'A') && (ch <= 'Z')) ? static_cast<char>(ch - 'A' + 'a') : ch;
+        }
+
+        struct query_parameter
+        {
+            utility::string_t::const_iterator name_begin;
+            utility::string_t::const_iterator name_end;
+            utility::string_t::const_iterator value_begin;
+            utility::string_t::const_iterator value_end;
+
+            bool name_equals(const query_parameter& other) const
+            {
+                return ((name_end - name_begin) == (other.name_end - other.name_begin)) && std::equal(name_begin, name_end, other.name_begin);
+            }
+
+            bool operator<(const query_parameter& other) const
+            {
+                return std::lexicographical_compare(name_begin, name_end, other.name_begin, other.name_end);
+            }
+        };
+
+        // Splits a decoded query into name and value ranges, skipping parameters without a value
+        void split_query(const utility::string_t& query, std::vector<query_parameter>& parameters)
+        {
+            auto pair_begin = query.cbegin();
+            while (pair_begin != query.cend())
+            {
+                auto pair_end = std::find(pair_begin, query.cend(), U('&'));
+                auto equals = std::find(pair_begin, pair_end, U('='));
+                if (equals != pair_end)
+                {
+                    query_parameter parameter = { pair_begin, equals, equals + 1, pair_end };
+                    parameters.push_back(parameter);
+                }
+
+                pair_begin = (pair_end == query.cend()) ? pair_end : pair_end + 1;
+            }
+
+            // Like a std::map, the parameters are ordered by name and the last value of a repeated name wins
+            std::stable_sort(parameters.begin(), parameters.end());
+        }
+    }
+
     utility::string_t calculate_hmac_sha256_hash(const utility::string_t& string_to_hash, const storage_credentials& credentials)
     {
-        auto utf8_string_to_hash = utility::conversions::to_utf8string(string_to_hash);
-        auto hash_streambuf = core::hash_hmac_sha256_streambuf(credentials.account_key());
-        hash_streambuf.putn(reinterpret_cast<const uint8_t*>(utf8_string_to_hash.data()), utf8_string_to_hash.size()).wait();
-        hash_streambuf.close().wait();
-        return utility::conversions::to_base64(hash_streambuf.hash());
+        return calculate_hmac_sha256_hash(string_to_hash, core::hmac_sha256_hash(credentials.account_key()));
+    }
+
+    utility::string_t calculate_hmac_sha256_hash(const utility::string_t& string_to_hash, const core::hmac_sha256_hash& signing_key)
+    {
+        core::hmac_sha256_hash hash(signing_key);
+        update_utf8(hash, string_to_hash);
+
+        utility::char_t signature[base64_signature_length];
+        finalize_signature(hash, signature);
+        return utility::string_t(signature, base64_signature_length);
+    }
+
+    shared_key_authentication_handler::shared_key_authentication_handler(std::shared_ptr<canonicalizer> canonicalizer, const storage_credentials& credentials)
+        : m_canonicalizer(canonicalizer), m_credentials(credentials)
+    {
+        if (m_credentials.is_shared_key())
+        {
+            m_signing_key = core::credential_cache::instance().get_signing_key(m_credentials.account_key());
+        }
     }
 
     void sas_authentication_handler::sign_request(web::http::http_request& request, operation_context context) const
@@ -40,98 +167,178 @@ namespace wa { namespace storage { namespace protocol {
     }
 
     void shared_key_authentication_handler::sign_request(web::http::http_request& request, operation_context context) const
+    {
+        sign_request_impl(request, context, nullptr);
+    }
+
+    std::string shared_key_authentication_handler::canonicalize_resource(const web::http::http_request& request) const
+    {
+        return m_credentials.is_shared_key() ? m_canonicalizer->canonicalize_resource_utf8(request) : std::string();
+    }
+
+    void shared_key_authentication_handler::sign_request_with_resource(web::http::http_request& request, operation_context context, const std::string& canonicalized_resource) const
+    {
+        sign_request_impl(request, context, canonicalized_resource.empty() ? nullptr : &canonicalized_resource);
+    }
+
+    void shared_key_authentication_handler::sign_request_impl(web::http::http_request& request, operation_context context, const std::string* canonicalized_resource) const
     {
         web::http::http_headers& headers = request.headers();
-        headers.add(ms_header_date, utility::datetime::utc_now().to_string());
+        headers.add(ms_header_date, core::current_rfc1123_datetime());
 
         if (m_credentials.is_shared_key())
         {
-            utility::string_t string_to_sign = m_canonicalizer->canonicalize(request, context);
+            // The string to sign is built as UTF-8, so that it can be hashed as it is
+            std::string string_to_sign;
+            string_to_sign.reserve(canonicalized_string_capacity);
+            if (canonicalized_resource != nullptr)
+            {
+                m_canonicalizer->canonicalize_utf8(request, context, *canonicalized_resource, string_to_sign);
+            }
+            else
+            {
+                m_canonicalizer->canonicalize_utf8(request, context, string_to_sign);
+            }
             
             if (core::logger::instance().should_log(context, client_log_level::log_level_verbose))
             {
-                utility::string_t with_dots(string_to_sign);
+                utility::string_t with_dots(core::to_string_t(string_to_sign));
                 std::replace(with_dots.begin(), with_dots.end(), U('\n'), U('.'));
-                core::logger::instance().log(context, client_log_level::log_level_verbose, U("StringToSign: ") + with_dots);
+                core::logger::instance().log(context, client_log_level::log_level_verbose, U("StringToSign: %s"), with_dots);
             }
 
-            utility::ostringstream_t header_value;
-            header_value << m_canonicalizer->authentication_scheme() << U(" ") << m_credentials.account_name() << U(":") << calculate_hmac_sha256_hash(string_to_sign, m_credentials);
+            core::hmac_sha256_hash hash(*m_signing_key);
+            hash.update(reinterpret_cast<const uint8_t*>(string_to_sign.data()), string_to_sign.size());
+
+            utility::char_t signature[base64_signature_length];
+            finalize_signature(hash, signature);
+
+            const auto& scheme = m_canonicalizer->authentication_scheme();
+            const auto& account_name = m_credentials.account_name();
+            utility::string_t header_value;
+            header_value.reserve(scheme.size() + account_name.size() + base64_signature_length + 2);
+            header_value.append(scheme).append(1, U(' ')).append(account_name).append(1, U(':')).append(signature, base64_signature_length);
 
-            headers.add(web::http::header_names::authorization, header_value.str());
+            headers.add(web::http::header_names::authorization, header_value);
+        }
+    }
+
+    void canonicalizer_helper::append(const utility::string_t& value)
+    {
+        append_utf8(value.cbegin(), value.cend());
+        m_result.push_back('\n');
+    }
+
+    void canonicalizer_helper::append_utf8(utility::string_t::const_iterator begin, utility::string_t::const_iterator end, bool to_lower)
+    {
+        if (begin == end)
+        {
+            return;
+        }
+
+        size_t start = m_result.size();
+        core::append_utf8(m_result, &*begin, end - begin);
+        if (to_lower)
+        {
+            // Continuation bytes of UTF-8 are never ASCII, so only the ASCII letters change
+            std::transform(m_result.begin() + start, m_result.end(), m_result.begin() + start, to_lower_ascii);
         }
     }
 
     void canonicalizer_helper::append_resource(bool query_only_comp)
     {
-        m_result << U("/") << m_account_name;
+        m_result.push_back('/');
+        append_utf8(m_account_name.cbegin(), m_account_name.cend());
 
         auto uri = m_request.request_uri();
         auto& resource = uri.path();
         if (resource.front() != U('/'))
         {
-            m_result << U("/");
+            m_result.push_back('/');
         }
 
-        m_result << resource;
+        append_utf8(resource.cbegin(), resource.cend());
 
-        auto query_map = web::http::uri::split_query(web::http::uri::decode(uri.query()));
-        if (query_only_comp)
+        auto query = web::http::uri::decode(uri.query());
+        if (query.empty())
         {
-            auto it = query_map.find(U("comp"));
-            if (it != query_map.end())
-            {
-                m_result << U("?comp=") << it->second;
-            }
+            return;
         }
-        else
+
+        std::vector<query_parameter> parameters;
+        parameters.reserve(8);
+        split_query(query, parameters);
+
+        const utility::string_t comp(U("comp"));
+        for (auto iter = parameters.cbegin(); iter != parameters.cend(); ++iter)
         {
-            // std::map keys are already sorted
-            for (auto iter = query_map.cbegin(); iter != query_map.cend(); ++iter)
+            auto next = iter + 1;
+            if ((next != parameters.cend()) && iter->name_equals(*next))
             {
-                auto name = iter->first;
-                std::transform(name.begin(), name.end(), name.begin(), tolower);
+                continue;
+            }
 
-                m_result << U("\n") << name << U(":") << iter->second;
+            if (query_only_comp)
+            {
+                if (((iter->name_end - iter->name_begin) == static_cast<ptrdiff_t>(comp.size())) && std::equal(iter->name_begin, iter->name_end, comp.cbegin()))
+                {
+                    m_result.append("?comp=");
+                    append_utf8(iter->value_begin, iter->value_end);
+                }
+            }
+            else
+            {
+                m_result.push_back('\n');
+                append_utf8(iter->name_begin, iter->name_end, true);
+                m_result.push_back(':');
+                append_utf8(iter->value_begin, iter->value_end);
             }
         }
     }
 
     void canonicalizer_helper::append_header(const utility::string_t& header_name)
     {
-        utility::string_t value;
-        m_request.headers().match(header_name, value);
-        append(value);
+        auto& headers = m_request.headers();
+        auto iter = headers.find(header_name);
+        if (iter != headers.end())
+        {
+            append(iter->second);
+        }
+        else
+        {
+            m_result.push_back('\n');
+        }
     }
 
     void canonicalizer_helper::append_date_header(bool allow_x_ms_date)
     {
-        utility::string_t value;
-        if (!m_request.headers().match(ms_header_date, value))
+        auto& headers = m_request.headers();
+        auto iter = headers.find(ms_header_date);
+        if (iter == headers.end())
         {
             append_header(web::http::header_names::date);
         }
         else if (allow_x_ms_date)
         {
-            append(value);
+            append(iter->second);
         }
         else
         {
-            append(utility::string_t());
+            m_result.push_back('\n');
         }
     }
 
     void canonicalizer_helper::append_x_ms_headers()
     {
+        const size_t prefix_length = std::char_traits<utility::char_t>::length(ms_header_prefix);
         auto& headers = m_request.headers();
         for (auto iter = headers.begin(); iter != headers.end(); ++iter)
         {
-            auto key = iter->first;
-            if ((key.size() > ms_header_prefix.size()) &&
-                std::equal(ms_header_prefix.cbegin(), ms_header_prefix.cend(), key.cbegin()))
+            auto& key = iter->first;
+            if ((key.size() > prefix_length) && (key.compare(0, prefix_length, ms_header_prefix) == 0))
             {
-                std::transform(key.begin(), key.end(), key.begin(), tolower);
-                m_result << key << U(":");
+                append_utf8(key.cbegin(), key.cend(), true);
+                m_result.push_back(':');
                 append(iter->second);
             }
         }
@@ -139,7 +346,35 @@ namespace wa { namespace storage { namespace protocol {
 
     utility::string_t shared_key_blob_queue_canonicalizer::canonicalize(const web::http::http_request& request, operation_context context) const
     {
-        canonicalizer_helper helper(request, m_account_name);
+        std::string result;
+        canonicalize_utf8(request, context, result);
+        return core::to_string_t(result);
+    }
+
+    void shared_key_blob_queue_canonicalizer::canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const
+    {
+        canonicalizer_helper helper(request, m_account_name, result);
+        append_headers(helper, request);
+        helper.append_resource(false);
+    }
+
+    void shared_key_blob_queue_canonicalizer::canonicalize_utf8(const web::http::http_request& request, operation_context context, const std::string& canonicalized_resource, std::string& result) const
+    {
+        canonicalizer_helper helper(request, m_account_name, result);
+        append_headers(helper, request);
+        helper.append_canonicalized_resource(canonicalized_resource);
+    }
+
+    std::string shared_key_blob_queue_canonicalizer::canonicalize_resource_utf8(const web::http::http_request& request) const
+    {
+        std::string result;
+        canonicalizer_helper helper(request, m_account_name, result);
+        helper.append_resource(false);
+        return result;
+    }
+
+    void shared_key_blob_queue_canonicalizer::append_headers(canonicalizer_helper& helper, const web::http::http_request& request) const
+    {
         helper.append(request.method());
         helper.append_header(web::http::header_names::content_encoding);
         helper.append_header(web::http::header_names::content_language);
@@ -153,39 +388,75 @@ namespace wa { namespace storage { namespace protocol {
         helper.append_header(web::http::header_names::if_unmodified_since);
         helper.append_header(web::http::header_names::range);
         helper.append_x_ms_headers();
-        helper.append_resource(false);
-        return helper.str();
     }
 
     utility::string_t shared_key_lite_blob_queue_canonicalizer::canonicalize(const web::http::http_request& request, operation_context context) const
     {
-        canonicalizer_helper helper(request, m_account_name);
+        std::string result;
+        canonicalize_utf8(request, context, result);
+        return core::to_string_t(result);
+    }
+
+    void shared_key_lite_blob_queue_canonicalizer::canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const
+    {
+        canonicalizer_helper helper(request, m_account_name, result);
+        append_headers(helper, request);
+        helper.append_resource(true);
+    }
+
+    void shared_key_lite_blob_queue_canonicalizer::canonicalize_utf8(const web::http::http_request& request, operation_context context, const std::string& canonicalized_resource, std::string& result) const
+    {
+        canonicalizer_helper helper(request, m_account_name, result);
+        append_headers(helper, request);
+        helper.append_canonicalized_resource(canonicalized_resource);
+    }
+
+    std::string shared_key_lite_blob_queue_canonicalizer::canonicalize_resource_utf8(const web::http::http_request& request) const
+    {
+        std::string result;
+        canonicalizer_helper helper(request, m_account_name, result);
+        helper.append_resource(true);
+        return result;
+    }
+
+    void shared_key_lite_blob_queue_canonicalizer::append_headers(canonicalizer_helper& helper, const web::http::http_request& request) const
+    {
         helper.append(request.method());
         helper.append_header(web::http::header_names::content_md5);
         helper.append_header(web::http::header_names::content_type);
         helper.append_date_header(false);
         helper.append_x_ms_headers();
-        helper.append_resource(true);
-        return helper.str();
     }
 
     utility::string_t shared_key_table_canonicalizer::canonicalize(const web::http::http_request& request, operation_context context) const
     {
-        canonicalizer_helper helper(request, m_account_name);
+        std::string result;
+        canonicalize_utf8(request, context, result);
+        return core::to_string_t(result);
+    }
+
+    void shared_key_table_canonicalizer::canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const
+    {
+        canonicalizer_helper helper(request, m_account_name, result);
         helper.append(request.method());
         helper.append_header(web::http::header_names::content_md5);
         helper.append_header(web::http::header_names::content_type);
         helper.append_date_header(true);
         helper.append_resource(true);
-        return helper.str();
     }
 
     utility::string_t shared_key_lite_table_canonicalizer::canonicalize(const web::http::http_request& request, operation_context context) const
     {
-        canonicalizer_helper helper(request, m_account_name);
+        std::string result;
+        canonicalize_utf8(request, context, result);
+        return core::to_string_t(result);
+    }
+
+    void shared_key_lite_table_canonicalizer::canonicalize_utf8(const web::http::http_request& request, operation_context context, std::string& result) const
+    {
+        canonicalizer_helper helper(request, m_account_name, result);
         helper.append_date_header(true);
         helper.append_resource(true);
-        return helper.str();
     }
 
 }}} // namespace wa::storage::protocol
@@ -0,0 +1,190 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="bandwidth_limiter.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "was/common.h"
+#include "wascore/constants.h"
+#include "wascore/resources.h"
+#include "wascore/timer_wheel.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        size_t get_default_burst(utility::size64_t bytes_per_second)
+        {
+            utility::size64_t burst = bytes_per_second / 10;
+            if (burst < protocol::bandwidth_limiter_min_burst)
+            {
+                burst = protocol::bandwidth_limiter_min_burst;
+            }
+
+            return burst > (std::numeric_limits<size_t>::max)() ? (std::numeric_limits<size_t>::max)() : static_cast<size_t>(burst);
+        }
+    }
+
+    bandwidth_limiter::bandwidth_limiter(utility::size64_t bytes_per_second)
+        : m_bytes_per_second(bytes_per_second), m_burst_bytes(get_default_burst(bytes_per_second)), m_timer_scheduled(false)
+    {
+        if (bytes_per_second == 0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_bandwidth_limiter_rate));
+        }
+
+        m_tokens = static_cast<double>(m_burst_bytes);
+        m_last_refill = std::chrono::steady_clock::now();
+    }
+
+    bandwidth_limiter::bandwidth_limiter(utility::size64_t bytes_per_second, size_t burst_bytes)
+        : m_bytes_per_second(bytes_per_second), m_burst_bytes(burst_bytes), m_timer_scheduled(false)
+    {
+        if (bytes_per_second == 0 || burst_bytes == 0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_bandwidth_limiter_rate));
+        }
+
+        m_tokens = static_cast<double>(m_burst_bytes);
+        m_last_refill = std::chrono::steady_clock::now();
+    }
+
+    pplx::task<void> bandwidth_limiter::acquire_async(size_t count, transfer_priority priority)
+    {
+        if (count > m_burst_bytes)
+        {
+            count = m_burst_bytes;
+        }
+
+        size_t level = static_cast<size_t>(priority);
+        std::lock_guard<std::mutex> guard(m_mutex);
+        refill(std::chrono::steady_clock::now());
+
+        // Waiters of the same or a higher priority go first, even if there are enough tokens for this transfer
+        bool waiting = false;
+        for (size_t i = 0; i <= level; ++i)
+        {
+            waiting = waiting || !m_waiters[i].empty();
+        }
+
+        if (!waiting && m_tokens >= static_cast<double>(count))
+        {
+            m_tokens -= static_cast<double>(count);
+            return pplx::task_from_result();
+        }
+
+        waiter value;
+        value.count = count;
+        m_waiters[level].push_back(value);
+        schedule_timer();
+        return pplx::create_task(value.ready);
+    }
+
+    void bandwidth_limiter::refill(std::chrono::steady_clock::time_point now)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - m_last_refill).count();
+        m_last_refill = now;
+        m_tokens += static_cast<double>(elapsed) * static_cast<double>(m_bytes_per_second) / 1000000.0;
+        if (m_tokens > static_cast<double>(m_burst_bytes))
+        {
+            m_tokens = static_cast<double>(m_burst_bytes);
+        }
+    }
+
+    void bandwidth_limiter::grant_waiters(std::vector<pplx::task_completion_event<void>>& ready)
+    {
+        // The waiters are served strictly in order of priority, so a large waiter of a higher priority
+        // is not overtaken by smaller ones of a lower priority
+        for (size_t level = 0; level < 3; ++level)
+        {
+            auto& waiters = m_waiters[level];
+            while (!waiters.empty())
+            {
+                if (m_tokens < static_cast<double>(waiters.front().count))
+                {
+                    return;
+                }
+
+                m_tokens -= static_cast<double>(waiters.front().count);
+                ready.push_back(waiters.front().ready);
+                waiters.pop_front();
+            }
+        }
+    }
+
+    void bandwidth_limiter::schedule_timer()
+    {
+        if (m_timer_scheduled)
+        {
+            return;
+        }
+
+        size_t count = 0;
+        for (size_t level = 0; level < 3 && count == 0; ++level)
+        {
+            if (!m_waiters[level].empty())
+            {
+                count = m_waiters[level].front().count;
+            }
+        }
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        // Wake up once the bucket holds enough tokens for the first waiter
+        double missing = static_cast<double>(count) - m_tokens;
+        auto delay = missing > 0.0 ? static_cast<std::chrono::milliseconds::rep>(std::ceil(missing * 1000.0 / static_cast<double>(m_bytes_per_second))) : 0;
+        if (delay < 1)
+        {
+            delay = 1;
+        }
+
+        m_timer_scheduled = true;
+        std::weak_ptr<bandwidth_limiter> weak_this = shared_from_this();
+        core::timer_wheel::instance().schedule(std::chrono::milliseconds(delay), [weak_this] ()
+        {
+            auto this_pointer = weak_this.lock();
+            if (this_pointer)
+            {
+                this_pointer->on_timer();
+            }
+        });
+    }
+
+    void bandwidth_limiter::on_timer()
+    {
+        std::vector<pplx::task_completion_event<void>> ready;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_timer_scheduled = false;
+            refill(std::chrono::steady_clock::now());
+            grant_waiters(ready);
+            schedule_timer();
+        }
+
+        // The continuations of the waiters must not run on the thread of the timer wheel
+        for (auto iter = ready.begin(); iter != ready.end(); ++iter)
+        {
+            auto event = *iter;
+            pplx::create_task([event] ()
+            {
+                event.set();
+            });
+        }
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,133 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_attribute_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/blob_attribute_cache.h"
+
+namespace wa { namespace storage { namespace core {
+
+    blob_attribute_cache_settings blob_attribute_cache::settings() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings;
+    }
+
+    void blob_attribute_cache::set_settings(const blob_attribute_cache_settings& value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_settings = value;
+        m_entries.clear();
+        m_index.clear();
+        ++m_invalidations;
+    }
+
+    bool blob_attribute_cache::is_enabled() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings.max_blobs() > 0;
+    }
+
+    utility::string_t blob_attribute_cache::get_key(const storage_uri& uri, const utility::string_t& snapshot_time)
+    {
+        // A line break cannot be part of a blob URI, so it separates the snapshot time from the URI
+        utility::string_t key(uri.primary_uri().to_string());
+        if (!snapshot_time.empty())
+        {
+            key.push_back(U('\n'));
+            key.append(snapshot_time);
+        }
+
+        return key;
+    }
+
+    uint64_t blob_attribute_cache::begin_read() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_invalidations;
+    }
+
+    bool blob_attribute_cache::try_get(const utility::string_t& key, cloud_blob_properties& properties, cloud_metadata& metadata, copy_state& copy, bool& is_fresh)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_index.find(key);
+        if (iter == m_index.end())
+        {
+            return false;
+        }
+
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        properties = iter->second->properties;
+        metadata = iter->second->metadata;
+        copy = iter->second->copy;
+        is_fresh = std::chrono::steady_clock::now() < iter->second->expiry_time;
+        return true;
+    }
+
+    void blob_attribute_cache::put(const utility::string_t& key, const cloud_blob_properties& properties, const cloud_metadata& metadata, const copy_state& copy, uint64_t read_invalidations)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        // Attributes that may have been changed while they were read are not stored, because the cache could not tell that they are out of date
+        if (m_settings.max_blobs() == 0 || read_invalidations != m_invalidations)
+        {
+            return;
+        }
+
+        std::chrono::steady_clock::time_point expiry_time = std::chrono::steady_clock::now() + m_settings.time_to_live();
+
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            iter->second->properties = properties;
+            iter->second->metadata = metadata;
+            iter->second->copy = copy;
+            iter->second->expiry_time = expiry_time;
+            m_entries.splice(m_entries.begin(), m_entries, iter->second);
+            return;
+        }
+
+        entry value;
+        value.key = key;
+        value.properties = properties;
+        value.metadata = metadata;
+        value.copy = copy;
+        value.expiry_time = expiry_time;
+        m_entries.push_front(std::move(value));
+        m_index[key] = m_entries.begin();
+
+        while (m_entries.size() > m_settings.max_blobs())
+        {
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+        }
+    }
+
+    void blob_attribute_cache::remove(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        ++m_invalidations;
+
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            m_entries.erase(iter->second);
+            m_index.erase(iter);
+        }
+    }
+
+}}} // namespace wa::storage::core
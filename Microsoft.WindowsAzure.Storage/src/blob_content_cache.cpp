@@ -0,0 +1,316 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_content_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/blob_content_cache.h"
+#include "wascore/hash_software.h"
+#include "wascore/util.h"
+#include "cpprest/containerstream.h"
+#include "cpprest/filestream.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        utility::string_t get_crc64(const uint8_t* data, size_t size)
+        {
+            crc64_hash hash;
+            hash.update(data, size);
+            return utility::conversions::to_base64(hash.finalize());
+        }
+
+        // Reads the next line of the header of a cache file, or returns false if the header ends too early
+        bool read_header_line(const std::string& data, size_t& position, std::string& line)
+        {
+            auto end = data.find('\n', position);
+            if (end == std::string::npos)
+            {
+                return false;
+            }
+
+            line = data.substr(position, end - position);
+            position = end + 1;
+            return true;
+        }
+
+        // A cache file holds the key, the ETag, the length and the CRC64 of the content on one line each, followed by the content itself
+        std::shared_ptr<const blob_content_cache::content> parse_file(const std::string& data, const utility::string_t& key)
+        {
+            size_t position = 0;
+            std::string file_key;
+            std::string etag;
+            std::string length;
+            std::string crc64;
+            if (!read_header_line(data, position, file_key) ||
+                !read_header_line(data, position, etag) ||
+                !read_header_line(data, position, length) ||
+                !read_header_line(data, position, crc64))
+            {
+                return nullptr;
+            }
+
+            // A file that belongs to another key with the same name, or that was not written completely, is ignored
+            std::string body(data.substr(position));
+            if ((file_key != utility::conversions::to_utf8string(key)) ||
+                (length != std::to_string(static_cast<unsigned long long>(body.size()))) ||
+                (crc64 != utility::conversions::to_utf8string(get_crc64(reinterpret_cast<const uint8_t*>(body.data()), body.size()))))
+            {
+                return nullptr;
+            }
+
+            auto value = std::make_shared<blob_content_cache::content>();
+            value->etag = utility::conversions::to_string_t(etag);
+            value->body = std::make_shared<std::vector<uint8_t>>(body.begin(), body.end());
+            return value;
+        }
+    }
+
+    blob_content_cache_settings blob_content_cache::settings() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings;
+    }
+
+    void blob_content_cache::set_settings(const blob_content_cache_settings& value)
+    {
+        if (!value.directory().empty())
+        {
+            create_local_directories(value.directory());
+        }
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_settings = value;
+        m_entries.clear();
+        m_index.clear();
+        m_size = 0;
+        ++m_invalidations;
+    }
+
+    bool blob_content_cache::is_enabled() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings.max_size_in_bytes() > 0;
+    }
+
+    utility::string_t blob_content_cache::get_key(const storage_uri& snapshot_qualified_uri)
+    {
+        return snapshot_qualified_uri.primary_uri().to_string();
+    }
+
+    uint64_t blob_content_cache::begin_read() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_invalidations;
+    }
+
+    pplx::task<std::shared_ptr<const blob_content_cache::content>> blob_content_cache::get_async(const utility::string_t& key)
+    {
+        utility::string_t path;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto iter = m_index.find(key);
+            if (iter != m_index.end())
+            {
+                m_entries.splice(m_entries.begin(), m_entries, iter->second);
+                return pplx::task_from_result(iter->second->value);
+            }
+
+            if (m_settings.directory().empty())
+            {
+                return pplx::task_from_result(std::shared_ptr<const content>());
+            }
+
+            path = get_path(key);
+        }
+
+        return read_file_async(path, key);
+    }
+
+    void blob_content_cache::put(const utility::string_t& key, std::shared_ptr<const content> value, uint64_t read_invalidations, bool write_to_disk)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        // A content that may have been changed while it was read is not stored, because it could not be told apart from the current one
+        if ((m_settings.max_size_in_bytes() == 0) || (read_invalidations != m_invalidations) || (value->body->size() > m_settings.max_blob_size_in_bytes()))
+        {
+            return;
+        }
+
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            m_size -= iter->second->value->body->size();
+            iter->second->value = value;
+            m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        }
+        else
+        {
+            entry new_entry;
+            new_entry.key = key;
+            new_entry.value = value;
+            m_entries.push_front(std::move(new_entry));
+            m_index[key] = m_entries.begin();
+        }
+
+        m_size += value->body->size();
+        while (m_size > m_settings.max_size_in_bytes())
+        {
+            const entry& oldest = m_entries.back();
+            m_size -= oldest.value->body->size();
+            if (!m_settings.directory().empty())
+            {
+                delete_file(get_path(oldest.key));
+            }
+
+            m_index.erase(oldest.key);
+            m_entries.pop_back();
+        }
+
+        if (write_to_disk && !m_settings.directory().empty())
+        {
+            write_file(get_path(key), key, value);
+        }
+    }
+
+    void blob_content_cache::remove(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        ++m_invalidations;
+
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            m_size -= iter->second->value->body->size();
+            m_entries.erase(iter->second);
+            m_index.erase(iter);
+        }
+
+        if (!m_settings.directory().empty())
+        {
+            delete_file(get_path(key));
+        }
+    }
+
+    utility::string_t blob_content_cache::get_path(const utility::string_t& key) const
+    {
+        // Keys are blob URIs, which can be longer than a file name, so files are named after the CRC64 of the key instead
+        const utility::char_t* hex_digits = U("0123456789abcdef");
+        std::string utf8_key(utility::conversions::to_utf8string(key));
+        crc64_hash hash;
+        hash.update(reinterpret_cast<const uint8_t*>(utf8_key.data()), utf8_key.size());
+        std::vector<unsigned char> name(hash.finalize());
+
+        utility::string_t path(m_settings.directory());
+        if ((path.back() != U('\\')) && (path.back() != U('/')))
+        {
+            path.push_back(U('/'));
+        }
+
+        for (auto iter = name.begin(); iter != name.end(); ++iter)
+        {
+            path.push_back(hex_digits[*iter >> 4]);
+            path.push_back(hex_digits[*iter & 0x0F]);
+        }
+
+        path.append(U(".blob"));
+        return path;
+    }
+
+    pplx::task<std::shared_ptr<const blob_content_cache::content>> blob_content_cache::read_file_async(const utility::string_t& path, const utility::string_t& key)
+    {
+        return concurrency::streams::fstream::open_istream(path).then([key] (pplx::task<concurrency::streams::istream> open_task) -> pplx::task<std::shared_ptr<const content>>
+        {
+            concurrency::streams::istream file;
+            try
+            {
+                file = open_task.get();
+            }
+            catch (const std::exception&)
+            {
+                // The content has not been written to disk, or it has been removed since
+                return pplx::task_from_result(std::shared_ptr<const content>());
+            }
+
+            concurrency::streams::container_buffer<std::string> buffer;
+            return file.read_to_end(buffer).then([file, buffer, key] (pplx::task<size_t> read_task) mutable -> std::shared_ptr<const content>
+            {
+                file.close().wait();
+                try
+                {
+                    read_task.wait();
+                }
+                catch (const std::exception&)
+                {
+                    return nullptr;
+                }
+
+                return parse_file(buffer.collection(), key);
+            });
+        });
+    }
+
+    void blob_content_cache::write_file(const utility::string_t& path, const utility::string_t& key, std::shared_ptr<const content> value)
+    {
+        const std::vector<uint8_t>& body = *value->body;
+        auto data = std::make_shared<std::string>();
+        data->append(utility::conversions::to_utf8string(key)).push_back('\n');
+        data->append(utility::conversions::to_utf8string(value->etag)).push_back('\n');
+        data->append(std::to_string(static_cast<unsigned long long>(body.size()))).push_back('\n');
+        data->append(utility::conversions::to_utf8string(get_crc64(body.data(), body.size()))).push_back('\n');
+        data->append(body.begin(), body.end());
+
+        m_disk_task = m_disk_task.then([path, data] () -> pplx::task<void>
+        {
+            return concurrency::streams::fstream::open_ostream(path, std::ios::out | std::ios::trunc).then([data] (concurrency::streams::ostream file) -> pplx::task<void>
+            {
+                return file.streambuf().putn(reinterpret_cast<const uint8_t*>(data->data()), data->size()).then([file, data] (pplx::task<size_t> write_task) mutable -> pplx::task<void>
+                {
+                    return file.close().then([write_task] ()
+                    {
+                        write_task.wait();
+                    });
+                });
+            });
+        }).then([] (pplx::task<void> write_task)
+        {
+            // A content that cannot be written to disk is only downloaded again once it is no longer in memory
+            try
+            {
+                write_task.wait();
+            }
+            catch (const std::exception&)
+            {
+            }
+        });
+    }
+
+    void blob_content_cache::delete_file(const utility::string_t& path)
+    {
+        m_disk_task = m_disk_task.then([path] ()
+        {
+            try
+            {
+                delete_local_file(path);
+            }
+            catch (const std::exception&)
+            {
+            }
+        });
+    }
+
+}}} // namespace wa::storage::core
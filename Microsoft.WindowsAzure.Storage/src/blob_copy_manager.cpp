@@ -0,0 +1,344 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_copy_manager.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    struct blob_copy_manager::shared_state
+    {
+        struct pending_copy
+        {
+            cloud_blob destination;
+            utility::string_t copy_id;
+            int64_t bytes_copied;
+            std::chrono::steady_clock::time_point last_progress;
+            bool stalled;
+        };
+
+        shared_state(const blob_copy_manager& manager)
+            : container(manager.m_container), options(manager.m_options), context(manager.m_context), copy_slots(manager.m_max_concurrent_copies),
+            min_polling_interval(manager.m_min_polling_interval), max_polling_interval(manager.m_max_polling_interval), stall_timeout(manager.m_stall_timeout),
+            polling_interval(manager.m_min_polling_interval), outstanding_copies(0), is_polling(false), made_progress(false)
+        {
+        }
+
+        static void start_copy(std::shared_ptr<shared_state> state, web::http::uri source, cloud_blob destination)
+        {
+            state->copy_slots.lock_async().then([state, source, destination] () mutable -> pplx::task<utility::string_t>
+            {
+                return destination.start_copy_from_blob_async(source, access_condition(), access_condition(), state->options, state->context);
+            }).then([state, destination] (pplx::task<utility::string_t> start_task)
+            {
+                utility::string_t copy_id;
+                try
+                {
+                    copy_id = start_task.get();
+                }
+                catch (...)
+                {
+                    complete_copy(state, blob_copy_result(destination, std::current_exception()));
+                    return;
+                }
+
+                // Small copies within an account may have completed already
+                if (destination.copy_state().status() != copy_status::pending)
+                {
+                    complete_copy(state, blob_copy_result(destination, false));
+                    return;
+                }
+
+                bool start_polling = false;
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    pending_copy copy = { destination, copy_id, destination.copy_state().bytes_copied(), std::chrono::steady_clock::now(), false };
+                    state->pending_copies.insert(std::make_pair(destination.name(), copy));
+                    if (!state->is_polling)
+                    {
+                        state->is_polling = true;
+                        state->polling_interval = state->min_polling_interval;
+                        start_polling = true;
+                    }
+                }
+
+                if (start_polling)
+                {
+                    poll(state);
+                }
+            });
+        }
+
+        static void complete_copy(std::shared_ptr<shared_state> state, blob_copy_result result)
+        {
+            pplx::task_completion_event<void> done_event;
+            bool is_done;
+
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                state->results.push_back(std::move(result));
+                is_done = --state->outstanding_copies == 0;
+                done_event = state->done_event;
+            }
+
+            state->copy_slots.unlock();
+            if (is_done)
+            {
+                done_event.set();
+            }
+        }
+
+        // Polls until no copy is pending anymore
+        static void poll(std::shared_ptr<shared_state> state)
+        {
+            pplx::details::do_while([state] () -> pplx::task<bool>
+            {
+                std::chrono::milliseconds interval;
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    interval = state->polling_interval;
+                }
+
+                return core::complete_after(interval).then([state] () -> pplx::task<bool>
+                {
+                    utility::string_t prefix;
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        prefix = get_common_prefix(state->pending_copies);
+                        state->made_progress = false;
+                    }
+
+                    return list_pending_copies_async(state, prefix, blob_continuation_token()).then([state] (pplx::task<void> list_task) -> bool
+                    {
+                        try
+                        {
+                            list_task.wait();
+                        }
+                        catch (...)
+                        {
+                            // The listing has been retried according to the retry policy already, so the copies are polled again later
+                        }
+
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        if (state->made_progress)
+                        {
+                            state->polling_interval = state->min_polling_interval;
+                        }
+                        else
+                        {
+                            state->polling_interval = std::min(state->polling_interval * 2, state->max_polling_interval);
+                        }
+
+                        if (state->pending_copies.empty())
+                        {
+                            state->is_polling = false;
+                            return false;
+                        }
+
+                        return true;
+                    });
+                });
+            });
+        }
+
+        // Must be called with the mutex held
+        static utility::string_t get_common_prefix(const std::map<utility::string_t, pending_copy>& copies)
+        {
+            if (copies.empty())
+            {
+                return utility::string_t();
+            }
+
+            // The names are sorted, so the prefix that the first and the last share is shared by all of them
+            const utility::string_t& first = copies.begin()->first;
+            const utility::string_t& last = copies.rbegin()->first;
+            size_t length = 0;
+            while ((length < first.size()) && (length < last.size()) && (first[length] == last[length]))
+            {
+                ++length;
+            }
+
+            return first.substr(0, length);
+        }
+
+        static pplx::task<void> list_pending_copies_async(std::shared_ptr<shared_state> state, utility::string_t prefix, blob_continuation_token token)
+        {
+            blob_listing_includes includes;
+            includes.set_copy(true);
+            return state->container.list_blobs_segmented_async(prefix, true, includes, 0, token, state->options, state->context).then([state, prefix] (blob_result_segment segment) -> pplx::task<void>
+            {
+                bool more_pending = process_segment(state, segment.blobs());
+                if (!more_pending || segment.continuation_token().empty())
+                {
+                    return pplx::task_from_result();
+                }
+
+                return list_pending_copies_async(state, prefix, segment.continuation_token());
+            });
+        }
+
+        // Returns true if some pending copies may still come in later segments of the listing
+        static bool process_segment(std::shared_ptr<shared_state> state, const std::vector<cloud_blob>& blobs)
+        {
+            auto now = std::chrono::steady_clock::now();
+            std::vector<blob_copy_result> completed;
+            std::vector<std::pair<cloud_blob, utility::string_t>> stalled;
+            bool more_pending;
+
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                for (auto iter = blobs.cbegin(); iter != blobs.cend(); ++iter)
+                {
+                    auto copy = state->pending_copies.find(iter->name());
+                    if (copy == state->pending_copies.end())
+                    {
+                        continue;
+                    }
+
+                    // Another copy to the same blob replaces this one, which the service then reports as aborted
+                    const wa::storage::copy_state& current_state = iter->copy_state();
+                    if ((current_state.copy_id() != copy->second.copy_id) || (current_state.status() != copy_status::pending))
+                    {
+                        completed.push_back(blob_copy_result(*iter, copy->second.stalled));
+                        state->pending_copies.erase(copy);
+                        state->made_progress = true;
+                        continue;
+                    }
+
+                    if (current_state.bytes_copied() != copy->second.bytes_copied)
+                    {
+                        copy->second.bytes_copied = current_state.bytes_copied();
+                        copy->second.last_progress = now;
+                        state->made_progress = true;
+                    }
+                    else if (!copy->second.stalled && (state->stall_timeout.count() > 0) && (now - copy->second.last_progress >= state->stall_timeout))
+                    {
+                        copy->second.stalled = true;
+                        stalled.push_back(std::make_pair(copy->second.destination, copy->second.copy_id));
+                    }
+                }
+
+                more_pending = !blobs.empty() && !state->pending_copies.empty() && (blobs.back().name() < state->pending_copies.rbegin()->first);
+            }
+
+            for (auto iter = completed.begin(); iter != completed.end(); ++iter)
+            {
+                complete_copy(state, std::move(*iter));
+            }
+
+            // An aborted copy is completed by a later poll, which sees its final state
+            for (auto iter = stalled.begin(); iter != stalled.end(); ++iter)
+            {
+                iter->first.abort_copy_async(iter->second, access_condition(), state->options, state->context).then([] (pplx::task<void> abort_task)
+                {
+                    try
+                    {
+                        abort_task.wait();
+                    }
+                    catch (...)
+                    {
+                        // The copy may have completed in the meantime
+                    }
+                });
+            }
+
+            return more_pending;
+        }
+
+        cloud_blob_container container;
+        blob_request_options options;
+        operation_context context;
+        core::async_semaphore copy_slots;
+        std::chrono::milliseconds min_polling_interval;
+        std::chrono::milliseconds max_polling_interval;
+        std::chrono::seconds stall_timeout;
+
+        std::map<utility::string_t, pending_copy> pending_copies;
+        std::vector<blob_copy_result> results;
+        std::chrono::milliseconds polling_interval;
+        size_t outstanding_copies;
+        bool is_polling;
+        bool made_progress;
+        pplx::task_completion_event<void> done_event;
+        std::mutex mutex;
+    };
+
+    void blob_copy_manager::add(const web::http::uri& source, const utility::string_t& destination_name)
+    {
+        if (m_state == nullptr)
+        {
+            if (m_max_concurrent_copies < 1)
+            {
+                throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_copy_manager_max_concurrent_copies));
+            }
+
+            if ((m_min_polling_interval.count() <= 0) || (m_min_polling_interval > m_max_polling_interval))
+            {
+                throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_copy_manager_polling_interval));
+            }
+
+            m_state = std::make_shared<shared_state>(*this);
+        }
+
+        auto state = m_state;
+        auto destination = m_container.get_blob_reference(destination_name);
+
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (state->outstanding_copies++ == 0)
+            {
+                state->done_event = pplx::task_completion_event<void>();
+            }
+        }
+
+        shared_state::start_copy(state, source, destination);
+    }
+
+    pplx::task<std::vector<blob_copy_result>> blob_copy_manager::wait_all_async()
+    {
+        auto state = m_state;
+        if (state == nullptr)
+        {
+            return pplx::task_from_result(std::vector<blob_copy_result>());
+        }
+
+        pplx::task_completion_event<void> done_event;
+
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (state->outstanding_copies == 0)
+            {
+                return pplx::task_from_result(state->results);
+            }
+
+            done_event = state->done_event;
+        }
+
+        return pplx::create_task(done_event).then([state] () -> std::vector<blob_copy_result>
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            return state->results;
+        });
+    }
+
+}} // namespace wa::storage
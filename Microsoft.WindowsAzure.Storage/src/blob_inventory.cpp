@@ -0,0 +1,614 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_inventory.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <algorithm>
+
+#include "was/blob.h"
+#include "wascore/resources.h"
+#include "wascore/streams.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        const size_t md5_size = 16;
+
+        // Parses an ETag of the form 0x followed by upper-case hexadecimal digits, returning 0 if formatting the
+        // value would not give back the same text
+        uint64_t parse_hexadecimal_etag(const utility::string_t& value)
+        {
+            if (value.size() < 3 || value.size() > 18 || value[0] != U('0') || value[1] != U('x') || value[2] == U('0'))
+            {
+                return 0;
+            }
+
+            uint64_t result = 0;
+            for (size_t i = 2; i < value.size(); ++i)
+            {
+                utility::char_t c = value[i];
+                result <<= 4;
+                if (c >= U('0') && c <= U('9'))
+                {
+                    result |= static_cast<uint64_t>(c - U('0'));
+                }
+                else if (c >= U('A') && c <= U('F'))
+                {
+                    result |= static_cast<uint64_t>(c - U('A') + 10);
+                }
+                else
+                {
+                    return 0;
+                }
+            }
+
+            return result;
+        }
+
+        // Formats an ETag parsed by parse_hexadecimal_etag, with the quotes it is returned with
+        utility::string_t format_hexadecimal_etag(uint64_t value)
+        {
+            const utility::char_t digits[] = U("0123456789ABCDEF");
+            utility::char_t buffer[16];
+            size_t count = 0;
+            for (; value != 0; value >>= 4)
+            {
+                buffer[count++] = digits[value & 0xF];
+            }
+
+            utility::string_t result;
+            result.reserve(count + 4);
+            result.append(U("\"0x"));
+            while (count > 0)
+            {
+                result.push_back(buffer[--count]);
+            }
+
+            result.push_back(U('"'));
+            return result;
+        }
+
+        // Decodes a base64 MD5 hash, returning false if encoding the bytes would not give back the same text
+        bool parse_content_md5(const utility::string_t& value, std::vector<unsigned char>& bytes)
+        {
+            if (value.size() != 24 || value[22] != U('=') || value[23] != U('='))
+            {
+                return false;
+            }
+
+            try
+            {
+                bytes = utility::conversions::from_base64(value);
+            }
+            catch (const std::exception&)
+            {
+                return false;
+            }
+
+            return bytes.size() == md5_size && utility::conversions::to_base64(bytes) == value;
+        }
+
+        const char snapshot_magic[8] = { 'W', 'A', 'S', 'I', 'N', 'V', 'E', 'N' };
+        const uint32_t snapshot_version = 1;
+
+        struct snapshot_header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+            uint64_t count;
+            uint64_t names_size;
+            uint64_t irregular_etag_count;
+            uint64_t irregular_etag_text_size;
+            uint64_t irregular_content_md5_count;
+            uint64_t irregular_content_md5_text_size;
+        };
+
+        // Offsets of the columns of a snapshot file. The 64-bit columns come first, right after the header, so that
+        // they are aligned, and the byte columns and the text follow.
+        struct snapshot_layout
+        {
+            explicit snapshot_layout(const snapshot_header& header)
+            {
+                name_ends = sizeof(snapshot_header);
+                lengths = name_ends + header.count * sizeof(uint64_t);
+                last_modified = lengths + header.count * sizeof(uint64_t);
+                etags = last_modified + header.count * sizeof(uint64_t);
+                irregular_etag_indexes = etags + header.count * sizeof(uint64_t);
+                irregular_etag_ends = irregular_etag_indexes + header.irregular_etag_count * sizeof(uint64_t);
+                irregular_content_md5_indexes = irregular_etag_ends + header.irregular_etag_count * sizeof(uint64_t);
+                irregular_content_md5_ends = irregular_content_md5_indexes + header.irregular_content_md5_count * sizeof(uint64_t);
+                content_md5s = irregular_content_md5_ends + header.irregular_content_md5_count * sizeof(uint64_t);
+                types = content_md5s + header.count * md5_size;
+                has_content_md5 = types + header.count;
+                names = has_content_md5 + header.count;
+                irregular_etag_text = names + header.names_size;
+                irregular_content_md5_text = irregular_etag_text + header.irregular_etag_text_size;
+                total_size = irregular_content_md5_text + header.irregular_content_md5_text_size;
+            }
+
+            uint64_t name_ends;
+            uint64_t lengths;
+            uint64_t last_modified;
+            uint64_t etags;
+            uint64_t irregular_etag_indexes;
+            uint64_t irregular_etag_ends;
+            uint64_t irregular_content_md5_indexes;
+            uint64_t irregular_content_md5_ends;
+            uint64_t content_md5s;
+            uint64_t types;
+            uint64_t has_content_md5;
+            uint64_t names;
+            uint64_t irregular_etag_text;
+            uint64_t irregular_content_md5_text;
+            uint64_t total_size;
+        };
+
+        // Orders names by their UTF-8 bytes, as the Blob service lists them
+        int compare_names(const char* left, size_t left_size, const char* right, size_t right_size)
+        {
+            int result = std::memcmp(left, right, std::min(left_size, right_size));
+            if (result != 0)
+            {
+                return result;
+            }
+
+            return left_size < right_size ? -1 : (left_size > right_size ? 1 : 0);
+        }
+
+        std::string to_utf8(const utility::string_t& value)
+        {
+#ifdef _UTF16_STRINGS
+            return utility::conversions::utf16_to_utf8(value);
+#else
+            return value;
+#endif
+        }
+
+        void throw_invalid_snapshot()
+        {
+            throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_inventory_snapshot));
+        }
+    }
+
+    utility::string_t blob_inventory::etag(size_t index) const
+    {
+        uint64_t value = m_etags[index];
+        if (value == 0)
+        {
+            auto irregular = m_irregular_etags.find(index);
+            return irregular != m_irregular_etags.end() ? irregular->second : utility::string_t();
+        }
+
+        return format_hexadecimal_etag(value);
+    }
+
+    utility::string_t blob_inventory::content_md5(size_t index) const
+    {
+        if (!m_has_content_md5[index])
+        {
+            auto irregular = m_irregular_content_md5s.find(index);
+            return irregular != m_irregular_content_md5s.end() ? irregular->second : utility::string_t();
+        }
+
+        auto begin = m_content_md5s.cbegin() + index * md5_size;
+        return utility::conversions::to_base64(std::vector<unsigned char>(begin, begin + md5_size));
+    }
+
+    void blob_inventory::reserve(size_t count, size_t name_bytes)
+    {
+        m_names.reserve(name_bytes);
+        m_name_ends.reserve(count);
+        m_lengths.reserve(count);
+        m_last_modified.reserve(count);
+        m_etags.reserve(count);
+        m_types.reserve(count);
+        m_content_md5s.reserve(count * md5_size);
+        m_has_content_md5.reserve(count);
+    }
+
+    void blob_inventory::append(const blob_inventory& other)
+    {
+        size_t offset = size();
+        uint64_t name_offset = m_names.size();
+
+        m_names.append(other.m_names);
+        for (auto iter = other.m_name_ends.cbegin(); iter != other.m_name_ends.cend(); ++iter)
+        {
+            m_name_ends.push_back(*iter + name_offset);
+        }
+
+        m_lengths.insert(m_lengths.end(), other.m_lengths.cbegin(), other.m_lengths.cend());
+        m_last_modified.insert(m_last_modified.end(), other.m_last_modified.cbegin(), other.m_last_modified.cend());
+        m_etags.insert(m_etags.end(), other.m_etags.cbegin(), other.m_etags.cend());
+        m_types.insert(m_types.end(), other.m_types.cbegin(), other.m_types.cend());
+        m_content_md5s.insert(m_content_md5s.end(), other.m_content_md5s.cbegin(), other.m_content_md5s.cend());
+        m_has_content_md5.insert(m_has_content_md5.end(), other.m_has_content_md5.cbegin(), other.m_has_content_md5.cend());
+
+        for (auto iter = other.m_irregular_etags.cbegin(); iter != other.m_irregular_etags.cend(); ++iter)
+        {
+            m_irregular_etags.insert(m_irregular_etags.end(), std::make_pair(iter->first + offset, iter->second));
+        }
+
+        for (auto iter = other.m_irregular_content_md5s.cbegin(); iter != other.m_irregular_content_md5s.cend(); ++iter)
+        {
+            m_irregular_content_md5s.insert(m_irregular_content_md5s.end(), std::make_pair(iter->first + offset, iter->second));
+        }
+
+        m_continuation_token = other.m_continuation_token;
+    }
+
+    void blob_inventory::clear()
+    {
+        blob_inventory empty;
+        *this = std::move(empty);
+    }
+
+    void blob_inventory::_add_blob(const utility::string_t& name, utility::size64_t length, const utility::datetime& last_modified, const utility::string_t& etag, blob_type type, const utility::string_t& content_md5)
+    {
+        size_t index = size();
+
+        m_names.append(to_utf8(name));
+        m_name_ends.push_back(m_names.size());
+        m_lengths.push_back(length);
+        m_last_modified.push_back(last_modified.is_initialized() ? last_modified.to_interval() : 0);
+        m_types.push_back(static_cast<uint8_t>(type));
+
+        uint64_t etag_value = parse_hexadecimal_etag(etag);
+        m_etags.push_back(etag_value);
+        if (etag_value == 0 && !etag.empty())
+        {
+            m_irregular_etags[index] = U('"') + etag + U('"');
+        }
+
+        std::vector<unsigned char> md5;
+        bool has_md5 = parse_content_md5(content_md5, md5);
+        m_has_content_md5.push_back(has_md5);
+        if (has_md5)
+        {
+            m_content_md5s.insert(m_content_md5s.end(), md5.cbegin(), md5.cend());
+        }
+        else
+        {
+            m_content_md5s.resize(m_content_md5s.size() + md5_size);
+            if (!content_md5.empty())
+            {
+                m_irregular_content_md5s[index] = content_md5;
+            }
+        }
+    }
+
+    blob_inventory_snapshot::blob_inventory_snapshot()
+        : m_size(0), m_names(nullptr), m_name_ends(nullptr), m_lengths(nullptr), m_last_modified(nullptr), m_etags(nullptr),
+        m_content_md5s(nullptr), m_types(nullptr), m_has_content_md5(nullptr)
+    {
+    }
+
+    void blob_inventory_snapshot::write(const utility::string_t& path, const blob_inventory& inventory)
+    {
+        size_t count = inventory.size();
+        std::vector<size_t> order(name_order(inventory));
+
+        std::vector<uint64_t> etag_indexes;
+        std::vector<uint64_t> etag_ends;
+        std::string etag_text;
+        std::vector<uint64_t> content_md5_indexes;
+        std::vector<uint64_t> content_md5_ends;
+        std::string content_md5_text;
+        if (!inventory.m_irregular_etags.empty() || !inventory.m_irregular_content_md5s.empty())
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto etag = inventory.m_irregular_etags.find(order[i]);
+                if (etag != inventory.m_irregular_etags.end())
+                {
+                    etag_text.append(to_utf8(etag->second));
+                    etag_indexes.push_back(i);
+                    etag_ends.push_back(etag_text.size());
+                }
+
+                auto content_md5 = inventory.m_irregular_content_md5s.find(order[i]);
+                if (content_md5 != inventory.m_irregular_content_md5s.end())
+                {
+                    content_md5_text.append(to_utf8(content_md5->second));
+                    content_md5_indexes.push_back(i);
+                    content_md5_ends.push_back(content_md5_text.size());
+                }
+            }
+        }
+
+        snapshot_header header;
+        std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+        header.version = snapshot_version;
+        header.reserved = 0;
+        header.count = count;
+        header.names_size = inventory.m_names.size();
+        header.irregular_etag_count = etag_indexes.size();
+        header.irregular_etag_text_size = etag_text.size();
+        header.irregular_content_md5_count = content_md5_indexes.size();
+        header.irregular_content_md5_text_size = content_md5_text.size();
+
+        snapshot_layout layout(header);
+        auto file = core::mapped_file::create(path, layout.total_size);
+        uint8_t* data = file->data();
+        std::memcpy(data, &header, sizeof(header));
+
+        uint64_t* name_ends = reinterpret_cast<uint64_t*>(data + layout.name_ends);
+        uint64_t* lengths = reinterpret_cast<uint64_t*>(data + layout.lengths);
+        uint64_t* last_modified = reinterpret_cast<uint64_t*>(data + layout.last_modified);
+        uint64_t* etags = reinterpret_cast<uint64_t*>(data + layout.etags);
+        uint8_t* content_md5s = data + layout.content_md5s;
+        uint8_t* types = data + layout.types;
+        uint8_t* has_content_md5 = data + layout.has_content_md5;
+        uint8_t* names = data + layout.names;
+
+        uint64_t name_end = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t source = order[i];
+            size_t name_size;
+            const char* name = inventory_name(inventory, source, name_size);
+            std::memcpy(names + name_end, name, name_size);
+            name_end += name_size;
+
+            name_ends[i] = name_end;
+            lengths[i] = inventory.m_lengths[source];
+            last_modified[i] = inventory.m_last_modified[source];
+            etags[i] = inventory.m_etags[source];
+            std::memcpy(content_md5s + i * md5_size, &inventory.m_content_md5s[source * md5_size], md5_size);
+            types[i] = inventory.m_types[source];
+            has_content_md5[i] = inventory.m_has_content_md5[source] ? 1 : 0;
+        }
+
+        if (!etag_indexes.empty())
+        {
+            std::memcpy(data + layout.irregular_etag_indexes, etag_indexes.data(), etag_indexes.size() * sizeof(uint64_t));
+            std::memcpy(data + layout.irregular_etag_ends, etag_ends.data(), etag_ends.size() * sizeof(uint64_t));
+            std::memcpy(data + layout.irregular_etag_text, etag_text.data(), etag_text.size());
+        }
+
+        if (!content_md5_indexes.empty())
+        {
+            std::memcpy(data + layout.irregular_content_md5_indexes, content_md5_indexes.data(), content_md5_indexes.size() * sizeof(uint64_t));
+            std::memcpy(data + layout.irregular_content_md5_ends, content_md5_ends.data(), content_md5_ends.size() * sizeof(uint64_t));
+            std::memcpy(data + layout.irregular_content_md5_text, content_md5_text.data(), content_md5_text.size());
+        }
+
+        file->flush();
+    }
+
+    blob_inventory_snapshot blob_inventory_snapshot::open(const utility::string_t& path)
+    {
+        auto file = core::mapped_file::open_read(path);
+        const uint8_t* data = file->data();
+        uint64_t file_size = file->size();
+
+        snapshot_header header;
+        if (file_size < sizeof(header))
+        {
+            throw_invalid_snapshot();
+        }
+
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0 || header.version != snapshot_version)
+        {
+            throw_invalid_snapshot();
+        }
+
+        // Every count is bounded by the file size before the layout is computed, so that the offsets cannot overflow
+        if (header.count > file_size || header.names_size > file_size || header.irregular_etag_count > file_size || header.irregular_etag_text_size > file_size ||
+            header.irregular_content_md5_count > file_size || header.irregular_content_md5_text_size > file_size)
+        {
+            throw_invalid_snapshot();
+        }
+
+        snapshot_layout layout(header);
+        if (layout.total_size != file_size)
+        {
+            throw_invalid_snapshot();
+        }
+
+        blob_inventory_snapshot result;
+        result.m_file = file;
+        result.m_size = static_cast<size_t>(header.count);
+        result.m_names = reinterpret_cast<const char*>(data + layout.names);
+        result.m_name_ends = reinterpret_cast<const uint64_t*>(data + layout.name_ends);
+        result.m_lengths = reinterpret_cast<const uint64_t*>(data + layout.lengths);
+        result.m_last_modified = reinterpret_cast<const uint64_t*>(data + layout.last_modified);
+        result.m_etags = reinterpret_cast<const uint64_t*>(data + layout.etags);
+        result.m_content_md5s = data + layout.content_md5s;
+        result.m_types = data + layout.types;
+        result.m_has_content_md5 = data + layout.has_content_md5;
+
+        result.m_irregular_etags.indexes = reinterpret_cast<const uint64_t*>(data + layout.irregular_etag_indexes);
+        result.m_irregular_etags.ends = reinterpret_cast<const uint64_t*>(data + layout.irregular_etag_ends);
+        result.m_irregular_etags.text = reinterpret_cast<const char*>(data + layout.irregular_etag_text);
+        result.m_irregular_etags.count = static_cast<size_t>(header.irregular_etag_count);
+
+        result.m_irregular_content_md5s.indexes = reinterpret_cast<const uint64_t*>(data + layout.irregular_content_md5_indexes);
+        result.m_irregular_content_md5s.ends = reinterpret_cast<const uint64_t*>(data + layout.irregular_content_md5_ends);
+        result.m_irregular_content_md5s.text = reinterpret_cast<const char*>(data + layout.irregular_content_md5_text);
+        result.m_irregular_content_md5s.count = static_cast<size_t>(header.irregular_content_md5_count);
+
+        // A name or a text that ends past its column would be read out of the mapping. The columns are not checked
+        // entry by entry, so that opening takes the same time whatever the number of blobs.
+        if ((result.m_size > 0 && result.m_name_ends[result.m_size - 1] != header.names_size) ||
+            (result.m_irregular_etags.count > 0 && result.m_irregular_etags.ends[result.m_irregular_etags.count - 1] != header.irregular_etag_text_size) ||
+            (result.m_irregular_content_md5s.count > 0 && result.m_irregular_content_md5s.ends[result.m_irregular_content_md5s.count - 1] != header.irregular_content_md5_text_size))
+        {
+            throw_invalid_snapshot();
+        }
+
+        return result;
+    }
+
+    const char* blob_inventory_snapshot::inventory_name(const blob_inventory& inventory, size_t index, size_t& size)
+    {
+        size_t begin = index == 0 ? 0 : static_cast<size_t>(inventory.m_name_ends[index - 1]);
+        size = static_cast<size_t>(inventory.m_name_ends[index]) - begin;
+        return inventory.m_names.data() + begin;
+    }
+
+    std::vector<size_t> blob_inventory_snapshot::name_order(const blob_inventory& inventory)
+    {
+        std::vector<size_t> order(inventory.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+
+        auto name_less = [&inventory] (size_t left, size_t right) -> bool
+        {
+            size_t left_size;
+            size_t right_size;
+            const char* left_name = inventory_name(inventory, left, left_size);
+            const char* right_name = inventory_name(inventory, right, right_size);
+            return compare_names(left_name, left_size, right_name, right_size) < 0;
+        };
+
+        // A listing is already in name order, so sorting is rarely needed
+        if (!std::is_sorted(order.cbegin(), order.cend(), name_less))
+        {
+            std::stable_sort(order.begin(), order.end(), name_less);
+        }
+
+        return order;
+    }
+
+    std::string blob_inventory_snapshot::find_text(const text_column& column, size_t index)
+    {
+        auto position = std::lower_bound(column.indexes, column.indexes + column.count, static_cast<uint64_t>(index));
+        if (position == column.indexes + column.count || *position != index)
+        {
+            return std::string();
+        }
+
+        size_t item = position - column.indexes;
+        size_t begin = item == 0 ? 0 : static_cast<size_t>(column.ends[item - 1]);
+        return std::string(column.text + begin, static_cast<size_t>(column.ends[item]) - begin);
+    }
+
+    utility::string_t blob_inventory_snapshot::etag(size_t index) const
+    {
+        uint64_t value = m_etags[index];
+        return value != 0 ? format_hexadecimal_etag(value) : utility::conversions::to_string_t(find_text(m_irregular_etags, index));
+    }
+
+    utility::string_t blob_inventory_snapshot::content_md5(size_t index) const
+    {
+        if (!m_has_content_md5[index])
+        {
+            return utility::conversions::to_string_t(find_text(m_irregular_content_md5s, index));
+        }
+
+        const uint8_t* begin = m_content_md5s + index * md5_size;
+        return utility::conversions::to_base64(std::vector<unsigned char>(begin, begin + md5_size));
+    }
+
+    bool blob_inventory_snapshot::find(const utility::string_t& name, size_t& index) const
+    {
+        std::string key(to_utf8(name));
+
+        size_t first = 0;
+        size_t last = m_size;
+        while (first < last)
+        {
+            size_t middle = first + (last - first) / 2;
+            size_t begin = middle == 0 ? 0 : static_cast<size_t>(m_name_ends[middle - 1]);
+            int result = compare_names(m_names + begin, static_cast<size_t>(m_name_ends[middle]) - begin, key.data(), key.size());
+            if (result == 0)
+            {
+                index = middle;
+                return true;
+            }
+
+            if (result < 0)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+
+        return false;
+    }
+
+    blob_inventory_diff blob_inventory_snapshot::diff(const blob_inventory& current) const
+    {
+        size_t count = current.size();
+        std::vector<size_t> order(name_order(current));
+
+        std::vector<size_t> added;
+        std::vector<size_t> changed;
+        std::vector<size_t> removed;
+
+        size_t i = 0;
+        size_t j = 0;
+        while (i < m_size && j < count)
+        {
+            size_t begin = i == 0 ? 0 : static_cast<size_t>(m_name_ends[i - 1]);
+            size_t current_size;
+            const char* name = inventory_name(current, order[j], current_size);
+            int result = compare_names(m_names + begin, static_cast<size_t>(m_name_ends[i]) - begin, name, current_size);
+            if (result < 0)
+            {
+                removed.push_back(i++);
+                continue;
+            }
+
+            if (result > 0)
+            {
+                added.push_back(order[j++]);
+                continue;
+            }
+
+            // An ETag kept in binary is never equal to one kept as text
+            uint64_t snapshot_etag = m_etags[i];
+            uint64_t current_etag = current.m_etags[order[j]];
+            bool is_changed = snapshot_etag != current_etag;
+            if (!is_changed && snapshot_etag == 0)
+            {
+                auto irregular = current.m_irregular_etags.find(order[j]);
+                is_changed = find_text(m_irregular_etags, i) != (irregular != current.m_irregular_etags.end() ? to_utf8(irregular->second) : std::string());
+            }
+
+            if (is_changed)
+            {
+                changed.push_back(order[j]);
+            }
+
+            ++i;
+            ++j;
+        }
+
+        for (; i < m_size; ++i)
+        {
+            removed.push_back(i);
+        }
+
+        for (; j < count; ++j)
+        {
+            added.push_back(order[j]);
+        }
+
+        return blob_inventory_diff(std::move(added), std::move(changed), std::move(removed));
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,411 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_lease_keeper.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <unordered_map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    struct blob_lease_keeper::shared_state
+    {
+        typedef std::function<pplx::task<void> (const access_condition&, const blob_request_options&, operation_context)> lease_action;
+
+        struct tracked_lease
+        {
+            utility::string_t lease_id;
+            lease_time duration;
+            lease_action renew;
+            lease_action release;
+            std::function<void (std::exception_ptr)> lost_handler;
+
+            // Tells apart the wheel entries of a lease that was released and tracked again
+            uint64_t generation;
+
+            std::chrono::steady_clock::time_point expiry_time;
+            pplx::task<void> renewal_task;
+        };
+
+        struct wheel_entry
+        {
+            utility::string_t key;
+            uint64_t generation;
+            uint64_t due_tick;
+        };
+
+        struct due_renewal
+        {
+            utility::string_t key;
+            uint64_t generation;
+            utility::string_t lease_id;
+            lease_time duration;
+            lease_action renew;
+            pplx::task_completion_event<void> renewal_event;
+        };
+
+        shared_state(const blob_request_options& options, operation_context context)
+            : options(options), context(context), wheel(protocol::lease_keeper_wheel_size), start_time(std::chrono::steady_clock::now()), processed_tick(0),
+            next_generation(0), is_timer_running(false), is_stopped(false), renewals(protocol::default_max_concurrent_lease_renewals)
+        {
+        }
+
+        static utility::string_t get_key(const storage_uri& uri)
+        {
+            return uri.primary_uri().to_string();
+        }
+
+        uint64_t get_tick(std::chrono::steady_clock::time_point time) const
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time - start_time).count() / protocol::lease_keeper_tick_interval.count());
+        }
+
+        // Must be called with the mutex held
+        void schedule(const utility::string_t& key, uint64_t generation, std::chrono::steady_clock::time_point renewal_time)
+        {
+            wheel_entry entry;
+            entry.key = key;
+            entry.generation = generation;
+            entry.due_tick = renewal_time > start_time ? std::max(get_tick(renewal_time), processed_tick + 1) : processed_tick + 1;
+            wheel[entry.due_tick % wheel.size()].push_back(std::move(entry));
+        }
+
+        // Must be called with the mutex held, and schedules the first renewal of a lease
+        void add(const utility::string_t& key, tracked_lease lease)
+        {
+            auto now = std::chrono::steady_clock::now();
+            lease.generation = ++next_generation;
+            lease.expiry_time = now + lease.duration.seconds();
+            lease.renewal_task = pplx::task_from_result();
+
+            // The lease was acquired or last renewed before it was tracked, so it is renewed when a third of its lease time is left from now
+            if (lease.duration.seconds().count() > 0)
+            {
+                schedule(key, lease.generation, now + lease.duration.seconds() - lease.duration.seconds() / 3);
+            }
+
+            leases[key] = std::move(lease);
+        }
+
+        // Must be called with the mutex held, and returns true if the caller has to start the timer
+        bool should_start_timer()
+        {
+            if (is_timer_running || is_stopped || leases.empty())
+            {
+                return false;
+            }
+
+            is_timer_running = true;
+            return true;
+        }
+
+        static void run_timer(std::shared_ptr<shared_state> state)
+        {
+            pplx::details::do_while([state] () -> pplx::task<bool>
+            {
+                return core::complete_after(protocol::lease_keeper_tick_interval).then([state] () -> bool
+                {
+                    std::vector<due_renewal> due_renewals;
+                    bool keep_running;
+
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        uint64_t current_tick = state->get_tick(std::chrono::steady_clock::now());
+
+                        // A timer that fell behind processes every slot it missed, and one pass over the wheel visits all of them
+                        uint64_t last_tick = std::min(current_tick, state->processed_tick + state->wheel.size());
+                        for (uint64_t tick = state->processed_tick + 1; tick <= last_tick; ++tick)
+                        {
+                            std::vector<wheel_entry>& slot = state->wheel[tick % state->wheel.size()];
+                            for (size_t i = 0; i < slot.size();)
+                            {
+                                if (slot[i].due_tick > current_tick)
+                                {
+                                    ++i;
+                                    continue;
+                                }
+
+                                state->take_due_renewal(slot[i], due_renewals);
+                                slot[i] = std::move(slot.back());
+                                slot.pop_back();
+                            }
+                        }
+
+                        state->processed_tick = std::max(state->processed_tick, current_tick);
+                        keep_running = !state->is_stopped && !state->leases.empty();
+                        state->is_timer_running = keep_running;
+                    }
+
+                    for (auto iter = due_renewals.begin(); iter != due_renewals.end(); ++iter)
+                    {
+                        renew_async(state, *iter);
+                    }
+
+                    return keep_running;
+                });
+            }).then([] (bool)
+            {
+            });
+        }
+
+        // Must be called with the mutex held
+        void take_due_renewal(const wheel_entry& entry, std::vector<due_renewal>& due_renewals)
+        {
+            // Entries of leases that have been released since are skipped rather than searched for when the lease is released
+            auto iter = leases.find(entry.key);
+            if (iter == leases.end() || iter->second.generation != entry.generation)
+            {
+                return;
+            }
+
+            due_renewal renewal;
+            renewal.key = entry.key;
+            renewal.generation = entry.generation;
+            renewal.lease_id = iter->second.lease_id;
+            renewal.duration = iter->second.duration;
+            renewal.renew = iter->second.renew;
+            iter->second.renewal_task = pplx::create_task(renewal.renewal_event);
+            due_renewals.push_back(std::move(renewal));
+        }
+
+        static void renew_async(std::shared_ptr<shared_state> state, const due_renewal& renewal)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            state->renewals.lock_async().then([state, renewal] () -> pplx::task<void>
+            {
+                return renewal.renew(access_condition::generate_lease_condition(renewal.lease_id), state->options, state->context);
+            }).then([state, renewal, start_time] (pplx::task<void> renewed_task)
+            {
+                state->renewals.unlock();
+
+                std::exception_ptr error;
+                bool is_rejected = false;
+                try
+                {
+                    renewed_task.wait();
+                }
+                catch (const storage_exception& e)
+                {
+                    // A client error other than a timeout means the lease is no longer held, for example because it has been broken
+                    auto status_code = e.result().http_status_code();
+                    is_rejected = e.result().is_response_available() && (status_code >= 400) && (status_code < 500) && (status_code != web::http::status_codes::RequestTimeout);
+                    error = std::current_exception();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                std::function<void (std::exception_ptr)> lost_handler;
+                bool is_lost = false;
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    auto iter = state->leases.find(renewal.key);
+                    if (iter != state->leases.end() && iter->second.generation == renewal.generation)
+                    {
+                        auto now = std::chrono::steady_clock::now();
+                        if (error == nullptr)
+                        {
+                            // The service started the new lease time after the request was sent, so measuring from then is on the safe side
+                            iter->second.expiry_time = start_time + renewal.duration.seconds();
+                            state->schedule(renewal.key, renewal.generation, iter->second.expiry_time - renewal.duration.seconds() / 3);
+                        }
+                        else if (!is_rejected && (now + protocol::lease_keeper_tick_interval < iter->second.expiry_time))
+                        {
+                            state->schedule(renewal.key, renewal.generation, now);
+                        }
+                        else
+                        {
+                            lost_handler = iter->second.lost_handler;
+                            state->leases.erase(iter);
+                            is_lost = true;
+                        }
+                    }
+                }
+
+                renewal.renewal_event.set();
+
+                if (is_lost && lost_handler)
+                {
+                    try
+                    {
+                        lost_handler(error);
+                    }
+                    catch (...)
+                    {
+                        // The handler runs on the timer, which has no caller to report its errors to
+                    }
+                }
+            });
+        }
+
+        blob_request_options options;
+        operation_context context;
+
+        std::unordered_map<utility::string_t, tracked_lease> leases;
+        std::vector<std::vector<wheel_entry>> wheel;
+        std::chrono::steady_clock::time_point start_time;
+        uint64_t processed_tick;
+        uint64_t next_generation;
+        bool is_timer_running;
+        bool is_stopped;
+        core::async_semaphore renewals;
+        mutable std::mutex mutex;
+    };
+
+    void blob_lease_keeper::initialize(const blob_request_options& options, operation_context context)
+    {
+        m_state = std::make_shared<shared_state>(options, context);
+    }
+
+    blob_lease_keeper::~blob_lease_keeper()
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->is_stopped = true;
+        m_state->leases.clear();
+    }
+
+    void blob_lease_keeper::track(const cloud_blob& blob, const utility::string_t& lease_id, const lease_time& duration, std::function<void (std::exception_ptr)> lost_handler)
+    {
+        if (lease_id.empty())
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_lease_keeper_empty_lease_id));
+        }
+
+        shared_state::tracked_lease lease;
+        lease.lease_id = lease_id;
+        lease.duration = duration;
+        lease.renew = [blob] (const access_condition& condition, const blob_request_options& options, operation_context context) -> pplx::task<void>
+        {
+            return blob.renew_lease_async(condition, options, context);
+        };
+        lease.release = [blob] (const access_condition& condition, const blob_request_options& options, operation_context context) -> pplx::task<void>
+        {
+            return blob.release_lease_async(condition, options, context);
+        };
+        lease.lost_handler = std::move(lost_handler);
+
+        bool start_timer;
+
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            m_state->add(shared_state::get_key(blob.uri()), std::move(lease));
+            start_timer = m_state->should_start_timer();
+        }
+
+        if (start_timer)
+        {
+            shared_state::run_timer(m_state);
+        }
+    }
+
+    void blob_lease_keeper::track(const cloud_blob_container& container, const utility::string_t& lease_id, const lease_time& duration, std::function<void (std::exception_ptr)> lost_handler)
+    {
+        if (lease_id.empty())
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_lease_keeper_empty_lease_id));
+        }
+
+        shared_state::tracked_lease lease;
+        lease.lease_id = lease_id;
+        lease.duration = duration;
+        lease.renew = [container] (const access_condition& condition, const blob_request_options& options, operation_context context) -> pplx::task<void>
+        {
+            return container.renew_lease_async(condition, options, context);
+        };
+        lease.release = [container] (const access_condition& condition, const blob_request_options& options, operation_context context) -> pplx::task<void>
+        {
+            return container.release_lease_async(condition, options, context);
+        };
+        lease.lost_handler = std::move(lost_handler);
+
+        bool start_timer;
+
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            m_state->add(shared_state::get_key(container.uri()), std::move(lease));
+            start_timer = m_state->should_start_timer();
+        }
+
+        if (start_timer)
+        {
+            shared_state::run_timer(m_state);
+        }
+    }
+
+    void blob_lease_keeper::release(const storage_uri& uri)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->leases.erase(shared_state::get_key(uri));
+    }
+
+    bool blob_lease_keeper::is_tracked(const storage_uri& uri) const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->leases.find(shared_state::get_key(uri)) != m_state->leases.end();
+    }
+
+    size_t blob_lease_keeper::tracked_count() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->leases.size();
+    }
+
+    access_condition blob_lease_keeper::get_access_condition(const storage_uri& uri) const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        auto iter = m_state->leases.find(shared_state::get_key(uri));
+        if (iter == m_state->leases.end())
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_lease_keeper_untracked_lease));
+        }
+
+        return access_condition::generate_lease_condition(iter->second.lease_id);
+    }
+
+    pplx::task<void> blob_lease_keeper::release_lease_async(const storage_uri& uri)
+    {
+        utility::string_t lease_id;
+        shared_state::lease_action release_action;
+        pplx::task<void> renewal_task;
+
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            auto iter = m_state->leases.find(shared_state::get_key(uri));
+            if (iter == m_state->leases.end())
+            {
+                throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_lease_keeper_untracked_lease));
+            }
+
+            lease_id = iter->second.lease_id;
+            release_action = iter->second.release;
+            renewal_task = iter->second.renewal_task;
+            m_state->leases.erase(iter);
+        }
+
+        auto state = m_state;
+        return renewal_task.then([state, lease_id, release_action] () -> pplx::task<void>
+        {
+            return release_action(access_condition::generate_lease_condition(lease_id), state->options, state->context);
+        });
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,210 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_listing_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/blob_listing_cache.h"
+#include "wascore/util.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        // Cached blobs and callers' blobs must not share their attributes, so that changing one does not change the other
+        blob_result_segment copy_segment(const blob_result_segment& source, const cloud_blob_container& container)
+        {
+            std::vector<cloud_blob> blobs;
+            blobs.reserve(source.blobs().size());
+            for (auto iter = source.blobs().cbegin(); iter != source.blobs().cend(); ++iter)
+            {
+                blobs.push_back(cloud_blob(iter->name(), iter->snapshot_time(), container, iter->properties(), iter->metadata(), iter->copy_state()));
+            }
+
+            std::vector<cloud_blob_directory> directories;
+            directories.reserve(source.directories().size());
+            for (auto iter = source.directories().cbegin(); iter != source.directories().cend(); ++iter)
+            {
+                directories.push_back(cloud_blob_directory(iter->prefix(), container));
+            }
+
+            return blob_result_segment(std::move(blobs), std::move(directories), source.continuation_token());
+        }
+    }
+
+    blob_listing_cache_settings blob_listing_cache::settings() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings;
+    }
+
+    void blob_listing_cache::set_settings(const blob_listing_cache_settings& value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_settings = value;
+        m_entries.clear();
+        m_index.clear();
+        ++m_invalidations;
+    }
+
+    bool blob_listing_cache::is_enabled() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings.max_listings() > 0;
+    }
+
+    utility::string_t blob_listing_cache::get_key(const storage_uri& container_uri, const utility::string_t& prefix, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const continuation_token& token)
+    {
+        // A line break cannot be part of the container URI, and the prefix is preceded by its length,
+        // so that neither it nor the marker can be mistaken for another field
+        utility::string_t key(container_uri.primary_uri().to_string());
+        key.push_back(U('\n'));
+        key.push_back(includes.metadata() ? U('m') : U('-'));
+        key.push_back(includes.uncommitted_blobs() ? U('u') : U('-'));
+        key.push_back(includes.copy() ? U('c') : U('-'));
+        key.append(convert_to_string(max_results));
+        key.push_back(U('\n'));
+        key.append(delimiter);
+        key.push_back(U('\n'));
+        key.append(convert_to_string(static_cast<int>(prefix.size())));
+        key.push_back(U('\n'));
+        key.append(prefix);
+        key.append(token.next_marker());
+        return key;
+    }
+
+    uint64_t blob_listing_cache::begin_read() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_invalidations;
+    }
+
+    bool blob_listing_cache::is_fresh(const entry& value) const
+    {
+        return std::chrono::steady_clock::now() < value.expiry_time;
+    }
+
+    bool blob_listing_cache::try_get(const utility::string_t& key, const cloud_blob_container& container, blob_result_segment& segment)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_index.find(key);
+        if (iter == m_index.end())
+        {
+            return false;
+        }
+
+        if (!is_fresh(*iter->second))
+        {
+            m_entries.erase(iter->second);
+            m_index.erase(iter);
+            return false;
+        }
+
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        segment = copy_segment(iter->second->segment, container);
+        return true;
+    }
+
+    bool blob_listing_cache::contains(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_index.find(key);
+        return iter != m_index.end() && is_fresh(*iter->second);
+    }
+
+    void blob_listing_cache::put(const utility::string_t& key, const cloud_blob_container& container, const utility::string_t& prefix, const blob_result_segment& segment, uint64_t read_invalidations)
+    {
+        // The copy is made before taking the lock, since it may be large
+        blob_result_segment copy = copy_segment(segment, container);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        // A segment listed while a blob was written may not include the change, so it is not stored
+        if (m_settings.max_listings() == 0 || read_invalidations != m_invalidations)
+        {
+            return;
+        }
+
+        std::chrono::steady_clock::time_point expiry_time = std::chrono::steady_clock::now() + m_settings.time_to_live();
+
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            iter->second->segment = std::move(copy);
+            iter->second->expiry_time = expiry_time;
+            m_entries.splice(m_entries.begin(), m_entries, iter->second);
+            return;
+        }
+
+        entry value;
+        value.key = key;
+        value.container = container.uri().primary_uri().to_string();
+        value.prefix = prefix;
+        value.segment = std::move(copy);
+        value.expiry_time = expiry_time;
+        m_entries.push_front(std::move(value));
+        m_index[key] = m_entries.begin();
+
+        while (m_entries.size() > m_settings.max_listings())
+        {
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+        }
+    }
+
+    void blob_listing_cache::remove_blob(const storage_uri& container_uri, const utility::string_t& blob_name)
+    {
+        utility::string_t container(container_uri.primary_uri().to_string());
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        ++m_invalidations;
+
+        // The blob appears in every listing whose prefix it starts with, either by itself or within a directory
+        for (auto iter = m_entries.begin(); iter != m_entries.end();)
+        {
+            if (iter->container == container && blob_name.compare(0, iter->prefix.size(), iter->prefix) == 0)
+            {
+                m_index.erase(iter->key);
+                iter = m_entries.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    void blob_listing_cache::remove_container(const storage_uri& container_uri)
+    {
+        utility::string_t container(container_uri.primary_uri().to_string());
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        ++m_invalidations;
+
+        for (auto iter = m_entries.begin(); iter != m_entries.end();)
+        {
+            if (iter->container == container)
+            {
+                m_index.erase(iter->key);
+                iter = m_entries.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+}}} // namespace wa::storage::core
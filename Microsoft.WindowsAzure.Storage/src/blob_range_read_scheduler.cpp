@@ -0,0 +1,276 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_range_read_scheduler.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <algorithm>
+#include <map>
+
+#include "wascore/constants.h"
+#include "wascore/util.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    struct blob_range_read_scheduler::shared_state
+    {
+        struct pending_read
+        {
+            int64_t offset;
+            int64_t length;
+            concurrency::streams::ostream target;
+            pplx::task_completion_event<void> done;
+        };
+
+        // The reads of one blob and ETag that are waiting for the batching window to end
+        struct pending_batch
+        {
+            pending_batch(const cloud_blob& blob)
+                : blob(blob)
+            {
+            }
+
+            cloud_blob blob;
+            std::vector<pending_read> reads;
+        };
+
+        shared_state(const blob_request_options& options, operation_context context)
+            : options(options), context(context), max_gap(protocol::default_range_read_max_gap), max_merged_size(protocol::default_range_read_max_merged_size),
+            batching_window(protocol::default_range_read_window)
+        {
+        }
+
+        static bool compare_offsets(const pending_read& left, const pending_read& right)
+        {
+            return left.offset < right.offset;
+        }
+
+        static void dispatch(std::shared_ptr<shared_state> state, const utility::string_t& key)
+        {
+            std::shared_ptr<pending_batch> batch;
+            int64_t max_gap;
+            int64_t max_merged_size;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                auto iter = state->batches.find(key);
+                batch = iter->second;
+                state->batches.erase(iter);
+                max_gap = static_cast<int64_t>(state->max_gap);
+                max_merged_size = static_cast<int64_t>(state->max_merged_size);
+            }
+
+            auto& reads = batch->reads;
+            std::stable_sort(reads.begin(), reads.end(), compare_offsets);
+
+            // Each run of reads ends where the next read starts too far away, or would make the download too large
+            size_t first = 0;
+            while (first < reads.size())
+            {
+                auto start = reads[first].offset;
+                auto end = reads[first].offset + reads[first].length;
+                size_t last = first + 1;
+                while (last < reads.size())
+                {
+                    auto next_end = std::max(end, reads[last].offset + reads[last].length);
+                    if ((reads[last].offset > end + max_gap) || (next_end - start > max_merged_size))
+                    {
+                        break;
+                    }
+
+                    end = next_end;
+                    ++last;
+                }
+
+                download_run(state, batch->blob, std::vector<pending_read>(reads.begin() + first, reads.begin() + last), start, end - start);
+                first = last;
+            }
+        }
+
+        static void download_run(std::shared_ptr<shared_state> state, cloud_blob blob, std::vector<pending_read> reads, int64_t start, int64_t length)
+        {
+            auto condition = blob.properties().etag().empty() ? access_condition() : access_condition::generate_if_match_condition(blob.properties().etag());
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            pplx::task<void> download_task;
+            try
+            {
+                download_task = blob.download_range_to_stream_async(buffer.create_ostream(), start, length, condition, state->options, state->context);
+            }
+            catch (...)
+            {
+                download_task = pplx::task_from_exception<void>(std::current_exception());
+            }
+
+            download_task.then([reads, start, buffer] (pplx::task<void> completed_task) mutable
+            {
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                    auto error = std::current_exception();
+                    for (auto iter = reads.begin(); iter != reads.end(); ++iter)
+                    {
+                        iter->done.set_exception(error);
+                    }
+
+                    return;
+                }
+
+                // The bytes are shared by the writes to the targets of the reads, which may complete at any time
+                auto data = std::make_shared<std::vector<uint8_t>>(std::move(buffer.collection()));
+                for (auto iter = reads.begin(); iter != reads.end(); ++iter)
+                {
+                    auto done = iter->done;
+                    auto data_offset = static_cast<size_t>(std::min<int64_t>(iter->offset - start, static_cast<int64_t>(data->size())));
+                    auto count = std::min(static_cast<size_t>(iter->length), data->size() - data_offset);
+                    pplx::task<size_t> write_task;
+                    try
+                    {
+                        write_task = iter->target.streambuf().putn(data->data() + data_offset, count);
+                    }
+                    catch (...)
+                    {
+                        write_task = pplx::task_from_exception<size_t>(std::current_exception());
+                    }
+
+                    write_task.then([data, done] (pplx::task<size_t> completed_write)
+                    {
+                        try
+                        {
+                            completed_write.wait();
+                            done.set();
+                        }
+                        catch (...)
+                        {
+                            done.set_exception(std::current_exception());
+                        }
+                    });
+                }
+            });
+        }
+
+        blob_request_options options;
+        operation_context context;
+        size_t max_gap;
+        size_t max_merged_size;
+        std::chrono::milliseconds batching_window;
+        std::map<utility::string_t, std::shared_ptr<pending_batch>> batches;
+        mutable std::mutex mutex;
+    };
+
+    void blob_range_read_scheduler::initialize(const blob_request_options& options, operation_context context)
+    {
+        m_state = std::make_shared<shared_state>(options, context);
+    }
+
+    pplx::task<void> blob_range_read_scheduler::download_range_to_stream_async(const cloud_blob& blob, concurrency::streams::ostream target, int64_t offset, int64_t length)
+    {
+        if (offset < 0)
+        {
+            throw std::invalid_argument("offset");
+        }
+
+        if (length <= 0)
+        {
+            throw std::invalid_argument("length");
+        }
+
+        // Reads are only merged for the same version of the same blob
+        utility::ostringstream_t key_builder;
+        key_builder << blob.snapshot_qualified_uri().primary_uri().to_string() << U('\n') << blob.properties().etag();
+        auto key = key_builder.str();
+
+        shared_state::pending_read read;
+        read.offset = offset;
+        read.length = length;
+        read.target = target;
+
+        auto state = m_state;
+        bool is_first = false;
+        std::chrono::milliseconds window;
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            auto& batch = state->batches[key];
+            if (batch == nullptr)
+            {
+                batch = std::make_shared<shared_state::pending_batch>(blob);
+                is_first = true;
+                window = state->batching_window;
+            }
+
+            batch->reads.push_back(read);
+        }
+
+        if (is_first)
+        {
+            core::complete_after(window).then([state, key] ()
+            {
+                shared_state::dispatch(state, key);
+            });
+        }
+
+        return pplx::create_task(read.done);
+    }
+
+    size_t blob_range_read_scheduler::max_gap() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_gap;
+    }
+
+    void blob_range_read_scheduler::set_max_gap(size_t value)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_gap = value;
+    }
+
+    size_t blob_range_read_scheduler::max_merged_size() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_merged_size;
+    }
+
+    void blob_range_read_scheduler::set_max_merged_size(size_t value)
+    {
+        if (value == 0)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_merged_size = value;
+    }
+
+    std::chrono::milliseconds blob_range_read_scheduler::batching_window() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->batching_window;
+    }
+
+    void blob_range_read_scheduler::set_batching_window(std::chrono::milliseconds value)
+    {
+        if (value.count() < 0)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->batching_window = value;
+    }
+
+}} // namespace wa::storage
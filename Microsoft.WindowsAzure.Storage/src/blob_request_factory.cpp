@@ -19,6 +19,7 @@
 #include "wascore/protocol.h"
 #include "wascore/constants.h"
 #include "wascore/resources.h"
+#include "wascore/datetime_codec.h"
 
 namespace wa { namespace storage { namespace protocol {
 
@@ -249,12 +250,13 @@ namespace wa { namespace storage { namespace protocol {
         }
     }
 
-    web::http::http_request put_block(const utility::string_t& block_id, const utility::string_t& content_md5, const access_condition& condition, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
+    web::http::http_request put_block(const utility::string_t& block_id, const utility::string_t& content_md5, const utility::string_t& content_crc64, const access_condition& condition, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
     {
         uri_builder.append_query(uri_query_component, component_block);
         uri_builder.append_query(uri_query_block_id, block_id);
         web::http::http_request request(base_request(web::http::methods::PUT, uri_builder, timeout, context));
         request.headers().add(web::http::header_names::content_md5, content_md5);
+        add_optional_header(request.headers(), ms_header_content_crc64, content_crc64);
         add_lease_id(request, condition);
         return request;
     }
@@ -304,7 +306,18 @@ namespace wa { namespace storage { namespace protocol {
         return request;
     }
 
-    web::http::http_request put_page(page_range range, page_write write, const utility::string_t& content_md5, const access_condition& condition, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
+    web::http::http_request get_page_ranges_diff(const utility::string_t& snapshot_time, const utility::string_t& previous_snapshot_time, const access_condition& condition, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
+    {
+        add_snapshot_time(uri_builder, snapshot_time);
+        uri_builder.append_query(uri_query_component, component_page_list);
+        uri_builder.append_query(uri_query_previous_snapshot, previous_snapshot_time);
+        web::http::http_request request(base_request(web::http::methods::GET, uri_builder, timeout, context));
+        request.headers()[ms_header_version] = header_value_page_ranges_diff_storage_version;
+        add_access_condition(request, condition);
+        return request;
+    }
+
+    web::http::http_request put_page(page_range range, page_write write, const utility::string_t& content_md5, const utility::string_t& content_crc64, const access_condition& condition, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
     {
         uri_builder.append_query(uri_query_component, component_page);
         web::http::http_request request(base_request(web::http::methods::PUT, uri_builder, timeout, context));
@@ -312,6 +325,7 @@ namespace wa { namespace storage { namespace protocol {
         web::http::http_headers& headers = request.headers();
         headers.add(ms_header_range, range.to_string());
         headers.add(web::http::header_names::content_md5, content_md5);
+        add_optional_header(headers, ms_header_content_crc64, content_crc64);
 
         switch (write)
         {
@@ -352,7 +366,7 @@ namespace wa { namespace storage { namespace protocol {
         return request;
     }
 
-    web::http::http_request get_blob(int64_t offset, int64_t length, bool get_range_content_md5, const utility::string_t& snapshot_time, const access_condition& condition, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
+    web::http::http_request get_blob(int64_t offset, int64_t length, bool get_range_content_md5, bool get_range_content_crc64, const utility::string_t& snapshot_time, const access_condition& condition, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
     {
         add_snapshot_time(uri_builder, snapshot_time);
         web::http::http_request request(base_request(web::http::methods::GET, uri_builder, timeout, context));
@@ -363,6 +377,11 @@ namespace wa { namespace storage { namespace protocol {
             request.headers().add(ms_header_range_get_content_md5, header_value_true);
         }
 
+        if ((offset >= 0) && get_range_content_crc64)
+        {
+            request.headers().add(ms_header_range_get_content_crc64, header_value_true);
+        }
+
         add_access_condition(request, condition);
         return request;
     }
@@ -505,12 +524,12 @@ namespace wa { namespace storage { namespace protocol {
 
         if (condition.if_modified_since_time().is_initialized())
         {
-            headers.add(web::http::header_names::if_modified_since, condition.if_modified_since_time().to_string(utility::datetime::date_format::RFC_1123));
+            headers.add(web::http::header_names::if_modified_since, core::format_rfc1123_datetime(condition.if_modified_since_time()));
         }
 
         if (condition.if_not_modified_since_time().is_initialized())
         {
-            headers.add(web::http::header_names::if_unmodified_since, condition.if_not_modified_since_time().to_string(utility::datetime::date_format::RFC_1123));
+            headers.add(web::http::header_names::if_unmodified_since, core::format_rfc1123_datetime(condition.if_not_modified_since_time()));
         }
 
         add_lease_id(request, condition);
@@ -525,12 +544,12 @@ namespace wa { namespace storage { namespace protocol {
 
         if (condition.if_modified_since_time().is_initialized())
         {
-            headers.add(ms_header_source_if_modified_since, condition.if_modified_since_time().to_string(utility::datetime::date_format::RFC_1123));
+            headers.add(ms_header_source_if_modified_since, core::format_rfc1123_datetime(condition.if_modified_since_time()));
         }
 
         if (condition.if_not_modified_since_time().is_initialized())
         {
-            headers.add(ms_header_source_if_unmodified_since, condition.if_not_modified_since_time().to_string(utility::datetime::date_format::RFC_1123));
+            headers.add(ms_header_source_if_unmodified_since, core::format_rfc1123_datetime(condition.if_not_modified_since_time()));
         }
 
         if (!condition.lease_id().empty())
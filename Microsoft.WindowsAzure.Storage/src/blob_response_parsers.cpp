@@ -17,6 +17,7 @@
 
 #include "stdafx.h"
 #include "wascore/protocol.h"
+#include "wascore/datetime_codec.h"
 
 namespace wa { namespace storage { namespace protocol {
 
@@ -131,7 +132,7 @@ namespace wa { namespace storage { namespace protocol {
     {
         if (!value.empty())
         {
-            return utility::datetime::from_string(value, utility::datetime::date_format::RFC_1123);
+            return core::parse_rfc1123_datetime(value);
         }
         else
         {
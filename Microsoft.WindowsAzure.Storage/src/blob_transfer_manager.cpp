@@ -0,0 +1,1008 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="blob_transfer_manager.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <deque>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "cpprest/filestream.h"
+
+#include "wascore/async_semaphore.h"
+#include "wascore/blobstreams.h"
+#include "wascore/hash_software.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    struct blob_directory_transfer_manager::shared_state
+    {
+        struct transfer_file
+        {
+            transfer_file(utility::string_t name, utility::string_t local_path, cloud_blob blob, utility::size64_t size, size_t chunk_count)
+                : name(std::move(name)), local_path(std::move(local_path)), blob(std::move(blob)), size(size), chunk_count(chunk_count), next_chunk(0), remaining_chunks(chunk_count)
+            {
+            }
+
+            utility::string_t name;
+            utility::string_t local_path;
+            cloud_blob blob;
+            utility::size64_t size;
+            size_t chunk_count;
+
+            // Only used by the dispatcher
+            size_t next_chunk;
+            core::block_id_sequence block_ids;
+            std::shared_ptr<core::mapped_file> file;
+
+            // Guarded by the mutex of the shared state
+            size_t remaining_chunks;
+            std::exception_ptr error;
+        };
+
+        // The MD5 hash of a local file, which stays valid for as long as the file keeps its size and last write time
+        struct cached_hash
+        {
+            cached_hash()
+                : size(0)
+            {
+            }
+
+            cached_hash(utility::size64_t size, utility::datetime last_write_time)
+                : size(size), last_write_time(last_write_time)
+            {
+            }
+
+            utility::size64_t size;
+            utility::datetime last_write_time;
+            utility::string_t content_md5;
+        };
+
+        shared_state(const blob_directory_transfer_manager& manager, const utility::string_t& local_directory, bool is_upload, bool is_sync)
+            : directory(manager.m_directory), options(manager.m_options), context(manager.m_context), local_directory(local_directory), is_upload(is_upload),
+            is_sync(is_sync), delete_extraneous(manager.m_delete_extraneous), chunk_size(manager.m_chunk_size), checkpoint_path(manager.m_checkpoint_path),
+            hash_cache_path(manager.m_hash_cache_path), max_active_chunked_files(static_cast<size_t>(manager.m_max_concurrent_transfers)),
+            transfer_slots(manager.m_max_concurrent_transfers), next_from_chunked_files(false), checkpoint_task(pplx::task_from_result())
+        {
+            options.apply_defaults(directory.container().service_client().default_request_options(), blob_type::block_blob);
+
+            while (!this->local_directory.empty() && ((this->local_directory.back() == U('\\')) || (this->local_directory.back() == U('/'))))
+            {
+                this->local_directory.pop_back();
+            }
+        }
+
+        static pplx::task<std::vector<blob_transfer_failure>> run_async(std::shared_ptr<shared_state> state)
+        {
+            return read_checkpoint_async(state->checkpoint_path).then([state] (std::set<utility::string_t> transferred) -> pplx::task<void>
+            {
+                if (state->is_sync)
+                {
+                    return find_changes_async(state, std::make_shared<std::set<utility::string_t>>(std::move(transferred)));
+                }
+
+                if (state->is_upload)
+                {
+                    find_local_files(state, transferred);
+                    return pplx::task_from_result();
+                }
+
+                return find_blobs_async(state, std::make_shared<std::set<utility::string_t>>(std::move(transferred)), blob_continuation_token());
+            }).then([state] () -> pplx::task<void>
+            {
+                if (state->checkpoint_path.empty())
+                {
+                    return pplx::task_from_result();
+                }
+
+                return concurrency::streams::fstream::open_ostream(state->checkpoint_path, std::ios::out | std::ios::app).then([state] (concurrency::streams::ostream checkpoint)
+                {
+                    state->checkpoint = checkpoint;
+                });
+            }).then([state] () -> pplx::task<void>
+            {
+                return dispatch_async(state);
+            }).then([state] (pplx::task<void> dispatch_task) -> pplx::task<void>
+            {
+                // Transfers that are still running are waited for even if the listing failed
+                return state->transfer_slots.wait_all_async().then([dispatch_task] ()
+                {
+                    dispatch_task.wait();
+                });
+            }).then([state] (pplx::task<void> transfer_task) -> pplx::task<void>
+            {
+                if (!state->is_sync)
+                {
+                    return transfer_task;
+                }
+
+                // Nothing is deleted unless both sides have been listed completely
+                return transfer_task.then([state] () -> pplx::task<void>
+                {
+                    return finish_sync_async(state);
+                });
+            }).then([state] (pplx::task<void> transfer_task) -> pplx::task<void>
+            {
+                if (!state->checkpoint.is_valid())
+                {
+                    return transfer_task;
+                }
+
+                pplx::task<void> checkpoint_task;
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    checkpoint_task = state->checkpoint_task;
+                }
+
+                auto checkpoint = state->checkpoint;
+                return checkpoint_task.then([checkpoint, transfer_task] (pplx::task<void> write_task) mutable -> pplx::task<void>
+                {
+                    return checkpoint.close().then([transfer_task, write_task] ()
+                    {
+                        transfer_task.wait();
+                        write_task.wait();
+                    });
+                });
+            }).then([state] () -> std::vector<blob_transfer_failure>
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                return std::move(state->failures);
+            });
+        }
+
+        // Returns the names of the files that a previous run has recorded as transferred
+        static pplx::task<std::set<utility::string_t>> read_checkpoint_async(const utility::string_t& checkpoint_path)
+        {
+            if (checkpoint_path.empty())
+            {
+                return pplx::task_from_result(std::set<utility::string_t>());
+            }
+
+            return concurrency::streams::fstream::open_istream(checkpoint_path).then([] (pplx::task<concurrency::streams::istream> open_task) -> pplx::task<std::set<utility::string_t>>
+            {
+                concurrency::streams::istream checkpoint;
+                try
+                {
+                    checkpoint = open_task.get();
+                }
+                catch (...)
+                {
+                    // There is no checkpoint yet, and an unreadable one is reported when it is opened for writing
+                    return pplx::task_from_result(std::set<utility::string_t>());
+                }
+
+                concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                return checkpoint.read_to_end(buffer).then([checkpoint, buffer] (size_t) mutable -> std::set<utility::string_t>
+                {
+                    checkpoint.close().wait();
+
+                    std::set<utility::string_t> transferred;
+                    const std::vector<uint8_t>& text = buffer.collection();
+                    auto line_begin = text.begin();
+                    for (auto iter = text.begin(); iter != text.end(); ++iter)
+                    {
+                        // A line without its line break was cut short by an interrupted run
+                        if (*iter == '\n')
+                        {
+                            if (iter != line_begin)
+                            {
+                                transferred.insert(utility::conversions::to_string_t(std::string(line_begin, iter)));
+                            }
+
+                            line_begin = iter + 1;
+                        }
+                    }
+
+                    return transferred;
+                });
+            });
+        }
+
+        static void find_local_files(std::shared_ptr<shared_state> state, const std::set<utility::string_t>& transferred)
+        {
+            auto files = core::list_local_files(state->local_directory);
+            for (auto iter = files.begin(); iter != files.end(); ++iter)
+            {
+                auto name = get_blob_name(state, iter->path);
+                if (transferred.find(name) == transferred.end())
+                {
+                    cloud_blob blob(state->directory.get_block_blob_reference(name));
+                    add_file(state, std::move(name), state->local_directory + U("\\") + iter->path, std::move(blob), iter->size);
+                }
+            }
+        }
+
+        static pplx::task<void> find_blobs_async(std::shared_ptr<shared_state> state, std::shared_ptr<std::set<utility::string_t>> transferred, blob_continuation_token token)
+        {
+            return state->directory.list_blobs_segmented_async(true, blob_listing_includes(), 0, token, state->options, state->context).then([state, transferred] (blob_result_segment segment) -> pplx::task<void>
+            {
+                const utility::string_t& prefix = state->directory.prefix();
+                const std::vector<cloud_blob>& blobs = segment.blobs();
+                for (auto iter = blobs.cbegin(); iter != blobs.cend(); ++iter)
+                {
+                    utility::string_t name(iter->name().substr(prefix.size()));
+                    if (transferred->find(name) != transferred->end())
+                    {
+                        continue;
+                    }
+
+                    auto local_path = get_local_path(state, name);
+                    add_file(state, std::move(name), std::move(local_path), *iter, iter->properties().size());
+                }
+
+                if (segment.continuation_token().empty())
+                {
+                    return pplx::task_from_result();
+                }
+
+                return find_blobs_async(state, transferred, segment.continuation_token());
+            });
+        }
+
+        // Converts the path of a file relative to the local directory to the name of its blob relative to the virtual directory
+        static utility::string_t get_blob_name(std::shared_ptr<shared_state> state, const utility::string_t& relative_path)
+        {
+            const utility::string_t& delimiter = state->directory.container().service_client().directory_delimiter();
+            utility::string_t name;
+            for (auto iter = relative_path.cbegin(); iter != relative_path.cend(); ++iter)
+            {
+                if (*iter == U('\\'))
+                {
+                    name.append(delimiter);
+                }
+                else
+                {
+                    name.push_back(*iter);
+                }
+            }
+
+            return name;
+        }
+
+        // Converts the name of a blob relative to the virtual directory to the full path of its local file
+        static utility::string_t get_local_path(std::shared_ptr<shared_state> state, const utility::string_t& name)
+        {
+            const utility::string_t& delimiter = state->directory.container().service_client().directory_delimiter();
+            utility::string_t local_path(state->local_directory);
+            local_path.push_back(U('\\'));
+            for (size_t position = 0; position < name.size(); )
+            {
+                if (name.compare(position, delimiter.size(), delimiter) == 0)
+                {
+                    local_path.push_back(U('\\'));
+                    position += delimiter.size();
+                }
+                else
+                {
+                    local_path.push_back(name[position++]);
+                }
+            }
+
+            return local_path;
+        }
+
+        // Returns the hashes that the previous sync has recorded, by the names of the blobs of their files
+        static pplx::task<std::map<utility::string_t, cached_hash>> read_hash_cache_async(const utility::string_t& hash_cache_path)
+        {
+            if (hash_cache_path.empty())
+            {
+                return pplx::task_from_result(std::map<utility::string_t, cached_hash>());
+            }
+
+            return concurrency::streams::fstream::open_istream(hash_cache_path).then([] (pplx::task<concurrency::streams::istream> open_task) -> pplx::task<std::map<utility::string_t, cached_hash>>
+            {
+                concurrency::streams::istream cache;
+                try
+                {
+                    cache = open_task.get();
+                }
+                catch (...)
+                {
+                    // There is no cache yet, and an unwritable one is reported when the sync writes it
+                    return pplx::task_from_result(std::map<utility::string_t, cached_hash>());
+                }
+
+                concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                return cache.read_to_end(buffer).then([cache, buffer] (size_t) mutable -> std::map<utility::string_t, cached_hash>
+                {
+                    cache.close().wait();
+
+                    // Each line holds the size, the last write time, the MD5 hash and the blob name of a file. Lines that cannot be read are ignored,
+                    // which only means that their files are hashed again.
+                    std::map<utility::string_t, cached_hash> hashes;
+                    std::istringstream text(std::string(buffer.collection().begin(), buffer.collection().end()));
+                    std::string line;
+                    while (std::getline(text, line))
+                    {
+                        std::istringstream fields(line);
+                        utility::size64_t size;
+                        utility::datetime::interval_type last_write_time;
+                        std::string content_md5;
+                        std::string name;
+                        if ((fields >> size >> last_write_time >> content_md5) && (fields.get() == ' ') && std::getline(fields, name) && !name.empty())
+                        {
+                            cached_hash hash(size, utility::datetime() + last_write_time);
+                            hash.content_md5 = utility::conversions::to_string_t(content_md5);
+                            hashes[utility::conversions::to_string_t(name)] = hash;
+                        }
+                    }
+
+                    return hashes;
+                });
+            });
+        }
+
+        // Lists both sides of a sync, hashes the local files that need a hash and have none cached, and adds the files that differ
+        static pplx::task<void> find_changes_async(std::shared_ptr<shared_state> state, std::shared_ptr<std::set<utility::string_t>> transferred)
+        {
+            if (!state->is_upload)
+            {
+                core::create_local_directories(state->local_directory);
+            }
+
+            auto local_files = std::make_shared<std::vector<core::local_file_entry>>(core::list_local_files(state->local_directory));
+            auto blobs = std::make_shared<std::map<utility::string_t, cloud_blob>>();
+            auto cached_hashes = std::make_shared<std::map<utility::string_t, cached_hash>>();
+            return read_hash_cache_async(state->hash_cache_path).then([state, blobs, cached_hashes] (std::map<utility::string_t, cached_hash> hashes) -> pplx::task<void>
+            {
+                *cached_hashes = std::move(hashes);
+                return list_blobs_async(state, blobs, blob_continuation_token());
+            }).then([state, local_files, blobs, cached_hashes] () -> pplx::task<void>
+            {
+                return hash_local_files_async(state, *local_files, *blobs, *cached_hashes);
+            }).then([state, local_files, blobs, transferred] ()
+            {
+                add_changed_files(state, *local_files, *blobs, *transferred);
+            });
+        }
+
+        static pplx::task<void> list_blobs_async(std::shared_ptr<shared_state> state, std::shared_ptr<std::map<utility::string_t, cloud_blob>> blobs, blob_continuation_token token)
+        {
+            return state->directory.list_blobs_segmented_async(true, blob_listing_includes(), 0, token, state->options, state->context).then([state, blobs] (blob_result_segment segment) -> pplx::task<void>
+            {
+                const utility::string_t& prefix = state->directory.prefix();
+                const std::vector<cloud_blob>& segment_blobs = segment.blobs();
+                for (auto iter = segment_blobs.cbegin(); iter != segment_blobs.cend(); ++iter)
+                {
+                    blobs->insert(std::make_pair(iter->name().substr(prefix.size()), *iter));
+                }
+
+                if (segment.continuation_token().empty())
+                {
+                    return pplx::task_from_result();
+                }
+
+                return list_blobs_async(state, blobs, segment.continuation_token());
+            });
+        }
+
+        static utility::string_t hash_local_file(const utility::string_t& path, utility::size64_t size)
+        {
+            // An empty file cannot be mapped, and has the hash of no data
+            core::md5_hash hash;
+            if (size > 0)
+            {
+                auto file = core::mapped_file::open_read(path);
+                if (file->size() != size)
+                {
+                    throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_transfer_file_changed));
+                }
+
+                hash.update(file->data(), static_cast<size_t>(size));
+            }
+
+            return utility::conversions::to_base64(hash.finalize());
+        }
+
+        // Hashes up to one file per transfer slot at the same time. A file that cannot be hashed is recorded as failed.
+        static pplx::task<void> hash_local_files_async(std::shared_ptr<shared_state> state, const std::vector<core::local_file_entry>& local_files, const std::map<utility::string_t, cloud_blob>& blobs, const std::map<utility::string_t, cached_hash>& cached_hashes)
+        {
+            std::vector<pplx::task<void>> hash_tasks;
+            for (auto iter = local_files.cbegin(); iter != local_files.cend(); ++iter)
+            {
+                auto name = get_blob_name(state, iter->path);
+                auto cached = cached_hashes.find(name);
+                if ((cached != cached_hashes.end()) && (cached->second.size == iter->size) && (cached->second.last_write_time == iter->last_write_time))
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->local_hashes.insert(*cached);
+                    continue;
+                }
+
+                // Every uploaded blob gets the hash of its file, but a download only needs the hashes that can be compared with a blob
+                if (!state->is_upload)
+                {
+                    auto blob = blobs.find(name);
+                    if ((blob == blobs.end()) || (blob->second.properties().size() != iter->size) || blob->second.properties().content_md5().empty())
+                    {
+                        continue;
+                    }
+                }
+
+                auto local_path = state->local_directory + U("\\") + iter->path;
+                cached_hash hash(iter->size, iter->last_write_time);
+                hash_tasks.push_back(state->transfer_slots.lock_async().then([state, name, local_path, hash] () mutable
+                {
+                    try
+                    {
+                        hash.content_md5 = hash_local_file(local_path, hash.size);
+                    }
+                    catch (...)
+                    {
+                        state->transfer_slots.unlock();
+                        throw;
+                    }
+
+                    state->transfer_slots.unlock();
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->local_hashes[name] = hash;
+                }).then([state, name] (pplx::task<void> hash_task)
+                {
+                    try
+                    {
+                        hash_task.wait();
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        state->failures.push_back(blob_transfer_failure(name, std::current_exception()));
+                    }
+                }));
+            }
+
+            if (hash_tasks.empty())
+            {
+                return pplx::task_from_result();
+            }
+
+            return pplx::when_all(hash_tasks.begin(), hash_tasks.end());
+        }
+
+        // Returns true if a file and its blob have the same content, judging by their MD5 hashes if both have one,
+        // and otherwise by whether the copy being synced to was written after the other one
+        static bool is_unchanged(std::shared_ptr<shared_state> state, const core::local_file_entry& file, const utility::string_t& content_md5, const cloud_blob& blob)
+        {
+            const cloud_blob_properties& properties = blob.properties();
+            if (properties.size() != file.size)
+            {
+                return false;
+            }
+
+            if (!properties.content_md5().empty() && !content_md5.empty())
+            {
+                return properties.content_md5() == content_md5;
+            }
+
+            // The service keeps whole seconds only
+            auto file_time = core::truncate_fractional_seconds(file.last_write_time).to_interval();
+            auto blob_time = properties.last_modified().to_interval();
+            return state->is_upload ? (blob_time >= file_time) : (file_time >= blob_time);
+        }
+
+        // Only called once the hashes are complete, so the hashes need no lock
+        static void add_changed_files(std::shared_ptr<shared_state> state, const std::vector<core::local_file_entry>& local_files, std::map<utility::string_t, cloud_blob>& blobs, const std::set<utility::string_t>& transferred)
+        {
+            for (auto iter = local_files.cbegin(); iter != local_files.cend(); ++iter)
+            {
+                auto name = get_blob_name(state, iter->path);
+                auto local_path = state->local_directory + U("\\") + iter->path;
+                auto hash = state->local_hashes.find(name);
+                utility::string_t content_md5(hash != state->local_hashes.end() ? hash->second.content_md5 : utility::string_t());
+
+                auto blob_iter = blobs.find(name);
+                if (blob_iter == blobs.end())
+                {
+                    if (!state->is_upload)
+                    {
+                        if (state->delete_extraneous)
+                        {
+                            state->extraneous_files.push_back(std::make_shared<transfer_file>(name, local_path, cloud_blob(), iter->size, 1));
+                            state->local_hashes.erase(name);
+                        }
+
+                        continue;
+                    }
+                }
+                else
+                {
+                    cloud_blob blob(blob_iter->second);
+                    blobs.erase(blob_iter);
+                    if (is_unchanged(state, *iter, content_md5, blob))
+                    {
+                        continue;
+                    }
+
+                    if (!state->is_upload)
+                    {
+                        // A missing hash that was needed has been recorded as a failure of the file already
+                        bool hash_failed = content_md5.empty() && !blob.properties().content_md5().empty() && (blob.properties().size() == iter->size);
+                        if (!hash_failed && (transferred.find(name) == transferred.end()))
+                        {
+                            // The file is rewritten, so its hash does not stay valid
+                            state->local_hashes.erase(name);
+                            add_file(state, name, local_path, blob, blob.properties().size());
+                        }
+
+                        continue;
+                    }
+                }
+
+                // Files that could not be hashed are not uploaded, as they have been recorded as failed already
+                if (!content_md5.empty() && (transferred.find(name) == transferred.end()))
+                {
+                    cloud_blob blob(state->directory.get_block_blob_reference(name));
+                    blob.properties().set_content_md5(content_md5);
+                    add_file(state, name, local_path, std::move(blob), iter->size);
+                }
+            }
+
+            // The blobs that are left have no local file
+            for (auto iter = blobs.cbegin(); iter != blobs.cend(); ++iter)
+            {
+                if (state->is_upload)
+                {
+                    if (state->delete_extraneous)
+                    {
+                        state->extraneous_files.push_back(std::make_shared<transfer_file>(iter->first, utility::string_t(), iter->second, iter->second.properties().size(), 1));
+                    }
+                }
+                else if (transferred.find(iter->first) == transferred.end())
+                {
+                    add_file(state, iter->first, get_local_path(state, iter->first), iter->second, iter->second.properties().size());
+                }
+            }
+        }
+
+        // Deletes the extraneous blobs or files, and then records the hashes of the local files for the next sync
+        static pplx::task<void> finish_sync_async(std::shared_ptr<shared_state> state)
+        {
+            std::vector<pplx::task<void>> delete_tasks;
+            for (auto iter = state->extraneous_files.cbegin(); iter != state->extraneous_files.cend(); ++iter)
+            {
+                auto file = *iter;
+                delete_tasks.push_back(state->transfer_slots.lock_async().then([state, file] () -> pplx::task<void>
+                {
+                    if (state->is_upload)
+                    {
+                        return file->blob.delete_blob_if_exists_async(delete_snapshots_option::include_snapshots, access_condition(), state->options, state->context).then([] (bool)
+                        {
+                        });
+                    }
+
+                    core::delete_local_file(file->local_path);
+                    return pplx::task_from_result();
+                }).then([state, file] (pplx::task<void> delete_task)
+                {
+                    state->transfer_slots.unlock();
+                    try
+                    {
+                        delete_task.wait();
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        state->failures.push_back(blob_transfer_failure(file->name, std::current_exception()));
+                    }
+                }));
+            }
+
+            auto delete_task = delete_tasks.empty() ? pplx::task_from_result() : pplx::when_all(delete_tasks.begin(), delete_tasks.end());
+            return delete_task.then([state] () -> pplx::task<void>
+            {
+                return write_hash_cache_async(state);
+            });
+        }
+
+        static pplx::task<void> write_hash_cache_async(std::shared_ptr<shared_state> state)
+        {
+            if (state->hash_cache_path.empty())
+            {
+                return pplx::task_from_result();
+            }
+
+            auto text = std::make_shared<std::string>();
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                for (auto iter = state->local_hashes.cbegin(); iter != state->local_hashes.cend(); ++iter)
+                {
+                    text->append(std::to_string(static_cast<unsigned long long>(iter->second.size))).push_back(' ');
+                    text->append(std::to_string(static_cast<unsigned long long>(iter->second.last_write_time.to_interval()))).push_back(' ');
+                    text->append(utility::conversions::to_utf8string(iter->second.content_md5)).push_back(' ');
+                    text->append(utility::conversions::to_utf8string(iter->first)).push_back('\n');
+                }
+            }
+
+            return concurrency::streams::fstream::open_ostream(state->hash_cache_path, std::ios::out | std::ios::trunc).then([text] (concurrency::streams::ostream cache) mutable -> pplx::task<void>
+            {
+                return cache.streambuf().putn(reinterpret_cast<const uint8_t*>(text->data()), text->size()).then([cache, text] (pplx::task<size_t> write_task) mutable -> pplx::task<void>
+                {
+                    return cache.close().then([write_task] ()
+                    {
+                        write_task.wait();
+                    });
+                });
+            });
+        }
+
+        static void add_file(std::shared_ptr<shared_state> state, utility::string_t name, utility::string_t local_path, cloud_blob blob, utility::size64_t size)
+        {
+            if (size > state->chunk_size)
+            {
+                auto chunk_count = static_cast<size_t>((size + state->chunk_size - 1) / state->chunk_size);
+                state->pending_chunked_files.push_back(std::make_shared<transfer_file>(std::move(name), std::move(local_path), std::move(blob), size, chunk_count));
+            }
+            else
+            {
+                state->whole_files.push_back(std::make_shared<transfer_file>(std::move(name), std::move(local_path), std::move(blob), size, 1));
+            }
+        }
+
+        // Starts one file or chunk each time a transfer slot becomes free, until everything has been started
+        static pplx::task<void> dispatch_async(std::shared_ptr<shared_state> state)
+        {
+            return pplx::details::do_while([state] () -> pplx::task<bool>
+            {
+                return state->transfer_slots.lock_async().then([state] () -> bool
+                {
+                    std::shared_ptr<transfer_file> file;
+                    size_t chunk;
+                    if (!get_next_transfer(state, file, chunk))
+                    {
+                        state->transfer_slots.unlock();
+                        return false;
+                    }
+
+                    start_transfer(state, file, chunk);
+                    return true;
+                });
+            }).then([] (bool)
+            {
+            });
+        }
+
+        // Picks a whole file and a chunk in turn. Large files are started only as the ones in progress finish, which keeps the
+        // number of open files bounded, and the chunks of the files in progress are taken in round-robin order.
+        static bool get_next_transfer(std::shared_ptr<shared_state> state, std::shared_ptr<transfer_file>& file, size_t& chunk)
+        {
+            for (;;)
+            {
+                while ((state->active_chunked_files.size() < state->max_active_chunked_files) && !state->pending_chunked_files.empty())
+                {
+                    state->active_chunked_files.push_back(state->pending_chunked_files.front());
+                    state->pending_chunked_files.pop_front();
+                }
+
+                bool use_chunk = !state->active_chunked_files.empty() && (state->whole_files.empty() || state->next_from_chunked_files);
+                state->next_from_chunked_files = !state->next_from_chunked_files;
+
+                if (!use_chunk)
+                {
+                    if (state->whole_files.empty())
+                    {
+                        return false;
+                    }
+
+                    file = state->whole_files.front();
+                    state->whole_files.pop_front();
+                    chunk = 0;
+                    return true;
+                }
+
+                file = state->active_chunked_files.front();
+                state->active_chunked_files.pop_front();
+
+                bool failed;
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    failed = file->error != nullptr;
+                }
+
+                // The remaining chunks of a file that has failed are not transferred
+                if (failed)
+                {
+                    complete_chunks(state, file, file->chunk_count - file->next_chunk);
+                    continue;
+                }
+
+                chunk = file->next_chunk++;
+                if (file->next_chunk < file->chunk_count)
+                {
+                    state->active_chunked_files.push_back(file);
+                }
+
+                return true;
+            }
+        }
+
+        static void start_transfer(std::shared_ptr<shared_state> state, std::shared_ptr<transfer_file> file, size_t chunk)
+        {
+            bool is_whole_file = file->size <= state->chunk_size;
+            pplx::task<void> transfer_task;
+            try
+            {
+                transfer_task = is_whole_file ? transfer_whole_file_async(state, file) : transfer_chunk_async(state, file, chunk);
+            }
+            catch (...)
+            {
+                transfer_task = pplx::task_from_exception<void>(std::current_exception());
+            }
+
+            transfer_task.then([state, file, is_whole_file] (pplx::task<void> completed_task) -> pplx::task<void>
+            {
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                    set_error(state, file, std::current_exception());
+                }
+
+                if (is_whole_file)
+                {
+                    complete_file(state, file);
+                    return pplx::task_from_result();
+                }
+
+                return complete_chunks(state, file, 1);
+            }).then([state] (pplx::task<void> completed_task)
+            {
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                    // Failures have been recorded for the file already
+                }
+
+                state->transfer_slots.unlock();
+            });
+        }
+
+        static pplx::task<void> transfer_whole_file_async(std::shared_ptr<shared_state> state, std::shared_ptr<transfer_file> file)
+        {
+            if (state->is_upload)
+            {
+                return cloud_block_blob(file->blob).upload_from_file_async(file->local_path, access_condition(), state->options, state->context);
+            }
+
+            create_parent_directories(state, file->local_path);
+            return file->blob.download_to_file_async(file->local_path, access_condition::generate_if_match_condition(file->blob.properties().etag()), state->options, state->context);
+        }
+
+        static pplx::task<void> transfer_chunk_async(std::shared_ptr<shared_state> state, std::shared_ptr<transfer_file> file, size_t chunk)
+        {
+            // The file is opened by its first chunk and closed after its last
+            if (file->file == nullptr)
+            {
+                if (state->is_upload)
+                {
+                    file->file = core::mapped_file::open_read(file->local_path);
+                    if (file->file->size() != file->size)
+                    {
+                        throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_transfer_file_changed));
+                    }
+                }
+                else
+                {
+                    create_parent_directories(state, file->local_path);
+                    file->file = core::mapped_file::create(file->local_path, file->size);
+                }
+            }
+
+            auto offset = static_cast<utility::size64_t>(chunk) * state->chunk_size;
+            auto length = static_cast<size_t>(std::min(static_cast<utility::size64_t>(state->chunk_size), file->size - offset));
+            auto data = file->file->data() + offset;
+            auto block_id = file->block_ids.get_block_id(chunk);
+
+            auto budget = state->options._memory_budget();
+            auto reserve_task = budget ? budget->reserve_async(length) : pplx::task_from_result(std::shared_ptr<core::memory_budget::reservation>());
+            return reserve_task.then([state, file, data, offset, length, block_id] (std::shared_ptr<core::memory_budget::reservation> reservation) -> pplx::task<void>
+            {
+                if (state->is_upload)
+                {
+                    auto source = concurrency::streams::rawptr_stream<uint8_t>::open_istream(static_cast<const uint8_t*>(data), length);
+                    return cloud_block_blob(file->blob).upload_block_async(block_id, source, utility::string_t(), access_condition(), state->options, state->context).then([source, reservation] (pplx::task<void> upload_task) mutable
+                    {
+                        source.close().wait();
+                        upload_task.wait();
+                    });
+                }
+
+                auto target = concurrency::streams::rawptr_stream<uint8_t>::open_ostream(data, length);
+                auto condition = access_condition::generate_if_match_condition(file->blob.properties().etag());
+                return file->blob.download_range_to_stream_async(target, static_cast<int64_t>(offset), static_cast<int64_t>(length), condition, state->options, state->context).then([target, reservation] (pplx::task<void> download_task) mutable
+                {
+                    target.close().wait();
+                    download_task.wait();
+                });
+            });
+        }
+
+        // Completes the specified number of chunks of a file, and the file itself once all of its chunks are complete
+        static pplx::task<void> complete_chunks(std::shared_ptr<shared_state> state, std::shared_ptr<transfer_file> file, size_t count)
+        {
+            bool failed;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                file->remaining_chunks -= count;
+                if (file->remaining_chunks > 0)
+                {
+                    return pplx::task_from_result();
+                }
+
+                failed = file->error != nullptr;
+            }
+
+            pplx::task<void> finish_task;
+            if (failed)
+            {
+                finish_task = pplx::task_from_result();
+            }
+            else if (state->is_upload)
+            {
+                std::vector<block_list_item> block_list;
+                block_list.reserve(file->chunk_count);
+                for (size_t i = 0; i < file->chunk_count; ++i)
+                {
+                    block_list.push_back(block_list_item(file->block_ids.get_block_id(i), block_list_item::uncommitted));
+                }
+
+                finish_task = cloud_block_blob(file->blob).upload_block_list_async(block_list, access_condition(), state->options, state->context);
+            }
+            else
+            {
+                finish_task = pplx::create_task([file] ()
+                {
+                    file->file->flush();
+                });
+            }
+
+            return finish_task.then([state, file] (pplx::task<void> completed_task)
+            {
+                file->file.reset();
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                    set_error(state, file, std::current_exception());
+                }
+
+                complete_file(state, file);
+            });
+        }
+
+        static void set_error(std::shared_ptr<shared_state> state, std::shared_ptr<transfer_file> file, std::exception_ptr error)
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (file->error == nullptr)
+            {
+                file->error = error;
+            }
+        }
+
+        // Records a failed file, or appends a file that has been transferred to the checkpoint
+        static void complete_file(std::shared_ptr<shared_state> state, std::shared_ptr<transfer_file> file)
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (file->error != nullptr)
+            {
+                state->failures.push_back(blob_transfer_failure(file->name, file->error));
+                return;
+            }
+
+            if (!state->checkpoint.is_valid())
+            {
+                return;
+            }
+
+            auto line = std::make_shared<std::string>(utility::conversions::to_utf8string(file->name));
+            line->push_back('\n');
+            auto checkpoint = state->checkpoint;
+            state->checkpoint_task = state->checkpoint_task.then([checkpoint, line] () mutable -> pplx::task<void>
+            {
+                return checkpoint.streambuf().putn(reinterpret_cast<const uint8_t*>(line->data()), line->size()).then([line] (size_t)
+                {
+                });
+            });
+        }
+
+        // Only called by the dispatcher
+        static void create_parent_directories(std::shared_ptr<shared_state> state, const utility::string_t& local_path)
+        {
+            utility::string_t parent(local_path.substr(0, local_path.find_last_of(U('\\'))));
+            if (parent != state->last_created_directory)
+            {
+                core::create_local_directories(parent);
+                state->last_created_directory = std::move(parent);
+            }
+        }
+
+        cloud_blob_directory directory;
+        blob_request_options options;
+        operation_context context;
+        utility::string_t local_directory;
+        bool is_upload;
+        bool is_sync;
+        bool delete_extraneous;
+        size_t chunk_size;
+        utility::string_t checkpoint_path;
+        utility::string_t hash_cache_path;
+        size_t max_active_chunked_files;
+        core::async_semaphore transfer_slots;
+
+        // Only used by the dispatcher
+        std::deque<std::shared_ptr<transfer_file>> whole_files;
+        std::deque<std::shared_ptr<transfer_file>> pending_chunked_files;
+        std::deque<std::shared_ptr<transfer_file>> active_chunked_files;
+        bool next_from_chunked_files;
+        utility::string_t last_created_directory;
+
+        // The blobs or files that a sync deletes once the transfers have completed
+        std::vector<std::shared_ptr<transfer_file>> extraneous_files;
+
+        // Guarded by the mutex
+        concurrency::streams::ostream checkpoint;
+        pplx::task<void> checkpoint_task;
+        std::vector<blob_transfer_failure> failures;
+        std::map<utility::string_t, cached_hash> local_hashes;
+        std::mutex mutex;
+    };
+
+    pplx::task<std::vector<blob_transfer_failure>> blob_directory_transfer_manager::upload_directory_async(const utility::string_t& local_directory)
+    {
+        return transfer_async(local_directory, true, false);
+    }
+
+    pplx::task<std::vector<blob_transfer_failure>> blob_directory_transfer_manager::download_directory_async(const utility::string_t& local_directory)
+    {
+        return transfer_async(local_directory, false, false);
+    }
+
+    pplx::task<std::vector<blob_transfer_failure>> blob_directory_transfer_manager::sync_upload_directory_async(const utility::string_t& local_directory)
+    {
+        return transfer_async(local_directory, true, true);
+    }
+
+    pplx::task<std::vector<blob_transfer_failure>> blob_directory_transfer_manager::sync_download_directory_async(const utility::string_t& local_directory)
+    {
+        return transfer_async(local_directory, false, true);
+    }
+
+    pplx::task<std::vector<blob_transfer_failure>> blob_directory_transfer_manager::transfer_async(const utility::string_t& local_directory, bool is_upload, bool is_sync)
+    {
+        if (m_max_concurrent_transfers < 1)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_transfer_manager_max_concurrent_transfers));
+        }
+
+        if ((m_chunk_size == 0) || (m_chunk_size > protocol::max_block_size))
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_transfer_manager_chunk_size));
+        }
+
+        auto state = std::make_shared<shared_state>(*this, local_directory, is_upload, is_sync);
+        return shared_state::run_async(state);
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,405 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="block_blob_log_writer.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <deque>
+
+#include "wascore/blobstreams.h"
+#include "wascore/constants.h"
+#include "wascore/util.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    struct block_blob_log_writer::shared_state
+    {
+        // The records gathered into a block, which get an ID once the block is sealed
+        struct pending_block
+        {
+            pending_block(uint64_t sequence)
+                : sequence(sequence), is_uploaded(false)
+            {
+            }
+
+            uint64_t sequence;
+            utility::string_t id;
+            std::vector<uint8_t> data;
+            pplx::task_completion_event<void> committed;
+            bool is_uploaded;
+            std::exception_ptr error;
+        };
+
+        shared_state(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
+            : blob(blob), condition(condition), options(options), context(context), max_block_size(protocol::default_log_writer_max_block_size),
+            max_batch_delay(protocol::default_log_writer_max_batch_delay), block_sequence(0), next_block_number(0), is_block_list_loaded(false), is_commit_running(false)
+        {
+        }
+
+        // Must be called with the mutex held, and returns the block that the caller has to upload, if there is one
+        std::shared_ptr<pending_block> seal_current_block()
+        {
+            auto block = current_block;
+            if (block != nullptr)
+            {
+                current_block.reset();
+                block->id = block_ids.get_block_id(next_block_number++);
+                sealed_blocks.push_back(block);
+                last_block = block;
+            }
+
+            return block;
+        }
+
+        // Must be called with the mutex held
+        void forget_block(const std::shared_ptr<pending_block>& block)
+        {
+            if (last_block == block)
+            {
+                last_block.reset();
+            }
+        }
+
+        static void upload_block(std::shared_ptr<shared_state> state, std::shared_ptr<pending_block> block)
+        {
+            if (block == nullptr)
+            {
+                return;
+            }
+
+            pplx::task<void> upload_task;
+            try
+            {
+                // Only the thread that sealed the block touches its data
+                auto block_data = concurrency::streams::bytestream::open_istream(std::move(block->data));
+                upload_task = state->blob.upload_block_async(block->id, block_data, utility::string_t(), state->condition, state->options, state->context);
+            }
+            catch (...)
+            {
+                upload_task = pplx::task_from_exception<void>(std::current_exception());
+            }
+
+            upload_task.then([state, block] (pplx::task<void> completed_task)
+            {
+                std::exception_ptr error;
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    block->is_uploaded = true;
+                    block->error = error;
+                }
+
+                start_commit(state);
+            });
+        }
+
+        // The blocks the blob has are kept by the first commit, so the later ones do not have to read them again
+        static pplx::task<void> load_block_list_async(std::shared_ptr<shared_state> state)
+        {
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (state->is_block_list_loaded)
+                {
+                    return pplx::task_from_result();
+                }
+            }
+
+            return state->blob.download_block_list_async(block_listing_filter::committed, state->condition, state->options, state->context).then([state] (pplx::task<std::vector<block_list_item>> download_task)
+            {
+                std::vector<block_list_item> blocks;
+                try
+                {
+                    blocks = download_task.get();
+                }
+                catch (const storage_exception& e)
+                {
+                    auto result = e.result();
+                    if (!result.is_response_available() ||
+                        (result.http_status_code() != web::http::status_codes::NotFound) ||
+                        (result.extended_error().code() != protocol::error_code_blob_not_found))
+                    {
+                        throw;
+                    }
+                }
+
+                std::lock_guard<std::mutex> guard(state->mutex);
+                state->committed_block_ids.reserve(blocks.size());
+                for (auto iter = blocks.cbegin(); iter != blocks.cend(); ++iter)
+                {
+                    state->committed_block_ids.push_back(iter->id());
+                }
+
+                state->is_block_list_loaded = true;
+            });
+        }
+
+        // Commits the blocks that have been uploaded, in order, unless a commit is running already, which starts the next one once it is done
+        static void start_commit(std::shared_ptr<shared_state> state)
+        {
+            std::vector<std::shared_ptr<pending_block>> failed_blocks;
+            std::vector<std::shared_ptr<pending_block>> group;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (state->is_commit_running)
+                {
+                    return;
+                }
+
+                while (!state->sealed_blocks.empty() && state->sealed_blocks.front()->is_uploaded)
+                {
+                    auto block = state->sealed_blocks.front();
+                    state->sealed_blocks.pop_front();
+                    if (block->error != nullptr)
+                    {
+                        state->forget_block(block);
+                        failed_blocks.push_back(block);
+                    }
+                    else
+                    {
+                        group.push_back(block);
+                    }
+                }
+
+                state->is_commit_running = !group.empty();
+            }
+
+            for (auto iter = failed_blocks.cbegin(); iter != failed_blocks.cend(); ++iter)
+            {
+                (*iter)->committed.set_exception((*iter)->error);
+            }
+
+            if (group.empty())
+            {
+                return;
+            }
+
+            load_block_list_async(state).then([state, group] () -> pplx::task<void>
+            {
+                std::vector<block_list_item> block_list;
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    block_list.reserve(state->committed_block_ids.size() + group.size());
+                    for (auto iter = state->committed_block_ids.cbegin(); iter != state->committed_block_ids.cend(); ++iter)
+                    {
+                        block_list.push_back(block_list_item(*iter, block_list_item::committed));
+                    }
+                }
+
+                for (auto iter = group.cbegin(); iter != group.cend(); ++iter)
+                {
+                    block_list.push_back(block_list_item((*iter)->id, block_list_item::uncommitted));
+                }
+
+                return state->blob.upload_block_list_async(block_list, state->condition, state->options, state->context);
+            }).then([state, group] (pplx::task<void> commit_task)
+            {
+                std::exception_ptr error;
+                try
+                {
+                    commit_task.wait();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->is_commit_running = false;
+                    for (auto iter = group.cbegin(); iter != group.cend(); ++iter)
+                    {
+                        if (error == nullptr)
+                        {
+                            state->committed_block_ids.push_back((*iter)->id);
+                        }
+
+                        state->forget_block(*iter);
+                    }
+                }
+
+                for (auto iter = group.cbegin(); iter != group.cend(); ++iter)
+                {
+                    if (error == nullptr)
+                    {
+                        (*iter)->committed.set();
+                    }
+                    else
+                    {
+                        (*iter)->committed.set_exception(error);
+                    }
+                }
+
+                start_commit(state);
+            });
+        }
+
+        cloud_block_blob blob;
+        access_condition condition;
+        blob_request_options options;
+        operation_context context;
+        size_t max_block_size;
+        std::chrono::milliseconds max_batch_delay;
+
+        // The block that records are appended to, and the blocks that have been sealed but not committed yet, in order
+        std::shared_ptr<pending_block> current_block;
+        std::deque<std::shared_ptr<pending_block>> sealed_blocks;
+        std::shared_ptr<pending_block> last_block;
+        uint64_t block_sequence;
+
+        core::block_id_sequence block_ids;
+        size_t next_block_number;
+        std::vector<utility::string_t> committed_block_ids;
+        bool is_block_list_loaded;
+        bool is_commit_running;
+        mutable std::mutex mutex;
+    };
+
+    void block_blob_log_writer::initialize(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        m_state = std::make_shared<shared_state>(blob, condition, options, context);
+    }
+
+    pplx::task<void> block_blob_log_writer::append_async(const uint8_t* data, size_t length)
+    {
+        if (length == 0)
+        {
+            return pplx::task_from_result();
+        }
+
+        auto state = m_state;
+        std::shared_ptr<shared_state::pending_block> full_block;
+        std::shared_ptr<shared_state::pending_block> sealed_block;
+        uint64_t scheduled_sequence = 0;
+        std::chrono::milliseconds delay;
+        pplx::task<void> result;
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (length > state->max_block_size)
+            {
+                throw std::invalid_argument("length");
+            }
+
+            // A record that does not fit in the current block starts the next one
+            if ((state->current_block != nullptr) && (state->current_block->data.size() + length > state->max_block_size))
+            {
+                full_block = state->seal_current_block();
+            }
+
+            if (state->current_block == nullptr)
+            {
+                state->current_block = std::make_shared<shared_state::pending_block>(++state->block_sequence);
+                scheduled_sequence = state->current_block->sequence;
+                delay = state->max_batch_delay;
+            }
+
+            auto& block_data = state->current_block->data;
+            block_data.insert(block_data.end(), data, data + length);
+            result = pplx::create_task(state->current_block->committed);
+
+            if ((block_data.size() >= state->max_block_size) || (state->max_batch_delay.count() <= 0))
+            {
+                sealed_block = state->seal_current_block();
+                scheduled_sequence = 0;
+            }
+        }
+
+        shared_state::upload_block(state, full_block);
+        shared_state::upload_block(state, sealed_block);
+
+        if (scheduled_sequence != 0)
+        {
+            core::complete_after(delay).then([state, scheduled_sequence] ()
+            {
+                std::shared_ptr<shared_state::pending_block> block;
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    if ((state->current_block != nullptr) && (state->current_block->sequence == scheduled_sequence))
+                    {
+                        block = state->seal_current_block();
+                    }
+                }
+
+                shared_state::upload_block(state, block);
+            });
+        }
+
+        return result;
+    }
+
+    pplx::task<void> block_blob_log_writer::flush_async()
+    {
+        auto state = m_state;
+        std::shared_ptr<shared_state::pending_block> block;
+        pplx::task<void> result = pplx::task_from_result();
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            block = state->seal_current_block();
+
+            // Blocks are committed in order, so the others are committed once the last one is
+            if (state->last_block != nullptr)
+            {
+                result = pplx::create_task(state->last_block->committed);
+            }
+        }
+
+        shared_state::upload_block(state, block);
+        return result;
+    }
+
+    size_t block_blob_log_writer::max_block_size() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_block_size;
+    }
+
+    void block_blob_log_writer::set_max_block_size(size_t value)
+    {
+        if ((value == 0) || (value > protocol::max_block_size))
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_block_size = value;
+    }
+
+    std::chrono::milliseconds block_blob_log_writer::max_batch_delay() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_batch_delay;
+    }
+
+    void block_blob_log_writer::set_max_batch_delay(std::chrono::milliseconds value)
+    {
+        if (value.count() < 0)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_batch_delay = value;
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,343 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="block_blob_parallel_writer.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/blobstreams.h"
+#include "wascore/constants.h"
+#include "wascore/resources.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    struct block_blob_parallel_writer::shared_state
+    {
+        struct part_upload
+        {
+            part_upload(size_t index, concurrency::streams::istream source)
+                : index(index), source(source)
+            {
+            }
+
+            size_t index;
+            concurrency::streams::istream source;
+
+            // Only used by the loop that reads the part, which runs one step at a time
+            std::vector<pplx::task<void>> block_tasks;
+
+            std::exception_ptr error;
+        };
+
+        shared_state(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
+            : blob(blob), condition(condition), options(options), context(context), max_concurrent_uploads(protocol::default_max_concurrent_block_uploads),
+            upload_slots(protocol::default_max_concurrent_block_uploads), next_part(0), next_block_number(0), pending_parts(0), is_committed(false)
+        {
+            // The block size may come from the default options of the client
+            blob_request_options modified_options(options);
+            modified_options.apply_defaults(blob.service_client().default_request_options(), blob.type());
+            block_size = static_cast<size_t>(std::min<utility::size64_t>(modified_options.stream_write_size_in_bytes(), protocol::max_block_size));
+            if (block_size == 0)
+            {
+                block_size = protocol::max_block_size;
+            }
+
+            done_event.set();
+        }
+
+        // Must be called with the mutex held
+        void record_error(part_upload& part, std::exception_ptr error)
+        {
+            if (part.error == nullptr)
+            {
+                part.error = error;
+            }
+
+            if (first_error == nullptr)
+            {
+                first_error = error;
+            }
+        }
+
+        // Reads the next block of the part once an upload slot is free, and starts uploading it. Returns false at the end of the part.
+        static pplx::task<bool> upload_next_block_async(std::shared_ptr<shared_state> state, std::shared_ptr<part_upload> part)
+        {
+            auto upload_slots = state->upload_slots;
+            return upload_slots.lock_async().then([state, part, upload_slots] () mutable -> pplx::task<bool>
+            {
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    if (state->first_error != nullptr)
+                    {
+                        upload_slots.unlock();
+                        return pplx::task_from_result(false);
+                    }
+                }
+
+                concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                pplx::task<size_t> read_task;
+                try
+                {
+                    read_task = part->source.read(buffer, state->block_size);
+                }
+                catch (...)
+                {
+                    upload_slots.unlock();
+                    throw;
+                }
+
+                return read_task.then([state, part, upload_slots, buffer] (pplx::task<size_t> read_task) mutable -> bool
+                {
+                    size_t read_count;
+                    try
+                    {
+                        read_count = read_task.get();
+                    }
+                    catch (...)
+                    {
+                        upload_slots.unlock();
+                        throw;
+                    }
+
+                    if (read_count == 0)
+                    {
+                        upload_slots.unlock();
+                        return false;
+                    }
+
+                    utility::string_t block_id;
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        auto block_number = state->next_block_number++;
+                        state->parts[part->index].push_back(block_number);
+                        block_id = state->block_ids.get_block_id(block_number);
+                    }
+
+                    auto block_data = concurrency::streams::bytestream::open_istream(std::move(buffer.collection()));
+                    pplx::task<void> upload_task;
+                    try
+                    {
+                        upload_task = state->blob.upload_block_async(block_id, block_data, utility::string_t(), state->condition, state->options, state->context);
+                    }
+                    catch (...)
+                    {
+                        upload_task = pplx::task_from_exception<void>(std::current_exception());
+                    }
+
+                    part->block_tasks.push_back(upload_task.then([state, part, upload_slots] (pplx::task<void> completed_task) mutable
+                    {
+                        upload_slots.unlock();
+                        try
+                        {
+                            completed_task.wait();
+                        }
+                        catch (...)
+                        {
+                            std::lock_guard<std::mutex> guard(state->mutex);
+                            state->record_error(*part, std::current_exception());
+                        }
+                    }));
+
+                    return true;
+                });
+            });
+        }
+
+        static pplx::task<void> upload_part_async(std::shared_ptr<shared_state> state, std::shared_ptr<part_upload> part)
+        {
+            return pplx::details::do_while([state, part] () -> pplx::task<bool>
+            {
+                return upload_next_block_async(state, part);
+            }).then([state, part] (pplx::task<bool> loop_task) -> pplx::task<void>
+            {
+                try
+                {
+                    loop_task.wait();
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->record_error(*part, std::current_exception());
+                }
+
+                // The tasks of the blocks never fail, as their errors are recorded instead
+                if (part->block_tasks.empty())
+                {
+                    return pplx::task_from_result();
+                }
+
+                return pplx::when_all(part->block_tasks.begin(), part->block_tasks.end());
+            }).then([state, part] ()
+            {
+                std::exception_ptr error;
+                bool is_done;
+                pplx::task_completion_event<void> done_event;
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    error = part->error;
+                    is_done = --state->pending_parts == 0;
+                    done_event = state->done_event;
+                }
+
+                if (is_done)
+                {
+                    done_event.set();
+                }
+
+                if (error != nullptr)
+                {
+                    std::rethrow_exception(error);
+                }
+            });
+        }
+
+        cloud_block_blob blob;
+        access_condition condition;
+        blob_request_options options;
+        operation_context context;
+        size_t block_size;
+        int max_concurrent_uploads;
+
+        // Blocks are numbered in the order they are read, whichever part they belong to, so every block has an ID of the same length
+        core::block_id_sequence block_ids;
+        core::async_semaphore upload_slots;
+
+        // The numbers of the blocks of each part, in order
+        std::map<size_t, std::vector<size_t>> parts;
+        size_t next_part;
+        size_t next_block_number;
+
+        int pending_parts;
+        pplx::task_completion_event<void> done_event;
+        std::exception_ptr first_error;
+        bool is_committed;
+        mutable std::mutex mutex;
+    };
+
+    void block_blob_parallel_writer::initialize(const cloud_block_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        m_state = std::make_shared<shared_state>(blob, condition, options, context);
+    }
+
+    size_t block_blob_parallel_writer::claim_part()
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->next_part++;
+    }
+
+    pplx::task<void> block_blob_parallel_writer::upload_part_async(size_t part_index, concurrency::streams::istream source)
+    {
+        auto state = m_state;
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (state->is_committed)
+            {
+                throw std::logic_error(utility::conversions::to_utf8string(protocol::error_parallel_writer_committed));
+            }
+
+            if (!state->parts.insert(std::make_pair(part_index, std::vector<size_t>())).second)
+            {
+                throw std::invalid_argument("part_index");
+            }
+
+            if (part_index >= state->next_part)
+            {
+                state->next_part = part_index + 1;
+            }
+
+            if (state->parts.size() == 1)
+            {
+                state->upload_slots = core::async_semaphore(state->max_concurrent_uploads);
+            }
+
+            if (state->pending_parts++ == 0)
+            {
+                state->done_event = pplx::task_completion_event<void>();
+            }
+        }
+
+        return shared_state::upload_part_async(state, std::make_shared<shared_state::part_upload>(part_index, source));
+    }
+
+    pplx::task<void> block_blob_parallel_writer::commit_async()
+    {
+        auto state = m_state;
+        pplx::task_completion_event<void> done_event;
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (state->is_committed)
+            {
+                throw std::logic_error(utility::conversions::to_utf8string(protocol::error_parallel_writer_committed));
+            }
+
+            state->is_committed = true;
+            done_event = state->done_event;
+        }
+
+        return pplx::create_task(done_event).then([state] () -> pplx::task<void>
+        {
+            std::vector<block_list_item> block_list;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (state->first_error != nullptr)
+                {
+                    std::rethrow_exception(state->first_error);
+                }
+
+                block_list.reserve(state->next_block_number);
+                for (auto part = state->parts.cbegin(); part != state->parts.cend(); ++part)
+                {
+                    for (auto block_number = part->second.cbegin(); block_number != part->second.cend(); ++block_number)
+                    {
+                        block_list.push_back(block_list_item(state->block_ids.get_block_id(*block_number), block_list_item::uncommitted));
+                    }
+                }
+            }
+
+            return state->blob.upload_block_list_async(block_list, state->condition, state->options, state->context);
+        });
+    }
+
+    size_t block_blob_parallel_writer::part_count() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->parts.size();
+    }
+
+    int block_blob_parallel_writer::max_concurrent_uploads() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_concurrent_uploads;
+    }
+
+    void block_blob_parallel_writer::set_max_concurrent_uploads(int value)
+    {
+        if (value < 1)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        if (m_state->parts.empty())
+        {
+            m_state->max_concurrent_uploads = value;
+        }
+    }
+
+}} // namespace wa::storage
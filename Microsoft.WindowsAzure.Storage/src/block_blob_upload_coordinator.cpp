@@ -0,0 +1,358 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="block_blob_upload_coordinator.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/blobstreams.h"
+#include "wascore/constants.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        bool parse_size_field(const utility::string_t& value, size_t& result)
+        {
+            if (value.empty() || (value.find_first_not_of(U("0123456789")) != utility::string_t::npos))
+            {
+                return false;
+            }
+
+            result = utility::conversions::scan_string<size_t>(value);
+            return true;
+        }
+
+        void throw_invalid_work_unit()
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_invalid_work_unit));
+        }
+    }
+
+    utility::string_t block_upload_assignment::to_string() const
+    {
+        utility::string_t result;
+        core::append_text_field(result, U("version"), U("1"));
+        core::append_text_field(result, U("part"), utility::conversions::print_string(m_part_index));
+        core::append_text_field(result, U("first_block"), utility::conversions::print_string(m_first_block));
+        core::append_text_field(result, U("max_blocks"), utility::conversions::print_string(m_max_block_count));
+        core::append_text_field(result, U("prefix"), m_block_id_prefix);
+        return result;
+    }
+
+    block_upload_assignment block_upload_assignment::parse(const utility::string_t& value)
+    {
+        std::vector<std::pair<utility::string_t, utility::string_t>> fields;
+        bool valid = core::parse_text_fields(value, fields);
+        bool has_version = false;
+
+        block_upload_assignment result;
+        for (auto iter = fields.cbegin(); valid && (iter != fields.cend()); ++iter)
+        {
+            const utility::string_t& name = iter->first;
+            const utility::string_t& field = iter->second;
+            if (name == U("version"))
+            {
+                has_version = true;
+                valid = (field == U("1"));
+            }
+            else if (name == U("part"))
+            {
+                valid = parse_size_field(field, result.m_part_index);
+            }
+            else if (name == U("first_block"))
+            {
+                valid = parse_size_field(field, result.m_first_block);
+            }
+            else if (name == U("max_blocks"))
+            {
+                valid = parse_size_field(field, result.m_max_block_count);
+            }
+            else if (name == U("prefix"))
+            {
+                result.m_block_id_prefix = field;
+            }
+
+            // Any other field was written by a later version and is skipped
+        }
+
+        if (!valid || !has_version || result.m_block_id_prefix.empty() || (result.m_first_block + result.m_max_block_count > protocol::max_block_count))
+        {
+            throw_invalid_work_unit();
+        }
+
+        return result;
+    }
+
+    utility::string_t block_upload_assignment::get_block_id(size_t index) const
+    {
+        if (index >= m_max_block_count)
+        {
+            throw std::invalid_argument("index");
+        }
+
+        core::block_id_sequence block_ids(utility::conversions::to_utf8string(m_block_id_prefix));
+        return block_ids.get_block_id(m_first_block + index);
+    }
+
+    utility::string_t block_upload_receipt::to_string() const
+    {
+        utility::string_t result;
+        core::append_text_field(result, U("version"), U("1"));
+        core::append_text_field(result, U("part"), utility::conversions::print_string(m_part_index));
+        core::append_text_field(result, U("blocks"), utility::conversions::print_string(m_block_count));
+        core::append_text_field(result, U("length"), utility::conversions::print_string(m_length));
+        return result;
+    }
+
+    block_upload_receipt block_upload_receipt::parse(const utility::string_t& value)
+    {
+        std::vector<std::pair<utility::string_t, utility::string_t>> fields;
+        bool valid = core::parse_text_fields(value, fields);
+        bool has_version = false;
+
+        block_upload_receipt result;
+        for (auto iter = fields.cbegin(); valid && (iter != fields.cend()); ++iter)
+        {
+            const utility::string_t& name = iter->first;
+            const utility::string_t& field = iter->second;
+            if (name == U("version"))
+            {
+                has_version = true;
+                valid = (field == U("1"));
+            }
+            else if (name == U("part"))
+            {
+                valid = parse_size_field(field, result.m_part_index);
+            }
+            else if (name == U("blocks"))
+            {
+                valid = parse_size_field(field, result.m_block_count);
+            }
+            else if (name == U("length"))
+            {
+                valid = !field.empty() && (field.find_first_not_of(U("0123456789")) == utility::string_t::npos);
+                if (valid)
+                {
+                    result.m_length = utility::conversions::scan_string<utility::size64_t>(field);
+                }
+            }
+        }
+
+        if (!valid || !has_version)
+        {
+            throw_invalid_work_unit();
+        }
+
+        return result;
+    }
+
+    block_blob_upload_coordinator::block_blob_upload_coordinator(const cloud_block_blob& blob, size_t part_count)
+        : m_blob(blob)
+    {
+        if ((part_count == 0) || (part_count > protocol::max_block_count))
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_part_count));
+        }
+
+        // Every part gets the same share of the blocks that the blob may have, so that no part depends on the size of another
+        core::block_id_sequence block_ids;
+        auto prefix = utility::conversions::to_string_t(block_ids.encoded_prefix());
+        size_t blocks_per_part = protocol::max_block_count / part_count;
+
+        m_assignments.reserve(part_count);
+        for (size_t i = 0; i < part_count; ++i)
+        {
+            block_upload_assignment assignment;
+            assignment.m_part_index = i;
+            assignment.m_first_block = i * blocks_per_part;
+            assignment.m_max_block_count = blocks_per_part;
+            assignment.m_block_id_prefix = prefix;
+            m_assignments.push_back(std::move(assignment));
+        }
+    }
+
+    pplx::task<block_upload_receipt> block_blob_upload_coordinator::upload_part_async(const cloud_block_blob& blob, const block_upload_assignment& assignment, concurrency::streams::istream source, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(blob.service_client().default_request_options(), blob.type());
+        size_t block_size = static_cast<size_t>(std::min<utility::size64_t>(modified_options.stream_write_size_in_bytes(), protocol::max_block_size));
+        if (block_size == 0)
+        {
+            block_size = protocol::max_block_size;
+        }
+
+        // The part is read one block at a time, and up to the parallelism factor of the blocks are uploaded at the same time
+        auto target = blob;
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        auto block_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+        auto block_count = std::make_shared<size_t>(0);
+        auto length = std::make_shared<utility::size64_t>(0);
+        auto failed = std::make_shared<std::atomic<bool>>(false);
+
+        return pplx::details::do_while([target, assignment, source, block_size, condition, modified_options, context, semaphore, block_tasks, block_count, length, failed] () mutable -> pplx::task<bool>
+        {
+            return semaphore.lock_async().then([target, assignment, source, block_size, condition, modified_options, context, semaphore, block_tasks, block_count, length, failed] () mutable -> pplx::task<bool>
+            {
+                if (*failed)
+                {
+                    semaphore.unlock();
+                    return pplx::task_from_result(false);
+                }
+
+                concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                return source.read(buffer, block_size).then([target, assignment, buffer, condition, modified_options, context, semaphore, block_tasks, block_count, length, failed] (pplx::task<size_t> read_task) mutable -> bool
+                {
+                    size_t read_count;
+                    try
+                    {
+                        read_count = read_task.get();
+                        if ((read_count > 0) && (*block_count >= assignment.max_block_count()))
+                        {
+                            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_part_too_large));
+                        }
+                    }
+                    catch (...)
+                    {
+                        semaphore.unlock();
+                        throw;
+                    }
+
+                    if (read_count == 0)
+                    {
+                        semaphore.unlock();
+                        return false;
+                    }
+
+                    auto block_id = assignment.get_block_id((*block_count)++);
+                    *length += read_count;
+
+                    auto block_data = concurrency::streams::bytestream::open_istream(std::move(buffer.collection()));
+                    pplx::task<void> upload_task;
+                    try
+                    {
+                        upload_task = target.upload_block_async(block_id, block_data, utility::string_t(), condition, modified_options, context);
+                    }
+                    catch (...)
+                    {
+                        upload_task = pplx::task_from_exception<void>(std::current_exception());
+                    }
+
+                    upload_task.then([semaphore, failed] (pplx::task<void> completed_task) mutable
+                    {
+                        try
+                        {
+                            completed_task.wait();
+                        }
+                        catch (...)
+                        {
+                            *failed = true;
+                        }
+
+                        semaphore.unlock();
+                    });
+
+                    block_tasks->push_back(upload_task);
+                    return true;
+                });
+            });
+        }).then([assignment, semaphore, block_tasks, block_count, length] (bool) mutable -> pplx::task<block_upload_receipt>
+        {
+            return semaphore.wait_all_async().then([assignment, block_tasks, block_count, length] () -> block_upload_receipt
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = block_tasks->begin(); iter != block_tasks->end(); ++iter)
+                {
+                    iter->get();
+                }
+
+                return block_upload_receipt(assignment.part_index(), *block_count, *length);
+            });
+        });
+    }
+
+    pplx::task<void> block_blob_upload_coordinator::commit_async(const std::vector<block_upload_receipt>& receipts, const access_condition& condition, const blob_request_options& options, operation_context context) const
+    {
+        // Every part must have exactly one receipt, which is put in the order of the parts
+        std::vector<const block_upload_receipt*> ordered_receipts(m_assignments.size(), nullptr);
+        bool valid = (receipts.size() == m_assignments.size());
+        for (auto iter = receipts.cbegin(); valid && (iter != receipts.cend()); ++iter)
+        {
+            size_t part_index = iter->part_index();
+            valid = (part_index < ordered_receipts.size()) && (ordered_receipts[part_index] == nullptr) && (iter->block_count() <= m_assignments[part_index].max_block_count());
+            if (valid)
+            {
+                ordered_receipts[part_index] = &*iter;
+            }
+        }
+
+        if (!valid)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_missing_upload_receipt));
+        }
+
+        auto parts = std::make_shared<std::vector<block_upload_receipt>>();
+        parts->reserve(ordered_receipts.size());
+        for (auto iter = ordered_receipts.cbegin(); iter != ordered_receipts.cend(); ++iter)
+        {
+            parts->push_back(**iter);
+        }
+
+        auto blob = m_blob;
+        auto assignments = m_assignments;
+        return blob.download_block_list_async(block_listing_filter::uncommitted, condition, options, context).then([blob, assignments, parts, condition, options, context] (std::vector<block_list_item> uncommitted_blocks) mutable -> pplx::task<void>
+        {
+            std::map<utility::string_t, size_t> block_sizes;
+            for (auto iter = uncommitted_blocks.cbegin(); iter != uncommitted_blocks.cend(); ++iter)
+            {
+                block_sizes[iter->id()] = iter->size();
+            }
+
+            // Nothing is committed unless every block of every part has been uploaded with the length its receipt states
+            std::vector<block_list_item> block_list;
+            for (auto part = parts->cbegin(); part != parts->cend(); ++part)
+            {
+                const block_upload_assignment& assignment = assignments[part->part_index()];
+                utility::size64_t length = 0;
+                for (size_t i = 0; i < part->block_count(); ++i)
+                {
+                    auto block_id = assignment.get_block_id(i);
+                    auto block = block_sizes.find(block_id);
+                    if (block == block_sizes.end())
+                    {
+                        throw storage_exception(utility::conversions::to_utf8string(protocol::error_missing_uploaded_block), false);
+                    }
+
+                    length += block->second;
+                    block_list.push_back(block_list_item(block_id, block_list_item::uncommitted));
+                }
+
+                if (length != part->length())
+                {
+                    throw storage_exception(utility::conversions::to_utf8string(protocol::error_missing_uploaded_block), false);
+                }
+            }
+
+            return blob.upload_block_list_async(block_list, condition, options, context);
+        });
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,62 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="block_buffer_pool.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/block_buffer_pool.h"
+
+#include <iterator>
+
+namespace wa { namespace storage { namespace core {
+
+    pplx::task<transfer_buffer> block_buffer_pool::acquire_async(size_t capacity, std::shared_ptr<wa::storage::buffer_allocator> allocator)
+    {
+        auto instance = shared_from_this();
+        return m_semaphore.lock_async().then([instance, capacity, allocator] () -> transfer_buffer
+        {
+            transfer_buffer buffer((transfer_allocator<uint8_t>(allocator)));
+            {
+                std::lock_guard<std::mutex> guard(instance->m_mutex);
+
+                // Only a buffer from the same allocator is reused
+                for (auto iter = instance->m_free_buffers.rbegin(); iter != instance->m_free_buffers.rend(); ++iter)
+                {
+                    if (iter->get_allocator().allocator() == allocator)
+                    {
+                        buffer = std::move(*iter);
+                        instance->m_free_buffers.erase(std::next(iter).base());
+                        break;
+                    }
+                }
+            }
+
+            buffer.clear();
+            buffer.reserve(capacity);
+            return buffer;
+        });
+    }
+
+    void block_buffer_pool::release(transfer_buffer buffer)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_free_buffers.push_back(std::move(buffer));
+        }
+
+        m_semaphore.unlock();
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,121 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="circuit_breaker.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/circuit_breaker.h"
+
+namespace wa { namespace storage { namespace core {
+
+    circuit_breaker::circuit_breaker()
+    {
+    }
+
+    circuit_breaker_settings circuit_breaker::settings() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings;
+    }
+
+    void circuit_breaker::set_settings(const circuit_breaker_settings& value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_settings = value;
+        if (m_settings.failure_threshold() == 0)
+        {
+            m_circuits.clear();
+        }
+    }
+
+    bool circuit_breaker::is_enabled() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings.failure_threshold() > 0;
+    }
+
+    bool circuit_breaker::try_admit(const utility::string_t& account, storage_location location)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_settings.failure_threshold() == 0)
+        {
+            return true;
+        }
+
+        auto iter = m_circuits.find(circuit_key(account, location));
+        if (iter == m_circuits.end() || iter->second.state == circuit_state::closed)
+        {
+            return true;
+        }
+
+        // A probe whose outcome was never recorded, such as one that could not be sent, is replaced by
+        // another once it has been out for as long as the circuit stays open
+        auto now = std::chrono::steady_clock::now();
+        circuit& value = iter->second;
+        if (now - value.changed < m_settings.open_duration())
+        {
+            return false;
+        }
+
+        value.state = circuit_state::half_open;
+        value.changed = now;
+        return true;
+    }
+
+    void circuit_breaker::record(const utility::string_t& account, storage_location location, bool failed)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_settings.failure_threshold() == 0)
+        {
+            return;
+        }
+
+        circuit_key key(account, location);
+        if (!failed)
+        {
+            // Only the probe is let through while the circuit is not closed, so its success closes it. A success
+            // recorded while the circuit is open is from a request sent before it opened, and leaves it open.
+            auto iter = m_circuits.find(key);
+            if (iter != m_circuits.end() && iter->second.state != circuit_state::open)
+            {
+                m_circuits.erase(iter);
+            }
+
+            return;
+        }
+
+        circuit& value = m_circuits[key];
+        switch (value.state)
+        {
+        case circuit_state::closed:
+            if (++value.failures >= m_settings.failure_threshold())
+            {
+                value.state = circuit_state::open;
+                value.changed = std::chrono::steady_clock::now();
+            }
+            break;
+
+        case circuit_state::half_open:
+            value.state = circuit_state::open;
+            value.changed = std::chrono::steady_clock::now();
+            break;
+
+        case circuit_state::open:
+            break;
+        }
+    }
+
+}}} // namespace wa::storage::core
@@ -19,44 +19,92 @@
 #include "was/blob.h"
 #include "wascore/protocol.h"
 #include "wascore/resources.h"
+#include "wascore/blob_attribute_cache.h"
+#include "wascore/blob_content_cache.h"
+#include "wascore/blob_listing_cache.h"
 #include "wascore/blobstreams.h"
+#include "wascore/request_coalescer.h"
 #include "wascore/util.h"
+#include "wascore/async_semaphore.h"
+#include "wascore/ordered_hash_stage.h"
 
 namespace wa { namespace storage {
 
+    namespace
+    {
+        // The result of a coalesced read, which is copied into the blob of each caller
+        struct coalesced_blob_read
+        {
+            cloud_blob_properties properties;
+            cloud_metadata metadata;
+            wa::storage::copy_state copy_state;
+            std::vector<uint8_t> body;
+        };
+
+        // Reads are only joined if they would send the same request, so the key has everything that goes into it
+        utility::string_t get_coalescing_key(const utility::string_t& method, const storage_uri& snapshot_qualified_uri, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options)
+        {
+            utility::ostringstream_t key;
+            key << U("blob\n") << method << U('\n') << snapshot_qualified_uri.primary_uri().to_string() << U('\n') << offset << U('\n') << length
+                << U('\n') << static_cast<int>(modified_options.location_mode()) << U('\n') << condition.lease_id()
+                << U('\n') << condition.if_match_etag() << U('\n') << condition.if_none_match_etag()
+                << U('\n') << condition.if_modified_since_time().to_interval() << U('\n') << condition.if_not_modified_since_time().to_interval();
+            return key.str();
+        }
+    }
+
     cloud_blob::cloud_blob(const storage_uri& uri)
-        : m_uri(uri), m_metadata(std::make_shared<cloud_metadata>()), m_properties(std::make_shared<cloud_blob_properties>()),
-        m_copy_state(std::make_shared<wa::storage::copy_state>())
+        : m_uri(uri), m_lazy_uri(false)
     {
+        set_shared_state(std::make_shared<shared_state>());
         init(utility::string_t(), storage_credentials());
     }
 
     cloud_blob::cloud_blob(const storage_uri& uri, const storage_credentials& credentials)
-        : m_uri(uri), m_metadata(std::make_shared<cloud_metadata>()), m_properties(std::make_shared<cloud_blob_properties>()),
-        m_copy_state(std::make_shared<wa::storage::copy_state>())
+        : m_uri(uri), m_lazy_uri(false)
     {
+        set_shared_state(std::make_shared<shared_state>());
         init(utility::string_t(), credentials);
     }
 
     cloud_blob::cloud_blob(const storage_uri& uri, const utility::string_t& snapshot_time, const storage_credentials& credentials)
-        : m_uri(uri), m_metadata(std::make_shared<cloud_metadata>()), m_properties(std::make_shared<cloud_blob_properties>()),
-        m_copy_state(std::make_shared<wa::storage::copy_state>())
+        : m_uri(uri), m_lazy_uri(false)
     {
+        set_shared_state(std::make_shared<shared_state>());
         init(snapshot_time, credentials);
     }
 
     cloud_blob::cloud_blob(const utility::string_t& name, const utility::string_t& snapshot_time, const cloud_blob_container& container)
-        : m_name(name), m_snapshot_time(snapshot_time), m_container(container), m_uri(core::append_path_to_uri(container.uri(), name)),
-        m_metadata(std::make_shared<cloud_metadata>()), m_properties(std::make_shared<cloud_blob_properties>()),
-        m_copy_state(std::make_shared<wa::storage::copy_state>())
+        : m_name(name), m_snapshot_time(snapshot_time), m_container(container), m_lazy_uri(true)
     {
+        set_shared_state(std::make_shared<shared_state>());
     }
 
     cloud_blob::cloud_blob(utility::string_t name, utility::string_t snapshot_time, const cloud_blob_container& container, cloud_blob_properties properties, cloud_metadata metadata, wa::storage::copy_state copy_state)
-        : m_name(std::move(name)), m_snapshot_time(std::move(snapshot_time)), m_container(container), m_uri(core::append_path_to_uri(container.uri(), name)),
-        m_metadata(std::make_shared<cloud_metadata>(std::move(metadata))), m_properties(std::make_shared<cloud_blob_properties>(std::move(properties))),
-        m_copy_state(std::make_shared<wa::storage::copy_state>(std::move(copy_state)))
+        : m_name(std::move(name)), m_snapshot_time(std::move(snapshot_time)), m_container(container), m_lazy_uri(true)
+    {
+        set_shared_state(std::make_shared<shared_state>(std::move(properties), std::move(metadata), std::move(copy_state)));
+    }
+
+    void cloud_blob::set_shared_state(std::shared_ptr<shared_state> state)
+    {
+        // The members point into the shared state, which they keep alive
+        m_properties = std::shared_ptr<cloud_blob_properties>(state, &state->properties);
+        m_metadata = std::shared_ptr<cloud_metadata>(state, &state->metadata);
+        m_copy_state = std::shared_ptr<wa::storage::copy_state>(state, &state->copy_state);
+        m_state = std::move(state);
+    }
+
+    const storage_uri& cloud_blob::lazy_uri() const
     {
+        // Copies of the blob share the state, so the URI is built once for all of them
+        const cloud_blob* instance = this;
+        std::call_once(m_state->uri_flag, [instance] ()
+        {
+            instance->m_state->uri = core::append_path_to_uri(instance->m_container.uri(), instance->m_name);
+        });
+
+        return m_state->uri;
     }
 
     void cloud_blob::init(const utility::string_t& snapshot_time, storage_credentials credentials)
@@ -87,7 +135,8 @@ namespace wa { namespace storage {
 
     storage_uri cloud_blob::snapshot_qualified_uri() const
     {
-        return storage_uri(add_snapshot_to_uri(m_uri.primary_uri(), m_snapshot_time), add_snapshot_to_uri(m_uri.secondary_uri(), m_snapshot_time));
+        const storage_uri& blob_uri = uri();
+        return storage_uri(add_snapshot_to_uri(blob_uri.primary_uri(), m_snapshot_time), add_snapshot_to_uri(blob_uri.secondary_uri(), m_snapshot_time));
     }
 
     cloud_blob_directory cloud_blob::get_parent_reference() const
@@ -113,7 +162,7 @@ namespace wa { namespace storage {
         utility::ostringstream_t resource_str;
         resource_str << U('/') << service_client().credentials().account_name() << U('/') << container().name() << U('/') << name();
 
-        return protocol::get_blob_sas_token(stored_policy_identifier, policy, headers, U("b"), resource_str.str(), service_client().credentials());
+        return protocol::get_blob_sas_token(stored_policy_identifier, policy, headers, U("b"), resource_str.str(), service_client().credentials(), service_client()._sas_cache());
     }
 
     pplx::task<concurrency::streams::istream> cloud_blob::open_read_async(const access_condition& condition, const blob_request_options& options, operation_context context)
@@ -122,6 +171,28 @@ namespace wa { namespace storage {
         modified_options.apply_defaults(service_client().default_request_options(), type(), false);
 
         auto instance = std::make_shared<cloud_blob>(*this);
+
+        // Other conditions have to be checked against the current attributes, so only a lease can be combined with cached ones
+        std::shared_ptr<core::blob_attribute_cache> cache = service_client()._attribute_cache();
+        if (cache != nullptr && cache->is_enabled() && !condition.is_conditional())
+        {
+            cloud_blob_properties properties;
+            cloud_metadata metadata;
+            wa::storage::copy_state copy_state;
+            bool is_fresh;
+            if (cache->try_get(core::blob_attribute_cache::get_key(uri(), snapshot_time()), properties, metadata, copy_state, is_fresh) && is_fresh)
+            {
+                *instance->m_properties = properties;
+                *instance->m_metadata = metadata;
+                *instance->m_copy_state = copy_state;
+
+                // The read is conditional on the cached ETag, so it fails instead of returning content that has changed since
+                auto modified_condition = wa::storage::access_condition::generate_if_match_condition(properties.etag());
+                modified_condition.set_lease_id(condition.lease_id());
+                return pplx::task_from_result(core::cloud_blob_istreambuf(instance, modified_condition, modified_options, context).create_istream());
+            }
+        }
+
         return instance->download_attributes_async(condition, modified_options, context).then([instance, condition, modified_options, context] () -> concurrency::streams::istream
         {
             auto modified_condition = wa::storage::access_condition::generate_if_match_condition(instance->properties().etag());
@@ -135,20 +206,72 @@ namespace wa { namespace storage {
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
+        std::shared_ptr<core::request_coalescer> coalescer = service_client().request_coalescer();
+        if (coalescer != nullptr && coalescer->is_enabled())
+        {
+            return download_attributes_coalesced_async(coalescer, condition, modified_options, context);
+        }
+
+        return download_attributes_impl_async(condition, modified_options, context);
+    }
+
+    pplx::task<void> cloud_blob::download_attributes_coalesced_async(std::shared_ptr<core::request_coalescer> coalescer, const access_condition& condition, const blob_request_options& modified_options, operation_context context)
+    {
+        auto blob = std::make_shared<cloud_blob>(*this);
+        utility::string_t key = get_coalescing_key(U("HEAD"), snapshot_qualified_uri(), -1, -1, condition, modified_options);
+        return coalescer->run_async<std::shared_ptr<const coalesced_blob_read>>(key, [blob, condition, modified_options, context] () -> pplx::task<std::shared_ptr<const coalesced_blob_read>>
+        {
+            return blob->download_attributes_impl_async(condition, modified_options, context).then([blob] () -> std::shared_ptr<const coalesced_blob_read>
+            {
+                auto read = std::make_shared<coalesced_blob_read>();
+                read->properties = blob->properties();
+                read->metadata = blob->metadata();
+                read->copy_state = blob->copy_state();
+                return read;
+            });
+        }).then([blob] (std::shared_ptr<const coalesced_blob_read> read)
+        {
+            *blob->m_properties = read->properties;
+            *blob->m_metadata = read->metadata;
+            *blob->m_copy_state = read->copy_state;
+        });
+    }
+
+    pplx::task<void> cloud_blob::download_attributes_impl_async(const access_condition& condition, const blob_request_options& modified_options, operation_context context)
+    {
         auto properties = m_properties;
         auto metadata = m_metadata;
         auto copy_state = m_copy_state;
 
+        std::shared_ptr<core::blob_attribute_cache> cache = service_client()._attribute_cache();
+        if (cache != nullptr && !cache->is_enabled())
+        {
+            cache.reset();
+        }
+
+        utility::string_t key = cache != nullptr ? core::blob_attribute_cache::get_key(uri(), snapshot_time()) : utility::string_t();
+        uint64_t read_invalidations = cache != nullptr ? cache->begin_read() : 0;
+
         auto command = std::make_shared<core::storage_command<void>>(uri());
         command->set_build_request(std::bind(protocol::get_blob_properties, snapshot_time(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_location_mode(core::command_location_mode::primary_or_secondary);
-        command->set_preprocess_response([properties, metadata, copy_state] (const web::http::http_response& response, operation_context context)
+        command->set_preprocess_response([properties, metadata, copy_state, cache, key, read_invalidations] (const web::http::http_response& response, operation_context context)
         {
+            if (cache != nullptr && response.status_code() == web::http::status_codes::NotFound)
+            {
+                cache->remove(key);
+            }
+
             protocol::preprocess_response(response, context);
             properties->update_all(protocol::blob_response_parsers::parse_blob_properties(response), false);
             *metadata = protocol::parse_metadata(response);
             *copy_state = protocol::blob_response_parsers::parse_copy_state(response);
+
+            if (cache != nullptr)
+            {
+                cache->put(key, *properties, *metadata, *copy_state, read_invalidations);
+            }
         });
         return core::executor<void>::execute_async(command, modified_options, context);
     }
@@ -156,6 +279,7 @@ namespace wa { namespace storage {
     pplx::task<void> cloud_blob::upload_metadata_async(const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
@@ -175,6 +299,7 @@ namespace wa { namespace storage {
     pplx::task<void> cloud_blob::upload_properties_async(const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
@@ -193,13 +318,19 @@ namespace wa { namespace storage {
 
     pplx::task<void> cloud_blob::delete_blob_async(delete_snapshots_option snapshots_option, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
+        auto instance = std::make_shared<cloud_blob>(*this);
         auto command = std::make_shared<core::storage_command<void>>(uri());
         command->set_build_request(std::bind(protocol::delete_blob, snapshots_option, snapshot_time(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response(std::bind(protocol::preprocess_response, std::placeholders::_1, std::placeholders::_2));
+        command->set_preprocess_response([instance] (const web::http::http_response& response, operation_context context)
+        {
+            instance->_remove_cached_listings();
+            protocol::preprocess_response(response, context);
+        });
         return core::executor<void>::execute_async(command, modified_options, context);
     }
 
@@ -208,37 +339,27 @@ namespace wa { namespace storage {
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
-        auto instance = std::make_shared<cloud_blob>(*this);
-        return exists_async(true, modified_options, context).then([instance, snapshots_option, condition, modified_options, context] (bool exists_result) -> pplx::task<bool>
+        // A blob in a container that does not exist does not exist either
+        return delete_blob_async(snapshots_option, condition, modified_options, context).then([] (pplx::task<void> delete_task) -> bool
         {
-            if (exists_result)
+            try
             {
-                return instance->delete_blob_async(snapshots_option, condition, modified_options, context).then([] (pplx::task<void> delete_task) -> bool
-                {
-                    try
-                    {
-                        delete_task.wait();
-                        return true;
-                    }
-                    catch (const storage_exception& e)
-                    {
-                        auto result = e.result();
-                        if (result.is_response_available() &&
-                            (result.http_status_code() == web::http::status_codes::NotFound) &&
-                            (result.extended_error().code() == protocol::error_code_blob_not_found))
-                        {
-                            return false;
-                        }
-                        else
-                        {
-                            throw;
-                        }
-                    }
-                });
+                delete_task.wait();
+                return true;
             }
-            else
+            catch (const storage_exception& e)
             {
-                return pplx::task_from_result(false);
+                auto result = e.result();
+                if (result.is_response_available() &&
+                    (result.http_status_code() == web::http::status_codes::NotFound) &&
+                    ((result.extended_error().code() == protocol::error_code_blob_not_found) || (result.extended_error().code() == protocol::error_code_container_not_found)))
+                {
+                    return false;
+                }
+                else
+                {
+                    throw;
+                }
             }
         });
     }
@@ -361,24 +482,620 @@ namespace wa { namespace storage {
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
+        std::shared_ptr<core::request_coalescer> coalescer = service_client().request_coalescer();
+        if (coalescer != nullptr && coalescer->is_enabled())
+        {
+            return download_coalesced_to_stream_async(coalescer, target, offset, length, condition, modified_options, context);
+        }
+
+        return download_range_to_stream_impl_async(target, offset, length, condition, modified_options, context);
+    }
+
+    pplx::task<void> cloud_blob::download_coalesced_to_stream_async(std::shared_ptr<core::request_coalescer> coalescer, concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context)
+    {
+        // The body is downloaded once into memory and then written to the target of each caller
+        auto blob = std::make_shared<cloud_blob>(*this);
+        utility::string_t key = get_coalescing_key(U("GET"), snapshot_qualified_uri(), offset, length, condition, modified_options);
+        return coalescer->run_async<std::shared_ptr<const coalesced_blob_read>>(key, [blob, offset, length, condition, modified_options, context] () -> pplx::task<std::shared_ptr<const coalesced_blob_read>>
+        {
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            return blob->download_range_to_stream_impl_async(buffer.create_ostream(), offset, length, condition, modified_options, context).then([blob, buffer] () mutable -> std::shared_ptr<const coalesced_blob_read>
+            {
+                auto read = std::make_shared<coalesced_blob_read>();
+                read->properties = blob->properties();
+                read->metadata = blob->metadata();
+                read->copy_state = blob->copy_state();
+                read->body = std::move(buffer.collection());
+                return read;
+            });
+        }).then([blob, target] (std::shared_ptr<const coalesced_blob_read> read) mutable -> pplx::task<void>
+        {
+            *blob->m_properties = read->properties;
+            *blob->m_metadata = read->metadata;
+            *blob->m_copy_state = read->copy_state;
+            if (read->body.empty())
+            {
+                return pplx::task_from_result();
+            }
+
+            return target.streambuf().putn(read->body.data(), read->body.size()).then([read] (size_t)
+            {
+            });
+        });
+    }
+
+    pplx::task<void> cloud_blob::download_range_to_stream_impl_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context)
+    {
+        // Only whole blobs are cached, and a condition other than a lease could not be combined with the cached ETag
+        if ((offset < 0) && (length < 0) && !condition.is_conditional())
+        {
+            std::shared_ptr<core::blob_content_cache> cache = service_client()._content_cache();
+            if (cache != nullptr && cache->is_enabled())
+            {
+                return download_cached_to_stream_async(cache, target, condition, modified_options, context);
+            }
+        }
+
+        // The service only returns a transactional MD5 or CRC64 for ranges of up to 4MB, so a larger download is split into ranges
+        bool use_transactional_hash = modified_options.use_transactional_md5() || modified_options.use_transactional_crc64();
+        bool fits_one_hashed_range = (offset >= 0) && (length >= 0) && (length <= static_cast<int64_t>(protocol::max_block_size));
+        if (((modified_options.parallelism_factor() > 1) && target.can_seek()) || (use_transactional_hash && !fits_one_hashed_range))
+        {
+            return download_parallel_ranges_to_stream_async(target, offset, length, condition, modified_options, context);
+        }
+
+        return download_single_range_to_stream_async(target, offset, length, condition, modified_options, context, true);
+    }
+
+    pplx::task<void> cloud_blob::download_cached_to_stream_async(std::shared_ptr<core::blob_content_cache> cache, concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& modified_options, operation_context context)
+    {
+        utility::string_t key = core::blob_content_cache::get_key(snapshot_qualified_uri());
+        uint64_t read_invalidations = cache->begin_read();
+        auto max_blob_size = static_cast<int64_t>(cache->settings().max_blob_size_in_bytes());
+        auto blob = std::make_shared<cloud_blob>(*this);
+
+        return cache->get_async(key).then([blob, cache, key, read_invalidations, max_blob_size, target, condition, modified_options, context] (std::shared_ptr<const core::blob_content_cache::content> cached) -> pplx::task<void>
+        {
+            auto properties = blob->m_properties;
+            auto metadata = blob->m_metadata;
+            auto copy_state = blob->m_copy_state;
+            auto not_modified = std::make_shared<bool>(false);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+
+            // As much as a cached blob can hold is requested, so that a larger blob is not kept in memory as a whole
+            access_condition request_condition(condition);
+            if (cached != nullptr)
+            {
+                request_condition.set_if_none_match_etag(cached->etag);
+            }
+
+            auto command = std::make_shared<core::storage_command<void>>(blob->uri());
+            auto snapshot = blob->snapshot_time();
+            command->set_build_request([max_blob_size, snapshot, request_condition] (web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) -> web::http::http_request
+            {
+                return protocol::get_blob(0, max_blob_size, false, false, snapshot, request_condition, uri_builder, timeout, context);
+            });
+            command->set_authentication_handler(blob->service_client().authentication_handler());
+            command->set_location_mode(core::command_location_mode::primary_or_secondary);
+            command->set_destination_stream(buffer.create_ostream());
+            command->set_recover_request([buffer] (utility::size64_t, operation_context) mutable -> bool
+            {
+                buffer.collection().clear();
+                buffer.seekpos(0, std::ios_base::out);
+                return true;
+            });
+            command->set_preprocess_response([properties, metadata, copy_state, cached, not_modified] (const web::http::http_response& response, operation_context context)
+            {
+                if ((cached != nullptr) && (response.status_code() == web::http::status_codes::NotModified))
+                {
+                    *not_modified = true;
+                    if (cached->has_attributes)
+                    {
+                        *properties = cached->properties;
+                        *metadata = cached->metadata;
+                        *copy_state = cached->copy;
+                    }
+                    else
+                    {
+                        properties->update_etag_and_last_modified(protocol::blob_response_parsers::parse_blob_properties(response));
+                    }
+
+                    return;
+                }
+
+                protocol::preprocess_response(response, context);
+                properties->update_all(protocol::blob_response_parsers::parse_blob_properties(response), true);
+                *metadata = protocol::parse_metadata(response);
+                *copy_state = protocol::blob_response_parsers::parse_copy_state(response);
+            });
+
+            return core::executor<void>::execute_async(command, modified_options, context).then([blob, cache, key, read_invalidations, cached, not_modified, buffer, target, condition, modified_options, context] (pplx::task<void> download_task) mutable -> pplx::task<void>
+            {
+                try
+                {
+                    download_task.wait();
+                }
+                catch (const storage_exception& e)
+                {
+                    auto status_code = e.result().http_status_code();
+                    if (status_code == web::http::status_codes::NotFound)
+                    {
+                        cache->remove(key);
+                    }
+                    else if (status_code == web::http::status_codes::RangeNotSatisfiable)
+                    {
+                        // An empty blob has no range to download, so it is downloaded as a whole without being cached
+                        return blob->download_single_range_to_stream_async(target, -1, -1, condition, modified_options, context, true);
+                    }
+
+                    throw;
+                }
+
+                // Only complete blobs are cached, so a content that has not changed is always complete
+                std::shared_ptr<const std::vector<uint8_t>> body;
+                bool is_complete = true;
+                if (*not_modified)
+                {
+                    body = cached->body;
+                    if (!cached->has_attributes)
+                    {
+                        cache->put(key, cached, read_invalidations, false);
+                    }
+                }
+                else
+                {
+                    auto downloaded = std::make_shared<std::vector<uint8_t>>(std::move(buffer.collection()));
+                    body = downloaded;
+                    is_complete = blob->properties().size() <= downloaded->size();
+                    if (is_complete)
+                    {
+                        auto value = std::make_shared<core::blob_content_cache::content>();
+                        value->etag = blob->properties().etag();
+                        value->body = downloaded;
+                        value->has_attributes = true;
+                        value->properties = blob->properties();
+                        value->metadata = blob->metadata();
+                        value->copy = blob->copy_state();
+                        cache->put(key, value, read_invalidations, true);
+                    }
+                }
+
+                return target.streambuf().putn(body->data(), body->size()).then([blob, body, is_complete, target, condition, modified_options, context] (size_t) -> pplx::task<void>
+                {
+                    if (is_complete)
+                    {
+                        return pplx::task_from_result();
+                    }
+
+                    // The blob is too large to be cached, so the rest of it is downloaded straight into the target
+                    access_condition rest_condition(wa::storage::access_condition::generate_if_match_condition(blob->properties().etag()));
+                    rest_condition.set_lease_id(condition.lease_id());
+                    return blob->download_single_range_to_stream_async(target, static_cast<int64_t>(body->size()), -1, rest_condition, modified_options, context, false);
+                });
+            });
+        });
+    }
+
+    pplx::task<void> cloud_blob::download_parallel_ranges_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context)
+    {
+        auto range_size = static_cast<int64_t>(modified_options.stream_read_size_in_bytes());
+        if ((modified_options.use_transactional_md5() || modified_options.use_transactional_crc64()) && (range_size > static_cast<int64_t>(protocol::max_block_size)))
+        {
+            // The service only returns a transactional MD5 or CRC64 for ranges of up to 4MB
+            range_size = static_cast<int64_t>(protocol::max_block_size);
+        }
+
+        auto start_offset = offset >= 0 ? offset : 0;
+        auto first_length = ((length >= 0) && (length < range_size)) ? length : range_size;
+        auto target_offset = target.can_seek() ? target.tell() : 0;
+        auto properties = m_properties;
+        cloud_blob blob(*this);
+
+        // A download of the whole blob is checked against the blob MD5 like a single request would be,
+        // and for that the first range is buffered too, as it has to be hashed before the others
+        bool validate_blob_md5 = (offset < 0) && (length < 0) && !modified_options.disable_content_md5_validation();
+        concurrency::streams::container_buffer<std::vector<uint8_t>> first_buffer;
+        auto first_target = validate_blob_md5 ? first_buffer.create_ostream() : target;
+
+        // The first range is downloaded on its own, which also retrieves the size and
+        // the ETag of the blob needed to split the rest of it into ranges.
+        return download_single_range_to_stream_async(first_target, start_offset, first_length, condition, modified_options, context, true).then([blob, target, target_offset, offset, length, start_offset, first_length, range_size, properties, validate_blob_md5, first_buffer, condition, modified_options, context] (pplx::task<void> first_range_task) -> pplx::task<void>
+        {
+            try
+            {
+                first_range_task.wait();
+            }
+            catch (const storage_exception& e)
+            {
+                // An empty blob has no range to download, so fall back to downloading it as a whole
+                if ((offset < 0) && (e.result().http_status_code() == web::http::status_codes::RangeNotSatisfiable))
+                {
+                    if (target.can_seek())
+                    {
+                        target.seek(target_offset);
+                    }
+
+                    return blob.download_single_range_to_stream_async(target, -1, -1, condition, modified_options, context, true);
+                }
+
+                throw;
+            }
+
+            auto end_offset = static_cast<int64_t>(properties->size());
+            if ((length >= 0) && (start_offset + length < end_offset))
+            {
+                end_offset = start_offset + length;
+            }
+
+            auto next_offset = std::make_shared<int64_t>(start_offset + first_length);
+
+            // Ranges complete in any order while the MD5 has to see them in order, so they are reordered before being hashed. Twice as much
+            // data as the ranges in flight may wait to be hashed, which keeps new ranges starting while the oldest one is still outstanding.
+            std::shared_ptr<core::ordered_hash_stage> blob_hash;
+            pplx::task<void> first_write_task = pplx::task_from_result();
+            if (validate_blob_md5)
+            {
+                if (!properties->content_md5().empty())
+                {
+                    auto window_size = static_cast<utility::size64_t>(range_size) * static_cast<utility::size64_t>(modified_options.parallelism_factor()) * 2;
+                    blob_hash = std::make_shared<core::ordered_hash_stage>(core::hash_md5_streambuf(), 0, window_size);
+                    blob_hash->add(0, first_buffer);
+                }
+
+                first_write_task = target.streambuf().putn(first_buffer.collection().data(), first_buffer.collection().size()).then([] (size_t)
+                {
+                });
+            }
+
+            return first_write_task.then([blob, target, target_offset, start_offset, end_offset, range_size, next_offset, properties, blob_hash, condition, modified_options, context] () -> pplx::task<void>
+            {
+                if (*next_offset >= end_offset)
+                {
+                    return pplx::task_from_result();
+                }
+
+                // All remaining ranges must come from the same version of the blob as the first one
+                access_condition range_condition(condition);
+                if (range_condition.if_match_etag().empty())
+                {
+                    range_condition.set_if_match_etag(properties->etag());
+                }
+
+                core::async_semaphore semaphore(modified_options.parallelism_factor());
+                core::async_semaphore write_lock(1);
+                auto range_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+                auto failed = std::make_shared<std::atomic<bool>>(false);
+
+                // A target that cannot seek is written to in order, each range after the one before it
+                bool sequential_writes = !target.can_seek();
+                auto last_range_task = std::make_shared<pplx::task<void>>(pplx::task_from_result());
+
+                return pplx::details::do_while([blob, target, target_offset, start_offset, end_offset, range_size, next_offset, blob_hash, range_condition, modified_options, context, semaphore, write_lock, sequential_writes, last_range_task, range_tasks, failed] () mutable -> pplx::task<bool>
+                {
+                    return semaphore.lock_async().then([blob_hash, next_offset, range_size, end_offset] () -> pplx::task<void>
+                    {
+                        // A range is only started once it fits in the reorder window of the hash
+                        if (!blob_hash)
+                        {
+                            return pplx::task_from_result();
+                        }
+
+                        return blob_hash->reserve_async(static_cast<utility::size64_t>(std::min(*next_offset + range_size, end_offset)));
+                    }).then([blob, target, target_offset, start_offset, end_offset, range_size, next_offset, blob_hash, range_condition, modified_options, context, semaphore, write_lock, sequential_writes, last_range_task, range_tasks, failed] () mutable -> bool
+                    {
+                        if (*failed)
+                        {
+                            semaphore.unlock();
+                            return false;
+                        }
+
+                        auto range_offset = *next_offset;
+                        auto range_length = std::min(range_size, end_offset - range_offset);
+                        *next_offset += range_length;
+
+                        // Each range is buffered and then written at its own position in the target,
+                        // one write at a time since the target is shared.
+                        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                        auto previous_range_task = *last_range_task;
+                        auto range_task = blob.download_single_range_to_stream_async(buffer.create_ostream(), range_offset, range_length, range_condition, modified_options, context, false).then([target, target_offset, start_offset, range_offset, range_length, buffer, blob_hash, write_lock, sequential_writes, previous_range_task] () mutable -> pplx::task<void>
+                        {
+                            auto write_ready = sequential_writes ? previous_range_task : write_lock.lock_async();
+                            return write_ready.then([target, target_offset, start_offset, range_offset, buffer, sequential_writes] () -> pplx::task<size_t>
+                            {
+                                auto target_buffer = target.streambuf();
+                                if (!sequential_writes)
+                                {
+                                    target_buffer.seekpos(target_offset + (range_offset - start_offset), std::ios_base::out);
+                                }
+
+                                return target_buffer.putn(buffer.collection().data(), buffer.collection().size());
+                            }).then([buffer, range_offset, range_length, blob_hash, write_lock, sequential_writes] (pplx::task<size_t> write_task) mutable
+                            {
+                                if (!sequential_writes)
+                                {
+                                    write_lock.unlock();
+                                }
+
+                                if (write_task.get() != static_cast<size_t>(range_length))
+                                {
+                                    throw storage_exception(utility::conversions::to_utf8string(protocol::error_incorrect_length));
+                                }
+
+                                if (blob_hash)
+                                {
+                                    blob_hash->add(static_cast<utility::size64_t>(range_offset), buffer);
+                                }
+                            });
+                        });
+
+                        range_task.then([semaphore, failed, blob_hash] (pplx::task<void> completed_task) mutable
+                        {
+                            try
+                            {
+                                completed_task.wait();
+                            }
+                            catch (...)
+                            {
+                                *failed = true;
+
+                                // Ranges waiting for the reorder window would otherwise wait for a range that never arrives
+                                if (blob_hash)
+                                {
+                                    blob_hash->cancel();
+                                }
+                            }
+
+                            semaphore.unlock();
+                        });
+
+                        range_tasks->push_back(range_task);
+                        *last_range_task = range_task;
+                        return *next_offset < end_offset;
+                    });
+                }).then([semaphore, range_tasks, target, target_offset, start_offset, end_offset] (bool) mutable -> pplx::task<void>
+                {
+                    return semaphore.wait_all_async().then([range_tasks, target, target_offset, start_offset, end_offset] ()
+                    {
+                        // Rethrow the first failure, if any
+                        for (auto iter = range_tasks->begin(); iter != range_tasks->end(); ++iter)
+                        {
+                            iter->get();
+                        }
+
+                        if (target.can_seek())
+                        {
+                            target.seek(target_offset + (end_offset - start_offset));
+                        }
+                    });
+                });
+            }).then([blob_hash, properties, end_offset] () -> pplx::task<void>
+            {
+                if (!blob_hash)
+                {
+                    return pplx::task_from_result();
+                }
+
+                return blob_hash->finish_async(static_cast<utility::size64_t>(end_offset)).then([properties] (std::vector<unsigned char> hash)
+                {
+                    if (properties->content_md5() != utility::conversions::to_base64(hash))
+                    {
+                        throw storage_exception(utility::conversions::to_utf8string(protocol::error_md5_mismatch));
+                    }
+                });
+            });
+        });
+    }
+
+    pplx::task<size_t> cloud_blob::download_range_to_buffer_async(uint8_t* buffer, size_t length, int64_t offset, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        if ((buffer == nullptr) && (length > 0))
+        {
+            throw std::invalid_argument("buffer");
+        }
+
+        if (offset < 0)
+        {
+            throw std::invalid_argument("offset");
+        }
+
+        if (length == 0)
+        {
+            return pplx::task_from_result<size_t>(0);
+        }
+
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
+
+        auto range_size = static_cast<int64_t>(modified_options.stream_read_size_in_bytes());
+        if ((modified_options.use_transactional_md5() || modified_options.use_transactional_crc64()) && (range_size > static_cast<int64_t>(protocol::max_block_size)))
+        {
+            // The service only returns a transactional MD5 or CRC64 for ranges of up to 4MB
+            range_size = static_cast<int64_t>(protocol::max_block_size);
+        }
+
+        // A range larger than the service returns a transactional hash for is split even without parallelism
+        auto total_length = static_cast<int64_t>(length);
+        bool split_ranges = (modified_options.parallelism_factor() > 1) || modified_options.use_transactional_md5() || modified_options.use_transactional_crc64();
+        auto first_length = (split_ranges && (range_size < total_length)) ? range_size : total_length;
+        auto properties = m_properties;
+        cloud_blob blob(*this);
+
+        // The first range is downloaded on its own, which also retrieves the size and the ETag of the blob needed to
+        // split the rest of it into ranges. Every range is read through a stream over its own part of the buffer.
+        auto first_target = concurrency::streams::rawptr_stream<uint8_t>::open_ostream(buffer, static_cast<size_t>(first_length));
+        return download_single_range_to_stream_async(first_target, offset, first_length, condition, modified_options, context, true).then([blob, buffer, offset, total_length, first_target, first_length, range_size, properties, condition, modified_options, context] (pplx::task<void> first_range_task) -> pplx::task<size_t>
+        {
+            try
+            {
+                first_range_task.wait();
+            }
+            catch (const storage_exception& e)
+            {
+                // The range starts at or after the end of the blob, so there is nothing to download
+                if (e.result().http_status_code() == web::http::status_codes::RangeNotSatisfiable)
+                {
+                    return pplx::task_from_result<size_t>(0);
+                }
+
+                throw;
+            }
+
+            auto first_written = static_cast<int64_t>(first_target.tell());
+            auto end_offset = std::min(offset + total_length, static_cast<int64_t>(properties->size()));
+            auto next_offset = std::make_shared<int64_t>(offset + first_length);
+            if ((first_written < first_length) || (*next_offset >= end_offset))
+            {
+                return pplx::task_from_result(static_cast<size_t>(first_written));
+            }
+
+            // All remaining ranges must come from the same version of the blob as the first one
+            access_condition range_condition(condition);
+            if (range_condition.if_match_etag().empty())
+            {
+                range_condition.set_if_match_etag(properties->etag());
+            }
+
+            core::async_semaphore semaphore(modified_options.parallelism_factor());
+            auto range_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+            auto failed = std::make_shared<std::atomic<bool>>(false);
+
+            return pplx::details::do_while([blob, buffer, offset, end_offset, range_size, next_offset, range_condition, modified_options, context, semaphore, range_tasks, failed] () mutable -> pplx::task<bool>
+            {
+                return semaphore.lock_async().then([blob, buffer, offset, end_offset, range_size, next_offset, range_condition, modified_options, context, semaphore, range_tasks, failed] () mutable -> bool
+                {
+                    if (*failed)
+                    {
+                        semaphore.unlock();
+                        return false;
+                    }
+
+                    auto range_offset = *next_offset;
+                    auto range_length = std::min(range_size, end_offset - range_offset);
+                    *next_offset += range_length;
+
+                    // The ranges do not share a stream, so they are written as they arrive without any locking
+                    auto target = concurrency::streams::rawptr_stream<uint8_t>::open_ostream(buffer + (range_offset - offset), static_cast<size_t>(range_length));
+                    auto range_task = blob.download_single_range_to_stream_async(target, range_offset, range_length, range_condition, modified_options, context, false).then([target, range_length] (pplx::task<void> download_task)
+                    {
+                        download_task.wait();
+                        if (static_cast<int64_t>(target.tell()) != range_length)
+                        {
+                            throw storage_exception(utility::conversions::to_utf8string(protocol::error_incorrect_length));
+                        }
+                    });
+
+                    range_task.then([semaphore, failed] (pplx::task<void> completed_task) mutable
+                    {
+                        try
+                        {
+                            completed_task.wait();
+                        }
+                        catch (...)
+                        {
+                            *failed = true;
+                        }
+
+                        semaphore.unlock();
+                    });
+
+                    range_tasks->push_back(range_task);
+                    return *next_offset < end_offset;
+                });
+            }).then([semaphore, range_tasks, offset, end_offset] (bool) mutable -> pplx::task<size_t>
+            {
+                return semaphore.wait_all_async().then([range_tasks, offset, end_offset] () -> size_t
+                {
+                    // Rethrow the first failure, if any
+                    for (auto iter = range_tasks->begin(); iter != range_tasks->end(); ++iter)
+                    {
+                        iter->get();
+                    }
+
+                    return static_cast<size_t>(end_offset - offset);
+                });
+            });
+        });
+    }
+
+    pplx::task<void> cloud_blob::download_single_range_to_stream_async(concurrency::streams::ostream target, int64_t offset, int64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context, bool update_properties)
+    {
         auto properties = m_properties;
         auto metadata = m_metadata;
         auto copy_state = m_copy_state;
         auto target_offset = target.can_seek() ? target.tell() : 0;
         auto response_md5 = std::make_shared<utility::string_t>();
+        auto response_crc64 = std::make_shared<utility::string_t>();
         auto response_length = std::make_shared<utility::size64_t>(protocol::invalid_size64_t);
 
+        // Keeps track of how much of the range reached the target across attempts, so that
+        // a retry after a failure in the middle of the body only requests the remaining bytes
+        struct download_state
+        {
+            utility::size64_t total_written;
+            utility::string_t etag;
+            bool receiving_body;
+        };
+
+        auto state = std::make_shared<download_state>();
+        state->total_written = 0;
+        state->receiving_body = false;
+
+        auto use_transactional_md5 = modified_options.use_transactional_md5();
+        auto use_transactional_crc64 = modified_options.use_transactional_crc64();
+        auto snapshot = snapshot_time();
+
         auto command = std::make_shared<core::storage_command<void>>(uri());
-        command->set_build_request(std::bind(protocol::get_blob, offset, length, modified_options.use_transactional_md5(), snapshot_time(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        command->set_build_request([offset, length, use_transactional_md5, use_transactional_crc64, snapshot, condition, state] (web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) -> web::http::http_request
+        {
+            if (state->total_written == 0)
+            {
+                return protocol::get_blob(offset, length, use_transactional_md5, use_transactional_crc64, snapshot, condition, uri_builder, timeout, context);
+            }
+
+            // Resume right after the last byte received, from the same version of the blob
+            access_condition resume_condition(condition);
+            if (resume_condition.if_match_etag().empty())
+            {
+                resume_condition.set_if_match_etag(state->etag);
+            }
+
+            auto written = static_cast<int64_t>(state->total_written);
+            auto resume_offset = (offset >= 0 ? offset : 0) + written;
+            auto resume_length = length >= 0 ? length - written : -1;
+
+            // The MD5 of a whole blob cannot be requested for a part of it, and a CRC64 is only returned for ranges
+            return protocol::get_blob(resume_offset, resume_length, use_transactional_md5 && (offset >= 0), use_transactional_crc64 && (offset >= 0), snapshot, resume_condition, uri_builder, timeout, context);
+        });
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_location_mode(core::command_location_mode::primary_or_secondary);
         command->set_destination_stream(target);
         command->set_calculate_response_body_md5(!modified_options.disable_content_md5_validation());
-        command->set_recover_request([target, target_offset] (operation_context context) -> bool
+        command->set_calculate_response_body_crc64(use_transactional_crc64 && (offset >= 0));
+        command->set_recover_request([target, target_offset, state] (utility::size64_t bytes_written, operation_context context) -> bool
         {
-            // TODO support resume
+            if (state->receiving_body && !state->etag.empty())
+            {
+                // The attempt failed while the body was being received, so everything
+                // written so far is valid content and only the rest needs to be downloaded
+                state->total_written += bytes_written;
+                state->receiving_body = false;
+                if (target.can_seek())
+                {
+                    target.seek(target_offset + static_cast<int64_t>(state->total_written));
+                }
+
+                return true;
+            }
+
+            if (bytes_written == 0)
+            {
+                return true;
+            }
+
+            // An error body or content that failed validation was written, so the range has to be downloaded again
             if (target.can_seek())
             {
+                state->total_written = 0;
                 target.seek(target_offset);
                 return true;
             }
@@ -387,30 +1104,94 @@ namespace wa { namespace storage {
                 return false;
             }
         });
-        command->set_preprocess_response([modified_options, properties, metadata, copy_state, offset, response_md5, response_length] (const web::http::http_response& response, operation_context context)
+        command->set_preprocess_response([modified_options, properties, metadata, copy_state, offset, response_md5, response_crc64, response_length, update_properties, state] (const web::http::http_response& response, operation_context context)
         {
             protocol::preprocess_response(response, context);
-            properties->update_all(protocol::blob_response_parsers::parse_blob_properties(response), offset >= 0);
-            *metadata = protocol::parse_metadata(response);
-            *copy_state = protocol::blob_response_parsers::parse_copy_state(response);
+
+            bool resumed = state->total_written > 0;
+            if (update_properties && (offset >= 0) && !modified_options.update_attributes_on_range_read())
+            {
+                // The other attributes are known already, so the headers are not parsed into them
+                properties->m_etag = protocol::parse_etag(response);
+            }
+            else if (update_properties)
+            {
+                properties->update_all(protocol::blob_response_parsers::parse_blob_properties(response), (offset >= 0) || resumed);
+
+                // The Content-MD5 of a range is its own, but the MD5 of the whole blob is returned with it in a separate header
+                auto blob_md5 = protocol::get_header_value(response, protocol::ms_header_blob_content_md5);
+                if ((offset >= 0) && !blob_md5.empty())
+                {
+                    properties->m_content_md5 = blob_md5;
+                }
+
+                *metadata = protocol::parse_metadata(response);
+                *copy_state = protocol::blob_response_parsers::parse_copy_state(response);
+            }
             
             *response_md5 = protocol::get_header_value(response, web::http::header_names::content_md5);
             
-            if (modified_options.use_transactional_md5() && !modified_options.disable_content_md5_validation() && response_md5->empty())
+            if (modified_options.use_transactional_md5() && !modified_options.disable_content_md5_validation() && response_md5->empty() && ((offset >= 0) || !resumed))
             {
                 throw storage_exception(utility::conversions::to_utf8string(protocol::error_missing_md5));
             }
 
+            *response_crc64 = protocol::get_header_value(response, protocol::ms_header_content_crc64);
+            if (modified_options.use_transactional_crc64() && response_crc64->empty() && (offset >= 0))
+            {
+                throw storage_exception(utility::conversions::to_utf8string(protocol::error_missing_crc64));
+            }
+
             *response_length = response.headers().content_length();
+
+            if (!resumed)
+            {
+                state->etag = protocol::parse_etag(response);
+            }
+
+            state->receiving_body = true;
         });
-        command->set_postprocess_response([response_md5, response_length] (const web::http::http_response& response, const request_result&, const core::ostream_descriptor& descriptor, operation_context context) -> pplx::task<void>
+        auto progress = modified_options.transfer_progress();
+        command->set_postprocess_response([response_md5, response_crc64, response_length, state, progress] (const web::http::http_response& response, const request_result&, const core::ostream_descriptor& descriptor, operation_context context) -> pplx::task<void>
         {
+            state->receiving_body = false;
             protocol::check_stream_length_and_md5(*response_length, *response_md5, descriptor);
+            protocol::check_stream_crc64(*response_crc64, descriptor);
+
+            // The range includes what earlier attempts received before they failed
+            if (progress)
+            {
+                progress->_add(state->total_written + descriptor.length());
+            }
+
             return pplx::task_from_result();
         });
         return core::executor<void>::execute_async(command, modified_options, context);
     }
 
+    pplx::task<void> cloud_blob::download_to_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        auto instance = std::make_shared<cloud_blob>(*this);
+        return download_attributes_async(condition, options, context).then([instance, path, condition, options, context] () -> pplx::task<void>
+        {
+            // The file is sized from the properties just read, so the content must not change afterwards
+            access_condition download_condition(condition);
+            if (download_condition.if_match_etag().empty())
+            {
+                download_condition.set_if_match_etag(instance->properties().etag());
+            }
+
+            auto file = core::mapped_file::create(path, instance->properties().size());
+            auto target = concurrency::streams::rawptr_stream<uint8_t>::open_ostream(file->data(), file->size());
+            return instance->download_to_stream_async(target, download_condition, options, context).then([file, target] (pplx::task<void> download_task) mutable
+            {
+                target.close().wait();
+                download_task.wait();
+                file->flush();
+            });
+        });
+    }
+
     pplx::task<bool> cloud_blob::exists_async(bool primary_only, const blob_request_options& options, operation_context context)
     {
         blob_request_options modified_options(options);
@@ -420,14 +1201,28 @@ namespace wa { namespace storage {
         auto metadata = m_metadata;
         auto copy_state = m_copy_state;
 
+        std::shared_ptr<core::blob_attribute_cache> cache = service_client()._attribute_cache();
+        if (cache != nullptr && !cache->is_enabled())
+        {
+            cache.reset();
+        }
+
+        utility::string_t key = cache != nullptr ? core::blob_attribute_cache::get_key(uri(), snapshot_time()) : utility::string_t();
+        uint64_t read_invalidations = cache != nullptr ? cache->begin_read() : 0;
+
         auto command = std::make_shared<core::storage_command<bool>>(uri());
         command->set_build_request(std::bind(protocol::get_blob_properties, snapshot_time(), access_condition(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_location_mode(primary_only ? core::command_location_mode::primary_only : core::command_location_mode::primary_or_secondary);
-        command->set_preprocess_response([properties, metadata, copy_state] (const web::http::http_response& response, operation_context context) -> bool
+        command->set_preprocess_response([properties, metadata, copy_state, cache, key, read_invalidations] (const web::http::http_response& response, operation_context context) -> bool
         {
             if (response.status_code() == web::http::status_codes::NotFound)
             {
+                if (cache != nullptr)
+                {
+                    cache->remove(key);
+                }
+
                 return false;
             }
 
@@ -435,6 +1230,12 @@ namespace wa { namespace storage {
             properties->update_all(protocol::blob_response_parsers::parse_blob_properties(response), false);
             *metadata = protocol::parse_metadata(response);
             *copy_state = protocol::blob_response_parsers::parse_copy_state(response);
+
+            if (cache != nullptr)
+            {
+                cache->put(key, *properties, *metadata, *copy_state, read_invalidations);
+            }
+
             return true;
         });
         return core::executor<bool>::execute_async(command, modified_options, context);
@@ -443,17 +1244,20 @@ namespace wa { namespace storage {
     pplx::task<utility::string_t> cloud_blob::start_copy_from_blob_async(const web::http::uri& source, const access_condition& source_condition, const access_condition& destination_condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
         auto properties = m_properties;
         auto copy_state = m_copy_state;
+        auto instance = std::make_shared<cloud_blob>(*this);
 
         auto command = std::make_shared<core::storage_command<utility::string_t>>(uri());
         command->set_build_request(std::bind(protocol::copy_blob, source, source_condition, metadata(), destination_condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response([properties, copy_state] (const web::http::http_response& response, operation_context context) -> utility::string_t
+        command->set_preprocess_response([instance, properties, copy_state] (const web::http::http_response& response, operation_context context) -> utility::string_t
         {
+            instance->_remove_cached_listings();
             protocol::preprocess_response(response, context);
             properties->update_etag_and_last_modified(protocol::blob_response_parsers::parse_blob_properties(response));
             auto new_state = protocol::blob_response_parsers::parse_copy_state(response);
@@ -474,6 +1278,7 @@ namespace wa { namespace storage {
     pplx::task<void> cloud_blob::abort_copy_async(const utility::string_t& copy_id, const access_condition& condition, const blob_request_options& options, operation_context context) const
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
@@ -509,6 +1314,29 @@ namespace wa { namespace storage {
         return core::executor<cloud_blob>::execute_async(command, modified_options, context);
     }
 
+    void cloud_blob::_remove_cached_attributes() const
+    {
+        // Removing the attributes also stops a read already in flight from storing what it read before the change
+        std::shared_ptr<core::blob_attribute_cache> cache = service_client()._attribute_cache();
+        if (cache != nullptr && cache->is_enabled())
+        {
+            cache->remove(core::blob_attribute_cache::get_key(uri(), snapshot_time()));
+        }
+
+        _remove_cached_listings();
+    }
+
+    void cloud_blob::_remove_cached_listings() const
+    {
+        // Writes that add or remove a blob also remove the listings again once the service has answered, so that a listing
+        // made while the write was in flight is not kept
+        std::shared_ptr<core::blob_listing_cache> cache = service_client()._listing_cache();
+        if (cache != nullptr && cache->is_enabled())
+        {
+            cache->remove_blob(container().uri(), name());
+        }
+    }
+
     void cloud_blob::assert_no_snapshot() const
     {
         if (!m_snapshot_time.empty())
@@ -19,9 +19,47 @@
 #include "was/blob.h"
 #include "wascore/protocol.h"
 #include "wascore/protocol_xml.h"
+#include "wascore/blob_attribute_cache.h"
+#include "wascore/blob_content_cache.h"
+#include "wascore/blob_listing_cache.h"
+#include "wascore/block_buffer_pool.h"
+#include "wascore/memory_budget.h"
+#include "wascore/resources.h"
+#include "wascore/sas_cache.h"
+#include "wascore/upload_tuner.h"
+#include "wascore/util.h"
 
 namespace wa { namespace storage {
 
+    void cloud_blob_client::initialize()
+    {
+        set_authentication_scheme(authentication_scheme::shared_key);
+        m_default_request_options._set_http_client_pool(http_client_pool());
+        m_default_request_options._set_location_selector(location_selector());
+        m_default_request_options._set_retry_budget(retry_budget());
+        m_default_request_options._set_latency_recorder(latency_recorder());
+        m_default_request_options._set_prepared_requests(prepared_requests());
+        m_default_request_options._set_existence_cache(existence_cache());
+        m_default_request_options._set_operation_dispatcher(operation_dispatcher());
+        m_default_request_options._set_circuit_breaker(circuit_breaker());
+        set_service_name(U("blob"));
+        set_block_buffer_pool_size(protocol::default_block_buffer_pool_size);
+        m_delimiter = protocol::directory_delimiter;
+        m_attribute_cache = std::make_shared<core::blob_attribute_cache>();
+        m_listing_cache = std::make_shared<core::blob_listing_cache>();
+        m_content_cache = std::make_shared<core::blob_content_cache>();
+        m_default_request_options._set_upload_tuner(std::make_shared<core::upload_tuner>());
+    }
+
+    pplx::task<std::vector<cloud_blob_container>> cloud_blob_client::list_containers_async(const utility::string_t& prefix, const container_listing_includes& includes, const blob_request_options& options, operation_context context) const
+    {
+        auto client = *this;
+        return core::list_all_segments_async<cloud_blob_container, container_result_segment>([client, prefix, includes, options, context] (const continuation_token& token) -> pplx::task<container_result_segment>
+        {
+            return client.list_containers_segmented_async(prefix, includes, 0, token, options, context);
+        });
+    }
+
     pplx::task<container_result_segment> cloud_blob_client::list_containers_segmented_async(const utility::string_t& prefix, const container_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
     {
         blob_request_options modified_options(options);
@@ -33,6 +71,7 @@ namespace wa { namespace storage {
         command->set_build_request(std::bind(protocol::list_containers, prefix, includes, max_results, current_token, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(authentication_handler());
         command->set_location_mode(core::command_location_mode::primary_or_secondary, current_token.target_location());
+        command->set_accept_compressed_response(true);
         command->set_preprocess_response(std::bind(protocol::preprocess_response<container_result_segment>, container_result_segment(), std::placeholders::_1, std::placeholders::_2));
         command->set_postprocess_response([client] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<container_result_segment>
         {
@@ -101,6 +140,108 @@ namespace wa { namespace storage {
         return cloud_blob_container(container_name, *this);
     }
 
+    size_t cloud_blob_client::block_buffer_pool_size() const
+    {
+        auto pool = m_default_request_options._block_buffer_pool();
+        return pool ? pool->max_buffers() : 0;
+    }
+
+    void cloud_blob_client::set_block_buffer_pool_size(size_t value)
+    {
+        // Buffers still held by streams of the previous pool are returned to it,
+        // since every stream keeps a reference to the pool it was opened with
+        std::shared_ptr<core::block_buffer_pool> pool;
+        if (value > 0)
+        {
+            pool = std::make_shared<core::block_buffer_pool>(value);
+        }
+
+        m_default_request_options._set_block_buffer_pool(pool);
+    }
+
+    utility::size64_t cloud_blob_client::memory_budget_in_bytes() const
+    {
+        auto budget = m_default_request_options._memory_budget();
+        return budget ? budget->max_bytes() : 0;
+    }
+
+    void cloud_blob_client::set_memory_budget_in_bytes(utility::size64_t value)
+    {
+        std::shared_ptr<core::memory_budget> budget;
+        if (value > 0)
+        {
+            budget = std::make_shared<core::memory_budget>(value);
+        }
+
+        m_default_request_options._set_memory_budget(budget);
+    }
+
+    size_t cloud_blob_client::shared_access_signature_cache_size() const
+    {
+        return m_sas_cache ? m_sas_cache->max_entries() : 0;
+    }
+
+    void cloud_blob_client::set_shared_access_signature_cache_size(size_t value)
+    {
+        std::shared_ptr<core::sas_cache> cache;
+        if (value > 0)
+        {
+            cache = std::make_shared<core::sas_cache>(value);
+        }
+
+        m_sas_cache = cache;
+    }
+
+    blob_attribute_cache_settings cloud_blob_client::attribute_cache_settings() const
+    {
+        return m_attribute_cache ? m_attribute_cache->settings() : blob_attribute_cache_settings();
+    }
+
+    void cloud_blob_client::set_attribute_cache_settings(const blob_attribute_cache_settings& value)
+    {
+        if (!m_attribute_cache)
+        {
+            m_attribute_cache = std::make_shared<core::blob_attribute_cache>();
+        }
+
+        m_attribute_cache->set_settings(value);
+    }
+
+    blob_listing_cache_settings cloud_blob_client::listing_cache_settings() const
+    {
+        return m_listing_cache ? m_listing_cache->settings() : blob_listing_cache_settings();
+    }
+
+    void cloud_blob_client::set_listing_cache_settings(const blob_listing_cache_settings& value)
+    {
+        if (!m_listing_cache)
+        {
+            m_listing_cache = std::make_shared<core::blob_listing_cache>();
+        }
+
+        m_listing_cache->set_settings(value);
+    }
+
+    blob_content_cache_settings cloud_blob_client::content_cache_settings() const
+    {
+        return m_content_cache ? m_content_cache->settings() : blob_content_cache_settings();
+    }
+
+    void cloud_blob_client::set_content_cache_settings(const blob_content_cache_settings& value)
+    {
+        if ((value.max_size_in_bytes() > 0) && ((value.max_blob_size_in_bytes() == 0) || (value.max_blob_size_in_bytes() > value.max_size_in_bytes())))
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_content_cache_max_blob_size));
+        }
+
+        if (!m_content_cache)
+        {
+            m_content_cache = std::make_shared<core::blob_content_cache>();
+        }
+
+        m_content_cache->set_settings(value);
+    }
+
     void cloud_blob_client::set_authentication_scheme(wa::storage::authentication_scheme value)
     {
         cloud_client::set_authentication_scheme(value);
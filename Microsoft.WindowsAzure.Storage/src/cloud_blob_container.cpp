@@ -21,9 +21,50 @@
 #include "wascore/protocol_xml.h"
 #include "wascore/util.h"
 #include "wascore/constants.h"
+#include "wascore/async_semaphore.h"
+#include "wascore/existence_cache.h"
+#include "wascore/blob_listing_cache.h"
+#include "wascore/request_coalescer.h"
 
 namespace wa { namespace storage {
 
+    namespace
+    {
+        // Writes a listing marker that makes the service list from the blob name on, laid out as the service writes the NextMarker that
+        // points at that blob: "2!", the length of the encoded part, "!", then the Base64 encoding of the length of the name, the name and
+        // the time of the blob, where the encoding is padded with '-'. The time is the one the service gives a blob that is not a snapshot.
+        utility::string_t get_listing_marker(const utility::string_t& blob_name)
+        {
+            std::string name = utility::conversions::to_utf8string(blob_name);
+            const std::string version_time("9999-12-31T23:59:59.9999999Z");
+
+            std::ostringstream value_builder;
+            value_builder << std::setw(6) << std::setfill('0') << name.size() << '!' << name << '!' << std::setw(6) << std::setfill('0') << version_time.size() << '!' << version_time << '!';
+            std::string value = value_builder.str();
+
+            utility::string_t encoded = utility::conversions::to_base64(std::vector<unsigned char>(value.cbegin(), value.cend()));
+            std::replace(encoded.begin(), encoded.end(), U('='), U('-'));
+
+            utility::string_t marker(U("2!"));
+            marker.append(utility::conversions::print_string(encoded.size()));
+            marker.push_back(U('!'));
+            marker.append(encoded);
+            return marker;
+        }
+
+        // Returns the longest prefix that the names share
+        utility::string_t get_shared_prefix(const utility::string_t& first_name, const utility::string_t& second_name)
+        {
+            size_t size = 0;
+            while ((size < first_name.size()) && (size < second_name.size()) && (first_name[size] == second_name[size]))
+            {
+                ++size;
+            }
+
+            return first_name.substr(0, size);
+        }
+    }
+
     cloud_blob_container::cloud_blob_container(const storage_uri& uri)
         : m_uri(uri), m_metadata(std::make_shared<cloud_metadata>()), m_properties(std::make_shared<cloud_blob_container_properties>())
     {
@@ -72,7 +113,28 @@ namespace wa { namespace storage {
         utility::ostringstream_t resource_str;
         resource_str << U('/') << service_client().credentials().account_name() << U('/') << name();
 
-        return protocol::get_blob_sas_token(stored_policy_identifier, policy, cloud_blob_shared_access_headers(), U("c"), resource_str.str(), service_client().credentials());
+        return protocol::get_blob_sas_token(stored_policy_identifier, policy, cloud_blob_shared_access_headers(), U("c"), resource_str.str(), service_client().credentials(), service_client()._sas_cache());
+    }
+
+    std::vector<utility::string_t> cloud_blob_container::get_blob_shared_access_signatures(const blob_shared_access_policy& policy, const utility::string_t& stored_policy_identifier, const std::vector<utility::string_t>& blob_names, const cloud_blob_shared_access_headers& headers) const
+    {
+        if (!service_client().credentials().is_shared_key())
+        {
+            throw std::logic_error(utility::conversions::to_utf8string(protocol::error_sas_missing_credentials));
+        }
+
+        utility::ostringstream_t prefix_str;
+        prefix_str << U('/') << service_client().credentials().account_name() << U('/') << name() << U('/');
+        auto prefix = prefix_str.str();
+
+        std::vector<utility::string_t> resources;
+        resources.reserve(blob_names.size());
+        for (auto iter = blob_names.cbegin(); iter != blob_names.cend(); ++iter)
+        {
+            resources.push_back(prefix + *iter);
+        }
+
+        return protocol::get_blob_sas_tokens(stored_policy_identifier, policy, headers, U("b"), resources, service_client().credentials());
     }
 
     cloud_blob cloud_blob_container::get_blob_reference(const utility::string_t& blob_name) const
@@ -280,46 +342,81 @@ namespace wa { namespace storage {
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
-        auto instance = std::make_shared<cloud_blob_container>(*this);
-        return exists_async(true, modified_options, context).then([instance, public_access, modified_options, context] (bool exists_result) -> pplx::task<bool>
+        // A container that was recently confirmed to exist is not created again
+        std::shared_ptr<core::existence_cache> cache = modified_options._existence_cache();
+        utility::string_t key = uri().primary_uri().to_string();
+        if (cache && cache->contains(key))
         {
-            if (!exists_result)
+            return pplx::task_from_result(false);
+        }
+
+        // A single request tells whether the container existed from the error it fails with
+        return create_async(public_access, modified_options, context).then([cache, key] (pplx::task<void> create_task) -> bool
+        {
+            try
             {
-                return instance->create_async(public_access, modified_options, context).then([] (pplx::task<void> create_task) -> bool
+                create_task.wait();
+                if (cache)
                 {
-                    try
-                    {
-                        create_task.wait();
-                        return true;
-                    }
-                    catch (const storage_exception& e)
-                    {
-                        auto result = e.result();
-                        if (result.is_response_available() &&
-                            (result.http_status_code() == web::http::status_codes::Conflict) &&
-                            (result.extended_error().code() == protocol::error_code_container_already_exists))
-                        {
-                            return false;
-                        }
-                        else
-                        {
-                            throw;
-                        }
-                    }
-                });
+                    cache->add(key);
+                }
+
+                return true;
             }
-            else
+            catch (const storage_exception& e)
             {
-                return pplx::task_from_result(false);
+                auto result = e.result();
+                if (result.is_response_available() &&
+                    (result.http_status_code() == web::http::status_codes::Conflict) &&
+                    (result.extended_error().code() == protocol::error_code_container_already_exists))
+                {
+                    if (cache)
+                    {
+                        cache->add(key);
+                    }
+
+                    return false;
+                }
+                else
+                {
+                    throw;
+                }
             }
         });
     }
 
+    pplx::task<void> cloud_blob_container::_create_after_not_found_async(const blob_request_options& options, operation_context context) const
+    {
+        // Writes that find the container missing at the same time join a single creation
+        auto instance = std::make_shared<cloud_blob_container>(*this);
+        auto coalescer = service_client().request_coalescer();
+        auto create = [instance, options, context] () -> pplx::task<bool>
+        {
+            return instance->create_if_not_exists_async(blob_container_public_access_type::off, options, context);
+        };
+
+        auto create_task = coalescer ? coalescer->run_async<bool>(U("create-container:") + uri().primary_uri().to_string(), create) : create();
+        return create_task.then([] (bool)
+        {
+        });
+    }
+
     pplx::task<void> cloud_blob_container::delete_container_async(const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
+        if (modified_options._existence_cache())
+        {
+            modified_options._existence_cache()->remove(uri().primary_uri().to_string());
+        }
+
+        std::shared_ptr<core::blob_listing_cache> listing_cache = service_client()._listing_cache();
+        if (listing_cache != nullptr && listing_cache->is_enabled())
+        {
+            listing_cache->remove_container(uri());
+        }
+
         auto command = std::make_shared<core::storage_command<void>>(uri());
         command->set_build_request(std::bind(protocol::delete_blob_container, condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
@@ -332,37 +429,26 @@ namespace wa { namespace storage {
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
 
-        auto instance = std::make_shared<cloud_blob_container>(*this);
-        return exists_async(true, modified_options, context).then([instance, condition, modified_options, context] (bool exists_result) -> pplx::task<bool>
+        return delete_container_async(condition, modified_options, context).then([] (pplx::task<void> delete_task) -> bool
         {
-            if (exists_result)
+            try
             {
-                return instance->delete_container_async(condition, modified_options, context).then([] (pplx::task<void> delete_task) -> bool
-                {
-                    try
-                    {
-                        delete_task.wait();
-                        return true;
-                    }
-                    catch (const storage_exception& e)
-                    {
-                        auto result = e.result();
-                        if (result.is_response_available() &&
-                            (result.http_status_code() == web::http::status_codes::NotFound) &&
-                            (result.extended_error().code() == protocol::error_code_container_not_found))
-                        {
-                            return false;
-                        }
-                        else
-                        {
-                            throw;
-                        }
-                    }
-                });
+                delete_task.wait();
+                return true;
             }
-            else
+            catch (const storage_exception& e)
             {
-                return pplx::task_from_result<bool>(false);
+                auto result = e.result();
+                if (result.is_response_available() &&
+                    (result.http_status_code() == web::http::status_codes::NotFound) &&
+                    (result.extended_error().code() == protocol::error_code_container_not_found))
+                {
+                    return false;
+                }
+                else
+                {
+                    throw;
+                }
             }
         });
     }
@@ -387,34 +473,617 @@ namespace wa { namespace storage {
             delimiter = service_client().directory_delimiter();
         }
 
+        std::shared_ptr<core::blob_listing_cache> cache = use_flat_blob_listing ? nullptr : service_client()._listing_cache();
+        if (cache == nullptr || !cache->is_enabled())
+        {
+            return list_blobs_segment_from_service_async(prefix, delimiter, includes, max_results, current_token, modified_options, context);
+        }
+
+        utility::string_t key = core::blob_listing_cache::get_key(uri(), prefix, delimiter, includes, max_results, current_token);
+        blob_result_segment cached_segment;
+        if (cache->try_get(key, *this, cached_segment))
+        {
+            return pplx::task_from_result(cached_segment);
+        }
+
+        uint64_t read_invalidations = cache->begin_read();
+        return list_blobs_segment_from_service_async(prefix, delimiter, includes, max_results, current_token, modified_options, context).then([container, cache, key, prefix, delimiter, includes, max_results, modified_options, read_invalidations] (blob_result_segment segment) -> blob_result_segment
+        {
+            cache->put(key, container, prefix, segment, read_invalidations);
+            container.prefetch_child_directories(cache, segment, delimiter, includes, max_results, modified_options);
+            return segment;
+        });
+    }
+
+    pplx::task<blob_result_segment> cloud_blob_container::list_blobs_segment_from_service_async(const utility::string_t& prefix, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const blob_continuation_token& current_token, const blob_request_options& modified_options, operation_context context) const
+    {
+        auto container = *this;
+
         auto command = std::make_shared<core::storage_command<blob_result_segment>>(uri());
         command->set_build_request(std::bind(protocol::list_blobs, prefix, delimiter, includes, max_results, current_token, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_location_mode(core::command_location_mode::primary_or_secondary, current_token.target_location());
+        command->set_accept_compressed_response(true);
         command->set_preprocess_response(std::bind(protocol::preprocess_response<blob_result_segment>, blob_result_segment(), std::placeholders::_1, std::placeholders::_2));
+        command->set_stream_response_body(true);
         command->set_postprocess_response([container, delimiter] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<blob_result_segment>
         {
-            protocol::list_blobs_reader reader(response.body());
+            // The reader pulls the body while it downloads, so it runs as its own task
+            return pplx::create_task([container, response, result] () -> blob_result_segment
+            {
+                protocol::list_blobs_reader reader(response.body());
+
+                std::vector<protocol::cloud_blob_list_item> blob_items(std::move(reader.extract_blob_items()));
+                std::vector<cloud_blob> blobs;
+                for (auto iter = blob_items.begin(); iter != blob_items.end(); ++iter)
+                {
+                    blobs.push_back(cloud_blob(std::move(iter->name()), std::move(iter->snapshot_time()), container, std::move(iter->properties()), std::move(iter->metadata()), std::move(iter->copy_state())));
+                }
+
+                std::vector<protocol::cloud_blob_prefix_list_item> blob_prefix_items(std::move(reader.extract_blob_prefix_items()));
+                std::vector<cloud_blob_directory> directories;
+                for (auto iter = blob_prefix_items.begin(); iter != blob_prefix_items.end(); ++iter)
+                {
+                    directories.push_back(cloud_blob_directory(iter->name(), container));
+                }
+
+                continuation_token token(std::move(reader.extract_next_marker()));
+                token.set_target_location(result.target_location());
+                return blob_result_segment(std::move(blobs), std::move(directories), token);
+            });
+        });
+        return core::executor<blob_result_segment>::execute_async(command, modified_options, context);
+    }
+
+    void cloud_blob_container::prefetch_child_directories(std::shared_ptr<core::blob_listing_cache> cache, const blob_result_segment& segment, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const blob_request_options& modified_options) const
+    {
+        size_t max_directories = cache->settings().max_prefetched_directories();
+        auto container = *this;
 
-            std::vector<protocol::cloud_blob_list_item> blob_items(std::move(reader.extract_blob_items()));
-            std::vector<cloud_blob> blobs;
-            for (auto iter = blob_items.begin(); iter != blob_items.end(); ++iter)
+        // The first segments of the children are listed in the background and only stored in the cache, so they are
+        // not listed ahead of time again, and failures are left to the request that browses into the directory
+        for (size_t i = 0; i < segment.directories().size() && i < max_directories; ++i)
+        {
+            utility::string_t prefix(segment.directories()[i].prefix());
+            utility::string_t key = core::blob_listing_cache::get_key(uri(), prefix, delimiter, includes, max_results, blob_continuation_token());
+            if (cache->contains(key))
             {
-                blobs.push_back(cloud_blob(std::move(iter->name()), std::move(iter->snapshot_time()), container, std::move(iter->properties()), std::move(iter->metadata()), std::move(iter->copy_state())));
+                continue;
             }
 
-            std::vector<protocol::cloud_blob_prefix_list_item> blob_prefix_items(std::move(reader.extract_blob_prefix_items()));
-            std::vector<cloud_blob_directory> directories;
-            for (auto iter = blob_prefix_items.begin(); iter != blob_prefix_items.end(); ++iter)
+            uint64_t read_invalidations = cache->begin_read();
+            pplx::task<blob_result_segment> prefetch_task;
+            try
             {
-                directories.push_back(cloud_blob_directory(iter->name(), container));
+                prefetch_task = list_blobs_segment_from_service_async(prefix, delimiter, includes, max_results, blob_continuation_token(), modified_options, operation_context());
             }
+            catch (...)
+            {
+                continue;
+            }
+
+            prefetch_task.then([cache, container, key, prefix, read_invalidations] (pplx::task<blob_result_segment> listing_task)
+            {
+                try
+                {
+                    cache->put(key, container, prefix, listing_task.get(), read_invalidations);
+                }
+                catch (...)
+                {
+                }
+            });
+        }
+    }
+
+    pplx::task<void> cloud_blob_container::list_blobs_async(const utility::string_t& prefix, bool use_flat_blob_listing, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
+
+        utility::string_t delimiter;
+
+        if (!use_flat_blob_listing)
+        {
+            if (includes.snapshots())
+            {
+                throw std::invalid_argument("includes");
+            }
+
+            delimiter = service_client().directory_delimiter();
+        }
+
+        return list_blobs_from_async(prefix, delimiter, includes, max_results, blob_continuation_token(), std::move(handler), modified_options, context);
+    }
+
+    pplx::task<void> cloud_blob_container::list_blobs_from_async(const utility::string_t& prefix, const utility::string_t& delimiter, const blob_listing_includes& includes, int max_results, const blob_continuation_token& first_token, std::function<bool (const list_blob_item&)> handler, const blob_request_options& modified_options, operation_context context) const
+    {
+        auto container = *this;
+        auto current_token = std::make_shared<blob_continuation_token>(first_token);
+        auto stopped = std::make_shared<bool>(false);
+
+        return pplx::details::do_while([container, prefix, delimiter, includes, max_results, handler, current_token, stopped, modified_options, context] () mutable -> pplx::task<bool>
+        {
+            // Number of items of this page already passed to the handler by a failed attempt
+            auto delivered = std::make_shared<size_t>(0);
+
+            auto command = std::make_shared<core::storage_command<blob_continuation_token>>(container.uri());
+            command->set_build_request(std::bind(protocol::list_blobs, prefix, delimiter, includes, max_results, *current_token, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            command->set_authentication_handler(container.service_client().authentication_handler());
+            command->set_location_mode(core::command_location_mode::primary_or_secondary, current_token->target_location());
+            command->set_accept_compressed_response(true);
+            command->set_preprocess_response(std::bind(protocol::preprocess_response<blob_continuation_token>, blob_continuation_token(), std::placeholders::_1, std::placeholders::_2));
+            command->set_stream_response_body(true);
+            command->set_postprocess_response([container, handler, stopped, delivered] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<blob_continuation_token>
+            {
+                return pplx::create_task([container, handler, stopped, delivered, response, result] () -> blob_continuation_token
+                {
+                    size_t index = 0;
+                    auto deliver = [&handler, &delivered, &index] (const list_blob_item& item) -> bool
+                    {
+                        if (index++ < *delivered)
+                        {
+                            return true;
+                        }
+
+                        ++*delivered;
+                        return handler(item);
+                    };
+
+                    protocol::list_blobs_reader reader(response.body());
+                    reader.set_item_handlers([&container, &deliver] (protocol::cloud_blob_list_item& item) -> bool
+                    {
+                        return deliver(list_blob_item(cloud_blob(std::move(item.name()), std::move(item.snapshot_time()), container, std::move(item.properties()), std::move(item.metadata()), std::move(item.copy_state()))));
+                    }, [&container, &deliver] (protocol::cloud_blob_prefix_list_item& item) -> bool
+                    {
+                        return deliver(list_blob_item(cloud_blob_directory(item.name(), container)));
+                    });
+
+                    // parse returns true only if a handler asked to stop
+                    if (reader.parse())
+                    {
+                        *stopped = true;
+                        return blob_continuation_token();
+                    }
 
-            continuation_token token(std::move(reader.extract_next_marker()));
-            token.set_target_location(result.target_location());
-            return pplx::task_from_result(blob_result_segment(std::move(blobs), std::move(directories), token));
+                    continuation_token token(std::move(reader.extract_next_marker()));
+                    token.set_target_location(result.target_location());
+                    return token;
+                });
+            });
+
+            return core::executor<blob_continuation_token>::execute_async(command, modified_options, context).then([current_token, stopped] (blob_continuation_token next_token) -> bool
+            {
+                *current_token = std::move(next_token);
+                return !*stopped && !current_token->empty();
+            });
+        }).then([] (bool)
+        {
+        });
+    }
+
+    pplx::task<blob_inventory> cloud_blob_container::list_blob_inventory_segmented_async(const utility::string_t& prefix, int max_results, const blob_continuation_token& current_token, const blob_request_options& options, operation_context context) const
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
+
+        auto command = std::make_shared<core::storage_command<blob_inventory>>(uri());
+        command->set_build_request(std::bind(protocol::list_blobs, prefix, utility::string_t(), blob_listing_includes(), max_results, current_token, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        command->set_authentication_handler(service_client().authentication_handler());
+        command->set_location_mode(core::command_location_mode::primary_or_secondary, current_token.target_location());
+        command->set_accept_compressed_response(true);
+        command->set_preprocess_response(std::bind(protocol::preprocess_response<blob_inventory>, blob_inventory(), std::placeholders::_1, std::placeholders::_2));
+        command->set_stream_response_body(true);
+        command->set_postprocess_response([] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<blob_inventory>
+        {
+            return pplx::create_task([response, result] () -> blob_inventory
+            {
+                protocol::list_blobs_inventory_reader reader(response.body());
+                blob_inventory inventory(reader.extract_result());
+
+                continuation_token token(inventory.continuation_token());
+                token.set_target_location(result.target_location());
+                inventory.set_continuation_token(std::move(token));
+                return inventory;
+            });
+        });
+        return core::executor<blob_inventory>::execute_async(command, modified_options, context);
+    }
+
+    pplx::task<blob_inventory> cloud_blob_container::list_blob_inventory_async(const utility::string_t& prefix, const blob_request_options& options, operation_context context) const
+    {
+        auto container = *this;
+        auto inventory = std::make_shared<blob_inventory>();
+
+        return pplx::details::do_while([container, prefix, options, context, inventory] () -> pplx::task<bool>
+        {
+            return container.list_blob_inventory_segmented_async(prefix, 0, inventory->continuation_token(), options, context).then([inventory] (blob_inventory segment) -> bool
+            {
+                inventory->append(segment);
+                return !inventory->continuation_token().empty();
+            });
+        }).then([inventory] (bool) -> blob_inventory
+        {
+            return std::move(*inventory);
+        });
+    }
+
+    pplx::task<std::vector<blob_listing_unit>> cloud_blob_container::split_listing_async(const utility::string_t& prefix, const blob_request_options& options, operation_context context) const
+    {
+        auto units = std::make_shared<std::vector<blob_listing_unit>>();
+        units->push_back(blob_listing_unit(prefix, false));
+
+        return list_blobs_async(prefix, false, blob_listing_includes(), 0, [units] (const list_blob_item& item) -> bool
+        {
+            if (!item.is_blob())
+            {
+                units->push_back(blob_listing_unit(item.as_directory().prefix(), true));
+            }
+
+            return true;
+        }, options, context).then([units] () -> std::vector<blob_listing_unit>
+        {
+            return std::move(*units);
+        });
+    }
+
+    utility::string_t blob_listing_unit::to_string() const
+    {
+        utility::string_t result;
+        core::append_text_field(result, U("version"), U("1"));
+        core::append_text_field(result, U("prefix"), m_prefix);
+        core::append_text_field(result, U("flat"), m_use_flat_blob_listing ? U("1") : U("0"));
+        core::append_continuation_token_fields(result, m_continuation_token);
+        core::append_text_field(result, U("complete"), m_is_complete ? U("1") : U("0"));
+        return result;
+    }
+
+    blob_listing_unit blob_listing_unit::parse(const utility::string_t& value)
+    {
+        std::vector<std::pair<utility::string_t, utility::string_t>> fields;
+        bool valid = core::parse_text_fields(value, fields);
+        bool has_version = false;
+
+        blob_listing_unit result(utility::string_t(), false);
+        for (auto iter = fields.cbegin(); valid && (iter != fields.cend()); ++iter)
+        {
+            const utility::string_t& name = iter->first;
+            const utility::string_t& field = iter->second;
+            if (name == U("version"))
+            {
+                has_version = true;
+                valid = (field == U("1"));
+            }
+            else if (name == U("prefix"))
+            {
+                result.m_prefix = field;
+            }
+            else if (name == U("flat"))
+            {
+                valid = (field == U("0")) || (field == U("1"));
+                result.m_use_flat_blob_listing = (field == U("1"));
+            }
+            else if (name == U("complete"))
+            {
+                valid = (field == U("0")) || (field == U("1"));
+                result.m_is_complete = (field == U("1"));
+            }
+            else
+            {
+                // Any other field that is not part of the continuation token was written by a later version and is skipped
+                core::parse_continuation_token_field(name, field, result.m_continuation_token, valid);
+            }
+        }
+
+        if (!valid || !has_version)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_invalid_work_unit));
+        }
+
+        return result;
+    }
+
+    pplx::task<void> cloud_blob_container::list_blobs_parallel_async(const std::vector<utility::string_t>& prefixes, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
+
+        auto container = *this;
+        auto handler_lock = std::make_shared<std::mutex>();
+        auto stopped = std::make_shared<std::atomic<bool>>(false);
+
+        // Items from all the prefixes are passed to the handler one at a time
+        std::function<bool (const list_blob_item&)> merged_handler = [handler, handler_lock, stopped] (const list_blob_item& item) -> bool
+        {
+            std::lock_guard<std::mutex> guard(*handler_lock);
+            if (*stopped)
+            {
+                return false;
+            }
+
+            if (!handler(item))
+            {
+                *stopped = true;
+            }
+
+            return !*stopped;
+        };
+
+        pplx::task<std::vector<utility::string_t>> get_prefixes;
+        if (!prefixes.empty())
+        {
+            get_prefixes = pplx::task_from_result(prefixes);
+        }
+        else
+        {
+            // Blobs at the root are passed on directly and each top-level virtual directory becomes a prefix
+            auto discovered = std::make_shared<std::vector<utility::string_t>>();
+            get_prefixes = list_blobs_async(utility::string_t(), false, includes, max_results, [merged_handler, discovered] (const list_blob_item& item) -> bool
+            {
+                if (item.is_blob())
+                {
+                    return merged_handler(item);
+                }
+
+                discovered->push_back(item.as_directory().prefix());
+                return true;
+            }, modified_options, context).then([discovered] () -> std::vector<utility::string_t>
+            {
+                return std::move(*discovered);
+            });
+        }
+
+        return get_prefixes.then([container, includes, max_results, merged_handler, stopped, modified_options, context] (std::vector<utility::string_t> shard_prefixes) -> pplx::task<void>
+        {
+            core::async_semaphore semaphore(modified_options.parallelism_factor());
+            auto shard_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+            auto next_shard = std::make_shared<size_t>(0);
+            auto shards = std::make_shared<std::vector<utility::string_t>>(std::move(shard_prefixes));
+
+            return pplx::details::do_while([container, includes, max_results, merged_handler, stopped, modified_options, context, semaphore, shard_tasks, next_shard, shards] () mutable -> pplx::task<bool>
+            {
+                if (*next_shard >= shards->size())
+                {
+                    return pplx::task_from_result(false);
+                }
+
+                return semaphore.lock_async().then([container, includes, max_results, merged_handler, stopped, modified_options, context, semaphore, shard_tasks, next_shard, shards] () mutable -> bool
+                {
+                    if (*stopped)
+                    {
+                        semaphore.unlock();
+                        return false;
+                    }
+
+                    auto shard_task = container.list_blobs_async((*shards)[(*next_shard)++], true, includes, max_results, merged_handler, modified_options, context);
+                    shard_task.then([semaphore, stopped] (pplx::task<void> completed_task) mutable
+                    {
+                        try
+                        {
+                            completed_task.wait();
+                        }
+                        catch (...)
+                        {
+                            // Remaining prefixes are not started and running ones stop at their next item
+                            *stopped = true;
+                        }
+
+                        semaphore.unlock();
+                    });
+
+                    shard_tasks->push_back(shard_task);
+                    return *next_shard < shards->size();
+                });
+            }).then([semaphore, shard_tasks] (bool) mutable -> pplx::task<void>
+            {
+                return semaphore.wait_all_async().then([shard_tasks] ()
+                {
+                    // Rethrow the first failure, if any
+                    for (auto iter = shard_tasks->begin(); iter != shard_tasks->end(); ++iter)
+                    {
+                        iter->get();
+                    }
+                });
+            });
+        });
+    }
+
+    pplx::task<void> cloud_blob_container::list_blobs_in_range_async(const utility::string_t& start_name, const utility::string_t& end_name, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
+
+        auto container = *this;
+        utility::string_t prefix = end_name.empty() ? utility::string_t() : get_shared_prefix(start_name, end_name);
+        bool use_marker = !start_name.empty() && !includes.snapshots();
+        auto delivered = std::make_shared<bool>(false);
+
+        // Blobs before the start name are skipped in case the listing starts earlier, and the first blob past the end name ends it
+        std::function<bool (const list_blob_item&)> range_handler = [start_name, end_name, handler, delivered] (const list_blob_item& item) -> bool
+        {
+            const utility::string_t& name = item.as_blob().name();
+            if (name < start_name)
+            {
+                return true;
+            }
+
+            if (!end_name.empty() && !(name < end_name))
+            {
+                return false;
+            }
+
+            *delivered = true;
+            return handler(item);
+        };
+
+        blob_continuation_token first_token;
+        if (use_marker)
+        {
+            first_token.set_next_marker(get_listing_marker(start_name));
+        }
+
+        return list_blobs_from_async(prefix, utility::string_t(), includes, max_results, first_token, range_handler, modified_options, context).then([container, prefix, includes, max_results, range_handler, use_marker, delivered, modified_options, context] (pplx::task<void> listing_task) -> pplx::task<void>
+        {
+            try
+            {
+                listing_task.wait();
+                return pplx::task_from_result();
+            }
+            catch (const storage_exception& e)
+            {
+                if (!use_marker || *delivered || (e.result().http_status_code() != web::http::status_codes::BadRequest))
+                {
+                    throw;
+                }
+            }
+
+            return container.list_blobs_from_async(prefix, utility::string_t(), includes, max_results, blob_continuation_token(), range_handler, modified_options, context);
+        });
+    }
+
+    pplx::task<void> cloud_blob_container::list_blobs_in_ranges_async(const std::vector<std::pair<utility::string_t, utility::string_t>>& ranges, const blob_listing_includes& includes, int max_results, std::function<bool (const list_blob_item&)> handler, const blob_request_options& options, operation_context context) const
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
+
+        auto container = *this;
+        auto handler_lock = std::make_shared<std::mutex>();
+        auto stopped = std::make_shared<std::atomic<bool>>(false);
+
+        // Items from all the ranges are passed to the handler one at a time
+        std::function<bool (const list_blob_item&)> merged_handler = [handler, handler_lock, stopped] (const list_blob_item& item) -> bool
+        {
+            std::lock_guard<std::mutex> guard(*handler_lock);
+            if (*stopped)
+            {
+                return false;
+            }
+
+            if (!handler(item))
+            {
+                *stopped = true;
+            }
+
+            return !*stopped;
+        };
+
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        auto range_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+        auto next_range = std::make_shared<size_t>(0);
+        auto shared_ranges = std::make_shared<std::vector<std::pair<utility::string_t, utility::string_t>>>(ranges);
+
+        return pplx::details::do_while([container, includes, max_results, merged_handler, stopped, modified_options, context, semaphore, range_tasks, next_range, shared_ranges] () mutable -> pplx::task<bool>
+        {
+            if (*next_range >= shared_ranges->size())
+            {
+                return pplx::task_from_result(false);
+            }
+
+            return semaphore.lock_async().then([container, includes, max_results, merged_handler, stopped, modified_options, context, semaphore, range_tasks, next_range, shared_ranges] () mutable -> bool
+            {
+                if (*stopped)
+                {
+                    semaphore.unlock();
+                    return false;
+                }
+
+                const std::pair<utility::string_t, utility::string_t>& range = (*shared_ranges)[(*next_range)++];
+                auto range_task = container.list_blobs_in_range_async(range.first, range.second, includes, max_results, merged_handler, modified_options, context);
+                range_task.then([semaphore, stopped] (pplx::task<void> completed_task) mutable
+                {
+                    try
+                    {
+                        completed_task.wait();
+                    }
+                    catch (...)
+                    {
+                        // Remaining ranges are not started and running ones stop at their next item
+                        *stopped = true;
+                    }
+
+                    semaphore.unlock();
+                });
+
+                range_tasks->push_back(range_task);
+                return *next_range < shared_ranges->size();
+            });
+        }).then([semaphore, range_tasks] (bool) mutable -> pplx::task<void>
+        {
+            return semaphore.wait_all_async().then([range_tasks] ()
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = range_tasks->begin(); iter != range_tasks->end(); ++iter)
+                {
+                    iter->get();
+                }
+            });
+        });
+    }
+
+    pplx::task<std::vector<blob_delete_failure>> cloud_blob_container::delete_blobs_async(const utility::string_t& prefix, delete_snapshots_option snapshots_option, const blob_request_options& options, operation_context context)
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), blob_type::unspecified);
+
+        auto container = *this;
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        auto failures_lock = std::make_shared<std::mutex>();
+        auto failures = std::make_shared<std::vector<blob_delete_failure>>();
+        auto next_segment = std::make_shared<pplx::task<blob_result_segment>>(list_blobs_segmented_async(prefix, true, blob_listing_includes(), 0, blob_continuation_token(), modified_options, context));
+
+        return pplx::details::do_while([container, prefix, snapshots_option, modified_options, context, semaphore, failures_lock, failures, next_segment] () mutable -> pplx::task<bool>
+        {
+            return next_segment->then([container, prefix, snapshots_option, modified_options, context, semaphore, failures_lock, failures, next_segment] (blob_result_segment segment) mutable -> pplx::task<bool>
+            {
+                // The next page is listed while the blobs of this one are being deleted
+                bool has_more = !segment.continuation_token().empty();
+                if (has_more)
+                {
+                    *next_segment = container.list_blobs_segmented_async(prefix, true, blob_listing_includes(), 0, segment.continuation_token(), modified_options, context);
+                }
+
+                auto blobs = std::make_shared<std::vector<cloud_blob>>(segment.blobs());
+                auto next_blob = std::make_shared<size_t>(0);
+                return pplx::details::do_while([snapshots_option, modified_options, context, semaphore, failures_lock, failures, blobs, next_blob] () mutable -> pplx::task<bool>
+                {
+                    if (*next_blob >= blobs->size())
+                    {
+                        return pplx::task_from_result(false);
+                    }
+
+                    return semaphore.lock_async().then([snapshots_option, modified_options, context, semaphore, failures_lock, failures, blobs, next_blob] () mutable -> bool
+                    {
+                        cloud_blob blob((*blobs)[(*next_blob)++]);
+                        blob.delete_blob_async(snapshots_option, access_condition(), modified_options, context).then([blob, semaphore, failures_lock, failures] (pplx::task<void> delete_task) mutable
+                        {
+                            try
+                            {
+                                delete_task.wait();
+                            }
+                            catch (...)
+                            {
+                                std::lock_guard<std::mutex> guard(*failures_lock);
+                                failures->push_back(blob_delete_failure(blob.name(), std::current_exception()));
+                            }
+
+                            semaphore.unlock();
+                        });
+
+                        return *next_blob < blobs->size();
+                    });
+                }).then([has_more] (bool) -> bool
+                {
+                    return has_more;
+                });
+            });
+        }).then([semaphore, failures] (pplx::task<bool> listing_task) mutable -> pplx::task<std::vector<blob_delete_failure>>
+        {
+            // Deletes that are still running are waited for even if the listing failed
+            return semaphore.wait_all_async().then([listing_task, failures] () -> std::vector<blob_delete_failure>
+            {
+                listing_task.get();
+                return std::move(*failures);
+            });
         });
-        return core::executor<blob_result_segment>::execute_async(command, modified_options, context);
     }
 
     pplx::task<void> cloud_blob_container::upload_permissions_async(const blob_container_permissions& permissions, const access_condition& condition, const blob_request_options& options, operation_context context)
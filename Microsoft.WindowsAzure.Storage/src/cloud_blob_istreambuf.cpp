@@ -33,10 +33,30 @@ namespace wa { namespace storage { namespace core {
             pos_type end(size());
             if ((pos >= 0) && (pos < end))
             {
-                m_current_blob_offset = pos;
-                m_next_blob_offset = m_current_blob_offset;
-                m_buffer = concurrency::streams::container_buffer<std::vector<char_type>>(std::ios_base::in);
+                if (static_cast<int64_t>(pos) != m_next_blob_offset)
+                {
+                    m_sequential_ranges = 0;
+                }
+
+                retire_buffer();
                 m_blob_hash = hash_streambuf();
+                if (!use_cached_range(pos))
+                {
+                    m_current_blob_offset = pos;
+                    m_next_blob_offset = m_current_blob_offset;
+                    m_buffer = concurrency::streams::container_buffer<transfer_buffer>(std::ios_base::in);
+                }
+
+                // Prefetched ranges are kept only if the reader can continue from one of them
+                if (!m_prefetched_ranges.empty())
+                {
+                    auto& last = m_prefetched_ranges.back();
+                    if ((pos < m_prefetched_ranges.front().offset) || (pos >= last.offset + last.length))
+                    {
+                        discard_prefetched_ranges();
+                    }
+                }
+
                 return pos;
             }
         }
@@ -116,39 +136,71 @@ namespace wa { namespace storage { namespace core {
 
     pplx::task<bool> basic_cloud_blob_istreambuf::download()
     {
+        // The current buffer is about to be replaced, so its memory is returned
+        // before waiting for the next range, which may need that memory itself
+        retire_buffer();
         m_current_blob_offset = m_next_blob_offset;
 
-        auto read_size = size() - m_current_blob_offset;
-        if (read_size == 0)
+        auto blob_size = static_cast<int64_t>(size());
+        if (m_current_blob_offset >= blob_size)
         {
             return pplx::task_from_result<bool>(false);
         }
 
-        m_buffer_size = m_next_buffer_size;
-        if (read_size > m_buffer_size)
+        ++m_sequential_ranges;
+
+        // The content of the whole blob is only hashed while it is read in order, which a cached range never is
+        if (!(m_blob_hash && m_blob_hash.is_open()) && use_cached_range(m_current_blob_offset))
         {
-            read_size = m_buffer_size;
+            return pplx::task_from_result<bool>(true);
+        }
+
+        // Drop the prefetched ranges the reader has already moved past
+        while (!m_prefetched_ranges.empty() && (m_prefetched_ranges.front().offset + m_prefetched_ranges.front().length <= m_current_blob_offset))
+        {
+            discard(m_prefetched_ranges.front());
+            m_prefetched_ranges.pop_front();
+        }
+
+        if (m_prefetched_ranges.empty() || (m_prefetched_ranges.front().offset > m_current_blob_offset))
+        {
+            discard_prefetched_ranges();
+            prefetch(m_current_blob_offset);
         }
 
-        m_next_blob_offset = m_current_blob_offset + read_size;
+        auto range = m_prefetched_ranges.front();
+        m_prefetched_ranges.pop_front();
+
+        // The reader may have seeked into the middle of a prefetched range
+        auto skip = m_current_blob_offset - range.offset;
+        m_current_blob_offset = range.offset;
+        m_next_blob_offset = range.offset + range.length;
+
+        // Keep the configured number of upcoming ranges in flight, which with a range cache only starts once the reads look sequential
+        bool is_sequential = (m_range_cache_size == 0) || (m_sequential_ranges > 1);
+        while (is_sequential && (static_cast<int>(m_prefetched_ranges.size()) < m_options.stream_prefetch_depth()))
+        {
+            auto next_offset = m_prefetched_ranges.empty() ? m_next_blob_offset : m_prefetched_ranges.back().offset + m_prefetched_ranges.back().length;
+            if (next_offset >= blob_size)
+            {
+                break;
+            }
 
-        auto& internal_buffer = m_buffer.collection();
-        internal_buffer.resize(static_cast<std::vector<char_type>::size_type>(read_size));
-        concurrency::streams::container_buffer<std::vector<char_type>> temp_buffer(std::move(internal_buffer), std::ios_base::out);
-        temp_buffer.seekpos(0, std::ios_base::out);
+            prefetch(next_offset);
+        }
 
         auto this_pointer = std::dynamic_pointer_cast<basic_cloud_blob_istreambuf>(shared_from_this());
-        return m_blob->download_range_to_stream_async(temp_buffer.create_ostream(), m_current_blob_offset, read_size, m_condition, m_options, m_context).then([this_pointer, temp_buffer] (pplx::task<void> download_task) -> pplx::task<bool>
+        return range.download_task.then([this_pointer, range, skip] (pplx::task<std::shared_ptr<memory_budget::reservation>> download_task) -> pplx::task<bool>
         {
             try
             {
-                download_task.wait();
-                this_pointer->m_buffer = concurrency::streams::container_buffer<std::vector<char_type>>(std::move(temp_buffer.collection()), std::ios_base::in);
+                this_pointer->m_buffer_reservation = download_task.get();
+                this_pointer->m_buffer = concurrency::streams::container_buffer<transfer_buffer>(std::move(range.buffer.collection()), std::ios_base::in);
                 this_pointer->m_buffer.seekpos(0, std::ios_base::in);
 
                 if (this_pointer->m_blob_hash && this_pointer->m_blob_hash.is_open())
                 {
-                    return this_pointer->m_buffer.create_istream().read_to_end(this_pointer->m_blob_hash).then([this_pointer] (size_t) -> bool
+                    return this_pointer->m_buffer.create_istream().read_to_end(this_pointer->m_blob_hash).then([this_pointer, skip] (size_t) -> bool
                     {
                         if (this_pointer->m_next_blob_offset == this_pointer->size())
                         {
@@ -159,12 +211,13 @@ namespace wa { namespace storage { namespace core {
                             }
                         }
 
-                        this_pointer->m_buffer.seekpos(0, std::ios_base::in);
+                        this_pointer->m_buffer.seekpos(skip, std::ios_base::in);
                         return true;
                     });
                 }
                 else
                 {
+                    this_pointer->m_buffer.seekpos(skip, std::ios_base::in);
                     return pplx::task_from_result<bool>(true);
                 }
             }
@@ -176,4 +229,153 @@ namespace wa { namespace storage { namespace core {
         });
     }
 
+    void basic_cloud_blob_istreambuf::prefetch(int64_t offset)
+    {
+        m_buffer_size = m_next_buffer_size;
+
+        // Cached ranges are aligned, so that a range is found again however the reader got to it
+        if ((m_range_cache_size > 0) && (m_buffer_size > 0))
+        {
+            offset -= offset % static_cast<int64_t>(m_buffer_size);
+        }
+
+        auto read_size = static_cast<int64_t>(size()) - offset;
+        if (read_size > static_cast<int64_t>(m_buffer_size))
+        {
+            read_size = static_cast<int64_t>(m_buffer_size);
+        }
+
+        prefetched_range range;
+        range.offset = offset;
+        range.length = read_size;
+        range.buffer = concurrency::streams::container_buffer<transfer_buffer>(transfer_buffer(transfer_allocator<char_type>(m_options.buffer_allocator())), std::ios_base::out);
+
+        // Each range can be canceled on its own when it is discarded, as well as with the whole stream
+        auto token = m_options.cancellation_token();
+        if (token.is_cancelable())
+        {
+            range.cancellation = pplx::cancellation_token_source::create_linked_source(token);
+        }
+
+        // The range is allocated and downloaded only once its memory has been reserved
+        auto reserve_task = m_memory_budget ? m_memory_budget->reserve_async(static_cast<size_t>(read_size)) : pplx::task_from_result(std::shared_ptr<memory_budget::reservation>());
+        auto blob = m_blob;
+        auto buffer = range.buffer;
+        auto condition = m_condition;
+        auto options = m_options;
+        auto context = m_context;
+        options.set_cancellation_token(range.cancellation.get_token());
+
+        // The attributes were downloaded when the stream was opened, and the condition keeps them from changing
+        options.set_update_attributes_on_range_read(false);
+        range.download_task = reserve_task.then([blob, buffer, offset, read_size, condition, options, context] (std::shared_ptr<memory_budget::reservation> reservation) -> pplx::task<std::shared_ptr<memory_budget::reservation>>
+        {
+            if (options.cancellation_token().is_canceled())
+            {
+                throw storage_exception(utility::conversions::to_utf8string(protocol::error_operation_canceled), false);
+            }
+
+            buffer.collection().reserve(static_cast<transfer_buffer::size_type>(read_size));
+            return blob->download_range_to_stream_async(buffer.create_ostream(), offset, read_size, condition, options, context).then([blob, reservation] (pplx::task<void> download_task) -> std::shared_ptr<memory_budget::reservation>
+            {
+                try
+                {
+                    download_task.wait();
+                }
+                catch (const storage_exception& e)
+                {
+                    // The blob has changed since its attributes were read, so they are not used again
+                    if (e.result().http_status_code() == web::http::status_codes::PreconditionFailed)
+                    {
+                        blob->_remove_cached_attributes();
+                    }
+
+                    throw;
+                }
+
+                return reservation;
+            });
+        });
+        m_prefetched_ranges.push_back(range);
+    }
+
+    void basic_cloud_blob_istreambuf::retire_buffer()
+    {
+        m_buffer_reservation.reset();
+
+        auto& data = m_buffer.collection();
+        if (data.empty() || (data.size() > m_range_cache_size))
+        {
+            return;
+        }
+
+        for (auto iter = m_cached_ranges.begin(); iter != m_cached_ranges.end(); ++iter)
+        {
+            if (iter->offset == m_current_blob_offset)
+            {
+                m_cached_size -= iter->data.size();
+                m_cached_ranges.erase(iter);
+                break;
+            }
+        }
+
+        cached_range range;
+        range.offset = m_current_blob_offset;
+        range.data = std::move(data);
+        m_cached_size += range.data.size();
+        m_cached_ranges.push_front(std::move(range));
+        m_buffer = concurrency::streams::container_buffer<transfer_buffer>(std::ios_base::in);
+
+        while (m_cached_size > m_range_cache_size)
+        {
+            m_cached_size -= m_cached_ranges.back().data.size();
+            m_cached_ranges.pop_back();
+        }
+    }
+
+    bool basic_cloud_blob_istreambuf::use_cached_range(int64_t offset)
+    {
+        for (auto iter = m_cached_ranges.begin(); iter != m_cached_ranges.end(); ++iter)
+        {
+            if ((offset >= iter->offset) && (offset < iter->offset + static_cast<int64_t>(iter->data.size())))
+            {
+                m_current_blob_offset = iter->offset;
+                m_next_blob_offset = iter->offset + static_cast<int64_t>(iter->data.size());
+                m_cached_size -= iter->data.size();
+                m_buffer = concurrency::streams::container_buffer<transfer_buffer>(std::move(iter->data), std::ios_base::in);
+                m_buffer.seekpos(offset - iter->offset, std::ios_base::in);
+                m_cached_ranges.erase(iter);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void basic_cloud_blob_istreambuf::discard_prefetched_ranges()
+    {
+        for (auto iter = m_prefetched_ranges.begin(); iter != m_prefetched_ranges.end(); ++iter)
+        {
+            discard(*iter);
+        }
+
+        m_prefetched_ranges.clear();
+    }
+
+    void basic_cloud_blob_istreambuf::discard(const prefetched_range& range)
+    {
+        // The download is abandoned, and its result is observed and dropped
+        range.cancellation.cancel();
+        range.download_task.then([] (pplx::task<std::shared_ptr<memory_budget::reservation>> download_task)
+        {
+            try
+            {
+                download_task.wait();
+            }
+            catch (const std::exception&)
+            {
+            }
+        });
+    }
+
 }}} // namespace wa::storage::core
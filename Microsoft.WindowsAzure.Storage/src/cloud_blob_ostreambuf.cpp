@@ -17,9 +17,137 @@
 
 #include "stdafx.h"
 #include "wascore/blobstreams.h"
+#include "wascore/scheduler.h"
 
 namespace wa { namespace storage { namespace core {
 
+    namespace
+    {
+        bool is_zero_page(const uint8_t* data, size_t size)
+        {
+            // The words are ORed together without branching, which lets the compiler vectorize the loop
+            uint64_t combined = 0;
+            size_t offset = 0;
+            for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+            {
+                uint64_t word;
+                std::memcpy(&word, data + offset, sizeof(word));
+                combined |= word;
+            }
+
+            for (; offset < size; ++offset)
+            {
+                combined |= data[offset];
+            }
+
+            return combined == 0;
+        }
+
+        const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        // A block blob has at most 50,000 blocks, and a multiple of three digits keeps the base64 text of a block number the same length
+        const size_t block_number_width = 6;
+
+        const char block_list_header[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList>";
+        const char block_list_entry_start[] = "<Latest>";
+        const char block_list_entry_end[] = "</Latest>";
+        const char block_list_footer[] = "</BlockList>";
+        const size_t block_list_header_size = sizeof(block_list_header) - 1;
+        const size_t block_list_footer_size = sizeof(block_list_footer) - 1;
+
+        // A block that timed out, hit a server error or lost its connection may go through when it is sent again,
+        // while any other failure would only repeat itself
+        bool is_block_failure_retryable(const storage_exception& e)
+        {
+            auto status_code = e.result().http_status_code();
+            return (status_code == 0) || (status_code == web::http::status_codes::RequestTimeout) || (status_code >= web::http::status_codes::InternalError);
+        }
+    }
+
+    block_id_sequence::block_id_sequence()
+    {
+        auto prefix = utility::conversions::to_utf8string(utility::uuid_to_string(utility::new_uuid()));
+        std::vector<unsigned char> prefix_as_array(prefix.cbegin(), prefix.cend());
+        m_encoded_prefix = utility::conversions::to_utf8string(utility::conversions::to_base64(prefix_as_array));
+    }
+
+    std::string block_id_sequence::get_utf8_block_id(size_t index) const
+    {
+        uint8_t number[block_number_width];
+        for (size_t i = block_number_width; i-- > 0; index /= 10)
+        {
+            number[i] = static_cast<uint8_t>('0' + (index % 10));
+        }
+
+        std::string result;
+        result.reserve(m_encoded_prefix.size() + block_number_width / 3 * 4);
+        result.append(m_encoded_prefix);
+        for (size_t i = 0; i < block_number_width; i += 3)
+        {
+            uint32_t group = (static_cast<uint32_t>(number[i]) << 16) | (static_cast<uint32_t>(number[i + 1]) << 8) | static_cast<uint32_t>(number[i + 2]);
+            result.push_back(base64_alphabet[(group >> 18) & 0x3F]);
+            result.push_back(base64_alphabet[(group >> 12) & 0x3F]);
+            result.push_back(base64_alphabet[(group >> 6) & 0x3F]);
+            result.push_back(base64_alphabet[group & 0x3F]);
+        }
+
+        return result;
+    }
+
+    basic_block_list_streambuf::basic_block_list_streambuf(block_id_sequence block_ids, size_t block_count)
+        : basic_istreambuf<basic_block_list_streambuf::char_type>(), m_block_ids(std::move(block_ids)), m_block_count(block_count), m_position(0), m_entry_index(protocol::invalid_size_t)
+    {
+        m_entry_size = sizeof(block_list_entry_start) - 1 + m_block_ids.get_utf8_block_id(0).size() + sizeof(block_list_entry_end) - 1;
+        m_size = block_list_header_size + static_cast<utility::size64_t>(m_block_count) * m_entry_size + block_list_footer_size;
+    }
+
+    size_t basic_block_list_streambuf::read(utility::size64_t position, char_type* ptr, size_t count)
+    {
+        auto entries_end = block_list_header_size + static_cast<utility::size64_t>(m_block_count) * m_entry_size;
+
+        size_t read_count = 0;
+        while ((read_count < count) && (position < m_size))
+        {
+            const char* part;
+            size_t part_size;
+            size_t part_offset;
+            if (position < block_list_header_size)
+            {
+                part = block_list_header;
+                part_size = block_list_header_size;
+                part_offset = static_cast<size_t>(position);
+            }
+            else if (position < entries_end)
+            {
+                auto entry_index = static_cast<size_t>((position - block_list_header_size) / m_entry_size);
+                if (entry_index != m_entry_index)
+                {
+                    m_entry.assign(block_list_entry_start);
+                    m_entry.append(m_block_ids.get_utf8_block_id(entry_index));
+                    m_entry.append(block_list_entry_end);
+                    m_entry_index = entry_index;
+                }
+
+                part = m_entry.data();
+                part_size = m_entry_size;
+                part_offset = static_cast<size_t>((position - block_list_header_size) % m_entry_size);
+            }
+            else
+            {
+                part = block_list_footer;
+                part_size = block_list_footer_size;
+                part_offset = static_cast<size_t>(position - entries_end);
+            }
+
+            auto copy_size = std::min(part_size - part_offset, count - read_count);
+            std::memcpy(ptr + read_count, part + part_offset, copy_size);
+            read_count += copy_size;
+            position += copy_size;
+        }
+
+        return read_count;
+    }
+
     pplx::task<void> basic_cloud_blob_ostreambuf::_close_write()
     {
         if (m_committed)
@@ -29,12 +157,8 @@ namespace wa { namespace storage { namespace core {
 
         m_committed = true;
         basic_ostreambuf<basic_cloud_blob_ostreambuf::char_type>::_close_write().wait();
-        
-        if (m_blob_hash)
-        {
-            m_blob_hash.close().wait();
-        }
 
+        // The blob hash is closed by commit_blob, once the last buffer has gone through the hashing stage
         return commit_blob();
     }
 
@@ -43,7 +167,20 @@ namespace wa { namespace storage { namespace core {
         upload_buffer();
 
         auto this_pointer = std::dynamic_pointer_cast<basic_cloud_blob_ostreambuf>(shared_from_this());
-        return m_semaphore.wait_all_async().then([this_pointer] () -> pplx::task<bool>
+        auto hash_task = m_hash_task;
+        return hash_task.then([this_pointer] (pplx::task<void> completed_hash_task) -> pplx::task<void>
+        {
+            // Hashing errors are reported through the uploads that depend on them
+            try
+            {
+                completed_hash_task.wait();
+            }
+            catch (const std::exception&)
+            {
+            }
+
+            return this_pointer->m_semaphore.wait_all_async();
+        }).then([this_pointer] () -> pplx::task<bool>
         {
             if (this_pointer->m_currentException == nullptr)
             {
@@ -56,76 +193,167 @@ namespace wa { namespace storage { namespace core {
         });
     }
 
+    pplx::task<void> basic_cloud_blob_ostreambuf::acquire_buffer()
+    {
+        if (m_buffer_acquired)
+        {
+            return pplx::task_from_result();
+        }
+
+        // Both of these wait if the memory budget is used up or all pooled buffers are in use
+        auto reserve_task = m_memory_budget ? m_memory_budget->reserve_async(m_buffer_size) : pplx::task_from_result(std::shared_ptr<memory_budget::reservation>());
+        auto this_pointer = std::dynamic_pointer_cast<basic_cloud_blob_ostreambuf>(shared_from_this());
+        return reserve_task.then([this_pointer] (std::shared_ptr<memory_budget::reservation> reservation) -> pplx::task<void>
+        {
+            this_pointer->m_buffer_reservation = reservation;
+            if (!this_pointer->m_buffer_pool)
+            {
+                this_pointer->m_buffer = concurrency::streams::container_buffer<transfer_buffer>(transfer_buffer(transfer_allocator<char_type>(this_pointer->m_options.buffer_allocator())), std::ios_base::out);
+                this_pointer->m_buffer_acquired = true;
+                return pplx::task_from_result();
+            }
+
+            return this_pointer->m_buffer_pool->acquire_async(this_pointer->m_buffer_size, this_pointer->m_options.buffer_allocator()).then([this_pointer] (transfer_buffer buffer)
+            {
+                this_pointer->m_buffer = concurrency::streams::container_buffer<transfer_buffer>(std::move(buffer), std::ios_base::out);
+                this_pointer->m_buffer_acquired = true;
+            });
+        });
+    }
+
     std::shared_ptr<basic_cloud_blob_ostreambuf::buffer_to_upload> basic_cloud_blob_ostreambuf::prepare_buffer()
     {
-        utility::string_t block_md5;
-        if (m_block_hash)
+        std::shared_ptr<block_buffer_pool> pool;
+        if (m_buffer_acquired)
         {
-            m_block_hash.close().wait();
-            block_md5 = utility::conversions::to_base64(m_block_hash.hash());
-            m_block_hash = hash_md5_streambuf();
+            pool = m_buffer_pool;
         }
 
-        auto buffer = std::make_shared<basic_cloud_blob_ostreambuf::buffer_to_upload>(m_buffer, block_md5);
-        m_buffer = concurrency::streams::container_buffer<std::vector<char_type>>();
+        auto buffer = std::make_shared<basic_cloud_blob_ostreambuf::buffer_to_upload>(m_buffer, pool, m_buffer_reservation);
+        m_buffer = concurrency::streams::container_buffer<transfer_buffer>();
+        m_buffer_reservation.reset();
+        m_buffer_acquired = false;
         m_buffer_size = m_next_buffer_size;
+
+        bool calculate_block_md5 = m_options.use_transactional_md5();
+        if (!buffer->is_empty() && (calculate_block_md5 || m_blob_hash))
+        {
+            // Buffers are hashed off the writer's thread, one after another so that the blob hash sees them in order.
+            // Both hashes are fed from the same chunk while it is still in the cache.
+            // If there is a CPU scheduler, the hashing is run there.
+            auto blob_hash = m_blob_hash;
+            auto cpu_scheduler = m_options.cpu_scheduler();
+            auto md5_task = m_hash_task.then([buffer, blob_hash, calculate_block_md5, cpu_scheduler] () -> pplx::task<utility::string_t>
+            {
+                return run_on_scheduler<utility::string_t>(cpu_scheduler, [buffer, blob_hash, calculate_block_md5] () -> utility::string_t
+                {
+                    hash_streambuf block_hash;
+                    if (calculate_block_md5)
+                    {
+                        block_hash = hash_md5_streambuf();
+                    }
+
+                    const auto& data = buffer->data();
+                    auto size = static_cast<size_t>(buffer->size());
+                    for (size_t offset = 0; offset < size; offset += protocol::default_buffer_size)
+                    {
+                        auto chunk_size = std::min(protocol::default_buffer_size, size - offset);
+                        if (block_hash)
+                        {
+                            block_hash.putn(data.data() + offset, chunk_size).wait();
+                        }
+
+                        if (blob_hash)
+                        {
+                            blob_hash.putn(data.data() + offset, chunk_size).wait();
+                        }
+                    }
+
+                    if (!block_hash)
+                    {
+                        return utility::string_t();
+                    }
+
+                    block_hash.close().wait();
+                    return utility::conversions::to_base64(block_hash.hash());
+                });
+            });
+
+            buffer->set_content_md5(md5_task);
+            m_hash_task = md5_task.then([] (pplx::task<utility::string_t> completed_task)
+            {
+                completed_task.wait();
+            });
+        }
+
         return buffer;
     }
 
     pplx::task<basic_cloud_blob_ostreambuf::int_type> basic_cloud_blob_ostreambuf::_putc(concurrency::streams::ostream::traits::char_type ch)
     {
-        pplx::task<void> upload_task = pplx::task_from_result();
-        
-        auto result = m_buffer.putc(ch).get();
-        if (m_buffer_size == m_buffer.in_avail())
+        auto this_pointer = std::dynamic_pointer_cast<basic_cloud_blob_ostreambuf>(shared_from_this());
+        return acquire_buffer().then([this_pointer, ch] () -> pplx::task<basic_cloud_blob_ostreambuf::int_type>
         {
-            upload_task = upload_buffer();
-        }
+            pplx::task<void> upload_task = pplx::task_from_result();
 
-        return upload_task.then([result] () -> basic_cloud_blob_ostreambuf::int_type
-        {
-            return result;
+            this_pointer->m_current_streambuf_offset += 1;
+            auto result = this_pointer->m_buffer.putc(ch).get();
+            if (this_pointer->m_buffer_size == this_pointer->m_buffer.size())
+            {
+                upload_task = this_pointer->upload_buffer();
+            }
+
+            return upload_task.then([result] () -> basic_cloud_blob_ostreambuf::int_type
+            {
+                return result;
+            });
         });
     }
 
     pplx::task<size_t> basic_cloud_blob_ostreambuf::_putn(const concurrency::streams::ostream::traits::char_type* ptr, size_t count)
     {
-        pplx::task<void> upload_task = pplx::task_from_result();
-        
         m_current_streambuf_offset += count;
-        auto remaining = count;
-        while (remaining > 0)
+
+        // Each block is filled only once a buffer has been acquired for it, and the next block
+        // is started only after the previous one has been handed over for upload, so a writer
+        // never holds more than one buffer that is not being uploaded
+        auto this_pointer = std::dynamic_pointer_cast<basic_cloud_blob_ostreambuf>(shared_from_this());
+        auto position = std::make_shared<const char_type*>(ptr);
+        auto remaining = std::make_shared<size_t>(count);
+        return pplx::details::do_while([this_pointer, position, remaining] () -> pplx::task<bool>
         {
-            auto write_size = m_buffer_size - m_buffer.in_avail();
-            if (write_size > remaining)
+            if (*remaining == 0)
             {
-                write_size = remaining;
+                return pplx::task_from_result(false);
             }
 
-            // All streambuf puts below are waited, because one is a memory buffer and the others
-            // are hash buffers. Hence, there is no async IO involved.
-
-            if (m_block_hash)
+            return this_pointer->acquire_buffer().then([this_pointer, position, remaining] () -> pplx::task<bool>
             {
-                m_block_hash.putn(ptr, write_size).wait();
-            }
+                pplx::task<void> upload_task = pplx::task_from_result();
 
-            if (m_blob_hash)
-            {
-                m_blob_hash.putn(ptr, write_size).wait();
-            }
+                auto write_size = this_pointer->m_buffer_size - this_pointer->m_buffer.size();
+                if (write_size > *remaining)
+                {
+                    write_size = *remaining;
+                }
 
-            m_buffer.putn(ptr, write_size).wait();
-            if (m_buffer_size == m_buffer.size())
-            {
-                upload_task = upload_buffer();
-            }
+                // The put is waited, because it is a memory buffer and there is no async IO involved.
+                // Hashing happens later, when the buffer is handed over for upload.
+                this_pointer->m_buffer.putn(*position, write_size).wait();
+                if (this_pointer->m_buffer_size == this_pointer->m_buffer.size())
+                {
+                    upload_task = this_pointer->upload_buffer();
+                }
 
-            ptr += write_size;
-            remaining -= write_size;
-        }
+                *position += write_size;
+                *remaining -= write_size;
 
-        return upload_task.then([count] () -> size_t
+                return upload_task.then([remaining] () -> bool
+                {
+                    return *remaining > 0;
+                });
+            });
+        }).then([count] (bool) -> size_t
         {
             return count;
         });
@@ -133,13 +361,20 @@ namespace wa { namespace storage { namespace core {
 
     pplx::task<void> basic_cloud_block_blob_ostreambuf::upload_buffer()
     {
+        // With a growing block size, the next block is as large as all the blocks so far together
+        if (m_options.initial_stream_write_size_in_bytes() > 0)
+        {
+            m_blocks_size += m_buffer.size();
+            m_next_buffer_size = static_cast<size_t>(std::min<utility::size64_t>(std::max<utility::size64_t>(m_blocks_size, m_buffer_size), m_options.stream_write_size_in_bytes()));
+        }
+
         auto buffer = prepare_buffer();
         if (buffer->is_empty())
         {
             return pplx::task_from_result();
         }
 
-        auto block_id = get_next_block_id();
+        auto block_id = m_block_ids.get_block_id(m_block_count++);
         
         auto this_pointer = std::dynamic_pointer_cast<basic_cloud_block_blob_ostreambuf>(shared_from_this());
         return m_semaphore.lock_async().then([this_pointer, buffer, block_id] ()
@@ -148,9 +383,13 @@ namespace wa { namespace storage { namespace core {
             {
                 try
                 {
-                    this_pointer->m_blob->upload_block_async(block_id, buffer->stream(), buffer->content_md5(), this_pointer->m_condition, this_pointer->m_options, this_pointer->m_context).then([this_pointer] (pplx::task<void> upload_task)
+                    buffer->content_md5().then([this_pointer, buffer, block_id] (utility::string_t content_md5)
+                    {
+                        return this_pointer->upload_block_with_retries(buffer, block_id, content_md5, 0);
+                    }).then([this_pointer, buffer] (pplx::task<void> upload_task)
                     {
                         std::lock_guard<async_semaphore> guard(this_pointer->m_semaphore, std::adopt_lock);
+                        buffer->release();
                         try
                         {
                             upload_task.wait();
@@ -173,6 +412,47 @@ namespace wa { namespace storage { namespace core {
         });
     }
 
+    pplx::task<void> basic_cloud_block_blob_ostreambuf::upload_block_with_retries(std::shared_ptr<buffer_to_upload> buffer, utility::string_t block_id, utility::string_t content_md5, int retry_count)
+    {
+        // Every attempt sends the buffer from its start, however far the previous one got
+        buffer->stream().seek(0);
+
+        auto this_pointer = std::dynamic_pointer_cast<basic_cloud_block_blob_ostreambuf>(shared_from_this());
+        return m_blob->upload_block_async(block_id, buffer->stream(), content_md5, m_condition, m_options, m_context).then([this_pointer, buffer, block_id, content_md5, retry_count] (pplx::task<void> upload_task) -> pplx::task<void>
+        {
+            try
+            {
+                upload_task.wait();
+                return pplx::task_from_result();
+            }
+            catch (const storage_exception& e)
+            {
+                if (!is_block_failure_retryable(e) || (retry_count >= this_pointer->m_options.stream_block_retries()) ||
+                    (this_pointer->m_currentException != nullptr) || this_pointer->m_options.cancellation_token().is_canceled())
+                {
+                    throw;
+                }
+
+                if ((retry_count == 0) && (++this_pointer->m_failed_blocks > this_pointer->m_options.stream_max_failed_blocks()))
+                {
+                    throw;
+                }
+            }
+
+            // The block keeps its place in the semaphore while it waits, and the other blocks go on being uploaded
+            auto delay = protocol::stream_block_retry_base_delay * (1 << std::min(retry_count, 5));
+            if (delay > protocol::stream_block_retry_max_delay)
+            {
+                delay = protocol::stream_block_retry_max_delay;
+            }
+
+            return complete_after(delay, this_pointer->m_options.cancellation_token()).then([this_pointer, buffer, block_id, content_md5, retry_count] () -> pplx::task<void>
+            {
+                return this_pointer->upload_block_with_retries(buffer, block_id, content_md5, retry_count + 1);
+            });
+        });
+    }
+
     pplx::task<void> basic_cloud_block_blob_ostreambuf::commit_blob()
     {
         auto this_pointer = std::dynamic_pointer_cast<basic_cloud_block_blob_ostreambuf>(shared_from_this());
@@ -180,24 +460,16 @@ namespace wa { namespace storage { namespace core {
         {
             if (this_pointer->m_blob_hash)
             {
+                this_pointer->m_blob_hash.close().wait();
                 this_pointer->m_blob->properties().set_content_md5(utility::conversions::to_base64(this_pointer->m_blob_hash.hash()));
             }
 
-            return this_pointer->m_blob->upload_block_list_async(this_pointer->m_block_list, this_pointer->m_condition, this_pointer->m_options, this_pointer->m_context);
+            // The block list is formatted while the request body is sent, instead of being built up front
+            auto block_list = block_list_streambuf(this_pointer->m_block_ids, this_pointer->m_block_count).create_istream();
+            return this_pointer->m_blob->upload_block_list_async(block_list, this_pointer->m_condition, this_pointer->m_options, this_pointer->m_context);
         });
     }
 
-    utility::string_t basic_cloud_block_blob_ostreambuf::get_next_block_id()
-    {
-        utility::ostringstream_t str;
-        str << m_block_id_prefix << U('-') << std::setw(6) << std::setfill(U('0')) << m_block_list.size();
-        auto utf8_block_id = utility::conversions::to_utf8string(str.str());
-        std::vector<unsigned char> block_id_as_array(utf8_block_id.cbegin(), utf8_block_id.cend());
-        utility::string_t block_id(utility::conversions::to_base64(block_id_as_array));
-        m_block_list.push_back(block_list_item(block_id));
-        return block_id;
-    }
-
     pplx::task<void> basic_cloud_page_blob_ostreambuf::upload_buffer()
     {
         auto buffer = prepare_buffer();
@@ -216,9 +488,13 @@ namespace wa { namespace storage { namespace core {
             {
                 try
                 {
-                    this_pointer->m_blob->upload_pages_async(buffer->stream(), offset, buffer->content_md5(), this_pointer->m_condition, this_pointer->m_options, this_pointer->m_context).then([this_pointer] (pplx::task<void> upload_task)
+                    buffer->content_md5().then([this_pointer, buffer, offset] (utility::string_t content_md5)
+                    {
+                        return this_pointer->upload_pages(buffer, offset, content_md5);
+                    }).then([this_pointer, buffer] (pplx::task<void> upload_task)
                     {
                         std::lock_guard<async_semaphore> guard(this_pointer->m_semaphore, std::adopt_lock);
+                        buffer->release();
                         try
                         {
                             upload_task.wait();
@@ -241,6 +517,97 @@ namespace wa { namespace storage { namespace core {
         });
     }
 
+    pplx::task<void> basic_cloud_page_blob_ostreambuf::upload_pages(std::shared_ptr<buffer_to_upload> buffer, int64_t offset, const utility::string_t& content_md5)
+    {
+        if (!m_options.skip_zero_pages())
+        {
+            return m_blob->upload_pages_async(buffer->stream(), offset, content_md5, m_condition, m_options, m_context);
+        }
+
+        // The buffer is split into runs of pages that either all contain data or all are zeros
+        const uint8_t* data = buffer->data().data();
+        auto size = static_cast<size_t>(buffer->size());
+        std::vector<std::pair<size_t, size_t>> data_runs;
+        std::vector<std::pair<size_t, size_t>> zero_runs;
+        size_t run_begin = 0;
+        bool run_is_zero = false;
+        for (size_t page_begin = 0; page_begin < size; page_begin += protocol::page_size)
+        {
+            bool page_is_zero = is_zero_page(data + page_begin, std::min(protocol::page_size, size - page_begin));
+            if ((page_begin > 0) && (page_is_zero != run_is_zero))
+            {
+                (run_is_zero ? zero_runs : data_runs).push_back(std::make_pair(run_begin, page_begin));
+                run_begin = page_begin;
+            }
+
+            run_is_zero = page_is_zero;
+        }
+
+        (run_is_zero ? zero_runs : data_runs).push_back(std::make_pair(run_begin, size));
+
+        if (zero_runs.empty())
+        {
+            return m_blob->upload_pages_async(buffer->stream(), offset, content_md5, m_condition, m_options, m_context);
+        }
+
+        // Zero pages count towards the progress of the upload whether or not they are cleared
+        std::vector<pplx::task<void>> run_tasks;
+        for (auto iter = zero_runs.cbegin(); iter != zero_runs.cend(); ++iter)
+        {
+            auto run_length = iter->second - iter->first;
+            auto run_task = m_clear_zero_pages ? m_blob->clear_pages_async(offset + iter->first, run_length, m_condition, m_options, m_context) : pplx::task_from_result();
+            run_tasks.push_back(add_transfer_progress(run_task, m_options, run_length));
+        }
+
+        // The MD5 of the whole buffer does not apply to a part of it, so each run gets its own if transactional MD5 is used
+        for (auto iter = data_runs.cbegin(); iter != data_runs.cend(); ++iter)
+        {
+            auto run_stream = concurrency::streams::rawptr_stream<uint8_t>::open_istream(data + iter->first, iter->second - iter->first);
+            run_tasks.push_back(m_blob->upload_pages_async(run_stream, offset + iter->first, utility::string_t(), m_condition, m_options, m_context).then([buffer, run_stream] (pplx::task<void> upload_task) mutable
+            {
+                run_stream.close().wait();
+                upload_task.wait();
+            }));
+        }
+
+        if (run_tasks.empty())
+        {
+            return pplx::task_from_result();
+        }
+
+        // The buffer is only released once every run is done with it, so a failed run does not end the wait early
+        auto first_error = std::make_shared<std::exception_ptr>();
+        auto error_mutex = std::make_shared<std::mutex>();
+        std::vector<pplx::task<void>> completed_tasks;
+        completed_tasks.reserve(run_tasks.size());
+        for (auto iter = run_tasks.begin(); iter != run_tasks.end(); ++iter)
+        {
+            completed_tasks.push_back(iter->then([first_error, error_mutex] (pplx::task<void> run_task)
+            {
+                try
+                {
+                    run_task.wait();
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> guard(*error_mutex);
+                    if (*first_error == nullptr)
+                    {
+                        *first_error = std::current_exception();
+                    }
+                }
+            }));
+        }
+
+        return pplx::when_all(completed_tasks.begin(), completed_tasks.end()).then([first_error] ()
+        {
+            if (*first_error != nullptr)
+            {
+                std::rethrow_exception(*first_error);
+            }
+        });
+    }
+
     pplx::task<void> basic_cloud_page_blob_ostreambuf::commit_blob()
     {
         if (m_blob_hash)
@@ -248,6 +615,7 @@ namespace wa { namespace storage { namespace core {
             auto this_pointer = std::dynamic_pointer_cast<basic_cloud_page_blob_ostreambuf>(shared_from_this());
             return _sync().then([this_pointer] (bool) -> pplx::task<void>
             {
+                this_pointer->m_blob_hash.close().wait();
                 this_pointer->m_blob->properties().set_content_md5(utility::conversions::to_base64(this_pointer->m_blob_hash.hash()));
                 return this_pointer->m_blob->upload_properties_async(this_pointer->m_condition, this_pointer->m_options, this_pointer->m_context);
             });
@@ -16,12 +16,263 @@
 // -----------------------------------------------------------------------------------------
 
 #include "stdafx.h"
+#include <unordered_map>
+#include <unordered_set>
 #include "wascore/protocol.h"
 #include "wascore/protocol_xml.h"
 #include "wascore/blobstreams.h"
+#include "wascore/hash_software.h"
+#include "wascore/async_semaphore.h"
+#include "wascore/block_buffer_pool.h"
+#include "wascore/upload_tuner.h"
+#include "wascore/transcode.h"
 
 namespace wa { namespace storage {
 
+    namespace
+    {
+        struct changed_blocks_upload_state
+        {
+            changed_blocks_upload_state(size_t block_count)
+                : block_list(block_count, block_list_item(utility::string_t())), next_offset(0), failed(false), blob_hash_task(pplx::task_from_result())
+            {
+            }
+
+            // The committed blocks of the blob as it was before, by block ID
+            std::unordered_map<utility::string_t, size_t> committed_blocks;
+
+            // The blocks this upload sends, so that a block that occurs several times is only sent once
+            std::unordered_set<utility::string_t> uploaded_blocks;
+            std::vector<block_list_item> block_list;
+            std::mutex mutex;
+
+            utility::size64_t next_offset;
+            std::vector<pplx::task<void>> block_tasks;
+            std::atomic<bool> failed;
+            pplx::task<void> blob_hash_task;
+        };
+
+        struct resumable_upload_state
+        {
+            resumable_upload_state(block_blob_upload_checkpoint checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler)
+                : checkpoint(std::move(checkpoint)), checkpoint_handler(std::move(checkpoint_handler)), first_unhashed_block(0), next_index(0), failed(false), blob_hash_task(pplx::task_from_result())
+            {
+            }
+
+            // Updated as blocks are uploaded and hashed, and passed to the handler while the mutex is held
+            block_blob_upload_checkpoint checkpoint;
+            std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler;
+            std::mutex mutex;
+
+            // The blocks the service already had when the upload started, which are only read again if the blob MD5 needs them
+            std::vector<bool> skipped_blocks;
+            core::md5_hash blob_hash;
+            size_t first_unhashed_block;
+
+            size_t next_index;
+            std::vector<pplx::task<void>> block_tasks;
+            std::atomic<bool> failed;
+            pplx::task<void> blob_hash_task;
+        };
+
+        struct blob_copy_state
+        {
+            blob_copy_state(size_t buffer_count)
+                : buffers(std::make_shared<core::block_buffer_pool>(buffer_count)), next_offset(0), failed(false)
+            {
+            }
+
+            // The ring of buffers that ranges are downloaded into, each of which is returned once its block has been uploaded
+            std::shared_ptr<core::block_buffer_pool> buffers;
+
+            utility::size64_t next_offset;
+            std::vector<pplx::task<void>> block_tasks;
+            std::atomic<bool> failed;
+            std::exception_ptr first_error;
+            std::mutex mutex;
+        };
+
+        const utility::string_t checkpoint_version(U("1"));
+        const utility::string_t checkpoint_version_name(U("version"));
+        const utility::string_t checkpoint_block_size_name(U("block_size"));
+        const utility::string_t checkpoint_block_id_prefix_name(U("block_id_prefix"));
+        const utility::string_t checkpoint_length_name(U("length"));
+        const utility::string_t checkpoint_completed_blocks_name(U("completed_blocks"));
+        const utility::string_t checkpoint_hashed_blocks_name(U("hashed_blocks"));
+        const utility::string_t checkpoint_md5_state_name(U("md5_state"));
+
+        // Unlike scan_string, accepts nothing but decimal digits
+        bool parse_checkpoint_number(const utility::string_t& value, utility::size64_t& result)
+        {
+            if (value.empty() || (value.size() > 19))
+            {
+                return false;
+            }
+
+            result = 0;
+            for (auto iter = value.cbegin(); iter != value.cend(); ++iter)
+            {
+                if ((*iter < U('0')) || (*iter > U('9')))
+                {
+                    return false;
+                }
+
+                result = result * 10 + static_cast<utility::size64_t>(*iter - U('0'));
+            }
+
+            return true;
+        }
+
+        // The completed blocks are written as runs of block numbers such as "0-41,43,45-50", which keeps them short while blocks finish mostly in order
+        utility::string_t format_block_runs(const std::vector<bool>& blocks)
+        {
+            utility::string_t result;
+            size_t index = 0;
+            while (index < blocks.size())
+            {
+                if (!blocks[index])
+                {
+                    ++index;
+                    continue;
+                }
+
+                size_t first = index;
+                while ((index < blocks.size()) && blocks[index])
+                {
+                    ++index;
+                }
+
+                if (!result.empty())
+                {
+                    result.push_back(U(','));
+                }
+
+                result.append(utility::conversions::print_string(first));
+                if (index - 1 > first)
+                {
+                    result.push_back(U('-'));
+                    result.append(utility::conversions::print_string(index - 1));
+                }
+            }
+
+            return result;
+        }
+
+        bool parse_block_runs(const utility::string_t& value, std::vector<bool>& blocks)
+        {
+            blocks.clear();
+            size_t position = 0;
+            while (position < value.size())
+            {
+                auto separator = value.find(U(','), position);
+                if (separator == utility::string_t::npos)
+                {
+                    separator = value.size();
+                }
+
+                auto run = value.substr(position, separator - position);
+                auto dash = run.find(U('-'));
+                utility::size64_t first;
+                utility::size64_t last;
+                if (!parse_checkpoint_number(run.substr(0, dash), first))
+                {
+                    return false;
+                }
+
+                if (dash == utility::string_t::npos)
+                {
+                    last = first;
+                }
+                else if (!parse_checkpoint_number(run.substr(dash + 1), last) || (last < first))
+                {
+                    return false;
+                }
+
+                // No blob has more than 50,000 blocks
+                if (last >= 50000)
+                {
+                    return false;
+                }
+
+                if (blocks.size() <= last)
+                {
+                    blocks.resize(static_cast<size_t>(last) + 1, false);
+                }
+
+                for (auto index = first; index <= last; ++index)
+                {
+                    blocks[static_cast<size_t>(index)] = true;
+                }
+
+                position = separator + 1;
+            }
+
+            return true;
+        }
+
+        // Builds the request of an upload_block_async call, without binding its arguments into function objects
+        class put_block_operation : public core::basic_command_operation
+        {
+        public:
+
+            put_block_operation(utility::string_t block_id, utility::string_t content_md5, utility::string_t content_crc64, access_condition condition)
+                : m_block_id(std::move(block_id)), m_content_md5(std::move(content_md5)), m_content_crc64(std::move(content_crc64)), m_condition(std::move(condition))
+            {
+            }
+
+            web::http::http_request build_request(web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) const
+            {
+                return protocol::put_block(m_block_id, m_content_md5, m_content_crc64, m_condition, uri_builder, timeout, context);
+            }
+
+            void preprocess_response(const web::http::http_response& response, operation_context context) const
+            {
+                protocol::preprocess_response(response, context);
+            }
+
+        private:
+
+            utility::string_t m_block_id;
+            utility::string_t m_content_md5;
+            utility::string_t m_content_crc64;
+            access_condition m_condition;
+        };
+
+        // Opens a stream that reads the buffers one after the other without copying them into one
+        concurrency::streams::istream open_gather_istream(const std::vector<const_buffer>& buffers)
+        {
+            std::vector<std::pair<const uint8_t*, size_t>> segments;
+            segments.reserve(buffers.size());
+            for (auto iter = buffers.cbegin(); iter != buffers.cend(); ++iter)
+            {
+                if ((iter->data() == nullptr) && (iter->size() > 0))
+                {
+                    throw std::invalid_argument("buffers");
+                }
+
+                segments.push_back(std::make_pair(iter->data(), iter->size()));
+            }
+
+            return core::gather_streambuf<uint8_t>(std::move(segments)).create_istream();
+        }
+
+        // Feeds the duration of an upload request to the throughput model of its endpoint, if uploads are tuned to it
+        void record_upload_request(core::storage_command<void>& command, const blob_request_options& modified_options, const web::http::uri& endpoint, utility::size64_t length)
+        {
+            if (!modified_options.adaptive_upload() || !modified_options._upload_tuner())
+            {
+                return;
+            }
+
+            auto tuner = modified_options._upload_tuner();
+            command.set_postprocess_response([tuner, endpoint, length] (const web::http::http_response&, const request_result& result, const core::ostream_descriptor&, operation_context) -> pplx::task<void>
+            {
+                tuner->record_request(endpoint, length, result);
+                return pplx::task_from_result();
+            });
+        }
+    }
+
     pplx::task<void> cloud_block_blob::upload_block_async(const utility::string_t& block_id, concurrency::streams::istream block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const
     {
         assert_no_snapshot();
@@ -29,41 +280,60 @@ namespace wa { namespace storage {
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
         bool needs_md5 = content_md5.empty() && modified_options.use_transactional_md5();
+        bool needs_crc64 = modified_options.use_transactional_crc64();
 
-        auto command = std::make_shared<core::storage_command<void>>(uri());
-        command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response(std::bind(protocol::preprocess_response, std::placeholders::_1, std::placeholders::_2));
-        return core::istream_descriptor::create(block_data, needs_md5).then([command, context, block_id, content_md5, modified_options, condition] (core::istream_descriptor request_body) -> pplx::task<void>
+        auto blob_uri = uri();
+        auto authentication_handler = service_client().authentication_handler();
+        auto endpoint = blob_uri.primary_uri();
+        return core::istream_descriptor::create(block_data, needs_md5, protocol::invalid_size64_t, needs_crc64, modified_options.buffer_allocator()).then([blob_uri, authentication_handler, context, block_id, content_md5, modified_options, condition, endpoint] (core::istream_descriptor request_body) -> pplx::task<void>
         {
             auto md5 = content_md5.empty() ? request_body.content_md5() : content_md5;
-            command->set_build_request(std::bind(protocol::put_block, block_id, md5, condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            auto command = std::make_shared<core::static_storage_command<void, put_block_operation>>(blob_uri, put_block_operation(block_id, md5, request_body.content_crc64(), condition));
+            command->set_authentication_handler(authentication_handler);
             command->set_request_body(request_body);
-            return core::executor<void>::execute_async(command, modified_options, context);
+            record_upload_request(*command, modified_options, endpoint, request_body.length());
+            return core::add_transfer_progress(core::executor<void>::execute_async(command, modified_options, context), modified_options, request_body.length());
         });
     }
 
+    pplx::task<void> cloud_block_blob::upload_block_async(const utility::string_t& block_id, const std::vector<const_buffer>& block_data, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context) const
+    {
+        // The stream is seekable, so any hash is calculated by reading the buffers in place before they are sent
+        return upload_block_async(block_id, open_gather_istream(block_data), content_md5, condition, options, context);
+    }
+
     pplx::task<void> cloud_block_blob::upload_block_list_async(const std::vector<block_list_item>& block_list, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
-        blob_request_options modified_options(options);
-        modified_options.apply_defaults(service_client().default_request_options(), type());
-
         protocol::block_list_writer writer;
         concurrency::streams::istream stream(concurrency::streams::bytestream::open_istream(std::move(writer.write(block_list))));
+        return upload_block_list_async(stream, condition, options, context);
+    }
+
+    pplx::task<void> cloud_block_blob::upload_block_list_async(concurrency::streams::istream block_list, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        assert_no_snapshot();
+        _remove_cached_attributes();
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
 
         auto properties = m_properties;
+        auto instance = std::make_shared<cloud_blob>(*this);
         
         auto command = std::make_shared<core::storage_command<void>>(uri());
         command->set_build_request(std::bind(protocol::put_block_list, *properties, metadata(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response([properties] (const web::http::http_response& response, operation_context context)
+        command->set_preprocess_response([instance, properties] (const web::http::http_response& response, operation_context context)
         {
+            instance->_remove_cached_listings();
             protocol::preprocess_response(response, context);
             properties->update_etag_and_last_modified(protocol::blob_response_parsers::parse_blob_properties(response));
         });
-        return core::istream_descriptor::create(stream).then([command, context, modified_options] (core::istream_descriptor request_body) -> pplx::task<void>
+        auto endpoint = uri().primary_uri();
+        return core::istream_descriptor::create(block_list).then([command, context, modified_options, endpoint] (core::istream_descriptor request_body) -> pplx::task<void>
         {
             command->set_request_body(request_body);
+            record_upload_request(*command, modified_options, endpoint, request_body.length());
             return core::executor<void>::execute_async(command, modified_options, context);
         });
     }
@@ -93,12 +363,8 @@ namespace wa { namespace storage {
         return core::executor<std::vector<block_list_item>>::execute_async(command, modified_options, context);
     }
 
-    pplx::task<concurrency::streams::ostream> cloud_block_blob::open_write_async(const access_condition& condition, const blob_request_options& options, operation_context context)
+    pplx::task<void> cloud_block_blob::check_write_condition_async(const access_condition& condition, const blob_request_options& modified_options, operation_context context)
     {
-        assert_no_snapshot();
-        blob_request_options modified_options(options);
-        modified_options.apply_defaults(service_client().default_request_options(), type(), false);
-
         pplx::task<void> check_condition_task;
         if (condition.is_conditional())
         {
@@ -128,6 +394,16 @@ namespace wa { namespace storage {
             check_condition_task = pplx::task_from_result();
         }
 
+        return check_condition_task;
+    }
+
+    pplx::task<concurrency::streams::ostream> cloud_block_blob::open_write_async(const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        assert_no_snapshot();
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type(), false);
+
+        auto check_condition_task = check_write_condition_async(condition, modified_options, context);
         auto instance = std::make_shared<cloud_block_blob>(*this);
         return check_condition_task.then([instance, condition, modified_options, context] ()
         {
@@ -138,6 +414,7 @@ namespace wa { namespace storage {
     pplx::task<void> cloud_block_blob::upload_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
@@ -146,26 +423,80 @@ namespace wa { namespace storage {
             length = core::get_remaining_stream_length(source);
         }
 
+        // The upload is sent as if the container existed, and only if it does not is the container created and the upload sent again
+        if (modified_options.create_container_if_not_found() && source.can_seek())
+        {
+            blob_request_options upload_options(modified_options);
+            upload_options.set_create_container_if_not_found(false);
+            auto instance = std::make_shared<cloud_block_blob>(*this);
+            auto position = source.tell();
+            return upload_from_stream_async(source, length, condition, upload_options, context).then([instance, source, position, length, condition, upload_options, context] (pplx::task<void> upload_task) mutable -> pplx::task<void>
+            {
+                try
+                {
+                    upload_task.wait();
+                    return pplx::task_from_result();
+                }
+                catch (const storage_exception& e)
+                {
+                    if (!core::is_storage_error(e, web::http::status_codes::NotFound, protocol::error_code_container_not_found))
+                    {
+                        throw;
+                    }
+                }
+
+                source.seek(position);
+                return instance->container()._create_after_not_found_async(upload_options, context).then([instance, source, length, condition, upload_options, context] () -> pplx::task<void>
+                {
+                    return instance->upload_from_stream_async(source, length, condition, upload_options, context);
+                });
+            });
+        }
+
         auto properties = m_properties;
         auto metadata = m_metadata;
 
+        // Adaptive uploads take the block size and the number of blocks in flight from the throughput observed for the endpoint,
+        // and send the blob in a single request whenever that is expected to be faster, even if blocks could be sent in parallel
+        auto single_upload_threshold = modified_options.single_blob_upload_threshold_in_bytes();
+        auto max_parallelism = modified_options.parallelism_factor();
+        auto endpoint = uri().primary_uri();
+        auto tuner = modified_options.adaptive_upload() ? modified_options._upload_tuner() : std::shared_ptr<core::upload_tuner>();
+        core::upload_tuner::tuning tuning;
+        bool is_tuned = tuner && tuner->try_get_tuning(endpoint, single_upload_threshold, modified_options.stream_write_size_in_bytes(), max_parallelism, tuning);
+        if (is_tuned)
+        {
+            single_upload_threshold = tuning.single_upload_threshold;
+            modified_options.set_stream_write_size_in_bytes(tuning.block_size);
+            modified_options.set_parallelism_factor(tuning.parallelism);
+        }
+
+        // A source that cannot seek has to be copied into memory to be sent in a single request, so it is only sent
+        // that way if it fits in the buffer that uploading it block by block would take anyway
+        if (!source.can_seek() && (single_upload_threshold > modified_options.stream_write_size_in_bytes()))
+        {
+            single_upload_threshold = modified_options.stream_write_size_in_bytes();
+        }
+
         if ((length != protocol::invalid_size64_t) &&
-            (length <= modified_options.single_blob_upload_threshold_in_bytes()) &&
-            (modified_options.parallelism_factor() == 1))
+            (length <= single_upload_threshold) &&
+            (is_tuned || (modified_options.parallelism_factor() == 1)))
         {
             if (modified_options.use_transactional_md5() && !modified_options.store_blob_content_md5())
             {
                 throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_md5_options_mismatch));
             }
 
+            auto instance = std::make_shared<cloud_blob>(*this);
             auto command = std::make_shared<core::storage_command<void>>(uri());
             command->set_authentication_handler(service_client().authentication_handler());
-            command->set_preprocess_response([properties] (const web::http::http_response& response, operation_context context)
+            command->set_preprocess_response([instance, properties] (const web::http::http_response& response, operation_context context)
             {
+                instance->_remove_cached_listings();
                 protocol::preprocess_response(response, context);
                 properties->update_etag_and_last_modified(protocol::blob_response_parsers::parse_blob_properties(response));
             });
-            return core::istream_descriptor::create(source, modified_options.store_blob_content_md5(), length).then([command, context, properties, metadata, condition, modified_options] (core::istream_descriptor request_body) -> pplx::task<void>
+            return core::istream_descriptor::create(source, modified_options.store_blob_content_md5(), length, false, modified_options.buffer_allocator()).then([command, context, properties, metadata, condition, modified_options, endpoint] (core::istream_descriptor request_body) -> pplx::task<void>
             {
                 if (!request_body.content_md5().empty())
                 {
@@ -174,42 +505,1081 @@ namespace wa { namespace storage {
 
                 command->set_build_request(std::bind(protocol::put_block_blob, *properties, *metadata, condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
                 command->set_request_body(request_body);
-                return core::executor<void>::execute_async(command, modified_options, context);
+                record_upload_request(*command, modified_options, endpoint, request_body.length());
+                return core::add_transfer_progress(core::executor<void>::execute_async(command, modified_options, context), modified_options, request_body.length());
             });
         }
 
-        return open_write_async(condition, modified_options, context).then([source, length] (concurrency::streams::ostream blob_stream) -> pplx::task<void>
+        auto start_time = std::chrono::steady_clock::now();
+        pplx::task<void> upload_task;
+
+        // Seekable sources are uploaded block by block straight from the source,
+        // instead of being copied into the buffers of a blob stream first
+        if ((length != protocol::invalid_size64_t) && source.can_seek())
         {
-            return core::stream_copy_async(source, blob_stream, length).then([blob_stream] (utility::size64_t) -> pplx::task<void>
+            upload_task = upload_blocks_from_seekable_stream_async(source, length, condition, modified_options, context);
+        }
+        else
+        {
+            upload_task = open_write_async(condition, modified_options, context).then([source, length] (concurrency::streams::ostream blob_stream) -> pplx::task<void>
             {
-                return blob_stream.close();
+                return core::stream_copy_async(source, blob_stream, length).then([blob_stream] (utility::size64_t) -> pplx::task<void>
+                {
+                    return blob_stream.close();
+                });
             });
+        }
+
+        if (!tuner || (length == protocol::invalid_size64_t))
+        {
+            return upload_task;
+        }
+
+        // The number of blocks in flight is tuned to the throughput of whole uploads
+        auto parallelism = modified_options.parallelism_factor();
+        return upload_task.then([tuner, endpoint, length, start_time, parallelism, max_parallelism] ()
+        {
+            tuner->record_upload(endpoint, length, std::chrono::steady_clock::now() - start_time, parallelism, max_parallelism);
         });
     }
 
-    pplx::task<void> cloud_block_blob::upload_text_async(const utility::string_t& content, const access_condition& condition, const blob_request_options& options, operation_context context)
+    pplx::task<void> cloud_block_blob::upload_from_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
-        auto utf8_body = utility::conversions::to_utf8string(content);
-        auto length = utf8_body.size();
-        auto stream = concurrency::streams::bytestream::open_istream(std::move(utf8_body));
-        m_properties->set_content_type(protocol::header_value_content_type_utf8);
-        return upload_from_stream_async(stream, length, condition, options, context);
+        auto file = core::mapped_file::open_read(path);
+        auto source = concurrency::streams::rawptr_stream<uint8_t>::open_istream(static_cast<const uint8_t*>(file->data()), file->size());
+        return upload_from_stream_async(source, file->size(), condition, options, context).then([file, source] (pplx::task<void> upload_task) mutable
+        {
+            source.close().wait();
+            upload_task.wait();
+        });
     }
 
-    pplx::task<utility::string_t> cloud_block_blob::download_text_async(const access_condition& condition, const blob_request_options& options, operation_context context)
+    pplx::task<void> cloud_block_blob::upload_blocks_from_seekable_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& modified_options, operation_context context)
     {
-        auto properties = m_properties;
-        
-        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
-        return download_to_stream_async(buffer.create_ostream(), condition, options, context).then([buffer, properties] () mutable -> utility::string_t
+        typedef concurrency::streams::istream::traits::char_type char_type;
+
+        auto remaining_length = core::get_remaining_stream_length(source);
+        if ((remaining_length != protocol::invalid_size64_t) && (remaining_length < length))
         {
-            if (properties->content_type() != protocol::header_value_content_type_utf8)
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_stream_short));
+        }
+
+        auto instance = std::make_shared<cloud_block_blob>(*this);
+        auto source_offset = source.tell();
+        auto block_size = static_cast<utility::size64_t>(modified_options.stream_write_size_in_bytes());
+        core::block_id_sequence block_ids;
+        auto block_count = std::make_shared<size_t>(0);
+        auto next_offset = std::make_shared<utility::size64_t>(0);
+        auto upload_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+        auto failed = std::make_shared<std::atomic<bool>>(false);
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        core::async_semaphore source_lock(1);
+
+        core::hash_streambuf blob_hash;
+        if (modified_options.store_blob_content_md5())
+        {
+            blob_hash = core::hash_md5_streambuf();
+        }
+
+        return check_write_condition_async(condition, modified_options, context).then([instance, source, source_offset, length, block_size, block_ids, block_count, next_offset, upload_tasks, failed, semaphore, source_lock, blob_hash, condition, modified_options, context] () mutable -> pplx::task<bool>
+        {
+            return pplx::details::do_while([instance, source, source_offset, length, block_size, block_ids, block_count, next_offset, upload_tasks, failed, semaphore, source_lock, blob_hash, condition, modified_options, context] () mutable -> pplx::task<bool>
             {
-                throw std::logic_error(utility::conversions::to_utf8string(protocol::error_unsupported_text_blob));
+                return semaphore.lock_async().then([instance, source, source_offset, length, block_size, block_ids, block_count, next_offset, upload_tasks, failed, semaphore, source_lock, blob_hash, condition, modified_options, context] () mutable -> pplx::task<bool>
+                {
+                    if (*failed || (*next_offset >= length))
+                    {
+                        semaphore.unlock();
+                        return pplx::task_from_result<bool>(false);
+                    }
+
+                    auto block_offset = *next_offset;
+                    auto block_length = std::min(block_size, length - block_offset);
+                    *next_offset += block_length;
+
+                    auto block_id = block_ids.get_block_id((*block_count)++);
+
+                    // Each block is a view over its range of the source, so no data is copied
+                    concurrency::streams::istream block_stream = core::substream_streambuf<char_type>(source.streambuf(), source_lock, source_offset + static_cast<concurrency::streams::istream::off_type>(block_offset), block_length).create_istream();
+
+                    // MD5s are calculated while the blocks are visited in order, as the blob MD5 covers all of them
+                    pplx::task<utility::string_t> block_md5_task;
+                    if (modified_options.use_transactional_md5() || blob_hash)
+                    {
+                        core::hash_streambuf block_hash;
+                        if (modified_options.use_transactional_md5())
+                        {
+                            block_hash = core::hash_md5_streambuf();
+                        }
+
+                        concurrency::streams::streambuf<char_type> first = block_hash ? concurrency::streams::streambuf<char_type>(block_hash) : core::null_streambuf<char_type>();
+                        concurrency::streams::streambuf<char_type> second = blob_hash ? concurrency::streams::streambuf<char_type>(blob_hash) : core::null_streambuf<char_type>();
+                        auto hash_stream = core::splitter_streambuf<char_type>(first, second).create_ostream();
+                        block_md5_task = core::stream_copy_async(block_stream, hash_stream, block_length).then([block_stream, block_hash] (utility::size64_t) mutable -> utility::string_t
+                        {
+                            block_stream.seek(0);
+                            if (!block_hash)
+                            {
+                                return utility::string_t();
+                            }
+
+                            block_hash.close().wait();
+                            return utility::conversions::to_base64(block_hash.hash());
+                        });
+                    }
+                    else
+                    {
+                        block_md5_task = pplx::task_from_result(utility::string_t());
+                    }
+
+                    return block_md5_task.then([instance, block_id, block_stream, next_offset, length, upload_tasks, failed, semaphore, condition, modified_options, context] (pplx::task<utility::string_t> md5_task) mutable -> bool
+                    {
+                        pplx::task<void> upload_task;
+                        try
+                        {
+                            upload_task = instance->upload_block_async(block_id, block_stream, md5_task.get(), condition, modified_options, context);
+                        }
+                        catch (...)
+                        {
+                            upload_task = pplx::task_from_exception<void>(std::current_exception());
+                        }
+
+                        upload_task.then([semaphore, failed] (pplx::task<void> completed_task) mutable
+                        {
+                            try
+                            {
+                                completed_task.wait();
+                            }
+                            catch (...)
+                            {
+                                *failed = true;
+                            }
+
+                            semaphore.unlock();
+                        });
+
+                        upload_tasks->push_back(upload_task);
+                        return *next_offset < length;
+                    });
+                });
+            });
+        }).then([instance, block_ids, block_count, upload_tasks, semaphore, blob_hash, condition, modified_options, context] (bool) mutable -> pplx::task<void>
+        {
+            return semaphore.wait_all_async().then([instance, block_ids, block_count, upload_tasks, blob_hash, condition, modified_options, context] () mutable -> pplx::task<void>
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = upload_tasks->begin(); iter != upload_tasks->end(); ++iter)
+                {
+                    iter->get();
+                }
+
+                if (blob_hash)
+                {
+                    blob_hash.close().wait();
+                    instance->properties().set_content_md5(utility::conversions::to_base64(blob_hash.hash()));
+                }
+
+                auto block_list = core::block_list_streambuf(block_ids, *block_count).create_istream();
+                return instance->upload_block_list_async(block_list, condition, modified_options, context);
+            });
+        });
+    }
+
+    pplx::task<void> cloud_block_blob::upload_changed_blocks_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        typedef concurrency::streams::istream::traits::char_type char_type;
+
+        assert_no_snapshot();
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        if (length == protocol::invalid_size64_t)
+        {
+            length = core::get_remaining_stream_length(source);
+        }
+
+        if ((length == protocol::invalid_size64_t) || !source.can_seek())
+        {
+            throw std::logic_error(utility::conversions::to_utf8string(protocol::error_changed_blocks_not_seekable));
+        }
+
+        auto remaining_length = core::get_remaining_stream_length(source);
+        if ((remaining_length != protocol::invalid_size64_t) && (remaining_length < length))
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_stream_short));
+        }
+
+        auto instance = std::make_shared<cloud_block_blob>(*this);
+        auto source_offset = source.tell();
+        auto block_size = static_cast<utility::size64_t>(modified_options.stream_write_size_in_bytes());
+        auto state = std::make_shared<changed_blocks_upload_state>(static_cast<size_t>((length + block_size - 1) / block_size));
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        core::async_semaphore source_lock(1);
+
+        core::hash_streambuf blob_hash;
+        if (modified_options.store_blob_content_md5())
+        {
+            blob_hash = core::hash_md5_streambuf();
+        }
+
+        // A blob that does not exist yet has no blocks to reuse
+        auto list_task = instance->download_block_list_async(block_listing_filter::committed, access_condition(), modified_options, context).then([state] (pplx::task<std::vector<block_list_item>> download_task)
+        {
+            try
+            {
+                auto committed_blocks = download_task.get();
+                for (auto iter = committed_blocks.cbegin(); iter != committed_blocks.cend(); ++iter)
+                {
+                    state->committed_blocks[iter->id()] = iter->size();
+                }
+            }
+            catch (const storage_exception& e)
+            {
+                if (e.result().http_status_code() != web::http::status_codes::NotFound)
+                {
+                    throw;
+                }
+            }
+        });
+
+        return list_task.then([instance, source, source_offset, length, block_size, state, semaphore, source_lock, blob_hash, condition, modified_options, context] () mutable -> pplx::task<bool>
+        {
+            return pplx::details::do_while([instance, source, source_offset, length, block_size, state, semaphore, source_lock, blob_hash, condition, modified_options, context] () mutable -> pplx::task<bool>
+            {
+                return semaphore.lock_async().then([instance, source, source_offset, length, block_size, state, semaphore, source_lock, blob_hash, condition, modified_options, context] () mutable -> bool
+                {
+                    if (state->failed || (state->next_offset >= length))
+                    {
+                        semaphore.unlock();
+                        return false;
+                    }
+
+                    auto block_offset = state->next_offset;
+                    auto block_length = std::min(block_size, length - block_offset);
+                    auto block_index = static_cast<size_t>(block_offset / block_size);
+                    state->next_offset += block_length;
+                    auto stream_offset = source_offset + static_cast<concurrency::streams::istream::off_type>(block_offset);
+
+                    // The blob MD5 covers the blocks in order, so it is fed through a chain that reads each block once more
+                    if (blob_hash)
+                    {
+                        state->blob_hash_task = state->blob_hash_task.then([source, source_lock, stream_offset, block_length, blob_hash] () -> pplx::task<void>
+                        {
+                            auto hash_source = core::substream_streambuf<char_type>(source.streambuf(), source_lock, stream_offset, block_length).create_istream();
+                            auto hash_stream = concurrency::streams::streambuf<char_type>(blob_hash).create_ostream();
+                            return core::stream_copy_async(hash_source, hash_stream, block_length).then([] (utility::size64_t)
+                            {
+                            });
+                        });
+                    }
+
+                    // Blocks are hashed in parallel, and the MD5 of a block's content is its fixed-length ID,
+                    // so a block that has not changed has the same ID as the block that is already committed
+                    concurrency::streams::istream block_stream = core::substream_streambuf<char_type>(source.streambuf(), source_lock, stream_offset, block_length).create_istream();
+                    core::hash_streambuf block_hash = core::hash_md5_streambuf();
+                    auto hash_stream = concurrency::streams::streambuf<char_type>(block_hash).create_ostream();
+                    auto block_task = core::stream_copy_async(block_stream, hash_stream, block_length).then([instance, block_stream, block_hash, block_length, block_index, state, condition, modified_options, context] (utility::size64_t) mutable -> pplx::task<void>
+                    {
+                        block_hash.close().wait();
+                        auto block_id = utility::conversions::to_base64(block_hash.hash());
+
+                        bool needs_upload = false;
+                        {
+                            std::lock_guard<std::mutex> guard(state->mutex);
+                            auto committed_block = state->committed_blocks.find(block_id);
+                            if ((committed_block != state->committed_blocks.end()) && (committed_block->second == block_length))
+                            {
+                                state->block_list[block_index] = block_list_item(block_id, block_list_item::committed);
+                            }
+                            else
+                            {
+                                state->block_list[block_index] = block_list_item(block_id, block_list_item::uncommitted);
+                                needs_upload = state->uploaded_blocks.insert(block_id).second;
+                            }
+                        }
+
+                        if (!needs_upload)
+                        {
+                            return pplx::task_from_result();
+                        }
+
+                        // The block ID doubles as the Content-MD5 of the block
+                        block_stream.seek(0);
+                        return instance->upload_block_async(block_id, block_stream, block_id, condition, modified_options, context);
+                    });
+
+                    block_task.then([semaphore, state] (pplx::task<void> completed_task) mutable
+                    {
+                        try
+                        {
+                            completed_task.wait();
+                        }
+                        catch (...)
+                        {
+                            state->failed = true;
+                        }
+
+                        semaphore.unlock();
+                    });
+
+                    state->block_tasks.push_back(block_task);
+                    return state->next_offset < length;
+                });
+            });
+        }).then([instance, state, semaphore, blob_hash, condition, modified_options, context] (bool) mutable -> pplx::task<void>
+        {
+            return semaphore.wait_all_async().then([instance, state, blob_hash, condition, modified_options, context] () mutable -> pplx::task<void>
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = state->block_tasks.begin(); iter != state->block_tasks.end(); ++iter)
+                {
+                    iter->get();
+                }
+
+                if (blob_hash)
+                {
+                    state->blob_hash_task.wait();
+                    blob_hash.close().wait();
+                    instance->properties().set_content_md5(utility::conversions::to_base64(blob_hash.hash()));
+                }
+
+                return instance->upload_block_list_async(state->block_list, condition, modified_options, context);
+            });
+        });
+    }
+
+    pplx::task<void> cloud_block_blob::upload_changed_blocks_from_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        auto file = core::mapped_file::open_read(path);
+        auto source = concurrency::streams::rawptr_stream<uint8_t>::open_istream(static_cast<const uint8_t*>(file->data()), file->size());
+        return upload_changed_blocks_from_stream_async(source, file->size(), condition, options, context).then([file, source] (pplx::task<void> upload_task) mutable
+        {
+            source.close().wait();
+            upload_task.wait();
+        });
+    }
+
+    pplx::task<void> cloud_block_blob::upload_resumable_from_stream_async(concurrency::streams::istream source, utility::size64_t length, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        typedef concurrency::streams::istream::traits::char_type char_type;
+
+        assert_no_snapshot();
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        if (length == protocol::invalid_size64_t)
+        {
+            length = core::get_remaining_stream_length(source);
+        }
+
+        if ((length == protocol::invalid_size64_t) || !source.can_seek())
+        {
+            throw std::logic_error(utility::conversions::to_utf8string(protocol::error_resumable_upload_not_seekable));
+        }
+
+        auto remaining_length = core::get_remaining_stream_length(source);
+        if ((remaining_length != protocol::invalid_size64_t) && (remaining_length < length))
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_stream_short));
+        }
+
+        if ((checkpoint.length() != protocol::invalid_size64_t) && (checkpoint.length() != length))
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_upload_checkpoint_length_mismatch));
+        }
+
+        auto instance = std::make_shared<cloud_block_blob>(*this);
+        auto source_offset = source.tell();
+        auto block_size = static_cast<utility::size64_t>(checkpoint.block_size());
+        auto block_count = static_cast<size_t>((length + block_size - 1) / block_size);
+        core::block_id_sequence block_ids(utility::conversions::to_utf8string(checkpoint.block_id_prefix()));
+        auto state = std::make_shared<resumable_upload_state>(checkpoint, checkpoint_handler);
+        state->checkpoint.m_length = length;
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        core::async_semaphore source_lock(1);
+
+        // The blob MD5 continues from the saved state, or starts over if there is none that fits this upload
+        bool hash_blob = modified_options.store_blob_content_md5();
+        if (!hash_blob || (state->checkpoint.m_hashed_blocks > block_count) || ((state->checkpoint.m_hashed_blocks > 0) && !state->blob_hash.load_state(state->checkpoint.m_md5_state)))
+        {
+            state->checkpoint.m_hashed_blocks = 0;
+            state->checkpoint.m_md5_state.clear();
+        }
+
+        state->first_unhashed_block = state->checkpoint.m_hashed_blocks;
+
+        // The service is the authority on which blocks have been uploaded: the checkpoint may have been saved before the last blocks
+        // went through, and blocks that were never committed are discarded after a week
+        auto list_task = check_write_condition_async(condition, modified_options, context).then([instance, modified_options, context] () -> pplx::task<std::vector<block_list_item>>
+        {
+            return instance->download_block_list_async(block_listing_filter::all, access_condition(), modified_options, context);
+        }).then([state, block_ids, block_count, block_size, length, hash_blob] (pplx::task<std::vector<block_list_item>> download_task)
+        {
+            std::unordered_map<utility::string_t, size_t> service_blocks;
+            try
+            {
+                auto blocks = download_task.get();
+                for (auto iter = blocks.cbegin(); iter != blocks.cend(); ++iter)
+                {
+                    service_blocks[iter->id()] = iter->size();
+                }
+            }
+            catch (const storage_exception& e)
+            {
+                // A blob that does not exist yet has no blocks
+                if (e.result().http_status_code() != web::http::status_codes::NotFound)
+                {
+                    throw;
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(state->mutex);
+            auto& completed_blocks = state->checkpoint.m_completed_blocks;
+            completed_blocks.assign(block_count, false);
+            for (size_t index = 0; index < block_count; ++index)
+            {
+                auto block_offset = static_cast<utility::size64_t>(index) * block_size;
+                auto block_length = static_cast<size_t>(std::min(block_size, length - block_offset));
+                auto service_block = service_blocks.find(block_ids.get_block_id(index));
+                completed_blocks[index] = (service_block != service_blocks.end()) && (service_block->second == block_length);
+            }
+
+            state->skipped_blocks = completed_blocks;
+
+            // Blocks before the first one that has to be sent or hashed are not read at all
+            size_t first_index = 0;
+            while ((first_index < block_count) && completed_blocks[first_index] && (!hash_blob || (first_index < state->first_unhashed_block)))
+            {
+                ++first_index;
+            }
+
+            state->next_index = first_index;
+        });
+
+        return list_task.then([instance, source, source_offset, length, block_size, block_count, block_ids, state, semaphore, source_lock, hash_blob, condition, modified_options, context] () mutable -> pplx::task<bool>
+        {
+            return pplx::details::do_while([instance, source, source_offset, length, block_size, block_count, block_ids, state, semaphore, source_lock, hash_blob, condition, modified_options, context] () mutable -> pplx::task<bool>
+            {
+                return semaphore.lock_async().then([instance, source, source_offset, length, block_size, block_count, block_ids, state, semaphore, source_lock, hash_blob, condition, modified_options, context] () mutable -> bool
+                {
+                    if (state->failed || (state->next_index >= block_count))
+                    {
+                        semaphore.unlock();
+                        return false;
+                    }
+
+                    auto block_index = state->next_index++;
+                    auto block_offset = static_cast<utility::size64_t>(block_index) * block_size;
+                    auto block_length = std::min(block_size, length - block_offset);
+                    auto stream_offset = source_offset + static_cast<concurrency::streams::istream::off_type>(block_offset);
+
+                    // The blob MD5 covers the blocks in order, so it is fed through a chain that reads each block on its own
+                    if (hash_blob && (block_index >= state->first_unhashed_block))
+                    {
+                        state->blob_hash_task = state->blob_hash_task.then([source, source_lock, stream_offset, block_length, block_index, state] () -> pplx::task<void>
+                        {
+                            auto hash_source = core::substream_streambuf<char_type>(source.streambuf(), source_lock, stream_offset, block_length).create_istream();
+                            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                            return core::stream_copy_async(hash_source, buffer.create_ostream(), block_length).then([buffer, block_index, state] (utility::size64_t) mutable
+                            {
+                                state->blob_hash.update(buffer.collection().data(), static_cast<size_t>(buffer.size()));
+
+                                std::lock_guard<std::mutex> guard(state->mutex);
+                                state->checkpoint.m_hashed_blocks = block_index + 1;
+                                state->checkpoint.m_md5_state = state->blob_hash.save_state();
+                            });
+                        });
+                    }
+
+                    if (state->skipped_blocks[block_index])
+                    {
+                        semaphore.unlock();
+                        return state->next_index < block_count;
+                    }
+
+                    concurrency::streams::istream block_stream = core::substream_streambuf<char_type>(source.streambuf(), source_lock, stream_offset, block_length).create_istream();
+                    pplx::task<void> upload_task;
+                    try
+                    {
+                        upload_task = instance->upload_block_async(block_ids.get_block_id(block_index), block_stream, utility::string_t(), condition, modified_options, context);
+                    }
+                    catch (...)
+                    {
+                        upload_task = pplx::task_from_exception<void>(std::current_exception());
+                    }
+
+                    auto block_task = upload_task.then([block_index, state] ()
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        state->checkpoint.m_completed_blocks[block_index] = true;
+                        if (state->checkpoint_handler)
+                        {
+                            state->checkpoint_handler(state->checkpoint);
+                        }
+                    });
+
+                    block_task.then([semaphore, state] (pplx::task<void> completed_task) mutable
+                    {
+                        try
+                        {
+                            completed_task.wait();
+                        }
+                        catch (...)
+                        {
+                            state->failed = true;
+                        }
+
+                        semaphore.unlock();
+                    });
+
+                    state->block_tasks.push_back(block_task);
+                    return state->next_index < block_count;
+                });
+            });
+        }).then([instance, block_ids, block_count, state, semaphore, hash_blob, condition, modified_options, context] (bool) mutable -> pplx::task<void>
+        {
+            return semaphore.wait_all_async().then([instance, block_ids, block_count, state, hash_blob, condition, modified_options, context] () mutable -> pplx::task<void>
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = state->block_tasks.begin(); iter != state->block_tasks.end(); ++iter)
+                {
+                    iter->get();
+                }
+
+                if (hash_blob)
+                {
+                    state->blob_hash_task.get();
+                    instance->properties().set_content_md5(utility::conversions::to_base64(state->blob_hash.finalize()));
+                }
+
+                auto block_list = core::block_list_streambuf(block_ids, block_count).create_istream();
+                return instance->upload_block_list_async(block_list, condition, modified_options, context);
+            });
+        });
+    }
+
+    pplx::task<void> cloud_block_blob::upload_resumable_from_file_async(const utility::string_t& path, const block_blob_upload_checkpoint& checkpoint, std::function<void (const block_blob_upload_checkpoint&)> checkpoint_handler, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        auto file = core::mapped_file::open_read(path);
+        auto source = concurrency::streams::rawptr_stream<uint8_t>::open_istream(static_cast<const uint8_t*>(file->data()), file->size());
+        return upload_resumable_from_stream_async(source, file->size(), checkpoint, checkpoint_handler, condition, options, context).then([file, source] (pplx::task<void> upload_task) mutable
+        {
+            source.close().wait();
+            upload_task.wait();
+        });
+    }
+
+    block_blob_upload_checkpoint::block_blob_upload_checkpoint()
+        : m_block_size(protocol::max_block_size), m_length(protocol::invalid_size64_t), m_hashed_blocks(0)
+    {
+        m_block_id_prefix = utility::conversions::to_string_t(core::block_id_sequence().encoded_prefix());
+    }
+
+    block_blob_upload_checkpoint::block_blob_upload_checkpoint(size_t block_size)
+        : m_block_size(block_size), m_length(protocol::invalid_size64_t), m_hashed_blocks(0)
+    {
+        if ((block_size == 0) || (block_size > protocol::max_block_size))
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_invalid_block_size));
+        }
+
+        m_block_id_prefix = utility::conversions::to_string_t(core::block_id_sequence().encoded_prefix());
+    }
+
+    size_t block_blob_upload_checkpoint::completed_block_count() const
+    {
+        return static_cast<size_t>(std::count(m_completed_blocks.cbegin(), m_completed_blocks.cend(), true));
+    }
+
+    utility::string_t block_blob_upload_checkpoint::to_string() const
+    {
+        // One name=value pair per line, so that the text can be saved and read back as it is
+        utility::string_t result;
+        result.append(checkpoint_version_name).append(U("=")).append(checkpoint_version).append(U("\n"));
+        result.append(checkpoint_block_size_name).append(U("=")).append(utility::conversions::print_string(m_block_size)).append(U("\n"));
+        result.append(checkpoint_block_id_prefix_name).append(U("=")).append(m_block_id_prefix).append(U("\n"));
+        if (m_length != protocol::invalid_size64_t)
+        {
+            result.append(checkpoint_length_name).append(U("=")).append(utility::conversions::print_string(m_length)).append(U("\n"));
+        }
+
+        result.append(checkpoint_completed_blocks_name).append(U("=")).append(format_block_runs(m_completed_blocks)).append(U("\n"));
+        if (m_hashed_blocks > 0)
+        {
+            result.append(checkpoint_hashed_blocks_name).append(U("=")).append(utility::conversions::print_string(m_hashed_blocks)).append(U("\n"));
+            result.append(checkpoint_md5_state_name).append(U("=")).append(utility::conversions::to_base64(m_md5_state)).append(U("\n"));
+        }
+
+        return result;
+    }
+
+    block_blob_upload_checkpoint block_blob_upload_checkpoint::parse(const utility::string_t& value)
+    {
+        block_blob_upload_checkpoint result;
+        result.m_block_id_prefix.clear();
+
+        bool valid = true;
+        bool has_version = false;
+        size_t position = 0;
+        while (valid && (position < value.size()))
+        {
+            auto line_end = value.find(U('\n'), position);
+            if (line_end == utility::string_t::npos)
+            {
+                line_end = value.size();
+            }
+
+            auto line = value.substr(position, line_end - position);
+            if (!line.empty() && (line.back() == U('\r')))
+            {
+                line.pop_back();
+            }
+
+            position = line_end + 1;
+            if (line.empty())
+            {
+                continue;
+            }
+
+            auto separator = line.find(U('='));
+            if (separator == utility::string_t::npos)
+            {
+                valid = false;
+                break;
+            }
+
+            auto name = line.substr(0, separator);
+            auto field = line.substr(separator + 1);
+            utility::size64_t number;
+            if (name == checkpoint_version_name)
+            {
+                has_version = true;
+                valid = (field == checkpoint_version);
+            }
+            else if (name == checkpoint_block_size_name)
+            {
+                valid = parse_checkpoint_number(field, number) && (number > 0) && (number <= protocol::max_block_size);
+                result.m_block_size = static_cast<size_t>(number);
+            }
+            else if (name == checkpoint_block_id_prefix_name)
+            {
+                // The prefix is base64 text, which the block number is appended to
+                valid = !field.empty() && (field.size() % 4 == 0) && (field.find_first_not_of(U("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/")) == utility::string_t::npos);
+                result.m_block_id_prefix = field;
+            }
+            else if (name == checkpoint_length_name)
+            {
+                valid = parse_checkpoint_number(field, number);
+                result.m_length = number;
+            }
+            else if (name == checkpoint_completed_blocks_name)
+            {
+                valid = parse_block_runs(field, result.m_completed_blocks);
+            }
+            else if (name == checkpoint_hashed_blocks_name)
+            {
+                valid = parse_checkpoint_number(field, number) && (number <= 50000);
+                result.m_hashed_blocks = static_cast<size_t>(number);
+            }
+            else if (name == checkpoint_md5_state_name)
+            {
+                result.m_md5_state = utility::conversions::from_base64(field);
+            }
+
+            // Names that this version does not know are skipped, so that later versions can add to the checkpoint
+        }
+
+        if (!valid || !has_version || result.m_block_id_prefix.empty())
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_invalid_upload_checkpoint));
+        }
+
+        return result;
+    }
+
+    pplx::task<void> cloud_block_blob::upload_from_buffers_async(const std::vector<const_buffer>& source, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        auto stream = open_gather_istream(source);
+        auto length = stream.streambuf().size();
+        return upload_from_stream_async(stream, length, condition, options, context);
+    }
+
+    pplx::task<void> cloud_block_blob::upload_text_async(const utility::string_t& content, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        auto utf8_body = utility::conversions::to_utf8string(content);
+        auto length = utf8_body.size();
+        auto stream = concurrency::streams::bytestream::open_istream(std::move(utf8_body));
+        m_properties->set_content_type(protocol::header_value_content_type_utf8);
+        return upload_from_stream_async(stream, length, condition, options, context);
+    }
+
+    pplx::task<utility::string_t> cloud_block_blob::download_text_async(const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        auto properties = m_properties;
+        
+        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+        return download_to_stream_async(buffer.create_ostream(), condition, options, context).then([buffer, properties] () mutable -> utility::string_t
+        {
+            if (properties->content_type() != protocol::header_value_content_type_utf8)
+            {
+                throw std::logic_error(utility::conversions::to_utf8string(protocol::error_unsupported_text_blob));
+            }
+
+            return core::to_string_t(reinterpret_cast<char*>(buffer.collection().data()), static_cast<size_t>(buffer.size()));
+        });
+    }
+
+
+    pplx::task<void> cloud_block_blob::upload_from_blob_async(const cloud_blob& source, const access_condition& source_condition, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        assert_no_snapshot();
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        // The source may belong to another account, whose client has defaults of its own. Every range is read by a single request,
+        // as the pipeline already runs the ranges in parallel.
+        blob_request_options source_options(options);
+        source_options.apply_defaults(source.service_client().default_request_options(), source.type());
+        source_options.set_parallelism_factor(1);
+
+        auto instance = std::make_shared<cloud_block_blob>(*this);
+        auto source_blob = std::make_shared<cloud_blob>(source);
+        auto block_size = std::min<utility::size64_t>(modified_options.stream_write_size_in_bytes(), protocol::max_block_size);
+        if (block_size == 0)
+        {
+            block_size = protocol::max_block_size;
+        }
+
+        // Up to parallelism ranges are downloaded while as many blocks are uploaded, so the ring holds twice as many buffers
+        auto parallelism = std::max(modified_options.parallelism_factor(), 1);
+        auto state = std::make_shared<blob_copy_state>(static_cast<size_t>(parallelism) * 2);
+        core::block_id_sequence block_ids;
+        core::async_semaphore download_slots(parallelism);
+        core::async_semaphore upload_slots(parallelism);
+
+        return check_write_condition_async(condition, modified_options, context).then([source_blob, source_condition, source_options, context] () -> pplx::task<void>
+        {
+            return source_blob->download_attributes_async(source_condition, source_options, context);
+        }).then([instance, source_blob, source_condition, source_options, block_size, state, block_ids, download_slots, upload_slots, condition, modified_options, context] () mutable -> pplx::task<bool>
+        {
+            auto length = source_blob->properties().size();
+
+            // Every range must come from the version of the source whose length was just read
+            access_condition range_condition(source_condition);
+            range_condition.set_if_match_etag(source_blob->properties().etag());
+
+            return pplx::details::do_while([instance, source_blob, range_condition, source_options, length, block_size, state, block_ids, download_slots, upload_slots, condition, modified_options, context] () mutable -> pplx::task<bool>
+            {
+                if (state->failed || (state->next_offset >= length))
+                {
+                    return pplx::task_from_result<bool>(false);
+                }
+
+                auto buffers = state->buffers;
+                return buffers->acquire_async(static_cast<size_t>(block_size), modified_options.buffer_allocator()).then([instance, source_blob, range_condition, source_options, length, block_size, state, block_ids, download_slots, upload_slots, condition, modified_options, context] (core::transfer_buffer buffer) mutable -> pplx::task<bool>
+                {
+                    auto block_buffer = std::make_shared<core::transfer_buffer>(std::move(buffer));
+                    return download_slots.lock_async().then([instance, source_blob, range_condition, source_options, length, block_size, state, block_ids, block_buffer, download_slots, upload_slots, condition, modified_options, context] () mutable -> bool
+                    {
+                        if (state->failed)
+                        {
+                            download_slots.unlock();
+                            state->buffers->release(std::move(*block_buffer));
+                            return false;
+                        }
+
+                        auto block_offset = state->next_offset;
+                        auto block_length = static_cast<size_t>(std::min(block_size, length - block_offset));
+                        auto block_id = block_ids.get_block_id(static_cast<size_t>(block_offset / block_size));
+                        state->next_offset += block_length;
+                        block_buffer->resize(block_length);
+
+                        pplx::task<size_t> download_task;
+                        try
+                        {
+                            download_task = source_blob->download_range_to_buffer_async(block_buffer->data(), block_length, static_cast<int64_t>(block_offset), range_condition, source_options, context);
+                        }
+                        catch (...)
+                        {
+                            download_task = pplx::task_from_exception<size_t>(std::current_exception());
+                        }
+
+                        // The download slot is given back as soon as the range has arrived, so the next range can be read while this block is uploaded
+                        auto block_task = download_task.then([download_slots] (pplx::task<size_t> completed_task) mutable -> size_t
+                        {
+                            download_slots.unlock();
+                            return completed_task.get();
+                        }).then([instance, block_id, block_buffer, upload_slots, condition, modified_options, context] (size_t) mutable -> pplx::task<void>
+                        {
+                            return upload_slots.lock_async().then([instance, block_id, block_buffer, upload_slots, condition, modified_options, context] () mutable -> pplx::task<void>
+                            {
+                                pplx::task<void> upload_task;
+                                try
+                                {
+                                    std::vector<const_buffer> block_data(1, const_buffer(block_buffer->data(), block_buffer->size()));
+                                    upload_task = instance->upload_block_async(block_id, block_data, utility::string_t(), condition, modified_options, context);
+                                }
+                                catch (...)
+                                {
+                                    upload_task = pplx::task_from_exception<void>(std::current_exception());
+                                }
+
+                                return upload_task.then([upload_slots] (pplx::task<void> completed_task) mutable
+                                {
+                                    upload_slots.unlock();
+                                    completed_task.wait();
+                                });
+                            });
+                        }).then([state, block_buffer] (pplx::task<void> completed_task)
+                        {
+                            state->buffers->release(std::move(*block_buffer));
+                            try
+                            {
+                                completed_task.wait();
+                            }
+                            catch (...)
+                            {
+                                std::lock_guard<std::mutex> guard(state->mutex);
+                                if (state->first_error == nullptr)
+                                {
+                                    state->first_error = std::current_exception();
+                                }
+
+                                state->failed = true;
+                            }
+                        });
+
+                        state->block_tasks.push_back(block_task);
+                        return state->next_offset < length;
+                    });
+                });
+            });
+        }).then([state] (bool) -> pplx::task<void>
+        {
+            // The tasks of the blocks never fail, as their errors are recorded instead
+            if (state->block_tasks.empty())
+            {
+                return pplx::task_from_result();
+            }
+
+            return pplx::when_all(state->block_tasks.begin(), state->block_tasks.end());
+        }).then([instance, source_blob, block_size, state, block_ids, condition, modified_options, context] () -> pplx::task<void>
+        {
+            if (state->first_error != nullptr)
+            {
+                std::rethrow_exception(state->first_error);
+            }
+
+            // The blob keeps the properties and metadata of the source, as with a copy done by the service
+            const auto& source_properties = source_blob->properties();
+            instance->properties().set_cache_control(source_properties.cache_control());
+            instance->properties().set_content_disposition(source_properties.content_disposition());
+            instance->properties().set_content_encoding(source_properties.content_encoding());
+            instance->properties().set_content_language(source_properties.content_language());
+            instance->properties().set_content_md5(source_properties.content_md5());
+            instance->properties().set_content_type(source_properties.content_type());
+            instance->metadata() = source_blob->metadata();
+
+            auto block_count = static_cast<size_t>((source_properties.size() + block_size - 1) / block_size);
+            auto block_list = core::block_list_streambuf(block_ids, block_count).create_istream();
+            return instance->upload_block_list_async(block_list, condition, modified_options, context);
+        });
+    }
+
+    pplx::task<void> cloud_block_blob::upload_compressed_from_stream_async(concurrency::streams::istream source, std::shared_ptr<block_codec> codec, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        if (codec == nullptr)
+        {
+            throw std::invalid_argument("codec");
+        }
+
+        assert_no_snapshot();
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        auto instance = std::make_shared<cloud_block_blob>(*this);
+        auto block_size = modified_options.stream_write_size_in_bytes();
+        core::block_id_sequence block_ids;
+        auto block_count = std::make_shared<size_t>(0);
+        auto upload_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+        auto failed = std::make_shared<std::atomic<bool>>(false);
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+
+        return check_write_condition_async(condition, modified_options, context).then([instance, source, codec, block_size, block_ids, block_count, upload_tasks, failed, semaphore, condition, modified_options, context] () mutable -> pplx::task<bool>
+        {
+            return pplx::details::do_while([instance, source, codec, block_size, block_ids, block_count, upload_tasks, failed, semaphore, condition, modified_options, context] () mutable -> pplx::task<bool>
+            {
+                return semaphore.lock_async().then([instance, source, codec, block_size, block_ids, block_count, upload_tasks, failed, semaphore, condition, modified_options, context] () mutable -> pplx::task<bool>
+                {
+                    if (*failed)
+                    {
+                        semaphore.unlock();
+                        return pplx::task_from_result<bool>(false);
+                    }
+
+                    concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                    return source.read(buffer, block_size).then([instance, buffer, codec, block_ids, block_count, upload_tasks, failed, semaphore, condition, modified_options, context] (pplx::task<size_t> read_task) mutable -> bool
+                    {
+                        size_t read_count;
+                        try
+                        {
+                            read_count = read_task.get();
+                        }
+                        catch (...)
+                        {
+                            semaphore.unlock();
+                            throw;
+                        }
+
+                        if (read_count == 0)
+                        {
+                            semaphore.unlock();
+                            return false;
+                        }
+
+                        auto block_id = block_ids.get_block_id((*block_count)++);
+                        auto data = std::make_shared<std::vector<uint8_t>>(std::move(buffer.collection()));
+
+                        // Each block is compressed by a task of its own, so the blocks in flight are compressed on several threads
+                        auto upload_task = pplx::create_task([codec, data] () -> std::vector<uint8_t>
+                        {
+                            return codec->compress(data->data(), data->size());
+                        }).then([instance, block_id, condition, modified_options, context] (std::vector<uint8_t> compressed) -> pplx::task<void>
+                        {
+                            return instance->upload_block_async(block_id, concurrency::streams::bytestream::open_istream(std::move(compressed)), utility::string_t(), condition, modified_options, context);
+                        });
+
+                        upload_task.then([semaphore, failed] (pplx::task<void> completed_task) mutable
+                        {
+                            try
+                            {
+                                completed_task.wait();
+                            }
+                            catch (...)
+                            {
+                                *failed = true;
+                            }
+
+                            semaphore.unlock();
+                        });
+
+                        upload_tasks->push_back(upload_task);
+                        return true;
+                    });
+                });
+            });
+        }).then([instance, codec, block_ids, block_count, upload_tasks, semaphore, condition, modified_options, context] (bool) mutable -> pplx::task<void>
+        {
+            return semaphore.wait_all_async().then([instance, codec, block_ids, block_count, upload_tasks, condition, modified_options, context] () mutable -> pplx::task<void>
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = upload_tasks->begin(); iter != upload_tasks->end(); ++iter)
+                {
+                    iter->get();
+                }
+
+                instance->properties().set_content_encoding(codec->content_encoding());
+                instance->properties().set_content_md5(utility::string_t());
+
+                auto block_list = core::block_list_streambuf(block_ids, *block_count).create_istream();
+                return instance->upload_block_list_async(block_list, condition, modified_options, context);
+            });
+        });
+    }
+
+    pplx::task<void> cloud_block_blob::download_decompressed_to_stream_async(concurrency::streams::ostream target, std::shared_ptr<block_codec> codec, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        if (codec == nullptr)
+        {
+            throw std::invalid_argument("codec");
+        }
+
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        auto instance = std::make_shared<cloud_block_blob>(*this);
+        return instance->download_block_list_async(block_listing_filter::committed, condition, modified_options, context).then([instance, target, codec, condition, modified_options, context] (std::vector<block_list_item> blocks) mutable -> pplx::task<void>
+        {
+            if (blocks.empty())
+            {
+                concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                return instance->download_to_stream_async(buffer.create_ostream(), condition, modified_options, context).then([target, codec, buffer] () mutable -> pplx::task<void>
+                {
+                    auto content = std::make_shared<std::vector<uint8_t>>(codec->decompress(buffer.collection().data(), buffer.collection().size()));
+                    return target.streambuf().putn(content->data(), content->size()).then([content] (size_t)
+                    {
+                    });
+                });
+            }
+
+            // A block keeps its slot until its content has been written, so at most parallelism_factor blocks are held in memory
+            core::async_semaphore semaphore(modified_options.parallelism_factor());
+            auto failed = std::make_shared<std::atomic<bool>>(false);
+            auto write_task = pplx::task_from_result();
+            int64_t offset = 0;
+            for (auto iter = blocks.cbegin(); iter != blocks.cend(); ++iter)
+            {
+                auto block_offset = offset;
+                auto block_length = static_cast<int64_t>(iter->size());
+                offset += block_length;
+
+                auto content_task = semaphore.lock_async().then([instance, block_offset, block_length, failed, condition, modified_options, context] () -> pplx::task<std::vector<uint8_t>>
+                {
+                    if (*failed)
+                    {
+                        return pplx::task_from_result(std::vector<uint8_t>());
+                    }
+
+                    concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                    return instance->download_range_to_stream_async(buffer.create_ostream(), block_offset, block_length, condition, modified_options, context).then([buffer] () mutable -> std::vector<uint8_t>
+                    {
+                        return std::move(buffer.collection());
+                    });
+                }).then([codec, failed] (std::vector<uint8_t> compressed) -> std::shared_ptr<std::vector<uint8_t>>
+                {
+                    if (*failed)
+                    {
+                        return std::make_shared<std::vector<uint8_t>>();
+                    }
+
+                    return std::make_shared<std::vector<uint8_t>>(codec->decompress(compressed.data(), compressed.size()));
+                });
+
+                write_task = write_task.then([content_task, target, semaphore, failed] (pplx::task<void> previous_task) mutable -> pplx::task<void>
+                {
+                    return content_task.then([previous_task, target, semaphore, failed] (pplx::task<std::shared_ptr<std::vector<uint8_t>>> completed_task) mutable -> pplx::task<void>
+                    {
+                        std::shared_ptr<std::vector<uint8_t>> content;
+                        try
+                        {
+                            previous_task.wait();
+                            content = completed_task.get();
+                        }
+                        catch (...)
+                        {
+                            *failed = true;
+                            semaphore.unlock();
+                            throw;
+                        }
+
+                        return target.streambuf().putn(content->data(), content->size()).then([content, semaphore, failed] (pplx::task<size_t> put_task) mutable
+                        {
+                            semaphore.unlock();
+                            try
+                            {
+                                put_task.wait();
+                            }
+                            catch (...)
+                            {
+                                *failed = true;
+                                throw;
+                            }
+                        });
+                    });
+                });
             }
 
-            std::string utf8_body(reinterpret_cast<char*>(buffer.collection().data()), static_cast<unsigned int>(buffer.size()));
-            return utility::conversions::to_string_t(utf8_body);
+            return write_task;
         });
     }
 
@@ -19,9 +19,249 @@
 #include "was/service_client.h"
 #include "wascore/protocol.h"
 #include "wascore/protocol_xml.h"
+#include "wascore/resources.h"
+#include "wascore/http_client_pool.h"
+#include "wascore/location_selector.h"
+#include "wascore/retry_budget.h"
+#include "wascore/latency_recorder.h"
+#include "wascore/prepared_request.h"
+#include "wascore/request_coalescer.h"
+#include "wascore/existence_cache.h"
+#include "wascore/operation_dispatcher.h"
+#include "wascore/circuit_breaker.h"
 
 namespace wa { namespace storage {
 
+    cloud_client::cloud_client(const storage_uri& base_uri)
+        : m_base_uri(base_uri), m_http_client_pool(std::make_shared<core::http_client_pool>(wa::storage::connection_pool_settings())),
+        m_location_selector(std::make_shared<core::location_selector>()), m_retry_budget(std::make_shared<core::retry_budget>()),
+        m_latency_recorder(std::make_shared<core::latency_recorder>()), m_prepared_requests(std::make_shared<core::prepared_request_cache>()),
+        m_request_coalescer(std::make_shared<core::request_coalescer>()), m_existence_cache(std::make_shared<core::existence_cache>()),
+        m_operation_dispatcher(std::make_shared<core::operation_dispatcher>()), m_circuit_breaker(std::make_shared<core::circuit_breaker>())
+    {
+    }
+
+    cloud_client::cloud_client(const storage_uri& base_uri, const wa::storage::storage_credentials& credentials)
+        : m_base_uri(base_uri), m_credentials(credentials), m_http_client_pool(std::make_shared<core::http_client_pool>(wa::storage::connection_pool_settings())),
+        m_location_selector(std::make_shared<core::location_selector>()), m_retry_budget(std::make_shared<core::retry_budget>()),
+        m_latency_recorder(std::make_shared<core::latency_recorder>()), m_prepared_requests(std::make_shared<core::prepared_request_cache>()),
+        m_request_coalescer(std::make_shared<core::request_coalescer>()), m_existence_cache(std::make_shared<core::existence_cache>()),
+        m_operation_dispatcher(std::make_shared<core::operation_dispatcher>()), m_circuit_breaker(std::make_shared<core::circuit_breaker>())
+    {
+    }
+
+    wa::storage::connection_pool_settings cloud_client::connection_pool_settings() const
+    {
+        if (!m_http_client_pool)
+        {
+            return wa::storage::connection_pool_settings();
+        }
+
+        return m_http_client_pool->settings();
+    }
+
+    void cloud_client::set_connection_pool_settings(const wa::storage::connection_pool_settings& value)
+    {
+        if (m_http_client_pool)
+        {
+            m_http_client_pool->set_settings(value);
+        }
+    }
+
+    pplx::task<int> cloud_client::warm_up_async(int connections) const
+    {
+        if (connections < 0)
+        {
+            throw std::invalid_argument("connections");
+        }
+
+        std::vector<pplx::task<int>> tasks;
+        if (m_http_client_pool && (connections > 0))
+        {
+            auto config = core::http_client_pool::client_config();
+            if (!m_base_uri.primary_uri().is_empty())
+            {
+                tasks.push_back(m_http_client_pool->warm_up_async(m_base_uri.primary_uri().authority(), config, connections));
+            }
+
+            if (!m_base_uri.secondary_uri().is_empty())
+            {
+                tasks.push_back(m_http_client_pool->warm_up_async(m_base_uri.secondary_uri().authority(), config, connections));
+            }
+        }
+
+        if (tasks.empty())
+        {
+            return pplx::task_from_result(0);
+        }
+
+        return pplx::when_all(tasks.begin(), tasks.end()).then([] (std::vector<int> results) -> int
+        {
+            int opened = 0;
+            for (auto iter = results.cbegin(); iter != results.cend(); ++iter)
+            {
+                opened += *iter;
+            }
+
+            return opened;
+        });
+    }
+
+    bool cloud_client::request_coalescing() const
+    {
+        return m_request_coalescer && m_request_coalescer->is_enabled();
+    }
+
+    void cloud_client::set_request_coalescing(bool value)
+    {
+        if (m_request_coalescer)
+        {
+            m_request_coalescer->set_enabled(value);
+        }
+    }
+
+    std::chrono::seconds cloud_client::existence_cache_time_to_live() const
+    {
+        return m_existence_cache ? m_existence_cache->time_to_live() : std::chrono::seconds(0);
+    }
+
+    void cloud_client::set_existence_cache_time_to_live(std::chrono::seconds value)
+    {
+        if (m_existence_cache)
+        {
+            m_existence_cache->set_time_to_live(value);
+        }
+    }
+
+    int cloud_client::max_concurrent_operations() const
+    {
+        return m_operation_dispatcher ? m_operation_dispatcher->max_concurrent_operations() : 0;
+    }
+
+    void cloud_client::set_max_concurrent_operations(int value)
+    {
+        if (value < 0)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        if (m_operation_dispatcher)
+        {
+            m_operation_dispatcher->set_max_concurrent_operations(value);
+        }
+    }
+
+    wa::storage::dispatch_tag_settings cloud_client::get_dispatch_tag_settings(const utility::string_t& tag) const
+    {
+        return m_operation_dispatcher ? m_operation_dispatcher->tag_settings(tag) : wa::storage::dispatch_tag_settings();
+    }
+
+    void cloud_client::set_dispatch_tag_settings(const utility::string_t& tag, const wa::storage::dispatch_tag_settings& value)
+    {
+        if (m_operation_dispatcher)
+        {
+            m_operation_dispatcher->set_tag_settings(tag, value);
+        }
+    }
+
+    std::map<utility::string_t, dispatch_tag_statistics> cloud_client::dispatch_statistics() const
+    {
+        if (!m_operation_dispatcher)
+        {
+            return std::map<utility::string_t, dispatch_tag_statistics>();
+        }
+
+        return m_operation_dispatcher->statistics();
+    }
+
+    void cloud_client::reset_dispatch_statistics()
+    {
+        if (m_operation_dispatcher)
+        {
+            m_operation_dispatcher->reset_statistics();
+        }
+    }
+
+    wa::storage::circuit_breaker_settings cloud_client::circuit_breaker_settings() const
+    {
+        if (!m_circuit_breaker)
+        {
+            return wa::storage::circuit_breaker_settings();
+        }
+
+        return m_circuit_breaker->settings();
+    }
+
+    void cloud_client::set_circuit_breaker_settings(const wa::storage::circuit_breaker_settings& value)
+    {
+        if (m_circuit_breaker)
+        {
+            m_circuit_breaker->set_settings(value);
+        }
+    }
+
+    double cloud_client::retry_budget_ratio() const
+    {
+        return m_retry_budget ? m_retry_budget->ratio() : 0.0;
+    }
+
+    void cloud_client::set_retry_budget_ratio(double value)
+    {
+        if (value < 0.0 || value > 1.0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_retry_budget_ratio));
+        }
+
+        if (m_retry_budget)
+        {
+            m_retry_budget->set_ratio(value);
+        }
+    }
+
+    std::map<utility::string_t, request_latency_histograms> cloud_client::latency_histograms() const
+    {
+        if (!m_latency_recorder)
+        {
+            return std::map<utility::string_t, request_latency_histograms>();
+        }
+
+        return m_latency_recorder->histograms();
+    }
+
+    void cloud_client::reset_latency_histograms()
+    {
+        if (m_latency_recorder)
+        {
+            m_latency_recorder->reset();
+        }
+    }
+
+    void cloud_client::set_service_name(const utility::string_t& value)
+    {
+        if (m_latency_recorder)
+        {
+            m_latency_recorder->set_service(value);
+        }
+    }
+
+    std::shared_ptr<wa::storage::metrics_sink> cloud_client::metrics_sink() const
+    {
+        if (!m_latency_recorder)
+        {
+            return nullptr;
+        }
+
+        return m_latency_recorder->metrics_sink();
+    }
+
+    void cloud_client::set_metrics_sink(std::shared_ptr<wa::storage::metrics_sink> value)
+    {
+        if (m_latency_recorder)
+        {
+            m_latency_recorder->set_metrics_sink(value);
+        }
+    }
+
     pplx::task<service_properties> cloud_client::download_service_properties_base_async(const request_options& modified_options, operation_context context) const
     {
         auto command = std::make_shared<core::storage_command<service_properties>>(base_uri());
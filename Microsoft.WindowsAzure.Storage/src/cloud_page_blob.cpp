@@ -16,15 +16,162 @@
 // -----------------------------------------------------------------------------------------
 
 #include "stdafx.h"
+#include <map>
+#include <mutex>
+
+#include "wascore/async_semaphore.h"
 #include "wascore/protocol.h"
 #include "wascore/protocol_xml.h"
 #include "wascore/blobstreams.h"
 
 namespace wa { namespace storage {
 
+    namespace
+    {
+        // Describes the valid page ranges of a blob as written ranges, and optionally the holes between them as cleared ranges
+        std::vector<page_diff_range> get_written_ranges(const std::vector<page_range>& ranges, int64_t blob_size, bool include_holes)
+        {
+            std::vector<page_diff_range> result;
+            int64_t valid_end = 0;
+            for (auto iter = ranges.cbegin(); iter != ranges.cend(); ++iter)
+            {
+                if (include_holes && (iter->start_offset() > valid_end))
+                {
+                    result.push_back(page_diff_range(valid_end, iter->start_offset() - 1, true));
+                }
+
+                result.push_back(page_diff_range(iter->start_offset(), iter->end_offset(), false));
+                valid_end = iter->end_offset() + 1;
+            }
+
+            if (include_holes && (blob_size > valid_end))
+            {
+                result.push_back(page_diff_range(valid_end, blob_size - 1, true));
+            }
+
+            return result;
+        }
+
+        // Passes the page ranges of consecutive windows to a handler in order, merging the ranges that continue into the next window
+        struct page_range_windows
+        {
+            page_range_windows(std::function<bool (const page_range&)> handler, int parallelism_factor)
+                : handler(handler), slots(parallelism_factor), next_window(0), pending(0, -1), has_pending(false), is_stopped(false)
+            {
+            }
+
+            // Must be called with the mutex held. Returns false once the handler has stopped the listing.
+            bool deliver(const std::vector<page_range>& ranges)
+            {
+                for (auto iter = ranges.cbegin(); iter != ranges.cend(); ++iter)
+                {
+                    if (has_pending && (pending.end_offset() + 1 == iter->start_offset()))
+                    {
+                        pending = page_range(pending.start_offset(), iter->end_offset());
+                        continue;
+                    }
+
+                    if (has_pending && !handler(pending))
+                    {
+                        has_pending = false;
+                        return false;
+                    }
+
+                    pending = *iter;
+                    has_pending = true;
+                }
+
+                return true;
+            }
+
+            // Each window holds a slot until its ranges have been passed on, so at most the parallelism factor of them are buffered
+            void complete(size_t window, pplx::task<std::vector<page_range>> list_task)
+            {
+                std::vector<page_range> ranges;
+                std::exception_ptr list_error;
+                try
+                {
+                    ranges = list_task.get();
+                }
+                catch (...)
+                {
+                    list_error = std::current_exception();
+                }
+
+                size_t released = 0;
+                {
+                    std::lock_guard<std::mutex> guard(mutex);
+                    if (is_stopped || (list_error != nullptr))
+                    {
+                        if (!is_stopped)
+                        {
+                            error = list_error;
+                            is_stopped = true;
+                        }
+
+                        released = 1;
+                    }
+                    else
+                    {
+                        completed[window] = std::move(ranges);
+                        try
+                        {
+                            for (auto iter = completed.find(next_window); iter != completed.end(); iter = completed.find(next_window))
+                            {
+                                bool next = deliver(iter->second);
+                                completed.erase(iter);
+                                ++next_window;
+                                ++released;
+                                if (!next)
+                                {
+                                    is_stopped = true;
+                                    break;
+                                }
+                            }
+                        }
+                        catch (...)
+                        {
+                            error = std::current_exception();
+                            is_stopped = true;
+                        }
+                    }
+
+                    if (is_stopped)
+                    {
+                        released += completed.size();
+                        completed.clear();
+                    }
+                }
+
+                // Released outside the lock, because a waiting window may start on this thread
+                for (size_t i = 0; i < released; ++i)
+                {
+                    slots.unlock();
+                }
+            }
+
+            bool stopped()
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                return is_stopped;
+            }
+
+            std::function<bool (const page_range&)> handler;
+            core::async_semaphore slots;
+            std::mutex mutex;
+            std::map<size_t, std::vector<page_range>> completed;
+            size_t next_window;
+            page_range pending;
+            bool has_pending;
+            bool is_stopped;
+            std::exception_ptr error;
+        };
+    }
+
     pplx::task<void> cloud_page_blob::clear_pages_async(int64_t start_offset, int64_t length, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
@@ -32,7 +179,7 @@ namespace wa { namespace storage {
         page_range range(start_offset, end_offset);
 
         auto command = std::make_shared<core::storage_command<void>>(uri());
-        command->set_build_request(std::bind(protocol::put_page, range, page_write::clear, utility::string_t(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        command->set_build_request(std::bind(protocol::put_page, range, page_write::clear, utility::string_t(), utility::string_t(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_preprocess_response(std::bind(protocol::preprocess_response, std::placeholders::_1, std::placeholders::_2));
         return core::executor<void>::execute_async(command, modified_options, context);
@@ -41,11 +188,13 @@ namespace wa { namespace storage {
     pplx::task<void> cloud_page_blob::upload_pages_async(concurrency::streams::istream page_data, int64_t start_offset, const utility::string_t& content_md5, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
         auto properties = m_properties;
         bool needs_md5 = content_md5.empty() && modified_options.use_transactional_md5();
+        bool needs_crc64 = modified_options.use_transactional_crc64();
         
         auto command = std::make_shared<core::storage_command<void>>(uri());
         command->set_authentication_handler(service_client().authentication_handler());
@@ -54,14 +203,14 @@ namespace wa { namespace storage {
             protocol::preprocess_response(response, context);
             properties->update_etag_and_last_modified(protocol::blob_response_parsers::parse_blob_properties(response));
         });
-        return core::istream_descriptor::create(page_data, needs_md5).then([command, context, start_offset, content_md5, modified_options, condition] (core::istream_descriptor request_body) -> pplx::task<void>
+        return core::istream_descriptor::create(page_data, needs_md5, protocol::invalid_size64_t, needs_crc64, modified_options.buffer_allocator()).then([command, context, start_offset, content_md5, modified_options, condition] (core::istream_descriptor request_body) -> pplx::task<void>
         {
             auto md5 = content_md5.empty() ? request_body.content_md5() : content_md5;
             auto end_offset = start_offset + request_body.length() - 1;
             page_range range(start_offset, end_offset);
-            command->set_build_request(std::bind(protocol::put_page, range, page_write::update, md5, condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            command->set_build_request(std::bind(protocol::put_page, range, page_write::update, md5, request_body.content_crc64(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
             command->set_request_body(request_body);
-            return core::executor<void>::execute_async(command, modified_options, context);
+            return core::add_transfer_progress(core::executor<void>::execute_async(command, modified_options, context), modified_options, request_body.length());
         });
     }
 
@@ -79,7 +228,7 @@ namespace wa { namespace storage {
         auto instance = std::make_shared<cloud_page_blob>(*this);
         return instance->download_attributes_async(condition, modified_options, context).then([instance, condition, modified_options, context] () -> concurrency::streams::ostream
         {
-            return core::cloud_page_blob_ostreambuf(instance, instance->properties().size(), condition, modified_options, context).create_ostream();
+            return core::cloud_page_blob_ostreambuf(instance, instance->properties().size(), /* is_new_blob */ false, condition, modified_options, context).create_ostream();
         });
     }
 
@@ -92,7 +241,7 @@ namespace wa { namespace storage {
         auto instance = std::make_shared<cloud_page_blob>(*this);
         return instance->create_async(size, condition, modified_options, context).then([instance, size, condition, modified_options, context] () -> concurrency::streams::ostream
         {
-            return core::cloud_page_blob_ostreambuf(instance, size, condition, modified_options, context).create_ostream();
+            return core::cloud_page_blob_ostreambuf(instance, size, /* is_new_blob */ true, condition, modified_options, context).create_ostream();
         });
     }
 
@@ -111,6 +260,36 @@ namespace wa { namespace storage {
             }
         }
 
+        // The upload is sent as if the container existed, and only if it does not is the container created and the upload sent again
+        if (modified_options.create_container_if_not_found() && source.can_seek())
+        {
+            blob_request_options upload_options(modified_options);
+            upload_options.set_create_container_if_not_found(false);
+            auto instance = std::make_shared<cloud_page_blob>(*this);
+            auto position = source.tell();
+            return upload_from_stream_async(source, length, condition, upload_options, context).then([instance, source, position, length, condition, upload_options, context] (pplx::task<void> upload_task) mutable -> pplx::task<void>
+            {
+                try
+                {
+                    upload_task.wait();
+                    return pplx::task_from_result();
+                }
+                catch (const storage_exception& e)
+                {
+                    if (!core::is_storage_error(e, web::http::status_codes::NotFound, protocol::error_code_container_not_found))
+                    {
+                        throw;
+                    }
+                }
+
+                source.seek(position);
+                return instance->container()._create_after_not_found_async(upload_options, context).then([instance, source, length, condition, upload_options, context] () -> pplx::task<void>
+                {
+                    return instance->upload_from_stream_async(source, length, condition, upload_options, context);
+                });
+            });
+        }
+
         return open_write_async(length, condition, modified_options, context).then([source, length] (concurrency::streams::ostream blob_stream) -> pplx::task<void>
         {
             return core::stream_copy_async(source, blob_stream, length).then([blob_stream] (utility::size64_t) -> pplx::task<void>
@@ -120,19 +299,243 @@ namespace wa { namespace storage {
         });
     }
 
+    pplx::task<void> cloud_page_blob::upload_from_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        auto file = core::mapped_file::open_read(path);
+        auto source = concurrency::streams::rawptr_stream<uint8_t>::open_istream(static_cast<const uint8_t*>(file->data()), file->size());
+        return upload_from_stream_async(source, file->size(), condition, options, context).then([file, source] (pplx::task<void> upload_task) mutable
+        {
+            source.close().wait();
+            upload_task.wait();
+        });
+    }
+
+    pplx::task<void> cloud_page_blob::download_sparse_to_stream_async(concurrency::streams::ostream target, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        if (!target.can_seek())
+        {
+            throw std::logic_error(utility::conversions::to_utf8string(protocol::error_sparse_download_not_seekable));
+        }
+
+        // Listing the page ranges also retrieves the size and the ETag of the blob
+        auto instance = std::make_shared<cloud_page_blob>(*this);
+        return instance->download_page_ranges_async(condition, modified_options, context).then([instance, target, condition, modified_options, context] (std::vector<page_range> ranges) -> pplx::task<void>
+        {
+            auto written_ranges = get_written_ranges(ranges, static_cast<int64_t>(instance->properties().size()), /* include_holes */ true);
+            return instance->download_page_ranges_to_stream_async(target, written_ranges, condition, modified_options, context);
+        });
+    }
+
+    pplx::task<void> cloud_page_blob::download_sparse_to_file_async(const utility::string_t& path, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        auto instance = std::make_shared<cloud_page_blob>(*this);
+        return instance->download_page_ranges_async(condition, modified_options, context).then([instance, path, condition, modified_options, context] (std::vector<page_range> ranges) -> pplx::task<void>
+        {
+            // A new file reads as zeros, so only the valid ranges are written and the holes stay unallocated
+            auto file = core::mapped_file::create(path, instance->properties().size(), /* sparse */ true);
+            auto target = concurrency::streams::rawptr_stream<uint8_t>::open_ostream(file->data(), file->size());
+            auto written_ranges = get_written_ranges(ranges, static_cast<int64_t>(instance->properties().size()), /* include_holes */ false);
+            return instance->download_page_ranges_to_stream_async(target, written_ranges, condition, modified_options, context).then([file, target] (pplx::task<void> download_task) mutable
+            {
+                target.close().wait();
+                download_task.wait();
+                file->flush();
+            });
+        });
+    }
+
+    pplx::task<std::vector<page_diff_range>> cloud_page_blob::download_page_ranges_diff_async(const utility::string_t& previous_snapshot_time, const access_condition& condition, const blob_request_options& options, operation_context context) const
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        auto properties = m_properties;
+
+        auto command = std::make_shared<core::storage_command<std::vector<page_diff_range>>>(uri());
+        command->set_build_request(std::bind(protocol::get_page_ranges_diff, snapshot_time(), previous_snapshot_time, condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        command->set_authentication_handler(service_client().authentication_handler());
+        command->set_location_mode(core::command_location_mode::primary_or_secondary);
+        command->set_preprocess_response([properties] (const web::http::http_response& response, operation_context context) -> std::vector<page_diff_range>
+        {
+            protocol::preprocess_response(response, context);
+            
+            auto parsed_properties = protocol::blob_response_parsers::parse_blob_properties(response);
+            properties->update_etag_and_last_modified(parsed_properties);
+            properties->update_size(parsed_properties);
+            return std::vector<page_diff_range>();
+        });
+        command->set_postprocess_response([] (const web::http::http_response& response, const request_result&, const core::ostream_descriptor&, operation_context context) -> pplx::task<std::vector<page_diff_range>>
+        {
+            protocol::page_diff_list_reader reader(response.body());
+            return pplx::task_from_result(reader.extract_result());
+        });
+        return core::executor<std::vector<page_diff_range>>::execute_async(command, modified_options, context);
+    }
+
+    pplx::task<void> cloud_page_blob::download_changes_to_stream_async(concurrency::streams::ostream target, const utility::string_t& previous_snapshot_time, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        if (!target.can_seek())
+        {
+            throw std::logic_error(utility::conversions::to_utf8string(protocol::error_sparse_download_not_seekable));
+        }
+
+        // Listing the changed ranges also retrieves the size and the ETag of the blob
+        auto instance = std::make_shared<cloud_page_blob>(*this);
+        return instance->download_page_ranges_diff_async(previous_snapshot_time, condition, modified_options, context).then([instance, target, condition, modified_options, context] (std::vector<page_diff_range> ranges) -> pplx::task<void>
+        {
+            return instance->download_page_ranges_to_stream_async(target, ranges, condition, modified_options, context);
+        });
+    }
+
+    pplx::task<void> cloud_page_blob::download_page_ranges_to_stream_async(concurrency::streams::ostream target, const std::vector<page_diff_range>& ranges, const access_condition& condition, const blob_request_options& modified_options, operation_context context)
+    {
+        auto range_size = static_cast<int64_t>(modified_options.stream_read_size_in_bytes());
+        if ((modified_options.use_transactional_md5() || modified_options.use_transactional_crc64()) && (range_size > static_cast<int64_t>(protocol::max_block_size)))
+        {
+            // The service only returns a transactional MD5 or CRC64 for ranges of up to 4MB
+            range_size = static_cast<int64_t>(protocol::max_block_size);
+        }
+
+        // The written ranges are downloaded and the cleared ranges are filled with zeros, in pieces of at most range_size bytes
+        struct piece
+        {
+            int64_t offset;
+            int64_t length;
+            bool is_hole;
+        };
+
+        auto pieces = std::make_shared<std::vector<piece>>();
+        auto add_pieces = [pieces, range_size] (int64_t begin, int64_t end, bool is_hole)
+        {
+            for (auto offset = begin; offset < end; offset += range_size)
+            {
+                piece next = { offset, std::min(range_size, end - offset), is_hole };
+                pieces->push_back(next);
+            }
+        };
+
+        bool zero_fill = false;
+        for (auto iter = ranges.cbegin(); iter != ranges.cend(); ++iter)
+        {
+            add_pieces(iter->start_offset(), iter->end_offset() + 1, iter->is_cleared());
+            zero_fill = zero_fill || iter->is_cleared();
+        }
+
+        auto blob_size = static_cast<int64_t>(m_properties->size());
+
+        auto target_offset = target.tell();
+        if (pieces->empty())
+        {
+            target.seek(target_offset + blob_size);
+            return pplx::task_from_result();
+        }
+
+        // All ranges must come from the version of the blob whose page ranges were listed
+        access_condition range_condition(condition);
+        if (range_condition.if_match_etag().empty())
+        {
+            range_condition.set_if_match_etag(m_properties->etag());
+        }
+
+        auto zeros = std::make_shared<std::vector<uint8_t>>(zero_fill ? static_cast<size_t>(range_size) : 0);
+        auto instance = std::make_shared<cloud_page_blob>(*this);
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        core::async_semaphore write_lock(1);
+        auto next_piece = std::make_shared<size_t>(0);
+        auto piece_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+        auto failed = std::make_shared<std::atomic<bool>>(false);
+
+        return pplx::details::do_while([instance, target, target_offset, pieces, next_piece, zeros, range_condition, modified_options, context, semaphore, write_lock, piece_tasks, failed] () mutable -> pplx::task<bool>
+        {
+            return semaphore.lock_async().then([instance, target, target_offset, pieces, next_piece, zeros, range_condition, modified_options, context, semaphore, write_lock, piece_tasks, failed] () mutable -> bool
+            {
+                if (*failed)
+                {
+                    semaphore.unlock();
+                    return false;
+                }
+
+                auto current = (*pieces)[(*next_piece)++];
+
+                // A hole needs no download, and a valid range is buffered first. Either is then written at its own position
+                // in the target, one write at a time since the target is shared.
+                concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+                auto download_task = current.is_hole ? pplx::task_from_result() : instance->download_single_range_to_stream_async(buffer.create_ostream(), current.offset, current.length, range_condition, modified_options, context, false);
+                auto piece_task = download_task.then([target, target_offset, current, buffer, zeros, write_lock] () mutable -> pplx::task<void>
+                {
+                    return write_lock.lock_async().then([target, target_offset, current, buffer, zeros] () -> pplx::task<size_t>
+                    {
+                        auto target_buffer = target.streambuf();
+                        target_buffer.seekpos(target_offset + current.offset, std::ios_base::out);
+                        const uint8_t* data = current.is_hole ? zeros->data() : buffer.collection().data();
+                        return target_buffer.putn(data, static_cast<size_t>(current.length));
+                    }).then([current, buffer, zeros, write_lock] (pplx::task<size_t> write_task) mutable
+                    {
+                        write_lock.unlock();
+                        if (write_task.get() != static_cast<size_t>(current.length))
+                        {
+                            throw storage_exception(utility::conversions::to_utf8string(protocol::error_incorrect_length));
+                        }
+                    });
+                });
+
+                piece_task.then([semaphore, failed] (pplx::task<void> completed_task) mutable
+                {
+                    try
+                    {
+                        completed_task.wait();
+                    }
+                    catch (...)
+                    {
+                        *failed = true;
+                    }
+
+                    semaphore.unlock();
+                });
+
+                piece_tasks->push_back(piece_task);
+                return *next_piece < pieces->size();
+            });
+        }).then([semaphore, piece_tasks, target, target_offset, blob_size] (bool) mutable -> pplx::task<void>
+        {
+            return semaphore.wait_all_async().then([piece_tasks, target, target_offset, blob_size] ()
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = piece_tasks->begin(); iter != piece_tasks->end(); ++iter)
+                {
+                    iter->get();
+                }
+
+                target.seek(target_offset + blob_size);
+            });
+        });
+    }
+
     pplx::task<void> cloud_page_blob::create_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
         auto properties = m_properties;
+        auto instance = std::make_shared<cloud_blob>(*this);
 
         auto command = std::make_shared<core::storage_command<void>>(uri());
         command->set_build_request(std::bind(protocol::put_page_blob, size, *properties, metadata(), condition, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response([properties, size] (const web::http::http_response& response, operation_context context)
+        command->set_preprocess_response([instance, properties, size] (const web::http::http_response& response, operation_context context)
         {
+            instance->_remove_cached_listings();
             protocol::preprocess_response(response, context);
             properties->update_etag_and_last_modified(protocol::blob_response_parsers::parse_blob_properties(response));
             properties->m_size = size;
@@ -143,6 +546,7 @@ namespace wa { namespace storage {
     pplx::task<void> cloud_page_blob::resize_async(utility::size64_t size, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
@@ -163,6 +567,7 @@ namespace wa { namespace storage {
     pplx::task<void> cloud_page_blob::set_sequence_number_async(const wa::storage::sequence_number& sequence_number, const access_condition& condition, const blob_request_options& options, operation_context context)
     {
         assert_no_snapshot();
+        _remove_cached_attributes();
         blob_request_options modified_options(options);
         modified_options.apply_defaults(service_client().default_request_options(), type());
 
@@ -210,4 +615,117 @@ namespace wa { namespace storage {
         return core::executor<std::vector<page_range>>::execute_async(command, modified_options, context);
     }
 
+    pplx::task<void> cloud_page_blob::download_page_ranges_async(int64_t offset, int64_t length, int64_t window_size, std::function<bool (const page_range&)> handler, const access_condition& condition, const blob_request_options& options, operation_context context) const
+    {
+        if ((offset < 0) || (offset % protocol::page_size != 0))
+        {
+            throw std::invalid_argument("offset");
+        }
+
+        if ((length < -1) || ((length > 0) && (length % protocol::page_size != 0)))
+        {
+            throw std::invalid_argument("length");
+        }
+
+        if ((window_size <= 0) || (window_size % protocol::page_size != 0))
+        {
+            throw std::invalid_argument("window_size");
+        }
+
+        blob_request_options modified_options(options);
+        modified_options.apply_defaults(service_client().default_request_options(), type());
+
+        // Without a length, the windows cover the blob up to its current size
+        auto instance = std::make_shared<cloud_page_blob>(*this);
+        pplx::task<int64_t> get_end_offset;
+        if (length >= 0)
+        {
+            get_end_offset = pplx::task_from_result(offset + length);
+        }
+        else
+        {
+            get_end_offset = instance->download_attributes_async(condition, modified_options, context).then([instance] () -> int64_t
+            {
+                return static_cast<int64_t>(instance->properties().size());
+            });
+        }
+
+        return get_end_offset.then([instance, offset, window_size, handler, condition, modified_options, context] (int64_t end_offset) -> pplx::task<void>
+        {
+            auto state = std::make_shared<page_range_windows>(handler, modified_options.parallelism_factor());
+            auto next_start = std::make_shared<int64_t>(offset);
+            auto next_window = std::make_shared<size_t>(0);
+
+            return pplx::details::do_while([instance, end_offset, window_size, condition, modified_options, context, state, next_start, next_window] () -> pplx::task<bool>
+            {
+                if ((*next_start >= end_offset) || state->stopped())
+                {
+                    return pplx::task_from_result(false);
+                }
+
+                return state->slots.lock_async().then([instance, end_offset, window_size, condition, modified_options, context, state, next_start, next_window] () -> bool
+                {
+                    if (state->stopped())
+                    {
+                        state->slots.unlock();
+                        return false;
+                    }
+
+                    auto window = (*next_window)++;
+                    auto window_start = *next_start;
+                    auto window_end = std::min(window_start + window_size, end_offset);
+                    *next_start = window_end;
+
+                    pplx::task<std::vector<page_range>> list_task;
+                    try
+                    {
+                        list_task = instance->download_page_ranges_async(window_start, window_end - window_start, condition, modified_options, context);
+                    }
+                    catch (...)
+                    {
+                        list_task = pplx::task_from_exception<std::vector<page_range>>(std::current_exception());
+                    }
+
+                    // A range may reach past the window it was listed in, so it is cut to the window and joined again when it is passed on
+                    list_task.then([window_start, window_end] (std::vector<page_range> ranges) -> std::vector<page_range>
+                    {
+                        std::vector<page_range> result;
+                        for (auto iter = ranges.cbegin(); iter != ranges.cend(); ++iter)
+                        {
+                            auto start = std::max(iter->start_offset(), window_start);
+                            auto end = std::min(iter->end_offset(), window_end - 1);
+                            if (start <= end)
+                            {
+                                result.push_back(page_range(start, end));
+                            }
+                        }
+
+                        return result;
+                    }).then([state, window] (pplx::task<std::vector<page_range>> completed_task)
+                    {
+                        state->complete(window, completed_task);
+                    });
+
+                    return *next_start < end_offset;
+                });
+            }).then([state] (bool) -> pplx::task<void>
+            {
+                return state->slots.wait_all_async().then([state] ()
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    if (state->error != nullptr)
+                    {
+                        std::rethrow_exception(state->error);
+                    }
+
+                    if (!state->is_stopped && state->has_pending)
+                    {
+                        state->has_pending = false;
+                        state->handler(state->pending);
+                    }
+                });
+            });
+        });
+    }
+
 }} // namespace wa::storage
@@ -16,9 +16,13 @@
 // -----------------------------------------------------------------------------------------
 
 #include "stdafx.h"
+#include "wascore/async_semaphore.h"
 #include "wascore/executor.h"
+#include "wascore/existence_cache.h"
+#include "wascore/prepared_request.h"
 #include "wascore/protocol.h"
 #include "wascore/protocol_xml.h"
+#include "wascore/request_coalescer.h"
 #include "wascore/resources.h"
 #include "was/queue.h"
 
@@ -48,14 +52,48 @@ namespace wa { namespace storage {
 
     pplx::task<bool> cloud_queue::create_if_not_exists_async(const queue_request_options& options, operation_context context)
     {
-        return exists_async_impl(options, context, /* allow_secondary */ false).then([this, options, context] (bool exists) -> pplx::task<bool>
+        queue_request_options modified_options = get_modified_options(options);
+
+        // A queue that was recently confirmed to exist is not created again
+        std::shared_ptr<core::existence_cache> cache = modified_options._existence_cache();
+        utility::string_t key = protocol::generate_queue_uri(service_client(), *this).primary_uri().to_string();
+        if (cache && cache->contains(key))
+        {
+            return pplx::task_from_result(false);
+        }
+
+        // The queue exists already if creating it returns 204, or 409 because its metadata differs
+        return create_async_impl(modified_options, context, /* allow_conflict */ true).then([cache, key] (pplx::task<bool> create_task) -> bool
         {
-            if (exists)
+            try
             {
-                return pplx::task_from_result(false);
+                bool created = create_task.get();
+                if (cache)
+                {
+                    cache->add(key);
+                }
+
+                return created;
             }
+            catch (const storage_exception& e)
+            {
+                auto result = e.result();
+                if (result.is_response_available() &&
+                    (result.http_status_code() == web::http::status_codes::Conflict) &&
+                    (result.extended_error().code() == protocol::error_code_queue_already_exists))
+                {
+                    if (cache)
+                    {
+                        cache->add(key);
+                    }
 
-            return create_async_impl(options, context, /* allow_conflict */ true);
+                    return false;
+                }
+                else
+                {
+                    throw;
+                }
+            }
         });
     }
 
@@ -68,15 +106,7 @@ namespace wa { namespace storage {
 
     pplx::task<bool> cloud_queue::delete_queue_if_exists_async(const queue_request_options& options, operation_context context)
     {
-        return exists_async_impl(options, context, /* allow_secondary */ false).then([this, options, context] (bool exists) -> pplx::task<bool>
-        {
-            if (!exists)
-            {
-                return pplx::task_from_result(false);
-            }
-
-            return delete_async_impl(options, context, /* allow_not_found */ true);
-        });
+        return delete_async_impl(options, context, /* allow_not_found */ true);
     }
 
     pplx::task<bool> cloud_queue::exists_async(const queue_request_options& options, operation_context context) const
@@ -84,41 +114,311 @@ namespace wa { namespace storage {
         return exists_async_impl(options, context, /* allow_secondary */ true);
     }
 
-    pplx::task<void> cloud_queue::add_message_async(cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, queue_request_options& options, operation_context context)
+    namespace
     {
-        if (time_to_live.count() <= 0LL)
+        void validate_add_message_times(std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout)
         {
-            throw std::invalid_argument("The time to live cannot be zero or negative.");
+            if (time_to_live.count() <= 0LL)
+            {
+                throw std::invalid_argument("The time to live cannot be zero or negative.");
+            }
+
+            if (time_to_live.count() > 604800LL)
+            {
+                throw std::invalid_argument("The time to live cannot be greater than 604800.");
+            }
+
+            if (initial_visibility_timeout.count() < 0LL)
+            {
+                throw std::invalid_argument("The initial visibility timeout cannot be negative.");
+            }
+
+            if (initial_visibility_timeout.count() > 604800LL)
+            {
+                throw std::invalid_argument("The initial visibility timeout cannot be greater than 604800.");
+            }
         }
 
-        if (time_to_live.count() > 604800LL)
+        // Creates the queue after an add has found it missing, which the adds that found it missing at the same time share
+        pplx::task<void> create_after_not_found_async(const cloud_queue& queue, const queue_request_options& options, operation_context context)
         {
-            throw std::invalid_argument("The time to live cannot be greater than 604800.");
+            auto instance = std::make_shared<cloud_queue>(queue);
+            auto coalescer = queue.service_client().request_coalescer();
+            auto create = [instance, options, context] () -> pplx::task<bool>
+            {
+                return instance->create_if_not_exists_async(options, context);
+            };
+
+            auto create_task = coalescer ? coalescer->run_async<bool>(U("create-queue:") + queue.uri().primary_uri().to_string(), create) : create();
+            return create_task.then([] (bool)
+            {
+            });
         }
 
-        if (initial_visibility_timeout.count() < 0LL)
+        // Builds the request of an add_message_async call, without binding its arguments into function objects
+        class add_message_operation : public core::basic_command_operation
+        {
+        public:
+
+            add_message_operation(const cloud_queue& queue, const cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout)
+                : m_queue(queue), m_message(message), m_time_to_live(time_to_live), m_initial_visibility_timeout(initial_visibility_timeout)
+            {
+            }
+
+            web::http::http_request build_request(web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) const
+            {
+                return protocol::add_message(m_queue, m_message, m_time_to_live, m_initial_visibility_timeout, uri_builder, timeout, context);
+            }
+
+            void preprocess_response(const web::http::http_response& response, operation_context context) const
+            {
+                protocol::preprocess_response(response, context);
+            }
+
+        private:
+
+            cloud_queue m_queue;
+            cloud_queue_message m_message;
+            std::chrono::seconds m_time_to_live;
+            std::chrono::seconds m_initial_visibility_timeout;
+        };
+
+        // Builds the requests of get_message_async and get_messages_async calls. A queue is usually polled with the same request
+        // again and again, so these are copied from a prepared request, which also saves canonicalizing their resource.
+        template<typename T>
+        class get_messages_operation : public core::basic_command_operation
+        {
+        public:
+
+            get_messages_operation(const cloud_queue& queue, size_t message_count, std::chrono::seconds visibility_timeout, std::shared_ptr<core::prepared_request_cache> prepared_requests, std::shared_ptr<protocol::authentication_handler> handler)
+                : m_queue(queue), m_message_count(message_count), m_visibility_timeout(visibility_timeout), m_prepared_requests(prepared_requests), m_handler(handler)
+            {
+            }
+
+            web::http::http_request build_request(web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) const
+            {
+                if (!m_prepared_requests)
+                {
+                    return protocol::get_messages(m_queue, m_message_count, m_visibility_timeout, /* is_peek */ false, uri_builder, timeout, context);
+                }
+
+                utility::ostringstream_t key;
+                key << U("GET messages ") << uri_builder.host() << uri_builder.path() << U(' ') << m_message_count << U(' ') << m_visibility_timeout.count() << U(' ') << timeout.count();
+
+                m_prepared = m_prepared_requests->find(key.str());
+                if (m_prepared)
+                {
+                    return m_prepared->create();
+                }
+
+                web::http::http_request request = protocol::get_messages(m_queue, m_message_count, m_visibility_timeout, /* is_peek */ false, uri_builder, timeout, context);
+                m_prepared = std::make_shared<core::prepared_request>(request, m_handler);
+                m_prepared_requests->add(key.str(), m_prepared);
+                return request;
+            }
+
+            bool sign_request(web::http::http_request& request, operation_context context) const
+            {
+                if (!m_prepared)
+                {
+                    return false;
+                }
+
+                m_prepared->sign(request, context);
+                return true;
+            }
+
+            T preprocess_response(const web::http::http_response& response, operation_context context) const
+            {
+                return protocol::preprocess_response<T>(T(), response, context);
+            }
+
+        private:
+
+            cloud_queue m_queue;
+            size_t m_message_count;
+            std::chrono::seconds m_visibility_timeout;
+            std::shared_ptr<core::prepared_request_cache> m_prepared_requests;
+            std::shared_ptr<protocol::authentication_handler> m_handler;
+
+            // The prepared request that the request of the current attempt was created from
+            mutable std::shared_ptr<const core::prepared_request> m_prepared;
+        };
+
+        struct add_messages_state
         {
-            throw std::invalid_argument("The initial visibility timeout cannot be negative.");
+            add_messages_state(const cloud_queue& queue, std::vector<cloud_queue_message> messages, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, int max_concurrent_adds, const queue_request_options& options, operation_context context)
+                : queue(queue), messages(std::move(messages)), errors(this->messages.size()), time_to_live(time_to_live), initial_visibility_timeout(initial_visibility_timeout), semaphore(max_concurrent_adds), next_message(0), options(options), context(context)
+            {
+            }
+
+            cloud_queue queue;
+            std::vector<cloud_queue_message> messages;
+
+            // Each add writes only the element for its own message, and the elements are read after all adds are done
+            std::vector<std::exception_ptr> errors;
+            std::chrono::seconds time_to_live;
+            std::chrono::seconds initial_visibility_timeout;
+            core::async_semaphore semaphore;
+            size_t next_message;
+            std::shared_ptr<const core::prepared_request> prepared;
+            queue_request_options options;
+            operation_context context;
+        };
+    }
+
+    pplx::task<void> cloud_queue::add_message_async(cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, queue_request_options& options, operation_context context)
+    {
+        validate_add_message_times(time_to_live, initial_visibility_timeout);
+
+        queue_request_options modified_options = get_modified_options(options);
+
+        // The message is added as if the queue existed, and only if it does not is the queue created and the message added again
+        if (modified_options.create_queue_if_not_found())
+        {
+            queue_request_options add_options(modified_options);
+            add_options.set_create_queue_if_not_found(false);
+            auto instance = std::make_shared<cloud_queue>(*this);
+            auto target = std::make_shared<cloud_queue_message>(message);
+            return add_message_async(message, time_to_live, initial_visibility_timeout, add_options, context).then([instance, target, time_to_live, initial_visibility_timeout, add_options, context] (pplx::task<void> add_task) mutable -> pplx::task<void>
+            {
+                try
+                {
+                    add_task.wait();
+                    return pplx::task_from_result();
+                }
+                catch (const storage_exception& e)
+                {
+                    if (!core::is_storage_error(e, web::http::status_codes::NotFound, protocol::error_code_queue_not_found))
+                    {
+                        throw;
+                    }
+                }
+
+                return create_after_not_found_async(*instance, add_options, context).then([instance, target, time_to_live, initial_visibility_timeout, add_options, context] () mutable -> pplx::task<void>
+                {
+                    return instance->add_message_async(*target, time_to_live, initial_visibility_timeout, add_options, context);
+                });
+            });
         }
 
-        if (initial_visibility_timeout.count() > 604800LL)
+        storage_uri uri = protocol::generate_queue_message_uri(service_client(), *this);
+
+        auto command = std::make_shared<core::static_storage_command<void, add_message_operation>>(uri, add_message_operation(*this, message, time_to_live, initial_visibility_timeout));
+        command->set_authentication_handler(service_client().authentication_handler());
+        return core::executor<void>::execute_async(command, modified_options, context);
+    }
+
+    pplx::task<std::vector<std::exception_ptr>> cloud_queue::add_messages_async(std::vector<cloud_queue_message> messages, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, int max_concurrent_adds, queue_request_options& options, operation_context context)
+    {
+        validate_add_message_times(time_to_live, initial_visibility_timeout);
+
+        if (max_concurrent_adds < 1)
         {
-            throw std::invalid_argument("The initial visibility timeout cannot be greater than 604800.");
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_max_concurrent_message_adds));
         }
 
         queue_request_options modified_options = get_modified_options(options);
         storage_uri uri = protocol::generate_queue_message_uri(service_client(), *this);
+        auto state = std::make_shared<add_messages_state>(*this, std::move(messages), time_to_live, initial_visibility_timeout, max_concurrent_adds, modified_options, context);
 
-        std::shared_ptr<core::storage_command<void>> command = std::make_shared<core::storage_command<void>>(uri);
-        command->set_build_request(std::bind(protocol::add_message, *this, message, time_to_live, initial_visibility_timeout, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-        command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response([] (const web::http::http_response& response, operation_context context)
+        // Every add is a POST to the same URI, so each request is copied from a prepared one and only gets its own message as the body.
+        // A request to another location is built and signed in full.
+        auto handler = service_client().authentication_handler();
+        web::http::http_request template_request = protocol::add_message(*this, cloud_queue_message(), time_to_live, initial_visibility_timeout, web::http::uri_builder(uri.primary_uri()), modified_options.server_timeout(), context);
+        state->prepared = std::make_shared<core::prepared_request>(template_request, handler);
+        std::chrono::seconds template_timeout = modified_options.server_timeout();
+
+        // Only the adds in flight have a command and a task, so a burst of any size is sent with bounded memory
+        return pplx::details::do_while([state, uri, template_timeout] () -> pplx::task<bool>
         {
-            protocol::preprocess_response(response, context);
-            //message.set_pop_receipt(protocol::parse_pop_receipt(response));
-            //message.set_next_visible_time(protocol::parse_next_visible_time(response));
+            if (state->next_message == state->messages.size())
+            {
+                return pplx::task_from_result(false);
+            }
+
+            size_t index = state->next_message++;
+            return state->semaphore.lock_async().then([state, uri, index, template_timeout] () -> bool
+            {
+                std::shared_ptr<core::storage_command<void>> command = std::make_shared<core::storage_command<void>>(uri);
+                command->set_build_request([state, index, template_timeout] (web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) -> web::http::http_request
+                {
+                    if (timeout != template_timeout || uri_builder.host() != state->prepared->uri().host())
+                    {
+                        return protocol::add_message(state->queue, state->messages[index], state->time_to_live, state->initial_visibility_timeout, uri_builder, timeout, context);
+                    }
+
+                    web::http::http_request request = state->prepared->create();
+                    protocol::message_writer writer;
+                    request.set_body(writer.write(state->messages[index]));
+                    return request;
+                });
+                command->set_custom_sign_request([state] (web::http::http_request& request, operation_context context)
+                {
+                    state->prepared->sign(request, context);
+                });
+                command->set_preprocess_response([] (const web::http::http_response& response, operation_context context)
+                {
+                    protocol::preprocess_response(response, context);
+                });
+
+                core::executor<void>::execute_async(command, state->options, state->context).then([state, index] (pplx::task<void> add_task)
+                {
+                    try
+                    {
+                        add_task.wait();
+                    }
+                    catch (...)
+                    {
+                        state->errors[index] = std::current_exception();
+                    }
+
+                    state->semaphore.unlock();
+                });
+
+                return true;
+            });
+        }).then([state] (bool) -> pplx::task<void>
+        {
+            return state->semaphore.wait_all_async();
+        }).then([state] () -> std::vector<std::exception_ptr>
+        {
+            return std::move(state->errors);
+        });
+    }
+
+    pplx::task<std::vector<std::exception_ptr>> cloud_queue::add_packed_messages_async(const std::vector<std::vector<uint8_t>>& contents, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, int max_concurrent_adds, queue_request_options& options, operation_context context)
+    {
+        // Remembers how many logical messages went into each envelope, so the errors of the envelopes can be spread back over them
+        std::vector<cloud_queue_message> envelopes;
+        auto envelope_counts = std::make_shared<std::vector<size_t>>();
+        queue_message_packer packer;
+        for (auto iter = contents.cbegin(); iter != contents.cend(); ++iter)
+        {
+            if (!packer.try_add(*iter))
+            {
+                envelope_counts->push_back(packer.count());
+                envelopes.push_back(packer.take_envelope());
+                packer.try_add(*iter);
+            }
+        }
+
+        if (packer.count() > 0)
+        {
+            envelope_counts->push_back(packer.count());
+            envelopes.push_back(packer.take_envelope());
+        }
+
+        return add_messages_async(std::move(envelopes), time_to_live, initial_visibility_timeout, max_concurrent_adds, options, context).then([envelope_counts] (const std::vector<std::exception_ptr>& envelope_errors) -> std::vector<std::exception_ptr>
+        {
+            std::vector<std::exception_ptr> errors;
+            for (size_t i = 0; i < envelope_errors.size(); ++i)
+            {
+                errors.insert(errors.end(), (*envelope_counts)[i], envelope_errors[i]);
+            }
+
+            return errors;
         });
-        return core::executor<void>::execute_async(command, modified_options, context);
     }
 
     pplx::task<cloud_queue_message> cloud_queue::get_message_async(std::chrono::seconds visibility_timeout, queue_request_options& options, operation_context context)
@@ -136,10 +436,9 @@ namespace wa { namespace storage {
         queue_request_options modified_options = get_modified_options(options);
         storage_uri uri = protocol::generate_queue_message_uri(service_client(), *this);
 
-        std::shared_ptr<core::storage_command<cloud_queue_message>> command = std::make_shared<core::storage_command<cloud_queue_message>>(uri);
-        command->set_build_request(std::bind(protocol::get_messages, *this, 1U, visibility_timeout, /* is_peek */ false, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-        command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response(std::bind(protocol::preprocess_response<cloud_queue_message>, cloud_queue_message(), std::placeholders::_1, std::placeholders::_2));
+        auto handler = service_client().authentication_handler();
+        auto command = std::make_shared<core::static_storage_command<cloud_queue_message, get_messages_operation<cloud_queue_message>>>(uri, get_messages_operation<cloud_queue_message>(*this, 1U, visibility_timeout, modified_options._prepared_requests(), handler));
+        command->set_authentication_handler(handler);
         command->set_postprocess_response([] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<cloud_queue_message>
         {
             protocol::message_reader reader(response.body());
@@ -172,10 +471,9 @@ namespace wa { namespace storage {
         queue_request_options modified_options = get_modified_options(options);
         storage_uri uri = protocol::generate_queue_message_uri(service_client(), *this);
 
-        std::shared_ptr<core::storage_command<std::vector<cloud_queue_message>>> command = std::make_shared<core::storage_command<std::vector<cloud_queue_message>>>(uri);
-        command->set_build_request(std::bind(protocol::get_messages, *this, message_count, visibility_timeout, /* is_peek */ false, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-        command->set_authentication_handler(service_client().authentication_handler());
-        command->set_preprocess_response(std::bind(protocol::preprocess_response<std::vector<cloud_queue_message>>, std::vector<cloud_queue_message>(), std::placeholders::_1, std::placeholders::_2));
+        auto handler = service_client().authentication_handler();
+        auto command = std::make_shared<core::static_storage_command<std::vector<cloud_queue_message>, get_messages_operation<std::vector<cloud_queue_message>>>>(uri, get_messages_operation<std::vector<cloud_queue_message>>(*this, message_count, visibility_timeout, modified_options._prepared_requests(), handler));
+        command->set_authentication_handler(handler);
         command->set_postprocess_response([] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<std::vector<cloud_queue_message>>
         {
             protocol::message_reader reader(response.body());
@@ -195,6 +493,21 @@ namespace wa { namespace storage {
         return core::executor<std::vector<cloud_queue_message>>::execute_async(command, modified_options, context);
     }
 
+    pplx::task<std::vector<queue_packed_message>> cloud_queue::get_packed_messages_async(size_t message_count, std::chrono::seconds visibility_timeout, queue_request_options& options, operation_context context)
+    {
+        return get_messages_async(message_count, visibility_timeout, options, context).then([] (const std::vector<cloud_queue_message>& messages) -> std::vector<queue_packed_message>
+        {
+            std::vector<queue_packed_message> results;
+            results.reserve(messages.size());
+            for (auto iter = messages.cbegin(); iter != messages.cend(); ++iter)
+            {
+                results.push_back(queue_packed_message(*iter));
+            }
+
+            return results;
+        });
+    }
+
     pplx::task<cloud_queue_message> cloud_queue::peek_message_async(const queue_request_options& options, operation_context context) const
     {
         queue_request_options modified_options = get_modified_options(options);
@@ -283,6 +596,20 @@ namespace wa { namespace storage {
         return core::executor<void>::execute_async(command, modified_options, context);
     }
 
+    pplx::task<bool> cloud_queue::complete_packed_message_async(queue_packed_message& message, size_t index, queue_request_options& options, operation_context context)
+    {
+        if (!message.complete(index))
+        {
+            return pplx::task_from_result(false);
+        }
+
+        cloud_queue_message envelope = message.envelope();
+        return delete_message_async(envelope, options, context).then([] () -> bool
+        {
+            return true;
+        });
+    }
+
     pplx::task<void> cloud_queue::clear_async(const queue_request_options& options, operation_context context)
     {
         queue_request_options modified_options = get_modified_options(options);
@@ -446,14 +773,9 @@ namespace wa { namespace storage {
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_preprocess_response([allow_conflict] (const web::http::http_response& response, operation_context context) -> bool
         {
-            if (response.status_code() == web::http::status_codes::Conflict)
-            {
-                if (allow_conflict)
-                {
-                    return false;
-                }
-            }
-            else if (response.status_code() == web::http::status_codes::NoContent)
+            // A conflict fails even if it is allowed, so that the caller can tell from the error code whether the queue
+            // exists or is being deleted
+            if (response.status_code() == web::http::status_codes::NoContent)
             {
                 if (allow_conflict)
                 {
@@ -476,6 +798,11 @@ namespace wa { namespace storage {
         queue_request_options modified_options = get_modified_options(options);
         storage_uri uri = protocol::generate_queue_uri(service_client(), *this);
 
+        if (modified_options._existence_cache())
+        {
+            modified_options._existence_cache()->remove(uri.primary_uri().to_string());
+        }
+
         std::shared_ptr<core::storage_command<bool>> command = std::make_shared<core::storage_command<bool>>(uri);
         command->set_build_request(std::bind(protocol::delete_queue, *this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
@@ -32,21 +32,10 @@ namespace wa { namespace storage {
 
     pplx::task<std::vector<cloud_queue>> cloud_queue_client::list_queues_async(const utility::string_t& prefix, bool get_metadata, const queue_request_options& options, operation_context context) const
     {
-        std::shared_ptr<std::vector<cloud_queue>> results = std::make_shared<std::vector<cloud_queue>>();
-        std::shared_ptr<continuation_token> continuation_token = std::make_shared<wa::storage::continuation_token>();
-
-        return pplx::details::do_while([this, results, prefix, get_metadata, continuation_token, options, context] () mutable -> pplx::task<bool>
-        {
-            return list_queues_segmented_async(prefix, get_metadata, -1, *continuation_token, options, context).then([results, continuation_token] (queue_result_segment result_segment) mutable -> bool
-            {
-                std::vector<wa::storage::cloud_queue> partial_results = result_segment.results();
-                results->insert(results->end(), partial_results.begin(), partial_results.end());
-                *continuation_token = result_segment.continuation_token();
-                return !continuation_token->empty();
-            });
-        }).then([results] (bool guard) -> pplx::task<std::vector<cloud_queue>>
+        auto client = *this;
+        return core::list_all_segments_async<cloud_queue, queue_result_segment>([client, prefix, get_metadata, options, context] (const continuation_token& token) -> pplx::task<queue_result_segment>
         {
-            return pplx::task_from_result(*results);
+            return client.list_queues_segmented_async(prefix, get_metadata, -1, token, options, context);
         });
     }
 
@@ -59,6 +48,7 @@ namespace wa { namespace storage {
         command->set_build_request(std::bind(protocol::list_queues, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(authentication_handler());
         command->set_location_mode(core::command_location_mode::primary_or_secondary, continuation_token.target_location());
+        command->set_accept_compressed_response(true);
         command->set_preprocess_response(std::bind(protocol::preprocess_response<queue_result_segment>, queue_result_segment(), std::placeholders::_1, std::placeholders::_2));
         command->set_postprocess_response([this, get_metadata] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<queue_result_segment>
         {
@@ -17,9 +17,21 @@
 
 #include "stdafx.h"
 #include "was/queue.h"
+#include "wascore/util.h"
 
 namespace wa { namespace storage {
 
     const std::chrono::seconds max_time_to_live(7 * 24 * 60 * 60);
 
+    const std::vector<uint8_t> cloud_queue_message::content_as_binary() const
+    {
+        if (m_is_binary)
+        {
+            return m_binary_content;
+        }
+
+        // The text received from the service is decoded directly, without converting it to UTF-8 first
+        return core::decode_base64(m_content);
+    }
+
 }} // namespace wa::storage
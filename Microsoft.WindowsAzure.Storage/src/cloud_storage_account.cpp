@@ -18,6 +18,7 @@
 #include "stdafx.h"
 
 #include "wascore/util.h"
+#include "wascore/credential_cache.h"
 #include "was/blob.h"
 #include "was/queue.h"
 #include "was/table.h"
@@ -107,94 +108,119 @@ namespace wa { namespace storage {
         return get_development_storage_account(web::http::uri());
     }
 
-    std::map<utility::string_t, utility::string_t> parse_string_into_settings(const utility::string_t& connection_string)
+    bool cloud_storage_account::share_signing_keys()
     {
-        std::map<utility::string_t, utility::string_t> settings;
-        auto splitted_string = core::string_split(connection_string, U(";"));
-        
-        for (auto iter = splitted_string.cbegin(); iter != splitted_string.cend(); ++iter)
-        {
-            if (!iter->empty())
-            {
-                auto equals = iter->find(U('='));
-
-                utility::string_t key = iter->substr(0, equals);
-                if (!key.empty())
-                {
-                    utility::string_t value;
-                    if (equals != utility::string_t::npos)
-                    {
-                        value = iter->substr(equals + 1);
-                    }
+        return core::credential_cache::instance().enabled();
+    }
 
-                    settings.insert(std::make_pair(std::move(key), std::move(value)));
-                }
-                else
-                {
-                    throw std::logic_error("Settings must be of the form \"name=value\".");
-                }
-            }
-        }
-        
-        return settings;
+    void cloud_storage_account::set_share_signing_keys(bool value)
+    {
+        core::credential_cache::instance().set_enabled(value);
     }
 
-    bool get_setting(std::map<utility::string_t, utility::string_t>& settings, const utility::string_t& key, utility::string_t& value)
+    namespace
     {
-        auto iter = settings.find(key);
-        if (iter == settings.end())
+        // The settings a connection string is parsed into, in the order of their names in setting_names
+        enum setting_id
+        {
+            use_development_storage_setting,
+            development_storage_proxy_uri_setting,
+            default_endpoints_protocol_setting,
+            account_name_setting,
+            account_key_setting,
+            blob_endpoint_setting,
+            queue_endpoint_setting,
+            table_endpoint_setting,
+            endpoint_suffix_setting,
+            shared_access_signature_setting,
+            setting_count
+        };
+
+        const utility::string_t* const setting_names[setting_count] =
+        {
+            &use_development_storage_setting_string,
+            &development_storage_proxy_uri_setting_string,
+            &default_endpoints_protocol_setting_string,
+            &account_name_setting_string,
+            &account_key_setting_string,
+            &blob_endpoint_setting_string,
+            &queue_endpoint_setting_string,
+            &table_endpoint_setting_string,
+            &endpoint_suffix_setting_string,
+            &shared_access_signature_setting_string
+        };
+
+        unsigned int setting_bit(setting_id id)
         {
-            return false;
+            return 1U << id;
         }
 
-        value = iter->second;
-        settings.erase(iter);
-        return true;
+        const unsigned int credential_settings = setting_bit(account_name_setting) | setting_bit(account_key_setting) | setting_bit(shared_access_signature_setting);
+        const unsigned int endpoint_settings = setting_bit(blob_endpoint_setting) | setting_bit(queue_endpoint_setting) | setting_bit(table_endpoint_setting);
     }
 
-    storage_credentials get_credentials(std::map<utility::string_t, utility::string_t>& settings)
+    struct cloud_storage_account::connection_settings
     {
-        utility::string_t account_name;
-        utility::string_t account_key;
-        utility::string_t shared_access_signature;
+        connection_settings()
+            : present(0)
+        {
+        }
 
-        get_setting(settings, account_name_setting_string, account_name);
-        get_setting(settings, account_key_setting_string, account_key);
-        get_setting(settings, shared_access_signature_setting_string, shared_access_signature);
+        bool has(setting_id id) const
+        {
+            return (present & setting_bit(id)) != 0;
+        }
 
-        if (!account_name.empty() && !account_key.empty() && shared_access_signature.empty())
+        // Returns true if the connection string has none but the given settings
+        bool has_only(unsigned int allowed) const
         {
-            return storage_credentials(account_name, account_key);
+            return ((present & ~allowed) == 0) && others.empty();
         }
 
-        if (account_name.empty() && account_key.empty() && !shared_access_signature.empty())
+        const utility::string_t& value(setting_id id) const
         {
-            return storage_credentials(shared_access_signature);
+            return values[id];
         }
 
-        return storage_credentials();
-    }
+        // The settings with their values, without the credentials
+        std::map<utility::string_t, utility::string_t> to_map() const
+        {
+            std::map<utility::string_t, utility::string_t> result(others.cbegin(), others.cend());
+            for (int id = 0; id < setting_count; ++id)
+            {
+                if (has(static_cast<setting_id>(id)) && ((credential_settings & setting_bit(static_cast<setting_id>(id))) == 0))
+                {
+                    result.insert(std::make_pair(*setting_names[id], values[id]));
+                }
+            }
 
-    cloud_storage_account cloud_storage_account::parse_devstore_settings(std::map<utility::string_t, utility::string_t> settings)
-    {
-        utility::string_t devstore;
-        utility::string_t devstore_proxy_uri;
+            return result;
+        }
+
+        unsigned int present;
+        utility::string_t values[setting_count];
 
-        if (get_setting(settings, use_development_storage_setting_string, devstore))
+        // Settings that none of the forms of connection string accept
+        std::vector<std::pair<utility::string_t, utility::string_t>> others;
+    };
+
+    cloud_storage_account cloud_storage_account::parse_devstore_settings(const connection_settings& settings)
+    {
+        if (settings.has(use_development_storage_setting))
         {
-            if (devstore != use_development_storage_setting_value)
+            if (settings.value(use_development_storage_setting) != use_development_storage_setting_value)
             {
                 throw std::invalid_argument(utility::conversions::to_utf8string(use_development_storage_setting_string));
             }
 
-            web::http::uri proxy_uri;
-            if (get_setting(settings, development_storage_proxy_uri_setting_string, devstore_proxy_uri))
+            if (settings.has_only(setting_bit(use_development_storage_setting) | setting_bit(development_storage_proxy_uri_setting)))
             {
-                proxy_uri = web::http::uri(devstore_proxy_uri);
-            }
+                web::http::uri proxy_uri;
+                if (settings.has(development_storage_proxy_uri_setting))
+                {
+                    proxy_uri = web::http::uri(settings.value(development_storage_proxy_uri_setting));
+                }
 
-            if (settings.empty())
-            {
                 return get_development_storage_account(proxy_uri);
             }
         }
@@ -202,56 +228,53 @@ namespace wa { namespace storage {
         return cloud_storage_account();
     }
     
-    cloud_storage_account cloud_storage_account::parse_defaults_settings(std::map<utility::string_t, utility::string_t> settings)
+    cloud_storage_account cloud_storage_account::parse_defaults_settings(const connection_settings& settings)
     {
-        utility::string_t scheme;
-        utility::string_t account_name;
-        utility::string_t account_key;
-
-        if (get_setting(settings, default_endpoints_protocol_setting_string, scheme) &&
-            get_setting(settings, account_name_setting_string, account_name) &&
-            get_setting(settings, account_key_setting_string, account_key))
+        if (settings.has(default_endpoints_protocol_setting) && settings.has(account_name_setting) && settings.has(account_key_setting) &&
+            settings.has_only(setting_bit(default_endpoints_protocol_setting) | setting_bit(account_name_setting) | setting_bit(account_key_setting) | setting_bit(endpoint_suffix_setting) | endpoint_settings))
         {
-            utility::string_t endpoint_suffix;
-            if (!get_setting(settings, endpoint_suffix_setting_string, endpoint_suffix))
-            {
-                endpoint_suffix = default_endpoint_suffix;
-            }
+            const auto& scheme = settings.value(default_endpoints_protocol_setting);
+            const auto& account_name = settings.value(account_name_setting);
+            auto endpoint_suffix = settings.has(endpoint_suffix_setting) ? settings.value(endpoint_suffix_setting) : default_endpoint_suffix;
 
-            utility::string_t blob_endpoint;
-            utility::string_t queue_endpoint;
-            utility::string_t table_endpoint;
-            get_setting(settings, blob_endpoint_setting_string, blob_endpoint);
-            get_setting(settings, queue_endpoint_setting_string, queue_endpoint);
-            get_setting(settings, table_endpoint_setting_string, table_endpoint);
+            const auto& blob_endpoint = settings.value(blob_endpoint_setting);
+            const auto& queue_endpoint = settings.value(queue_endpoint_setting);
+            const auto& table_endpoint = settings.value(table_endpoint_setting);
 
-            if (settings.empty())
-            {
-                cloud_storage_account account(storage_credentials(account_name, account_key),
-                    blob_endpoint.empty() ? construct_default_endpoint(scheme, account_name, default_blob_hostname_prefix, endpoint_suffix) : storage_uri(web::http::uri(blob_endpoint)),
-                    queue_endpoint.empty() ? construct_default_endpoint(scheme, account_name, default_queue_hostname_prefix, endpoint_suffix) : storage_uri(web::http::uri(queue_endpoint)),
-                    table_endpoint.empty() ? construct_default_endpoint(scheme, account_name, default_table_hostname_prefix, endpoint_suffix) : storage_uri(web::http::uri(table_endpoint)));
+            cloud_storage_account account(storage_credentials(account_name, settings.value(account_key_setting)),
+                blob_endpoint.empty() ? construct_default_endpoint(scheme, account_name, default_blob_hostname_prefix, endpoint_suffix) : storage_uri(web::http::uri(blob_endpoint)),
+                queue_endpoint.empty() ? construct_default_endpoint(scheme, account_name, default_queue_hostname_prefix, endpoint_suffix) : storage_uri(web::http::uri(queue_endpoint)),
+                table_endpoint.empty() ? construct_default_endpoint(scheme, account_name, default_table_hostname_prefix, endpoint_suffix) : storage_uri(web::http::uri(table_endpoint)));
 
-                account.m_endpoint_suffix = endpoint_suffix;
-                return account;
-            }
+            account.m_endpoint_suffix = std::move(endpoint_suffix);
+            return account;
         }
 
         return cloud_storage_account();
     }
 
-    cloud_storage_account cloud_storage_account::parse_explicit_settings(std::map<utility::string_t, utility::string_t> settings)
+    cloud_storage_account cloud_storage_account::parse_explicit_settings(const connection_settings& settings)
     {
-        utility::string_t blob_endpoint;
-        utility::string_t queue_endpoint;
-        utility::string_t table_endpoint;
-        get_setting(settings, blob_endpoint_setting_string, blob_endpoint);
-        get_setting(settings, queue_endpoint_setting_string, queue_endpoint);
-        get_setting(settings, table_endpoint_setting_string, table_endpoint);
-        storage_credentials credentials(get_credentials(settings));
+        const auto& blob_endpoint = settings.value(blob_endpoint_setting);
+        const auto& queue_endpoint = settings.value(queue_endpoint_setting);
+        const auto& table_endpoint = settings.value(table_endpoint_setting);
         
-        if (settings.empty() && (!blob_endpoint.empty() || !queue_endpoint.empty() || !table_endpoint.empty()))
+        if (settings.has_only(endpoint_settings | credential_settings) && (!blob_endpoint.empty() || !queue_endpoint.empty() || !table_endpoint.empty()))
         {
+            const auto& account_name = settings.value(account_name_setting);
+            const auto& account_key = settings.value(account_key_setting);
+            const auto& shared_access_signature = settings.value(shared_access_signature_setting);
+
+            storage_credentials credentials;
+            if (!account_name.empty() && !account_key.empty() && shared_access_signature.empty())
+            {
+                credentials = storage_credentials(account_name, account_key);
+            }
+            else if (account_name.empty() && account_key.empty() && !shared_access_signature.empty())
+            {
+                credentials = storage_credentials(shared_access_signature);
+            }
+
             return cloud_storage_account(credentials,
                 blob_endpoint.empty() ? storage_uri() : storage_uri(web::http::uri(blob_endpoint)),
                 queue_endpoint.empty() ? storage_uri() : storage_uri(web::http::uri(queue_endpoint)),
@@ -263,34 +286,84 @@ namespace wa { namespace storage {
 
     cloud_storage_account cloud_storage_account::parse(const utility::string_t& connection_string)
     {
-        cloud_storage_account account;
-        auto settings = parse_string_into_settings(connection_string);
+        // The connection string is read in one pass. Names are compared in place, and only the values are copied out.
+        // Like a std::map, the first value of a repeated setting wins.
+        connection_settings settings;
+        const auto size = connection_string.size();
+        for (size_t begin = 0; begin < size;)
+        {
+            auto end = connection_string.find(U(';'), begin);
+            if (end == utility::string_t::npos)
+            {
+                end = size;
+            }
+
+            if (end > begin)
+            {
+                auto equals = connection_string.find(U('='), begin);
+                if ((equals == utility::string_t::npos) || (equals > end))
+                {
+                    equals = end;
+                }
+
+                if (equals == begin)
+                {
+                    throw std::logic_error("Settings must be of the form \"name=value\".");
+                }
+
+                auto name_length = equals - begin;
+                auto value_begin = equals < end ? equals + 1 : end;
+
+                int id = 0;
+                while ((id < setting_count) && (connection_string.compare(begin, name_length, *setting_names[id]) != 0))
+                {
+                    ++id;
+                }
 
-        account = parse_devstore_settings(settings);
-        if (account.is_initialized())
+                if (id < setting_count)
+                {
+                    if (!settings.has(static_cast<setting_id>(id)))
+                    {
+                        settings.present |= setting_bit(static_cast<setting_id>(id));
+                        settings.values[id].assign(connection_string, value_begin, end - value_begin);
+                    }
+                }
+                else
+                {
+                    utility::string_t name(connection_string, begin, name_length);
+                    auto duplicate = std::find_if(settings.others.cbegin(), settings.others.cend(), [&name] (const std::pair<utility::string_t, utility::string_t>& other) -> bool
+                    {
+                        return other.first == name;
+                    });
+
+                    if (duplicate == settings.others.cend())
+                    {
+                        settings.others.push_back(std::make_pair(std::move(name), utility::string_t(connection_string, value_begin, end - value_begin)));
+                    }
+                }
+            }
+
+            begin = end + 1;
+        }
+
+        auto account = parse_devstore_settings(settings);
+        if (!account.is_initialized())
         {
-            get_credentials(settings);
-            account.m_settings = settings;
-            return account;
+            account = parse_defaults_settings(settings);
         }
 
-        account = parse_defaults_settings(settings);
-        if (account.is_initialized())
+        if (!account.is_initialized())
         {
-            get_credentials(settings);
-            account.m_settings = settings;
-            return account;
+            account = parse_explicit_settings(settings);
         }
 
-        account = parse_explicit_settings(settings);
-        if (account.is_initialized())
+        if (!account.is_initialized())
         {
-            get_credentials(settings);
-            account.m_settings = settings;
-            return account;
+            throw std::invalid_argument("connection_string");
         }
 
-        throw std::invalid_argument("connection_string");
+        account.m_settings = settings.to_map();
+        return account;
     }
 
     cloud_blob_client cloud_storage_account::create_cloud_blob_client() const
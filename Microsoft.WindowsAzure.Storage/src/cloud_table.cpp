@@ -16,15 +16,314 @@
 // -----------------------------------------------------------------------------------------
 
 #include "stdafx.h"
+#include <map>
+
+#include "wascore/async_semaphore.h"
 #include "wascore/executor.h"
+#include "wascore/existence_cache.h"
 #include "wascore/protocol.h"
+#include "wascore/protocol_json.h"
 #include "wascore/protocol_xml.h"
+#include "wascore/partition_key_filter.h"
+#include "wascore/partition_tracker.h"
+#include "wascore/request_coalescer.h"
 #include "wascore/resources.h"
+#include "wascore/table_entity_cache.h"
 #include "wascore/util.h"
 #include "was/table.h"
 
 namespace wa { namespace storage {
 
+    namespace
+    {
+        // Records every attempt of the command with the partition it addresses, if the operation is one of those sampled
+        template<typename T>
+        void sample_partition(core::storage_command<T>& command, const cloud_table_client& client, const utility::string_t& table_name, const utility::string_t& partition_key)
+        {
+            std::shared_ptr<core::partition_tracker> tracker = client.partition_tracker();
+            if (tracker == nullptr || !tracker->should_sample())
+            {
+                return;
+            }
+
+            command.set_record_attempt([tracker, table_name, partition_key] (const request_result& result)
+            {
+                tracker->record(table_name, partition_key, result);
+            });
+        }
+
+        // Passes the entities read from the ranges of a parallel query to a single handler
+        class parallel_query_merger
+        {
+        public:
+
+            parallel_query_merger(size_t range_count, bool preserve_order, std::function<bool (const table_entity&)> handler)
+                : m_preserve_order(preserve_order), m_handler(std::move(handler)), m_stopped(false), m_current_range(0), m_buffered_results(range_count), m_completed_ranges(range_count, false)
+            {
+            }
+
+            bool is_stopped() const
+            {
+                return m_stopped;
+            }
+
+            void stop()
+            {
+                m_stopped = true;
+            }
+
+            // Returns false once no more entities are wanted
+            bool add_results(size_t range, const std::vector<table_entity>& results)
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                if (!m_preserve_order || range == m_current_range)
+                {
+                    pass_results(results);
+                }
+                else
+                {
+                    std::vector<table_entity>& buffered = m_buffered_results[range];
+                    buffered.insert(buffered.end(), results.begin(), results.end());
+                }
+
+                return !m_stopped;
+            }
+
+            void complete_range(size_t range)
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_completed_ranges[range] = true;
+
+                // The ranges that were held back are passed on in order, up to the first one that is still being read
+                while (m_preserve_order && m_current_range < m_completed_ranges.size() && m_completed_ranges[m_current_range])
+                {
+                    if (++m_current_range < m_buffered_results.size())
+                    {
+                        std::vector<table_entity> buffered;
+                        buffered.swap(m_buffered_results[m_current_range]);
+                        pass_results(buffered);
+                    }
+                }
+            }
+
+        private:
+
+            void pass_results(const std::vector<table_entity>& results)
+            {
+                for (auto iter = results.cbegin(); iter != results.cend() && !m_stopped; ++iter)
+                {
+                    if (!m_handler(*iter))
+                    {
+                        m_stopped = true;
+                    }
+                }
+            }
+
+            const bool m_preserve_order;
+            std::function<bool (const table_entity&)> m_handler;
+            std::atomic<bool> m_stopped;
+            size_t m_current_range;
+            std::vector<std::vector<table_entity>> m_buffered_results;
+            std::vector<bool> m_completed_ranges;
+            std::mutex m_mutex;
+        };
+
+        // Forwards the entities of one page to a receiver, skipping those that a failed attempt at the page has already forwarded
+        class resuming_entity_receiver : public table_entity_receiver
+        {
+        public:
+
+            explicit resuming_entity_receiver(std::shared_ptr<table_entity_receiver> receiver)
+                : m_receiver(std::move(receiver)), m_delivered(0), m_index(0), m_forwarding(false), m_stopped(false)
+            {
+            }
+
+            void start_attempt()
+            {
+                m_index = 0;
+                m_forwarding = false;
+            }
+
+            bool is_stopped() const
+            {
+                return m_stopped;
+            }
+
+            virtual int property_index(const std::string& name) const
+            {
+                return m_receiver->property_index(name);
+            }
+
+            virtual edm_type property_type(int index) const
+            {
+                return m_receiver->property_type(index);
+            }
+
+            virtual void begin_entity()
+            {
+                m_forwarding = !m_stopped && m_index++ >= m_delivered;
+                if (m_forwarding)
+                {
+                    m_receiver->begin_entity();
+                }
+            }
+
+            virtual void set_partition_key(const utility::string_t& value)
+            {
+                if (m_forwarding)
+                {
+                    m_receiver->set_partition_key(value);
+                }
+            }
+
+            virtual void set_row_key(const utility::string_t& value)
+            {
+                if (m_forwarding)
+                {
+                    m_receiver->set_row_key(value);
+                }
+            }
+
+            virtual void set_timestamp(const utility::datetime& value)
+            {
+                if (m_forwarding)
+                {
+                    m_receiver->set_timestamp(value);
+                }
+            }
+
+            virtual void set_etag(const utility::string_t& value)
+            {
+                if (m_forwarding)
+                {
+                    m_receiver->set_etag(value);
+                }
+            }
+
+            virtual void set_property(int index, const entity_property& value)
+            {
+                if (m_forwarding)
+                {
+                    m_receiver->set_property(index, value);
+                }
+            }
+
+            virtual bool end_entity()
+            {
+                if (m_forwarding)
+                {
+                    m_forwarding = false;
+                    ++m_delivered;
+                    if (!m_receiver->end_entity())
+                    {
+                        m_stopped = true;
+                    }
+                }
+
+                return !m_stopped;
+            }
+
+        private:
+
+            std::shared_ptr<table_entity_receiver> m_receiver;
+            size_t m_delivered;
+            size_t m_index;
+            bool m_forwarding;
+            bool m_stopped;
+        };
+
+        // Restricts the query to the PartitionKeys of the range
+        table_query get_range_query(const table_query& query, const core::partition_key_range& range)
+        {
+            utility::string_t range_filter = core::get_partition_key_filter(range);
+
+            table_query range_query(query);
+            if (!query.filter_string().empty() && !range_filter.empty())
+            {
+                range_query.set_filter_string(table_query::combine_filter_conditions(query.filter_string(), query_logical_operator::and, range_filter));
+            }
+            else if (!range_filter.empty())
+            {
+                range_query.set_filter_string(range_filter);
+            }
+
+            return range_query;
+        }
+
+        // Restricts the query to the PartitionKeys from the lower bound up to the upper bound, where an empty bound leaves that side open
+        table_query get_range_query(const table_query& query, const utility::string_t& lower_partition_key, const utility::string_t& upper_partition_key)
+        {
+            core::partition_key_range range;
+            range.lower = lower_partition_key;
+            range.upper = upper_partition_key;
+            range.has_upper = !upper_partition_key.empty();
+            return get_range_query(query, range);
+        }
+
+        // Builds a query for the entities of one partition that have any of the given row keys
+        table_query get_lookup_query(const utility::string_t& partition_key, const std::map<utility::string_t, std::vector<size_t>>& rows)
+        {
+            utility::string_t row_filter;
+            for (auto row = rows.cbegin(); row != rows.cend(); ++row)
+            {
+                utility::string_t condition = table_query::generate_filter_condition(U("RowKey"), query_comparison_operator::equal, row->first);
+                row_filter = row_filter.empty() ? condition : table_query::combine_filter_conditions(row_filter, query_logical_operator::or, condition);
+            }
+
+            utility::string_t partition_filter = table_query::generate_filter_condition(U("PartitionKey"), query_comparison_operator::equal, partition_key);
+
+            table_query query;
+            query.set_filter_string(table_query::combine_filter_conditions(partition_filter, query_logical_operator::and, row_filter));
+            return query;
+        }
+
+        // Builds the request of a single entity operation and checks its response, without binding its arguments into function objects
+        class table_entity_operation : public core::basic_command_operation
+        {
+        public:
+
+            table_entity_operation(const table_operation& operation, table_payload_format payload_format, bool echo_content, utility::string_t if_none_match)
+                : m_operation(operation), m_payload_format(payload_format), m_echo_content(echo_content), m_if_none_match(std::move(if_none_match)),
+                m_allow_not_found(operation.operation_type() == table_operation_type::retrieve_operation), m_allow_not_modified(!m_if_none_match.empty())
+            {
+            }
+
+            web::http::http_request build_request(web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) const
+            {
+                web::http::http_request request = protocol::execute_operation(m_operation, m_payload_format, m_echo_content, uri_builder, timeout, context);
+                if (m_allow_not_modified)
+                {
+                    request.headers().add(web::http::header_names::if_none_match, m_if_none_match);
+                }
+
+                return request;
+            }
+
+            table_result preprocess_response(const web::http::http_response& response, operation_context context) const
+            {
+                bool is_allowed = (m_allow_not_found && response.status_code() == web::http::status_codes::NotFound) ||
+                    (m_allow_not_modified && response.status_code() == web::http::status_codes::NotModified);
+                if (!is_allowed)
+                {
+                    protocol::preprocess_response(response, context);
+                }
+
+                return table_result();
+            }
+
+        private:
+
+            table_operation m_operation;
+            table_payload_format m_payload_format;
+            bool m_echo_content;
+            utility::string_t m_if_none_match;
+
+            // Do not throw an exception when the retrieve fails because the entity does not exist, or when a cached entity has not changed
+            bool m_allow_not_found;
+            bool m_allow_not_modified;
+        };
+    }
+
     const utility::string_t query_comparison_operator::equal = U("eq");
     const utility::string_t query_comparison_operator::not_equal = U("ne");
     const utility::string_t query_comparison_operator::greater_than = U("gt");
@@ -55,14 +354,25 @@ namespace wa { namespace storage {
 
     pplx::task<bool> cloud_table::create_if_not_exists_async(const table_request_options& options, operation_context context)
     {
-        return exists_async_impl(options, context, /* allow_secondary */ false).then([this, options, context] (bool exists) -> pplx::task<bool>
+        table_request_options modified_options = get_modified_options(options);
+
+        // A table that was recently confirmed to exist is not created again
+        std::shared_ptr<core::existence_cache> cache = modified_options._existence_cache();
+        utility::string_t key = protocol::generate_table_uri(service_client(), *this).primary_uri().to_string();
+        if (cache && cache->contains(key))
+        {
+            return pplx::task_from_result(false);
+        }
+
+        // Table errors may be returned as JSON, which request_result does not parse, so any conflict means the table exists
+        return create_async_impl(modified_options, context, /* allow_conflict */ true).then([cache, key] (bool created) -> bool
         {
-            if (exists)
+            if (cache)
             {
-                return pplx::task_from_result(false);
+                cache->add(key);
             }
 
-            return create_async_impl(options, context, /* allow_conflict */ true);
+            return created;
         });
     }
 
@@ -75,15 +385,7 @@ namespace wa { namespace storage {
 
     pplx::task<bool> cloud_table::delete_table_if_exists_async(const table_request_options& options, operation_context context)
     {
-        return exists_async_impl(options, context, /* allow_secondary */ false).then([this, options, context] (bool exists) -> pplx::task<bool>
-        {
-            if (!exists)
-            {
-                return pplx::task_from_result(false);
-            }
-
-            return delete_async_impl(options, context, /* allow_not_found */ true);
-        });
+        return delete_async_impl(options, context, /* allow_not_found */ true);
     }
 
     pplx::task<bool> cloud_table::exists_async(const table_request_options& options, operation_context context) const
@@ -94,29 +396,107 @@ namespace wa { namespace storage {
     pplx::task<table_result> cloud_table::execute_async(const table_operation& operation, const table_request_options& options, operation_context context) const
     {
         table_request_options modified_options = get_modified_options(options);
-        storage_uri uri = protocol::generate_table_uri(service_client(), *this, operation);
 
-        // Do not throw an exception when the retrieve fails because the entity does not exist
-        bool allow_not_found = operation.operation_type() == table_operation_type::retrieve_operation;
+        std::shared_ptr<core::table_entity_cache> cache = service_client().entity_cache();
+        if (cache == nullptr || !cache->is_enabled())
+        {
+            if (operation.operation_type() == table_operation_type::retrieve_operation)
+            {
+                return retrieve_async_impl(operation, utility::string_t(), modified_options, context);
+            }
+
+            return execute_async_impl(operation, utility::string_t(), modified_options, context);
+        }
 
-        std::shared_ptr<core::storage_command<table_result>> command = std::make_shared<core::storage_command<table_result>>(uri);
-        command->set_build_request(std::bind(protocol::execute_operation, operation, options.payload_format(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-        command->set_authentication_handler(service_client().authentication_handler());
-        command->set_location_mode(operation.operation_type() == wa::storage::table_operation_type::retrieve_operation ? core::command_location_mode::primary_or_secondary : core::command_location_mode::primary_only);
-        command->set_preprocess_response([allow_not_found] (const web::http::http_response& response, operation_context context) -> table_result
+        utility::string_t key = core::table_entity_cache::get_key(name(), operation.entity().partition_key(), operation.entity().row_key());
+        if (operation.operation_type() != table_operation_type::retrieve_operation)
         {
-            if (!allow_not_found || response.status_code() != web::http::status_codes::NotFound)
+            // The entity is removed again once the write completes, in case a retrieve that started meanwhile read the old version
+            cache->remove(key);
+            return execute_async_impl(operation, utility::string_t(), modified_options, context).then([cache, key] (pplx::task<table_result> write_task) -> table_result
             {
-                protocol::preprocess_response(response, context);
+                cache->remove(key);
+                return write_task.get();
+            });
+        }
+
+        // Types chosen by a property resolver may differ between calls, so those entities are not cached,
+        // and neither are entities that record their properties, since cached ones may not have
+        if (modified_options.property_resolver() || modified_options.track_property_changes())
+        {
+            return execute_async_impl(operation, utility::string_t(), modified_options, context);
+        }
+
+        table_result cached_result;
+        bool is_fresh;
+        bool is_cached = cache->try_get(key, cached_result, is_fresh);
+        if (is_cached && is_fresh)
+        {
+            return pplx::task_from_result(cached_result);
+        }
+
+        uint64_t read_invalidations = cache->begin_read();
+        utility::string_t if_none_match = is_cached ? cached_result.etag() : utility::string_t();
+        return retrieve_async_impl(operation, if_none_match, modified_options, context).then([cache, key, cached_result, read_invalidations] (table_result result) -> table_result
+        {
+            switch (result.http_status_code())
+            {
+            case web::http::status_codes::NotModified:
+                cache->refresh(key);
+                return cached_result;
+
+            case web::http::status_codes::OK:
+                cache->put(key, result, read_invalidations);
+                break;
+
+            default:
+                cache->remove(key);
+                break;
             }
-            return table_result();
+
+            return result;
         });
-        command->set_postprocess_response([] (const web::http::http_response& response, const request_result&, const core::ostream_descriptor&, operation_context context) -> pplx::task<table_result>
+    }
+
+    pplx::task<table_result> cloud_table::retrieve_async_impl(const table_operation& operation, const utility::string_t& if_none_match, const table_request_options& modified_options, operation_context context) const
+    {
+        // Types chosen by a property resolver may differ between calls, so those retrieves are not joined, and
+        // neither are retrieves that record the properties of the entity
+        std::shared_ptr<core::request_coalescer> coalescer = service_client().request_coalescer();
+        if (coalescer == nullptr || !coalescer->is_enabled() || modified_options.property_resolver() || modified_options.track_property_changes())
+        {
+            return execute_async_impl(operation, if_none_match, modified_options, context);
+        }
+
+        utility::ostringstream_t key;
+        key << U("table\n") << uri().primary_uri().to_string() << U('\n') << operation.entity().partition_key() << U('\n') << operation.entity().row_key()
+            << U('\n') << static_cast<int>(modified_options.location_mode()) << U('\n') << if_none_match;
+
+        cloud_table instance(*this);
+        return coalescer->run_async<table_result>(key.str(), [instance, operation, if_none_match, modified_options, context] () -> pplx::task<table_result>
+        {
+            return instance.execute_async_impl(operation, if_none_match, modified_options, context);
+        });
+    }
+
+    pplx::task<table_result> cloud_table::execute_async_impl(const table_operation& operation, const utility::string_t& if_none_match, const table_request_options& modified_options, operation_context context) const
+    {
+        storage_uri uri = protocol::generate_table_uri(service_client(), *this, operation);
+
+        auto command = std::make_shared<core::static_storage_command<table_result, table_entity_operation>>(uri, table_entity_operation(operation, modified_options.payload_format(), modified_options.echo_content(), if_none_match));
+        command->set_authentication_handler(service_client().authentication_handler());
+        command->set_location_mode(operation.operation_type() == wa::storage::table_operation_type::retrieve_operation ? core::command_location_mode::primary_or_secondary : core::command_location_mode::primary_only);
+        command->set_stream_response_body(true);
+        sample_partition(*command, service_client(), name(), operation.entity().partition_key());
+        auto property_resolver = modified_options.property_resolver();
+        bool track_property_changes = modified_options.track_property_changes();
+        command->set_postprocess_response([property_resolver, track_property_changes] (const web::http::http_response& response, const request_result&, const core::ostream_descriptor&, operation_context context) -> pplx::task<table_result>
         {
             int status_code = response.status_code();
             utility::string_t etag = protocol::table_response_parsers::parse_etag(response);
 
-            if (status_code == web::http::status_codes::NoContent)
+            // A retrieve of an entity that does not exist has an error body rather than an entity, and an unchanged entity has no body
+            if (status_code == web::http::status_codes::NoContent || status_code == web::http::status_codes::NotFound || status_code == web::http::status_codes::NotModified)
             {
                 table_result result;
                 result.set_http_status_code(status_code);
@@ -125,12 +505,17 @@ namespace wa { namespace storage {
             }
             else
             {
-                return response.extract_json().then([status_code, etag] (const web::json::value& obj) -> table_result
+                // The reader pulls the body while it downloads, so it runs as its own task
+                return pplx::create_task([response, status_code, etag, property_resolver, track_property_changes] () -> table_result
                 {
+                    protocol::table_entity_reader reader(response.body(), /* is_query */ false);
+                    reader.set_property_resolver(property_resolver);
+                    reader.set_track_property_changes(track_property_changes);
+
                     table_result result;
                     result.set_http_status_code(status_code);
                     result.set_etag(etag);
-                    result.set_entity(protocol::table_response_parsers::parse_entity(obj));
+                    result.set_entity(reader.extract_entity());
                     return result;
                 });
             }
@@ -177,59 +562,185 @@ namespace wa { namespace storage {
             throw std::invalid_argument("The batch operation cannot contain any other operations when it contains a retrieve operation.");
         }
 
-        // TODO: Pre-create a stream for the response to pass to response handler in other functions too so the response doesn't need to be copied
-        Concurrency::streams::stringstreambuf response_buffer;
+        size_t batch_size = operations.size();
+
+        // The cached copies of the entities a batch changes are removed both before and after it runs, like for single operations
+        std::shared_ptr<core::table_entity_cache> cache = service_client().entity_cache();
+        std::vector<utility::string_t> cache_keys;
+        if (!is_query && cache != nullptr && cache->is_enabled())
+        {
+            cache_keys.reserve(batch_size);
+            for (std::vector<table_operation>::const_iterator itr = operations.cbegin(); itr != operations.cend(); ++itr)
+            {
+                cache_keys.push_back(core::table_entity_cache::get_key(name(), itr->entity().partition_key(), itr->entity().row_key()));
+                cache->remove(cache_keys.back());
+            }
+        }
 
         std::shared_ptr<core::storage_command<std::vector<table_result>>> command = std::make_shared<core::storage_command<std::vector<table_result>>>(uri);
-        command->set_build_request(std::bind(protocol::execute_batch_operation, response_buffer, *this, operation, options.payload_format(), is_query, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        cloud_table instance(*this);
+        table_payload_format payload_format = options.payload_format();
+        bool echo_content = options.echo_content();
+        command->set_build_request([instance, operation, payload_format, is_query, echo_content] (web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context) -> web::http::http_request
+        {
+            return protocol::execute_batch_operation(instance, operation, payload_format, is_query, echo_content, uri_builder, timeout, context);
+        });
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_location_mode(is_query ? core::command_location_mode::primary_or_secondary : core::command_location_mode::primary_only);
+        sample_partition(*command, service_client(), name(), partition_key);
         command->set_preprocess_response([] (const web::http::http_response& response, operation_context context) -> std::vector<table_result>
         {
             protocol::preprocess_response(response, context);
             return std::vector<table_result>();
         });
-        command->set_postprocess_response([response_buffer, operations, is_query] (const web::http::http_response& response, const request_result&, const core::ostream_descriptor&, operation_context context) mutable -> pplx::task<std::vector<table_result>>
+        command->set_stream_response_body(true);
+        command->set_postprocess_response([is_query, batch_size] (const web::http::http_response& response, const request_result&, const core::ostream_descriptor&, operation_context context) -> pplx::task<std::vector<table_result>>
         {
-            return response.content_ready().then([response_buffer, operations, is_query] (const web::http::http_response& response) mutable -> pplx::task<std::vector<table_result>>
+            // The multipart response is parsed while it downloads, so it runs as its own task
+            return pplx::create_task([response, is_query, batch_size] () -> std::vector<table_result>
             {
-                /*
-                std::vector<table_result> batch_result;
-                batch_result.reserve(operations.size());
+                return protocol::table_response_parsers::parse_batch_results(response.body(), is_query, batch_size);
+            });
+        });
+        pplx::task<std::vector<table_result>> batch_task = core::executor<std::vector<table_result>>::execute_async(command, modified_options, context);
+        if (cache_keys.empty())
+        {
+            return batch_task;
+        }
 
-                for (std::vector<table_operation>::const_iterator itr = operations.cbegin(); itr != operations.cend(); ++itr)
-                {
-                    table_result result;
-                    result.set_entity(itr->entity());
+        return batch_task.then([cache, cache_keys] (pplx::task<std::vector<table_result>> completed_task) -> std::vector<table_result>
+        {
+            for (std::vector<utility::string_t>::const_iterator itr = cache_keys.cbegin(); itr != cache_keys.cend(); ++itr)
+            {
+                cache->remove(*itr);
+            }
 
-                    batch_result.push_back(result);
-                }
-                */
+            return completed_task.get();
+        });
+    }
 
-                std::vector<table_result> batch_result = protocol::table_response_parsers::parse_batch_results(response_buffer, is_query, operations.size());
-                return pplx::task_from_result(batch_result);
+    pplx::task<std::vector<table_entity>> cloud_table::execute_query_async(const table_query& query, const table_request_options& options, operation_context context) const
+    {
+        // A filter that names several PartitionKeys or ranges of them is read one range per request, concurrently and in the same order
+        table_request_options modified_options = get_modified_options(options);
+        if ((modified_options.parallelism_factor() > 1) && (core::get_partition_key_ranges(query.filter_string()).size() > 1))
+        {
+            auto results = std::make_shared<std::vector<table_entity>>();
+            return execute_query_parallel_async(query, std::vector<utility::string_t>(), true, [results] (const table_entity& entity) -> bool
+            {
+                results->push_back(entity);
+                return true;
+            }, modified_options, context).then([results] () -> std::vector<table_entity>
+            {
+                return std::move(*results);
             });
+        }
+
+        auto table = *this;
+        return core::list_all_segments_async<table_entity, table_query_segment>([table, query, options, context] (const continuation_token& token) -> pplx::task<table_query_segment>
+        {
+            return table.execute_query_segmented_async(query, token, options, context);
         });
-        return core::executor<std::vector<table_result>>::execute_async(command, modified_options, context);
     }
 
-    pplx::task<std::vector<table_entity>> cloud_table::execute_query_async(const table_query& query, const table_request_options& options, operation_context context) const
+    pplx::task<void> cloud_table::execute_query_async(const table_query& query, std::function<bool (const table_entity&)> handler, bool prefetch, const table_request_options& options, operation_context context) const
+    {
+        auto table = *this;
+        return core::for_each_segment_result_async<table_entity, table_query_segment>([table, query, options, context] (const continuation_token& token) -> pplx::task<table_query_segment>
+        {
+            return table.execute_query_segmented_async(query, token, options, context);
+        }, std::move(handler), prefetch);
+    }
+
+    pplx::task<table_query_result> cloud_table::execute_query_async(const table_query& query, size_t max_memory_size, const utility::string_t& spill_directory, const table_request_options& options, operation_context context) const
+    {
+        table_query_result result(max_memory_size, spill_directory);
+        return execute_query_async(query, [result] (const table_entity& entity) mutable -> bool
+        {
+            result.append(entity);
+            return true;
+        }, true, options, context).then([result] () mutable -> table_query_result
+        {
+            result.finish();
+            return result;
+        });
+    }
+
+    pplx::task<void> cloud_table::execute_query_async(const table_query& query, std::shared_ptr<table_entity_receiver> receiver, const table_request_options& options, operation_context context) const
     {
-        std::shared_ptr<std::vector<table_entity>> results = std::make_shared<std::vector<table_entity>>();
-        std::shared_ptr<continuation_token> continuation_token = std::make_shared<wa::storage::continuation_token>();
+        table_request_options modified_options = get_modified_options(options);
+
+        auto table = *this;
+        auto current_token = std::make_shared<continuation_token>();
+        auto stopped = std::make_shared<bool>(false);
 
-        return pplx::details::do_while([this, results, query, continuation_token, options, context] () mutable -> pplx::task<bool>
+        return pplx::details::do_while([table, query, receiver, current_token, stopped, modified_options, context] () -> pplx::task<bool>
         {
-            return execute_query_segmented_async(query, *continuation_token, options, context).then([results, continuation_token] (table_query_segment query_segment) mutable -> bool
+            auto page_receiver = std::make_shared<resuming_entity_receiver>(receiver);
+
+            storage_uri uri = protocol::generate_table_uri(table.service_client(), table, query, *current_token);
+            auto command = std::make_shared<core::storage_command<continuation_token>>(uri);
+            command->set_build_request(std::bind(protocol::execute_query, modified_options.payload_format(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            command->set_authentication_handler(table.service_client().authentication_handler());
+            command->set_location_mode(core::command_location_mode::primary_or_secondary, current_token->target_location());
+            command->set_accept_compressed_response(true);
+            command->set_preprocess_response([] (const web::http::http_response& response, operation_context context) -> continuation_token
+            {
+                protocol::preprocess_response(response, context);
+                return continuation_token();
+            });
+            command->set_stream_response_body(true);
+            command->set_postprocess_response([page_receiver, stopped] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<continuation_token>
+            {
+                continuation_token next_token = protocol::table_response_parsers::parse_continuation_token(response, result);
+
+                return pplx::create_task([page_receiver, stopped, response, next_token] () -> continuation_token
+                {
+                    page_receiver->start_attempt();
+
+                    protocol::table_entity_reader reader(response.body(), page_receiver.get());
+                    reader.parse();
+
+                    if (page_receiver->is_stopped())
+                    {
+                        *stopped = true;
+                        return continuation_token();
+                    }
+
+                    return next_token;
+                });
+            });
+
+            return core::executor<continuation_token>::execute_async(command, modified_options, context).then([current_token, stopped] (continuation_token next_token) -> bool
             {
-                std::vector<table_entity> partial_results = query_segment.results();
-                results->insert(results->end(), partial_results.begin(), partial_results.end());
-                *continuation_token = query_segment.continuation_token();
-                return !continuation_token->empty();
+                *current_token = std::move(next_token);
+                return !*stopped && !current_token->empty();
             });
-        }).then([results] (bool guard) -> pplx::task<std::vector<table_entity>>
+        }).then([] (bool)
+        {
+        });
+    }
+
+    pplx::task<void> cloud_table::execute_query_columnar_async(const table_query& query, const std::vector<std::pair<utility::string_t, edm_type>>& columns, size_t batch_size, std::function<bool (const table_column_batch&)> handler, const table_request_options& options, operation_context context) const
+    {
+        auto receiver = std::make_shared<table_column_batch_receiver>(columns, batch_size, std::move(handler));
+
+        table_query projected_query = query;
+        if (projected_query.select_columns().empty())
+        {
+            std::vector<utility::string_t> select_columns;
+            select_columns.reserve(columns.size());
+            for (auto iter = columns.cbegin(); iter != columns.cend(); ++iter)
+            {
+                select_columns.push_back(iter->first);
+            }
+
+            projected_query.set_select_columns(select_columns);
+        }
+
+        return execute_query_async(projected_query, receiver, options, context).then([receiver] ()
         {
-            return pplx::task_from_result(*results);
+            receiver->finish();
         });
     }
 
@@ -247,12 +758,17 @@ namespace wa { namespace storage {
         command->set_build_request(std::bind(protocol::execute_query, options.payload_format(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
         command->set_location_mode(core::command_location_mode::primary_or_secondary, continuation_token.target_location());
+        command->set_accept_compressed_response(true);
         command->set_preprocess_response([] (const web::http::http_response& response, operation_context context) -> table_query_segment
         {
             protocol::preprocess_response(response, context);
             return table_query_segment();
         });
-        command->set_postprocess_response([] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<table_query_segment>
+        command->set_stream_response_body(true);
+        auto select_columns = query.select_columns();
+        auto property_resolver = modified_options.property_resolver();
+        bool track_property_changes = modified_options.track_property_changes();
+        command->set_postprocess_response([select_columns, property_resolver, track_property_changes] (const web::http::http_response& response, const request_result& result, const core::ostream_descriptor&, operation_context context) -> pplx::task<table_query_segment>
         {
             storage::continuation_token next_continuation_token = protocol::table_response_parsers::parse_continuation_token(response, result);
 
@@ -261,10 +777,17 @@ namespace wa { namespace storage {
             return pplx::task_from_result(result);
             */
 
-            return response.extract_json().then([next_continuation_token] (const web::json::value& obj) -> table_query_segment
+            // The reader pulls the body while it downloads, so it runs as its own task
+            return pplx::create_task([response, next_continuation_token, select_columns, property_resolver, track_property_changes] () -> table_query_segment
             {
+                // Only the selected properties are read, and their types come from the resolver if there is one
+                protocol::table_entity_reader reader(response.body(), /* is_query */ true);
+                reader.set_projection(select_columns);
+                reader.set_property_resolver(property_resolver);
+                reader.set_track_property_changes(track_property_changes);
+
                 table_query_segment query_segment;
-                query_segment.set_results(protocol::table_response_parsers::parse_query_results(obj));
+                query_segment.set_results(reader.extract_entities());
                 query_segment.set_continuation_token(next_continuation_token);
 
                 return query_segment;
@@ -273,6 +796,309 @@ namespace wa { namespace storage {
         return core::executor<table_query_segment>::execute_async(command, modified_options, context);
     }
 
+    pplx::task<void> cloud_table::execute_query_parallel_async(const table_query& query, const std::vector<utility::string_t>& partition_key_boundaries, bool preserve_order, std::function<bool (const table_entity&)> handler, const table_request_options& options, operation_context context) const
+    {
+        table_request_options modified_options = get_modified_options(options);
+
+        // Only the PartitionKeys that the filter can match are queried, and each key or range the filter names is queried on its own
+        auto ranges = std::make_shared<std::vector<core::partition_key_range>>(core::split_partition_key_ranges(core::get_partition_key_ranges(query.filter_string()), partition_key_boundaries));
+        size_t range_count = ranges->size();
+        if (range_count == 0)
+        {
+            return pplx::task_from_result();
+        }
+
+        auto table = *this;
+        auto merger = std::make_shared<parallel_query_merger>(range_count, preserve_order, std::move(handler));
+
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        auto range_tasks = std::make_shared<std::vector<pplx::task<void>>>();
+        auto next_range = std::make_shared<size_t>(0);
+
+        return pplx::details::do_while([table, query, ranges, range_count, merger, modified_options, context, semaphore, range_tasks, next_range] () mutable -> pplx::task<bool>
+        {
+            return semaphore.lock_async().then([table, query, ranges, range_count, merger, modified_options, context, semaphore, range_tasks, next_range] () mutable -> bool
+            {
+                if (merger->is_stopped())
+                {
+                    semaphore.unlock();
+                    return false;
+                }
+
+                size_t range = (*next_range)++;
+                table_query range_query = get_range_query(query, (*ranges)[range]);
+                auto continuation_token = std::make_shared<wa::storage::continuation_token>();
+
+                auto range_task = pplx::details::do_while([table, range_query, range, merger, continuation_token, modified_options, context] () -> pplx::task<bool>
+                {
+                    return table.execute_query_segmented_async(range_query, *continuation_token, modified_options, context).then([range, merger, continuation_token] (table_query_segment query_segment) -> bool
+                    {
+                        *continuation_token = query_segment.continuation_token();
+                        return merger->add_results(range, query_segment.results()) && !continuation_token->empty();
+                    });
+                }).then([range, merger] (bool)
+                {
+                    merger->complete_range(range);
+                });
+
+                range_task.then([semaphore, merger] (pplx::task<void> completed_task) mutable
+                {
+                    try
+                    {
+                        completed_task.wait();
+                    }
+                    catch (...)
+                    {
+                        // Remaining ranges are not started and running ones stop after their current segment
+                        merger->stop();
+                    }
+
+                    semaphore.unlock();
+                });
+
+                range_tasks->push_back(range_task);
+                return *next_range < range_count;
+            });
+        }).then([semaphore, range_tasks] (bool) mutable -> pplx::task<void>
+        {
+            return semaphore.wait_all_async().then([range_tasks] ()
+            {
+                // Rethrow the first failure, if any
+                for (auto iter = range_tasks->begin(); iter != range_tasks->end(); ++iter)
+                {
+                    iter->get();
+                }
+            });
+        });
+    }
+
+    table_scan_unit::table_scan_unit(const table_query& query, const utility::string_t& lower_partition_key, const utility::string_t& upper_partition_key)
+        : m_query(get_range_query(query, lower_partition_key, upper_partition_key)), m_lower_partition_key(lower_partition_key), m_upper_partition_key(upper_partition_key), m_is_complete(false)
+    {
+    }
+
+    std::vector<table_scan_unit> table_scan_unit::split(const table_query& query, const std::vector<utility::string_t>& partition_key_boundaries)
+    {
+        std::vector<table_scan_unit> units;
+        units.reserve(partition_key_boundaries.size() + 1);
+        for (size_t range = 0; range <= partition_key_boundaries.size(); ++range)
+        {
+            units.push_back(table_scan_unit(query, range > 0 ? partition_key_boundaries[range - 1] : utility::string_t(), range < partition_key_boundaries.size() ? partition_key_boundaries[range] : utility::string_t()));
+        }
+
+        return units;
+    }
+
+    utility::string_t table_scan_unit::to_string() const
+    {
+        // The saved filter already holds the range, so the bounds are only kept to be reported again
+        utility::string_t result;
+        core::append_text_field(result, U("version"), U("1"));
+        core::append_text_field(result, U("filter"), m_query.filter_string());
+        core::append_text_field(result, U("take_count"), utility::conversions::print_string(m_query.take_count()));
+        for (auto iter = m_query.select_columns().cbegin(); iter != m_query.select_columns().cend(); ++iter)
+        {
+            core::append_text_field(result, U("select"), *iter);
+        }
+
+        core::append_text_field(result, U("lower"), m_lower_partition_key);
+        core::append_text_field(result, U("upper"), m_upper_partition_key);
+        core::append_continuation_token_fields(result, m_continuation_token);
+        core::append_text_field(result, U("complete"), m_is_complete ? U("1") : U("0"));
+        return result;
+    }
+
+    table_scan_unit table_scan_unit::parse(const utility::string_t& value)
+    {
+        std::vector<std::pair<utility::string_t, utility::string_t>> fields;
+        bool valid = core::parse_text_fields(value, fields);
+        bool has_version = false;
+
+        table_query query;
+        std::vector<utility::string_t> select_columns;
+        table_scan_unit result(query);
+        for (auto iter = fields.cbegin(); valid && (iter != fields.cend()); ++iter)
+        {
+            const utility::string_t& name = iter->first;
+            const utility::string_t& field = iter->second;
+            if (name == U("version"))
+            {
+                has_version = true;
+                valid = (field == U("1"));
+            }
+            else if (name == U("filter"))
+            {
+                query.set_filter_string(field);
+            }
+            else if (name == U("take_count"))
+            {
+                valid = !field.empty() && (field.find_first_not_of(U("-0123456789")) == utility::string_t::npos);
+                if (valid)
+                {
+                    query.set_take_count(utility::conversions::scan_string<int>(field));
+                }
+            }
+            else if (name == U("select"))
+            {
+                select_columns.push_back(field);
+            }
+            else if (name == U("lower"))
+            {
+                result.m_lower_partition_key = field;
+            }
+            else if (name == U("upper"))
+            {
+                result.m_upper_partition_key = field;
+            }
+            else if (name == U("complete"))
+            {
+                valid = (field == U("0")) || (field == U("1"));
+                result.m_is_complete = (field == U("1"));
+            }
+            else
+            {
+                // Any other field that is not part of the continuation token was written by a later version and is skipped
+                core::parse_continuation_token_field(name, field, result.m_continuation_token, valid);
+            }
+        }
+
+        if (!valid || !has_version)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_invalid_work_unit));
+        }
+
+        query.set_select_columns(select_columns);
+        result.m_query = query;
+        return result;
+    }
+
+    pplx::task<std::vector<table_result>> cloud_table::retrieve_entities_async(const std::vector<std::pair<utility::string_t, utility::string_t>>& keys, const table_request_options& options, operation_context context) const
+    {
+        if (keys.empty())
+        {
+            return pplx::task_from_result(std::vector<table_result>());
+        }
+
+        table_request_options modified_options = get_modified_options(options);
+
+        // The positions of each key, grouped by partition and row key so that a key asked for twice is only read once
+        typedef std::map<utility::string_t, std::vector<size_t>> rows_type;
+        std::map<utility::string_t, rows_type> partitions;
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            partitions[keys[i].first][keys[i].second].push_back(i);
+        }
+
+        // Keys that no query or retrieve finds keep this result
+        table_result not_found_result;
+        not_found_result.set_http_status_code(web::http::status_codes::NotFound);
+        auto results = std::make_shared<std::vector<table_result>>(keys.size(), not_found_result);
+
+        auto table = *this;
+        core::async_semaphore semaphore(modified_options.parallelism_factor());
+        auto tasks = std::make_shared<std::vector<pplx::task<void>>>();
+
+        for (auto partition = partitions.cbegin(); partition != partitions.cend(); ++partition)
+        {
+            const rows_type& rows = partition->second;
+            if (rows.size() < protocol::min_row_keys_per_lookup_query)
+            {
+                // A single retrieve is cheaper than a query for one or two entities, and can be answered from the entity cache
+                for (auto row = rows.cbegin(); row != rows.cend(); ++row)
+                {
+                    table_operation operation = table_operation::retrieve_entity(partition->first, row->first);
+                    std::vector<size_t> positions = row->second;
+                    tasks->push_back(semaphore.lock_async().then([table, operation, modified_options, context] () -> pplx::task<table_result>
+                    {
+                        return table.execute_async(operation, modified_options, context);
+                    }).then([results, positions] (table_result result)
+                    {
+                        for (auto iter = positions.cbegin(); iter != positions.cend(); ++iter)
+                        {
+                            (*results)[*iter] = result;
+                        }
+                    }));
+                }
+
+                continue;
+            }
+
+            rows_type::const_iterator row = rows.cbegin();
+            while (row != rows.cend())
+            {
+                auto chunk = std::make_shared<rows_type>();
+                for (; row != rows.cend() && chunk->size() < protocol::max_row_keys_per_lookup_query; ++row)
+                {
+                    chunk->insert(*row);
+                }
+
+                table_query query = get_lookup_query(partition->first, *chunk);
+                auto continuation_token = std::make_shared<wa::storage::continuation_token>();
+                tasks->push_back(semaphore.lock_async().then([table, query, chunk, results, continuation_token, modified_options, context] () -> pplx::task<bool>
+                {
+                    return pplx::details::do_while([table, query, chunk, results, continuation_token, modified_options, context] () -> pplx::task<bool>
+                    {
+                        return table.execute_query_segmented_async(query, *continuation_token, modified_options, context).then([chunk, results, continuation_token] (table_query_segment query_segment) -> bool
+                        {
+                            *continuation_token = query_segment.continuation_token();
+
+                            const std::vector<table_entity>& entities = query_segment.results();
+                            for (auto entity = entities.cbegin(); entity != entities.cend(); ++entity)
+                            {
+                                auto positions = chunk->find(entity->row_key());
+                                if (positions == chunk->cend())
+                                {
+                                    continue;
+                                }
+
+                                table_result result;
+                                result.set_http_status_code(web::http::status_codes::OK);
+                                result.set_etag(entity->etag());
+                                result.set_entity(*entity);
+                                for (auto iter = positions->second.cbegin(); iter != positions->second.cend(); ++iter)
+                                {
+                                    (*results)[*iter] = result;
+                                }
+                            }
+
+                            return !continuation_token->empty();
+                        });
+                    });
+                }).then([] (bool)
+                {
+                }));
+            }
+        }
+
+        for (auto iter = tasks->begin(); iter != tasks->end(); ++iter)
+        {
+            iter->then([semaphore] (pplx::task<void> completed_task) mutable
+            {
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                    // The failure is rethrown once all the requests have completed
+                }
+
+                semaphore.unlock();
+            });
+        }
+
+        return semaphore.wait_all_async().then([tasks, results] () -> std::vector<table_result>
+        {
+            // Rethrow the first failure, if any
+            for (auto iter = tasks->begin(); iter != tasks->end(); ++iter)
+            {
+                iter->get();
+            }
+
+            return std::move(*results);
+        });
+    }
+
     utility::string_t cloud_table::get_shared_access_signature(const table_shared_access_policy& policy, const utility::string_t& stored_policy_identifier, const utility::string_t& start_partition_key, const utility::string_t& start_row_key, const utility::string_t& end_partition_key, const utility::string_t& end_row_key) const
     {
         if (!service_client().credentials().is_shared_key())
@@ -340,6 +1166,11 @@ namespace wa { namespace storage {
         table_request_options modified_options = get_modified_options(options);
         storage_uri uri = protocol::generate_table_uri(service_client(), *this, false);
 
+        if (modified_options._existence_cache())
+        {
+            modified_options._existence_cache()->remove(protocol::generate_table_uri(service_client(), *this).primary_uri().to_string());
+        }
+
         std::shared_ptr<core::storage_command<bool>> command = std::make_shared<core::storage_command<bool>>(uri);
         command->set_build_request(std::bind(protocol::execute_table_operation, *this, table_operation_type::delete_operation, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         command->set_authentication_handler(service_client().authentication_handler());
@@ -18,9 +18,28 @@
 #include "stdafx.h"
 #include "was/table.h"
 #include "wascore/util.h"
+#include "wascore/partition_tracker.h"
+#include "wascore/resources.h"
+#include "wascore/table_entity_cache.h"
 
 namespace wa { namespace storage {
 
+    void cloud_table_client::initialize()
+    {
+        set_authentication_scheme(authentication_scheme::shared_key);
+        m_default_request_options._set_http_client_pool(http_client_pool());
+        m_default_request_options._set_location_selector(location_selector());
+        m_default_request_options._set_retry_budget(retry_budget());
+        m_default_request_options._set_latency_recorder(latency_recorder());
+        m_default_request_options._set_prepared_requests(prepared_requests());
+        m_default_request_options._set_existence_cache(existence_cache());
+        m_default_request_options._set_operation_dispatcher(operation_dispatcher());
+        m_default_request_options._set_circuit_breaker(circuit_breaker());
+        set_service_name(U("table"));
+        m_entity_cache = std::make_shared<core::table_entity_cache>();
+        m_partition_tracker = std::make_shared<core::partition_tracker>();
+    }
+
     table_request_options cloud_table_client::get_modified_options(const table_request_options& options) const
     {
         table_request_options modified_options(options);
@@ -30,21 +49,10 @@ namespace wa { namespace storage {
 
     pplx::task<std::vector<cloud_table>> cloud_table_client::list_tables_async(const utility::string_t& prefix, const table_request_options& options, operation_context context) const
     {
-        std::shared_ptr<std::vector<cloud_table>> results = std::make_shared<std::vector<cloud_table>>();
-        std::shared_ptr<continuation_token> continuation_token = std::make_shared<wa::storage::continuation_token>();
-
-        return pplx::details::do_while([this, results, prefix, continuation_token, options, context] () mutable -> pplx::task<bool>
+        auto client = *this;
+        return core::list_all_segments_async<cloud_table, table_result_segment>([client, prefix, options, context] (const continuation_token& token) -> pplx::task<table_result_segment>
         {
-            return list_tables_segmented_async(prefix, -1, *continuation_token, options, context).then([results, continuation_token] (table_result_segment result_segment) mutable -> bool
-            {
-                std::vector<wa::storage::cloud_table> partial_results = result_segment.results();
-                results->insert(results->end(), partial_results.begin(), partial_results.end());
-                *continuation_token = result_segment.continuation_token();
-                return !continuation_token->empty();
-            });
-        }).then([results] (bool guard) -> pplx::task<std::vector<cloud_table>>
-        {
-            return pplx::task_from_result(*results);
+            return client.list_tables_segmented_async(prefix, -1, token, options, context);
         });
     }
 
@@ -118,6 +126,41 @@ namespace wa { namespace storage {
         return table;
     }
 
+    table_entity_cache_settings cloud_table_client::entity_cache_settings() const
+    {
+        return m_entity_cache->settings();
+    }
+
+    void cloud_table_client::set_entity_cache_settings(const table_entity_cache_settings& value)
+    {
+        m_entity_cache->set_settings(value);
+    }
+
+    double cloud_table_client::partition_sampling_rate() const
+    {
+        return m_partition_tracker->sampling_rate();
+    }
+
+    void cloud_table_client::set_partition_sampling_rate(double value)
+    {
+        if (value < 0.0 || value > 1.0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_partition_sampling_rate));
+        }
+
+        m_partition_tracker->set_sampling_rate(value);
+    }
+
+    std::vector<table_partition_statistics> cloud_table_client::hot_partitions(size_t count) const
+    {
+        return m_partition_tracker->hot_partitions(count);
+    }
+
+    void cloud_table_client::reset_partition_statistics()
+    {
+        m_partition_tracker->reset();
+    }
+
     void cloud_table_client::set_authentication_scheme(wa::storage::authentication_scheme value)
     {
         cloud_client::set_authentication_scheme(value);
@@ -0,0 +1,99 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="credential_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/credential_cache.h"
+#include "wascore/constants.h"
+#include "wascore/hash_software.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        std::once_flag instance_flag;
+        credential_cache* instance_pointer = nullptr;
+    }
+
+    credential_cache& credential_cache::instance()
+    {
+        // The cache is never destroyed, so that it can still be used while other static objects are destroyed
+        std::call_once(instance_flag, [] ()
+        {
+            instance_pointer = new credential_cache(protocol::credential_cache_size);
+        });
+
+        return *instance_pointer;
+    }
+
+    void credential_cache::set_enabled(bool value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_enabled = value;
+        if (!value)
+        {
+            m_signing_keys.clear();
+        }
+    }
+
+    std::shared_ptr<const hmac_sha256_hash> credential_cache::get_signing_key(const std::vector<uint8_t>& account_key)
+    {
+        if (!m_enabled)
+        {
+            return std::make_shared<const hmac_sha256_hash>(account_key);
+        }
+
+        // The entries are found by a digest of the account key, so that the cache itself holds no secret
+        std::string key(sha256_hash::digest_size, '\0');
+        sha256_hash digest;
+        digest.update(account_key.data(), account_key.size());
+        digest.finalize(reinterpret_cast<uint8_t*>(&key[0]));
+
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto iter = m_signing_keys.find(key);
+            if (iter != m_signing_keys.end())
+            {
+                auto signing_key = iter->second.lock();
+                if (signing_key)
+                {
+                    return signing_key;
+                }
+            }
+        }
+
+        // A keyed hash holds no heap memory and is copied for each message, so one instance can be shared by all signers
+        auto signing_key = std::make_shared<const hmac_sha256_hash>(account_key);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_signing_keys.size() >= m_max_entries)
+        {
+            for (auto iter = m_signing_keys.begin(); iter != m_signing_keys.end();)
+            {
+                iter = iter->second.expired() ? m_signing_keys.erase(iter) : std::next(iter);
+            }
+        }
+
+        // If every entry is still in use, the key is not shared rather than evicting one that is
+        if (m_enabled && (m_signing_keys.size() < m_max_entries))
+        {
+            m_signing_keys[key] = signing_key;
+        }
+
+        return signing_key;
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,320 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="datetime_codec.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/datetime_codec.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        const int64_t ticks_per_second = 10000000;
+        const int64_t seconds_per_day = 86400;
+
+        // utility::datetime counts 100 nanosecond ticks since 1601-01-01, which is this many days before 1970-01-01
+        const int64_t days_from_1601_to_1970 = 134774;
+
+        const size_t rfc1123_length = 29;
+        const size_t iso8601_seconds_length = 19;
+
+        const char day_names[] = "SunMonTueWedThuFriSat";
+        const char month_names[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+        struct civil_time
+        {
+            int64_t year;
+            int month;
+            int day;
+            int hour;
+            int minute;
+            int second;
+        };
+
+        // Converts between dates of the proleptic Gregorian calendar and days since 1970-01-01, without any tables or loops
+        int64_t days_from_civil(int64_t year, int month, int day)
+        {
+            year -= month <= 2 ? 1 : 0;
+            int64_t era = (year >= 0 ? year : year - 399) / 400;
+            int64_t year_of_era = year - era * 400;
+            int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+            int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+            return era * 146097 + day_of_era - 719468;
+        }
+
+        void civil_from_days(int64_t days, civil_time& result)
+        {
+            days += 719468;
+            int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+            int64_t day_of_era = days - era * 146097;
+            int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+            int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+            int64_t month_index = (5 * day_of_year + 2) / 153;
+            result.day = static_cast<int>(day_of_year - (153 * month_index + 2) / 5 + 1);
+            result.month = static_cast<int>(month_index < 10 ? month_index + 3 : month_index - 9);
+            result.year = year_of_era + era * 400 + (result.month <= 2 ? 1 : 0);
+        }
+
+        int days_in_month(int64_t year, int month)
+        {
+            static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+            bool leap_year = (year % 4 == 0) && ((year % 100 != 0) || (year % 400 == 0));
+            return (month == 2 && leap_year) ? 29 : days[month - 1];
+        }
+
+        bool parse_digits(const utility::char_t* text, size_t count, int& value)
+        {
+            value = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                unsigned int digit = static_cast<unsigned int>(text[i] - U('0'));
+                if (digit > 9)
+                {
+                    return false;
+                }
+
+                value = value * 10 + static_cast<int>(digit);
+            }
+
+            return true;
+        }
+
+        void format_digits(utility::char_t* target, size_t count, int64_t value)
+        {
+            for (size_t i = count; i > 0; --i)
+            {
+                target[i - 1] = static_cast<utility::char_t>(U('0') + value % 10);
+                value /= 10;
+            }
+        }
+
+        bool to_datetime(const civil_time& time, int64_t fraction, utility::datetime& result)
+        {
+            if (time.month < 1 || time.month > 12 || time.day < 1 || time.day > days_in_month(time.year, time.month) ||
+                time.hour > 23 || time.minute > 59 || time.second > 59)
+            {
+                return false;
+            }
+
+            int64_t days = days_from_civil(time.year, time.month, time.day) + days_from_1601_to_1970;
+            if (days < 0)
+            {
+                return false;
+            }
+
+            int64_t seconds = days * seconds_per_day + time.hour * 3600 + time.minute * 60 + time.second;
+            result = utility::datetime() + static_cast<utility::datetime::interval_type>(seconds * ticks_per_second + fraction);
+            return true;
+        }
+
+        // Returns the time of day and the days since 1970-01-01 of a datetime
+        int64_t split_datetime(const utility::datetime& value, civil_time& time)
+        {
+            int64_t seconds = static_cast<int64_t>(value.to_interval() / ticks_per_second);
+            int64_t days = seconds / seconds_per_day - days_from_1601_to_1970;
+            int64_t second_of_day = seconds % seconds_per_day;
+            civil_from_days(days, time);
+            time.hour = static_cast<int>(second_of_day / 3600);
+            time.minute = static_cast<int>(second_of_day / 60 % 60);
+            time.second = static_cast<int>(second_of_day % 60);
+            return days;
+        }
+
+        // Writes the 29 characters of an RFC 1123 date
+        void format_rfc1123(const utility::datetime& value, utility::char_t* target)
+        {
+            civil_time time;
+            int64_t days = split_datetime(value, time);
+
+            // 1970-01-01 was a Thursday
+            int64_t day_of_week = ((days % 7) + 11) % 7;
+            for (size_t i = 0; i < 3; ++i)
+            {
+                target[i] = static_cast<utility::char_t>(day_names[day_of_week * 3 + i]);
+                target[8 + i] = static_cast<utility::char_t>(month_names[(time.month - 1) * 3 + i]);
+            }
+
+            target[3] = U(',');
+            target[4] = U(' ');
+            format_digits(target + 5, 2, time.day);
+            target[7] = U(' ');
+            target[11] = U(' ');
+            format_digits(target + 12, 4, time.year);
+            target[16] = U(' ');
+            format_digits(target + 17, 2, time.hour);
+            target[19] = U(':');
+            format_digits(target + 20, 2, time.minute);
+            target[22] = U(':');
+            format_digits(target + 23, 2, time.second);
+            target[25] = U(' ');
+            target[26] = U('G');
+            target[27] = U('M');
+            target[28] = U('T');
+        }
+
+        WASTORAGE_THREAD_LOCAL int64_t cached_rfc1123_second = -1;
+        WASTORAGE_THREAD_LOCAL utility::char_t cached_rfc1123_text[rfc1123_length];
+    }
+
+    utility::datetime parse_rfc1123_datetime(const utility::string_t& value)
+    {
+        const utility::char_t* text = value.c_str();
+        civil_time time;
+        int day = 0;
+        int year = 0;
+        if (value.size() == rfc1123_length && text[3] == U(',') && text[4] == U(' ') && text[7] == U(' ') && text[11] == U(' ') && text[16] == U(' ') &&
+            text[19] == U(':') && text[22] == U(':') && text[25] == U(' ') && text[26] == U('G') && text[27] == U('M') && text[28] == U('T') &&
+            parse_digits(text + 5, 2, day) && parse_digits(text + 12, 4, year) && parse_digits(text + 17, 2, time.hour) &&
+            parse_digits(text + 20, 2, time.minute) && parse_digits(text + 23, 2, time.second))
+        {
+            time.year = year;
+            time.day = day;
+            time.month = 0;
+            for (int i = 0; i < 12; ++i)
+            {
+                if (text[8] == static_cast<utility::char_t>(month_names[i * 3]) && text[9] == static_cast<utility::char_t>(month_names[i * 3 + 1]) &&
+                    text[10] == static_cast<utility::char_t>(month_names[i * 3 + 2]))
+                {
+                    time.month = i + 1;
+                    break;
+                }
+            }
+
+            utility::datetime result;
+            if (to_datetime(time, 0, result))
+            {
+                return result;
+            }
+        }
+
+        // Dates in any other form, such as with a single digit day, are left to the general parser
+        return utility::datetime::from_string(value, utility::datetime::RFC_1123);
+    }
+
+    utility::string_t format_rfc1123_datetime(const utility::datetime& value)
+    {
+        utility::char_t text[rfc1123_length];
+        format_rfc1123(value, text);
+        return utility::string_t(text, rfc1123_length);
+    }
+
+    utility::datetime parse_iso8601_datetime(const utility::string_t& value)
+    {
+        const utility::char_t* text = value.c_str();
+        size_t length = value.size();
+        civil_time time;
+        int year = 0;
+        if (length < iso8601_seconds_length + 1 || text[4] != U('-') || text[7] != U('-') || text[10] != U('T') || text[13] != U(':') || text[16] != U(':') ||
+            !parse_digits(text, 4, year) || !parse_digits(text + 5, 2, time.month) || !parse_digits(text + 8, 2, time.day) ||
+            !parse_digits(text + 11, 2, time.hour) || !parse_digits(text + 14, 2, time.minute) || !parse_digits(text + 17, 2, time.second) ||
+            text[length - 1] != U('Z'))
+        {
+            return utility::datetime();
+        }
+
+        time.year = year;
+
+        // The fraction is kept to the seven digits a datetime can hold
+        int64_t fraction = 0;
+        size_t position = iso8601_seconds_length;
+        if (text[position] == U('.'))
+        {
+            size_t digits = 0;
+            for (++position; position < length - 1; ++position, ++digits)
+            {
+                unsigned int digit = static_cast<unsigned int>(text[position] - U('0'));
+                if (digit > 9)
+                {
+                    return utility::datetime();
+                }
+
+                if (digits < 7)
+                {
+                    fraction = fraction * 10 + digit;
+                }
+            }
+
+            if (digits == 0)
+            {
+                return utility::datetime();
+            }
+
+            for (; digits < 7; ++digits)
+            {
+                fraction *= 10;
+            }
+        }
+
+        if (position != length - 1)
+        {
+            return utility::datetime();
+        }
+
+        utility::datetime result;
+        return to_datetime(time, fraction, result) ? result : utility::datetime();
+    }
+
+    utility::string_t format_iso8601_datetime(const utility::datetime& value)
+    {
+        civil_time time;
+        split_datetime(value, time);
+
+        utility::char_t text[iso8601_seconds_length + 9];
+        format_digits(text, 4, time.year);
+        text[4] = U('-');
+        format_digits(text + 5, 2, time.month);
+        text[7] = U('-');
+        format_digits(text + 8, 2, time.day);
+        text[10] = U('T');
+        format_digits(text + 11, 2, time.hour);
+        text[13] = U(':');
+        format_digits(text + 14, 2, time.minute);
+        text[16] = U(':');
+        format_digits(text + 17, 2, time.second);
+
+        // The fraction is written with seven digits, without trailing zeros
+        size_t length = iso8601_seconds_length;
+        int64_t fraction = static_cast<int64_t>(value.to_interval() % ticks_per_second);
+        if (fraction > 0)
+        {
+            text[length] = U('.');
+            format_digits(text + length + 1, 7, fraction);
+            length += 8;
+            while (text[length - 1] == U('0'))
+            {
+                --length;
+            }
+        }
+
+        text[length++] = U('Z');
+        return utility::string_t(text, length);
+    }
+
+    utility::string_t current_rfc1123_datetime()
+    {
+        utility::datetime now = utility::datetime::utc_now();
+        int64_t second = static_cast<int64_t>(now.to_interval() / ticks_per_second);
+        if (second != cached_rfc1123_second)
+        {
+            format_rfc1123(now, cached_rfc1123_text);
+            cached_rfc1123_second = second;
+        }
+
+        return utility::string_t(cached_rfc1123_text, rfc1123_length);
+    }
+
+}}} // namespace wa::storage::core
@@ -18,6 +18,7 @@
 #include "stdafx.h"
 #include "was/table.h"
 #include "wascore/util.h"
+#include "wascore/transcode.h"
 
 namespace wa { namespace storage {
 
@@ -29,7 +30,12 @@ namespace wa { namespace storage {
             throw std::runtime_error("The type of the entity property is not date/time.");
         }
 
-        utility::datetime result = core::parse_datetime(m_value);
+        if (has_stored_value(edm_type::datetime))
+        {
+            return utility::datetime() + m_datetime;
+        }
+
+        utility::datetime result = core::parse_datetime(str());
         if (!result.is_initialized())
         {
             throw std::runtime_error("An error occurred parsing the date/time.");
@@ -38,34 +44,215 @@ namespace wa { namespace storage {
         return result;
     }
 
-    // TODO: Move this back to the .h file after switching to Casablanca's datetime parsing
-    void entity_property::set_value_impl(const utility::datetime& value)
+    void entity_property::format_value() const
     {
-        m_value = core::convert_to_string(value);
+        switch (m_stored_type)
+        {
+        case edm_type::binary:
+            m_value = utility::conversions::to_base64(m_binary);
+            break;
+
+        case edm_type::boolean:
+            m_value = m_boolean ? U("true") : U("false");
+            break;
+
+        case edm_type::datetime:
+            // TODO: Switch to Casablanca's datetime formatting
+            m_value = core::convert_to_string(utility::datetime() + m_datetime);
+            break;
+
+        case edm_type::double_floating_point:
+            if (core::is_nan(m_double))
+            {
+                m_value = protocol::double_not_a_number;
+            }
+            else if (m_double == std::numeric_limits<double>::infinity())
+            {
+                m_value = protocol::double_infinity;
+            }
+            else if (m_double == -std::numeric_limits<double>::infinity())
+            {
+                m_value = protocol::double_negative_infinity;
+            }
+            else
+            {
+                utility::ostringstream_t buffer;
+                // Two extra digits of precision are needed to ensure proper rounding
+                buffer.precision(std::numeric_limits<double>::digits10 + 2);
+                buffer << m_double;
+                m_value = buffer.str();
+            }
+            break;
+
+        case edm_type::guid:
+            {
+                utility::uuid value;
+                std::memcpy(&value, m_guid, sizeof(m_guid));
+                m_value = utility::uuid_to_string(value);
+            }
+            break;
+
+        case edm_type::int32:
+            {
+                utility::ostringstream_t buffer;
+                buffer << m_int32;
+                m_value = buffer.str();
+            }
+            break;
+
+        case edm_type::int64:
+            {
+                utility::ostringstream_t buffer;
+                buffer << m_int64;
+                m_value = buffer.str();
+            }
+            break;
+
+#ifdef _UTF16_STRINGS
+        case edm_type::string:
+            m_value = core::to_string_t(m_utf8_value);
+            break;
+#endif
+
+        default:
+            break;
+        }
+
+        m_value_formatted = true;
     }
 
-    void entity_property::set_value_impl(double value)
+    template<typename T>
+    static bool parse_number(const utility::string_t& value, T& result)
     {
-        if (core::is_nan(value))
+        utility::istringstream_t buffer(value);
+        buffer >> result;
+        return !buffer.fail() && buffer.eof();
+    }
+
+    void entity_property::parse_value()
+    {
+        // The text stays as the formatted value, so str() keeps returning exactly what was set.
+        // A value that does not parse as the new type is left as text and the accessor reports the error when it is read.
+        if (!m_value_formatted)
         {
-            m_value = protocol::double_not_a_number;
+            format_value();
         }
-        else if (value == std::numeric_limits<double>::infinity())
+
+        switch (m_property_type)
         {
-            m_value = protocol::double_infinity;
+        case edm_type::binary:
+            try
+            {
+                m_binary = utility::conversions::from_base64(m_value);
+            }
+            catch (const std::exception&)
+            {
+                return;
+            }
+            break;
+
+        case edm_type::boolean:
+            if (m_value.compare(U("false")) == 0)
+            {
+                m_boolean = false;
+            }
+            else if (m_value.compare(U("true")) == 0)
+            {
+                m_boolean = true;
+            }
+            else
+            {
+                return;
+            }
+            break;
+
+        case edm_type::datetime:
+            {
+                utility::datetime result = core::parse_datetime(m_value);
+                if (!result.is_initialized())
+                {
+                    return;
+                }
+
+                m_datetime = result.to_interval();
+            }
+            break;
+
+        case edm_type::double_floating_point:
+            if (m_value.compare(protocol::double_not_a_number) == 0)
+            {
+                m_double = std::numeric_limits<double>::quiet_NaN();
+            }
+            else if (m_value.compare(protocol::double_infinity) == 0)
+            {
+                m_double = std::numeric_limits<double>::infinity();
+            }
+            else if (m_value.compare(protocol::double_negative_infinity) == 0)
+            {
+                m_double = -std::numeric_limits<double>::infinity();
+            }
+            else if (!parse_number(m_value, m_double))
+            {
+                return;
+            }
+            break;
+
+        case edm_type::guid:
+            try
+            {
+                utility::uuid result = utility::string_to_uuid(m_value);
+                std::memcpy(m_guid, &result, sizeof(m_guid));
+            }
+            catch (const std::exception&)
+            {
+                return;
+            }
+            break;
+
+        case edm_type::int32:
+            if (!parse_number(m_value, m_int32))
+            {
+                return;
+            }
+            break;
+
+        case edm_type::int64:
+            if (!parse_number(m_value, m_int64))
+            {
+                return;
+            }
+            break;
+
+        default:
+            return;
         }
-        else if (value == -std::numeric_limits<double>::infinity())
+
+        m_stored_type = m_property_type;
+        m_has_stored_value = true;
+        m_value_formatted = true;
+    }
+
+    table_entity::properties_type table_entity::changed_properties() const
+    {
+        if (m_original_properties == nullptr)
         {
-            m_value = protocol::double_negative_infinity;
+            return m_properties;
         }
-        else
+
+        properties_type changes;
+        for (properties_type::const_iterator itr = m_properties.cbegin(); itr != m_properties.cend(); ++itr)
         {
-            utility::ostringstream_t buffer;
-            // Two extra digits of precision are needed to ensure proper rounding
-            buffer.precision(std::numeric_limits<double>::digits10 + 2);
-            buffer << value;
-            m_value = buffer.str();
+            properties_type::const_iterator original = m_original_properties->find(itr->first);
+            if (original == m_original_properties->cend() ||
+                original->second.property_type() != itr->second.property_type() ||
+                original->second.is_null() != itr->second.is_null() ||
+                (!itr->second.is_null() && original->second.str() != itr->second.str()))
+            {
+                changes.insert(*itr);
+            }
         }
+
+        return changes;
     }
 
 }} // namespace wa::storage
@@ -0,0 +1,105 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="existence_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/existence_cache.h"
+
+namespace wa { namespace storage { namespace core {
+
+    std::chrono::seconds existence_cache::time_to_live() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_time_to_live;
+    }
+
+    void existence_cache::set_time_to_live(std::chrono::seconds value)
+    {
+        if (value.count() < 0)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_time_to_live = value;
+        if (value.count() == 0)
+        {
+            m_expiry_times.clear();
+        }
+    }
+
+    bool existence_cache::contains(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_expiry_times.find(key);
+        if (iter == m_expiry_times.end())
+        {
+            return false;
+        }
+
+        if (iter->second <= std::chrono::steady_clock::now())
+        {
+            m_expiry_times.erase(iter);
+            return false;
+        }
+
+        return true;
+    }
+
+    void existence_cache::add(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_time_to_live.count() > 0)
+        {
+            m_expiry_times[key] = std::chrono::steady_clock::now() + m_time_to_live;
+        }
+    }
+
+    void existence_cache::remove(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_expiry_times.erase(key);
+    }
+
+    void existence_cache::remove_containing(const utility::string_t& request_uri)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_expiry_times.empty())
+        {
+            return;
+        }
+
+        // A resource is a prefix of the URI that ends where a path segment or a table key starts, such as
+        // the container of a blob, the queue of its messages or the table of an entity
+        utility::string_t::size_type end = request_uri.find(U('?'));
+        if (end == utility::string_t::npos)
+        {
+            end = request_uri.size();
+        }
+
+        utility::string_t::size_type start = request_uri.find(U("://"));
+        start = start == utility::string_t::npos ? 0 : start + 3;
+        for (utility::string_t::size_type i = start; i <= end; ++i)
+        {
+            if (i == end || request_uri[i] == U('/') || request_uri[i] == U('('))
+            {
+                m_expiry_times.erase(request_uri.substr(0, i));
+            }
+        }
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,496 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="gzip_decoder.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <algorithm>
+
+#include "wascore/gzip_decoder.h"
+#include "wascore/resources.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        // Number of compressed bytes requested from the source each time the input runs out
+        const size_t gzip_read_chunk_size = 16 * 1024;
+
+        const size_t gzip_window_size = 32 * 1024;
+
+        const uint8_t gzip_flag_header_crc = 0x02;
+        const uint8_t gzip_flag_extra = 0x04;
+        const uint8_t gzip_flag_name = 0x08;
+        const uint8_t gzip_flag_comment = 0x10;
+        const uint8_t gzip_flags_reserved = 0xE0;
+
+        const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        const uint8_t length_extra_bits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        const uint8_t distance_extra_bits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        // The order in which the lengths of the code length code are stored
+        const uint8_t code_length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        struct crc32_table
+        {
+            crc32_table()
+            {
+                for (uint32_t b = 0; b < 256; ++b)
+                {
+                    uint32_t crc = b;
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320U) : (crc >> 1);
+                    }
+
+                    table[b] = crc;
+                }
+            }
+
+            uint32_t table[256];
+        };
+
+        // Built during static initialization, so that no thread can observe a partially built table
+        const crc32_table crc32_lookup;
+    }
+
+    gzip_decoder::gzip_decoder(std::function<size_t (uint8_t*, size_t)> source)
+        : m_source(std::move(source)), m_input(gzip_read_chunk_size), m_input_position(0), m_input_size(0), m_source_done(false),
+        m_bit_buffer(0), m_bit_count(0), m_state(state_member_header), m_last_block(false), m_stored_remaining(0), m_copy_length(0), m_copy_distance(0),
+        m_window(gzip_window_size), m_window_position(0), m_window_filled(0), m_member_crc(0), m_member_size(0)
+    {
+    }
+
+    size_t gzip_decoder::read(uint8_t* buffer, size_t count)
+    {
+        size_t written = 0;
+        while (written < count && m_state != state_done)
+        {
+            switch (m_state)
+            {
+            case state_member_header:
+                m_state = read_member_header() ? state_block_header : state_done;
+                break;
+
+            case state_block_header:
+                read_block_header();
+                break;
+
+            case state_stored_block:
+                if (m_stored_remaining == 0)
+                {
+                    end_block();
+                    break;
+                }
+
+                emit(read_byte(), buffer, written);
+                --m_stored_remaining;
+                break;
+
+            case state_compressed_block:
+                if (m_copy_length > 0)
+                {
+                    emit(m_window[(m_window_position - m_copy_distance) & (gzip_window_size - 1)], buffer, written);
+                    --m_copy_length;
+                    break;
+                }
+
+                {
+                    int symbol = decode_symbol(m_literal_code);
+                    if (symbol < 256)
+                    {
+                        emit(static_cast<uint8_t>(symbol), buffer, written);
+                    }
+                    else if (symbol == 256)
+                    {
+                        end_block();
+                    }
+                    else
+                    {
+                        symbol -= 257;
+                        if (symbol >= 29)
+                        {
+                            fail();
+                        }
+
+                        m_copy_length = length_base[symbol] + read_bits(length_extra_bits[symbol]);
+
+                        int distance_symbol = decode_symbol(m_distance_code);
+                        if (distance_symbol >= 30)
+                        {
+                            fail();
+                        }
+
+                        m_copy_distance = distance_base[distance_symbol] + read_bits(distance_extra_bits[distance_symbol]);
+                        if (m_copy_distance > m_window_filled)
+                        {
+                            fail();
+                        }
+                    }
+                }
+                break;
+
+            case state_member_trailer:
+                read_member_trailer();
+                m_state = state_member_header;
+                break;
+
+            case state_done:
+                break;
+            }
+        }
+
+        return written;
+    }
+
+    bool gzip_decoder::read_member_header()
+    {
+        // The content ends cleanly only between members
+        uint8_t id1;
+        if (!try_read_byte(id1))
+        {
+            return false;
+        }
+
+        uint8_t id2 = read_byte();
+        uint8_t method = read_byte();
+        uint8_t flags = read_byte();
+        if (id1 != 0x1F || id2 != 0x8B || method != 8 || (flags & gzip_flags_reserved) != 0)
+        {
+            fail();
+        }
+
+        // Modification time, extra flags and operating system
+        for (int i = 0; i < 6; ++i)
+        {
+            read_byte();
+        }
+
+        if (flags & gzip_flag_extra)
+        {
+            size_t length = read_byte();
+            length |= static_cast<size_t>(read_byte()) << 8;
+            for (size_t i = 0; i < length; ++i)
+            {
+                read_byte();
+            }
+        }
+
+        if (flags & gzip_flag_name)
+        {
+            while (read_byte() != 0)
+            {
+            }
+        }
+
+        if (flags & gzip_flag_comment)
+        {
+            while (read_byte() != 0)
+            {
+            }
+        }
+
+        if (flags & gzip_flag_header_crc)
+        {
+            read_byte();
+            read_byte();
+        }
+
+        m_bit_buffer = 0;
+        m_bit_count = 0;
+        m_last_block = false;
+        m_window_filled = 0;
+        m_member_crc = 0xFFFFFFFFU;
+        m_member_size = 0;
+        return true;
+    }
+
+    void gzip_decoder::read_block_header()
+    {
+        m_last_block = read_bits(1) != 0;
+        switch (read_bits(2))
+        {
+        case 0:
+            {
+                // A stored block starts at a byte boundary
+                m_bit_buffer = 0;
+                m_bit_count = 0;
+
+                uint16_t length = read_byte();
+                length |= static_cast<uint16_t>(read_byte()) << 8;
+                uint16_t complement = read_byte();
+                complement |= static_cast<uint16_t>(read_byte()) << 8;
+                if (length != static_cast<uint16_t>(~complement))
+                {
+                    fail();
+                }
+
+                m_stored_remaining = length;
+                m_state = state_stored_block;
+            }
+            break;
+
+        case 1:
+            {
+                uint8_t lengths[288 + 30];
+                std::fill(lengths, lengths + 144, static_cast<uint8_t>(8));
+                std::fill(lengths + 144, lengths + 256, static_cast<uint8_t>(9));
+                std::fill(lengths + 256, lengths + 280, static_cast<uint8_t>(7));
+                std::fill(lengths + 280, lengths + 288, static_cast<uint8_t>(8));
+                std::fill(lengths + 288, lengths + 288 + 30, static_cast<uint8_t>(5));
+                build_code(m_literal_code, lengths, 288);
+                build_code(m_distance_code, lengths + 288, 30);
+                m_state = state_compressed_block;
+            }
+            break;
+
+        case 2:
+            read_dynamic_codes();
+            m_state = state_compressed_block;
+            break;
+
+        default:
+            fail();
+        }
+    }
+
+    void gzip_decoder::read_dynamic_codes()
+    {
+        size_t literal_count = read_bits(5) + 257;
+        size_t distance_count = read_bits(5) + 1;
+        size_t code_length_count = read_bits(4) + 4;
+        if (literal_count > 286 || distance_count > 30)
+        {
+            fail();
+        }
+
+        uint8_t lengths[286 + 30];
+        std::fill(lengths, lengths + 19, static_cast<uint8_t>(0));
+        for (size_t i = 0; i < code_length_count; ++i)
+        {
+            lengths[code_length_order[i]] = static_cast<uint8_t>(read_bits(3));
+        }
+
+        huffman_code code_length_code;
+        build_code(code_length_code, lengths, 19);
+
+        size_t total = literal_count + distance_count;
+        size_t index = 0;
+        while (index < total)
+        {
+            int symbol = decode_symbol(code_length_code);
+            if (symbol < 16)
+            {
+                lengths[index++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t value = 0;
+            size_t repeat;
+            if (symbol == 16)
+            {
+                if (index == 0)
+                {
+                    fail();
+                }
+
+                value = lengths[index - 1];
+                repeat = 3 + read_bits(2);
+            }
+            else if (symbol == 17)
+            {
+                repeat = 3 + read_bits(3);
+            }
+            else
+            {
+                repeat = 11 + read_bits(7);
+            }
+
+            if (index + repeat > total)
+            {
+                fail();
+            }
+
+            std::fill(lengths + index, lengths + index + repeat, value);
+            index += repeat;
+        }
+
+        // A block without an end-of-block code could never end
+        if (lengths[256] == 0)
+        {
+            fail();
+        }
+
+        build_code(m_literal_code, lengths, literal_count);
+        build_code(m_distance_code, lengths + literal_count, distance_count);
+    }
+
+    void gzip_decoder::read_member_trailer()
+    {
+        // The trailer starts at a byte boundary
+        m_bit_buffer = 0;
+        m_bit_count = 0;
+
+        uint32_t crc = 0;
+        uint32_t size = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            crc |= static_cast<uint32_t>(read_byte()) << (8 * i);
+        }
+
+        for (int i = 0; i < 4; ++i)
+        {
+            size |= static_cast<uint32_t>(read_byte()) << (8 * i);
+        }
+
+        if (crc != ~m_member_crc || size != m_member_size)
+        {
+            fail();
+        }
+    }
+
+    void gzip_decoder::end_block()
+    {
+        m_state = m_last_block ? state_member_trailer : state_block_header;
+    }
+
+    bool gzip_decoder::try_read_byte(uint8_t& value)
+    {
+        while (m_input_position == m_input_size)
+        {
+            if (m_source_done)
+            {
+                return false;
+            }
+
+            m_input_position = 0;
+            m_input_size = m_source(m_input.data(), m_input.size());
+            if (m_input_size == 0)
+            {
+                m_source_done = true;
+            }
+        }
+
+        value = m_input[m_input_position++];
+        return true;
+    }
+
+    uint8_t gzip_decoder::read_byte()
+    {
+        uint8_t value = 0;
+        if (!try_read_byte(value))
+        {
+            fail();
+        }
+
+        return value;
+    }
+
+    uint32_t gzip_decoder::read_bits(int count)
+    {
+        while (m_bit_count < count)
+        {
+            m_bit_buffer |= static_cast<uint32_t>(read_byte()) << m_bit_count;
+            m_bit_count += 8;
+        }
+
+        uint32_t value = m_bit_buffer & ((1U << count) - 1);
+        m_bit_buffer >>= count;
+        m_bit_count -= count;
+        return value;
+    }
+
+    int gzip_decoder::decode_symbol(const huffman_code& code)
+    {
+        // Codes are read one bit at a time, most significant bit first, and compared against the first code of each length
+        int value = 0;
+        int first = 0;
+        int index = 0;
+        for (int length = 1; length < 16; ++length)
+        {
+            value |= static_cast<int>(read_bits(1));
+            int count = code.counts[length];
+            if (value - first < count)
+            {
+                return code.symbols[index + (value - first)];
+            }
+
+            index += count;
+            first = (first + count) << 1;
+            value <<= 1;
+        }
+
+        fail();
+        return -1;
+    }
+
+    void gzip_decoder::emit(uint8_t value, uint8_t* buffer, size_t& written)
+    {
+        buffer[written++] = value;
+        m_window[m_window_position] = value;
+        m_window_position = (m_window_position + 1) & (gzip_window_size - 1);
+        if (m_window_filled < gzip_window_size)
+        {
+            ++m_window_filled;
+        }
+
+        m_member_crc = crc32_lookup.table[(m_member_crc ^ value) & 0xFF] ^ (m_member_crc >> 8);
+        ++m_member_size;
+    }
+
+    void gzip_decoder::build_code(huffman_code& code, const uint8_t* lengths, size_t count)
+    {
+        std::fill(code.counts, code.counts + 16, static_cast<uint16_t>(0));
+        for (size_t i = 0; i < count; ++i)
+        {
+            ++code.counts[lengths[i]];
+        }
+
+        // More codes of a length than the shorter ones leave room for cannot be decoded
+        int left = 1;
+        for (int length = 1; length < 16; ++length)
+        {
+            left = (left << 1) - code.counts[length];
+            if (left < 0)
+            {
+                fail();
+            }
+        }
+
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int length = 1; length < 15; ++length)
+        {
+            offsets[length + 1] = offsets[length] + code.counts[length];
+        }
+
+        code.symbols.assign(count, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (lengths[i] != 0)
+            {
+                code.symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+            }
+        }
+    }
+
+    void gzip_decoder::fail()
+    {
+        throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_gzip_stream));
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,76 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="hash_linux.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/hash_linux.h"
+
+#ifndef WIN32
+
+namespace wa { namespace storage { namespace core {
+
+    basic_hash_hmac_sha256_streambuf::basic_hash_hmac_sha256_streambuf(const std::vector<unsigned char>& key)
+        : m_hash_object(key)
+    {
+    }
+
+    pplx::task<void> basic_hash_hmac_sha256_streambuf::_close_write()
+    {
+        m_hash = m_hash_object.finalize();
+        return basic_hash_streambuf::_close_write();
+    }
+
+    pplx::task<basic_hash_hmac_sha256_streambuf::int_type> basic_hash_hmac_sha256_streambuf::_putc(basic_hash_hmac_sha256_streambuf::char_type ch)
+    {
+        return putn(&ch, 1).then([ch] (size_t count) -> basic_hash_hmac_sha256_streambuf::int_type
+        {
+            return count ? (basic_hash_hmac_sha256_streambuf::int_type)ch : traits::eof();
+        });
+    }
+
+    pplx::task<size_t> basic_hash_hmac_sha256_streambuf::_putn(const basic_hash_hmac_sha256_streambuf::char_type* ptr, size_t count)
+    {
+        m_hash_object.update(ptr, count);
+        return pplx::task_from_result(count);
+    }
+
+    basic_hash_md5_streambuf::basic_hash_md5_streambuf()
+    {
+    }
+
+    pplx::task<void> basic_hash_md5_streambuf::_close_write()
+    {
+        m_hash = m_hash_object.finalize();
+        return basic_hash_streambuf::_close_write();
+    }
+
+    pplx::task<basic_hash_md5_streambuf::int_type> basic_hash_md5_streambuf::_putc(basic_hash_md5_streambuf::char_type ch)
+    {
+        return putn(&ch, 1).then([ch] (size_t count) -> basic_hash_md5_streambuf::int_type
+        {
+            return count ? (basic_hash_md5_streambuf::int_type)ch : traits::eof();
+        });
+    }
+
+    pplx::task<size_t> basic_hash_md5_streambuf::_putn(const basic_hash_md5_streambuf::char_type* ptr, size_t count)
+    {
+        m_hash_object.update(ptr, count);
+        return pplx::task_from_result(count);
+    }
+
+}}} // namespace wa::storage::core
+
+#endif // !WIN32
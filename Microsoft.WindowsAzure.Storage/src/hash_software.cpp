@@ -0,0 +1,558 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="hash_software.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/hash_software.h"
+
+#include <cstring>
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        inline uint32_t rotate_left(uint32_t value, int bits)
+        {
+            return (value << bits) | (value >> (32 - bits));
+        }
+
+        inline uint32_t rotate_right(uint32_t value, int bits)
+        {
+            return (value >> bits) | (value << (32 - bits));
+        }
+
+        inline uint32_t load_little_endian(const uint8_t* data)
+        {
+            return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+        }
+
+        inline uint32_t load_big_endian(const uint8_t* data)
+        {
+            return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+        }
+
+        inline void store_little_endian(uint8_t* data, uint32_t value)
+        {
+            data[0] = static_cast<uint8_t>(value);
+            data[1] = static_cast<uint8_t>(value >> 8);
+            data[2] = static_cast<uint8_t>(value >> 16);
+            data[3] = static_cast<uint8_t>(value >> 24);
+        }
+
+        inline void store_big_endian(uint8_t* data, uint32_t value)
+        {
+            data[0] = static_cast<uint8_t>(value >> 24);
+            data[1] = static_cast<uint8_t>(value >> 16);
+            data[2] = static_cast<uint8_t>(value >> 8);
+            data[3] = static_cast<uint8_t>(value);
+        }
+
+        // Buffers partial blocks and passes whole blocks straight from the input to the transform,
+        // so that large writes are hashed without being copied
+        template<typename Transform>
+        void update_blocks(uint8_t* buffer, size_t& buffered, uint64_t& length, const uint8_t* data, size_t count, Transform transform)
+        {
+            length += count;
+
+            if (buffered > 0)
+            {
+                size_t fill = std::min(count, static_cast<size_t>(64) - buffered);
+                std::memcpy(buffer + buffered, data, fill);
+                buffered += fill;
+                data += fill;
+                count -= fill;
+
+                if (buffered < 64)
+                {
+                    return;
+                }
+
+                transform(buffer, 1);
+                buffered = 0;
+            }
+
+            if (count >= 64)
+            {
+                transform(data, count / 64);
+                data += count & ~static_cast<size_t>(63);
+                count &= 63;
+            }
+
+            if (count > 0)
+            {
+                std::memcpy(buffer, data, count);
+                buffered = count;
+            }
+        }
+    }
+
+#pragma region MD5
+
+#define WASTORAGE_MD5_STEP(f, a, b, c, d, x, t, s) \
+    a += f(b, c, d) + x + t; \
+    a = rotate_left(a, s) + b;
+
+#define WASTORAGE_MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define WASTORAGE_MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define WASTORAGE_MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define WASTORAGE_MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+    md5_hash::md5_hash()
+        : m_length(0), m_buffered(0)
+    {
+        m_state[0] = 0x67452301;
+        m_state[1] = 0xefcdab89;
+        m_state[2] = 0x98badcfe;
+        m_state[3] = 0x10325476;
+    }
+
+    void md5_hash::update(const uint8_t* data, size_t count)
+    {
+        update_blocks(m_buffer, m_buffered, m_length, data, count, [this] (const uint8_t* blocks, size_t block_count)
+        {
+            transform(blocks, block_count);
+        });
+    }
+
+    std::vector<unsigned char> md5_hash::finalize()
+    {
+        uint64_t bit_length = m_length * 8;
+
+        uint8_t padding[72] = { 0x80 };
+        size_t padding_length = (m_buffered < 56) ? (56 - m_buffered) : (120 - m_buffered);
+        for (int i = 0; i < 8; ++i)
+        {
+            padding[padding_length + i] = static_cast<uint8_t>(bit_length >> (8 * i));
+        }
+
+        update(padding, padding_length + 8);
+
+        std::vector<unsigned char> digest(16);
+        for (int i = 0; i < 4; ++i)
+        {
+            store_little_endian(digest.data() + 4 * i, m_state[i]);
+        }
+
+        return digest;
+    }
+
+    std::vector<uint8_t> md5_hash::save_state() const
+    {
+        // The four state words and the length are stored in little-endian order, followed by the buffered bytes
+        std::vector<uint8_t> state(24 + m_buffered);
+        for (int i = 0; i < 4; ++i)
+        {
+            store_little_endian(state.data() + 4 * i, m_state[i]);
+        }
+
+        store_little_endian(state.data() + 16, static_cast<uint32_t>(m_length));
+        store_little_endian(state.data() + 20, static_cast<uint32_t>(m_length >> 32));
+        std::memcpy(state.data() + 24, m_buffer, m_buffered);
+        return state;
+    }
+
+    bool md5_hash::load_state(const std::vector<uint8_t>& state)
+    {
+        if ((state.size() < 24) || (state.size() >= 24 + 64))
+        {
+            return false;
+        }
+
+        uint64_t length = static_cast<uint64_t>(load_little_endian(state.data() + 16)) | (static_cast<uint64_t>(load_little_endian(state.data() + 20)) << 32);
+        size_t buffered = state.size() - 24;
+        if ((length % 64) != buffered)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 4; ++i)
+        {
+            m_state[i] = load_little_endian(state.data() + 4 * i);
+        }
+
+        m_length = length;
+        m_buffered = buffered;
+        std::memcpy(m_buffer, state.data() + 24, buffered);
+        return true;
+    }
+
+    void md5_hash::transform(const uint8_t* data, size_t blocks)
+    {
+        uint32_t a = m_state[0];
+        uint32_t b = m_state[1];
+        uint32_t c = m_state[2];
+        uint32_t d = m_state[3];
+
+        for (; blocks > 0; --blocks, data += 64)
+        {
+            uint32_t x[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                x[i] = load_little_endian(data + 4 * i);
+            }
+
+            uint32_t saved_a = a;
+            uint32_t saved_b = b;
+            uint32_t saved_c = c;
+            uint32_t saved_d = d;
+
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, a, b, c, d, x[0], 0xd76aa478, 7)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, d, a, b, c, x[1], 0xe8c7b756, 12)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, c, d, a, b, x[2], 0x242070db, 17)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, b, c, d, a, x[3], 0xc1bdceee, 22)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, a, b, c, d, x[4], 0xf57c0faf, 7)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, d, a, b, c, x[5], 0x4787c62a, 12)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, c, d, a, b, x[6], 0xa8304613, 17)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, b, c, d, a, x[7], 0xfd469501, 22)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, a, b, c, d, x[8], 0x698098d8, 7)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, d, a, b, c, x[9], 0x8b44f7af, 12)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, c, d, a, b, x[10], 0xffff5bb1, 17)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, b, c, d, a, x[11], 0x895cd7be, 22)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, a, b, c, d, x[12], 0x6b901122, 7)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, d, a, b, c, x[13], 0xfd987193, 12)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, c, d, a, b, x[14], 0xa679438e, 17)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_F, b, c, d, a, x[15], 0x49b40821, 22)
+
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, a, b, c, d, x[1], 0xf61e2562, 5)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, d, a, b, c, x[6], 0xc040b340, 9)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, c, d, a, b, x[11], 0x265e5a51, 14)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, b, c, d, a, x[0], 0xe9b6c7aa, 20)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, a, b, c, d, x[5], 0xd62f105d, 5)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, d, a, b, c, x[10], 0x02441453, 9)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, c, d, a, b, x[15], 0xd8a1e681, 14)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, b, c, d, a, x[4], 0xe7d3fbc8, 20)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, a, b, c, d, x[9], 0x21e1cde6, 5)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, d, a, b, c, x[14], 0xc33707d6, 9)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, c, d, a, b, x[3], 0xf4d50d87, 14)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, b, c, d, a, x[8], 0x455a14ed, 20)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, a, b, c, d, x[13], 0xa9e3e905, 5)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, d, a, b, c, x[2], 0xfcefa3f8, 9)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, c, d, a, b, x[7], 0x676f02d9, 14)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_G, b, c, d, a, x[12], 0x8d2a4c8a, 20)
+
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, a, b, c, d, x[5], 0xfffa3942, 4)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, d, a, b, c, x[8], 0x8771f681, 11)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, c, d, a, b, x[11], 0x6d9d6122, 16)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, b, c, d, a, x[14], 0xfde5380c, 23)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, a, b, c, d, x[1], 0xa4beea44, 4)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, d, a, b, c, x[4], 0x4bdecfa9, 11)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, c, d, a, b, x[7], 0xf6bb4b60, 16)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, b, c, d, a, x[10], 0xbebfbc70, 23)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, a, b, c, d, x[13], 0x289b7ec6, 4)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, d, a, b, c, x[0], 0xeaa127fa, 11)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, c, d, a, b, x[3], 0xd4ef3085, 16)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, b, c, d, a, x[6], 0x04881d05, 23)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, a, b, c, d, x[9], 0xd9d4d039, 4)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, d, a, b, c, x[12], 0xe6db99e5, 11)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, c, d, a, b, x[15], 0x1fa27cf8, 16)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_H, b, c, d, a, x[2], 0xc4ac5665, 23)
+
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, a, b, c, d, x[0], 0xf4292244, 6)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, d, a, b, c, x[7], 0x432aff97, 10)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, c, d, a, b, x[14], 0xab9423a7, 15)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, b, c, d, a, x[5], 0xfc93a039, 21)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, a, b, c, d, x[12], 0x655b59c3, 6)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, d, a, b, c, x[3], 0x8f0ccc92, 10)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, c, d, a, b, x[10], 0xffeff47d, 15)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, b, c, d, a, x[1], 0x85845dd1, 21)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, a, b, c, d, x[8], 0x6fa87e4f, 6)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, d, a, b, c, x[15], 0xfe2ce6e0, 10)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, c, d, a, b, x[6], 0xa3014314, 15)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, b, c, d, a, x[13], 0x4e0811a1, 21)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, a, b, c, d, x[4], 0xf7537e82, 6)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, d, a, b, c, x[11], 0xbd3af235, 10)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, c, d, a, b, x[2], 0x2ad7d2bb, 15)
+            WASTORAGE_MD5_STEP(WASTORAGE_MD5_I, b, c, d, a, x[9], 0xeb86d391, 21)
+
+            a += saved_a;
+            b += saved_b;
+            c += saved_c;
+            d += saved_d;
+        }
+
+        m_state[0] = a;
+        m_state[1] = b;
+        m_state[2] = c;
+        m_state[3] = d;
+    }
+
+#undef WASTORAGE_MD5_STEP
+#undef WASTORAGE_MD5_F
+#undef WASTORAGE_MD5_G
+#undef WASTORAGE_MD5_H
+#undef WASTORAGE_MD5_I
+
+#pragma endregion
+
+#pragma region SHA-256
+
+    namespace
+    {
+        const uint32_t sha256_round_constants[64] =
+        {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+    }
+
+    sha256_hash::sha256_hash()
+        : m_length(0), m_buffered(0)
+    {
+        m_state[0] = 0x6a09e667;
+        m_state[1] = 0xbb67ae85;
+        m_state[2] = 0x3c6ef372;
+        m_state[3] = 0xa54ff53a;
+        m_state[4] = 0x510e527f;
+        m_state[5] = 0x9b05688c;
+        m_state[6] = 0x1f83d9ab;
+        m_state[7] = 0x5be0cd19;
+    }
+
+    void sha256_hash::update(const uint8_t* data, size_t count)
+    {
+        update_blocks(m_buffer, m_buffered, m_length, data, count, [this] (const uint8_t* blocks, size_t block_count)
+        {
+            transform(blocks, block_count);
+        });
+    }
+
+    std::vector<unsigned char> sha256_hash::finalize()
+    {
+        std::vector<unsigned char> digest(digest_size);
+        finalize(digest.data());
+        return digest;
+    }
+
+    void sha256_hash::finalize(uint8_t* digest)
+    {
+        uint64_t bit_length = m_length * 8;
+
+        uint8_t padding[72] = { 0x80 };
+        size_t padding_length = (m_buffered < 56) ? (56 - m_buffered) : (120 - m_buffered);
+        for (int i = 0; i < 8; ++i)
+        {
+            padding[padding_length + i] = static_cast<uint8_t>(bit_length >> (56 - 8 * i));
+        }
+
+        update(padding, padding_length + 8);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            store_big_endian(digest + 4 * i, m_state[i]);
+        }
+    }
+
+    void sha256_hash::transform(const uint8_t* data, size_t blocks)
+    {
+        for (; blocks > 0; --blocks, data += 64)
+        {
+            uint32_t w[64];
+            for (int i = 0; i < 16; ++i)
+            {
+                w[i] = load_big_endian(data + 4 * i);
+            }
+
+            for (int i = 16; i < 64; ++i)
+            {
+                uint32_t s0 = rotate_right(w[i - 15], 7) ^ rotate_right(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotate_right(w[i - 2], 17) ^ rotate_right(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = m_state[0];
+            uint32_t b = m_state[1];
+            uint32_t c = m_state[2];
+            uint32_t d = m_state[3];
+            uint32_t e = m_state[4];
+            uint32_t f = m_state[5];
+            uint32_t g = m_state[6];
+            uint32_t h = m_state[7];
+
+            for (int i = 0; i < 64; ++i)
+            {
+                uint32_t s1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+                uint32_t choice = (e & f) ^ (~e & g);
+                uint32_t temp1 = h + s1 + choice + sha256_round_constants[i] + w[i];
+                uint32_t s0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+                uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+                uint32_t temp2 = s0 + majority;
+
+                h = g;
+                g = f;
+                f = e;
+                e = d + temp1;
+                d = c;
+                c = b;
+                b = a;
+                a = temp1 + temp2;
+            }
+
+            m_state[0] += a;
+            m_state[1] += b;
+            m_state[2] += c;
+            m_state[3] += d;
+            m_state[4] += e;
+            m_state[5] += f;
+            m_state[6] += g;
+            m_state[7] += h;
+        }
+    }
+
+#pragma endregion
+
+#pragma region HMAC-SHA256
+
+    hmac_sha256_hash::hmac_sha256_hash(const std::vector<unsigned char>& key)
+    {
+        uint8_t block_key[64] = { 0 };
+        if (key.size() > sizeof(block_key))
+        {
+            sha256_hash key_hash;
+            key_hash.update(key.data(), key.size());
+            key_hash.finalize(block_key);
+        }
+        else
+        {
+            std::copy(key.begin(), key.end(), block_key);
+        }
+
+        // Both pads are absorbed up front, so that a copy of this object can start hashing a message right away
+        uint8_t inner_key[64];
+        uint8_t outer_key[64];
+        for (size_t i = 0; i < sizeof(block_key); ++i)
+        {
+            inner_key[i] = block_key[i] ^ 0x36;
+            outer_key[i] = block_key[i] ^ 0x5c;
+        }
+
+        m_inner.update(inner_key, sizeof(inner_key));
+        m_outer.update(outer_key, sizeof(outer_key));
+    }
+
+    void hmac_sha256_hash::update(const uint8_t* data, size_t count)
+    {
+        m_inner.update(data, count);
+    }
+
+    std::vector<unsigned char> hmac_sha256_hash::finalize()
+    {
+        std::vector<unsigned char> digest(digest_size);
+        finalize(digest.data());
+        return digest;
+    }
+
+    void hmac_sha256_hash::finalize(uint8_t* digest)
+    {
+        uint8_t inner_digest[sha256_hash::digest_size];
+        m_inner.finalize(inner_digest);
+
+        m_outer.update(inner_digest, sizeof(inner_digest));
+        m_outer.finalize(digest);
+    }
+
+#pragma endregion
+
+#pragma region CRC64
+
+    namespace
+    {
+        const uint64_t crc64_polynomial = 0x9A6C9329AC4BC9B5ULL;
+
+        // Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes
+        struct crc64_tables
+        {
+            crc64_tables()
+            {
+                for (int b = 0; b < 256; ++b)
+                {
+                    uint64_t crc = static_cast<uint64_t>(b);
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        crc = (crc & 1) ? ((crc >> 1) ^ crc64_polynomial) : (crc >> 1);
+                    }
+
+                    table[0][b] = crc;
+                }
+
+                for (int b = 0; b < 256; ++b)
+                {
+                    for (int k = 1; k < 8; ++k)
+                    {
+                        table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+                    }
+                }
+            }
+
+            uint64_t table[8][256];
+        };
+
+        // Built during static initialization, so that no thread can observe a partially built table
+        const crc64_tables crc64_lookup;
+    }
+
+    crc64_hash::crc64_hash()
+        : m_crc(~0ULL)
+    {
+    }
+
+    void crc64_hash::update(const uint8_t* data, size_t count)
+    {
+        const auto& table = crc64_lookup.table;
+        auto crc = m_crc;
+
+        while (count >= 8)
+        {
+            crc ^= static_cast<uint64_t>(load_little_endian(data)) | (static_cast<uint64_t>(load_little_endian(data + 4)) << 32);
+            crc = table[7][crc & 0xff] ^
+                table[6][(crc >> 8) & 0xff] ^
+                table[5][(crc >> 16) & 0xff] ^
+                table[4][(crc >> 24) & 0xff] ^
+                table[3][(crc >> 32) & 0xff] ^
+                table[2][(crc >> 40) & 0xff] ^
+                table[1][(crc >> 48) & 0xff] ^
+                table[0][crc >> 56];
+            data += 8;
+            count -= 8;
+        }
+
+        while (count > 0)
+        {
+            crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xff];
+            ++data;
+            --count;
+        }
+
+        m_crc = crc;
+    }
+
+    std::vector<unsigned char> crc64_hash::finalize()
+    {
+        auto crc = ~m_crc;
+        std::vector<unsigned char> result(8);
+        store_little_endian(result.data(), static_cast<uint32_t>(crc));
+        store_little_endian(result.data() + 4, static_cast<uint32_t>(crc >> 32));
+        return result;
+    }
+
+#pragma endregion
+
+}}} // namespace wa::storage::core
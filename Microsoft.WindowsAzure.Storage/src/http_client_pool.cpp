@@ -0,0 +1,347 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="http_client_pool.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/http_client_pool.h"
+
+namespace wa { namespace storage { namespace core {
+
+    web::http::client::http_client_config http_client_pool::client_config()
+    {
+        // The configuration is shared by all requests sent through the pool, so the
+        // operation expiry time is enforced by racing each attempt against a timer instead
+        web::http::client::http_client_config config;
+        config.set_timeout(std::chrono::seconds());
+        return config;
+    }
+
+    pplx::task<http_client_pool::lease> http_client_pool::acquire_async(const web::http::uri& authority, const web::http::client::http_client_config& config)
+    {
+        utility::string_t host = authority.to_string();
+        utility::string_t key = get_key(host, config);
+
+        std::shared_ptr<async_semaphore> host_semaphore;
+        int generation = 0;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto limit = get_host_limit(host);
+            if (limit)
+            {
+                host_semaphore = limit->semaphore;
+                generation = limit->generation;
+            }
+        }
+
+        auto lock_task = host_semaphore ? host_semaphore->lock_async() : pplx::task_from_result();
+        auto instance = shared_from_this();
+        return lock_task.then([instance, authority, config, key, host, host_semaphore, generation] () -> http_client_pool::lease
+        {
+            std::shared_ptr<web::http::client::http_client> client;
+            {
+                std::lock_guard<std::mutex> guard(instance->m_mutex);
+                client = instance->get_idle_client(key);
+            }
+
+            if (!client)
+            {
+                client = std::make_shared<web::http::client::http_client>(authority, config);
+            }
+
+            return lease(key, host, client, host_semaphore, generation);
+        });
+    }
+
+    void http_client_pool::release(lease& value, bool reusable, request_outcome outcome)
+    {
+        if (!value.is_valid())
+        {
+            return;
+        }
+
+        adapt_host_limit(value, outcome);
+
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto now = std::chrono::steady_clock::now();
+            remove_expired_clients(now);
+
+            if (reusable && m_settings.max_idle_connections_per_host() > 0)
+            {
+                // Most recently used clients are kept at the back so that they are reused first,
+                // while the oldest ones are the first to be dropped or to expire
+                auto& idle_clients = m_idle_clients[value.m_key];
+                idle_client entry;
+                entry.client = value.m_client;
+                entry.last_used = now;
+                idle_clients.push_back(entry);
+
+                while (idle_clients.size() > m_settings.max_idle_connections_per_host())
+                {
+                    idle_clients.pop_front();
+                }
+            }
+        }
+
+        // The semaphore is released outside the lock, as it may run the continuation of a pending acquire
+        if (value.m_host_semaphore)
+        {
+            value.m_host_semaphore->unlock();
+        }
+
+        value = lease();
+    }
+
+    pplx::task<int> http_client_pool::warm_up_async(const web::http::uri& authority, const web::http::client::http_client_config& config, int connections)
+    {
+        // Connections beyond what the pool keeps idle, or beyond the limit of the host, would be dropped or never opened
+        auto current_settings = settings();
+        connections = static_cast<int>(std::min(static_cast<size_t>(std::max(connections, 0)), current_settings.max_idle_connections_per_host()));
+        if (current_settings.max_connections_per_host() > 0)
+        {
+            connections = std::min(connections, current_settings.max_connections_per_host());
+        }
+
+        if (connections == 0)
+        {
+            return pplx::task_from_result(0);
+        }
+
+        // All the leases are acquired before any is released, so that each request opens a connection of its own.
+        // The request only has to reach the host, which resolves its name and sets up the connection; any response will do.
+        auto instance = shared_from_this();
+        std::vector<pplx::task<int>> tasks;
+        tasks.reserve(connections);
+        for (int i = 0; i < connections; ++i)
+        {
+            tasks.push_back(acquire_async(authority, config).then([instance] (lease value) -> pplx::task<int>
+            {
+                web::http::http_request request(web::http::methods::HEAD);
+                return value.client().request(request).then([instance, value] (pplx::task<web::http::http_response> response_task) mutable -> int
+                {
+                    bool opened = false;
+                    try
+                    {
+                        response_task.get();
+                        opened = true;
+                    }
+                    catch (const std::exception&)
+                    {
+                    }
+
+                    instance->release(value, opened);
+                    return opened ? 1 : 0;
+                });
+            }));
+        }
+
+        return pplx::when_all(tasks.begin(), tasks.end()).then([] (std::vector<int> results) -> int
+        {
+            int opened = 0;
+            for (auto iter = results.cbegin(); iter != results.cend(); ++iter)
+            {
+                opened += *iter;
+            }
+
+            return opened;
+        });
+    }
+
+    connection_pool_settings http_client_pool::settings() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings;
+    }
+
+    void http_client_pool::set_settings(const connection_pool_settings& value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_settings = value;
+
+        // Trim the idle lists to the new limits; host semaphores are recreated lazily
+        // by the next acquire, while outstanding leases keep releasing the old ones
+        remove_expired_clients(std::chrono::steady_clock::now());
+        for (auto iter = m_idle_clients.begin(); iter != m_idle_clients.end(); ++iter)
+        {
+            while (iter->second.size() > m_settings.max_idle_connections_per_host())
+            {
+                iter->second.pop_front();
+            }
+        }
+    }
+
+    void http_client_pool::record_response_time(const utility::string_t& host, std::chrono::milliseconds value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto& times = m_response_times[host];
+        if (times.window.size() < protocol::response_time_window_size)
+        {
+            times.window.push_back(value.count());
+        }
+        else
+        {
+            // The window is full, so the oldest time is overwritten
+            times.window[times.next] = value.count();
+            times.next = (times.next + 1) % times.window.size();
+        }
+    }
+
+    bool http_client_pool::try_get_response_time_percentile(const utility::string_t& host, double percentile, std::chrono::milliseconds& value) const
+    {
+        std::vector<std::chrono::milliseconds::rep> window;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto iter = m_response_times.find(host);
+            if ((iter == m_response_times.end()) || (iter->second.window.size() < protocol::min_response_time_samples))
+            {
+                return false;
+            }
+
+            window = iter->second.window;
+        }
+
+        auto rank = window.begin() + static_cast<ptrdiff_t>(percentile * (window.size() - 1));
+        std::nth_element(window.begin(), rank, window.end());
+        value = std::chrono::milliseconds(*rank);
+        return true;
+    }
+
+    utility::string_t http_client_pool::get_key(const utility::string_t& host, const web::http::client::http_client_config& config)
+    {
+        utility::ostringstream_t key;
+        key << host << U('|') << config.timeout().count();
+        return key.str();
+    }
+
+    http_client_pool::host_limit* http_client_pool::get_host_limit(const utility::string_t& host)
+    {
+        bool adaptive = m_settings.adaptive_concurrency();
+        int max_connections = m_settings.max_connections_per_host();
+        if (adaptive && (max_connections <= 0))
+        {
+            max_connections = protocol::default_max_adaptive_connections_per_host;
+        }
+
+        if (max_connections <= 0)
+        {
+            m_host_limits.erase(host);
+            return nullptr;
+        }
+
+        auto& limit = m_host_limits[host];
+        if (!limit.semaphore || (limit.max_connections != max_connections) || (limit.adaptive != adaptive))
+        {
+            limit.max_connections = max_connections;
+            limit.adaptive = adaptive;
+            limit.semaphore = std::make_shared<async_semaphore>(max_connections);
+            limit.limit = static_cast<double>(max_connections);
+            limit.granted = max_connections;
+            limit.generation = 0;
+        }
+
+        return &limit;
+    }
+
+    void http_client_pool::adapt_host_limit(const lease& value, request_outcome outcome)
+    {
+        if ((outcome == request_outcome::unknown) || !value.m_host_semaphore)
+        {
+            return;
+        }
+
+        std::shared_ptr<async_semaphore> semaphore;
+        int64_t released = 0;
+        int64_t held_back = 0;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto iter = m_host_limits.find(value.m_host);
+            if ((iter == m_host_limits.end()) || !iter->second.adaptive || (iter->second.semaphore != value.m_host_semaphore))
+            {
+                return;
+            }
+
+            auto& limit = iter->second;
+            semaphore = limit.semaphore;
+            if (outcome == request_outcome::succeeded)
+            {
+                // Additive increase: one more request in flight once a whole limit's worth of requests has succeeded
+                limit.limit = std::min(limit.limit + 1.0 / limit.limit, static_cast<double>(limit.max_connections));
+                int granted = static_cast<int>(limit.limit);
+                released = granted - limit.granted;
+                limit.granted = granted;
+            }
+            else if (value.m_generation == limit.generation)
+            {
+                // Multiplicative decrease, once for all the requests that were already in flight when the host got busy
+                limit.limit = std::max(limit.limit / 2.0, 1.0);
+                int granted = static_cast<int>(limit.limit);
+                held_back = limit.granted - granted;
+                limit.granted = granted;
+                ++limit.generation;
+            }
+        }
+
+        // Units are held back by acquiring them for good, which waits for enough of the requests in flight to complete,
+        // and are given back when the limit grows again
+        if (released > 0)
+        {
+            semaphore->unlock(released);
+        }
+
+        if (held_back > 0)
+        {
+            semaphore->lock_async(held_back);
+        }
+    }
+
+    std::shared_ptr<web::http::client::http_client> http_client_pool::get_idle_client(const utility::string_t& key)
+    {
+        remove_expired_clients(std::chrono::steady_clock::now());
+
+        auto iter = m_idle_clients.find(key);
+        if (iter == m_idle_clients.end() || iter->second.empty())
+        {
+            return nullptr;
+        }
+
+        auto client = iter->second.back().client;
+        iter->second.pop_back();
+        return client;
+    }
+
+    void http_client_pool::remove_expired_clients(std::chrono::steady_clock::time_point now)
+    {
+        auto idle_timeout = m_settings.idle_timeout();
+        for (auto iter = m_idle_clients.begin(); iter != m_idle_clients.end();)
+        {
+            auto& idle_clients = iter->second;
+            while (!idle_clients.empty() && (now - idle_clients.front().last_used) >= idle_timeout)
+            {
+                idle_clients.pop_front();
+            }
+
+            if (idle_clients.empty())
+            {
+                iter = m_idle_clients.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+}}} // namespace wa::storage::core
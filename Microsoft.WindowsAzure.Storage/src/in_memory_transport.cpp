@@ -0,0 +1,604 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="in_memory_transport.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "was/in_memory_transport.h"
+#include "wascore/constants.h"
+#include "wascore/protocol.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        enum class storage_service
+        {
+            blob,
+            queue,
+            table
+        };
+
+        const utility::string_t canned_etag(U("\"0x8D0B3F4E5A6C7D8\""));
+        const char canned_blob_properties[] = "<Properties><Last-Modified>Wed, 09 Sep 2009 09:20:02 GMT</Last-Modified><Etag>0x8D0B3F4E5A6C7D8</Etag>"
+            "<Content-Length>0</Content-Length><Content-Type>application/octet-stream</Content-Type><BlobType>BlockBlob</BlobType>"
+            "<LeaseStatus>unlocked</LeaseStatus><LeaseState>available</LeaseState></Properties>";
+
+        storage_service get_service(const web::http::http_request& request)
+        {
+            // The host names of accounts and the ports of the storage emulator tell the services apart, and
+            // table requests can also be recognized by their OData headers
+            const auto& uri = request.request_uri();
+            if (uri.host().find(U(".table.")) != utility::string_t::npos || uri.port() == 10002 || request.headers().has(protocol::header_max_data_service_version))
+            {
+                return storage_service::table;
+            }
+
+            if (uri.host().find(U(".queue.")) != utility::string_t::npos || uri.port() == 10001)
+            {
+                return storage_service::queue;
+            }
+
+            return storage_service::blob;
+        }
+
+        utility::string_t get_query_value(const std::map<utility::string_t, utility::string_t>& query, const utility::string_t& name)
+        {
+            auto iter = query.find(name);
+            return iter == query.end() ? utility::string_t() : iter->second;
+        }
+
+        bool ends_with(const utility::string_t& value, const utility::string_t& suffix)
+        {
+            return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        web::http::http_response create_response(web::http::status_code status_code)
+        {
+            web::http::http_response response(status_code);
+            response.headers().add(protocol::ms_header_request_id, utility::uuid_to_string(utility::new_uuid()));
+            response.headers().add(protocol::ms_header_version, protocol::header_value_storage_version);
+            response.headers().add(web::http::header_names::date, utility::datetime::utc_now().to_string());
+            return response;
+        }
+
+        web::http::http_response create_response(web::http::status_code status_code, const std::string& body, const utility::string_t& content_type)
+        {
+            auto response = create_response(status_code);
+            response.set_body(std::vector<unsigned char>(body.begin(), body.end()));
+            response.headers().set_content_type(content_type);
+            return response;
+        }
+
+        void add_write_headers(web::http::http_response& response)
+        {
+            response.headers().add(web::http::header_names::etag, canned_etag);
+            response.headers().add(web::http::header_names::last_modified, utility::datetime::utc_now().to_string());
+        }
+
+        web::http::http_response server_busy_response(storage_service service)
+        {
+            if (service == storage_service::table)
+            {
+                return create_response(web::http::status_codes::ServiceUnavailable, "{\"odata.error\":{\"code\":\"ServerBusy\",\"message\":{\"lang\":\"en-US\",\"value\":\"The server is busy.\"}}}", U("application/json;odata=minimalmetadata"));
+            }
+
+            return create_response(web::http::status_codes::ServiceUnavailable, "<?xml version=\"1.0\" encoding=\"utf-8\"?><Error><Code>ServerBusy</Code><Message>The server is busy.</Message></Error>", U("application/xml"));
+        }
+
+        std::string make_table_entity(int index)
+        {
+            std::string entity("{\"PartitionKey\":\"partition\",\"RowKey\":\"row");
+            entity.append(std::to_string(index));
+            entity.append("\",\"Timestamp\":\"");
+            entity.append(utility::conversions::to_utf8string(utility::datetime::utc_now().to_string(utility::datetime::ISO_8601)));
+            entity.append("\",\"Name\":\"name\",\"Age\":23}");
+            return entity;
+        }
+
+        web::http::http_response table_batch_response(const std::string& batch_body)
+        {
+            // Every operation in the batch has a request line, and only a retrieve, which is always alone, is a GET
+            size_t operation_count = 0;
+            for (size_t pos = batch_body.find(" HTTP/1.1\r\n"); pos != std::string::npos; pos = batch_body.find(" HTTP/1.1\r\n", pos + 1))
+            {
+                ++operation_count;
+            }
+
+            bool is_query = batch_body.find("\r\nGET ") != std::string::npos;
+            auto batch_boundary = utility::conversions::to_utf8string(core::generate_boundary_name(U("batchresponse")));
+            auto changeset_boundary = utility::conversions::to_utf8string(core::generate_boundary_name(U("changesetresponse")));
+
+            std::string body;
+            body.append("--").append(batch_boundary).append("\r\n");
+            if (is_query)
+            {
+                body.append("Content-Type: application/http\r\nContent-Transfer-Encoding: binary\r\n\r\n");
+                body.append("HTTP/1.1 200 OK\r\nContent-Type: application/json;odata=minimalmetadata;streaming=true;charset=utf-8\r\nETag: W/\"datetime'2013-08-22T01%3A12%3A06.2608595Z'\"\r\n\r\n");
+                body.append(make_table_entity(0)).append("\r\n");
+            }
+            else
+            {
+                body.append("Content-Type: multipart/mixed; boundary=").append(changeset_boundary).append("\r\n\r\n");
+                for (size_t i = 0; i < operation_count; ++i)
+                {
+                    body.append("--").append(changeset_boundary).append("\r\n");
+                    body.append("Content-Type: application/http\r\nContent-Transfer-Encoding: binary\r\n\r\n");
+                    body.append("HTTP/1.1 204 No Content\r\nETag: W/\"datetime'2013-08-22T01%3A12%3A06.2608595Z'\"\r\n\r\n");
+                }
+
+                body.append("--").append(changeset_boundary).append("--\r\n");
+            }
+
+            body.append("--").append(batch_boundary).append("--\r\n");
+            return create_response(web::http::status_codes::Accepted, body, protocol::header_value_content_type_mime_multipart_prefix + utility::conversions::to_string_t(batch_boundary));
+        }
+
+        web::http::http_response table_response(const web::http::http_request& request, const std::string& batch_body, int listing_size)
+        {
+            const auto& path = request.request_uri().path();
+            if (ends_with(path, U("$batch")))
+            {
+                return table_batch_response(batch_body);
+            }
+
+            if (request.method() != web::http::methods::GET)
+            {
+                auto response = create_response(web::http::status_codes::NoContent);
+                response.headers().add(web::http::header_names::etag, U("W/\"datetime'2013-08-22T01%3A12%3A06.2608595Z'\""));
+                return response;
+            }
+
+            const utility::string_t content_type(U("application/json;odata=minimalmetadata;streaming=true;charset=utf-8"));
+            if (path.find(U("PartitionKey=")) != utility::string_t::npos)
+            {
+                return create_response(web::http::status_codes::OK, make_table_entity(0), content_type);
+            }
+
+            bool is_table_listing = ends_with(path, U("Tables")) || ends_with(path, U("Tables()"));
+            std::string body("{\"value\":[");
+            for (int i = 0; i < listing_size; ++i)
+            {
+                if (i > 0)
+                {
+                    body.push_back(',');
+                }
+
+                body.append(is_table_listing ? "{\"TableName\":\"table" + std::to_string(i) + "\"}" : make_table_entity(i));
+            }
+
+            body.append("]}");
+            return create_response(web::http::status_codes::OK, body, content_type);
+        }
+
+        web::http::http_response queue_response(const web::http::http_request& request, const std::map<utility::string_t, utility::string_t>& query, const utility::string_t& component, int listing_size)
+        {
+            const auto& method = request.method();
+            bool is_messages = request.request_uri().path().find(U("/messages")) != utility::string_t::npos;
+            if (is_messages && method == web::http::methods::GET)
+            {
+                auto count_value = get_query_value(query, U("numofmessages"));
+                int count = count_value.empty() ? 1 : std::stoi(utility::conversions::to_utf8string(count_value));
+                auto now = utility::conversions::to_utf8string(utility::datetime::utc_now().to_string());
+
+                std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><QueueMessagesList>");
+                for (int i = 0; i < count; ++i)
+                {
+                    body.append("<QueueMessage><MessageId>").append(utility::conversions::to_utf8string(utility::uuid_to_string(utility::new_uuid()))).append("</MessageId>");
+                    body.append("<InsertionTime>").append(now).append("</InsertionTime><ExpirationTime>").append(now).append("</ExpirationTime>");
+                    body.append("<PopReceipt>AgAAAAMAAAAAAAAA</PopReceipt><TimeNextVisible>").append(now).append("</TimeNextVisible>");
+                    body.append("<DequeueCount>1</DequeueCount><MessageText>bWVzc2FnZQ==</MessageText></QueueMessage>");
+                }
+
+                body.append("</QueueMessagesList>");
+                return create_response(web::http::status_codes::OK, body, U("application/xml"));
+            }
+
+            if (is_messages && method == web::http::methods::PUT)
+            {
+                auto response = create_response(web::http::status_codes::NoContent);
+                response.headers().add(protocol::ms_header_pop_receipt, U("AgAAAAMAAAAAAAAA"));
+                response.headers().add(protocol::ms_header_time_next_visible, utility::datetime::utc_now().to_string());
+                return response;
+            }
+
+            if (method == web::http::methods::GET && component == protocol::component_list)
+            {
+                std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults><Queues>");
+                for (int i = 0; i < listing_size; ++i)
+                {
+                    body.append("<Queue><Name>queue").append(std::to_string(i)).append("</Name></Queue>");
+                }
+
+                body.append("</Queues><NextMarker /></EnumerationResults>");
+                return create_response(web::http::status_codes::OK, body, U("application/xml"));
+            }
+
+            if (method == web::http::methods::GET || method == web::http::methods::HEAD)
+            {
+                auto response = create_response(web::http::status_codes::OK);
+                response.headers().add(protocol::ms_header_approximate_messages_count, U("0"));
+                return response;
+            }
+
+            if (method == web::http::methods::POST)
+            {
+                return create_response(web::http::status_codes::Created);
+            }
+
+            if (method == web::http::methods::DEL)
+            {
+                return create_response(web::http::status_codes::NoContent);
+            }
+
+            return create_response(component.empty() ? web::http::status_codes::Created : web::http::status_codes::NoContent);
+        }
+
+        web::http::http_response blob_download_response(const web::http::http_request& request, utility::size64_t blob_size)
+        {
+            // Both the x-ms-range and the Range header have the form "bytes=start-end"
+            auto range = protocol::get_header_value(request.headers(), protocol::ms_header_range);
+            if (range.empty())
+            {
+                range = protocol::get_header_value(request.headers(), web::http::header_names::range);
+            }
+
+            utility::size64_t start = 0;
+            utility::size64_t length = blob_size;
+            bool is_range = false;
+            auto separator = range.find(U('-'));
+            if (range.size() > 6 && separator != utility::string_t::npos)
+            {
+                start = std::stoull(utility::conversions::to_utf8string(range.substr(6, separator - 6)));
+                auto end = separator + 1 < range.size() ? std::stoull(utility::conversions::to_utf8string(range.substr(separator + 1))) : blob_size - 1;
+                if (start >= blob_size)
+                {
+                    return create_response(web::http::status_codes::RangeNotSatisfiable);
+                }
+
+                length = std::min(end, blob_size - 1) - start + 1;
+                is_range = true;
+            }
+
+            auto response = create_response(is_range ? web::http::status_codes::PartialContent : web::http::status_codes::OK);
+            response.set_body(std::vector<unsigned char>(static_cast<size_t>(length)));
+            response.headers().set_content_type(U("application/octet-stream"));
+            response.headers().add(protocol::ms_header_blob_type, protocol::header_value_blob_type_block);
+            add_write_headers(response);
+            if (is_range)
+            {
+                utility::ostringstream_t content_range;
+                content_range << U("bytes ") << start << U('-') << (start + length - 1) << U('/') << blob_size;
+                response.headers().add(web::http::header_names::content_range, content_range.str());
+            }
+
+            return response;
+        }
+
+        web::http::http_response blob_list_response(const std::map<utility::string_t, utility::string_t>& query, const utility::string_t& resource_type, int listing_size)
+        {
+            auto prefix = utility::conversions::to_utf8string(web::http::uri::decode(get_query_value(query, U("prefix"))));
+            std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults>");
+            if (resource_type == protocol::resource_container)
+            {
+                body.append("<Blobs>");
+                for (int i = 0; i < listing_size; ++i)
+                {
+                    body.append("<Blob><Name>").append(prefix).append("blob").append(std::to_string(i)).append("</Name>").append(canned_blob_properties).append("</Blob>");
+                }
+
+                body.append("</Blobs>");
+            }
+            else
+            {
+                body.append("<Containers>");
+                for (int i = 0; i < listing_size; ++i)
+                {
+                    body.append("<Container><Name>").append(prefix).append("container").append(std::to_string(i)).append("</Name>");
+                    body.append("<Properties><Last-Modified>Wed, 09 Sep 2009 09:20:02 GMT</Last-Modified><Etag>0x8D0B3F4E5A6C7D8</Etag></Properties></Container>");
+                }
+
+                body.append("</Containers>");
+            }
+
+            body.append("<NextMarker /></EnumerationResults>");
+            return create_response(web::http::status_codes::OK, body, U("application/xml"));
+        }
+
+        web::http::http_response blob_response(const web::http::http_request& request, const std::map<utility::string_t, utility::string_t>& query, const utility::string_t& component, utility::size64_t blob_size, int listing_size)
+        {
+            const auto& method = request.method();
+            auto resource_type = get_query_value(query, protocol::uri_query_resource_type);
+            if (method == web::http::methods::GET)
+            {
+                if (component == protocol::component_list)
+                {
+                    return blob_list_response(query, resource_type, listing_size);
+                }
+
+                if (component == protocol::component_block_list)
+                {
+                    return create_response(web::http::status_codes::OK, "<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList><CommittedBlocks /><UncommittedBlocks /></BlockList>", U("application/xml"));
+                }
+
+                if (component == protocol::component_acl)
+                {
+                    return create_response(web::http::status_codes::OK, "<?xml version=\"1.0\" encoding=\"utf-8\"?><SignedIdentifiers />", U("application/xml"));
+                }
+
+                if (component.empty() && resource_type.empty())
+                {
+                    return blob_download_response(request, blob_size);
+                }
+            }
+
+            if (method == web::http::methods::GET || method == web::http::methods::HEAD)
+            {
+                auto response = create_response(web::http::status_codes::OK);
+                add_write_headers(response);
+                if (resource_type.empty())
+                {
+                    response.headers().add(protocol::ms_header_blob_type, protocol::header_value_blob_type_block);
+                    response.headers().add(protocol::ms_header_lease_status, protocol::header_value_unlocked);
+                    response.headers().add(protocol::ms_header_lease_state, protocol::header_value_lease_available);
+                    response.headers().set_content_type(U("application/octet-stream"));
+                    response.headers().set_content_length(blob_size);
+                }
+
+                return response;
+            }
+
+            if (method == web::http::methods::DEL)
+            {
+                return create_response(web::http::status_codes::Accepted);
+            }
+
+            if (component == protocol::component_lease)
+            {
+                auto action = protocol::get_header_value(request.headers(), protocol::ms_header_lease_action);
+                if (action == protocol::header_value_lease_break)
+                {
+                    auto response = create_response(web::http::status_codes::Accepted);
+                    response.headers().add(protocol::ms_header_lease_time, U("0"));
+                    return response;
+                }
+
+                auto lease_id = protocol::get_header_value(request.headers(), protocol::ms_header_lease_proposed_id);
+                if (lease_id.empty())
+                {
+                    lease_id = protocol::get_header_value(request.headers(), protocol::ms_header_lease_id);
+                }
+
+                if (lease_id.empty())
+                {
+                    lease_id = utility::uuid_to_string(utility::new_uuid());
+                }
+
+                auto response = create_response(action == protocol::header_value_lease_acquire ? web::http::status_codes::Created : web::http::status_codes::OK);
+                response.headers().add(protocol::ms_header_lease_id, lease_id);
+                return response;
+            }
+
+            // Blocks, block lists, blobs and containers are created, while properties and metadata are only set
+            bool is_created = component.empty() || component == protocol::component_block_list || component == U("block") || component == U("page");
+            auto response = create_response(is_created ? web::http::status_codes::Created : web::http::status_codes::OK);
+            add_write_headers(response);
+            return response;
+        }
+
+        void read_request_body(const web::http::http_request& request, bool keep_body, utility::size64_t& length, std::string& body)
+        {
+            auto stream = request._get_impl()->instream();
+            if (!stream.is_valid())
+            {
+                return;
+            }
+
+            auto streambuf = stream.streambuf();
+            std::vector<uint8_t> chunk(protocol::default_buffer_size);
+            for (;;)
+            {
+                auto read = streambuf.getn(chunk.data(), chunk.size()).get();
+                if (read == 0)
+                {
+                    break;
+                }
+
+                length += read;
+                if (keep_body)
+                {
+                    body.append(reinterpret_cast<const char*>(chunk.data()), read);
+                }
+            }
+        }
+
+        std::vector<unsigned char> read_response_body(const web::http::http_response& response)
+        {
+            auto stream = response._get_impl()->instream();
+            if (!stream.is_valid())
+            {
+                return std::vector<unsigned char>();
+            }
+
+            concurrency::streams::container_buffer<std::vector<unsigned char>> buffer;
+            stream.read_to_end(buffer).wait();
+            return std::move(buffer.collection());
+        }
+
+        void complete_response(const web::http::http_request& request, web::http::http_response& response, const std::vector<unsigned char>& body)
+        {
+            // The body goes to the stream the request asked for, like the HTTP client would do, or else it is set on the response
+            auto response_stream = request._get_impl()->_response_stream();
+            if (response_stream.is_valid())
+            {
+                if (!body.empty())
+                {
+                    response_stream.streambuf().putn(body.data(), body.size()).wait();
+                }
+            }
+            else
+            {
+                // Setting the body replaces the content headers, which may describe something else, such as a blob whose properties are read
+                auto content_type = response.headers().content_type();
+                utility::size64_t content_length = 0;
+                bool has_content_length = response.headers().match(web::http::header_names::content_length, content_length);
+
+                response.set_body(body);
+                if (!content_type.empty())
+                {
+                    response.headers().set_content_type(content_type);
+                }
+
+                if (has_content_length)
+                {
+                    response.headers().set_content_length(content_length);
+                }
+            }
+
+            response._get_impl()->_complete(body.size());
+        }
+
+        struct pending_response
+        {
+            web::http::http_response response;
+            std::vector<unsigned char> body;
+        };
+    }
+
+    in_memory_transport::in_memory_transport()
+        : m_latency(0), m_bandwidth(0), m_error_rate(0.0), m_failure_rate(0.0), m_blob_size(0), m_listing_size(0), m_request_count(0)
+    {
+    }
+
+    pplx::task<web::http::http_response> in_memory_transport::send(web::http::http_request request, const pplx::cancellation_token& token)
+    {
+        ++m_request_count;
+        auto outcome = next_outcome();
+
+        // The transport is kept alive by the request options of the operation until the response is received
+        return pplx::create_task([this, request, token, outcome] () -> pplx::task<web::http::http_response>
+        {
+            // The body is read to the end as it would be by the HTTP client, and only kept for batches
+            bool is_batch = ends_with(request.request_uri().path(), U("$batch"));
+            utility::size64_t request_length = 0;
+            std::string batch_body;
+            read_request_body(request, is_batch, request_length, batch_body);
+
+            auto state = std::make_shared<pending_response>();
+            if (outcome == request_outcome::error)
+            {
+                state->response = server_busy_response(get_service(request));
+            }
+            else if (outcome == request_outcome::response)
+            {
+                state->response = m_responder ? m_responder(request, batch_body) : default_response(request, batch_body);
+            }
+
+            if (outcome != request_outcome::failure)
+            {
+                state->body = read_response_body(state->response);
+            }
+
+            auto delay = m_latency;
+            if (m_bandwidth > 0)
+            {
+                delay += std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>((request_length + state->body.size()) * 1000 / m_bandwidth));
+            }
+
+            return core::complete_after(delay, token).then([request, token, outcome, state] () -> web::http::http_response
+            {
+                if (token.is_canceled())
+                {
+                    pplx::cancel_current_task();
+                }
+
+                if (outcome == request_outcome::failure)
+                {
+                    throw web::http::http_exception(protocol::error_transport_connection_failure);
+                }
+
+                complete_response(request, state->response, state->body);
+                return state->response;
+            });
+        });
+    }
+
+    web::http::http_response in_memory_transport::default_response(const web::http::http_request& request, const std::string& batch_body) const
+    {
+        auto query = web::http::uri::split_query(request.request_uri().query());
+        auto component = get_query_value(query, protocol::uri_query_component);
+        switch (get_service(request))
+        {
+        case storage_service::table:
+            return table_response(request, batch_body, m_listing_size);
+
+        case storage_service::queue:
+            return queue_response(request, query, component, m_listing_size);
+
+        default:
+            return blob_response(request, query, component, m_blob_size, m_listing_size);
+        }
+    }
+
+    void in_memory_transport::set_error_rate(double value)
+    {
+        if (value < 0.0 || value > 1.0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_transport_rate));
+        }
+
+        m_error_rate = value;
+    }
+
+    void in_memory_transport::set_failure_rate(double value)
+    {
+        if (value < 0.0 || value > 1.0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_transport_rate));
+        }
+
+        m_failure_rate = value;
+    }
+
+    in_memory_transport::request_outcome in_memory_transport::next_outcome()
+    {
+        if (m_error_rate == 0.0 && m_failure_rate == 0.0)
+        {
+            return request_outcome::response;
+        }
+
+        double value;
+        {
+            std::lock_guard<std::mutex> guard(m_random_mutex);
+            value = std::uniform_real_distribution<double>(0.0, 1.0)(m_random);
+        }
+
+        if (value < m_failure_rate)
+        {
+            return request_outcome::failure;
+        }
+
+        if (value < m_failure_rate + m_error_rate)
+        {
+            return request_outcome::error;
+        }
+
+        return request_outcome::response;
+    }
+
+}} // namespace wa::storage
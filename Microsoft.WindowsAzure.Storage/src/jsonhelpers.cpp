@@ -0,0 +1,565 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="jsonhelpers.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/jsonhelpers.h"
+#include "wascore/transcode.h"
+
+namespace wa { namespace storage { namespace core { namespace json {
+
+    namespace
+    {
+        // Number of bytes requested from the source stream each time the reader runs out of buffered input
+        const size_t json_read_chunk_size = 16 * 1024;
+
+        bool is_json_whitespace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        bool is_json_number_char(char c)
+        {
+            return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        }
+
+        bool parse_hex4(const char* data, uint32_t& value)
+        {
+            value = 0;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                char c = data[i];
+                value <<= 4;
+                if (c >= '0' && c <= '9')
+                {
+                    value |= static_cast<uint32_t>(c - '0');
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    value |= static_cast<uint32_t>(c - 'a' + 10);
+                }
+                else if (c >= 'A' && c <= 'F')
+                {
+                    value |= static_cast<uint32_t>(c - 'A' + 10);
+                }
+                else
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // Moves past the decimal digits at the given position, and returns how many there were
+        size_t skip_digits(const char* data, size_t size, size_t& position)
+        {
+            size_t start = position;
+            while (position < size && data[position] >= '0' && data[position] <= '9')
+            {
+                ++position;
+            }
+
+            return position - start;
+        }
+
+        void append_utf8(std::string& target, uint32_t code_point)
+        {
+            if (code_point < 0x80)
+            {
+                target.push_back(static_cast<char>(code_point));
+            }
+            else if (code_point < 0x800)
+            {
+                target.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+                target.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+            else if (code_point < 0x10000)
+            {
+                target.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+                target.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                target.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+            else
+            {
+                target.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+                target.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+                target.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+                target.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+            }
+        }
+    }
+
+    utility::string_t json_string_view::to_string() const
+    {
+        return core::to_string_t(m_data, m_size);
+    }
+
+    json_reader::json_reader(concurrency::streams::istream stream)
+        : m_source(stream.is_valid() ? stream.streambuf() : concurrency::streams::streambuf<uint8_t>()), m_data(nullptr), m_size(0), m_position(0), m_state(state_value)
+    {
+        m_sourceDone = !m_source;
+    }
+
+    json_reader::json_reader(const char* data, size_t size)
+        : m_sourceDone(true), m_data(data), m_size(size), m_position(0), m_state(state_value)
+    {
+    }
+
+    void json_reader::parse()
+    {
+        // Skip the byte order mark if there is one
+        if (ensure(3) && std::memcmp(m_data + m_position, "\xEF\xBB\xBF", 3) == 0)
+        {
+            m_position += 3;
+        }
+
+        while (skip_whitespace())
+        {
+            char c = m_data[m_position];
+            switch (m_state)
+            {
+            case state_first_value:
+                if (c == ']')
+                {
+                    ++m_position;
+                    end_container('[');
+                    break;
+                }
+                read_value();
+                break;
+
+            case state_value:
+                read_value();
+                break;
+
+            case state_first_key:
+                if (c == '}')
+                {
+                    ++m_position;
+                    end_container('{');
+                    break;
+                }
+                // fall through
+
+            case state_key:
+                if (c != '"')
+                {
+                    fail("Expected the name of an object member in JSON input.");
+                }
+
+                handle_key(read_string());
+                m_state = state_colon;
+                break;
+
+            case state_colon:
+                if (c != ':')
+                {
+                    fail("Expected ':' after the name of an object member in JSON input.");
+                }
+
+                ++m_position;
+                m_state = state_value;
+                break;
+
+            case state_comma:
+                ++m_position;
+                if (c == ',')
+                {
+                    m_state = m_containers.back() == '{' ? state_key : state_value;
+                }
+                else if (c == '}' || c == ']')
+                {
+                    end_container(c == '}' ? '{' : '[');
+                }
+                else
+                {
+                    fail("Expected ',' or the end of an object or array in JSON input.");
+                }
+                break;
+
+            case state_done:
+                fail("Unexpected text after the end of the JSON input.");
+            }
+        }
+
+        if (m_state != state_done)
+        {
+            fail("Unexpected end of JSON input.");
+        }
+    }
+
+    void json_reader::read_value()
+    {
+        char c = m_data[m_position];
+        switch (c)
+        {
+        case '{':
+            ++m_position;
+            handle_begin_object();
+            m_containers.push_back('{');
+            m_state = state_first_key;
+            break;
+
+        case '[':
+            ++m_position;
+            handle_begin_array();
+            m_containers.push_back('[');
+            m_state = state_first_value;
+            break;
+
+        case '"':
+            handle_string(read_string());
+            end_value();
+            break;
+
+        case 't':
+            read_literal("true", 4);
+            handle_boolean(true);
+            end_value();
+            break;
+
+        case 'f':
+            read_literal("false", 5);
+            handle_boolean(false);
+            end_value();
+            break;
+
+        case 'n':
+            read_literal("null", 4);
+            handle_null();
+            end_value();
+            break;
+
+        default:
+            if (c == '-' || (c >= '0' && c <= '9'))
+            {
+                bool is_integer;
+                json_string_view number = read_number(is_integer);
+                handle_number(number, is_integer);
+                end_value();
+            }
+            else
+            {
+                fail("Unexpected character in JSON input.");
+            }
+            break;
+        }
+    }
+
+    void json_reader::end_container(char open)
+    {
+        if (m_containers.empty() || m_containers.back() != open)
+        {
+            fail("Mismatched end of an object or array in JSON input.");
+        }
+
+        m_containers.pop_back();
+        if (open == '{')
+        {
+            handle_end_object();
+        }
+        else
+        {
+            handle_end_array();
+        }
+
+        end_value();
+    }
+
+    void json_reader::end_value()
+    {
+        m_state = m_containers.empty() ? state_done : state_comma;
+    }
+
+    bool json_reader::fill_buffer()
+    {
+        if (m_sourceDone)
+        {
+            return false;
+        }
+
+        // Everything before the current position has been reported already, so it can be discarded
+        if (m_position > 0)
+        {
+            m_buffer.erase(0, m_position);
+            m_position = 0;
+        }
+
+        size_t size = m_buffer.size();
+        m_buffer.resize(size + json_read_chunk_size);
+        size_t read = m_source.getn(reinterpret_cast<uint8_t*>(&m_buffer[size]), json_read_chunk_size).get();
+        m_buffer.resize(size + read);
+
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+
+        if (read == 0)
+        {
+            m_sourceDone = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool json_reader::ensure(size_t count)
+    {
+        while (m_size - m_position < count)
+        {
+            if (!fill_buffer())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool json_reader::skip_whitespace()
+    {
+        for (;;)
+        {
+            while (m_position < m_size && is_json_whitespace(m_data[m_position]))
+            {
+                ++m_position;
+            }
+
+            if (m_position < m_size)
+            {
+                return true;
+            }
+
+            if (!fill_buffer())
+            {
+                return false;
+            }
+        }
+    }
+
+    json_string_view json_reader::read_string()
+    {
+        // Offsets are relative to m_position, because reading more input may move the buffered bytes
+        size_t offset = 1;
+        bool escaped = false;
+        bool terminated = false;
+        while (!terminated)
+        {
+            if (m_position + offset >= m_size)
+            {
+                if (!fill_buffer())
+                {
+                    fail("Unterminated string in JSON input.");
+                }
+
+                continue;
+            }
+
+            char c = m_data[m_position + offset];
+            if (c == '"')
+            {
+                terminated = true;
+            }
+            else if (c == '\\')
+            {
+                escaped = true;
+                offset += 2;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                fail("Unescaped control character in a JSON string.");
+            }
+            else
+            {
+                ++offset;
+            }
+        }
+
+        const char* begin = m_data + m_position + 1;
+        size_t length = offset - 1;
+        m_position += offset + 1;
+
+        if (!escaped)
+        {
+            return json_string_view(begin, length);
+        }
+
+        decode_string(begin, length);
+        return json_string_view(m_decoded.data(), m_decoded.size());
+    }
+
+    void json_reader::decode_string(const char* data, size_t size)
+    {
+        m_decoded.clear();
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (data[i] != '\\')
+            {
+                m_decoded.push_back(data[i]);
+                continue;
+            }
+
+            char c = data[++i];
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                m_decoded.push_back(c);
+                break;
+
+            case 'b':
+                m_decoded.push_back('\b');
+                break;
+
+            case 'f':
+                m_decoded.push_back('\f');
+                break;
+
+            case 'n':
+                m_decoded.push_back('\n');
+                break;
+
+            case 'r':
+                m_decoded.push_back('\r');
+                break;
+
+            case 't':
+                m_decoded.push_back('\t');
+                break;
+
+            case 'u':
+                {
+                    uint32_t code_point;
+                    if (i + 4 >= size || !parse_hex4(data + i + 1, code_point))
+                    {
+                        fail("Invalid unicode escape sequence in a JSON string.");
+                    }
+
+                    i += 4;
+                    if (code_point >= 0xD800 && code_point < 0xDC00)
+                    {
+                        // A high surrogate must be followed by an escaped low surrogate
+                        uint32_t low_surrogate;
+                        if (i + 6 >= size || data[i + 1] != '\\' || data[i + 2] != 'u' || !parse_hex4(data + i + 3, low_surrogate) || low_surrogate < 0xDC00 || low_surrogate >= 0xE000)
+                        {
+                            fail("Invalid unicode surrogate pair in a JSON string.");
+                        }
+
+                        i += 6;
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                    }
+                    else if (code_point >= 0xDC00 && code_point < 0xE000)
+                    {
+                        fail("Invalid unicode surrogate pair in a JSON string.");
+                    }
+
+                    append_utf8(m_decoded, code_point);
+                }
+                break;
+
+            default:
+                fail("Invalid escape sequence in a JSON string.");
+            }
+        }
+    }
+
+    json_string_view json_reader::read_number(bool& is_integer)
+    {
+        size_t offset = 0;
+        for (;;)
+        {
+            while (m_position + offset < m_size && is_json_number_char(m_data[m_position + offset]))
+            {
+                ++offset;
+            }
+
+            // A number that ends the buffered input may continue in the next chunk
+            if (m_position + offset < m_size || !fill_buffer())
+            {
+                break;
+            }
+        }
+
+        const char* begin = m_data + m_position;
+        m_position += offset;
+
+        // The characters that may appear in a number were taken as a whole, so they are checked against the grammar here
+        size_t i = 0;
+        if (i < offset && begin[i] == '-')
+        {
+            ++i;
+        }
+
+        if (i < offset && begin[i] == '0')
+        {
+            ++i;
+        }
+        else if (skip_digits(begin, offset, i) == 0)
+        {
+            fail("Malformed number in JSON input.");
+        }
+
+        is_integer = true;
+        if (i < offset && begin[i] == '.')
+        {
+            is_integer = false;
+            ++i;
+            if (skip_digits(begin, offset, i) == 0)
+            {
+                fail("Malformed number in JSON input.");
+            }
+        }
+
+        if (i < offset && (begin[i] == 'e' || begin[i] == 'E'))
+        {
+            is_integer = false;
+            ++i;
+            if (i < offset && (begin[i] == '+' || begin[i] == '-'))
+            {
+                ++i;
+            }
+
+            if (skip_digits(begin, offset, i) == 0)
+            {
+                fail("Malformed number in JSON input.");
+            }
+        }
+
+        if (i != offset)
+        {
+            fail("Malformed number in JSON input.");
+        }
+
+        return json_string_view(begin, offset);
+    }
+
+    void json_reader::read_literal(const char* literal, size_t length)
+    {
+        if (!ensure(length) || std::memcmp(m_data + m_position, literal, length) != 0)
+        {
+            fail("Unexpected character in JSON input.");
+        }
+
+        m_position += length;
+    }
+
+    void json_reader::fail(const char* message)
+    {
+        throw std::runtime_error(message);
+    }
+
+}}}} // namespace wa::storage::core::json
@@ -0,0 +1,78 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="latency_recorder.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/latency_recorder.h"
+#include "wascore/constants.h"
+
+namespace wa { namespace storage { namespace core {
+
+    utility::string_t latency_recorder::get_operation(const web::http::http_request& request)
+    {
+        utility::string_t operation(request.method());
+        auto query = web::http::uri::split_query(request.request_uri().query());
+
+        auto restype = query.find(protocol::uri_query_resource_type);
+        if (restype != query.end())
+        {
+            operation.append(U(" "));
+            operation.append(restype->second);
+        }
+
+        auto component = query.find(protocol::uri_query_component);
+        if (component != query.end())
+        {
+            operation.append(U(" "));
+            operation.append(component->second);
+        }
+
+        return operation;
+    }
+
+    void latency_recorder::record(const utility::string_t& operation, const request_timings& timings)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_histograms[operation].add(timings);
+    }
+
+    std::map<utility::string_t, request_latency_histograms> latency_recorder::histograms() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_histograms;
+    }
+
+    bool latency_recorder::try_get_mean_latency(const utility::string_t& operation, std::chrono::microseconds& value) const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_histograms.find(operation);
+        if (iter == m_histograms.end() || iter->second.total().count() < protocol::min_response_time_samples)
+        {
+            return false;
+        }
+
+        const latency_histogram& total = iter->second.total();
+        value = std::chrono::microseconds(total.total().count() / static_cast<std::chrono::microseconds::rep>(total.count()));
+        return true;
+    }
+
+    void latency_recorder::reset()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_histograms.clear();
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,101 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="location_selector.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/location_selector.h"
+#include "wascore/constants.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        // Weight of the newest request in the moving averages, so that a brownout shows within a few requests
+        const double health_decay = 0.2;
+
+        // Number of requests the preferred location has to have served before the other one is probed
+        const int min_health_samples = 5;
+
+        // The other location is tried when it has not been used for this long, so that its recovery is noticed
+        const std::chrono::seconds location_probe_interval(10);
+
+        // Reads only move to the other location if it is expected to be at least this much cheaper, so they do not flap
+        const double location_switch_ratio = 0.8;
+
+        // Upper bound of the error rate in the cost, which would otherwise be infinite for a location that fails every request
+        const double max_cost_error_rate = 0.95;
+    }
+
+    storage_location location_selector::select(const utility::string_t& account)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto& health = m_accounts[account];
+        auto other = health.preferred == storage_location::primary ? storage_location::secondary : storage_location::primary;
+        auto& preferred_health = health.get(health.preferred);
+        auto& other_health = health.get(other);
+
+        auto now = std::chrono::steady_clock::now();
+        if ((preferred_health.samples >= min_health_samples) && (now - other_health.last_used >= location_probe_interval))
+        {
+            // Only one read probes the other location in each interval, even before it has been answered
+            other_health.last_used = now;
+            return other;
+        }
+
+        preferred_health.last_used = now;
+        return health.preferred;
+    }
+
+    void location_selector::record(const utility::string_t& account, storage_location location, std::chrono::milliseconds latency, bool failed)
+    {
+        double value = static_cast<double>(latency.count());
+        double error = failed ? 1.0 : 0.0;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto& health = m_accounts[account];
+        auto& location_health = health.get(location);
+        if (location_health.samples == 0)
+        {
+            location_health.latency = value;
+            location_health.error_rate = error;
+        }
+        else
+        {
+            location_health.latency += health_decay * (value - location_health.latency);
+            location_health.error_rate += health_decay * (error - location_health.error_rate);
+        }
+
+        ++location_health.samples;
+        location_health.last_used = std::chrono::steady_clock::now();
+
+        auto other = health.preferred == storage_location::primary ? storage_location::secondary : storage_location::primary;
+        const auto& other_health = health.get(other);
+        if ((other_health.samples > 0) && (get_cost(other_health) < get_cost(health.get(health.preferred)) * location_switch_ratio))
+        {
+            health.preferred = other;
+        }
+    }
+
+    double location_selector::get_cost(const location_health& health)
+    {
+        // The expected time to a successful response, if every failed request has to be sent again after the usual retry interval,
+        // so that a location that fails quickly is not mistaken for a fast one
+        double retry_interval = static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(protocol::default_retry_interval).count());
+        double error_rate = std::min(health.error_rate, max_cost_error_rate);
+        return (health.latency + error_rate * retry_interval) / (1.0 - error_rate);
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,187 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="log_ring.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/log_ring.h"
+
+#include <chrono>
+#include <thread>
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        // How long the drain thread sleeps once it finds the ring empty
+        const std::chrono::milliseconds log_drain_interval(10);
+    }
+
+    log_ring::log_ring(size_t capacity, writer write)
+        : m_mask(0), m_enqueue_position(0), m_dropped(0), m_write(std::move(write)), m_dequeue_position(0), m_reported_dropped(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+
+        m_slots.reset(new slot[size]);
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        m_mask = size - 1;
+    }
+
+    bool log_ring::try_push(client_log_level level, const utility::char_t* format, int64_t value, const utility::string_t& text1, const utility::string_t& text2)
+    {
+        start_drain_thread();
+
+        // Claim a position whose slot has already been drained. A producer that loses the race for a position
+        // retries with the next one, so no producer ever waits for another.
+        auto position = m_enqueue_position.load(std::memory_order_relaxed);
+        slot* target;
+        for (;;)
+        {
+            target = &m_slots[position & m_mask];
+            auto sequence = target->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0)
+            {
+                if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                position = m_enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        target->level = level;
+        target->format = format;
+        target->value = value;
+        target->text1 = text1;
+        target->text2 = text2;
+        target->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    void log_ring::flush()
+    {
+        drain();
+    }
+
+    size_t log_ring::drain()
+    {
+        std::lock_guard<std::mutex> guard(m_drain_mutex);
+
+        size_t drained = 0;
+        for (;;)
+        {
+            auto& source = m_slots[m_dequeue_position & m_mask];
+            if (source.sequence.load(std::memory_order_acquire) != m_dequeue_position + 1)
+            {
+                break;
+            }
+
+            auto level = source.level;
+            auto message = format_message(source.format, source.value, source.text1, source.text2);
+            source.text1.clear();
+            source.text2.clear();
+
+            // Hand the slot back to the producers before writing, as writing is the slow part
+            source.sequence.store(m_dequeue_position + m_mask + 1, std::memory_order_release);
+            ++m_dequeue_position;
+            ++drained;
+
+            if (m_write)
+            {
+                m_write(level, message);
+            }
+        }
+
+        auto dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reported_dropped)
+        {
+            auto message = format_message(U("%d log records were dropped because the log ring was full"), static_cast<int64_t>(dropped - m_reported_dropped), utility::string_t(), utility::string_t());
+            m_reported_dropped = dropped;
+            if (m_write)
+            {
+                m_write(client_log_level::log_level_warning, message);
+            }
+        }
+
+        return drained;
+    }
+
+    void log_ring::start_drain_thread()
+    {
+        std::call_once(m_drain_thread_flag, [this] ()
+        {
+            // The ring is never destroyed while the process runs, so the thread is left to end with it
+            std::thread([this] ()
+            {
+                for (;;)
+                {
+                    if (drain() == 0)
+                    {
+                        std::this_thread::sleep_for(log_drain_interval);
+                    }
+                }
+            }).detach();
+        });
+    }
+
+    utility::string_t log_ring::format_message(const utility::char_t* format, int64_t value, const utility::string_t& text1, const utility::string_t& text2)
+    {
+        if (format == nullptr)
+        {
+            return text1;
+        }
+
+        utility::ostringstream_t str;
+        const utility::string_t* next_text = &text1;
+        for (const utility::char_t* c = format; *c != U('\0'); ++c)
+        {
+            if (c[0] == U('%') && c[1] == U('d'))
+            {
+                str << value;
+                ++c;
+            }
+            else if (c[0] == U('%') && c[1] == U('s'))
+            {
+                str << *next_text;
+                next_text = &text2;
+                ++c;
+            }
+            else
+            {
+                str << *c;
+            }
+        }
+
+        return str.str();
+    }
+
+}}} // namespace wa::storage::core
@@ -20,6 +20,7 @@
 
 #include <evntprov.h>
 #include <evntrace.h>
+#include <winmeta.h>
 
 namespace wa { namespace storage { namespace core {
 
@@ -47,7 +48,67 @@ namespace wa { namespace storage { namespace core {
         return TRACE_LEVEL_VERBOSE;
     }
 
+    void write_etw_event(client_log_level level, const utility::string_t& message)
+    {
+        if (g_event_provider_handle != NULL)
+        {
+            auto utf16_message = utility::conversions::to_utf16string(message);
+            EventWriteString(g_event_provider_handle, get_etw_log_level(level), 0, utf16_message.c_str());
+        }
+    }
+
+    // The keyword of the phase events in wastorage_events.man
+    static const ULONGLONG phase_event_keyword = 0x1;
+
+    // The manifest numbers the events of a phase by its task, the start event first
+    EVENT_DESCRIPTOR get_phase_event_descriptor(trace_phase phase, bool is_start)
+    {
+        USHORT task = static_cast<USHORT>(phase);
+        EVENT_DESCRIPTOR descriptor;
+        EventDescCreate(&descriptor, is_start ? task * 2 - 1 : task * 2, 0, 0, TRACE_LEVEL_INFORMATION, task, is_start ? WINEVENT_OPCODE_START : WINEVENT_OPCODE_STOP, phase_event_keyword);
+        return descriptor;
+    }
+
+    // The activity ID of an attempt is the provider GUID with its last eight bytes replaced by the activity
+    GUID get_activity_id(uint64_t activity)
+    {
+        GUID activity_id = event_provider_guid;
+        for (size_t i = 0; i < sizeof(activity_id.Data4); ++i)
+        {
+            activity_id.Data4[i] = static_cast<unsigned char>(activity >> (i * 8));
+        }
+
+        return activity_id;
+    }
+
+    void write_phase_event(trace_phase phase, bool is_start, uint64_t activity, const phase_event& value)
+    {
+        if (g_event_provider_handle == NULL)
+        {
+            return;
+        }
+
+        auto operation = utility::conversions::to_utf16string(value.operation);
+        auto client_request_id = utility::conversions::to_utf16string(value.client_request_id);
+        UCHAR location = static_cast<UCHAR>(value.location);
+        USHORT status_code = static_cast<USHORT>(value.status_code);
+        ULONGLONG bytes = static_cast<ULONGLONG>(value.bytes);
+
+        // The fields are in the order of the PhaseStart and PhaseStop templates, of which the start one is a prefix
+        EVENT_DATA_DESCRIPTOR data[5];
+        EventDataDescCreate(&data[0], operation.c_str(), static_cast<ULONG>((operation.size() + 1) * sizeof(wchar_t)));
+        EventDataDescCreate(&data[1], client_request_id.c_str(), static_cast<ULONG>((client_request_id.size() + 1) * sizeof(wchar_t)));
+        EventDataDescCreate(&data[2], &location, sizeof(location));
+        EventDataDescCreate(&data[3], &status_code, sizeof(status_code));
+        EventDataDescCreate(&data[4], &bytes, sizeof(bytes));
+
+        auto descriptor = get_phase_event_descriptor(phase, is_start);
+        auto activity_id = get_activity_id(activity);
+        EventWriteTransfer(g_event_provider_handle, &descriptor, &activity_id, NULL, is_start ? 3 : 5, data);
+    }
+
     logger::logger()
+        : m_ring(new log_ring(protocol::log_ring_capacity, write_etw_event)), m_operation_count(0)
     {
         if (EventRegister(&event_provider_guid, NULL, NULL, &g_event_provider_handle) != ERROR_SUCCESS)
         {
@@ -59,7 +120,10 @@ namespace wa { namespace storage { namespace core {
     {
         if (g_event_provider_handle != NULL)
         {
-            EventUnregister(g_event_provider_handle);
+            m_ring->flush();
+            auto handle = g_event_provider_handle;
+            g_event_provider_handle = NULL;
+            EventUnregister(handle);
         }
     }
 
@@ -67,11 +131,79 @@ namespace wa { namespace storage { namespace core {
     {
         if (g_event_provider_handle != NULL)
         {
-            auto utf16_message = utility::conversions::to_utf16string(message);
-            EventWriteString(g_event_provider_handle, get_etw_log_level(level), 0, utf16_message.c_str());
+            m_ring->try_push(level, nullptr, 0, message, utility::string_t());
+        }
+    }
+
+    void logger::log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, int64_t value) const
+    {
+        if (g_event_provider_handle != NULL)
+        {
+            m_ring->try_push(level, format, value, utility::string_t(), utility::string_t());
+        }
+    }
+
+    void logger::log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, const utility::string_t& text) const
+    {
+        if (g_event_provider_handle != NULL)
+        {
+            m_ring->try_push(level, format, 0, text, utility::string_t());
+        }
+    }
+
+    void logger::log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, int64_t value, const utility::string_t& text) const
+    {
+        if (g_event_provider_handle != NULL)
+        {
+            m_ring->try_push(level, format, value, text, utility::string_t());
         }
     }
 
+    void logger::log(wa::storage::operation_context context, client_log_level level, const utility::char_t* format, const utility::string_t& text1, const utility::string_t& text2) const
+    {
+        if (g_event_provider_handle != NULL)
+        {
+            m_ring->try_push(level, format, 0, text1, text2);
+        }
+    }
+
+    client_log_level logger::operation_log_level(wa::storage::operation_context context) const
+    {
+        if (g_event_provider_handle == NULL)
+        {
+            return client_log_level::log_level_off;
+        }
+
+        auto level = context.log_level();
+        auto interval = context.log_sampling_interval();
+        if (interval > 1 && level > client_log_level::log_level_warning && m_operation_count.fetch_add(1, std::memory_order_relaxed) % interval != 0)
+        {
+            level = client_log_level::log_level_warning;
+        }
+
+        return level;
+    }
+
+    void logger::flush() const
+    {
+        m_ring->flush();
+    }
+
+    bool logger::phase_events_enabled() const
+    {
+        return (g_event_provider_handle != NULL) && (EventProviderEnabled(g_event_provider_handle, TRACE_LEVEL_INFORMATION, phase_event_keyword) != FALSE);
+    }
+
+    void logger::write_phase_start(trace_phase phase, uint64_t activity, const phase_event& value) const
+    {
+        write_phase_event(phase, true, activity, value);
+    }
+
+    void logger::write_phase_stop(trace_phase phase, uint64_t activity, const phase_event& value) const
+    {
+        write_phase_event(phase, false, activity, value);
+    }
+
     bool logger::should_log(wa::storage::operation_context context, client_log_level level) const
     {
         return (g_event_provider_handle != NULL) && (level <= context.log_level());
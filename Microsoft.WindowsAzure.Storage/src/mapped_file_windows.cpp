@@ -0,0 +1,138 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="mapped_file_windows.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/mapped_file_windows.h"
+#include "wascore/resources.h"
+
+#ifdef WIN32
+
+#include <winioctl.h>
+
+namespace wa { namespace storage { namespace core {
+
+    std::shared_ptr<mapped_file> mapped_file::open_read(const utility::string_t& path)
+    {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw utility::details::create_system_error(GetLastError());
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            auto error = GetLastError();
+            CloseHandle(file);
+            throw utility::details::create_system_error(error);
+        }
+
+        return std::shared_ptr<mapped_file>(new mapped_file(file, static_cast<utility::size64_t>(size.QuadPart), false));
+    }
+
+    std::shared_ptr<mapped_file> mapped_file::create(const utility::string_t& path, utility::size64_t size, bool sparse)
+    {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw utility::details::create_system_error(GetLastError());
+        }
+
+        if (sparse)
+        {
+            // A file system without sparse files fails this, and the file is then allocated in full, which still reads as zeros
+            DWORD returned;
+            DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL);
+        }
+
+        // Size the whole file up front, so that it is not extended piece by piece
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(file, end, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+        {
+            auto error = GetLastError();
+            CloseHandle(file);
+            throw utility::details::create_system_error(error);
+        }
+
+        return std::shared_ptr<mapped_file>(new mapped_file(file, size, true));
+    }
+
+    mapped_file::mapped_file(HANDLE file, utility::size64_t size, bool writable)
+        : m_file(file), m_mapping(NULL), m_data(nullptr), m_size(0), m_writable(writable)
+    {
+        if (size > std::numeric_limits<size_t>::max())
+        {
+            CloseHandle(m_file);
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_file_too_large_to_map));
+        }
+
+        // Empty files cannot be mapped, so they are represented by an empty view
+        if (size == 0)
+        {
+            return;
+        }
+
+        m_mapping = CreateFileMappingW(m_file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping == NULL)
+        {
+            auto error = GetLastError();
+            CloseHandle(m_file);
+            throw utility::details::create_system_error(error);
+        }
+
+        m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+        if (m_data == nullptr)
+        {
+            auto error = GetLastError();
+            CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            throw utility::details::create_system_error(error);
+        }
+
+        m_size = static_cast<size_t>(size);
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if (m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+
+        if (m_mapping != NULL)
+        {
+            CloseHandle(m_mapping);
+        }
+
+        CloseHandle(m_file);
+    }
+
+    void mapped_file::flush()
+    {
+        if (m_writable && (m_data != nullptr))
+        {
+            if (!FlushViewOfFile(m_data, 0) || !FlushFileBuffers(m_file))
+            {
+                throw utility::details::create_system_error(GetLastError());
+            }
+        }
+    }
+
+}}} // namespace wa::storage::core
+
+#endif
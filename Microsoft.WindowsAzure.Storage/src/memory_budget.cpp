@@ -0,0 +1,37 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="memory_budget.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/memory_budget.h"
+
+namespace wa { namespace storage { namespace core {
+
+    pplx::task<std::shared_ptr<memory_budget::reservation>> memory_budget::reserve_async(size_t bytes)
+    {
+        if (bytes > m_max_bytes)
+        {
+            bytes = static_cast<size_t>(m_max_bytes);
+        }
+
+        auto instance = shared_from_this();
+        return m_semaphore.lock_async(static_cast<int64_t>(bytes)).then([instance, bytes] () -> std::shared_ptr<reservation>
+        {
+            return std::shared_ptr<reservation>(new reservation(instance, bytes));
+        });
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,80 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="metrics_sink.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "was/common.h"
+
+#include <thread>
+
+namespace wa { namespace storage {
+
+    void histogram_metrics_sink::record(const request_metrics& metrics)
+    {
+        // Requests completing on the same thread always land in the same shard
+        auto& target = m_shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % protocol::metrics_sink_shard_count];
+        auto key = std::make_tuple(metrics.service(), metrics.operation(), metrics.location());
+
+        pplx::extensibility::scoped_critical_section_t l(target.lock);
+        auto iter = target.series.find(key);
+        if (iter == target.series.end())
+        {
+            iter = target.series.insert(std::make_pair(key, metrics_series(metrics.service(), metrics.operation(), metrics.location()))).first;
+        }
+
+        iter->second.add(metrics);
+    }
+
+    std::vector<metrics_series> histogram_metrics_sink::series() const
+    {
+        std::map<series_key, metrics_series> merged;
+        for (size_t i = 0; i < protocol::metrics_sink_shard_count; ++i)
+        {
+            pplx::extensibility::scoped_critical_section_t l(m_shards[i].lock);
+            for (auto iter = m_shards[i].series.cbegin(); iter != m_shards[i].series.cend(); ++iter)
+            {
+                auto existing = merged.find(iter->first);
+                if (existing == merged.end())
+                {
+                    merged.insert(*iter);
+                }
+                else
+                {
+                    existing->second.merge(iter->second);
+                }
+            }
+        }
+
+        std::vector<metrics_series> result;
+        result.reserve(merged.size());
+        for (auto iter = merged.cbegin(); iter != merged.cend(); ++iter)
+        {
+            result.push_back(iter->second);
+        }
+
+        return result;
+    }
+
+    void histogram_metrics_sink::reset()
+    {
+        for (size_t i = 0; i < protocol::metrics_sink_shard_count; ++i)
+        {
+            pplx::extensibility::scoped_critical_section_t l(m_shards[i].lock);
+            m_shards[i].series.clear();
+        }
+    }
+
+}} // namespace wa::storage
@@ -17,6 +17,7 @@
 
 #include "stdafx.h"
 #include "wascore/util.h"
+#include "wascore/transcode.h"
 #include "was/table.h"
 
 namespace wa { namespace storage {  namespace core {
@@ -35,66 +36,66 @@ namespace wa { namespace storage {  namespace core {
         return boundary_name;
     }
 
-    void write_line_break(utility::string_t& body_text)
+    void append_utf8(std::string& body, const utility::string_t& value)
     {
-        body_text.push_back(U('\r'));
-        body_text.push_back(U('\n'));
+        // Transcode straight into the body, so no temporary UTF-8 string is needed
+        append_utf8(body, value.data(), value.size());
     }
 
-    void write_boundary(utility::string_t& body_text, const utility::string_t& boundary_name, bool is_closure)
+    void write_line_break(std::string& body)
     {
-        body_text.append(U("--"));
-        body_text.append(boundary_name);
+        body.push_back('\r');
+        body.push_back('\n');
+    }
+
+    void write_boundary(std::string& body, const utility::string_t& boundary_name, bool is_closure)
+    {
+        body.append("--");
+        append_utf8(body, boundary_name);
         if (is_closure)
         {
-            body_text.append(U("--"));
+            body.append("--");
         }
 
-        write_line_break(body_text);
+        write_line_break(body);
     }
 
-    void write_mime_multipart_headers(utility::string_t& body_text)
+    void write_mime_multipart_headers(std::string& body)
     {
-        body_text.append(web::http::header_names::content_type);
-        body_text.push_back(U(':'));
-        body_text.push_back(U(' '));
-        body_text.append(protocol::header_value_content_type_http);
-        write_line_break(body_text);
+        append_utf8(body, web::http::header_names::content_type);
+        body.append(": ");
+        append_utf8(body, protocol::header_value_content_type_http);
+        write_line_break(body);
 
-        body_text.append(protocol::header_content_transfer_encoding);
-        body_text.push_back(U(':'));
-        body_text.push_back(U(' '));
-        body_text.append(protocol::header_value_content_transfer_encoding_binary);
-        write_line_break(body_text);
+        append_utf8(body, protocol::header_content_transfer_encoding);
+        body.append(": ");
+        append_utf8(body, protocol::header_value_content_transfer_encoding_binary);
+        write_line_break(body);
 
-        write_line_break(body_text);
+        write_line_break(body);
     }
 
-    void write_request_line(utility::string_t& body_text, const web::http::method& method, const web::http::uri& uri)
+    void write_request_line(std::string& body, const web::http::method& method, const web::http::uri& uri)
     {
-        body_text.append(method);
-        body_text.push_back(U(' '));
-        body_text.append(uri.to_string());
-        body_text.push_back(U(' '));
-        body_text.append(protocol::http_version);
-        write_line_break(body_text);
+        append_utf8(body, method);
+        body.push_back(' ');
+        append_utf8(body, uri.to_string());
+        body.push_back(' ');
+        append_utf8(body, protocol::http_version);
+        write_line_break(body);
     }
 
-    void write_request_headers(utility::string_t& body_text, const web::http::http_headers& headers)
+    void write_request_headers(std::string& body, const web::http::http_headers& headers)
     {
         for (web::http::http_headers::const_iterator itr = headers.begin(); itr != headers.end(); ++itr)
         {
-            utility::string_t header_name = itr->first;
-            utility::string_t header_value = itr->second;
-
-            body_text.append(header_name);
-            body_text.push_back(U(':'));
-            body_text.push_back(U(' '));
-            body_text.append(header_value);
-            write_line_break(body_text);
+            append_utf8(body, itr->first);
+            body.append(": ");
+            append_utf8(body, itr->second);
+            write_line_break(body);
         }
 
-        write_line_break(body_text);
+        write_line_break(body);
     }
 
     /*
@@ -115,14 +116,61 @@ namespace wa { namespace storage {  namespace core {
     }
     */
 
-    void write_request_payload(utility::string_t& body_text, web::json::value json_object)
+    // Escapes the UTF-8 text at the end of the body in place. UTF-8 continuation bytes are never below 0x80, so only ASCII is affected.
+    static void escape_json_string(std::string& body, size_t begin)
     {
-        if (!json_object.is_null())
+        for (size_t i = begin; i < body.size(); ++i)
         {
-            body_text.append(json_object.to_string());
+            unsigned char c = static_cast<unsigned char>(body[i]);
+            if (c == '"' || c == '\\' || c < 0x20)
+            {
+                char escape[7];
+                size_t length = 2;
+                escape[0] = '\\';
+                switch (c)
+                {
+                case '"': escape[1] = '"'; break;
+                case '\\': escape[1] = '\\'; break;
+                case '\b': escape[1] = 'b'; break;
+                case '\f': escape[1] = 'f'; break;
+                case '\n': escape[1] = 'n'; break;
+                case '\r': escape[1] = 'r'; break;
+                case '\t': escape[1] = 't'; break;
+                default:
+                    {
+                        const char hex_digits[] = "0123456789ABCDEF";
+                        escape[1] = 'u';
+                        escape[2] = '0';
+                        escape[3] = '0';
+                        escape[4] = hex_digits[c >> 4];
+                        escape[5] = hex_digits[c & 0xF];
+                        length = 6;
+                    }
+                    break;
+                }
+
+                body.replace(i, 1, escape, length);
+                i += length - 1;
+            }
         }
+    }
 
-        write_line_break(body_text);
+    void write_json_string(std::string& body, const utility::string_t& value)
+    {
+        body.push_back('"');
+        size_t begin = body.size();
+        append_utf8(body, value);
+        escape_json_string(body, begin);
+        body.push_back('"');
+    }
+
+    void write_json_utf8_string(std::string& body, const std::string& value)
+    {
+        body.push_back('"');
+        size_t begin = body.size();
+        body.append(value);
+        escape_json_string(body, begin);
+        body.push_back('"');
     }
 
 }}} // namespace wa::storage::core
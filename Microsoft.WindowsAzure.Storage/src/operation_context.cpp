@@ -21,11 +21,13 @@
 namespace wa { namespace storage {
 
     client_log_level operation_context::m_global_log_level = client_log_level::log_level_off;
+    size_t operation_context::m_global_log_sampling_interval = 1;
 
     operation_context::operation_context()
         : m_impl(std::make_shared<_operation_context>())
     {
         set_log_level(default_log_level());
+        set_log_sampling_interval(default_log_sampling_interval());
         set_client_request_id(utility::uuid_to_string(utility::new_uuid()));
     }
 
@@ -39,4 +41,14 @@ namespace wa { namespace storage {
         m_global_log_level = log_level;
     }
 
+    size_t operation_context::default_log_sampling_interval()
+    {
+        return m_global_log_sampling_interval;
+    }
+
+    void operation_context::set_default_log_sampling_interval(size_t interval)
+    {
+        m_global_log_sampling_interval = interval;
+    }
+
 }} // namespace wa::storage
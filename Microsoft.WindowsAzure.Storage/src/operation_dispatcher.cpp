@@ -0,0 +1,175 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="operation_dispatcher.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <algorithm>
+
+#include "wascore/operation_dispatcher.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        void set_events(std::vector<pplx::task_completion_event<void>>& events)
+        {
+            for (auto iter = events.begin(); iter != events.end(); ++iter)
+            {
+                iter->set();
+            }
+        }
+    }
+
+    void operation_dispatcher::set_max_concurrent_operations(int value)
+    {
+        std::vector<pplx::task_completion_event<void>> events;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_max_concurrent_operations.store(value);
+            dispatch_waiting(events);
+        }
+
+        set_events(events);
+    }
+
+    dispatch_tag_settings operation_dispatcher::tag_settings(const utility::string_t& tag) const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_tags.find(tag);
+        return iter != m_tags.end() ? iter->second.settings : dispatch_tag_settings();
+    }
+
+    void operation_dispatcher::set_tag_settings(const utility::string_t& tag, const dispatch_tag_settings& value)
+    {
+        std::vector<pplx::task_completion_event<void>> events;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_tags[tag].settings = value;
+            dispatch_waiting(events);
+        }
+
+        set_events(events);
+    }
+
+    pplx::task<void> operation_dispatcher::acquire_async(const utility::string_t& tag)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        tag_state& state = m_tags[tag];
+        if (state.waiting.empty() && state.running == 0)
+        {
+            state.virtual_time = std::max(state.virtual_time, m_virtual_time);
+        }
+
+        // While there is room, no operation can be waiting other than for the quota of its own tag
+        if (state.waiting.empty() && can_start(state))
+        {
+            start(state, std::chrono::microseconds(0));
+            return pplx::task_from_result();
+        }
+
+        waiter value;
+        value.enqueue_time = std::chrono::steady_clock::now();
+        state.waiting.push_back(value);
+        return pplx::create_task(value.event);
+    }
+
+    void operation_dispatcher::release(const utility::string_t& tag)
+    {
+        std::vector<pplx::task_completion_event<void>> events;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            tag_state& state = m_tags[tag];
+            --state.running;
+            --m_running;
+            dispatch_waiting(events);
+        }
+
+        set_events(events);
+    }
+
+    std::map<utility::string_t, dispatch_tag_statistics> operation_dispatcher::statistics() const
+    {
+        std::map<utility::string_t, dispatch_tag_statistics> result;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto iter = m_tags.cbegin(); iter != m_tags.cend(); ++iter)
+        {
+            dispatch_tag_statistics& statistics = result[iter->first];
+            statistics.m_queued_operations = iter->second.waiting.size();
+            statistics.m_running_operations = static_cast<size_t>(iter->second.running);
+            statistics.m_queueing_delay = iter->second.queueing_delay;
+        }
+
+        return result;
+    }
+
+    void operation_dispatcher::reset_statistics()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto iter = m_tags.begin(); iter != m_tags.end(); ++iter)
+        {
+            iter->second.queueing_delay = latency_histogram();
+        }
+    }
+
+    bool operation_dispatcher::can_start(const tag_state& state) const
+    {
+        int max_concurrent_operations = m_max_concurrent_operations.load();
+        if (max_concurrent_operations > 0 && m_running >= max_concurrent_operations)
+        {
+            return false;
+        }
+
+        return state.settings.max_concurrent_operations() == 0 || state.running < state.settings.max_concurrent_operations();
+    }
+
+    void operation_dispatcher::start(tag_state& state, std::chrono::microseconds delay)
+    {
+        ++state.running;
+        ++m_running;
+        m_virtual_time = state.virtual_time;
+        state.virtual_time += 1.0 / state.settings.weight();
+        state.queueing_delay.add(delay);
+    }
+
+    void operation_dispatcher::dispatch_waiting(std::vector<pplx::task_completion_event<void>>& events)
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (;;)
+        {
+            tag_state* next = nullptr;
+            for (auto iter = m_tags.begin(); iter != m_tags.end(); ++iter)
+            {
+                tag_state& state = iter->second;
+                if (!state.waiting.empty() && can_start(state) && (next == nullptr || state.virtual_time < next->virtual_time))
+                {
+                    next = &state;
+                }
+            }
+
+            if (next == nullptr)
+            {
+                return;
+            }
+
+            waiter value = next->waiting.front();
+            next->waiting.pop_front();
+            start(*next, std::chrono::duration_cast<std::chrono::microseconds>(now - value.enqueue_time));
+            events.push_back(value.event);
+        }
+    }
+
+}}} // namespace wa::storage::core
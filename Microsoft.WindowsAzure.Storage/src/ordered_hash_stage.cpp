@@ -0,0 +1,182 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="ordered_hash_stage.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/ordered_hash_stage.h"
+
+namespace wa { namespace storage { namespace core {
+
+    pplx::task<void> ordered_hash_stage::reserve_async(utility::size64_t end_offset)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_canceled || (end_offset <= m_next_offset + m_window_size))
+        {
+            return pplx::task_from_result();
+        }
+
+        reservation pending;
+        pending.end_offset = end_offset;
+        m_reservations.push_back(pending);
+        return pplx::create_task(pending.event);
+    }
+
+    void ordered_hash_stage::add(utility::size64_t offset, range_buffer data)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (m_canceled)
+            {
+                return;
+            }
+
+            m_pending_ranges[offset] = data;
+            if (m_hashing || (offset != m_next_offset))
+            {
+                return;
+            }
+
+            m_hashing = true;
+        }
+
+        // Hashing takes a while for large ranges, so it is not done on the thread that completed the download
+        auto this_pointer = shared_from_this();
+        pplx::create_task([this_pointer] ()
+        {
+            this_pointer->hash_ranges();
+        });
+    }
+
+    pplx::task<std::vector<unsigned char>> ordered_hash_stage::finish_async(utility::size64_t end_offset)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (m_hashing || (m_next_offset < end_offset))
+            {
+                m_end_offset = end_offset;
+                m_finish_event = std::make_shared<pplx::task_completion_event<std::vector<unsigned char>>>();
+                return pplx::create_task(*m_finish_event);
+            }
+        }
+
+        m_hash.close().wait();
+        return pplx::task_from_result(m_hash.hash());
+    }
+
+    void ordered_hash_stage::cancel()
+    {
+        std::vector<pplx::task_completion_event<void>> granted;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_canceled = true;
+            m_pending_ranges.clear();
+            for (auto iter = m_reservations.begin(); iter != m_reservations.end(); ++iter)
+            {
+                granted.push_back(iter->event);
+            }
+
+            m_reservations.clear();
+        }
+
+        for (auto iter = granted.begin(); iter != granted.end(); ++iter)
+        {
+            iter->set();
+        }
+    }
+
+    void ordered_hash_stage::hash_ranges()
+    {
+        for (;;)
+        {
+            range_buffer data;
+            bool has_range = false;
+            std::shared_ptr<pplx::task_completion_event<std::vector<unsigned char>>> finish_event;
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                auto first_range = m_pending_ranges.begin();
+                if (m_canceled || (first_range == m_pending_ranges.end()) || (first_range->first != m_next_offset))
+                {
+                    // The range that comes next has not arrived yet, and whoever adds it starts hashing again
+                    m_hashing = false;
+                    if (!m_canceled && m_finish_event && (m_next_offset >= m_end_offset))
+                    {
+                        finish_event = m_finish_event;
+                        m_finish_event.reset();
+                    }
+                }
+                else
+                {
+                    data = first_range->second;
+                    has_range = true;
+                    m_pending_ranges.erase(first_range);
+                }
+            }
+
+            if (!has_range)
+            {
+                if (finish_event)
+                {
+                    try
+                    {
+                        m_hash.close().wait();
+                        finish_event->set(m_hash.hash());
+                    }
+                    catch (...)
+                    {
+                        finish_event->set_exception(std::current_exception());
+                    }
+                }
+
+                return;
+            }
+
+            const auto& range = data.collection();
+            m_hash.putn(range.data(), range.size()).wait();
+
+            std::vector<pplx::task_completion_event<void>> granted;
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_next_offset += range.size();
+                complete_reservations(granted);
+            }
+
+            for (auto iter = granted.begin(); iter != granted.end(); ++iter)
+            {
+                iter->set();
+            }
+        }
+    }
+
+    void ordered_hash_stage::complete_reservations(std::vector<pplx::task_completion_event<void>>& granted)
+    {
+        auto limit = m_next_offset + m_window_size;
+        auto kept = m_reservations.begin();
+        for (auto iter = m_reservations.begin(); iter != m_reservations.end(); ++iter)
+        {
+            if (iter->end_offset <= limit)
+            {
+                granted.push_back(iter->event);
+            }
+            else
+            {
+                *kept++ = *iter;
+            }
+        }
+
+        m_reservations.erase(kept, m_reservations.end());
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,756 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="page_blob_write_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <list>
+#include <set>
+#include <unordered_map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/constants.h"
+#include "wascore/util.h"
+#include "was/blob.h"
+
+namespace wa { namespace storage {
+
+    struct page_blob_write_cache::shared_state
+    {
+        struct cached_page
+        {
+            std::vector<uint8_t> data;
+            bool is_dirty;
+
+            // The sequence number of the last write to the page
+            uint64_t version;
+
+            // The position of a clean page in the least recently used list
+            std::list<int64_t>::iterator lru_position;
+        };
+
+        struct page_run
+        {
+            int64_t first_page;
+            std::vector<uint8_t> data;
+        };
+
+        // Runs of pages read from the blob, and the number of writes that had been applied when the reads started
+        struct fetch_result
+        {
+            uint64_t write_sequence;
+            std::vector<page_run> runs;
+        };
+
+        // A run of dirty pages being written back, with the version of each page that it holds
+        struct flush_run
+        {
+            int64_t first_page;
+            concurrency::streams::istream source;
+            std::vector<uint64_t> versions;
+        };
+
+        shared_state(const cloud_page_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
+            : blob(blob), condition(condition), options(options), context(context), max_dirty_size(protocol::default_page_cache_max_dirty_size),
+            max_clean_size(protocol::default_page_cache_max_clean_size), flush_interval(protocol::default_page_cache_flush_interval),
+            max_concurrent_writes(protocol::default_max_concurrent_page_writes), dirty_size(0), clean_size(0), write_sequence(0), max_evicted_version(0),
+            is_flush_scheduled(false), is_size_flush_running(false), is_stopped(false), last_write(pplx::task_from_result()), last_flush(pplx::task_from_result()),
+            size_flush(pplx::task_from_result())
+        {
+        }
+
+        static pplx::task<void> ignore_error(pplx::task<void> task)
+        {
+            return task.then([] (pplx::task<void> completed_task)
+            {
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                }
+            });
+        }
+
+        // Data read from the blob is only cached if no page written since the read started has been dropped, as
+        // otherwise the read may have missed that write. Pages written since then that are still cached win anyway.
+        // Must be called with the mutex held.
+        bool can_cache(const fetch_result& result) const
+        {
+            return max_evicted_version <= result.write_sequence;
+        }
+
+        // Must be called with the mutex held
+        void insert_clean_page(int64_t index, const uint8_t* data)
+        {
+            cached_page page;
+            page.data.assign(data, data + protocol::page_size);
+            page.is_dirty = false;
+            page.version = 0;
+            clean_pages.push_front(index);
+            page.lru_position = clean_pages.begin();
+            pages.insert(std::make_pair(index, std::move(page)));
+            clean_size += protocol::page_size;
+        }
+
+        // Must be called with the mutex held
+        void touch(cached_page& page)
+        {
+            if (!page.is_dirty)
+            {
+                clean_pages.splice(clean_pages.begin(), clean_pages, page.lru_position);
+            }
+        }
+
+        // Must be called with the mutex held
+        void evict()
+        {
+            while (clean_size > max_clean_size && !clean_pages.empty())
+            {
+                auto iter = pages.find(clean_pages.back());
+                max_evicted_version = std::max(max_evicted_version, iter->second.version);
+                pages.erase(iter);
+                clean_pages.pop_back();
+                clean_size -= protocol::page_size;
+            }
+        }
+
+        // Must be called with the mutex held, and schedules a flush after the flush interval if there are dirty pages
+        void schedule_flush(std::shared_ptr<shared_state> state)
+        {
+            if (is_flush_scheduled || is_stopped || dirty_pages.empty() || flush_interval.count() <= 0)
+            {
+                return;
+            }
+
+            is_flush_scheduled = true;
+            core::complete_after(flush_interval).then([state] ()
+            {
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->is_flush_scheduled = false;
+                    if (state->is_stopped)
+                    {
+                        return;
+                    }
+                }
+
+                ignore_error(start_flush(state));
+            });
+        }
+
+        static pplx::task<page_run> fetch_async(std::shared_ptr<shared_state> state, int64_t first_page, int64_t page_count)
+        {
+            cloud_page_blob blob(state->blob);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            auto offset = first_page * static_cast<int64_t>(protocol::page_size);
+            auto length = page_count * static_cast<int64_t>(protocol::page_size);
+            return blob.download_range_to_stream_async(buffer.create_ostream(), offset, length, state->condition, state->options, state->context).then([first_page, buffer] () mutable -> page_run
+            {
+                page_run run;
+                run.first_page = first_page;
+                run.data = std::move(buffer.collection());
+                return run;
+            });
+        }
+
+        static pplx::task<fetch_result> fetch_all_async(uint64_t write_sequence, std::vector<pplx::task<page_run>> fetch_tasks)
+        {
+            if (fetch_tasks.empty())
+            {
+                fetch_result result;
+                result.write_sequence = write_sequence;
+                return pplx::task_from_result(result);
+            }
+
+            return pplx::when_all(fetch_tasks.begin(), fetch_tasks.end()).then([write_sequence] (std::vector<page_run> runs) -> fetch_result
+            {
+                fetch_result result;
+                result.write_sequence = write_sequence;
+                result.runs = std::move(runs);
+                return result;
+            });
+        }
+
+        // Reads the pages at the edges of a write that the write only covers a part of, if they are not cached
+        static pplx::task<fetch_result> fetch_edges_async(std::shared_ptr<shared_state> state, const std::vector<int64_t>& edge_pages)
+        {
+            uint64_t write_sequence;
+            std::vector<pplx::task<page_run>> fetch_tasks;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                write_sequence = state->write_sequence;
+                for (auto iter = edge_pages.cbegin(); iter != edge_pages.cend(); ++iter)
+                {
+                    if (state->pages.find(*iter) == state->pages.end())
+                    {
+                        fetch_tasks.push_back(fetch_async(state, *iter, 1));
+                    }
+                }
+            }
+
+            return fetch_all_async(write_sequence, std::move(fetch_tasks));
+        }
+
+        // Must be called with the mutex held, and caches the fetched pages that are not cached yet
+        void insert_fetched_pages(const fetch_result& result)
+        {
+            if (!can_cache(result))
+            {
+                return;
+            }
+
+            for (auto run = result.runs.cbegin(); run != result.runs.cend(); ++run)
+            {
+                for (size_t offset = 0; offset + protocol::page_size <= run->data.size(); offset += protocol::page_size)
+                {
+                    int64_t index = run->first_page + static_cast<int64_t>(offset / protocol::page_size);
+                    if (pages.find(index) == pages.end())
+                    {
+                        insert_clean_page(index, run->data.data() + offset);
+                    }
+                }
+            }
+        }
+
+        static pplx::task<void> apply_write_async(std::shared_ptr<shared_state> state, const fetch_result& fetched, std::shared_ptr<std::vector<uint8_t>> data, int64_t start_offset, std::vector<int64_t> edge_pages)
+        {
+            bool has_edge_pages = true;
+            bool should_flush = false;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                state->insert_fetched_pages(fetched);
+
+                for (auto iter = edge_pages.cbegin(); iter != edge_pages.cend(); ++iter)
+                {
+                    has_edge_pages = has_edge_pages && state->pages.find(*iter) != state->pages.end();
+                }
+
+                if (has_edge_pages)
+                {
+                    state->apply_write(*data, start_offset);
+                    state->evict();
+                    state->schedule_flush(state);
+                    if (state->dirty_size >= state->max_dirty_size && !state->is_size_flush_running)
+                    {
+                        state->is_size_flush_running = true;
+                        should_flush = true;
+                    }
+                }
+            }
+
+            if (should_flush)
+            {
+                auto size_flush = ignore_error(start_flush(state)).then([state] ()
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->is_size_flush_running = false;
+                });
+
+                std::lock_guard<std::mutex> guard(state->mutex);
+                state->size_flush = size_flush;
+            }
+
+            if (has_edge_pages)
+            {
+                return pplx::task_from_result();
+            }
+
+            // An edge page that was read could not be cached because another page was dropped in the meantime, so it is read again
+            return fetch_edges_async(state, edge_pages).then([state, data, start_offset, edge_pages] (fetch_result refetched) -> pplx::task<void>
+            {
+                return apply_write_async(state, refetched, data, start_offset, edge_pages);
+            });
+        }
+
+        // Must be called with the mutex held, once every page that the write only covers a part of is cached
+        void apply_write(const std::vector<uint8_t>& data, int64_t start_offset)
+        {
+            const int64_t page_size = static_cast<int64_t>(protocol::page_size);
+            int64_t end_offset = start_offset + static_cast<int64_t>(data.size());
+            uint64_t version = ++write_sequence;
+            for (int64_t index = start_offset / page_size; index * page_size < end_offset; ++index)
+            {
+                // A page that is not cached is covered by the write as a whole
+                auto iter = pages.find(index);
+                if (iter == pages.end())
+                {
+                    cached_page page;
+                    page.data.resize(protocol::page_size);
+                    page.is_dirty = true;
+                    iter = pages.insert(std::make_pair(index, std::move(page))).first;
+                    dirty_pages.insert(index);
+                    dirty_size += protocol::page_size;
+                }
+                else if (!iter->second.is_dirty)
+                {
+                    iter->second.is_dirty = true;
+                    clean_pages.erase(iter->second.lru_position);
+                    dirty_pages.insert(index);
+                    clean_size -= protocol::page_size;
+                    dirty_size += protocol::page_size;
+                }
+
+                cached_page& page = iter->second;
+                int64_t copy_begin = std::max(start_offset, index * page_size);
+                int64_t copy_end = std::min(end_offset, (index + 1) * page_size);
+                std::copy(data.begin() + static_cast<size_t>(copy_begin - start_offset), data.begin() + static_cast<size_t>(copy_end - start_offset), page.data.begin() + static_cast<size_t>(copy_begin - index * page_size));
+                page.version = version;
+            }
+        }
+
+        static pplx::task<void> write_async(std::shared_ptr<shared_state> state, std::shared_ptr<std::vector<uint8_t>> data, int64_t start_offset)
+        {
+            const int64_t page_size = static_cast<int64_t>(protocol::page_size);
+            int64_t end_offset = start_offset + static_cast<int64_t>(data->size());
+            int64_t first_page = start_offset / page_size;
+            int64_t last_page = (end_offset - 1) / page_size;
+
+            std::vector<int64_t> edge_pages;
+            if ((start_offset % page_size != 0) || (end_offset < (first_page + 1) * page_size))
+            {
+                edge_pages.push_back(first_page);
+            }
+
+            if ((end_offset % page_size != 0) && (edge_pages.empty() || last_page != first_page))
+            {
+                edge_pages.push_back(last_page);
+            }
+
+            // The edge pages are read right away, but the writes are applied in the order they were started
+            auto fetch_task = fetch_edges_async(state, edge_pages);
+            pplx::task_completion_event<void> applied_event;
+            pplx::task<void> previous_write;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                previous_write = state->last_write;
+                state->last_write = pplx::create_task(applied_event);
+            }
+
+            auto applied_task = previous_write.then([fetch_task] () -> pplx::task<fetch_result>
+            {
+                return fetch_task;
+            }).then([state, data, start_offset, edge_pages] (fetch_result fetched) -> pplx::task<void>
+            {
+                return apply_write_async(state, fetched, data, start_offset, edge_pages);
+            });
+            ignore_error(applied_task).then([applied_event] ()
+            {
+                applied_event.set();
+            });
+
+            return applied_task.then([state] () -> pplx::task<void>
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (state->is_size_flush_running && state->dirty_size >= 2 * state->max_dirty_size)
+                {
+                    return state->size_flush;
+                }
+
+                return pplx::task_from_result();
+            });
+        }
+
+        static pplx::task<std::vector<uint8_t>> read_async(std::shared_ptr<shared_state> state, int64_t offset, size_t length)
+        {
+            const int64_t page_size = static_cast<int64_t>(protocol::page_size);
+            int64_t end_offset = offset + static_cast<int64_t>(length);
+            auto result = std::make_shared<std::vector<uint8_t>>(length);
+
+            uint64_t write_sequence;
+            std::vector<pplx::task<page_run>> fetch_tasks;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                write_sequence = state->write_sequence;
+
+                int64_t missing_begin = -1;
+                for (int64_t index = offset / page_size; index * page_size < end_offset; ++index)
+                {
+                    auto iter = state->pages.find(index);
+                    if (iter == state->pages.end())
+                    {
+                        if (missing_begin < 0)
+                        {
+                            missing_begin = index;
+                        }
+
+                        continue;
+                    }
+
+                    if (missing_begin >= 0)
+                    {
+                        fetch_tasks.push_back(fetch_async(state, missing_begin, index - missing_begin));
+                        missing_begin = -1;
+                    }
+
+                    copy_page(iter->second.data.data(), index, offset, *result);
+                    state->touch(iter->second);
+                }
+
+                if (missing_begin >= 0)
+                {
+                    fetch_tasks.push_back(fetch_async(state, missing_begin, (end_offset + page_size - 1) / page_size - missing_begin));
+                }
+            }
+
+            if (fetch_tasks.empty())
+            {
+                return pplx::task_from_result(std::move(*result));
+            }
+
+            return fetch_all_async(write_sequence, std::move(fetch_tasks)).then([state, offset, result] (fetch_result fetched) -> std::vector<uint8_t>
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                bool is_current = state->can_cache(fetched);
+                for (auto run = fetched.runs.cbegin(); run != fetched.runs.cend(); ++run)
+                {
+                    for (size_t run_offset = 0; run_offset + protocol::page_size <= run->data.size(); run_offset += protocol::page_size)
+                    {
+                        // A page written while it was being read is newer than what was read
+                        int64_t index = run->first_page + static_cast<int64_t>(run_offset / protocol::page_size);
+                        auto iter = state->pages.find(index);
+                        if (iter != state->pages.end())
+                        {
+                            copy_page(iter->second.data.data(), index, offset, *result);
+                            state->touch(iter->second);
+                            continue;
+                        }
+
+                        copy_page(run->data.data() + run_offset, index, offset, *result);
+                        if (is_current)
+                        {
+                            state->insert_clean_page(index, run->data.data() + run_offset);
+                        }
+                    }
+                }
+
+                state->evict();
+                return std::move(*result);
+            });
+        }
+
+        // Copies the part of a page that lies in the range read into the result
+        static void copy_page(const uint8_t* page_data, int64_t index, int64_t offset, std::vector<uint8_t>& result)
+        {
+            const int64_t page_size = static_cast<int64_t>(protocol::page_size);
+            int64_t end_offset = offset + static_cast<int64_t>(result.size());
+            int64_t copy_begin = std::max(offset, index * page_size);
+            int64_t copy_end = std::min(end_offset, (index + 1) * page_size);
+            std::copy(page_data + (copy_begin - index * page_size), page_data + (copy_end - index * page_size), result.begin() + static_cast<size_t>(copy_begin - offset));
+        }
+
+        // Flushes run one after another, so that an older run never overwrites a newer one
+        static pplx::task<void> start_flush(std::shared_ptr<shared_state> state)
+        {
+            pplx::task_completion_event<void> flushed_event;
+            pplx::task<void> previous_flush;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                previous_flush = state->last_flush;
+                state->last_flush = pplx::create_task(flushed_event);
+            }
+
+            auto flush_task = previous_flush.then([state] () -> pplx::task<void>
+            {
+                return run_flush(state);
+            });
+            ignore_error(flush_task).then([flushed_event] ()
+            {
+                flushed_event.set();
+            });
+            return flush_task;
+        }
+
+        static pplx::task<void> run_flush(std::shared_ptr<shared_state> state)
+        {
+            // Adjacent dirty pages are written together, up to the largest size of a single write
+            const size_t max_run_pages = protocol::max_page_write_size / protocol::page_size;
+            std::vector<std::shared_ptr<flush_run>> runs;
+            int max_concurrent_writes;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                max_concurrent_writes = state->max_concurrent_writes;
+
+                std::vector<uint8_t> run_data;
+                std::shared_ptr<flush_run> run;
+                int64_t previous_page = -1;
+                for (auto iter = state->dirty_pages.cbegin(); iter != state->dirty_pages.cend(); ++iter)
+                {
+                    if (run == nullptr || *iter != previous_page + 1 || run->versions.size() == max_run_pages)
+                    {
+                        if (run != nullptr)
+                        {
+                            run->source = concurrency::streams::bytestream::open_istream(std::move(run_data));
+                            runs.push_back(run);
+                        }
+
+                        run = std::make_shared<flush_run>();
+                        run->first_page = *iter;
+                        run_data = std::vector<uint8_t>();
+                    }
+
+                    const cached_page& page = state->pages.find(*iter)->second;
+                    run_data.insert(run_data.end(), page.data.begin(), page.data.end());
+                    run->versions.push_back(page.version);
+                    previous_page = *iter;
+                }
+
+                if (run != nullptr)
+                {
+                    run->source = concurrency::streams::bytestream::open_istream(std::move(run_data));
+                    runs.push_back(run);
+                }
+            }
+
+            if (runs.empty())
+            {
+                return pplx::task_from_result();
+            }
+
+            core::async_semaphore write_slots(max_concurrent_writes);
+            auto first_error = std::make_shared<std::exception_ptr>();
+            std::vector<pplx::task<void>> run_tasks;
+            run_tasks.reserve(runs.size());
+            for (auto iter = runs.cbegin(); iter != runs.cend(); ++iter)
+            {
+                auto run = *iter;
+                run_tasks.push_back(write_slots.lock_async().then([state, run] () -> pplx::task<void>
+                {
+                    cloud_page_blob blob(state->blob);
+                    return blob.upload_pages_async(run->source, run->first_page * static_cast<int64_t>(protocol::page_size), utility::string_t(), state->condition, state->options, state->context);
+                }).then([state, run, write_slots, first_error] (pplx::task<void> upload_task) mutable
+                {
+                    write_slots.unlock();
+
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    try
+                    {
+                        upload_task.wait();
+                    }
+                    catch (...)
+                    {
+                        if (*first_error == nullptr)
+                        {
+                            *first_error = std::current_exception();
+                        }
+
+                        return;
+                    }
+
+                    state->mark_clean(*run);
+                }));
+            }
+
+            return pplx::when_all(run_tasks.begin(), run_tasks.end()).then([state, first_error] ()
+            {
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->evict();
+
+                    // Pages that could not be written, or were written again during the flush, are flushed later
+                    state->schedule_flush(state);
+                }
+
+                if (*first_error != nullptr)
+                {
+                    std::rethrow_exception(*first_error);
+                }
+            });
+        }
+
+        // Must be called with the mutex held, and marks the pages of a run that was written clean unless they were written again since
+        void mark_clean(const flush_run& run)
+        {
+            for (size_t i = 0; i < run.versions.size(); ++i)
+            {
+                int64_t index = run.first_page + static_cast<int64_t>(i);
+                auto iter = pages.find(index);
+                if (iter == pages.end() || !iter->second.is_dirty || iter->second.version != run.versions[i])
+                {
+                    continue;
+                }
+
+                iter->second.is_dirty = false;
+                clean_pages.push_front(index);
+                iter->second.lru_position = clean_pages.begin();
+                dirty_pages.erase(index);
+                dirty_size -= protocol::page_size;
+                clean_size += protocol::page_size;
+            }
+        }
+
+        cloud_page_blob blob;
+        access_condition condition;
+        blob_request_options options;
+        operation_context context;
+
+        size_t max_dirty_size;
+        size_t max_clean_size;
+        std::chrono::milliseconds flush_interval;
+        int max_concurrent_writes;
+
+        std::unordered_map<int64_t, cached_page> pages;
+        std::set<int64_t> dirty_pages;
+
+        // The most recently used clean pages are at the front
+        std::list<int64_t> clean_pages;
+        size_t dirty_size;
+        size_t clean_size;
+
+        // Counts the writes applied so far, and tells the latest write to any page that has been dropped
+        uint64_t write_sequence;
+        uint64_t max_evicted_version;
+
+        bool is_flush_scheduled;
+        bool is_size_flush_running;
+        bool is_stopped;
+        pplx::task<void> last_write;
+        pplx::task<void> last_flush;
+        pplx::task<void> size_flush;
+        std::mutex mutex;
+    };
+
+    void page_blob_write_cache::initialize(const cloud_page_blob& blob, const access_condition& condition, const blob_request_options& options, operation_context context)
+    {
+        m_state = std::make_shared<shared_state>(blob, condition, options, context);
+    }
+
+    page_blob_write_cache::~page_blob_write_cache()
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->is_stopped = true;
+    }
+
+    pplx::task<void> page_blob_write_cache::write_async(const uint8_t* data, size_t length, int64_t start_offset)
+    {
+        if (start_offset < 0)
+        {
+            throw std::invalid_argument("start_offset");
+        }
+
+        if (length == 0)
+        {
+            return pplx::task_from_result();
+        }
+
+        auto buffer = std::make_shared<std::vector<uint8_t>>(data, data + length);
+        return shared_state::write_async(m_state, buffer, start_offset);
+    }
+
+    pplx::task<std::vector<uint8_t>> page_blob_write_cache::read_async(int64_t offset, size_t length)
+    {
+        if (offset < 0)
+        {
+            throw std::invalid_argument("offset");
+        }
+
+        if (length == 0)
+        {
+            return pplx::task_from_result(std::vector<uint8_t>());
+        }
+
+        return shared_state::read_async(m_state, offset, length);
+    }
+
+    pplx::task<void> page_blob_write_cache::flush_async()
+    {
+        auto state = m_state;
+        pplx::task<void> last_write;
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            last_write = state->last_write;
+        }
+
+        return last_write.then([state] () -> pplx::task<void>
+        {
+            return shared_state::start_flush(state);
+        });
+    }
+
+    size_t page_blob_write_cache::dirty_size() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->dirty_size;
+    }
+
+    size_t page_blob_write_cache::cached_size() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->dirty_size + m_state->clean_size;
+    }
+
+    size_t page_blob_write_cache::max_dirty_size() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_dirty_size;
+    }
+
+    void page_blob_write_cache::set_max_dirty_size(size_t value)
+    {
+        if (value == 0)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_dirty_size = value;
+    }
+
+    size_t page_blob_write_cache::max_clean_size() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_clean_size;
+    }
+
+    void page_blob_write_cache::set_max_clean_size(size_t value)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_clean_size = value;
+        m_state->evict();
+    }
+
+    std::chrono::milliseconds page_blob_write_cache::flush_interval() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->flush_interval;
+    }
+
+    void page_blob_write_cache::set_flush_interval(std::chrono::milliseconds value)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->flush_interval = value;
+        m_state->schedule_flush(m_state);
+    }
+
+    int page_blob_write_cache::max_concurrent_writes() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_concurrent_writes;
+    }
+
+    void page_blob_write_cache::set_max_concurrent_writes(int value)
+    {
+        if (value < 1)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_concurrent_writes = value;
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,429 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="partition_key_filter.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/partition_key_filter.h"
+#include "was/table.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        enum class filter_token_kind
+        {
+            open,
+            close,
+            string,
+            word,
+            literal,
+            end
+        };
+
+        struct filter_token
+        {
+            filter_token_kind kind;
+            utility::string_t value;
+        };
+
+        // Reads the tokens of a filter, where a string literal is unquoted and any other literal, such as guid'...' or 5L, is kept as written
+        bool tokenize_filter(const utility::string_t& filter, std::vector<filter_token>& tokens)
+        {
+            size_t position = 0;
+            while (position < filter.size())
+            {
+                utility::char_t c = filter[position];
+                if (c == U(' ') || c == U('\t') || c == U('\r') || c == U('\n'))
+                {
+                    ++position;
+                    continue;
+                }
+
+                filter_token token;
+                if (c == U('(') || c == U(')'))
+                {
+                    token.kind = c == U('(') ? filter_token_kind::open : filter_token_kind::close;
+                    ++position;
+                }
+                else
+                {
+                    size_t start = position;
+                    while (position < filter.size() && filter[position] != U(' ') && filter[position] != U('\t') && filter[position] != U('\r') &&
+                        filter[position] != U('\n') && filter[position] != U('(') && filter[position] != U(')') && filter[position] != U('\''))
+                    {
+                        ++position;
+                    }
+
+                    bool is_quoted = position < filter.size() && filter[position] == U('\'');
+                    token.kind = is_quoted ? (position == start ? filter_token_kind::string : filter_token_kind::literal) : filter_token_kind::word;
+                    if (is_quoted)
+                    {
+                        // A quote inside the literal is written twice
+                        bool terminated = false;
+                        utility::string_t value;
+                        ++position;
+                        while (!terminated && position < filter.size())
+                        {
+                            if (filter[position] != U('\''))
+                            {
+                                value.push_back(filter[position++]);
+                            }
+                            else if (position + 1 < filter.size() && filter[position + 1] == U('\''))
+                            {
+                                value.push_back(U('\''));
+                                position += 2;
+                            }
+                            else
+                            {
+                                terminated = true;
+                                ++position;
+                            }
+                        }
+
+                        if (!terminated)
+                        {
+                            return false;
+                        }
+
+                        token.value = token.kind == filter_token_kind::string ? value : filter.substr(start, position - start);
+                    }
+                    else
+                    {
+                        token.value = filter.substr(start, position - start);
+                    }
+                }
+
+                tokens.push_back(std::move(token));
+            }
+
+            filter_token end;
+            end.kind = filter_token_kind::end;
+            tokens.push_back(end);
+            return true;
+        }
+
+        bool is_lower_before(const partition_key_range& left, const partition_key_range& right)
+        {
+            int result = left.lower.compare(right.lower);
+            return result < 0 || (result == 0 && left.lower_inclusive && !right.lower_inclusive);
+        }
+
+        bool is_upper_before(const partition_key_range& left, const partition_key_range& right)
+        {
+            if (!left.has_upper || !right.has_upper)
+            {
+                return left.has_upper && !right.has_upper;
+            }
+
+            int result = left.upper.compare(right.upper);
+            return result < 0 || (result == 0 && !left.upper_inclusive && right.upper_inclusive);
+        }
+
+        bool is_empty(const partition_key_range& range)
+        {
+            if (!range.has_upper)
+            {
+                return false;
+            }
+
+            int result = range.lower.compare(range.upper);
+            return result > 0 || (result == 0 && !(range.lower_inclusive && range.upper_inclusive));
+        }
+
+        // Sorts the ranges and merges the ones that overlap or meet
+        std::vector<partition_key_range> normalize(std::vector<partition_key_range> ranges)
+        {
+            ranges.erase(std::remove_if(ranges.begin(), ranges.end(), is_empty), ranges.end());
+            std::sort(ranges.begin(), ranges.end(), is_lower_before);
+
+            std::vector<partition_key_range> result;
+            for (auto iter = ranges.cbegin(); iter != ranges.cend(); ++iter)
+            {
+                if (!result.empty())
+                {
+                    partition_key_range& last = result.back();
+                    int lower_compare = last.has_upper ? iter->lower.compare(last.upper) : -1;
+                    if (lower_compare < 0 || (lower_compare == 0 && (last.upper_inclusive || iter->lower_inclusive)))
+                    {
+                        if (is_upper_before(last, *iter))
+                        {
+                            last.upper = iter->upper;
+                            last.has_upper = iter->has_upper;
+                            last.upper_inclusive = iter->upper_inclusive;
+                        }
+
+                        continue;
+                    }
+                }
+
+                result.push_back(*iter);
+            }
+
+            return result;
+        }
+
+        std::vector<partition_key_range> unite(std::vector<partition_key_range> left, const std::vector<partition_key_range>& right)
+        {
+            left.insert(left.end(), right.cbegin(), right.cend());
+            return normalize(std::move(left));
+        }
+
+        std::vector<partition_key_range> intersect(const std::vector<partition_key_range>& left, const std::vector<partition_key_range>& right)
+        {
+            std::vector<partition_key_range> result;
+            for (auto left_iter = left.cbegin(); left_iter != left.cend(); ++left_iter)
+            {
+                for (auto right_iter = right.cbegin(); right_iter != right.cend(); ++right_iter)
+                {
+                    partition_key_range range = is_lower_before(*left_iter, *right_iter) ? *right_iter : *left_iter;
+                    const partition_key_range& upper = is_upper_before(*left_iter, *right_iter) ? *left_iter : *right_iter;
+                    range.upper = upper.upper;
+                    range.has_upper = upper.has_upper;
+                    range.upper_inclusive = upper.upper_inclusive;
+                    result.push_back(range);
+                }
+            }
+
+            return normalize(std::move(result));
+        }
+
+        std::vector<partition_key_range> all_partition_keys()
+        {
+            return std::vector<partition_key_range>(1, partition_key_range());
+        }
+
+        // Reads a filter with the precedence of OData, where "not" binds tightest, then "and", then "or". A condition on anything other
+        // than the PartitionKey, and anything under "not", matches every PartitionKey, so the ranges always hold every matching entity.
+        class partition_key_filter_parser
+        {
+        public:
+
+            explicit partition_key_filter_parser(const std::vector<filter_token>& tokens)
+                : m_tokens(tokens), m_position(0), m_failed(false)
+            {
+            }
+
+            std::vector<partition_key_range> parse()
+            {
+                std::vector<partition_key_range> result = parse_or();
+                if (m_failed || current().kind != filter_token_kind::end)
+                {
+                    return all_partition_keys();
+                }
+
+                return result;
+            }
+
+        private:
+
+            const filter_token& current() const
+            {
+                return m_tokens[m_position];
+            }
+
+            bool is_word(const utility::string_t& value) const
+            {
+                return current().kind == filter_token_kind::word && current().value == value;
+            }
+
+            std::vector<partition_key_range> parse_or()
+            {
+                std::vector<partition_key_range> result = parse_and();
+                while (!m_failed && is_word(query_logical_operator::or))
+                {
+                    ++m_position;
+                    result = unite(std::move(result), parse_and());
+                }
+
+                return result;
+            }
+
+            std::vector<partition_key_range> parse_and()
+            {
+                std::vector<partition_key_range> result = parse_not();
+                while (!m_failed && is_word(query_logical_operator::and))
+                {
+                    ++m_position;
+                    result = intersect(result, parse_not());
+                }
+
+                return result;
+            }
+
+            std::vector<partition_key_range> parse_not()
+            {
+                if (is_word(query_logical_operator::not))
+                {
+                    ++m_position;
+                    parse_not();
+                    return all_partition_keys();
+                }
+
+                if (current().kind == filter_token_kind::open)
+                {
+                    ++m_position;
+                    std::vector<partition_key_range> result = parse_or();
+                    if (current().kind != filter_token_kind::close)
+                    {
+                        m_failed = true;
+                        return all_partition_keys();
+                    }
+
+                    ++m_position;
+                    return result;
+                }
+
+                return parse_comparison();
+            }
+
+            std::vector<partition_key_range> parse_comparison()
+            {
+                if (m_position + 2 >= m_tokens.size())
+                {
+                    m_failed = true;
+                    return all_partition_keys();
+                }
+
+                const filter_token& left = m_tokens[m_position];
+                const filter_token& comparison = m_tokens[m_position + 1];
+                const filter_token& right = m_tokens[m_position + 2];
+                if (!is_operand(left) || comparison.kind != filter_token_kind::word || !is_operand(right))
+                {
+                    m_failed = true;
+                    return all_partition_keys();
+                }
+
+                m_position += 3;
+                if (left.kind == filter_token_kind::word && left.value == U("PartitionKey") && right.kind == filter_token_kind::string)
+                {
+                    return get_comparison_ranges(comparison.value, right.value, false);
+                }
+
+                if (right.kind == filter_token_kind::word && right.value == U("PartitionKey") && left.kind == filter_token_kind::string)
+                {
+                    return get_comparison_ranges(comparison.value, left.value, true);
+                }
+
+                return all_partition_keys();
+            }
+
+            static bool is_operand(const filter_token& token)
+            {
+                return token.kind == filter_token_kind::word || token.kind == filter_token_kind::string || token.kind == filter_token_kind::literal;
+            }
+
+            // Returns the PartitionKeys that compare with the value, where a reversed comparison has the value on the left
+            static std::vector<partition_key_range> get_comparison_ranges(const utility::string_t& comparison, const utility::string_t& value, bool is_reversed)
+            {
+                bool is_greater = comparison == (is_reversed ? query_comparison_operator::less_than : query_comparison_operator::greater_than);
+                bool is_greater_or_equal = comparison == (is_reversed ? query_comparison_operator::less_than_or_equal : query_comparison_operator::greater_than_or_equal);
+                bool is_less = comparison == (is_reversed ? query_comparison_operator::greater_than : query_comparison_operator::less_than);
+                bool is_less_or_equal = comparison == (is_reversed ? query_comparison_operator::greater_than_or_equal : query_comparison_operator::less_than_or_equal);
+
+                partition_key_range range;
+                if (comparison == query_comparison_operator::equal)
+                {
+                    range.lower = value;
+                    range.upper = value;
+                    range.has_upper = true;
+                    range.upper_inclusive = true;
+                }
+                else if (is_greater || is_greater_or_equal)
+                {
+                    range.lower = value;
+                    range.lower_inclusive = is_greater_or_equal;
+                }
+                else if (is_less || is_less_or_equal)
+                {
+                    range.upper = value;
+                    range.has_upper = true;
+                    range.upper_inclusive = is_less_or_equal;
+                }
+
+                // Not Equal, and any operator that is not known, leaves every PartitionKey
+                return normalize(std::vector<partition_key_range>(1, range));
+            }
+
+            const std::vector<filter_token>& m_tokens;
+            size_t m_position;
+            bool m_failed;
+        };
+    }
+
+    std::vector<partition_key_range> get_partition_key_ranges(const utility::string_t& filter)
+    {
+        std::vector<filter_token> tokens;
+        if (filter.empty() || !tokenize_filter(filter, tokens))
+        {
+            return all_partition_keys();
+        }
+
+        partition_key_filter_parser parser(tokens);
+        return parser.parse();
+    }
+
+    std::vector<partition_key_range> split_partition_key_ranges(const std::vector<partition_key_range>& ranges, const std::vector<utility::string_t>& partition_key_boundaries)
+    {
+        std::vector<partition_key_range> result;
+        for (auto iter = ranges.cbegin(); iter != ranges.cend(); ++iter)
+        {
+            partition_key_range remaining = *iter;
+            for (auto boundary = partition_key_boundaries.cbegin(); boundary != partition_key_boundaries.cend(); ++boundary)
+            {
+                // A boundary at or before the start of what is left, or after its end, does not split it
+                int upper_compare = remaining.has_upper ? boundary->compare(remaining.upper) : -1;
+                if (boundary->compare(remaining.lower) > 0 && (upper_compare < 0 || (upper_compare == 0 && remaining.upper_inclusive)))
+                {
+                    partition_key_range piece = remaining;
+                    piece.upper = *boundary;
+                    piece.has_upper = true;
+                    piece.upper_inclusive = false;
+                    result.push_back(piece);
+
+                    remaining.lower = *boundary;
+                    remaining.lower_inclusive = true;
+                }
+            }
+
+            result.push_back(remaining);
+        }
+
+        return result;
+    }
+
+    utility::string_t get_partition_key_filter(const partition_key_range& range)
+    {
+        if (range.is_point())
+        {
+            return table_query::generate_filter_condition(U("PartitionKey"), query_comparison_operator::equal, range.lower);
+        }
+
+        utility::string_t filter;
+        if (!range.lower.empty() || !range.lower_inclusive)
+        {
+            filter = table_query::generate_filter_condition(U("PartitionKey"), range.lower_inclusive ? query_comparison_operator::greater_than_or_equal : query_comparison_operator::greater_than, range.lower);
+        }
+
+        if (range.has_upper)
+        {
+            utility::string_t upper_filter = table_query::generate_filter_condition(U("PartitionKey"), range.upper_inclusive ? query_comparison_operator::less_than_or_equal : query_comparison_operator::less_than, range.upper);
+            filter = filter.empty() ? upper_filter : table_query::combine_filter_conditions(filter, query_logical_operator::and, upper_filter);
+        }
+
+        return filter;
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,139 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="partition_tracker.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <algorithm>
+
+#include "wascore/partition_tracker.h"
+#include "wascore/constants.h"
+
+namespace wa { namespace storage { namespace core {
+
+    double partition_tracker::sampling_rate() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_sampling_rate;
+    }
+
+    void partition_tracker::set_sampling_rate(double value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_sampling_rate = value;
+        m_sample_credit = 0.0;
+        if (value == 0.0)
+        {
+            m_entries.clear();
+        }
+    }
+
+    bool partition_tracker::should_sample()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_sampling_rate <= 0.0)
+        {
+            return false;
+        }
+
+        m_sample_credit += m_sampling_rate;
+        if (m_sample_credit < 1.0)
+        {
+            return false;
+        }
+
+        m_sample_credit -= 1.0;
+        return true;
+    }
+
+    void partition_tracker::record(const utility::string_t& table_name, const utility::string_t& partition_key, const request_result& result)
+    {
+        utility::string_t key;
+        key.reserve(table_name.size() + partition_key.size() + 1);
+        key.append(table_name).append(1, U('\n')).append(partition_key);
+
+        bool is_throttled = result.is_response_available() && (result.http_status_code() == web::http::status_codes::ServiceUnavailable || result.http_status_code() == 429);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_entries.find(key);
+        if (iter == m_entries.end())
+        {
+            entry value;
+            value.table_name = table_name;
+            value.partition_key = partition_key;
+            value.operation_count = 0;
+            value.throttled_count = 0;
+            value.total_latency = std::chrono::microseconds(0);
+
+            if (m_entries.size() >= protocol::partition_tracker_capacity)
+            {
+                auto least = std::min_element(m_entries.begin(), m_entries.end(), [] (const std::pair<const utility::string_t, entry>& left, const std::pair<const utility::string_t, entry>& right) -> bool
+                {
+                    return left.second.operation_count < right.second.operation_count;
+                });
+
+                value.operation_count = least->second.operation_count;
+                m_entries.erase(least);
+            }
+
+            iter = m_entries.insert(std::make_pair(key, value)).first;
+        }
+
+        ++iter->second.operation_count;
+        iter->second.throttled_count += is_throttled ? 1 : 0;
+        iter->second.total_latency += result.timings().total_time();
+    }
+
+    std::vector<table_partition_statistics> partition_tracker::hot_partitions(size_t count) const
+    {
+        std::vector<const entry*> entries;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        entries.reserve(m_entries.size());
+        for (auto iter = m_entries.cbegin(); iter != m_entries.cend(); ++iter)
+        {
+            entries.push_back(&iter->second);
+        }
+
+        count = std::min(count, entries.size());
+        std::partial_sort(entries.begin(), entries.begin() + count, entries.end(), [] (const entry* left, const entry* right) -> bool
+        {
+            if (left->operation_count != right->operation_count)
+            {
+                return left->operation_count > right->operation_count;
+            }
+
+            return left->throttled_count > right->throttled_count;
+        });
+
+        std::vector<table_partition_statistics> result;
+        result.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const entry& value = *entries[i];
+            result.push_back(table_partition_statistics(value.table_name, value.partition_key, value.operation_count, value.throttled_count, value.total_latency));
+        }
+
+        return result;
+    }
+
+    void partition_tracker::reset()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_entries.clear();
+    }
+
+}}} // namespace wa::storage::core
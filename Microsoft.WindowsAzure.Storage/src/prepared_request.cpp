@@ -0,0 +1,81 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="prepared_request.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/prepared_request.h"
+#include "wascore/constants.h"
+
+namespace wa { namespace storage { namespace core {
+
+    prepared_request::prepared_request(const web::http::http_request& template_request, std::shared_ptr<protocol::authentication_handler> handler)
+        : m_method(template_request.method()), m_uri(template_request.request_uri()), m_headers(template_request.headers()), m_handler(handler)
+    {
+        if (m_handler)
+        {
+            m_canonicalized_resource = m_handler->canonicalize_resource(template_request);
+        }
+    }
+
+    web::http::http_request prepared_request::create() const
+    {
+        web::http::http_request request(m_method);
+        request.set_request_uri(m_uri);
+        request.headers() = m_headers;
+        return request;
+    }
+
+    void prepared_request::sign(web::http::http_request& request, operation_context context) const
+    {
+        if (!m_handler)
+        {
+            return;
+        }
+
+        if (!m_canonicalized_resource.empty() && request.request_uri() == m_uri)
+        {
+            m_handler->sign_request_with_resource(request, context, m_canonicalized_resource);
+        }
+        else
+        {
+            m_handler->sign_request(request, context);
+        }
+    }
+
+    std::shared_ptr<const prepared_request> prepared_request_cache::find(const utility::string_t& key) const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_requests.find(key);
+        if (iter == m_requests.end())
+        {
+            return nullptr;
+        }
+
+        return iter->second;
+    }
+
+    void prepared_request_cache::add(const utility::string_t& key, std::shared_ptr<const prepared_request> value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_requests.size() >= protocol::prepared_request_cache_size && m_requests.find(key) == m_requests.end())
+        {
+            m_requests.erase(m_requests.begin());
+        }
+
+        m_requests[key] = value;
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,620 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="protocol_json.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include "wascore/constants.h"
+#include "wascore/datetime_codec.h"
+#include "wascore/protocol_json.h"
+#include "wascore/transcode.h"
+#include "wascore/util.h"
+
+namespace wa { namespace storage { namespace protocol {
+
+    namespace
+    {
+        const char odata_prefix[] = "odata.";
+        const char odata_type_suffix[] = "@odata.type";
+        const size_t odata_prefix_length = sizeof(odata_prefix) - 1;
+        const size_t odata_type_suffix_length = sizeof(odata_type_suffix) - 1;
+
+        bool is_odata_member(const std::string& name)
+        {
+            return name.compare(0, odata_prefix_length, odata_prefix) == 0;
+        }
+
+        bool is_type_annotation(const std::string& name)
+        {
+            return name.size() > odata_type_suffix_length && name.compare(name.size() - odata_type_suffix_length, odata_type_suffix_length, odata_type_suffix) == 0;
+        }
+
+        const char* get_property_type_name(edm_type type)
+        {
+            switch (type)
+            {
+            case edm_type::binary:
+                return "Edm.Binary";
+
+            case edm_type::boolean:
+                return "Edm.Boolean";
+
+            case edm_type::datetime:
+                return "Edm.DateTime";
+
+            case edm_type::double_floating_point:
+                return "Edm.Double";
+
+            case edm_type::guid:
+                return "Edm.Guid";
+
+            case edm_type::int32:
+                return "Edm.Int32";
+
+            case edm_type::int64:
+                return "Edm.Int64";
+
+            default: // edm_type::string
+                return "Edm.String";
+            }
+        }
+
+        void append_integer(std::string& body, int64_t value)
+        {
+            // The digits are produced from the end, and the magnitude is kept unsigned so that the smallest value does not overflow
+            char digits[20];
+            size_t count = 0;
+            uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+            do
+            {
+                digits[sizeof(digits) - ++count] = static_cast<char>('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude > 0);
+
+            if (value < 0)
+            {
+                body.push_back('-');
+            }
+
+            body.append(digits + sizeof(digits) - count, count);
+        }
+
+        // Writes a finite double as a JSON number with a fraction or an exponent, so that it is not taken for an integer
+        void append_double(std::string& body, double value)
+        {
+            // Two extra digits of precision are needed to ensure proper rounding
+            char text[32];
+#ifdef WIN32
+            int length = sprintf_s(text, "%.17g", value);
+#else
+            int length = snprintf(text, sizeof(text), "%.17g", value);
+#endif
+            if (length <= 0)
+            {
+                throw std::runtime_error("An error occurred formatting the double.");
+            }
+
+            size_t offset = body.size();
+            body.append(text, static_cast<size_t>(length));
+
+            size_t marker = body.find_first_of(".eE", offset);
+            if (marker == std::string::npos)
+            {
+                body.append(".0");
+            }
+            else if (body[marker] != '.')
+            {
+                body.insert(marker, ".0");
+            }
+        }
+    }
+
+    void table_entity_reader::initialize()
+    {
+        // A query response wraps the entities in the "value" array of the outer object
+        m_entity_depth = m_is_query ? 2 : 0;
+        m_value_member = false;
+        m_in_value_array = false;
+        m_in_entity = false;
+        m_member_count = 0;
+        m_track_property_changes = false;
+        m_property_count_hint = 0;
+        m_property_index = -1;
+        m_type = edm_type::string;
+    }
+
+    void table_entity_reader::handle_begin_object()
+    {
+        if (!m_in_entity && depth() == m_entity_depth && (!m_is_query || m_in_value_array))
+        {
+            m_in_entity = true;
+            m_member_count = 0;
+            m_type_property_name.clear();
+
+            if (m_receiver != nullptr)
+            {
+                m_receiver->begin_entity();
+                return;
+            }
+
+            m_entity = table_entity();
+
+            // Sizing the property map from the previous row avoids rehashing it while the properties are added
+            if (m_property_count_hint > 0)
+            {
+                m_entity.properties().reserve(m_property_count_hint);
+            }
+        }
+    }
+
+    void table_entity_reader::handle_end_object()
+    {
+        if (m_in_entity && depth() == m_entity_depth)
+        {
+            m_in_entity = false;
+            m_property_count_hint = std::max(m_property_count_hint, m_entity.properties().size());
+
+            // Empty objects in a query response are not entities
+            if (m_receiver != nullptr)
+            {
+                if (m_member_count > 0)
+                {
+                    m_receiver->end_entity();
+                }
+            }
+            else if (!m_is_query || m_member_count > 0)
+            {
+                if (m_track_property_changes)
+                {
+                    m_entity.accept_changes();
+                }
+
+                m_entities.push_back(std::move(m_entity));
+            }
+        }
+    }
+
+    void table_entity_reader::handle_begin_array()
+    {
+        if (m_is_query && depth() == 1 && m_value_member)
+        {
+            m_in_value_array = true;
+        }
+    }
+
+    void table_entity_reader::handle_end_array()
+    {
+        if (m_is_query && depth() == 1)
+        {
+            m_in_value_array = false;
+        }
+    }
+
+    void table_entity_reader::handle_key(const core::json::json_string_view& key)
+    {
+        if (m_is_query && depth() == 1)
+        {
+            m_value_member = key.equals("value");
+        }
+        else if (is_entity_member())
+        {
+            m_property_name.assign(key.data(), key.size());
+            ++m_member_count;
+
+            if (is_filtering_properties())
+            {
+                // The index is looked up once per column, and the name at the same position of the next row usually matches
+                size_t position = m_member_count - 1;
+                if (position >= m_property_indexes.size())
+                {
+                    m_property_indexes.resize(position + 1, std::make_pair(std::string(), -1));
+                }
+
+                std::pair<std::string, int>& index = m_property_indexes[position];
+                if (index.first != m_property_name)
+                {
+                    index.first = m_property_name;
+                    index.second = is_regular_property() ? get_property_index() : -1;
+                }
+
+                m_property_index = index.second;
+            }
+        }
+    }
+
+    void table_entity_reader::handle_string(const core::json::json_string_view& value)
+    {
+        if (!is_entity_member())
+        {
+            return;
+        }
+
+        if (is_odata_member(m_property_name))
+        {
+            // The object is a special OData value
+
+            // TODO: if needed use: odata.type, odata.id, odata.editlink
+
+            if (m_property_name.compare(odata_prefix_length, std::string::npos, "etag") == 0)
+            {
+                if (m_receiver != nullptr)
+                {
+                    m_receiver->set_etag(value.to_string());
+                }
+                else if (m_entity.etag().empty())
+                {
+                    m_entity.set_etag(value.to_string());
+                }
+            }
+        }
+        else if (is_type_annotation(m_property_name))
+        {
+            // The object is the type of a property, which precedes the property itself
+            m_type_property_name.assign(m_property_name, 0, m_property_name.size() - odata_type_suffix_length);
+            m_type = get_property_type(value);
+        }
+        else if (m_property_name == "PartitionKey")
+        {
+            if (m_receiver != nullptr)
+            {
+                m_receiver->set_partition_key(value.to_string());
+            }
+            else if (m_entity.partition_key().empty())
+            {
+                m_entity.set_partition_key(value.to_string());
+            }
+        }
+        else if (m_property_name == "RowKey")
+        {
+            if (m_receiver != nullptr)
+            {
+                m_receiver->set_row_key(value.to_string());
+            }
+            else if (m_entity.row_key().empty())
+            {
+                m_entity.set_row_key(value.to_string());
+            }
+        }
+        else if (m_property_name == "Timestamp")
+        {
+            if (m_receiver != nullptr)
+            {
+                m_receiver->set_timestamp(core::parse_datetime(value.to_string()));
+            }
+            else if (!m_entity.timestamp().is_initialized())
+            {
+                m_entity.set_timestamp(core::parse_datetime(value.to_string()));
+            }
+        }
+        else if (!is_skipped_property())
+        {
+            // The type is set to String for consistency unless a specific EDM type was specified, either by the response, the resolver or the receiver
+            entity_property property;
+            property.set_utf8_value(value.to_utf8_string());
+
+            edm_type type = edm_type::string;
+            if (m_property_resolver && m_receiver == nullptr)
+            {
+                type = resolve_property_type(property.str());
+            }
+            else if (m_property_name == m_type_property_name)
+            {
+                type = m_type;
+            }
+            else if (m_receiver != nullptr)
+            {
+                type = m_receiver->property_type(m_property_index);
+            }
+
+            if (type != edm_type::string)
+            {
+                property.set_property_type(type);
+            }
+
+            add_property(std::move(property));
+        }
+    }
+
+    void table_entity_reader::handle_number(const core::json::json_string_view& value, bool is_integer)
+    {
+        if (!is_entity_member() || !is_regular_property() || is_skipped_property())
+        {
+            return;
+        }
+
+        m_number.assign(value.data(), value.size());
+
+        // A receiver or a resolver can ask for a 64-bit integer or a double where the response does not say which one a number is
+        edm_type requested_type = edm_type::string;
+        if (m_receiver != nullptr)
+        {
+            requested_type = m_receiver->property_type(m_property_index);
+        }
+        else if (m_property_resolver)
+        {
+            requested_type = resolve_property_type(value.to_string());
+        }
+
+        entity_property property;
+        if (requested_type == edm_type::int64 && is_integer)
+        {
+            property.set_value(static_cast<int64_t>(std::strtoll(m_number.c_str(), nullptr, 10)));
+            add_property(std::move(property));
+            return;
+        }
+
+        if (is_integer && requested_type != edm_type::double_floating_point)
+        {
+            errno = 0;
+            long long number = std::strtoll(m_number.c_str(), nullptr, 10);
+            if (errno == 0 && number >= std::numeric_limits<int32_t>::min() && number <= std::numeric_limits<int32_t>::max())
+            {
+                property.set_value(static_cast<int32_t>(number));
+                add_property(std::move(property));
+                return;
+            }
+        }
+
+        property.set_value(std::strtod(m_number.c_str(), nullptr));
+        add_property(std::move(property));
+    }
+
+    void table_entity_reader::handle_boolean(bool value)
+    {
+        if (is_entity_member() && is_regular_property() && !is_skipped_property())
+        {
+            entity_property property;
+            property.set_value(value);
+            add_property(std::move(property));
+        }
+    }
+
+    void table_entity_reader::handle_null()
+    {
+        // A receiver is not given null values, so the member keeps its default
+        if (is_entity_member() && is_regular_property() && !is_skipped_property() && m_receiver == nullptr)
+        {
+            add_property(entity_property());
+        }
+    }
+
+    bool table_entity_reader::is_entity_member() const
+    {
+        return m_in_entity && depth() == m_entity_depth + 1;
+    }
+
+    bool table_entity_reader::is_regular_property() const
+    {
+        return !is_odata_member(m_property_name) && !is_type_annotation(m_property_name) &&
+            m_property_name != "PartitionKey" && m_property_name != "RowKey" && m_property_name != "Timestamp";
+    }
+
+    void table_entity_reader::set_projection(const std::vector<utility::string_t>& columns)
+    {
+        m_projection.clear();
+        for (auto iter = columns.cbegin(); iter != columns.cend(); ++iter)
+        {
+            m_projection.push_back(core::to_utf8string(*iter));
+        }
+    }
+
+    bool table_entity_reader::is_filtering_properties() const
+    {
+        return m_receiver != nullptr || !m_projection.empty();
+    }
+
+    bool table_entity_reader::is_skipped_property() const
+    {
+        return is_filtering_properties() && m_property_index < 0;
+    }
+
+    int table_entity_reader::get_property_index() const
+    {
+        if (m_receiver != nullptr)
+        {
+            return m_receiver->property_index(m_property_name);
+        }
+
+        return std::find(m_projection.cbegin(), m_projection.cend(), m_property_name) != m_projection.cend() ? 0 : -1;
+    }
+
+    edm_type table_entity_reader::resolve_property_type(const utility::string_t& value)
+    {
+        return m_property_resolver(m_entity.partition_key(), m_entity.row_key(), property_name(), value);
+    }
+
+    const utility::string_t& table_entity_reader::property_name()
+    {
+        size_t position = m_member_count - 1;
+        if (position >= m_property_names.size())
+        {
+            m_property_names.resize(position + 1);
+        }
+
+        std::pair<std::string, utility::string_t>& name = m_property_names[position];
+        if (name.first != m_property_name)
+        {
+            name.first = m_property_name;
+            name.second = core::to_string_t(m_property_name);
+        }
+
+        return name.second;
+    }
+
+    void table_entity_reader::add_property(entity_property property)
+    {
+        if (m_receiver != nullptr)
+        {
+            m_receiver->set_property(m_property_index, property);
+            return;
+        }
+
+        m_entity.properties().insert(table_entity::property_type(property_name(), std::move(property)));
+    }
+
+    edm_type table_entity_reader::get_property_type(const core::json::json_string_view& type_name)
+    {
+        if (type_name.equals("Edm.Binary"))
+        {
+            return edm_type::binary;
+        }
+        else if (type_name.equals("Edm.Boolean"))
+        {
+            return edm_type::boolean;
+        }
+        else if (type_name.equals("Edm.DateTime"))
+        {
+            return edm_type::datetime;
+        }
+        else if (type_name.equals("Edm.Double"))
+        {
+            return edm_type::double_floating_point;
+        }
+        else if (type_name.equals("Edm.Guid"))
+        {
+            return edm_type::guid;
+        }
+        else if (type_name.equals("Edm.Int32"))
+        {
+            return edm_type::int32;
+        }
+        else if (type_name.equals("Edm.Int64"))
+        {
+            return edm_type::int64;
+        }
+        else
+        {
+            return edm_type::string;
+        }
+    }
+
+    void table_entity_writer::write_entity(std::string& body, const table_entity& entity)
+    {
+        body.append("{\"PartitionKey\":");
+        core::write_json_string(body, entity.partition_key());
+        body.append(",\"RowKey\":");
+        core::write_json_string(body, entity.row_key());
+
+        const table_entity::properties_type& properties = entity.properties();
+        for (table_entity::properties_type::const_iterator itr = properties.cbegin(); itr != properties.cend(); ++itr)
+        {
+            body.push_back(',');
+            write_property(body, itr->first, itr->second);
+        }
+
+        body.push_back('}');
+    }
+
+    void table_entity_writer::write_property(std::string& body, const utility::string_t& name, const entity_property& property)
+    {
+        // Strings, booleans, 32-bit integers and finite doubles are told apart by their JSON values, and the other types are sent as annotated strings
+        edm_type type = property.property_type();
+        switch (type)
+        {
+        case edm_type::string:
+            core::write_json_string(body, name);
+            body.push_back(':');
+            if (property.has_utf8_value())
+            {
+                // A string read from a response is written back without being converted
+                core::write_json_utf8_string(body, property.utf8_value());
+            }
+            else
+            {
+                core::write_json_string(body, property.str());
+            }
+            return;
+
+        case edm_type::boolean:
+            core::write_json_string(body, name);
+            body.push_back(':');
+            body.append((property.has_stored_value(edm_type::boolean) ? property.m_boolean : property.boolean_value()) ? "true" : "false");
+            return;
+
+        case edm_type::int32:
+            core::write_json_string(body, name);
+            body.push_back(':');
+            append_integer(body, property.has_stored_value(edm_type::int32) ? property.m_int32 : property.int32_value());
+            return;
+
+        case edm_type::double_floating_point:
+            {
+                double value = property.has_stored_value(edm_type::double_floating_point) ? property.m_double : property.double_value();
+                if (core::is_finite(value))
+                {
+                    core::write_json_string(body, name);
+                    body.push_back(':');
+                    append_double(body, value);
+                    return;
+                }
+            }
+            break;
+
+        case edm_type::int64:
+            if (property.has_stored_value(edm_type::int64))
+            {
+                write_type_annotation(body, name, type);
+                body.push_back('"');
+                append_integer(body, property.m_int64);
+                body.push_back('"');
+                return;
+            }
+            break;
+
+        case edm_type::binary:
+            if (property.has_stored_value(edm_type::binary))
+            {
+                write_type_annotation(body, name, type);
+                body.push_back('"');
+                core::append_base64(body, property.m_binary.data(), property.m_binary.size());
+                body.push_back('"');
+                return;
+            }
+            break;
+
+        case edm_type::datetime:
+            if (property.has_stored_value(edm_type::datetime))
+            {
+                write_type_annotation(body, name, type);
+                core::write_json_string(body, core::format_iso8601_datetime(utility::datetime() + property.m_datetime));
+                return;
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        // Values without a stored form, such as text that could not be parsed as the type of the property, are sent as they are
+        write_type_annotation(body, name, type);
+        core::write_json_string(body, property.str());
+    }
+
+    void table_entity_writer::write_type_annotation(std::string& body, const utility::string_t& name, edm_type type)
+    {
+        core::write_json_string(body, name);
+        body.insert(body.size() - 1, odata_type_suffix);
+        body.append(":\"");
+        body.append(get_property_type_name(type));
+        body.append("\",");
+        core::write_json_string(body, name);
+        body.push_back(':');
+    }
+
+}}} // namespace wa::storage::protocol
@@ -18,6 +18,8 @@
 #include "stdafx.h"
 #include "wascore/protocol.h"
 #include "wascore/protocol_xml.h"
+#include "wascore/util.h"
+#include "wascore/datetime_codec.h"
 
 namespace wa { namespace storage { namespace protocol {
 
@@ -307,11 +309,27 @@ namespace wa { namespace storage { namespace protocol {
 
             if (element_name == xml_blob)
             {
-                m_blob_items.push_back(cloud_blob_list_item(std::move(m_uri), std::move(m_name), std::move(m_snapshot_time), std::move(metadata), std::move(m_properties), std::move(m_copy_state)));
+                cloud_blob_list_item item(std::move(m_uri), std::move(m_name), std::move(m_snapshot_time), std::move(metadata), std::move(m_properties), std::move(m_copy_state));
+                if (!m_blob_handler)
+                {
+                    m_blob_items.push_back(std::move(item));
+                }
+                else if (!m_blob_handler(item))
+                {
+                    pause();
+                }
             }
             else if (element_name == xml_blob_prefix)
             {
-                m_blob_prefix_items.push_back(cloud_blob_prefix_list_item(std::move(m_uri), std::move(m_name)));
+                cloud_blob_prefix_list_item item(std::move(m_uri), std::move(m_name));
+                if (!m_blob_prefix_handler)
+                {
+                    m_blob_prefix_items.push_back(std::move(item));
+                }
+                else if (!m_blob_prefix_handler(item))
+                {
+                    pause();
+                }
             }
 
             m_properties = cloud_blob_properties();
@@ -319,6 +337,71 @@ namespace wa { namespace storage { namespace protocol {
         }
     }
 
+    void list_blobs_inventory_reader::handle_element(const utility::string_t& element_name)
+    {
+        if (get_parent_element_name() == xml_properties)
+        {
+            if (element_name == xml_content_length)
+            {
+                extract_current_element(m_length);
+                return;
+            }
+
+            if (element_name == xml_last_modified)
+            {
+                m_last_modified = parse_last_modified(get_current_element_text());
+                return;
+            }
+
+            if (element_name == xml_etag)
+            {
+                m_etag = get_current_element_text();
+                return;
+            }
+
+            if (element_name == xml_blob_type)
+            {
+                m_type = blob_response_parsers::parse_blob_type(get_current_element_text());
+                return;
+            }
+
+            if (element_name == xml_content_md5)
+            {
+                m_content_md5 = get_current_element_text();
+                return;
+            }
+
+            return;
+        }
+
+        if (element_name == xml_name && get_parent_element_name() == xml_blob)
+        {
+            m_name = get_current_element_text();
+            return;
+        }
+
+        if (element_name == xml_next_marker)
+        {
+            m_next_marker = get_current_element_text();
+            return;
+        }
+    }
+
+    void list_blobs_inventory_reader::handle_end_element(const utility::string_t& element_name)
+    {
+        if (element_name == xml_blob && get_parent_element_name() == xml_blobs)
+        {
+            m_inventory._add_blob(m_name, m_length, m_last_modified, m_etag, m_type, m_content_md5);
+
+            m_name.clear();
+            m_length = 0;
+            m_last_modified = utility::datetime();
+            m_etag.clear();
+            m_type = blob_type::unspecified;
+            m_content_md5.clear();
+        }
+    }
+
     void page_list_reader::handle_element(const utility::string_t& element_name)
     {
         if (element_name == xml_start && m_start == -1)
@@ -345,6 +428,32 @@ namespace wa { namespace storage { namespace protocol {
         }
     }
 
+    void page_diff_list_reader::handle_element(const utility::string_t& element_name)
+    {
+        if (element_name == xml_start && m_start == -1)
+        {
+            extract_current_element(m_start);
+        }
+        else if (element_name == xml_end && m_end == -1)
+        {
+            extract_current_element(m_end);
+        }
+    }
+
+    void page_diff_list_reader::handle_end_element(const utility::string_t& element_name)
+    {
+        if (m_start != -1 && m_end != -1)
+        {
+            if (element_name == xml_page_range || element_name == xml_clear_range)
+            {
+                page_diff_range range(m_start, m_end, element_name == xml_clear_range);
+                m_page_list.push_back(range);
+                m_start = -1;
+                m_end = -1;
+            }
+        }
+    }
+
     void block_list_reader::handle_begin_element(const utility::string_t& element_name)
     {
         if (element_name == xml_committed_blocks)
@@ -634,15 +743,15 @@ namespace wa { namespace storage { namespace protocol {
         }
         else if (element_name == U("InsertionTime"))
         {
-            m_insertion_time = utility::datetime::from_string(get_current_element_text(), utility::datetime::RFC_1123);
+            m_insertion_time = core::parse_rfc1123_datetime(get_current_element_text());
         }
         else if (element_name == U("ExpirationTime"))
         {
-            m_expiration_time = utility::datetime::from_string(get_current_element_text(), utility::datetime::RFC_1123);
+            m_expiration_time = core::parse_rfc1123_datetime(get_current_element_text());
         }
         else if (element_name == U("TimeNextVisible"))
         {
-            m_next_visible_time = utility::datetime::from_string(get_current_element_text(), utility::datetime::RFC_1123);
+            m_next_visible_time = core::parse_rfc1123_datetime(get_current_element_text());
         }
         else if (element_name == U("DequeueCount"))
         {
@@ -655,13 +764,27 @@ namespace wa { namespace storage { namespace protocol {
     {
         if (element_name == U("QueueMessage"))
         {
-            cloud_message_list_item item(m_content, m_id, m_pop_receipt, m_insertion_time, m_expiration_time, m_next_visible_time, m_dequeue_count);
-            m_items.push_back(item);
+            // The members are reset when the next message starts, so they can be moved into the item
+            m_items.push_back(cloud_message_list_item(std::move(m_content), std::move(m_id), std::move(m_pop_receipt), m_insertion_time, m_expiration_time, m_next_visible_time, m_dequeue_count));
         }
     }
 
     std::string message_writer::write(const cloud_queue_message& message)
     {
+        if (message.m_is_binary)
+        {
+            // Base64 text needs no escaping, so raw data is encoded straight into the body without going through the XML writer
+            const char prefix[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?><QueueMessage><MessageText>";
+            const char suffix[] = "</MessageText></QueueMessage>";
+
+            std::string body;
+            body.reserve(sizeof(prefix) + sizeof(suffix) + (message.m_binary_content.size() + 2) / 3 * 4);
+            body.append(prefix);
+            core::append_base64(body, message.m_binary_content.data(), message.m_binary_content.size());
+            body.append(suffix);
+            return body;
+        }
+
         std::ostringstream outstream;
         initialize(outstream);
 
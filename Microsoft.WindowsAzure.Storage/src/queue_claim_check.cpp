@@ -0,0 +1,172 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="queue_claim_check.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <cstring>
+
+#include "was/queue.h"
+#include "wascore/constants.h"
+#include "wascore/resources.h"
+#include "wascore/transcode.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        // The header of a claim check is "WQ" followed by the version of the encoding, which base64 encodes to "V1EC".
+        // It follows the header of packed messages, which uses version 1.
+        const uint8_t claim_check_header[] = { 0x57, 0x51, 0x02 };
+        const utility::char_t claim_check_encoded_header[] = U("V1EC");
+
+        bool starts_with_header(const std::vector<uint8_t>& content)
+        {
+            return content.size() >= sizeof(claim_check_header) && std::memcmp(content.data(), claim_check_header, sizeof(claim_check_header)) == 0;
+        }
+
+        utility::string_t get_blob_name(const cloud_queue_message& message)
+        {
+            std::vector<uint8_t> content = message.content_as_binary();
+            if (!starts_with_header(content) || content.size() == sizeof(claim_check_header))
+            {
+                throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_claim_check));
+            }
+
+            return core::to_string_t(reinterpret_cast<const char*>(content.data()) + sizeof(claim_check_header), content.size() - sizeof(claim_check_header));
+        }
+    }
+
+    struct queue_claim_check::shared_state
+    {
+        shared_state(const cloud_queue& queue, const cloud_blob_container& container, size_t threshold, const blob_request_options& blob_options)
+            : queue(queue), container(container), threshold(threshold), blob_options(blob_options)
+        {
+        }
+
+        cloud_queue queue;
+        cloud_blob_container container;
+        size_t threshold;
+        blob_request_options blob_options;
+    };
+
+    void queue_claim_check::initialize(const cloud_queue& queue, const cloud_blob_container& container, size_t threshold, const blob_request_options& blob_options)
+    {
+        if (threshold > protocol::max_packed_queue_message_size)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_claim_check_threshold));
+        }
+
+        m_state = std::make_shared<shared_state>(queue, container, threshold, blob_options);
+    }
+
+    size_t queue_claim_check::threshold() const
+    {
+        return m_state->threshold;
+    }
+
+    bool queue_claim_check::is_claim_check(const cloud_queue_message& message)
+    {
+        // The text is checked before it is decoded, so other messages are not decoded twice
+        return message.content_as_string().compare(0, 4, claim_check_encoded_header) == 0;
+    }
+
+    pplx::task<void> queue_claim_check::add_message_async(const std::vector<uint8_t>& content, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, const queue_request_options& options, operation_context context)
+    {
+        auto state = m_state;
+        auto modified_options = std::make_shared<queue_request_options>(options);
+
+        // Small content is added as it is, unless it could be mistaken for a claim check
+        if (content.size() <= state->threshold && !starts_with_header(content))
+        {
+            auto message = std::make_shared<cloud_queue_message>(content);
+            return state->queue.add_message_async(*message, time_to_live, initial_visibility_timeout, *modified_options, context).then([message, modified_options] ()
+            {
+            });
+        }
+
+        auto blob = state->container.get_block_blob_reference(utility::uuid_to_string(utility::new_uuid()));
+        auto source = concurrency::streams::bytestream::open_istream(content);
+        return blob.upload_from_stream_async(source, content.size(), access_condition(), state->blob_options, context).then([state, blob, time_to_live, initial_visibility_timeout, modified_options, context] () -> pplx::task<void>
+        {
+            std::string name = core::to_utf8string(blob.name());
+            std::vector<uint8_t> reference(claim_check_header, claim_check_header + sizeof(claim_check_header));
+            reference.insert(reference.end(), name.cbegin(), name.cend());
+
+            auto message = std::make_shared<cloud_queue_message>(std::move(reference));
+            return state->queue.add_message_async(*message, time_to_live, initial_visibility_timeout, *modified_options, context).then([state, blob, message, modified_options, context] (pplx::task<void> added_task) mutable -> pplx::task<void>
+            {
+                try
+                {
+                    added_task.wait();
+                    return pplx::task_from_result();
+                }
+                catch (...)
+                {
+                    // No message refers to the blob, so it is deleted before the error is passed on
+                    auto error = std::current_exception();
+                    return blob.delete_blob_if_exists_async(delete_snapshots_option::none, access_condition(), state->blob_options, context).then([error] (pplx::task<bool> deleted_task)
+                    {
+                        try
+                        {
+                            deleted_task.wait();
+                        }
+                        catch (...)
+                        {
+                        }
+
+                        std::rethrow_exception(error);
+                    });
+                }
+            });
+        });
+    }
+
+    pplx::task<concurrency::streams::istream> queue_claim_check::open_content_async(const cloud_queue_message& message, operation_context context)
+    {
+        if (!is_claim_check(message))
+        {
+            return pplx::task_from_result(concurrency::streams::bytestream::open_istream(message.content_as_binary()));
+        }
+
+        auto blob = m_state->container.get_block_blob_reference(get_blob_name(message));
+        return blob.open_read_async(access_condition(), m_state->blob_options, context);
+    }
+
+    pplx::task<void> queue_claim_check::delete_message_async(cloud_queue_message& message, const queue_request_options& options, operation_context context)
+    {
+        auto state = m_state;
+        auto modified_options = std::make_shared<queue_request_options>(options);
+        auto deleted_message = std::make_shared<cloud_queue_message>(message);
+        bool has_blob = is_claim_check(message);
+        utility::string_t blob_name = has_blob ? get_blob_name(message) : utility::string_t();
+
+        // The message is deleted first, so that a failure leaves at most a blob that nothing refers to, rather than a message without its content
+        return state->queue.delete_message_async(*deleted_message, *modified_options, context).then([state, deleted_message, modified_options, has_blob, blob_name, context] () -> pplx::task<void>
+        {
+            if (!has_blob)
+            {
+                return pplx::task_from_result();
+            }
+
+            auto blob = state->container.get_block_blob_reference(blob_name);
+            return blob.delete_blob_if_exists_async(delete_snapshots_option::none, access_condition(), state->blob_options, context).then([] (bool)
+            {
+            });
+        });
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,350 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="queue_depth_monitor.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <unordered_map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/queue.h"
+
+namespace wa { namespace storage {
+
+    struct queue_depth_monitor::shared_state
+    {
+        struct tracked_queue
+        {
+            cloud_queue queue;
+            queue_depth_snapshot snapshot;
+            std::chrono::steady_clock::time_point next_refresh;
+
+            // Tells apart the refreshes of a queue that was untracked and tracked again
+            uint64_t generation;
+
+            // Completes when the refresh in flight does, and is only valid while one is
+            pplx::task<void> refresh_task;
+            bool is_refreshing;
+        };
+
+        struct due_refresh
+        {
+            utility::string_t key;
+            uint64_t generation;
+            std::shared_ptr<cloud_queue> queue;
+            pplx::task_completion_event<void> refresh_event;
+        };
+
+        shared_state(int max_concurrent_refreshes, std::chrono::milliseconds min_refresh_interval, std::chrono::milliseconds max_refresh_interval, const queue_request_options& options, operation_context context)
+            : min_refresh_interval(min_refresh_interval), max_refresh_interval(max_refresh_interval), options(options), context(context),
+            tick_interval(std::min(min_refresh_interval, protocol::lease_keeper_tick_interval)), next_generation(0), is_timer_running(false), is_stopped(false),
+            refreshes(max_concurrent_refreshes)
+        {
+        }
+
+        static utility::string_t get_key(const cloud_queue& queue)
+        {
+            return queue.uri().primary_uri().to_string();
+        }
+
+        // Must be called with the mutex held, and returns true if the caller has to start the timer
+        bool should_start_timer()
+        {
+            if (is_timer_running || is_stopped || queues.empty())
+            {
+                return false;
+            }
+
+            is_timer_running = true;
+            return true;
+        }
+
+        // Must be called with the mutex held
+        void take_due_refresh(const utility::string_t& key, tracked_queue& tracked, std::vector<due_refresh>& due_refreshes)
+        {
+            due_refresh refresh;
+            refresh.key = key;
+            refresh.generation = tracked.generation;
+
+            // The request updates the queue object it is sent for, so every refresh gets a copy of its own
+            refresh.queue = std::make_shared<cloud_queue>(tracked.queue);
+            tracked.refresh_task = pplx::create_task(refresh.refresh_event);
+            tracked.is_refreshing = true;
+            due_refreshes.push_back(std::move(refresh));
+        }
+
+        static void run_timer(std::shared_ptr<shared_state> state)
+        {
+            pplx::details::do_while([state] () -> pplx::task<bool>
+            {
+                return core::complete_after(state->tick_interval).then([state] () -> bool
+                {
+                    std::vector<due_refresh> due_refreshes;
+                    bool keep_running;
+
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        auto now = std::chrono::steady_clock::now();
+                        for (auto iter = state->queues.begin(); iter != state->queues.end(); ++iter)
+                        {
+                            if (!iter->second.is_refreshing && iter->second.next_refresh <= now)
+                            {
+                                state->take_due_refresh(iter->first, iter->second, due_refreshes);
+                            }
+                        }
+
+                        keep_running = !state->is_stopped && !state->queues.empty();
+                        state->is_timer_running = keep_running;
+                    }
+
+                    for (auto iter = due_refreshes.begin(); iter != due_refreshes.end(); ++iter)
+                    {
+                        refresh_async(state, *iter);
+                    }
+
+                    return keep_running;
+                });
+            }).then([] (bool)
+            {
+            });
+        }
+
+        static void refresh_async(std::shared_ptr<shared_state> state, const due_refresh& refresh)
+        {
+            state->refreshes.lock_async().then([state, refresh] () -> pplx::task<void>
+            {
+                return refresh.queue->download_attributes_async(state->options, state->context);
+            }).then([state, refresh] (pplx::task<void> refreshed_task)
+            {
+                state->refreshes.unlock();
+
+                std::exception_ptr error;
+                try
+                {
+                    refreshed_task.wait();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                bool is_changed = false;
+                queue_depth_snapshot snapshot;
+                std::function<void (const queue_depth_snapshot&)> callback;
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    auto iter = state->queues.find(refresh.key);
+                    if (iter != state->queues.end() && iter->second.generation == refresh.generation)
+                    {
+                        tracked_queue& tracked = iter->second;
+                        tracked.is_refreshing = false;
+                        tracked.snapshot.m_error = error;
+
+                        // A failed refresh backs off like one that found the same depth
+                        auto interval = std::min(tracked.snapshot.m_refresh_interval * 2, state->max_refresh_interval);
+                        if (!error)
+                        {
+                            int count = refresh.queue->approximate_message_count();
+                            is_changed = count != tracked.snapshot.m_approximate_message_count;
+                            if (is_changed)
+                            {
+                                interval = state->min_refresh_interval;
+                            }
+
+                            if (tracked.snapshot.m_approximate_message_count >= 0)
+                            {
+                                tracked.snapshot.m_previous_message_count = tracked.snapshot.m_approximate_message_count;
+                            }
+
+                            tracked.snapshot.m_approximate_message_count = count;
+                            tracked.snapshot.m_refreshed_time = utility::datetime::utc_now();
+                        }
+
+                        tracked.snapshot.m_refresh_interval = interval;
+                        tracked.next_refresh = std::chrono::steady_clock::now() + interval;
+                        snapshot = tracked.snapshot;
+                        callback = state->is_stopped ? nullptr : state->change_callback;
+                    }
+                }
+
+                if (is_changed && callback)
+                {
+                    try
+                    {
+                        callback(snapshot);
+                    }
+                    catch (...)
+                    {
+                        // A failing callback must not stop the queue from being refreshed
+                    }
+                }
+
+                refresh.refresh_event.set();
+            });
+        }
+
+        std::chrono::milliseconds min_refresh_interval;
+        std::chrono::milliseconds max_refresh_interval;
+        queue_request_options options;
+        operation_context context;
+        std::chrono::milliseconds tick_interval;
+
+        std::unordered_map<utility::string_t, tracked_queue> queues;
+        std::function<void (const queue_depth_snapshot&)> change_callback;
+        uint64_t next_generation;
+        bool is_timer_running;
+        bool is_stopped;
+        core::async_semaphore refreshes;
+        mutable std::mutex mutex;
+    };
+
+    void queue_depth_monitor::initialize(int max_concurrent_refreshes, std::chrono::milliseconds min_refresh_interval, std::chrono::milliseconds max_refresh_interval, const queue_request_options& options, operation_context context)
+    {
+        if (max_concurrent_refreshes < 1)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_depth_monitor_max_concurrent_refreshes));
+        }
+
+        if (min_refresh_interval < protocol::min_depth_refresh_interval || max_refresh_interval < min_refresh_interval)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_depth_monitor_refresh_interval));
+        }
+
+        m_state = std::make_shared<shared_state>(max_concurrent_refreshes, min_refresh_interval, max_refresh_interval, options, context);
+    }
+
+    queue_depth_monitor::~queue_depth_monitor()
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->is_stopped = true;
+        m_state->queues.clear();
+    }
+
+    void queue_depth_monitor::track(const cloud_queue& queue)
+    {
+        auto key = shared_state::get_key(queue);
+        bool start_timer;
+
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            if (m_state->queues.find(key) != m_state->queues.end())
+            {
+                return;
+            }
+
+            shared_state::tracked_queue tracked;
+            tracked.queue = queue;
+            tracked.snapshot.m_queue_uri = queue.uri().primary_uri();
+            tracked.snapshot.m_refresh_interval = m_state->min_refresh_interval;
+            tracked.next_refresh = std::chrono::steady_clock::now();
+            tracked.generation = ++m_state->next_generation;
+            tracked.refresh_task = pplx::task_from_result();
+            tracked.is_refreshing = false;
+            m_state->queues[key] = tracked;
+
+            start_timer = m_state->should_start_timer();
+        }
+
+        if (start_timer)
+        {
+            shared_state::run_timer(m_state);
+        }
+    }
+
+    void queue_depth_monitor::untrack(const cloud_queue& queue)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->queues.erase(shared_state::get_key(queue));
+    }
+
+    bool queue_depth_monitor::is_tracked(const cloud_queue& queue) const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->queues.find(shared_state::get_key(queue)) != m_state->queues.end();
+    }
+
+    size_t queue_depth_monitor::tracked_count() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->queues.size();
+    }
+
+    queue_depth_snapshot queue_depth_monitor::get_snapshot(const cloud_queue& queue) const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        auto iter = m_state->queues.find(shared_state::get_key(queue));
+        if (iter == m_state->queues.end())
+        {
+            return queue_depth_snapshot();
+        }
+
+        return iter->second.snapshot;
+    }
+
+    std::vector<queue_depth_snapshot> queue_depth_monitor::snapshots() const
+    {
+        std::vector<queue_depth_snapshot> result;
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        result.reserve(m_state->queues.size());
+        for (auto iter = m_state->queues.cbegin(); iter != m_state->queues.cend(); ++iter)
+        {
+            result.push_back(iter->second.snapshot);
+        }
+
+        return result;
+    }
+
+    void queue_depth_monitor::set_change_callback(std::function<void (const queue_depth_snapshot&)> callback)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->change_callback = std::move(callback);
+    }
+
+    pplx::task<void> queue_depth_monitor::refresh_async()
+    {
+        std::vector<shared_state::due_refresh> due_refreshes;
+        std::vector<pplx::task<void>> refresh_tasks;
+
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            for (auto iter = m_state->queues.begin(); iter != m_state->queues.end(); ++iter)
+            {
+                if (!iter->second.is_refreshing)
+                {
+                    m_state->take_due_refresh(iter->first, iter->second, due_refreshes);
+                }
+
+                refresh_tasks.push_back(iter->second.refresh_task);
+            }
+        }
+
+        for (auto iter = due_refreshes.begin(); iter != due_refreshes.end(); ++iter)
+        {
+            shared_state::refresh_async(m_state, *iter);
+        }
+
+        if (refresh_tasks.empty())
+        {
+            return pplx::task_from_result();
+        }
+
+        return pplx::when_all(refresh_tasks.begin(), refresh_tasks.end());
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,97 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="queue_message_deleter.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/async_semaphore.h"
+#include "wascore/resources.h"
+#include "was/queue.h"
+
+namespace wa { namespace storage {
+
+    struct queue_message_deleter::shared_state
+    {
+        shared_state(const cloud_queue& queue, int max_concurrent_deletes, const queue_request_options& options, operation_context context)
+            : queue(queue), options(options), context(context), semaphore(max_concurrent_deletes)
+        {
+        }
+
+        void add_failure(const cloud_queue_message& message, std::exception_ptr error)
+        {
+            std::lock_guard<std::mutex> guard(failures_mutex);
+            failures.push_back(queue_delete_failure(message, error));
+        }
+
+        cloud_queue queue;
+        queue_request_options options;
+        operation_context context;
+        core::async_semaphore semaphore;
+        std::vector<queue_delete_failure> failures;
+        std::mutex failures_mutex;
+    };
+
+    void queue_message_deleter::initialize(const cloud_queue& queue, int max_concurrent_deletes, const queue_request_options& options, operation_context context)
+    {
+        if (max_concurrent_deletes < 1)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_deleter_max_concurrent_deletes));
+        }
+
+        m_state = std::make_shared<shared_state>(queue, max_concurrent_deletes, options, context);
+    }
+
+    pplx::task<void> queue_message_deleter::add_async(const cloud_queue_message& message)
+    {
+        // The request keeps a reference to the message until it completes
+        auto deleted_message = std::make_shared<cloud_queue_message>(message);
+
+        // The returned task completes when the delete may be sent, which holds back callers while all the permitted deletes are in flight
+        auto state = m_state;
+        auto acquired = state->semaphore.lock_async();
+        acquired.then([state, deleted_message] () -> pplx::task<void>
+        {
+            return state->queue.delete_message_async(*deleted_message, state->options, state->context);
+        }).then([state, deleted_message] (pplx::task<void> deleted_task)
+        {
+            try
+            {
+                deleted_task.wait();
+            }
+            catch (...)
+            {
+                state->add_failure(*deleted_message, std::current_exception());
+            }
+
+            state->semaphore.unlock();
+        });
+
+        return acquired;
+    }
+
+    pplx::task<std::vector<queue_delete_failure>> queue_message_deleter::flush_async()
+    {
+        auto state = m_state;
+        return state->semaphore.wait_all_async().then([state] () -> std::vector<queue_delete_failure>
+        {
+            std::vector<queue_delete_failure> failures;
+            std::lock_guard<std::mutex> guard(state->failures_mutex);
+            failures.swap(state->failures);
+            return failures;
+        });
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,344 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="queue_message_lease_keeper.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <unordered_map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/queue.h"
+
+namespace wa { namespace storage {
+
+    struct queue_message_lease_keeper::shared_state
+    {
+        struct tracked_message
+        {
+            // Renewals update the message in place, so a delete that waits for a renewal sees its pop receipt even after the message was untracked
+            std::shared_ptr<cloud_queue_message> message;
+
+            // Tells apart the wheel entries of a message that was released and tracked again
+            uint64_t generation;
+
+            pplx::task<void> renewal_task;
+        };
+
+        struct wheel_entry
+        {
+            utility::string_t message_id;
+            uint64_t generation;
+            uint64_t due_tick;
+        };
+
+        struct due_renewal
+        {
+            utility::string_t message_id;
+            uint64_t generation;
+            std::shared_ptr<cloud_queue_message> message;
+            pplx::task_completion_event<void> renewal_event;
+        };
+
+        shared_state(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+            : queue(queue), visibility_timeout(visibility_timeout), options(options), context(context), renewal_margin(visibility_timeout / 3),
+            wheel(protocol::lease_keeper_wheel_size), start_time(std::chrono::steady_clock::now()), processed_tick(0), next_generation(0),
+            is_timer_running(false), is_stopped(false), renewals(protocol::default_max_concurrent_lease_renewals)
+        {
+        }
+
+        uint64_t get_tick(std::chrono::steady_clock::time_point time) const
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time - start_time).count() / protocol::lease_keeper_tick_interval.count());
+        }
+
+        // Must be called with the mutex held
+        void schedule(const utility::string_t& message_id, uint64_t generation, std::chrono::steady_clock::time_point renewal_time)
+        {
+            wheel_entry entry;
+            entry.message_id = message_id;
+            entry.generation = generation;
+            entry.due_tick = renewal_time > start_time ? std::max(get_tick(renewal_time), processed_tick + 1) : processed_tick + 1;
+            wheel[entry.due_tick % wheel.size()].push_back(std::move(entry));
+        }
+
+        // Must be called with the mutex held, and returns true if the caller has to start the timer
+        bool should_start_timer()
+        {
+            if (is_timer_running || is_stopped || messages.empty())
+            {
+                return false;
+            }
+
+            is_timer_running = true;
+            return true;
+        }
+
+        static void run_timer(std::shared_ptr<shared_state> state)
+        {
+            pplx::details::do_while([state] () -> pplx::task<bool>
+            {
+                return core::complete_after(protocol::lease_keeper_tick_interval).then([state] () -> bool
+                {
+                    std::vector<due_renewal> due_renewals;
+                    bool keep_running;
+
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        uint64_t current_tick = state->get_tick(std::chrono::steady_clock::now());
+
+                        // A timer that fell behind processes every slot it missed, and one pass over the wheel visits all of them
+                        uint64_t last_tick = std::min(current_tick, state->processed_tick + state->wheel.size());
+                        for (uint64_t tick = state->processed_tick + 1; tick <= last_tick; ++tick)
+                        {
+                            std::vector<wheel_entry>& slot = state->wheel[tick % state->wheel.size()];
+                            for (size_t i = 0; i < slot.size();)
+                            {
+                                if (slot[i].due_tick > current_tick)
+                                {
+                                    ++i;
+                                    continue;
+                                }
+
+                                state->take_due_renewal(slot[i], due_renewals);
+                                slot[i] = std::move(slot.back());
+                                slot.pop_back();
+                            }
+                        }
+
+                        state->processed_tick = std::max(state->processed_tick, current_tick);
+                        keep_running = !state->is_stopped && !state->messages.empty();
+                        state->is_timer_running = keep_running;
+                    }
+
+                    for (auto iter = due_renewals.begin(); iter != due_renewals.end(); ++iter)
+                    {
+                        renew_async(state, *iter);
+                    }
+
+                    return keep_running;
+                });
+            }).then([] (bool)
+            {
+            });
+        }
+
+        // Must be called with the mutex held
+        void take_due_renewal(const wheel_entry& entry, std::vector<due_renewal>& due_renewals)
+        {
+            // Entries of messages that have been released since are skipped rather than searched for when the message is released
+            auto iter = messages.find(entry.message_id);
+            if (iter == messages.end() || iter->second.generation != entry.generation)
+            {
+                return;
+            }
+
+            due_renewal renewal;
+            renewal.message_id = entry.message_id;
+            renewal.generation = entry.generation;
+            renewal.message = iter->second.message;
+            iter->second.renewal_task = pplx::create_task(renewal.renewal_event);
+            due_renewals.push_back(std::move(renewal));
+        }
+
+        static void renew_async(std::shared_ptr<shared_state> state, const due_renewal& renewal)
+        {
+            std::shared_ptr<cloud_queue_message> renewed_message;
+
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                renewed_message = std::make_shared<cloud_queue_message>(*renewal.message);
+            }
+
+            auto start_time = std::chrono::steady_clock::now();
+            state->renewals.lock_async().then([state, renewed_message] () -> pplx::task<void>
+            {
+                return state->queue.update_message_async(*renewed_message, state->visibility_timeout, /* update_content */ false, state->options, state->context);
+            }).then([state, renewal, renewed_message, start_time] (pplx::task<void> renewed_task)
+            {
+                state->renewals.unlock();
+
+                bool is_renewed = true;
+                try
+                {
+                    renewed_task.wait();
+                }
+                catch (...)
+                {
+                    is_renewed = false;
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    if (is_renewed)
+                    {
+                        *renewal.message = *renewed_message;
+                    }
+
+                    auto iter = state->messages.find(renewal.message_id);
+                    if (iter != state->messages.end() && iter->second.generation == renewal.generation)
+                    {
+                        if (is_renewed)
+                        {
+                            // The service started the new visibility timeout after the request was sent, so measuring from then is on the safe side
+                            state->schedule(renewal.message_id, renewal.generation, start_time + state->visibility_timeout - state->renewal_margin);
+                        }
+                        else
+                        {
+                            state->messages.erase(iter);
+                        }
+                    }
+                }
+
+                renewal.renewal_event.set();
+            });
+        }
+
+        cloud_queue queue;
+        std::chrono::seconds visibility_timeout;
+        queue_request_options options;
+        operation_context context;
+        std::chrono::seconds renewal_margin;
+
+        std::unordered_map<utility::string_t, tracked_message> messages;
+        std::vector<std::vector<wheel_entry>> wheel;
+        std::chrono::steady_clock::time_point start_time;
+        uint64_t processed_tick;
+        uint64_t next_generation;
+        bool is_timer_running;
+        bool is_stopped;
+        core::async_semaphore renewals;
+        mutable std::mutex mutex;
+    };
+
+    void queue_message_lease_keeper::initialize(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+    {
+        if (visibility_timeout < protocol::min_lease_keeper_visibility_timeout || visibility_timeout.count() > 604800LL)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_lease_keeper_visibility_timeout));
+        }
+
+        m_state = std::make_shared<shared_state>(queue, visibility_timeout, options, context);
+    }
+
+    queue_message_lease_keeper::~queue_message_lease_keeper()
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->is_stopped = true;
+        m_state->messages.clear();
+    }
+
+    void queue_message_lease_keeper::track(const cloud_queue_message& message)
+    {
+        if (message.id().empty() || message.pop_receipt().empty())
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_lease_keeper_message_without_receipt));
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::seconds remaining_time = m_state->visibility_timeout;
+        if (message.next_visibile_time().is_initialized())
+        {
+            remaining_time = std::chrono::seconds(message.next_visibile_time() - utility::datetime::utc_now());
+        }
+
+        bool start_timer;
+
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+
+            shared_state::tracked_message tracked;
+            tracked.message = std::make_shared<cloud_queue_message>(message);
+            tracked.generation = ++m_state->next_generation;
+            tracked.renewal_task = pplx::task_from_result();
+            m_state->messages[message.id()] = tracked;
+
+            m_state->schedule(message.id(), tracked.generation, now + remaining_time - m_state->renewal_margin);
+            start_timer = m_state->should_start_timer();
+        }
+
+        if (start_timer)
+        {
+            shared_state::run_timer(m_state);
+        }
+    }
+
+    void queue_message_lease_keeper::release(const utility::string_t& message_id)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->messages.erase(message_id);
+    }
+
+    bool queue_message_lease_keeper::is_tracked(const utility::string_t& message_id) const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->messages.find(message_id) != m_state->messages.end();
+    }
+
+    size_t queue_message_lease_keeper::tracked_count() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->messages.size();
+    }
+
+    cloud_queue_message queue_message_lease_keeper::get_message(const utility::string_t& message_id) const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        auto iter = m_state->messages.find(message_id);
+        if (iter == m_state->messages.end())
+        {
+            return cloud_queue_message();
+        }
+
+        return *iter->second.message;
+    }
+
+    pplx::task<void> queue_message_lease_keeper::delete_message_async(const utility::string_t& message_id)
+    {
+        std::shared_ptr<cloud_queue_message> message;
+        pplx::task<void> renewal_task;
+
+        {
+            std::lock_guard<std::mutex> guard(m_state->mutex);
+            auto iter = m_state->messages.find(message_id);
+            if (iter == m_state->messages.end())
+            {
+                throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_lease_keeper_untracked_message));
+            }
+
+            message = iter->second.message;
+            renewal_task = iter->second.renewal_task;
+            m_state->messages.erase(iter);
+        }
+
+        auto state = m_state;
+        return renewal_task.then([state, message] () -> pplx::task<void>
+        {
+            std::shared_ptr<cloud_queue_message> deleted_message;
+
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                deleted_message = std::make_shared<cloud_queue_message>(*message);
+            }
+
+            return state->queue.delete_message_async(*deleted_message, state->options, state->context).then([deleted_message] ()
+            {
+            });
+        });
+    }
+
+}} // namespace wa::storage
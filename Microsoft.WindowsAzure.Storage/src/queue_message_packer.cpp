@@ -0,0 +1,201 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="queue_message_packer.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <cstring>
+#include <mutex>
+
+#include "was/queue.h"
+#include "wascore/constants.h"
+#include "wascore/resources.h"
+#include "wascore/transcode.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        // The header of an envelope is "WQ" followed by the version of the encoding, which base64 encodes to "V1EB"
+        const uint8_t packed_message_header[] = { 0x57, 0x51, 0x01 };
+        const utility::char_t packed_message_encoded_header[] = U("V1EB");
+
+        size_t get_size_prefix_length(size_t size)
+        {
+            size_t length = 1;
+            while (size >= 0x80)
+            {
+                size >>= 7;
+                ++length;
+            }
+
+            return length;
+        }
+
+        void append_size_prefix(std::vector<uint8_t>& target, size_t size)
+        {
+            while (size >= 0x80)
+            {
+                target.push_back(static_cast<uint8_t>(size | 0x80));
+                size >>= 7;
+            }
+
+            target.push_back(static_cast<uint8_t>(size));
+        }
+
+        void unpack_envelope(const std::vector<uint8_t>& envelope, std::vector<std::vector<uint8_t>>& contents)
+        {
+            size_t position = sizeof(packed_message_header);
+            if (envelope.size() < position || std::memcmp(envelope.data(), packed_message_header, position) != 0)
+            {
+                throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_packed_message));
+            }
+
+            while (position < envelope.size())
+            {
+                size_t size = 0;
+                int shift = 0;
+                for (;;)
+                {
+                    if (position == envelope.size() || shift > 28)
+                    {
+                        throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_packed_message));
+                    }
+
+                    uint8_t byte = envelope[position++];
+                    size |= static_cast<size_t>(byte & 0x7F) << shift;
+                    shift += 7;
+                    if ((byte & 0x80) == 0)
+                    {
+                        break;
+                    }
+                }
+
+                if (size > envelope.size() - position)
+                {
+                    throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_packed_message));
+                }
+
+                contents.push_back(std::vector<uint8_t>(envelope.cbegin() + position, envelope.cbegin() + position + size));
+                position += size;
+            }
+        }
+    }
+
+    bool queue_message_packer::try_add(const std::vector<uint8_t>& content)
+    {
+        size_t frame_size = get_size_prefix_length(content.size()) + content.size();
+        if (sizeof(packed_message_header) + frame_size > protocol::max_packed_queue_message_size)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_packed_message_too_large));
+        }
+
+        if (m_envelope.empty())
+        {
+            m_envelope.assign(packed_message_header, packed_message_header + sizeof(packed_message_header));
+        }
+        else if (m_envelope.size() + frame_size > protocol::max_packed_queue_message_size)
+        {
+            return false;
+        }
+
+        append_size_prefix(m_envelope, content.size());
+        m_envelope.insert(m_envelope.end(), content.cbegin(), content.cend());
+        ++m_count;
+        return true;
+    }
+
+    cloud_queue_message queue_message_packer::take_envelope()
+    {
+        if (m_envelope.empty())
+        {
+            m_envelope.assign(packed_message_header, packed_message_header + sizeof(packed_message_header));
+        }
+
+        cloud_queue_message envelope(std::move(m_envelope));
+        m_envelope = std::vector<uint8_t>();
+        m_count = 0;
+        return envelope;
+    }
+
+    struct queue_packed_message::shared_state
+    {
+        cloud_queue_message envelope;
+        std::vector<std::vector<uint8_t>> contents;
+        std::vector<bool> completed;
+        size_t remaining;
+        std::mutex mutex;
+    };
+
+    queue_packed_message::queue_packed_message(cloud_queue_message envelope)
+        : m_state(std::make_shared<shared_state>())
+    {
+        m_state->envelope = std::move(envelope);
+
+        // The text of an envelope is checked before it is decoded, so other messages in the queue are passed on as they are
+        utility::string_t text = m_state->envelope.content_as_string();
+        if (text.compare(0, 4, packed_message_encoded_header) == 0)
+        {
+            unpack_envelope(m_state->envelope.content_as_binary(), m_state->contents);
+        }
+        else
+        {
+            std::string utf8_text = core::to_utf8string(text);
+            m_state->contents.push_back(std::vector<uint8_t>(utf8_text.cbegin(), utf8_text.cend()));
+        }
+
+        m_state->completed.assign(m_state->contents.size(), false);
+        m_state->remaining = m_state->contents.size();
+    }
+
+    const cloud_queue_message& queue_packed_message::envelope() const
+    {
+        return m_state->envelope;
+    }
+
+    size_t queue_packed_message::size() const
+    {
+        return m_state->contents.size();
+    }
+
+    const std::vector<uint8_t>& queue_packed_message::content(size_t index) const
+    {
+        return m_state->contents.at(index);
+    }
+
+    bool queue_packed_message::complete(size_t index)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        if (index >= m_state->completed.size())
+        {
+            throw std::invalid_argument("index");
+        }
+
+        if (m_state->completed[index])
+        {
+            return false;
+        }
+
+        m_state->completed[index] = true;
+        return --m_state->remaining == 0;
+    }
+
+    size_t queue_packed_message::remaining() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->remaining;
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,343 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="queue_message_prefetcher.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <deque>
+
+#include "wascore/resources.h"
+#include "was/queue.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        // Weight of the latest observation in the moving averages of the consumption interval and the request latency
+        const double average_weight = 0.2;
+
+        double to_seconds(std::chrono::steady_clock::duration value)
+        {
+            return std::chrono::duration_cast<std::chrono::duration<double>>(value).count();
+        }
+
+        void update_average(double& average, double value)
+        {
+            average = average <= 0.0 ? value : average + average_weight * (value - average);
+        }
+    }
+
+    struct queue_message_prefetcher::shared_state
+    {
+        struct leased_message
+        {
+            cloud_queue_message message;
+            std::chrono::steady_clock::time_point visibility_end_time;
+        };
+
+        typedef std::vector<std::pair<pplx::task_completion_event<cloud_queue_message>, cloud_queue_message>> completion_list;
+
+        shared_state(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+            : queue(queue), visibility_timeout(visibility_timeout), options(options), context(context),
+            lease_duration(visibility_timeout.count() == 0LL ? protocol::default_queue_visibility_timeout : visibility_timeout),
+            max_buffered_messages(protocol::default_max_prefetched_queue_messages),
+            requested_messages(0), is_queue_empty(false), average_interval(0.0), average_latency(0.0), has_last_request_time(false)
+        {
+            minimum_remaining_visibility = std::min(protocol::default_minimum_remaining_visibility, lease_duration / 2);
+        }
+
+        // Returns the number of messages worth keeping in the buffer. Must be called with the mutex held.
+        size_t target_size() const
+        {
+            if (average_interval <= 0.0 || average_latency <= 0.0)
+            {
+                return std::min(protocol::max_get_messages_count, max_buffered_messages);
+            }
+
+            // Enough messages to last while the next requests are in flight, with room for the consumption rate to change
+            double wanted = 2.0 * average_latency / average_interval + 1.0;
+
+            // More messages than can be consumed before their visibility timeout is about to expire would only be discarded
+            double usable = to_seconds(lease_duration - minimum_remaining_visibility) / average_interval;
+
+            double target = std::min(wanted, usable);
+            if (target < 1.0)
+            {
+                return 1;
+            }
+
+            return target >= static_cast<double>(max_buffered_messages) ? max_buffered_messages : static_cast<size_t>(target);
+        }
+
+        // Returns the number of messages each new request should get. Must be called with the mutex held.
+        std::vector<size_t> collect_requests()
+        {
+            std::vector<size_t> requests;
+
+            // An empty queue is only asked again when somebody is waiting for a message
+            if (is_queue_empty && waiters.empty())
+            {
+                return requests;
+            }
+
+            size_t target = std::max(target_size(), waiters.size());
+            size_t buffered = messages.size() + requested_messages;
+            while (buffered < target)
+            {
+                size_t count = std::min(protocol::max_get_messages_count, target - buffered);
+                requests.push_back(count);
+                requested_messages += count;
+                buffered += count;
+            }
+
+            return requests;
+        }
+
+        static void send_requests(std::shared_ptr<shared_state> state, const std::vector<size_t>& requests)
+        {
+            for (auto iter = requests.cbegin(); iter != requests.cend(); ++iter)
+            {
+                get_messages_async(state, *iter);
+            }
+        }
+
+        static void get_messages_async(std::shared_ptr<shared_state> state, size_t count)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+
+            pplx::task<std::vector<cloud_queue_message>> messages_task;
+            try
+            {
+                messages_task = state->queue.get_messages_async(count, state->visibility_timeout, state->options, state->context);
+            }
+            catch (...)
+            {
+                messages_task = pplx::task_from_exception<std::vector<cloud_queue_message>>(std::current_exception());
+            }
+
+            messages_task.then([state, count, start_time] (pplx::task<std::vector<cloud_queue_message>> completed_task)
+            {
+                completion_list completions;
+                std::vector<pplx::task_completion_event<cloud_queue_message>> failed_waiters;
+                std::exception_ptr error;
+                std::vector<size_t> requests;
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->requested_messages -= count;
+
+                    try
+                    {
+                        std::vector<cloud_queue_message> results = completed_task.get();
+                        update_average(state->average_latency, to_seconds(std::chrono::steady_clock::now() - start_time));
+                        state->is_queue_empty = results.empty();
+
+                        // The service starts the visibility timeout after the request was sent, so measuring from then is on the safe side
+                        leased_message leased;
+                        leased.visibility_end_time = start_time + state->lease_duration;
+                        for (auto iter = results.cbegin(); iter != results.cend(); ++iter)
+                        {
+                            if (!state->waiters.empty())
+                            {
+                                completions.push_back(std::make_pair(state->waiters.front(), *iter));
+                                state->waiters.pop_front();
+                            }
+                            else
+                            {
+                                leased.message = *iter;
+                                state->messages.push_back(leased);
+                            }
+                        }
+
+                        // Waiting consumers are told that the queue is empty once no other request can still bring them a message
+                        if (state->is_queue_empty && state->requested_messages == 0)
+                        {
+                            while (!state->waiters.empty())
+                            {
+                                completions.push_back(std::make_pair(state->waiters.front(), cloud_queue_message()));
+                                state->waiters.pop_front();
+                            }
+                        }
+
+                        requests = state->collect_requests();
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+
+                        // The error is reported to a consumer that waits or else to the next one, rather than retried in the background
+                        if (state->waiters.empty())
+                        {
+                            state->error = error;
+                        }
+                        else
+                        {
+                            failed_waiters.assign(state->waiters.begin(), state->waiters.end());
+                            state->waiters.clear();
+                        }
+                    }
+                }
+
+                send_requests(state, requests);
+
+                for (auto iter = completions.begin(); iter != completions.end(); ++iter)
+                {
+                    iter->first.set(iter->second);
+                }
+
+                for (auto iter = failed_waiters.begin(); iter != failed_waiters.end(); ++iter)
+                {
+                    iter->set_exception(error);
+                }
+            });
+        }
+
+        cloud_queue queue;
+        std::chrono::seconds visibility_timeout;
+        queue_request_options options;
+        operation_context context;
+        std::chrono::seconds lease_duration;
+
+        size_t max_buffered_messages;
+        std::chrono::seconds minimum_remaining_visibility;
+
+        std::deque<leased_message> messages;
+        std::deque<pplx::task_completion_event<cloud_queue_message>> waiters;
+        size_t requested_messages;
+        bool is_queue_empty;
+        std::exception_ptr error;
+
+        double average_interval;
+        double average_latency;
+        std::chrono::steady_clock::time_point last_request_time;
+        bool has_last_request_time;
+        mutable std::mutex mutex;
+    };
+
+    void queue_message_prefetcher::initialize(const cloud_queue& queue, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+    {
+        if (visibility_timeout.count() < 0LL)
+        {
+            throw std::invalid_argument("The visibility timeout cannot be negative.");
+        }
+
+        if (visibility_timeout.count() > 604800LL)
+        {
+            throw std::invalid_argument("The visibility timeout cannot be greater than 604800.");
+        }
+
+        m_state = std::make_shared<shared_state>(queue, visibility_timeout, options, context);
+    }
+
+    pplx::task<cloud_queue_message> queue_message_prefetcher::get_message_async()
+    {
+        auto state = m_state;
+        pplx::task_completion_event<cloud_queue_message> waiter;
+        cloud_queue_message message;
+        bool has_message = false;
+        std::exception_ptr error;
+        std::vector<size_t> requests;
+
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            auto now = std::chrono::steady_clock::now();
+
+            // The time between calls tells how fast the messages are consumed
+            if (state->has_last_request_time)
+            {
+                update_average(state->average_interval, to_seconds(now - state->last_request_time));
+            }
+
+            state->last_request_time = now;
+            state->has_last_request_time = true;
+
+            if (state->error != nullptr)
+            {
+                std::swap(error, state->error);
+            }
+            else
+            {
+                // A message could be received by another consumer while it is still being processed if its visibility timeout is about to expire
+                while (!state->messages.empty() && state->messages.front().visibility_end_time - now < state->minimum_remaining_visibility)
+                {
+                    state->messages.pop_front();
+                }
+
+                if (!state->messages.empty())
+                {
+                    message = state->messages.front().message;
+                    state->messages.pop_front();
+                    has_message = true;
+                }
+                else
+                {
+                    state->waiters.push_back(waiter);
+                }
+
+                requests = state->collect_requests();
+            }
+        }
+
+        if (error != nullptr)
+        {
+            return pplx::task_from_exception<cloud_queue_message>(error);
+        }
+
+        shared_state::send_requests(state, requests);
+
+        if (has_message)
+        {
+            return pplx::task_from_result(message);
+        }
+
+        return pplx::create_task(waiter);
+    }
+
+    size_t queue_message_prefetcher::max_buffered_messages() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->max_buffered_messages;
+    }
+
+    void queue_message_prefetcher::set_max_buffered_messages(size_t value)
+    {
+        if (value == 0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_prefetch_max_buffered_messages));
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->max_buffered_messages = value;
+    }
+
+    std::chrono::seconds queue_message_prefetcher::minimum_remaining_visibility() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->minimum_remaining_visibility;
+    }
+
+    void queue_message_prefetcher::set_minimum_remaining_visibility(std::chrono::seconds value)
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        if (value.count() < 0LL || value >= m_state->lease_duration)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_prefetch_minimum_remaining_visibility));
+        }
+
+        m_state->minimum_remaining_visibility = value;
+    }
+
+}} // namespace wa::storage
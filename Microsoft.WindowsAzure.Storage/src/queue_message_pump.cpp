@@ -0,0 +1,418 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="queue_message_pump.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <algorithm>
+#include <random>
+
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/queue.h"
+
+namespace wa { namespace storage {
+
+    struct queue_message_pump::shared_state
+    {
+        shared_state(const queue_message_pump& pump)
+            : queue(pump.m_queue), handler(pump.m_handler), options(pump.m_options), context(pump.m_context), visibility_timeout(pump.m_visibility_timeout),
+            max_concurrent_handlers(pump.m_max_concurrent_handlers), min_polling_interval(pump.m_min_polling_interval), max_polling_interval(pump.m_max_polling_interval),
+            adaptive_visibility_timeout(pump.m_adaptive_visibility_timeout), visibility_percentile(pump.m_visibility_percentile), visibility_margin(pump.m_visibility_margin),
+            next_processing_time(0), is_running(true), active_handlers(0), empty_polls(0), random_distribution(0.5, 1.0)
+        {
+        }
+
+        // Returns the visibility timeout for the next poll. Must be called with the mutex held.
+        std::chrono::seconds next_visibility_timeout() const
+        {
+            if (!adaptive_visibility_timeout || processing_times.size() < protocol::adaptive_visibility_min_samples)
+            {
+                return visibility_timeout;
+            }
+
+            std::vector<std::chrono::milliseconds::rep> sorted(processing_times);
+            size_t index = static_cast<size_t>(std::ceil(visibility_percentile * static_cast<double>(sorted.size())));
+            index = std::min(std::max(index, static_cast<size_t>(1)), sorted.size()) - 1;
+            std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+
+            std::chrono::seconds::rep timeout = (sorted[index] + 999) / 1000 + visibility_margin.count();
+            return std::chrono::seconds(std::min(std::max(timeout, static_cast<std::chrono::seconds::rep>(1)), static_cast<std::chrono::seconds::rep>(604800)));
+        }
+
+        // Keeps the processing time of a message out of a window of recent ones. Must be called with the mutex held.
+        void record_processing_time(std::chrono::milliseconds value)
+        {
+            if (processing_times.size() < protocol::adaptive_visibility_window_size)
+            {
+                processing_times.push_back(value.count());
+            }
+            else
+            {
+                processing_times[next_processing_time] = value.count();
+                next_processing_time = (next_processing_time + 1) % processing_times.size();
+            }
+        }
+
+        // Returns the time to wait after an empty response. Must be called with the mutex held.
+        std::chrono::milliseconds next_polling_interval()
+        {
+            double interval = static_cast<double>(min_polling_interval.count()) * std::pow(2.0, std::min(empty_polls, 30));
+            interval = std::min(interval, static_cast<double>(max_polling_interval.count()));
+            ++empty_polls;
+
+            // Up to half of the interval is left out at random
+            return std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(interval * random_distribution(random_engine)));
+        }
+
+        // Returns a task that completes with true once a handler is free, or with false once the pump has been stopped
+        static pplx::task<bool> wait_for_handler_async(std::shared_ptr<shared_state> state)
+        {
+            pplx::task_completion_event<void> handler_event;
+
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (!state->is_running || state->active_handlers < state->max_concurrent_handlers)
+                {
+                    return pplx::task_from_result(state->is_running);
+                }
+
+                state->handler_event = pplx::task_completion_event<void>();
+                handler_event = state->handler_event;
+            }
+
+            return pplx::create_task(handler_event).then([state] () -> bool
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                return state->is_running;
+            });
+        }
+
+        static pplx::task<bool> poll_async(std::shared_ptr<shared_state> state)
+        {
+            size_t message_count;
+            std::chrono::seconds visibility_timeout;
+
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                message_count = std::min(protocol::max_get_messages_count, static_cast<size_t>(state->max_concurrent_handlers - state->active_handlers));
+                visibility_timeout = state->next_visibility_timeout();
+            }
+
+            pplx::task<std::vector<cloud_queue_message>> messages_task;
+            try
+            {
+                messages_task = state->queue.get_messages_async(message_count, visibility_timeout, state->options, state->context);
+            }
+            catch (...)
+            {
+                messages_task = pplx::task_from_exception<std::vector<cloud_queue_message>>(std::current_exception());
+            }
+
+            return messages_task.then([state, visibility_timeout] (pplx::task<std::vector<cloud_queue_message>> completed_task) -> pplx::task<bool>
+            {
+                std::vector<cloud_queue_message> messages;
+                try
+                {
+                    messages = completed_task.get();
+                }
+                catch (...)
+                {
+                    // The request has been retried according to the retry policy already, so the pump backs off as if the queue was empty
+                }
+
+                if (messages.empty())
+                {
+                    std::chrono::milliseconds interval;
+                    pplx::task_completion_event<void> stop_event;
+
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        interval = state->next_polling_interval();
+                        stop_event = state->stop_event;
+                    }
+
+                    // Stopping the pump ends the wait early
+                    return (core::complete_after(interval) || pplx::create_task(stop_event)).then([state] () -> bool
+                    {
+                        std::lock_guard<std::mutex> guard(state->mutex);
+                        return state->is_running;
+                    });
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->empty_polls = 0;
+                    state->active_handlers += static_cast<int>(messages.size());
+                }
+
+                for (auto iter = messages.cbegin(); iter != messages.cend(); ++iter)
+                {
+                    run_handler(state, *iter, visibility_timeout);
+                }
+
+                // Messages are arriving again, so the queue is polled as soon as a handler is free
+                return pplx::task_from_result(true);
+            });
+        }
+
+        // Returns a task that renews the message each time a third of its visibility timeout is left, until the handler completes or
+        // a renewal fails. No renewal is in progress once the task completes, so the pop receipt of the message can be used again.
+        static pplx::task<void> renew_until_handled_async(std::shared_ptr<shared_state> state, std::shared_ptr<cloud_queue_message> message, std::chrono::seconds visibility_timeout, pplx::task<void> handled_task)
+        {
+            if (visibility_timeout.count() == 0)
+            {
+                visibility_timeout = protocol::default_queue_visibility_timeout;
+            }
+
+            auto renewal_delay = std::chrono::duration_cast<std::chrono::milliseconds>(visibility_timeout) * 2 / 3;
+            auto is_handled = handled_task.then([] (pplx::task<void>) -> bool
+            {
+                return true;
+            });
+
+            return pplx::details::do_while([state, message, visibility_timeout, renewal_delay, is_handled] () -> pplx::task<bool>
+            {
+                auto is_due = core::complete_after(renewal_delay).then([] () -> bool
+                {
+                    return false;
+                });
+
+                return (is_handled || is_due).then([state, message, visibility_timeout] (bool handled) -> pplx::task<bool>
+                {
+                    if (handled)
+                    {
+                        return pplx::task_from_result(false);
+                    }
+
+                    pplx::task<void> renewal_task;
+                    try
+                    {
+                        renewal_task = state->queue.update_message_async(*message, visibility_timeout, false, state->options, state->context);
+                    }
+                    catch (...)
+                    {
+                        return pplx::task_from_result(false);
+                    }
+
+                    return renewal_task.then([] (pplx::task<void> completed_task) -> bool
+                    {
+                        try
+                        {
+                            completed_task.wait();
+                            return true;
+                        }
+                        catch (...)
+                        {
+                            // The message may have been handled by someone else, so it is not renewed any more
+                            return false;
+                        }
+                    });
+                });
+            }).then([] (bool)
+            {
+            });
+        }
+
+        static void run_handler(std::shared_ptr<shared_state> state, cloud_queue_message message, std::chrono::seconds visibility_timeout)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            pplx::task<void> handled_task;
+            try
+            {
+                handled_task = state->handler(message);
+            }
+            catch (...)
+            {
+                handled_task = pplx::task_from_exception<void>(std::current_exception());
+            }
+
+            // Renewals update the pop receipt of the message, which the handler is not given, so they do not race with it
+            auto current_message = std::make_shared<cloud_queue_message>(message);
+            auto renewal_task = state->adaptive_visibility_timeout ? renew_until_handled_async(state, current_message, visibility_timeout, handled_task) : pplx::task_from_result();
+
+            handled_task.then([state, current_message, renewal_task, start_time] (pplx::task<void> completed_task) -> pplx::task<void>
+            {
+                try
+                {
+                    completed_task.wait();
+                }
+                catch (...)
+                {
+                    // The message is handled again once its visibility timeout expires
+                    return renewal_task;
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->record_processing_time(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time));
+                }
+
+                return renewal_task.then([state, current_message] () -> pplx::task<void>
+                {
+                    return state->queue.delete_message_async(*current_message, state->options, state->context);
+                });
+            }).then([state] (pplx::task<void> deleted_task)
+            {
+                try
+                {
+                    deleted_task.wait();
+                }
+                catch (...)
+                {
+                    // A message that could not be deleted is handled again once its visibility timeout expires
+                }
+
+                pplx::task_completion_event<void> handler_event;
+                pplx::task_completion_event<void> idle_event;
+                bool is_idle;
+
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    --state->active_handlers;
+                    handler_event = state->handler_event;
+                    idle_event = state->idle_event;
+                    is_idle = !state->is_running && state->active_handlers == 0;
+                }
+
+                handler_event.set();
+                if (is_idle)
+                {
+                    idle_event.set();
+                }
+            });
+        }
+
+        cloud_queue queue;
+        handler_type handler;
+        queue_request_options options;
+        operation_context context;
+        std::chrono::seconds visibility_timeout;
+        int max_concurrent_handlers;
+        std::chrono::milliseconds min_polling_interval;
+        std::chrono::milliseconds max_polling_interval;
+        bool adaptive_visibility_timeout;
+        double visibility_percentile;
+        std::chrono::seconds visibility_margin;
+
+        // The processing times of recent messages, in milliseconds
+        std::vector<std::chrono::milliseconds::rep> processing_times;
+        size_t next_processing_time;
+
+        bool is_running;
+        int active_handlers;
+        int empty_polls;
+        pplx::task_completion_event<void> handler_event;
+        pplx::task_completion_event<void> stop_event;
+        pplx::task_completion_event<void> idle_event;
+        std::uniform_real_distribution<> random_distribution;
+        std::default_random_engine random_engine;
+        std::mutex mutex;
+    };
+
+    queue_message_pump::~queue_message_pump()
+    {
+        if (m_state != nullptr)
+        {
+            stop_async();
+        }
+    }
+
+    void queue_message_pump::start()
+    {
+        if (m_state != nullptr)
+        {
+            throw std::logic_error(utility::conversions::to_utf8string(protocol::error_pump_already_started));
+        }
+
+        if (m_visibility_timeout.count() < 0LL)
+        {
+            throw std::invalid_argument("The visibility timeout cannot be negative.");
+        }
+
+        if (m_visibility_timeout.count() > 604800LL)
+        {
+            throw std::invalid_argument("The visibility timeout cannot be greater than 604800.");
+        }
+
+        if (m_max_concurrent_handlers < 1)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_pump_max_concurrent_handlers));
+        }
+
+        if (m_min_polling_interval.count() <= 0 || m_min_polling_interval > m_max_polling_interval)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_pump_polling_interval));
+        }
+
+        if (!(m_visibility_percentile > 0.0 && m_visibility_percentile <= 1.0) || m_visibility_margin.count() < 0LL)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_pump_visibility_percentile));
+        }
+
+        auto state = std::make_shared<shared_state>(*this);
+        m_state = state;
+        m_run_task = pplx::details::do_while([state] () -> pplx::task<bool>
+        {
+            return shared_state::wait_for_handler_async(state).then([state] (bool is_running) -> pplx::task<bool>
+            {
+                if (!is_running)
+                {
+                    return pplx::task_from_result(false);
+                }
+
+                return shared_state::poll_async(state);
+            });
+        }).then([] (bool)
+        {
+        });
+    }
+
+    pplx::task<void> queue_message_pump::stop_async()
+    {
+        auto state = m_state;
+        if (state == nullptr)
+        {
+            return pplx::task_from_result();
+        }
+
+        pplx::task_completion_event<void> handler_event;
+        pplx::task_completion_event<void> stop_event;
+
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            state->is_running = false;
+            handler_event = state->handler_event;
+            stop_event = state->stop_event;
+        }
+
+        // Both the wait for a free handler and the wait before the next poll end right away
+        handler_event.set();
+        stop_event.set();
+
+        return m_run_task.then([state] () -> pplx::task<void>
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (state->active_handlers == 0)
+            {
+                return pplx::task_from_result();
+            }
+
+            return pplx::create_task(state->idle_event);
+        });
+    }
+
+}} // namespace wa::storage
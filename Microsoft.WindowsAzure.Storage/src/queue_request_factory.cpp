@@ -183,7 +183,7 @@ namespace wa { namespace storage { namespace protocol {
         web::http::http_request request = queue_base_request(web::http::methods::POST, uri_builder, timeout, context);
 
         protocol::message_writer writer;
-        std::string content = writer.write(message.content_as_string());
+        std::string content = writer.write(message);
         request.set_body(content);
 
         return request;
@@ -229,7 +229,7 @@ namespace wa { namespace storage { namespace protocol {
         if (update_contents)
         {
             protocol::message_writer writer;
-            std::string content = writer.write(message.content_as_string());
+            std::string content = writer.write(message);
             request.set_body(content);
         }
 
@@ -19,6 +19,7 @@
 #include "was/common.h"
 #include "wascore/protocol_xml.h"
 #include "wascore/constants.h"
+#include "wascore/datetime_codec.h"
 
 namespace wa { namespace storage {
 
@@ -59,7 +60,7 @@ namespace wa { namespace storage {
         utility::string_t request_date;
         if (headers.match(web::http::header_names::date, request_date))
         {
-            m_request_date = utility::datetime::from_string(request_date, utility::datetime::date_format::RFC_1123);
+            m_request_date = core::parse_rfc1123_datetime(request_date);
         }
     }
 
@@ -0,0 +1,197 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="request_tracer.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "was/common.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        std::atomic<uint64_t> last_span_id(0);
+
+        void add_field(web::json::value::field_map& fields, const utility::char_t* name, web::json::value value)
+        {
+            fields.push_back(std::make_pair(web::json::value(utility::string_t(name)), std::move(value)));
+        }
+
+        const utility::char_t* get_category(trace_span_kind kind)
+        {
+            switch (kind)
+            {
+            case trace_span_kind::operation:
+                return U("operation");
+
+            case trace_span_kind::attempt:
+                return U("attempt");
+
+            default:
+                return U("phase");
+            }
+        }
+
+        const utility::char_t* get_location_name(storage_location location)
+        {
+            switch (location)
+            {
+            case storage_location::primary:
+                return U("primary");
+
+            case storage_location::secondary:
+                return U("secondary");
+
+            default:
+                return U("unspecified");
+            }
+        }
+
+        // Where the spans of an operation are shown in the trace
+        struct trace_lane
+        {
+            int process;
+            int thread;
+        };
+    }
+
+    uint64_t request_tracer::_next_span_id()
+    {
+        return ++last_span_id;
+    }
+
+    void chrome_trace_writer::record(const trace_span& span)
+    {
+        pplx::extensibility::scoped_critical_section_t l(m_lock);
+        m_spans.push_back(span);
+    }
+
+    std::vector<trace_span> chrome_trace_writer::spans() const
+    {
+        pplx::extensibility::scoped_critical_section_t l(m_lock);
+        return m_spans;
+    }
+
+    web::json::value chrome_trace_writer::to_json() const
+    {
+        std::vector<trace_span> spans(this->spans());
+
+        std::vector<const trace_span*> operations;
+        for (auto iter = spans.cbegin(); iter != spans.cend(); ++iter)
+        {
+            if (iter->kind() == trace_span_kind::operation)
+            {
+                operations.push_back(&*iter);
+            }
+        }
+
+        std::sort(operations.begin(), operations.end(), [] (const trace_span* left, const trace_span* right)
+        {
+            return left->start_time() < right->start_time();
+        });
+
+        // Each client request ID is a process, and an operation is put on the first thread of its process that is free
+        // by the time it starts, so that the spans on one thread always nest
+        web::json::value::element_vector events;
+        std::map<utility::string_t, int> processes;
+        std::vector<std::vector<std::chrono::steady_clock::time_point>> thread_end_times;
+        std::map<uint64_t, trace_lane> lanes;
+        for (auto iter = operations.cbegin(); iter != operations.cend(); ++iter)
+        {
+            const trace_span& operation = **iter;
+            auto process = processes.find(operation.client_request_id());
+            if (process == processes.end())
+            {
+                process = processes.insert(std::make_pair(operation.client_request_id(), static_cast<int>(processes.size()) + 1)).first;
+                thread_end_times.push_back(std::vector<std::chrono::steady_clock::time_point>());
+
+                web::json::value::field_map args;
+                add_field(args, U("name"), web::json::value(operation.client_request_id()));
+
+                web::json::value::field_map fields;
+                add_field(fields, U("name"), web::json::value(utility::string_t(U("process_name"))));
+                add_field(fields, U("ph"), web::json::value(utility::string_t(U("M"))));
+                add_field(fields, U("pid"), web::json::value(process->second));
+                add_field(fields, U("args"), web::json::value::object(args));
+                events.push_back(web::json::value::object(fields));
+            }
+
+            auto& end_times = thread_end_times[process->second - 1];
+            size_t thread = 0;
+            while (thread < end_times.size() && end_times[thread] > operation.start_time())
+            {
+                ++thread;
+            }
+
+            auto end_time = operation.start_time() + operation.duration();
+            if (thread == end_times.size())
+            {
+                end_times.push_back(end_time);
+            }
+            else
+            {
+                end_times[thread] = end_time;
+            }
+
+            trace_lane lane;
+            lane.process = process->second;
+            lane.thread = static_cast<int>(thread) + 1;
+            lanes[operation.span_id()] = lane;
+        }
+
+        // Spans of operations that have not completed yet are left out, as their lane is not known
+        std::chrono::steady_clock::time_point origin = operations.empty() ? std::chrono::steady_clock::time_point() : operations.front()->start_time();
+        for (auto iter = spans.cbegin(); iter != spans.cend(); ++iter)
+        {
+            auto lane = lanes.find(iter->operation_id());
+            if (lane == lanes.end())
+            {
+                continue;
+            }
+
+            web::json::value::field_map args;
+            add_field(args, U("client_request_id"), web::json::value(iter->client_request_id()));
+            add_field(args, U("span_id"), web::json::value(static_cast<double>(iter->span_id())));
+            add_field(args, U("parent_id"), web::json::value(static_cast<double>(iter->parent_id())));
+            add_field(args, U("location"), web::json::value(utility::string_t(get_location_name(iter->location()))));
+            add_field(args, U("status"), web::json::value(static_cast<int32_t>(iter->http_status_code())));
+
+            auto start = std::chrono::duration_cast<std::chrono::microseconds>(iter->start_time() - origin).count();
+            web::json::value::field_map fields;
+            add_field(fields, U("name"), web::json::value(iter->name()));
+            add_field(fields, U("cat"), web::json::value(utility::string_t(get_category(iter->kind()))));
+            add_field(fields, U("ph"), web::json::value(utility::string_t(U("X"))));
+            add_field(fields, U("ts"), web::json::value(static_cast<double>(start)));
+            add_field(fields, U("dur"), web::json::value(static_cast<double>(iter->duration().count())));
+            add_field(fields, U("pid"), web::json::value(lane->second.process));
+            add_field(fields, U("tid"), web::json::value(lane->second.thread));
+            add_field(fields, U("args"), web::json::value::object(args));
+            events.push_back(web::json::value::object(fields));
+        }
+
+        web::json::value::field_map trace;
+        add_field(trace, U("traceEvents"), web::json::value::array(events));
+        add_field(trace, U("displayTimeUnit"), web::json::value(utility::string_t(U("ms"))));
+        return web::json::value::object(trace);
+    }
+
+    void chrome_trace_writer::clear()
+    {
+        pplx::extensibility::scoped_critical_section_t l(m_lock);
+        m_spans.clear();
+    }
+
+}} // namespace wa::storage
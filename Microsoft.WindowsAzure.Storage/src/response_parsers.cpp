@@ -19,6 +19,7 @@
 #include "wascore/protocol.h"
 #include "wascore/constants.h"
 #include "wascore/resources.h"
+#include "wascore/datetime_codec.h"
 
 namespace wa { namespace storage { namespace protocol {
 
@@ -60,6 +61,14 @@ namespace wa { namespace storage { namespace protocol {
         }
     }
 
+    void check_stream_crc64(const utility::string_t& content_crc64, const core::ostream_descriptor& descriptor)
+    {
+        if (!content_crc64.empty() && !descriptor.content_crc64().empty() && (content_crc64 != descriptor.content_crc64()))
+        {
+            throw storage_exception(utility::conversions::to_utf8string(error_crc64_mismatch));
+        }
+    }
+
     utility::string_t get_header_value(const web::http::http_headers& headers, const utility::string_t& header)
     {
         utility::string_t value;
@@ -79,7 +88,7 @@ namespace wa { namespace storage { namespace protocol {
 
     utility::datetime parse_last_modified(const utility::string_t& value)
     {
-        return utility::datetime::from_string(value, utility::datetime::date_format::RFC_1123);
+        return core::parse_rfc1123_datetime(value);
     }
 
     utility::datetime parse_last_modified(const web::http::http_response& response)
@@ -216,7 +225,7 @@ namespace wa { namespace storage { namespace protocol {
         utility::string_t value;
         if (response.headers().match(ms_header_time_next_visible, value))
         {
-            return utility::datetime::from_string(value, utility::datetime::RFC_1123);
+            return core::parse_rfc1123_datetime(value);
         }
 
         return utility::datetime();
@@ -226,14 +235,14 @@ namespace wa { namespace storage { namespace protocol {
     {
         cloud_metadata metadata;
 
+        const size_t prefix_length = std::char_traits<utility::char_t>::length(ms_header_metadata_prefix);
         auto& headers = response.headers();
         for (auto iter = headers.begin(); iter != headers.end(); ++iter)
         {
-            auto key = iter->first;
-            if ((key.size() > ms_header_metadata_prefix.size()) &&
-                std::equal(ms_header_metadata_prefix.cbegin(), ms_header_metadata_prefix.cend(), key.cbegin()))
+            auto& key = iter->first;
+            if ((key.size() > prefix_length) && (key.compare(0, prefix_length, ms_header_metadata_prefix) == 0))
             {
-                metadata.insert(std::make_pair(key.substr(ms_header_metadata_prefix.size()), iter->second));
+                metadata.insert(std::make_pair(key.substr(prefix_length), iter->second));
             }
         }
 
@@ -0,0 +1,64 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="retry_budget.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/retry_budget.h"
+#include "wascore/constants.h"
+
+namespace wa { namespace storage { namespace core {
+
+    retry_budget::retry_budget()
+        : m_ratio(0.0), m_tokens(protocol::retry_budget_capacity)
+    {
+    }
+
+    double retry_budget::ratio() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_ratio;
+    }
+
+    void retry_budget::set_ratio(double value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_ratio = value;
+    }
+
+    void retry_budget::record_operation()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_tokens = std::min(m_tokens + m_ratio, protocol::retry_budget_capacity);
+    }
+
+    bool retry_budget::try_withdraw()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_ratio <= 0.0)
+        {
+            return true;
+        }
+
+        if (m_tokens < 1.0)
+        {
+            return false;
+        }
+
+        m_tokens -= 1.0;
+        return true;
+    }
+
+}}} // namespace wa::storage::core
@@ -149,4 +149,21 @@ namespace wa { namespace storage {
         return result;
     }
 
+    retry_info basic_decorrelated_jitter_retry_policy::evaluate(const retry_context& retry_context, operation_context context)
+    {
+        auto result = basic_common_retry_policy::evaluate(retry_context, context);
+
+        if (result.should_retry())
+        {
+            std::chrono::milliseconds min_interval(m_delta_backoff);
+            std::chrono::milliseconds max_interval(std::min(m_last_interval * 3, max_exponential_retry_interval));
+            std::uniform_int_distribution<std::chrono::milliseconds::rep> distribution(min_interval.count(), std::max(min_interval, max_interval).count());
+            m_last_interval = std::chrono::milliseconds(distribution(m_rand_engine));
+            result.set_retry_interval(m_last_interval);
+            align_retry_interval(result);
+        }
+
+        return result;
+    }
+
 }} // namespace wa::storage
@@ -0,0 +1,97 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="sas_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/sas_cache.h"
+
+namespace wa { namespace storage { namespace core {
+
+    bool sas_cache::try_get(const utility::string_t& key, utility::string_t& token)
+    {
+        auto now = utility::datetime::utc_now().to_interval();
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_entries.find(key);
+        if (iter == m_entries.end())
+        {
+            return false;
+        }
+
+        if (iter->second.expiry <= now)
+        {
+            m_entries.erase(iter);
+            return false;
+        }
+
+        token = iter->second.token;
+        return true;
+    }
+
+    void sas_cache::add(const utility::string_t& key, const utility::string_t& token, const utility::datetime& expiry)
+    {
+        if (m_max_entries == 0)
+        {
+            return;
+        }
+
+        auto now = utility::datetime::utc_now().to_interval();
+        entry value;
+        value.token = token;
+        value.expiry = expiry.is_initialized() ? expiry.to_interval() : std::numeric_limits<utility::datetime::interval_type>::max();
+        if (value.expiry <= now)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if ((m_entries.size() >= m_max_entries) && (m_entries.find(key) == m_entries.end()))
+        {
+            remove_expired(now);
+            if (m_entries.size() >= m_max_entries)
+            {
+                auto first_to_expire = m_entries.begin();
+                for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+                {
+                    if (iter->second.expiry < first_to_expire->second.expiry)
+                    {
+                        first_to_expire = iter;
+                    }
+                }
+
+                m_entries.erase(first_to_expire);
+            }
+        }
+
+        m_entries[key] = std::move(value);
+    }
+
+    void sas_cache::remove_expired(utility::datetime::interval_type now)
+    {
+        for (auto iter = m_entries.begin(); iter != m_entries.end();)
+        {
+            if (iter->second.expiry <= now)
+            {
+                iter = m_entries.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,182 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="sharded_queue.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <random>
+
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/queue.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        // Weight of the latest poll of a queue in its hit rate
+        const double hit_rate_weight = 0.2;
+
+        // Share of the weight an empty queue keeps, so that messages arriving there are still found
+        const double min_hit_rate = 0.05;
+    }
+
+    struct sharded_queue::shared_state
+    {
+        explicit shared_state(std::vector<cloud_queue> queues)
+            : shards(std::move(queues)), hit_rates(shards.size(), 1.0), next_shard(0), distribution(0.0, 1.0)
+        {
+        }
+
+        size_t choose_shard()
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+
+            double total = 0.0;
+            for (auto iter = hit_rates.cbegin(); iter != hit_rates.cend(); ++iter)
+            {
+                total += std::max(*iter, min_hit_rate);
+            }
+
+            double point = distribution(random_engine) * total;
+            for (size_t i = 0; i < hit_rates.size(); ++i)
+            {
+                point -= std::max(hit_rates[i], min_hit_rate);
+                if (point < 0.0)
+                {
+                    return i;
+                }
+            }
+
+            return hit_rates.size() - 1;
+        }
+
+        void record_poll(size_t index, bool is_hit)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            hit_rates[index] += hit_rate_weight * ((is_hit ? 1.0 : 0.0) - hit_rates[index]);
+        }
+
+        static pplx::task<sharded_queue_result> get_messages_async(std::shared_ptr<shared_state> state, size_t index, size_t remaining_shards, size_t message_count, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+        {
+            queue_request_options request_options(options);
+            return state->shards[index].get_messages_async(message_count, visibility_timeout, request_options, context).then([state, index, remaining_shards, message_count, visibility_timeout, options, context] (std::vector<cloud_queue_message> messages) -> pplx::task<sharded_queue_result>
+            {
+                state->record_poll(index, !messages.empty());
+                if (!messages.empty() || remaining_shards == 0)
+                {
+                    return pplx::task_from_result(sharded_queue_result(state->shards[index], std::move(messages)));
+                }
+
+                // The chosen queue is empty, so the others are tried in turn before reporting that there are no messages
+                return get_messages_async(state, (index + 1) % state->shards.size(), remaining_shards - 1, message_count, visibility_timeout, options, context);
+            });
+        }
+
+        std::vector<cloud_queue> shards;
+        std::vector<double> hit_rates;
+        std::atomic<size_t> next_shard;
+        std::uniform_real_distribution<> distribution;
+        std::default_random_engine random_engine;
+        std::mutex mutex;
+    };
+
+    sharded_queue::sharded_queue(std::vector<cloud_queue> shards)
+    {
+        if (shards.empty())
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_sharded_queue_empty));
+        }
+
+        m_state = std::make_shared<shared_state>(std::move(shards));
+    }
+
+    sharded_queue::sharded_queue(const cloud_queue_client& client, const utility::string_t& name_prefix, size_t shard_count)
+    {
+        if (shard_count == 0)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_sharded_queue_empty));
+        }
+
+        std::vector<cloud_queue> shards;
+        shards.reserve(shard_count);
+        for (size_t i = 0; i < shard_count; ++i)
+        {
+            shards.push_back(client.get_queue_reference(name_prefix + core::convert_to_string(static_cast<int>(i))));
+        }
+
+        m_state = std::make_shared<shared_state>(std::move(shards));
+    }
+
+    const std::vector<cloud_queue>& sharded_queue::shards() const
+    {
+        return m_state->shards;
+    }
+
+    size_t sharded_queue::get_shard_index(const utility::string_t& key) const
+    {
+        // The key is hashed as UTF-8, so producers on platforms with different string types agree on the queue
+        return static_cast<size_t>(core::hash_utf8_key(key) % m_state->shards.size());
+    }
+
+    pplx::task<void> sharded_queue::create_if_not_exists_async(const queue_request_options& options, operation_context context)
+    {
+        std::vector<pplx::task<bool>> tasks;
+        tasks.reserve(m_state->shards.size());
+        for (auto iter = m_state->shards.begin(); iter != m_state->shards.end(); ++iter)
+        {
+            tasks.push_back(iter->create_if_not_exists_async(options, context));
+        }
+
+        return pplx::when_all(tasks.begin(), tasks.end()).then([] (std::vector<bool>)
+        {
+        });
+    }
+
+    pplx::task<void> sharded_queue::delete_if_exists_async(const queue_request_options& options, operation_context context)
+    {
+        std::vector<pplx::task<bool>> tasks;
+        tasks.reserve(m_state->shards.size());
+        for (auto iter = m_state->shards.begin(); iter != m_state->shards.end(); ++iter)
+        {
+            tasks.push_back(iter->delete_queue_if_exists_async(options, context));
+        }
+
+        return pplx::when_all(tasks.begin(), tasks.end()).then([] (std::vector<bool>)
+        {
+        });
+    }
+
+    pplx::task<void> sharded_queue::add_message_async(cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, const queue_request_options& options, operation_context context)
+    {
+        size_t index = m_state->next_shard++ % m_state->shards.size();
+        queue_request_options request_options(options);
+        return m_state->shards[index].add_message_async(message, time_to_live, initial_visibility_timeout, request_options, context);
+    }
+
+    pplx::task<void> sharded_queue::add_message_async(const utility::string_t& key, cloud_queue_message& message, std::chrono::seconds time_to_live, std::chrono::seconds initial_visibility_timeout, const queue_request_options& options, operation_context context)
+    {
+        queue_request_options request_options(options);
+        return m_state->shards[get_shard_index(key)].add_message_async(message, time_to_live, initial_visibility_timeout, request_options, context);
+    }
+
+    pplx::task<sharded_queue_result> sharded_queue::get_messages_async(size_t message_count, std::chrono::seconds visibility_timeout, const queue_request_options& options, operation_context context)
+    {
+        size_t index = m_state->choose_shard();
+        return shared_state::get_messages_async(m_state, index, m_state->shards.size() - 1, message_count, visibility_timeout, options, context);
+    }
+
+}} // namespace wa::storage
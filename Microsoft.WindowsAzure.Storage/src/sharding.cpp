@@ -0,0 +1,252 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="sharding.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/sharding.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        void check_accounts(const std::vector<cloud_storage_account>& accounts)
+        {
+            if (accounts.empty())
+            {
+                throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_sharded_client_empty));
+            }
+        }
+
+        size_t place(const shard_placement& placement, const utility::string_t& key, size_t shard_count)
+        {
+            size_t index = placement(key, shard_count);
+            if (index >= shard_count)
+            {
+                throw std::out_of_range(utility::conversions::to_utf8string(protocol::error_shard_placement));
+            }
+
+            return index;
+        }
+    }
+
+    size_t consistent_hash_placement(const utility::string_t& key, size_t shard_count)
+    {
+        if (shard_count == 0)
+        {
+            throw std::invalid_argument("shard_count");
+        }
+
+        // Jump consistent hashing (Lamping and Veach): the key jumps forward through the shards, and lands on a new last
+        // shard with a probability of 1 / shard_count, which is exactly the share of the keys that the new shard takes over
+        uint64_t hash = core::hash_utf8_key(key);
+        int64_t shard = -1;
+        int64_t next = 0;
+        while (next < static_cast<int64_t>(shard_count))
+        {
+            shard = next;
+            hash = hash * 2862933555777941757ULL + 1;
+            next = static_cast<int64_t>((shard + 1) * (static_cast<double>(1LL << 31) / static_cast<double>((hash >> 33) + 1)));
+        }
+
+        return static_cast<size_t>(shard);
+    }
+
+    sharded_blob_client::sharded_blob_client(const std::vector<cloud_storage_account>& accounts)
+        : m_placement(consistent_hash_placement)
+    {
+        check_accounts(accounts);
+        m_shards.reserve(accounts.size());
+        for (auto iter = accounts.cbegin(); iter != accounts.cend(); ++iter)
+        {
+            m_shards.push_back(iter->create_cloud_blob_client());
+        }
+    }
+
+    sharded_blob_client::sharded_blob_client(const std::vector<cloud_storage_account>& accounts, shard_placement placement, const blob_request_options& default_request_options)
+        : m_placement(placement ? std::move(placement) : shard_placement(consistent_hash_placement))
+    {
+        check_accounts(accounts);
+        m_shards.reserve(accounts.size());
+        for (auto iter = accounts.cbegin(); iter != accounts.cend(); ++iter)
+        {
+            m_shards.push_back(iter->create_cloud_blob_client(default_request_options));
+        }
+    }
+
+    const std::vector<cloud_blob_client>& sharded_blob_client::shards() const
+    {
+        return m_shards;
+    }
+
+    size_t sharded_blob_client::get_shard_index(const utility::string_t& blob_name) const
+    {
+        return place(m_placement, blob_name, m_shards.size());
+    }
+
+    cloud_block_blob sharded_blob_client::get_block_blob_reference(const utility::string_t& container_name, const utility::string_t& blob_name) const
+    {
+        return m_shards[get_shard_index(blob_name)].get_container_reference(container_name).get_block_blob_reference(blob_name);
+    }
+
+    cloud_page_blob sharded_blob_client::get_page_blob_reference(const utility::string_t& container_name, const utility::string_t& blob_name) const
+    {
+        return m_shards[get_shard_index(blob_name)].get_container_reference(container_name).get_page_blob_reference(blob_name);
+    }
+
+    std::vector<cloud_blob_container> sharded_blob_client::get_container_references(const utility::string_t& container_name) const
+    {
+        std::vector<cloud_blob_container> containers;
+        containers.reserve(m_shards.size());
+        for (auto iter = m_shards.cbegin(); iter != m_shards.cend(); ++iter)
+        {
+            containers.push_back(iter->get_container_reference(container_name));
+        }
+
+        return containers;
+    }
+
+    pplx::task<void> sharded_blob_client::create_containers_if_not_exist_async(const utility::string_t& container_name, const blob_request_options& options, operation_context context) const
+    {
+        auto containers = get_container_references(container_name);
+        std::vector<pplx::task<bool>> tasks;
+        tasks.reserve(containers.size());
+        for (auto iter = containers.begin(); iter != containers.end(); ++iter)
+        {
+            tasks.push_back(iter->create_if_not_exists_async(blob_container_public_access_type::off, options, context));
+        }
+
+        return pplx::when_all(tasks.begin(), tasks.end()).then([] (std::vector<bool>)
+        {
+        });
+    }
+
+    sharded_table_client::sharded_table_client(const std::vector<cloud_storage_account>& accounts)
+        : m_placement(consistent_hash_placement)
+    {
+        check_accounts(accounts);
+        m_shards.reserve(accounts.size());
+        for (auto iter = accounts.cbegin(); iter != accounts.cend(); ++iter)
+        {
+            m_shards.push_back(iter->create_cloud_table_client());
+        }
+    }
+
+    sharded_table_client::sharded_table_client(const std::vector<cloud_storage_account>& accounts, shard_placement placement, const table_request_options& default_request_options)
+        : m_placement(placement ? std::move(placement) : shard_placement(consistent_hash_placement))
+    {
+        check_accounts(accounts);
+        m_shards.reserve(accounts.size());
+        for (auto iter = accounts.cbegin(); iter != accounts.cend(); ++iter)
+        {
+            m_shards.push_back(iter->create_cloud_table_client(default_request_options));
+        }
+    }
+
+    const std::vector<cloud_table_client>& sharded_table_client::shards() const
+    {
+        return m_shards;
+    }
+
+    size_t sharded_table_client::get_shard_index(const utility::string_t& partition_key) const
+    {
+        return place(m_placement, partition_key, m_shards.size());
+    }
+
+    cloud_table sharded_table_client::get_table_reference(const utility::string_t& table_name, const utility::string_t& partition_key) const
+    {
+        return m_shards[get_shard_index(partition_key)].get_table_reference(table_name);
+    }
+
+    std::vector<cloud_table> sharded_table_client::get_table_references(const utility::string_t& table_name) const
+    {
+        std::vector<cloud_table> tables;
+        tables.reserve(m_shards.size());
+        for (auto iter = m_shards.cbegin(); iter != m_shards.cend(); ++iter)
+        {
+            tables.push_back(iter->get_table_reference(table_name));
+        }
+
+        return tables;
+    }
+
+    pplx::task<void> sharded_table_client::create_tables_if_not_exist_async(const utility::string_t& table_name, const table_request_options& options, operation_context context) const
+    {
+        auto tables = get_table_references(table_name);
+        std::vector<pplx::task<bool>> tasks;
+        tasks.reserve(tables.size());
+        for (auto iter = tables.begin(); iter != tables.end(); ++iter)
+        {
+            tasks.push_back(iter->create_if_not_exists_async(options, context));
+        }
+
+        return pplx::when_all(tasks.begin(), tasks.end()).then([] (std::vector<bool>)
+        {
+        });
+    }
+
+    sharded_queue_client::sharded_queue_client(const std::vector<cloud_storage_account>& accounts)
+        : m_placement(consistent_hash_placement)
+    {
+        check_accounts(accounts);
+        m_shards.reserve(accounts.size());
+        for (auto iter = accounts.cbegin(); iter != accounts.cend(); ++iter)
+        {
+            m_shards.push_back(iter->create_cloud_queue_client());
+        }
+    }
+
+    sharded_queue_client::sharded_queue_client(const std::vector<cloud_storage_account>& accounts, shard_placement placement, const queue_request_options& default_request_options)
+        : m_placement(placement ? std::move(placement) : shard_placement(consistent_hash_placement))
+    {
+        check_accounts(accounts);
+        m_shards.reserve(accounts.size());
+        for (auto iter = accounts.cbegin(); iter != accounts.cend(); ++iter)
+        {
+            m_shards.push_back(iter->create_cloud_queue_client(default_request_options));
+        }
+    }
+
+    const std::vector<cloud_queue_client>& sharded_queue_client::shards() const
+    {
+        return m_shards;
+    }
+
+    size_t sharded_queue_client::get_shard_index(const utility::string_t& queue_name) const
+    {
+        return place(m_placement, queue_name, m_shards.size());
+    }
+
+    cloud_queue sharded_queue_client::get_queue_reference(const utility::string_t& queue_name) const
+    {
+        return m_shards[get_shard_index(queue_name)].get_queue_reference(queue_name);
+    }
+
+    sharded_queue sharded_queue_client::get_sharded_queue(const utility::string_t& queue_name) const
+    {
+        std::vector<cloud_queue> queues;
+        queues.reserve(m_shards.size());
+        for (auto iter = m_shards.cbegin(); iter != m_shards.cend(); ++iter)
+        {
+            queues.push_back(iter->get_queue_reference(queue_name));
+        }
+
+        return sharded_queue(std::move(queues));
+    }
+
+}} // namespace wa::storage
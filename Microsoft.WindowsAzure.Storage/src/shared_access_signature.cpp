@@ -22,6 +22,9 @@
 #include "was/queue.h"
 #include "was/table.h"
 #include "wascore/util.h"
+#include "wascore/hash_software.h"
+#include "wascore/sas_cache.h"
+#include "wascore/credential_cache.h"
 
 namespace wa { namespace storage { namespace protocol {
 
@@ -129,32 +132,127 @@ namespace wa { namespace storage { namespace protocol {
 
 #pragma region Blob SAS Helpers
 
-    utility::string_t get_blob_sas_string_to_sign(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource, const storage_credentials& credentials)
+    namespace
     {
-        auto str = get_sas_string_to_sign(identifier, policy, resource);
+        // Signs blob SAS tokens that share a policy and a set of headers, so that everything but the
+        // resource is formatted once whether one token or many are signed
+        class blob_sas_signer
+        {
+        public:
 
-        str << U('\n') << headers.cache_control();
-        str << U('\n') << headers.content_disposition();
-        str << U('\n') << headers.content_encoding();
-        str << U('\n') << headers.content_language();
-        str << U('\n') << headers.content_type();
+            blob_sas_signer(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource_type, const storage_credentials& credentials)
+                : m_credentials(credentials)
+            {
+                utility::ostringstream_t prefix;
+                prefix << policy.permissions_to_string() << U('\n');
+                prefix << convert_datetime_if_initialized(policy.start()) << U('\n');
+                prefix << convert_datetime_if_initialized(policy.expiry()) << U('\n');
+                m_string_to_sign_prefix = prefix.str();
+
+                utility::ostringstream_t suffix;
+                suffix << U('\n') << identifier << U('\n');
+                suffix << header_value_storage_version;
+                suffix << U('\n') << headers.cache_control();
+                suffix << U('\n') << headers.content_disposition();
+                suffix << U('\n') << headers.content_encoding();
+                suffix << U('\n') << headers.content_language();
+                suffix << U('\n') << headers.content_type();
+                m_string_to_sign_suffix = suffix.str();
+
+                // The token is the same query as get_sas_token_builder builds, with the signature in the middle
+                web::http::uri_builder before_signature;
+                add_query_if_not_empty(before_signature, uri_query_sas_version, header_value_storage_version);
+                add_query_if_not_empty(before_signature, uri_query_sas_identifier, identifier);
+                m_token_prefix = U("?") + before_signature.query();
+
+                web::http::uri_builder after_signature;
+                if (policy.is_valid())
+                {
+                    add_query_if_not_empty(after_signature, uri_query_sas_start, convert_datetime_if_initialized(policy.start()));
+                    add_query_if_not_empty(after_signature, uri_query_sas_expiry, convert_datetime_if_initialized(policy.expiry()));
+                    add_query_if_not_empty(after_signature, uri_query_sas_permissions, policy.permissions_to_string());
+                }
+
+                add_query_if_not_empty(after_signature, uri_query_sas_resource, resource_type);
+                add_query_if_not_empty(after_signature, uri_query_sas_cache_control, headers.cache_control());
+                add_query_if_not_empty(after_signature, uri_query_sas_content_type, headers.content_type());
+                add_query_if_not_empty(after_signature, uri_query_sas_content_encoding, headers.content_encoding());
+                add_query_if_not_empty(after_signature, uri_query_sas_content_language, headers.content_language());
+                add_query_if_not_empty(after_signature, uri_query_sas_content_disposition, headers.content_disposition());
+                m_token_suffix = after_signature.query();
+            }
 
-        return calculate_hmac_sha256_hash(str.str(), credentials);
+            utility::string_t string_to_sign(const utility::string_t& resource) const
+            {
+                utility::string_t result;
+                result.reserve(m_string_to_sign_prefix.size() + resource.size() + m_string_to_sign_suffix.size());
+                result.append(m_string_to_sign_prefix).append(resource).append(m_string_to_sign_suffix);
+                return result;
+            }
+
+            utility::string_t sign(const utility::string_t& string_to_sign)
+            {
+                // The account key is only scheduled once, and not at all if every token comes from a cache
+                if (!m_signing_key)
+                {
+                    m_signing_key = core::credential_cache::instance().get_signing_key(m_credentials.account_key());
+                }
+
+                utility::string_t token(m_token_prefix);
+                token.append(U("&")).append(uri_query_sas_signature).append(U("="));
+                token.append(web::http::uri::encode_data_string(calculate_hmac_sha256_hash(string_to_sign, *m_signing_key)));
+                if (!m_token_suffix.empty())
+                {
+                    token.append(U("&")).append(m_token_suffix);
+                }
+
+                return token;
+            }
+
+        private:
+
+            const storage_credentials& m_credentials;
+            std::shared_ptr<const core::hmac_sha256_hash> m_signing_key;
+            utility::string_t m_string_to_sign_prefix;
+            utility::string_t m_string_to_sign_suffix;
+            utility::string_t m_token_prefix;
+            utility::string_t m_token_suffix;
+        };
     }
 
-    utility::string_t get_blob_sas_token(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource_type, const utility::string_t& resource, const storage_credentials& credentials)
+    utility::string_t get_blob_sas_token(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource_type, const utility::string_t& resource, const storage_credentials& credentials, const std::shared_ptr<core::sas_cache>& cache)
     {
-        auto signature = get_blob_sas_string_to_sign(identifier, policy, headers, resource, credentials);
-        auto builder = get_sas_token_builder(identifier, policy, signature);
+        blob_sas_signer signer(identifier, policy, headers, resource_type, credentials);
+        auto string_to_sign = signer.string_to_sign(resource);
+        if (!cache)
+        {
+            return signer.sign(string_to_sign);
+        }
 
-        add_query_if_not_empty(builder, uri_query_sas_resource, resource_type);
-        add_query_if_not_empty(builder, uri_query_sas_cache_control, headers.cache_control());
-        add_query_if_not_empty(builder, uri_query_sas_content_type, headers.content_type());
-        add_query_if_not_empty(builder, uri_query_sas_content_encoding, headers.content_encoding());
-        add_query_if_not_empty(builder, uri_query_sas_content_language, headers.content_language());
-        add_query_if_not_empty(builder, uri_query_sas_content_disposition, headers.content_disposition());
+        // The string to sign covers everything in the token but its resource type
+        utility::string_t token;
+        auto key = resource_type + U('\n') + string_to_sign;
+        if (!cache->try_get(key, token))
+        {
+            token = signer.sign(string_to_sign);
+            cache->add(key, token, policy.expiry());
+        }
 
-        return U("?") + builder.query();
+        return token;
+    }
+
+    std::vector<utility::string_t> get_blob_sas_tokens(const utility::string_t& identifier, const shared_access_policy& policy, const cloud_blob_shared_access_headers& headers, const utility::string_t& resource_type, const std::vector<utility::string_t>& resources, const storage_credentials& credentials)
+    {
+        blob_sas_signer signer(identifier, policy, headers, resource_type, credentials);
+
+        std::vector<utility::string_t> tokens;
+        tokens.reserve(resources.size());
+        for (auto iter = resources.cbegin(); iter != resources.cend(); ++iter)
+        {
+            tokens.push_back(signer.sign(signer.string_to_sign(*iter)));
+        }
+
+        return tokens;
     }
 
 #pragma endregion
@@ -0,0 +1,219 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="table_bulk_writer.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/async_semaphore.h"
+#include "wascore/protocol.h"
+#include "wascore/resources.h"
+#include "was/table.h"
+
+namespace wa { namespace storage {
+
+    struct table_bulk_writer::shared_state
+    {
+        shared_state(const cloud_table& table, const table_request_options& options, operation_context context)
+            : table(table), options(options), context(context), semaphore(options.parallelism_factor())
+        {
+        }
+
+        void add_failure(const table_operation& operation, std::exception_ptr error)
+        {
+            std::lock_guard<std::mutex> guard(failures_mutex);
+            failures.push_back(table_bulk_failure(operation, error));
+        }
+
+        static pplx::task<void> write_operation_async(std::shared_ptr<shared_state> state, const table_operation& operation)
+        {
+            return state->table.execute_async(operation, state->options, state->context).then([state, operation] (pplx::task<table_result> result_task)
+            {
+                try
+                {
+                    result_task.wait();
+                }
+                catch (...)
+                {
+                    state->add_failure(operation, std::current_exception());
+                }
+            });
+        }
+
+        static pplx::task<void> write_batch_async(std::shared_ptr<shared_state> state, std::shared_ptr<table_batch_operation> batch)
+        {
+            if (batch->operations().size() == 1)
+            {
+                return write_operation_async(state, batch->operations().front());
+            }
+
+            return state->table.execute_batch_async(*batch, state->options, state->context).then([state, batch] (pplx::task<std::vector<table_result>> result_task) -> pplx::task<void>
+            {
+                try
+                {
+                    result_task.wait();
+                    return pplx::task_from_result();
+                }
+                catch (...)
+                {
+                }
+
+                // None of the operations in a failed batch have been applied, so they are sent one at a time to find out which of them failed
+                auto next_operation = std::make_shared<size_t>(0);
+                return pplx::details::do_while([state, batch, next_operation] () -> pplx::task<bool>
+                {
+                    const table_operation& operation = batch->operations()[(*next_operation)++];
+                    return write_operation_async(state, operation).then([batch, next_operation] () -> bool
+                    {
+                        return *next_operation < batch->operations().size();
+                    });
+                }).then([] (bool)
+                {
+                });
+            });
+        }
+
+        cloud_table table;
+        table_request_options options;
+        operation_context context;
+        core::async_semaphore semaphore;
+        std::vector<table_bulk_failure> failures;
+        std::mutex failures_mutex;
+    };
+
+    void table_bulk_writer::initialize(const cloud_table& table, const table_request_options& options, operation_context context)
+    {
+        table_request_options modified_options(options);
+        modified_options.apply_defaults(table.service_client().default_request_options());
+
+        m_state = std::make_shared<shared_state>(table, modified_options, context);
+        m_buffered_operations = 0;
+        m_max_buffered_operations = protocol::default_max_buffered_table_operations;
+    }
+
+    pplx::task<void> table_bulk_writer::add_async(const table_operation& operation)
+    {
+        if (operation.operation_type() == table_operation_type::retrieve_operation)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_bulk_retrieve_operation));
+        }
+
+        size_t operation_size = protocol::get_batch_operation_size(m_state->table, operation);
+        const utility::string_t& row_key = operation.entity().row_key();
+
+        std::vector<pplx::task<void>> sent_tasks;
+        pending_batch& batch = m_batches[operation.entity().partition_key()];
+
+        // A batch may not change the same entity twice, so an operation for an entity already in the batch starts a new one
+        if (!batch.operation.operations().empty() &&
+            (batch.operation.operations().size() >= protocol::max_batch_operations ||
+            batch.payload_size + operation_size > protocol::max_batch_payload_size ||
+            batch.row_keys.find(row_key) != batch.row_keys.end()))
+        {
+            sent_tasks.push_back(send_async(batch));
+        }
+
+        batch.operation.operations().push_back(operation);
+        batch.payload_size += operation_size;
+        batch.row_keys.insert(row_key);
+        ++m_buffered_operations;
+
+        if (batch.operation.operations().size() >= protocol::max_batch_operations)
+        {
+            sent_tasks.push_back(send_async(batch));
+        }
+
+        if (m_buffered_operations > m_max_buffered_operations)
+        {
+            // Too many operations are waiting for their partitions to fill up a batch, so the largest batch is sent as it is
+            auto largest = m_batches.end();
+            for (auto iter = m_batches.begin(); iter != m_batches.end(); ++iter)
+            {
+                if (largest == m_batches.end() || iter->second.operation.operations().size() > largest->second.operation.operations().size())
+                {
+                    largest = iter;
+                }
+            }
+
+            sent_tasks.push_back(send_async(largest->second));
+        }
+
+        if (sent_tasks.empty())
+        {
+            return pplx::task_from_result();
+        }
+
+        return pplx::when_all(sent_tasks.begin(), sent_tasks.end());
+    }
+
+    pplx::task<std::vector<table_bulk_failure>> table_bulk_writer::flush_async()
+    {
+        for (auto iter = m_batches.begin(); iter != m_batches.end(); ++iter)
+        {
+            if (!iter->second.operation.operations().empty())
+            {
+                send_async(iter->second);
+            }
+        }
+
+        m_batches.clear();
+
+        auto state = m_state;
+        return state->semaphore.wait_all_async().then([state] () -> std::vector<table_bulk_failure>
+        {
+            std::vector<table_bulk_failure> failures;
+            std::lock_guard<std::mutex> guard(state->failures_mutex);
+            failures.swap(state->failures);
+            return failures;
+        });
+    }
+
+    pplx::task<void> table_bulk_writer::send_async(pending_batch& batch)
+    {
+        auto operation = std::make_shared<table_batch_operation>();
+        operation->operations().swap(batch.operation.operations());
+        m_buffered_operations -= operation->operations().size();
+        batch.payload_size = 0;
+        batch.row_keys.clear();
+
+        // The returned task completes when the batch may be sent, which holds back callers while all the permitted batches are in flight
+        auto state = m_state;
+        auto acquired = state->semaphore.lock_async();
+        acquired.then([state, operation] ()
+        {
+            return shared_state::write_batch_async(state, operation);
+        }).then([state, operation] (pplx::task<void> written_task)
+        {
+            try
+            {
+                written_task.wait();
+            }
+            catch (...)
+            {
+                // Failures of the requests are recorded already, so this is an error that prevented them from being sent
+                std::exception_ptr error = std::current_exception();
+                for (auto iter = operation->operations().cbegin(); iter != operation->operations().cend(); ++iter)
+                {
+                    state->add_failure(*iter, error);
+                }
+            }
+
+            state->semaphore.unlock();
+        });
+
+        return acquired;
+    }
+
+}} // namespace wa::storage
@@ -0,0 +1,302 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="table_column_batch.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <limits>
+
+#include "was/table.h"
+#include "wascore/resources.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        // Returns the number of bytes a value takes in a fixed-width column, or zero for booleans, which are bits, and variable-width types
+        size_t fixed_value_size(edm_type type)
+        {
+            switch (type)
+            {
+            case edm_type::int32:
+                return sizeof(int32_t);
+
+            case edm_type::int64:
+            case edm_type::datetime:
+                return sizeof(int64_t);
+
+            case edm_type::double_floating_point:
+                return sizeof(double);
+
+            default:
+                return 0;
+            }
+        }
+
+        bool is_variable_width(edm_type type)
+        {
+            return type == edm_type::string || type == edm_type::guid || type == edm_type::binary;
+        }
+
+        void append_bit(std::vector<uint8_t>& bits, size_t index, bool value)
+        {
+            if (index % 8 == 0)
+            {
+                bits.push_back(0);
+            }
+
+            if (value)
+            {
+                bits[index / 8] |= static_cast<uint8_t>(1 << (index % 8));
+            }
+        }
+
+        template<typename V>
+        void append_fixed_value(std::vector<uint8_t>& values, V value)
+        {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+            values.insert(values.end(), bytes, bytes + sizeof(V));
+        }
+    }
+
+    table_column::table_column(const utility::string_t& name, edm_type type)
+        : m_name(name), m_type(type), m_size(0), m_null_count(0)
+    {
+        clear();
+    }
+
+    void table_column::append(const entity_property& value)
+    {
+        switch (m_type)
+        {
+        case edm_type::boolean:
+            append_bit(m_values, m_size, value.boolean_value());
+            break;
+
+        case edm_type::int32:
+            append_fixed_value(m_values, value.int32_value());
+            break;
+
+        case edm_type::int64:
+            append_fixed_value(m_values, value.int64_value());
+            break;
+
+        case edm_type::double_floating_point:
+            append_fixed_value(m_values, value.double_value());
+            break;
+
+        case edm_type::datetime:
+            append_fixed_value(m_values, static_cast<int64_t>(value.datetime_value().to_interval()));
+            break;
+
+        case edm_type::binary:
+            {
+                std::vector<uint8_t> bytes = value.binary_value();
+                append_text(std::string(bytes.cbegin(), bytes.cend()));
+            }
+            return;
+
+        case edm_type::guid:
+            append_text(utility::conversions::to_utf8string(utility::uuid_to_string(value.guid_value())));
+            return;
+
+        default:
+            // String values read from a response are kept as UTF-8, so they are copied without being converted
+            if (value.property_type() == edm_type::string && value.has_utf8_value())
+            {
+                append_text(value.utf8_value());
+            }
+            else
+            {
+                append_text(utility::conversions::to_utf8string(value.string_value()));
+            }
+            return;
+        }
+
+        append_validity(true);
+    }
+
+    void table_column::append_text(const std::string& value)
+    {
+        if (value.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max()) - m_values.size())
+        {
+            throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_table_column_too_large));
+        }
+
+        m_values.insert(m_values.end(), value.cbegin(), value.cend());
+        m_offsets.push_back(static_cast<int32_t>(m_values.size()));
+        append_validity(true);
+    }
+
+    void table_column::append_null()
+    {
+        if (m_type == edm_type::boolean)
+        {
+            append_bit(m_values, m_size, false);
+        }
+        else if (is_variable_width(m_type))
+        {
+            m_offsets.push_back(static_cast<int32_t>(m_values.size()));
+        }
+        else
+        {
+            m_values.resize(m_values.size() + fixed_value_size(m_type));
+        }
+
+        ++m_null_count;
+        append_validity(false);
+    }
+
+    void table_column::clear()
+    {
+        // The buffers keep their capacity, so a column that is reused for every batch stops allocating after the first one
+        m_size = 0;
+        m_null_count = 0;
+        m_validity.clear();
+        m_values.clear();
+        m_offsets.clear();
+        if (is_variable_width(m_type))
+        {
+            m_offsets.push_back(0);
+        }
+    }
+
+    void table_column::append_validity(bool has_value)
+    {
+        append_bit(m_validity, m_size, has_value);
+        ++m_size;
+    }
+
+    table_column_batch_receiver::table_column_batch_receiver(const std::vector<std::pair<utility::string_t, edm_type>>& columns, size_t batch_size, std::function<bool (const table_column_batch&)> handler)
+        : m_received(columns.size(), false), m_batch_size(batch_size), m_handler(std::move(handler)), m_stopped(false)
+    {
+        if (batch_size == 0)
+        {
+            throw std::invalid_argument("batch_size");
+        }
+
+        m_batch.m_columns.reserve(columns.size());
+        m_utf8_names.reserve(columns.size());
+        for (auto iter = columns.cbegin(); iter != columns.cend(); ++iter)
+        {
+            m_batch.m_columns.push_back(table_column(iter->first, iter->second));
+            m_utf8_names.push_back(utility::conversions::to_utf8string(iter->first));
+        }
+    }
+
+    int table_column_batch_receiver::property_index(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_utf8_names.size(); ++i)
+        {
+            if (m_utf8_names[i] == name)
+            {
+                return static_cast<int>(i);
+            }
+        }
+
+        return -1;
+    }
+
+    edm_type table_column_batch_receiver::property_type(int index) const
+    {
+        return m_batch.m_columns[index].type();
+    }
+
+    void table_column_batch_receiver::begin_entity()
+    {
+        m_received.assign(m_received.size(), false);
+    }
+
+    void table_column_batch_receiver::set_partition_key(const utility::string_t& value)
+    {
+        m_batch.m_partition_keys.append_text(utility::conversions::to_utf8string(value));
+    }
+
+    void table_column_batch_receiver::set_row_key(const utility::string_t& value)
+    {
+        m_batch.m_row_keys.append_text(utility::conversions::to_utf8string(value));
+    }
+
+    void table_column_batch_receiver::set_timestamp(const utility::datetime&)
+    {
+    }
+
+    void table_column_batch_receiver::set_etag(const utility::string_t&)
+    {
+    }
+
+    void table_column_batch_receiver::set_property(int index, const entity_property& value)
+    {
+        if (!m_received[index])
+        {
+            m_batch.m_columns[index].append(value);
+            m_received[index] = true;
+        }
+    }
+
+    bool table_column_batch_receiver::end_entity()
+    {
+        // Every column gets a row for every entity, so the properties an entity does not have become nulls
+        for (size_t i = 0; i < m_received.size(); ++i)
+        {
+            if (!m_received[i])
+            {
+                m_batch.m_columns[i].append_null();
+            }
+        }
+
+        if (m_batch.m_partition_keys.size() == m_batch.m_size)
+        {
+            m_batch.m_partition_keys.append_null();
+        }
+
+        if (m_batch.m_row_keys.size() == m_batch.m_size)
+        {
+            m_batch.m_row_keys.append_null();
+        }
+
+        ++m_batch.m_size;
+        if (m_batch.m_size < m_batch_size)
+        {
+            return true;
+        }
+
+        return handle_batch();
+    }
+
+    void table_column_batch_receiver::finish()
+    {
+        if (!m_stopped && m_batch.m_size > 0)
+        {
+            handle_batch();
+        }
+    }
+
+    bool table_column_batch_receiver::handle_batch()
+    {
+        m_stopped = !m_handler(m_batch);
+
+        m_batch.m_size = 0;
+        m_batch.m_partition_keys.clear();
+        m_batch.m_row_keys.clear();
+        for (auto iter = m_batch.m_columns.begin(); iter != m_batch.m_columns.end(); ++iter)
+        {
+            iter->clear();
+        }
+
+        return !m_stopped;
+    }
+
+}} // namespace wa::storage
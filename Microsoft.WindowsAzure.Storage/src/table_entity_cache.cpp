@@ -0,0 +1,137 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="table_entity_cache.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/table_entity_cache.h"
+
+namespace wa { namespace storage { namespace core {
+
+    table_entity_cache_settings table_entity_cache::settings() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings;
+    }
+
+    void table_entity_cache::set_settings(const table_entity_cache_settings& value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_settings = value;
+        m_entries.clear();
+        m_index.clear();
+        ++m_invalidations;
+    }
+
+    bool table_entity_cache::is_enabled() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_settings.max_entities() > 0;
+    }
+
+    utility::string_t table_entity_cache::get_key(const utility::string_t& table_name, const utility::string_t& partition_key, const utility::string_t& row_key)
+    {
+        // Control characters are not allowed in table names and keys, so a line break cannot be part of any of them
+        utility::string_t key;
+        key.reserve(table_name.size() + partition_key.size() + row_key.size() + 2);
+        key.append(table_name);
+        key.push_back(U('\n'));
+        key.append(partition_key);
+        key.push_back(U('\n'));
+        key.append(row_key);
+        return key;
+    }
+
+    uint64_t table_entity_cache::begin_read() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_invalidations;
+    }
+
+    bool table_entity_cache::try_get(const utility::string_t& key, table_result& result, bool& is_fresh)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_index.find(key);
+        if (iter == m_index.end())
+        {
+            return false;
+        }
+
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        result = iter->second->result;
+        is_fresh = std::chrono::steady_clock::now() < iter->second->expiry_time;
+        return true;
+    }
+
+    void table_entity_cache::put(const utility::string_t& key, const table_result& result, uint64_t read_invalidations)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        // An entity that may have been changed while it was read is not stored, because the cache could not tell that it is out of date
+        if (m_settings.max_entities() == 0 || read_invalidations != m_invalidations)
+        {
+            return;
+        }
+
+        std::chrono::steady_clock::time_point expiry_time = std::chrono::steady_clock::now() + m_settings.time_to_live();
+
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            iter->second->result = result;
+            iter->second->expiry_time = expiry_time;
+            m_entries.splice(m_entries.begin(), m_entries, iter->second);
+            return;
+        }
+
+        entry value;
+        value.key = key;
+        value.result = result;
+        value.expiry_time = expiry_time;
+        m_entries.push_front(std::move(value));
+        m_index[key] = m_entries.begin();
+
+        while (m_entries.size() > m_settings.max_entities())
+        {
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+        }
+    }
+
+    void table_entity_cache::refresh(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            iter->second->expiry_time = std::chrono::steady_clock::now() + m_settings.time_to_live();
+        }
+    }
+
+    void table_entity_cache::remove(const utility::string_t& key)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        ++m_invalidations;
+
+        auto iter = m_index.find(key);
+        if (iter != m_index.end())
+        {
+            m_entries.erase(iter->second);
+            m_index.erase(iter);
+        }
+    }
+
+}}} // namespace wa::storage::core
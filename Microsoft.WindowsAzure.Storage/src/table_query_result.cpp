@@ -0,0 +1,427 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="table_query_result.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include <cstdio>
+#include <fstream>
+
+#include "wascore/resources.h"
+#include "was/table.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        // Approximates the bytes that an entity takes up in memory, including the nodes of its property map
+        size_t estimate_entity_size(const table_entity& entity)
+        {
+            size_t size = sizeof(table_entity) + (entity.partition_key().size() + entity.row_key().size() + entity.etag().size()) * sizeof(utility::char_t);
+            for (auto iter = entity.properties().cbegin(); iter != entity.properties().cend(); ++iter)
+            {
+                size += sizeof(table_entity::property_type) + 2 * sizeof(void*) + iter->first.size() * sizeof(utility::char_t);
+                if (iter->second.is_null())
+                {
+                    continue;
+                }
+
+                if (iter->second.property_type() == edm_type::string)
+                {
+                    size += iter->second.string_value().size() * sizeof(utility::char_t);
+                }
+                else if (iter->second.property_type() == edm_type::binary)
+                {
+                    size += iter->second.binary_value().size();
+                }
+            }
+
+            return size;
+        }
+
+        void throw_spill_error()
+        {
+            throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_table_spill_file));
+        }
+
+        // The file holds one record per entity. Lengths and integers are written as little-endian base-128 varints, and doubles and GUIDs as they are in memory.
+        void write_varint(std::ostream& stream, uint64_t value)
+        {
+            char buffer[10];
+            size_t size = 0;
+            do
+            {
+                uint8_t byte = static_cast<uint8_t>(value & 0x7F);
+                value >>= 7;
+                buffer[size++] = static_cast<char>(value != 0 ? (byte | 0x80) : byte);
+            }
+            while (value != 0);
+
+            stream.write(buffer, size);
+        }
+
+        uint64_t read_varint(std::istream& stream)
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                char c;
+                if (!stream.get(c))
+                {
+                    throw_spill_error();
+                }
+
+                value |= static_cast<uint64_t>(static_cast<uint8_t>(c) & 0x7F) << shift;
+                if ((static_cast<uint8_t>(c) & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+
+            throw_spill_error();
+            return 0;
+        }
+
+        // Signed integers are zigzag-encoded, so that small negative values stay short
+        void write_signed(std::ostream& stream, int64_t value)
+        {
+            write_varint(stream, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+
+        int64_t read_signed(std::istream& stream)
+        {
+            uint64_t value = read_varint(stream);
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        void write_bytes(std::ostream& stream, const void* data, size_t size)
+        {
+            write_varint(stream, size);
+            stream.write(static_cast<const char*>(data), size);
+        }
+
+        void read_bytes(std::istream& stream, std::vector<uint8_t>& value)
+        {
+            value.resize(static_cast<size_t>(read_varint(stream)));
+            if (!value.empty() && !stream.read(reinterpret_cast<char*>(&value[0]), value.size()))
+            {
+                throw_spill_error();
+            }
+        }
+
+        void write_string(std::ostream& stream, const utility::string_t& value)
+        {
+            auto utf8_value = utility::conversions::to_utf8string(value);
+            write_bytes(stream, utf8_value.data(), utf8_value.size());
+        }
+
+        utility::string_t read_string(std::istream& stream)
+        {
+            std::vector<uint8_t> value;
+            read_bytes(stream, value);
+            return utility::conversions::to_string_t(std::string(value.begin(), value.end()));
+        }
+
+        void write_entity(std::ostream& stream, const table_entity& entity)
+        {
+            write_string(stream, entity.partition_key());
+            write_string(stream, entity.row_key());
+            write_string(stream, entity.etag());
+            write_varint(stream, entity.timestamp().to_interval());
+            write_varint(stream, entity.properties().size());
+            for (auto iter = entity.properties().cbegin(); iter != entity.properties().cend(); ++iter)
+            {
+                const entity_property& property = iter->second;
+                write_string(stream, iter->first);
+                stream.put(static_cast<char>(property.property_type()));
+                stream.put(property.is_null() ? 1 : 0);
+                if (property.is_null())
+                {
+                    continue;
+                }
+
+                switch (property.property_type())
+                {
+                case edm_type::string:
+                    write_string(stream, property.string_value());
+                    break;
+
+                case edm_type::binary:
+                    {
+                        auto value = property.binary_value();
+                        write_bytes(stream, value.data(), value.size());
+                    }
+                    break;
+
+                case edm_type::boolean:
+                    stream.put(property.boolean_value() ? 1 : 0);
+                    break;
+
+                case edm_type::datetime:
+                    write_varint(stream, property.datetime_value().to_interval());
+                    break;
+
+                case edm_type::double_floating_point:
+                    {
+                        double value = property.double_value();
+                        stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+                    }
+                    break;
+
+                case edm_type::guid:
+                    {
+                        auto value = property.guid_value();
+                        stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+                    }
+                    break;
+
+                case edm_type::int32:
+                    write_signed(stream, property.int32_value());
+                    break;
+
+                case edm_type::int64:
+                    write_signed(stream, property.int64_value());
+                    break;
+                }
+            }
+        }
+
+        table_entity read_entity(std::istream& stream)
+        {
+            auto partition_key = read_string(stream);
+            auto row_key = read_string(stream);
+            table_entity entity(partition_key, row_key);
+            entity.set_etag(read_string(stream));
+            entity.set_timestamp(utility::datetime() + read_varint(stream));
+
+            auto property_count = static_cast<size_t>(read_varint(stream));
+            auto& properties = entity.properties();
+            for (size_t i = 0; i < property_count; ++i)
+            {
+                auto name = read_string(stream);
+                char type;
+                char is_null;
+                if (!stream.get(type) || !stream.get(is_null) || (static_cast<unsigned char>(type) > static_cast<unsigned char>(edm_type::int64)))
+                {
+                    throw_spill_error();
+                }
+
+                entity_property property;
+                if (is_null == 0)
+                {
+                    switch (static_cast<edm_type>(type))
+                    {
+                    case edm_type::string:
+                        property = entity_property(read_string(stream));
+                        break;
+
+                    case edm_type::binary:
+                        {
+                            std::vector<uint8_t> value;
+                            read_bytes(stream, value);
+                            property = entity_property(value);
+                        }
+                        break;
+
+                    case edm_type::boolean:
+                        {
+                            char value;
+                            if (!stream.get(value))
+                            {
+                                throw_spill_error();
+                            }
+
+                            property = entity_property(value != 0);
+                        }
+                        break;
+
+                    case edm_type::datetime:
+                        property = entity_property(utility::datetime() + read_varint(stream));
+                        break;
+
+                    case edm_type::double_floating_point:
+                        {
+                            double value;
+                            if (!stream.read(reinterpret_cast<char*>(&value), sizeof(value)))
+                            {
+                                throw_spill_error();
+                            }
+
+                            property = entity_property(value);
+                        }
+                        break;
+
+                    case edm_type::guid:
+                        {
+                            utility::uuid value;
+                            if (!stream.read(reinterpret_cast<char*>(&value), sizeof(value)))
+                            {
+                                throw_spill_error();
+                            }
+
+                            property = entity_property(value);
+                        }
+                        break;
+
+                    case edm_type::int32:
+                        property = entity_property(static_cast<int32_t>(read_signed(stream)));
+                        break;
+
+                    case edm_type::int64:
+                        property = entity_property(read_signed(stream));
+                        break;
+                    }
+                }
+                else
+                {
+                    property.set_property_type(static_cast<edm_type>(type));
+                }
+
+                properties.insert(std::make_pair(std::move(name), std::move(property)));
+            }
+
+            return entity;
+        }
+    }
+
+    struct table_query_result::shared_state
+    {
+        shared_state(size_t max_memory_size, const utility::string_t& spill_directory)
+            : max_memory_size(max_memory_size), spill_directory(spill_directory), memory_size(0), spilled_count(0), next_entity(0), next_spilled(0)
+        {
+        }
+
+        ~shared_state()
+        {
+            if (!spill_path.empty())
+            {
+                file.close();
+#ifdef WIN32
+                _wremove(spill_path.c_str());
+#else
+                std::remove(spill_path.c_str());
+#endif
+            }
+        }
+
+        size_t max_memory_size;
+        utility::string_t spill_directory;
+        std::vector<table_entity> entities;
+        size_t memory_size;
+
+        utility::string_t spill_path;
+        std::fstream file;
+        size_t spilled_count;
+
+        size_t next_entity;
+        size_t next_spilled;
+    };
+
+    table_query_result::table_query_result(size_t max_memory_size, const utility::string_t& spill_directory)
+    {
+        if (spill_directory.empty())
+        {
+            throw std::invalid_argument("spill_directory");
+        }
+
+        m_state = std::make_shared<shared_state>(max_memory_size, spill_directory);
+    }
+
+    void table_query_result::append(const table_entity& entity)
+    {
+        if (m_state->spill_path.empty())
+        {
+            size_t size = estimate_entity_size(entity);
+            if (m_state->memory_size + size <= m_state->max_memory_size)
+            {
+                m_state->memory_size += size;
+                m_state->entities.push_back(entity);
+                return;
+            }
+
+            // Every entity from the first one that does not fit goes to the file, so the results stay in order
+            utility::string_t path(m_state->spill_directory);
+            if ((path.back() != U('/')) && (path.back() != U('\\')))
+            {
+                path.push_back(U('/'));
+            }
+
+            path.append(utility::uuid_to_string(utility::new_uuid())).append(U(".entities"));
+            m_state->file.open(path.c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            if (!m_state->file.is_open())
+            {
+                throw_spill_error();
+            }
+
+            m_state->spill_path = std::move(path);
+        }
+
+        write_entity(m_state->file, entity);
+        if (!m_state->file)
+        {
+            throw_spill_error();
+        }
+
+        ++m_state->spilled_count;
+    }
+
+    void table_query_result::finish()
+    {
+        if (!m_state->spill_path.empty())
+        {
+            m_state->file.flush();
+            m_state->file.seekg(0);
+            if (!m_state->file)
+            {
+                throw_spill_error();
+            }
+        }
+    }
+
+    bool table_query_result::read_next(table_entity& entity)
+    {
+        if (!m_state)
+        {
+            return false;
+        }
+
+        if (m_state->next_entity < m_state->entities.size())
+        {
+            entity = m_state->entities[m_state->next_entity++];
+            return true;
+        }
+
+        if (m_state->next_spilled < m_state->spilled_count)
+        {
+            entity = read_entity(m_state->file);
+            ++m_state->next_spilled;
+            return true;
+        }
+
+        return false;
+    }
+
+    size_t table_query_result::size() const
+    {
+        return m_state ? m_state->entities.size() + m_state->spilled_count : 0;
+    }
+
+    size_t table_query_result::spilled_count() const
+    {
+        return m_state ? m_state->spilled_count : 0;
+    }
+
+}} // namespace wa::storage
@@ -17,6 +17,7 @@
 
 #include "stdafx.h"
 #include "wascore/protocol.h"
+#include "wascore/protocol_json.h"
 #include "wascore/constants.h"
 #include "wascore/resources.h"
 #include "was/common.h"
@@ -229,7 +230,7 @@ namespace wa { namespace storage { namespace protocol {
         }
     }
 
-    const utility::string_t& get_accept_header(table_payload_format payload_format)
+    const utility::char_t* get_accept_header(table_payload_format payload_format)
     {
         switch (payload_format)
         {
@@ -259,7 +260,7 @@ namespace wa { namespace storage { namespace protocol {
         populate_http_headers(headers, boundary_name);
     }
 
-    void populate_http_headers(web::http::http_headers& headers, table_operation_type operation_type, table_payload_format payload_format)
+    void populate_http_headers(web::http::http_headers& headers, table_operation_type operation_type, table_payload_format payload_format, bool echo_content)
     {
         if (operation_type == table_operation_type::retrieve_operation || 
             operation_type == table_operation_type::insert_operation)
@@ -273,9 +274,9 @@ namespace wa { namespace storage { namespace protocol {
             operation_type == table_operation_type::merge_operation || 
             operation_type == table_operation_type::replace_operation)
         {
-            if (operation_type == table_operation_type::insert_operation)
+            if (operation_type == table_operation_type::insert_operation && !echo_content)
             {
-                // TODO: Make the "Prefer: return-no-content" header configurable if needed
+                // Without the entity in the response, only the ETag is returned
                 headers.add(header_prefer, U("return-no-content"));
             }
 
@@ -293,7 +294,7 @@ namespace wa { namespace storage { namespace protocol {
         populate_http_headers(headers);
     }
 
-    void populate_http_headers(web::http::http_headers& headers, const table_operation& operation, table_payload_format payload_format)
+    void populate_http_headers(web::http::http_headers& headers, const table_operation& operation, table_payload_format payload_format, bool echo_content)
     {
         table_operation_type operation_type = operation.operation_type();
 
@@ -315,10 +316,10 @@ namespace wa { namespace storage { namespace protocol {
             headers.add(web::http::header_names::if_match, etag);
         }
 
-        populate_http_headers(headers, operation_type, payload_format);
+        populate_http_headers(headers, operation_type, payload_format, echo_content);
     }
 
-    web::json::value generate_json_object(const table_operation& operation)
+    bool write_json_object(std::string& body, const table_operation& operation)
     {
         if (operation.operation_type() == table_operation_type::insert_operation || 
             operation.operation_type() == table_operation_type::insert_or_merge_operation || 
@@ -326,87 +327,11 @@ namespace wa { namespace storage { namespace protocol {
             operation.operation_type() == table_operation_type::merge_operation || 
             operation.operation_type() == table_operation_type::replace_operation)
         {
-            const std::unordered_map<utility::string_t, entity_property>& properties = operation.entity().properties();
-            web::json::value::field_map fields;
-            fields.reserve(properties.size() * 2U + 2U);
-
-            web::json::value partition_key_name(U("PartitionKey"));
-            web::json::value partition_key_value(operation.entity().partition_key());
-            fields.push_back(std::pair<web::json::value, web::json::value>(partition_key_name, partition_key_value));
-
-            web::json::value row_key_name(U("RowKey"));
-            web::json::value row_key_value(operation.entity().row_key());
-            fields.push_back(std::pair<web::json::value, web::json::value>(row_key_name, row_key_value));
-
-            // TODO: Confirm that there is no need to write the ETag in the message body
-
-            for (std::unordered_map<utility::string_t, entity_property>::const_iterator itr = properties.cbegin(); itr != properties.cend(); ++itr)
-            {
-                bool requires_type;
-                web::json::value property_name(itr->first);
-
-                web::json::value property_value;
-                if (itr->second.property_type() == edm_type::boolean)
-                {
-                    requires_type = false;
-                    property_value = web::json::value(itr->second.boolean_value());
-                }
-                else if (itr->second.property_type() == edm_type::int32)
-                {
-                    requires_type = false;
-                    property_value = web::json::value(itr->second.int32_value());
-                }
-                else if (itr->second.property_type() == edm_type::double_floating_point)
-                {
-                    // TODO: Test writing special double values: NaN, Inf, -Inf
-
-                    /*
-                    double double_value = itr->second.double_value();
-                    if (core::is_finite(double_value))
-                    {
-                        requires_type = false;
-                        property_value = web::json::value(double_value);
-                    }
-                    else
-                    {
-                        // Serialize special double values as strings
-                        requires_type = true;
-                        property_value = web::json::value(itr->second.str());
-                    }
-                    */
-
-                    // TODO: Remove this temporary workaround and use the above code after Casablanca fixes truncated double values
-                    requires_type = true;
-                    property_value = web::json::value(itr->second.str());
-                }
-                else
-                {
-                    requires_type = true;
-                    property_value = web::json::value(itr->second.str());
-                }
-
-                if (requires_type)
-                {
-                    utility::string_t property_name_for_type;
-                    property_name_for_type.reserve(itr->first.size() + 11U);
-                    property_name_for_type.append(itr->first);
-                    property_name_for_type.append(U("@odata.type"));
-
-                    utility::string_t value_for_type = get_property_type_name(itr->second.property_type());
-
-                    web::json::value type_name(property_name_for_type);
-                    web::json::value type_value(value_for_type);
-
-                    fields.push_back(std::pair<web::json::value, web::json::value>(type_name, type_value));
-                }
-
-                fields.push_back(std::pair<web::json::value, web::json::value>(property_name, property_value));
-            }
-
-            return web::json::value::object(fields);
+            table_entity_writer::write_entity(body, operation.entity());
+            return true;
         }
 
-        return web::json::value::null();
+        return false;
     }
 
     web::http::http_request table_base_request(web::http::method method, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
@@ -438,7 +363,7 @@ namespace wa { namespace storage { namespace protocol {
             web::http::http_headers& headers = request.headers();
 
             // This operation is processed internally and it does not need metadata because all property types are known
-            populate_http_headers(headers, operation_type, table_payload_format::json_no_metadata);
+            populate_http_headers(headers, operation_type, table_payload_format::json_no_metadata, /* echo_content */ false);
 
             if (operation_type == table_operation_type::insert_operation)
             {
@@ -468,48 +393,73 @@ namespace wa { namespace storage { namespace protocol {
     }
     */
 
-    web::http::http_request execute_operation(const table_operation& operation, table_payload_format payload_format, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
+    web::http::http_request execute_operation(const table_operation& operation, table_payload_format payload_format, bool echo_content, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
     {
         web::http::method method = get_http_method(operation.operation_type());
         web::http::http_request request = table_base_request(method, uri_builder, timeout, context);
 
         web::http::http_headers& headers = request.headers();
-        populate_http_headers(headers, operation, payload_format);
+        populate_http_headers(headers, operation, payload_format, echo_content);
 
-        web::json::value json_object = generate_json_object(operation);
-        if (!json_object.is_null())
+        std::string body;
+        if (write_json_object(body, operation))
         {
-            request.set_body(json_object);
+            size_t length = body.size();
+            request.set_body(Concurrency::streams::bytestream::open_istream(std::move(body)), length, header_value_content_type_json);
         }
 
         return request;
     }
 
-    web::http::http_request execute_batch_operation(Concurrency::streams::stringstreambuf& response_buffer, const cloud_table& table, const table_batch_operation& operation, table_payload_format payload_format, bool is_query, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
+    size_t get_batch_body_size_estimate(const table_batch_operation::operations_type& operations)
+    {
+        // Every operation has about 400 bytes of MIME and HTTP headers, and a property takes about 64 bytes of JSON
+        size_t estimate = 256U;
+        for (table_batch_operation::operations_type::const_iterator itr = operations.cbegin(); itr != operations.cend(); ++itr)
+        {
+            estimate += 400U + itr->entity().partition_key().size() + itr->entity().row_key().size() + itr->entity().properties().size() * 64U;
+        }
+
+        return estimate;
+    }
+
+    size_t get_batch_operation_size(const cloud_table& table, const table_operation& operation)
+    {
+        // The entity is serialized to find its exact size, and the MIME and HTTP headers around it take about 400 bytes besides the request line
+        std::string body;
+        write_json_object(body, operation);
+
+        web::http::uri uri = generate_table_uri(table.service_client().base_uri().primary_uri(), table, operation);
+        return 400U + uri.to_string().size() + body.size();
+    }
+
+    web::http::http_request execute_batch_operation(const cloud_table& table, const table_batch_operation& operation, table_payload_format payload_format, bool is_query, bool echo_content, web::http::uri_builder uri_builder, const std::chrono::seconds& timeout, operation_context context)
     {
         utility::string_t batch_boundary_name = core::generate_boundary_name(U("batch"));
         utility::string_t changeset_boundary_name = core::generate_boundary_name(U("changeset"));
         
         web::http::http_request request = table_base_request(web::http::methods::POST, uri_builder, timeout, context);
-        request.set_response_stream(Concurrency::streams::ostream(response_buffer));
 
         web::http::http_headers& batch_headers = request.headers();
         populate_http_headers(batch_headers, payload_format, batch_boundary_name);
 
-        table_batch_operation::operations_type operations = operation.operations();
+        const table_batch_operation::operations_type& operations = operation.operations();
         //bool is_query = operations.size() == 1 && operations[0].operation_type() == table_operation_type::retrieve_operation;
 
         web::http::uri base_uri = table.service_client().base_uri().primary_uri();
-        utility::string_t body_text;
 
-        core::write_boundary(body_text, batch_boundary_name);
+        // The body is written as UTF-8 into a single buffer that is handed to the request without another copy
+        std::string body;
+        body.reserve(get_batch_body_size_estimate(operations));
+
+        core::write_boundary(body, batch_boundary_name);
 
         if (!is_query)
         {
             web::http::http_headers changeset_headers;
             populate_http_headers(changeset_headers, changeset_boundary_name);
 
-            core::write_request_headers(body_text, changeset_headers);
+            core::write_request_headers(body, changeset_headers);
         }
 
         if (operations.size() > 0U)
@@ -517,44 +467,46 @@ namespace wa { namespace storage { namespace protocol {
             int content_id = 0;
             for (table_batch_operation::operations_type::const_iterator itr = operations.cbegin(); itr != operations.cend(); ++itr)
             {
-                table_operation operation = *itr;
+                const table_operation& operation = *itr;
                 web::http::method method = get_http_method(operation.operation_type());
                 web::http::uri uri = generate_table_uri(base_uri, table, operation);
 
                 web::http::http_headers operation_headers;
-                populate_http_headers(operation_headers, operation, payload_format);
+                populate_http_headers(operation_headers, operation, payload_format, echo_content);
 
                 if (!is_query)
                 {
                     operation_headers.add(header_content_id, core::convert_to_string(content_id));
 
-                    core::write_boundary(body_text, changeset_boundary_name);
+                    core::write_boundary(body, changeset_boundary_name);
                 }
 
-                core::write_mime_multipart_headers(body_text);
-                core::write_request_line(body_text, method, uri);
+                core::write_mime_multipart_headers(body);
+                core::write_request_line(body, method, uri);
                 //core::write_content_id_request_header(body_text, content_id);
-                core::write_request_headers(body_text, operation_headers);
+                core::write_request_headers(body, operation_headers);
 
-                web::json::value json_object = generate_json_object(operation);
-                core::write_request_payload(body_text, json_object);
+                write_json_object(body, operation);
+                core::write_line_break(body);
 
                 ++content_id;
             }
         }
         else
         {
-            core::write_boundary(body_text, changeset_boundary_name);
+            core::write_boundary(body, changeset_boundary_name);
         }
 
         if (!is_query)
         {
-            core::write_boundary(body_text, changeset_boundary_name, /* is_closure */ true);
+            core::write_boundary(body, changeset_boundary_name, /* is_closure */ true);
         }
 
-        core::write_boundary(body_text, batch_boundary_name, /* is_closure */ true);
+        core::write_boundary(body, batch_boundary_name, /* is_closure */ true);
 
-        request.set_body(body_text);
+        // The length is known from the buffer, so the body does not need to be measured again
+        size_t length = body.size();
+        request.set_body(Concurrency::streams::bytestream::open_istream(std::move(body)), length, get_multipart_content_type(batch_boundary_name));
 
         return request;
     }
@@ -564,7 +516,7 @@ namespace wa { namespace storage { namespace protocol {
         web::http::http_request request = table_base_request(web::http::methods::GET, uri_builder, timeout, context);
 
         web::http::http_headers& headers = request.headers();
-        populate_http_headers(headers, table_operation_type::retrieve_operation, payload_format);
+        populate_http_headers(headers, table_operation_type::retrieve_operation, payload_format, /* echo_content */ false);
 
         return request;
     }
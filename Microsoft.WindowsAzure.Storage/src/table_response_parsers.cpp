@@ -17,6 +17,9 @@
 
 #include "stdafx.h"
 #include "wascore/protocol.h"
+#include "wascore/protocol_json.h"
+#include "wascore/resources.h"
+#include "wascore/transcode.h"
 #include "was/common.h"
 
 namespace wa { namespace storage { namespace protocol {
@@ -128,389 +131,236 @@ namespace wa { namespace storage { namespace protocol {
         return continuation_token;
     }
 
-    table_entity table_response_parsers::parse_entity(const web::json::value& obj)
+    namespace
     {
-        table_entity entity;
+        // Number of bytes requested from the response body each time the reader runs out of buffered lines
+        const size_t batch_read_chunk_size = 16 * 1024;
 
-        // TODO: Choose a smart estimate of the number of properties to avoid rehashes
-        /*
-        if (obj.size() > 3)
-        {
-            entity.properties().reserve((obj.size() - 2U) / 2U);
-        }
-        */
-
-        /*
-        utility::string_t partition_key;
-        utility::string_t row_key;
-        utility::string_t etag;
-        datetime timestamp;
-        unordered_map<utility::string_t, entity_property> properties;
-        */
-
-        utility::string_t last_type_for_property;
-        edm_type last_type;
-
-        for (web::json::value::const_iterator property_itr = obj.cbegin(); property_itr != obj.cend(); ++property_itr)
+        /// <summary>
+        /// Reads the lines of a multipart response as the body downloads, keeping only the unread part of the current chunk.
+        /// </summary>
+        class multipart_line_reader
         {
-            utility::string_t property_name = property_itr->first.as_string();
-            web::json::value property_obj = property_itr->second;
+        public:
 
-            if (property_name.compare(0, 6, U("odata.")) == 0)
+            explicit multipart_line_reader(Concurrency::streams::istream stream)
+                : m_source(stream.streambuf()), m_position(0), m_search_position(0), m_source_done(!m_source)
             {
-                // The object is a special OData value
-
-                // TODO: if needed use: odata.type, odata.id, odata.editlink
+            }
 
-                if (property_name.compare(6, property_name.size() - 6, U("etag")) == 0)
+            bool read_line(std::string& line)
+            {
+                for (;;)
                 {
-                    // The object is the ETag
-                    if (!property_obj.is_null() && property_obj.is_string() && entity.etag().empty())
+                    size_t end = m_buffer.find('\n', m_search_position);
+                    if (end != std::string::npos)
                     {
-                        entity.set_etag(property_obj.as_string());
+                        assign_line(line, end);
+                        m_position = end + 1;
+                        m_search_position = m_position;
+                        return true;
+                    }
+
+                    m_search_position = m_buffer.size();
+                    if (!fill_buffer())
+                    {
+                        // The last line does not have to be terminated
+                        if (m_position < m_buffer.size())
+                        {
+                            assign_line(line, m_buffer.size());
+                            m_position = m_buffer.size();
+                            m_search_position = m_position;
+                            return true;
+                        }
+
+                        return false;
                     }
                 }
             }
-            else if (property_name.size() > 11 && property_name.compare(property_name.size() - 11, 11, U("@odata.type")) == 0)
-            {
-                // The object is the type of a property
 
-                if (!property_obj.is_null() && property_obj.is_string())
+        private:
+
+            void assign_line(std::string& line, size_t end)
+            {
+                if (end > m_position && m_buffer[end - 1] == '\r')
+                {
+                    line.assign(m_buffer, m_position, end - 1 - m_position);
+                }
+                else
                 {
-                    last_type_for_property = property_name.substr(0, property_name.size() - 11);
-                    last_type = get_property_type(property_obj.as_string());
+                    line.assign(m_buffer, m_position, end - m_position);
                 }
             }
-            else
+
+            bool fill_buffer()
             {
-                if (property_name.compare(U("PartitionKey")) == 0)
+                if (m_source_done)
                 {
-                    // The object is the Partition Key
-
-                    if (!property_obj.is_null() && property_obj.is_string() && entity.partition_key().empty())
-                    {
-                        entity.set_partition_key(property_obj.as_string());
-                    }
+                    return false;
                 }
-                else if (property_name.compare(U("RowKey")) == 0)
-                {
-                    // The object is the Row Key
 
-                    if (!property_obj.is_null() && property_obj.is_string() && entity.row_key().empty())
-                    {
-                        entity.set_row_key(property_obj.as_string());
-                    }
-                }
-                else if (property_name.compare(U("Timestamp")) == 0)
+                // Lines before the current position have been returned already, so they can be discarded
+                if (m_position > 0)
                 {
-                    // The object is the Timestamp
-
-                    if (!property_obj.is_null() && property_obj.is_string() && !entity.timestamp().is_initialized())
-                    {
-                        utility::datetime timestamp = core::parse_datetime(property_obj.as_string());
-                        entity.set_timestamp(timestamp);
-                    }
+                    m_buffer.erase(0, m_position);
+                    m_search_position -= m_position;
+                    m_position = 0;
                 }
-                else
-                {
-                    // The object is a regular property
 
-                    entity_property entity_property;
+                size_t size = m_buffer.size();
+                m_buffer.resize(size + batch_read_chunk_size);
+                size_t read = m_source.getn(reinterpret_cast<uint8_t*>(&m_buffer[size]), batch_read_chunk_size).get();
+                m_buffer.resize(size + read);
 
-                    // The type is set to String for consistency unless a specific EDM type was specified
-                    if (!property_obj.is_null())
-                    {
-                        /*
-                        entity_property.set_property_type(edm_type::string);
-                        entity_property.set_is_null(true);
-                        */
-
-                        if (property_obj.is_boolean())
-                        {
-                            entity_property.set_value(property_obj.as_bool());
-                        }
-                        else if (property_obj.is_number())
-                        {
-                            /*
-                            // This workaround is used to determine if the property is stored internally as an integer or floating point
-                            numeric_detector detector;
-                            property_obj.serialize(detector);
-                            */
-
-                            if (property_obj.is_integer())
-                            {
-                                entity_property.set_value(property_obj.as_integer());
-                            }
-                            else
-                            {
-                                entity_property.set_value(property_obj.as_double());
-                            }
-                        }
-                        else
-                        {
-                            entity_property.set_value(property_obj.as_string());
-                            if (property_name.compare(last_type_for_property) == 0)
-                            {
-                                entity_property.set_property_type(last_type);
-                            }
-                        }
-                    }
+                if (read == 0)
+                {
+                    m_source_done = true;
+                    return false;
+                }
 
-                    /*
-                    if (property_name.compare(last_type_for_property) == 0)
-                    {
-                        entity_property
-                    }
-                    else
-                    {
-                        // Treat all unknown property types as strings for consistency
-                        entity_property.set_property_type(edm_type::string);
+                return true;
+            }
 
-                        if (property_obj.is_null())
-                        {
-                            entity_property.set_is_null(true);
-                        }
-                        else
-                        {
-                            entity_property.set_value(property_obj.to_string());
-                        }
+            Concurrency::streams::streambuf<uint8_t> m_source;
+            std::string m_buffer;
+            size_t m_position;
+            size_t m_search_position;
+            bool m_source_done;
+        };
 
-                        switch (property_obj.type())
-                        {
-                        case web::json::value::value_type::Null:
-                            entity_property.set_is_null(true);
-                            break;
+        bool starts_with(const std::string& value, const char* prefix)
+        {
+            return value.compare(0, std::strlen(prefix), prefix) == 0;
+        }
 
-                        case web::json::value::value_type::Boolean:
-                            entity_property = entity_property(property_obj.as_bool());
-                            break;
+        std::string trim_header_value(const std::string& line, size_t begin)
+        {
+            while (begin < line.size() && line[begin] == ' ')
+            {
+                ++begin;
+            }
 
-                        case web::json::value::value_type::Number:
-                            property_obj.as_double()
-                            break;
-                        }
-                    }
-                    */
+            return line.substr(begin);
+        }
 
-                    entity.properties().insert(table_entity::property_type(property_name, entity_property));
+        bool is_boundary(const std::string& line, const std::vector<std::string>& boundaries)
+        {
+            for (auto itr = boundaries.cbegin(); itr != boundaries.cend(); ++itr)
+            {
+                if (line.compare(0, itr->size(), *itr) == 0 && (line.size() == itr->size() || line.compare(itr->size(), std::string::npos, "--") == 0))
+                {
+                    return true;
                 }
             }
-        }
 
-        return entity;
+            return false;
+        }
     }
 
-    std::vector<table_result> table_response_parsers::parse_batch_results(Concurrency::streams::stringstreambuf& response_buffer, bool is_query, size_t batch_size)
+    std::vector<table_result> table_response_parsers::parse_batch_results(Concurrency::streams::istream response_body, bool is_query, size_t batch_size)
     {
         std::vector<table_result> batch_result;
         batch_result.reserve(batch_size);
 
-        std::string& response_body = response_buffer.collection();
-
-        // TODO: Make this Casablanca code more robust
-
-        // More strings we will search for during the course of parsing
-        std::string http_begin("HTTP"), etag_header("ETag: "), crlf("\r\n"), crlfcrlf("\r\n\r\n"), space(" ");
-
-        if (is_query)
+        // The multipart body is read a line at a time: MIME part headers, then for every operation an HTTP status line,
+        // its headers and its content up to the next batch or changeset boundary.
+        multipart_line_reader reader(response_body);
+        std::vector<std::string> boundaries;
+        std::string closing_boundary;
+        bool closed = false;
+        std::string line;
+        std::string content;
+
+        bool has_line = reader.read_line(line);
+        while (has_line)
         {
-            // Find the HTTP status line
-            size_t response_begin = response_body.find(http_begin);
-
-            // Find the status code within that line
-            size_t status_code_begin = response_body.find(space, response_begin) + space.size();
-            size_t status_code_end = response_body.find(space, status_code_begin);
-            std::string status_code_string = response_body.substr(status_code_begin, status_code_end - status_code_begin);
-
-            // Extract the status code as an integer
-            int status_code = utility::conversions::scan_string<int>(utility::conversions::to_string_t(status_code_string));
-
-            // Acceptable codes are 'Created' and 'NoContent'
-            if (status_code == web::http::status_codes::OK || status_code == web::http::status_codes::Created || status_code == web::http::status_codes::Accepted || status_code == web::http::status_codes::NoContent || status_code == web::http::status_codes::PartialContent || status_code == web::http::status_codes::NotFound)
+            if (!starts_with(line, "HTTP"))
             {
-                table_result result;
-                result.set_http_status_code(status_code);
-
-                // The operation succeeded. Try to find an ETag: header if it exists. Delete operations will not have an etag header
-                // so copy the list of headers into a substring and search within the list, lest we cross a changeset boundary.
-                size_t headersBegin = response_body.find(crlf, status_code_end) + crlf.size();
-                size_t headersEnd = response_body.find(crlfcrlf, headersBegin) + crlf.size();
-                std::string headers = response_body.substr(headersBegin, headersEnd - headersBegin);
-
-                utility::string_t etag_value;
-
-                size_t etagBegin = headers.find(etag_header);
-                if (etagBegin != std::string::npos)
+                // The first boundary delimits the batch, and the Content-Type header of a part names the changeset boundary
+                if (boundaries.empty() && starts_with(line, "--"))
                 {
-                    etagBegin += etag_header.size();
-                    size_t etagEnd = headers.find(crlf, etagBegin);
-                    std::string etag = headers.substr(etagBegin, etagEnd - etagBegin);
-                    etag_value = utility::conversions::to_string_t(etag);
-
-                    result.set_etag(etag_value);
+                    boundaries.push_back(line);
+                    closing_boundary = line + "--";
+                }
+                else if (line == closing_boundary)
+                {
+                    closed = true;
+                }
+                else
+                {
+                    size_t boundary_begin = line.find("boundary=");
+                    if (starts_with(line, "Content-Type") && boundary_begin != std::string::npos)
+                    {
+                        boundaries.push_back("--" + line.substr(boundary_begin + 9));
+                    }
                 }
 
-                size_t content_begin_offset = response_body.find(crlfcrlf, status_code_end) + crlfcrlf.size();
-                size_t content_end_offset = response_body.find("\r\n--batchresponse", content_begin_offset) + crlf.size();
-
-                std::string content_string = response_body.substr(content_begin_offset, content_end_offset - content_begin_offset);
-
-                web::json::value obj = web::json::value::parse(utility::conversions::to_string_t(content_string));
-                table_entity entity = parse_entity(obj);
-                entity.set_etag(etag_value);
-                result.set_entity(entity);
-
-                batch_result.push_back(result);
+                has_line = reader.read_line(line);
+                continue;
             }
-            else
-            {
-                // An operation failed. Find the start of the XML block that contains information about the error
-                size_t content_begin_offset = response_body.find(crlfcrlf, status_code_end) + crlfcrlf.size();
-                size_t content_end_offset = response_body.find("\r\n--batchresponse", content_begin_offset) + crlf.size();
 
-                std::string error_string = response_body.substr(content_begin_offset, content_end_offset - content_begin_offset);
+            // Find the status code within the status line
+            size_t status_code_begin = line.find(' ');
+            int status_code = status_code_begin == std::string::npos ? 0 : std::atoi(line.c_str() + status_code_begin + 1);
 
-                throw storage_exception(utility::conversions::to_utf8string(error_string));
+            // The operation's headers end with an empty line. Delete operations will not have an ETag header.
+            utility::string_t etag;
+            while ((has_line = reader.read_line(line)) && !line.empty())
+            {
+                if (starts_with(line, "ETag:"))
+                {
+                    etag = core::to_string_t(trim_header_value(line, 5));
+                }
             }
-        }
-        else
-        {
-            // Strings we will search for during the course of parsing
-            std::string content_type("Content-Type"), boundary_begin("boundary=");
-
-            // Find the Content-Type header for the batch - it contains the changeset marker right after the occurence of "boundary="
-            size_t content_typeOffset = response_body.find(content_type);
-            size_t changeset_begin_offset = response_body.find(boundary_begin, content_typeOffset) + boundary_begin.size();
-            size_t changeset_end_offset = response_body.find(crlf, changeset_begin_offset);
-
-            std::string changeset_marker_prefix = "--" + response_body.substr(changeset_begin_offset, changeset_end_offset - changeset_begin_offset);
-            std::string changeset_begin_marker = changeset_marker_prefix + crlf;
 
-            size_t result_index = SIZE_MAX;
+            // Acceptable codes are 'Created' and 'NoContent', and 'NotFound' for a retrieve
+            bool succeeded = status_code == web::http::status_codes::OK || status_code == web::http::status_codes::Created || status_code == web::http::status_codes::Accepted || status_code == web::http::status_codes::NoContent || status_code == web::http::status_codes::PartialContent || (is_query && status_code == web::http::status_codes::NotFound);
 
-            // Loop through the response looking for changeset begin markers.
-            size_t next_changeset = response_body.find(changeset_begin_marker, changeset_end_offset);
+            // Only the entity of a retrieve or of an insert that echoes it and the description of a failure are kept, the content of other operations is skipped
+            bool keep_content = !succeeded || status_code == web::http::status_codes::OK || status_code == web::http::status_codes::Created;
 
-            while(next_changeset != std::string::npos)
+            content.clear();
+            while (has_line && (has_line = reader.read_line(line)) && !is_boundary(line, boundaries))
             {
-                ++result_index;
-                // Find the HTTP status line
-                size_t response_begin = response_body.find(http_begin, next_changeset + changeset_begin_marker.size());
-
-                // Find the status code within that line
-                size_t status_code_begin = response_body.find(space, response_begin) + space.size();
-                size_t status_code_end = response_body.find(space, status_code_begin);
-                std::string status_code_string = response_body.substr(status_code_begin, status_code_end - status_code_begin);
-
-                // Extract the status code as an integer
-                int status_code = utility::conversions::scan_string<int>(utility::conversions::to_string_t(status_code_string));
-
-                // Acceptable codes are 'Created' and 'NoContent'
-                if (status_code == web::http::status_codes::OK || status_code == web::http::status_codes::Created || status_code == web::http::status_codes::Accepted || status_code == web::http::status_codes::NoContent || status_code == web::http::status_codes::PartialContent)
+                if (keep_content)
                 {
-                    table_result result;
-                    result.set_http_status_code(status_code);
-
-                    // The operation succeeded. Try to find an ETag: header if it exists. Delete operations will not have an etag header
-                    // so copy the list of headers into a substring and search within the list, lest we cross a changeset boundary.
-                    size_t headersBegin = response_body.find(crlf, status_code_end) + crlf.size();
-                    size_t headersEnd = response_body.find(crlfcrlf, headersBegin) + crlf.size();
-                    std::string headers = response_body.substr(headersBegin, headersEnd - headersBegin);
-
-                    size_t etagBegin = headers.find(etag_header);
-                    if (etagBegin != std::string::npos)
-                    {
-                        etagBegin += etag_header.size();
-                        size_t etagEnd = headers.find(crlf, etagBegin);
-                        std::string etag = headers.substr(etagBegin, etagEnd - etagBegin);
-
-                        result.set_etag(utility::conversions::to_string_t(etag));
-                    }
-
-                    batch_result.push_back(result);
-
-                    next_changeset = response_body.find(changeset_begin_marker, headersEnd);
-                }
-                else
-                {
-                    // An operation failed. Find the start of the XML block that contains information about the error
-                    size_t content_begin_offset = response_body.find(crlfcrlf, status_code_end) + crlfcrlf.size();
-                    size_t content_end_offset = response_body.find(changeset_marker_prefix, content_begin_offset);
-
-                    std::string error_string = response_body.substr(content_begin_offset, content_end_offset - content_begin_offset);
-
-                    throw storage_exception(utility::conversions::to_utf8string(error_string));
+                    content.append(line).append("\r\n");
                 }
             }
-        }
-
-        return batch_result;
-    }
 
-    std::vector<table_entity> table_response_parsers::parse_query_results(const web::json::value& obj)
-    {
-        std::vector<table_entity> result;
-
-        if (obj.is_object())
-        {
-            /*
-            for (web::json::value::const_iterator obj_itr = obj.cbegin(); obj_itr != obj.cend(); ++obj_itr)
+            // A body that ends inside an operation was cut short, so neither its status nor its content can be trusted
+            if (!has_line)
             {
+                break;
             }
-            */
 
-            web::json::value entities_obj = obj.get(U("value"));
-            if (!entities_obj.is_null() && entities_obj.is_array())
+            if (!succeeded)
             {
-                for (web::json::value::const_iterator entity_itr = entities_obj.cbegin(); entity_itr != entities_obj.cend(); ++entity_itr)
-                {
-                    web::json::value entity_obj = entity_itr->second;
-                    if (!entity_obj.is_null() && entity_obj.is_object() && entity_obj.size() > 0)
-                    {
-                        table_entity entity = parse_entity(entity_obj);
-                        result.push_back(entity);
-                    }
-                }
+                // An operation failed, and the content contains information about the error
+                throw storage_exception(content);
             }
-        }
 
-        return result;
-    }
+            table_result result;
+            result.set_http_status_code(status_code);
+            result.set_etag(etag);
 
-    edm_type table_response_parsers::get_property_type(const utility::string_t& type_name)
-    {
-        if (type_name.compare(U("Edm.Binary")) == 0)
-        {
-            return edm_type::binary;
-        }
-        else if (type_name.compare(U("Edm.Boolean")) == 0)
-        {
-            return edm_type::boolean;
-        }
-        else if (type_name.compare(U("Edm.DateTime")) == 0)
-        {
-            return edm_type::datetime;
-        }
-        else if (type_name.compare(U("Edm.Double")) == 0)
-        {
-            return edm_type::double_floating_point;
-        }
-        else if (type_name.compare(U("Edm.Guid")) == 0)
-        {
-            return edm_type::guid;
-        }
-        else if (type_name.compare(U("Edm.Int32")) == 0)
-        {
-            return edm_type::int32;
-        }
-        else if (type_name.compare(U("Edm.Int64")) == 0)
-        {
-            return edm_type::int64;
+            if (keep_content)
+            {
+                table_entity_reader entity_reader(content.data(), content.size(), /* is_query */ false);
+                table_entity entity = entity_reader.extract_entity();
+                entity.set_etag(etag);
+                result.set_entity(entity);
+            }
+
+            batch_result.push_back(result);
         }
-        else
+
+        if (!closed)
         {
-            return edm_type::string;
+            throw storage_exception(utility::conversions::to_utf8string(protocol::error_truncated_batch_response));
         }
+
+        return batch_result;
     }
 
 }}} // namespace wa::storage::protocol
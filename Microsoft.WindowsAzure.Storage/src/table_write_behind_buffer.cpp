@@ -0,0 +1,449 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="table_write_behind_buffer.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <map>
+
+#include "wascore/async_semaphore.h"
+#include "wascore/constants.h"
+#include "wascore/protocol.h"
+#include "wascore/resources.h"
+#include "wascore/util.h"
+#include "was/table.h"
+
+namespace wa { namespace storage {
+
+    namespace
+    {
+        bool replaces_entity(table_operation_type type)
+        {
+            return type == table_operation_type::insert_or_replace_operation || type == table_operation_type::replace_operation;
+        }
+
+        bool inserts_entity(table_operation_type type)
+        {
+            return type == table_operation_type::insert_or_replace_operation || type == table_operation_type::insert_or_merge_operation;
+        }
+
+        // Combines a buffered write of an entity with a later write of the same entity into a single write with the same outcome
+        table_operation combine_operations(const table_operation& earlier, const table_operation& later)
+        {
+            table_operation_type earlier_type = earlier.operation_type();
+            table_operation_type later_type = later.operation_type();
+            const utility::string_t& etag = earlier.entity().etag().empty() ? later.entity().etag() : earlier.entity().etag();
+
+            table_entity entity(later.entity().partition_key(), later.entity().row_key(), etag, later.entity().properties());
+            if (replaces_entity(later_type))
+            {
+                // The entity exists once the earlier write has inserted it, so only inserting it as well keeps the outcome
+                table_operation_type type = inserts_entity(earlier_type) ? table_operation_type::insert_or_replace_operation : later_type;
+                return type == table_operation_type::insert_or_replace_operation ? table_operation::insert_or_replace_entity(entity) : table_operation::replace_entity(entity);
+            }
+
+            // Properties of the later write win over the ones of the earlier write
+            table_entity::properties_type properties(later.entity().properties());
+            const table_entity::properties_type& earlier_properties = earlier.entity().properties();
+            properties.insert(earlier_properties.cbegin(), earlier_properties.cend());
+            entity = table_entity(entity.partition_key(), entity.row_key(), etag, properties);
+
+            switch (earlier_type)
+            {
+            case table_operation_type::insert_or_replace_operation:
+                return table_operation::insert_or_replace_entity(entity);
+
+            case table_operation_type::replace_operation:
+                return table_operation::replace_entity(entity);
+
+            default:
+                return (earlier_type == table_operation_type::insert_or_merge_operation || later_type == table_operation_type::insert_or_merge_operation) ?
+                    table_operation::insert_or_merge_entity(entity) : table_operation::merge_entity(entity);
+            }
+        }
+    }
+
+    struct table_write_behind_buffer::shared_state
+    {
+        // The write of an entity, which later writes of the entity are combined into until it is sent
+        struct pending_write
+        {
+            explicit pending_write(const table_operation& operation)
+                : operation(operation)
+            {
+            }
+
+            table_operation operation;
+            pplx::task_completion_event<void> written;
+        };
+
+        typedef std::map<utility::string_t, std::shared_ptr<pending_write>> rows_type;
+        typedef std::map<utility::string_t, rows_type> partitions_type;
+
+        // The writes that are sent together, and whose flushes complete once all of them have been applied
+        struct flush_run
+        {
+            flush_run()
+                : remaining_batches(0)
+            {
+            }
+
+            partitions_type partitions;
+            pplx::task_completion_event<void> completed;
+            size_t remaining_batches;
+            std::exception_ptr error;
+        };
+
+        shared_state(const cloud_table& table, const table_request_options& options, operation_context context)
+            : table(table), options(options), context(context), semaphore(options.parallelism_factor()), flush_interval(protocol::default_write_behind_flush_interval),
+            next_run(std::make_shared<flush_run>()), is_flush_requested(false), is_timer_scheduled(false)
+        {
+        }
+
+        // Must be called with the mutex held, and returns the run that the caller has to send, if there is one
+        std::shared_ptr<flush_run> take_next_run()
+        {
+            if (current_run != nullptr || next_run->partitions.empty())
+            {
+                return nullptr;
+            }
+
+            current_run = next_run;
+            next_run = std::make_shared<flush_run>();
+            is_flush_requested = false;
+            return current_run;
+        }
+
+        // Must be called with the mutex held, and returns true if the caller has to start a timer
+        bool schedule_timer()
+        {
+            if (is_timer_scheduled || current_run != nullptr || next_run->partitions.empty())
+            {
+                return false;
+            }
+
+            is_timer_scheduled = true;
+            return true;
+        }
+
+        static void start_timer(std::shared_ptr<shared_state> state, std::chrono::milliseconds delay)
+        {
+            core::complete_after(delay).then([state] ()
+            {
+                std::shared_ptr<flush_run> run;
+                {
+                    std::lock_guard<std::mutex> guard(state->mutex);
+                    state->is_timer_scheduled = false;
+                    run = state->take_next_run();
+                }
+
+                send_run(state, run);
+            });
+        }
+
+        static void complete_write(std::shared_ptr<shared_state> state, std::shared_ptr<flush_run> run, const std::shared_ptr<pending_write>& write, std::exception_ptr error)
+        {
+            if (error == nullptr)
+            {
+                write->written.set();
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (run->error == nullptr)
+                {
+                    run->error = error;
+                }
+            }
+
+            write->written.set_exception(error);
+        }
+
+        static pplx::task<void> write_operation_async(std::shared_ptr<shared_state> state, std::shared_ptr<flush_run> run, std::shared_ptr<pending_write> write)
+        {
+            return state->table.execute_async(write->operation, state->options, state->context).then([state, run, write] (pplx::task<table_result> result_task)
+            {
+                std::exception_ptr error;
+                try
+                {
+                    result_task.wait();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                complete_write(state, run, write, error);
+            });
+        }
+
+        static pplx::task<void> write_batch_async(std::shared_ptr<shared_state> state, std::shared_ptr<flush_run> run, std::shared_ptr<std::vector<std::shared_ptr<pending_write>>> batch)
+        {
+            if (batch->size() == 1)
+            {
+                return write_operation_async(state, run, batch->front());
+            }
+
+            table_batch_operation operation;
+            for (auto iter = batch->cbegin(); iter != batch->cend(); ++iter)
+            {
+                operation.operations().push_back((*iter)->operation);
+            }
+
+            return state->table.execute_batch_async(operation, state->options, state->context).then([state, run, batch] (pplx::task<std::vector<table_result>> result_task) -> pplx::task<void>
+            {
+                try
+                {
+                    result_task.wait();
+                    for (auto iter = batch->cbegin(); iter != batch->cend(); ++iter)
+                    {
+                        (*iter)->written.set();
+                    }
+
+                    return pplx::task_from_result();
+                }
+                catch (...)
+                {
+                }
+
+                // None of the operations in a failed batch have been applied, so they are sent one at a time to find out which of them failed
+                auto next_write = std::make_shared<size_t>(0);
+                return pplx::details::do_while([state, run, batch, next_write] () -> pplx::task<bool>
+                {
+                    auto write = (*batch)[(*next_write)++];
+                    return write_operation_async(state, run, write).then([batch, next_write] () -> bool
+                    {
+                        return *next_write < batch->size();
+                    });
+                }).then([] (bool)
+                {
+                });
+            });
+        }
+
+        static void send_run(std::shared_ptr<shared_state> state, std::shared_ptr<flush_run> run)
+        {
+            if (run == nullptr)
+            {
+                return;
+            }
+
+            // Every entity is written once per run, so the batches of a partition can be sent at the same time
+            std::vector<std::shared_ptr<std::vector<std::shared_ptr<pending_write>>>> batches;
+            for (auto partition = run->partitions.cbegin(); partition != run->partitions.cend(); ++partition)
+            {
+                std::shared_ptr<std::vector<std::shared_ptr<pending_write>>> batch;
+                size_t payload_size = 0;
+                for (auto row = partition->second.cbegin(); row != partition->second.cend(); ++row)
+                {
+                    size_t operation_size = protocol::get_batch_operation_size(state->table, row->second->operation);
+                    if (batch == nullptr || batch->size() >= protocol::max_batch_operations || payload_size + operation_size > protocol::max_batch_payload_size)
+                    {
+                        batch = std::make_shared<std::vector<std::shared_ptr<pending_write>>>();
+                        batches.push_back(batch);
+                        payload_size = 0;
+                    }
+
+                    batch->push_back(row->second);
+                    payload_size += operation_size;
+                }
+            }
+
+            run->remaining_batches = batches.size();
+            for (auto iter = batches.cbegin(); iter != batches.cend(); ++iter)
+            {
+                auto batch = *iter;
+                state->semaphore.lock_async().then([state, run, batch] ()
+                {
+                    return write_batch_async(state, run, batch);
+                }).then([state, run, batch] (pplx::task<void> written_task)
+                {
+                    try
+                    {
+                        written_task.wait();
+                    }
+                    catch (...)
+                    {
+                        // Failures of the requests are recorded already, so this is an error that prevented them from being sent
+                        std::exception_ptr error = std::current_exception();
+                        for (auto write = batch->cbegin(); write != batch->cend(); ++write)
+                        {
+                            complete_write(state, run, *write, error);
+                        }
+                    }
+
+                    state->semaphore.unlock();
+                    complete_batch(state, run);
+                });
+            }
+        }
+
+        static void complete_batch(std::shared_ptr<shared_state> state, std::shared_ptr<flush_run> run)
+        {
+            std::shared_ptr<flush_run> next;
+            bool start_timer_now = false;
+            std::chrono::milliseconds delay;
+            std::exception_ptr error;
+            {
+                std::lock_guard<std::mutex> guard(state->mutex);
+                if (--run->remaining_batches > 0)
+                {
+                    return;
+                }
+
+                error = run->error;
+                state->current_run.reset();
+
+                // Writes buffered while the run was sent go out at once if a flush asked for them, or after the flush interval otherwise
+                if (state->is_flush_requested || state->flush_interval.count() <= 0)
+                {
+                    next = state->take_next_run();
+                }
+                else
+                {
+                    start_timer_now = state->schedule_timer();
+                    delay = state->flush_interval;
+                }
+            }
+
+            if (error == nullptr)
+            {
+                run->completed.set();
+            }
+            else
+            {
+                run->completed.set_exception(error);
+            }
+
+            send_run(state, next);
+            if (start_timer_now)
+            {
+                start_timer(state, delay);
+            }
+        }
+
+        cloud_table table;
+        table_request_options options;
+        operation_context context;
+        core::async_semaphore semaphore;
+        std::chrono::milliseconds flush_interval;
+
+        // The writes being sent, and the ones buffered since, which are sent by the next run
+        std::shared_ptr<flush_run> current_run;
+        std::shared_ptr<flush_run> next_run;
+        bool is_flush_requested;
+        bool is_timer_scheduled;
+        mutable std::mutex mutex;
+    };
+
+    void table_write_behind_buffer::initialize(const cloud_table& table, const table_request_options& options, operation_context context)
+    {
+        table_request_options modified_options(options);
+        modified_options.apply_defaults(table.service_client().default_request_options());
+
+        m_state = std::make_shared<shared_state>(table, modified_options, context);
+    }
+
+    pplx::task<void> table_write_behind_buffer::write_async(const table_operation& operation)
+    {
+        table_operation_type type = operation.operation_type();
+        if (type != table_operation_type::insert_or_replace_operation && type != table_operation_type::insert_or_merge_operation &&
+            type != table_operation_type::replace_operation && type != table_operation_type::merge_operation)
+        {
+            throw std::invalid_argument(utility::conversions::to_utf8string(protocol::error_write_behind_operation));
+        }
+
+        auto state = m_state;
+        std::shared_ptr<shared_state::flush_run> run;
+        bool start_timer_now = false;
+        std::chrono::milliseconds delay;
+        pplx::task<void> result;
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            auto& write = state->next_run->partitions[operation.entity().partition_key()][operation.entity().row_key()];
+            if (write == nullptr)
+            {
+                write = std::make_shared<shared_state::pending_write>(operation);
+            }
+            else
+            {
+                write->operation = combine_operations(write->operation, operation);
+            }
+
+            result = pplx::create_task(write->written);
+
+            if (state->flush_interval.count() <= 0)
+            {
+                run = state->take_next_run();
+            }
+            else
+            {
+                start_timer_now = state->schedule_timer();
+                delay = state->flush_interval;
+            }
+        }
+
+        shared_state::send_run(state, run);
+        if (start_timer_now)
+        {
+            shared_state::start_timer(state, delay);
+        }
+
+        return result;
+    }
+
+    pplx::task<void> table_write_behind_buffer::flush_async()
+    {
+        auto state = m_state;
+        std::shared_ptr<shared_state::flush_run> run;
+        pplx::task<void> result = pplx::task_from_result();
+        {
+            std::lock_guard<std::mutex> guard(state->mutex);
+            if (!state->next_run->partitions.empty())
+            {
+                // A running flush sends the buffered writes as soon as it is done
+                result = pplx::create_task(state->next_run->completed);
+                state->is_flush_requested = true;
+                run = state->take_next_run();
+            }
+            else if (state->current_run != nullptr)
+            {
+                result = pplx::create_task(state->current_run->completed);
+            }
+        }
+
+        shared_state::send_run(state, run);
+        return result;
+    }
+
+    std::chrono::milliseconds table_write_behind_buffer::flush_interval() const
+    {
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        return m_state->flush_interval;
+    }
+
+    void table_write_behind_buffer::set_flush_interval(std::chrono::milliseconds value)
+    {
+        if (value.count() < 0)
+        {
+            throw std::invalid_argument("value");
+        }
+
+        std::lock_guard<std::mutex> guard(m_state->mutex);
+        m_state->flush_interval = value;
+    }
+
+}} // namespace wa::storage
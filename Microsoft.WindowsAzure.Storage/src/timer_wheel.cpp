@@ -0,0 +1,263 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="timer_wheel.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/timer_wheel.h"
+
+#include <thread>
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        // Resolution of the timers. A timer fires within one tick after its delay has passed.
+        const std::chrono::milliseconds tick_length(10);
+
+        // Level 0 spans 256 ticks and each level above spans 64 times as many as the level below, so four
+        // levels cover more than a week. Longer timers are moved back to the top level until they are due.
+        const size_t level_count = 4;
+        const int lowest_level_bits = 8;
+        const int upper_level_bits = 6;
+
+        // Longer delays are cut to this, so that adding them to the clock cannot overflow
+        const std::chrono::hours max_delay(24 * 365 * 10);
+
+        std::once_flag instance_flag;
+        timer_wheel* instance_pointer;
+
+        int get_shift(size_t level)
+        {
+            return level == 0 ? 0 : lowest_level_bits + static_cast<int>(level - 1) * upper_level_bits;
+        }
+
+        uint64_t get_mask(size_t level)
+        {
+            return level == 0 ? (1 << lowest_level_bits) - 1 : (1 << upper_level_bits) - 1;
+        }
+    }
+
+    timer_wheel& timer_wheel::instance()
+    {
+        // The wheel is never destroyed, because its thread may still be waiting when the library is unloaded
+        std::call_once(instance_flag, [] ()
+        {
+            instance_pointer = new timer_wheel();
+        });
+
+        return *instance_pointer;
+    }
+
+    timer_wheel::timer_wheel()
+        : m_epoch(std::chrono::steady_clock::now()), m_current_tick(0), m_wake_tick(UINT64_MAX), m_pending(0), m_started(false)
+    {
+        m_levels.resize(level_count);
+        for (size_t level = 0; level < level_count; ++level)
+        {
+            m_levels[level].resize(static_cast<size_t>(get_mask(level) + 1));
+        }
+    }
+
+    timer_wheel::timer timer_wheel::schedule(std::chrono::milliseconds delay, std::function<void()> callback)
+    {
+        // The timer is due at the first tick that starts after the delay has passed
+        delay = std::min(std::max(delay, std::chrono::milliseconds::zero()), std::chrono::duration_cast<std::chrono::milliseconds>(max_delay));
+        auto due = std::chrono::steady_clock::now() - m_epoch + delay;
+        auto expiry = static_cast<uint64_t>((due + tick_length - std::chrono::steady_clock::duration(1)) / tick_length);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!m_started)
+        {
+            std::thread([this] ()
+            {
+                run();
+            }).detach();
+            m_started = true;
+        }
+
+        // An idle wheel is not advanced, so it catches up with the clock when a timer is scheduled again
+        if (m_pending == 0)
+        {
+            m_current_tick = std::max(m_current_tick, get_tick(std::chrono::steady_clock::now()));
+        }
+
+        auto value = std::make_shared<entry>(expiry, std::move(callback));
+        insert(value);
+        ++m_pending;
+
+        if (value->expiry < m_wake_tick)
+        {
+            m_condition.notify_one();
+        }
+
+        return timer(this, value);
+    }
+
+    void timer_wheel::cancel(const std::shared_ptr<entry>& value)
+    {
+        // The entry stays in its slot and is dropped when the wheel reaches it
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!value->done)
+        {
+            value->done = true;
+            value->callback = nullptr;
+            --m_pending;
+        }
+    }
+
+    void timer_wheel::insert(std::shared_ptr<entry> value)
+    {
+        auto expiry = std::max(value->expiry, m_current_tick);
+        auto delta = expiry - m_current_tick;
+
+        size_t level = 0;
+        uint64_t span = get_mask(0) + 1;
+        while (level + 1 < level_count && delta >= span)
+        {
+            ++level;
+            span <<= upper_level_bits;
+        }
+
+        if (delta >= span)
+        {
+            expiry = m_current_tick + span - 1;
+        }
+
+        m_levels[level][static_cast<size_t>((expiry >> get_shift(level)) & get_mask(level))].push_back(std::move(value));
+    }
+
+    void timer_wheel::cascade(size_t level)
+    {
+        std::vector<std::shared_ptr<entry>> entries;
+        entries.swap(m_levels[level][static_cast<size_t>((m_current_tick >> get_shift(level)) & get_mask(level))]);
+        for (auto iter = entries.begin(); iter != entries.end(); ++iter)
+        {
+            if (!(*iter)->done)
+            {
+                insert(std::move(*iter));
+            }
+        }
+    }
+
+    void timer_wheel::advance(std::vector<std::function<void()>>& expired)
+    {
+        // Whenever a level wraps around, the next slot of the level above is spread over the levels below
+        for (size_t level = 1; level < level_count && ((m_current_tick >> get_shift(level)) << get_shift(level)) == m_current_tick; ++level)
+        {
+            cascade(level);
+        }
+
+        std::vector<std::shared_ptr<entry>> entries;
+        entries.swap(m_levels[0][static_cast<size_t>(m_current_tick & get_mask(0))]);
+        for (auto iter = entries.begin(); iter != entries.end(); ++iter)
+        {
+            auto& value = *iter;
+            if (value->done)
+            {
+                continue;
+            }
+
+            if (value->expiry <= m_current_tick)
+            {
+                value->done = true;
+                expired.push_back(std::move(value->callback));
+                value->callback = nullptr;
+                --m_pending;
+            }
+            else
+            {
+                insert(std::move(value));
+            }
+        }
+
+        ++m_current_tick;
+    }
+
+    uint64_t timer_wheel::get_next_wake_tick() const
+    {
+        if (m_pending == 0)
+        {
+            return UINT64_MAX;
+        }
+
+        // Level 0 is only scanned up to where it wraps around, since the level above is cascaded there anyway
+        if ((m_current_tick & get_mask(0)) == 0)
+        {
+            return m_current_tick;
+        }
+
+        auto boundary = (m_current_tick | get_mask(0)) + 1;
+        for (auto tick = m_current_tick; tick < boundary; ++tick)
+        {
+            if (!m_levels[0][static_cast<size_t>(tick & get_mask(0))].empty())
+            {
+                return tick;
+            }
+        }
+
+        return boundary;
+    }
+
+    uint64_t timer_wheel::get_tick(std::chrono::steady_clock::time_point time) const
+    {
+        return static_cast<uint64_t>((time - m_epoch) / tick_length);
+    }
+
+    void timer_wheel::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            std::vector<std::function<void()>> expired;
+            auto now_tick = get_tick(std::chrono::steady_clock::now());
+            while (m_pending > 0 && m_current_tick <= now_tick)
+            {
+                advance(expired);
+            }
+
+            if (!expired.empty())
+            {
+                // Callbacks run without the lock, so that they can schedule and cancel timers
+                m_wake_tick = 0;
+                lock.unlock();
+                for (auto iter = expired.begin(); iter != expired.end(); ++iter)
+                {
+                    try
+                    {
+                        (*iter)();
+                    }
+                    catch (...)
+                    {
+                    }
+                }
+
+                lock.lock();
+                continue;
+            }
+
+            m_wake_tick = get_next_wake_tick();
+            if (m_wake_tick == UINT64_MAX)
+            {
+                m_condition.wait(lock);
+            }
+            else
+            {
+                m_condition.wait_until(lock, m_epoch + tick_length * static_cast<std::chrono::milliseconds::rep>(m_wake_tick));
+            }
+        }
+    }
+
+}}} // namespace wa::storage::core
@@ -0,0 +1,264 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="transcode.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+
+#include "stdafx.h"
+#include "wascore/transcode.h"
+
+#if defined(_UTF16_STRINGS) && (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#include <emmintrin.h>
+#define WASTORAGE_TRANSCODE_SSE2
+#endif
+
+namespace wa { namespace storage { namespace core {
+
+#ifdef _UTF16_STRINGS
+
+    namespace
+    {
+        // Copies the leading ASCII characters of the UTF-16 text, returning how many were copied
+        size_t narrow_ascii(const utility::char_t* source, size_t size, char* target)
+        {
+            size_t i = 0;
+#ifdef WASTORAGE_TRANSCODE_SSE2
+            const __m128i non_ascii_bits = _mm_set1_epi16(static_cast<short>(0xFF80));
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+                __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 8));
+                __m128i non_ascii = _mm_and_si128(_mm_or_si128(first, second), non_ascii_bits);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, _mm_setzero_si128())) != 0xFFFF)
+                {
+                    break;
+                }
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_packus_epi16(first, second));
+            }
+#endif
+
+            for (; (i < size) && (static_cast<uint16_t>(source[i]) < 0x80); ++i)
+            {
+                target[i] = static_cast<char>(source[i]);
+            }
+
+            return i;
+        }
+
+        // Widens the leading ASCII bytes of the UTF-8 text, returning how many were widened
+        size_t widen_ascii(const char* source, size_t size, utility::char_t* target)
+        {
+            size_t i = 0;
+#ifdef WASTORAGE_TRANSCODE_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+                if (_mm_movemask_epi8(bytes) != 0)
+                {
+                    break;
+                }
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_unpacklo_epi8(bytes, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i + 8), _mm_unpackhi_epi8(bytes, zero));
+            }
+#endif
+
+            for (; (i < size) && (static_cast<uint8_t>(source[i]) < 0x80); ++i)
+            {
+                target[i] = static_cast<utility::char_t>(source[i]);
+            }
+
+            return i;
+        }
+
+        // Decodes the UTF-8 sequence at the start of the text, returning its length, or 0 if it is not valid
+        size_t decode_utf8(const uint8_t* source, size_t size, uint32_t& code_point)
+        {
+            uint8_t lead = source[0];
+            size_t length;
+            uint32_t minimum;
+            if ((lead & 0xE0) == 0xC0)
+            {
+                length = 2;
+                minimum = 0x80;
+                code_point = lead & 0x1F;
+            }
+            else if ((lead & 0xF0) == 0xE0)
+            {
+                length = 3;
+                minimum = 0x800;
+                code_point = lead & 0x0F;
+            }
+            else if ((lead & 0xF8) == 0xF0)
+            {
+                length = 4;
+                minimum = 0x10000;
+                code_point = lead & 0x07;
+            }
+            else
+            {
+                return 0;
+            }
+
+            if (length > size)
+            {
+                return 0;
+            }
+
+            for (size_t i = 1; i < length; ++i)
+            {
+                if ((source[i] & 0xC0) != 0x80)
+                {
+                    return 0;
+                }
+
+                code_point = (code_point << 6) | (source[i] & 0x3F);
+            }
+
+            // Overlong forms, surrogates and values above the last code point are not valid UTF-8
+            if ((code_point < minimum) || (code_point > 0x10FFFF) || ((code_point >= 0xD800) && (code_point < 0xE000)))
+            {
+                return 0;
+            }
+
+            return length;
+        }
+    }
+
+    void append_utf8(std::string& target, const utility::char_t* data, size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        // A code unit never takes more than three bytes, because a pair of surrogates takes four
+        size_t start = target.size();
+        target.resize(start + size * 3);
+        char* begin = &target[start];
+        char* out = begin;
+
+        size_t i = 0;
+        while (i < size)
+        {
+            size_t ascii = narrow_ascii(data + i, size - i, out);
+            i += ascii;
+            out += ascii;
+            if (i == size)
+            {
+                break;
+            }
+
+            uint32_t code_point = static_cast<uint16_t>(data[i++]);
+            if ((code_point >= 0xD800) && (code_point < 0xDC00) && (i < size))
+            {
+                uint32_t low_surrogate = static_cast<uint16_t>(data[i]);
+                if ((low_surrogate >= 0xDC00) && (low_surrogate < 0xE000))
+                {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                    ++i;
+                }
+            }
+
+            if (code_point < 0x800)
+            {
+                *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+            else if (code_point < 0x10000)
+            {
+                *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+            else
+            {
+                *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+        }
+
+        target.resize(start + (out - begin));
+    }
+
+    void append_string_t(utility::string_t& target, const char* data, size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        // UTF-8 never has fewer bytes than UTF-16 has code units
+        size_t start = target.size();
+        target.resize(start + size);
+        utility::char_t* begin = &target[start];
+        utility::char_t* out = begin;
+
+        size_t i = 0;
+        while (i < size)
+        {
+            size_t ascii = widen_ascii(data + i, size - i, out);
+            i += ascii;
+            out += ascii;
+            if (i == size)
+            {
+                break;
+            }
+
+            uint32_t code_point;
+            size_t length = decode_utf8(reinterpret_cast<const uint8_t*>(data + i), size - i, code_point);
+            if (length == 0)
+            {
+                // Leave the error to the library conversion, so that invalid text fails the same way as before
+                target.resize(start);
+                target.append(utility::conversions::to_string_t(std::string(data, size)));
+                return;
+            }
+
+            i += length;
+            if (code_point < 0x10000)
+            {
+                *out++ = static_cast<utility::char_t>(code_point);
+            }
+            else
+            {
+                code_point -= 0x10000;
+                *out++ = static_cast<utility::char_t>(0xD800 + (code_point >> 10));
+                *out++ = static_cast<utility::char_t>(0xDC00 + (code_point & 0x3FF));
+            }
+        }
+
+        target.resize(start + (out - begin));
+    }
+
+#else
+
+    void append_utf8(std::string& target, const utility::char_t* data, size_t size)
+    {
+        target.append(data, size);
+    }
+
+    void append_string_t(utility::string_t& target, const char* data, size_t size)
+    {
+        target.append(data, size);
+    }
+
+#endif
+
+}}} // namespace wa::storage::core
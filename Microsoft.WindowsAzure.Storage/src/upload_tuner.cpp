@@ -0,0 +1,192 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="upload_tuner.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "wascore/upload_tuner.h"
+
+namespace wa { namespace storage { namespace core {
+
+    namespace
+    {
+        // Weight of the newest request in the model, so that it follows changes in the network within a few dozen requests
+        const double request_decay = 0.1;
+
+        // Number of requests that have to be seen for an endpoint before uploads to it are tuned
+        const int min_tuning_samples = 8;
+
+        // Uploads only move to a different number of blocks in flight if that was at least this much faster
+        const double parallelism_improvement = 1.1;
+
+        // Number of uploads after which the neighboring numbers of blocks in flight are measured again
+        const int parallelism_probe_interval = 32;
+
+        // Blocks take this many times the latency to send, so that the latency costs at most a fifth of the time
+        const double block_latency_multiple = 4.0;
+
+        const size_t min_tuned_block_size = 256 * 1024;
+        const size_t tuned_block_size_granularity = 64 * 1024;
+    }
+
+    void upload_tuner::record_request(const web::http::uri& uri, utility::size64_t bytes, const request_result& result)
+    {
+        auto start = result.start_time().to_interval();
+        auto end = result.end_time().to_interval();
+        if (end < start)
+        {
+            return;
+        }
+
+        // utility::datetime counts intervals of 100 nanoseconds
+        double x = static_cast<double>(bytes);
+        double y = static_cast<double>(end - start) / 10000000.0;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto& state = m_endpoints[get_key(uri)];
+        double keep = 1.0 - request_decay;
+        state.weight = state.weight * keep + 1.0;
+        state.sum_x = state.sum_x * keep + x;
+        state.sum_y = state.sum_y * keep + y;
+        state.sum_xx = state.sum_xx * keep + x * x;
+        state.sum_xy = state.sum_xy * keep + x * y;
+        ++state.samples;
+    }
+
+    void upload_tuner::record_upload(const web::http::uri& uri, utility::size64_t bytes, std::chrono::steady_clock::duration elapsed, int parallelism, int max_parallelism)
+    {
+        double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+        if ((seconds <= 0.0) || (parallelism < 1))
+        {
+            return;
+        }
+
+        double rate = static_cast<double>(bytes) / seconds;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto& state = m_endpoints[get_key(uri)];
+
+        auto current = state.upload_rates.find(parallelism);
+        if (current == state.upload_rates.end())
+        {
+            current = state.upload_rates.insert(std::make_pair(parallelism, rate)).first;
+        }
+        else
+        {
+            current->second = (current->second + rate) / 2.0;
+        }
+
+        // Forget the neighbors from time to time, so that they are measured again under the current conditions
+        if (++state.uploads_since_probe >= parallelism_probe_interval)
+        {
+            state.uploads_since_probe = 0;
+            double current_rate = current->second;
+            state.upload_rates.clear();
+            state.upload_rates[parallelism] = current_rate;
+            current = state.upload_rates.find(parallelism);
+        }
+
+        // Measure each neighbor once, then move to the faster one if it was faster by enough
+        int higher = std::min(parallelism * 2, std::max(max_parallelism, 1));
+        int lower = std::max(parallelism / 2, 1);
+        auto higher_rate = state.upload_rates.find(higher);
+        auto lower_rate = state.upload_rates.find(lower);
+        if ((higher != parallelism) && (higher_rate == state.upload_rates.end()))
+        {
+            state.parallelism = higher;
+        }
+        else if ((lower != parallelism) && (lower_rate == state.upload_rates.end()))
+        {
+            state.parallelism = lower;
+        }
+        else
+        {
+            state.parallelism = parallelism;
+            double best_rate = current->second * parallelism_improvement;
+            if ((higher != parallelism) && (higher_rate->second > best_rate))
+            {
+                state.parallelism = higher;
+                best_rate = higher_rate->second;
+            }
+
+            if ((lower != parallelism) && (lower_rate->second > best_rate))
+            {
+                state.parallelism = lower;
+            }
+        }
+    }
+
+    bool upload_tuner::try_get_tuning(const web::http::uri& uri, utility::size64_t max_single_upload_threshold, size_t max_block_size, int max_parallelism, tuning& value) const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = m_endpoints.find(get_key(uri));
+        if ((iter == m_endpoints.end()) || (iter->second.samples < min_tuning_samples))
+        {
+            return false;
+        }
+
+        // The least squares fit of duration = latency + bytes / bandwidth needs requests of different sizes
+        const endpoint_state& state = iter->second;
+        double mean_x = state.sum_x / state.weight;
+        double mean_y = state.sum_y / state.weight;
+        double variance_x = state.sum_xx / state.weight - mean_x * mean_x;
+        double covariance = state.sum_xy / state.weight - mean_x * mean_y;
+        if ((variance_x <= mean_x * mean_x * 0.01) || (covariance <= 0.0))
+        {
+            return false;
+        }
+
+        double seconds_per_byte = covariance / variance_x;
+        double latency = std::max(mean_y - seconds_per_byte * mean_x, 0.0);
+        double bandwidth = 1.0 / seconds_per_byte;
+
+        int parallelism = std::max(max_parallelism, 1);
+        if ((state.parallelism > 0) && (state.parallelism < parallelism))
+        {
+            parallelism = state.parallelism;
+        }
+
+        double block_size = block_latency_multiple * latency * bandwidth;
+        size_t tuned_block_size = max_block_size;
+        if (block_size < static_cast<double>(max_block_size))
+        {
+            tuned_block_size = (static_cast<size_t>(block_size) + tuned_block_size_granularity - 1) / tuned_block_size_granularity * tuned_block_size_granularity;
+            tuned_block_size = std::min(std::max(tuned_block_size, min_tuned_block_size), max_block_size);
+        }
+
+        // A single request takes latency + n / bandwidth, and a block upload about two latencies, one for the blocks and one
+        // for the block list, plus n / (parallelism * bandwidth). The single request is faster below the size where they meet.
+        utility::size64_t threshold = max_single_upload_threshold;
+        if (parallelism > 1)
+        {
+            double break_even = latency * bandwidth * parallelism / (parallelism - 1);
+            if (break_even < static_cast<double>(threshold))
+            {
+                threshold = static_cast<utility::size64_t>(break_even);
+            }
+        }
+
+        value.single_upload_threshold = threshold;
+        value.block_size = tuned_block_size;
+        value.parallelism = parallelism;
+        return true;
+    }
+
+    utility::string_t upload_tuner::get_key(const web::http::uri& uri)
+    {
+        return uri.authority().to_string();
+    }
+
+}}} // namespace wa::storage::core
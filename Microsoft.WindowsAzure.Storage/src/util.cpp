@@ -20,6 +20,8 @@
 #include "wascore/util.h"
 #include "wascore/constants.h"
 #include "wascore/resources.h"
+#include "wascore/timer_wheel.h"
+#include "wascore/datetime_codec.h"
 
 #ifdef WIN32
 #include <float.h>
@@ -46,37 +48,247 @@ namespace wa { namespace storage {  namespace core {
         return protocol::invalid_size64_t;
     }
 
-    pplx::task<utility::size64_t> stream_copy_async(concurrency::streams::istream istream, concurrency::streams::ostream ostream, utility::size64_t length)
+    namespace
     {
-        size_t buffer_size(protocol::default_buffer_size);
-        utility::size64_t istream_length = length == protocol::invalid_size64_t ? get_remaining_stream_length(istream) : length;
-        if ((istream_length != protocol::invalid_size64_t) && (istream_length < buffer_size))
+        // The buffers of finished copies are kept for the next ones, up to a limit. Taking a buffer never waits, because
+        // a copy may be waiting on another one, such as a copy into a blob stream whose upload copies the block it sends.
+        class stream_copy_buffer_cache
+        {
+        public:
+
+            std::vector<uint8_t> acquire(size_t size)
+            {
+                std::vector<uint8_t> buffer;
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    if (!m_free_buffers.empty())
+                    {
+                        buffer = std::move(m_free_buffers.back());
+                        m_free_buffers.pop_back();
+                    }
+                }
+
+                buffer.resize(size);
+                return buffer;
+            }
+
+            void release(std::vector<uint8_t> buffer)
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                if ((buffer.capacity() >= protocol::stream_copy_buffer_size) && (m_free_buffers.size() < protocol::stream_copy_max_cached_buffers))
+                {
+                    m_free_buffers.push_back(std::move(buffer));
+                }
+            }
+
+        private:
+
+            std::vector<std::vector<uint8_t>> m_free_buffers;
+            std::mutex m_mutex;
+        };
+
+        std::once_flag stream_copy_buffer_cache_flag;
+        stream_copy_buffer_cache* stream_copy_buffer_cache_pointer = nullptr;
+
+        stream_copy_buffer_cache& get_stream_copy_buffer_cache()
+        {
+            // The cache is never destroyed, so that copies still running while static objects are destroyed can return their buffers
+            std::call_once(stream_copy_buffer_cache_flag, [] ()
+            {
+                stream_copy_buffer_cache_pointer = new stream_copy_buffer_cache();
+            });
+
+            return *stream_copy_buffer_cache_pointer;
+        }
+
+        struct stream_copy_state
+        {
+            stream_copy_state(size_t buffer_count, size_t buffer_size)
+                : slot_writes(buffer_count, pplx::task_from_result()), last_write(pplx::task_from_result()), next_slot(0)
+            {
+                for (size_t i = 0; i < buffer_count; ++i)
+                {
+                    buffers.push_back(get_stream_copy_buffer_cache().acquire(buffer_size));
+                }
+            }
+
+            ~stream_copy_state()
+            {
+                for (auto iter = buffers.begin(); iter != buffers.end(); ++iter)
+                {
+                    get_stream_copy_buffer_cache().release(std::move(*iter));
+                }
+            }
+
+            std::vector<std::vector<uint8_t>> buffers;
+
+            // The write of each buffer, which has to finish before the buffer is read into again
+            std::vector<pplx::task<void>> slot_writes;
+            pplx::task<void> last_write;
+            size_t next_slot;
+        };
+
+        pplx::task<void> putn_all_async(concurrency::streams::streambuf<uint8_t> obuffer, const uint8_t* data, size_t count)
+        {
+            return obuffer.putn(data, count).then([obuffer, data, count] (size_t written) -> pplx::task<void>
+            {
+                if (written == count)
+                {
+                    return pplx::task_from_result();
+                }
+
+                if (written == 0)
+                {
+                    throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_stream_copy_write));
+                }
+
+                return putn_all_async(obuffer, data + written, count - written);
+            });
+        }
+
+        pplx::task<bool> sequential_copy_async(concurrency::streams::istream istream, concurrency::streams::streambuf<uint8_t> obuffer, size_t buffer_size, std::shared_ptr<utility::size64_t> length_ptr, std::shared_ptr<utility::size64_t> total_ptr)
+        {
+            return pplx::details::do_while([istream, obuffer, buffer_size, length_ptr, total_ptr] () -> pplx::task<bool>
+            {
+                size_t read_length = buffer_size;
+                if ((length_ptr != nullptr) && (*length_ptr < read_length))
+                {
+                    read_length = static_cast<size_t>(*length_ptr);
+                }
+
+                return istream.read(obuffer, read_length).then([length_ptr, total_ptr] (size_t count) -> bool
+                {
+                    *total_ptr += count;
+                    if (length_ptr != nullptr)
+                    {
+                        *length_ptr -= count;
+                    }
+
+                    return (count > 0) && (length_ptr == nullptr || *length_ptr > 0);
+                });
+            });
+        }
+
+        pplx::task<bool> pipelined_copy_async(concurrency::streams::streambuf<uint8_t> ibuffer, concurrency::streams::streambuf<uint8_t> obuffer, size_t buffer_size, std::shared_ptr<utility::size64_t> length_ptr, std::shared_ptr<utility::size64_t> total_ptr)
         {
-            buffer_size = static_cast<size_t>(istream_length);
+            auto state = std::make_shared<stream_copy_state>(protocol::stream_copy_buffer_count, buffer_size);
+            return pplx::details::do_while([ibuffer, obuffer, buffer_size, length_ptr, total_ptr, state] () -> pplx::task<bool>
+            {
+                size_t slot = state->next_slot;
+                state->next_slot = (slot + 1) % state->buffers.size();
+
+                size_t read_length = buffer_size;
+                if ((length_ptr != nullptr) && (*length_ptr < read_length))
+                {
+                    read_length = static_cast<size_t>(*length_ptr);
+                }
+
+                return state->slot_writes[slot].then([ibuffer, read_length, state, slot] () mutable -> pplx::task<size_t>
+                {
+                    return ibuffer.getn(state->buffers[slot].data(), read_length);
+                }).then([obuffer, length_ptr, total_ptr, state, slot] (size_t count) -> bool
+                {
+                    if (count == 0)
+                    {
+                        return false;
+                    }
+
+                    *total_ptr += count;
+                    if (length_ptr != nullptr)
+                    {
+                        *length_ptr -= count;
+                    }
+
+                    // Writes are chained so that they reach the sink in order, while the next buffer is being read
+                    auto write_task = state->last_write.then([obuffer, state, slot, count] () -> pplx::task<void>
+                    {
+                        return putn_all_async(obuffer, state->buffers[slot].data(), count);
+                    });
+
+                    state->slot_writes[slot] = write_task;
+                    state->last_write = write_task;
+                    return (length_ptr == nullptr) || (*length_ptr > 0);
+                });
+            }).then([state] (bool) -> pplx::task<bool>
+            {
+                return state->last_write.then([] () -> bool
+                {
+                    return true;
+                });
+            });
         }
+    }
 
+    pplx::task<utility::size64_t> stream_copy_async(concurrency::streams::istream istream, concurrency::streams::ostream ostream, utility::size64_t length)
+    {
+        utility::size64_t istream_length = length == protocol::invalid_size64_t ? get_remaining_stream_length(istream) : length;
+
+        auto ibuffer = istream.streambuf();
         auto obuffer = ostream.streambuf();
         auto length_ptr = (length != protocol::invalid_size64_t) ? std::make_shared<utility::size64_t>(length) : nullptr;
         auto total_ptr = std::make_shared<utility::size64_t>(0);
-        return pplx::details::do_while([istream, obuffer, buffer_size, length_ptr, total_ptr] () -> pplx::task<bool>
+
+        // Sources and sinks that hold their data in memory are copied from or into that memory directly, which istream::read
+        // does, so there is nothing to overlap. Otherwise the source is read into one buffer while the one before it is written.
+        size_t direct_buffer_size(protocol::default_buffer_size);
+        size_t pipelined_buffer_size(protocol::stream_copy_buffer_size);
+        if (istream_length != protocol::invalid_size64_t)
         {
-            size_t read_length = buffer_size;
-            if ((length_ptr != nullptr) && (*length_ptr < read_length))
-            {
-                read_length = static_cast<size_t>(*length_ptr);
-            }
+            direct_buffer_size = static_cast<size_t>(std::min<utility::size64_t>(istream_length, direct_buffer_size));
+            pipelined_buffer_size = static_cast<size_t>(std::min<utility::size64_t>(istream_length, pipelined_buffer_size));
+        }
 
-            return istream.read(obuffer, read_length).then([length_ptr, total_ptr] (size_t count) -> bool
+        // A source such as a response body may only have its next block in memory, so only one that holds all of the data counts
+        uint8_t* data = nullptr;
+        size_t available = 0;
+        bool source_in_memory = ibuffer.acquire(data, available);
+        if (source_in_memory)
+        {
+            ibuffer.release(data, 0);
+            source_in_memory = (istream_length != protocol::invalid_size64_t) && (available >= istream_length);
+        }
+
+        pplx::task<bool> copy_task;
+        if (source_in_memory || (direct_buffer_size == 0))
+        {
+            copy_task = sequential_copy_async(istream, obuffer, direct_buffer_size, length_ptr, total_ptr);
+        }
+        else if ((data = obuffer.alloc(direct_buffer_size)) != nullptr)
+        {
+            copy_task = ibuffer.getn(data, direct_buffer_size).then([istream, obuffer, direct_buffer_size, length_ptr, total_ptr] (pplx::task<size_t> read_task) mutable -> pplx::task<bool>
             {
+                size_t count = 0;
+                try
+                {
+                    count = read_task.get();
+                }
+                catch (...)
+                {
+                    obuffer.commit(0);
+                    throw;
+                }
+
+                obuffer.commit(count);
                 *total_ptr += count;
                 if (length_ptr != nullptr)
                 {
                     *length_ptr -= count;
                 }
 
-                return (count > 0) && (length_ptr == nullptr || *length_ptr > 0);
+                if ((count == 0) || ((length_ptr != nullptr) && (*length_ptr == 0)))
+                {
+                    return pplx::task_from_result(true);
+                }
+
+                return sequential_copy_async(istream, obuffer, direct_buffer_size, length_ptr, total_ptr);
             });
-        }).then([total_ptr, length] (bool) -> utility::size64_t
+        }
+        else
+        {
+            copy_task = pipelined_copy_async(ibuffer, obuffer, pipelined_buffer_size, length_ptr, total_ptr);
+        }
+
+        return copy_task.then([total_ptr, length] (bool) -> utility::size64_t
         {
             if (length != protocol::invalid_size64_t && *total_ptr != length)
             {
@@ -87,6 +299,50 @@ namespace wa { namespace storage {  namespace core {
         });
     }
 
+    pplx::task<void> complete_after(std::chrono::milliseconds timeout)
+    {
+        // All delays share the timer wheel, so that the cost of a pending delay does not depend on how many there are
+        pplx::task_completion_event<void> tce;
+        timer_wheel::instance().schedule(timeout, [tce] ()
+        {
+            tce.set();
+        });
+
+        return pplx::create_task(tce);
+    }
+
+    pplx::task<void> complete_after(std::chrono::milliseconds timeout, pplx::cancellation_token token)
+    {
+        if (!token.is_cancelable())
+        {
+            return complete_after(timeout);
+        }
+
+        // Canceling the token completes the delay early, and whoever waited on it is expected to check the token
+        pplx::task_completion_event<void> tce;
+        auto timer = timer_wheel::instance().schedule(timeout, [tce] ()
+        {
+            tce.set();
+        });
+
+        auto registration = token.register_callback([tce, timer] ()
+        {
+            timer.cancel();
+            tce.set();
+        });
+
+        return pplx::create_task(tce).then([token, registration] ()
+        {
+            token.deregister_callback(registration);
+        });
+    }
+
+    bool is_storage_error(const storage_exception& e, web::http::status_code status_code, const utility::char_t* error_code)
+    {
+        const auto& result = e.result();
+        return result.is_response_available() && (result.http_status_code() == status_code) && (result.extended_error().code() == error_code);
+    }
+
     std::vector<utility::string_t> string_split(const utility::string_t& string, const utility::string_t& separator)
     {
         std::vector<utility::string_t> result;
@@ -103,6 +359,99 @@ namespace wa { namespace storage {  namespace core {
         return result;
     }
 
+    void append_text_field(utility::string_t& text, const utility::string_t& name, const utility::string_t& value)
+    {
+        text.append(name).append(U("=")).append(web::http::uri::encode_data_string(value)).append(U("\n"));
+    }
+
+    bool parse_text_fields(const utility::string_t& text, std::vector<std::pair<utility::string_t, utility::string_t>>& fields)
+    {
+        size_t position = 0;
+        while (position < text.size())
+        {
+            auto line_end = text.find(U('\n'), position);
+            if (line_end == utility::string_t::npos)
+            {
+                line_end = text.size();
+            }
+
+            auto line = text.substr(position, line_end - position);
+            if (!line.empty() && (line.back() == U('\r')))
+            {
+                line.pop_back();
+            }
+
+            position = line_end + 1;
+            if (line.empty())
+            {
+                continue;
+            }
+
+            auto separator = line.find(U('='));
+            if (separator == utility::string_t::npos)
+            {
+                return false;
+            }
+
+            utility::string_t value;
+            try
+            {
+                value = web::http::uri::decode(line.substr(separator + 1));
+            }
+            catch (const web::http::uri_exception&)
+            {
+                return false;
+            }
+
+            fields.push_back(std::make_pair(line.substr(0, separator), std::move(value)));
+        }
+
+        return true;
+    }
+
+    void append_continuation_token_fields(utility::string_t& text, const continuation_token& token)
+    {
+        if (token.empty())
+        {
+            return;
+        }
+
+        append_text_field(text, U("next_marker"), token.next_marker());
+        if (token.target_location() != storage_location::unspecified)
+        {
+            append_text_field(text, U("target_location"), token.target_location() == storage_location::primary ? U("primary") : U("secondary"));
+        }
+    }
+
+    bool parse_continuation_token_field(const utility::string_t& name, const utility::string_t& value, continuation_token& token, bool& valid)
+    {
+        if (name == U("next_marker"))
+        {
+            token.set_next_marker(value);
+            return true;
+        }
+
+        if (name == U("target_location"))
+        {
+            if (value == U("primary"))
+            {
+                token.set_target_location(storage_location::primary);
+            }
+            else if (value == U("secondary"))
+            {
+                token.set_target_location(storage_location::secondary);
+            }
+            else
+            {
+                valid = false;
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
     utility::string_t single_quote(const utility::string_t& value)
     {
         const utility::char_t SINGLE_QUOTE = U('\'');
@@ -179,6 +528,23 @@ namespace wa { namespace storage {  namespace core {
     }
     */
 
+    uint64_t hash_utf8_key(const utility::string_t& key)
+    {
+        // The 64-bit FNV-1a hash of the UTF-8 bytes, so that processes on platforms with different string types agree on it
+        const uint64_t fnv_offset_basis = 14695981039346656037ULL;
+        const uint64_t fnv_prime = 1099511628211ULL;
+
+        std::string utf8_key = utility::conversions::to_utf8string(key);
+        uint64_t hash = fnv_offset_basis;
+        for (auto iter = utf8_key.cbegin(); iter != utf8_key.cend(); ++iter)
+        {
+            hash ^= static_cast<uint8_t>(*iter);
+            hash *= fnv_prime;
+        }
+
+        return hash;
+    }
+
     utility::string_t convert_to_string(int value)
     {
         // TODO: Try to use a standard function for this
@@ -202,68 +568,120 @@ namespace wa { namespace storage {  namespace core {
         return result;
     }
 
-    // TODO: Remove the following 4 functions and switch to Casablanca's datetime parsing when it is ready
-    utility::string_t convert_to_string(utility::datetime value)
+    namespace
     {
-        int status;
+        const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        const int8_t base64_invalid = -1;
+        const int8_t base64_padding = -2;
+
+        struct base64_decoding_table
+        {
+            base64_decoding_table()
+            {
+                for (size_t i = 0; i < 128; ++i)
+                {
+                    values[i] = base64_invalid;
+                }
+
+                for (size_t i = 0; i < 64; ++i)
+                {
+                    values[static_cast<unsigned char>(base64_alphabet[i])] = static_cast<int8_t>(i);
+                }
+
+                values['='] = base64_padding;
+            }
+
+            int8_t values[128];
+        };
 
-        ULARGE_INTEGER largeInt;
-        largeInt.QuadPart = value.to_interval();
+        // Built before any thread can use it, because function-local statics are not thread-safe on all supported compilers
+        const base64_decoding_table base64_decoding;
 
-        FILETIME ft;
-        ft.dwHighDateTime = largeInt.HighPart;
-        ft.dwLowDateTime = largeInt.LowPart;
+        int8_t get_base64_value(utility::char_t c)
+        {
+            return static_cast<uint32_t>(c) < 128 ? base64_decoding.values[static_cast<size_t>(c)] : base64_invalid;
+        }
+    }
+
+    void append_base64(std::string& target, const uint8_t* data, size_t size)
+    {
+        size_t offset = target.size();
+        target.resize(offset + (size + 2) / 3 * 4);
+        char* output = &target[0] + offset;
 
-        SYSTEMTIME systemTime;
-        if (!FileTimeToSystemTime((const FILETIME *)&ft, &systemTime))
+        // Three bytes become four characters, so whole groups are written without any branches
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3)
         {
-            throw utility::details::create_system_error(GetLastError());
+            uint32_t group = (static_cast<uint32_t>(data[i]) << 16) | (static_cast<uint32_t>(data[i + 1]) << 8) | data[i + 2];
+            output[0] = base64_alphabet[group >> 18];
+            output[1] = base64_alphabet[(group >> 12) & 0x3F];
+            output[2] = base64_alphabet[(group >> 6) & 0x3F];
+            output[3] = base64_alphabet[group & 0x3F];
+            output += 4;
         }
 
-        std::wostringstream outStream;
-
-            const size_t buffSize = 64;
-    #if _WIN32_WINNT < _WIN32_WINNT_VISTA 
-            TCHAR dateStr[buffSize] = {0};
-            status = GetDateFormat(LOCALE_INVARIANT, 0, &systemTime, "yyyy-MM-dd", dateStr, buffSize);
-    #else
-            wchar_t dateStr[buffSize] = {0};
-            status = GetDateFormatEx(LOCALE_NAME_INVARIANT, 0, &systemTime, L"yyyy-MM-dd", dateStr, buffSize, NULL);
-    #endif // _WIN32_WINNT < _WIN32_WINNT_VISTA 
-            if (status == 0)
+        if (i < size)
+        {
+            uint32_t group = static_cast<uint32_t>(data[i]) << 16;
+            if (i + 1 < size)
             {
-                throw utility::details::create_system_error(GetLastError());
+                group |= static_cast<uint32_t>(data[i + 1]) << 8;
             }
 
-    #if _WIN32_WINNT < _WIN32_WINNT_VISTA 
-            TCHAR timeStr[buffSize] = {0};
-            status = GetTimeFormat(LOCALE_INVARIANT, TIME_NOTIMEMARKER | TIME_FORCE24HOURFORMAT, &systemTime, "HH':'mm':'ss", timeStr, buffSize);
-    #else
-            wchar_t timeStr[buffSize] = {0};
-            status = GetTimeFormatEx(LOCALE_NAME_INVARIANT, TIME_NOTIMEMARKER | TIME_FORCE24HOURFORMAT, &systemTime, L"HH':'mm':'ss", timeStr, buffSize);
-    #endif // _WIN32_WINNT < _WIN32_WINNT_VISTA 
-            if (status == 0)
+            output[0] = base64_alphabet[group >> 18];
+            output[1] = base64_alphabet[(group >> 12) & 0x3F];
+            output[2] = i + 1 < size ? base64_alphabet[(group >> 6) & 0x3F] : '=';
+            output[3] = '=';
+        }
+    }
+
+    std::vector<uint8_t> decode_base64(const utility::string_t& value)
+    {
+        std::vector<uint8_t> result;
+        if (value.size() % 4 != 0)
+        {
+            throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_base64));
+        }
+
+        result.reserve(value.size() / 4 * 3);
+
+        const utility::char_t* input = value.data();
+        for (size_t i = 0; i < value.size(); i += 4)
+        {
+            int8_t v0 = get_base64_value(input[i]);
+            int8_t v1 = get_base64_value(input[i + 1]);
+            int8_t v2 = get_base64_value(input[i + 2]);
+            int8_t v3 = get_base64_value(input[i + 3]);
+
+            // Padding may only end the last group, and at least two characters of a group carry data
+            bool is_last = i + 4 == value.size();
+            if (v0 < 0 || v1 < 0 || v2 == base64_invalid || v3 == base64_invalid ||
+                ((v2 == base64_padding || v3 == base64_padding) && !is_last) || (v2 == base64_padding && v3 != base64_padding))
             {
-                throw utility::details::create_system_error(GetLastError());
+                throw std::runtime_error(utility::conversions::to_utf8string(protocol::error_invalid_base64));
             }
 
-            outStream << dateStr << "T" << timeStr;
-            uint64_t frac_sec = largeInt.QuadPart % static_cast<utility::datetime::interval_type>(10000000);
-            if (frac_sec > 0)
+            result.push_back(static_cast<uint8_t>((v0 << 2) | (v1 >> 4)));
+            if (v2 >= 0)
             {
-                // Append fractional second, which is a 7-digit value with no trailing zeros
-                // This way, '1200' becomes '00012'
-                char buf[9] = { 0 };
-                sprintf_s(buf, sizeof(buf), ".%07d", frac_sec);
-                // trim trailing zeros
-                for (int i = 7; buf[i] == '0'; i--) buf[i] = '\0';
-                outStream << buf;
+                result.push_back(static_cast<uint8_t>(((v1 & 0x0F) << 4) | (v2 >> 2)));
+                if (v3 >= 0)
+                {
+                    result.push_back(static_cast<uint8_t>(((v2 & 0x03) << 6) | v3));
+                }
             }
-            outStream << "Z";
+        }
+
+        return result;
+    }
 
-        return outStream.str();
+    utility::string_t convert_to_string(utility::datetime value)
+    {
+        return format_iso8601_datetime(value);
     }
 
+    // TODO: Remove the following 3 functions and switch to Casablanca's datetime parsing when it is ready
     bool system_type_to_datetime(void* pvsysTime, uint64_t seconds, utility::datetime * pdt)
     {
         SYSTEMTIME* psysTime = (SYSTEMTIME*)pvsysTime;
@@ -300,6 +718,13 @@ namespace wa { namespace storage {  namespace core {
 
     utility::datetime parse_datetime(utility::string_t dateString)
     {
+        // Dates written by the service always take the fast path, and only other forms are scanned below
+        utility::datetime fast_result = parse_iso8601_datetime(dateString);
+        if (fast_result.is_initialized())
+        {
+            return fast_result;
+        }
+
         // avoid floating point math to preserve precision
         uint64_t ufrac_second = 0;
 
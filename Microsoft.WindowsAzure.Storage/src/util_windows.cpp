@@ -23,38 +23,102 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <rpc.h>
-#include <agents.h>
 
 namespace wa { namespace storage {  namespace core {
 
-    pplx::task<void> complete_after(std::chrono::milliseconds timeout)
+    std::vector<local_file_entry> list_local_files(const utility::string_t& directory)
     {
-        // A task completion event that is set when a timer fires.
-        pplx::task_completion_event<void> tce;
+        std::vector<local_file_entry> files;
 
-        // Create a non-repeating timer.
-        auto fire_once = new concurrency::timer<int>(static_cast<unsigned int>(timeout.count()), 0, nullptr, false);
+        // Subdirectories that are still to be enumerated, relative to the root and ending with a separator
+        std::vector<utility::string_t> pending_directories(1, utility::string_t());
+        while (!pending_directories.empty())
+        {
+            utility::string_t relative_directory(std::move(pending_directories.back()));
+            pending_directories.pop_back();
+
+            utility::string_t pattern(directory + U("\\") + relative_directory + U("*"));
+            WIN32_FIND_DATAW find_data;
+            HANDLE find_handle = FindFirstFileW(pattern.c_str(), &find_data);
+            if (find_handle == INVALID_HANDLE_VALUE)
+            {
+                throw utility::details::create_system_error(GetLastError());
+            }
+
+            do
+            {
+                utility::string_t name(find_data.cFileName);
+                if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                {
+                    // Links to directories are not followed, so that the enumeration cannot loop
+                    if ((name != U(".")) && (name != U("..")) && ((find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0))
+                    {
+                        pending_directories.push_back(relative_directory + name + U("\\"));
+                    }
+                }
+                else
+                {
+                    // A FILETIME counts 100-nanosecond intervals since 1601, as utility::datetime does
+                    local_file_entry file;
+                    file.path = relative_directory + name;
+                    file.size = (static_cast<utility::size64_t>(find_data.nFileSizeHigh) << 32) | find_data.nFileSizeLow;
+                    file.last_write_time = utility::datetime() + ((static_cast<utility::datetime::interval_type>(find_data.ftLastWriteTime.dwHighDateTime) << 32) | find_data.ftLastWriteTime.dwLowDateTime);
+                    files.push_back(std::move(file));
+                }
+            } while (FindNextFileW(find_handle, &find_data));
+
+            auto error = GetLastError();
+            FindClose(find_handle);
+            if (error != ERROR_NO_MORE_FILES)
+            {
+                throw utility::details::create_system_error(error);
+            }
+        }
+
+        return files;
+    }
 
-        // Create a call object that sets the completion event after the timer fires.
-        auto callback = new concurrency::call<int>([tce] (int)
+    void create_local_directories(const utility::string_t& path)
+    {
+        // Every parent is created first. Parents that cannot be created, such as the root of a drive or share, are
+        // assumed to exist, since only whether the whole path is a directory in the end matters.
+        DWORD error = ERROR_SUCCESS;
+        for (auto separator = path.find_first_of(U("\\/"), 1); ; separator = path.find_first_of(U("\\/"), separator + 1))
         {
-            tce.set();
-        });
+            utility::string_t parent(path.substr(0, separator));
+            if (CreateDirectoryW(parent.c_str(), nullptr))
+            {
+                error = ERROR_SUCCESS;
+            }
+            else
+            {
+                error = GetLastError();
+            }
 
-        // Connect the timer to the callback and start the timer.
-        fire_once->link_target(callback);
-        fire_once->start();
+            if (separator == utility::string_t::npos)
+            {
+                break;
+            }
+        }
 
-        // Create a task that completes after the completion event is set.
-        pplx::task<void> event_set(tce);
+        auto attributes = GetFileAttributesW(path.c_str());
+        if ((attributes == INVALID_FILE_ATTRIBUTES) || ((attributes & FILE_ATTRIBUTE_DIRECTORY) == 0))
+        {
+            throw utility::details::create_system_error(error == ERROR_SUCCESS ? ERROR_PATH_NOT_FOUND : error);
+        }
+    }
 
-        // Create a continuation task that cleans up resources and 
-        // and return that continuation task. 
-        return event_set.then([callback, fire_once] ()
+    void delete_local_file(const utility::string_t& path)
+    {
+        // A file that is already gone is what the caller wanted anyway
+        if (!DeleteFileW(path.c_str()))
         {
-            delete callback;
-            delete fire_once;
-        });
+            DWORD error = GetLastError();
+            if ((error != ERROR_FILE_NOT_FOUND) && (error != ERROR_PATH_NOT_FOUND))
+            {
+                throw utility::details::create_system_error(error);
+            }
+        }
     }
 
 }}} // namespace wa::storage::core
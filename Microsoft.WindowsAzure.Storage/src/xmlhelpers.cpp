@@ -41,14 +41,10 @@
 
 #include "stdafx.h"
 #include "wascore/xmlhelpers.h"
+#include "wascore/transcode.h"
 
 #ifdef WIN32
 #include "wascore/xmlstream.h"
-#else
-typedef int XmlNodeType;
-#define XmlNodeType_Element xmlpp::TextReader::xmlNodeType::Element
-#define XmlNodeType_Text xmlpp::TextReader::xmlNodeType::Text
-#define XmlNodeType_EndElement xmlpp::TextReader::xmlNodeType::EndElement
 #endif
 
 using namespace web;
@@ -57,71 +53,549 @@ using namespace concurrency;
 
 namespace wa { namespace storage { namespace core { namespace xml {
 
+    namespace
+    {
+        // Number of bytes requested from the source stream each time the reader runs out of buffered input
+        const size_t xml_read_chunk_size = 16 * 1024;
+
+        bool is_xml_whitespace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        bool is_name_delimiter(char c)
+        {
+            return is_xml_whitespace(c) || c == '/' || c == '>' || c == '=';
+        }
+
+        xml_string_view local_name(const xml_string_view& qualified_name)
+        {
+            const char* colon = static_cast<const char*>(memchr(qualified_name.data(), ':', qualified_name.size()));
+            if (colon == nullptr)
+            {
+                return qualified_name;
+            }
+
+            ++colon;
+            return xml_string_view(colon, qualified_name.size() - (colon - qualified_name.data()));
+        }
+
+        char* write_utf8(char* out, uint32_t code_point)
+        {
+            if (code_point < 0x80)
+            {
+                *out++ = static_cast<char>(code_point);
+            }
+            else if (code_point < 0x800)
+            {
+                *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+            else if (code_point < 0x10000)
+            {
+                *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+            else
+            {
+                *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+                *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+            }
+
+            return out;
+        }
+
+        // Decodes a character or predefined entity reference between '&' and ';'. Returns false if it is not one.
+        bool decode_reference(const char* begin, const char* end, uint32_t& code_point)
+        {
+            size_t length = end - begin;
+            if (length >= 2 && begin[0] == '#')
+            {
+                bool hex = begin[1] == 'x';
+                const char* digit = begin + (hex ? 2 : 1);
+                if (digit == end)
+                {
+                    return false;
+                }
+
+                code_point = 0;
+                for (; digit != end; ++digit)
+                {
+                    char c = *digit;
+                    uint32_t value;
+                    if (c >= '0' && c <= '9')
+                    {
+                        value = c - '0';
+                    }
+                    else if (hex && c >= 'a' && c <= 'f')
+                    {
+                        value = c - 'a' + 10;
+                    }
+                    else if (hex && c >= 'A' && c <= 'F')
+                    {
+                        value = c - 'A' + 10;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+
+                    code_point = code_point * (hex ? 16 : 10) + value;
+                    if (code_point > 0x10FFFF)
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            if (length == 2 && begin[0] == 'l' && begin[1] == 't')
+            {
+                code_point = '<';
+            }
+            else if (length == 2 && begin[0] == 'g' && begin[1] == 't')
+            {
+                code_point = '>';
+            }
+            else if (length == 3 && memcmp(begin, "amp", 3) == 0)
+            {
+                code_point = '&';
+            }
+            else if (length == 4 && memcmp(begin, "quot", 4) == 0)
+            {
+                code_point = '"';
+            }
+            else if (length == 4 && memcmp(begin, "apos", 4) == 0)
+            {
+                code_point = '\'';
+            }
+            else
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        // Expands references and normalizes line breaks. A decoded reference is never longer than its
+        // encoded form, so this is done in place and returns the new end of the text.
+        char* decode_in_place(char* begin, char* end)
+        {
+            char* out = begin;
+            for (char* in = begin; in != end;)
+            {
+                char c = *in;
+                if (c == '&')
+                {
+                    char* semicolon = static_cast<char*>(memchr(in + 1, ';', end - in - 1));
+                    uint32_t code_point;
+                    if (semicolon != nullptr && decode_reference(in + 1, semicolon, code_point))
+                    {
+                        out = write_utf8(out, code_point);
+                        in = semicolon + 1;
+                        continue;
+                    }
+                }
+                else if (c == '\r')
+                {
+                    *out++ = '\n';
+                    ++in;
+                    if (in != end && *in == '\n')
+                    {
+                        ++in;
+                    }
+                    continue;
+                }
+
+                *out++ = c;
+                ++in;
+            }
+
+            return out;
+        }
+    }
+
+    utility::string_t xml_string_view::to_string() const
+    {
+        return core::to_string_t(m_data, m_size);
+    }
+
     void xml_reader::initialize(streams::istream stream)
     {
-        remove_bom(stream);
+        m_source = stream.is_valid() ? stream.streambuf() : streams::streambuf<uint8_t>();
+        m_sourceDone = !m_source;
+        m_buffer.clear();
+        m_position = 0;
+        m_nodeType = node_none;
+        m_attributes.clear();
+        m_attributeIndex = no_attribute;
+        m_elementStack.clear();
+        m_continueParsing = true;
+        m_streamDone = false;
 
-#ifdef WIN32
-        HRESULT hr;
-        CComPtr<IStream> pInputStream;
-        pInputStream.Attach(xmlstring_istream::create(stream));
+        // Skip the UTF-8 byte order mark, if any
+        while (m_buffer.size() < 3 && fill_buffer())
+        {
+        }
 
-        if (pInputStream == nullptr)
+        if (m_buffer.compare(0, 3, "\xEF\xBB\xBF") == 0)
         {
-            auto error = ERROR_NOT_ENOUGH_MEMORY;
-            log_error_message(U("XML reader IStream creation failed"), error);
-            throw utility::details::create_system_error(error);
+            m_position = 3;
         }
+    }
 
-        if (FAILED(hr = CreateXmlReader(__uuidof(IXmlReader), (void**)&m_reader, NULL)))
+    bool xml_reader::fill_buffer()
+    {
+        if (m_sourceDone)
         {
+            return false;
+        }
 
-            auto error = GetLastError();
-            log_error_message(U("XML reader CreateXmlReader failed"), error);
-            throw utility::details::create_system_error(error);
+        // Everything before the current position has been reported already, so it can be discarded
+        if (m_position > 0)
+        {
+            m_buffer.erase(0, m_position);
+            m_position = 0;
         }
 
-        if (FAILED(hr = m_reader->SetProperty(XmlReaderProperty_DtdProcessing, DtdProcessing_Prohibit)))
+        size_t size = m_buffer.size();
+        m_buffer.resize(size + xml_read_chunk_size);
+        size_t read = m_source.getn(reinterpret_cast<uint8_t*>(&m_buffer[size]), xml_read_chunk_size).get();
+        m_buffer.resize(size + read);
+
+        if (read == 0)
         {
+            m_sourceDone = true;
+            return false;
+        }
 
-            auto error = GetLastError();
-            log_error_message(U("XML reader SetProperty failed"), error);
-            throw utility::details::create_system_error(error);
+        return true;
+    }
+
+    bool xml_reader::find_in_buffer(const char* terminator, size_t length, size_t start, size_t& found)
+    {
+        // Offsets are relative to m_position, because reading more input may move the buffered bytes
+        for (;;)
+        {
+            size_t position = m_buffer.find(terminator, m_position + start, length);
+            if (position != std::string::npos)
+            {
+                found = position - m_position;
+                return true;
+            }
+
+            size_t scanned = m_buffer.size() - m_position;
+            start = scanned >= length ? scanned - length + 1 : 0;
+            if (!fill_buffer())
+            {
+                return false;
+            }
         }
+    }
 
-        if (FAILED(hr = m_reader->SetInput(pInputStream)))
+    xml_string_view xml_reader::decode_text(size_t begin, size_t end)
+    {
+        char* data = &m_buffer[0];
+        for (size_t i = begin; i < end; ++i)
         {
+            if (data[i] == '&' || data[i] == '\r')
+            {
+                char* decoded_end = decode_in_place(data + i, data + end);
+                return xml_string_view(data + begin, decoded_end - (data + begin));
+            }
+        }
 
-            auto error = GetLastError();
-            log_error_message(U("XML reader SetInput failed"), error);
-            throw utility::details::create_system_error(error);
+        return xml_string_view(data + begin, end - begin);
+    }
+
+    bool xml_reader::parse_start_tag(size_t begin, size_t end)
+    {
+        // begin is the first character after '<' and end is the position of '>'
+        const char* data = m_buffer.data();
+
+        m_emptyElement = end > begin && data[end - 1] == '/';
+        if (m_emptyElement)
+        {
+            --end;
         }
-#else
-        concurrency::streams::stringstreambuf buffer;
-        stream.read_to_end(buffer).get();
-        m_data = buffer.collection();
-        if (m_data.empty())
-            m_reader.reset();
-        else
-            m_reader.reset(new xmlpp::TextReader(reinterpret_cast<const unsigned char*>(m_data.data()), static_cast<unsigned int>(m_data.size())));
-#endif
+
+        size_t i = begin;
+        while (i < end && !is_name_delimiter(data[i]))
+        {
+            ++i;
+        }
+
+        if (i == begin)
+        {
+            return false;
+        }
+
+        m_name = xml_string_view(data + begin, i - begin);
+        m_value = xml_string_view();
+        m_attributes.clear();
+
+        for (;;)
+        {
+            while (i < end && is_xml_whitespace(data[i]))
+            {
+                ++i;
+            }
+
+            if (i == end)
+            {
+                break;
+            }
+
+            size_t name_begin = i;
+            while (i < end && !is_name_delimiter(data[i]))
+            {
+                ++i;
+            }
+
+            size_t name_end = i;
+            while (i < end && is_xml_whitespace(data[i]))
+            {
+                ++i;
+            }
+
+            if (name_end == name_begin || i == end || data[i] != '=')
+            {
+                return false;
+            }
+
+            ++i;
+            while (i < end && is_xml_whitespace(data[i]))
+            {
+                ++i;
+            }
+
+            if (i == end || (data[i] != '"' && data[i] != '\''))
+            {
+                return false;
+            }
+
+            const char* close = static_cast<const char*>(memchr(data + i + 1, data[i], end - i - 1));
+            if (close == nullptr)
+            {
+                return false;
+            }
+
+            size_t value_end = close - data;
+            attribute value;
+            value.name = xml_string_view(data + name_begin, name_end - name_begin);
+            value.value = decode_text(i + 1, value_end);
+            m_attributes.push_back(value);
+
+            i = value_end + 1;
+        }
+
+        m_nodeType = node_element;
+        return true;
     }
 
-    /// <summary>
-    /// Remove Byte Order Mark from the stream
-    /// </summary>
-    void xml_reader::remove_bom(streams::istream stream)
+    bool xml_reader::read_node()
     {
-        // Synchronous.
-        if (stream.peek().get() == 0xEF
-            && stream.peek().get() == 0xBB
-            && stream.peek().get() == 0xBF)
+        m_attributeIndex = no_attribute;
+
+        for (;;)
         {
-            stream.read().get();
-            stream.read().get();
-            stream.read().get();
-            return;
+            if (m_position == m_buffer.size() && !fill_buffer())
+            {
+                return false;
+            }
+
+            if (m_buffer[m_position] != '<')
+            {
+                // Character data runs up to the next markup or the end of the stream
+                size_t length;
+                if (!find_in_buffer("<", 1, 0, length))
+                {
+                    length = m_buffer.size() - m_position;
+                }
+
+                size_t begin = m_position;
+                m_position += length;
+
+                bool whitespace = true;
+                for (size_t i = begin; whitespace && i < m_position; ++i)
+                {
+                    whitespace = is_xml_whitespace(m_buffer[i]);
+                }
+
+                // Whitespace between elements is not reported, the same as XmlLite's whitespace nodes
+                if (whitespace)
+                {
+                    continue;
+                }
+
+                m_nodeType = node_text;
+                m_name = xml_string_view();
+                m_value = decode_text(begin, m_position);
+                return true;
+            }
+
+            // Make sure enough is buffered to tell the kinds of markup apart
+            while (m_buffer.size() - m_position < 9 && fill_buffer())
+            {
+            }
+
+            size_t available = m_buffer.size() - m_position;
+            const char* markup = m_buffer.data() + m_position;
+            size_t length;
+
+            if (available >= 2 && markup[1] == '?')
+            {
+                if (!find_in_buffer("?>", 2, 2, length))
+                {
+                    break;
+                }
+
+                m_position += length + 2;
+                continue;
+            }
+
+            if (available >= 4 && memcmp(markup, "<!--", 4) == 0)
+            {
+                if (!find_in_buffer("-->", 3, 4, length))
+                {
+                    break;
+                }
+
+                m_position += length + 3;
+                continue;
+            }
+
+            if (available >= 9 && memcmp(markup, "<![CDATA[", 9) == 0)
+            {
+                if (!find_in_buffer("]]>", 3, 9, length))
+                {
+                    break;
+                }
+
+                size_t begin = m_position + 9;
+                m_position += length + 3;
+                if (m_position - 3 == begin)
+                {
+                    continue;
+                }
+
+                m_nodeType = node_text;
+                m_name = xml_string_view();
+                m_value = xml_string_view(m_buffer.data() + begin, m_position - 3 - begin);
+                return true;
+            }
+
+            if (available >= 2 && markup[1] == '!')
+            {
+                stop_on_error(U("XML reader does not process document type definitions"));
+                return false;
+            }
+
+            if (available >= 2 && markup[1] == '/')
+            {
+                if (!find_in_buffer(">", 1, 2, length))
+                {
+                    break;
+                }
+
+                const char* data = m_buffer.data() + m_position;
+                size_t name_end = length;
+                while (name_end > 2 && is_xml_whitespace(data[name_end - 1]))
+                {
+                    --name_end;
+                }
+
+                m_nodeType = node_end_element;
+                m_name = xml_string_view(data + 2, name_end - 2);
+                m_value = xml_string_view();
+                m_attributes.clear();
+                m_position += length + 1;
+                return true;
+            }
+
+            // A start tag ends at the first '>' outside of a quoted attribute value
+            size_t offset = 1;
+            char quote = 0;
+            for (;;)
+            {
+                size_t size = m_buffer.size() - m_position;
+                const char* data = m_buffer.data() + m_position;
+                for (; offset < size; ++offset)
+                {
+                    char c = data[offset];
+                    if (quote != 0)
+                    {
+                        if (c == quote)
+                        {
+                            quote = 0;
+                        }
+                    }
+                    else if (c == '"' || c == '\'')
+                    {
+                        quote = c;
+                    }
+                    else if (c == '>')
+                    {
+                        break;
+                    }
+                }
+
+                if (offset < size || !fill_buffer())
+                {
+                    break;
+                }
+            }
+
+            if (offset >= m_buffer.size() - m_position)
+            {
+                break;
+            }
+
+            size_t begin = m_position;
+            m_position += offset + 1;
+            if (!parse_start_tag(begin + 1, begin + offset))
+            {
+                stop_on_error(U("XML reader found a malformed start element"));
+                return false;
+            }
+
+            return true;
         }
+
+        stop_on_error(U("XML reader reached the end of the stream inside markup"));
+        return false;
+    }
+
+    const utility::string_t& xml_reader::intern_name(xml_string_view qualified_name)
+    {
+        // The same few element names repeat for every item in a listing, so each one is converted only once
+        xml_string_view name = local_name(qualified_name);
+        m_nameKey.assign(name.data(), name.size());
+
+        auto it = m_names.find(m_nameKey);
+        if (it == m_names.end())
+        {
+            it = m_names.insert(std::make_pair(m_nameKey, name.to_string())).first;
+        }
+
+        return it->second;
+    }
+
+    void xml_reader::stop_on_error(const utility::string_t& message)
+    {
+        // Like XmlLite, malformed input ends the parse instead of throwing, because error responses
+        // are not guaranteed to have an XML body
+        log_error_message(message);
+        m_source = streams::streambuf<uint8_t>();
+        m_sourceDone = true;
+        m_buffer.clear();
+        m_position = 0;
+        m_nodeType = node_none;
+        m_attributes.clear();
     }
 
     bool xml_reader::parse()
@@ -131,33 +605,18 @@ namespace wa { namespace storage { namespace core { namespace xml {
         m_continueParsing = true;
 
         // read until there are no more nodes
-#ifdef WIN32
-        HRESULT hr;
-        XmlNodeType nodeType;
-        while (m_continueParsing && S_OK == (hr = m_reader->Read(&nodeType)))
+        while (m_continueParsing && read_node())
         {
-#else
-        if (m_reader == nullptr)
-            return !m_continueParsing; // no XML document to read
-
-        while (m_continueParsing && m_reader->read())
-        {
-            auto nodeType = m_reader->get_node_type();
-#endif
-            switch (nodeType)
+            switch (m_nodeType)
             {
 
-            case XmlNodeType_Element:
+            case node_element:
             {
-                auto name = get_current_element_name();
-                m_elementStack.push_back(name);
+                const utility::string_t& name = intern_name(m_name);
+                m_elementStack.push_back(&name);
                 handle_begin_element(name);
 
-#ifdef WIN32
-                if (m_reader->IsEmptyElement())
-#else
-                if (m_reader->is_empty_element())
-#endif
+                if (m_emptyElement)
                 {
                     handle_end_element(name);
                     m_elementStack.pop_back();
@@ -165,12 +624,21 @@ namespace wa { namespace storage { namespace core { namespace xml {
             }
                 break;
 
-            case XmlNodeType_Text:
-                handle_element(m_elementStack.back());
+            case node_text:
+                if (!m_elementStack.empty())
+                {
+                    handle_element(*m_elementStack.back());
+                }
                 break;
 
-            case XmlNodeType_EndElement:
-                handle_end_element(m_elementStack.back());
+            case node_end_element:
+                if (m_elementStack.empty() || m_elementStack.back() != &intern_name(m_name))
+                {
+                    stop_on_error(U("XML reader found an end element that does not match the start element"));
+                    break;
+                }
+
+                handle_end_element(*m_elementStack.back());
                 m_elementStack.pop_back();
                 break;
 
@@ -187,7 +655,7 @@ namespace wa { namespace storage { namespace core { namespace xml {
         return !m_continueParsing;
     }
 
-    utility::string_t xml_reader::get_parent_element_name(size_t pos)
+    const utility::string_t& xml_reader::get_parent_element_name(size_t pos)
     {
         if (m_elementStack.size() > pos + 1)
         {
@@ -196,99 +664,69 @@ namespace wa { namespace storage { namespace core { namespace xml {
 
             if (pos <= parentDepth)
             {
-                return m_elementStack[parentDepth - pos];
+                return *m_elementStack[parentDepth - pos];
             }
         }
 
         // return empty string
-        return utility::string_t();
+        return m_emptyName;
     }
 
-    utility::string_t xml_reader::get_current_element_name()
+    const utility::string_t& xml_reader::get_current_element_name()
     {
-#ifdef WIN32
-        HRESULT hr;
-        const wchar_t * pwszLocalName = NULL;
+        if (m_attributeIndex != no_attribute)
+        {
+            return intern_name(m_attributes[m_attributeIndex].name);
+        }
 
-        if (FAILED(hr = m_reader->GetLocalName(&pwszLocalName, NULL)))
+        if (m_nodeType == node_element || m_nodeType == node_end_element)
         {
-            auto error = GetLastError();
-            log_error_message(U("XML reader GetLocalName failed"), error);
-            throw utility::details::create_system_error(error);
+            return intern_name(m_name);
         }
-        return utility::string_t(pwszLocalName);
-#else
-        return utility::string_t(m_reader->get_local_name().raw());
-#endif
+
+        return m_emptyName;
     }
 
     utility::string_t xml_reader::get_current_element_name_with_prefix()
     {
-#ifdef WIN32
-        HRESULT hr;
-        const wchar_t * pwszName = NULL;
-
-        if (FAILED(hr = m_reader->GetQualifiedName(&pwszName, NULL)))
-        {
-            auto error = GetLastError();
-            log_error_message(U("XML reader GetQualified failed"), error);
-            throw utility::details::create_system_error(error);
-        }
-        return utility::string_t(pwszName);
-#else
-        throw std::runtime_error("Not implemented");
-#endif
+        return m_attributeIndex != no_attribute ? m_attributes[m_attributeIndex].name.to_string() : m_name.to_string();
     }
 
     utility::string_t xml_reader::get_current_element_text()
     {
-#ifdef WIN32
-        HRESULT hr;
-        const wchar_t * pwszValue;
-
-        if (FAILED(hr = m_reader->GetValue(&pwszValue, NULL)))
-        {
-            auto error = GetLastError();
-            log_error_message(U("XML reader GetValue failed"), error);
-            throw utility::details::create_system_error(error);
-        }
+        return get_current_element_text_view().to_string();
+    }
 
-        return utility::string_t(pwszValue);
-#else
-        return utility::string_t(m_reader->get_value().raw());
-#endif
+    xml_string_view xml_reader::get_current_element_text_view() const
+    {
+        return m_attributeIndex != no_attribute ? m_attributes[m_attributeIndex].value : m_value;
     }
 
     bool xml_reader::move_to_first_attribute()
     {
-#ifdef WIN32
-        HRESULT hr;
-        if (FAILED(hr = m_reader->MoveToFirstAttribute()))
+        if (m_nodeType != node_element || m_attributes.empty())
         {
-            auto error = GetLastError();
-            log_error_message(U("XML reader MoveToFirstAttribute failed"), error);
-            throw utility::details::create_system_error(error);
+            return false;
         }
-        return (hr == S_OK);
-#else
-        return m_reader->move_to_first_attribute();
-#endif
+
+        m_attributeIndex = 0;
+        return true;
     }
 
     bool xml_reader::move_to_next_attribute()
     {
-#ifdef WIN32
-        HRESULT hr;
-        if (FAILED(hr = m_reader->MoveToNextAttribute()))
+        if (m_attributeIndex == no_attribute)
         {
-            auto error = GetLastError();
-            log_error_message(U("XML reader MoveToNextAttribute failed"), error);
-            throw utility::details::create_system_error(error);
+            return move_to_first_attribute();
         }
-        return (hr == S_OK);
-#else
-        return m_reader->move_to_next_attribute();
-#endif
+
+        if (m_attributeIndex + 1 >= m_attributes.size())
+        {
+            return false;
+        }
+
+        ++m_attributeIndex;
+        return true;
     }
 
     void xml_writer::initialize(std::ostream& stream)
@@ -0,0 +1,171 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="async_semaphore_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "wascore/async_semaphore.h"
+
+SUITE(Core)
+{
+    TEST(async_semaphore_weights)
+    {
+        wa::storage::core::async_semaphore semaphore(4);
+
+        // Units are taken by weight, and a lock that does not fit waits until enough are released
+        auto first = semaphore.lock_async(3);
+        CHECK(first.is_done());
+
+        auto second = semaphore.lock_async(3);
+        CHECK(!second.is_done());
+
+        semaphore.unlock(1);
+        CHECK(!second.is_done());
+
+        semaphore.unlock(2);
+        CHECK(second.is_done());
+        CHECK(!semaphore.wait_all_async().is_done());
+
+        // The single unit locks take one unit each
+        auto third = semaphore.lock_async();
+        CHECK(third.is_done());
+        auto fourth = semaphore.lock_async();
+        CHECK(!fourth.is_done());
+
+        semaphore.unlock(3);
+        CHECK(fourth.is_done());
+        semaphore.unlock();
+        CHECK(!semaphore.wait_all_async().is_done());
+        semaphore.unlock();
+        CHECK(semaphore.wait_all_async().is_done());
+    }
+
+    TEST(async_semaphore_clamped_weights)
+    {
+        wa::storage::core::async_semaphore semaphore(4);
+
+        // A weight above the count of the semaphore takes all of its units instead of waiting forever
+        auto heavy = semaphore.lock_async(10);
+        CHECK(heavy.is_done());
+
+        auto light = semaphore.lock_async(1);
+        CHECK(!light.is_done());
+
+        semaphore.unlock(10);
+        CHECK(light.is_done());
+        semaphore.unlock(1);
+        CHECK(semaphore.wait_all_async().is_done());
+
+        // A weight below one takes a single unit, and is released as a single unit
+        wa::storage::core::async_semaphore pair(2);
+        auto zero = pair.lock_async(0);
+        auto negative = pair.lock_async(-5);
+        CHECK(zero.is_done());
+        CHECK(negative.is_done());
+
+        auto waiting = pair.lock_async(1);
+        CHECK(!waiting.is_done());
+
+        pair.unlock(0);
+        CHECK(waiting.is_done());
+        pair.unlock(-5);
+        CHECK(!pair.wait_all_async().is_done());
+        pair.unlock(1);
+        CHECK(pair.wait_all_async().is_done());
+    }
+
+    TEST(async_semaphore_order)
+    {
+        wa::storage::core::async_semaphore semaphore(4);
+
+        auto held = semaphore.lock_async(1);
+        CHECK(held.is_done());
+
+        // A heavy waiter is not overtaken by the light ones queued after it, even though they would fit
+        auto heavy = semaphore.lock_async(4);
+        auto light = semaphore.lock_async(1);
+        auto lighter = semaphore.lock_async(2);
+        CHECK(!heavy.is_done());
+        CHECK(!light.is_done());
+        CHECK(!lighter.is_done());
+
+        semaphore.unlock(1);
+        CHECK(heavy.is_done());
+        CHECK(!light.is_done());
+        CHECK(!lighter.is_done());
+
+        // Once it is done, the waiters behind it are granted in order as far as the units go
+        semaphore.unlock(4);
+        CHECK(light.is_done());
+        CHECK(lighter.is_done());
+
+        auto last = semaphore.lock_async(2);
+        CHECK(!last.is_done());
+        semaphore.unlock(1);
+        CHECK(last.is_done());
+
+        semaphore.unlock(2);
+        semaphore.unlock(2);
+        CHECK(semaphore.wait_all_async().is_done());
+    }
+
+    TEST(async_semaphore_concurrency)
+    {
+        const int64_t count = 5;
+        wa::storage::core::async_semaphore semaphore(count);
+        std::atomic<int64_t> in_use(0);
+        std::atomic<int64_t> max_in_use(0);
+
+        // Threads lock and unlock different weights at once. A lost wakeup would leave one of them waiting forever,
+        // and the units in use never exceed the count of the semaphore.
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 8; ++thread)
+        {
+            threads.push_back(std::thread([&semaphore, &in_use, &max_in_use, count, thread] ()
+            {
+                for (int i = 0; i < 2000; ++i)
+                {
+                    int64_t weight = (thread + i) % count + 1;
+                    semaphore.lock_async(weight).wait();
+
+                    auto current = in_use.fetch_add(weight) + weight;
+                    auto highest = max_in_use.load();
+                    while ((current > highest) && !max_in_use.compare_exchange_weak(highest, current))
+                    {
+                    }
+
+                    in_use.fetch_sub(weight);
+                    semaphore.unlock(weight);
+                }
+            }));
+        }
+
+        for (auto iter = threads.begin(); iter != threads.end(); ++iter)
+        {
+            iter->join();
+        }
+
+        CHECK(max_in_use.load() <= count);
+        CHECK_EQUAL(0, in_use.load());
+        semaphore.wait_all_async().wait();
+
+        // All the units are back, so the largest lock is granted at once
+        auto all = semaphore.lock_async(count);
+        CHECK(all.is_done());
+        semaphore.unlock(count);
+    }
+}
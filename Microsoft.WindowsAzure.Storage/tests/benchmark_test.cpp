@@ -0,0 +1,475 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="benchmark_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#if defined(WIN32) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+
+#include "cpprest/rawptrstream.h"
+#include "was/auth.h"
+#include "was/blob.h"
+#include "was/in_memory_transport.h"
+#include "was/table.h"
+#include "wascore/allocation_tracker.h"
+#include "wascore/protocol.h"
+#include "wascore/protocol_json.h"
+#include "wascore/protocol_xml.h"
+#include "wascore/streams.h"
+
+// Times should be read from a release build. Allocations are counted through the debug CRT, which the tests share
+// with the library, so they are only reported by a debug build. The requests of a library built with
+// WASTORAGE_COUNT_ALLOCATIONS also report the allocations the library made for them, in any build.
+
+namespace
+{
+    std::atomic<long long> allocation_count(0);
+
+#if defined(WIN32) && defined(_DEBUG)
+    int __cdecl count_allocation(int allocation_type, void*, size_t, int, long, const unsigned char*, int)
+    {
+        if (allocation_type == _HOOK_ALLOC || allocation_type == _HOOK_REALLOC)
+        {
+            ++allocation_count;
+        }
+
+        return TRUE;
+    }
+
+    const bool allocations_counted = true;
+#else
+    const bool allocations_counted = false;
+#endif
+
+    void run_benchmark(const utility::string_t& name, int iterations, size_t bytes_per_operation, std::function<void ()> operation)
+    {
+        // The first run fills caches and lazily created state, so it is not measured
+        operation();
+
+#if defined(WIN32) && defined(_DEBUG)
+        auto previous_hook = _CrtSetAllocHook(count_allocation);
+#endif
+        auto allocations_before = allocation_count.load();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            operation();
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto allocations = allocation_count.load() - allocations_before;
+#if defined(WIN32) && defined(_DEBUG)
+        _CrtSetAllocHook(previous_hook);
+#endif
+
+        auto nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / iterations;
+        ucout << name << U(": ") << static_cast<long long>(nanoseconds) << U(" ns/op");
+        if (allocations_counted)
+        {
+            ucout << U(", ") << static_cast<double>(allocations) / iterations << U(" allocs/op");
+        }
+
+        if (bytes_per_operation > 0)
+        {
+            ucout << U(", ") << static_cast<long long>(bytes_per_operation * 1000.0 / nanoseconds) << U(" MB/s");
+        }
+
+        ucout << std::endl;
+    }
+
+    // Runs the operation on an increasing number of threads at once, and reports how the throughput scales against the
+    // throughput of a single thread. The operation is given the index of the thread that runs it.
+    void run_scaling_benchmark(const utility::string_t& name, int operations_per_thread, std::function<void (int)> operation)
+    {
+        int max_threads = std::min(std::max(static_cast<int>(std::thread::hardware_concurrency()), 1), 64);
+        double single_thread_rate = 0.0;
+        for (int thread_count = 1; ; thread_count = std::min(thread_count * 2, max_threads))
+        {
+            // Every thread warms up first, so that lazily created state is not measured
+            std::vector<std::thread> threads;
+            std::atomic<int> ready(0);
+            std::atomic<bool> start(false);
+            for (int i = 0; i < thread_count; ++i)
+            {
+                threads.push_back(std::thread([&operation, &ready, &start, operations_per_thread, i] ()
+                {
+                    operation(i);
+                    ++ready;
+                    while (!start.load())
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    for (int j = 0; j < operations_per_thread; ++j)
+                    {
+                        operation(i);
+                    }
+                }));
+            }
+
+            while (ready.load() < thread_count)
+            {
+                std::this_thread::yield();
+            }
+
+            auto start_time = std::chrono::steady_clock::now();
+            start = true;
+            for (auto iter = threads.begin(); iter != threads.end(); ++iter)
+            {
+                iter->join();
+            }
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+            double rate = static_cast<double>(operations_per_thread) * thread_count * 1000000.0 / (elapsed > 0 ? elapsed : 1);
+            if (thread_count == 1)
+            {
+                single_thread_rate = rate;
+            }
+
+            // Perfect scaling keeps the throughput of each thread at the single thread throughput
+            double efficiency = rate / (single_thread_rate * thread_count);
+            ucout << name << U(" (") << thread_count << U(" threads): ") << static_cast<long long>(rate) << U(" ops/s, ")
+                << static_cast<long long>(rate / thread_count) << U(" ops/s per thread, ") << static_cast<int>(efficiency * 100.0) << U("% scaling") << std::endl;
+
+            if (thread_count == max_threads)
+            {
+                break;
+            }
+        }
+    }
+
+    wa::storage::cloud_block_blob make_in_memory_blob(bool use_transactional_md5)
+    {
+        wa::storage::blob_request_options options;
+        options.set_transport(std::make_shared<wa::storage::in_memory_transport>());
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_use_transactional_md5(use_transactional_md5);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        return client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+    }
+
+    std::string make_list_blobs_response(int count)
+    {
+        std::string response("<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults ServiceEndpoint=\"https://account.blob.core.windows.net/\" ContainerName=\"container\"><Blobs>");
+        for (int i = 0; i < count; ++i)
+        {
+            response.append("<Blob><Name>directory/blob");
+            response.append(std::to_string(i));
+            response.append("</Name><Properties><Last-Modified>Wed, 09 Sep 2009 09:20:02 GMT</Last-Modified><Etag>0x8CBFF45D8A29A19</Etag>");
+            response.append("<Content-Length>1048576</Content-Length><Content-Type>application/octet-stream</Content-Type><Content-MD5>sQqNsWTgdUEFt6mb5y4/5Q==</Content-MD5>");
+            response.append("<BlobType>BlockBlob</BlobType><LeaseStatus>unlocked</LeaseStatus><LeaseState>available</LeaseState></Properties>");
+            response.append("<Metadata><Owner>user</Owner></Metadata></Blob>");
+        }
+
+        response.append("</Blobs><NextMarker /></EnumerationResults>");
+        return response;
+    }
+
+    std::string make_query_response(int count)
+    {
+        std::string response("{\"odata.metadata\":\"https://account.table.core.windows.net/$metadata#table\",\"value\":[");
+        for (int i = 0; i < count; ++i)
+        {
+            if (i > 0)
+            {
+                response.push_back(',');
+            }
+
+            response.append("{\"PartitionKey\":\"partition\",\"RowKey\":\"row");
+            response.append(std::to_string(i));
+            response.append("\",\"Timestamp\":\"2013-08-22T01:12:06.2608595Z\",\"Age\":23,\"Name\":\"name\",\"Score\":1.5,");
+            response.append("\"Total\":\"1234567890123\",\"Total@odata.type\":\"Edm.Int64\",\"Active\":true,");
+            response.append("\"Created\":\"2013-08-22T01:12:06Z\",\"Created@odata.type\":\"Edm.DateTime\"}");
+        }
+
+        response.append("]}");
+        return response;
+    }
+}
+
+SUITE(Benchmarks)
+{
+    TEST(shared_key_sign_request)
+    {
+        wa::storage::storage_credentials credentials(U("account"), U("YWNjb3VudGtleQ=="));
+        wa::storage::protocol::shared_key_authentication_handler handler(std::make_shared<wa::storage::protocol::shared_key_blob_queue_canonicalizer>(U("account")), credentials);
+        wa::storage::operation_context context;
+
+        web::http::http_request request(web::http::methods::PUT);
+        request.set_request_uri(web::http::uri(U("https://account.blob.core.windows.net/container/blob?comp=block&blockid=AAAAAA%3D%3D&timeout=90")));
+        request.headers().add(U("x-ms-version"), U("2012-02-12"));
+        request.headers().add(U("x-ms-date"), U("Wed, 09 Sep 2009 09:20:02 GMT"));
+        request.headers().add(U("x-ms-client-request-id"), U("c2e0c4d0-5a7e-4a7f-9b9f-1b5e0c2f3a01"));
+        request.headers().add(U("x-ms-meta-owner"), U("user"));
+        request.headers().add(web::http::header_names::content_length, U("4194304"));
+        request.headers().add(web::http::header_names::content_type, U("application/octet-stream"));
+
+        run_benchmark(U("shared_key_sign_request"), 10000, 0, [&handler, &request, &context] ()
+        {
+            handler.sign_request(request, context);
+            request.headers().remove(web::http::header_names::authorization);
+        });
+
+        handler.sign_request(request, context);
+        CHECK(request.headers().has(web::http::header_names::authorization));
+    }
+
+    TEST(list_blobs_reader)
+    {
+        const auto response = make_list_blobs_response(1000);
+        auto read_items = [&response] () -> std::vector<wa::storage::protocol::cloud_blob_list_item>
+        {
+            auto stream = concurrency::streams::rawptr_stream<uint8_t>::open_istream(reinterpret_cast<const uint8_t*>(response.data()), response.size());
+            wa::storage::protocol::list_blobs_reader reader(stream);
+            return reader.extract_blob_items();
+        };
+
+        run_benchmark(U("list_blobs_reader (1000 blobs)"), 100, response.size(), [&read_items] ()
+        {
+            read_items();
+        });
+
+        CHECK_EQUAL(1000U, read_items().size());
+    }
+
+    TEST(table_entity_reader)
+    {
+        const auto response = make_query_response(1000);
+        auto read_entities = [&response] () -> std::vector<wa::storage::table_entity>
+        {
+            wa::storage::protocol::table_entity_reader reader(response.data(), response.size(), true);
+            return reader.extract_entities();
+        };
+
+        run_benchmark(U("table_entity_reader (1000 entities)"), 100, response.size(), [&read_entities] ()
+        {
+            read_entities();
+        });
+
+        CHECK_EQUAL(1000U, read_entities().size());
+    }
+
+    TEST(entity_property_conversions)
+    {
+        const auto datetime = utility::datetime::from_string(U("2013-08-22T01:12:06Z"), utility::datetime::ISO_8601);
+        const auto guid = utility::string_to_uuid(U("c2e0c4d0-5a7e-4a7f-9b9f-1b5e0c2f3a01"));
+
+        // Each operation formats and then parses one property of each type that needs a conversion
+        size_t length = 0;
+        run_benchmark(U("entity_property_conversions"), 10000, 0, [&datetime, &guid, &length] ()
+        {
+            wa::storage::entity_property values[] =
+            {
+                wa::storage::entity_property(int32_t(-123456)),
+                wa::storage::entity_property(int64_t(1234567890123LL)),
+                wa::storage::entity_property(3.14159),
+                wa::storage::entity_property(true),
+                wa::storage::entity_property(datetime),
+                wa::storage::entity_property(guid)
+            };
+
+            for (auto& value : values)
+            {
+                auto type = value.property_type();
+                wa::storage::entity_property parsed(value.str());
+                parsed.set_property_type(type);
+                length += parsed.str().size();
+            }
+        });
+
+        wa::storage::entity_property parsed(wa::storage::entity_property(int64_t(1234567890123LL)).str());
+        parsed.set_property_type(wa::storage::edm_type::int64);
+        CHECK_EQUAL(1234567890123LL, parsed.int64_value());
+    }
+
+    TEST(table_entity_writer)
+    {
+        wa::storage::table_entity entity(U("partition"), U("row"));
+        entity.properties()[U("Name")] = wa::storage::entity_property(utility::string_t(U("name \"quoted\"")));
+        entity.properties()[U("Age")] = wa::storage::entity_property(int32_t(-23));
+        entity.properties()[U("Big")] = wa::storage::entity_property(int64_t(-9223372036854775807LL - 1));
+        entity.properties()[U("Score")] = wa::storage::entity_property(2.0);
+        entity.properties()[U("Tiny")] = wa::storage::entity_property(1e-300);
+        entity.properties()[U("Missing")] = wa::storage::entity_property(std::numeric_limits<double>::quiet_NaN());
+        entity.properties()[U("Active")] = wa::storage::entity_property(true);
+        entity.properties()[U("Created")] = wa::storage::entity_property(utility::datetime::from_string(U("2013-08-22T01:12:06.5Z"), utility::datetime::ISO_8601));
+        entity.properties()[U("Data")] = wa::storage::entity_property(std::vector<uint8_t>(10, 0xAB));
+
+        std::string body;
+        run_benchmark(U("table_entity_writer"), 10000, 0, [&entity, &body] ()
+        {
+            body.clear();
+            wa::storage::protocol::table_entity_writer::write_entity(body, entity);
+        });
+
+        // Only the types that JSON values cannot tell apart are annotated
+        CHECK(body.find("\"Name@odata.type\"") == std::string::npos);
+        CHECK(body.find("\"Age@odata.type\"") == std::string::npos);
+        CHECK(body.find("\"Score@odata.type\"") == std::string::npos);
+        CHECK(body.find("\"Active@odata.type\"") == std::string::npos);
+        CHECK(body.find("\"Score\":2.0") != std::string::npos);
+        CHECK(body.find("\"Big@odata.type\":\"Edm.Int64\",\"Big\":\"-9223372036854775808\"") != std::string::npos);
+        CHECK(body.find("\"Missing@odata.type\":\"Edm.Double\",\"Missing\":\"NaN\"") != std::string::npos);
+
+        wa::storage::protocol::table_entity_reader reader(body.data(), body.size(), false);
+        wa::storage::table_entity parsed = reader.extract_entity();
+
+        CHECK(parsed.partition_key() == U("partition"));
+        CHECK(parsed.row_key() == U("row"));
+        CHECK_EQUAL(entity.properties().size(), parsed.properties().size());
+        for (auto iter = entity.properties().cbegin(); iter != entity.properties().cend(); ++iter)
+        {
+            const wa::storage::entity_property& property = parsed.properties().at(iter->first);
+            CHECK(property.property_type() == iter->second.property_type());
+            CHECK(property.str() == iter->second.str());
+        }
+    }
+
+    TEST(batch_request_body)
+    {
+        wa::storage::cloud_table_client client(wa::storage::storage_uri(web::http::uri(U("https://account.table.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")));
+        auto table = client.get_table_reference(U("table"));
+
+        wa::storage::table_batch_operation operation;
+        for (int i = 0; i < 100; ++i)
+        {
+            wa::storage::table_entity entity(U("partition"), U("row") + utility::conversions::print_string(i));
+            entity.properties()[U("Name")] = wa::storage::entity_property(utility::string_t(U("name")));
+            entity.properties()[U("Age")] = wa::storage::entity_property(int32_t(23));
+            entity.properties()[U("Score")] = wa::storage::entity_property(1.5);
+            operation.insert_or_replace_entity(entity);
+        }
+
+        wa::storage::operation_context context;
+        auto build_request = [&table, &operation, &context] () -> web::http::http_request
+        {
+            return wa::storage::protocol::execute_batch_operation(table, operation, wa::storage::table_payload_format::json, false, false, web::http::uri_builder(table.service_client().base_uri().primary_uri()), std::chrono::seconds(30), context);
+        };
+
+        run_benchmark(U("batch_request_body (100 entities)"), 1000, 0, [&build_request] ()
+        {
+            build_request();
+        });
+
+        CHECK(build_request().headers().content_type().find(U("multipart/mixed")) == 0);
+    }
+
+    TEST(hash_md5_streambuf)
+    {
+        const size_t buffer_size = 4 * 1024 * 1024;
+        std::vector<uint8_t> buffer(buffer_size);
+        for (size_t i = 0; i < buffer_size; ++i)
+        {
+            buffer[i] = static_cast<uint8_t>(i * 31);
+        }
+
+        utility::string_t content_md5;
+        run_benchmark(U("hash_md5_streambuf (4 MB)"), 50, buffer_size, [&buffer, &content_md5] ()
+        {
+            wa::storage::core::hash_md5_streambuf hash;
+            hash.putn(buffer.data(), buffer.size()).wait();
+            hash.close().wait();
+            content_md5 = utility::conversions::to_base64(hash.hash());
+        });
+
+        CHECK(!content_md5.empty());
+    }
+
+    TEST(put_block)
+    {
+        auto blob = make_in_memory_blob(false);
+        std::vector<uint8_t> content(64 * 1024);
+        wa::storage::request_allocations allocations;
+        uint64_t library_allocations = 0;
+        int runs = 0;
+        run_benchmark(U("put_block (64 KB)"), 1000, content.size(), [&blob, &content, &allocations, &library_allocations, &runs] ()
+        {
+            wa::storage::operation_context context;
+            blob.upload_block(U("YmxvY2s="), concurrency::streams::bytestream::open_istream(content), utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), context);
+            allocations = context.request_results().back().allocations();
+            library_allocations += allocations.count();
+            ++runs;
+        });
+
+        if (wa::storage::core::allocation_scope::is_counting())
+        {
+            ucout << U("put_block (64 KB): ") << static_cast<double>(library_allocations) / runs << U(" library allocs/op") << std::endl;
+            CHECK(allocations.count() > 0);
+            CHECK(allocations.bytes() > 0);
+        }
+        else
+        {
+            CHECK_EQUAL(0U, allocations.count());
+            CHECK_EQUAL(0U, allocations.bytes());
+        }
+    }
+
+    // Each variant shares one more structure between the threads than the one before it, so the variant whose scaling
+    // drops first shows which shared structure contends: the client itself (its authentication handler, default
+    // options and pools), the request result list of a shared operation_context, or the hash providers.
+    TEST(shared_client_scaling)
+    {
+        std::vector<uint8_t> content(4 * 1024);
+        const int operations_per_thread = 200;
+
+        std::vector<wa::storage::cloud_block_blob> blobs;
+        for (int i = 0; i < 64; ++i)
+        {
+            blobs.push_back(make_in_memory_blob(false));
+        }
+
+        std::atomic<int> completed(0);
+        run_scaling_benchmark(U("put_block (client per thread)"), operations_per_thread, [&blobs, &content, &completed] (int thread_index)
+        {
+            blobs[thread_index].upload_block(U("YmxvY2s="), concurrency::streams::bytestream::open_istream(content), utility::string_t());
+            ++completed;
+        });
+
+        auto shared_blob = make_in_memory_blob(false);
+        run_scaling_benchmark(U("put_block (shared client)"), operations_per_thread, [&shared_blob, &content, &completed] (int)
+        {
+            shared_blob.upload_block(U("YmxvY2s="), concurrency::streams::bytestream::open_istream(content), utility::string_t());
+            ++completed;
+        });
+
+        wa::storage::operation_context shared_context;
+        run_scaling_benchmark(U("put_block (shared client and context)"), operations_per_thread, [&shared_blob, &content, &shared_context, &completed] (int)
+        {
+            shared_blob.upload_block(U("YmxvY2s="), concurrency::streams::bytestream::open_istream(content), utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), shared_context);
+            ++completed;
+        });
+
+        auto md5_blob = make_in_memory_blob(true);
+        run_scaling_benchmark(U("put_block (shared client, transactional MD5)"), operations_per_thread, [&md5_blob, &content, &completed] (int)
+        {
+            md5_blob.upload_block(U("YmxvY2s="), concurrency::streams::bytestream::open_istream(content), utility::string_t());
+            ++completed;
+        });
+
+        CHECK(completed.load() > 0);
+        CHECK(!shared_context.request_results().empty());
+    }
+}
@@ -197,6 +197,55 @@ SUITE(Blob)
         check_lease_access(m_blob, wa::storage::lease_state::available, lease_id, false);
     }
 
+    TEST_FIXTURE(block_blob_test_base, blob_lease_keeper)
+    {
+        m_blob.upload_text(U("test"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        wa::storage::blob_lease_keeper lease_keeper(wa::storage::blob_request_options(), m_context);
+        CHECK_THROW(lease_keeper.get_access_condition(m_blob.uri()), std::invalid_argument);
+        CHECK_THROW(lease_keeper.track(m_blob, utility::string_t(), wa::storage::lease_time(std::chrono::seconds(15)), nullptr), std::invalid_argument);
+
+        std::atomic<bool> is_lost(false);
+        auto lease_id = m_blob.acquire_lease(wa::storage::lease_time(std::chrono::seconds(15)), utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        lease_keeper.track(m_blob, lease_id, wa::storage::lease_time(std::chrono::seconds(15)), [&is_lost] (std::exception_ptr)
+        {
+            is_lost = true;
+        });
+        CHECK(lease_keeper.is_tracked(m_blob.uri()));
+        CHECK_EQUAL(1, lease_keeper.tracked_count());
+
+        // The lease outlives its lease time because it is renewed
+        std::this_thread::sleep_for(std::chrono::seconds(40));
+        check_lease_access(m_blob, wa::storage::lease_state::leased, lease_id, false);
+        m_blob.upload_text(U("renewed"), lease_keeper.get_access_condition(m_blob.uri()), wa::storage::blob_request_options(), m_context);
+        CHECK(!is_lost);
+
+        // A broken lease is lost at its next renewal
+        m_blob.break_lease(wa::storage::lease_break_period(std::chrono::seconds(0)), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        for (int i = 0; (i < 30) && !is_lost; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+
+        CHECK(is_lost);
+        CHECK(!lease_keeper.is_tracked(m_blob.uri()));
+        CHECK_THROW(lease_keeper.release_lease(m_blob.uri()), std::invalid_argument);
+    }
+
+    TEST_FIXTURE(container_test_base, container_lease_keeper)
+    {
+        m_container.create(wa::storage::blob_container_public_access_type::off, wa::storage::blob_request_options(), m_context);
+
+        wa::storage::blob_lease_keeper lease_keeper(wa::storage::blob_request_options(), m_context);
+        auto lease_id = m_container.acquire_lease(wa::storage::lease_time(), utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        lease_keeper.track(m_container, lease_id, wa::storage::lease_time(), nullptr);
+        CHECK(lease_keeper.get_access_condition(m_container.uri()).lease_id() == lease_id);
+
+        lease_keeper.release_lease(m_container.uri());
+        CHECK_EQUAL(0, lease_keeper.tracked_count());
+        check_lease_access(m_container, wa::storage::lease_state::available, lease_id, false, true);
+    }
+
     TEST_FIXTURE(block_blob_test_base, blob_lease_break_infinite_immediately)
     {
         m_blob.upload_text(U("test"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
@@ -19,6 +19,10 @@
 #include "blob_test_base.h"
 #include "check_macros.h"
 
+#include "was/in_memory_transport.h"
+
+#include <atomic>
+
 size_t seek_read_and_compare(concurrency::streams::istream stream, std::vector<uint8_t> buffer_to_compare, utility::size64_t offset, size_t count, size_t expected_read_count)
 {
     std::vector<uint8_t> buffer;
@@ -53,6 +57,41 @@ SUITE(Blob)
         CHECK_ARRAY_EQUAL(buffer, output_buffer.collection(), output_buffer.collection().size());
     }
 
+    TEST_FIXTURE(block_blob_test_base, blob_read_stream_prefetch)
+    {
+        wa::storage::blob_request_options options;
+        options.set_stream_read_size_in_bytes(1 * 1024 * 1024);
+        options.set_stream_prefetch_depth(2);
+
+        std::vector<uint8_t> buffer;
+        buffer.resize(5 * 1024 * 1024 + 1024);
+        fill_buffer_and_get_md5(buffer);
+        m_blob.upload_from_stream(concurrency::streams::bytestream::open_istream(buffer), wa::storage::access_condition(), options, m_context);
+
+        {
+            wa::storage::operation_context context;
+            concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+
+            auto stream = m_blob.open_read(wa::storage::access_condition(), options, context);
+            stream.read_to_end(output_buffer).wait();
+            stream.close();
+
+            CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+            CHECK_ARRAY_EQUAL(buffer, output_buffer.collection(), output_buffer.collection().size());
+
+            // One HEAD request followed by one request per range, none of them wasted
+            CHECK_EQUAL(7, context.request_results().size());
+        }
+
+        auto stream = m_blob.open_read(wa::storage::access_condition(), options, m_context);
+        seek_read_and_compare(stream, buffer, 0, 1024, 1024);
+        seek_read_and_compare(stream, buffer, 2 * 1024 * 1024 + 512, 1024, 1024);
+        seek_read_and_compare(stream, buffer, 4 * 1024 * 1024 - 512, 1024, 1024);
+        seek_read_and_compare(stream, buffer, 1024, 1024, 1024);
+        seek_read_and_compare(stream, buffer, buffer.size() - 128, 1024, 128);
+        stream.close();
+    }
+
     TEST_FIXTURE(block_blob_test_base, blob_read_stream_etag_lock)
     {
         wa::storage::blob_request_options options;
@@ -150,6 +189,144 @@ SUITE(Blob)
         CHECK_EQUAL(concurrency::streams::ostream::traits::eof(), stream.seek(0));
     }
 
+    TEST_FIXTURE(block_blob_test_base, block_blob_write_stream_buffer_pool)
+    {
+        auto client = m_client;
+        client.set_block_buffer_pool_size(1);
+        CHECK_EQUAL(1U, client.block_buffer_pool_size());
+        auto blob = client.get_container_reference(m_container.name()).get_block_blob_reference(m_blob.name());
+
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(4);
+        options.set_stream_write_size_in_bytes(16 * 1024);
+        options.set_use_transactional_md5(true);
+
+        std::vector<uint8_t> buffer;
+        buffer.resize(10 * 16 * 1024 + 100);
+        fill_buffer_and_get_md5(buffer);
+
+        // Only one block buffer can be held at a time, so writes wait for each upload to return its buffer
+        auto stream = blob.open_write(wa::storage::access_condition(), options, m_context);
+        stream.streambuf().putn(buffer.data(), buffer.size() / 2).wait();
+        stream.streambuf().putn(buffer.data() + buffer.size() / 2, buffer.size() - buffer.size() / 2).wait();
+        stream.close().wait();
+
+        CHECK_EQUAL(11U, blob.download_block_list(wa::storage::block_listing_filter::committed, wa::storage::access_condition(), options, m_context).size());
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), options, m_context);
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+    }
+
+    class counting_buffer_allocator : public wa::storage::buffer_allocator
+    {
+    public:
+
+        counting_buffer_allocator()
+            : m_allocations(0), m_outstanding_bytes(0)
+        {
+        }
+
+        void* allocate(size_t size)
+        {
+            ++m_allocations;
+            m_outstanding_bytes += size;
+            return ::operator new(size);
+        }
+
+        void deallocate(void* pointer, size_t size)
+        {
+            m_outstanding_bytes -= size;
+            ::operator delete(pointer);
+        }
+
+        int allocations() const
+        {
+            return m_allocations;
+        }
+
+        size_t outstanding_bytes() const
+        {
+            return m_outstanding_bytes;
+        }
+
+    private:
+
+        std::atomic<int> m_allocations;
+        std::atomic<size_t> m_outstanding_bytes;
+    };
+
+    TEST_FIXTURE(block_blob_test_base, blob_streams_buffer_allocator)
+    {
+        auto allocator = std::make_shared<counting_buffer_allocator>();
+
+        std::vector<uint8_t> buffer;
+        buffer.resize(4 * 16 * 1024 + 100);
+        fill_buffer_and_get_md5(buffer);
+
+        {
+            auto client = m_client;
+            client.set_block_buffer_pool_size(2);
+            auto blob = client.get_container_reference(m_container.name()).get_block_blob_reference(m_blob.name());
+
+            wa::storage::blob_request_options options;
+            options.set_parallelism_factor(2);
+            options.set_stream_write_size_in_bytes(16 * 1024);
+            options.set_stream_read_size_in_bytes(16 * 1024);
+            options.set_buffer_allocator(allocator);
+
+            auto write_stream = blob.open_write(wa::storage::access_condition(), options, m_context);
+            write_stream.streambuf().putn(buffer.data(), buffer.size()).wait();
+            write_stream.close().wait();
+
+            // The blocks were staged in buffers from the allocator, which the pool of the client still holds
+            int write_allocations = allocator->allocations();
+            CHECK(write_allocations > 0);
+
+            std::vector<uint8_t> output(buffer.size());
+            auto read_stream = blob.open_read(wa::storage::access_condition(), options, m_context);
+            CHECK_EQUAL(buffer.size(), read_stream.streambuf().getn(output.data(), output.size()).get());
+            read_stream.close().wait();
+            CHECK_ARRAY_EQUAL(buffer.data(), output.data(), buffer.size());
+            CHECK(allocator->allocations() > write_allocations);
+        }
+
+        // Every buffer is given back to the allocator once the streams and the pool are gone
+        CHECK_EQUAL(0U, allocator->outstanding_bytes());
+    }
+
+    TEST_FIXTURE(block_blob_test_base, blob_streams_memory_budget)
+    {
+        auto client = m_client;
+        client.set_memory_budget_in_bytes(2 * 16 * 1024);
+        CHECK_EQUAL(2 * 16 * 1024U, client.memory_budget_in_bytes());
+        auto blob = client.get_container_reference(m_container.name()).get_block_blob_reference(m_blob.name());
+
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(4);
+        options.set_stream_write_size_in_bytes(16 * 1024);
+        options.set_stream_read_size_in_bytes(16 * 1024);
+        options.set_stream_prefetch_depth(3);
+
+        std::vector<uint8_t> buffer;
+        buffer.resize(10 * 16 * 1024 + 100);
+        fill_buffer_and_get_md5(buffer);
+
+        // Both streams hold at most two buffers at once, so they wait for each other's buffers to be released
+        auto write_stream = blob.open_write(wa::storage::access_condition(), options, m_context);
+        write_stream.streambuf().putn(buffer.data(), buffer.size()).wait();
+        write_stream.close().wait();
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        auto read_stream = blob.open_read(wa::storage::access_condition(), options, m_context);
+        read_stream.read_to_end(output_buffer).wait();
+        read_stream.close().wait();
+
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+    }
+
     TEST_FIXTURE(page_blob_test_base, page_blob_write_stream_seek_with_md5)
     {
         wa::storage::blob_request_options options;
@@ -390,6 +567,165 @@ SUITE(Blob)
         stream.close().wait();
     }
 
+    TEST(block_blob_write_stream_block_retries)
+    {
+        // The first two block requests fail with a server error, and every other request is answered as usual
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto failures = std::make_shared<std::atomic<int>>(0);
+        auto transport_pointer = transport.get();
+        transport->set_responder([transport_pointer, failures] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            if ((query[U("comp")] == U("block")) && (*failures)-- > 0)
+            {
+                return web::http::http_response(web::http::status_codes::InternalError);
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options default_options;
+        default_options.set_transport(transport);
+        default_options.set_retry_policy(wa::storage::no_retry_policy());
+        default_options.set_stream_write_size_in_bytes(64 * 1024);
+        default_options.set_parallelism_factor(2);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        std::vector<uint8_t> buffer(4 * 64 * 1024);
+        auto write = [&blob, &buffer] (const wa::storage::blob_request_options& options)
+        {
+            auto stream = blob.open_write(wa::storage::access_condition(), options, wa::storage::operation_context());
+            stream.streambuf().putn(buffer.data(), buffer.size()).wait();
+            stream.close().wait();
+        };
+
+        // Only the failed blocks are sent again, and the stream completes
+        *failures = 2;
+        auto request_count = transport->request_count();
+        write(wa::storage::blob_request_options());
+        CHECK_EQUAL(request_count + 7, transport->request_count());
+
+        wa::storage::blob_request_options options;
+        options.set_stream_block_retries(0);
+        *failures = 1;
+        CHECK_THROW(write(options), wa::storage::storage_exception);
+
+        options.set_stream_block_retries(3);
+        options.set_stream_max_failed_blocks(1);
+        *failures = 2;
+        CHECK_THROW(write(options), wa::storage::storage_exception);
+    }
+
+    TEST(blob_read_stream_range_cache)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(64 * 1024);
+        auto transport_pointer = transport.get();
+        auto ranges = std::make_shared<std::vector<utility::string_t>>();
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, ranges, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto range = request.headers().find(U("x-ms-range"));
+            if ((request.method() == web::http::methods::GET) && (range != request.headers().end()))
+            {
+                std::lock_guard<std::mutex> guard(*mutex);
+                ranges->push_back(range->second);
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_read_size_in_bytes(4 * 1024);
+        options.set_stream_range_cache_size_in_bytes(16 * 1024);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        auto stream = blob.open_read();
+        auto read_at = [&stream] (utility::size64_t offset)
+        {
+            std::vector<uint8_t> buffer(100);
+            stream.seek(offset);
+            CHECK_EQUAL(buffer.size(), stream.streambuf().getn(buffer.data(), buffer.size()).get());
+        };
+
+        // Ranges are aligned, and reading a footer and then a header again only downloads each of them once
+        read_at(61 * 1024);
+        read_at(100);
+        read_at(61 * 1024 + 10);
+        read_at(200);
+        CHECK_EQUAL(2U, ranges->size());
+        CHECK(ranges->at(0) == U("bytes=61440-65535"));
+        CHECK(ranges->at(1) == U("bytes=0-4095"));
+
+        // The least recently used ranges are dropped once the cache is full
+        for (int i = 2; i <= 6; ++i)
+        {
+            read_at(i * 4 * 1024);
+        }
+
+        CHECK_EQUAL(7U, ranges->size());
+        read_at(6 * 4 * 1024 + 10);
+        read_at(100);
+        CHECK_EQUAL(8U, ranges->size());
+
+        stream.close().wait();
+    }
+
+    TEST(blob_range_read_scheduler)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(64 * 1024);
+        auto transport_pointer = transport.get();
+        auto ranges = std::make_shared<std::vector<utility::string_t>>();
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, ranges, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto range = request.headers().find(U("x-ms-range"));
+            if ((request.method() == web::http::methods::GET) && (range != request.headers().end()))
+            {
+                std::lock_guard<std::mutex> guard(*mutex);
+                ranges->push_back(range->second);
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        wa::storage::blob_range_read_scheduler scheduler;
+        scheduler.set_max_gap(1024);
+        scheduler.set_batching_window(std::chrono::milliseconds(50));
+
+        // The first three reads are close enough to share a download, and the last one is too far away
+        std::vector<concurrency::streams::container_buffer<std::vector<uint8_t>>> targets(4);
+        std::vector<pplx::task<void>> reads;
+        reads.push_back(scheduler.download_range_to_stream_async(blob, targets[0].create_ostream(), 1000, 100));
+        reads.push_back(scheduler.download_range_to_stream_async(blob, targets[1].create_ostream(), 0, 200));
+        reads.push_back(scheduler.download_range_to_stream_async(blob, targets[2].create_ostream(), 2000, 50));
+        reads.push_back(scheduler.download_range_to_stream_async(blob, targets[3].create_ostream(), 40000, 10));
+        pplx::when_all(reads.begin(), reads.end()).wait();
+
+        CHECK_EQUAL(100U, targets[0].collection().size());
+        CHECK_EQUAL(200U, targets[1].collection().size());
+        CHECK_EQUAL(50U, targets[2].collection().size());
+        CHECK_EQUAL(10U, targets[3].collection().size());
+
+        std::sort(ranges->begin(), ranges->end());
+        CHECK_EQUAL(2U, ranges->size());
+        CHECK(ranges->at(0) == U("bytes=0-2049"));
+        CHECK(ranges->at(1) == U("bytes=40000-40009"));
+
+        CHECK_THROW(scheduler.download_range_to_stream_async(blob, targets[0].create_ostream(), 0, 0), std::invalid_argument);
+    }
+
     TEST_FIXTURE(block_blob_test_base, blob_read_stream_maximum_execution_time)
     {
         std::chrono::seconds duration(10);
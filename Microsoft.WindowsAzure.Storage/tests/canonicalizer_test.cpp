@@ -0,0 +1,327 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="canonicalizer_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "was/auth.h"
+#include "wascore/constants.h"
+
+namespace
+{
+    const utility::string_t account_name(U("account"));
+    const utility::string_t date(U("Mon, 01 Jan 2024 00:00:00 GMT"));
+
+    utility::string_t to_lower(utility::string_t value)
+    {
+        for (auto iter = value.begin(); iter != value.end(); ++iter)
+        {
+            if ((*iter >= U('A')) && (*iter <= U('Z')))
+            {
+                *iter = static_cast<utility::char_t>(*iter - U('A') + U('a'));
+            }
+        }
+
+        return value;
+    }
+
+    // Builds the string to sign the way the canonicalizers did before they wrote UTF-8 directly,
+    // with the query parameters copied into a std::map and the result written to a string stream
+    class reference_canonicalizer
+    {
+    public:
+
+        reference_canonicalizer(const web::http::http_request& request)
+            : m_request(request)
+        {
+        }
+
+        utility::string_t blob_queue()
+        {
+            append(m_request.method());
+            append_header(web::http::header_names::content_encoding);
+            append_header(web::http::header_names::content_language);
+            append_header(web::http::header_names::content_length);
+            append_header(web::http::header_names::content_md5);
+            append_header(web::http::header_names::content_type);
+            append_date_header(false);
+            append_header(web::http::header_names::if_modified_since);
+            append_header(web::http::header_names::if_match);
+            append_header(web::http::header_names::if_none_match);
+            append_header(web::http::header_names::if_unmodified_since);
+            append_header(web::http::header_names::range);
+            append_x_ms_headers();
+            append_resource(false);
+            return m_result.str();
+        }
+
+        utility::string_t lite_blob_queue()
+        {
+            append(m_request.method());
+            append_header(web::http::header_names::content_md5);
+            append_header(web::http::header_names::content_type);
+            append_date_header(false);
+            append_x_ms_headers();
+            append_resource(true);
+            return m_result.str();
+        }
+
+        utility::string_t table()
+        {
+            append(m_request.method());
+            append_header(web::http::header_names::content_md5);
+            append_header(web::http::header_names::content_type);
+            append_date_header(true);
+            append_resource(true);
+            return m_result.str();
+        }
+
+        utility::string_t lite_table()
+        {
+            append_date_header(true);
+            append_resource(true);
+            return m_result.str();
+        }
+
+    private:
+
+        void append(const utility::string_t& value)
+        {
+            m_result << value << U("\n");
+        }
+
+        void append_resource(bool query_only_comp)
+        {
+            m_result << U("/") << account_name;
+
+            auto uri = m_request.request_uri();
+            auto& resource = uri.path();
+            if (resource.front() != U('/'))
+            {
+                m_result << U("/");
+            }
+
+            m_result << resource;
+
+            auto query_map = web::http::uri::split_query(web::http::uri::decode(uri.query()));
+            if (query_only_comp)
+            {
+                auto it = query_map.find(U("comp"));
+                if (it != query_map.end())
+                {
+                    m_result << U("?comp=") << it->second;
+                }
+            }
+            else
+            {
+                for (auto iter = query_map.cbegin(); iter != query_map.cend(); ++iter)
+                {
+                    m_result << U("\n") << to_lower(iter->first) << U(":") << iter->second;
+                }
+            }
+        }
+
+        void append_header(const utility::string_t& header_name)
+        {
+            utility::string_t value;
+            m_request.headers().match(header_name, value);
+            append(value);
+        }
+
+        void append_date_header(bool allow_x_ms_date)
+        {
+            utility::string_t value;
+            if (!m_request.headers().match(wa::storage::protocol::ms_header_date, value))
+            {
+                append_header(web::http::header_names::date);
+            }
+            else if (allow_x_ms_date)
+            {
+                append(value);
+            }
+            else
+            {
+                append(utility::string_t());
+            }
+        }
+
+        void append_x_ms_headers()
+        {
+            const utility::string_t prefix(U("x-ms-"));
+            auto& headers = m_request.headers();
+            for (auto iter = headers.begin(); iter != headers.end(); ++iter)
+            {
+                auto key = iter->first;
+                if ((key.size() > prefix.size()) && std::equal(prefix.cbegin(), prefix.cend(), key.cbegin()))
+                {
+                    m_result << to_lower(key) << U(":");
+                    append(iter->second);
+                }
+            }
+        }
+
+        const web::http::http_request& m_request;
+        utility::ostringstream_t m_result;
+    };
+
+    std::string canonicalize_utf8(const wa::storage::protocol::canonicalizer& canonicalizer, const web::http::http_request& request)
+    {
+        std::string result("left over from an earlier request");
+        canonicalizer.canonicalize_utf8(request, wa::storage::operation_context(), result);
+        return result;
+    }
+
+    // Checks that a canonicalizer gives the same string to sign as before, whether it is built as a whole,
+    // as UTF-8 or from a resource that was canonicalized once for several requests
+    void check_canonicalizer(const wa::storage::protocol::canonicalizer& canonicalizer, const web::http::http_request& request, const utility::string_t& expected)
+    {
+        CHECK_UTF8_EQUAL(expected, canonicalizer.canonicalize(request, wa::storage::operation_context()));
+
+        auto expected_utf8 = utility::conversions::to_utf8string(expected);
+        CHECK_EQUAL(expected_utf8, canonicalize_utf8(canonicalizer, request));
+
+        auto resource = canonicalizer.canonicalize_resource_utf8(request);
+        std::string result;
+        canonicalizer.canonicalize_utf8(request, wa::storage::operation_context(), resource, result);
+        CHECK_EQUAL(expected_utf8, result);
+    }
+
+    void check_parity(const web::http::http_request& request)
+    {
+        check_canonicalizer(wa::storage::protocol::shared_key_blob_queue_canonicalizer(account_name), request, reference_canonicalizer(request).blob_queue());
+        check_canonicalizer(wa::storage::protocol::shared_key_lite_blob_queue_canonicalizer(account_name), request, reference_canonicalizer(request).lite_blob_queue());
+        check_canonicalizer(wa::storage::protocol::shared_key_table_canonicalizer(account_name), request, reference_canonicalizer(request).table());
+        check_canonicalizer(wa::storage::protocol::shared_key_lite_table_canonicalizer(account_name), request, reference_canonicalizer(request).lite_table());
+    }
+
+    web::http::http_request create_request(const web::http::method& method, const utility::string_t& uri)
+    {
+        web::http::http_request request(method);
+        request.set_request_uri(web::http::uri(uri));
+        request.headers().add(wa::storage::protocol::ms_header_date, date);
+        request.headers().add(U("x-ms-version"), U("2012-02-12"));
+        return request;
+    }
+}
+
+SUITE(Core)
+{
+    TEST(canonicalizer_strings_to_sign)
+    {
+        auto block = create_request(web::http::methods::PUT, U("https://account.blob.core.windows.net/container/blob?comp=block&blockid=AAAA&timeout=30"));
+        block.headers().add(web::http::header_names::content_length, U("11"));
+        block.headers().add(web::http::header_names::content_type, U("text/plain"));
+        block.headers().add(U("x-ms-meta-Name"), U("value"));
+
+        CHECK_EQUAL(std::string("PUT\n\n\n11\n\ntext/plain\n\n\n\n\n\n\n"
+            "x-ms-date:Mon, 01 Jan 2024 00:00:00 GMT\nx-ms-meta-name:value\nx-ms-version:2012-02-12\n"
+            "/account/container/blob\nblockid:AAAA\ncomp:block\ntimeout:30"),
+            canonicalize_utf8(wa::storage::protocol::shared_key_blob_queue_canonicalizer(account_name), block));
+
+        CHECK_EQUAL(std::string("PUT\n\ntext/plain\n\n"
+            "x-ms-date:Mon, 01 Jan 2024 00:00:00 GMT\nx-ms-meta-name:value\nx-ms-version:2012-02-12\n"
+            "/account/container/blob?comp=block"),
+            canonicalize_utf8(wa::storage::protocol::shared_key_lite_blob_queue_canonicalizer(account_name), block));
+
+        auto messages = create_request(web::http::methods::GET, U("https://account.queue.core.windows.net/queue/messages?numofmessages=32&peekonly=true"));
+        CHECK_EQUAL(std::string("GET\n\n\n\n\n\n\n\n\n\n\n\n"
+            "x-ms-date:Mon, 01 Jan 2024 00:00:00 GMT\nx-ms-version:2012-02-12\n"
+            "/account/queue/messages\nnumofmessages:32\npeekonly:true"),
+            canonicalize_utf8(wa::storage::protocol::shared_key_blob_queue_canonicalizer(account_name), messages));
+
+        auto query = create_request(web::http::methods::GET, U("https://account.table.core.windows.net/people?$top=5&timeout=30"));
+        query.headers().add(web::http::header_names::content_type, U("application/json"));
+        CHECK_EQUAL(std::string("GET\n\napplication/json\nMon, 01 Jan 2024 00:00:00 GMT\n/account/people"),
+            canonicalize_utf8(wa::storage::protocol::shared_key_table_canonicalizer(account_name), query));
+        CHECK_EQUAL(std::string("Mon, 01 Jan 2024 00:00:00 GMT\n/account/people"),
+            canonicalize_utf8(wa::storage::protocol::shared_key_lite_table_canonicalizer(account_name), query));
+
+        auto acl = create_request(web::http::methods::GET, U("https://account.table.core.windows.net/people?comp=acl"));
+        CHECK_EQUAL(std::string("Mon, 01 Jan 2024 00:00:00 GMT\n/account/people?comp=acl"),
+            canonicalize_utf8(wa::storage::protocol::shared_key_lite_table_canonicalizer(account_name), acl));
+
+        // Without an x-ms-date header, the Date header is signed in its place
+        web::http::http_request dated(web::http::methods::GET);
+        dated.set_request_uri(web::http::uri(U("https://account.table.core.windows.net/people")));
+        dated.headers().add(web::http::header_names::date, date);
+        CHECK_EQUAL(std::string("GET\n\n\nMon, 01 Jan 2024 00:00:00 GMT\n/account/people"),
+            canonicalize_utf8(wa::storage::protocol::shared_key_table_canonicalizer(account_name), dated));
+
+        check_parity(block);
+        check_parity(messages);
+        check_parity(query);
+        check_parity(acl);
+        check_parity(dated);
+    }
+
+    TEST(canonicalizer_headers)
+    {
+        // A header that is added twice is signed once with both values, under its name in lowercase
+        auto request = create_request(web::http::methods::PUT, U("https://account.blob.core.windows.net/container/blob"));
+        request.headers().add(U("x-ms-meta-a"), U("1"));
+        request.headers().add(U("x-ms-meta-a"), U("2"));
+        request.headers().add(U("x-ms-meta-B"), U("3"));
+        check_parity(request);
+
+        // The names of headers are matched without regard to case, and their values are signed as they are, spaces and all
+        request.headers().add(U("x-ms-Meta-Mixed"), U("  two  spaces "));
+        request.headers().add(U("content-type"), U(" text/plain "));
+        request.headers().add(U("If-Match"), U("\"0x8D0\""));
+        request.headers().add(U("RANGE"), U("bytes=0-511"));
+        check_parity(request);
+
+        auto canonicalized = canonicalize_utf8(wa::storage::protocol::shared_key_blob_queue_canonicalizer(account_name), request);
+        CHECK(canonicalized.find("\n text/plain \n") != std::string::npos);
+        CHECK(canonicalized.find("\nx-ms-meta-mixed:  two  spaces \n") != std::string::npos);
+        CHECK(canonicalized.find("\n\"0x8D0\"\n\n\nbytes=0-511\n") != std::string::npos);
+        CHECK(canonicalized.find("\nx-ms-meta-b:3\n") != std::string::npos);
+    }
+
+    TEST(canonicalizer_query_parameters)
+    {
+        // Parameters are sorted by name as they were given and then lowercased, a repeated name keeps its last value,
+        // a parameter without a value is left out, and the values are decoded
+        auto request = create_request(web::http::methods::GET, U("https://account.blob.core.windows.net/container?restype=container&comp=list&include=snapshots&include=metadata&prefix=a%20b&Marker=m&flag&maxresults=10"));
+        check_parity(request);
+
+        CHECK_EQUAL(std::string("/account/container\nmarker:m\ncomp:list\ninclude:metadata\nmaxresults:10\nprefix:a b\nrestype:container"),
+            wa::storage::protocol::shared_key_blob_queue_canonicalizer(account_name).canonicalize_resource_utf8(request));
+        CHECK_EQUAL(std::string("/account/container?comp=list"),
+            wa::storage::protocol::shared_key_lite_blob_queue_canonicalizer(account_name).canonicalize_resource_utf8(request));
+
+        // A repeated comp parameter keeps its last value for the Shared Key Lite schemes too
+        auto repeated = create_request(web::http::methods::GET, U("https://account.blob.core.windows.net/container?comp=metadata&restype=container&comp=list"));
+        check_parity(repeated);
+    }
+
+    TEST(canonicalizer_non_ascii)
+    {
+        // The path is signed as it was encoded in the URI, while the decoded query and the headers are signed as UTF-8
+        web::http::uri_builder builder(U("https://account.blob.core.windows.net"));
+        builder.set_path(U("/container/bl\u00F6b \u20AC"), true);
+        builder.append_query(U("comp"), U("metadata"));
+        builder.append_query(U("prefix"), U("\u00E9\u20AC"), true);
+        auto request = create_request(web::http::methods::PUT, builder.to_string());
+        request.headers().add(U("x-ms-meta-name"), U("caf\u00E9"));
+        check_parity(request);
+
+        auto canonicalized = canonicalize_utf8(wa::storage::protocol::shared_key_blob_queue_canonicalizer(account_name), request);
+        CHECK(canonicalized.find("\nx-ms-meta-name:caf\xC3\xA9\n") != std::string::npos);
+        CHECK(canonicalized.find("\nprefix:\xC3\xA9\xE2\x82\xAC") != std::string::npos);
+        CHECK(canonicalized.find("/account" + utility::conversions::to_utf8string(web::http::uri(builder.to_string()).path())) != std::string::npos);
+    }
+}
@@ -18,6 +18,8 @@
 #include "stdafx.h"
 #include "blob_test_base.h"
 #include "check_macros.h"
+#include "was/analytics.h"
+#include "wascore/datetime_codec.h"
 
 #pragma region Fixture
 
@@ -139,6 +141,29 @@ SUITE(Blob)
         CHECK(containers.empty());
     }
 
+    TEST_FIXTURE(blob_service_test_base_with_objects_to_delete, list_containers_all_segments)
+    {
+        auto prefix = get_random_container_name();
+
+        for (int i = 0; i < 3; i++)
+        {
+            auto index = utility::conversions::print_string(i);
+            auto container = m_client.get_container_reference(prefix + index);
+            m_containers_to_delete.push_back(container);
+            container.create(wa::storage::blob_container_public_access_type::off, wa::storage::blob_request_options(), m_context);
+        }
+
+        auto segmented = list_all_containers(prefix, wa::storage::container_listing_includes(), 0, wa::storage::blob_request_options());
+        auto listing = m_client.list_containers(prefix, wa::storage::container_listing_includes(), wa::storage::blob_request_options(), m_context);
+
+        CHECK_EQUAL(3, listing.size());
+        CHECK_EQUAL(segmented.size(), listing.size());
+        for (size_t i = 0; i < listing.size() && i < segmented.size(); ++i)
+        {
+            CHECK_UTF8_EQUAL(segmented[i].name(), listing[i].name());
+        }
+    }
+
     TEST_FIXTURE(blob_service_test_base_with_objects_to_delete, list_blobs_from_client_root)
     {
         auto root_container = m_client.get_root_container_reference();
@@ -229,4 +254,53 @@ SUITE(Blob)
         client.set_authentication_scheme(wa::storage::authentication_scheme::shared_key_lite);
         client.list_containers_segmented(utility::string_t(), wa::storage::container_listing_includes(), 1, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), m_context);
     }
+
+    TEST(analytics_log_reader)
+    {
+        std::string log =
+            "1.0;2014-05-01T13:00:00.1234567Z;GetBlob;Success;200;12;10;authenticated;account;account;blob;"
+            "\"https://account.blob.core.windows.net/container/blob?timeout=90\";\"/account/container/blob\";a84aa705-8a85-48c5-b064-b43bd22979c1;0;"
+            "10.0.0.1:1234;2014-02-14;455;0;274;1024;0;;\"abc==\";\"0x8D1\";Tuesday, 29-Apr-14 10:00:00 GMT;;\"Client v1.0 (Windows; x64)\";;\"id1\"\n"
+            "\n"
+            "1.0;2014-05-01T13:00:01.0000000Z;PutBlob;ServerTimeoutError;500;30000;29990;anonymous\r\n"
+            "1.0;2014-05-01T13:00:02.0000000Z;GetBlob;Success;200;1;1";
+
+        std::vector<utility::string_t> operations;
+        std::vector<int> status_codes;
+        size_t field_counts[3] = { 0, 0, 0 };
+        auto stream = concurrency::streams::bytestream::open_istream(log);
+        auto count = wa::storage::read_analytics_log_async(stream, [&] (const wa::storage::analytics_log_entry& entry)
+        {
+            if (operations.empty())
+            {
+                CHECK(entry.version().equals("1.0"));
+                CHECK(entry.request_start_time() == wa::storage::core::parse_iso8601_datetime(U("2014-05-01T13:00:00.1234567Z")));
+                CHECK_EQUAL(std::chrono::milliseconds(12).count(), entry.end_to_end_latency().count());
+                CHECK(entry.request_url().equals("https://account.blob.core.windows.net/container/blob?timeout=90"));
+                CHECK_UTF8_EQUAL(U("a84aa705-8a85-48c5-b064-b43bd22979c1"), entry.request_id().to_string());
+                CHECK_EQUAL(1024U, entry.response_packet_size());
+                CHECK(entry.request_md5().empty());
+                CHECK(entry.user_agent().equals("Client v1.0 (Windows; x64)"));
+                CHECK(entry.referrer().empty());
+                CHECK(entry.client_request_id().equals("id1"));
+            }
+
+            CHECK(operations.size() < 3);
+            field_counts[operations.size()] = entry.field_count();
+            operations.push_back(entry.operation_type().to_string());
+            status_codes.push_back(entry.http_status_code());
+        }).get();
+
+        CHECK_EQUAL(3U, count);
+        CHECK_EQUAL(30U, field_counts[0]);
+        CHECK_EQUAL(8U, field_counts[1]);
+        CHECK_EQUAL(7U, field_counts[2]);
+        CHECK_UTF8_EQUAL(U("PutBlob"), operations[1]);
+        CHECK_EQUAL(500, status_codes[1]);
+        CHECK_EQUAL(200, status_codes[2]);
+
+        // An unterminated quoted field is not a valid entry
+        auto malformed = concurrency::streams::bytestream::open_istream(std::string("1.0;\"unterminated;GetBlob\n"));
+        CHECK_THROW(wa::storage::read_analytics_log_async(malformed, [] (const wa::storage::analytics_log_entry&) {}).get(), std::runtime_error);
+    }
 }
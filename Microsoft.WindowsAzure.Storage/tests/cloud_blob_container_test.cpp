@@ -19,6 +19,12 @@
 #include "blob_test_base.h"
 #include "check_macros.h"
 
+#include <atomic>
+#include <mutex>
+#include <set>
+
+#include "was/in_memory_transport.h"
+
 #pragma region Fixture
 
 void container_test_base::check_public_access(wa::storage::blob_container_public_access_type access)
@@ -93,6 +99,20 @@ SUITE(Blob)
         CHECK_UTF8_EQUAL(m_container.uri().secondary_uri().to_string(), directory.container().uri().secondary_uri().to_string());
     }
 
+    TEST_FIXTURE(container_test_base, container_get_reference_lazy_uri)
+    {
+        // A copy made before the URI is first used shares it, along with the properties
+        auto blob = m_container.get_block_blob_reference(U("dir/blob1"));
+        auto copy = blob;
+        CHECK_UTF8_EQUAL(m_container.uri().primary_uri().to_string() + U("/dir/blob1"), blob.uri().primary_uri().to_string());
+        CHECK(&blob.uri() == &copy.uri());
+
+        blob.properties().set_content_type(U("text/plain"));
+        CHECK_UTF8_EQUAL(U("text/plain"), copy.properties().content_type());
+        CHECK(copy.copy_state().status() == wa::storage::copy_status::invalid);
+        CHECK(copy.metadata().empty());
+    }
+
     TEST_FIXTURE(container_test_base, container_create_delete)
     {
         CHECK(!m_container.exists(wa::storage::blob_request_options(), m_context));
@@ -248,6 +268,470 @@ SUITE(Blob)
         }
     }
 
+    TEST_FIXTURE(container_test_base, container_list_blobs_streaming)
+    {
+        m_container.create(wa::storage::blob_container_public_access_type::off, wa::storage::blob_request_options(), m_context);
+        std::set<utility::string_t> names;
+
+        for (int i = 0; i < 5; i++)
+        {
+            auto blob = m_container.get_block_blob_reference(U("dir") + utility::conversions::print_string(i % 2) + U("/blob") + utility::conversions::print_string(i));
+            blob.upload_text(utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+            names.insert(blob.name());
+        }
+
+        std::vector<utility::string_t> listed;
+        m_container.list_blobs(utility::string_t(), true, wa::storage::blob_listing_includes(), 2, [&listed] (const wa::storage::list_blob_item& item) -> bool
+        {
+            CHECK(item.is_blob());
+            listed.push_back(item.as_blob().name());
+            return true;
+        }, wa::storage::blob_request_options(), m_context);
+
+        CHECK_EQUAL(names.size(), listed.size());
+        CHECK(std::set<utility::string_t>(listed.begin(), listed.end()) == names);
+
+        size_t directories = 0;
+        m_container.list_blobs(utility::string_t(), false, wa::storage::blob_listing_includes(), 1, [&directories] (const wa::storage::list_blob_item& item) -> bool
+        {
+            CHECK(!item.is_blob());
+            ++directories;
+            return true;
+        }, wa::storage::blob_request_options(), m_context);
+
+        CHECK_EQUAL(2, directories);
+
+        size_t seen = 0;
+        m_container.list_blobs(utility::string_t(), true, wa::storage::blob_listing_includes(), 2, [&seen] (const wa::storage::list_blob_item&) -> bool
+        {
+            return ++seen < 3;
+        }, wa::storage::blob_request_options(), m_context);
+
+        CHECK_EQUAL(3, seen);
+    }
+
+    TEST_FIXTURE(container_test_base, container_list_blobs_parallel)
+    {
+        m_container.create(wa::storage::blob_container_public_access_type::off, wa::storage::blob_request_options(), m_context);
+        std::set<utility::string_t> names;
+
+        for (int i = 0; i < 9; i++)
+        {
+            auto name = i < 3 ? U("root") + utility::conversions::print_string(i) : U("shard") + utility::conversions::print_string(i % 3) + U("/blob") + utility::conversions::print_string(i);
+            auto blob = m_container.get_block_blob_reference(name);
+            blob.upload_text(utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+            names.insert(blob.name());
+        }
+
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(3);
+
+        std::set<utility::string_t> discovered;
+        m_container.list_blobs_parallel_async(std::vector<utility::string_t>(), wa::storage::blob_listing_includes(), 1, [&discovered] (const wa::storage::list_blob_item& item) -> bool
+        {
+            CHECK(item.is_blob());
+            CHECK(discovered.insert(item.as_blob().name()).second);
+            return true;
+        }, options, m_context).wait();
+
+        CHECK(discovered == names);
+
+        std::vector<utility::string_t> prefixes;
+        prefixes.push_back(U("shard0/"));
+        prefixes.push_back(U("shard1/"));
+        prefixes.push_back(U("shard2/"));
+
+        std::set<utility::string_t> sharded;
+        m_container.list_blobs_parallel_async(prefixes, wa::storage::blob_listing_includes(), 1, [&sharded] (const wa::storage::list_blob_item& item) -> bool
+        {
+            CHECK(sharded.insert(item.as_blob().name()).second);
+            return true;
+        }, options, m_context).wait();
+
+        CHECK_EQUAL(6, sharded.size());
+
+        size_t seen = 0;
+        m_container.list_blobs_parallel_async(prefixes, wa::storage::blob_listing_includes(), 1, [&seen] (const wa::storage::list_blob_item&) -> bool
+        {
+            return ++seen < 2;
+        }, options, m_context).wait();
+
+        CHECK_EQUAL(2, seen);
+    }
+
+    TEST_FIXTURE(container_test_base, container_split_listing)
+    {
+        m_container.create(wa::storage::blob_container_public_access_type::off, wa::storage::blob_request_options(), m_context);
+        std::set<utility::string_t> names;
+
+        for (int i = 0; i < 9; i++)
+        {
+            auto name = i < 3 ? U("root") + utility::conversions::print_string(i) : U("shard") + utility::conversions::print_string(i % 3) + U("/blob") + utility::conversions::print_string(i);
+            auto blob = m_container.get_block_blob_reference(name);
+            blob.upload_text(utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+            names.insert(blob.name());
+        }
+
+        auto units = m_container.split_listing(utility::string_t(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(4U, units.size());
+        CHECK(!units[0].use_flat_blob_listing());
+
+        // Each unit is listed two blobs at a time, and saved and read back after every segment
+        std::set<utility::string_t> listed;
+        for (auto iter = units.cbegin(); iter != units.cend(); ++iter)
+        {
+            auto unit = wa::storage::blob_listing_unit::parse(iter->to_string());
+            CHECK(unit.prefix() == iter->prefix());
+            CHECK(unit.use_flat_blob_listing() == iter->use_flat_blob_listing());
+
+            while (!unit.is_complete())
+            {
+                auto segment = m_container.list_blobs_segmented(unit.prefix(), unit.use_flat_blob_listing(), wa::storage::blob_listing_includes(), 2, unit.continuation_token(), wa::storage::blob_request_options(), m_context);
+                for (auto blob = segment.blobs().cbegin(); blob != segment.blobs().cend(); ++blob)
+                {
+                    CHECK(listed.insert(blob->name()).second);
+                }
+
+                unit.advance(segment.continuation_token());
+                unit = wa::storage::blob_listing_unit::parse(unit.to_string());
+            }
+        }
+
+        CHECK(listed == names);
+        CHECK_THROW(wa::storage::blob_listing_unit::parse(U("version=1\nflat=yes\n")), std::invalid_argument);
+    }
+
+    TEST_FIXTURE(container_test_base, container_delete_blobs)
+    {
+        m_container.create(wa::storage::blob_container_public_access_type::off, wa::storage::blob_request_options(), m_context);
+
+        for (int i = 0; i < 6; i++)
+        {
+            auto name = (i < 5 ? U("old/blob") : U("new/blob")) + utility::conversions::print_string(i);
+            m_container.get_block_blob_reference(name).upload_text(utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        }
+
+        // A leased blob cannot be deleted without the lease ID
+        auto leased_blob = m_container.get_block_blob_reference(U("old/blob0"));
+        leased_blob.acquire_lease(wa::storage::lease_time(), utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(2);
+
+        auto failures = m_container.delete_blobs(U("old/"), wa::storage::delete_snapshots_option::none, options, m_context);
+        CHECK_EQUAL(1, failures.size());
+        CHECK(failures[0].name() == leased_blob.name());
+        CHECK_THROW(std::rethrow_exception(failures[0].error()), wa::storage::storage_exception);
+
+        std::vector<utility::string_t> remaining;
+        m_container.list_blobs_async(utility::string_t(), true, wa::storage::blob_listing_includes(), 0, [&remaining] (const wa::storage::list_blob_item& item) -> bool
+        {
+            remaining.push_back(item.as_blob().name());
+            return true;
+        }, wa::storage::blob_request_options(), m_context).wait();
+
+        CHECK_EQUAL(2, remaining.size());
+        leased_blob.break_lease(wa::storage::lease_break_period(std::chrono::seconds(0)), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+    }
+
+    TEST(container_list_blob_inventory)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_responder([] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults ServiceEndpoint=\"https://account.blob.core.windows.net/\" ContainerName=\"container\"><Blobs>");
+            if (query[U("marker")].empty())
+            {
+                body.append("<Blob><Name>blob0</Name><Properties><Last-Modified>Wed, 09 Sep 2009 09:20:02 GMT</Last-Modified><Etag>0x8CBFF45D8A29A19</Etag>");
+                body.append("<Content-Length>1048576</Content-Length><Content-MD5>sQqNsWTgdUEFt6mb5y4/5Q==</Content-MD5><BlobType>BlockBlob</BlobType></Properties></Blob>");
+                body.append("<Blob><Name>blob1</Name><Properties><Etag>custom</Etag><Content-Length>512</Content-Length><BlobType>PageBlob</BlobType></Properties></Blob>");
+                body.append("</Blobs><NextMarker>page2</NextMarker></EnumerationResults>");
+            }
+            else
+            {
+                body.append("<Blob><Name>caf\xC3\xA9</Name><Properties><Etag>0x8CBFF45D8A29A1A</Etag><Content-Length>0</Content-Length><BlobType>BlockBlob</BlobType></Properties>");
+                body.append("<Metadata><Owner>user</Owner></Metadata></Blob></Blobs><NextMarker /></EnumerationResults>");
+            }
+
+            web::http::http_response response(web::http::status_codes::OK);
+            response.set_body(body, U("application/xml"));
+            return response;
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto container = client.get_container_reference(U("container"));
+
+        auto segment = container.list_blob_inventory_segmented(utility::string_t(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(2U, segment.size());
+        CHECK(!segment.continuation_token().empty());
+
+        auto inventory = container.list_blob_inventory(utility::string_t(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(3U, inventory.size());
+        CHECK(inventory.continuation_token().empty());
+
+        CHECK(inventory.name(0) == U("blob0"));
+        CHECK_EQUAL(1048576U, inventory.length(0));
+        CHECK(inventory.last_modified(0) == utility::datetime::from_string(U("Wed, 09 Sep 2009 09:20:02 GMT")));
+        CHECK(inventory.etag(0) == U("\"0x8CBFF45D8A29A19\""));
+        CHECK(inventory.content_md5(0) == U("sQqNsWTgdUEFt6mb5y4/5Q=="));
+        CHECK(inventory.type(0) == wa::storage::blob_type::block_blob);
+
+        CHECK(inventory.etag(1) == U("\"custom\""));
+        CHECK(inventory.content_md5(1).empty());
+        CHECK(!inventory.last_modified(1).is_initialized());
+        CHECK(inventory.type(1) == wa::storage::blob_type::page_blob);
+
+        CHECK(inventory.name_utf8(2) == "caf\xC3\xA9");
+        CHECK(inventory.etag(2) == U("\"0x8CBFF45D8A29A1A\""));
+        CHECK_EQUAL(0U, inventory.length(2));
+    }
+
+    TEST(container_list_blobs_compressed)
+    {
+        // A listing of three blobs, gzip encoded
+        const unsigned char compressed_listing[] =
+        {
+            0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xBD, 0x92, 0x41, 0x4E, 0xC3, 0x30,
+            0x10, 0x45, 0xAF, 0x12, 0x79, 0xDF, 0x38, 0x89, 0xA8, 0x14, 0x90, 0xE3, 0xAA, 0x2D, 0xE9, 0x0A,
+            0x2A, 0x04, 0x5C, 0xC0, 0x75, 0x86, 0xD4, 0x6A, 0x32, 0x8E, 0xEC, 0x49, 0x1B, 0x6E, 0x8F, 0x93,
+            0x02, 0x42, 0x65, 0xD3, 0x0D, 0xAC, 0x3C, 0xF3, 0xE7, 0xDB, 0xFF, 0x49, 0x1E, 0xB1, 0x18, 0xDA,
+            0x26, 0x3A, 0x82, 0xF3, 0xC6, 0x62, 0xC1, 0xD2, 0x38, 0x61, 0x11, 0xA0, 0xB6, 0x95, 0xC1, 0xBA,
+            0x60, 0x3D, 0xBD, 0xCD, 0x72, 0xB6, 0x90, 0xA2, 0xC4, 0xBE, 0x05, 0xA7, 0x28, 0x98, 0x9E, 0xC1,
+            0xF7, 0x0D, 0xF9, 0xE8, 0x05, 0xDC, 0xD1, 0x68, 0x28, 0xB1, 0xEA, 0xAC, 0x41, 0x2A, 0xD8, 0x9E,
+            0xA8, 0xF3, 0x77, 0x9C, 0x2B, 0xAD, 0x6D, 0x8F, 0x14, 0xEF, 0x1A, 0xBB, 0x8B, 0xB5, 0x75, 0x10,
+            0x9F, 0x0C, 0x56, 0xF6, 0xE4, 0x63, 0x04, 0xE2, 0x2C, 0x5A, 0x5B, 0x24, 0x65, 0x10, 0xDC, 0x56,
+            0xB5, 0x50, 0x30, 0xFD, 0xD5, 0x32, 0x29, 0x56, 0xE1, 0x8A, 0x3F, 0x1F, 0x52, 0x8C, 0x63, 0x39,
+            0x3E, 0x92, 0x08, 0x3E, 0xD5, 0xE2, 0xC9, 0xD9, 0x0E, 0x1C, 0x19, 0x08, 0x9E, 0x92, 0x54, 0x2D,
+            0x93, 0x21, 0x5F, 0xAF, 0x36, 0x9B, 0x9B, 0xF9, 0x7D, 0xBE, 0xCC, 0x6E, 0x97, 0x69, 0x70, 0x4E,
+            0xBA, 0x18, 0x33, 0x00, 0x69, 0xF6, 0x00, 0x58, 0xD3, 0x5E, 0xCE, 0xD3, 0x4C, 0xF0, 0x0B, 0x6D,
+            0x4A, 0x79, 0x7D, 0xEF, 0x40, 0x86, 0x42, 0x1F, 0xC6, 0x4E, 0xF0, 0x6F, 0x4D, 0xF0, 0x9F, 0x61,
+            0xFC, 0x4C, 0x74, 0xC1, 0x95, 0x5E, 0xCD, 0x95, 0xFE, 0x2B, 0x57, 0x76, 0x35, 0x57, 0xF6, 0xB7,
+            0x5C, 0xFC, 0xF3, 0x3F, 0xB7, 0x30, 0xD0, 0xA3, 0x72, 0x07, 0x70, 0x11, 0x0F, 0xEA, 0xEF, 0x65,
+            0x92, 0x1F, 0xDC, 0x92, 0x6A, 0x71, 0x87, 0x02, 0x00, 0x00
+        };
+
+        std::vector<unsigned char> compressed_body(compressed_listing, compressed_listing + sizeof(compressed_listing));
+        auto accept_encoding = std::make_shared<utility::string_t>();
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_responder([compressed_body, accept_encoding] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            auto header = request.headers().find(web::http::header_names::accept_encoding);
+            *accept_encoding = header != request.headers().end() ? header->second : utility::string_t();
+
+            web::http::http_response response(web::http::status_codes::OK);
+            if (accept_encoding->empty())
+            {
+                response.set_body(std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults ContainerName=\"container\"><Blobs /><NextMarker /></EnumerationResults>"), U("application/xml"));
+            }
+            else
+            {
+                response.set_body(compressed_body);
+                response.headers().set_content_type(U("application/xml"));
+                response.headers().add(web::http::header_names::content_encoding, U("gzip"));
+            }
+
+            return response;
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto container = client.get_container_reference(U("container"));
+
+        // Responses are not compressed unless the options ask for it
+        auto segment = container.list_blobs_segmented(utility::string_t(), true, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK(accept_encoding->empty());
+        CHECK(segment.blobs().empty());
+
+        wa::storage::blob_request_options compressed_options;
+        compressed_options.set_accept_compressed_responses(true);
+        segment = container.list_blobs_segmented(utility::string_t(), true, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), compressed_options, wa::storage::operation_context());
+        CHECK(*accept_encoding == U("gzip"));
+        CHECK_EQUAL(3U, segment.blobs().size());
+        CHECK(segment.blobs()[0].name() == U("blob0"));
+        CHECK(segment.blobs()[2].name() == U("blob2"));
+        CHECK_EQUAL(512U, segment.blobs()[2].properties().size());
+        CHECK(segment.continuation_token().empty());
+    }
+
+    TEST(container_blob_inventory_snapshot)
+    {
+        wa::storage::blob_inventory snapshot_inventory;
+        snapshot_inventory._add_blob(U("unchanged"), 1, utility::datetime(), U("0x8CBFF45D8A29A19"), wa::storage::blob_type::block_blob, U("sQqNsWTgdUEFt6mb5y4/5Q=="));
+        snapshot_inventory._add_blob(U("changed"), 2, utility::datetime(), U("0x8CBFF45D8A29A1A"), wa::storage::blob_type::page_blob, utility::string_t());
+        snapshot_inventory._add_blob(U("removed"), 3, utility::datetime(), U("custom"), wa::storage::blob_type::block_blob, utility::string_t());
+
+        // The snapshot is sorted by name when it is written
+        const utility::string_t path(U("blob_inventory_snapshot.bin"));
+        wa::storage::blob_inventory_snapshot::write(path, snapshot_inventory);
+        auto snapshot = wa::storage::blob_inventory_snapshot::open(path);
+        CHECK_EQUAL(3U, snapshot.size());
+        CHECK(snapshot.name(0) == U("changed"));
+        CHECK(snapshot.name(1) == U("removed"));
+        CHECK(snapshot.name(2) == U("unchanged"));
+        CHECK(snapshot.etag(1) == U("\"custom\""));
+        CHECK(snapshot.etag(2) == U("\"0x8CBFF45D8A29A19\""));
+        CHECK(snapshot.content_md5(2) == U("sQqNsWTgdUEFt6mb5y4/5Q=="));
+        CHECK(snapshot.type(0) == wa::storage::blob_type::page_blob);
+
+        size_t index;
+        CHECK(snapshot.find(U("unchanged"), index));
+        CHECK_EQUAL(2U, index);
+        CHECK(!snapshot.find(U("added"), index));
+
+        wa::storage::blob_inventory current;
+        current._add_blob(U("added"), 4, utility::datetime(), U("0x8CBFF45D8A29A1B"), wa::storage::blob_type::block_blob, utility::string_t());
+        current._add_blob(U("changed"), 5, utility::datetime(), U("0x8CBFF45D8A29A1C"), wa::storage::blob_type::page_blob, utility::string_t());
+        current._add_blob(U("unchanged"), 1, utility::datetime(), U("0x8CBFF45D8A29A19"), wa::storage::blob_type::block_blob, U("sQqNsWTgdUEFt6mb5y4/5Q=="));
+
+        auto diff = snapshot.diff(current);
+        CHECK_EQUAL(1U, diff.added().size());
+        CHECK(current.name(diff.added()[0]) == U("added"));
+        CHECK_EQUAL(1U, diff.changed().size());
+        CHECK(current.name(diff.changed()[0]) == U("changed"));
+        CHECK_EQUAL(1U, diff.removed().size());
+        CHECK(snapshot.name(diff.removed()[0]) == U("removed"));
+    }
+
+    TEST(container_list_blobs_in_ranges)
+    {
+        // The transport lists two blobs per page, from the start of the prefix or from the blob that a marker names
+        auto names = std::make_shared<std::vector<std::string>>();
+        names->push_back("log/2019");
+        names->push_back("log/2020");
+        names->push_back("log/2021");
+        names->push_back("log/2022");
+        names->push_back("log/2023");
+        names->push_back("other");
+
+        auto reject_markers = std::make_shared<std::atomic<bool>>(false);
+        auto malformed_markers = std::make_shared<std::atomic<bool>>(false);
+        auto request_count = std::make_shared<std::atomic<int>>(0);
+        auto prefixes = std::make_shared<std::vector<utility::string_t>>();
+        auto prefixes_lock = std::make_shared<std::mutex>();
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_responder([names, reject_markers, malformed_markers, request_count, prefixes, prefixes_lock] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            ++*request_count;
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            utility::string_t marker = web::http::uri::decode(query[U("marker")]);
+            std::string prefix = utility::conversions::to_utf8string(web::http::uri::decode(query[U("prefix")]));
+            {
+                std::lock_guard<std::mutex> guard(*prefixes_lock);
+                prefixes->push_back(web::http::uri::decode(query[U("prefix")]));
+            }
+
+            size_t start = 0;
+            if (marker.compare(0, 2, U("2!")) == 0)
+            {
+                if (*reject_markers)
+                {
+                    web::http::http_response response(web::http::status_codes::BadRequest);
+                    response.set_body(std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?><Error><Code>OutOfRangeInput</Code><Message>One of the request inputs is out of range.</Message></Error>"), U("application/xml"));
+                    return response;
+                }
+
+                // The marker holds the Base64 encoding of "<length>!<name>!<length>!<time>!", padded with '-'
+                utility::string_t encoded = marker.substr(marker.find(U('!'), 2) + 1);
+                std::replace(encoded.begin(), encoded.end(), U('-'), U('='));
+                std::vector<unsigned char> decoded = utility::conversions::from_base64(encoded);
+                std::string position(decoded.begin(), decoded.end());
+                std::string name = position.substr(7, position.find('!', 7) - 7);
+                if ((position.compare(0, 7, "00000" + std::to_string(name.size()) + "!") != 0) || (position.substr(8 + name.size()) != "000028!9999-12-31T23:59:59.9999999Z!"))
+                {
+                    *malformed_markers = true;
+                }
+
+                start = std::lower_bound(names->begin(), names->end(), name) - names->begin();
+            }
+            else if (!marker.empty())
+            {
+                start = utility::conversions::scan_string<size_t>(marker);
+            }
+
+            std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults ContainerName=\"container\"><Blobs>");
+            size_t index = start;
+            size_t listed = 0;
+            for (; (index < names->size()) && (listed < 2); ++index)
+            {
+                if ((*names)[index].compare(0, prefix.size(), prefix) == 0)
+                {
+                    body.append("<Blob><Name>").append((*names)[index]).append("</Name><Properties><Content-Length>0</Content-Length><BlobType>BlockBlob</BlobType></Properties></Blob>");
+                    ++listed;
+                }
+            }
+
+            body.append("</Blobs><NextMarker>");
+            if (index < names->size())
+            {
+                body.append(std::to_string(index));
+            }
+
+            body.append("</NextMarker></EnumerationResults>");
+            web::http::http_response response(web::http::status_codes::OK);
+            response.set_body(body, U("application/xml"));
+            return response;
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto container = client.get_container_reference(U("container"));
+
+        // The listing seeks to the start name within the shared prefix and stops at the first blob past the end name
+        std::vector<utility::string_t> listed;
+        auto list_handler = [&listed] (const wa::storage::list_blob_item& item) -> bool
+        {
+            listed.push_back(item.as_blob().name());
+            return true;
+        };
+
+        container.list_blobs_in_range(U("log/2020"), U("log/2022"), list_handler);
+        CHECK_EQUAL(2U, listed.size());
+        CHECK(listed[0] == U("log/2020"));
+        CHECK(listed[1] == U("log/2021"));
+        CHECK_EQUAL(2, request_count->load());
+        CHECK(prefixes->back() == U("log/202"));
+
+        // A marker the service does not accept falls back to listing the shared prefix from its start
+        listed.clear();
+        *request_count = 0;
+        *reject_markers = true;
+        container.list_blobs_in_range(U("log/2020"), U("log/2022"), list_handler);
+        CHECK_EQUAL(2U, listed.size());
+        CHECK(listed[0] == U("log/2020"));
+        CHECK(listed[1] == U("log/2021"));
+        CHECK_EQUAL(3, request_count->load());
+        *reject_markers = false;
+
+        // Several ranges are listed concurrently, and a range with an open end lists the rest of the container
+        std::vector<std::pair<utility::string_t, utility::string_t>> ranges;
+        ranges.push_back(std::make_pair(utility::string_t(U("log/2019")), utility::string_t(U("log/2020"))));
+        ranges.push_back(std::make_pair(utility::string_t(U("log/2022")), utility::string_t()));
+
+        wa::storage::blob_request_options parallel_options;
+        parallel_options.set_parallelism_factor(2);
+        std::set<utility::string_t> range_names;
+        container.list_blobs_in_ranges_async(ranges, wa::storage::blob_listing_includes(), 0, [&range_names] (const wa::storage::list_blob_item& item) -> bool
+        {
+            range_names.insert(item.as_blob().name());
+            return true;
+        }, parallel_options, wa::storage::operation_context()).wait();
+
+        CHECK_EQUAL(4U, range_names.size());
+        CHECK(range_names.count(U("log/2019")) == 1);
+        CHECK(range_names.count(U("log/2022")) == 1);
+        CHECK(range_names.count(U("log/2023")) == 1);
+        CHECK(range_names.count(U("other")) == 1);
+        CHECK(!*malformed_markers);
+    }
+
     TEST_FIXTURE(blob_test_base, container_stored_policy)
     {
         auto stored_permissions = m_container.download_permissions(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
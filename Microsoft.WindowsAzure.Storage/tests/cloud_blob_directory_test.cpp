@@ -244,4 +244,210 @@ SUITE(Blob)
             CHECK_THROW(list_entire_blob_tree(container, includes, 1, depth, wa::storage::blob_request_options(), m_context), std::invalid_argument);
         }
     }
+
+    TEST(directory_listing_cache)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto listings = std::make_shared<std::map<utility::string_t, int>>();
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([listings, mutex] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            if (request.method() == web::http::methods::DEL)
+            {
+                return web::http::http_response(web::http::status_codes::Accepted);
+            }
+
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            auto prefix = web::http::uri::decode(query[U("prefix")]);
+            {
+                std::lock_guard<std::mutex> guard(*mutex);
+                ++(*listings)[prefix];
+            }
+
+            std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><EnumerationResults ServiceEndpoint=\"https://account.blob.core.windows.net/\" ContainerName=\"container\"><Blobs>");
+            if (prefix == U("dir/"))
+            {
+                body.append("<Blob><Name>dir/blob</Name><Properties><Etag>0x8CBFF45D8A29A19</Etag><Content-Length>512</Content-Length><BlobType>BlockBlob</BlobType></Properties></Blob>");
+                body.append("<BlobPrefix><Name>dir/sub/</Name></BlobPrefix>");
+            }
+
+            body.append("</Blobs><NextMarker /></EnumerationResults>");
+            web::http::http_response response(web::http::status_codes::OK);
+            response.set_body(body, U("application/xml"));
+            return response;
+        });
+
+        auto count = [listings, mutex] (const utility::string_t& prefix) -> int
+        {
+            std::lock_guard<std::mutex> guard(*mutex);
+            return (*listings)[prefix];
+        };
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+
+        wa::storage::blob_listing_cache_settings settings;
+        settings.set_max_listings(16);
+        client.set_listing_cache_settings(settings);
+        auto directory = client.get_container_reference(U("container")).get_directory_reference(U("dir"));
+
+        // Listing the directory again is served from the cache, and its child directory is listed in the background
+        auto segment = directory.list_blobs_segmented(false, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(1U, segment.blobs().size());
+        CHECK_EQUAL(1U, segment.directories().size());
+        auto cached = directory.list_blobs_segmented(false, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(1, count(U("dir/")));
+        CHECK(cached.blobs()[0].name() == U("dir/blob"));
+        CHECK(cached.blobs()[0].properties().etag() == segment.blobs()[0].properties().etag());
+        CHECK(cached.directories()[0].prefix() == U("dir/sub/"));
+
+        for (int i = 0; i < 500 && count(U("dir/sub/")) == 0; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        cached.directories()[0].list_blobs_segmented(false, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(1, count(U("dir/sub/")));
+
+        // Flat listings are never cached
+        directory.list_blobs_segmented(true, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        directory.list_blobs_segmented(true, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(3, count(U("dir/")));
+
+        // Deleting a blob removes the listings it appears in, but not those of other directories
+        auto blob = cached.blobs()[0];
+        blob.delete_blob(wa::storage::delete_snapshots_option::none, wa::storage::access_condition(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        directory.list_blobs_segmented(false, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(4, count(U("dir/")));
+        auto other = client.get_container_reference(U("container")).get_directory_reference(U("other"));
+        other.list_blobs_segmented(false, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        other.list_blobs_segmented(false, wa::storage::blob_listing_includes(), 0, wa::storage::blob_continuation_token(), wa::storage::blob_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(1, count(U("other/")));
+    }
+
+    TEST_FIXTURE(blob_test_base, directory_transfer_manager)
+    {
+        const utility::string_t local_directory(U("directory_transfer_manager.tmp"));
+        const utility::string_t checkpoint_path(U("directory_transfer_manager_checkpoint.tmp"));
+        const size_t chunk_size = 64 * 1024;
+
+        std::vector<uint8_t> large_content(2 * chunk_size + 100);
+        fill_buffer_and_get_md5(large_content);
+
+        auto source = m_container.get_directory_reference(U("source"));
+        source.get_block_blob_reference(U("small1")).upload_text(U("small1"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        source.get_block_blob_reference(U("sub/small2")).upload_text(U("small2"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        source.get_block_blob_reference(U("sub/large")).upload_from_stream(concurrency::streams::bytestream::open_istream(large_content), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        wa::storage::blob_directory_transfer_manager download_manager(source, wa::storage::blob_request_options(), m_context);
+        download_manager.set_chunk_size(chunk_size);
+        download_manager.set_max_concurrent_transfers(2);
+        CHECK(download_manager.download_directory(local_directory).empty());
+
+        {
+            std::ifstream large_file(local_directory + U("\\sub\\large"), std::ios::binary);
+            std::vector<char> large_file_content((std::istreambuf_iterator<char>(large_file)), std::istreambuf_iterator<char>());
+            CHECK_EQUAL(large_content.size(), large_file_content.size());
+            CHECK_ARRAY_EQUAL(reinterpret_cast<const char*>(large_content.data()), large_file_content.data(), large_content.size());
+        }
+
+        auto destination = m_container.get_directory_reference(U("destination"));
+        wa::storage::blob_directory_transfer_manager upload_manager(destination, wa::storage::blob_request_options(), m_context);
+        upload_manager.set_chunk_size(chunk_size);
+        upload_manager.set_max_concurrent_transfers(2);
+        upload_manager.set_checkpoint_path(checkpoint_path);
+        CHECK(upload_manager.upload_directory(local_directory).empty());
+
+        CHECK(destination.get_block_blob_reference(U("small1")).download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context) == U("small1"));
+        CHECK(destination.get_block_blob_reference(U("sub/small2")).download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context) == U("small2"));
+        concurrency::streams::container_buffer<std::vector<uint8_t>> large_blob_content;
+        destination.get_block_blob_reference(U("sub/large")).download_to_stream(large_blob_content.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(large_content.size(), large_blob_content.collection().size());
+        CHECK_ARRAY_EQUAL(large_content.data(), large_blob_content.collection().data(), large_content.size());
+
+        // Files recorded in the checkpoint are not uploaded again
+        auto small_blob = destination.get_block_blob_reference(U("small1"));
+        small_blob.delete_blob(wa::storage::delete_snapshots_option::none, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK(upload_manager.upload_directory(local_directory).empty());
+        CHECK(!small_blob.exists(wa::storage::blob_request_options(), m_context));
+
+        upload_manager.set_checkpoint_path(utility::string_t());
+        CHECK_THROW(upload_manager.upload_directory(local_directory + U("\\missing")), std::system_error);
+
+        upload_manager.set_chunk_size(0);
+        CHECK_THROW(upload_manager.upload_directory(local_directory), std::invalid_argument);
+
+        std::remove(utility::conversions::to_utf8string(local_directory + U("\\small1")).c_str());
+        std::remove(utility::conversions::to_utf8string(local_directory + U("\\sub\\small2")).c_str());
+        std::remove(utility::conversions::to_utf8string(local_directory + U("\\sub\\large")).c_str());
+        std::remove(utility::conversions::to_utf8string(checkpoint_path).c_str());
+    }
+
+    TEST_FIXTURE(blob_test_base, directory_transfer_manager_sync)
+    {
+        const utility::string_t local_directory(U("directory_transfer_manager_sync.tmp"));
+        const utility::string_t hash_cache_path(U("directory_transfer_manager_sync_hashes.tmp"));
+
+        auto source = m_container.get_directory_reference(U("source"));
+        source.get_block_blob_reference(U("small1")).upload_text(U("small1"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        source.get_block_blob_reference(U("sub/small2")).upload_text(U("small2"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        wa::storage::blob_directory_transfer_manager download_manager(source, wa::storage::blob_request_options(), m_context);
+        CHECK(download_manager.download_directory(local_directory).empty());
+
+        std::atomic<int> put_count(0);
+        m_context.set_sending_request([&put_count] (web::http::http_request& request, wa::storage::operation_context)
+        {
+            if (request.method() == web::http::methods::PUT)
+            {
+                ++put_count;
+            }
+        });
+
+        auto destination = m_container.get_directory_reference(U("destination"));
+        wa::storage::blob_directory_transfer_manager upload_manager(destination, wa::storage::blob_request_options(), m_context);
+        upload_manager.set_hash_cache_path(hash_cache_path);
+        CHECK(upload_manager.sync_upload_directory(local_directory).empty());
+        CHECK_EQUAL(2, put_count);
+
+        auto small_blob = destination.get_block_blob_reference(U("small1"));
+        small_blob.download_attributes(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK(!small_blob.properties().content_md5().empty());
+
+        // Nothing has changed, so the hashes come from the cache and nothing is uploaded
+        put_count = 0;
+        CHECK(upload_manager.sync_upload_directory(local_directory).empty());
+        CHECK_EQUAL(0, put_count);
+
+        // Only the changed file is uploaded, and a blob without a local file is deleted if asked to
+        {
+            std::ofstream changed_file(local_directory + U("\\small1"), std::ios::binary | std::ios::trunc);
+            changed_file << "changed";
+        }
+
+        auto extra_blob = destination.get_block_blob_reference(U("extra"));
+        extra_blob.upload_text(U("extra"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        put_count = 0;
+        upload_manager.set_delete_extraneous(true);
+        CHECK(upload_manager.sync_upload_directory(local_directory).empty());
+        CHECK_EQUAL(1, put_count);
+        CHECK(small_blob.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context) == U("changed"));
+        CHECK(!extra_blob.exists(wa::storage::blob_request_options(), m_context));
+
+        // Syncing back from the source restores the file that differs
+        CHECK(download_manager.sync_download_directory(local_directory).empty());
+        {
+            std::ifstream restored_file(local_directory + U("\\small1"), std::ios::binary);
+            std::string restored_content((std::istreambuf_iterator<char>(restored_file)), std::istreambuf_iterator<char>());
+            CHECK_EQUAL("small1", restored_content);
+        }
+
+        m_context.set_sending_request(std::function<void(web::http::http_request &, wa::storage::operation_context)>());
+        std::remove(utility::conversions::to_utf8string(local_directory + U("\\small1")).c_str());
+        std::remove(utility::conversions::to_utf8string(local_directory + U("\\sub\\small2")).c_str());
+        std::remove(utility::conversions::to_utf8string(hash_cache_path).c_str());
+    }
 }
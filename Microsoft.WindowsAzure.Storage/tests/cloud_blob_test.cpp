@@ -459,6 +459,163 @@ SUITE(Blob)
         check_access(sas_token, wa::storage::blob_shared_access_policy::permissions::read, headers, blob);
     }
 
+    TEST_FIXTURE(blob_test_base, blob_sas_cache_and_bulk)
+    {
+        wa::storage::blob_shared_access_policy policy;
+        policy.set_permissions(wa::storage::blob_shared_access_policy::permissions::read);
+        policy.set_start(utility::datetime::utc_now() - utility::datetime::from_minutes(5));
+        policy.set_expiry(utility::datetime::utc_now() + utility::datetime::from_minutes(30));
+
+        wa::storage::cloud_blob_shared_access_headers headers;
+        headers.set_content_type(U("plain/text"));
+
+        std::vector<utility::string_t> blob_names;
+        for (int i = 0; i < 3; i++)
+        {
+            blob_names.push_back(U("blob") + utility::conversions::print_string(i));
+        }
+
+        auto sas_tokens = m_container.get_blob_shared_access_signatures(policy, utility::string_t(), blob_names, headers);
+        CHECK_EQUAL(blob_names.size(), sas_tokens.size());
+
+        auto client = m_container.service_client();
+        CHECK_EQUAL(0U, client.shared_access_signature_cache_size());
+        client.set_shared_access_signature_cache_size(16);
+        CHECK_EQUAL(16U, client.shared_access_signature_cache_size());
+        auto cached_container = client.get_container_reference(m_container.name());
+
+        for (size_t i = 0; i < blob_names.size(); i++)
+        {
+            auto blob = m_container.get_block_blob_reference(blob_names[i]);
+            CHECK_UTF8_EQUAL(blob.get_shared_access_signature(policy, utility::string_t(), headers), sas_tokens[i]);
+
+            auto cached_blob = cached_container.get_block_blob_reference(blob_names[i]);
+            CHECK_UTF8_EQUAL(sas_tokens[i], cached_blob.get_shared_access_signature(policy, utility::string_t(), headers));
+            CHECK_UTF8_EQUAL(sas_tokens[i], cached_blob.get_shared_access_signature(policy, utility::string_t(), headers));
+        }
+
+        auto blob = m_container.get_block_blob_reference(blob_names[0]);
+        blob.upload_text(U("test"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        check_access(sas_tokens[0], wa::storage::blob_shared_access_policy::permissions::read, headers, blob);
+    }
+
+    TEST_FIXTURE(blob_test_base, blob_attribute_cache)
+    {
+        auto client = m_container.service_client();
+        CHECK_EQUAL(0U, client.attribute_cache_settings().max_blobs());
+
+        wa::storage::blob_attribute_cache_settings settings;
+        settings.set_max_blobs(16);
+        settings.set_time_to_live(std::chrono::seconds(60));
+        client.set_attribute_cache_settings(settings);
+        CHECK_EQUAL(16U, client.attribute_cache_settings().max_blobs());
+
+        auto blob = client.get_container_reference(m_container.name()).get_block_blob_reference(U("blob"));
+        blob.upload_text(U("test"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        blob.download_attributes(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        // Fresh attributes are not read again, so only the content is downloaded
+        {
+            wa::storage::operation_context context;
+            auto stream = blob.open_read(wa::storage::access_condition(), wa::storage::blob_request_options(), context);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+            stream.read_to_end(output_buffer).wait();
+            stream.close().wait();
+            CHECK_EQUAL(4U, output_buffer.collection().size());
+            CHECK_EQUAL(1U, context.request_results().size());
+        }
+
+        // A change made through another client is caught by the cached ETag
+        wa::storage::cloud_blob_client other_client(client.base_uri(), client.credentials());
+        other_client.get_container_reference(m_container.name()).get_block_blob_reference(U("blob")).upload_text(U("changed"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        {
+            auto stream = blob.open_read(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+            CHECK_THROW(stream.read_to_end(output_buffer).wait(), wa::storage::storage_exception);
+        }
+
+        // The stale attributes have been removed, so they are read again
+        {
+            wa::storage::operation_context context;
+            auto stream = blob.open_read(wa::storage::access_condition(), wa::storage::blob_request_options(), context);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+            stream.read_to_end(output_buffer).wait();
+            stream.close().wait();
+            CHECK_EQUAL(7U, output_buffer.collection().size());
+            CHECK_EQUAL(2U, context.request_results().size());
+        }
+
+        // Writes through the caching client remove the attributes of the blob they change
+        blob.upload_text(U("test"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        {
+            wa::storage::operation_context context;
+            blob.open_read(wa::storage::access_condition(), wa::storage::blob_request_options(), context).close().wait();
+            CHECK_EQUAL(1U, context.request_results().size());
+            CHECK_EQUAL(4U, blob.properties().size());
+        }
+    }
+
+    TEST_FIXTURE(blob_test_base, blob_content_cache)
+    {
+        auto client = m_container.service_client();
+        CHECK_EQUAL(0U, client.content_cache_settings().max_size_in_bytes());
+
+        wa::storage::blob_content_cache_settings invalid_settings;
+        invalid_settings.set_max_size_in_bytes(1024);
+        invalid_settings.set_max_blob_size_in_bytes(0);
+        CHECK_THROW(client.set_content_cache_settings(invalid_settings), std::invalid_argument);
+        invalid_settings.set_max_blob_size_in_bytes(2048);
+        CHECK_THROW(client.set_content_cache_settings(invalid_settings), std::invalid_argument);
+
+        wa::storage::blob_content_cache_settings settings;
+        settings.set_max_size_in_bytes(1024);
+        settings.set_max_blob_size_in_bytes(16);
+        client.set_content_cache_settings(settings);
+        CHECK_EQUAL(1024U, client.content_cache_settings().max_size_in_bytes());
+
+        auto blob = client.get_container_reference(m_container.name()).get_block_blob_reference(U("blob"));
+        blob.upload_text(U("test"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_UTF8_EQUAL(U("test"), blob.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context));
+
+        // The content has not changed, so the service does not send it again
+        {
+            wa::storage::operation_context context;
+            CHECK_UTF8_EQUAL(U("test"), blob.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), context));
+            CHECK_EQUAL(1U, context.request_results().size());
+            CHECK_EQUAL(web::http::status_codes::NotModified, context.request_results().back().http_status_code());
+            CHECK_EQUAL(4U, blob.properties().size());
+        }
+
+        // A change made through another client is downloaded
+        wa::storage::cloud_blob_client other_client(client.base_uri(), client.credentials());
+        other_client.get_container_reference(m_container.name()).get_block_blob_reference(U("blob")).upload_text(U("changed"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        {
+            wa::storage::operation_context context;
+            CHECK_UTF8_EQUAL(U("changed"), blob.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), context));
+            CHECK_EQUAL(1U, context.request_results().size());
+            CHECK_EQUAL(web::http::status_codes::PartialContent, context.request_results().back().http_status_code());
+        }
+
+        // A blob larger than a cached blob can be is downloaded in two parts and not cached
+        utility::string_t large_text(U("0123456789abcdefghijklmnopqrstuvwxyz"));
+        auto large_blob = client.get_container_reference(m_container.name()).get_block_blob_reference(U("large"));
+        large_blob.upload_text(large_text, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        for (int i = 0; i < 2; i++)
+        {
+            wa::storage::operation_context context;
+            CHECK_UTF8_EQUAL(large_text, large_blob.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), context));
+            CHECK_EQUAL(2U, context.request_results().size());
+        }
+
+        // Empty blobs cannot be downloaded by range, so they are downloaded as a whole
+        auto empty_blob = client.get_container_reference(m_container.name()).get_block_blob_reference(U("empty"));
+        empty_blob.upload_text(utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_UTF8_EQUAL(utility::string_t(), empty_blob.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context));
+
+        blob.delete_blob(wa::storage::delete_snapshots_option::none, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_THROW(blob.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context), wa::storage::storage_exception);
+    }
+
     TEST_FIXTURE(blob_test_base, blob_sas_invalid_time)
     {
         wa::storage::blob_shared_access_policy policy;
@@ -583,4 +740,46 @@ SUITE(Blob)
         copy.start_copy_from_blob(defiddler(blob.uri().primary_uri()), wa::storage::access_condition::generate_if_match_condition(blob.properties().etag()), wa::storage::access_condition::generate_if_match_condition(copy.properties().etag()), wa::storage::blob_request_options(), m_context);
         CHECK(wait_for_copy(copy));
     }
+
+    TEST_FIXTURE(blob_test_base, blob_copy_manager)
+    {
+        wa::storage::blob_copy_manager manager(m_container, wa::storage::blob_request_options(), m_context);
+        manager.set_max_concurrent_copies(2);
+        manager.set_min_polling_interval(std::chrono::milliseconds(100));
+        manager.set_max_polling_interval(std::chrono::milliseconds(1000));
+
+        const int blob_count = 5;
+        for (int i = 0; i < blob_count; ++i)
+        {
+            auto source = m_container.get_block_blob_reference(U("source") + utility::conversions::print_string(i));
+            source.upload_text(source.name(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+            manager.add(defiddler(source.uri().primary_uri()), U("copies/") + source.name());
+        }
+
+        // A source that does not exist fails to start
+        manager.add(defiddler(m_container.get_block_blob_reference(U("missing")).uri().primary_uri()), U("copies/missing"));
+
+        auto results = manager.wait_all();
+        CHECK_EQUAL(blob_count + 1U, results.size());
+        for (auto iter = results.cbegin(); iter != results.cend(); ++iter)
+        {
+            if (iter->destination().name() == U("copies/missing"))
+            {
+                CHECK(iter->error() != nullptr);
+                continue;
+            }
+
+            CHECK(iter->error() == nullptr);
+            CHECK(!iter->stalled());
+            CHECK(wa::storage::copy_status::success == iter->destination().copy_state().status());
+
+            auto copy = m_container.get_block_blob_reference(iter->destination().name());
+            CHECK_UTF8_EQUAL(copy.name().substr(7), copy.download_text(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context));
+        }
+
+        wa::storage::blob_copy_manager invalid_manager(m_container);
+        invalid_manager.set_max_concurrent_copies(0);
+        CHECK_THROW(invalid_manager.add(U("http://www.example.com/blob"), U("blob")), std::invalid_argument);
+        CHECK(invalid_manager.wait_all().empty());
+    }
 }
@@ -19,6 +19,9 @@
 #include "blob_test_base.h"
 #include "check_macros.h"
 
+#include "was/in_memory_transport.h"
+#include "wascore/blobstreams.h"
+
 #pragma region Fixture
 
 utility::string_t block_blob_test_base::get_block_id(uint16_t block_index)
@@ -67,6 +70,84 @@ void block_blob_test_base::check_block_list_equal(const std::vector<wa::storage:
 
 #pragma endregion
 
+namespace
+{
+    // Keeps the block ID, Content-MD5 and body of every Put Block request, and the blob MD5 of the block list, and then
+    // passes the request on to another transport
+    class block_recording_transport : public wa::storage::http_transport
+    {
+    public:
+
+        struct block_request
+        {
+            utility::string_t block_id;
+            utility::string_t content_md5;
+            std::vector<uint8_t> body;
+        };
+
+        explicit block_recording_transport(std::shared_ptr<wa::storage::http_transport> inner)
+            : m_inner(inner)
+        {
+        }
+
+        virtual pplx::task<web::http::http_response> send(web::http::http_request request, const pplx::cancellation_token& token) override
+        {
+            auto instance = this;
+            return pplx::create_task([instance, request, token] () -> pplx::task<web::http::http_response>
+            {
+                auto query = web::http::uri::split_query(request.request_uri().query());
+                if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("block")))
+                {
+                    block_request block;
+                    block.block_id = web::http::uri::decode(query[U("blockid")]);
+                    request.headers().match(web::http::header_names::content_md5, block.content_md5);
+
+                    concurrency::streams::container_buffer<std::vector<uint8_t>> body;
+                    request._get_impl()->instream().read_to_end(body).wait();
+                    block.body = std::move(body.collection());
+
+                    std::lock_guard<std::mutex> guard(instance->m_mutex);
+                    instance->m_blocks.push_back(std::move(block));
+                }
+                else if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("blocklist")))
+                {
+                    std::lock_guard<std::mutex> guard(instance->m_mutex);
+                    request.headers().match(U("x-ms-blob-content-md5"), instance->m_blob_md5);
+                }
+
+                return instance->m_inner->send(request, token);
+            });
+        }
+
+        std::vector<block_request> blocks() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_blocks;
+        }
+
+        utility::string_t blob_md5() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_blob_md5;
+        }
+
+    private:
+
+        std::shared_ptr<wa::storage::http_transport> m_inner;
+        std::vector<block_request> m_blocks;
+        utility::string_t m_blob_md5;
+        mutable std::mutex m_mutex;
+    };
+
+    utility::string_t get_md5(const std::vector<uint8_t>& data)
+    {
+        wa::storage::core::hash_md5_streambuf md5;
+        md5.putn(data.data(), data.size()).wait();
+        md5.close().wait();
+        return utility::conversions::to_base64(md5.hash());
+    }
+}
+
 SUITE(Blob)
 {
     TEST_FIXTURE(block_blob_test_base, block_upload)
@@ -145,6 +226,78 @@ SUITE(Blob)
         m_context.set_sending_request(std::function<void(web::http::http_request &, wa::storage::operation_context)>());
     }
 
+    TEST_FIXTURE(block_blob_test_base, block_upload_crc64)
+    {
+        // CRC64 of "123456789" in little-endian byte order
+        const std::string block_data("123456789");
+        const utility::string_t expected_crc64(U("iJh5CoYUi64="));
+        std::vector<uint8_t> buffer(block_data.begin(), block_data.end());
+
+        utility::string_t crc64_header;
+        m_context.set_sending_request([&crc64_header] (web::http::http_request& request, wa::storage::operation_context)
+        {
+            if (!request.headers().match(U("x-ms-content-crc64"), crc64_header))
+            {
+                crc64_header.clear();
+            }
+        });
+
+        wa::storage::blob_request_options options;
+        std::vector<wa::storage::block_list_item> blocks;
+
+        options.set_use_transactional_crc64(false);
+        blocks.push_back(wa::storage::block_list_item(get_block_id(0)));
+        m_blob.upload_block(get_block_id(0), concurrency::streams::bytestream::open_istream(buffer), utility::string_t(), wa::storage::access_condition(), options, m_context);
+        CHECK_UTF8_EQUAL(utility::string_t(), crc64_header);
+
+        options.set_use_transactional_crc64(true);
+        blocks.push_back(wa::storage::block_list_item(get_block_id(1)));
+        m_blob.upload_block(get_block_id(1), concurrency::streams::bytestream::open_istream(buffer), utility::string_t(), wa::storage::access_condition(), options, m_context);
+        CHECK_UTF8_EQUAL(expected_crc64, crc64_header);
+
+        m_context.set_sending_request(std::function<void(web::http::http_request &, wa::storage::operation_context)>());
+
+        m_blob.upload_block_list(blocks, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        m_blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(2 * buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data() + buffer.size(), buffer.size());
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_upload_expect_continue)
+    {
+        std::vector<uint8_t> buffer(16 * 1024);
+
+        utility::string_t expect_header;
+        m_context.set_sending_request([&expect_header] (web::http::http_request& request, wa::storage::operation_context)
+        {
+            if (!request.headers().match(U("Expect"), expect_header))
+            {
+                expect_header.clear();
+            }
+        });
+
+        wa::storage::blob_request_options options;
+        CHECK_EQUAL(0U, options.expect_continue_threshold());
+        m_blob.upload_block(get_block_id(0), concurrency::streams::bytestream::open_istream(buffer), utility::string_t(), wa::storage::access_condition(), options, m_context);
+        CHECK(expect_header.empty());
+
+        // Only bodies at least as large as the threshold wait for the service to accept the request
+        options.set_expect_continue_threshold(buffer.size() + 1);
+        m_blob.upload_block(get_block_id(1), concurrency::streams::bytestream::open_istream(buffer), utility::string_t(), wa::storage::access_condition(), options, m_context);
+        CHECK(expect_header.empty());
+
+        options.set_expect_continue_threshold(buffer.size());
+        m_blob.upload_block(get_block_id(2), concurrency::streams::bytestream::open_istream(buffer), utility::string_t(), wa::storage::access_condition(), options, m_context);
+        CHECK_UTF8_EQUAL(U("100-continue"), expect_header);
+
+        // A request the service rejects still fails as before
+        auto lease_id = utility::uuid_to_string(utility::new_uuid());
+        CHECK_THROW(m_blob.upload_block(get_block_id(3), concurrency::streams::bytestream::open_istream(buffer), utility::string_t(), wa::storage::access_condition::generate_lease_condition(lease_id), options, m_context), wa::storage::storage_exception);
+
+        m_context.set_sending_request(std::function<void(web::http::http_request &, wa::storage::operation_context)>());
+    }
+
     TEST_FIXTURE(block_blob_test_base, block_blob_upload)
     {
         const size_t size = 6 * 1024 * 1024;
@@ -304,8 +457,13 @@ SUITE(Blob)
             m_blob.delete_blob();
             m_blob.properties().set_content_md5(utility::string_t());
 
+            // A source that does not fit in one write buffer is uploaded block by block instead of being copied into memory
             options.set_stream_write_size_in_bytes(1 * 1024 * 1024);
             options.set_store_blob_content_md5(false);
+            check_parallelism(upload_and_download(m_blob, buffer_size, buffer_offset, blob_size, false, options, 5, false), 1);
+            m_blob.delete_blob();
+            m_blob.properties().set_content_md5(utility::string_t());
+
             options.set_parallelism_factor(4);
             check_parallelism(upload_and_download(m_blob, buffer_size, buffer_offset, blob_size, false, options, 5, false), 4);
             m_blob.delete_blob();
@@ -319,6 +477,36 @@ SUITE(Blob)
         }
     }
 
+    TEST_FIXTURE(block_blob_test_base, block_blob_adaptive_upload)
+    {
+        CHECK(!wa::storage::blob_request_options().adaptive_upload());
+
+        wa::storage::blob_request_options options;
+        options.set_adaptive_upload(true);
+        options.set_parallelism_factor(4);
+        options.set_stream_write_size_in_bytes(512 * 1024);
+        options.set_store_blob_content_md5(true);
+        CHECK(options.adaptive_upload());
+
+        // Blobs of different sizes give the throughput model requests of different sizes, so later uploads are tuned
+        const size_t sizes[4] = { 1024, 3 * 1024 * 1024 + 512, 64 * 1024, 2 * 1024 * 1024 };
+        for (int i = 0; i < 12; ++i)
+        {
+            auto size = sizes[i % 4];
+            std::vector<uint8_t> buffer;
+            buffer.resize(size);
+            auto md5 = fill_buffer_and_get_md5(buffer);
+
+            m_blob.upload_from_stream(concurrency::streams::bytestream::open_istream(buffer), wa::storage::access_condition(), options, m_context);
+            CHECK_UTF8_EQUAL(md5, m_blob.properties().content_md5());
+
+            concurrency::streams::container_buffer<std::vector<uint8_t>> target;
+            m_blob.download_to_stream(target.create_ostream(), wa::storage::access_condition(), options, m_context);
+            CHECK_EQUAL(size, target.collection().size());
+            CHECK_ARRAY_EQUAL(buffer, target.collection(), size);
+        }
+    }
+
     TEST_FIXTURE(block_blob_test_base, block_blob_upload_with_invalid_size)
     {
         const size_t buffer_size = 2 * 1024 * 1024;
@@ -348,6 +536,370 @@ SUITE(Blob)
         CHECK_THROW(m_blob.download_text(wa::storage::access_condition(), options, m_context), wa::storage::storage_exception);
     }
 
+    TEST_FIXTURE(block_blob_test_base, block_blob_parallel_download)
+    {
+        const size_t size = 6 * 1024 * 1024 + 512;
+        std::vector<uint8_t> buffer;
+        buffer.resize(size);
+        fill_buffer_and_get_md5(buffer);
+        m_blob.upload_from_stream(concurrency::streams::bytestream::open_istream(buffer), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(4);
+        options.set_stream_read_size_in_bytes(1 * 1024 * 1024);
+        options.set_use_transactional_md5(true);
+
+        {
+            wa::storage::operation_context context;
+            concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+            m_blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), options, context);
+            CHECK_EQUAL(size, output_buffer.collection().size());
+            CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), size);
+            CHECK_EQUAL(7, context.request_results().size());
+            CHECK_EQUAL(size, m_blob.properties().size());
+        }
+
+        {
+            const int64_t offset = 1024 * 1024 - 10;
+            const int64_t length = 3 * 1024 * 1024 + 20;
+            wa::storage::operation_context context;
+            concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+            m_blob.download_range_to_stream(output_buffer.create_ostream(), offset, length, wa::storage::access_condition(), options, context);
+            CHECK_EQUAL(static_cast<size_t>(length), output_buffer.collection().size());
+            CHECK_ARRAY_EQUAL(buffer.data() + offset, output_buffer.collection().data(), static_cast<size_t>(length));
+            CHECK_EQUAL(4, context.request_results().size());
+        }
+
+        m_blob.upload_text(utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK(m_blob.download_text(wa::storage::access_condition(), options, m_context).empty());
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_transactional_md5_download)
+    {
+        const size_t size = 9 * 1024 * 1024 + 512;
+        std::vector<uint8_t> buffer;
+        buffer.resize(size);
+        fill_buffer_and_get_md5(buffer);
+        m_blob.upload_from_stream(concurrency::streams::bytestream::open_istream(buffer), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        // Ranges larger than 4MB are split even without parallelism, as the service would not return their MD5
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(1);
+        options.set_stream_read_size_in_bytes(16 * 1024 * 1024);
+        options.set_use_transactional_md5(true);
+
+        {
+            const int64_t offset = 100;
+            const int64_t length = 9 * 1024 * 1024;
+            wa::storage::operation_context context;
+            concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+            m_blob.download_range_to_stream(output_buffer.create_ostream(), offset, length, wa::storage::access_condition(), options, context);
+            CHECK_EQUAL(static_cast<size_t>(length), output_buffer.collection().size());
+            CHECK_ARRAY_EQUAL(buffer.data() + offset, output_buffer.collection().data(), static_cast<size_t>(length));
+            CHECK_EQUAL(3, context.request_results().size());
+        }
+
+        {
+            std::vector<uint8_t> output(size);
+            wa::storage::operation_context context;
+            CHECK_EQUAL(size, m_blob.download_range_to_buffer(output.data(), output.size(), 0, wa::storage::access_condition(), options, context));
+            CHECK_ARRAY_EQUAL(buffer.data(), output.data(), size);
+            CHECK_EQUAL(3, context.request_results().size());
+        }
+
+        // A target that cannot seek gets the ranges in order, however they complete
+        options.set_parallelism_factor(3);
+        {
+            wa::storage::operation_context context;
+            concurrency::streams::producer_consumer_buffer<uint8_t> output_buffer;
+            m_blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), options, context);
+            output_buffer.close(std::ios_base::out).wait();
+
+            std::vector<uint8_t> output(size + 1);
+            CHECK_EQUAL(size, output_buffer.getn(output.data(), output.size()).get());
+            CHECK_ARRAY_EQUAL(buffer.data(), output.data(), size);
+            CHECK_EQUAL(3, context.request_results().size());
+        }
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_upload_from_buffers)
+    {
+        std::vector<uint8_t> buffer;
+        buffer.resize(2 * 1024 * 1024 + 100);
+        auto md5 = fill_buffer_and_get_md5(buffer);
+
+        // A header, an empty piece, the payload and a trailer, as a serializer would produce them
+        std::vector<wa::storage::const_buffer> pieces;
+        pieces.push_back(wa::storage::const_buffer(buffer.data(), 100));
+        pieces.push_back(wa::storage::const_buffer(buffer.data() + 100, 0));
+        pieces.push_back(wa::storage::const_buffer(buffer.data() + 100, 2 * 1024 * 1024 - 1));
+        pieces.push_back(wa::storage::const_buffer(buffer.data() + 2 * 1024 * 1024 + 99, 1));
+
+        utility::string_t md5_header;
+        m_context.set_sending_request([&md5_header] (web::http::http_request& request, wa::storage::operation_context)
+        {
+            if (!request.headers().match(web::http::header_names::content_md5, md5_header))
+            {
+                md5_header.clear();
+            }
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_use_transactional_md5(true);
+        auto block_id = get_block_id(0);
+        m_blob.upload_block(block_id, pieces, utility::string_t(), wa::storage::access_condition(), options, m_context);
+        CHECK_UTF8_EQUAL(md5, md5_header);
+
+        std::vector<wa::storage::block_list_item> blocks;
+        blocks.push_back(wa::storage::block_list_item(block_id));
+        m_blob.upload_block_list(blocks, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output;
+        m_blob.download_to_stream(output.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_ARRAY_EQUAL(buffer, output.collection(), (int)buffer.size());
+
+        // Above the threshold, the pieces are split into blocks that do not line up with them
+        options.set_single_blob_upload_threshold_in_bytes(1 * 1024 * 1024);
+        options.set_stream_write_size_in_bytes(512 * 1024);
+        options.set_store_blob_content_md5(true);
+        m_blob.upload_from_buffers(pieces, wa::storage::access_condition(), options, m_context);
+        m_blob.download_attributes(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(buffer.size(), m_blob.properties().size());
+        CHECK_UTF8_EQUAL(md5, m_blob.properties().content_md5());
+        CHECK_EQUAL(5, m_blob.download_block_list(wa::storage::block_listing_filter::committed, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context).size());
+
+        CHECK_THROW(m_blob.upload_from_buffers(std::vector<wa::storage::const_buffer>(1, wa::storage::const_buffer(nullptr, 1))), std::invalid_argument);
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_upload_from_blob)
+    {
+        std::vector<uint8_t> buffer;
+        buffer.resize(3 * 1024 * 1024 + 100);
+        fill_buffer_and_get_md5(buffer);
+
+        auto source = m_container.get_block_blob_reference(U("source"));
+        source.properties().set_content_type(U("application/octet-stream"));
+        source.metadata()[U("key")] = U("value");
+        source.upload_from_stream(concurrency::streams::bytestream::open_istream(buffer), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        // Small blocks get several ranges and uploads in flight at the same time through the ring of buffers
+        wa::storage::blob_request_options options;
+        options.set_stream_write_size_in_bytes(256 * 1024);
+        options.set_parallelism_factor(4);
+        m_blob.upload_from_blob(source, wa::storage::access_condition(), wa::storage::access_condition(), options, m_context);
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output;
+        m_blob.download_to_stream(output.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_ARRAY_EQUAL(buffer, output.collection(), (int)buffer.size());
+        CHECK_EQUAL(13, m_blob.download_block_list(wa::storage::block_listing_filter::committed, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context).size());
+        CHECK(m_blob.properties().content_type() == U("application/octet-stream"));
+        CHECK(m_blob.metadata()[U("key")] == U("value"));
+
+        // The ranges are read under the ETag of the source, which a mismatching condition on the source fails before any block is written
+        auto destination = m_container.get_block_blob_reference(U("destination"));
+        CHECK_THROW(destination.upload_from_blob(source, wa::storage::access_condition::generate_if_match_condition(U("\"0x0\"")), wa::storage::access_condition(), options, m_context), wa::storage::storage_exception);
+        CHECK(!destination.exists(wa::storage::blob_request_options(), m_context));
+
+        // An empty source gives an empty blob
+        source.upload_block_list(std::vector<wa::storage::block_list_item>(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        m_blob.upload_from_blob(source, wa::storage::access_condition(), wa::storage::access_condition(), options, m_context);
+        m_blob.download_attributes(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(0U, m_blob.properties().size());
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_download_to_buffer)
+    {
+        const size_t size = 6 * 1024 * 1024 + 512;
+        std::vector<uint8_t> buffer;
+        buffer.resize(size);
+        fill_buffer_and_get_md5(buffer);
+        m_blob.upload_from_stream(concurrency::streams::bytestream::open_istream(buffer), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(4);
+        options.set_stream_read_size_in_bytes(1 * 1024 * 1024);
+        options.set_use_transactional_md5(true);
+
+        {
+            const int64_t offset = 1024 * 1024 - 10;
+            const size_t length = 3 * 1024 * 1024 + 20;
+            std::vector<uint8_t> output(length);
+            wa::storage::operation_context context;
+            CHECK_EQUAL(length, m_blob.download_range_to_buffer(output.data(), length, offset, wa::storage::access_condition(), options, context));
+            CHECK_ARRAY_EQUAL(buffer.data() + offset, output.data(), length);
+            CHECK_EQUAL(4, context.request_results().size());
+            CHECK_EQUAL(size, m_blob.properties().size());
+        }
+
+        {
+            // The blob ends before the range does, and a range after its end is empty
+            const int64_t offset = 6 * 1024 * 1024;
+            std::vector<uint8_t> output(2 * 1024 * 1024);
+            wa::storage::operation_context context;
+            CHECK_EQUAL(size_t(512), m_blob.download_range_to_buffer(output.data(), output.size(), offset, wa::storage::access_condition(), options, context));
+            CHECK_ARRAY_EQUAL(buffer.data() + offset, output.data(), 512);
+            CHECK_EQUAL(size_t(0), m_blob.download_range_to_buffer(output.data(), output.size(), size + 1024, wa::storage::access_condition(), options, context));
+        }
+
+        options.set_parallelism_factor(1);
+        options.set_use_transactional_md5(false);
+        std::vector<uint8_t> output(size);
+        CHECK_EQUAL(size, m_blob.download_range_to_buffer(output.data(), size, 0, wa::storage::access_condition(), options, m_context));
+        CHECK_ARRAY_EQUAL(buffer.data(), output.data(), size);
+
+        CHECK_THROW(m_blob.download_range_to_buffer(nullptr, 1, 0), std::invalid_argument);
+        CHECK_THROW(m_blob.download_range_to_buffer(output.data(), 1, -1), std::invalid_argument);
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_range_read_attributes)
+    {
+        m_blob.metadata()[U("key")] = U("value1");
+        m_blob.upload_text(U("range read attributes"), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        auto blob = m_container.get_block_blob_reference(m_blob.name());
+        blob.download_attributes(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        m_blob.metadata()[U("key")] = U("value2");
+        m_blob.upload_metadata(wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        // Only the ETag is taken from the response of a range read without the update
+        wa::storage::blob_request_options options;
+        options.set_update_attributes_on_range_read(false);
+        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+        blob.download_range_to_stream(buffer.create_ostream(), 0, 5, wa::storage::access_condition(), options, m_context);
+        CHECK_EQUAL(5U, buffer.collection().size());
+        CHECK(blob.metadata()[U("key")] == U("value1"));
+        CHECK(m_blob.properties().etag() == blob.properties().etag());
+
+        blob.download_range_to_stream(buffer.create_ostream(), 0, 5, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK(blob.metadata()[U("key")] == U("value2"));
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_file_upload)
+    {
+        const utility::string_t source_path(U("block_blob_file_upload_source.tmp"));
+        const utility::string_t target_path(U("block_blob_file_upload_target.tmp"));
+
+        const size_t size = 3 * 1024 * 1024 + 1024;
+        std::vector<uint8_t> buffer;
+        buffer.resize(size);
+        fill_buffer_and_get_md5(buffer);
+        {
+            std::ofstream source_file(source_path, std::ios::binary);
+            source_file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        }
+
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(2);
+        options.set_single_blob_upload_threshold_in_bytes(1 * 1024 * 1024);
+        options.set_store_blob_content_md5(true);
+        m_blob.upload_from_file(source_path, wa::storage::access_condition(), options, m_context);
+        m_blob.download_to_file(target_path, wa::storage::access_condition(), options, m_context);
+
+        {
+            std::ifstream target_file(target_path, std::ios::binary);
+            std::vector<char> target_buffer((std::istreambuf_iterator<char>(target_file)), std::istreambuf_iterator<char>());
+            CHECK_EQUAL(size, target_buffer.size());
+            CHECK_ARRAY_EQUAL(reinterpret_cast<const char*>(buffer.data()), target_buffer.data(), size);
+        }
+
+        m_blob.upload_text(utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        m_blob.download_to_file(target_path, wa::storage::access_condition(), options, m_context);
+        {
+            std::ifstream target_file(target_path, std::ios::binary | std::ios::ate);
+            CHECK_EQUAL(0, static_cast<int>(target_file.tellg()));
+        }
+
+        std::remove(utility::conversions::to_utf8string(source_path).c_str());
+        std::remove(utility::conversions::to_utf8string(target_path).c_str());
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_upload_changed_blocks)
+    {
+        const size_t block_size = 256 * 1024;
+        std::vector<uint8_t> buffer(4 * block_size + 1024);
+        fill_buffer_and_get_md5(buffer);
+
+        // The last full block repeats the first one, so it is only sent once
+        std::copy(buffer.begin(), buffer.begin() + block_size, buffer.begin() + 3 * block_size);
+
+        wa::storage::blob_request_options options;
+        options.set_stream_write_size_in_bytes(block_size);
+        options.set_parallelism_factor(2);
+
+        {
+            // Listing the blocks of a blob that does not exist yet, four of the five blocks and the block list
+            wa::storage::operation_context context;
+            m_blob.upload_changed_blocks_from_stream(concurrency::streams::bytestream::open_istream(buffer), buffer.size(), wa::storage::access_condition(), options, context);
+            CHECK_EQUAL(6U, context.request_results().size());
+        }
+
+        buffer[2 * block_size + 10] ^= 0xFF;
+        {
+            // Only the changed block is sent again
+            wa::storage::operation_context context;
+            m_blob.upload_changed_blocks_from_stream(concurrency::streams::bytestream::open_istream(buffer), buffer.size(), wa::storage::access_condition(), options, context);
+            CHECK_EQUAL(3U, context.request_results().size());
+        }
+
+        auto block_list = m_blob.download_block_list(wa::storage::block_listing_filter::committed, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(5U, block_list.size());
+        CHECK(block_list[0].id() == block_list[3].id());
+        CHECK(!m_blob.properties().content_md5().empty());
+
+        // Downloading the whole blob also validates the MD5 of its content
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        m_blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+
+        concurrency::streams::producer_consumer_buffer<uint8_t> non_seekable_buffer;
+        CHECK_THROW(m_blob.upload_changed_blocks_from_stream(non_seekable_buffer.create_istream(), buffer.size(), wa::storage::access_condition(), options, m_context), std::logic_error);
+    }
+
+    TEST_FIXTURE(block_blob_test_base, block_blob_streamed_block_list)
+    {
+        wa::storage::core::block_id_sequence block_ids;
+        auto block_list = wa::storage::core::block_list_streambuf(block_ids, 3).create_istream();
+        concurrency::streams::container_buffer<std::vector<uint8_t>> body;
+        block_list.read_to_end(body).wait();
+
+        std::string expected("<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList>");
+        for (size_t i = 0; i < 3; ++i)
+        {
+            CHECK_EQUAL(block_ids.get_utf8_block_id(0).size(), block_ids.get_utf8_block_id(i).size());
+            expected.append("<Latest>" + block_ids.get_utf8_block_id(i) + "</Latest>");
+        }
+
+        expected.append("</BlockList>");
+        CHECK_EQUAL(expected, std::string(body.collection().begin(), body.collection().end()));
+        CHECK(block_ids.get_utf8_block_id(1) != block_ids.get_utf8_block_id(2));
+
+        // Reading the body again from a position within a block list entry
+        block_list.seek(expected.size() - 20);
+        concurrency::streams::container_buffer<std::vector<uint8_t>> tail;
+        block_list.read_to_end(tail).wait();
+        CHECK_EQUAL(expected.substr(expected.size() - 20), std::string(tail.collection().begin(), tail.collection().end()));
+
+        std::vector<uint8_t> buffer(300 * 1024);
+        fill_buffer_and_get_md5(buffer);
+
+        wa::storage::blob_request_options options;
+        options.set_stream_write_size_in_bytes(16 * 1024);
+        options.set_parallelism_factor(4);
+        auto stream = m_blob.open_write(wa::storage::access_condition(), options, m_context);
+        stream.streambuf().putn(buffer.data(), buffer.size()).wait();
+        stream.close().wait();
+
+        auto committed_blocks = m_blob.download_block_list(wa::storage::block_listing_filter::committed, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(buffer.size() / (16 * 1024) + 1, committed_blocks.size());
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        m_blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+    }
+
     TEST_FIXTURE(block_blob_test_base, block_blob_constructor)
     {
         m_blob.upload_block_list(std::vector<wa::storage::block_list_item>(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
@@ -517,4 +1069,764 @@ SUITE(Blob)
 
         m_context.set_response_received(std::function<void(web::http::http_request &, const web::http::http_response&, wa::storage::operation_context)>());
     }
+
+    TEST(block_blob_resumable_upload)
+    {
+        // The transport keeps the blocks it receives and lists them as uncommitted, like the service would
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto blocks = std::make_shared<std::vector<utility::string_t>>();
+        auto put_block_count = std::make_shared<std::atomic<int>>(0);
+        auto blob_md5 = std::make_shared<utility::string_t>();
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, blocks, put_block_count, blob_md5, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            std::lock_guard<std::mutex> guard(*mutex);
+            if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("block")))
+            {
+                ++*put_block_count;
+                blocks->push_back(web::http::uri::decode(query[U("blockid")]));
+            }
+            else if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("blocklist")))
+            {
+                auto md5 = request.headers().find(U("x-ms-blob-content-md5"));
+                if (md5 != request.headers().end())
+                {
+                    *blob_md5 = md5->second;
+                }
+            }
+            else if ((request.method() == web::http::methods::GET) && (query[U("comp")] == U("blocklist")))
+            {
+                std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList><CommittedBlocks /><UncommittedBlocks>");
+                for (auto iter = blocks->cbegin(); iter != blocks->cend(); ++iter)
+                {
+                    body.append("<Block><Name>").append(utility::conversions::to_utf8string(*iter)).append("</Name><Size>65536</Size></Block>");
+                }
+
+                body.append("</UncommittedBlocks></BlockList>");
+                web::http::http_response response(web::http::status_codes::OK);
+                response.set_body(body, U("application/xml"));
+                return response;
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_parallelism_factor(1);
+        options.set_store_blob_content_md5(true);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto container = client.get_container_reference(U("container"));
+
+        std::vector<uint8_t> buffer(5 * 64 * 1024);
+        for (size_t i = 0; i < buffer.size(); ++i)
+        {
+            buffer[i] = static_cast<uint8_t>(i * 31);
+        }
+
+        auto upload = [&buffer] (wa::storage::cloud_block_blob& blob, const wa::storage::block_blob_upload_checkpoint& checkpoint, std::function<void (const wa::storage::block_blob_upload_checkpoint&)> handler)
+        {
+            auto source = concurrency::streams::bytestream::open_istream(buffer);
+            blob.upload_resumable_from_stream(source, buffer.size(), checkpoint, handler);
+        };
+
+        // An upload that is not interrupted commits all blocks
+        auto whole_blob = container.get_block_blob_reference(U("whole"));
+        upload(whole_blob, wa::storage::block_blob_upload_checkpoint(64 * 1024), std::function<void (const wa::storage::block_blob_upload_checkpoint&)>());
+        CHECK_EQUAL(5, *put_block_count);
+        auto expected_md5 = *blob_md5;
+        CHECK(!expected_md5.empty());
+
+        // The process stops while the third checkpoint is saved, after the service has received the third block
+        blocks->clear();
+        *put_block_count = 0;
+        utility::string_t saved_checkpoint;
+        int save_count = 0;
+        auto blob = container.get_block_blob_reference(U("resumed"));
+        CHECK_THROW(upload(blob, wa::storage::block_blob_upload_checkpoint(64 * 1024), [&saved_checkpoint, &save_count] (const wa::storage::block_blob_upload_checkpoint& checkpoint)
+        {
+            if (++save_count == 3)
+            {
+                throw std::runtime_error("stopped");
+            }
+
+            saved_checkpoint = checkpoint.to_string();
+        }), std::runtime_error);
+        CHECK_EQUAL(3, *put_block_count);
+
+        auto checkpoint = wa::storage::block_blob_upload_checkpoint::parse(saved_checkpoint);
+        CHECK_EQUAL(64 * 1024, checkpoint.block_size());
+        CHECK_EQUAL(2, checkpoint.completed_block_count());
+        CHECK_EQUAL(saved_checkpoint, checkpoint.to_string());
+
+        // Resuming sends only the blocks the service does not have, and the blob MD5 continues from the saved state
+        blob_md5->clear();
+        *put_block_count = 0;
+        upload(blob, checkpoint, std::function<void (const wa::storage::block_blob_upload_checkpoint&)>());
+        CHECK_EQUAL(2, *put_block_count);
+        CHECK_UTF8_EQUAL(expected_md5, *blob_md5);
+
+        CHECK_THROW(wa::storage::block_blob_upload_checkpoint::parse(U("block_size=65536")), std::invalid_argument);
+        CHECK_THROW(wa::storage::block_blob_upload_checkpoint(5 * 1024 * 1024), std::invalid_argument);
+    }
+
+    TEST(block_blob_parallel_download_blob_md5)
+    {
+        // The canned blob is all zeros, and the responses carry the MD5 of the whole blob as the service returns it with a range
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(256 * 1024);
+        auto transport_pointer = transport.get();
+        auto blob_md5 = std::make_shared<utility::string_t>();
+        transport->set_responder([transport_pointer, blob_md5] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto response = transport_pointer->default_response(request, batch_body);
+            response.headers().add(U("x-ms-blob-content-md5"), *blob_md5);
+            return response;
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_read_size_in_bytes(16 * 1024);
+        options.set_parallelism_factor(4);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        auto download = [&blob] (const wa::storage::blob_request_options& options)
+        {
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            blob.download_to_stream(buffer.create_ostream(), wa::storage::access_condition(), options, wa::storage::operation_context());
+            CHECK_EQUAL(256 * 1024, buffer.collection().size());
+        };
+
+        // The ranges are hashed in order however they complete
+        *blob_md5 = U("7IeoOJMdTV0ulKBGRHiKVQ==");
+        download(wa::storage::blob_request_options());
+        CHECK_UTF8_EQUAL(U("7IeoOJMdTV0ulKBGRHiKVQ=="), blob.properties().content_md5());
+
+        *blob_md5 = U("AAAAAAAAAAAAAAAAAAAAAA==");
+        CHECK_THROW(download(wa::storage::blob_request_options()), wa::storage::storage_exception);
+
+        wa::storage::blob_request_options no_validation;
+        no_validation.set_disable_content_md5_validation(true);
+        download(no_validation);
+    }
+
+    TEST(block_blob_transfer_progress)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(256 * 1024);
+
+        auto reports = std::make_shared<std::atomic<int>>(0);
+        auto last_reported = std::make_shared<std::atomic<utility::size64_t>>(0);
+        auto progress = std::make_shared<wa::storage::transfer_progress>([reports, last_reported] (utility::size64_t bytes)
+        {
+            ++*reports;
+            *last_reported = bytes;
+        }, std::chrono::hours(1));
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_read_size_in_bytes(16 * 1024);
+        options.set_stream_write_size_in_bytes(64 * 1024);
+        options.set_single_blob_upload_threshold_in_bytes(64 * 1024);
+        options.set_parallelism_factor(4);
+        options.set_transfer_progress(progress);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        // Every range of a parallel download is counted, and the handler is only called once within the interval
+        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+        blob.download_to_stream(buffer.create_ostream());
+        CHECK_EQUAL(256 * 1024, progress->bytes_transferred());
+        CHECK_EQUAL(1, *reports);
+
+        // Every block is counted, but not the block list that commits them
+        std::vector<uint8_t> content(5 * 64 * 1024);
+        blob.upload_from_stream(concurrency::streams::bytestream::open_istream(content), content.size());
+        CHECK_EQUAL((256 + 5 * 64) * 1024, progress->bytes_transferred());
+        CHECK_EQUAL(1, *reports);
+
+        progress->report();
+        CHECK_EQUAL(2, *reports);
+        CHECK_EQUAL(progress->bytes_transferred(), last_reported->load());
+    }
+
+    TEST(block_blob_write_stream_growing_blocks)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto block_sizes = std::make_shared<std::vector<utility::size64_t>>();
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, block_sizes, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("block")))
+            {
+                std::lock_guard<std::mutex> guard(*mutex);
+                block_sizes->push_back(request.headers().content_length());
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_write_size_in_bytes(256 * 1024);
+        options.set_initial_stream_write_size_in_bytes(64 * 1024);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        // Each block is as large as the ones before it together, up to the block size
+        std::vector<uint8_t> content(1024 * 1024 + 1);
+        auto stream = blob.open_write();
+        stream.streambuf().putn(content.data(), content.size()).wait();
+        stream.close().wait();
+
+        std::vector<utility::size64_t> expected;
+        expected.push_back(64 * 1024);
+        expected.push_back(64 * 1024);
+        expected.push_back(128 * 1024);
+        expected.push_back(256 * 1024);
+        expected.push_back(256 * 1024);
+        expected.push_back(256 * 1024);
+        expected.push_back(1);
+        CHECK(*block_sizes == expected);
+    }
+
+    TEST(block_blob_parallel_writer)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto block_sizes = std::make_shared<std::map<utility::string_t, utility::size64_t>>();
+        auto block_lists = std::make_shared<int>(0);
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, block_sizes, block_lists, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            if (request.method() == web::http::methods::PUT)
+            {
+                std::lock_guard<std::mutex> guard(*mutex);
+                if (query[U("comp")] == U("block"))
+                {
+                    (*block_sizes)[query[U("blockid")]] = request.headers().content_length();
+                }
+                else if (query[U("comp")] == U("blocklist"))
+                {
+                    ++*block_lists;
+                }
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_write_size_in_bytes(64 * 1024);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        wa::storage::block_blob_parallel_writer writer(blob);
+        writer.set_max_concurrent_uploads(2);
+        CHECK_EQUAL(0U, writer.claim_part());
+        CHECK_EQUAL(1U, writer.claim_part());
+
+        // The parts are uploaded at the same time, and a part larger than the block size is split into blocks
+        std::vector<uint8_t> first_part(64 * 1024);
+        std::vector<uint8_t> second_part(1);
+        std::vector<uint8_t> last_part(100 * 1024);
+        std::vector<pplx::task<void>> uploads;
+        uploads.push_back(writer.upload_part_async(5, concurrency::streams::bytestream::open_istream(last_part)));
+        uploads.push_back(writer.upload_part_async(1, concurrency::streams::bytestream::open_istream(second_part)));
+        uploads.push_back(writer.upload_part_async(0, concurrency::streams::bytestream::open_istream(first_part)));
+        CHECK_THROW(writer.upload_part_async(5, concurrency::streams::bytestream::open_istream(second_part)), std::invalid_argument);
+        CHECK_EQUAL(6U, writer.claim_part());
+        CHECK_EQUAL(3U, writer.part_count());
+
+        writer.commit();
+        for (auto iter = uploads.begin(); iter != uploads.end(); ++iter)
+        {
+            CHECK(iter->is_done());
+        }
+
+        // Every block has an ID of the same length, and the block list is only committed once
+        CHECK_EQUAL(4U, block_sizes->size());
+        utility::size64_t total_size = 0;
+        for (auto iter = block_sizes->cbegin(); iter != block_sizes->cend(); ++iter)
+        {
+            CHECK_EQUAL(block_sizes->cbegin()->first.size(), iter->first.size());
+            total_size += iter->second;
+        }
+
+        CHECK_EQUAL((64 + 100) * 1024 + 1, total_size);
+        CHECK_EQUAL(1, *block_lists);
+
+        CHECK_THROW(writer.upload_part_async(writer.claim_part(), concurrency::streams::bytestream::open_istream(second_part)), std::logic_error);
+        CHECK_THROW(writer.commit_async(), std::logic_error);
+    }
+
+    TEST(block_blob_upload_coordinator)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto block_sizes = std::make_shared<std::map<utility::string_t, utility::size64_t>>();
+        auto block_lists = std::make_shared<int>(0);
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, block_sizes, block_lists, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            std::lock_guard<std::mutex> guard(*mutex);
+            if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("block")))
+            {
+                (*block_sizes)[web::http::uri::decode(query[U("blockid")])] = request.headers().content_length();
+            }
+            else if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("blocklist")))
+            {
+                ++*block_lists;
+            }
+            else if ((request.method() == web::http::methods::GET) && (query[U("comp")] == U("blocklist")))
+            {
+                std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><BlockList><CommittedBlocks /><UncommittedBlocks>");
+                for (auto iter = block_sizes->cbegin(); iter != block_sizes->cend(); ++iter)
+                {
+                    body.append("<Block><Name>").append(utility::conversions::to_utf8string(iter->first)).append("</Name><Size>");
+                    body.append(utility::conversions::to_utf8string(utility::conversions::print_string(iter->second))).append("</Size></Block>");
+                }
+
+                body.append("</UncommittedBlocks></BlockList>");
+                web::http::http_response response(web::http::status_codes::OK);
+                response.set_body(body, U("application/xml"));
+                return response;
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_write_size_in_bytes(64 * 1024);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        CHECK_THROW(wa::storage::block_blob_upload_coordinator(blob, 0), std::invalid_argument);
+
+        // The assignments split the blocks of the blob evenly, and can be passed to the workers as text
+        wa::storage::block_blob_upload_coordinator coordinator(blob, 3);
+        CHECK_EQUAL(3U, coordinator.assignments().size());
+        std::vector<wa::storage::block_upload_assignment> assignments;
+        for (auto iter = coordinator.assignments().cbegin(); iter != coordinator.assignments().cend(); ++iter)
+        {
+            assignments.push_back(wa::storage::block_upload_assignment::parse(iter->to_string()));
+        }
+
+        CHECK_EQUAL(16666U, assignments[1].first_block());
+        CHECK_EQUAL(16666U, assignments[1].max_block_count());
+        CHECK(assignments[2].get_block_id(0) == coordinator.assignments()[2].get_block_id(0));
+        CHECK_EQUAL(assignments[0].get_block_id(0).size(), assignments[2].get_block_id(16665).size());
+        CHECK_THROW(wa::storage::block_upload_assignment::parse(U("version=1\n")), std::invalid_argument);
+
+        // Each part is uploaded separately, and a part larger than the block size is split into blocks
+        std::vector<uint8_t> first_part(100 * 1024);
+        std::vector<uint8_t> second_part(1);
+        std::vector<wa::storage::block_upload_receipt> receipts;
+        receipts.push_back(wa::storage::block_blob_upload_coordinator::upload_part(blob, assignments[2], concurrency::streams::bytestream::open_istream(std::vector<uint8_t>())));
+        receipts.push_back(wa::storage::block_blob_upload_coordinator::upload_part(blob, assignments[1], concurrency::streams::bytestream::open_istream(second_part)));
+        receipts.push_back(wa::storage::block_upload_receipt::parse(wa::storage::block_blob_upload_coordinator::upload_part(blob, assignments[0], concurrency::streams::bytestream::open_istream(first_part)).to_string()));
+        CHECK_EQUAL(0U, receipts[2].part_index());
+        CHECK_EQUAL(2U, receipts[2].block_count());
+        CHECK_EQUAL(100U * 1024, receipts[2].length());
+        CHECK_EQUAL(0U, receipts[0].block_count());
+        CHECK_EQUAL(3U, block_sizes->size());
+
+        // Nothing is committed without a receipt for every part, or if a block of a receipt is missing
+        std::vector<wa::storage::block_upload_receipt> missing_receipt(receipts.begin(), receipts.begin() + 2);
+        CHECK_THROW(coordinator.commit(missing_receipt), std::invalid_argument);
+        std::vector<wa::storage::block_upload_receipt> wrong_length(receipts);
+        wrong_length[1] = wa::storage::block_upload_receipt(1, 1, 2);
+        CHECK_THROW(coordinator.commit(wrong_length), wa::storage::storage_exception);
+        CHECK_EQUAL(0, *block_lists);
+
+        // The block list of all the parts is committed with a single request
+        coordinator.commit(receipts);
+        CHECK_EQUAL(1, *block_lists);
+    }
+
+    TEST(block_blob_log_writer)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto block_sizes = std::make_shared<std::vector<utility::size64_t>>();
+        auto block_list_reads = std::make_shared<int>(0);
+        auto block_list_writes = std::make_shared<int>(0);
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, block_sizes, block_list_reads, block_list_writes, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            std::lock_guard<std::mutex> guard(*mutex);
+            if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("block")))
+            {
+                block_sizes->push_back(request.headers().content_length());
+            }
+            else if (query[U("comp")] == U("blocklist"))
+            {
+                ++*(request.method() == web::http::methods::GET ? block_list_reads : block_list_writes);
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        wa::storage::block_blob_log_writer writer(blob);
+        writer.set_max_block_size(1000);
+        writer.set_max_batch_delay(std::chrono::hours(1));
+
+        std::vector<uint8_t> record(300);
+        CHECK_THROW(writer.append_async(record.data(), 1001), std::invalid_argument);
+
+        // Three records fill a block, and the fourth one starts the next block
+        std::vector<pplx::task<void>> appends;
+        for (int i = 0; i < 10; ++i)
+        {
+            appends.push_back(writer.append_async(record.data(), record.size()));
+        }
+
+        appends.front().wait();
+        CHECK(!appends.back().is_done());
+
+        writer.flush();
+        for (auto iter = appends.begin(); iter != appends.end(); ++iter)
+        {
+            CHECK(iter->is_done());
+        }
+
+        // The blocks are uploaded at the same time, so they can arrive in any order
+        std::vector<utility::size64_t> expected;
+        expected.push_back(300);
+        expected.push_back(900);
+        expected.push_back(900);
+        expected.push_back(900);
+        std::sort(block_sizes->begin(), block_sizes->end());
+        CHECK(*block_sizes == expected);
+
+        // The blocks the blob had are only read once, and the blocks uploaded during a commit are committed together
+        CHECK_EQUAL(1, *block_list_reads);
+        CHECK(*block_list_writes >= 1 && *block_list_writes <= 4);
+    }
+
+    class framing_block_codec : public wa::storage::block_codec
+    {
+    public:
+
+        framing_block_codec()
+            : m_compressed(0), m_decompressed(0)
+        {
+        }
+
+        utility::string_t content_encoding() const
+        {
+            return U("framed");
+        }
+
+        // Every frame starts with a marker byte
+        std::vector<uint8_t> compress(const uint8_t* data, size_t length)
+        {
+            ++m_compressed;
+            std::vector<uint8_t> frame(1, 0xFF);
+            frame.insert(frame.end(), data, data + length);
+            return frame;
+        }
+
+        std::vector<uint8_t> decompress(const uint8_t* data, size_t length)
+        {
+            ++m_decompressed;
+            return std::vector<uint8_t>(data + 1, data + length);
+        }
+
+        std::atomic<int> m_compressed;
+        std::atomic<int> m_decompressed;
+    };
+
+    TEST(block_blob_compressed_transfer)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(1001);
+        auto transport_pointer = transport.get();
+        auto block_sizes = std::make_shared<std::vector<utility::size64_t>>();
+        auto content_encoding = std::make_shared<utility::string_t>();
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([transport_pointer, block_sizes, content_encoding, mutex] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            if (request.method() == web::http::methods::PUT)
+            {
+                std::lock_guard<std::mutex> guard(*mutex);
+                if (query[U("comp")] == U("block"))
+                {
+                    block_sizes->push_back(request.headers().content_length());
+                }
+                else if (query[U("comp")] == U("blocklist"))
+                {
+                    auto header = request.headers().find(U("x-ms-blob-content-encoding"));
+                    *content_encoding = header != request.headers().end() ? header->second : utility::string_t();
+                }
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_write_size_in_bytes(64 * 1024);
+        options.set_parallelism_factor(2);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        // Every block is compressed on its own, and the blob gets the content encoding of the codec
+        auto codec = std::make_shared<framing_block_codec>();
+        std::vector<uint8_t> content(3 * 64 * 1024 + 100);
+        blob.upload_compressed_from_stream(concurrency::streams::bytestream::open_istream(content), codec);
+        CHECK_EQUAL(4, codec->m_compressed);
+        std::sort(block_sizes->begin(), block_sizes->end());
+        CHECK_EQUAL(4U, block_sizes->size());
+        CHECK_EQUAL(101U, block_sizes->front());
+        CHECK_EQUAL(64U * 1024 + 1, block_sizes->back());
+        CHECK(*content_encoding == U("framed"));
+
+        // Without committed blocks, the blob is decompressed as a whole
+        concurrency::streams::container_buffer<std::vector<uint8_t>> target;
+        blob.download_decompressed_to_stream(target.create_ostream(), codec);
+        CHECK_EQUAL(1, codec->m_decompressed);
+        CHECK_EQUAL(1000U, target.collection().size());
+    }
+
+    TEST(block_blob_upload_trace)
+    {
+        auto tracer = std::make_shared<wa::storage::chrome_trace_writer>();
+
+        wa::storage::blob_request_options options;
+        options.set_transport(std::make_shared<wa::storage::in_memory_transport>());
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_stream_write_size_in_bytes(64 * 1024);
+        options.set_single_blob_upload_threshold_in_bytes(64 * 1024);
+        options.set_parallelism_factor(4);
+        options.set_tracer(tracer);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        wa::storage::operation_context context;
+        std::vector<uint8_t> content(5 * 64 * 1024);
+        blob.upload_from_stream(concurrency::streams::bytestream::open_istream(content), content.size(), wa::storage::access_condition(), wa::storage::blob_request_options(), context);
+
+        // Every block and the block list is an operation of its own, with one attempt and the phases of that attempt below it
+        auto spans = tracer->spans();
+        std::map<uint64_t, wa::storage::trace_span> by_id;
+        int operations = 0;
+        for (auto iter = spans.cbegin(); iter != spans.cend(); ++iter)
+        {
+            CHECK(iter->client_request_id() == context.client_request_id());
+            by_id[iter->span_id()] = *iter;
+            if (iter->kind() == wa::storage::trace_span_kind::operation)
+            {
+                ++operations;
+                CHECK_EQUAL(0U, iter->parent_id());
+                CHECK_EQUAL(iter->span_id(), iter->operation_id());
+            }
+        }
+
+        CHECK_EQUAL(6, operations);
+        for (auto iter = spans.cbegin(); iter != spans.cend(); ++iter)
+        {
+            if (iter->kind() == wa::storage::trace_span_kind::operation)
+            {
+                continue;
+            }
+
+            auto parent = by_id.find(iter->parent_id());
+            CHECK(parent != by_id.end());
+            if (parent != by_id.end())
+            {
+                CHECK(parent->second.kind() == (iter->kind() == wa::storage::trace_span_kind::attempt ? wa::storage::trace_span_kind::operation : wa::storage::trace_span_kind::attempt));
+                CHECK(iter->start_time() >= parent->second.start_time());
+            }
+        }
+
+        auto trace = tracer->to_json();
+        CHECK_EQUAL(spans.size() + 1, trace[U("traceEvents")].size());
+    }
+
+    TEST(block_blob_upload_creates_missing_container)
+    {
+        // Blob uploads fail with ContainerNotFound until the container is created, which waits until every upload has failed once
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto not_found_count = std::make_shared<std::atomic<int>>(0);
+        auto create_count = std::make_shared<std::atomic<int>>(0);
+        auto is_created = std::make_shared<std::atomic<bool>>(false);
+        transport->set_responder([transport_pointer, not_found_count, create_count, is_created] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            if ((request.method() == web::http::methods::PUT) && (query[U("restype")] == U("container")))
+            {
+                ++*create_count;
+                for (int i = 0; (i < 500) && (*not_found_count < 3); ++i)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+
+                *is_created = true;
+                return web::http::http_response(web::http::status_codes::Created);
+            }
+
+            if ((request.method() == web::http::methods::PUT) && !*is_created)
+            {
+                ++*not_found_count;
+                web::http::http_response response(web::http::status_codes::NotFound);
+                response.set_body(std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?><Error><Code>ContainerNotFound</Code><Message>The specified container does not exist.</Message></Error>"), U("application/xml"));
+                return response;
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto container = client.get_container_reference(U("container"));
+
+        // Without the option, the upload fails
+        auto blob = container.get_block_blob_reference(U("blob"));
+        CHECK_THROW(blob.upload_text(U("text")), wa::storage::storage_exception);
+        *not_found_count = 0;
+
+        // Uploads that fail at the same time share a single creation of the container, and are then sent again
+        wa::storage::blob_request_options create_options;
+        create_options.set_create_container_if_not_found(true);
+        std::vector<wa::storage::cloud_block_blob> blobs;
+        std::vector<pplx::task<void>> uploads;
+        for (int i = 0; i < 3; ++i)
+        {
+            blobs.push_back(container.get_block_blob_reference(U("blob") + utility::conversions::print_string(i)));
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            uploads.push_back(blobs[i].upload_text_async(U("text"), wa::storage::access_condition(), create_options, wa::storage::operation_context()));
+        }
+
+        pplx::when_all(uploads.begin(), uploads.end()).wait();
+        CHECK_EQUAL(3, not_found_count->load());
+        CHECK_EQUAL(1, create_count->load());
+
+        // Once the container exists, an upload takes a single request
+        wa::storage::operation_context context;
+        blobs[0].upload_text(U("more text"), wa::storage::access_condition(), create_options, context);
+        CHECK_EQUAL(1U, context.request_results().size());
+    }
+
+    TEST(block_blob_upload_seekable_source)
+    {
+        // The second Put Block request fails with a server error once, and is sent again
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto put_block_count = std::make_shared<std::atomic<int>>(0);
+        auto failed_put_block = std::make_shared<std::atomic<int>>(1);
+        transport->set_responder([transport_pointer, put_block_count, failed_put_block] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            if ((request.method() == web::http::methods::PUT) && (query[U("comp")] == U("block")) && ((*put_block_count)++ == *failed_put_block))
+            {
+                return web::http::http_response(web::http::status_codes::InternalError);
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        const size_t block_size = 64 * 1024;
+        const size_t offset = 1000;
+        std::vector<uint8_t> buffer(offset + 3 * block_size + 1234);
+        auto expected_md5 = blob_service_test_base::fill_buffer_and_get_md5(buffer, offset, buffer.size() - offset);
+        auto length = buffer.size() - offset;
+
+        wa::storage::blob_request_options options;
+        options.set_retry_policy(wa::storage::linear_retry_policy(std::chrono::seconds(0), 3));
+        options.set_stream_write_size_in_bytes(block_size);
+        options.set_single_blob_upload_threshold_in_bytes(block_size);
+        options.set_parallelism_factor(1);
+        options.set_use_transactional_md5(true);
+        options.set_store_blob_content_md5(true);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto container = client.get_container_reference(U("container"));
+
+        // A seekable source that is not at its beginning is sent block by block from where it is
+        auto seekable = std::make_shared<block_recording_transport>(transport);
+        wa::storage::blob_request_options seekable_options;
+        seekable_options.set_transport(seekable);
+        auto source = concurrency::streams::bytestream::open_istream(buffer);
+        source.seek(offset);
+        auto seekable_blob = container.get_block_blob_reference(U("seekable"));
+        seekable_blob.upload_from_stream(source, length, wa::storage::access_condition(), seekable_options, wa::storage::operation_context());
+
+        // The blocks are whole but for the last one, and the failed block is read again from the same range of the source
+        auto blocks = seekable->blocks();
+        CHECK_EQUAL(5U, blocks.size());
+        if (blocks.size() == 5U)
+        {
+            CHECK(blocks[1].block_id == blocks[2].block_id);
+            CHECK(blocks[1].content_md5 == blocks[2].content_md5);
+            CHECK(blocks[1].body == blocks[2].body);
+            blocks.erase(blocks.begin() + 1);
+
+            size_t block_offset = offset;
+            for (size_t i = 0; i < blocks.size(); ++i)
+            {
+                auto block_length = std::min(block_size, buffer.size() - block_offset);
+                CHECK_EQUAL(block_length, blocks[i].body.size());
+                CHECK(std::equal(blocks[i].body.cbegin(), blocks[i].body.cend(), buffer.cbegin() + block_offset));
+                CHECK(get_md5(blocks[i].body) == blocks[i].content_md5);
+                block_offset += block_length;
+            }
+
+            CHECK_EQUAL(buffer.size(), block_offset);
+            CHECK_EQUAL(1234U, blocks.back().body.size());
+        }
+
+        CHECK(expected_md5 == seekable->blob_md5());
+        CHECK(expected_md5 == seekable_blob.properties().content_md5());
+
+        // The MD5s calculated in place are those of a source that has to be copied into buffers before it is sent
+        concurrency::streams::producer_consumer_buffer<uint8_t> non_seekable_buffer;
+        non_seekable_buffer.putn(buffer.data() + offset, length).wait();
+        non_seekable_buffer.close(std::ios_base::out).wait();
+
+        *failed_put_block = -1;
+        auto buffered = std::make_shared<block_recording_transport>(transport);
+        wa::storage::blob_request_options buffered_options;
+        buffered_options.set_transport(buffered);
+        auto buffered_blob = container.get_block_blob_reference(U("buffered"));
+        buffered_blob.upload_from_stream(non_seekable_buffer.create_istream(), length, wa::storage::access_condition(), buffered_options, wa::storage::operation_context());
+
+        auto buffered_blocks = buffered->blocks();
+        CHECK_EQUAL(blocks.size(), buffered_blocks.size());
+        for (size_t i = 0; i < std::min(blocks.size(), buffered_blocks.size()); ++i)
+        {
+            CHECK(blocks[i].content_md5 == buffered_blocks[i].content_md5);
+            CHECK(blocks[i].body == buffered_blocks[i].body);
+        }
+
+        CHECK(seekable->blob_md5() == buffered->blob_md5());
+    }
 }
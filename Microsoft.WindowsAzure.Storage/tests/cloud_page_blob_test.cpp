@@ -18,6 +18,7 @@
 #include "stdafx.h"
 #include "blob_test_base.h"
 #include "check_macros.h"
+#include "was/in_memory_transport.h"
 
 #pragma region Fixture
 
@@ -232,6 +233,186 @@ SUITE(Blob)
         m_blob.properties().set_content_md5(utility::string_t());
     }
 
+    TEST_FIXTURE(page_blob_test_base, page_blob_upload_skip_zero_pages)
+    {
+        wa::storage::blob_request_options options;
+        options.set_skip_zero_pages(true);
+        options.set_parallelism_factor(2);
+        options.set_stream_write_size_in_bytes(64 * 1024);
+        options.set_use_transactional_md5(true);
+
+        std::vector<uint8_t> buffer;
+        buffer.resize(4 * 64 * 1024);
+        fill_buffer_and_get_md5(buffer);
+
+        // The runs of data start and end inside and at the edges of the write buffers
+        std::vector<wa::storage::page_range> pages;
+        pages.push_back(wa::storage::page_range(0, 2 * 512 - 1));
+        pages.push_back(wa::storage::page_range(60 * 1024, 70 * 1024 - 1));
+        pages.push_back(wa::storage::page_range(3 * 64 * 1024, buffer.size() - 512 - 1));
+
+        int64_t zero_begin = 0;
+        for (auto iter = pages.cbegin(); iter != pages.cend(); ++iter)
+        {
+            std::fill(buffer.begin() + zero_begin, buffer.begin() + iter->start_offset(), 0);
+            zero_begin = iter->end_offset() + 1;
+        }
+
+        std::fill(buffer.begin() + zero_begin, buffer.end(), 0);
+
+        // A new blob is still all zeros, so the zero pages are not sent
+        m_blob.upload_from_stream(concurrency::streams::bytestream::open_istream(buffer), wa::storage::access_condition(), options, m_context);
+        check_page_ranges_equal(pages);
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        m_blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), options, m_context);
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+
+        // Writing to an existing blob clears the zero pages instead
+        std::vector<uint8_t> full_buffer(buffer.size());
+        fill_buffer_and_get_md5(full_buffer);
+        m_blob.upload_from_stream(concurrency::streams::bytestream::open_istream(full_buffer), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        auto stream = m_blob.open_write(wa::storage::access_condition(), options, m_context);
+        stream.streambuf().putn(buffer.data(), buffer.size()).wait();
+        stream.close().wait();
+        check_page_ranges_equal(pages);
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> cleared_output_buffer;
+        m_blob.download_to_stream(cleared_output_buffer.create_ostream(), wa::storage::access_condition(), options, m_context);
+        CHECK_EQUAL(buffer.size(), cleared_output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), cleared_output_buffer.collection().data(), buffer.size());
+    }
+
+    TEST_FIXTURE(page_blob_test_base, page_blob_open_write_parallel)
+    {
+        std::vector<uint8_t> buffer(12 * 1024 * 1024);
+        fill_buffer_and_get_md5(buffer);
+
+        // Larger or unaligned write sizes are reduced to whole pages of at most 4 MB
+        wa::storage::blob_request_options options;
+        options.set_stream_write_size_in_bytes(5 * 1024 * 1024 + 100);
+        options.set_parallelism_factor(4);
+
+        wa::storage::operation_context context;
+        auto stream = m_blob.open_write(buffer.size(), wa::storage::access_condition(), options, context);
+        CHECK_EQUAL(4U * 1024 * 1024, stream.streambuf().buffer_size(std::ios_base::out));
+        stream.streambuf().set_buffer_size(1000, std::ios_base::out);
+        CHECK_EQUAL(512U, stream.streambuf().buffer_size(std::ios_base::out));
+        stream.streambuf().set_buffer_size(4 * 1024 * 1024, std::ios_base::out);
+
+        stream.streambuf().putn(buffer.data(), buffer.size()).wait();
+        stream.close().wait();
+
+        // Creating the blob, then three page writes at the same time
+        CHECK_EQUAL(4U, context.request_results().size());
+        check_parallelism(context, 3);
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        m_blob.download_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+    }
+
+    TEST_FIXTURE(page_blob_test_base, page_blob_download_sparse)
+    {
+        const utility::string_t target_path(U("page_blob_download_sparse_target.tmp"));
+
+        std::vector<uint8_t> buffer(512 * 1024);
+        m_blob.create(buffer.size(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        std::vector<wa::storage::page_range> pages;
+        pages.push_back(wa::storage::page_range(4 * 1024, 12 * 1024 - 1));
+        pages.push_back(wa::storage::page_range(100 * 1024, 300 * 1024 - 1));
+
+        for (auto iter = pages.cbegin(); iter != pages.cend(); ++iter)
+        {
+            std::vector<uint8_t> page_data(static_cast<size_t>(iter->end_offset() - iter->start_offset() + 1));
+            fill_buffer_and_get_md5(page_data);
+            std::copy(page_data.begin(), page_data.end(), buffer.begin() + iter->start_offset());
+            m_blob.upload_pages(concurrency::streams::bytestream::open_istream(page_data), iter->start_offset(), utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        }
+
+        // The second valid range is downloaded in several pieces at once
+        wa::storage::blob_request_options options;
+        options.set_parallelism_factor(4);
+        options.set_stream_read_size_in_bytes(64 * 1024);
+        options.set_use_transactional_md5(true);
+
+        wa::storage::operation_context context;
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer;
+        m_blob.download_sparse_to_stream(output_buffer.create_ostream(), wa::storage::access_condition(), options, context);
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+
+        // Listing the page ranges, then one piece of the first range and four of the second
+        CHECK_EQUAL(6U, context.request_results().size());
+
+        m_blob.download_sparse_to_file(target_path, wa::storage::access_condition(), options, m_context);
+        {
+            std::ifstream target_file(target_path, std::ios::binary);
+            std::vector<char> target_buffer((std::istreambuf_iterator<char>(target_file)), std::istreambuf_iterator<char>());
+            CHECK_EQUAL(buffer.size(), target_buffer.size());
+            CHECK_ARRAY_EQUAL(reinterpret_cast<const char*>(buffer.data()), target_buffer.data(), buffer.size());
+        }
+
+        concurrency::streams::producer_consumer_buffer<uint8_t> non_seekable_buffer;
+        CHECK_THROW(m_blob.download_sparse_to_stream(non_seekable_buffer.create_ostream(), wa::storage::access_condition(), options, m_context), std::logic_error);
+
+        std::remove(utility::conversions::to_utf8string(target_path).c_str());
+    }
+
+    TEST_FIXTURE(page_blob_test_base, page_blob_download_changes)
+    {
+        std::vector<uint8_t> buffer(256 * 1024);
+        m_blob.create(buffer.size(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        fill_buffer_and_get_md5(buffer);
+        m_blob.upload_pages(concurrency::streams::bytestream::open_istream(buffer), 0, utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        auto snapshot = m_blob.create_snapshot(wa::storage::cloud_metadata(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> replica_buffer;
+        wa::storage::cloud_page_blob(m_blob.name(), snapshot.snapshot_time(), m_container).download_to_stream(replica_buffer.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(buffer.size(), replica_buffer.collection().size());
+
+        std::vector<uint8_t> page_data(16 * 1024);
+        fill_buffer_and_get_md5(page_data);
+        std::copy(page_data.begin(), page_data.end(), buffer.begin() + 16 * 1024);
+        m_blob.upload_pages(concurrency::streams::bytestream::open_istream(page_data), 16 * 1024, utility::string_t(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        std::fill(buffer.begin() + 128 * 1024, buffer.begin() + 144 * 1024, static_cast<uint8_t>(0));
+        m_blob.clear_pages(128 * 1024, 16 * 1024, wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+
+        auto ranges = m_blob.download_page_ranges_diff(snapshot.snapshot_time(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context);
+        CHECK_EQUAL(2U, ranges.size());
+        for (auto iter = ranges.cbegin(); iter != ranges.cend(); ++iter)
+        {
+            if (iter->is_cleared())
+            {
+                CHECK_EQUAL(128 * 1024, iter->start_offset());
+                CHECK_EQUAL(144 * 1024 - 1, iter->end_offset());
+            }
+            else
+            {
+                CHECK_EQUAL(16 * 1024, iter->start_offset());
+                CHECK_EQUAL(32 * 1024 - 1, iter->end_offset());
+            }
+        }
+
+        // Only the written range is downloaded
+        wa::storage::operation_context context;
+        concurrency::streams::container_buffer<std::vector<uint8_t>> output_buffer(std::move(replica_buffer.collection()), std::ios_base::out);
+        auto output_stream = output_buffer.create_ostream();
+        output_stream.seek(0);
+        m_blob.download_changes_to_stream(output_stream, snapshot.snapshot_time(), wa::storage::access_condition(), wa::storage::blob_request_options(), context);
+        CHECK_EQUAL(2U, context.request_results().size());
+        CHECK_EQUAL(buffer.size(), output_buffer.collection().size());
+        CHECK_ARRAY_EQUAL(buffer.data(), output_buffer.collection().data(), buffer.size());
+
+        concurrency::streams::producer_consumer_buffer<uint8_t> non_seekable_buffer;
+        CHECK_THROW(m_blob.download_changes_to_stream(non_seekable_buffer.create_ostream(), snapshot.snapshot_time(), wa::storage::access_condition(), wa::storage::blob_request_options(), m_context), std::logic_error);
+    }
+
     TEST_FIXTURE(page_blob_test_base, page_blob_upload_with_nonseekable)
     {
         const size_t size = 6 * 1024 * 1024;
@@ -406,4 +587,189 @@ SUITE(Blob)
 
         m_context.set_response_received(std::function<void(web::http::http_request &, const web::http::http_response&, wa::storage::operation_context)>());
     }
+
+    TEST(page_blob_write_cache)
+    {
+        // The transport fills the ranges that are read with a pattern, and records the ranges that are written
+        const size_t blob_size = 64 * 1024;
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto reads = std::make_shared<std::vector<utility::string_t>>();
+        auto writes = std::make_shared<std::vector<utility::string_t>>();
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([reads, writes, mutex, blob_size] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            auto range = request.headers().find(U("x-ms-range"))->second;
+            std::lock_guard<std::mutex> guard(*mutex);
+            if (request.method() == web::http::methods::PUT)
+            {
+                writes->push_back(range);
+                web::http::http_response response(web::http::status_codes::Created);
+                response.headers().add(web::http::header_names::etag, U("\"0x8D0B3F4E5A6C7D8\""));
+                response.headers().add(web::http::header_names::last_modified, utility::datetime::utc_now().to_string());
+                return response;
+            }
+
+            reads->push_back(range);
+            auto separator = range.find(U('-'));
+            size_t start = std::stoul(utility::conversions::to_utf8string(range.substr(6, separator - 6)));
+            size_t end = std::stoul(utility::conversions::to_utf8string(range.substr(separator + 1)));
+            std::vector<unsigned char> body(end - start + 1);
+            for (size_t i = 0; i < body.size(); ++i)
+            {
+                body[i] = static_cast<unsigned char>((start + i) % 251);
+            }
+
+            web::http::http_response response(web::http::status_codes::PartialContent);
+            response.set_body(body);
+            response.headers().set_content_type(U("application/octet-stream"));
+            response.headers().add(U("x-ms-blob-type"), U("PageBlob"));
+            response.headers().add(web::http::header_names::etag, U("\"0x8D0B3F4E5A6C7D8\""));
+            response.headers().add(web::http::header_names::last_modified, utility::datetime::utc_now().to_string());
+            utility::ostringstream_t content_range;
+            content_range << U("bytes ") << start << U('-') << end << U('/') << blob_size;
+            response.headers().add(web::http::header_names::content_range, content_range.str());
+            return response;
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_page_blob_reference(U("blob"));
+
+        wa::storage::page_blob_write_cache cache(blob);
+        cache.set_flush_interval(std::chrono::milliseconds(0));
+
+        std::vector<uint8_t> expected(blob_size);
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            expected[i] = static_cast<uint8_t>(i % 251);
+        }
+
+        auto write = [&cache, &expected] (size_t offset, size_t length, uint8_t value)
+        {
+            std::vector<uint8_t> data(length, value);
+            cache.write(data.data(), data.size(), offset);
+            std::fill(expected.begin() + offset, expected.begin() + offset + length, value);
+        };
+
+        // Writes that do not cover whole pages read the rest of their first and last pages, and overlapping writes are merged
+        write(10, 100, 1);
+        CHECK_EQUAL(1U, reads->size());
+        write(600, 1000, 2);
+        CHECK_EQUAL(3U, reads->size());
+        write(512, 512, 3);
+        write(1024, 1024, 4);
+        CHECK_EQUAL(3U, reads->size());
+        CHECK(writes->empty());
+        CHECK_EQUAL(4U * 512U, cache.dirty_size());
+
+        auto data = cache.read(0, 4096);
+        CHECK_EQUAL(4U, reads->size());
+        CHECK_ARRAY_EQUAL(expected.data(), data.data(), data.size());
+
+        // The adjacent dirty pages are written with a single request, after which they are clean
+        cache.flush();
+        CHECK_EQUAL(1U, writes->size());
+        CHECK_UTF8_EQUAL(U("bytes=0-2047"), (*writes)[0]);
+        CHECK_EQUAL(0U, cache.dirty_size());
+        CHECK_EQUAL(8U * 512U, cache.cached_size());
+
+        data = cache.read(0, 4096);
+        CHECK_EQUAL(4U, reads->size());
+        CHECK_ARRAY_EQUAL(expected.data(), data.data(), data.size());
+
+        // Runs that are not adjacent are written separately
+        write(8192, 512, 5);
+        write(16384, 1024, 6);
+        cache.flush();
+        CHECK_EQUAL(3U, writes->size());
+        CHECK_EQUAL(4U, reads->size());
+
+        // A flush starts by itself once the maximum dirty size is reached
+        cache.set_max_dirty_size(2048);
+        write(32768, 2048, 7);
+        cache.flush();
+        CHECK_EQUAL(4U, writes->size());
+
+        // Clean pages above the maximum clean size are dropped, and read again when they are needed
+        cache.set_max_clean_size(1024);
+        CHECK_EQUAL(1024U, cache.cached_size());
+        data = cache.read(2048, 1024);
+        CHECK_EQUAL(5U, reads->size());
+        CHECK_ARRAY_EQUAL(expected.data() + 2048, data.data(), data.size());
+    }
+
+    TEST(page_blob_windowed_page_ranges)
+    {
+        // The transport lists every valid range that overlaps the requested range, without cutting it to the request
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto requests = std::make_shared<int>(0);
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([requests, mutex] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            const int64_t valid_ranges[][2] = { { 0, 5119 }, { 8192, 8703 }, { 9216, 12287 } };
+            auto range = request.headers().find(U("x-ms-range"))->second;
+            auto separator = range.find(U('-'));
+            int64_t start = std::stoll(utility::conversions::to_utf8string(range.substr(6, separator - 6)));
+            int64_t end = std::stoll(utility::conversions::to_utf8string(range.substr(separator + 1)));
+
+            std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><PageList>");
+            for (size_t i = 0; i < 3; ++i)
+            {
+                if ((valid_ranges[i][0] <= end) && (valid_ranges[i][1] >= start))
+                {
+                    body.append("<PageRange><Start>").append(std::to_string(valid_ranges[i][0])).append("</Start><End>").append(std::to_string(valid_ranges[i][1])).append("</End></PageRange>");
+                }
+            }
+
+            body.append("</PageList>");
+            {
+                std::lock_guard<std::mutex> guard(*mutex);
+                ++*requests;
+            }
+
+            web::http::http_response response(web::http::status_codes::OK);
+            response.set_body(body, U("application/xml"));
+            response.headers().add(U("x-ms-blob-content-length"), U("16384"));
+            response.headers().add(web::http::header_names::etag, U("\"0x8D0B3F4E5A6C7D8\""));
+            response.headers().add(web::http::header_names::last_modified, utility::datetime::utc_now().to_string());
+            return response;
+        });
+
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        options.set_parallelism_factor(2);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto blob = client.get_container_reference(U("container")).get_page_blob_reference(U("blob"));
+
+        // Every window is listed with its own request, and ranges are passed in order, once, across window boundaries
+        std::vector<wa::storage::page_range> ranges;
+        blob.download_page_ranges(0, 16384, 4096, [&ranges] (const wa::storage::page_range& range) -> bool
+        {
+            ranges.push_back(range);
+            return true;
+        }, wa::storage::access_condition(), wa::storage::blob_request_options(), wa::storage::operation_context());
+
+        CHECK_EQUAL(4, *requests);
+        CHECK_EQUAL(3U, ranges.size());
+        CHECK_EQUAL(0, ranges[0].start_offset());
+        CHECK_EQUAL(5119, ranges[0].end_offset());
+        CHECK_EQUAL(8192, ranges[1].start_offset());
+        CHECK_EQUAL(8703, ranges[1].end_offset());
+        CHECK_EQUAL(9216, ranges[2].start_offset());
+        CHECK_EQUAL(12287, ranges[2].end_offset());
+
+        // Returning false from the handler stops the listing
+        ranges.clear();
+        blob.download_page_ranges(0, 16384, 4096, [&ranges] (const wa::storage::page_range& range) -> bool
+        {
+            ranges.push_back(range);
+            return false;
+        }, wa::storage::access_condition(), wa::storage::blob_request_options(), wa::storage::operation_context());
+
+        CHECK_EQUAL(1U, ranges.size());
+        CHECK_THROW(blob.download_page_ranges_async(0, 16384, 1000, [] (const wa::storage::page_range&) -> bool { return true; }, wa::storage::access_condition(), wa::storage::blob_request_options(), wa::storage::operation_context()), std::invalid_argument);
+    }
 }
@@ -16,8 +16,70 @@
 // -----------------------------------------------------------------------------------------
 
 #include "stdafx.h"
+#include "test_base.h"
 #include "test_helper.h"
+#include "check_macros.h"
+#include "was/in_memory_transport.h"
 #include "was/queue.h"
+#include "wascore/constants.h"
+#include "wascore/protocol.h"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace
+{
+    struct recorded_request
+    {
+        explicit recorded_request(const web::http::http_request& request)
+            : method(request.method()), uri(request.request_uri()), headers(request.headers())
+        {
+        }
+
+        web::http::method method;
+        web::http::uri uri;
+        web::http::http_headers headers;
+    };
+
+    // Checks that a request was signed as it would be if its whole string to sign had been built for it
+    void check_signature(const recorded_request& recorded)
+    {
+        web::http::http_request request(recorded.method);
+        request.set_request_uri(recorded.uri);
+        request.headers() = recorded.headers;
+
+        wa::storage::protocol::shared_key_blob_queue_canonicalizer canonicalizer(U("account"));
+        auto signature = wa::storage::protocol::calculate_hmac_sha256_hash(canonicalizer.canonicalize(request, wa::storage::operation_context()), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")));
+
+        utility::string_t authorization;
+        CHECK(recorded.headers.match(web::http::header_names::authorization, authorization));
+        CHECK_UTF8_EQUAL(canonicalizer.authentication_scheme() + U(" account:") + signature, authorization);
+    }
+
+    // Checks that a request has the URI and the headers of one that was built in full, besides those added when it was sent
+    void check_unprepared(const recorded_request& recorded, const web::http::http_request& expected)
+    {
+        CHECK_UTF8_EQUAL(expected.method(), recorded.method);
+        CHECK_UTF8_EQUAL(expected.request_uri().to_string(), recorded.uri.to_string());
+
+        for (auto iter = expected.headers().begin(); iter != expected.headers().end(); ++iter)
+        {
+            utility::string_t value;
+            CHECK(recorded.headers.match(iter->first, value));
+            CHECK_UTF8_EQUAL(iter->second, value);
+        }
+
+        for (auto iter = recorded.headers.begin(); iter != recorded.headers.end(); ++iter)
+        {
+            if (iter->first != wa::storage::protocol::ms_header_date && iter->first != wa::storage::protocol::ms_header_client_request_id && iter->first != web::http::header_names::authorization)
+            {
+                CHECK(expected.headers().has(iter->first));
+            }
+        }
+    }
+}
 
 SUITE(Queue)
 {
@@ -121,6 +183,7 @@ SUITE(Queue)
         wa::storage::cloud_queue_message message(content);
 
         CHECK(message.content_as_string().size() >= content.size());
+        CHECK(message.content_as_string() == utility::conversions::to_base64(content));
         CHECK_ARRAY_EQUAL(content, message.content_as_binary(), content.size());
         CHECK(message.id().empty());
         CHECK(message.pop_receipt().empty());
@@ -648,6 +711,569 @@ SUITE(Queue)
         queue.delete_queue();
     }
 
+    TEST(Queue_Prefetcher)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+
+        std::set<utility::string_t> contents;
+        for (int i = 0; i < 5; ++i)
+        {
+            wa::storage::cloud_queue_message message(get_random_string());
+            queue.add_message(message);
+            contents.insert(message.content_as_string());
+        }
+
+        wa::storage::queue_request_options options;
+        wa::storage::operation_context context;
+        wa::storage::queue_message_prefetcher prefetcher(queue, std::chrono::seconds(60), options, context);
+
+        CHECK_THROW(prefetcher.set_max_buffered_messages(0U), std::invalid_argument);
+        CHECK_THROW(prefetcher.set_minimum_remaining_visibility(std::chrono::seconds(60)), std::invalid_argument);
+
+        prefetcher.set_minimum_remaining_visibility(std::chrono::seconds(10));
+        CHECK(prefetcher.minimum_remaining_visibility() == std::chrono::seconds(10));
+
+        std::set<utility::string_t> ids;
+        for (int i = 0; i < 5; ++i)
+        {
+            wa::storage::cloud_queue_message message = prefetcher.get_message();
+
+            CHECK(!message.id().empty());
+            CHECK(!message.pop_receipt().empty());
+            CHECK(contents.find(message.content_as_string()) != contents.end());
+            ids.insert(message.id());
+
+            queue.delete_message(message);
+        }
+
+        // Every message is only handed out once, and an empty message shows that the queue is empty
+        CHECK_EQUAL(5U, ids.size());
+        CHECK(prefetcher.get_message().id().empty());
+        CHECK(context.request_results().size() >= 1U);
+
+        queue.delete_queue();
+    }
+
+    TEST(Queue_MessagePump)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+
+        std::set<utility::string_t> contents;
+        for (int i = 0; i < 3; ++i)
+        {
+            wa::storage::cloud_queue_message message(get_random_string());
+            queue.add_message(message);
+            contents.insert(message.content_as_string());
+        }
+
+        std::set<utility::string_t> handled_contents;
+        std::mutex handled_mutex;
+        pplx::task_completion_event<void> all_handled;
+
+        wa::storage::queue_message_pump pump(queue, [&handled_contents, &handled_mutex, all_handled] (const wa::storage::cloud_queue_message& message) -> pplx::task<void>
+        {
+            std::lock_guard<std::mutex> guard(handled_mutex);
+            handled_contents.insert(message.content_as_string());
+            if (handled_contents.size() == 3U)
+            {
+                all_handled.set();
+            }
+
+            return pplx::task_from_result();
+        });
+
+        pump.set_max_concurrent_handlers(2);
+        pump.set_visibility_timeout(std::chrono::seconds(30));
+        pump.set_min_polling_interval(std::chrono::milliseconds(50));
+        pump.set_max_polling_interval(std::chrono::milliseconds(1000));
+        pump.start();
+
+        CHECK_THROW(pump.start(), std::logic_error);
+
+        pplx::create_task(all_handled).wait();
+        pump.stop();
+
+        CHECK(handled_contents == contents);
+
+        // Messages are deleted once their handler has completed
+        CHECK(queue.peek_message().id().empty());
+
+        queue.delete_queue();
+    }
+
+    TEST(Queue_MessagePump_AdaptiveVisibility)
+    {
+        // The transport returns one message to each of the first twelve polls, and renewals return a new pop receipt
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto visibility_timeouts = std::make_shared<std::vector<utility::string_t>>();
+        auto delete_receipts = std::make_shared<std::vector<utility::string_t>>();
+        auto renewals = std::make_shared<int>(0);
+        auto mutex = std::make_shared<std::mutex>();
+        transport->set_responder([visibility_timeouts, delete_receipts, renewals, mutex] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            auto query = web::http::uri::split_query(request.request_uri().query());
+            auto now = utility::conversions::to_utf8string(utility::datetime::utc_now().to_string());
+            std::lock_guard<std::mutex> guard(*mutex);
+            if (request.method() == web::http::methods::DEL)
+            {
+                delete_receipts->push_back(web::http::uri::decode(query[U("popreceipt")]));
+                return web::http::http_response(web::http::status_codes::NoContent);
+            }
+
+            if (request.method() == web::http::methods::PUT)
+            {
+                ++*renewals;
+                web::http::http_response response(web::http::status_codes::NoContent);
+                response.headers().add(U("x-ms-popreceipt"), U("renewed"));
+                response.headers().add(U("x-ms-time-next-visible"), utility::datetime::utc_now().to_string());
+                return response;
+            }
+
+            visibility_timeouts->push_back(query[U("visibilitytimeout")]);
+            std::string body("<?xml version=\"1.0\" encoding=\"utf-8\"?><QueueMessagesList>");
+            if (visibility_timeouts->size() <= 12U)
+            {
+                body.append("<QueueMessage><MessageId>").append(std::to_string(visibility_timeouts->size())).append("</MessageId>");
+                body.append("<InsertionTime>").append(now).append("</InsertionTime><ExpirationTime>").append(now).append("</ExpirationTime>");
+                body.append("<PopReceipt>initial</PopReceipt><TimeNextVisible>").append(now).append("</TimeNextVisible>");
+                body.append("<DequeueCount>1</DequeueCount><MessageText>aGVsbG8=</MessageText></QueueMessage>");
+            }
+
+            body.append("</QueueMessagesList>");
+            web::http::http_response response(web::http::status_codes::OK);
+            response.set_body(body, U("application/xml"));
+            return response;
+        });
+
+        wa::storage::queue_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_queue_client client(wa::storage::storage_uri(web::http::uri(U("https://account.queue.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto queue = client.get_queue_reference(U("queue"));
+
+        // The last message takes longer than the visibility timeout picked for it
+        pplx::task_completion_event<void> all_handled;
+        auto handled = std::make_shared<std::atomic<int>>(0);
+        wa::storage::queue_message_pump pump(queue, [handled, all_handled] (const wa::storage::cloud_queue_message& message) -> pplx::task<void>
+        {
+            bool is_slow = message.id() == U("12");
+            return pplx::create_task([is_slow] ()
+            {
+                if (is_slow)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+                }
+            }).then([handled, all_handled] ()
+            {
+                if (++*handled == 12)
+                {
+                    all_handled.set();
+                }
+            });
+        });
+
+        pump.set_max_concurrent_handlers(1);
+        pump.set_visibility_timeout(std::chrono::seconds(30));
+        pump.set_adaptive_visibility_timeout(true);
+        pump.set_visibility_margin(std::chrono::seconds(0));
+        pump.set_min_polling_interval(std::chrono::milliseconds(50));
+        pump.set_max_polling_interval(std::chrono::milliseconds(100));
+        pump.start();
+        pplx::create_task(all_handled).wait();
+        pump.stop();
+
+        // Until enough messages have been handled the visibility timeout of the pump is used, and then the processing times
+        std::lock_guard<std::mutex> guard(*mutex);
+        CHECK(visibility_timeouts->at(0) == U("30"));
+        CHECK(visibility_timeouts->at(9) == U("30"));
+        CHECK(visibility_timeouts->at(10) == U("1"));
+        CHECK(visibility_timeouts->at(11) == U("1"));
+
+        // The slow message is renewed, and deleted with the pop receipt of its latest renewal
+        CHECK(*renewals >= 1);
+        CHECK_EQUAL(12U, delete_receipts->size());
+        CHECK(delete_receipts->at(0) == U("initial"));
+        CHECK(delete_receipts->back() == U("renewed"));
+
+
+        wa::storage::queue_message_pump invalid_pump(queue, [] (const wa::storage::cloud_queue_message&) { return pplx::task_from_result(); });
+        invalid_pump.set_visibility_percentile(0.0);
+        CHECK_THROW(invalid_pump.start(), std::invalid_argument);
+        invalid_pump.set_visibility_percentile(0.5);
+        invalid_pump.set_visibility_margin(std::chrono::seconds(-1));
+        CHECK_THROW(invalid_pump.start(), std::invalid_argument);
+    }
+
+    TEST(Queue_LeaseKeeper)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+
+        {
+            wa::storage::cloud_queue_message message(get_random_string());
+            queue.add_message(message);
+        }
+
+        wa::storage::queue_request_options options;
+        wa::storage::operation_context context;
+        wa::storage::queue_message_lease_keeper lease_keeper(queue, std::chrono::seconds(3), options, context);
+
+        CHECK_THROW(lease_keeper.track(wa::storage::cloud_queue_message(get_random_string())), std::invalid_argument);
+        CHECK_THROW(lease_keeper.delete_message_async(get_random_string()), std::invalid_argument);
+
+        wa::storage::cloud_queue_message message = queue.get_message(std::chrono::seconds(3), options, context);
+        lease_keeper.track(message);
+
+        CHECK(lease_keeper.is_tracked(message.id()));
+        CHECK_EQUAL(1U, lease_keeper.tracked_count());
+
+        // The message would have become visible again several times without the renewals
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+
+        CHECK(queue.peek_message().id().empty());
+
+        wa::storage::cloud_queue_message renewed_message = lease_keeper.get_message(message.id());
+        CHECK(renewed_message.id() == message.id());
+        CHECK(renewed_message.pop_receipt() != message.pop_receipt());
+
+        lease_keeper.delete_message(message.id());
+
+        CHECK(!lease_keeper.is_tracked(message.id()));
+        CHECK_EQUAL(0U, lease_keeper.tracked_count());
+
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+
+        CHECK(queue.peek_message().id().empty());
+
+        queue.delete_queue();
+    }
+
+    TEST(Queue_MessageDeleter)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+
+        for (int i = 0; i < 3; ++i)
+        {
+            wa::storage::cloud_queue_message message(get_random_string());
+            queue.add_message(message);
+        }
+
+        wa::storage::queue_request_options options;
+        wa::storage::operation_context context;
+        wa::storage::queue_message_deleter deleter(queue, 2, options, context);
+
+        std::vector<wa::storage::cloud_queue_message> messages = queue.get_messages(3U, std::chrono::seconds(60), options, context);
+        CHECK_EQUAL(3U, messages.size());
+
+        for (auto iter = messages.cbegin(); iter != messages.cend(); ++iter)
+        {
+            deleter.add(*iter);
+        }
+
+        // A pop receipt that does not match the message's is reported as a failure, without stopping the other deletes
+        wa::storage::cloud_queue_message invalid_message(messages[0].id(), get_random_string());
+        deleter.add(invalid_message);
+
+        std::vector<wa::storage::queue_delete_failure> failures = deleter.flush();
+
+        CHECK_EQUAL(1U, failures.size());
+        if (!failures.empty())
+        {
+            CHECK(failures[0].message().pop_receipt() == invalid_message.pop_receipt());
+            CHECK_THROW(std::rethrow_exception(failures[0].error()), wa::storage::storage_exception);
+        }
+
+        CHECK(queue.peek_message().id().empty());
+        CHECK(deleter.flush().empty());
+
+        queue.delete_queue();
+    }
+
+    TEST(Queue_DepthMonitor)
+    {
+        wa::storage::cloud_queue queue1 = get_queue();
+        wa::storage::cloud_queue queue2 = get_queue();
+
+        CHECK_THROW(wa::storage::queue_depth_monitor(0, std::chrono::seconds(1), std::chrono::seconds(10), wa::storage::queue_request_options(), wa::storage::operation_context()), std::invalid_argument);
+        CHECK_THROW(wa::storage::queue_depth_monitor(4, std::chrono::seconds(10), std::chrono::seconds(1), wa::storage::queue_request_options(), wa::storage::operation_context()), std::invalid_argument);
+
+        wa::storage::queue_request_options options;
+        wa::storage::operation_context context;
+        wa::storage::queue_depth_monitor monitor(4, std::chrono::seconds(1), std::chrono::seconds(60), options, context);
+
+        std::atomic<int> change_count(0);
+        monitor.set_change_callback([&change_count] (const wa::storage::queue_depth_snapshot&)
+        {
+            ++change_count;
+        });
+
+        monitor.track(queue1);
+        monitor.track(queue2);
+        CHECK(monitor.is_tracked(queue1));
+        CHECK_EQUAL(2U, monitor.tracked_count());
+
+        monitor.refresh();
+        CHECK_EQUAL(0, monitor.get_snapshot(queue1).approximate_message_count());
+        CHECK_EQUAL(-1, monitor.get_snapshot(queue1).previous_message_count());
+        CHECK_EQUAL(2, change_count.load());
+
+        for (int i = 0; i < 3; ++i)
+        {
+            wa::storage::cloud_queue_message message(get_random_string());
+            queue1.add_message(message);
+        }
+
+        // Only the queue whose depth changed calls the callback, and it is refreshed again sooner than the other one
+        monitor.refresh();
+        wa::storage::queue_depth_snapshot snapshot = monitor.get_snapshot(queue1);
+        CHECK_EQUAL(3, snapshot.approximate_message_count());
+        CHECK_EQUAL(0, snapshot.previous_message_count());
+        CHECK(!snapshot.error());
+        CHECK_EQUAL(3, change_count.load());
+        CHECK(snapshot.refresh_interval() < monitor.get_snapshot(queue2).refresh_interval());
+        CHECK_EQUAL(2U, monitor.snapshots().size());
+
+        monitor.untrack(queue2);
+        CHECK(!monitor.is_tracked(queue2));
+        CHECK(monitor.get_snapshot(queue2).queue_uri().is_empty());
+
+        queue1.delete_queue();
+        queue2.delete_queue();
+    }
+
+    TEST(Queue_ClaimCheck)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+        wa::storage::cloud_blob_container container = test_config::instance().account().create_cloud_blob_client().get_container_reference(U("claimcheck") + get_random_string());
+        container.create();
+
+        CHECK_THROW(wa::storage::queue_claim_check(queue, container, 64 * 1024, wa::storage::blob_request_options()), std::invalid_argument);
+
+        wa::storage::queue_claim_check claim_check(queue, container);
+        std::vector<uint8_t> small_content(1024, 's');
+        std::vector<uint8_t> large_content(256 * 1024);
+        for (size_t i = 0; i < large_content.size(); ++i)
+        {
+            large_content[i] = static_cast<uint8_t>(i);
+        }
+
+        claim_check.add_message(small_content);
+        claim_check.add_message(large_content);
+
+        // Only the large content is offloaded to a blob, and both are read back the same way
+        std::vector<wa::storage::cloud_queue_message> messages = queue.get_messages(2U);
+        CHECK_EQUAL(2U, messages.size());
+        size_t claim_check_count = 0;
+        for (auto iter = messages.begin(); iter != messages.end(); ++iter)
+        {
+            bool is_claim_check = wa::storage::queue_claim_check::is_claim_check(*iter);
+            claim_check_count += is_claim_check ? 1 : 0;
+
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            claim_check.open_content(*iter).read_to_end(buffer).wait();
+            CHECK(buffer.collection() == (is_claim_check ? large_content : small_content));
+
+            claim_check.delete_message(*iter);
+        }
+
+        CHECK_EQUAL(1U, claim_check_count);
+        CHECK(queue.peek_message().id().empty());
+        CHECK(container.list_blobs_segmented(utility::string_t(), wa::storage::blob_continuation_token()).blobs().empty());
+
+        container.delete_container();
+        queue.delete_queue();
+    }
+
+    TEST(Queue_AddMessages)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+
+        std::vector<wa::storage::cloud_queue_message> messages;
+        std::set<utility::string_t> contents;
+        for (int i = 0; i < 20; ++i)
+        {
+            utility::string_t content = get_random_string();
+            messages.push_back(wa::storage::cloud_queue_message(content));
+            contents.insert(content);
+        }
+
+        // A message larger than the service allows fails without stopping the other adds
+        messages.push_back(wa::storage::cloud_queue_message(utility::string_t(100000, U('a'))));
+
+        wa::storage::queue_request_options options;
+        wa::storage::operation_context context;
+        std::vector<std::exception_ptr> errors = queue.add_messages(messages, std::chrono::seconds(604800LL), std::chrono::seconds(0LL), 4, options, context);
+
+        CHECK_EQUAL(messages.size(), errors.size());
+        for (size_t i = 0; i + 1 < errors.size(); ++i)
+        {
+            CHECK(errors[i] == nullptr);
+        }
+
+        CHECK(errors.back() != nullptr);
+        CHECK_THROW(std::rethrow_exception(errors.back()), wa::storage::storage_exception);
+
+        std::vector<wa::storage::cloud_queue_message> received = queue.get_messages(32U, std::chrono::seconds(60), options, context);
+        CHECK_EQUAL(contents.size(), received.size());
+        for (auto iter = received.cbegin(); iter != received.cend(); ++iter)
+        {
+            CHECK(contents.find(iter->content_as_string()) != contents.end());
+        }
+
+        CHECK_THROW(queue.add_messages(messages, std::chrono::seconds(604800LL), std::chrono::seconds(0LL), 0, options, context), std::invalid_argument);
+        CHECK(queue.add_messages(std::vector<wa::storage::cloud_queue_message>()).empty());
+
+        queue.delete_queue();
+    }
+
+    TEST(Queue_PackedMessages)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+
+        std::vector<std::vector<uint8_t>> contents;
+        for (int i = 0; i < 500; ++i)
+        {
+            std::string content(190, 'a');
+            content.append(utility::conversions::to_utf8string(get_random_string()));
+            contents.push_back(std::vector<uint8_t>(content.cbegin(), content.cend()));
+        }
+
+        wa::storage::queue_request_options options;
+        wa::storage::operation_context context;
+        std::vector<std::exception_ptr> errors = queue.add_packed_messages(contents, std::chrono::seconds(604800LL), std::chrono::seconds(0LL), 4, options, context);
+
+        CHECK_EQUAL(contents.size(), errors.size());
+        for (auto iter = errors.cbegin(); iter != errors.cend(); ++iter)
+        {
+            CHECK(*iter == nullptr);
+        }
+
+        // Each envelope holds as many logical messages as fit in 48 KB, so 500 of them take three envelopes
+        std::vector<wa::storage::queue_packed_message> envelopes = queue.get_packed_messages(32U, std::chrono::seconds(60), options, context);
+        CHECK_EQUAL(3U, envelopes.size());
+
+        std::vector<std::vector<uint8_t>> received;
+        for (auto iter = envelopes.begin(); iter != envelopes.end(); ++iter)
+        {
+            for (size_t i = 0; i < iter->size(); ++i)
+            {
+                received.push_back(iter->content(i));
+                bool deleted = queue.complete_packed_message_async(*iter, i, options, context).get();
+                CHECK_EQUAL(i + 1 == iter->size(), deleted);
+            }
+
+            CHECK_EQUAL(0U, iter->remaining());
+            CHECK(!iter->complete(0));
+        }
+
+        CHECK(received == contents);
+        CHECK(queue.get_messages(32U, std::chrono::seconds(60), options, context).empty());
+
+        // A message that is not an envelope is one logical message
+        wa::storage::queue_packed_message plain(wa::storage::cloud_queue_message(U("plain")));
+        CHECK_EQUAL(1U, plain.size());
+        CHECK(std::string(plain.content(0).cbegin(), plain.content(0).cend()) == "plain");
+
+        wa::storage::queue_message_packer packer;
+        CHECK_THROW(packer.try_add(std::vector<uint8_t>(64 * 1024)), std::invalid_argument);
+
+        queue.delete_queue();
+    }
+
+    TEST(Queue_BinaryMessages)
+    {
+        wa::storage::cloud_queue queue = get_queue();
+
+        // Sizes that leave each possible remainder after whole base64 groups
+        std::vector<std::vector<uint8_t>> contents;
+        for (size_t size = 0; size < 3; ++size)
+        {
+            std::vector<uint8_t> content = get_random_binary_data();
+            content.resize(content.size() - content.size() % 3 + size);
+            contents.push_back(content);
+        }
+
+        for (auto iter = contents.cbegin(); iter != contents.cend(); ++iter)
+        {
+            wa::storage::cloud_queue_message message(*iter);
+            queue.add_message(message);
+        }
+
+        std::vector<wa::storage::cloud_queue_message> messages = queue.get_messages(3U);
+        CHECK_EQUAL(3U, messages.size());
+
+        for (auto iter = messages.cbegin(); iter != messages.cend(); ++iter)
+        {
+            std::vector<uint8_t> content = iter->content_as_binary();
+            CHECK(std::find(contents.cbegin(), contents.cend(), content) != contents.cend());
+            CHECK(iter->content_as_string() == utility::conversions::to_base64(content));
+        }
+
+        wa::storage::cloud_queue_message text_message(U("not base64"));
+        CHECK_THROW(text_message.content_as_binary(), std::runtime_error);
+
+        queue.delete_queue();
+    }
+
+    TEST(Queue_Sharded)
+    {
+        wa::storage::sharded_queue queue(get_queue_client(), get_queue_name() + U("-"), 3U);
+        queue.create_if_not_exists();
+
+        CHECK_EQUAL(3U, queue.shards().size());
+
+        // Messages without a key go to each queue in turn
+        for (int i = 0; i < 6; ++i)
+        {
+            wa::storage::cloud_queue_message message(get_random_string());
+            queue.add_message(message);
+        }
+
+        for (auto iter = queue.shards().cbegin(); iter != queue.shards().cend(); ++iter)
+        {
+            wa::storage::cloud_queue shard = *iter;
+            shard.download_attributes();
+            CHECK_EQUAL(2, shard.approximate_message_count());
+        }
+
+        // Messages with the same key go to the same queue
+        utility::string_t key = get_random_string();
+        size_t shard_index = queue.get_shard_index(key);
+        CHECK_EQUAL(shard_index, queue.get_shard_index(key));
+
+        for (int i = 0; i < 2; ++i)
+        {
+            wa::storage::cloud_queue_message message(get_random_string());
+            queue.add_message(key, message);
+        }
+
+        {
+            wa::storage::cloud_queue shard = queue.shards()[shard_index];
+            shard.download_attributes();
+            CHECK_EQUAL(4, shard.approximate_message_count());
+        }
+
+        size_t message_count = 0;
+        for (int i = 0; i < 10 && message_count < 8U; ++i)
+        {
+            wa::storage::sharded_queue_result result = queue.get_messages(32U);
+            CHECK(!result.messages().empty());
+
+            wa::storage::cloud_queue shard = result.queue();
+            for (auto iter = result.messages().cbegin(); iter != result.messages().cend(); ++iter)
+            {
+                wa::storage::cloud_queue_message message = *iter;
+                shard.delete_message(message);
+            }
+
+            message_count += result.messages().size();
+        }
+
+        CHECK_EQUAL(8U, message_count);
+        CHECK(queue.get_messages(32U).messages().empty());
+
+        queue.delete_if_exists();
+    }
+
     TEST(Queue_Permissions)
     {
         wa::storage::cloud_queue queue = get_queue();
@@ -718,4 +1344,238 @@ SUITE(Queue)
             CHECK(permissions.policies().empty());
         }
     }
+
+    TEST(Queue_CreateIfNotExists_SingleRequest)
+    {
+        // The transport answers creates as the service does for a queue that does not exist, exists, or exists with other metadata
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto status = std::make_shared<web::http::status_code>(web::http::status_codes::Created);
+        auto request_count = std::make_shared<std::atomic<int>>(0);
+        transport->set_responder([status, request_count] (const web::http::http_request&, const std::string&) -> web::http::http_response
+        {
+            ++*request_count;
+            web::http::http_response response(*status);
+            if (*status == web::http::status_codes::Conflict)
+            {
+                response.set_body(std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?><Error><Code>QueueAlreadyExists</Code><Message>The specified queue already exists.</Message></Error>"), U("application/xml"));
+            }
+            else if (*status == web::http::status_codes::NotFound)
+            {
+                response.set_body(std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?><Error><Code>QueueNotFound</Code><Message>The specified queue does not exist.</Message></Error>"), U("application/xml"));
+            }
+
+            return response;
+        });
+
+        wa::storage::queue_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_queue_client client(wa::storage::storage_uri(web::http::uri(U("https://account.queue.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto queue = client.get_queue_reference(U("queue"));
+
+        CHECK(queue.create_if_not_exists());
+        CHECK_EQUAL(1, request_count->load());
+
+        *status = web::http::status_codes::NoContent;
+        CHECK(!queue.create_if_not_exists());
+        CHECK_EQUAL(2, request_count->load());
+
+        *status = web::http::status_codes::Conflict;
+        CHECK(!queue.create_if_not_exists());
+        CHECK_EQUAL(3, request_count->load());
+
+        *status = web::http::status_codes::NotFound;
+        CHECK(!queue.delete_queue_if_exists());
+        CHECK_EQUAL(4, request_count->load());
+    }
+
+    TEST(Queue_CreateIfNotExists_ExistenceCache)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto status = std::make_shared<web::http::status_code>(web::http::status_codes::Created);
+        auto request_count = std::make_shared<std::atomic<int>>(0);
+        transport->set_responder([status, request_count] (const web::http::http_request&, const std::string&) -> web::http::http_response
+        {
+            ++*request_count;
+            return web::http::http_response(*status);
+        });
+
+        wa::storage::queue_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_queue_client client(wa::storage::storage_uri(web::http::uri(U("https://account.queue.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        client.set_existence_cache_time_to_live(std::chrono::seconds(60));
+        auto queue = client.get_queue_reference(U("queue"));
+
+        // Once the queue is confirmed, creating it again does not send a request, even through another reference
+        CHECK(queue.create_if_not_exists());
+        CHECK_EQUAL(1, request_count->load());
+        CHECK(!queue.create_if_not_exists());
+        CHECK(!client.get_queue_reference(U("queue")).create_if_not_exists());
+        CHECK_EQUAL(1, request_count->load());
+
+        // A message request that fails with Not Found forgets the queue
+        *status = web::http::status_codes::NotFound;
+        wa::storage::cloud_queue_message message(U("message"));
+        CHECK_THROW(queue.add_message(message), wa::storage::storage_exception);
+        CHECK_EQUAL(2, request_count->load());
+
+        *status = web::http::status_codes::Created;
+        CHECK(queue.create_if_not_exists());
+        CHECK_EQUAL(3, request_count->load());
+
+        // Deleting the queue forgets it as well
+        *status = web::http::status_codes::NoContent;
+        queue.delete_queue();
+        CHECK_EQUAL(4, request_count->load());
+
+        *status = web::http::status_codes::Created;
+        CHECK(queue.create_if_not_exists());
+        CHECK_EQUAL(5, request_count->load());
+
+        // Without a time to live, every create sends a request
+        client.set_existence_cache_time_to_live(std::chrono::seconds(0));
+        *status = web::http::status_codes::NoContent;
+        CHECK(!queue.create_if_not_exists());
+        CHECK_EQUAL(6, request_count->load());
+    }
+
+    TEST(Queue_AddMessage_CreatesMissingQueue)
+    {
+        // Messages are refused with QueueNotFound until the queue is created
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto is_created = std::make_shared<std::atomic<bool>>(false);
+        auto add_count = std::make_shared<std::atomic<int>>(0);
+        auto create_count = std::make_shared<std::atomic<int>>(0);
+        transport->set_responder([is_created, add_count, create_count] (const web::http::http_request& request, const std::string&) -> web::http::http_response
+        {
+            if (request.method() == web::http::methods::PUT)
+            {
+                ++*create_count;
+                *is_created = true;
+                return web::http::http_response(web::http::status_codes::Created);
+            }
+
+            ++*add_count;
+            if (!*is_created)
+            {
+                web::http::http_response response(web::http::status_codes::NotFound);
+                response.set_body(std::string("<?xml version=\"1.0\" encoding=\"utf-8\"?><Error><Code>QueueNotFound</Code><Message>The specified queue does not exist.</Message></Error>"), U("application/xml"));
+                return response;
+            }
+
+            return web::http::http_response(web::http::status_codes::Created);
+        });
+
+        wa::storage::queue_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_queue_client client(wa::storage::storage_uri(web::http::uri(U("https://account.queue.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto queue = client.get_queue_reference(U("queue"));
+        wa::storage::cloud_queue_message message(U("message"));
+
+        // Without the option, the add fails
+        wa::storage::queue_request_options add_options;
+        CHECK_THROW(queue.add_message(message, std::chrono::seconds(604800), std::chrono::seconds(0), add_options, wa::storage::operation_context()), wa::storage::storage_exception);
+        CHECK_EQUAL(1, add_count->load());
+        CHECK_EQUAL(0, create_count->load());
+
+        // With it, the queue is created and the message is added again
+        add_options.set_create_queue_if_not_found(true);
+        queue.add_message(message, std::chrono::seconds(604800), std::chrono::seconds(0), add_options, wa::storage::operation_context());
+        CHECK_EQUAL(3, add_count->load());
+        CHECK_EQUAL(1, create_count->load());
+
+        // Once the queue exists, an add takes a single request
+        queue.add_message(message, std::chrono::seconds(604800), std::chrono::seconds(0), add_options, wa::storage::operation_context());
+        CHECK_EQUAL(4, add_count->load());
+        CHECK_EQUAL(1, create_count->load());
+    }
+
+    TEST(Queue_PreparedRequests)
+    {
+        // The first get and the first add of messages fail once with a server error, and are sent again
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        auto transport_pointer = transport.get();
+        auto requests = std::make_shared<std::vector<recorded_request>>();
+        auto requests_mutex = std::make_shared<std::mutex>();
+        auto fail_get = std::make_shared<std::atomic<bool>>(true);
+        auto fail_add = std::make_shared<std::atomic<bool>>(true);
+        transport->set_responder([transport_pointer, requests, requests_mutex, fail_get, fail_add] (const web::http::http_request& request, const std::string& batch_body) -> web::http::http_response
+        {
+            {
+                std::lock_guard<std::mutex> guard(*requests_mutex);
+                requests->push_back(recorded_request(request));
+            }
+
+            auto& fail = (request.method() == web::http::methods::GET) ? *fail_get : *fail_add;
+            if (fail.exchange(false))
+            {
+                return web::http::http_response(web::http::status_codes::InternalError);
+            }
+
+            return transport_pointer->default_response(request, batch_body);
+        });
+
+        wa::storage::queue_request_options options;
+        options.set_transport(transport);
+        options.set_retry_policy(wa::storage::linear_retry_policy(std::chrono::seconds(0), 3));
+        options.set_server_timeout(std::chrono::seconds(20));
+        wa::storage::cloud_queue_client client(wa::storage::storage_uri(web::http::uri(U("https://account.queue.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), options);
+        auto queue = client.get_queue_reference(U("queue"));
+        const web::http::uri messages_uri(U("https://account.queue.core.windows.net/queue/messages"));
+        const std::chrono::seconds visibility_timeout(30);
+
+        // A poll that is retried and then repeated sends the same request each time, and one with another server timeout is prepared apart
+        wa::storage::queue_request_options get_options;
+        queue.get_messages_async(32, visibility_timeout, get_options, wa::storage::operation_context()).get();
+        queue.get_messages_async(32, visibility_timeout, get_options, wa::storage::operation_context()).get();
+        get_options.set_server_timeout(std::chrono::seconds(25));
+        queue.get_messages_async(32, visibility_timeout, get_options, wa::storage::operation_context()).get();
+
+        CHECK_EQUAL(4U, requests->size());
+        auto get_request = wa::storage::protocol::get_messages(queue, 32, visibility_timeout, /* is_peek */ false, web::http::uri_builder(messages_uri), std::chrono::seconds(20), wa::storage::operation_context());
+        auto get_with_timeout = wa::storage::protocol::get_messages(queue, 32, visibility_timeout, /* is_peek */ false, web::http::uri_builder(messages_uri), std::chrono::seconds(25), wa::storage::operation_context());
+        for (size_t i = 0; i < requests->size(); ++i)
+        {
+            check_signature((*requests)[i]);
+            check_unprepared((*requests)[i], i < 3 ? get_request : get_with_timeout);
+        }
+
+        CHECK((*requests)[3].uri.query().find(U("timeout=25")) != utility::string_t::npos);
+
+        // Adds of different messages are copied from one prepared request, each with its own body, including the add that is retried
+        std::vector<wa::storage::cloud_queue_message> messages;
+        messages.push_back(wa::storage::cloud_queue_message(U("a")));
+        messages.push_back(wa::storage::cloud_queue_message(U("message two")));
+        messages.push_back(wa::storage::cloud_queue_message(U("a third message, which is longer than the others")));
+        const std::chrono::seconds time_to_live(3600);
+        const std::chrono::seconds initial_visibility_timeout(0);
+
+        requests->clear();
+        wa::storage::queue_request_options add_options;
+        auto errors = queue.add_messages_async(messages, time_to_live, initial_visibility_timeout, 1, add_options, wa::storage::operation_context()).get();
+        CHECK_EQUAL(messages.size(), errors.size());
+        for (auto iter = errors.begin(); iter != errors.end(); ++iter)
+        {
+            CHECK(*iter == nullptr);
+        }
+
+        // One add at a time, so the requests are in the order of the messages
+        CHECK_EQUAL(4U, requests->size());
+        std::set<utility::size64_t> content_lengths;
+        for (size_t i = 0; i < requests->size(); ++i)
+        {
+            const auto& message = messages[i == 0 ? 0 : i - 1];
+            auto add_request = wa::storage::protocol::add_message(queue, message, time_to_live, initial_visibility_timeout, web::http::uri_builder(messages_uri), std::chrono::seconds(20), wa::storage::operation_context());
+            check_signature((*requests)[i]);
+            check_unprepared((*requests)[i], add_request);
+
+            utility::size64_t content_length = 0;
+            CHECK((*requests)[i].headers.match(web::http::header_names::content_length, content_length));
+            content_lengths.insert(content_length);
+        }
+
+        CHECK_EQUAL(messages.size(), content_lengths.size());
+    }
 }
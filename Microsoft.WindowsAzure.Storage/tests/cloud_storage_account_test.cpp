@@ -22,6 +22,11 @@
 #include "was/blob.h"
 #include "was/queue.h"
 #include "was/table.h"
+#include "was/sharding.h"
+#include "wascore/credential_cache.h"
+#include "wascore/hash_software.h"
+#include "wascore/datetime_codec.h"
+#include "wascore/util.h"
 
 const utility::string_t test_uri(U("http://test/abc"));
 const utility::string_t token(U("?sp=abcde&sig=1"));
@@ -249,6 +254,92 @@ SUITE(Core)
         CHECK(account.blob_endpoint().secondary_uri().is_empty());
     }
 
+    TEST(cloud_storage_account_parse_repeated)
+    {
+        const utility::string_t connection_string(U("DefaultEndpointsProtocol=https;AccountName=test;AccountKey=") + test_account_key);
+        auto account = wa::storage::cloud_storage_account::parse(connection_string);
+        auto repeated = wa::storage::cloud_storage_account::parse(connection_string);
+        check_account_equal(account, repeated);
+
+        // The first of repeated settings wins, and a setting that no form accepts fails the parse
+        auto duplicated = wa::storage::cloud_storage_account::parse(connection_string + U(";AccountName=other"));
+        CHECK_UTF8_EQUAL(test_account_name, duplicated.credentials().account_name());
+        CHECK_THROW(wa::storage::cloud_storage_account::parse(connection_string + U(";Unknown=1")), std::invalid_argument);
+        CHECK_THROW(wa::storage::cloud_storage_account::parse(U("=value")), std::logic_error);
+
+    }
+
+    TEST(cloud_storage_account_share_signing_keys)
+    {
+        auto& cache = wa::storage::core::credential_cache::instance();
+        auto account_key = wa::storage::storage_credentials(test_account_name, test_account_key).account_key();
+
+        // Signing keys are not shared unless asked for
+        CHECK(!wa::storage::cloud_storage_account::share_signing_keys());
+        CHECK(cache.get_signing_key(account_key) != cache.get_signing_key(account_key));
+
+        wa::storage::cloud_storage_account::set_share_signing_keys(true);
+        {
+            // Signers of the same key share its key schedule, but only while one of them still uses it
+            auto signing_key = cache.get_signing_key(account_key);
+            CHECK(signing_key == cache.get_signing_key(account_key));
+            CHECK(signing_key != cache.get_signing_key(wa::storage::storage_credentials(test_account_name, U("b3RoZXJrZXk=")).account_key()));
+
+            std::weak_ptr<const wa::storage::core::hmac_sha256_hash> released(signing_key);
+            signing_key.reset();
+            CHECK(released.expired());
+        }
+
+        wa::storage::cloud_storage_account::set_share_signing_keys(false);
+        CHECK(!wa::storage::cloud_storage_account::share_signing_keys());
+    }
+
+    TEST(sharded_clients)
+    {
+        std::vector<wa::storage::cloud_storage_account> accounts;
+        for (int i = 0; i < 4; ++i)
+        {
+            accounts.push_back(wa::storage::cloud_storage_account(wa::storage::storage_credentials(test_account_name + wa::storage::core::convert_to_string(i), test_account_key), true));
+        }
+
+        // Growing the shards only moves keys to the new shard
+        size_t moved = 0;
+        for (int i = 0; i < 1000; ++i)
+        {
+            auto key = U("blob") + wa::storage::core::convert_to_string(i);
+            auto before = wa::storage::consistent_hash_placement(key, 3);
+            auto after = wa::storage::consistent_hash_placement(key, 4);
+            CHECK(before < 3);
+            CHECK(after == before || after == 3);
+            moved += after == 3 ? 1 : 0;
+        }
+
+        CHECK(moved > 150 && moved < 350);
+
+        wa::storage::sharded_blob_client blob_client(accounts);
+        auto blob = blob_client.get_block_blob_reference(U("container"), U("blob"));
+        auto index = blob_client.get_shard_index(U("blob"));
+        CHECK_UTF8_EQUAL(accounts[index].blob_endpoint().primary_uri().host(), blob.uri().primary_uri().host());
+        CHECK_UTF8_EQUAL(U("/container/blob"), blob.uri().primary_uri().path());
+        CHECK_EQUAL(4U, blob_client.get_container_references(U("container")).size());
+
+        wa::storage::sharded_table_client table_client(accounts);
+        auto table = table_client.get_table_reference(U("table"), U("partition"));
+        CHECK_UTF8_EQUAL(accounts[table_client.get_shard_index(U("partition"))].table_endpoint().primary_uri().host(), table.uri().primary_uri().host());
+
+        wa::storage::sharded_queue_client queue_client(accounts);
+        auto queue = queue_client.get_queue_reference(U("queue"));
+        CHECK_UTF8_EQUAL(accounts[queue_client.get_shard_index(U("queue"))].queue_endpoint().primary_uri().host(), queue.uri().primary_uri().host());
+        CHECK_EQUAL(4U, queue_client.get_sharded_queue(U("queue")).shards().size());
+
+        // A custom placement is used as it is, and must stay within the shards
+        wa::storage::sharded_blob_client first_client(accounts, [] (const utility::string_t&, size_t) -> size_t { return 0; }, wa::storage::blob_request_options());
+        CHECK_EQUAL(0U, first_client.get_shard_index(U("blob")));
+        wa::storage::sharded_blob_client invalid_client(accounts, [] (const utility::string_t&, size_t shard_count) -> size_t { return shard_count; }, wa::storage::blob_request_options());
+        CHECK_THROW(invalid_client.get_block_blob_reference(U("container"), U("blob")), std::out_of_range);
+        CHECK_THROW(wa::storage::sharded_queue_client(std::vector<wa::storage::cloud_storage_account>()), std::invalid_argument);
+    }
+
     TEST(cloud_storage_account_devstore_proxy)
     {
         auto account = wa::storage::cloud_storage_account::parse(U("UseDevelopmentStorage=true;DevelopmentStorageProxyUri=http://ipv4.fiddler"));
@@ -259,4 +350,51 @@ SUITE(Core)
         CHECK(account.queue_endpoint().secondary_uri().is_empty());
         CHECK(account.table_endpoint().secondary_uri().is_empty());
     }
+
+    TEST(datetime_codec)
+    {
+        // Both parsers agree with the general one, and dates are written back the way they were read
+        const utility::string_t rfc1123(U("Sun, 06 Nov 1994 08:49:37 GMT"));
+        auto date = wa::storage::core::parse_rfc1123_datetime(rfc1123);
+        CHECK(date == utility::datetime::from_string(rfc1123, utility::datetime::RFC_1123));
+        CHECK_UTF8_EQUAL(rfc1123, wa::storage::core::format_rfc1123_datetime(date));
+
+        const utility::string_t leap_day(U("Tue, 29 Feb 2000 23:59:59 GMT"));
+        CHECK_UTF8_EQUAL(leap_day, wa::storage::core::format_rfc1123_datetime(wa::storage::core::parse_rfc1123_datetime(leap_day)));
+        CHECK(!wa::storage::core::parse_rfc1123_datetime(U("Wed, 30 Feb 2000 23:59:59 GMT")).is_initialized());
+
+        auto timestamp = wa::storage::core::parse_iso8601_datetime(U("2013-08-22T01:12:06.2608595Z"));
+        CHECK_UTF8_EQUAL(U("2013-08-22T01:12:06.2608595Z"), wa::storage::core::format_iso8601_datetime(timestamp));
+        CHECK(wa::storage::core::parse_iso8601_datetime(U("2013-08-22T01:12:06Z")) == timestamp - 2608595);
+        CHECK_UTF8_EQUAL(U("2013-08-22T01:12:06.5Z"), wa::storage::core::format_iso8601_datetime(wa::storage::core::parse_iso8601_datetime(U("2013-08-22T01:12:06.50Z"))));
+        CHECK(!wa::storage::core::parse_iso8601_datetime(U("2013-08-22T01:12:06.Z")).is_initialized());
+        CHECK(!wa::storage::core::parse_iso8601_datetime(U("2013-08-22 01:12:06Z")).is_initialized());
+
+        // The current date is within a second of the clock
+        auto before = utility::datetime::utc_now().to_interval() / 10000000;
+        auto now = wa::storage::core::parse_rfc1123_datetime(wa::storage::core::current_rfc1123_datetime()).to_interval() / 10000000;
+        auto after = utility::datetime::utc_now().to_interval() / 10000000;
+        CHECK(now >= before && now <= after);
+    }
+
+    TEST(cloud_metadata_lookup)
+    {
+        wa::storage::cloud_metadata metadata;
+        metadata[U("ccc")] = U("3");
+        metadata[U("aaa")] = U("1");
+        CHECK(metadata.insert(std::make_pair(utility::string_t(U("bbb")), utility::string_t(U("2")))).second);
+        CHECK(!metadata.insert(std::make_pair(utility::string_t(U("aaa")), utility::string_t(U("x")))).second);
+
+        // Entries are kept in the order of their names, and a name is only ever stored once
+        CHECK_EQUAL(3U, metadata.size());
+        CHECK_UTF8_EQUAL(U("aaa"), metadata.cbegin()->first);
+        CHECK_UTF8_EQUAL(U("1"), metadata.at(U("aaa")));
+        CHECK_UTF8_EQUAL(U("2"), metadata.find(U("bbb"))->second);
+        CHECK(metadata.find(U("ddd")) == metadata.end());
+        CHECK_THROW(metadata.at(U("ddd")), std::out_of_range);
+
+        CHECK_EQUAL(1U, metadata.erase(U("bbb")));
+        CHECK_EQUAL(0U, metadata.count(U("bbb")));
+        CHECK(metadata == wa::storage::cloud_metadata(metadata.cbegin(), metadata.cend()));
+    }
 }
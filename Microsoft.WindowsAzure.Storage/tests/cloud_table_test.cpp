@@ -18,6 +18,7 @@
 #include "stdafx.h"
 #include "test_helper.h"
 #include "was/table.h"
+#include "wascore/partition_key_filter.h"
 
 SUITE(Table)
 {
@@ -509,6 +510,59 @@ SUITE(Table)
         CHECK(property.str().size() > 0);
     }
 
+    TEST(EntityProperty_StringConversion)
+    {
+        wa::storage::entity_property property(utility::string_t(U("1234567890123")));
+        property.set_property_type(wa::storage::edm_type::int64);
+
+        CHECK(property.property_type() == wa::storage::edm_type::int64);
+        CHECK_EQUAL(1234567890123LL, property.int64_value());
+        CHECK(property.str().compare(U("1234567890123")) == 0);
+
+        property.set_value(utility::string_t(U("true")));
+        property.set_property_type(wa::storage::edm_type::boolean);
+
+        CHECK(property.boolean_value());
+        CHECK(property.str().compare(U("true")) == 0);
+
+        property.set_value(utility::string_t(U("not a boolean")));
+        property.set_property_type(wa::storage::edm_type::boolean);
+
+        CHECK_THROW(property.boolean_value(), std::runtime_error);
+        CHECK(property.str().compare(U("not a boolean")) == 0);
+
+        property.set_value((int32_t)42);
+        CHECK(property.str().compare(U("42")) == 0);
+
+        property.set_value((int32_t)-7);
+        CHECK_EQUAL(-7, property.int32_value());
+        CHECK(property.str().compare(U("-7")) == 0);
+    }
+
+    TEST(EntityProperty_Utf8)
+    {
+        wa::storage::entity_property property;
+        property.set_utf8_value(std::string("caf\xC3\xA9"));
+
+        CHECK(property.property_type() == wa::storage::edm_type::string);
+        CHECK(!property.is_null());
+#ifdef _UTF16_STRINGS
+        CHECK(property.has_utf8_value());
+        CHECK(property.utf8_value() == std::string("caf\xC3\xA9"));
+#endif
+        CHECK(property.string_value().compare(utility::conversions::to_string_t(std::string("caf\xC3\xA9"))) == 0);
+
+        property.set_utf8_value(std::string("1234567890123"));
+        property.set_property_type(wa::storage::edm_type::int64);
+
+        CHECK(!property.has_utf8_value());
+        CHECK_EQUAL(1234567890123LL, property.int64_value());
+        CHECK(property.str().compare(U("1234567890123")) == 0);
+
+        property.set_value(utility::string_t(U("text")));
+        CHECK(!property.has_utf8_value());
+    }
+
     TEST(EntityProperty_Null)
     {
         wa::storage::entity_property property;
@@ -733,6 +787,47 @@ SUITE(Table)
         CHECK(operation.operation_type() == wa::storage::table_operation_type::merge_operation);
     }
 
+    TEST(Operation_MergeChanges)
+    {
+        utility::string_t partition_key = get_random_string();
+        utility::string_t row_key = get_random_string();
+        wa::storage::table_entity entity(partition_key, row_key);
+        entity.set_etag(U("\"0x8D0\""));
+        entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(get_random_int32())));
+        entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyB"), wa::storage::entity_property(get_random_string())));
+        entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyC"), wa::storage::entity_property(get_random_double())));
+
+        // Without recorded properties, all of them are merged
+        CHECK(!entity.is_tracking_changes());
+        CHECK_EQUAL(3U, wa::storage::table_operation::merge_entity_changes(entity).entity().properties().size());
+
+        entity.accept_changes();
+        CHECK(entity.is_tracking_changes());
+        CHECK(entity.changed_properties().empty());
+
+        // Setting a property to an equal value of the same type does not change it
+        wa::storage::table_entity copy = entity;
+        copy.properties()[U("PropertyA")] = wa::storage::entity_property(entity.properties()[U("PropertyA")].int32_value());
+        copy.properties()[U("PropertyB")] = wa::storage::entity_property(get_random_string());
+        copy.properties()[U("PropertyC")].set_is_null(true);
+        copy.properties().insert(wa::storage::table_entity::property_type(U("PropertyD"), wa::storage::entity_property(true)));
+
+        wa::storage::table_operation operation = wa::storage::table_operation::merge_entity_changes(copy);
+
+        CHECK(operation.operation_type() == wa::storage::table_operation_type::merge_operation);
+        CHECK(operation.entity().partition_key().compare(partition_key) == 0);
+        CHECK(operation.entity().row_key().compare(row_key) == 0);
+        CHECK(operation.entity().etag().compare(entity.etag()) == 0);
+        CHECK_EQUAL(3U, operation.entity().properties().size());
+        CHECK(operation.entity().properties().find(U("PropertyA")) == operation.entity().properties().cend());
+        CHECK(operation.entity().properties().at(U("PropertyB")).string_value() == copy.properties()[U("PropertyB")].string_value());
+        CHECK(operation.entity().properties().at(U("PropertyC")).is_null());
+        CHECK(operation.entity().properties().at(U("PropertyD")).boolean_value());
+
+        // The original entity is unaffected by changes to the copy
+        CHECK(entity.changed_properties().empty());
+    }
+
     TEST(Operation_Replace)
     {
         utility::string_t partition_key = get_random_string();
@@ -803,6 +898,24 @@ SUITE(Table)
         options.set_payload_format(payload_format);
 
         CHECK(options.payload_format() == payload_format);
+
+        CHECK_EQUAL(1, options.parallelism_factor());
+
+        options.set_parallelism_factor(4);
+
+        CHECK_EQUAL(4, options.parallelism_factor());
+
+        CHECK(!options.track_property_changes());
+
+        options.set_track_property_changes(true);
+
+        CHECK(options.track_property_changes());
+
+        CHECK(!options.echo_content());
+
+        options.set_echo_content(true);
+
+        CHECK(options.echo_content());
     }
 
     TEST(Table_CreateAndDelete)
@@ -1089,6 +1202,66 @@ SUITE(Table)
         table.delete_table();
     }
 
+    TEST(EntityOperation_InsertEchoContent)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key = get_random_string();
+        int32_t int32_value = get_random_int32();
+
+        wa::storage::table_request_options options;
+        options.set_echo_content(true);
+
+        // An insert that echoes the entity returns it with the timestamp the service set
+        {
+            wa::storage::table_entity entity(partition_key, U("a"));
+            entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(int32_value)));
+
+            wa::storage::table_result result = table.execute(wa::storage::table_operation::insert_entity(entity), options, wa::storage::operation_context());
+
+            CHECK_EQUAL(201, result.http_status_code());
+            CHECK(!result.etag().empty());
+            CHECK(result.entity().row_key() == U("a"));
+            CHECK(result.entity().timestamp().is_initialized());
+            CHECK_EQUAL(int32_value, result.entity().properties().at(U("PropertyA")).int32_value());
+        }
+
+        {
+            wa::storage::table_batch_operation operation;
+            operation.insert_entity(wa::storage::table_entity(partition_key, U("b")));
+            operation.insert_entity(wa::storage::table_entity(partition_key, U("c")));
+
+            std::vector<wa::storage::table_result> results = table.execute_batch(operation, options, wa::storage::operation_context());
+
+            CHECK_EQUAL(2U, results.size());
+            for (std::vector<wa::storage::table_result>::const_iterator itr = results.cbegin(); itr != results.cend(); ++itr)
+            {
+                CHECK_EQUAL(201, itr->http_status_code());
+                CHECK(!itr->etag().empty());
+                CHECK(itr->entity().partition_key() == partition_key);
+            }
+        }
+
+        // By default only the ETag of an inserted entity is returned
+        {
+            wa::storage::table_batch_operation operation;
+            operation.insert_entity(wa::storage::table_entity(partition_key, U("d")));
+            operation.insert_entity(wa::storage::table_entity(partition_key, U("e")));
+
+            std::vector<wa::storage::table_result> results = table.execute_batch(operation);
+
+            CHECK_EQUAL(2U, results.size());
+            for (std::vector<wa::storage::table_result>::const_iterator itr = results.cbegin(); itr != results.cend(); ++itr)
+            {
+                CHECK_EQUAL(204, itr->http_status_code());
+                CHECK(!itr->etag().empty());
+                CHECK(itr->entity().partition_key().empty());
+            }
+        }
+
+        table.delete_table();
+    }
+
     TEST(EntityOperation_InsertAndMerge)
     {
         wa::storage::cloud_table table = get_table();
@@ -2158,6 +2331,271 @@ SUITE(Table)
         CHECK_THROW(table.execute_batch(operation, options, context), std::invalid_argument);
     }
 
+    TEST(EntityBatch_BulkWriter)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key1 = get_random_string();
+        utility::string_t partition_key2 = get_random_string();
+
+        {
+            wa::storage::table_request_options options;
+            wa::storage::operation_context context;
+
+            options.set_parallelism_factor(4);
+
+            wa::storage::table_bulk_writer writer(table, options, context);
+
+            CHECK_THROW(writer.add(wa::storage::table_operation::retrieve_entity(partition_key1, get_random_string())), std::invalid_argument);
+
+            // The first partition needs more than one batch and the second one changes the same entity twice
+            for (int row1 = 0; row1 < 10; ++row1)
+            {
+                for (int row2 = 0; row2 < 26; ++row2)
+                {
+                    wa::storage::table_entity entity(partition_key1, get_string('a' + row1, 'a' + row2));
+                    entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(get_random_int32())));
+                    writer.add(wa::storage::table_operation::insert_entity(entity));
+                }
+            }
+
+            for (int row = 0; row < 26; ++row)
+            {
+                wa::storage::table_entity entity(partition_key2, get_string('a', 'a' + row));
+                writer.add(wa::storage::table_operation::insert_entity(entity));
+
+                entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(get_random_string())));
+                writer.add(wa::storage::table_operation::merge_entity(entity));
+            }
+
+            std::vector<wa::storage::table_bulk_failure> failures = writer.flush();
+
+            CHECK(failures.empty());
+
+            // Inserting an entity that exists fails on its own, without failing the rest of its batch
+            writer.add(wa::storage::table_operation::insert_entity(wa::storage::table_entity(partition_key2, get_string('a', 'a'))));
+            writer.add(wa::storage::table_operation::insert_entity(wa::storage::table_entity(partition_key2, get_string('b', 'a'))));
+
+            failures = writer.flush_async().get();
+
+            CHECK_EQUAL(1U, failures.size());
+            CHECK(failures[0].operation().entity().row_key() == get_string('a', 'a'));
+            CHECK_THROW(std::rethrow_exception(failures[0].error()), wa::storage::storage_exception);
+        }
+
+        {
+            wa::storage::table_query query;
+            query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_key1));
+
+            std::vector<wa::storage::table_entity> results = table.execute_query(query);
+
+            CHECK_EQUAL(260U, results.size());
+        }
+
+        {
+            wa::storage::table_query query;
+            query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_key2));
+
+            std::vector<wa::storage::table_entity> results = table.execute_query(query);
+
+            CHECK_EQUAL(27U, results.size());
+
+            for (std::vector<wa::storage::table_entity>::const_iterator itr = results.cbegin(); itr != results.cend(); ++itr)
+            {
+                if (itr->row_key() != get_string('b', 'a'))
+                {
+                    CHECK(itr->properties().find(U("PropertyA")) != itr->properties().cend());
+                }
+            }
+        }
+
+        table.delete_table();
+    }
+
+    TEST(EntityBatch_WriteBehindBuffer)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key = get_random_string();
+        int32_t int32_value = get_random_int32();
+
+        wa::storage::table_request_options options;
+        wa::storage::operation_context context;
+
+        {
+            wa::storage::table_write_behind_buffer buffer(table, options, context);
+            buffer.set_flush_interval(std::chrono::milliseconds(60 * 1000));
+
+            CHECK(buffer.flush_interval() == std::chrono::milliseconds(60 * 1000));
+            CHECK_THROW(buffer.write(wa::storage::table_operation::insert_entity(wa::storage::table_entity(partition_key, U("a")))), std::invalid_argument);
+            CHECK_THROW(buffer.set_flush_interval(std::chrono::milliseconds(-1)), std::invalid_argument);
+
+            // The writes of each entity are combined, and the entities of the partition are sent as a single batch
+            std::vector<pplx::task<void>> writes;
+            for (int i = 0; i < 10; ++i)
+            {
+                wa::storage::table_entity counter(partition_key, U("counter"));
+                counter.properties().insert(wa::storage::table_entity::property_type(U("Count"), wa::storage::entity_property(static_cast<int32_t>(i))));
+                writes.push_back(buffer.write_async(wa::storage::table_operation::insert_or_replace_entity(counter)));
+
+                wa::storage::table_entity status(partition_key, U("status"));
+                status.properties().insert(wa::storage::table_entity::property_type(get_string('a', 'a' + i), wa::storage::entity_property(int32_value)));
+                writes.push_back(buffer.write_async(wa::storage::table_operation::insert_or_merge_entity(status)));
+            }
+
+            buffer.flush();
+
+            CHECK_EQUAL(1U, context.request_results().size());
+            for (auto iter = writes.begin(); iter != writes.end(); ++iter)
+            {
+                CHECK(iter->is_done());
+                iter->get();
+            }
+
+            // Nothing is sent by a flush of an empty buffer
+            buffer.flush();
+            CHECK_EQUAL(1U, context.request_results().size());
+
+            // A failed write fails its own task and the flush
+            wa::storage::table_entity missing(partition_key, get_random_string());
+            missing.set_etag(U("*"));
+            pplx::task<void> failed_write = buffer.write_async(wa::storage::table_operation::merge_entity(missing));
+
+            CHECK_THROW(buffer.flush(), wa::storage::storage_exception);
+            CHECK_THROW(failed_write.get(), wa::storage::storage_exception);
+        }
+
+        {
+            wa::storage::table_result result = table.execute(wa::storage::table_operation::retrieve_entity(partition_key, U("counter")));
+
+            CHECK_EQUAL(200, result.http_status_code());
+            CHECK_EQUAL(1U, result.entity().properties().size());
+            CHECK_EQUAL(9, result.entity().properties().at(U("Count")).int32_value());
+        }
+
+        {
+            wa::storage::table_result result = table.execute(wa::storage::table_operation::retrieve_entity(partition_key, U("status")));
+
+            CHECK_EQUAL(200, result.http_status_code());
+            CHECK_EQUAL(10U, result.entity().properties().size());
+            CHECK_EQUAL(int32_value, result.entity().properties().at(get_string('a', 'j')).int32_value());
+        }
+
+        table.delete_table();
+    }
+
+    TEST(Entity_Cache)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        // Copies of the service client share the cache, so the settings apply to the table's own copy too
+        wa::storage::table_entity_cache_settings settings;
+        settings.set_max_entities(10);
+        settings.set_time_to_live(std::chrono::seconds(60));
+        wa::storage::cloud_table_client client = table.service_client();
+        client.set_entity_cache_settings(settings);
+
+        CHECK_EQUAL(10U, table.service_client().entity_cache_settings().max_entities());
+
+        utility::string_t partition_key = get_random_string();
+        utility::string_t row_key = get_random_string();
+        int32_t int32_value = get_random_int32();
+
+        {
+            wa::storage::table_entity entity(partition_key, row_key);
+            entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(int32_value)));
+
+            table.execute(wa::storage::table_operation::insert_entity(entity));
+        }
+
+        wa::storage::table_request_options options;
+        wa::storage::operation_context context;
+
+        wa::storage::table_result first_result = table.execute(wa::storage::table_operation::retrieve_entity(partition_key, row_key), options, context);
+        wa::storage::table_result second_result = table.execute(wa::storage::table_operation::retrieve_entity(partition_key, row_key), options, context);
+
+        // The second retrieve is answered from the cache
+        CHECK_EQUAL(1, context.request_results().size());
+        CHECK_EQUAL(200, second_result.http_status_code());
+        CHECK(second_result.etag() == first_result.etag());
+        CHECK_EQUAL(int32_value, second_result.entity().properties().at(U("PropertyA")).int32_value());
+
+        // A write through the same client removes the cached copy
+        int32_t new_int32_value = get_random_int32();
+
+        {
+            wa::storage::table_entity entity(partition_key, row_key);
+            entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(new_int32_value)));
+
+            table.execute(wa::storage::table_operation::insert_or_replace_entity(entity));
+        }
+
+        wa::storage::table_result third_result = table.execute(wa::storage::table_operation::retrieve_entity(partition_key, row_key), options, context);
+
+        CHECK_EQUAL(2, context.request_results().size());
+        CHECK(third_result.etag() != first_result.etag());
+        CHECK_EQUAL(new_int32_value, third_result.entity().properties().at(U("PropertyA")).int32_value());
+
+        // Once the time to live has passed, the cached copy is revalidated with its ETag
+        settings.set_time_to_live(std::chrono::seconds(0));
+        client.set_entity_cache_settings(settings);
+
+        table.execute(wa::storage::table_operation::retrieve_entity(partition_key, row_key), options, context);
+        wa::storage::table_result fourth_result = table.execute(wa::storage::table_operation::retrieve_entity(partition_key, row_key), options, context);
+
+        CHECK_EQUAL(4, context.request_results().size());
+        CHECK_EQUAL(200, fourth_result.http_status_code());
+        CHECK(fourth_result.etag() == third_result.etag());
+        CHECK_EQUAL(new_int32_value, fourth_result.entity().properties().at(U("PropertyA")).int32_value());
+
+        table.delete_table();
+    }
+
+    TEST(Table_HotPartitions)
+    {
+        wa::storage::cloud_table table = get_table();
+        wa::storage::cloud_table_client client = table.service_client();
+
+        CHECK_THROW(client.set_partition_sampling_rate(1.5), std::invalid_argument);
+        CHECK(client.hot_partitions(10).empty());
+
+        // Copies of the service client share the statistics, and every operation is sampled
+        client.set_partition_sampling_rate(1.0);
+        CHECK_EQUAL(1.0, table.service_client().partition_sampling_rate());
+
+        utility::string_t hot_partition_key = get_random_string();
+        utility::string_t cold_partition_key = get_random_string();
+        for (int i = 0; i < 3; ++i)
+        {
+            table.execute(wa::storage::table_operation::insert_entity(wa::storage::table_entity(hot_partition_key, get_random_string())));
+        }
+
+        table.execute(wa::storage::table_operation::insert_entity(wa::storage::table_entity(cold_partition_key, get_random_string())));
+
+        std::vector<wa::storage::table_partition_statistics> partitions = client.hot_partitions(10);
+        CHECK_EQUAL(2U, partitions.size());
+        if (partitions.size() == 2U)
+        {
+            CHECK(partitions[0].table_name() == table.name());
+            CHECK(partitions[0].partition_key() == hot_partition_key);
+            CHECK_EQUAL(3U, partitions[0].operation_count());
+            CHECK_EQUAL(0U, partitions[0].throttled_count());
+            CHECK(partitions[1].partition_key() == cold_partition_key);
+            CHECK_EQUAL(1U, partitions[1].operation_count());
+        }
+
+        CHECK_EQUAL(1U, client.hot_partitions(1).size());
+
+        client.reset_partition_statistics();
+        CHECK(client.hot_partitions(10).empty());
+
+        client.set_partition_sampling_rate(0.0);
+        table.execute(wa::storage::table_operation::insert_entity(wa::storage::table_entity(hot_partition_key, get_random_string())));
+        CHECK(client.hot_partitions(10).empty());
+
+        table.delete_table();
+    }
+
     TEST(EntityQuery_Normal)
     {
         wa::storage::cloud_table table = get_table();
@@ -2656,6 +3094,649 @@ SUITE(Table)
         table.delete_table();
     }
 
+    TEST(EntityQuery_Handler)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key = get_random_string();
+
+        {
+            wa::storage::table_batch_operation operation;
+
+            for (int row = 0; row < 26; ++row)
+            {
+                wa::storage::table_entity entity(partition_key, get_string('a', 'a' + row));
+                operation.insert_entity(entity);
+            }
+
+            table.execute_batch(operation);
+        }
+
+        wa::storage::table_query query;
+        query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_key));
+        query.set_take_count(10);
+
+        for (int prefetch = 0; prefetch <= 1; ++prefetch)
+        {
+            wa::storage::table_request_options options;
+            wa::storage::operation_context context;
+
+            std::vector<utility::string_t> row_keys;
+            table.execute_query(query, [&row_keys] (const wa::storage::table_entity& entity) -> bool
+            {
+                row_keys.push_back(entity.row_key());
+                return true;
+            }, prefetch != 0, options, context);
+
+            CHECK_EQUAL(26U, row_keys.size());
+            CHECK_EQUAL(3, context.request_results().size());
+
+            for (size_t i = 0; i < row_keys.size(); ++i)
+            {
+                CHECK(row_keys[i] == get_string('a', 'a' + (utility::char_t)i));
+            }
+        }
+
+        {
+            wa::storage::table_request_options options;
+            wa::storage::operation_context context;
+
+            int count = 0;
+            table.execute_query_async(query, [&count] (const wa::storage::table_entity&) -> bool
+            {
+                return ++count < 15;
+            }, false, options, context).wait();
+
+            CHECK_EQUAL(15, count);
+            CHECK_EQUAL(2, context.request_results().size());
+        }
+
+        table.delete_table();
+    }
+
+    struct mapped_entity
+    {
+        utility::string_t partition_key;
+        utility::string_t row_key;
+        utility::string_t etag;
+        int32_t int32_value;
+        int64_t int64_value;
+        double double_value;
+        utility::string_t string_value;
+        utility::datetime datetime_value;
+    };
+
+    TEST(EntityQuery_Mapping)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key = get_random_string();
+
+        wa::storage::table_entity_mapping<mapped_entity> mapping;
+        mapping.partition_key(&mapped_entity::partition_key)
+            .row_key(&mapped_entity::row_key)
+            .etag(&mapped_entity::etag)
+            .property(U("PropertyA"), &mapped_entity::int32_value)
+            .property(U("PropertyB"), &mapped_entity::int64_value)
+            .property(U("PropertyC"), &mapped_entity::double_value)
+            .property(U("PropertyD"), &mapped_entity::string_value)
+            .property(U("PropertyE"), &mapped_entity::datetime_value);
+
+        std::vector<mapped_entity> values;
+        {
+            wa::storage::table_batch_operation operation;
+
+            for (int row = 0; row < 26; ++row)
+            {
+                mapped_entity value;
+                value.partition_key = partition_key;
+                value.row_key = get_string('a', 'a' + row);
+                value.int32_value = get_random_int32();
+                value.int64_value = get_random_int64();
+                value.double_value = get_random_double();
+                value.string_value = get_random_string();
+                value.datetime_value = get_random_datetime();
+                values.push_back(value);
+
+                wa::storage::table_entity entity = mapping.write_entity(value);
+
+                // Properties that are not mapped are skipped when reading
+                entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyF"), wa::storage::entity_property(get_random_binary_data())));
+                operation.insert_entity(entity);
+            }
+
+            table.execute_batch(operation);
+        }
+
+        wa::storage::table_query query;
+        query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_key));
+        query.set_take_count(10);
+
+        for (int payload = 0; payload <= 1; ++payload)
+        {
+            wa::storage::table_request_options options;
+            wa::storage::operation_context context;
+
+            // Without metadata the types of the properties come from the mapping
+            options.set_payload_format(payload == 0 ? wa::storage::table_payload_format::json : wa::storage::table_payload_format::json_no_metadata);
+
+            std::vector<mapped_entity> results;
+            table.execute_query_async(query, mapping, [&results] (const mapped_entity& value) -> bool
+            {
+                results.push_back(value);
+                return true;
+            }, options, context).wait();
+
+            CHECK_EQUAL(values.size(), results.size());
+
+            for (size_t i = 0; i < results.size() && i < values.size(); ++i)
+            {
+                CHECK(results[i].partition_key == values[i].partition_key);
+                CHECK(results[i].row_key == values[i].row_key);
+                CHECK_EQUAL(values[i].int32_value, results[i].int32_value);
+                CHECK_EQUAL(values[i].int64_value, results[i].int64_value);
+                CHECK_EQUAL(values[i].double_value, results[i].double_value);
+                CHECK(results[i].string_value == values[i].string_value);
+                CHECK(results[i].datetime_value == values[i].datetime_value);
+            }
+        }
+
+        {
+            int count = 0;
+            table.execute_query(query, mapping, [&count] (const mapped_entity&) -> bool
+            {
+                return ++count < 5;
+            });
+
+            CHECK_EQUAL(5, count);
+        }
+
+        table.delete_table();
+    }
+
+    TEST(EntityQuery_Columnar)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key = get_random_string();
+
+        std::vector<int32_t> int32_values;
+        std::vector<utility::string_t> string_values;
+        {
+            wa::storage::table_batch_operation operation;
+
+            for (int row = 0; row < 26; ++row)
+            {
+                wa::storage::table_entity entity(partition_key, get_string('a', 'a' + row));
+                int32_values.push_back(get_random_int32());
+                entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(int32_values.back())));
+
+                // Every third entity does not have the string property, which becomes a null
+                string_values.push_back(row % 3 == 0 ? utility::string_t() : get_random_string());
+                if (row % 3 != 0)
+                {
+                    entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyB"), wa::storage::entity_property(string_values.back())));
+                }
+
+                operation.insert_entity(entity);
+            }
+
+            table.execute_batch(operation);
+        }
+
+        wa::storage::table_query query;
+        query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_key));
+
+        std::vector<std::pair<utility::string_t, wa::storage::edm_type>> columns;
+        columns.push_back(std::make_pair(utility::string_t(U("PropertyA")), wa::storage::edm_type::int32));
+        columns.push_back(std::make_pair(utility::string_t(U("PropertyB")), wa::storage::edm_type::string));
+
+        std::vector<size_t> batch_sizes;
+        size_t row = 0;
+        table.execute_query_columnar(query, columns, 10, [&] (const wa::storage::table_column_batch& batch) -> bool
+        {
+            batch_sizes.push_back(batch.size());
+            CHECK_EQUAL(2U, batch.columns().size());
+            CHECK_EQUAL(batch.size(), batch.partition_keys().size());
+
+            const wa::storage::table_column& int32_column = batch.columns()[0];
+            const wa::storage::table_column& string_column = batch.columns()[1];
+            CHECK_EQUAL(batch.size() + 1, string_column.offsets().size());
+
+            for (size_t i = 0; i < batch.size() && row < int32_values.size(); ++i, ++row)
+            {
+                CHECK(batch.partition_keys().string_value(i) == partition_key);
+                CHECK(batch.row_keys().string_value(i) == get_string('a', 'a' + static_cast<int>(row)));
+                CHECK(!int32_column.is_null(i));
+                CHECK_EQUAL(int32_values[row], int32_column.int32_value(i));
+                CHECK_EQUAL(row % 3 == 0, string_column.is_null(i));
+                CHECK(string_column.string_value(i) == string_values[row]);
+            }
+
+            return true;
+        });
+
+        CHECK_EQUAL(26U, row);
+        CHECK_EQUAL(3U, batch_sizes.size());
+        CHECK_EQUAL(6U, batch_sizes.back());
+
+        {
+            int count = 0;
+            table.execute_query_columnar(query, columns, 10, [&count] (const wa::storage::table_column_batch&) -> bool
+            {
+                ++count;
+                return false;
+            });
+
+            CHECK_EQUAL(1, count);
+        }
+
+        table.delete_table();
+    }
+
+    TEST(EntityQuery_Projection)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key = get_random_string();
+        utility::string_t row_key = get_random_string();
+        int64_t int64_value = get_random_int64();
+        utility::datetime datetime_value = get_random_datetime();
+
+        {
+            wa::storage::table_entity entity(partition_key, row_key);
+            entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(int64_value)));
+            entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyB"), wa::storage::entity_property(datetime_value)));
+            entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyC"), wa::storage::entity_property(get_random_string())));
+            entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyD"), wa::storage::entity_property(get_random_binary_data())));
+
+            table.execute(wa::storage::table_operation::insert_entity(entity));
+        }
+
+        wa::storage::table_query query;
+        query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_key));
+
+        std::vector<utility::string_t> select_columns;
+        select_columns.push_back(U("PropertyA"));
+        select_columns.push_back(U("PropertyB"));
+        query.set_select_columns(select_columns);
+
+        wa::storage::table_request_options options;
+        wa::storage::operation_context context;
+
+        // Without metadata the 64-bit integer and the date/time would otherwise be read as strings
+        int resolved_count = 0;
+        options.set_payload_format(wa::storage::table_payload_format::json_no_metadata);
+        options.set_property_resolver([&resolved_count, partition_key, row_key] (const utility::string_t& entity_partition_key, const utility::string_t& entity_row_key, const utility::string_t& property_name, const utility::string_t&) -> wa::storage::edm_type
+        {
+            ++resolved_count;
+            CHECK(entity_partition_key == partition_key);
+            CHECK(entity_row_key == row_key);
+            return property_name == U("PropertyA") ? wa::storage::edm_type::int64 : wa::storage::edm_type::datetime;
+        });
+
+        std::vector<wa::storage::table_entity> results = table.execute_query(query, options, context);
+
+        CHECK_EQUAL(1U, results.size());
+        CHECK_EQUAL(2, resolved_count);
+
+        if (!results.empty())
+        {
+            const wa::storage::table_entity::properties_type& properties = results[0].properties();
+
+            CHECK_EQUAL(2U, properties.size());
+            CHECK(properties.find(U("PropertyA")) != properties.cend());
+            CHECK(properties.find(U("PropertyB")) != properties.cend());
+
+            if (properties.size() == 2U)
+            {
+                CHECK(properties.at(U("PropertyA")).property_type() == wa::storage::edm_type::int64);
+                CHECK_EQUAL(int64_value, properties.at(U("PropertyA")).int64_value());
+                CHECK(properties.at(U("PropertyB")).property_type() == wa::storage::edm_type::datetime);
+                CHECK(properties.at(U("PropertyB")).datetime_value() == datetime_value);
+            }
+        }
+
+        table.delete_table();
+    }
+
+    TEST(EntityQuery_Parallel)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        std::vector<utility::string_t> partition_keys;
+        for (int partition = 0; partition < 4; ++partition)
+        {
+            partition_keys.push_back(get_random_string());
+        }
+
+        std::sort(partition_keys.begin(), partition_keys.end());
+
+        for (std::vector<utility::string_t>::const_iterator itr = partition_keys.cbegin(); itr != partition_keys.cend(); ++itr)
+        {
+            wa::storage::table_batch_operation operation;
+
+            for (int row = 0; row < 26; ++row)
+            {
+                wa::storage::table_entity entity(*itr, get_string('a', 'a' + row));
+                operation.insert_entity(entity);
+            }
+
+            table.execute_batch(operation);
+        }
+
+        // The first boundary is inside the first partition, so the first range holds no entity
+        std::vector<utility::string_t> boundaries;
+        boundaries.push_back(partition_keys[0]);
+        boundaries.push_back(partition_keys[2]);
+
+        wa::storage::table_query query;
+        wa::storage::table_request_options options;
+        wa::storage::operation_context context;
+
+        options.set_parallelism_factor(3);
+
+        {
+            std::vector<wa::storage::table_entity> results;
+            table.execute_query_parallel(query, boundaries, true, [&results] (const wa::storage::table_entity& entity) -> bool
+            {
+                results.push_back(entity);
+                return true;
+            }, options, context);
+
+            CHECK_EQUAL(104U, results.size());
+
+            for (size_t i = 1; i < results.size(); ++i)
+            {
+                CHECK(results[i - 1].partition_key() < results[i].partition_key() ||
+                    (results[i - 1].partition_key() == results[i].partition_key() && results[i - 1].row_key() < results[i].row_key()));
+            }
+        }
+
+        {
+            std::vector<wa::storage::table_entity> results;
+            query.set_filter_string(wa::storage::table_query::generate_filter_condition(U("RowKey"), wa::storage::query_comparison_operator::less_than, get_string('a', 'k')));
+            query.set_take_count(4);
+
+            table.execute_query_parallel(query, boundaries, false, [&results] (const wa::storage::table_entity& entity) -> bool
+            {
+                results.push_back(entity);
+                return true;
+            }, options, context);
+
+            CHECK_EQUAL(40U, results.size());
+        }
+
+        {
+            int count = 0;
+            table.execute_query_parallel(query, boundaries, false, [&count] (const wa::storage::table_entity&) -> bool
+            {
+                return ++count < 5;
+            }, options, context);
+
+            CHECK_EQUAL(5, count);
+        }
+
+        {
+            // The partitions named by the filter are queried on their own, without boundaries
+            std::vector<wa::storage::table_entity> results;
+            query.set_filter_string(wa::storage::table_query::combine_filter_conditions(
+                wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_keys[3]),
+                wa::storage::query_logical_operator::or,
+                wa::storage::table_query::generate_filter_condition(U("PartitionKey"), wa::storage::query_comparison_operator::equal, partition_keys[1])));
+            query.set_take_count(-1);
+
+            table.execute_query_parallel(query, std::vector<utility::string_t>(), true, [&results] (const wa::storage::table_entity& entity) -> bool
+            {
+                results.push_back(entity);
+                return true;
+            }, options, context);
+
+            CHECK_EQUAL(52U, results.size());
+            CHECK(results.front().partition_key() == partition_keys[1]);
+            CHECK(results.back().partition_key() == partition_keys[3]);
+
+            std::vector<wa::storage::table_entity> serial_results = table.execute_query(query, options, context);
+            CHECK_EQUAL(52U, serial_results.size());
+            CHECK(serial_results.front().partition_key() == partition_keys[1]);
+            CHECK(serial_results.back().partition_key() == partition_keys[3]);
+        }
+
+        table.delete_table();
+    }
+
+    TEST(EntityQuery_PartitionKeyRanges)
+    {
+        typedef wa::storage::table_query table_query;
+        typedef wa::storage::query_comparison_operator comparison;
+        typedef wa::storage::query_logical_operator logical;
+
+        utility::string_t key_a = table_query::generate_filter_condition(U("PartitionKey"), comparison::equal, U("a"));
+        utility::string_t key_b = table_query::generate_filter_condition(U("PartitionKey"), comparison::equal, U("b"));
+        utility::string_t row = table_query::generate_filter_condition(U("RowKey"), comparison::equal, U("r"));
+        utility::string_t range = table_query::combine_filter_conditions(table_query::generate_filter_condition(U("PartitionKey"), comparison::greater_than_or_equal, U("c")),
+            logical::and, table_query::generate_filter_condition(U("PartitionKey"), comparison::less_than, U("x")));
+
+        // Filters that do not restrict the PartitionKey match every partition
+        CHECK(wa::storage::core::get_partition_key_ranges(utility::string_t()).front().is_unbounded());
+        CHECK(wa::storage::core::get_partition_key_ranges(row).front().is_unbounded());
+        CHECK(wa::storage::core::get_partition_key_ranges(table_query::combine_filter_conditions(key_a, logical::or, row)).front().is_unbounded());
+        CHECK(wa::storage::core::get_partition_key_ranges(U("not (") + key_a + U(")")).front().is_unbounded());
+        CHECK(wa::storage::core::get_partition_key_ranges(U("(") + key_a).front().is_unbounded());
+
+        // A filter no entity can match has no range at all
+        CHECK(wa::storage::core::get_partition_key_ranges(table_query::combine_filter_conditions(key_a, logical::and, key_b)).empty());
+
+        // Equality sets become one range per key, in order, and other conditions are left to the service
+        std::vector<wa::storage::core::partition_key_range> ranges = wa::storage::core::get_partition_key_ranges(table_query::combine_filter_conditions(table_query::combine_filter_conditions(key_b, logical::or, key_a), logical::and, row));
+        CHECK_EQUAL(2U, ranges.size());
+        CHECK(ranges[0].is_point() && ranges[0].lower == U("a"));
+        CHECK(ranges[1].is_point() && ranges[1].lower == U("b"));
+        CHECK(wa::storage::core::get_partition_key_filter(ranges[0]) == key_a);
+
+        // A quoted value and a value on the left of the comparison are read as the service reads them
+        ranges = wa::storage::core::get_partition_key_ranges(U("'q' lt PartitionKey and PartitionKey eq 'it''s' or Count gt 5L and PartitionKey eq 'z'"));
+        CHECK_EQUAL(1U, ranges.size());
+        CHECK(ranges[0].is_point() && ranges[0].lower == U("z"));
+
+        // Boundaries split a range only where they fall inside it
+        std::vector<utility::string_t> boundaries;
+        boundaries.push_back(U("a"));
+        boundaries.push_back(U("m"));
+        boundaries.push_back(U("z"));
+        ranges = wa::storage::core::split_partition_key_ranges(wa::storage::core::get_partition_key_ranges(table_query::combine_filter_conditions(range, logical::and, row)), boundaries);
+        CHECK_EQUAL(2U, ranges.size());
+        CHECK(wa::storage::core::get_partition_key_filter(ranges[0]) == table_query::combine_filter_conditions(table_query::generate_filter_condition(U("PartitionKey"), comparison::greater_than_or_equal, U("c")),
+            logical::and, table_query::generate_filter_condition(U("PartitionKey"), comparison::less_than, U("m"))));
+        CHECK(wa::storage::core::get_partition_key_filter(ranges[1]) == table_query::combine_filter_conditions(table_query::generate_filter_condition(U("PartitionKey"), comparison::greater_than_or_equal, U("m")),
+            logical::and, table_query::generate_filter_condition(U("PartitionKey"), comparison::less_than, U("x"))));
+    }
+
+    TEST(EntityQuery_Spill)
+    {
+        wa::storage::cloud_table table = get_table();
+        utility::string_t partition_key = get_random_string();
+
+        wa::storage::table_batch_operation operation;
+        for (int row = 0; row < 26; ++row)
+        {
+            wa::storage::table_entity entity(partition_key, get_string('a', 'a' + row));
+            entity.properties().insert(std::make_pair(U("Name"), wa::storage::entity_property(get_random_string())));
+            entity.properties().insert(std::make_pair(U("Count"), wa::storage::entity_property(-row)));
+            entity.properties().insert(std::make_pair(U("Total"), wa::storage::entity_property(static_cast<int64_t>(row) << 40)));
+            entity.properties().insert(std::make_pair(U("Ratio"), wa::storage::entity_property(row / 4.0)));
+            entity.properties().insert(std::make_pair(U("Data"), wa::storage::entity_property(std::vector<uint8_t>(row + 1, static_cast<uint8_t>(row)))));
+            operation.insert_entity(entity);
+        }
+
+        table.execute_batch(operation);
+
+        wa::storage::table_query query;
+        std::vector<wa::storage::table_entity> expected = table.execute_query(query);
+        CHECK_EQUAL(26U, expected.size());
+
+        // Only the first entities are kept in memory, and the rest are read back from the file with the same values
+        wa::storage::table_query_result result = table.execute_query(query, 4096, U("."), wa::storage::table_request_options(), wa::storage::operation_context());
+        CHECK_EQUAL(26U, result.size());
+        CHECK(result.spilled_count() > 0U);
+        CHECK(result.spilled_count() < 26U);
+
+        wa::storage::table_entity entity;
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            CHECK(result.read_next(entity));
+            CHECK(entity.partition_key() == expected[i].partition_key());
+            CHECK(entity.row_key() == expected[i].row_key());
+            CHECK(entity.etag() == expected[i].etag());
+            CHECK(entity.timestamp() == expected[i].timestamp());
+            CHECK(entity.properties().at(U("Name")).string_value() == expected[i].properties().at(U("Name")).string_value());
+            CHECK_EQUAL(expected[i].properties().at(U("Count")).int32_value(), entity.properties().at(U("Count")).int32_value());
+            CHECK_EQUAL(expected[i].properties().at(U("Total")).int64_value(), entity.properties().at(U("Total")).int64_value());
+            CHECK_EQUAL(expected[i].properties().at(U("Ratio")).double_value(), entity.properties().at(U("Ratio")).double_value());
+            CHECK(entity.properties().at(U("Data")).binary_value() == expected[i].properties().at(U("Data")).binary_value());
+        }
+
+        CHECK(!result.read_next(entity));
+        CHECK_THROW(table.execute_query_async(query, 4096, utility::string_t(), wa::storage::table_request_options(), wa::storage::operation_context()), std::invalid_argument);
+
+        table.delete_table();
+    }
+
+    TEST(EntityQuery_ScanUnits)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        std::vector<utility::string_t> partition_keys;
+        for (int partition = 0; partition < 3; ++partition)
+        {
+            partition_keys.push_back(get_random_string());
+        }
+
+        std::sort(partition_keys.begin(), partition_keys.end());
+
+        for (std::vector<utility::string_t>::const_iterator itr = partition_keys.cbegin(); itr != partition_keys.cend(); ++itr)
+        {
+            wa::storage::table_batch_operation operation;
+
+            for (int row = 0; row < 10; ++row)
+            {
+                wa::storage::table_entity entity(*itr, get_string('a', 'a' + row));
+                operation.insert_entity(entity);
+            }
+
+            table.execute_batch(operation);
+        }
+
+        std::vector<utility::string_t> boundaries;
+        boundaries.push_back(partition_keys[1]);
+
+        wa::storage::table_query query;
+        query.set_take_count(4);
+
+        std::vector<wa::storage::table_scan_unit> units = wa::storage::table_scan_unit::split(query, boundaries);
+        CHECK_EQUAL(2U, units.size());
+        CHECK(units[0].lower_partition_key().empty());
+        CHECK(units[0].upper_partition_key() == partition_keys[1]);
+        CHECK(units[1].lower_partition_key() == partition_keys[1]);
+        CHECK(units[1].upper_partition_key().empty());
+
+        // Each segment is processed by a unit read back from the text saved after the previous one
+        std::vector<size_t> counts;
+        for (std::vector<wa::storage::table_scan_unit>::const_iterator itr = units.cbegin(); itr != units.cend(); ++itr)
+        {
+            size_t count = 0;
+            utility::string_t saved = itr->to_string();
+            wa::storage::table_scan_unit unit = wa::storage::table_scan_unit::parse(saved);
+            while (!unit.is_complete())
+            {
+                wa::storage::table_query_segment segment = table.execute_query_segmented(unit.query(), unit.continuation_token());
+                count += segment.results().size();
+                unit.advance(segment.continuation_token());
+
+                saved = unit.to_string();
+                unit = wa::storage::table_scan_unit::parse(saved);
+            }
+
+            CHECK(unit.lower_partition_key() == itr->lower_partition_key());
+            CHECK(unit.upper_partition_key() == itr->upper_partition_key());
+            counts.push_back(count);
+        }
+
+        CHECK_EQUAL(10U, counts[0]);
+        CHECK_EQUAL(20U, counts[1]);
+
+        CHECK_THROW(wa::storage::table_scan_unit::parse(U("filter=x\n")), std::invalid_argument);
+        CHECK_THROW(wa::storage::table_scan_unit::parse(U("version=1\ntake_count=%zz\n")), std::invalid_argument);
+        CHECK_THROW(wa::storage::table_scan_unit::parse(U("version=2\n")), std::invalid_argument);
+
+        table.delete_table();
+    }
+
+    TEST(EntityQuery_MultiGet)
+    {
+        wa::storage::cloud_table table = get_table();
+
+        utility::string_t partition_key = get_random_string();
+        utility::string_t other_partition_key = get_random_string();
+
+        {
+            wa::storage::table_batch_operation operation;
+
+            for (int row = 0; row < 20; ++row)
+            {
+                wa::storage::table_entity entity(partition_key, get_string('a', 'a' + row));
+                entity.properties().insert(wa::storage::table_entity::property_type(U("PropertyA"), wa::storage::entity_property(static_cast<int32_t>(row))));
+                operation.insert_entity(entity);
+            }
+
+            table.execute_batch(operation);
+            table.execute(wa::storage::table_operation::insert_entity(wa::storage::table_entity(other_partition_key, U("a"))));
+        }
+
+        // The rows of the first partition are read by queries, and the two keys of the other partition one by one
+        std::vector<std::pair<utility::string_t, utility::string_t>> keys;
+        for (int row = 19; row >= 0; --row)
+        {
+            keys.push_back(std::make_pair(partition_key, get_string('a', 'a' + row)));
+        }
+
+        keys.push_back(std::make_pair(partition_key, U("missing")));
+        keys.push_back(std::make_pair(other_partition_key, U("a")));
+        keys.push_back(std::make_pair(other_partition_key, U("missing")));
+        keys.push_back(std::make_pair(partition_key, get_string('a', 'a')));
+
+        wa::storage::table_request_options options;
+        wa::storage::operation_context context;
+
+        options.set_parallelism_factor(3);
+
+        std::vector<wa::storage::table_result> results = table.retrieve_entities(keys, options, context);
+
+        CHECK_EQUAL(4U, context.request_results().size());
+        CHECK_EQUAL(keys.size(), results.size());
+
+        for (int row = 0; row < 20; ++row)
+        {
+            const wa::storage::table_result& result = results[19 - row];
+            CHECK_EQUAL(200, result.http_status_code());
+            CHECK(!result.etag().empty());
+            CHECK(result.entity().partition_key() == partition_key);
+            CHECK(result.entity().row_key() == get_string('a', 'a' + row));
+            CHECK_EQUAL(row, result.entity().properties().at(U("PropertyA")).int32_value());
+        }
+
+        CHECK_EQUAL(404, results[20].http_status_code());
+        CHECK_EQUAL(200, results[21].http_status_code());
+        CHECK(results[21].entity().partition_key() == other_partition_key);
+        CHECK_EQUAL(404, results[22].http_status_code());
+        CHECK_EQUAL(200, results[23].http_status_code());
+        CHECK(results[23].entity().row_key() == get_string('a', 'a'));
+
+        CHECK(table.retrieve_entities(std::vector<std::pair<utility::string_t, utility::string_t>>()).empty());
+
+        table.delete_table();
+    }
+
     TEST(Table_Permissions)
     {
         wa::storage::cloud_table table = get_table();
@@ -1,4 +1,4 @@
-// -----------------------------------------------------------------------------------------
+﻿// -----------------------------------------------------------------------------------------
 // <copyright file="executor_test.cpp" company="Microsoft">
 //    Copyright 2013 Microsoft Corporation
 //
@@ -19,6 +19,415 @@
 #include "blob_test_base.h"
 #include "check_macros.h"
 
+#include "was/await.h"
+#include "was/in_memory_transport.h"
+#include "was/table.h"
+#include "wascore/hash_software.h"
+#include "wascore/streams.h"
+#include "wascore/util.h"
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    class counting_scheduler : public pplx::scheduler_interface
+    {
+    public:
+
+        counting_scheduler()
+            : m_count(0)
+        {
+        }
+
+        virtual void schedule(pplx::TaskProc_t proc, void* parameter) override
+        {
+            ++m_count;
+            std::thread(proc, parameter).detach();
+        }
+
+        int count() const
+        {
+            return m_count;
+        }
+
+    private:
+
+        std::atomic<int> m_count;
+    };
+
+    // Only serves the requests to one host, as a multiplexing transport would for the endpoints that negotiate its protocol
+    class single_host_transport : public wa::storage::in_memory_transport
+    {
+    public:
+
+        explicit single_host_transport(utility::string_t host)
+            : m_host(std::move(host))
+        {
+        }
+
+        virtual bool can_send(const web::http::uri& authority) override
+        {
+            return authority.host() == m_host;
+        }
+
+    private:
+
+        utility::string_t m_host;
+    };
+
+    utility::string_t get_md5(const uint8_t* data, size_t size)
+    {
+        wa::storage::core::hash_md5_streambuf md5;
+        md5.putn(data, size).wait();
+        md5.close().wait();
+        return utility::conversions::to_base64(md5.hash());
+    }
+
+    std::string to_hex(const std::vector<unsigned char>& digest)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        for (auto iter = digest.cbegin(); iter != digest.cend(); ++iter)
+        {
+            hex.push_back(digits[*iter >> 4]);
+            hex.push_back(digits[*iter & 0x0f]);
+        }
+
+        return hex;
+    }
+
+    template<typename Hash>
+    std::string get_digest(Hash hash, const std::string& message)
+    {
+        hash.update(reinterpret_cast<const uint8_t*>(message.data()), message.size());
+        return to_hex(hash.finalize());
+    }
+
+    // Hashes the message in chunks of the given size, so that the chunks straddle the 64-byte blocks in every way
+    template<typename Hash>
+    std::string get_chunked_digest(Hash hash, const std::string& message, size_t chunk_size)
+    {
+        for (size_t offset = 0; offset < message.size(); offset += chunk_size)
+        {
+            hash.update(reinterpret_cast<const uint8_t*>(message.data()) + offset, std::min(chunk_size, message.size() - offset));
+        }
+
+        return to_hex(hash.finalize());
+    }
+
+    // Serves the downloads of one blob, but cuts the body of the first responses short after a number of bytes, as a
+    // connection lost in the middle of the body would. The headers of every request are kept for the test to check.
+    class interrupting_transport : public wa::storage::http_transport
+    {
+    public:
+
+        interrupting_transport(std::vector<uint8_t> content, size_t cut_after, int interruptions)
+            : m_content(std::move(content)), m_cut_after(cut_after), m_interruptions(interruptions)
+        {
+        }
+
+        virtual pplx::task<web::http::http_response> send(web::http::http_request request, const pplx::cancellation_token&) override
+        {
+            bool interrupt;
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_requests.push_back(request.headers());
+                interrupt = m_interruptions > 0;
+                if (interrupt)
+                {
+                    --m_interruptions;
+                }
+            }
+
+            // The range has the form "bytes=start-end", and the end may be left out
+            size_t start = 0;
+            size_t end = m_content.size();
+            utility::string_t range;
+            bool is_range = request.headers().match(U("x-ms-range"), range);
+            if (is_range)
+            {
+                auto value = utility::conversions::to_utf8string(range);
+                auto separator = value.find('-');
+                start = static_cast<size_t>(std::stoull(value.substr(6, separator - 6)));
+                if (separator + 1 < value.size())
+                {
+                    end = std::min(end, static_cast<size_t>(std::stoull(value.substr(separator + 1))) + 1);
+                }
+            }
+
+            web::http::http_response response(is_range ? web::http::status_codes::PartialContent : web::http::status_codes::OK);
+            response.headers().add(U("x-ms-request-id"), utility::uuid_to_string(utility::new_uuid()));
+            response.headers().add(U("x-ms-blob-type"), U("BlockBlob"));
+            response.headers().add(web::http::header_names::etag, U("\"0x8D0B3F4E5A6C7D8\""));
+            response.headers().add(web::http::header_names::last_modified, U("Wed, 09 Sep 2009 09:20:02 GMT"));
+            response.headers().set_content_type(U("application/octet-stream"));
+            response.headers().set_content_length(end - start);
+            if (is_range)
+            {
+                utility::ostringstream_t content_range;
+                content_range << U("bytes ") << start << U('-') << (end - 1) << U('/') << m_content.size();
+                response.headers().add(web::http::header_names::content_range, content_range.str());
+            }
+
+            // A whole blob comes with its MD5, and a range with its own only if it was asked for
+            utility::string_t range_md5;
+            if (!is_range)
+            {
+                response.headers().add(web::http::header_names::content_md5, get_md5(m_content.data(), m_content.size()));
+            }
+            else if (request.headers().match(U("x-ms-range-get-content-md5"), range_md5) && range_md5 == U("true"))
+            {
+                response.headers().add(web::http::header_names::content_md5, get_md5(m_content.data() + start, end - start));
+            }
+
+            size_t length = interrupt ? std::min(m_cut_after, end - start) : end - start;
+            auto response_stream = request._get_impl()->_response_stream();
+            if (length > 0)
+            {
+                response_stream.streambuf().putn(m_content.data() + start, length).wait();
+            }
+
+            if (interrupt)
+            {
+                response._get_impl()->_complete(length, std::make_exception_ptr(web::http::http_exception(U("The connection was lost"))));
+            }
+            else
+            {
+                response._get_impl()->_complete(length);
+            }
+
+            return pplx::task_from_result(response);
+        }
+
+        std::vector<web::http::http_headers> requests() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_requests;
+        }
+
+    private:
+
+        std::vector<uint8_t> m_content;
+        size_t m_cut_after;
+        int m_interruptions;
+        std::vector<web::http::http_headers> m_requests;
+        mutable std::mutex m_mutex;
+    };
+
+    wa::storage::cloud_block_blob get_transport_blob(std::shared_ptr<wa::storage::http_transport> transport)
+    {
+        wa::storage::blob_request_options default_options;
+        default_options.set_transport(transport);
+        default_options.set_retry_policy(wa::storage::linear_retry_policy(std::chrono::seconds(1), 3));
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+        return client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+    }
+
+#ifndef WIN32
+    // A plain HTTP server on a loopback port, which answers every request it reads with the same bytes after a delay.
+    class loopback_server
+    {
+    public:
+
+        explicit loopback_server(std::string response, std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+            : m_response(std::move(response)), m_delay(delay), m_request_count(0), m_in_flight(0), m_max_in_flight(0)
+        {
+            sockaddr_in address;
+            std::memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t address_length = sizeof(address);
+
+            m_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (m_socket < 0 || ::bind(m_socket, reinterpret_cast<sockaddr*>(&address), address_length) != 0 ||
+                ::listen(m_socket, 16) != 0 || ::getsockname(m_socket, reinterpret_cast<sockaddr*>(&address), &address_length) != 0)
+            {
+                throw std::runtime_error("The loopback server could not listen");
+            }
+
+            m_port = ntohs(address.sin_port);
+            m_accept_thread = std::thread([this] () { accept_connections(); });
+        }
+
+        ~loopback_server()
+        {
+            // Shutting the sockets down wakes the threads blocked on them
+            ::shutdown(m_socket, SHUT_RDWR);
+            m_accept_thread.join();
+            for (auto connection : m_connections)
+            {
+                ::shutdown(connection, SHUT_RDWR);
+            }
+
+            for (auto& thread : m_threads)
+            {
+                thread.join();
+            }
+
+            for (auto connection : m_connections)
+            {
+                ::close(connection);
+            }
+
+            ::close(m_socket);
+        }
+
+        web::http::uri uri() const
+        {
+            return web::http::uri(U("http://127.0.0.1:") + utility::conversions::print_string(m_port));
+        }
+
+        int request_count() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_request_count;
+        }
+
+        std::vector<std::string> requests() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_requests;
+        }
+
+        // The most requests that were waiting for their response at the same time
+        int max_in_flight() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_max_in_flight;
+        }
+
+    private:
+
+        void accept_connections()
+        {
+            for (;;)
+            {
+                int connection = ::accept(m_socket, nullptr, nullptr);
+                if (connection < 0)
+                {
+                    return;
+                }
+
+                m_connections.push_back(connection);
+                m_threads.push_back(std::thread([this, connection] () { serve(connection); }));
+            }
+        }
+
+        void serve(int connection)
+        {
+            std::string received;
+            for (;;)
+            {
+                // A request ends after its headers and the body they announce
+                size_t headers_end;
+                while ((headers_end = received.find("\r\n\r\n")) == std::string::npos)
+                {
+                    if (!receive(connection, received))
+                    {
+                        return;
+                    }
+                }
+
+                std::string headers = received.substr(0, headers_end);
+                std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+                size_t request_length = headers_end + 4;
+                auto content_length = headers.find("\r\ncontent-length:");
+                if (content_length != std::string::npos)
+                {
+                    request_length += std::stoul(headers.substr(content_length + 17));
+                }
+
+                while (received.size() < request_length)
+                {
+                    if (!receive(connection, received))
+                    {
+                        return;
+                    }
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    m_requests.push_back(received.substr(0, request_length));
+                    ++m_request_count;
+                    m_max_in_flight = std::max(m_max_in_flight, ++m_in_flight);
+                }
+
+                received.erase(0, request_length);
+                std::this_thread::sleep_for(m_delay);
+
+                // The request stops counting before its response leaves, so that the next one it lets through never overlaps it
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    --m_in_flight;
+                }
+
+                for (size_t sent = 0; sent < m_response.size();)
+                {
+                    auto result = ::send(connection, m_response.data() + sent, m_response.size() - sent, MSG_NOSIGNAL);
+                    if (result <= 0)
+                    {
+                        return;
+                    }
+
+                    sent += static_cast<size_t>(result);
+                }
+            }
+        }
+
+        static bool receive(int connection, std::string& received)
+        {
+            char buffer[4096];
+            auto result = ::recv(connection, buffer, sizeof(buffer), 0);
+            if (result <= 0)
+            {
+                return false;
+            }
+
+            received.append(buffer, static_cast<size_t>(result));
+            return true;
+        }
+
+        std::string m_response;
+        std::chrono::milliseconds m_delay;
+        int m_socket;
+        uint16_t m_port;
+        std::thread m_accept_thread;
+        std::vector<int> m_connections;
+        std::vector<std::thread> m_threads;
+        std::vector<std::string> m_requests;
+        int m_request_count;
+        int m_in_flight;
+        int m_max_in_flight;
+        mutable std::mutex m_mutex;
+    };
+#endif
+}
+
+#ifdef WASTORAGE_COROUTINES_SUPPORTED
+namespace
+{
+    pplx::task<size_t> check_container_twice(wa::storage::cloud_blob_container container)
+    {
+        size_t missing = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            if (!co_await wa::storage::awaitable(container.exists_async()))
+            {
+                ++missing;
+            }
+        }
+
+        co_return missing;
+    }
+}
+#endif
+
 SUITE(Core)
 {
     TEST(operation_context)
@@ -63,6 +472,1003 @@ SUITE(Core)
         CHECK(result.end_time().to_interval() > result.start_time().to_interval());
     }
 
+    TEST(operation_context_request_results_limit)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+
+        wa::storage::operation_context context;
+        context.set_max_request_results(2);
+        for (int i = 0; i < 3; ++i)
+        {
+            container.exists(wa::storage::blob_request_options(), context);
+        }
+
+        // Only the most recent results are kept, but every request is counted
+        CHECK_EQUAL(2U, context.request_results().size());
+        CHECK_EQUAL(3U, context.request_count());
+        CHECK_EQUAL(3U, context.failed_request_count());
+
+        context.set_max_request_results(0);
+        CHECK(context.request_results().empty());
+        container.exists(wa::storage::blob_request_options(), context);
+        CHECK(context.request_results().empty());
+        CHECK_EQUAL(4U, context.request_count());
+    }
+
+    TEST(connection_pool)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+
+        wa::storage::connection_pool_settings settings;
+        CHECK_THROW(settings.set_max_connections_per_host(-1), std::invalid_argument);
+        settings.set_max_connections_per_host(2);
+        settings.set_max_idle_connections_per_host(1);
+        client.set_connection_pool_settings(settings);
+
+        CHECK_EQUAL(2, client.connection_pool_settings().max_connections_per_host());
+        CHECK_EQUAL(1U, client.connection_pool_settings().max_idle_connections_per_host());
+
+        // Copies of the client share the same pool
+        auto client_copy = client;
+        CHECK_EQUAL(2, client_copy.connection_pool_settings().max_connections_per_host());
+
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        std::vector<pplx::task<bool>> tasks;
+        for (int i = 0; i < 8; ++i)
+        {
+            tasks.push_back(container.exists_async());
+        }
+
+        for (auto iter = tasks.begin(); iter != tasks.end(); ++iter)
+        {
+            CHECK(!iter->get());
+        }
+    }
+
+    TEST(connection_warm_up)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        CHECK_THROW(client.warm_up(-1), std::invalid_argument);
+
+        wa::storage::connection_pool_settings settings;
+        settings.set_max_idle_connections_per_host(0);
+        client.set_connection_pool_settings(settings);
+        CHECK_EQUAL(0, client.warm_up(4));
+
+        // Only as many connections are opened as the pool keeps idle for each endpoint
+        settings.set_max_idle_connections_per_host(2);
+        client.set_connection_pool_settings(settings);
+        int opened = client.warm_up(4);
+        CHECK(opened >= 2);
+        CHECK(opened <= 4);
+
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        CHECK(!container.exists());
+    }
+
+    TEST(adaptive_connection_pool)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        CHECK(!client.connection_pool_settings().adaptive_concurrency());
+
+        wa::storage::connection_pool_settings settings;
+        settings.set_adaptive_concurrency(true);
+        settings.set_max_connections_per_host(4);
+        client.set_connection_pool_settings(settings);
+        CHECK(client.connection_pool_settings().adaptive_concurrency());
+
+        // Requests of any outcome keep flowing through the adaptive limit
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        std::vector<pplx::task<bool>> tasks;
+        for (int i = 0; i < 16; ++i)
+        {
+            tasks.push_back(container.exists_async());
+        }
+
+        for (auto iter = tasks.begin(); iter != tasks.end(); ++iter)
+        {
+            CHECK(!iter->get());
+        }
+    }
+
+    TEST(retry_budget)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        CHECK_EQUAL(0.0, client.retry_budget_ratio());
+        CHECK_THROW(client.set_retry_budget_ratio(-0.1), std::invalid_argument);
+        CHECK_THROW(client.set_retry_budget_ratio(1.1), std::invalid_argument);
+
+        // The budget is shared by the copies of the client and the objects created from it
+        auto copy = client;
+        copy.set_retry_budget_ratio(0.1);
+        CHECK_EQUAL(0.1, client.retry_budget_ratio());
+
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        CHECK(!container.exists());
+    }
+
+    TEST(latency_histograms)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        client.reset_latency_histograms();
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+
+        wa::storage::operation_context context;
+        container.exists(wa::storage::blob_request_options(), context);
+        container.exists(wa::storage::blob_request_options(), context);
+
+        // Each request reports its phases, and the ones that make up the total cannot add up to more than it
+        CHECK_EQUAL(2U, context.request_results().size());
+        const auto& timings = context.request_results().back().timings();
+        CHECK(timings.total_time().count() > 0);
+        CHECK(timings.time_to_first_byte().count() > 0);
+        CHECK(timings.build_time() + timings.sign_time() + timings.connection_wait_time() + timings.time_to_first_byte() + timings.body_time() + timings.postprocess_time() <= timings.total_time());
+
+        auto histograms = client.latency_histograms();
+        auto iter = histograms.find(U("HEAD container"));
+        CHECK(iter != histograms.end());
+        if (iter != histograms.end())
+        {
+            CHECK_EQUAL(2U, iter->second.total().count());
+            CHECK(iter->second.total().percentile(0.5) >= iter->second.time_to_first_byte().percentile(0.5));
+        }
+
+        client.reset_latency_histograms();
+        CHECK(client.latency_histograms().empty());
+    }
+
+    TEST(metrics_sink)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        auto sink = std::make_shared<wa::storage::histogram_metrics_sink>();
+        client.set_metrics_sink(sink);
+        CHECK(client.metrics_sink() == sink);
+
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        container.exists();
+        container.exists();
+
+        // Both requests are aggregated into the same series, whichever threads they completed on
+        auto series = sink->series();
+        CHECK_EQUAL(1U, series.size());
+        if (!series.empty())
+        {
+            CHECK(series.front().service() == U("blob"));
+            CHECK(series.front().operation() == U("HEAD container"));
+            CHECK(series.front().location() == wa::storage::storage_location::primary);
+            CHECK_EQUAL(2U, series.front().latency().total().count());
+            CHECK_EQUAL(0U, series.front().request_bytes().total());
+            CHECK_EQUAL(0U, series.front().retries().total());
+            CHECK_EQUAL(1U, series.front().status_codes().size());
+            CHECK_EQUAL(2U, series.front().status_codes().at(web::http::status_codes::NotFound));
+        }
+
+        // Once the sink is removed, requests are no longer reported to it
+        client.set_metrics_sink(nullptr);
+        container.exists();
+        CHECK_EQUAL(2U, sink->series().front().latency().total().count());
+
+        sink->reset();
+        CHECK(sink->series().empty());
+    }
+
+    TEST(operation_dispatch)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        CHECK_EQUAL(0, client.max_concurrent_operations());
+        CHECK_THROW(client.set_max_concurrent_operations(-1), std::invalid_argument);
+
+        wa::storage::dispatch_tag_settings settings;
+        CHECK_EQUAL(1, settings.weight());
+        CHECK_EQUAL(0, settings.max_concurrent_operations());
+        CHECK_THROW(settings.set_weight(0), std::invalid_argument);
+        CHECK_THROW(settings.set_max_concurrent_operations(-1), std::invalid_argument);
+
+        settings.set_weight(4);
+        client.set_dispatch_tag_settings(U("small"), settings);
+        CHECK_EQUAL(4, client.get_dispatch_tag_settings(U("small")).weight());
+
+        settings = wa::storage::dispatch_tag_settings();
+        settings.set_max_concurrent_operations(1);
+        client.set_dispatch_tag_settings(U("bulk"), settings);
+
+        // The limit is shared by the copies of the client, so the operations of both tags wait for the same two slots
+        auto copy = client;
+        copy.set_max_concurrent_operations(2);
+        CHECK_EQUAL(2, client.max_concurrent_operations());
+
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        std::vector<pplx::task<bool>> tasks;
+        for (int i = 0; i < 12; ++i)
+        {
+            wa::storage::operation_context context;
+            context.set_dispatch_tag(i % 3 == 0 ? U("small") : U("bulk"));
+            tasks.push_back(container.exists_async(wa::storage::blob_request_options(), context));
+        }
+
+        for (auto iter = tasks.begin(); iter != tasks.end(); ++iter)
+        {
+            CHECK(!iter->get());
+        }
+
+        auto statistics = client.dispatch_statistics();
+        CHECK_EQUAL(4U, statistics[U("small")].queueing_delay().count());
+        CHECK_EQUAL(8U, statistics[U("bulk")].queueing_delay().count());
+        CHECK_EQUAL(0U, statistics[U("bulk")].queued_operations());
+        CHECK_EQUAL(0U, statistics[U("bulk")].running_operations());
+
+        client.reset_dispatch_statistics();
+        CHECK_EQUAL(0U, client.dispatch_statistics()[U("bulk")].queueing_delay().count());
+
+        // Without a limit, operations start right away and are not counted
+        client.set_max_concurrent_operations(0);
+        CHECK(!container.exists());
+        CHECK_EQUAL(0U, client.dispatch_statistics()[U("")].queueing_delay().count());
+    }
+
+    TEST(verbose_logging)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+
+        // Messages are only formatted once the log is written, so logging everything must not change the outcome of any request
+        wa::storage::operation_context context;
+        context.set_log_level(wa::storage::client_log_level::log_level_verbose);
+        CHECK(!container.exists(wa::storage::blob_request_options(), context));
+        CHECK_THROW(container.download_attributes(wa::storage::access_condition(), wa::storage::blob_request_options(), context), wa::storage::storage_exception);
+        CHECK_EQUAL(2U, context.request_results().size());
+    }
+
+    TEST(log_sampling)
+    {
+        auto default_interval = wa::storage::operation_context::default_log_sampling_interval();
+        CHECK_EQUAL(1U, default_interval);
+
+        wa::storage::operation_context::set_default_log_sampling_interval(4);
+        wa::storage::operation_context sampled_context;
+        CHECK_EQUAL(4U, sampled_context.log_sampling_interval());
+        wa::storage::operation_context::set_default_log_sampling_interval(default_interval);
+        CHECK_EQUAL(1U, wa::storage::operation_context().log_sampling_interval());
+
+        // Whether or not an operation is sampled, it behaves the same
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        sampled_context.set_log_level(wa::storage::client_log_level::log_level_verbose);
+        for (int i = 0; i < 4; ++i)
+        {
+            CHECK(!container.exists(wa::storage::blob_request_options(), sampled_context));
+        }
+
+        CHECK_EQUAL(4U, sampled_context.request_results().size());
+    }
+
+#ifdef WASTORAGE_COROUTINES_SUPPORTED
+    TEST(coroutines)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        CHECK_EQUAL(2U, check_container_twice(container).get());
+    }
+#endif
+
+    TEST(schedulers)
+    {
+        auto io_scheduler = std::make_shared<counting_scheduler>();
+        auto cpu_scheduler = std::make_shared<counting_scheduler>();
+
+        wa::storage::blob_request_options default_options;
+        default_options.set_io_scheduler(io_scheduler);
+        default_options.set_cpu_scheduler(cpu_scheduler);
+        auto account = test_config::instance().account();
+        wa::storage::cloud_blob_client client(account.blob_endpoint(), account.credentials(), default_options);
+
+        // The response headers of every request are handled on the I/O scheduler
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+        CHECK(!container.exists());
+        CHECK(io_scheduler->count() > 0);
+        CHECK_EQUAL(0, cpu_scheduler->count());
+
+        // Parsing a response body is done on the CPU scheduler
+        auto io_count = io_scheduler->count();
+        client.list_containers_segmented(U("this-prefix-does-not-exist"), wa::storage::blob_continuation_token());
+        CHECK(io_scheduler->count() > io_count);
+        CHECK(cpu_scheduler->count() > 0);
+    }
+
+    TEST(in_memory_transport)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(1024);
+        transport->set_listing_size(3);
+
+        wa::storage::blob_request_options default_options;
+        default_options.set_transport(transport);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+        auto container = client.get_container_reference(U("container"));
+
+        // Requests are answered from memory with canned responses
+        container.create();
+        auto blob = container.get_block_blob_reference(U("blob"));
+        blob.upload_text(U("text"));
+
+        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+        blob.download_to_stream(buffer.create_ostream());
+        CHECK_EQUAL(1024U, buffer.collection().size());
+        CHECK_EQUAL(3U, container.list_blobs_segmented(wa::storage::blob_continuation_token()).blobs().size());
+        CHECK_EQUAL(4U, transport->request_count());
+
+        // Injected errors are retried like those of the service
+        transport->set_error_rate(1.0);
+        wa::storage::blob_request_options options;
+        options.set_retry_policy(wa::storage::linear_retry_policy(std::chrono::seconds(1), 1));
+        wa::storage::operation_context context;
+        CHECK_THROW(container.exists(options, context), wa::storage::storage_exception);
+        CHECK_EQUAL(2U, context.request_results().size());
+        CHECK_EQUAL(web::http::status_codes::ServiceUnavailable, context.request_results().back().http_status_code());
+
+        CHECK_THROW(transport->set_error_rate(1.5), std::invalid_argument);
+    }
+
+    TEST(deadline_aware_retries)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_error_rate(1.0);
+
+        wa::storage::blob_request_options default_options;
+        default_options.set_transport(transport);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+        auto container = client.get_container_reference(U("container"));
+
+        // The backoff alone outlasts the operation, so the first failure is not retried
+        wa::storage::blob_request_options options;
+        options.set_retry_policy(wa::storage::linear_retry_policy(std::chrono::seconds(10), 3));
+        options.set_maximum_execution_time(std::chrono::seconds(2));
+        wa::storage::operation_context context;
+
+        auto start = std::chrono::steady_clock::now();
+        CHECK_THROW(container.exists(options, context), wa::storage::storage_exception);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+        CHECK_EQUAL(1U, context.request_results().size());
+        CHECK_EQUAL(web::http::status_codes::ServiceUnavailable, context.request_results().back().http_status_code());
+
+        // Without a deadline, the retry policy decides alone
+        wa::storage::blob_request_options retried_options;
+        retried_options.set_retry_policy(wa::storage::linear_retry_policy(std::chrono::seconds(1), 1));
+        wa::storage::operation_context retried_context;
+        CHECK_THROW(container.exists(retried_options, retried_context), wa::storage::storage_exception);
+        CHECK_EQUAL(2U, retried_context.request_results().size());
+    }
+
+    TEST(operation_expiry)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_latency(std::chrono::seconds(3));
+        auto blob = get_transport_blob(transport);
+
+        // The operation fails when its deadline passes, without waiting for the late response
+        wa::storage::blob_request_options options;
+        options.set_maximum_execution_time(std::chrono::seconds(1));
+        wa::storage::operation_context context;
+
+        auto start = std::chrono::steady_clock::now();
+        CHECK_THROW(blob.exists(options, context), wa::storage::storage_exception);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2500));
+        CHECK_EQUAL(1U, context.request_results().size());
+        CHECK_EQUAL(1U, transport->request_count());
+
+        // The same request succeeds when the deadline leaves room for it
+        options.set_maximum_execution_time(std::chrono::seconds(10));
+        CHECK(blob.exists(options, wa::storage::operation_context()));
+    }
+
+#ifndef WIN32
+    TEST(abandoned_request_slot)
+    {
+        loopback_server server("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n", std::chrono::milliseconds(1500));
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(server.uri()), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")));
+        wa::storage::connection_pool_settings settings;
+        settings.set_max_connections_per_host(1);
+        client.set_connection_pool_settings(settings);
+        auto container = client.get_container_reference(U("container"));
+
+        // The request that timed out keeps the only connection of the host until its response arrives
+        wa::storage::blob_request_options options;
+        options.set_maximum_execution_time(std::chrono::seconds(1));
+        options.set_retry_policy(wa::storage::no_retry_policy());
+
+        auto start = std::chrono::steady_clock::now();
+        CHECK_THROW(container.exists(options, wa::storage::operation_context()), wa::storage::storage_exception);
+        CHECK(!container.exists());
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(2900));
+        CHECK_EQUAL(2, server.request_count());
+        CHECK_EQUAL(1, server.max_in_flight());
+    }
+#endif
+
+    TEST(abandoned_downloads)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(1024);
+        transport->set_latency(std::chrono::milliseconds(1500));
+        auto blob = get_transport_blob(transport);
+
+        // A download that times out is not retried, so the target only ever receives the body of the abandoned attempt
+        {
+            wa::storage::blob_request_options options;
+            options.set_maximum_execution_time(std::chrono::seconds(1));
+            wa::storage::operation_context context;
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            CHECK_THROW(blob.download_to_stream(buffer.create_ostream(), wa::storage::access_condition(), options, context), wa::storage::storage_exception);
+            CHECK_EQUAL(1U, context.request_results().size());
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            CHECK_EQUAL(1U, transport->request_count());
+            CHECK_EQUAL(1024U, buffer.collection().size());
+        }
+
+        // A canceled download is not retried either, and its request writes nothing once it sees the token
+        {
+            pplx::cancellation_token_source source;
+            wa::storage::blob_request_options options;
+            options.set_cancellation_token(source.get_token());
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            auto task = blob.download_to_stream_async(buffer.create_ostream(), wa::storage::access_condition(), options, wa::storage::operation_context());
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            source.cancel();
+            CHECK_THROW(task.get(), wa::storage::storage_exception);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+            CHECK_EQUAL(2U, transport->request_count());
+            CHECK(buffer.collection().empty());
+        }
+
+        // With a deadline and a token, the body still goes straight to the target, so an interrupted download resumes
+        std::vector<uint8_t> content(64 * 1024);
+        blob_service_test_base::fill_buffer_and_get_md5(content);
+        auto interrupting = std::make_shared<interrupting_transport>(content, 16 * 1024, 1);
+        auto interrupted_blob = get_transport_blob(interrupting);
+
+        pplx::cancellation_token_source source;
+        wa::storage::blob_request_options options;
+        options.set_maximum_execution_time(std::chrono::seconds(30));
+        options.set_cancellation_token(source.get_token());
+        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+        interrupted_blob.download_to_stream(buffer.create_ostream(), wa::storage::access_condition(), options, wa::storage::operation_context());
+        CHECK(content == buffer.collection());
+
+        auto requests = interrupting->requests();
+        CHECK_EQUAL(2U, requests.size());
+        CHECK_UTF8_EQUAL(U("bytes=16384-"), requests.back()[U("x-ms-range")]);
+    }
+
+    TEST(resumed_downloads)
+    {
+        std::vector<uint8_t> content(64 * 1024);
+        auto content_md5 = blob_service_test_base::fill_buffer_and_get_md5(content);
+
+        // The retry asks for the rest of the blob, and only for the version whose start was received
+        {
+            auto transport = std::make_shared<interrupting_transport>(content, 16 * 1024, 2);
+            auto blob = get_transport_blob(transport);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            wa::storage::operation_context context;
+            blob.download_to_stream(buffer.create_ostream(), wa::storage::access_condition(), wa::storage::blob_request_options(), context);
+            CHECK(content == buffer.collection());
+            CHECK_EQUAL(3U, context.request_results().size());
+
+            auto requests = transport->requests();
+            CHECK_EQUAL(3U, requests.size());
+            CHECK(!requests[0].has(U("x-ms-range")));
+            CHECK(!requests[0].has(web::http::header_names::if_match));
+            CHECK_UTF8_EQUAL(U("bytes=16384-"), requests[1][U("x-ms-range")]);
+            CHECK_UTF8_EQUAL(U("\"0x8D0B3F4E5A6C7D8\""), requests[1][web::http::header_names::if_match]);
+            CHECK_UTF8_EQUAL(U("bytes=32768-"), requests[2][U("x-ms-range")]);
+            CHECK_UTF8_EQUAL(U("\"0x8D0B3F4E5A6C7D8\""), requests[2][web::http::header_names::if_match]);
+
+            // The MD5 of the whole blob is kept, although the part of it that was resumed comes without one
+            CHECK(!requests[1].has(U("x-ms-range-get-content-md5")));
+            CHECK_UTF8_EQUAL(content_md5, blob.properties().content_md5());
+            CHECK_EQUAL(content.size(), static_cast<size_t>(blob.properties().size()));
+        }
+
+        // A target that cannot seek receives every byte exactly once
+        {
+            auto transport = std::make_shared<interrupting_transport>(content, 16 * 1024, 1);
+            auto blob = get_transport_blob(transport);
+            concurrency::streams::producer_consumer_buffer<uint8_t> target;
+            CHECK(!target.can_seek());
+            blob.download_to_stream(target.create_ostream());
+            target.close(std::ios_base::out).wait();
+
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            target.create_istream().read_to_end(buffer).wait();
+            CHECK(content == buffer.collection());
+            CHECK_EQUAL(2U, transport->requests().size());
+        }
+
+        // A range checked with its own MD5 asks for the MD5 of the part that is resumed
+        {
+            auto transport = std::make_shared<interrupting_transport>(content, 16 * 1024, 1);
+            auto blob = get_transport_blob(transport);
+            wa::storage::blob_request_options options;
+            options.set_use_transactional_md5(true);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+            blob.download_range_to_stream(buffer.create_ostream(), 1000, 40000, wa::storage::access_condition(), options, wa::storage::operation_context());
+            CHECK(std::vector<uint8_t>(content.begin() + 1000, content.begin() + 41000) == buffer.collection());
+
+            auto requests = transport->requests();
+            CHECK_EQUAL(2U, requests.size());
+            CHECK_UTF8_EQUAL(U("bytes=1000-40999"), requests[0][U("x-ms-range")]);
+            CHECK_UTF8_EQUAL(U("bytes=17384-40999"), requests[1][U("x-ms-range")]);
+            CHECK_UTF8_EQUAL(U("true"), requests[1][U("x-ms-range-get-content-md5")]);
+            CHECK_UTF8_EQUAL(U("\"0x8D0B3F4E5A6C7D8\""), requests[1][web::http::header_names::if_match]);
+        }
+    }
+
+    TEST(circuit_breaker)
+    {
+        wa::storage::circuit_breaker_settings settings;
+        CHECK_EQUAL(0, settings.failure_threshold());
+        CHECK_THROW(settings.set_failure_threshold(-1), std::invalid_argument);
+        CHECK_THROW(settings.set_open_duration(std::chrono::seconds(-1)), std::invalid_argument);
+        settings.set_failure_threshold(2);
+        settings.set_open_duration(std::chrono::seconds(1));
+
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_error_rate(1.0);
+
+        wa::storage::blob_request_options default_options;
+        default_options.set_transport(transport);
+        default_options.set_retry_policy(wa::storage::no_retry_policy());
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+        client.set_circuit_breaker_settings(settings);
+        auto container = client.get_container_reference(U("container"));
+
+        // Once enough requests have failed in a row, operations fail without sending a request
+        for (int i = 0; i < 2; ++i)
+        {
+            wa::storage::operation_context context;
+            CHECK_THROW(container.exists(wa::storage::blob_request_options(), context), wa::storage::storage_exception);
+            CHECK_EQUAL(1U, context.request_results().size());
+        }
+
+        wa::storage::operation_context open_context;
+        CHECK_THROW(container.exists(wa::storage::blob_request_options(), open_context), wa::storage::storage_exception);
+        CHECK_EQUAL(0U, open_context.request_results().size());
+        CHECK_EQUAL(2U, transport->request_count());
+
+        // After the open duration, a probe is let through, and its success closes the circuit
+        transport->set_error_rate(0.0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        CHECK(container.exists());
+        CHECK(container.exists());
+        CHECK_EQUAL(4U, transport->request_count());
+    }
+
+    TEST(transport_fallback)
+    {
+        auto transport = std::make_shared<single_host_transport>(U("account.blob.core.windows.net"));
+        wa::storage::blob_request_options options;
+        options.set_transport(transport);
+
+        // The transport sends the requests to its host
+        wa::storage::cloud_blob_client memory_client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")));
+        memory_client.get_container_reference(U("container")).exists(options, wa::storage::operation_context());
+        CHECK_EQUAL(1U, transport->request_count());
+
+        // The requests to any other endpoint go through the HTTP client
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        wa::storage::operation_context context;
+        CHECK(!client.get_container_reference(U("nonexistentcontainer") + get_random_string()).exists(options, context));
+        CHECK_EQUAL(1U, transport->request_count());
+        CHECK_EQUAL(1U, context.request_results().size());
+    }
+
+    TEST(bandwidth_limiter)
+    {
+        CHECK_THROW(wa::storage::bandwidth_limiter(0), std::invalid_argument);
+        CHECK_THROW(wa::storage::bandwidth_limiter(1024, 0), std::invalid_argument);
+
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(128 * 1024);
+
+        wa::storage::blob_request_options default_options;
+        default_options.set_transport(transport);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+        auto blob = client.get_container_reference(U("container")).get_block_blob_reference(U("blob"));
+
+        // Only the first burst is received right away, and the rest of the body arrives at the rate of the limiter
+        auto limiter = std::make_shared<wa::storage::bandwidth_limiter>(64 * 1024, 16 * 1024);
+        wa::storage::blob_request_options options;
+        options.set_bandwidth_limiter(limiter);
+
+        auto start = std::chrono::steady_clock::now();
+        concurrency::streams::container_buffer<std::vector<uint8_t>> buffer;
+        blob.download_to_stream(buffer.create_ostream(), wa::storage::access_condition(), options, wa::storage::operation_context());
+        CHECK_EQUAL(128U * 1024U, buffer.collection().size());
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(1500));
+
+        // A transfer of a higher priority goes ahead of a bulk transfer that is already waiting
+        auto slow_limiter = std::make_shared<wa::storage::bandwidth_limiter>(16 * 1024, 16 * 1024);
+        slow_limiter->acquire_async(16 * 1024, wa::storage::transfer_priority::normal).wait();
+        auto bulk = slow_limiter->acquire_async(16 * 1024, wa::storage::transfer_priority::bulk);
+        auto interactive = slow_limiter->acquire_async(16 * 1024, wa::storage::transfer_priority::interactive);
+        CHECK(!bulk.is_done());
+
+        interactive.wait();
+        CHECK(!bulk.is_done());
+        bulk.wait();
+    }
+
+    TEST(request_coalescing)
+    {
+        auto transport = std::make_shared<wa::storage::in_memory_transport>();
+        transport->set_blob_size(1024);
+        transport->set_latency(std::chrono::milliseconds(200));
+
+        wa::storage::blob_request_options default_options;
+        default_options.set_transport(transport);
+        wa::storage::cloud_blob_client client(wa::storage::storage_uri(web::http::uri(U("https://account.blob.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), default_options);
+        CHECK(!client.request_coalescing());
+        client.set_request_coalescing(true);
+        auto container = client.get_container_reference(U("container"));
+
+        // Identical reads that are in flight at the same time send a single request and all receive its result
+        std::vector<concurrency::streams::container_buffer<std::vector<uint8_t>>> buffers(5);
+        std::vector<wa::storage::cloud_block_blob> blobs;
+        std::vector<pplx::task<void>> tasks;
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            blobs.push_back(container.get_block_blob_reference(U("blob")));
+            tasks.push_back(blobs.back().download_to_stream_async(buffers[i].create_ostream()));
+            tasks.push_back(container.get_block_blob_reference(U("blob")).download_attributes_async());
+        }
+
+        pplx::when_all(tasks.begin(), tasks.end()).wait();
+        CHECK_EQUAL(2U, transport->request_count());
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            CHECK_EQUAL(1024U, buffers[i].collection().size());
+            CHECK_EQUAL(1024U, blobs[i].properties().size());
+        }
+
+        // A range is a different read, and a read that starts after the first one has completed sends a request of its own
+        concurrency::streams::container_buffer<std::vector<uint8_t>> range;
+        blobs[0].download_range_to_stream(range.create_ostream(), 0, 512);
+        CHECK_EQUAL(512U, range.collection().size());
+        blobs[0].download_attributes();
+        CHECK_EQUAL(4U, transport->request_count());
+
+        wa::storage::table_request_options table_options;
+        table_options.set_transport(transport);
+        wa::storage::cloud_table_client table_client(wa::storage::storage_uri(web::http::uri(U("https://account.table.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")), table_options);
+        table_client.set_request_coalescing(true);
+        auto table = table_client.get_table_reference(U("table"));
+
+        std::vector<pplx::task<wa::storage::table_result>> retrieves;
+        for (int i = 0; i < 5; ++i)
+        {
+            retrieves.push_back(table.execute_async(wa::storage::table_operation::retrieve_entity(U("partition"), U("row"))));
+        }
+
+        auto results = pplx::when_all(retrieves.begin(), retrieves.end()).get();
+        CHECK_EQUAL(5U, transport->request_count());
+        for (auto iter = results.cbegin(); iter != results.cend(); ++iter)
+        {
+            CHECK_EQUAL(web::http::status_codes::OK, iter->http_status_code());
+        }
+    }
+
+    TEST(md5_hash)
+    {
+        // The test suite of RFC 1321
+        CHECK_EQUAL(std::string("d41d8cd98f00b204e9800998ecf8427e"), get_digest(wa::storage::core::md5_hash(), ""));
+        CHECK_EQUAL(std::string("0cc175b9c0f1b6a831c399e269772661"), get_digest(wa::storage::core::md5_hash(), "a"));
+        CHECK_EQUAL(std::string("900150983cd24fb0d6963f7d28e17f72"), get_digest(wa::storage::core::md5_hash(), "abc"));
+        CHECK_EQUAL(std::string("f96b697d7cb7938d525a2f31aaf161d0"), get_digest(wa::storage::core::md5_hash(), "message digest"));
+        CHECK_EQUAL(std::string("c3fcd3d76192e4007dfb496cca67e13b"), get_digest(wa::storage::core::md5_hash(), "abcdefghijklmnopqrstuvwxyz"));
+        CHECK_EQUAL(std::string("d174ab98d277d9f5a5611c2c9f419d9f"), get_digest(wa::storage::core::md5_hash(), "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"));
+        CHECK_EQUAL(std::string("57edf4a22be3c955ac49da2e2107b67a"), get_digest(wa::storage::core::md5_hash(), "12345678901234567890123456789012345678901234567890123456789012345678901234567890"));
+
+        // Chunks of any size give the digest of the whole message
+        std::string million(1000000, 'a');
+        CHECK_EQUAL(std::string("7707d6ae4e027c70eea2a935c2296f21"), get_digest(wa::storage::core::md5_hash(), million));
+        size_t chunk_sizes[] = { 1, 63, 64, 65, 997, 4096 };
+        for (auto chunk_size : chunk_sizes)
+        {
+            CHECK_EQUAL(std::string("7707d6ae4e027c70eea2a935c2296f21"), get_chunked_digest(wa::storage::core::md5_hash(), million, chunk_size));
+        }
+
+        // A saved state continues where it was left off
+        wa::storage::core::md5_hash hash;
+        hash.update(reinterpret_cast<const uint8_t*>(million.data()), 1000);
+        wa::storage::core::md5_hash restored;
+        CHECK(restored.load_state(hash.save_state()));
+        restored.update(reinterpret_cast<const uint8_t*>(million.data()), million.size() - 1000);
+        CHECK_EQUAL(std::string("7707d6ae4e027c70eea2a935c2296f21"), to_hex(restored.finalize()));
+        CHECK(!restored.load_state(std::vector<uint8_t>(3)));
+    }
+
+    TEST(sha256_hash)
+    {
+        // The examples of FIPS 180-4
+        CHECK_EQUAL(std::string("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"), get_digest(wa::storage::core::sha256_hash(), ""));
+        CHECK_EQUAL(std::string("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"), get_digest(wa::storage::core::sha256_hash(), "abc"));
+        CHECK_EQUAL(std::string("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"), get_digest(wa::storage::core::sha256_hash(), "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+        CHECK_EQUAL(std::string("cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"), get_digest(wa::storage::core::sha256_hash(), "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu"));
+
+        // Chunks of any size give the digest of the whole message
+        std::string million(1000000, 'a');
+        CHECK_EQUAL(std::string("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"), get_digest(wa::storage::core::sha256_hash(), million));
+        size_t chunk_sizes[] = { 1, 63, 64, 65, 997, 4096 };
+        for (auto chunk_size : chunk_sizes)
+        {
+            CHECK_EQUAL(std::string("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"), get_chunked_digest(wa::storage::core::sha256_hash(), million, chunk_size));
+        }
+    }
+
+    TEST(hmac_sha256_hash)
+    {
+        // The test cases of RFC 4231
+        std::vector<unsigned char> key(20, 0x0b);
+        CHECK_EQUAL(std::string("b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"), get_digest(wa::storage::core::hmac_sha256_hash(key), "Hi There"));
+
+        std::string jefe("Jefe");
+        key.assign(jefe.begin(), jefe.end());
+        CHECK_EQUAL(std::string("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"), get_digest(wa::storage::core::hmac_sha256_hash(key), "what do ya want for nothing?"));
+
+        key.assign(20, 0xaa);
+        CHECK_EQUAL(std::string("773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe"), get_digest(wa::storage::core::hmac_sha256_hash(key), std::string(50, '\xdd')));
+
+        key.clear();
+        for (unsigned char value = 0x01; value <= 0x19; ++value)
+        {
+            key.push_back(value);
+        }
+
+        CHECK_EQUAL(std::string("82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b"), get_digest(wa::storage::core::hmac_sha256_hash(key), std::string(50, '\xcd')));
+
+        key.assign(20, 0x0c);
+        CHECK_EQUAL(std::string("a3b6167473100ee06e0c796c2955552b"), get_digest(wa::storage::core::hmac_sha256_hash(key), "Test With Truncation").substr(0, 32));
+
+        // A key longer than a block is hashed first
+        key.assign(131, 0xaa);
+        CHECK_EQUAL(std::string("60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"), get_digest(wa::storage::core::hmac_sha256_hash(key), "Test Using Larger Than Block-Size Key - Hash Key First"));
+
+        std::string message("This is a test using a larger than block-size key and a larger than block-size data. The key needs to be hashed before being used by the HMAC algorithm.");
+        CHECK_EQUAL(std::string("9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2"), get_digest(wa::storage::core::hmac_sha256_hash(key), message));
+
+        // A keyed instance is copied to sign each message, in chunks of any size
+        wa::storage::core::hmac_sha256_hash keyed(key);
+        size_t chunk_sizes[] = { 1, 7, 64, 100 };
+        for (auto chunk_size : chunk_sizes)
+        {
+            CHECK_EQUAL(std::string("9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2"), get_chunked_digest(keyed, message, chunk_size));
+        }
+    }
+
+    TEST(hashing_streambuf)
+    {
+        std::vector<uint8_t> buffer(64 * 1024);
+        utility::string_t md5 = blob_service_test_base::fill_buffer_and_get_md5(buffer);
+
+        // Half of the body is written through the destination's own buffer and the other half is written from a copy
+        concurrency::streams::container_buffer<std::vector<uint8_t>> destination;
+        wa::storage::core::hash_streambuf hash = wa::storage::core::hash_md5_streambuf();
+        wa::storage::core::hashing_streambuf<uint8_t> target(destination, hash, wa::storage::core::hash_streambuf());
+
+        size_t half = buffer.size() / 2;
+        uint8_t* allocated = target.alloc(half);
+        CHECK(allocated != nullptr);
+        std::memcpy(allocated, buffer.data(), half);
+        target.commit(half);
+        CHECK_EQUAL(half, target.putn(buffer.data() + half, buffer.size() - half).get());
+
+        hash.close().wait();
+        CHECK_EQUAL(buffer.size(), target.total_written());
+        CHECK(buffer == destination.collection());
+        CHECK_UTF8_EQUAL(md5, utility::conversions::to_base64(hash.hash()));
+
+        // Without hashes, writes only count the bytes on their way to the destination
+        concurrency::streams::container_buffer<std::vector<uint8_t>> plain_destination;
+        wa::storage::core::hashing_streambuf<uint8_t> plain_target(plain_destination, wa::storage::core::hash_streambuf(), wa::storage::core::hash_streambuf());
+        plain_target.putn(buffer.data(), buffer.size()).wait();
+        CHECK_EQUAL(buffer.size(), plain_target.total_written());
+        CHECK(buffer == plain_destination.collection());
+    }
+
+    TEST(hashing_streambuf_size_hint)
+    {
+        std::vector<uint8_t> buffer(64 * 1024);
+        blob_service_test_base::fill_buffer_and_get_md5(buffer);
+
+        // The first write after the hint reserves the whole body, so the vector is never reallocated afterwards
+        concurrency::streams::container_buffer<std::vector<uint8_t>> destination;
+        wa::storage::core::hashing_streambuf<uint8_t> target(destination, wa::storage::core::hash_streambuf(), wa::storage::core::hash_streambuf());
+        target.putn(buffer.data(), 1024).wait();
+        target.set_size_hint(buffer.size());
+        target.putn(buffer.data() + 1024, 1024).wait();
+        CHECK(destination.collection().capacity() >= buffer.size());
+
+        const uint8_t* data = destination.collection().data();
+        target.putn(buffer.data() + 2048, buffer.size() - 2048).wait();
+        CHECK(data == destination.collection().data());
+        CHECK(buffer == destination.collection());
+    }
+
+    TEST(stream_copy)
+    {
+        std::vector<uint8_t> buffer(3 * 1024 * 1024 + 17);
+        blob_service_test_base::fill_buffer_and_get_md5(buffer);
+
+        // A source that only has its next block in memory is copied through buffers, which a sink without alloc needs
+        {
+            concurrency::streams::producer_consumer_buffer<uint8_t> source;
+            source.putn(buffer.data(), buffer.size()).wait();
+            source.close(std::ios_base::out).wait();
+
+            concurrency::streams::container_buffer<std::vector<uint8_t>> first;
+            concurrency::streams::container_buffer<std::vector<uint8_t>> second;
+            wa::storage::core::splitter_streambuf<uint8_t> target(first, second);
+            CHECK_EQUAL(buffer.size(), wa::storage::core::stream_copy_async(source.create_istream(), target.create_ostream(), wa::storage::protocol::invalid_size64_t).get());
+            CHECK(buffer == first.collection());
+            CHECK(buffer == second.collection());
+        }
+
+        // A source in memory is copied from directly, and a copy of a given length stops there
+        {
+            concurrency::streams::container_buffer<std::vector<uint8_t>> source(buffer, std::ios_base::in);
+            concurrency::streams::container_buffer<std::vector<uint8_t>> target;
+            CHECK_EQUAL(1024U * 1024U, wa::storage::core::stream_copy_async(source.create_istream(), target.create_ostream(), 1024 * 1024).get());
+            CHECK(std::equal(target.collection().cbegin(), target.collection().cend(), buffer.cbegin()));
+        }
+
+        // A source that ends early fails a copy of a given length
+        {
+            concurrency::streams::producer_consumer_buffer<uint8_t> source;
+            source.putn(buffer.data(), 1024).wait();
+            source.close(std::ios_base::out).wait();
+
+            concurrency::streams::container_buffer<std::vector<uint8_t>> target;
+            CHECK_THROW(wa::storage::core::stream_copy_async(source.create_istream(), target.create_ostream(), 4096).get(), std::invalid_argument);
+        }
+    }
+
+    TEST(substream_streambuf)
+    {
+        std::vector<uint8_t> buffer(5 * 1024 + 300);
+        blob_service_test_base::fill_buffer_and_get_md5(buffer);
+
+        // Views over consecutive blocks of a source that is read from an offset, as a seekable upload sends them
+        concurrency::streams::container_buffer<std::vector<uint8_t>> source(buffer, std::ios_base::in);
+        wa::storage::core::async_semaphore source_lock(1);
+        const size_t offset = 123;
+        const size_t block_size = 1024;
+        std::vector<concurrency::streams::istream> views;
+        for (size_t block_offset = 0; offset + block_offset < buffer.size(); block_offset += block_size)
+        {
+            auto length = std::min(block_size, buffer.size() - offset - block_offset);
+            views.push_back(wa::storage::core::substream_streambuf<uint8_t>(source, source_lock, static_cast<concurrency::streams::istream::off_type>(offset + block_offset), length).create_istream());
+        }
+
+        // The last block is the short one, and the blocks are read all at once without mixing up their ranges
+        CHECK_EQUAL(6U, views.size());
+        CHECK_EQUAL(300 - offset, views.back().streambuf().size());
+
+        std::vector<concurrency::streams::container_buffer<std::vector<uint8_t>>> targets(views.size());
+        std::vector<pplx::task<size_t>> reads;
+        for (size_t i = 0; i < views.size(); ++i)
+        {
+            reads.push_back(views[i].read_to_end(targets[i]));
+        }
+
+        pplx::when_all(reads.begin(), reads.end()).wait();
+        for (size_t i = 0; i < views.size(); ++i)
+        {
+            auto start = buffer.cbegin() + offset + i * block_size;
+            CHECK_EQUAL(views[i].streambuf().size(), targets[i].collection().size());
+            CHECK(std::equal(targets[i].collection().cbegin(), targets[i].collection().cend(), start));
+        }
+
+        // A view seeks within its own range only
+        auto view = views[1];
+        CHECK_EQUAL(100, static_cast<int>(view.seek(100)));
+        std::vector<uint8_t> read(10);
+        CHECK_EQUAL(10U, view.streambuf().getn(read.data(), read.size()).get());
+        CHECK(std::equal(read.cbegin(), read.cend(), buffer.cbegin() + offset + block_size + 100));
+        CHECK_EQUAL(static_cast<int>(block_size), static_cast<int>(view.seek(0, std::ios_base::end)));
+        CHECK_EQUAL(0U, view.streambuf().getn(read.data(), read.size()).get());
+        CHECK(view.streambuf().seekpos(block_size + 1, std::ios_base::in) == static_cast<concurrency::streams::istream::pos_type>(concurrency::streams::istream::traits::eof()));
+
+        // Hashing the blocks in place, as they are visited in order, gives the MD5s of copying each block into a buffer first
+        wa::storage::core::hash_md5_streambuf blob_hash;
+        for (size_t i = 0; i < views.size(); ++i)
+        {
+            views[i].seek(0);
+            wa::storage::core::hash_md5_streambuf block_hash;
+            auto hash_stream = wa::storage::core::splitter_streambuf<uint8_t>(block_hash, blob_hash).create_ostream();
+            auto length = views[i].streambuf().size();
+            CHECK_EQUAL(length, wa::storage::core::stream_copy_async(views[i], hash_stream, length).get());
+            block_hash.close().wait();
+            CHECK(get_md5(buffer.data() + offset + i * block_size, static_cast<size_t>(length)) == utility::conversions::to_base64(block_hash.hash()));
+        }
+
+        blob_hash.close().wait();
+        CHECK(get_md5(buffer.data() + offset, buffer.size() - offset) == utility::conversions::to_base64(blob_hash.hash()));
+
+        // A retry that rewinds the block after part of it was sent reads the same range again, and so does
+        // an attempt that reads the block through a view of its own
+        view.seek(0);
+        CHECK_EQUAL(10U, view.streambuf().getn(read.data(), read.size()).get());
+        view.seek(0);
+        concurrency::streams::container_buffer<std::vector<uint8_t>> retry_target;
+        CHECK_EQUAL(block_size, view.read_to_end(retry_target).get());
+        CHECK(std::equal(retry_target.collection().cbegin(), retry_target.collection().cend(), buffer.cbegin() + offset + block_size));
+
+        auto attempt = wa::storage::core::substream_streambuf<uint8_t>(view.streambuf(), wa::storage::core::async_semaphore(1), 0, block_size).create_istream();
+        concurrency::streams::container_buffer<std::vector<uint8_t>> attempt_target;
+        CHECK_EQUAL(block_size, attempt.read_to_end(attempt_target).get());
+        CHECK(retry_target.collection() == attempt_target.collection());
+    }
+
+    TEST(cancellation_token)
+    {
+        auto client = test_config::instance().account().create_cloud_blob_client();
+        auto container = client.get_container_reference(U("this-container-does-not-exist"));
+
+        // An operation whose token is already canceled sends no request
+        {
+            pplx::cancellation_token_source source;
+            source.cancel();
+
+            wa::storage::blob_request_options options;
+            options.set_cancellation_token(source.get_token());
+            wa::storage::operation_context context;
+            CHECK_THROW(container.exists(options, context), wa::storage::storage_exception);
+            CHECK(context.request_results().empty());
+        }
+
+        // Canceling the token ends the wait before a retry right away
+        {
+            wa::storage::cloud_blob_client unreachable_client(wa::storage::storage_uri(web::http::uri(U("http://127.0.0.1:1"))));
+            auto unreachable_container = unreachable_client.get_container_reference(U("container"));
+
+            pplx::cancellation_token_source source;
+            wa::storage::blob_request_options options;
+            options.set_retry_policy(wa::storage::linear_retry_policy(std::chrono::seconds(60), 3));
+            options.set_cancellation_token(source.get_token());
+
+            auto start = std::chrono::steady_clock::now();
+            auto task = unreachable_container.exists_async(options, wa::storage::operation_context());
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            source.cancel();
+
+            CHECK_THROW(task.get(), wa::storage::storage_exception);
+            CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(30));
+        }
+
+        // A request in flight on a pooled client is abandoned as soon as the token is canceled
+        {
+            wa::storage::cloud_blob_client silent_client(wa::storage::storage_uri(web::http::uri(U("http://10.255.255.1"))));
+            auto silent_container = silent_client.get_container_reference(U("container"));
+
+            pplx::cancellation_token_source source;
+            wa::storage::blob_request_options options;
+            options.set_retry_policy(wa::storage::no_retry_policy());
+            options.set_server_timeout(std::chrono::seconds(120));
+            options.set_cancellation_token(source.get_token());
+
+            auto start = std::chrono::steady_clock::now();
+            auto task = silent_container.exists_async(options, wa::storage::operation_context());
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            source.cancel();
+
+            CHECK_THROW(task.get(), wa::storage::storage_exception);
+            CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+        }
+    }
+
     TEST(storage_uri)
     {
         CHECK_THROW(wa::storage::storage_uri(U("http://www.microsoft.com/test1"), U("http://www.microsoft.com/test2")), std::invalid_argument);
@@ -0,0 +1,310 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="json_reader_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "wascore/jsonhelpers.h"
+
+namespace
+{
+    // Records what the reader reports as "{", "}", "[", "]", "k:name", "s:text", "i:number" for an integer,
+    // "d:number" for any other number, "b:true", "b:false" and "null"
+    class recording_reader : public wa::storage::core::json::json_reader
+    {
+    public:
+
+        explicit recording_reader(concurrency::streams::istream stream)
+            : json_reader(stream), m_max_depth(0)
+        {
+        }
+
+        explicit recording_reader(const std::string& document)
+            : json_reader(document.data(), document.size()), m_max_depth(0)
+        {
+        }
+
+        const std::vector<std::string>& events() const
+        {
+            return m_events;
+        }
+
+        size_t max_depth() const
+        {
+            return m_max_depth;
+        }
+
+    protected:
+
+        virtual void handle_begin_object() override
+        {
+            m_events.push_back("{");
+            m_max_depth = std::max(m_max_depth, depth() + 1);
+        }
+
+        virtual void handle_end_object() override
+        {
+            m_events.push_back("}");
+        }
+
+        virtual void handle_begin_array() override
+        {
+            m_events.push_back("[");
+            m_max_depth = std::max(m_max_depth, depth() + 1);
+        }
+
+        virtual void handle_end_array() override
+        {
+            m_events.push_back("]");
+        }
+
+        virtual void handle_key(const wa::storage::core::json::json_string_view& key) override
+        {
+            m_events.push_back("k:" + key.to_utf8_string());
+        }
+
+        virtual void handle_string(const wa::storage::core::json::json_string_view& value) override
+        {
+            m_events.push_back("s:" + value.to_utf8_string());
+        }
+
+        virtual void handle_number(const wa::storage::core::json::json_string_view& value, bool is_integer) override
+        {
+            m_events.push_back((is_integer ? "i:" : "d:") + value.to_utf8_string());
+        }
+
+        virtual void handle_boolean(bool value) override
+        {
+            m_events.push_back(value ? "b:true" : "b:false");
+        }
+
+        virtual void handle_null() override
+        {
+            m_events.push_back("null");
+        }
+
+    private:
+
+        std::vector<std::string> m_events;
+        size_t m_max_depth;
+    };
+
+    std::vector<std::string> read_events(const std::string& document)
+    {
+        recording_reader reader(document);
+        reader.parse();
+        return reader.events();
+    }
+
+    std::vector<std::string> read_stream_events(const std::string& document)
+    {
+        recording_reader reader(concurrency::streams::bytestream::open_istream(document));
+        reader.parse();
+        return reader.events();
+    }
+
+    void check_events(const std::vector<std::string>& expected, const std::vector<std::string>& actual)
+    {
+        CHECK_EQUAL(expected.size(), actual.size());
+        for (size_t i = 0; i < std::min(expected.size(), actual.size()); ++i)
+        {
+            CHECK_EQUAL(expected[i], actual[i]);
+        }
+    }
+
+    template<size_t N>
+    void check_events(const char* const (&expected)[N], const std::vector<std::string>& actual)
+    {
+        check_events(std::vector<std::string>(expected, expected + N), actual);
+    }
+
+    std::string format_number(double value)
+    {
+        std::ostringstream stream;
+        stream.precision(17);
+        stream << value;
+        return "n:" + stream.str();
+    }
+
+    // Lists the events the reader would report for a document that web::json has parsed, with every number as a double
+    void get_value_events(const web::json::value& value, std::vector<std::string>& events)
+    {
+        switch (value.type())
+        {
+        case web::json::value::Object:
+            events.push_back("{");
+            for (auto iter = value.cbegin(); iter != value.cend(); ++iter)
+            {
+                events.push_back("k:" + utility::conversions::to_utf8string(iter->first.as_string()));
+                get_value_events(iter->second, events);
+            }
+            events.push_back("}");
+            break;
+
+        case web::json::value::Array:
+            events.push_back("[");
+            for (auto iter = value.cbegin(); iter != value.cend(); ++iter)
+            {
+                get_value_events(iter->second, events);
+            }
+            events.push_back("]");
+            break;
+
+        case web::json::value::String:
+            events.push_back("s:" + utility::conversions::to_utf8string(value.as_string()));
+            break;
+
+        case web::json::value::Number:
+            events.push_back(format_number(value.as_double()));
+            break;
+
+        case web::json::value::Boolean:
+            events.push_back(value.as_bool() ? "b:true" : "b:false");
+            break;
+
+        default:
+            events.push_back("null");
+            break;
+        }
+    }
+
+    void check_parity(const std::string& document)
+    {
+        std::vector<std::string> expected;
+        get_value_events(web::json::value::parse(utility::conversions::to_string_t(document)), expected);
+
+        auto actual = read_events(document);
+        for (auto iter = actual.begin(); iter != actual.end(); ++iter)
+        {
+            if (iter->compare(0, 2, "i:") == 0 || iter->compare(0, 2, "d:") == 0)
+            {
+                *iter = format_number(std::strtod(iter->c_str() + 2, nullptr));
+            }
+        }
+
+        check_events(expected, actual);
+    }
+}
+
+SUITE(Core)
+{
+    TEST(json_reader_strings)
+    {
+        // Every escape sequence is decoded, and a surrogate pair becomes a single four-byte character
+        const char* const escapes[] = { "s:\\ \" / \b \f \n \r \t A \xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80 \xF4\x8F\xBF\xBF" };
+        check_events(escapes, read_events("\"\\\\ \\\" \\/ \\b \\f \\n \\r \\t \\u0041 \\u00e9 \\u20AC \\ud83d\\ude00 \\uDBFF\\uDFFF\""));
+
+        // Text without escapes, including UTF-8 that is not ASCII, is passed as it is
+        const char* const unescaped[] = { "{", "k:na\xC3\xAFve", "s:caf\xC3\xA9", "k:", "s:", "}" };
+        check_events(unescaped, read_events("{\"na\xC3\xAFve\":\"caf\xC3\xA9\",\"\":\"\"}"));
+
+        // Whitespace and a byte order mark around the value are skipped
+        const char* const whitespace[] = { "s:a" };
+        check_events(whitespace, read_events("\xEF\xBB\xBF \r\n\t\"a\" \n"));
+    }
+
+    TEST(json_reader_values)
+    {
+        const char* const values[] = { "[", "i:0", "i:-0", "i:123", "i:-9223372036854775808", "d:1.5", "d:-0.25", "d:1e10", "d:1E+2", "d:2.5e-3", "b:true", "b:false", "null", "]" };
+        check_events(values, read_events("[0,-0,123,-9223372036854775808,1.5,-0.25,1e10,1E+2,2.5e-3,true,false,null]"));
+
+        // A value on its own is a whole document
+        const char* const integer_events[] = { "i:42" };
+        const char* const null_events[] = { "null" };
+        check_events(integer_events, read_events("42"));
+        check_events(null_events, read_events(" null "));
+
+        // Nested objects and arrays are reported in order, however deep they go
+        recording_reader nested("{\"a\":[{\"b\":{}},[[]],{}],\"c\":{\"d\":[1,[2,{\"e\":null}]]}}");
+        nested.parse();
+        const char* const nested_events[] = { "{", "k:a", "[", "{", "k:b", "{", "}", "}", "[", "[", "]", "]", "{", "}", "]", "k:c", "{", "k:d", "[", "i:1", "[", "i:2", "{", "k:e", "null", "}", "]", "]", "}", "}" };
+        check_events(nested_events, nested.events());
+        CHECK_EQUAL(5U, nested.max_depth());
+
+        std::string deep(std::string(1000, '[') + std::string(1000, ']'));
+        recording_reader deep_reader(deep);
+        deep_reader.parse();
+        CHECK_EQUAL(2000U, deep_reader.events().size());
+        CHECK_EQUAL(1000U, deep_reader.max_depth());
+    }
+
+    TEST(json_reader_chunk_boundaries)
+    {
+        // A stream is read 16KB at a time, so moving the values across the end of the first chunk
+        // splits each number, escape sequence, surrogate pair, literal and key in turn
+        const std::string values("-12.5e+3,\"a\\u00e9\\ud83d\\ude00\\n\",true,false,null,{\"key\":[1234567890]}]");
+        const char* const expected_values[] = { "d:-12.5e+3", "s:a\xC3\xA9\xF0\x9F\x98\x80\n", "b:true", "b:false", "null", "{", "k:key", "[", "i:1234567890", "]", "}", "]" };
+        const size_t chunk_size = 16 * 1024;
+        for (size_t split = 0; split <= values.size(); ++split)
+        {
+            std::string padding(chunk_size - split - 4, 'p');
+            std::vector<std::string> expected(1, "[");
+            expected.push_back("s:" + padding);
+            expected.insert(expected.end(), expected_values, expected_values + _countof(expected_values));
+
+            std::string document("[\"" + padding + "\"," + values);
+            check_events(expected, read_stream_events(document));
+        }
+
+        // A number that ends the document is not cut short at the end of a chunk
+        std::string number("1234567.5");
+        const char* const number_events[] = { "d:1234567.5" };
+        for (size_t split = 1; split < number.size(); ++split)
+        {
+            std::string document(std::string(chunk_size - split, ' ') + number);
+            check_events(number_events, read_stream_events(document));
+        }
+
+        // Strings longer than a chunk are reported whole
+        std::string text(3 * chunk_size, 't');
+        std::vector<std::string> long_events(1, "[");
+        long_events.push_back("s:" + text);
+        long_events.push_back("s:" + text + "\"");
+        long_events.push_back("]");
+        check_events(long_events, read_stream_events("[\"" + text + "\",\"" + text + "\\\"\"]"));
+    }
+
+    TEST(json_reader_malformed_input)
+    {
+        const char* documents[] =
+        {
+            "", "   ", "[", "{", "]", "}", "[1,]", "[,1]", "{\"a\":1,}", "{\"a\" 1}", "{\"a\":}", "{a:1}", "{1:1}", "[1 2]",
+            "[}", "{]", "[1}", "{\"a\":1]", "tru", "nul", "falsy", "True", "\"abc", "\"a\nb\"", "\"\\x\"", "\"\\u12\"",
+            "\"\\u12G4\"", "\"\\ud83d\"", "\"\\ud83dx\"", "\"\\ude00\"", "\"\\ud83d\\u0041\"", "1 2", "{} {}", "[] x",
+            "01", "-", "+1", ".5", "1.", "1.e5", "1e", "1e+", "--1", "1.2.3", "0x10", "[1-2]", "'a'",
+        };
+
+        for (auto document : documents)
+        {
+            CHECK_THROW(read_events(document), std::runtime_error);
+            CHECK_THROW(read_stream_events(document), std::runtime_error);
+        }
+    }
+
+    TEST(json_reader_parity)
+    {
+        // The reader reports the same values as web::json for the payloads of the table service
+        check_parity("{\"odata.metadata\":\"https://account.table.core.windows.net/$metadata#Tables\",\"value\":[{\"TableName\":\"table1\"},{\"TableName\":\"table2\"}]}");
+        check_parity("{\"odata.metadata\":\"https://account.table.core.windows.net/$metadata#table\",\"value\":["
+            "{\"PartitionKey\":\"partition\",\"RowKey\":\"row0\",\"Timestamp\":\"2013-08-22T01:12:06.2608595Z\",\"Age\":23,\"Name\":\"name\",\"Score\":1.5,"
+            "\"Total\":\"1234567890123\",\"Total@odata.type\":\"Edm.Int64\",\"Active\":true,\"Created\":\"2013-08-22T01:12:06Z\",\"Created@odata.type\":\"Edm.DateTime\"},"
+            "{\"odata.etag\":\"W/\\\"datetime'2013-08-22T01%3A12%3A06.2608595Z'\\\"\",\"PartitionKey\":\"p\\u00e9\",\"RowKey\":\"\",\"Binary@odata.type\":\"Edm.Binary\",\"Binary\":\"AQID\","
+            "\"Guid@odata.type\":\"Edm.Guid\",\"Guid\":\"c2e0c4d0-5a7e-4a7f-9b9f-1b5e0c2f3a01\",\"Negative\":-42,\"Small\":-0.125,\"Large\":1e300,\"Text\":\"line\\nbreak\\ttab \\\"quoted\\\"\"}]}");
+        check_parity("{\"odata.error\":{\"code\":\"ServerBusy\",\"message\":{\"lang\":\"en-US\",\"value\":\"The server is busy.\\nRequestId:c2e0c4d0\"}}}");
+        check_parity("{\"value\":[],\"odata.nextLink\":null}");
+    }
+}
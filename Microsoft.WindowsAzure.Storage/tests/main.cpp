@@ -19,12 +19,20 @@
 
 #include "was/blob.h"
 
+// The benchmarks take a while and only report timings, so they are run only when asked for by name
+const char* benchmark_suite_name = "Benchmarks";
+
 int run_tests(const char* suite_name, const char* test_name)
 {
     UnitTest::TestReporterStdout reporter;
     UnitTest::TestRunner runner(reporter);
-    return runner.RunTestsIf(UnitTest::Test::GetTestList(), suite_name, [test_name] (UnitTest::Test* test) -> bool
+    return runner.RunTestsIf(UnitTest::Test::GetTestList(), suite_name, [suite_name, test_name] (UnitTest::Test* test) -> bool
     {
+        if ((suite_name == NULL) && !strcmp(benchmark_suite_name, test->m_details.suiteName))
+        {
+            return false;
+        }
+
         return (test_name == NULL) || (!strcmp(test_name, test->m_details.testName));
     }, 0);
 }
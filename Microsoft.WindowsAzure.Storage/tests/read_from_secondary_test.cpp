@@ -267,4 +267,52 @@ SUITE(Core)
         CHECK_THROW(container.list_blobs_segmented(utility::string_t(), true, wa::storage::blob_listing_includes(), 1, token, options, m_context), wa::storage::storage_exception);
         CHECK_EQUAL(5, m_context.request_results().size());
     }
+
+    TEST_FIXTURE(blob_test_base, adaptive_location_mode)
+    {
+        wa::storage::blob_request_options options;
+        options.set_location_mode(wa::storage::location_mode::adaptive);
+
+        // Writes can only be served by the primary location
+        auto blob = m_container.get_block_blob_reference(U("blockblob"));
+        blob.upload_text(blob.name(), wa::storage::access_condition(), options, m_context);
+        CHECK(wa::storage::storage_location::primary == m_context.request_results().back().target_location());
+
+        // Reads start at the healthier location, and the other location is probed once enough reads have been served
+        for (int i = 0; i < 20; ++i)
+        {
+            auto offset = m_context.request_results().size();
+            m_client.list_containers_segmented(utility::string_t(), wa::storage::container_listing_includes(), 1, wa::storage::blob_continuation_token(), options, m_context);
+            CHECK_EQUAL(offset + 1, m_context.request_results().size());
+            CHECK_EQUAL(web::http::status_codes::OK, m_context.request_results().back().http_status_code());
+        }
+
+        bool used_secondary = false;
+        for (auto iter = m_context.request_results().begin(); iter != m_context.request_results().end(); ++iter)
+        {
+            used_secondary |= iter->target_location() == wa::storage::storage_location::secondary;
+        }
+
+        CHECK(used_secondary);
+    }
+
+    TEST_FIXTURE(blob_service_test_base, hedged_reads)
+    {
+        CHECK(!wa::storage::blob_request_options().hedged_reads());
+
+        wa::storage::blob_request_options options;
+        options.set_location_mode(wa::storage::location_mode::primary_then_secondary);
+        options.set_hedged_reads(true);
+        CHECK(options.hedged_reads());
+
+        // Once enough response times of the primary location are known, the slowest reads are also sent to the secondary location,
+        // and each read is still served once by whichever location answers first
+        for (int i = 0; i < 50; ++i)
+        {
+            auto offset = m_context.request_results().size();
+            m_client.list_containers_segmented(utility::string_t(), wa::storage::container_listing_includes(), 1, wa::storage::blob_continuation_token(), options, m_context);
+            CHECK_EQUAL(offset + 1, m_context.request_results().size());
+            CHECK_EQUAL(web::http::status_codes::OK, m_context.request_results().back().http_status_code());
+        }
+    }
 }
@@ -246,6 +246,29 @@ SUITE(Core)
         }
     }
 
+    TEST(decorrelated_jitter_retry_results)
+    {
+        wa::storage::decorrelated_jitter_retry_policy policy(std::chrono::seconds(2), 8);
+
+        wa::storage::operation_context op_context;
+        auto last_interval = std::chrono::milliseconds(std::chrono::seconds(2));
+        for (int retry_count = 0; retry_count < 8; ++retry_count)
+        {
+            wa::storage::request_result result(utility::datetime::utc_now(), wa::storage::storage_location::primary, web::http::http_response(web::http::status_codes::InternalError), false);
+            auto retry_info = policy.evaluate(wa::storage::retry_context(retry_count, result, wa::storage::storage_location::primary, wa::storage::location_mode::primary_only), op_context);
+
+            // Each wait is between the delta backoff and three times the previous one, up to the maximum. The policy
+            // takes the time since the last attempt off the wait, which is measured in whole seconds.
+            CHECK(retry_info.should_retry());
+            CHECK(retry_info.retry_interval() >= std::chrono::milliseconds(1000));
+            CHECK(retry_info.retry_interval() <= std::min(last_interval * 3, wa::storage::max_exponential_retry_interval));
+            last_interval = retry_info.retry_interval() + std::chrono::milliseconds(1000);
+        }
+
+        wa::storage::request_result result(utility::datetime::utc_now(), wa::storage::storage_location::primary, web::http::http_response(web::http::status_codes::InternalError), false);
+        CHECK(!policy.evaluate(wa::storage::retry_context(8, result, wa::storage::storage_location::primary, wa::storage::location_mode::primary_only), op_context).should_retry());
+    }
+
     TEST(linear_retry_results)
     {
         auto allowed_delta = [] (int retry_count) -> std::chrono::milliseconds
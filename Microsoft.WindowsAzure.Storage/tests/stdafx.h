@@ -30,5 +30,7 @@
 #include "UnitTest++.h"
 #include "TestReporterStdout.h"
 
+#include <atomic>
 #include <thread>
+#include <fstream>
 #include <math.h>
@@ -0,0 +1,229 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="table_batch_parser_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "wascore/protocol.h"
+
+namespace
+{
+    const char insert_etag[] = "W/\"datetime'2013-10-15T08%3A30%3A12.5012346Z'\"";
+    const char delete_etag[] = "W/\"datetime'2013-10-15T08%3A30%3A12.6123457Z'\"";
+
+    // The response of the service to a changeset that inserts an entity and echoes it, then deletes another one
+    const std::string changeset_response(
+        "--batchresponse_4c637ba4-b2e8-40f9-8b1d-f8b6a9c3b0d1\r\n"
+        "Content-Type: multipart/mixed; boundary=changesetresponse_f2e5fde7-8c8d-4b5e-9b4a-2b5b2a2d1a3e\r\n"
+        "\r\n"
+        "--changesetresponse_f2e5fde7-8c8d-4b5e-9b4a-2b5b2a2d1a3e\r\n"
+        "Content-Type: application/http\r\n"
+        "Content-Transfer-Encoding: binary\r\n"
+        "\r\n"
+        "HTTP/1.1 201 Created\r\n"
+        "Content-ID: 1\r\n"
+        "X-Content-Type-Options: nosniff\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Preference-Applied: return-content\r\n"
+        "DataServiceVersion: 3.0;\r\n"
+        "Location: https://account.table.core.windows.net/people(PartitionKey='a',RowKey='1')\r\n"
+        "Content-Type: application/json;odata=minimalmetadata;streaming=true;charset=utf-8\r\n"
+        "ETag: W/\"datetime'2013-10-15T08%3A30%3A12.5012346Z'\"\r\n"
+        "\r\n"
+        "{\"odata.metadata\":\"https://account.table.core.windows.net/$metadata#people/@Element\","
+        "\"odata.etag\":\"W/\\\"datetime'2013-10-15T08%3A30%3A12.5012346Z'\\\"\","
+        "\"PartitionKey\":\"a\",\"RowKey\":\"1\",\"Timestamp\":\"2013-10-15T08:30:12.5012346Z\",\"Name\":\"caf\xC3\xA9\"}\r\n"
+        "--changesetresponse_f2e5fde7-8c8d-4b5e-9b4a-2b5b2a2d1a3e\r\n"
+        "Content-Type: application/http\r\n"
+        "Content-Transfer-Encoding: binary\r\n"
+        "\r\n"
+        "HTTP/1.1 204 No Content\r\n"
+        "Content-ID: 2\r\n"
+        "X-Content-Type-Options: nosniff\r\n"
+        "Cache-Control: no-cache\r\n"
+        "DataServiceVersion: 1.0;\r\n"
+        "ETag: W/\"datetime'2013-10-15T08%3A30%3A12.6123457Z'\"\r\n"
+        "\r\n"
+        "\r\n"
+        "--changesetresponse_f2e5fde7-8c8d-4b5e-9b4a-2b5b2a2d1a3e--\r\n"
+        "--batchresponse_4c637ba4-b2e8-40f9-8b1d-f8b6a9c3b0d1--\r\n");
+
+    // The response of the service to a batch that retrieves an entity, which is not in a changeset
+    const std::string retrieve_response(
+        "--batchresponse_9a2d3c41-0b7e-4f35-a0d6-5e2f8c1b7d40\r\n"
+        "Content-Type: application/http\r\n"
+        "Content-Transfer-Encoding: binary\r\n"
+        "\r\n"
+        "HTTP/1.1 200 OK\r\n"
+        "X-Content-Type-Options: nosniff\r\n"
+        "Cache-Control: no-cache\r\n"
+        "DataServiceVersion: 3.0;\r\n"
+        "Content-Type: application/json;odata=minimalmetadata;streaming=true;charset=utf-8\r\n"
+        "ETag: W/\"datetime'2013-10-15T08%3A30%3A12.5012346Z'\"\r\n"
+        "\r\n"
+        "{\"odata.metadata\":\"https://account.table.core.windows.net/$metadata#people/@Element\","
+        "\"PartitionKey\":\"a\",\"RowKey\":\"1\",\"Timestamp\":\"2013-10-15T08:30:12.5012346Z\",\"Name\":\"caf\xC3\xA9\"}\r\n"
+        "--batchresponse_9a2d3c41-0b7e-4f35-a0d6-5e2f8c1b7d40--\r\n");
+
+    // The response of the service to a changeset whose second operation failed, which holds only the failure
+    const std::string conflict_response(
+        "--batchresponse_0d3f1e6a-7c2b-4a9e-8f51-3b6d2e9c4a17\r\n"
+        "Content-Type: multipart/mixed; boundary=changesetresponse_6b8e2f0c-1d4a-4e73-9c25-7a0f3d5b8e61\r\n"
+        "\r\n"
+        "--changesetresponse_6b8e2f0c-1d4a-4e73-9c25-7a0f3d5b8e61\r\n"
+        "Content-Type: application/http\r\n"
+        "Content-Transfer-Encoding: binary\r\n"
+        "\r\n"
+        "HTTP/1.1 409 Conflict\r\n"
+        "Content-ID: 2\r\n"
+        "X-Content-Type-Options: nosniff\r\n"
+        "Cache-Control: no-cache\r\n"
+        "DataServiceVersion: 3.0;\r\n"
+        "Content-Type: application/json;odata=minimalmetadata;streaming=true;charset=utf-8\r\n"
+        "\r\n"
+        "{\"odata.error\":{\"code\":\"EntityAlreadyExists\",\"message\":{\"lang\":\"en-US\",\"value\":\"1:The specified entity already exists.\\n"
+        "RequestId:5e1f8b2a-0002-0036-4c3e-8c1b2d000000\\nTime:2013-10-15T08:30:12.7234568Z\"}}}\r\n"
+        "--changesetresponse_6b8e2f0c-1d4a-4e73-9c25-7a0f3d5b8e61--\r\n"
+        "--batchresponse_0d3f1e6a-7c2b-4a9e-8f51-3b6d2e9c4a17--\r\n");
+
+    std::vector<wa::storage::table_result> parse(const std::string& body, bool is_query, size_t batch_size)
+    {
+        return wa::storage::protocol::table_response_parsers::parse_batch_results(concurrency::streams::bytestream::open_istream(body), is_query, batch_size);
+    }
+
+    // The parser takes 16KB from the body at a time, so a preamble, which comes before the first boundary and is ignored,
+    // puts the end of the first chunk the given number of bytes into the response
+    std::string split_at(const std::string& response, size_t split)
+    {
+        const size_t chunk_size = 16 * 1024;
+        return std::string(chunk_size - split - 2, 'p') + "\r\n" + response;
+    }
+
+    void check_entity(const wa::storage::table_result& result, const char* etag)
+    {
+        auto& entity = result.entity();
+        CHECK_UTF8_EQUAL(U("a"), entity.partition_key());
+        CHECK_UTF8_EQUAL(U("1"), entity.row_key());
+        CHECK_EQUAL(std::string(etag), utility::conversions::to_utf8string(entity.etag()));
+
+        auto name = entity.properties().find(U("Name"));
+        CHECK(name != entity.properties().end());
+        if (name != entity.properties().end())
+        {
+            CHECK_EQUAL(std::string("caf\xC3\xA9"), utility::conversions::to_utf8string(name->second.string_value()));
+        }
+    }
+
+    void check_changeset_results(const std::vector<wa::storage::table_result>& results)
+    {
+        CHECK_EQUAL(2U, results.size());
+        if (results.size() == 2)
+        {
+            CHECK_EQUAL(web::http::status_codes::Created, results[0].http_status_code());
+            CHECK_EQUAL(std::string(insert_etag), utility::conversions::to_utf8string(results[0].etag()));
+            check_entity(results[0], insert_etag);
+
+            CHECK_EQUAL(web::http::status_codes::NoContent, results[1].http_status_code());
+            CHECK_EQUAL(std::string(delete_etag), utility::conversions::to_utf8string(results[1].etag()));
+            CHECK(results[1].entity().properties().empty());
+        }
+    }
+
+    void check_retrieve_results(const std::vector<wa::storage::table_result>& results)
+    {
+        CHECK_EQUAL(1U, results.size());
+        if (results.size() == 1)
+        {
+            CHECK_EQUAL(web::http::status_codes::OK, results[0].http_status_code());
+            check_entity(results[0], insert_etag);
+        }
+    }
+
+    void check_conflict(const std::string& body)
+    {
+        bool thrown = false;
+        try
+        {
+            parse(body, false, 2);
+        }
+        catch (const wa::storage::storage_exception& e)
+        {
+            // The failure is reported with the description the service gave
+            thrown = true;
+            CHECK(std::string(e.what()).find("EntityAlreadyExists") != std::string::npos);
+        }
+
+        CHECK(thrown);
+    }
+}
+
+SUITE(Table)
+{
+    TEST(table_batch_parser_results)
+    {
+        check_changeset_results(parse(changeset_response, false, 2));
+        check_retrieve_results(parse(retrieve_response, true, 1));
+        check_conflict(conflict_response);
+
+        // A retrieve of an entity that does not exist is not a failure
+        std::string not_found(retrieve_response);
+        not_found.replace(not_found.find("200 OK"), 6, "404 Not Found");
+        auto results = parse(not_found, true, 1);
+        CHECK_EQUAL(1U, results.size());
+        CHECK_EQUAL(web::http::status_codes::NotFound, results[0].http_status_code());
+        CHECK_THROW(parse(not_found, false, 1), wa::storage::storage_exception);
+    }
+
+    TEST(table_batch_parser_chunks)
+    {
+        // Every byte of the responses is the first one of a chunk in turn, which splits their boundary lines,
+        // the line breaks, the headers of the parts and the operations and the entities in every place
+        for (size_t split = 0; split <= changeset_response.size(); ++split)
+        {
+            check_changeset_results(parse(split_at(changeset_response, split), false, 2));
+        }
+
+        for (size_t split = 0; split <= retrieve_response.size(); ++split)
+        {
+            check_retrieve_results(parse(split_at(retrieve_response, split), true, 1));
+        }
+
+        for (size_t split = 0; split <= conflict_response.size(); ++split)
+        {
+            check_conflict(split_at(conflict_response, split));
+        }
+    }
+
+    TEST(table_batch_parser_truncated)
+    {
+        // A body that ends anywhere before the closing boundary of the batch fails, rather than giving fewer results
+        // or a part of an entity. Only the line break after the closing boundary may be missing.
+        for (size_t length = 0; length < changeset_response.size() - 2; ++length)
+        {
+            CHECK_THROW(parse(changeset_response.substr(0, length), false, 2), wa::storage::storage_exception);
+        }
+
+        for (size_t length = 0; length < retrieve_response.size() - 2; ++length)
+        {
+            CHECK_THROW(parse(retrieve_response.substr(0, length), true, 1), wa::storage::storage_exception);
+        }
+
+        check_changeset_results(parse(changeset_response.substr(0, changeset_response.size() - 2), false, 2));
+        check_changeset_results(parse(changeset_response.substr(0, changeset_response.size() - 1), false, 2));
+        check_retrieve_results(parse(retrieve_response.substr(0, retrieve_response.size() - 2), true, 1));
+    }
+}
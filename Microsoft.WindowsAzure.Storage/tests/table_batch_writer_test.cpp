@@ -0,0 +1,236 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="table_batch_writer_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "wascore/protocol.h"
+#include "wascore/protocol_json.h"
+
+namespace
+{
+    const char etag[] = "W/\"datetime'2013-10-15T08%3A30%3A12.5012346Z'\"";
+
+    std::string read_body(const web::http::http_request& request)
+    {
+        concurrency::streams::container_buffer<std::string> buffer;
+        request.body().read_to_end(buffer).wait();
+        return buffer.collection();
+    }
+
+    // Gets the boundary that follows the given text in the body
+    std::string find_boundary(const std::string& body, const std::string& prefix)
+    {
+        size_t begin = body.find(prefix);
+        if (begin == std::string::npos)
+        {
+            return std::string();
+        }
+
+        begin += prefix.size();
+        return body.substr(begin, body.find("\r\n", begin) - begin);
+    }
+
+    // Serializes an entity the way the batch writer did before it wrote UTF-8 directly: as a web::json object,
+    // converted to a platform string and then to UTF-8. Only strings, booleans and 32-bit integers are used,
+    // which have been written without a type annotation since the entity writer stopped annotating strings.
+    std::string write_entity_with_json_value(const wa::storage::table_entity& entity)
+    {
+        web::json::value::field_map fields;
+        fields.push_back(std::make_pair(web::json::value(U("PartitionKey")), web::json::value(entity.partition_key())));
+        fields.push_back(std::make_pair(web::json::value(U("RowKey")), web::json::value(entity.row_key())));
+
+        auto& properties = entity.properties();
+        for (auto iter = properties.cbegin(); iter != properties.cend(); ++iter)
+        {
+            web::json::value value;
+            switch (iter->second.property_type())
+            {
+            case wa::storage::edm_type::boolean:
+                value = web::json::value(iter->second.boolean_value());
+                break;
+
+            case wa::storage::edm_type::int32:
+                value = web::json::value(iter->second.int32_value());
+                break;
+
+            default:
+                value = web::json::value(iter->second.str());
+                break;
+            }
+
+            fields.push_back(std::make_pair(web::json::value(iter->first), value));
+        }
+
+        return utility::conversions::to_utf8string(web::json::value::object(fields).to_string());
+    }
+
+    void check_entity(const wa::storage::table_entity& entity)
+    {
+        std::string body;
+        wa::storage::protocol::table_entity_writer::write_entity(body, entity);
+        CHECK_EQUAL(write_entity_with_json_value(entity), body);
+    }
+}
+
+SUITE(Table)
+{
+    TEST(table_batch_writer_golden_body)
+    {
+        wa::storage::cloud_table_client client(wa::storage::storage_uri(web::http::uri(U("https://account.table.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")));
+        auto table = client.get_table_reference(U("people"));
+
+        // Text outside of ASCII in the keys, the names and the values, including a character outside of the basic plane,
+        // and the characters that JSON escapes
+        wa::storage::table_batch_operation operation;
+        wa::storage::table_entity inserted(U("a"), U("1"));
+        inserted.properties()[U("Name")] = wa::storage::entity_property(utility::string_t(U("caf\u00E9 \u2615 \U0001F600 \"q\" \\ \n\t")));
+        operation.insert_entity(inserted);
+
+        wa::storage::table_entity merged(U("a"), U("2 \u00E9"));
+        merged.set_etag(utility::conversions::to_string_t(etag));
+        merged.properties()[U("Gr\u00F6\u00DFe")] = wa::storage::entity_property(int32_t(180));
+        operation.merge_entity(merged);
+
+        operation.delete_entity(wa::storage::table_entity(U("a"), U("3")));
+
+        auto request = wa::storage::protocol::execute_batch_operation(table, operation, wa::storage::table_payload_format::json, false, false, web::http::uri_builder(table.service_client().base_uri().primary_uri()), std::chrono::seconds(30), wa::storage::operation_context());
+        auto body = read_body(request);
+
+        // The boundaries are random, so they are taken from the body
+        auto batch = find_boundary(body, "--");
+        auto changeset = find_boundary(body, "boundary=");
+        CHECK_EQUAL(0U, batch.find("batch_"));
+        CHECK_EQUAL(0U, changeset.find("changeset_"));
+        CHECK_UTF8_EQUAL(utility::conversions::to_string_t("multipart/mixed; boundary=" + batch), request.headers().content_type());
+
+        // The body that the writer built as a platform string before, converted to UTF-8
+        std::string expected;
+        expected.append("--").append(batch).append("\r\n");
+        expected.append("Content-Type: multipart/mixed; boundary=").append(changeset).append("\r\n");
+        expected.append("MaxDataServiceVersion: 3.0;Native\r\n");
+        expected.append("\r\n");
+
+        expected.append("--").append(changeset).append("\r\n");
+        expected.append("Content-Type: application/http\r\n");
+        expected.append("Content-Transfer-Encoding: binary\r\n");
+        expected.append("\r\n");
+        expected.append("POST https://account.table.core.windows.net/people HTTP/1.1\r\n");
+        expected.append("Accept: application/json;odata=minimalmetadata\r\n");
+        expected.append("Content-ID: 0\r\n");
+        expected.append("Content-Type: application/json\r\n");
+        expected.append("MaxDataServiceVersion: 3.0;Native\r\n");
+        expected.append("Prefer: return-no-content\r\n");
+        expected.append("\r\n");
+        expected.append("{\"PartitionKey\":\"a\",\"RowKey\":\"1\",\"Name\":\"caf\xC3\xA9 \xE2\x98\x95 \xF0\x9F\x98\x80 \\\"q\\\" \\\\ \\n\\t\"}\r\n");
+
+        expected.append("--").append(changeset).append("\r\n");
+        expected.append("Content-Type: application/http\r\n");
+        expected.append("Content-Transfer-Encoding: binary\r\n");
+        expected.append("\r\n");
+        expected.append("MERGE https://account.table.core.windows.net/people(PartitionKey='a',RowKey='2%20%C3%A9') HTTP/1.1\r\n");
+        expected.append("Content-ID: 1\r\n");
+        expected.append("Content-Type: application/json\r\n");
+        expected.append("If-Match: ").append(etag).append("\r\n");
+        expected.append("MaxDataServiceVersion: 3.0;Native\r\n");
+        expected.append("\r\n");
+        expected.append("{\"PartitionKey\":\"a\",\"RowKey\":\"2 \xC3\xA9\",\"Gr\xC3\xB6\xC3\x9F" "e\":180}\r\n");
+
+        expected.append("--").append(changeset).append("\r\n");
+        expected.append("Content-Type: application/http\r\n");
+        expected.append("Content-Transfer-Encoding: binary\r\n");
+        expected.append("\r\n");
+        expected.append("DELETE https://account.table.core.windows.net/people(PartitionKey='a',RowKey='3') HTTP/1.1\r\n");
+        expected.append("Content-ID: 2\r\n");
+        expected.append("If-Match: *\r\n");
+        expected.append("MaxDataServiceVersion: 3.0;Native\r\n");
+        expected.append("\r\n");
+        expected.append("\r\n");
+
+        expected.append("--").append(changeset).append("--\r\n");
+        expected.append("--").append(batch).append("--\r\n");
+
+        CHECK_EQUAL(expected, body);
+
+        utility::size64_t content_length = 0;
+        CHECK(request.headers().match(web::http::header_names::content_length, content_length));
+        CHECK_EQUAL(static_cast<utility::size64_t>(expected.size()), content_length);
+    }
+
+    TEST(table_batch_writer_retrieve_body)
+    {
+        wa::storage::cloud_table_client client(wa::storage::storage_uri(web::http::uri(U("https://account.table.core.windows.net"))), wa::storage::storage_credentials(U("account"), U("YWNjb3VudGtleQ==")));
+        auto table = client.get_table_reference(U("people"));
+
+        // A retrieve is not in a changeset, and has no content
+        wa::storage::table_batch_operation operation;
+        operation.retrieve_entity(U("\u00E9"), U("1"));
+
+        auto request = wa::storage::protocol::execute_batch_operation(table, operation, wa::storage::table_payload_format::json, true, false, web::http::uri_builder(table.service_client().base_uri().primary_uri()), std::chrono::seconds(30), wa::storage::operation_context());
+        auto body = read_body(request);
+        auto batch = find_boundary(body, "--");
+
+        std::string expected;
+        expected.append("--").append(batch).append("\r\n");
+        expected.append("Content-Type: application/http\r\n");
+        expected.append("Content-Transfer-Encoding: binary\r\n");
+        expected.append("\r\n");
+        expected.append("GET https://account.table.core.windows.net/people(PartitionKey='%C3%A9',RowKey='1') HTTP/1.1\r\n");
+        expected.append("Accept: application/json;odata=minimalmetadata\r\n");
+        expected.append("MaxDataServiceVersion: 3.0;Native\r\n");
+        expected.append("\r\n");
+        expected.append("\r\n");
+        expected.append("--").append(batch).append("--\r\n");
+
+        CHECK_EQUAL(expected, body);
+    }
+
+    TEST(table_batch_writer_json_value_parity)
+    {
+        // The entity writer gives the same bytes as a web::json object converted to UTF-8, whatever the text
+        const utility::char_t* const texts[] =
+        {
+            U(""),
+            U("plain"),
+            U("caf\u00E9"),
+            U("\u00DF\u00F6\u0100\u07FF"),
+            U("\u0800\u20AC\u2615\uFFFD"),
+            U("\U00010000\U0001F600\U0010FFFF"),
+            U("\"quoted\" and \\back\\slashed"),
+            U("line\nbreak\tand tab"),
+            U("mixed \u00E9\"\\\n\U0001F600 end"),
+        };
+
+        for (auto text : texts)
+        {
+            wa::storage::table_entity entity(text, text);
+            entity.properties()[U("Value")] = wa::storage::entity_property(utility::string_t(text));
+            check_entity(entity);
+
+            // A name outside of ASCII
+            wa::storage::table_entity named(U("partition"), U("row"));
+            named.properties()[utility::string_t(U("N\u00E4me ")) + text] = wa::storage::entity_property(utility::string_t(text));
+            check_entity(named);
+        }
+
+        wa::storage::table_entity typed(U("p\u00E4rtition"), U("r\u00F6w"));
+        typed.properties()[U("\u00C4ge")] = wa::storage::entity_property(int32_t(-42));
+        typed.properties()[U("\u00C4ctive")] = wa::storage::entity_property(true);
+        typed.properties()[U("N\u00E4me")] = wa::storage::entity_property(utility::string_t(U("n\u00E4me")));
+        check_entity(typed);
+    }
+}
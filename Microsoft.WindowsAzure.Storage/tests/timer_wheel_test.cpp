@@ -0,0 +1,216 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="timer_wheel_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "wascore/timer_wheel.h"
+
+namespace
+{
+    // Records which timers fired, in order, and how long after the start of the test each one did
+    class fired_timers
+    {
+    public:
+
+        fired_timers()
+            : m_start(std::chrono::steady_clock::now())
+        {
+        }
+
+        std::function<void()> record(int id)
+        {
+            auto instance = this;
+            return [instance, id] ()
+            {
+                instance->add(id);
+            };
+        }
+
+        void add(int id)
+        {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start);
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_ids.push_back(id);
+            m_elapsed.push_back(elapsed);
+        }
+
+        std::vector<int> ids() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_ids;
+        }
+
+        std::vector<std::chrono::milliseconds> elapsed() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_elapsed;
+        }
+
+    private:
+
+        std::chrono::steady_clock::time_point m_start;
+        std::vector<int> m_ids;
+        std::vector<std::chrono::milliseconds> m_elapsed;
+        mutable std::mutex m_mutex;
+    };
+
+    template<size_t N>
+    void check_ids(const int (&expected)[N], const std::vector<int>& actual)
+    {
+        CHECK_EQUAL(N, actual.size());
+        for (size_t i = 0; i < std::min(N, actual.size()); ++i)
+        {
+            CHECK_EQUAL(expected[i], actual[i]);
+        }
+    }
+}
+
+SUITE(Core)
+{
+    TEST(timer_wheel_order)
+    {
+        auto& wheel = wa::storage::core::timer_wheel::instance();
+        fired_timers fired;
+
+        // Timers fire in the order of their delays, and those due at the same time in the order they were scheduled
+        int delays[] = { 300, 100, 200, 0, 100 };
+        for (int id = 0; id < 5; ++id)
+        {
+            wheel.schedule(std::chrono::milliseconds(delays[id]), fired.record(id));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        const int expected[] = { 3, 1, 4, 2, 0 };
+        check_ids(expected, fired.ids());
+
+        // None fires before its delay has passed, and each one within a few ticks after it
+        auto elapsed = fired.elapsed();
+        auto ids = fired.ids();
+        for (size_t i = 0; i < std::min(elapsed.size(), ids.size()); ++i)
+        {
+            CHECK(elapsed[i] >= std::chrono::milliseconds(delays[ids[i]]));
+            CHECK(elapsed[i] < std::chrono::milliseconds(delays[ids[i]] + 100));
+        }
+    }
+
+    TEST(timer_wheel_cancel)
+    {
+        auto& wheel = wa::storage::core::timer_wheel::instance();
+        fired_timers fired;
+
+        // A cancelled timer does not fire, and the others around it still do
+        wheel.schedule(std::chrono::milliseconds(100), fired.record(0));
+        auto cancelled = wheel.schedule(std::chrono::milliseconds(150), fired.record(1));
+        wheel.schedule(std::chrono::milliseconds(200), fired.record(2));
+        cancelled.cancel();
+
+        // A callback can cancel a timer that is due later, since callbacks run without the lock of the wheel
+        auto later = wheel.schedule(std::chrono::milliseconds(300), fired.record(3));
+        wheel.schedule(std::chrono::milliseconds(250), [&fired, later] ()
+        {
+            later.cancel();
+            fired.add(4);
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        const int expected[] = { 0, 2, 4 };
+        check_ids(expected, fired.ids());
+
+        // Cancelling a timer that has fired or was cancelled already, or one that was never scheduled, does nothing
+        cancelled.cancel();
+        later.cancel();
+        wa::storage::core::timer_wheel::timer().cancel();
+
+        wheel.schedule(std::chrono::milliseconds(50), fired.record(5));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        const int expected_later[] = { 0, 2, 4, 5 };
+        check_ids(expected_later, fired.ids());
+    }
+
+    TEST(timer_wheel_rotations)
+    {
+        auto& wheel = wa::storage::core::timer_wheel::instance();
+        fired_timers fired;
+
+        // Level 0 of the wheel spans 2.56 seconds, so a longer timer waits in the level above until it is moved down
+        wheel.schedule(std::chrono::milliseconds(3000), fired.record(0));
+
+        // A timer that schedules the next one from its callback keeps firing as the wheel turns over
+        std::function<void(int)> reschedule;
+        reschedule = [&wheel, &fired, &reschedule] (int id)
+        {
+            fired.add(id);
+            if (id < 13)
+            {
+                wheel.schedule(std::chrono::milliseconds(900), [&reschedule, id] () { reschedule(id + 1); });
+            }
+        };
+
+        wheel.schedule(std::chrono::milliseconds(900), [&reschedule] () { reschedule(10); });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(4000));
+        const int expected[] = { 10, 11, 12, 0, 13 };
+        check_ids(expected, fired.ids());
+
+        auto elapsed = fired.elapsed();
+        if (elapsed.size() == 5U)
+        {
+            CHECK(elapsed[3] >= std::chrono::milliseconds(3000));
+            CHECK(elapsed[3] < std::chrono::milliseconds(3200));
+            for (size_t i = 0; i < 3; ++i)
+            {
+                CHECK(elapsed[i] >= std::chrono::milliseconds(900 * (i + 1)));
+            }
+
+            CHECK(elapsed[4] >= std::chrono::milliseconds(3600));
+            CHECK(elapsed[4] - elapsed[2] >= std::chrono::milliseconds(900));
+        }
+    }
+
+    TEST(timer_wheel_delays)
+    {
+        auto& wheel = wa::storage::core::timer_wheel::instance();
+        fired_timers fired;
+
+        // A zero or negative delay fires on the next tick
+        wheel.schedule(std::chrono::milliseconds(0), fired.record(0));
+        wheel.schedule(std::chrono::milliseconds(-1000), fired.record(1));
+
+        // Delays beyond what the levels of the wheel span, up to the largest one there is, wait without firing
+        auto month = wheel.schedule(std::chrono::hours(24 * 30), fired.record(2));
+        auto longest = wheel.schedule(std::chrono::milliseconds::max(), fired.record(3));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        const int expected[] = { 0, 1 };
+        check_ids(expected, fired.ids());
+        auto elapsed = fired.elapsed();
+        for (auto iter = elapsed.begin(); iter != elapsed.end(); ++iter)
+        {
+            CHECK(*iter < std::chrono::milliseconds(100));
+        }
+
+        // The long timers do not hold up the short ones scheduled after them
+        wheel.schedule(std::chrono::milliseconds(100), fired.record(4));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        const int expected_later[] = { 0, 1, 4 };
+        check_ids(expected_later, fired.ids());
+
+        month.cancel();
+        longest.cancel();
+    }
+}
@@ -0,0 +1,194 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="transcode_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "wascore/transcode.h"
+
+namespace
+{
+    // Characters of each length in UTF-8, at both ends of the range of that length
+    const char* const non_ascii_characters[] =
+    {
+        "\xC2\x80", "\xC3\xA9", "\xDF\xBF",
+        "\xE0\xA0\x80", "\xE2\x82\xAC", "\xED\x9F\xBF", "\xEE\x80\x80", "\xEF\xBF\xBF",
+        "\xF0\x90\x80\x80", "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF",
+    };
+
+    // Sequences that are not valid UTF-8: stray and missing continuation bytes, overlong forms,
+    // surrogates, values above the last code point and bytes that never start a sequence
+    const char* const invalid_sequences[] =
+    {
+        "\x80", "\xBF", "\xC3", "\xC3\x28", "\xE2\x82", "\xE2\x28\xA1", "\xF0\x9F\x98", "\xF0\x9F\x98\x28",
+        "\xC0\xAF", "\xC1\xBF", "\xE0\x80\xAF", "\xF0\x80\x80\xAF",
+        "\xED\xA0\x80", "\xED\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80",
+        "\xF8\x88\x80\x80\x80", "\xFE", "\xFF",
+    };
+
+    // Surrounds the text with ASCII of the given lengths, so that it lands at every offset of a 16-character block
+    std::string surround(const std::string& text, size_t before, size_t after)
+    {
+        std::string result;
+        for (size_t i = 0; i < before; ++i)
+        {
+            result.push_back(static_cast<char>('a' + i % 26));
+        }
+
+        result.append(text);
+        for (size_t i = 0; i < after; ++i)
+        {
+            result.push_back(static_cast<char>('0' + i % 10));
+        }
+
+        return result;
+    }
+
+    // Converts valid UTF-8 both ways, and checks each direction against utility::conversions
+    void check_round_trip(const std::string& utf8)
+    {
+        utility::string_t value = wa::storage::core::to_string_t(utf8);
+        CHECK(utility::conversions::to_string_t(utf8) == value);
+
+        std::string converted = wa::storage::core::to_utf8string(value);
+        CHECK(utility::conversions::to_utf8string(value) == converted);
+        CHECK(utf8 == converted);
+
+        // Appending keeps what the target held before
+        std::string utf8_target("prefix");
+        wa::storage::core::append_utf8(utf8_target, value.data(), value.size());
+        CHECK("prefix" + utf8 == utf8_target);
+
+        utility::string_t target(U("prefix"));
+        wa::storage::core::append_string_t(target, utf8.data(), utf8.size());
+        CHECK(U("prefix") + value == target);
+    }
+
+    // Checks that text that is not valid UTF-8 gives the same result as utility::conversions, or fails the same way
+    void check_invalid(const std::string& utf8)
+    {
+        bool expected_failure = false;
+        utility::string_t expected;
+        try
+        {
+            expected = utility::conversions::to_string_t(utf8);
+        }
+        catch (const std::exception&)
+        {
+            expected_failure = true;
+        }
+
+        bool failure = false;
+        utility::string_t target(U("prefix"));
+        try
+        {
+            wa::storage::core::append_string_t(target, utf8.data(), utf8.size());
+        }
+        catch (const std::exception&)
+        {
+            failure = true;
+        }
+
+        CHECK_EQUAL(expected_failure, failure);
+        CHECK(failure ? (target == U("prefix")) : (target == U("prefix") + expected));
+    }
+}
+
+SUITE(Core)
+{
+    TEST(transcode_ascii)
+    {
+        // Every length up to a few blocks, so that both the blocks and the characters after them are converted
+        for (size_t length = 0; length <= 50; ++length)
+        {
+            check_round_trip(surround(std::string(), length, 0));
+        }
+
+        // All of ASCII, including the control characters and the null character
+        std::string ascii;
+        for (int c = 0; c < 0x80; ++c)
+        {
+            ascii.push_back(static_cast<char>(c));
+        }
+
+        check_round_trip(ascii);
+        check_round_trip(ascii + ascii + ascii);
+    }
+
+    TEST(transcode_non_ascii)
+    {
+        // A character of each length at every offset of a block, followed by blocks of ASCII and partial ones
+        for (auto character : non_ascii_characters)
+        {
+            for (size_t before = 0; before <= 33; ++before)
+            {
+                check_round_trip(surround(character, before, 0));
+                check_round_trip(surround(character, before, 17));
+                check_round_trip(surround(character, before, 40));
+            }
+        }
+
+        // Text with no ASCII at all, and characters of every length next to each other
+        std::string mixed;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (auto character : non_ascii_characters)
+            {
+                mixed.append(character);
+            }
+        }
+
+        check_round_trip(mixed);
+        check_round_trip(surround(mixed, 15, 16) + mixed);
+
+        // A character outside of the basic plane is a surrogate pair in UTF-16
+        utility::string_t emoji = wa::storage::core::to_string_t(std::string("\xF0\x9F\x98\x80"));
+#ifdef _UTF16_STRINGS
+        CHECK_EQUAL(2U, emoji.size());
+        CHECK_EQUAL(0xD83D, static_cast<int>(emoji[0]));
+        CHECK_EQUAL(0xDE00, static_cast<int>(emoji[1]));
+#else
+        CHECK_EQUAL(4U, emoji.size());
+#endif
+    }
+
+    TEST(transcode_invalid_sequences)
+    {
+        // Invalid UTF-8 is left to utility::conversions, wherever it is in the text
+        for (auto sequence : invalid_sequences)
+        {
+            check_invalid(sequence);
+            check_invalid(surround(sequence, 16, 0));
+            check_invalid(surround(sequence, 21, 16));
+            check_invalid(surround("\xC3\xA9" + std::string(sequence), 3, 40));
+        }
+
+#ifdef _UTF16_STRINGS
+        // A lone surrogate in UTF-16 is written as the three bytes of its code unit
+        utility::string_t high(U("a"));
+        high.push_back(static_cast<utility::char_t>(0xD83D));
+        CHECK_EQUAL(std::string("a\xED\xA0\xBD"), wa::storage::core::to_utf8string(high));
+
+        high.push_back(U('b'));
+        CHECK_EQUAL(std::string("a\xED\xA0\xBD" "b"), wa::storage::core::to_utf8string(high));
+
+        utility::string_t low(1, static_cast<utility::char_t>(0xDE00));
+        low.push_back(static_cast<utility::char_t>(0xD83D));
+        CHECK_EQUAL(std::string("\xED\xB8\x80\xED\xA0\xBD"), wa::storage::core::to_utf8string(low));
+#endif
+    }
+}
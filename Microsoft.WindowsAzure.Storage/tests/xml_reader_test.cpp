@@ -0,0 +1,214 @@
+// -----------------------------------------------------------------------------------------
+// <copyright file="xml_reader_test.cpp" company="Microsoft">
+//    Copyright 2013 Microsoft Corporation
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+// </copyright>
+// -----------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "check_macros.h"
+
+#include "wascore/xmlhelpers.h"
+
+namespace
+{
+    // Records what the reader reports as "<name" for a start element, "@name=value" for each of its attributes,
+    // "'text" for text and "/name" for an end element
+    class recording_reader : public wa::storage::core::xml::xml_reader
+    {
+    public:
+
+        explicit recording_reader(const std::string& document)
+            : xml_reader(concurrency::streams::bytestream::open_istream(document))
+        {
+            m_finished = !parse();
+        }
+
+        const std::vector<std::string>& events() const
+        {
+            return m_events;
+        }
+
+        const std::vector<std::string>& errors() const
+        {
+            return m_errors;
+        }
+
+        bool finished() const
+        {
+            return m_finished;
+        }
+
+    protected:
+
+        virtual void handle_begin_element(const utility::string_t& element_name) override
+        {
+            m_events.push_back("<" + utility::conversions::to_utf8string(element_name));
+            while (move_to_next_attribute())
+            {
+                m_events.push_back("@" + utility::conversions::to_utf8string(get_current_element_name()) + "=" + utility::conversions::to_utf8string(get_current_element_text()));
+            }
+        }
+
+        virtual void handle_element(const utility::string_t&) override
+        {
+            m_events.push_back("'" + utility::conversions::to_utf8string(get_current_element_text()));
+        }
+
+        virtual void handle_end_element(const utility::string_t& element_name) override
+        {
+            m_events.push_back("/" + utility::conversions::to_utf8string(element_name));
+        }
+
+        virtual void log_error_message(const utility::string_t& message, unsigned long) override
+        {
+            m_errors.push_back(utility::conversions::to_utf8string(message));
+        }
+
+    private:
+
+        std::vector<std::string> m_events;
+        std::vector<std::string> m_errors;
+        bool m_finished;
+    };
+
+    void check_events(const std::vector<std::string>& expected, const std::vector<std::string>& actual)
+    {
+        CHECK_EQUAL(expected.size(), actual.size());
+        for (size_t i = 0; i < std::min(expected.size(), actual.size()); ++i)
+        {
+            CHECK_EQUAL(expected[i], actual[i]);
+        }
+    }
+
+    template<size_t N>
+    void check_events(const char* const (&expected)[N], const std::vector<std::string>& actual)
+    {
+        check_events(std::vector<std::string>(expected, expected + N), actual);
+    }
+}
+
+SUITE(Core)
+{
+    TEST(xml_reader_references)
+    {
+        // The predefined entities and character references of any length are expanded
+        recording_reader reader("<a>&lt;&gt;&amp;&quot;&apos; &#65;&#x42;&#xe9;&#x20AC;&#x1F600;</a>");
+        CHECK(reader.finished());
+        CHECK(reader.errors().empty());
+        const char* const expected[] = { "<a", "'<>&\"' AB\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80", "/a" };
+        check_events(expected, reader.events());
+
+        // A reference that is not one is kept as it is, and line breaks are normalized
+        recording_reader unknown("<a>&nbsp; &#xZZ; & b&;\r\nc\rd</a>");
+        const char* const unknown_events[] = { "<a", "'&nbsp; &#xZZ; & b&;\nc\nd", "/a" };
+        check_events(unknown_events, unknown.events());
+
+        // Attribute values are decoded the same way, and either quote may delimit them
+        recording_reader attributes("<p:a x=\"1 &amp; 2\" p:y='say \"hi\"' z = \"&#x3C;\"/>");
+        const char* const attributes_events[] = { "<a", "@x=1 & 2", "@y=say \"hi\"", "@z=<", "/a" };
+        check_events(attributes_events, attributes.events());
+    }
+
+    TEST(xml_reader_markup)
+    {
+        // CDATA is reported as it is, while comments and processing instructions are skipped
+        recording_reader reader("<?xml version=\"1.0\" encoding=\"utf-8\"?><!-- <b> --><a><![CDATA[<b>&amp;]]><?pi <c>?>t<![CDATA[]]></a>");
+        CHECK(reader.errors().empty());
+        const char* const expected[] = { "<a", "'<b>&amp;", "'t", "/a" };
+        check_events(expected, reader.events());
+
+        // The UTF-8 byte order mark is skipped
+        recording_reader bom("\xEF\xBB\xBF<a>\xC3\xA9</a>");
+        CHECK(bom.errors().empty());
+        const char* const bom_events[] = { "<a", "'\xC3\xA9", "/a" };
+        check_events(bom_events, bom.events());
+
+        // Text that is only whitespace is not reported, but the whitespace around other text is kept
+        recording_reader whitespace("<a>\r\n  <b> </b>\t<c> x </c>\n</a>\n");
+        CHECK(whitespace.errors().empty());
+        const char* const whitespace_events[] = { "<a", "<b", "/b", "<c", "' x ", "/c", "/a" };
+        check_events(whitespace_events, whitespace.events());
+    }
+
+    TEST(xml_reader_buffer_boundaries)
+    {
+        // The reader takes 16KB from the stream at a time, so moving the element across the end of the
+        // first chunk splits each of its tags, attributes, references and CDATA sections in turn
+        const std::string item("<item name=\"a&amp;b\" id='7'>x&lt;y<![CDATA[<z>]]></item>");
+        const size_t chunk_size = 16 * 1024;
+        const std::string head("<root><pad>");
+        const std::string tail("</pad>");
+        const char* const item_events[] = { "/pad", "<item", "@name=a&b", "@id=7", "'x<y", "'<z>", "/item", "/root" };
+        for (size_t split = 0; split <= item.size(); ++split)
+        {
+            std::string padding(chunk_size - split - head.size() - tail.size(), 'p');
+            recording_reader reader(head + padding + tail + item + "</root>");
+            CHECK(reader.errors().empty());
+            std::vector<std::string> expected;
+            expected.push_back("<root");
+            expected.push_back("<pad");
+            expected.push_back("'" + padding);
+            expected.insert(expected.end(), item_events, item_events + _countof(item_events));
+            check_events(expected, reader.events());
+        }
+
+        // Text longer than a chunk is reported whole
+        std::string text(3 * chunk_size + 5, 't');
+        text.replace(chunk_size - 2, 5, "&amp;");
+        recording_reader reader("<a>" + text + "</a>");
+        std::string decoded(text);
+        decoded.replace(chunk_size - 2, 5, "&");
+        std::vector<std::string> expected;
+        expected.push_back("<a");
+        expected.push_back("'" + decoded);
+        expected.push_back("/a");
+        check_events(expected, reader.events());
+    }
+
+    TEST(xml_reader_malformed_input)
+    {
+        // Document type definitions are not processed, so the reader stops at one
+        recording_reader dtd("<!DOCTYPE a [<!ENTITY e \"x\">]><a>&e;</a>");
+        CHECK(dtd.finished());
+        CHECK_EQUAL(1U, dtd.errors().size());
+        CHECK(dtd.events().empty());
+
+        // Malformed input ends the parse after what was read before it, instead of throwing
+        recording_reader unquoted("<a><b x=1/></a>");
+        CHECK_EQUAL(1U, unquoted.errors().size());
+        const char* const unquoted_events[] = { "<a" };
+        check_events(unquoted_events, unquoted.events());
+
+        recording_reader mismatched("<a><b></a></b>");
+        CHECK_EQUAL(1U, mismatched.errors().size());
+        const char* const mismatched_events[] = { "<a", "<b" };
+        check_events(mismatched_events, mismatched.events());
+
+        recording_reader truncated("<a><b attribute=\"value");
+        CHECK_EQUAL(1U, truncated.errors().size());
+        const char* const truncated_events[] = { "<a" };
+        check_events(truncated_events, truncated.events());
+
+        recording_reader unterminated("<a><![CDATA[text</a>");
+        CHECK_EQUAL(1U, unterminated.errors().size());
+        const char* const unterminated_events[] = { "<a" };
+        check_events(unterminated_events, unterminated.events());
+
+        // A body that is not XML at all, such as some error responses, is only text outside of any element
+        recording_reader text("Service Unavailable");
+        CHECK(text.finished());
+        CHECK(text.errors().empty());
+        CHECK(text.events().empty());
+    }
+}